@@ -63,6 +63,17 @@ CameraMetadata &CameraMetadata::operator=(const camera_metadata_t *buffer) {
     }
 
     if (CC_LIKELY(buffer != mBuffer)) {
+        // Copy into the existing buffer when it is large enough, so that
+        // repeatedly assigned requests and results don't reallocate.
+        if (buffer != NULL && mBuffer != NULL) {
+            size_t needed = calculate_camera_metadata_size(
+                    get_camera_metadata_entry_count(buffer),
+                    get_camera_metadata_data_count(buffer));
+            if (needed <= get_camera_metadata_size(mBuffer) &&
+                    copy_camera_metadata(mBuffer, needed, buffer) != NULL) {
+                return *this;
+            }
+        }
         camera_metadata_t *newBuffer = clone_camera_metadata(buffer);
         clear();
         mBuffer = newBuffer;
@@ -316,18 +327,31 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void *data,
     size_t data_size = calculate_camera_metadata_entry_data_size(type,
             data_count);
 
-    res = resizeIfNeeded(1, data_size);
-
+    // Only grow the buffer by what the update actually adds; an existing
+    // entry that keeps its size is overwritten in place.
+    camera_metadata_entry_t entry;
+    res = find_camera_metadata_entry(mBuffer, tag, &entry);
     if (res == OK) {
-        camera_metadata_entry_t entry;
-        res = find_camera_metadata_entry(mBuffer, tag, &entry);
-        if (res == NAME_NOT_FOUND) {
-            res = add_camera_metadata_entry(mBuffer,
-                    tag, data, data_count);
-        } else if (res == OK) {
+        size_t entry_size = calculate_camera_metadata_entry_data_size(type,
+                entry.count);
+        if (data_size > entry_size) {
+            // update_camera_metadata_entry appends the new data and leaves
+            // the old data in place
+            res = resizeIfNeeded(0, data_size);
+            if (res == OK) {
+                res = find_camera_metadata_entry(mBuffer, tag, &entry);
+            }
+        }
+        if (res == OK) {
             res = update_camera_metadata_entry(mBuffer,
                     entry.index, data, data_count, NULL);
         }
+    } else if (res == NAME_NOT_FOUND || mBuffer == NULL) {
+        res = resizeIfNeeded(1, data_size);
+        if (res == OK) {
+            res = add_camera_metadata_entry(mBuffer,
+                    tag, data, data_count);
+        }
     }
 
     if (res != OK) {
@@ -410,6 +434,38 @@ void CameraMetadata::dump(int fd, int verbosity, int indentation) const {
     dump_indented_camera_metadata(mBuffer, fd, verbosity, indentation);
 }
 
+status_t CameraMetadata::reserve(size_t entryCapacity, size_t dataCapacity) {
+    if (mLocked) {
+        ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
+        return INVALID_OPERATION;
+    }
+    if (mBuffer != NULL &&
+            get_camera_metadata_entry_capacity(mBuffer) >= entryCapacity &&
+            get_camera_metadata_data_capacity(mBuffer) >= dataCapacity) {
+        return OK;
+    }
+
+    size_t entryCount = 0;
+    size_t dataCount = 0;
+    if (mBuffer != NULL) {
+        entryCount = get_camera_metadata_entry_count(mBuffer);
+        dataCount = get_camera_metadata_data_count(mBuffer);
+    }
+    camera_metadata_t *newBuffer = allocate_camera_metadata(
+            entryCapacity > entryCount ? entryCapacity : entryCount,
+            dataCapacity > dataCount ? dataCapacity : dataCount);
+    if (newBuffer == NULL) {
+        ALOGE("%s: Can't allocate metadata buffer", __FUNCTION__);
+        return NO_MEMORY;
+    }
+    if (mBuffer != NULL) {
+        append_camera_metadata(newBuffer, mBuffer);
+        free_camera_metadata(mBuffer);
+    }
+    mBuffer = newBuffer;
+    return OK;
+}
+
 status_t CameraMetadata::resizeIfNeeded(size_t extraEntries, size_t extraData) {
     if (mBuffer == NULL) {
         mBuffer = allocate_camera_metadata(extraEntries * 2, extraData * 2);
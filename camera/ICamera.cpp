@@ -55,6 +55,7 @@ enum {
     SET_VIDEO_BUFFER_MODE,
     SET_VIDEO_BUFFER_TARGET,
     RELEASE_RECORDING_FRAME_HANDLE,
+    RELEASE_RECORDING_FRAME_HANDLE_BATCH,
 };
 
 class BpCamera: public BpInterface<ICamera>
@@ -172,6 +173,24 @@ public:
         native_handle_delete(handle);
     }
 
+    void releaseRecordingFrameHandleBatch(const std::vector<native_handle_t*>& handles) {
+        ALOGV("releaseRecordingFrameHandleBatch");
+        Parcel data, reply;
+        data.writeInterfaceToken(ICamera::getInterfaceDescriptor());
+        data.writeUint32(handles.size());
+        for (size_t i = 0; i < handles.size(); i++) {
+            data.writeNativeHandle(handles[i]);
+        }
+
+        remote()->transact(RELEASE_RECORDING_FRAME_HANDLE_BATCH, data, &reply);
+
+        // Close the native handles because camera received dup copies.
+        for (size_t i = 0; i < handles.size(); i++) {
+            native_handle_close(handles[i]);
+            native_handle_delete(handles[i]);
+        }
+    }
+
     status_t setVideoBufferMode(int32_t videoBufferMode)
     {
         ALOGV("setVideoBufferMode: %d", videoBufferMode);
@@ -378,6 +397,29 @@ status_t BnCamera::onTransact(
             releaseRecordingFrameHandle(data.readNativeHandle());
             return NO_ERROR;
         } break;
+        case RELEASE_RECORDING_FRAME_HANDLE_BATCH: {
+            ALOGV("RELEASE_RECORDING_FRAME_HANDLE_BATCH");
+            CHECK_INTERFACE(ICamera, data, reply);
+            uint32_t count = 0;
+            status_t res = data.readUint32(&count);
+            if (res != OK) {
+                ALOGE("%s: Failed to read batch count: %d", __FUNCTION__, res);
+                return BAD_VALUE;
+            }
+            std::vector<native_handle_t*> handles;
+            for (uint32_t i = 0; i < count; i++) {
+                native_handle_t *handle = data.readNativeHandle();
+                if (handle == nullptr) {
+                    ALOGE("%s: Received a null native handle at %u of %u", __FUNCTION__,
+                            i, count);
+                    break;
+                }
+                handles.push_back(handle);
+            }
+            // releaseRecordingFrameHandleBatch will be responsble to close the native handles.
+            releaseRecordingFrameHandleBatch(handles);
+            return NO_ERROR;
+        } break;
         case SET_VIDEO_BUFFER_MODE: {
             ALOGV("SET_VIDEO_BUFFER_MODE");
             CHECK_INTERFACE(ICamera, data, reply);
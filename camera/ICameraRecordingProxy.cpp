@@ -32,6 +32,7 @@ enum {
     STOP_RECORDING,
     RELEASE_RECORDING_FRAME,
     RELEASE_RECORDING_FRAME_HANDLE,
+    RELEASE_RECORDING_FRAME_HANDLE_BATCH,
 };
 
 
@@ -82,6 +83,24 @@ public:
         native_handle_close(handle);
         native_handle_delete(handle);
     }
+
+    void releaseRecordingFrameHandleBatch(const std::vector<native_handle_t*>& handles) {
+        ALOGV("releaseRecordingFrameHandleBatch");
+        Parcel data, reply;
+        data.writeInterfaceToken(ICameraRecordingProxy::getInterfaceDescriptor());
+        data.writeUint32(handles.size());
+        for (size_t i = 0; i < handles.size(); i++) {
+            data.writeNativeHandle(handles[i]);
+        }
+
+        remote()->transact(RELEASE_RECORDING_FRAME_HANDLE_BATCH, data, &reply);
+
+        // Close the native handles because camera received dup copies.
+        for (size_t i = 0; i < handles.size(); i++) {
+            native_handle_close(handles[i]);
+            native_handle_delete(handles[i]);
+        }
+    }
 };
 
 IMPLEMENT_META_INTERFACE(CameraRecordingProxy, "android.hardware.ICameraRecordingProxy");
@@ -121,6 +140,30 @@ status_t BnCameraRecordingProxy::onTransact(
             releaseRecordingFrameHandle(data.readNativeHandle());
             return NO_ERROR;
         } break;
+        case RELEASE_RECORDING_FRAME_HANDLE_BATCH: {
+            ALOGV("RELEASE_RECORDING_FRAME_HANDLE_BATCH");
+            CHECK_INTERFACE(ICameraRecordingProxy, data, reply);
+            uint32_t count = 0;
+            status_t res = data.readUint32(&count);
+            if (res != OK) {
+                ALOGE("%s: Failed to read batch count: %d", __FUNCTION__, res);
+                return BAD_VALUE;
+            }
+            std::vector<native_handle_t*> handles;
+            for (uint32_t i = 0; i < count; i++) {
+                native_handle_t *handle = data.readNativeHandle();
+                if (handle == nullptr) {
+                    ALOGE("%s: Received a null native handle at %u of %u", __FUNCTION__,
+                            i, count);
+                    break;
+                }
+                handles.push_back(handle);
+            }
+
+            // releaseRecordingFrameHandleBatch will be responsble to close the native handles.
+            releaseRecordingFrameHandleBatch(handles);
+            return NO_ERROR;
+        } break;
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -35,6 +35,7 @@ LOCAL_C_INCLUDES := \
 	external/jpeg
 
 LOCAL_CFLAGS += -Wno-multichar
+LOCAL_CFLAGS_arm64 := -DNEON_INTRINSICS
 #LOCAL_CFLAGS += -UNDEBUG
 
 LOCAL_MODULE_TAGS := optional
@@ -21,6 +21,10 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
+#ifdef NEON_INTRINSICS
+#include <arm_neon.h>
+#endif
+
 #include "FrameOutput.h"
 
 using namespace android;
@@ -197,7 +201,21 @@ void FrameOutput::reduceRgbaToRgb(uint8_t* buf, unsigned int pixelCount) {
     // with 32-bit copies advancing at different rates (taking care at the
     // end to not go one byte over).
     const uint8_t* readPtr = buf;
-    for (unsigned int i = 0; i < pixelCount; i++) {
+    unsigned int i = 0;
+#ifdef NEON_INTRINSICS
+    // Each store ends before the bytes the next load reads.
+    for (; i + 16 <= pixelCount; i += 16) {
+        uint8x16x4_t rgba = vld4q_u8(readPtr);
+        uint8x16x3_t rgb;
+        rgb.val[0] = rgba.val[0];
+        rgb.val[1] = rgba.val[1];
+        rgb.val[2] = rgba.val[2];
+        vst3q_u8(buf, rgb);
+        readPtr += 16 * kGlBytesPerPixel;
+        buf += 16 * kOutBytesPerPixel;
+    }
+#endif
+    for (; i < pixelCount; i++) {
         *buf++ = *readPtr++;
         *buf++ = *readPtr++;
         *buf++ = *readPtr++;
@@ -187,6 +187,12 @@ status_t Overlay::setup_l() {
 
 void Overlay::release_l() {
     ALOGV("Overlay::release_l");
+    if (mNumFramesProcessed > 0) {
+        ALOGD("Overlay drew %zu frames (%zu dropped), avg %.3f ms, max %.3f ms",
+                mNumFramesProcessed, mTotalDroppedFrames,
+                mTotalProcessNsecs / 1000000.0 / mNumFramesProcessed,
+                mMaxProcessNsecs / 1000000.0);
+    }
     mOutputSurface.clear();
     mGlConsumer.clear();
     mProducer.clear();
@@ -198,6 +204,7 @@ void Overlay::release_l() {
 
 void Overlay::processFrame_l() {
     float texMatrix[16];
+    nsecs_t startNsecs = systemTime(CLOCK_MONOTONIC);
 
     mGlConsumer->updateTexImage();
     mGlConsumer->getTransformMatrix(texMatrix);
@@ -252,20 +259,31 @@ void Overlay::processFrame_l() {
 
     mEglWindow.presentationTime(monotonicNsec);
     mEglWindow.swapBuffers();
+
+    nsecs_t processNsecs = systemTime(CLOCK_MONOTONIC) - startNsecs;
+    mNumFramesProcessed++;
+    mTotalProcessNsecs += processNsecs;
+    if (processNsecs > mMaxProcessNsecs) {
+        mMaxProcessNsecs = processNsecs;
+    }
 }
 
 void Overlay::getTimeString_l(nsecs_t monotonicNsec, char* buf, size_t bufLen) {
     //const char* format = "%m-%d %T";    // matches log output
     const char* format = "%T";
-    struct tm tm;
 
-    // localtime/strftime is not the fastest way to do this, but a trivial
-    // benchmark suggests that the cost is negligible.
+    // localtime/strftime is not the fastest way to do this, so only redo
+    // it when the second changes.
     int64_t realTime = mStartRealtimeNsecs +
             (monotonicNsec - mStartMonotonicNsecs);
     time_t secs = (time_t) (realTime / 1000000000);
-    localtime_r(&secs, &tm);
-    strftime(buf, bufLen, format, &tm);
+    if (secs != mLastTimeSecs) {
+        struct tm tm;
+        localtime_r(&secs, &tm);
+        strftime(mTimeSecsBuf, sizeof(mTimeSecsBuf), format, &tm);
+        mLastTimeSecs = secs;
+    }
+    strlcpy(buf, mTimeSecsBuf, bufLen);
 
     int32_t msec = (int32_t) ((realTime % 1000000000) / 1000000);
     char tmpBuf[5];
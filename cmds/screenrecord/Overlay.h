@@ -45,7 +45,11 @@ public:
         mStartMonotonicNsecs(0),
         mStartRealtimeNsecs(0),
         mLastFrameNumber(-1),
-        mTotalDroppedFrames(0)
+        mTotalDroppedFrames(0),
+        mLastTimeSecs(-1),
+        mNumFramesProcessed(0),
+        mTotalProcessNsecs(0),
+        mMaxProcessNsecs(0)
         {}
 
     // Creates a thread that performs the overlay.  Pass in the surface that
@@ -151,6 +155,16 @@ private:
     nsecs_t mLastFrameNumber;
     size_t mTotalDroppedFrames;
 
+    // Wall-clock second last formatted by getTimeString_l(), and the
+    // result, so that strftime() only runs when the text changes.
+    time_t mLastTimeSecs;
+    char mTimeSecsBuf[64];
+
+    // Time spent drawing each frame, reported on release.
+    size_t mNumFramesProcessed;
+    nsecs_t mTotalProcessNsecs;
+    nsecs_t mMaxProcessNsecs;
+
     static const char* kPropertyNames[];
 };
 
@@ -64,6 +64,7 @@ static const uint32_t kMaxTimeLimitSec = 180;       // 3 minutes
 static const uint32_t kFallbackWidth = 1280;        // 720p
 static const uint32_t kFallbackHeight = 720;
 static const char* kMimeTypeAvc = "video/avc";
+static const nsecs_t kOrientationPollNsec = 100000000LL;  // 100ms
 
 // Command-line parameters.
 static bool gVerbose = false;           // chatty on stdout
@@ -162,6 +163,9 @@ static status_t prepareEncoder(float displayFps, sp<MediaCodec>* pCodec,
     format->setInt32("bitrate", gBitRate);
     format->setFloat("frame-rate", displayFps);
     format->setInt32("i-frame-interval", 10);
+    // Keep up with the display if this ends up on a software encoder;
+    // encoders without speed presets ignore this.
+    format->setInt32("encoder-speed", 4 /* fastest */);
 
     sp<ALooper> looper = new ALooper;
     looper->setName("screenrecord_looper");
@@ -313,18 +317,31 @@ static status_t prepareVirtualDisplay(const DisplayInfo& mainDpyInfo,
  * Exactly one of muxer or rawFp must be non-null.
  *
  * The muxer must *not* have been started before calling.
+ *
+ * Also keeps frame pacing statistics.  The virtual display only sends
+ * frames when the screen changes, so a gap between frames is not
+ * necessarily a dropped one; gaps longer than 1.5 frame periods at the
+ * display refresh rate are counted separately.
  */
 static status_t runEncoder(const sp<MediaCodec>& encoder,
         const sp<MediaMuxer>& muxer, FILE* rawFp, const sp<IBinder>& mainDpy,
-        const sp<IBinder>& virtualDpy, uint8_t orientation) {
+        const sp<IBinder>& virtualDpy, uint8_t orientation, float displayFps) {
     static int kTimeout = 250000;   // be responsive on signal
     status_t err;
     ssize_t trackIdx = -1;
     uint32_t debugNumFrames = 0;
     int64_t startWhenNsec = systemTime(CLOCK_MONOTONIC);
     int64_t endWhenNsec = startWhenNsec + seconds_to_nanoseconds(gTimeLimitSec);
+    int64_t lastOrientationCheckNsec = 0;
     DisplayInfo mainDpyInfo;
 
+    int64_t frameIntervalUsec = displayFps > 0 ? (int64_t) (1000000 / displayFps) : 16667;
+    int64_t lastPtsUsec = -1;
+    int64_t maxIntervalUsec = 0;
+    uint32_t numLongGaps = 0;
+    uint32_t numMissedPeriods = 0;
+    int64_t maxWriteNsec = 0;
+
     assert((rawFp == NULL && muxer != NULL) || (rawFp != NULL && muxer == NULL));
 
     Vector<sp<ABuffer> > buffers;
@@ -366,12 +383,16 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
                 ALOGV("Got data in buffer %zu, size=%zu, pts=%" PRId64,
                         bufIndex, size, ptsUsec);
 
-                { // scope
+                int64_t nowNsec = systemTime(CLOCK_MONOTONIC);
+                if (nowNsec - lastOrientationCheckNsec >= kOrientationPollNsec) {
                     ATRACE_NAME("orientation");
                     // Check orientation, update if it has changed.
                     //
                     // Polling for changes is inefficient and wrong, but the
                     // useful stuff is hard to get at without a Dalvik VM.
+                    // Limit it to a few times a second rather than every
+                    // frame, since it is a binder call into SurfaceFlinger.
+                    lastOrientationCheckNsec = nowNsec;
                     err = SurfaceComposerClient::getDisplayInfo(mainDpy,
                             &mainDpyInfo);
                     if (err != NO_ERROR) {
@@ -393,6 +414,23 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
                     ptsUsec = systemTime(SYSTEM_TIME_MONOTONIC) / 1000;
                 }
 
+                if ((flags & MediaCodec::BUFFER_FLAG_CODECCONFIG) == 0) {
+                    if (lastPtsUsec >= 0) {
+                        int64_t intervalUsec = ptsUsec - lastPtsUsec;
+                        if (intervalUsec > maxIntervalUsec) {
+                            maxIntervalUsec = intervalUsec;
+                        }
+                        if (intervalUsec > frameIntervalUsec * 3 / 2) {
+                            numLongGaps++;
+                            numMissedPeriods += (intervalUsec + frameIntervalUsec / 2)
+                                    / frameIntervalUsec - 1;
+                        }
+                    }
+                    lastPtsUsec = ptsUsec;
+                }
+
+                int64_t writeStartNsec = systemTime(CLOCK_MONOTONIC);
+
                 if (muxer == NULL) {
                     fwrite(buffers[bufIndex]->data(), 1, size, rawFp);
                     // Flush the data immediately in case we're streaming.
@@ -418,6 +456,10 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
                         return err;
                     }
                 }
+                int64_t writeNsec = systemTime(CLOCK_MONOTONIC) - writeStartNsec;
+                if (writeNsec > maxWriteNsec) {
+                    maxWriteNsec = writeNsec;
+                }
                 debugNumFrames++;
             }
             err = encoder->releaseOutputBuffer(bufIndex);
@@ -473,10 +515,18 @@ static status_t runEncoder(const sp<MediaCodec>& encoder,
     }
 
     ALOGV("Encoder stopping (req=%d)", gStopRequested);
+    ALOGD("Frame pacing: %u frames, max interval %.3f ms, %u gaps over 1.5"
+            " frames (%u frame periods), max write %.3f ms",
+            debugNumFrames, maxIntervalUsec / 1000.0, numLongGaps,
+            numMissedPeriods, maxWriteNsec / 1000000.0);
     if (gVerbose) {
         printf("Encoder stopping; recorded %u frames in %" PRId64 " seconds\n",
                 debugNumFrames, nanoseconds_to_seconds(
                         systemTime(CLOCK_MONOTONIC) - startWhenNsec));
+        printf("Longest gap between frames %.3f ms; %u gaps over 1.5 frames"
+                " at %.2ffps, %u frame periods without a frame\n",
+                maxIntervalUsec / 1000.0, numLongGaps, displayFps,
+                numMissedPeriods);
     }
     return NO_ERROR;
 }
@@ -701,7 +751,7 @@ static status_t recordScreen(const char* fileName) {
     } else {
         // Main encoder loop.
         err = runEncoder(encoder, muxer, rawFp, mainDpy, dpy,
-                mainDpyInfo.orientation);
+                mainDpyInfo.orientation, mainDpyInfo.fps);
         if (err != NO_ERROR) {
             fprintf(stderr, "Encoder failed (err=%d)\n", err);
             // fall through to cleanup
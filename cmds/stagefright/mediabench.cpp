@@ -0,0 +1,692 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "mediabench"
+#include <errno.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+#include <algorithm>
+
+#include <binder/ProcessState.h>
+#include <gui/Surface.h>
+#include <media/openmax/OMX_IVCommon.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaMuxer.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/NuMediaExtractor.h>
+#include <utils/KeyedVector.h>
+#include <utils/Vector.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-s <scenario>] [-a] [-c <codec>] [-w <warmup runs>]"
+                    " [-n <iterations>] [-b <bitrate>] [-o <output file>] [-j <json file>]"
+                    " <input file>\n", me);
+    fprintf(stderr, "       -h help\n");
+    fprintf(stderr, "       -s extract, decode, transcode or mux (default decode)\n");
+    fprintf(stderr, "       -a decode the audio track instead of the video track\n");
+    fprintf(stderr, "       -c decoder component to use, e.g. OMX.google.h264.decoder\n");
+    fprintf(stderr, "       -w untimed runs before the measured ones (default 1)\n");
+    fprintf(stderr, "       -n measured runs (default 5)\n");
+    fprintf(stderr, "       -b transcode bitrate in bits/s (default 4000000)\n");
+    fprintf(stderr, "       -o transcode and mux output file."
+                    " Default is /data/local/tmp/mediabench.mp4\n");
+    fprintf(stderr, "       -j write the JSON report to this file instead of stdout\n");
+
+    exit(1);
+}
+
+using namespace android;
+
+static const int64_t kTimeoutUs = 10000ll;
+
+struct Options {
+    const char *mPath;
+    const char *mScenario;
+    const char *mCodecName;
+    const char *mOutputPath;
+    bool mUseAudio;
+    int32_t mBitrate;
+};
+
+// What one run did and what it cost this process.  Codecs run in the media
+// server processes, so the CPU time and memory are the client's only.
+struct RunStats {
+    int64_t mWallUs;
+    int64_t mUserUs;
+    int64_t mSystemUs;
+    int64_t mMaxRssKb;
+    // -1 if the binder debugfs statistics are not readable
+    int64_t mBinderTransactions;
+    int64_t mUnits;  // samples read or written, or frames decoded or encoded
+    int64_t mBytes;
+};
+
+static int64_t timevalToUs(const struct timeval &tv) {
+    return tv.tv_sec * 1000000ll + tv.tv_usec;
+}
+
+static int64_t getBinderTransactions() {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/kernel/debug/binder/proc/%d", getpid());
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    int64_t count = -1;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        long long value;
+        if (sscanf(line, " BC_TRANSACTION: %lld", &value) == 1) {
+            count = value;
+            break;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+static void getUsage(RunStats *stats) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    stats->mWallUs = ALooper::GetNowUs();
+    stats->mUserUs = timevalToUs(usage.ru_utime);
+    stats->mSystemUs = timevalToUs(usage.ru_stime);
+    stats->mMaxRssKb = usage.ru_maxrss;
+    stats->mBinderTransactions = getBinderTransactions();
+}
+
+static size_t getSampleBufferSize(const sp<AMessage> &format) {
+    int32_t maxInputSize;
+    if (format->findInt32("max-input-size", &maxInputSize) && maxInputSize > 0) {
+        return maxInputSize;
+    }
+    int32_t width, height;
+    if (format->findInt32("width", &width) && format->findInt32("height", &height)) {
+        return width * height * 4;  // Assuming it is maximally 4BPP
+    }
+    return 1 * 1024 * 1024;
+}
+
+// Selects the first audio or video track and returns its index and format.
+static status_t selectTrack(
+        const sp<NuMediaExtractor> &extractor, bool audio,
+        size_t *trackIndex, sp<AMessage> *format) {
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        status_t err = extractor->getTrackFormat(i, format);
+        if (err != OK) {
+            return err;
+        }
+
+        AString mime;
+        CHECK((*format)->findString("mime", &mime));
+        if (!strncasecmp(mime.c_str(), audio ? "audio/" : "video/", 6)) {
+            *trackIndex = i;
+            return extractor->selectTrack(i);
+        }
+    }
+    return ERROR_UNSUPPORTED;
+}
+
+static sp<MediaCodec> createDecoder(
+        const sp<ALooper> &looper, const Options &options, const sp<AMessage> &format) {
+    if (options.mCodecName != NULL) {
+        return MediaCodec::CreateByComponentName(looper, options.mCodecName);
+    }
+    AString mime;
+    CHECK(format->findString("mime", &mime));
+    return MediaCodec::CreateByType(looper, mime.c_str(), false /* encoder */);
+}
+
+// Queues the next sample of the selected track, or EOS once there are none
+// left.  Does nothing if the codec has no input buffer available.
+static status_t feedCodec(
+        const sp<NuMediaExtractor> &extractor, const sp<MediaCodec> &codec,
+        bool *sawInputEOS, RunStats *stats) {
+    size_t index;
+    status_t err = codec->dequeueInputBuffer(&index, kTimeoutUs);
+    if (err == -EAGAIN) {
+        return OK;
+    } else if (err != OK) {
+        return err;
+    }
+
+    sp<ABuffer> buffer;
+    err = codec->getInputBuffer(index, &buffer);
+    if (err != OK) {
+        return err;
+    }
+
+    int64_t timeUs;
+    if (extractor->getSampleTime(&timeUs) != OK) {
+        *sawInputEOS = true;
+        return codec->queueInputBuffer(
+                index, 0 /* offset */, 0 /* size */, 0ll /* timeUs */,
+                MediaCodec::BUFFER_FLAG_EOS);
+    }
+
+    err = extractor->readSampleData(buffer);
+    if (err != OK) {
+        return err;
+    }
+    stats->mBytes += buffer->size();
+    extractor->advance();
+
+    return codec->queueInputBuffer(
+            index, 0 /* offset */, buffer->size(), timeUs, 0 /* flags */);
+}
+
+static void releaseCodec(sp<MediaCodec> *codec) {
+    if (*codec != NULL) {
+        (*codec)->release();
+        codec->clear();
+    }
+}
+
+static status_t runExtract(const Options &options, RunStats *stats) {
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    status_t err = extractor->setDataSource(NULL /* httpService */, options.mPath);
+    if (err != OK) {
+        return err;
+    }
+
+    size_t bufferSize = 0;
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<AMessage> format;
+        err = extractor->getTrackFormat(i, &format);
+        if (err != OK) {
+            return err;
+        }
+        bufferSize = std::max(bufferSize, getSampleBufferSize(format));
+        extractor->selectTrack(i);
+    }
+
+    sp<ABuffer> buffer = new ABuffer(bufferSize);
+    size_t trackIndex;
+    while (extractor->getSampleTrackIndex(&trackIndex) == OK) {
+        err = extractor->readSampleData(buffer);
+        if (err != OK) {
+            return err;
+        }
+        ++stats->mUnits;
+        stats->mBytes += buffer->size();
+        extractor->advance();
+    }
+    return OK;
+}
+
+static status_t runDecode(
+        const sp<ALooper> &looper, const Options &options, RunStats *stats) {
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    status_t err = extractor->setDataSource(NULL /* httpService */, options.mPath);
+    if (err != OK) {
+        return err;
+    }
+
+    size_t trackIndex;
+    sp<AMessage> format;
+    err = selectTrack(extractor, options.mUseAudio, &trackIndex, &format);
+    if (err != OK) {
+        return err;
+    }
+
+    sp<MediaCodec> codec = createDecoder(looper, options, format);
+    if (codec == NULL) {
+        return NAME_NOT_FOUND;
+    }
+    err = codec->configure(format, NULL /* surface */, NULL /* crypto */, 0 /* flags */);
+    if (err == OK) {
+        err = codec->start();
+    }
+
+    bool sawInputEOS = false;
+    bool sawOutputEOS = false;
+    while (err == OK && !sawOutputEOS) {
+        if (!sawInputEOS) {
+            err = feedCodec(extractor, codec, &sawInputEOS, stats);
+            if (err != OK) {
+                break;
+            }
+        }
+
+        size_t index, offset, size;
+        int64_t timeUs;
+        uint32_t flags;
+        err = codec->dequeueOutputBuffer(
+                &index, &offset, &size, &timeUs, &flags, kTimeoutUs);
+        if (err == OK) {
+            if (size > 0) {
+                ++stats->mUnits;
+            }
+            sawOutputEOS = (flags & MediaCodec::BUFFER_FLAG_EOS) != 0;
+            err = codec->releaseOutputBuffer(index);
+        } else if (err == -EAGAIN || err == INFO_FORMAT_CHANGED
+                || err == INFO_OUTPUT_BUFFERS_CHANGED) {
+            err = OK;
+        }
+    }
+
+    releaseCodec(&codec);
+    return err;
+}
+
+// Decodes the video track into the input surface of an AVC encoder.
+static status_t runTranscode(
+        const sp<ALooper> &looper, const Options &options, RunStats *stats) {
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    status_t err = extractor->setDataSource(NULL /* httpService */, options.mPath);
+    if (err != OK) {
+        return err;
+    }
+
+    size_t trackIndex;
+    sp<AMessage> format;
+    err = selectTrack(extractor, false /* audio */, &trackIndex, &format);
+    if (err != OK) {
+        return err;
+    }
+
+    int32_t width, height;
+    CHECK(format->findInt32("width", &width));
+    CHECK(format->findInt32("height", &height));
+
+    sp<AMessage> encoderFormat = new AMessage;
+    encoderFormat->setString("mime", MEDIA_MIMETYPE_VIDEO_AVC);
+    encoderFormat->setInt32("width", width);
+    encoderFormat->setInt32("height", height);
+    encoderFormat->setInt32("color-format", OMX_COLOR_FormatAndroidOpaque);
+    encoderFormat->setInt32("bitrate", options.mBitrate);
+    encoderFormat->setFloat("frame-rate", 30.0f);
+    encoderFormat->setInt32("i-frame-interval", 1);
+
+    sp<MediaCodec> encoder = MediaCodec::CreateByType(
+            looper, MEDIA_MIMETYPE_VIDEO_AVC, true /* encoder */);
+    if (encoder == NULL) {
+        return NAME_NOT_FOUND;
+    }
+    sp<MediaCodec> decoder;
+    sp<IGraphicBufferProducer> bufferProducer;
+    err = encoder->configure(
+            encoderFormat, NULL /* surface */, NULL /* crypto */,
+            MediaCodec::CONFIGURE_FLAG_ENCODE);
+    if (err == OK) {
+        err = encoder->createInputSurface(&bufferProducer);
+    }
+    if (err == OK) {
+        decoder = createDecoder(looper, options, format);
+        if (decoder == NULL) {
+            err = NAME_NOT_FOUND;
+        }
+    }
+    if (err == OK) {
+        err = decoder->configure(
+                format, new Surface(bufferProducer), NULL /* crypto */, 0 /* flags */);
+    }
+    if (err == OK) {
+        err = encoder->start();
+    }
+    if (err == OK) {
+        err = decoder->start();
+    }
+
+    bool sawInputEOS = false;
+    bool sawDecoderEOS = false;
+    bool sawEncoderEOS = false;
+    while (err == OK && !sawEncoderEOS) {
+        if (!sawInputEOS) {
+            err = feedCodec(extractor, decoder, &sawInputEOS, stats);
+            if (err != OK) {
+                break;
+            }
+        }
+
+        size_t index, offset, size;
+        int64_t timeUs;
+        uint32_t flags;
+        if (!sawDecoderEOS) {
+            err = decoder->dequeueOutputBuffer(
+                    &index, &offset, &size, &timeUs, &flags, kTimeoutUs);
+            if (err == OK) {
+                if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+                    sawDecoderEOS = true;
+                    err = decoder->releaseOutputBuffer(index);
+                    if (err == OK) {
+                        err = encoder->signalEndOfInputStream();
+                    }
+                } else {
+                    err = decoder->renderOutputBufferAndRelease(index, timeUs * 1000ll);
+                }
+            } else if (err == -EAGAIN || err == INFO_FORMAT_CHANGED
+                    || err == INFO_OUTPUT_BUFFERS_CHANGED) {
+                err = OK;
+            }
+            if (err != OK) {
+                break;
+            }
+        }
+
+        err = encoder->dequeueOutputBuffer(
+                &index, &offset, &size, &timeUs, &flags, kTimeoutUs);
+        if (err == OK) {
+            if (size > 0 && !(flags & MediaCodec::BUFFER_FLAG_CODECCONFIG)) {
+                ++stats->mUnits;
+            }
+            sawEncoderEOS = (flags & MediaCodec::BUFFER_FLAG_EOS) != 0;
+            err = encoder->releaseOutputBuffer(index);
+        } else if (err == -EAGAIN || err == INFO_FORMAT_CHANGED
+                || err == INFO_OUTPUT_BUFFERS_CHANGED) {
+            err = OK;
+        }
+    }
+
+    releaseCodec(&decoder);
+    releaseCodec(&encoder);
+    return err;
+}
+
+// Copies every sample of the first audio and video tracks into an MP4 file.
+static status_t runMux(const Options &options, RunStats *stats) {
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    status_t err = extractor->setDataSource(NULL /* httpService */, options.mPath);
+    if (err != OK) {
+        return err;
+    }
+
+    int fd = open(options.mOutputPath,
+            O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return -errno;
+    }
+    sp<MediaMuxer> muxer = new MediaMuxer(fd, MediaMuxer::OUTPUT_FORMAT_MPEG_4);
+    close(fd);
+
+    // Map the extractor's track index to the muxer's track index.
+    KeyedVector<size_t, ssize_t> trackIndexMap;
+    size_t bufferSize = 0;
+    bool haveAudio = false;
+    bool haveVideo = false;
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<AMessage> format;
+        err = extractor->getTrackFormat(i, &format);
+        if (err != OK) {
+            return err;
+        }
+
+        AString mime;
+        CHECK(format->findString("mime", &mime));
+        bool isAudio = !strncasecmp(mime.c_str(), "audio/", 6);
+        bool isVideo = !strncasecmp(mime.c_str(), "video/", 6);
+        if (isAudio && !haveAudio) {
+            haveAudio = true;
+        } else if (isVideo && !haveVideo) {
+            haveVideo = true;
+        } else {
+            continue;
+        }
+
+        ssize_t newTrackIndex = muxer->addTrack(format);
+        if (newTrackIndex < 0) {
+            fprintf(stderr, "track %zu (%s) unsupported by muxer\n", i, mime.c_str());
+            continue;
+        }
+        extractor->selectTrack(i);
+        trackIndexMap.add(i, newTrackIndex);
+        bufferSize = std::max(bufferSize, getSampleBufferSize(format));
+    }
+    if (trackIndexMap.isEmpty()) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    err = muxer->start();
+    sp<ABuffer> buffer = new ABuffer(bufferSize);
+    size_t trackIndex;
+    while (err == OK && extractor->getSampleTrackIndex(&trackIndex) == OK) {
+        err = extractor->readSampleData(buffer);
+        if (err != OK) {
+            break;
+        }
+
+        int64_t timeUs;
+        sp<MetaData> meta;
+        if (extractor->getSampleTime(&timeUs) != OK
+                || extractor->getSampleMeta(&meta) != OK) {
+            err = ERROR_MALFORMED;
+            break;
+        }
+        uint32_t sampleFlags = 0;
+        int32_t val;
+        if (meta->findInt32(kKeyIsSyncFrame, &val) && val != 0) {
+            sampleFlags |= MediaCodec::BUFFER_FLAG_SYNCFRAME;
+        }
+
+        err = muxer->writeSampleData(
+                buffer, trackIndexMap.valueFor(trackIndex), timeUs, sampleFlags);
+        ++stats->mUnits;
+        extractor->advance();
+    }
+
+    status_t stopErr = muxer->stop();
+    if (err == OK) {
+        err = stopErr;
+    }
+
+    struct stat st;
+    if (stat(options.mOutputPath, &st) == 0) {
+        stats->mBytes = st.st_size;
+    }
+    return err;
+}
+
+static status_t runScenario(
+        const sp<ALooper> &looper, const Options &options, RunStats *stats) {
+    RunStats start;
+    getUsage(&start);
+    stats->mUnits = 0;
+    stats->mBytes = 0;
+
+    status_t err;
+    if (!strcmp(options.mScenario, "extract")) {
+        err = runExtract(options, stats);
+    } else if (!strcmp(options.mScenario, "decode")) {
+        err = runDecode(looper, options, stats);
+    } else if (!strcmp(options.mScenario, "transcode")) {
+        err = runTranscode(looper, options, stats);
+    } else {
+        err = runMux(options, stats);
+    }
+
+    RunStats end;
+    getUsage(&end);
+    stats->mWallUs = end.mWallUs - start.mWallUs;
+    stats->mUserUs = end.mUserUs - start.mUserUs;
+    stats->mSystemUs = end.mSystemUs - start.mSystemUs;
+    stats->mMaxRssKb = end.mMaxRssKb;
+    stats->mBinderTransactions =
+        (start.mBinderTransactions < 0 || end.mBinderTransactions < 0)
+            ? -1 : end.mBinderTransactions - start.mBinderTransactions;
+    return err;
+}
+
+static void printJsonString(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', out);
+        }
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void printReport(FILE *out, const Options &options, const Vector<RunStats> &runs) {
+    fprintf(out, "{\n  \"scenario\": ");
+    printJsonString(out, options.mScenario);
+    fprintf(out, ",\n  \"input\": ");
+    printJsonString(out, options.mPath);
+    fprintf(out, ",\n  \"track\": \"%s\"", options.mUseAudio ? "audio" : "video");
+    if (options.mCodecName != NULL) {
+        fprintf(out, ",\n  \"codec\": ");
+        printJsonString(out, options.mCodecName);
+    }
+    fprintf(out, ",\n  \"runs\": [\n");
+
+    Vector<int64_t> wallUs;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const RunStats &run = runs[i];
+        fprintf(out, "    { \"wall_us\": %" PRId64 ", \"user_us\": %" PRId64
+                ", \"system_us\": %" PRId64 ", \"max_rss_kb\": %" PRId64
+                ", \"binder_transactions\": %" PRId64 ", \"units\": %" PRId64
+                ", \"bytes\": %" PRId64 " }%s\n",
+                run.mWallUs, run.mUserUs, run.mSystemUs, run.mMaxRssKb,
+                run.mBinderTransactions, run.mUnits, run.mBytes,
+                i + 1 < runs.size() ? "," : "");
+        wallUs.push_back(run.mWallUs);
+    }
+    fprintf(out, "  ]");
+
+    if (!runs.isEmpty()) {
+        std::sort(wallUs.editArray(), wallUs.editArray() + wallUs.size());
+        int64_t medianUs = wallUs[wallUs.size() / 2];
+        fprintf(out, ",\n  \"summary\": { \"min_wall_us\": %" PRId64
+                ", \"median_wall_us\": %" PRId64 ", \"max_wall_us\": %" PRId64
+                ", \"units_per_sec\": %.2f }",
+                wallUs[0], medianUs, wallUs[wallUs.size() - 1],
+                medianUs > 0 ? runs[0].mUnits * 1E6 / medianUs : 0.0);
+    }
+    fprintf(out, "\n}\n");
+}
+
+int main(int argc, char **argv) {
+    const char *me = argv[0];
+
+    Options options;
+    options.mScenario = "decode";
+    options.mCodecName = NULL;
+    options.mOutputPath = "/data/local/tmp/mediabench.mp4";
+    options.mUseAudio = false;
+    options.mBitrate = 4000000;
+    const char *jsonPath = NULL;
+    int warmupRuns = 1;
+    int iterations = 5;
+
+    int res;
+    while ((res = getopt(argc, argv, "has:c:w:n:b:o:j:")) >= 0) {
+        switch (res) {
+            case 'a':
+                options.mUseAudio = true;
+                break;
+            case 's':
+                options.mScenario = optarg;
+                break;
+            case 'c':
+                options.mCodecName = optarg;
+                break;
+            case 'w':
+                warmupRuns = atoi(optarg);
+                break;
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'b':
+                options.mBitrate = atoi(optarg);
+                break;
+            case 'o':
+                options.mOutputPath = optarg;
+                break;
+            case 'j':
+                jsonPath = optarg;
+                break;
+            case '?':
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 1 || warmupRuns < 0 || iterations <= 0 || options.mBitrate <= 0) {
+        usage(me);
+    }
+    options.mPath = argv[0];
+
+    if (strcmp(options.mScenario, "extract") && strcmp(options.mScenario, "decode")
+            && strcmp(options.mScenario, "transcode") && strcmp(options.mScenario, "mux")) {
+        usage(me);
+    }
+    if (options.mUseAudio && !strcmp(options.mScenario, "transcode")) {
+        fprintf(stderr, "only video can be transcoded\n");
+        return 1;
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    DataSource::RegisterDefaultSniffers();
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("mediabench");
+    looper->start();
+
+    Vector<RunStats> runs;
+    for (int i = 0; i < warmupRuns + iterations; ++i) {
+        RunStats stats;
+        status_t err = runScenario(looper, options, &stats);
+        if (err != OK) {
+            fprintf(stderr, "%s run %d failed: %d\n", options.mScenario, i, err);
+            looper->stop();
+            return 1;
+        }
+        if (i >= warmupRuns) {
+            runs.push_back(stats);
+        }
+    }
+
+    looper->stop();
+
+    FILE *out = stdout;
+    if (jsonPath != NULL) {
+        out = fopen(jsonPath, "w");
+        if (out == NULL) {
+            fprintf(stderr, "cannot open %s\n", jsonPath);
+            return 1;
+        }
+    }
+    printReport(out, options, runs);
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    return 0;
+}
@@ -54,6 +54,7 @@ static const float kSaturation = 0.0f;  // SaturationFilter param
 static void usage(const char *me) {
     fprintf(stderr, "usage: [flags] %s\n"
                     "\t[-b] use IntrinsicBlurFilter\n"
+                    "\t[-C] use a chain of SaturationFilter and IntrinsicBlurFilter\n"
                     "\t[-c] use argb to rgba conversion RSFilter\n"
                     "\t[-n] use night vision RSFilter\n"
                     "\t[-r] use saturation RSFilter\n"
@@ -153,6 +154,7 @@ enum FilterType {
     FILTERTYPE_RS_SATURATION,
     FILTERTYPE_RS_NIGHT_VISION,
     FILTERTYPE_RS_ARGB_TO_RGBA,
+    FILTERTYPE_CHAIN,
 };
 
 size_t inputFramesSinceFlush = 0;
@@ -414,6 +416,15 @@ static int decode(
             params->setFloat("saturation", kSaturation);
             break;
         }
+        case FILTERTYPE_CHAIN:
+        {
+            filterState->mCodec = MediaCodec::CreateByComponentName(
+                    looper, "android.filter.chain");
+            vidFormat->setString("filters", "saturation,intrinsicblur");
+            params->setFloat("saturation", kSaturation);
+            params->setFloat("blur-radius", kBlurRadius);
+            break;
+        }
         case FILTERTYPE_RS_SATURATION:
         {
             SaturationRSFilter *satFilter = new SaturationRSFilter;
@@ -669,13 +680,18 @@ int main(int argc, char **argv) {
     FilterType filterType = FILTERTYPE_ZERO;
 
     int res;
-    while ((res = getopt(argc, argv, "bcnrszTRSh")) >= 0) {
+    while ((res = getopt(argc, argv, "bCcnrszTRSh")) >= 0) {
         switch (res) {
             case 'b':
             {
                 filterType = FILTERTYPE_INTRINSIC_BLUR;
                 break;
             }
+            case 'C':
+            {
+                filterType = FILTERTYPE_CHAIN;
+                break;
+            }
             case 'c':
             {
                 filterType = FILTERTYPE_RS_ARGB_TO_RGBA;
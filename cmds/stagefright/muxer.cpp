@@ -37,13 +37,16 @@
 #include <media/stagefright/NuMediaExtractor.h>
 
 static void usage(const char *me) {
-    fprintf(stderr, "usage: %s [-a] [-v] [-s <trim start time>]"
+    fprintf(stderr, "usage: %s [-a] [-v] [-p] [-b] [-s <trim start time>]"
                     " [-e <trim end time>] [-o <output file>]"
                     " <input video file>\n", me);
     fprintf(stderr, "       -h help\n");
     fprintf(stderr, "       -a use audio\n");
     fprintf(stderr, "       -v use video\n");
     fprintf(stderr, "       -w mux into WebM container (default is MP4)\n");
+    fprintf(stderr, "       -p pass the samples straight from the extractor's tracks to the"
+                    " muxer\n");
+    fprintf(stderr, "       -b benchmark: report the throughput\n");
     fprintf(stderr, "       -s Time in milli-seconds when the trim should start\n");
     fprintf(stderr, "       -e Time in milli-seconds when the trim should end\n");
     fprintf(stderr, "       -o output file name. Default is /sdcard/muxeroutput.mp4\n");
@@ -62,6 +65,8 @@ static int muxing(
         int trimStartTimeMs,
         int trimEndTimeMs,
         int rotationDegrees,
+        bool usePassThrough,
+        bool benchmark,
         MediaMuxer::OutputFormat container = MediaMuxer::OUTPUT_FORMAT_MPEG_4) {
     sp<NuMediaExtractor> extractor = new NuMediaExtractor;
     if (extractor->setDataSource(NULL /* httpService */, path) != OK) {
@@ -137,12 +142,29 @@ static int muxing(
             }
         }
 
+        ssize_t newTrackIndex;
+        if (usePassThrough) {
+            sp<IMediaSource> source;
+            err = extractor->getTrackSource(i, &source);
+            CHECK_EQ(err, (status_t)OK);
+
+            newTrackIndex = enableTrim
+                    ? muxer->addSourceTrack(source, trimStartTimeUs, trimEndTimeUs)
+                    : muxer->addSourceTrack(source);
+            if (newTrackIndex < 0) {
+                fprintf(stderr, "%s track (%zu) unsupported by muxer\n",
+                        isAudio ? "audio" : "video",
+                        i);
+            }
+            continue;
+        }
+
         ALOGV("selecting track %zu", i);
 
         err = extractor->selectTrack(i);
         CHECK_EQ(err, (status_t)OK);
 
-        ssize_t newTrackIndex = muxer->addTrack(format);
+        newTrackIndex = muxer->addTrack(format);
         if (newTrackIndex < 0) {
             fprintf(stderr, "%s track (%zu) unsupported by muxer\n",
                     isAudio ? "audio" : "video",
@@ -162,7 +184,8 @@ static int muxing(
     muxer->setOrientationHint(rotationDegrees);
     muxer->start();
 
-    while (!sawInputEOS) {
+    // the writer reads the tracks itself, and stop() waits for it to be done
+    while (!sawInputEOS && !usePassThrough) {
         status_t err = extractor->getSampleTrackIndex(&trackIndex);
         if (err != OK) {
             ALOGV("saw input eos, err %d", err);
@@ -223,6 +246,13 @@ static int muxing(
     fprintf(stderr, "SUCCESS: muxer generate the video in %" PRId64 " ms\n",
             elapsedTimeUs / 1000);
 
+    struct stat st;
+    if (benchmark && stat(outputFileName, &st) == 0 && elapsedTimeUs > 0) {
+        fprintf(stderr, "%s: %" PRId64 " bytes at %.2f MB/s\n",
+                usePassThrough ? "pass-through" : "copy",
+                (int64_t)st.st_size, st.st_size / (elapsedTimeUs / 1E6) / 1E6);
+    }
+
     return 0;
 }
 
@@ -235,13 +265,15 @@ int main(int argc, char **argv) {
     int trimStartTimeMs = -1;
     int trimEndTimeMs = -1;
     int rotationDegrees = 0;
+    bool usePassThrough = false;
+    bool benchmark = false;
     // When trimStartTimeMs and trimEndTimeMs seems valid, we turn this switch
     // to true.
     bool enableTrim = false;
     MediaMuxer::OutputFormat container = MediaMuxer::OUTPUT_FORMAT_MPEG_4;
 
     int res;
-    while ((res = getopt(argc, argv, "h?avo:s:e:r:w")) >= 0) {
+    while ((res = getopt(argc, argv, "h?avo:s:e:r:wpb")) >= 0) {
         switch (res) {
             case 'a':
             {
@@ -261,6 +293,18 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'p':
+            {
+                usePassThrough = true;
+                break;
+            }
+
+            case 'b':
+            {
+                benchmark = true;
+                break;
+            }
+
             case 'o':
             {
                 outputFileName = optarg;
@@ -326,7 +370,8 @@ int main(int argc, char **argv) {
     looper->start();
 
     int result = muxing(argv[0], useAudio, useVideo, outputFileName,
-                        enableTrim, trimStartTimeMs, trimEndTimeMs, rotationDegrees, container);
+                        enableTrim, trimStartTimeMs, trimEndTimeMs, rotationDegrees,
+                        usePassThrough, benchmark, container);
 
     looper->stop();
 
@@ -25,6 +25,7 @@
 #include <media/DrmSessionClientInterface.h>
 #include <media/stagefright/ProcessInfo.h>
 #include <unistd.h>
+#include <string>
 #include <utils/String8.h>
 
 namespace android {
@@ -37,6 +38,10 @@ static String8 GetSessionIdString(const Vector<uint8_t> &sessionId) {
     return sessionIdStr;
 }
 
+static std::string GetSessionKey(const Vector<uint8_t> &sessionId) {
+    return std::string(reinterpret_cast<const char *>(sessionId.array()), sessionId.size());
+}
+
 bool isEqualSessionId(const Vector<uint8_t> &sessionId1, const Vector<uint8_t> &sessionId2) {
     if (sessionId1.size() != sessionId2.size()) {
         return false;
@@ -83,21 +88,41 @@ void DrmSessionManager::addSession(
     } else {
         mSessionMap.editValueAt(index).push_back(info);
     }
+    mSessionPids[GetSessionKey(sessionId)] = pid;
+}
+
+SessionInfo* DrmSessionManager::findSession_l(
+        const Vector<uint8_t> &sessionId, SessionInfos **infosOut, size_t *indexOut) {
+    auto it = mSessionPids.find(GetSessionKey(sessionId));
+    if (it == mSessionPids.end()) {
+        return NULL;
+    }
+    ssize_t index = mSessionMap.indexOfKey(it->second);
+    if (index < 0) {
+        return NULL;
+    }
+    SessionInfos& infos = mSessionMap.editValueAt(index);
+    for (size_t j = 0; j < infos.size(); ++j) {
+        if (isEqualSessionId(sessionId, infos[j].sessionId)) {
+            if (infosOut != NULL) {
+                *infosOut = &infos;
+            }
+            if (indexOut != NULL) {
+                *indexOut = j;
+            }
+            return &infos.editItemAt(j);
+        }
+    }
+    return NULL;
 }
 
 void DrmSessionManager::useSession(const Vector<uint8_t> &sessionId) {
     ALOGV("useSession(%s)", GetSessionIdString(sessionId).string());
 
     Mutex::Autolock lock(mLock);
-    for (size_t i = 0; i < mSessionMap.size(); ++i) {
-        SessionInfos& infos = mSessionMap.editValueAt(i);
-        for (size_t j = 0; j < infos.size(); ++j) {
-            SessionInfo& info = infos.editItemAt(j);
-            if (isEqualSessionId(sessionId, info.sessionId)) {
-                info.timeStamp = getTime_l();
-                return;
-            }
-        }
+    SessionInfo *info = findSession_l(sessionId, NULL, NULL);
+    if (info != NULL) {
+        info->timeStamp = getTime_l();
     }
 }
 
@@ -105,14 +130,11 @@ void DrmSessionManager::removeSession(const Vector<uint8_t> &sessionId) {
     ALOGV("removeSession(%s)", GetSessionIdString(sessionId).string());
 
     Mutex::Autolock lock(mLock);
-    for (size_t i = 0; i < mSessionMap.size(); ++i) {
-        SessionInfos& infos = mSessionMap.editValueAt(i);
-        for (size_t j = 0; j < infos.size(); ++j) {
-            if (isEqualSessionId(sessionId, infos[j].sessionId)) {
-                infos.removeAt(j);
-                return;
-            }
-        }
+    SessionInfos *infos;
+    size_t index;
+    if (findSession_l(sessionId, &infos, &index) != NULL) {
+        infos->removeAt(index);
+        mSessionPids.erase(GetSessionKey(sessionId));
     }
 }
 
@@ -126,6 +148,7 @@ void DrmSessionManager::removeDrm(sp<DrmSessionClientInterface> drm) {
         for (size_t j = 0; j < infos.size();) {
             if (infos[j].drm == drm) {
                 ALOGV("removed session (%s)", GetSessionIdString(infos[j].sessionId).string());
+                mSessionPids.erase(GetSessionKey(infos[j].sessionId));
                 j = infos.removeAt(j);
                 found = true;
             } else {
@@ -18,50 +18,83 @@
 #define LOG_TAG "ClearKeyCryptoPlugin"
 #include <utils/Log.h>
 
-#include <openssl/aes.h>
+#include <openssl/evp.h>
 
 #include "AesCtrDecryptor.h"
 
 namespace clearkeydrm {
 
-static const size_t kBlockBitCount = kBlockSize * 8;
-
 android::status_t AesCtrDecryptor::decrypt(const android::Vector<uint8_t>& key,
         const Iv iv, const uint8_t* source,
         uint8_t* destination,
         const SubSample* subSamples,
         size_t numSubSamples,
         size_t* bytesDecryptedOut) {
-    uint32_t blockOffset = 0;
-    uint8_t previousEncryptedCounter[kBlockSize];
-    memset(previousEncryptedCounter, 0, kBlockSize);
+    // The EVP interface uses the hardware AES instructions when the CPU has
+    // them, and keeps the keystream position across calls like
+    // AES_ctr128_encrypt does.
+    EVP_CIPHER_CTX ctx;
+    EVP_CIPHER_CTX_init(&ctx);
+    if (EVP_EncryptInit_ex(&ctx, EVP_aes_128_ctr(), NULL, key.array(), iv) != 1) {
+        ALOGE("Failed to initialize AES-CTR context");
+        EVP_CIPHER_CTX_cleanup(&ctx);
+        return android::UNKNOWN_ERROR;
+    }
 
+    // Consecutive subsamples are contiguous in the buffer, so adjacent clear
+    // runs are copied with a single memcpy and adjacent encrypted runs are
+    // decrypted with a single call.
     size_t offset = 0;
-    AES_KEY opensslKey;
-    AES_set_encrypt_key(key.array(), kBlockBitCount, &opensslKey);
-    Iv opensslIv;
-    memcpy(opensslIv, iv, sizeof(opensslIv));
-
-    for (size_t i = 0; i < numSubSamples; ++i) {
-        const SubSample& subSample = subSamples[i];
+    size_t clearBytes = 0;
+    size_t encryptedBytes = 0;
+    android::status_t res = android::OK;
+    for (size_t i = 0; i <= numSubSamples && res == android::OK; ++i) {
+        bool last = (i == numSubSamples);
+        size_t numClear = last ? 0 : subSamples[i].mNumBytesOfClearData;
+        size_t numEncrypted = last ? 0 : subSamples[i].mNumBytesOfEncryptedData;
 
-        if (subSample.mNumBytesOfClearData > 0) {
-            memcpy(destination + offset, source + offset,
-                    subSample.mNumBytesOfClearData);
-            offset += subSample.mNumBytesOfClearData;
+        if ((numClear > 0 || last) && encryptedBytes > 0) {
+            res = decryptRun(&ctx, source + offset, destination + offset, encryptedBytes);
+            offset += encryptedBytes;
+            encryptedBytes = 0;
         }
+        clearBytes += numClear;
 
-        if (subSample.mNumBytesOfEncryptedData > 0) {
-            AES_ctr128_encrypt(source + offset, destination + offset,
-                    subSample.mNumBytesOfEncryptedData, &opensslKey,
-                    opensslIv, previousEncryptedCounter,
-                    &blockOffset);
-            offset += subSample.mNumBytesOfEncryptedData;
+        if ((numEncrypted > 0 || last) && clearBytes > 0) {
+            memcpy(destination + offset, source + offset, clearBytes);
+            offset += clearBytes;
+            clearBytes = 0;
         }
+        encryptedBytes += numEncrypted;
+    }
+
+    EVP_CIPHER_CTX_cleanup(&ctx);
+    if (res != android::OK) {
+        return res;
     }
 
     *bytesDecryptedOut = offset;
     return android::OK;
 }
 
+android::status_t AesCtrDecryptor::decryptRun(EVP_CIPHER_CTX* ctx, const uint8_t* source,
+        uint8_t* destination, size_t length) {
+    // EVP_EncryptUpdate takes an int length
+    static const size_t kMaxRunLength = 1 << 30;
+    while (length > 0) {
+        size_t chunk = length < kMaxRunLength ? length : kMaxRunLength;
+        int outLength = 0;
+        if (EVP_EncryptUpdate(ctx, destination, &outLength, source,
+                static_cast<int>(chunk)) != 1 ||
+                outLength != static_cast<int>(chunk)) {
+            ALOGE("AES-CTR decryption failed");
+            return android::UNKNOWN_ERROR;
+        }
+        source += chunk;
+        destination += chunk;
+        length -= chunk;
+    }
+    return android::OK;
+}
+
 } // namespace clearkeydrm
@@ -18,6 +18,7 @@
 #define CLEARKEY_AES_CTR_DECRYPTOR_H_
 
 #include <media/stagefright/foundation/ABase.h>
+#include <openssl/evp.h>
 #include <Utils.h>
 #include <utils/Errors.h>
 #include <utils/Vector.h>
@@ -36,6 +37,9 @@ public:
             size_t* bytesDecryptedOut);
 
 private:
+    android::status_t decryptRun(EVP_CIPHER_CTX* ctx, const uint8_t* source,
+            uint8_t* destination, size_t length);
+
     DISALLOW_EVIL_CONSTRUCTORS(AesCtrDecryptor);
 };
 
@@ -53,13 +53,12 @@ ssize_t CryptoPlugin::decrypt(bool secure, const KeyId keyId, const Iv iv,
                         "data.");
                 return android::ERROR_DRM_DECRYPT;
             }
+            offset += subSample.mNumBytesOfClearData;
+        }
 
-            if (subSample.mNumBytesOfClearData != 0) {
-                memcpy(reinterpret_cast<uint8_t*>(dstPtr) + offset,
-                       reinterpret_cast<const uint8_t*>(srcPtr) + offset,
-                       subSample.mNumBytesOfClearData);
-                offset += subSample.mNumBytesOfClearData;
-            }
+        // The clear subsamples are contiguous, copy them all at once
+        if (offset != 0) {
+            memcpy(dstPtr, srcPtr, offset);
         }
         return static_cast<ssize_t>(offset);
     } else if (mode == kMode_AES_CTR) {
@@ -143,6 +143,14 @@ class CameraMetadata: public Parcelable {
     status_t update(const camera_metadata_ro_entry &entry);
 
 
+    /**
+     * Make sure the buffer can hold at least entryCapacity entries and
+     * dataCapacity bytes of data without reallocating, keeping the current
+     * contents. Useful before building up a request or result with many
+     * update() calls.
+     */
+    status_t reserve(size_t entryCapacity, size_t dataCapacity);
+
     template<typename T>
     status_t update(uint32_t tag, Vector<T> data) {
         return update(tag, data.array(), data.size());
@@ -21,6 +21,8 @@
 #include <cutils/native_handle.h>
 #include <utils/RefBase.h>
 
+#include <vector>
+
 namespace android {
 
 class ICameraRecordingProxyListener;
@@ -85,6 +87,8 @@ public:
     virtual void            stopRecording() = 0;
     virtual void            releaseRecordingFrame(const sp<IMemory>& mem) = 0;
     virtual void            releaseRecordingFrameHandle(native_handle_t *handle) = 0;
+    virtual void            releaseRecordingFrameHandleBatch(
+                                    const std::vector<native_handle_t*>& handles) = 0;
 };
 
 // ----------------------------------------------------------------------------
@@ -24,6 +24,8 @@
 #include <binder/Status.h>
 #include <utils/String8.h>
 
+#include <vector>
+
 namespace android {
 
 class IGraphicBufferProducer;
@@ -101,6 +103,11 @@ public:
     // ICameraClient::recordingFrameHandleCallbackTimestamp.
     virtual void            releaseRecordingFrameHandle(native_handle_t *handle) = 0;
 
+    // Release a batch of recording frame handles received via
+    // ICameraClient::recordingFrameHandleCallbackTimestamp, in a single call.
+    virtual void            releaseRecordingFrameHandleBatch(
+                                    const std::vector<native_handle_t*>& handles) = 0;
+
     // auto focus
     virtual status_t        autoFocus() = 0;
 
@@ -18,6 +18,7 @@
 #define __CC_HELPER_H__
 
 #include <stdint.h>
+#include <atomic>
 #include <common_time/ICommonClock.h>
 #include <utils/threads.h>
 
@@ -53,18 +54,46 @@ class CCHelper {
     status_t getLocalTime(int64_t* localTime);
     status_t getLocalFreq(uint64_t* freq);
 
+    // Like getCommonTime(), but for callers which need common time at a high
+    // rate.  The time is extrapolated with CLOCK_MONOTONIC from a getCommonTime()
+    // round trip, instead of making one for every call; a new one is made
+    // every kSamplePeriodNs.  Round trips much slower than the fastest recent ones are
+    // rejected, since the service could have read the time anywhere within
+    // them, and the rate of common time against CLOCK_MONOTONIC is estimated
+    // from accepted round trips about a second apart.  Small backward steps
+    // when switching to a new round trip are hidden.
+    status_t getEstimatedCommonTime(int64_t* commonTime);
+
   private:
     class CommonClockListener : public BnCommonClockListener {
       public:
         void onTimelineChanged(uint64_t timelineID);
     };
 
+    struct TimeSample {
+        int64_t mono_ns;  // middle of the round trip
+        int64_t common_time;
+    };
+
     static bool verifyClock_l();
+    static status_t sampleCommonTime_l();
 
     static Mutex lock_;
     static sp<ICommonClock> common_clock_;
     static sp<ICommonClockListener> common_clock_listener_;
     static uint32_t ref_count_;
+
+    // state of getEstimatedCommonTime(); ns_rate_ is in common ticks per ns
+    static const int64_t kSamplePeriodNs;
+    static std::atomic<bool> timeline_changed_;
+    static bool sample_valid_;
+    static int64_t next_sample_ns_;
+    static TimeSample sample_;
+    static TimeSample rate_anchor_;
+    static int64_t min_rtt_ns_;
+    static double nominal_ns_rate_;
+    static double ns_rate_;
+    static int64_t last_estimate_;
 };
 
 
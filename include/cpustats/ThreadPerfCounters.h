@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _THREAD_PERF_COUNTERS_H
+#define _THREAD_PERF_COUNTERS_H
+
+#include <stdint.h>
+
+namespace android {
+
+// Hardware performance counters of the current thread, read through perf_event_open(2):
+// CPU cycles, instructions retired, and L1 data cache and last level cache read misses.
+// The counters are opened as one group, so that they count over the same interval, and
+// all of them are read by a single read(2) per sample.
+// The kernel may refuse some or all of them, for instance because of
+// /proc/sys/kernel/perf_event_paranoid or a PMU that lacks the event; use isAvailable().
+// On hosts other than Linux, no counter is ever available.
+// Like ThreadCpuUsage, the methods of this class may only be called by the thread
+// which called open().
+
+class ThreadPerfCounters
+{
+
+public:
+    enum Counter {
+        CYCLES,
+        INSTRUCTIONS,
+        L1D_MISSES,
+        LLC_MISSES,
+        kNumCounters
+    };
+
+    ThreadPerfCounters();
+    ~ThreadPerfCounters();
+
+    // Open the counters for the calling thread, and start counting.
+    // Returns true if at least the CYCLES counter is available.
+    bool open();
+
+    // Stop counting and release the file descriptors
+    void close();
+
+    bool isAvailable(Counter counter) const { return mIndex[counter] >= 0; }
+
+    // Set deltas[] to the counts since the previous sample, or since open() for the first one.
+    // The deltas of the counters that are not available are set to 0.
+    // The deltas are scaled if the kernel had to multiplex the counters on the PMU.
+    // Returns true if the deltas are valid.
+    bool sample(uint64_t deltas[kNumCounters]);
+
+    // Return the name of a counter, for dumps
+    static const char *counterToString(Counter counter);
+
+private:
+    int         mFds[kNumCounters];     // file descriptors in open order, -1 if none
+    int         mIndex[kNumCounters];   // position of each counter in the group read, or -1
+    int         mOpened;                // number of counters in the group
+    uint64_t    mPrevious[kNumCounters]; // previous scaled counts, indexed by Counter
+    bool        mPreviousValid;
+};
+
+}   // namespace android
+
+#endif // _THREAD_PERF_COUNTERS_H
@@ -95,7 +95,10 @@ public:
      * info:    Pointer to optional parameter according to event type:
      *          - EVENT_MORE_DATA: pointer to AudioRecord::Buffer struct. The callback must not read
      *                             more bytes than indicated by 'size' field and update 'size' if
-     *                             fewer bytes are consumed.
+     *                             fewer bytes are consumed.  The buffer points directly into
+     *                             the shared record buffer and is only valid during the
+     *                             callback; no copy is made.  If fewer bytes are consumed,
+     *                             the callback is called again with the rest of the buffer.
      *          - EVENT_OVERRUN: unused.
      *          - EVENT_MARKER: pointer to const uint32_t containing the marker position in frames.
      *          - EVENT_NEW_POS: pointer to const uint32_t containing the new position in frames.
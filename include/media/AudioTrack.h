@@ -674,12 +674,15 @@ private:
      * if the client were to release the first frames and then call obtainBuffer() again.
      * This value is only a prediction, and needs to be confirmed.
      * It will be set to zero for an error return.
-     * FIXME We could pass an array of Buffers instead of only one Buffer to obtainBuffer(),
-     * in case the requested amount of frames is in two or more non-contiguous regions.
+     * If wrapped is non-NULL, it is an output parameter for the frames that follow audioBuffer
+     * at the start of the buffer, in case the requested amount of frames is in two
+     * non-contiguous regions.  Its frameCount is zero if there is no second region, and
+     * otherwise both regions must be released together by one releaseBuffer() of their total size.
      * FIXME requested and elapsed are both relative times.  Consider changing to absolute time.
      */
             status_t    obtainBuffer(Buffer* audioBuffer, const struct timespec *requested,
-                                     struct timespec *elapsed = NULL, size_t *nonContig = NULL);
+                                     struct timespec *elapsed = NULL, size_t *nonContig = NULL,
+                                     Buffer* wrapped = NULL);
 public:
 
     /* Public API for TRANSFER_OBTAIN mode.
@@ -928,6 +931,9 @@ protected:
 
             void     restartIfDisabled();
 
+            // body of releaseBuffer(), called with mLock held
+            void     releaseBuffer_l(size_t stepCount);
+
     // Next 4 fields may be changed if IAudioTrack is re-created, but always != 0
     sp<IAudioTrack>         mAudioTrack;
     sp<IMemory>             mCblkMemory;
@@ -24,6 +24,9 @@
 #include <utils/threads.h>
 #include <utils/Vector.h>
 
+#include <string>
+#include <unordered_map>
+
 namespace android {
 
 class DrmSessionManagerTest;
@@ -60,6 +63,9 @@ private:
     friend class DrmSessionManagerTest;
 
     int64_t getTime_l();
+    // Returns the session, and its SessionInfos and index in it if not NULL
+    SessionInfo* findSession_l(
+            const Vector<uint8_t> &sessionId, SessionInfos **infos, size_t *index);
     bool getLowestPriority_l(int* lowestPriorityPid, int* lowestPriority);
     bool getLeastUsedSession_l(
             int pid, sp<DrmSessionClientInterface>* drm, Vector<uint8_t>* sessionId);
@@ -67,6 +73,8 @@ private:
     sp<ProcessInfoInterface> mProcessInfo;
     mutable Mutex mLock;
     PidSessionInfosMap mSessionMap;
+    // pid owning each session, by session id bytes
+    std::unordered_map<std::string, int> mSessionPids;
     int64_t mTime;
 
     DISALLOW_EVIL_CONSTRUCTORS(DrmSessionManager);
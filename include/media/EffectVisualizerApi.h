@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_EFFECT_VISUALIZER_API_H
+#define ANDROID_EFFECT_VISUALIZER_API_H
+
+#include <audio_effects/effect_visualizer.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+// Extensions of the visualizer control API of <audio_effects/effect_visualizer.h> implemented
+// by the AOSP visualizer.  Engines that do not implement them return -EINVAL.
+
+#define VISUALIZER_FFT_SIZE_MAX 4096
+#define VISUALIZER_FFT_SIZE_MIN VISUALIZER_CAPTURE_SIZE_MIN
+
+// window applied to the capture before the FFT
+enum visualizer_fft_window_e {
+    VISUALIZER_FFT_WINDOW_RECTANGULAR,  // no window, as the FFT computed by the client
+    VISUALIZER_FFT_WINDOW_HANN,
+    VISUALIZER_FFT_WINDOW_HAMMING,
+    VISUALIZER_FFT_WINDOW_BLACKMAN,
+    VISUALIZER_FFT_WINDOW_CNT,
+};
+
+//-----------------------------------------------------------------------------
+// command VISUALIZER_CMD_FFT: returns the FFT of the latest capture, in the 8 bit format of
+// Visualizer::getFft(): DC and Nyquist real parts first, then the real and imaginary parts of
+// the bins 1 to size / 2 - 1.  The FFT is computed at most once per buffer processed by the
+// engine for a given size and window, and shared by all the clients of the engine.
+//-----------------------------------------------------------------------------
+// command format:
+//  size: 2 * sizeof(uint32_t)
+//  data: FFT size, power of 2 in [VISUALIZER_FFT_SIZE_MIN, VISUALIZER_FFT_SIZE_MAX], followed
+//        by the window, one of visualizer_fft_window_e
+//-----------------------------------------------------------------------------
+// reply format:
+//  size: FFT size
+//  data: FFT bytes
+//-----------------------------------------------------------------------------
+#define VISUALIZER_CMD_FFT (VISUALIZER_CMD_MEASURE + 1)
+
+#if __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ANDROID_EFFECT_VISUALIZER_API_H
@@ -15,6 +15,7 @@
  */
 
 #include <binder/IInterface.h>
+#include <utils/threads.h>
 #include <media/stagefright/foundation/ABase.h>
 #include <media/hardware/CryptoAPI.h>
 
@@ -26,6 +27,7 @@ namespace android {
 
 struct AString;
 class IMemory;
+class IMemoryHeap;
 
 struct ICrypto : public IInterface {
     DECLARE_META_INTERFACE(Crypto);
@@ -63,6 +65,11 @@ struct ICrypto : public IInterface {
             void *dstPtr,
             AString *errorDetailMsg) = 0;
 
+    // Shares the heap the sharedBuffers passed to decrypt() are allocated
+    // from, once, so that decrypt() only needs to send their offset in it
+    // instead of an IMemory each call. A NULL heap stops sharing it.
+    virtual void setHeap(const sp<IMemoryHeap> &heap) = 0;
+
 private:
     DISALLOW_EVIL_CONSTRUCTORS(ICrypto);
 };
@@ -71,9 +78,15 @@ struct BnCrypto : public BnInterface<ICrypto> {
     virtual status_t onTransact(
             uint32_t code, const Parcel &data, Parcel *reply,
             uint32_t flags = 0);
+
+    virtual void setHeap(const sp<IMemoryHeap> &heap);
+
 private:
     void readVector(const Parcel &data, Vector<uint8_t> &vector) const;
     void writeVector(Parcel *reply, Vector<uint8_t> const &vector) const;
+
+    Mutex mHeapLock;
+    sp<IMemoryHeap> mHeap;
 };
 
 }  // namespace android
@@ -20,6 +20,7 @@
 #include <binder/IInterface.h>
 #include <binder/IMemory.h>
 #include <binder/Parcel.h>
+#include <media/nbaio/NBLog.h>
 
 namespace android {
 
@@ -31,6 +32,12 @@ public:
     virtual void    registerWriter(const sp<IMemory>& shared, size_t size, const char *name) = 0;
     virtual void    unregisterWriter(const sp<IMemory>& shared) = 0;
 
+    // Summary of the NBLog::Writer::logHistogram() values called name, logged by the writer
+    // registered as writerName, either recent or since the writer was registered.
+    // Returns NAME_NOT_FOUND if there are none, PERMISSION_DENIED without the DUMP permission.
+    virtual status_t getHistogramSummary(const char *writerName, const char *name, bool recent,
+                                         NBLog::Histogram::Summary *summary) = 0;
+
 };
 
 class BnMediaLogService: public BnInterface<IMediaLogService>
@@ -185,6 +185,8 @@ public:
     static const size_t kTransferSharedAsSharedThreshold = 4 * 1024;  // if >= shared, else inline
     static const size_t kTransferInlineAsSharedThreshold = 64 * 1024; // if >= shared, else inline
     static const size_t kInlineMaxTransfer = 256 * 1024; // Binder size limited to BINDER_VM_SIZE.
+    static const size_t kBinderRingBytes = 2 * 1024 * 1024; // shared memory of the transfer ring
+    static const size_t kBinderRingMaxBuffers = 32;
 
 protected:
     virtual ~BnMediaSource();
@@ -194,6 +196,16 @@ private:
 
     std::unique_ptr<MediaBufferGroup> mGroup;
 
+    // Buffers of one shared memory region that samples from the source are
+    // copied into, unless the source hands out shared memory that can be
+    // used as is; the client releasing a buffer returns it to the ring.
+    std::unique_ptr<MediaBufferGroup> mRing;
+    size_t mRingBufferSize;
+
+    // Returns a free buffer of the ring for length bytes, creating the ring
+    // on first use.
+    status_t acquireRingBuffer(MediaBuffer **out, size_t length);
+
     // To prevent marshalling IMemory with each read transaction, we cache the IMemory pointer
     // into a map.
     //
@@ -179,6 +179,33 @@ public:
             OMX_U32 range_offset, OMX_U32 range_length,
             OMX_U32 flags, OMX_TICKS timestamp, int fenceFd = -1) = 0;
 
+    struct FillBufferInfo {
+        buffer_id mBuffer;
+        int mFenceFd;
+    };
+    // Calls fillBuffer() on each of the |count| buffers in order, in a single transaction
+    // for a remote IOMX, stopping at the first one that fails. Sets |numFilled| to the number
+    // of buffers filled. Takes ownership of all the fences even if this call fails.
+    virtual status_t fillBuffers(
+            node_id node, const FillBufferInfo *buffers, size_t count, size_t *numFilled);
+
+    struct EmptyBufferInfo {
+        buffer_id mBuffer;
+        OMX_U32 mRangeOffset;
+        OMX_U32 mRangeLength;
+        OMX_U32 mFlags;
+        OMX_TICKS mTimestamp;
+        int mFenceFd;
+    };
+    // Same as fillBuffers() for emptyBuffer().
+    virtual status_t emptyBuffers(
+            node_id node, const EmptyBufferInfo *buffers, size_t count, size_t *numEmptied);
+
+    enum {
+        // most buffers passed to a single fillBuffers() or emptyBuffers() transaction
+        kMaxBatchBuffers = 64
+    };
+
     virtual status_t getExtensionIndex(
             node_id node,
             const char *parameter_name,
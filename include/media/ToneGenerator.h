@@ -275,6 +275,8 @@ private:
 
     uint32_t mSamplingRate;  // AudioFlinger Sampling rate
     sp<AudioTrack> mpAudioTrack;  // Pointer to audio track used for playback
+    sp<AudioTrack> mpStaticTrack;  // Static audio track playing a short tone, if any
+    int mStaticToneMaxMs;  // Longest tone played with mpStaticTrack (media.tonegen.static-max-ms)
     Mutex mLock;  // Mutex to control concurent access to ToneGenerator object from audio callback and application API
     Mutex mCbkCondLock; // Mutex associated to mWaitCbkCond
     Condition mWaitCbkCond; // condition enabling interface to wait for audio callback completion after a change is requested
@@ -284,6 +286,8 @@ private:
     struct timespec mStartTime; // tone start time: needed to guaranty actual tone duration
 
     bool initAudioTrack();
+    bool startStaticTone_l();
+    void stopStaticTone_l();
     static void audioCallback(int event, void* user, void *info);
     bool prepareWave();
     unsigned int numWaves(unsigned int segmentIdx);
@@ -18,6 +18,7 @@
 #define ANDROID_MEDIA_VISUALIZER_H
 
 #include <media/AudioEffect.h>
+#include <media/EffectVisualizerApi.h>
 #include <audio_effects/effect_visualizer.h>
 #include <utils/Thread.h>
 
@@ -79,6 +80,8 @@ public:
     static uint32_t getMaxCaptureSize() { return VISUALIZER_CAPTURE_SIZE_MAX; }
     // minimum capture size in samples
     static uint32_t getMinCaptureSize() { return VISUALIZER_CAPTURE_SIZE_MIN; }
+    // maximum FFT size in samples, see getFft(uint8_t *, uint32_t)
+    static uint32_t getMaxFftSize() { return VISUALIZER_FFT_SIZE_MAX; }
     // maximum capture rate in millihertz
     static uint32_t getMaxCaptureRate() { return CAPTURE_RATE_MAX; }
 
@@ -132,6 +135,16 @@ public:
     // are returned
     status_t getFft(uint8_t *fft);
 
+    // same as getFft(uint8_t *) for an FFT of size samples, a power of two in the range
+    // [VISUALIZER_FFT_SIZE_MIN, VISUALIZER_FFT_SIZE_MAX] independent of the capture size.
+    // The FFT is computed by the effect engine, once for all the visualizers of the session.
+    status_t getFft(uint8_t *fft, uint32_t size);
+
+    // set the window applied before the FFT, one of visualizer_fft_window_e.
+    // The default is VISUALIZER_FFT_WINDOW_RECTANGULAR.
+    status_t setFftWindow(uint32_t window);
+    uint32_t getFftWindow() { return mFftWindow; }
+
 protected:
     // from IEffectClient
     virtual void controlStatusChanged(bool controlGranted);
@@ -166,6 +179,7 @@ private:
     uint32_t mSampleRate;
     uint32_t mScalingMode;
     uint32_t mMeasurementMode;
+    uint32_t mFftWindow;
     capture_cbk_t mCaptureCallBack;
     void *mCaptureCbkUser;
     sp<CaptureThread> mCaptureThread;
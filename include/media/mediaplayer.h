@@ -166,7 +166,14 @@ enum media_parameter_keys {
     KEY_PARAMETER_PLAYBACK_RATE_PERMILLE = 1300,                // set only
 
     // Set a Parcel containing the value of a parcelled Java AudioAttribute instance
-    KEY_PARAMETER_AUDIO_ATTRIBUTES = 1400                       // set only
+    KEY_PARAMETER_AUDIO_ATTRIBUTES = 1400,                      // set only
+
+    // Return a Parcel containing the playback metrics of the current session as int64_t
+    // values, -1 where unknown: prepare duration (us), time from start to the first
+    // rendered frame (us), rebuffer count, total rebuffer duration (us), video frames
+    // rendered, video frames dropped, average video decode time (us) and the last
+    // estimated source bandwidth (kbps).
+    KEY_PARAMETER_PLAYBACK_METRICS = 1500                       // get only
 };
 
 // Keep INVOKE_ID_* in sync with MediaPlayer.java.
@@ -22,6 +22,7 @@
 #include <utils/List.h>
 #include <utils/Errors.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 #include <pthread.h>
 
 struct dirent;
@@ -78,6 +79,14 @@ struct MediaScanner {
     virtual MediaScanResult processDirectory(
             const char *path, MediaScannerClient &client);
 
+    // Scans the files of "paths" as processFile() would, reporting them to
+    // "client" in order, and stores the result of each one in "results".
+    // Stops at the first file which returns MEDIA_SCAN_RESULT_ERROR, and
+    // returns that error. The files after it are not reported.
+    virtual MediaScanResult processFiles(
+            const Vector<String8> &paths, MediaScannerClient &client,
+            Vector<MediaScanResult> *results);
+
     void setLocale(const char *locale);
 
     virtual MediaAlbumArt *extractAlbumArt(int fd) = 0;
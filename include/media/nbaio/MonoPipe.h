@@ -79,7 +79,24 @@ public:
             // Return NO_ERROR if there is a timestamp available
             status_t getTimestamp(ExtendedTimestamp &timestamp);
 
+            // Rate matching for a writer and reader in different clock domains.
+            // When enabled, MonoPipeReader::read() feeds the fill level just after each read
+            // into a PI controller, whose integral term tracks the drift between the clocks.
+            // getRateCorrection() is the factor by which the writer should scale the rate it
+            // produces frames at, for instance with a resampler, to hold that fill level at
+            // getAvgFrames().  It is 1.0 when disabled,
+            // and otherwise stays within 1.0 +/- kMaxRateCorrection.
+            // setRateControl() must be called before the first read(),
+            // getRateCorrection() may be called by any thread.
+            void    setRateControl(bool enabled) { mRateControl = enabled; }
+            double  getRateCorrection() const;
+
+            static const double kMaxRateCorrection;
+
 private:
+            // called by MonoPipeReader::read() when rate control is enabled
+            void    updateRateCorrection(size_t filled);
+
     const size_t    mReqFrames;     // as requested in constructor, unrounded
     const size_t    mMaxFrames;     // always a power of 2
     void * const    mBuffer;
@@ -97,6 +114,14 @@ private:
 
     bool            mIsShutdown;    // whether shutdown(true) was called, no barriers are needed
 
+    bool            mRateControl;   // whether setRateControl(true) was called
+    // reader state of the rate controller
+    int64_t         mRateLastNs;    // CLOCK_MONOTONIC of the previous update, 0 if none
+    double          mRateIntegral;  // integral of the fill error, in seconds * seconds
+    // written by reader with android_atomic_release_store,
+    // read by any thread with android_atomic_acquire_load
+    volatile int32_t mRateCorrectionPpb;    // (getRateCorrection() - 1.0) * 1e9
+
     ExtendedTimestampSingleStateQueue::Shared      mTimestampShared;
     ExtendedTimestampSingleStateQueue::Mutator     mTimestampMutator;
     ExtendedTimestampSingleStateQueue::Observer    mTimestampObserver;
@@ -21,12 +21,12 @@
 
 #include <binder/IMemory.h>
 #include <utils/Mutex.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
 #include <audio_utils/roundup.h>
 
 namespace android {
 
-class String8;
-
 class NBLog {
 
 public:
@@ -40,6 +40,14 @@ enum Event {
     EVENT_RESERVED,
     EVENT_STRING,               // ASCII string, not NUL-terminated
     EVENT_TIMESTAMP,            // clock_gettime(CLOCK_MONOTONIC)
+    // A logFormat() entry is EVENT_START_FMT, EVENT_TIMESTAMP, one event per argument
+    // (EVENT_INTEGER, EVENT_DOUBLE or EVENT_STRING), then EVENT_END_FMT.
+    // It is only formatted by the Reader.
+    EVENT_START_FMT,            // printf-like format string, not NUL-terminated
+    EVENT_INTEGER,              // int64_t, any integer or pointer argument
+    EVENT_DOUBLE,               // double, any floating point argument
+    EVENT_END_FMT,              // end of the arguments, no data
+    EVENT_HISTOGRAM,            // name length, name, then int32_t values; see logHistogram()
 };
 
 // ---------------------------------------------------------------------------
@@ -83,6 +91,49 @@ public:
 
 // ---------------------------------------------------------------------------
 
+// Log-linear histogram of non-negative int32_t values.  Each power of 2 is divided into
+// kSubBuckets buckets, so a percentile is within 1/(2 * kSubBuckets) of the exact value.
+// Not thread-safe.
+class Histogram {
+public:
+    Histogram() { reset(); }
+
+    void        reset();
+    void        add(int32_t value);             // negative values are counted as 0
+    void        add(const Histogram& other);
+
+    uint64_t    count() const { return mCount; }
+
+    // Returns an estimate of the value below which there are percent % of the values,
+    // or 0 if the histogram is empty.
+    int32_t     percentile(double percent) const;
+
+    struct Summary {
+        uint64_t    mCount;
+        int32_t     mMin;
+        int32_t     mP50;
+        int32_t     mP99;
+        int32_t     mP999;
+        int32_t     mMax;
+    };
+    Summary     summarize() const;
+
+private:
+    static const int    kSubBits = 3;
+    static const size_t kSubBuckets = 1 << kSubBits;
+    static const size_t kBuckets = (32 - kSubBits) << kSubBits;
+
+    static size_t   bucketOf(int32_t value);
+    static int32_t  lowerBound(size_t bucket);  // smallest value of a bucket
+
+    uint32_t    mBuckets[kBuckets];
+    uint64_t    mCount;
+    int32_t     mMin;
+    int32_t     mMax;
+};
+
+// ---------------------------------------------------------------------------
+
 // FIXME Timeline was intended to wrap Writer and Reader, but isn't actually used yet.
 // For now it is just a namespace for sharedSize().
 class Timeline : public RefBase {
@@ -128,6 +179,21 @@ public:
     virtual void    logTimestamp();
     virtual void    logTimestamp(const struct timespec& ts);
 
+    // Like logTimestamp() followed by logf(), but the arguments are stored in binary and
+    // formatted by the Reader, so that the cost for the writer is only a few copies.
+    // A conversion with '*' width or precision, or "%n", ends the arguments that are logged.
+    virtual void    logFormat(const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
+    virtual void    logVFormat(const char *fmt, va_list ap);
+
+    // Log count values of the measurement called name, for instance a cycle time in us.
+    // They are not formatted by dump(), but aggregated by Reader::updateHistograms().
+    // The name is truncated to kMaxHistogramName characters, and at most
+    // kMaxHistogramValues values are logged, so callers should batch about that many.
+    virtual void    logHistogram(const char *name, const int32_t *values, size_t count);
+
+    static const size_t kMaxHistogramName = 15;
+    static const size_t kMaxHistogramValues = (255 - 1 - kMaxHistogramName) / sizeof(int32_t);
+
     virtual bool    isEnabled() const;
 
     // return value for all of these is the previous isEnabled()
@@ -161,6 +227,9 @@ public:
     virtual void    logvf(const char *fmt, va_list ap);
     virtual void    logTimestamp();
     virtual void    logTimestamp(const struct timespec& ts);
+    virtual void    logFormat(const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
+    virtual void    logVFormat(const char *fmt, va_list ap);
+    virtual void    logHistogram(const char *name, const int32_t *values, size_t count);
 
     virtual bool    isEnabled() const;
     virtual bool    setEnabled(bool enabled);
@@ -184,6 +253,26 @@ public:
     void    dump(int fd, size_t indent = 0);
     bool    isIMemory(const sp<IMemory>& iMemory) const;
 
+    // A formatted line, with the most recent timestamp logged before or within it
+    // (0 if there was none), so that the logs of several writers can be merged.
+    struct Line {
+        int64_t mTimestampNs;
+        String8 mText;
+    };
+
+    // Like dump(), but append the lines to lines instead of writing them out
+    void    dump(Vector<Line>& lines);
+
+    // Histograms of the logHistogram() values.  They are read independently of dump(),
+    // and must be updated more often than the writer fills the shared memory.
+    // These methods may be called from any thread.
+    void    updateHistograms();
+    // Start a new window for the recent histograms, which cover the current and previous window
+    void    rotateHistograms();
+    void    dumpHistograms(int fd, size_t indent = 0);
+    // Returns false if there is no histogram called name
+    bool    getHistogramSummary(const char *name, bool recent, Histogram::Summary *summary);
+
 private:
     const size_t    mSize;      // circular buffer size in bytes, must be a power of 2
     const Shared* const mShared; // raw pointer to shared memory
@@ -191,10 +280,34 @@ private:
     int32_t     mFront;         // index of oldest acknowledged Entry
     int     mFd;                // file descriptor
     int     mIndent;            // indentation level
+    Vector<Line> *mLines;       // if non-NULL, where dumpLine() appends instead of writing
+    int64_t mLineTimestampNs;   // latest timestamp seen by dump()
 
     void    dumpLine(const String8& timestamp, String8& body);
 
+    // Format the logFormat() entry starting at copy[i] into body, and its timestamp into
+    // timestamp.  Returns the index one past the entry.
+    size_t  formatEntry(const uint8_t *copy, size_t i, size_t avail,
+                        String8& timestamp, String8& body);
+
     static const size_t kSquashTimestamp = 5; // squash this many or more adjacent timestamps
+
+    // Copy the entries from front up to the current rear into a new[] array.
+    // On return front is the new rear, avail the number of bytes copied, and lost the number
+    // of bytes that were overwritten before they could be copied.
+    uint8_t *copyEntries(int32_t& front, size_t& avail, size_t& lost) const;
+
+    struct NamedHistogram {
+        String8     mName;
+        Histogram   mTotal;         // since the writer was registered
+        Histogram   mWindow[2];     // current and previous window
+    };
+
+    Mutex           mHistogramLock; // protects the fields below
+    int32_t         mHistogramFront; // like mFront, but for updateHistograms()
+    size_t          mHistogramLost; // bytes overwritten before updateHistograms() saw them
+    size_t          mHistogramWindow; // index of the current window in NamedHistogram::mWindow
+    Vector<NamedHistogram> mHistograms;
 };
 
 };  // class NBLog
@@ -21,11 +21,21 @@
 
 namespace android {
 
-// PipeReader is safe for only a single thread
+// PipeReader is safe for only a single thread, except where noted
 class PipeReader : public NBAIO_Source {
 
 public:
 
+    // Called on the reader thread, from the read or obtain() that detected the overrun,
+    // with the number of frames discarded.
+    typedef void (*overrun_callback_t)(void *cookie, size_t framesLost);
+
+    // A contiguous part of the pipe buffer, see obtain()
+    struct Span {
+        const void *mData;
+        size_t      mFrames;
+    };
+
     // Construct a PipeReader and associate it with a Pipe
     // FIXME make this constructor a factory method of Pipe.
     PipeReader(Pipe& pipe);
@@ -49,15 +59,39 @@ public:
 
     // NBAIO_Source end
 
+    // Read without copying.  Returns the number of frames available at the read position,
+    // at most count, or a negative status as read() does.  The frames are described by
+    // spans[0] followed by spans[1], which is empty unless the data wraps around the end
+    // of the pipe buffer.  They stay in the pipe until release().
+    ssize_t obtain(Span spans[2], size_t count);
+
+    // Consume count frames of those returned by the last obtain().  Returns count, or OVERRUN
+    // if the writer may have overwritten them since obtain(); they are consumed in either case.
+    // As with read(), an overrun is detected on a best effort basis.
+    ssize_t release(size_t count);
+
+    // Set the callback for overruns, or NULL for none.
+    void    setOverrunCallback(overrun_callback_t callback, void *cookie);
+
+    // Any thread.  The number of frames this reader had left to read in the pipe
+    // as of its latest read or release(), which is a measure of how far it lags the writer.
+    size_t  fillLevel() const;
+
 #if 0   // until necessary
     Pipe& pipe() const { return mPipe; }
 #endif
 
 private:
+    // Advance mFront by count frames, and publish it for fillLevel()
+    void        advance(size_t count);
+
     Pipe&       mPipe;
     int32_t     mFront;         // follows behind mPipe.mRear
+    volatile int32_t mPublishedFront;   // written by android_atomic_release_store
     int64_t     mFramesOverrun;
     int64_t     mOverruns;
+    overrun_callback_t mOverrunCallback;
+    void       *mOverrunCookie;
 };
 
 }   // namespace android
@@ -23,6 +23,7 @@
 
 namespace android {
 
+struct AsyncFileWriter;
 struct MediaSource;
 class MetaData;
 
@@ -44,6 +45,10 @@ private:
     enum {
         kAdtsHeaderLength = 7,     // # of bytes for the adts header
         kSamplesPerFrame  = 1024,  // # of samples in a frame
+
+        // output buffering, see AsyncFileWriter::CreateFromProperties()
+        kDefaultIOBufferSizeKB = 32,
+        kDefaultNumIOBuffers = 2,
     };
 
     int   mFd;
@@ -61,12 +66,14 @@ private:
     int32_t mSampleRate;
     int32_t mAACProfile;
     int32_t mFrameDurationUs;
+    AsyncFileWriter *mFileWriter;
 
     static void *ThreadWrapper(void *);
     status_t threadFunc();
     bool exceedsFileSizeLimit();
     bool exceedsFileDurationLimit();
     status_t writeAdtsHeader(uint32_t frameLength);
+    status_t writeFile(const void *data, size_t size);
     status_t reset();
 
     DISALLOW_EVIL_CONSTRUCTORS(AACWriter);
@@ -291,6 +291,12 @@ private:
     bool mLegacyAdaptiveExperiment;
     int32_t mMetadataBuffersToSubmit;
     size_t mNumUndequeuedBuffers;
+
+    // see updateExtraOutputBuffers()
+    bool mAdaptiveOutputBufferCount;
+    OMX_U32 mExtraOutputBuffers;
+    int32_t mNumOutputDequeues;
+    int32_t mNumOutputDequeueStalls;
     sp<DataConverter> mConverter[2];
 
     int64_t mRepeatFrameDelayUs;
@@ -323,6 +329,9 @@ private:
     status_t allocateOutputMetadataBuffers();
     status_t submitOutputMetadataBuffer();
     void signalSubmitOutputMetadataBufferIfEOS_workaround();
+    void updateExtraOutputBuffers();
+    status_t setLowLatency(bool lowLatency);
+    status_t setEncoderSpeed(int32_t speed);
     status_t allocateOutputBuffersFromNativeWindow();
     status_t cancelBufferToNativeWindow(BufferInfo *info);
     status_t freeOutputBuffersNotOwnedByComponent();
@@ -26,6 +26,7 @@
 
 namespace android {
 
+struct AsyncFileWriter;
 class MetaData;
 
 struct AMRWriter : public MediaWriter {
@@ -43,6 +44,12 @@ protected:
     virtual ~AMRWriter();
 
 private:
+    enum {
+        // output buffering, see AsyncFileWriter::CreateFromProperties()
+        kDefaultIOBufferSizeKB = 32,
+        kDefaultNumIOBuffers = 2,
+    };
+
     int   mFd;
     status_t mInitCheck;
     sp<IMediaSource> mSource;
@@ -54,11 +61,13 @@ private:
     pthread_t mThread;
     int64_t mEstimatedSizeBytes;
     int64_t mEstimatedDurationUs;
+    AsyncFileWriter *mFileWriter;
 
     static void *ThreadWrapper(void *);
     status_t threadFunc();
     bool exceedsFileSizeLimit();
     bool exceedsFileDurationLimit();
+    status_t writeFile(const void *data, size_t size);
     status_t reset();
 
     AMRWriter(const AMRWriter &);
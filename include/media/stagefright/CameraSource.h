@@ -213,6 +213,8 @@ protected:
     virtual status_t startCameraRecording();
     virtual void releaseRecordingFrame(const sp<IMemory>& frame);
     virtual void releaseRecordingFrameHandle(native_handle_t* handle);
+    // Releases recording frame handles in a single call to the camera.
+    virtual void releaseRecordingFrameHandleBatch(const std::vector<native_handle_t*>& handles);
 
     // Returns true if need to skip the current frame.
     // Called from dataCallbackTimestamp.
@@ -245,6 +247,9 @@ private:
     int64_t mFirstFrameTimeUs;
     int32_t mNumFramesDropped;
     int32_t mNumGlitches;
+    // frames that found no free entry in mMemoryBases, and the longest wait
+    int32_t mNumMemoryBaseWaits;
+    int64_t mMaxMemoryBaseWaitUs;
     int64_t mGlitchDurationThresholdUs;
     bool mCollectStats;
 
@@ -272,6 +277,8 @@ private:
     sp<BufferQueueListener> mBufferQueueListener;
 
     void releaseQueuedFrames();
+    // Waits for an entry in mMemoryBases; returns false if none became available in time.
+    bool waitForMemoryBaseLocked();
     void releaseOneRecordingFrame(const sp<IMemory>& frame);
     void createVideoBufferMemoryHeap(size_t size, uint32_t bufferCount);
 
@@ -33,6 +33,15 @@ struct ColorConverter {
 
     bool isValid() const;
 
+    // YUV to RGB conversion matrix, MATRIX_BT601 unless set otherwise.
+    enum Matrix {
+        MATRIX_BT601,
+        MATRIX_BT601_FULL_RANGE,
+        MATRIX_BT709,
+    };
+
+    void setMatrix(Matrix matrix);
+
     status_t convert(
             const void *srcBits,
             size_t srcWidth, size_t srcHeight,
@@ -43,6 +52,18 @@ struct ColorConverter {
             size_t dstCropLeft, size_t dstCropTop,
             size_t dstCropRight, size_t dstCropBottom);
 
+    // Converts the source crop into a whole dstWidth x dstHeight bitmap,
+    // sampling the nearest source pixels when the sizes differ, so that a
+    // downscaled frame is produced without converting the full one first.
+    // The rows are split into up to numThreads bands converted in parallel.
+    status_t convertScaled(
+            const void *srcBits,
+            size_t srcWidth, size_t srcHeight,
+            size_t srcCropLeft, size_t srcCropTop,
+            size_t srcCropRight, size_t srcCropBottom,
+            void *dstBits, size_t dstWidth, size_t dstHeight,
+            size_t numThreads = 1);
+
 private:
     struct BitmapParams {
         BitmapParams(
@@ -59,27 +80,48 @@ private:
         size_t mCropLeft, mCropTop, mCropRight, mCropBottom;
     };
 
-    OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
-    uint8_t *mClip;
+    // where the samples of one source row are, see convertRow()
+    struct SourceRow {
+        const uint8_t *mY;
+        const uint8_t *mU;
+        const uint8_t *mV;
+        size_t mYStep;
+        size_t mUVStep;
+    };
 
-    uint8_t *initClip();
+    // rows [mStartRow, mEndRow) of a convertScaled() destination
+    struct Band {
+        const ColorConverter *mConverter;
+        const BitmapParams *mSrc;
+        const size_t *mSrcX;  // source column of each destination column
+        uint8_t *mDst;
+        size_t mDstWidth, mDstHeight;
+        size_t mStartRow, mEndRow;
+    };
 
-    status_t convertCbYCrY(
-            const BitmapParams &src, const BitmapParams &dst);
+    OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
+    Matrix mMatrix;
 
-    status_t convertYUV420Planar(
-            const BitmapParams &src, const BitmapParams &dst);
+    size_t dstBytesPerPixel() const;
 
-    status_t convertYUV420PlanarUseLibYUV(
-            const BitmapParams &src, const BitmapParams &dst);
+    void getSourceRow(const BitmapParams &src, size_t row, SourceRow *out) const;
 
-    status_t convertQCOMYUV420SemiPlanar(
-            const BitmapParams &src, const BitmapParams &dst);
+    // Converts one row of width pixels.  Luma samples are yStep bytes
+    // apart and each pair of pixels shares the chroma samples at the next
+    // uvStep bytes of u and v.
+    void convertRow(
+            const uint8_t *y, size_t yStep,
+            const uint8_t *u, const uint8_t *v, size_t uvStep,
+            size_t width, uint8_t *dst) const;
 
-    status_t convertYUV420SemiPlanar(
-            const BitmapParams &src, const BitmapParams &dst);
+    // Converts the source pixels srcX[0 .. width - 1] of a row.
+    void convertRowSampled(
+            const SourceRow &row, const size_t *srcX, size_t width, uint8_t *dst) const;
 
-    status_t convertTIYUV420PackedSemiPlanar(
+    void convertBand(const Band &band) const;
+    static void *BandThread(void *band);
+
+    status_t convertYUV420PlanarUseLibYUV(
             const BitmapParams &src, const BitmapParams &dst);
 
     ColorConverter(const ColorConverter &);
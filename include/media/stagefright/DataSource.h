@@ -32,6 +32,7 @@ namespace android {
 
 struct AMessage;
 struct AString;
+class  FileMap;
 class  IDataSource;
 struct IMediaHTTPService;
 class String8;
@@ -100,6 +101,12 @@ public:
         return ERROR_UNSUPPORTED;
     }
 
+    // Maps |size| bytes at |offset| read-only in memory, for sources backed by a local file.
+    // Returns NULL if the range cannot be mapped. The caller deletes the returned map.
+    virtual FileMap *mapRange(off64_t /* offset */, size_t /* size */) {
+        return NULL;
+    }
+
     ////////////////////////////////////////////////////////////////////////////
 
     bool sniff(String8 *mimeType, float *confidence, sp<AMessage> *meta);
@@ -39,6 +39,8 @@ public:
 
     virtual status_t getSize(off64_t *size);
 
+    virtual FileMap *mapRange(off64_t offset, size_t size);
+
     virtual sp<DecryptHandle> DrmInitialization(const char *mime);
 
     virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client);
@@ -64,6 +66,38 @@ private:
     ssize_t mDrmBufSize;
     unsigned char *mDrmBuf;
 
+    // Reads smaller than a block are served from the last few blocks read,
+    // aligned on kBlockSize, to save the system calls of the many small
+    // reads of the extractors.
+    enum {
+        kBlockSize = 65536,
+        kNumBlocks = 4,
+    };
+    struct Block {
+        off64_t mOffset;
+        ssize_t mSize;
+        uint64_t mLastUse;
+        uint8_t *mData;
+    };
+    Block mBlocks[kNumBlocks];
+    uint64_t mUseCount;
+
+    // Access pattern, to switch the readahead of the file between
+    // sequential and random with posix_fadvise().
+    off64_t mLastReadEnd;
+    int32_t mNumSequentialReads;
+    int mAdvice;
+
+    // Mapping of the whole file, used for all reads if enabled.
+    bool mMapChecked;
+    FileMap *mMap;
+
+    void initBlocks();
+    ssize_t readBlock_l(off64_t blockOffset, Block **block);
+    ssize_t readCached_l(off64_t offset, void *data, size_t size);
+    void updateAdvice_l(off64_t offset, size_t size);
+    void mapFile_l();
+
     ssize_t readAtDRM(off64_t offset, void *data, size_t size);
 
     FileSource(const FileSource &);
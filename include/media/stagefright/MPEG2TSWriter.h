@@ -51,6 +51,13 @@ private:
         kWhatSourceNotify = 'noti'
     };
 
+    enum {
+        kTSPacketSize = 188,
+
+        // room for the packets of a large video access unit
+        kInitialOutputBufferSize = 1024 * kTSPacketSize,
+    };
+
     struct SourceInfo;
 
     FILE *mFile;
@@ -72,12 +79,21 @@ private:
     int mPMTContinuityCounter;
     uint32_t mCrcTable[256];
 
+    // PAT and PMT with the CRCs, without the continuity counters
+    uint8_t mPATPacket[kTSPacketSize];
+    uint8_t mPMTPacket[kTSPacketSize];
+
+    // packets waiting to be written out
+    sp<ABuffer> mOutputBuffer;
+
     void init();
 
     void writeTS();
-    void writeProgramAssociationTable();
-    void writeProgramMap();
+    void initProgramAssociationTable();
+    void initProgramMap();
     void writeAccessUnit(int32_t sourceIndex, const sp<ABuffer> &buffer);
+    uint8_t *appendPackets(size_t numPackets);
+    void flushPackets();
     void initCrcTable();
     uint32_t crc32(const uint8_t *start, size_t length);
 
@@ -28,6 +28,7 @@
 namespace android {
 
 class AMessage;
+struct AsyncFileWriter;
 class MediaBuffer;
 class MetaData;
 
@@ -101,6 +102,18 @@ private:
     bool mAreGeoTagsAvailable;
     int32_t mStartTimeOffsetMs;
 
+    // NULL if the file is written directly
+    AsyncFileWriter *mFileWriter;
+
+    // Fragmented file: the moov box, without samples, is written once all
+    // the tracks started, then each track writes a moof/mdat pair about
+    // every mFragmentDurationUs; an mfra box ends the file.  0 if the file
+    // is not fragmented.
+    int64_t mFragmentDurationUs;
+    bool mFragmentedMoovWritten;
+    uint32_t mFragmentSequenceNumber;
+    off64_t mMehdOffset;
+
     Mutex mLock;
 
     List<Track *> mTracks;
@@ -185,6 +198,20 @@ private:
     void lock();
     void unlock();
 
+    bool isFragmented() const { return mFragmentDurationUs > 0; }
+    bool tracksReadyForFragments_l();
+    void writeFragmentedMoovBox_l();
+    void writeMvexBox();
+    void finishFragmentedFile(int64_t durationUs);
+    void onFragmentWritten_l();
+
+    // All the writes to and the seeks in mFd go through these once the file
+    // writer is started.
+    void startFileWriter();
+    void stopFileWriter();
+    void writeFile(const void *data, size_t size);
+    void seekFile(off64_t offset);
+
     // Acquire lock before calling these methods
     off64_t addSample_l(MediaBuffer *buffer);
     off64_t addLengthPrefixedSample_l(MediaBuffer *buffer);
@@ -21,10 +21,37 @@
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MetaData.h>
+#include <utils/List.h>
 #include <utils/threads.h>
 
 namespace android {
 
+// Bytes of the buffers queued to a set of MediaAdapters and not returned by
+// their readers yet.
+struct MediaBufferBudget : public RefBase {
+    MediaBufferBudget(size_t maxBytes);
+
+    void setMaxBytes(size_t maxBytes);
+
+    // A buffer always fits when nothing is held, whatever its size.
+    bool tryAcquire(size_t size);
+
+    // Waits until size fits.
+    void acquire(size_t size);
+
+    void release(size_t size);
+
+private:
+    Mutex mLock;
+    Condition mReleasedCond;
+    size_t mMaxBytes;
+    size_t mAcquiredBytes;
+
+    bool fits_l(size_t size) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(MediaBufferBudget);
+};
+
 // Convert the MediaMuxer's push model into MPEG4Writer's pull model.
 // Used only by the MediaMuxer for now.
 struct MediaAdapter : public MediaSource, public MediaBufferObserver {
@@ -56,6 +83,13 @@ public:
     // deep copy, such that after pushBuffer return, the buffer can be re-used.
     status_t pushBuffer(MediaBuffer *buffer);
 
+    // queueBuffer() returns right away; the adapter takes over the buffer,
+    // whose reference count must be 0, and read() returns the queued buffers
+    // in order.  The buffer's size must have been acquired from the budget
+    // set, if any; it is released once the reader returns the buffer.
+    status_t queueBuffer(MediaBuffer *buffer);
+    void setBudget(const sp<MediaBufferBudget> &budget);
+
 private:
     Mutex mAdapterLock;
     // Make sure the read() wait for the incoming buffer.
@@ -64,10 +98,18 @@ private:
     Condition mBufferReturnedCond;
 
     MediaBuffer *mCurrentMediaBuffer;
+    // The pushed buffer pushBuffer() waits for.
+    MediaBuffer *mPushedMediaBuffer;
+
+    List<MediaBuffer *> mQueuedBuffers;
+    Condition mQueueDrainedCond;
+    sp<MediaBufferBudget> mBudget;
 
     bool mStarted;
     sp<MetaData> mOutputFormat;
 
+    void dropQueuedBuffers_l();
+
     DISALLOW_EVIL_CONSTRUCTORS(MediaAdapter);
 };
 
@@ -18,6 +18,8 @@
 
 #define MEDIA_BUFFER_GROUP_H_
 
+#include <vector>
+
 #include <media/stagefright/MediaBuffer.h>
 #include <utils/Errors.h>
 #include <utils/threads.h>
@@ -56,13 +58,35 @@ public:
     // If buffer is nullptr, have acquire_buffer() check for remote release.
     virtual void signalBufferReturned(MediaBuffer *buffer);
 
+    struct Stats {
+        uint64_t mHits;         // acquired from the free buffers returned to the group
+        uint64_t mMisses;       // acquired by scanning or growing the group
+        uint64_t mWaits;        // blocked because no buffer was available
+        uint64_t mAllocations;  // buffers allocated by acquire_buffer()
+    };
+    void get_stats(Stats *stats);
+
 private:
     friend class MediaBuffer;
 
+    // Free buffers are kept in their size class: class k holds buffer sizes in [2^k, 2^(k+1)),
+    // the last class larger sizes too.
+    enum {
+        kNumSizeClasses = 32,
+    };
+    static size_t sizeClass(size_t size);
+
+    MediaBuffer *popFreeBuffer_l(size_t requestedSize);
+    void removeFreeBuffer_l(MediaBuffer *buffer);
+
     Mutex mLock;
     Condition mCondition;
     size_t mGrowthLimit;  // Do not automatically grow group larger than this.
     std::list<MediaBuffer *> mBuffers;
+    // Buffers returned to the group, most recent last. A buffer released remotely, or claimed, is
+    // not in these lists and is found by scanning mBuffers.
+    std::vector<MediaBuffer *> mFreeBuffers[kNumSizeClasses];
+    Stats mStats;
 
     MediaBufferGroup(const MediaBufferGroup &);
     MediaBufferGroup &operator=(const MediaBufferGroup &);
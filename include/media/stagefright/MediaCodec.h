@@ -130,6 +130,23 @@ struct MediaCodec : public AHandler {
             uint32_t flags,
             AString *errorDetailMsg = NULL);
 
+    // One buffer of queueInputBuffers() or dequeueOutputBuffers().
+    struct BatchBuffer {
+        size_t mIndex;
+        size_t mOffset;
+        size_t mSize;
+        int64_t mPresentationTimeUs;
+        uint32_t mFlags;
+    };
+
+    // Queues count input buffers in one call, in order, stopping at the
+    // first one that fails; numQueued is set to the number queued.
+    status_t queueInputBuffers(
+            const BatchBuffer *buffers,
+            size_t count,
+            size_t *numQueued,
+            AString *errorDetailMsg = NULL);
+
     status_t dequeueInputBuffer(size_t *index, int64_t timeoutUs = 0ll);
 
     status_t dequeueOutputBuffer(
@@ -140,6 +157,15 @@ struct MediaCodec : public AHandler {
             uint32_t *flags,
             int64_t timeoutUs = 0ll);
 
+    // Dequeues up to maxCount output buffers, waiting up to timeoutUs for
+    // the first one only; returns the same errors and INFO_* codes as
+    // dequeueOutputBuffer() with count set to 0.
+    status_t dequeueOutputBuffers(
+            BatchBuffer *buffers,
+            size_t maxCount,
+            size_t *count,
+            int64_t timeoutUs = 0ll);
+
     status_t renderOutputBufferAndRelease(size_t index, int64_t timestampNs);
     status_t renderOutputBufferAndRelease(size_t index);
     status_t releaseOutputBuffer(size_t index);
@@ -217,6 +243,7 @@ private:
         kWhatRelease                        = 'rele',
         kWhatDequeueInputBuffer             = 'deqI',
         kWhatQueueInputBuffer               = 'queI',
+        kWhatQueueInputBuffers              = 'qIBs',
         kWhatDequeueOutputBuffer            = 'deqO',
         kWhatReleaseOutputBuffer            = 'relO',
         kWhatSignalEndOfInputStream         = 'eois',
@@ -331,6 +358,11 @@ private:
     List<size_t> mAvailPortBuffers[2];
     Vector<BufferInfo> mPortBuffers[2];
 
+    // Whether dequeueInputBuffer() and dequeueOutputBuffer() may take an
+    // available buffer under mBufferLock instead of going through the
+    // looper; only set between the messages, when the state allows it.
+    bool mDirectDequeueAllowed[2];
+
     int32_t mDequeueInputTimeoutGeneration;
     sp<AReplyToken> mDequeueInputReplyID;
 
@@ -364,6 +396,12 @@ private:
     status_t onQueueInputBuffer(const sp<AMessage> &msg);
     status_t onReleaseOutputBuffer(const sp<AMessage> &msg);
     ssize_t dequeuePortBuffer(int32_t portIndex);
+    ssize_t dequeuePortBuffer_l(int32_t portIndex);
+    void getOutputBufferInfo_l(
+            size_t index, size_t *offset, size_t *size, int64_t *timeUs, uint32_t *flags);
+    void updateDirectDequeue();
+    size_t dequeueAvailableOutputBuffers(BatchBuffer *buffers, size_t maxCount);
+    void handleMessage(const sp<AMessage> &msg);
 
     status_t getBufferAndFormat(
             size_t portIndex, size_t index,
@@ -117,12 +117,24 @@ private:
     sp<MediaCodecInfo> mCurrentInfo;
     sp<IOMX> mOMX;
 
+    // every XML file read, to tell whether the cache is up to date
+    struct ParsedFile {
+        AString mPath;
+        int64_t mSize;
+        int64_t mModifiedTimeNs;
+    };
+    Vector<ParsedFile> mParsedFiles;
+
     MediaCodecList();
     ~MediaCodecList();
 
     status_t initCheck() const;
     void parseXMLFile(const char *path);
 
+    status_t readCache();
+    void writeCache() const;
+    void configureResourcePolicies();
+
     static void StartElementHandlerWrapper(
             void *me, const char *name, const char **attrs);
 
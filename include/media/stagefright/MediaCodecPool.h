@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_CODEC_POOL_H_
+
+#define MEDIA_CODEC_POOL_H_
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+
+namespace android {
+
+struct ALooper;
+struct MediaCodec;
+
+// Keeps recently recycled codecs stopped, with their component still
+// allocated in the loaded state, so that the next codec created for the
+// same component only pays for configure() and start().
+//
+// The pool holds up to media.codec.pool-size codecs (default 2, 0 disables
+// it) for media.codec.pool-timeout-ms (default 3000) each.  Secure codecs
+// are never pooled.  Recycled codecs keep running on the looper they were
+// created on.
+struct MediaCodecPool : public AHandler {
+    // Returns a pooled codec for the component MediaCodec::CreateByType()
+    // would pick for mime, if there is one for pid, otherwise creates one.
+    static sp<MediaCodec> CreateByType(
+            const sp<ALooper> &looper, const AString &mime, bool encoder,
+            status_t *err = NULL, pid_t pid = -1);
+
+    // Like CreateByType(), for a specific component.
+    static sp<MediaCodec> CreateByComponentName(
+            const sp<ALooper> &looper, const AString &name,
+            status_t *err = NULL, pid_t pid = -1);
+
+    // Stops codec and keeps it for a later CreateByType(), or releases it if
+    // it cannot be pooled.  The caller must not use codec afterwards.
+    static status_t Recycle(const sp<MediaCodec> &codec, pid_t pid = -1);
+
+    // Starts creating the codec CreateByType() would pick for mime on the
+    // pool's looper and keeps it in the pool for pid, so that it can be
+    // allocated while the caller is still busy with something else.  A
+    // CreateByType() for the same codec while it is being created waits for
+    // it instead of creating another one.
+    static void Prewarm(const AString &mime, bool encoder, pid_t pid = -1);
+
+protected:
+    virtual ~MediaCodecPool();
+
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatExpire = 'expi',
+        kWhatPrewarm = 'prew',
+    };
+
+    struct Entry {
+        sp<MediaCodec> mCodec;
+        AString mName;
+        pid_t mPid;
+        int64_t mRecycledUs;
+    };
+
+    Mutex mLock;
+    Condition mCondition;
+    List<Entry> mEntries;
+    // codecs being created by Prewarm(), without mCodec
+    List<Entry> mPrewarming;
+    size_t mNumEntries;
+    size_t mMaxEntries;
+    int64_t mTimeoutUs;
+    sp<ALooper> mLooper;
+
+    MediaCodecPool();
+
+    static sp<MediaCodecPool> getInstance();
+
+    sp<MediaCodec> acquire(const AString &mime, bool encoder, pid_t pid);
+    sp<MediaCodec> acquireByName(const AString &name, pid_t pid);
+    status_t recycle(const sp<MediaCodec> &codec, pid_t pid);
+    void prewarm(const AString &mime, bool encoder, pid_t pid);
+    void onPrewarm(const sp<AMessage> &msg);
+
+    // Adds a stopped codec; the lock must be held.  Returns the entry
+    // evicted to make room for it, if any.
+    sp<MediaCodec> addEntry_l(const sp<MediaCodec> &codec, const AString &name, pid_t pid);
+    bool isPrewarming_l(const AString &name, pid_t pid) const;
+    // Removes and returns the pooled codec for name and pid, waiting for it
+    // if it is being prewarmed; the lock must be held.
+    sp<MediaCodec> takeEntry_l(const AString &name, pid_t pid);
+
+    DISALLOW_EVIL_CONSTRUCTORS(MediaCodecPool);
+};
+
+}  // namespace android
+
+#endif  // MEDIA_CODEC_POOL_H_
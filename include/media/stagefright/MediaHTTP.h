@@ -25,10 +25,15 @@
 namespace android {
 
 struct IMediaHTTPConnection;
+struct IMediaHTTPService;
 
 struct MediaHTTP : public HTTPBase {
     MediaHTTP(const sp<IMediaHTTPConnection> &conn);
 
+    // Uses an idle connection of the service if there is one, and gives the
+    // connection back to the pool once destroyed (see HTTPConnectionPool).
+    MediaHTTP(const sp<IMediaHTTPService> &service);
+
     virtual status_t connect(
             const char *uri,
             const KeyedVector<String8, String8> *headers,
@@ -56,6 +61,7 @@ protected:
 
 private:
     status_t mInitCheck;
+    sp<IMediaHTTPService> mHTTPService;
     sp<IMediaHTTPConnection> mHTTPConnection;
 
     KeyedVector<String8, String8> mLastHeaders;
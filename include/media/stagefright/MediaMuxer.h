@@ -18,6 +18,7 @@
 #define MEDIA_MUXER_H_
 
 #include <utils/Errors.h>
+#include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/Vector.h>
 #include <utils/threads.h>
@@ -29,7 +30,9 @@ namespace android {
 struct ABuffer;
 struct AMessage;
 struct MediaAdapter;
+struct MediaBufferBudget;
 class MediaBuffer;
+class IMediaSource;
 struct MediaSource;
 class MetaData;
 struct MediaWriter;
@@ -64,6 +67,22 @@ public:
      */
     ssize_t addTrack(const sp<AMessage> &format);
 
+    /**
+     * Add a track whose samples the writer reads straight from source,
+     * e.g. from NuMediaExtractor::getTrackSource(), keeping their
+     * timestamps and sync flags. No writeSampleData() call is needed for
+     * such a track, and stop() waits for the writer to have read all of
+     * its samples. This should be called before start().
+     * @param source the track's samples.
+     * @param startTimeUs the source is first seeked to the sync sample at
+     *                    or before this time if it is positive.
+     * @param endTimeUs the track ends before the first sample later than
+     *                  this time if it is not negative.
+     * @return the track's index or negative number if error.
+     */
+    ssize_t addSourceTrack(const sp<IMediaSource> &source,
+                           int64_t startTimeUs = 0, int64_t endTimeUs = -1);
+
     /**
      * Start muxing. Make sure all the tracks have been added before
      * calling this.
@@ -114,12 +133,53 @@ public:
     status_t writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
                              int64_t timeUs, uint32_t flags) ;
 
+    /**
+     * Send a sample buffer for muxing without copying or waiting for it.
+     * The muxer takes over the buffer: its data must not be changed after
+     * this call. The samples are handed to the writer in timestamp order
+     * across the tracks, keeping the order of each track. This only
+     * blocks when the samples not written yet exceed the memory budget.
+     * @param buffer the incoming sample buffer.
+     * @param trackIndex the buffer's track index number.
+     * @param timeUs the buffer's time stamp.
+     * @param flags the only supported flag for now is
+     *              MediaCodec::BUFFER_FLAG_SYNCFRAME.
+     * @return OK if no error.
+     */
+    status_t queueSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
+                             int64_t timeUs, uint32_t flags);
+
+    /**
+     * Set the memory budget of the samples sent with queueSampleData()
+     * that are not written yet. The default is set by
+     * media.muxer.max-buffered-kb.
+     * @param maxBytes the budget; a single sample larger than it is
+     *                 still accepted.
+     * @return OK if no error.
+     */
+    status_t setMaxBufferedBytes(size_t maxBytes);
+
 private:
     const OutputFormat mFormat;
     sp<MediaWriter> mWriter;
-    Vector< sp<MediaAdapter> > mTrackList;  // Each track has its MediaAdapter.
+    // Each track has its MediaAdapter, but for the ones added by
+    // addSourceTrack(), which are NULL.
+    Vector< sp<MediaAdapter> > mTrackList;
+    struct PassThroughSource;
+    Vector< sp<PassThroughSource> > mSourceTrackList;
     sp<MetaData> mFileMeta;  // Metadata for the whole file.
 
+    // Samples from queueSampleData() waiting for a sample of every track
+    // with a MediaAdapter, so that the earliest one can go to its track
+    // first.
+    struct PendingSample {
+        MediaBuffer *mBuffer;
+        int64_t mTimeUs;
+    };
+    Vector< List<PendingSample> > mPendingSamples;  // one list per track
+    size_t mNumTracksWithoutPendingSamples;
+    sp<MediaBufferBudget> mBudget;
+
     Mutex mMuxerLock;
 
     enum State {
@@ -130,6 +190,14 @@ private:
     };
     State mState;
 
+    status_t checkSample_l(const sp<ABuffer> &buffer, size_t trackIndex);
+    static MediaBuffer *makeSample(
+            const sp<ABuffer> &buffer, int64_t timeUs, uint32_t flags);
+    status_t queuePendingSample_l(size_t trackIndex);
+    ssize_t earliestPendingSample_l() const;
+    status_t interleavePendingSamples_l();
+    status_t flushPendingSamples_l();
+
     DISALLOW_EVIL_CONSTRUCTORS(MediaMuxer);
 };
 
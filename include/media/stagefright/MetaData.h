@@ -117,6 +117,10 @@ enum {
     kKey64BitFileOffset   = 'fobt',  // int32_t (bool)
     kKey2ByteNalLength    = '2NAL',  // int32_t (bool)
 
+    // Set this key to author a fragmented file, with movie fragments of
+    // about this duration
+    kKeyFragmentDurationUs = 'frgD',  // int64_t
+
     // Identify the file output format for authoring
     // Please see <media/mediarecorder.h> for the supported
     // file output formats.
@@ -287,12 +291,19 @@ private:
         String8 asString(bool verbose) const;
 
     private:
+        // Data too large for the reservoir. It is never modified once set, so copies of the
+        // item share it.
+        struct shared_storage {
+            volatile int32_t mRefCount;
+            int32_t mPadding;  // keeps the data that follows 8 byte aligned
+        };
+
         uint32_t mType;
         size_t mSize;
 
         union {
-            void *ext_data;
-            float reservoir;
+            shared_storage *ext_data;
+            int64_t reservoir[2];  // holds int64_t, pointer and Rect data
         } u;
 
         bool usesReservoir() const {
@@ -303,11 +314,11 @@ private:
         void freeStorage();
 
         void *storage() {
-            return usesReservoir() ? &u.reservoir : u.ext_data;
+            return usesReservoir() ? (void *)u.reservoir : (void *)(u.ext_data + 1);
         }
 
         const void *storage() const {
-            return usesReservoir() ? &u.reservoir : u.ext_data;
+            return usesReservoir() ? (const void *)u.reservoir : (const void *)(u.ext_data + 1);
         }
     };
 
@@ -315,7 +326,19 @@ private:
         int32_t mLeft, mTop, mRight, mBottom;
     };
 
+    // Keys set on every sample are kept out of mItems, which would otherwise reallocate its
+    // storage for them after each clear().
+    enum {
+        kNumHotKeys = 4,
+    };
+    static ssize_t HotKeyIndex(uint32_t key);
+
+    size_t numItems() const;
+    const typed_data &itemAt(size_t index, uint32_t *key) const;
+
     KeyedVector<uint32_t, typed_data> mItems;
+    typed_data mHotItems[kNumHotKeys];
+    uint32_t mHotItemsPresent;  // bit i is set iff mHotItems[i] is
 
     // MetaData &operator=(const MetaData &);
 };
@@ -65,6 +65,12 @@ struct NuMediaExtractor : public RefBase {
 
     status_t getFileFormat(sp<AMessage> *format) const;
 
+    // A source of its own for the track, to hand the samples over without
+    // copying them (e.g. to MediaMuxer::addSourceTrack()).  The track must
+    // not be selected, and the source is read independently of this
+    // extractor.
+    status_t getTrackSource(size_t index, sp<IMediaSource> *source) const;
+
     status_t selectTrack(size_t index);
     status_t unselectTrack(size_t index);
 
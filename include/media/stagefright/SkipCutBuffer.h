@@ -37,6 +37,9 @@ class SkipCutBuffer: public RefBase {
     // Submit one MediaBuffer for skipping and cutting. This may consume all or
     // some of the data in the buffer, or it may add data to it.
     // After this, the caller should continue processing the buffer as usual.
+    // Skipping only adjusts the buffer's range; cutting moves the data of a
+    // buffer only if there is no room in front of it for the data held back
+    // from the previous one.
     void submit(MediaBuffer *buffer);
     void submit(const sp<ABuffer>& buffer);    // same as above, but with an ABuffer
     void clear();
@@ -46,15 +49,17 @@ class SkipCutBuffer: public RefBase {
     virtual ~SkipCutBuffer();
 
  private:
-    void write(const char *src, size_t num);
-    size_t read(char *dst, size_t num);
+    // Trims the data at base + *offset and updates its range.
+    void submit(char *base, size_t *offset, size_t *length);
     int32_t mSkip;
     int32_t mFrontPadding;
     int32_t mBackPadding;
-    int32_t mWriteHead;
-    int32_t mReadHead;
-    int32_t mCapacity;
-    char* mCutBuffer;
+    // the last mBackPadding bytes submitted, or fewer at the start
+    int32_t mHeldSize;
+    char* mHeld;
+    // where the next buffer's tail is saved before it becomes mHeld
+    char* mSpare;
+    bool mPassthrough;
     DISALLOW_EVIL_CONSTRUCTORS(SkipCutBuffer);
 };
 
@@ -30,15 +30,17 @@ struct StagefrightMediaScanner : public MediaScanner {
             const char *path, const char *mimeType,
             MediaScannerClient &client);
 
+    // Extracts the metadata of the files on several threads, the client
+    // is still called on the calling thread only.
+    virtual MediaScanResult processFiles(
+            const Vector<String8> &paths, MediaScannerClient &client,
+            Vector<MediaScanResult> *results);
+
     virtual MediaAlbumArt *extractAlbumArt(int fd);
 
 private:
     StagefrightMediaScanner(const StagefrightMediaScanner &);
     StagefrightMediaScanner &operator=(const StagefrightMediaScanner &);
-
-    MediaScanResult processFileInternal(
-            const char *path, const char *mimeType,
-            MediaScannerClient &client);
 };
 
 }  // namespace android
@@ -42,6 +42,14 @@ struct VideoFrameScheduler : public RefBase {
     // returns the current frames-per-second, or 0.f if not primed
     float getFrameRate();
 
+    // cadence statistics since the last init()
+    struct Stats {
+        size_t mNumFrames;          // frames scheduled against a known vsync
+        size_t mNumCadenceBreaks;   // frames shown for an unexpected number of vsyncs
+        size_t mNumCorrections;     // vsyncs added or removed to catch up with drift
+    };
+    void getStats(Stats *stats) const;
+
     void release();
 
     static const size_t kHistorySize = 8;
@@ -82,6 +90,7 @@ private:
     };
 
     void updateVsync();
+    void logStats() const;
 
     nsecs_t mVsyncTime;        // vsync timing from display
     nsecs_t mVsyncPeriod;
@@ -90,6 +99,8 @@ private:
     nsecs_t mLastVsyncTime;    // estimated vsync time for last frame
     nsecs_t mTimeCorrection;   // running adjustment
 
+    Stats mStats;
+
     PLL mPll;                  // PLL for video frame rate based on render time
 
     sp<ISurfaceComposer> mComposer;
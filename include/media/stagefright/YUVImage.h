@@ -98,13 +98,34 @@ public:
             int32_t destStartX, int32_t destStartY,
             const YUVImage &srcImage, YUVImage &destImage);
 
+    // Copies a rectangle between a planar and a semi planar image a row at a
+    // time, interleaving or deinterleaving the U/V rows.
+    static void fastCopyRectangle420Mixed(
+            const Rect& srcRect,
+            int32_t destStartX, int32_t destStartY,
+            const YUVImage &srcImage, YUVImage &destImage);
+
     // Tries to use memcopy to copy entire rows of data.
-    // Returns false if fast copy is not possible for the passed image formats.
+    // Returns false if fast copy is not possible for the passed image formats
+    // and rectangle; copies between planar and semi planar images need even
+    // rectangle and destination coordinates.
     static bool fastCopyRectangle(
             const Rect& srcRect,
             int32_t destStartX, int32_t destStartY,
             const YUVImage &srcImage, YUVImage &destImage);
 
+    // Sets every pixel in rect to the given value, a data row at a time.
+    void fillRectangle(const Rect& rect,
+            uint8_t yValue, uint8_t uValue, uint8_t vValue);
+
+    // Sets pixel (x, y) of destImage to pixel
+    // (srcOffsetX + x * skipX, srcOffsetY + y * skipY) of srcImage, for the
+    // whole of destImage, with the same result as doing so pixel by pixel.
+    static void downsample(
+            int32_t srcOffsetX, int32_t srcOffsetY,
+            int32_t skipX, int32_t skipY,
+            const YUVImage &srcImage, YUVImage &destImage);
+
     // Convert the given YUV value to RGB.
     void yuv2rgb(uint8_t yValue, uint8_t uValue, uint8_t vValue,
         uint8_t *r, uint8_t *g, uint8_t *b) const;
@@ -158,6 +179,11 @@ private:
         int32_t *uDataOffsetIncrement,
         int32_t *vDataOffsetIncrement) const;
 
+    // Returns the U and V addresses of the given U/V data row and the
+    // distance between consecutive U (or V) values in it.
+    void getUVRow(int32_t uvRow,
+        uint8_t **uAddr, uint8_t **vAddr, int32_t *uvStep) const;
+
     // Given the offset return the address of the corresponding channel's data.
     uint8_t* getYAddress(int32_t offset) const;
     uint8_t* getUAddress(int32_t offset) const;
@@ -31,17 +31,27 @@ namespace android {
 struct AAtomizer {
     static const char *Atomize(const char *name);
 
+    // Same as Atomize() for a name whose hash is already known, but returns NULL instead of
+    // adding a new atom once kMaxAtoms atoms exist.
+    static const char *TryAtomize(const char *name, uint32_t hash);
+
+    // Returns the hash of s, and its length in *length if not NULL.
+    static uint32_t Hash(const char *s, size_t *length = NULL);
+
 private:
+    enum {
+        kMaxAtoms = 4096,
+    };
+
     static AAtomizer gAtomizer;
 
     Mutex mLock;
     Vector<List<AString> > mAtoms;
+    size_t mNumAtoms;
 
     AAtomizer();
 
-    const char *atomize(const char *name);
-
-    static uint32_t Hash(const char *s);
+    const char *atomize(const char *name, uint32_t hash, bool limited);
 
     DISALLOW_EVIL_CONSTRUCTORS(AAtomizer);
 };
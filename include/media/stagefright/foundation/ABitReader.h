@@ -46,9 +46,14 @@ public:
     // Tries to skip |n| bits. Returns true iff successful. Skipping 0 bits will always succeed.
     bool skipBits(size_t n);
 
+    // Tries to get an unsigned Exp-Golomb code ue(v) with at most 31 leading zero bits. If not
+    // successful, either due to overread or to a longer code, returns false. Otherwise, stores
+    // the decoded value in |out| and returns true.
+    bool getUEGraceful(uint32_t *out);
+
     // "Puts" |n| bits with the value |x| back virtually into the bit stream. The put-back bits
     // are not actually written into the data, but are tracked in a separate buffer that can
-    // store at most 32 bits. This is a no-op if the stream has already been over-read.
+    // store at most 64 bits. This is a no-op if the stream has already been over-read.
     void putBits(uint32_t x, size_t n);
 
     size_t numBitsLeft() const;
@@ -63,10 +68,12 @@ protected:
     const uint8_t *mData;
     size_t mSize;
 
-    uint32_t mReservoir;  // left-aligned bits
+    uint64_t mReservoir;  // left-aligned bits, the bits past mNumBitsLeft are 0
     size_t mNumBitsLeft;
     bool mOverRead;
 
+    // Tops up the reservoir with whole bytes, up to 64 bits. Returns false iff there is no data
+    // left to add.
     virtual bool fillReservoir();
 
     DISALLOW_EVIL_CONSTRUCTORS(ABitReader);
@@ -44,6 +44,14 @@ struct ABuffer : public RefBase {
     // create buffer from dup of some memory block
     static sp<ABuffer> CreateAsCopy(const void *data, size_t capacity);
 
+    // create buffer whose data is taken from, and returned to, a process wide cache of blocks
+    // of the same size class, for buffers allocated and released at a high rate
+    static sp<ABuffer> CreatePooled(size_t capacity);
+
+    // create buffer viewing size bytes at offset in the range of this buffer, sharing its
+    // data: the slice keeps this buffer alive, and sees any change to the data
+    sp<ABuffer> slice(size_t offset, size_t size);
+
     void setInt32Data(int32_t data) { mInt32Data = data; }
     int32_t int32Data() const { return mInt32Data; }
 
@@ -60,6 +68,9 @@ private:
 
     MediaBufferBase *mMediaBufferBase;
 
+    // buffer owning the data of a slice
+    sp<ABuffer> mParent;
+
     void *mData;
     size_t mCapacity;
     size_t mRangeOffset;
@@ -68,6 +79,7 @@ private:
     int32_t mInt32Data;
 
     bool mOwnsData;
+    bool mPooled;
 
     DISALLOW_EVIL_CONSTRUCTORS(ABuffer);
 };
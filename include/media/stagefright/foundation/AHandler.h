@@ -19,6 +19,7 @@
 #define A_HANDLER_H_
 
 #include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AString.h>
 #include <utils/KeyedVector.h>
 #include <utils/RefBase.h>
 
@@ -30,7 +31,9 @@ struct AHandler : public RefBase {
     AHandler()
         : mID(0),
           mVerboseStats(false),
-          mMessageCounter(0) {
+          mMessageCounter(0),
+          mNumRecent(0),
+          mNextRecent(0) {
     }
 
     ALooper::handler_id id() const {
@@ -65,11 +68,38 @@ private:
         mLooper = looper;
     }
 
+    // Verbose statistics, per message what: the wait is the delay between the time a message
+    // was due and its delivery, the execution time that of onMessageReceived().
+    struct MessageStats {
+        uint32_t mCount;
+        int64_t mTotalWaitUs;
+        int64_t mMaxWaitUs;
+        int64_t mTotalExecUs;
+        int64_t mMaxExecUs;
+    };
+    // the last mNumRecent messages delivered with verbose statistics, in a ring where the next
+    // one goes at mNextRecent
+    struct RecentMessage {
+        uint32_t mWhat;
+        int32_t mWaitUs;
+        int32_t mExecUs;
+    };
+    enum {
+        kNumRecentMessages = 16,
+    };
+
     bool mVerboseStats;
     uint32_t mMessageCounter;
-    KeyedVector<uint32_t, uint32_t> mMessages;
-
-    void deliverMessage(const sp<AMessage> &msg);
+    KeyedVector<uint32_t, MessageStats> mMessages;
+    RecentMessage mRecentMessages[kNumRecentMessages];
+    uint32_t mNumRecent;
+    uint32_t mNextRecent;
+    // names of the systrace counters of the wait and execution times
+    AString mWaitCounterName;
+    AString mExecCounterName;
+
+    void deliverMessage(const sp<AMessage> &msg, int64_t whenUs);
+    void clearStats();
 
     DISALLOW_EVIL_CONSTRUCTORS(AHandler);
 };
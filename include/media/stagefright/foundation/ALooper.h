@@ -24,6 +24,7 @@
 #include <utils/KeyedVector.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -31,6 +32,7 @@ namespace android {
 struct AHandler;
 struct AMessage;
 struct AReplyToken;
+class String8;
 
 struct ALooper : public RefBase {
     typedef int32_t event_id;
@@ -41,6 +43,11 @@ struct ALooper : public RefBase {
     // Takes effect in a subsequent call to start().
     void setName(const char *name);
 
+    // Takes effect in a subsequent call to start(). With more than one thread, the messages of
+    // different handlers may be delivered concurrently; the messages of a given handler are
+    // still delivered one at a time and in order. Not supported with runOnCallingThread.
+    void setNumThreads(size_t numThreads);
+
     handler_id registerHandler(const sp<AHandler> &handler);
     void unregisterHandler(handler_id handlerID);
 
@@ -63,10 +70,12 @@ protected:
 
 private:
     friend struct AMessage;       // post()
+    friend struct ALooperRoster;  // appendStats()
 
     struct Event {
         int64_t mWhenUs;
-        sp<AMessage> mMessage;
+        uint64_t mSequence;       // keeps events due at the same time in posting order
+        size_t mSlot;             // index of the message in mEventMessages
     };
 
     Mutex mLock;
@@ -74,12 +83,39 @@ private:
 
     AString mName;
 
-    List<Event> mEventQueue;
+    // binary min-heap ordered by (mWhenUs, mSequence)
+    Vector<Event> mEventQueue;
+    // messages of the queued events, in slots recycled through mFreeEventSlots
+    Vector<sp<AMessage> > mEventMessages;
+    Vector<size_t> mFreeEventSlots;
+    uint64_t mNextEventSequence;
+
+    // event queue statistics, reported by ALooperRoster::dump()
+    size_t mMaxQueueDepth;
+    uint64_t mEventsDelivered;
+    int64_t mTotalLatencyUs;  // sum of the delays between due and delivery times
+    int64_t mMaxLatencyUs;
 
     struct LooperThread;
     sp<LooperThread> mThread;
     bool mRunningLocally;
 
+    // thread pool, used when mNumThreads > 1
+    struct DueMessage {
+        sp<AMessage> mMessage;
+        int64_t mWhenUs;
+    };
+    struct HandlerQueue {
+        handler_id mHandlerID;
+        List<DueMessage> mMessages;  // messages due, in delivery order
+    };
+    size_t mNumThreads;
+    Vector<sp<LooperThread> > mPoolThreads;  // threads running in addition to mThread
+    // Queues of the handlers with messages being or to be delivered. A queue is either in
+    // mRunnableQueues or owned by the thread delivering one of its messages.
+    KeyedVector<handler_id, HandlerQueue *> mHandlerQueues;
+    List<HandlerQueue *> mRunnableQueues;
+
     // use a separate lock for reply handling, as it is always on another thread
     // use a central lock, however, to avoid creating a mutex for each reply
     Mutex mRepliesLock;
@@ -102,6 +138,19 @@ private:
     // END --- methods used only by AMessage
 
     bool loop();
+    bool loopPool();
+    void updateStats_l(int64_t latencyUs);
+
+    static bool isEarlier(const Event &a, const Event &b) {
+        return a.mWhenUs < b.mWhenUs
+                || (a.mWhenUs == b.mWhenUs && a.mSequence < b.mSequence);
+    }
+    // inserts an event in the heap, returns whether it is the next one due. mLock must be held.
+    bool pushEvent_l(int64_t whenUs, const sp<AMessage> &msg);
+    // removes the next event due from the heap and returns its message. mLock must be held.
+    sp<AMessage> popEvent_l();
+
+    void appendStats(String8 *s, bool clear);
 
     DISALLOW_EVIL_CONSTRUCTORS(ALooper);
 };
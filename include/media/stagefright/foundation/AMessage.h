@@ -180,6 +180,10 @@ struct AMessage : public RefBase {
     size_t countEntries() const;
     const char *getEntryNameAt(size_t index, Type *type) const;
 
+    // Messages are allocated from a small free list of recently released messages.
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+
 protected:
     virtual ~AMessage();
 
@@ -210,10 +214,15 @@ private:
             AString *stringValue;
             Rect rectValue;
         } u;
+        // Names are atoms from AAtomizer, unless the atom table is full.
         const char *mName;
-        size_t      mNameLength;
+        uint32_t    mNameLength;
+        uint32_t    mNameHash;
         Type mType;
-        void setName(const char *name, size_t len);
+        bool        mNameOwned;  // mName is not an atom and must be freed
+        void setName(const char *name, size_t len, uint32_t hash);
+        void setName(const Item &other);
+        void freeName();
     };
 
     enum {
@@ -229,9 +238,10 @@ private:
     void setObjectInternal(
             const char *name, const sp<RefBase> &obj, Type type);
 
-    size_t findItemIndex(const char *name, size_t len) const;
+    size_t findItemIndex(const char *name, size_t len, uint32_t hash) const;
 
-    void deliver();
+    // whenUs is the time the message was due, for the handler statistics
+    void deliver(int64_t whenUs);
 
     DISALLOW_EVIL_CONSTRUCTORS(AMessage);
 };
@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/KeyedVector.h>
+#include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/Thread.h>
 
@@ -31,6 +32,9 @@ struct AMessage;
 
 // Helper class to manage a number of live sockets (datagram and stream-based)
 // on a single thread. Clients are notified about activity through AMessages.
+// The thread waits for the sockets with epoll, or select if that fails.
+// With media.network-session.edge-triggered set, UDP sessions are kept in
+// the epoll set edge-triggered instead of being updated on every wakeup.
 struct ANetworkSession : public RefBase {
     ANetworkSession();
 
@@ -103,6 +107,8 @@ private:
     int32_t mNextSessionID;
 
     int mPipeFd[2];
+    int mEpollFd;
+    bool mEdgeTriggered;
 
     KeyedVector<int32_t, sp<Session> > mSessions;
 
@@ -123,8 +129,15 @@ private:
             int32_t *sessionID);
 
     void threadLoop();
+    void threadLoopSelect();
+    void threadLoopEpoll();
     void interrupt();
 
+    void updateEpollEvents_l(const sp<Session> &session);
+    void processSession_l(
+            const sp<Session> &session, bool readable, bool writable,
+            List<sp<Session> > *sessionsToAdd);
+
     static status_t MakeSocketNonBlocking(int s);
 
     DISALLOW_EVIL_CONSTRUCTORS(ANetworkSession);
@@ -48,6 +48,12 @@ struct AMediaCodecBufferInfo {
     uint32_t flags;
 };
 typedef struct AMediaCodecBufferInfo AMediaCodecBufferInfo;
+
+struct AMediaCodecIndexedBufferInfo {
+    size_t index;
+    AMediaCodecBufferInfo info;
+};
+typedef struct AMediaCodecIndexedBufferInfo AMediaCodecIndexedBufferInfo;
 typedef struct AMediaCodecCryptoInfo AMediaCodecCryptoInfo;
 
 enum {
@@ -133,6 +139,14 @@ ssize_t AMediaCodec_dequeueInputBuffer(AMediaCodec*, int64_t timeoutUs);
 media_status_t AMediaCodec_queueInputBuffer(AMediaCodec*,
         size_t idx, off_t offset, size_t size, uint64_t time, uint32_t flags);
 
+/**
+ * Send count buffers to the codec for processing in one call, in order. Stops at the first
+ * buffer that cannot be queued and returns its error; numQueued is set to the number of
+ * buffers queued.
+ */
+media_status_t AMediaCodec_queueInputBuffers(AMediaCodec*,
+        const AMediaCodecIndexedBufferInfo *buffers, size_t count, size_t *numQueued);
+
 /**
  * Send the specified buffer to the codec for processing.
  */
@@ -144,6 +158,15 @@ media_status_t AMediaCodec_queueSecureInputBuffer(AMediaCodec*,
  */
 ssize_t AMediaCodec_dequeueOutputBuffer(AMediaCodec*, AMediaCodecBufferInfo *info,
         int64_t timeoutUs);
+
+/**
+ * Get up to maxCount buffers of processed data, waiting up to timeoutUs for the first one.
+ * Returns the number of buffers, or one of the AMEDIACODEC_INFO_* codes or an error as
+ * AMediaCodec_dequeueOutputBuffer does. A buffer with the end of stream flag is always the
+ * last one returned.
+ */
+ssize_t AMediaCodec_dequeueOutputBuffers(AMediaCodec*, AMediaCodecIndexedBufferInfo *buffers,
+        size_t maxCount, int64_t timeoutUs);
 AMediaFormat* AMediaCodec_getOutputFormat(AMediaCodec*);
 
 /**
@@ -278,6 +278,16 @@ public:
     status_t    obtainBuffer(Buffer* buffer, const struct timespec *requested = NULL,
             struct timespec *elapsed = NULL);
 
+    // Like obtainBuffer(), but if the available frames wrap around the end of the buffer,
+    // then buffers[1] is set to the frames that follow at the start of the buffer,
+    // so that up to buffers[0].mFrameCount frames can be obtained with one call.
+    // On entry, buffers[0].mFrameCount is the maximum number of desired frames in total.
+    // On exit, buffers[0] is as for obtainBuffer(), and buffers[1].mFrameCount is 0 if there is
+    // no second part.  The mNonContig of both are the frames available beyond both parts.
+    // Both parts are released together by a releaseBuffer() of their total frame count.
+    status_t    obtainBuffers(Buffer buffers[2], const struct timespec *requested = NULL,
+            struct timespec *elapsed = NULL);
+
     // Release (some of) the frames last obtained.
     // On entry, buffer->mFrameCount should have the number of frames to release,
     // which must (cumulatively) be <= the number of frames last obtained but not yet released.
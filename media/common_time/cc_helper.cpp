@@ -18,6 +18,7 @@
 
 #include <common_time/cc_helper.h>
 #include <common_time/ICommonClock.h>
+#include <utils/Timers.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -27,6 +28,26 @@ sp<ICommonClock> CCHelper::common_clock_;
 sp<ICommonClockListener> CCHelper::common_clock_listener_;
 uint32_t CCHelper::ref_count_ = 0;
 
+const int64_t CCHelper::kSamplePeriodNs = 10000000;  // 10 ms
+std::atomic<bool> CCHelper::timeline_changed_(false);
+bool CCHelper::sample_valid_ = false;
+int64_t CCHelper::next_sample_ns_ = 0;
+CCHelper::TimeSample CCHelper::sample_;
+CCHelper::TimeSample CCHelper::rate_anchor_;
+int64_t CCHelper::min_rtt_ns_ = 0;
+double CCHelper::nominal_ns_rate_ = 0;
+double CCHelper::ns_rate_ = 0;
+int64_t CCHelper::last_estimate_ = 0;
+
+// A round trip slower than this many times the fastest recent one is rejected,
+// unless the current sample is older than kMaxSampleAge sample periods.
+static const int64_t kMaxRttRatio = 2;
+static const int64_t kMaxSampleAge = 4;
+// Accepted round trips at least this far apart update the rate estimate, which
+// is kept within kMaxRateError of the nominal common clock frequency.
+static const int64_t kRateIntervalNs = 1000000000;
+static const double kMaxRateError = 0.0005;
+
 bool CCHelper::verifyClock_l() {
     bool ret = false;
 
@@ -81,8 +102,10 @@ CCHelper::~CCHelper() {
 }
 
 void CCHelper::CommonClockListener::onTimelineChanged(uint64_t timelineID __unused) {
-    // do nothing; listener is only really used as a token so the server can
-    // find out when clients die.
+    // The listener is mostly used as a token so the server can find out when
+    // clients die, but times estimated for the old timeline are meaningless.
+    // lock_ may be held across the call which triggered this notification.
+    timeline_changed_ = true;
 }
 
 // Helper methods which attempts to make calls to the common time binder
@@ -126,4 +149,96 @@ CCHELPER_METHOD(getLocalTime(int64_t* localTime),
 CCHELPER_METHOD(getLocalFreq(uint64_t* freq),
                 getLocalFreq(freq))
 
+status_t CCHelper::getEstimatedCommonTime(int64_t* commonTime) {
+    Mutex::Autolock lock(&lock_);
+
+    if (timeline_changed_.exchange(false)) {
+        sample_valid_ = false;
+    }
+
+    int64_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (!sample_valid_ || now >= next_sample_ns_) {
+        status_t status = sampleCommonTime_l();
+        if (status != OK) {
+            sample_valid_ = false;
+            return status;
+        }
+    }
+
+    int64_t estimate = sample_.common_time
+            + static_cast<int64_t>((now - sample_.mono_ns) * ns_rate_);
+    // hide the small steps back in time that a new sample can cause; anything
+    // larger is a real change of the clock
+    int64_t step = last_estimate_ - estimate;
+    if (step > 0 && step < static_cast<int64_t>(kSamplePeriodNs * nominal_ns_rate_)) {
+        estimate = last_estimate_;
+    }
+    last_estimate_ = estimate;
+
+    *commonTime = estimate;
+    return OK;
+}
+
+status_t CCHelper::sampleCommonTime_l() {
+    if (!verifyClock_l())
+        return DEAD_OBJECT;
+
+    status_t status;
+    if (nominal_ns_rate_ == 0) {
+        uint64_t freq;
+        status = common_clock_->getCommonFreq(&freq);
+        if (OK != status)
+            return status;
+        nominal_ns_rate_ = ns_rate_ = freq / 1e9;
+    }
+
+    int64_t common;
+    int64_t before = systemTime(SYSTEM_TIME_MONOTONIC);
+    status = common_clock_->getCommonTime(&common);
+    int64_t after = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (OK != status)
+        return status;
+
+    // also after a rejected round trip, so that jitter does not turn into a
+    // round trip per call
+    next_sample_ns_ = after + kSamplePeriodNs;
+
+    int64_t rtt = after - before;
+    TimeSample sample;
+    sample.mono_ns = before + rtt / 2;
+    sample.common_time = common;
+
+    if (!sample_valid_) {
+        min_rtt_ns_ = rtt;
+        sample_ = rate_anchor_ = sample;
+        sample_valid_ = true;
+        last_estimate_ = common;
+        return OK;
+    }
+
+    if (rtt > kMaxRttRatio * min_rtt_ns_
+            && after - sample_.mono_ns < kMaxSampleAge * kSamplePeriodNs) {
+        // let the threshold follow round trips which become slower for good
+        min_rtt_ns_ += (rtt - min_rtt_ns_) / 8;
+        return OK;
+    }
+    min_rtt_ns_ = rtt < min_rtt_ns_ ? rtt : min_rtt_ns_ + (rtt - min_rtt_ns_) / 8;
+    sample_ = sample;
+
+    int64_t interval = sample.mono_ns - rate_anchor_.mono_ns;
+    if (interval >= kRateIntervalNs) {
+        double rate = (sample.common_time - rate_anchor_.common_time) / (double)interval;
+        double maxRate = nominal_ns_rate_ * (1 + kMaxRateError);
+        double minRate = nominal_ns_rate_ * (1 - kMaxRateError);
+        if (rate > maxRate) {
+            rate = maxRate;
+        } else if (rate < minRate) {
+            rate = minRate;
+        }
+        ns_rate_ += (rate - ns_rate_) / 4;
+        rate_anchor_ = sample;
+    }
+    return OK;
+}
+
 }  // namespace android
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMG_UTILS_BUFFER_STRIP_SOURCE_H
+#define IMG_UTILS_BUFFER_STRIP_SOURCE_H
+
+#include <img_utils/Output.h>
+#include <img_utils/StripSource.h>
+
+#include <cutils/compiler.h>
+#include <utils/Errors.h>
+
+#include <stdint.h>
+
+namespace android {
+namespace img_utils {
+
+/**
+ * StripSource that writes an image straight from a locked buffer, such as a
+ * RAW16 camera buffer, without an intermediate copy.  The whole image is
+ * written with a single write if its rows are contiguous, otherwise with one
+ * write per row.
+ *
+ * Pixels are written as they are in memory, so multi-byte samples must
+ * already be in the byte order of the TIFF file being written.
+ */
+class ANDROID_API BufferStripSource : public StripSource {
+    public:
+        /**
+         * Create a source for the width x height image at pixels + offset,
+         * with bytesPerPixel bytes per pixel and rowStride bytes per row.
+         * The buffer must stay valid until the source has been written.
+         */
+        BufferStripSource(const uint8_t* pixels, uint32_t ifd, uint32_t width,
+                uint32_t height, uint32_t bytesPerPixel, uint32_t rowStride,
+                uint64_t offset = 0);
+
+        virtual ~BufferStripSource();
+
+        virtual status_t writeToStream(Output& stream, uint32_t count);
+
+        virtual uint32_t getIfd() const;
+
+    private:
+        const uint8_t* mPixels;
+        uint32_t mIfd;
+        uint32_t mWidth;
+        uint32_t mHeight;
+        uint32_t mBytesPerPixel;
+        uint32_t mRowStride;
+        uint64_t mOffset;
+};
+
+} /*namespace img_utils*/
+} /*namespace android*/
+
+#endif /*IMG_UTILS_BUFFER_STRIP_SOURCE_H*/
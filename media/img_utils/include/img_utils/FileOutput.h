@@ -35,7 +35,11 @@ class ANDROID_API FileOutput : public Output {
         virtual status_t write(const uint8_t* buf, size_t offset, size_t count);
         virtual status_t close();
     private:
+        // Strips are usually written a row at a time
+        static const size_t kBufferSize = 256 * 1024;
+
         FILE *mFp;
+        uint8_t *mBuffer;
         String8 mPath;
         bool mOpen;
 };
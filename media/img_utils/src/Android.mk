@@ -32,6 +32,7 @@ LOCAL_SRC_FILES := \
   ByteArrayOutput.cpp \
   DngUtils.cpp \
   StripSource.cpp \
+  BufferStripSource.cpp \
 
 LOCAL_SHARED_LIBRARIES := \
   libexpat \
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BufferStripSource"
+
+#include <img_utils/BufferStripSource.h>
+
+#include <utils/Log.h>
+
+#include <inttypes.h>
+
+namespace android {
+namespace img_utils {
+
+BufferStripSource::BufferStripSource(const uint8_t* pixels, uint32_t ifd, uint32_t width,
+        uint32_t height, uint32_t bytesPerPixel, uint32_t rowStride, uint64_t offset)
+        : mPixels(pixels), mIfd(ifd), mWidth(width), mHeight(height),
+          mBytesPerPixel(bytesPerPixel), mRowStride(rowStride), mOffset(offset) {}
+
+BufferStripSource::~BufferStripSource() {}
+
+status_t BufferStripSource::writeToStream(Output& stream, uint32_t count) {
+    uint64_t rowSize = static_cast<uint64_t>(mWidth) * mBytesPerPixel;
+    uint64_t fullSize = rowSize * mHeight;
+    if (fullSize != count) {
+        ALOGE("%s: Amount to write %u doesn't match image size %" PRIu64, __FUNCTION__, count,
+                fullSize);
+        return BAD_VALUE;
+    }
+    if (mPixels == NULL || mRowStride < rowSize) {
+        ALOGE("%s: Invalid buffer (row stride %u, row size %" PRIu64 ")", __FUNCTION__,
+                mRowStride, rowSize);
+        return BAD_VALUE;
+    }
+
+    const uint8_t* start = mPixels + mOffset;
+    status_t res = OK;
+    if (mRowStride == rowSize) {
+        // Contiguous rows, write everything at once
+        if ((res = stream.write(start, 0, count)) != OK) {
+            ALOGE("%s: Failed to write image (%d)", __FUNCTION__, res);
+        }
+        return res;
+    }
+
+    for (uint32_t row = 0; row < mHeight; ++row) {
+        if ((res = stream.write(start + static_cast<uint64_t>(row) * mRowStride, 0,
+                rowSize)) != OK) {
+            ALOGE("%s: Failed to write row %u (%d)", __FUNCTION__, row, res);
+            return res;
+        }
+    }
+    return OK;
+}
+
+uint32_t BufferStripSource::getIfd() const {
+    return mIfd;
+}
+
+} /*namespace img_utils*/
+} /*namespace android*/
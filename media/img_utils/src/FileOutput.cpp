@@ -18,16 +18,19 @@
 
 #include <utils/Log.h>
 
+#include <stdlib.h>
+
 namespace android {
 namespace img_utils {
 
-FileOutput::FileOutput(String8 path) : mFp(NULL), mPath(path), mOpen(false) {}
+FileOutput::FileOutput(String8 path) : mFp(NULL), mBuffer(NULL), mPath(path), mOpen(false) {}
 
 FileOutput::~FileOutput() {
     if (mOpen) {
         ALOGW("%s: Destructor called with %s still open.", __FUNCTION__, mPath.string());
         close();
     }
+    free(mBuffer);
 }
 
 status_t FileOutput::open() {
@@ -40,6 +43,13 @@ status_t FileOutput::open() {
         ALOGE("%s: Could not open file %s", __FUNCTION__, mPath.string());
         return BAD_VALUE;
     }
+    if (mBuffer == NULL) {
+        mBuffer = static_cast<uint8_t*>(malloc(kBufferSize));
+    }
+    if (mBuffer != NULL && ::setvbuf(mFp, reinterpret_cast<char*>(mBuffer), _IOFBF,
+            kBufferSize) != 0) {
+        ALOGW("%s: Could not set buffer for file %s", __FUNCTION__, mPath.string());
+    }
     mOpen = true;
     return OK;
 }
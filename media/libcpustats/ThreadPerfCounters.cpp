@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ThreadPerfCounters"
+//#define LOG_NDEBUG 0
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include <utils/Log.h>
+
+#include <cpustats/ThreadPerfCounters.h>
+
+namespace android {
+
+#ifdef __linux__
+static int perfEventOpen(uint32_t type, uint64_t config, int groupFd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = groupFd < 0;    // the whole group is enabled at once through the leader
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+            PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // pid 0 and cpu -1: the calling thread, on any CPU
+    return syscall(__NR_perf_event_open, &attr, 0 /*pid*/, -1 /*cpu*/, groupFd, 0 /*flags*/);
+}
+
+static uint64_t cacheReadMissConfig(uint64_t cache)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+#endif
+
+ThreadPerfCounters::ThreadPerfCounters() :
+    mOpened(0),
+    mPreviousValid(false)
+{
+    for (int i = 0; i < kNumCounters; ++i) {
+        mFds[i] = -1;
+        mIndex[i] = -1;
+        mPrevious[i] = 0;
+    }
+}
+
+ThreadPerfCounters::~ThreadPerfCounters()
+{
+    close();
+}
+
+bool ThreadPerfCounters::open()
+{
+    close();
+#ifdef __linux__
+    static const struct {
+        uint32_t mType;
+        uint64_t mConfig;
+    } kEvents[kNumCounters] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, cacheReadMissConfig(PERF_COUNT_HW_CACHE_L1D) },
+        { PERF_TYPE_HW_CACHE, cacheReadMissConfig(PERF_COUNT_HW_CACHE_LL) },
+    };
+    for (int i = 0; i < kNumCounters; ++i) {
+        int fd = perfEventOpen(kEvents[i].mType, kEvents[i].mConfig, mOpened > 0 ? mFds[0] : -1);
+        if (fd < 0) {
+            ALOGV("perf_event_open(%s) errno=%d", counterToString((Counter) i), errno);
+            if (i == CYCLES) {
+                // without the group leader there is nothing to attach the other counters to
+                break;
+            }
+            continue;
+        }
+        mIndex[i] = mOpened;
+        mFds[mOpened++] = fd;
+    }
+    if (mOpened == 0) {
+        return false;
+    }
+    if (ioctl(mFds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP) != 0 ||
+            ioctl(mFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) {
+        ALOGE("perf event ioctl errno=%d", errno);
+        close();
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ThreadPerfCounters::close()
+{
+    // the group leader is closed last
+    for (int i = mOpened - 1; i >= 0; --i) {
+        ::close(mFds[i]);
+        mFds[i] = -1;
+    }
+    for (int i = 0; i < kNumCounters; ++i) {
+        mIndex[i] = -1;
+    }
+    mOpened = 0;
+    mPreviousValid = false;
+}
+
+bool ThreadPerfCounters::sample(uint64_t deltas[kNumCounters])
+{
+    if (mOpened == 0) {
+        return false;
+    }
+    // PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, then one value per counter
+    uint64_t values[3 + kNumCounters];
+    ssize_t expected = (3 + mOpened) * sizeof(uint64_t);
+    if (read(mFds[0], values, expected) != expected || values[0] != (uint64_t) mOpened) {
+        return false;
+    }
+    const uint64_t enabled = values[1];
+    const uint64_t running = values[2];
+    if (running == 0) {
+        return false;
+    }
+    uint64_t current[kNumCounters];
+    for (int i = 0; i < kNumCounters; ++i) {
+        current[i] = 0;
+        if (mIndex[i] >= 0) {
+            current[i] = values[3 + mIndex[i]];
+            if (running < enabled) {
+                // multiplexed: extrapolate to the whole time the counter was enabled
+                current[i] = (uint64_t) ((double) current[i] * enabled / running);
+            }
+        }
+    }
+    const bool previousValid = mPreviousValid;
+    for (int i = 0; i < kNumCounters; ++i) {
+        deltas[i] = previousValid && current[i] >= mPrevious[i] ? current[i] - mPrevious[i] :
+                current[i];
+        mPrevious[i] = current[i];
+    }
+    mPreviousValid = true;
+    return true;
+}
+
+/*static*/
+const char *ThreadPerfCounters::counterToString(Counter counter)
+{
+    switch (counter) {
+    case CYCLES:        return "cycles";
+    case INSTRUCTIONS:  return "instructions";
+    case L1D_MISSES:    return "L1D misses";
+    case LLC_MISSES:    return "LLC misses";
+    default:            return "unknown";
+    }
+}
+
+}   // namespace android
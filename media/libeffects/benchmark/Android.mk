@@ -0,0 +1,33 @@
+LOCAL_PATH:= $(call my-dir)
+
+#
+# effects benchmark
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	effects_benchmark.cpp
+
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-effects) \
+	$(call include-path-for, audio-utils)
+
+LOCAL_STATIC_LIBRARIES := \
+	libsndfile
+
+LOCAL_SHARED_LIBRARIES := \
+	libeffects \
+	libaudioutils \
+	libcutils \
+	libutils \
+	liblog
+
+LOCAL_MODULE:= effects_benchmark
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CXX_STL := libc++
+
+LOCAL_CFLAGS := -Werror -Wall
+
+include $(BUILD_EXECUTABLE)
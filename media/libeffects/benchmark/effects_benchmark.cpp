@@ -0,0 +1,690 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <malloc.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <string>
+#include <vector>
+#include <audio_utils/primitives.h>
+#include <audio_utils/sndfile.h>
+#include <hardware/audio_effect.h>
+#include <media/EffectsFactoryApi.h>
+#include <utils/Timers.h>
+
+/* Benchmark of the effects loaded by the EffectsFactory.
+ *
+ * Each effect of the factory is run alone, or the effects given with -e are run as one
+ * chain, in the order given, as in an AudioFlinger effect chain: the effects process in
+ * place, except when an effect changes the channel count (e.g. the downmixer).
+ *
+ * The chain is configured for every combination of the frame counts and channel counts
+ * requested, and run over synthetic input (tones and noise) or over a recorded file, for a
+ * number of trials. For each effect and for the whole chain the report gives:
+ * - ns and CPU cycles per frame of the best trial. Cycles are counted where the kernel
+ *   permits access to the cycle counter, and are reported as -1 otherwise.
+ * - the longest process() call of all trials, in microseconds.
+ * - for the chain only, the heap growth over the timed trials, which catches the memory
+ *   that process() allocates and keeps. Memory allocated and freed within one call is not
+ *   seen.
+ * Effects keep their default parameters. Pinning to a single cpu (-C) and fixing the cpu
+ * frequency makes runs comparable across builds and devices.
+ *
+ * The report is CSV by default, one line per effect and configuration, or JSON with -j.
+ */
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-l] [-j] [-F] [-e effect]... [-f frames,...] [-c channels,...]\n"
+                    "       [-i file.wav] [-r rate] [-t trials] [-C cpu]\n", name);
+    fprintf(stderr, "    -l    list the effects of the factory and exit\n");
+    fprintf(stderr, "    -j    report in JSON (default CSV)\n");
+    fprintf(stderr, "    -F    process float buffers (default 16 bit)\n");
+    fprintf(stderr, "    -e    add an effect, by name or implementation UUID, to the chain\n");
+    fprintf(stderr, "          (default: benchmark each effect alone)\n");
+    fprintf(stderr, "    -f    frame counts per process() call (default 128,256,480,960)\n");
+    fprintf(stderr, "    -c    input channel counts (default 1,2,6,8), ignored with -i\n");
+    fprintf(stderr, "    -i    process this file instead of synthetic input\n");
+    fprintf(stderr, "    -r    sample rate of synthetic input (default 48000)\n");
+    fprintf(stderr, "    -t    number of trials per configuration (default 5)\n");
+    fprintf(stderr, "    -C    pin the benchmark to this cpu\n");
+}
+
+static const uint32_t kDefaultSampleRate = 48000;
+static const size_t kDefaultFrameCounts[] = { 128, 256, 480, 960 };
+static const uint32_t kDefaultChannelCounts[] = { 1, 2, 6, 8 };
+static const uint32_t kMaxChannels = 8;
+static const double kSeconds = 1.;               // input length per trial
+static const int32_t kSessionId = 1;             // any session other than the output mix
+static const int32_t kIoId = 1;
+
+// Counts CPU cycles of this thread with perf_event_open(), if available.
+class CycleCounter {
+public:
+    CycleCounter() : mFd(-1), mOverhead(0) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        mFd = syscall(__NR_perf_event_open, &attr, 0 /*pid*/, -1 /*cpu*/,
+                -1 /*group_fd*/, 0 /*flags*/);
+        if (mFd >= 0) {
+            // the cycles of an empty measurement are subtracted from each measurement.
+            int64_t overhead = INT64_MAX;
+            for (int i = 0; i < 100; ++i) {
+                start();
+                const int64_t cycles = stop();
+                if (cycles >= 0 && cycles < overhead) {
+                    overhead = cycles;
+                }
+            }
+            mOverhead = overhead == INT64_MAX ? 0 : overhead;
+        }
+    }
+    ~CycleCounter() {
+        if (mFd >= 0) {
+            close(mFd);
+        }
+    }
+    bool isValid() const { return mFd >= 0; }
+    void start() {
+        if (mFd >= 0) {
+            ioctl(mFd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(mFd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    // returns the cycles since start(), or -1 if not available.
+    int64_t stop() {
+        if (mFd < 0) {
+            return -1;
+        }
+        ioctl(mFd, PERF_EVENT_IOC_DISABLE, 0);
+        int64_t cycles;
+        if (read(mFd, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+            return -1;
+        }
+        return cycles > mOverhead ? cycles - mOverhead : 0;
+    }
+private:
+    int mFd;
+    int64_t mOverhead;
+};
+
+struct Result {
+    const char *chain;       // names of the effects of the chain
+    const char *effect;      // name of the effect, or "chain"
+    const char *input;       // "synthetic" or the input file
+    size_t frameCount;       // frames per process() call
+    uint32_t channels;       // input channels of the effect
+    bool useFloat;
+    double nsPerFrame;
+    double cyclesPerFrame;   // negative if not available
+    double worstBlockUs;
+    int64_t heapBytes;       // negative if not measured
+};
+
+class Report {
+public:
+    explicit Report(bool json) : mJson(json), mCount(0) {
+        if (mJson) {
+            printf("[\n");
+        } else {
+            printf("chain,effect,input,frames,channels,format,ns_per_frame,cycles_per_frame,"
+                    "worst_block_us,heap_bytes\n");
+        }
+    }
+    ~Report() {
+        if (mJson) {
+            printf("\n]\n");
+        }
+    }
+    void add(const Result &r) {
+        const char *format = r.useFloat ? "float" : "int16";
+        if (mJson) {
+            printf("%s  {\"chain\": \"%s\", \"effect\": \"%s\", \"input\": \"%s\","
+                    " \"frames\": %zu, \"channels\": %u, \"format\": \"%s\","
+                    " \"ns_per_frame\": %.3f, \"cycles_per_frame\": %.3f,"
+                    " \"worst_block_us\": %.3f, \"heap_bytes\": %" PRId64 "}",
+                    mCount == 0 ? "" : ",\n", r.chain, r.effect, r.input, r.frameCount,
+                    r.channels, format, r.nsPerFrame, r.cyclesPerFrame, r.worstBlockUs,
+                    r.heapBytes);
+        } else {
+            printf("%s,%s,%s,%zu,%u,%s,%.3f,%.3f,%.3f,%" PRId64 "\n", r.chain, r.effect,
+                    r.input, r.frameCount, r.channels, format, r.nsPerFrame,
+                    r.cyclesPerFrame, r.worstBlockUs, r.heapBytes);
+        }
+        fflush(stdout);
+        ++mCount;
+    }
+private:
+    const bool mJson;
+    size_t mCount;
+};
+
+// Interleaved 16 bit input, looped over to feed the process() calls.
+struct Signal {
+    std::vector<int16_t> samples;
+    uint32_t channels;
+    uint32_t sampleRate;
+    const char *name;
+
+    size_t frames() const { return samples.size() / channels; }
+};
+
+// A tone per channel, distinct so that the channels do not cancel, plus some noise.
+static void makeSyntheticSignal(Signal &signal, uint32_t channels, uint32_t sampleRate)
+{
+    const size_t frames = (size_t)(kSeconds * sampleRate);
+    signal.samples.resize(frames * channels);
+    signal.channels = channels;
+    signal.sampleRate = sampleRate;
+    signal.name = "synthetic";
+    uint32_t seed = 1;
+    for (size_t i = 0; i < frames; ++i) {
+        for (uint32_t c = 0; c < channels; ++c) {
+            const double freq = 220. * (c + 1);
+            seed = seed * 1664525u + 1013904223u;
+            const double noise = ((int32_t)seed >> 16) / 32768.;
+            const double value = 0.25 * sin(2. * M_PI * freq * i / sampleRate) + 0.05 * noise;
+            signal.samples[i * channels + c] = (int16_t)(value * 32767.);
+        }
+    }
+}
+
+static bool readSignal(Signal &signal, const char *path)
+{
+    SF_INFO info;
+    memset(&info, 0, sizeof(info));
+    SNDFILE *sf = sf_open(path, SFM_READ, &info);
+    if (sf == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    if (info.channels <= 0 || (uint32_t)info.channels > kMaxChannels || info.frames <= 0) {
+        fprintf(stderr, "%s: unsupported channel count %d or empty file\n", path,
+                info.channels);
+        sf_close(sf);
+        return false;
+    }
+    signal.samples.resize(info.frames * info.channels);
+    const sf_count_t frames = sf_readf_short(sf, &signal.samples[0], info.frames);
+    sf_close(sf);
+    signal.samples.resize(frames * info.channels);
+    signal.channels = info.channels;
+    signal.sampleRate = info.samplerate;
+    signal.name = path;
+    return frames > 0;
+}
+
+static std::string uuidToString(const effect_uuid_t &uuid)
+{
+    char str[40];
+    snprintf(str, sizeof(str), "%08x-%04x-%04x-%04x-%02x%02x%02x%02x%02x%02x",
+            uuid.timeLow, uuid.timeMid, uuid.timeHiAndVersion, uuid.clockSeq,
+            uuid.node[0], uuid.node[1], uuid.node[2], uuid.node[3], uuid.node[4], uuid.node[5]);
+    return str;
+}
+
+static std::vector<effect_descriptor_t> queryEffects()
+{
+    std::vector<effect_descriptor_t> descriptors;
+    uint32_t count = 0;
+    if (EffectQueryNumberEffects(&count) != 0) {
+        return descriptors;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        effect_descriptor_t desc;
+        if (EffectQueryEffect(i, &desc) == 0) {
+            descriptors.push_back(desc);
+        }
+    }
+    return descriptors;
+}
+
+static const char *effectKind(const effect_descriptor_t &desc)
+{
+    switch (desc.flags & EFFECT_FLAG_TYPE_MASK) {
+    case EFFECT_FLAG_TYPE_AUXILIARY:
+        return "auxiliary";
+    case EFFECT_FLAG_TYPE_PRE_PROC:
+        return "pre_processing";
+    case EFFECT_FLAG_TYPE_POST_PROC:
+        return "post_processing";
+    default:
+        return "insert";
+    }
+}
+
+// One effect of the chain and its statistics for the current configuration.
+struct ChainEffect {
+    effect_descriptor_t desc;
+    effect_handle_t handle;
+    effect_config_t config;
+    uint32_t inChannels;
+    uint32_t outChannels;
+    int64_t trialNs;
+    int64_t trialCycles;
+    int64_t bestNs;
+    int64_t bestCycles;
+    int64_t worstBlockNs;
+};
+
+static bool isPreProcessing(const effect_descriptor_t &desc)
+{
+    return (desc.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_PRE_PROC;
+}
+
+static audio_channel_mask_t channelMask(const effect_descriptor_t &desc, uint32_t channels)
+{
+    return isPreProcessing(desc) ? audio_channel_in_mask_from_count(channels)
+                                  : audio_channel_out_mask_from_count(channels);
+}
+
+static int sendCommand(effect_handle_t handle, uint32_t cmd, uint32_t size, void *data)
+{
+    int reply = 0;
+    uint32_t replySize = sizeof(reply);
+    const int status = (*handle)->command(handle, cmd, size, data, &replySize, &reply);
+    return status != 0 ? status : reply;
+}
+
+// Creates, configures and enables the effect for inChannels of input. The output keeps the
+// input channels if the effect supports it, or else is stereo, as for the downmixer.
+static bool setUpEffect(ChainEffect &fx, uint32_t inChannels, uint32_t sampleRate,
+        audio_format_t format, size_t frameCount)
+{
+    const int32_t session = isPreProcessing(fx.desc) ? kSessionId : AUDIO_SESSION_OUTPUT_MIX;
+    if (EffectCreate(&fx.desc.uuid, session, kIoId, &fx.handle) != 0) {
+        fx.handle = NULL;
+        return false;
+    }
+    if (sendCommand(fx.handle, EFFECT_CMD_INIT, 0, NULL) != 0) {
+        return false;
+    }
+    const uint32_t outChannelsTried[] = { inChannels, 2 };
+    for (size_t i = 0; i < ARRAY_SIZE(outChannelsTried); ++i) {
+        effect_config_t &config = fx.config;
+        memset(&config, 0, sizeof(config));
+        config.inputCfg.samplingRate = sampleRate;
+        config.inputCfg.channels = channelMask(fx.desc, inChannels);
+        config.inputCfg.format = format;
+        config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+        config.inputCfg.buffer.frameCount = frameCount;
+        config.inputCfg.mask = EFFECT_CONFIG_ALL;
+        config.outputCfg = config.inputCfg;
+        config.outputCfg.channels = channelMask(fx.desc, outChannelsTried[i]);
+        config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+        if (sendCommand(fx.handle, EFFECT_CMD_SET_CONFIG, sizeof(config), &config) == 0) {
+            fx.inChannels = inChannels;
+            fx.outChannels = outChannelsTried[i];
+            return sendCommand(fx.handle, EFFECT_CMD_ENABLE, 0, NULL) == 0;
+        }
+    }
+    return false;
+}
+
+static void releaseChain(std::vector<ChainEffect> &chain)
+{
+    for (size_t i = 0; i < chain.size(); ++i) {
+        if (chain[i].handle != NULL) {
+            EffectRelease(chain[i].handle);
+            chain[i].handle = NULL;
+        }
+    }
+}
+
+// Copies frames of the signal, from frame index position, as format.
+static void readInput(const Signal &signal, size_t &position, void *buffer, size_t frames,
+        bool useFloat)
+{
+    size_t done = 0;
+    while (done < frames) {
+        size_t count = frames - done;
+        if (count > signal.frames() - position) {
+            count = signal.frames() - position;
+        }
+        const int16_t *src = &signal.samples[position * signal.channels];
+        if (useFloat) {
+            memcpy_to_float_from_i16((float *)buffer + done * signal.channels, src,
+                    count * signal.channels);
+        } else {
+            memcpy((int16_t *)buffer + done * signal.channels, src,
+                    count * signal.channels * sizeof(int16_t));
+        }
+        done += count;
+        position = (position + count) % signal.frames();
+    }
+}
+
+// Runs the chain over the signal in blocks of frameCount frames, and returns the frames
+// processed per trial.
+static int64_t runChain(std::vector<ChainEffect> &chain, const Signal &signal,
+        size_t frameCount, bool useFloat, int trials, CycleCounter &counter,
+        int64_t &bestChainNs, int64_t &bestChainCycles, int64_t &worstChainNs,
+        int64_t &heapBytes)
+{
+    const size_t sampleSize = useFloat ? sizeof(float) : sizeof(int16_t);
+    std::vector<uint8_t> buffers[2];
+    buffers[0].resize(frameCount * kMaxChannels * sampleSize);
+    buffers[1].resize(frameCount * kMaxChannels * sampleSize);
+    const size_t blocks = (size_t)(kSeconds * signal.sampleRate) / frameCount;
+    struct mallinfo heapStart;
+    memset(&heapStart, 0, sizeof(heapStart));
+
+    // one untimed pass, as the effects may finish their setup on the first buffers.
+    for (int n = -1; n < trials; ++n) {
+        if (n == 0) {
+            heapStart = mallinfo();
+        }
+        size_t position = 0;
+        for (size_t i = 0; i < chain.size(); ++i) {
+            chain[i].trialNs = 0;
+            chain[i].trialCycles = 0;
+        }
+        int64_t trialNs = 0;
+        int64_t trialCycles = 0;
+        for (size_t b = 0; b < blocks; ++b) {
+            int current = 0;
+            readInput(signal, position, &buffers[current][0], frameCount, useFloat);
+            int64_t blockNs = 0;
+            for (size_t i = 0; i < chain.size(); ++i) {
+                ChainEffect &fx = chain[i];
+                const int next = fx.inChannels == fx.outChannels ? current : 1 - current;
+                audio_buffer_t in;
+                audio_buffer_t out;
+                in.frameCount = frameCount;
+                in.raw = &buffers[current][0];
+                out.frameCount = frameCount;
+                out.raw = &buffers[next][0];
+                const nsecs_t startNs = systemTime();
+                counter.start();
+                (void) (*fx.handle)->process(fx.handle, &in, &out);
+                const int64_t cycles = counter.stop();
+                const int64_t ns = systemTime() - startNs;
+                fx.trialNs += ns;
+                fx.trialCycles = cycles < 0 || fx.trialCycles < 0 ? -1 : fx.trialCycles + cycles;
+                if (n >= 0 && ns > fx.worstBlockNs) {
+                    fx.worstBlockNs = ns;
+                }
+                blockNs += ns;
+                current = next;
+            }
+            trialNs += blockNs;
+            if (n >= 0 && blockNs > worstChainNs) {
+                worstChainNs = blockNs;
+            }
+        }
+        if (n < 0) {
+            continue;
+        }
+        for (size_t i = 0; i < chain.size(); ++i) {
+            ChainEffect &fx = chain[i];
+            if (n == 0 || fx.trialNs < fx.bestNs) {
+                fx.bestNs = fx.trialNs;   // save the best out of our trials.
+                fx.bestCycles = fx.trialCycles;
+            }
+            trialCycles = fx.trialCycles < 0 || trialCycles < 0 ? -1 : trialCycles + fx.trialCycles;
+        }
+        if (n == 0 || trialNs < bestChainNs) {
+            bestChainNs = trialNs;
+            bestChainCycles = trialCycles;
+        }
+    }
+    const struct mallinfo heapEnd = mallinfo();
+    heapBytes = (int64_t)heapEnd.uordblks - (int64_t)heapStart.uordblks;
+    return blocks * frameCount;
+}
+
+// Benchmarks the chain of effects for one configuration.
+static void benchChain(Report &report, const std::vector<effect_descriptor_t> &effects,
+        const char *chainName, const Signal &signal, size_t frameCount, bool useFloat,
+        int trials, CycleCounter &counter)
+{
+    const audio_format_t format = useFloat ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
+    std::vector<ChainEffect> chain(effects.size());
+    uint32_t channels = signal.channels;
+    for (size_t i = 0; i < effects.size(); ++i) {
+        memset(&chain[i], 0, sizeof(chain[i]));
+        chain[i].desc = effects[i];
+        if (!setUpEffect(chain[i], channels, signal.sampleRate, format, frameCount)) {
+            fprintf(stderr, "%s: %s does not support %u channels, %s, %zu frames, skipped\n",
+                    chainName, effects[i].name, channels, useFloat ? "float" : "int16",
+                    frameCount);
+            releaseChain(chain);
+            return;
+        }
+        channels = chain[i].outChannels;
+    }
+
+    int64_t bestChainNs = 0;
+    int64_t bestChainCycles = -1;
+    int64_t worstChainNs = 0;
+    int64_t heapBytes = 0;
+    const int64_t frames = runChain(chain, signal, frameCount, useFloat, trials, counter,
+            bestChainNs, bestChainCycles, worstChainNs, heapBytes);
+
+    for (size_t i = 0; i < chain.size(); ++i) {
+        const ChainEffect &fx = chain[i];
+        const Result r = { chainName, fx.desc.name, signal.name, frameCount, fx.inChannels,
+                useFloat,
+                (double)fx.bestNs / frames,
+                fx.bestCycles < 0 ? -1. : (double)fx.bestCycles / frames,
+                fx.worstBlockNs / 1000., -1 };
+        report.add(r);
+    }
+    const Result r = { chainName, "chain", signal.name, frameCount, signal.channels, useFloat,
+            (double)bestChainNs / frames,
+            bestChainCycles < 0 ? -1. : (double)bestChainCycles / frames,
+            worstChainNs / 1000., heapBytes };
+    report.add(r);
+    releaseChain(chain);
+}
+
+static bool findEffect(const std::vector<effect_descriptor_t> &descriptors, const char *name,
+        effect_descriptor_t &desc)
+{
+    for (size_t i = 0; i < descriptors.size(); ++i) {
+        if (strcasecmp(descriptors[i].name, name) == 0 ||
+                strcasecmp(uuidToString(descriptors[i].uuid).c_str(), name) == 0) {
+            desc = descriptors[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+static bool parseList(const char *arg, std::vector<T> &values)
+{
+    values.clear();
+    for (const char *p = arg; *p != '\0';) {
+        char *end;
+        const long value = strtol(p, &end, 10);
+        if (end == p || value <= 0) {
+            return false;
+        }
+        values.push_back((T)value);
+        p = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') {
+            return false;
+        }
+    }
+    return !values.empty();
+}
+
+int main(int argc, char* argv[]) {
+    const char* const progname = argv[0];
+    bool list = false;
+    bool json = false;
+    bool useFloat = false;
+    std::vector<const char *> effectNames;
+    std::vector<size_t> frameCounts(kDefaultFrameCounts,
+            kDefaultFrameCounts + ARRAY_SIZE(kDefaultFrameCounts));
+    std::vector<uint32_t> channelCounts(kDefaultChannelCounts,
+            kDefaultChannelCounts + ARRAY_SIZE(kDefaultChannelCounts));
+    const char *inputFile = NULL;
+    uint32_t sampleRate = kDefaultSampleRate;
+    int trials = 5;
+    int cpu = -1;
+
+    for (int ch; (ch = getopt(argc, argv, "ljFe:f:c:i:r:t:C:")) != -1;) {
+        switch (ch) {
+        case 'l':
+            list = true;
+            break;
+        case 'j':
+            json = true;
+            break;
+        case 'F':
+            useFloat = true;
+            break;
+        case 'e':
+            effectNames.push_back(optarg);
+            break;
+        case 'f':
+            if (!parseList(optarg, frameCounts)) {
+                usage(progname);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'c':
+            if (!parseList(optarg, channelCounts)) {
+                usage(progname);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'i':
+            inputFile = optarg;
+            break;
+        case 'r':
+            sampleRate = atoi(optarg);
+            break;
+        case 't':
+            trials = atoi(optarg);
+            break;
+        case 'C':
+            cpu = atoi(optarg);
+            break;
+        case '?':
+        default:
+            usage(progname);
+            return EXIT_FAILURE;
+        }
+    }
+    if (trials <= 0 || sampleRate == 0) {
+        usage(progname);
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < channelCounts.size(); ++i) {
+        if (channelCounts[i] > kMaxChannels) {
+            fprintf(stderr, "at most %u channels\n", kMaxChannels);
+            return EXIT_FAILURE;
+        }
+    }
+
+    const std::vector<effect_descriptor_t> descriptors = queryEffects();
+    if (descriptors.empty()) {
+        fprintf(stderr, "no effect found by the effects factory\n");
+        return EXIT_FAILURE;
+    }
+    if (list) {
+        for (size_t i = 0; i < descriptors.size(); ++i) {
+            printf("%s  %-16s %s (%s)\n", uuidToString(descriptors[i].uuid).c_str(),
+                    effectKind(descriptors[i]), descriptors[i].name,
+                    descriptors[i].implementor);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // the chains: the effects given, or each effect alone.
+    std::vector<std::vector<effect_descriptor_t> > chains;
+    std::vector<std::string> chainNames;
+    if (!effectNames.empty()) {
+        chains.resize(1);
+        std::string name;
+        for (size_t i = 0; i < effectNames.size(); ++i) {
+            effect_descriptor_t desc;
+            if (!findEffect(descriptors, effectNames[i], desc)) {
+                fprintf(stderr, "effect %s not found, see %s -l\n", effectNames[i], progname);
+                return EXIT_FAILURE;
+            }
+            chains[0].push_back(desc);
+            name += (i == 0 ? "" : "+");
+            name += desc.name;
+        }
+        chainNames.push_back(name);
+    } else {
+        for (size_t i = 0; i < descriptors.size(); ++i) {
+            chains.push_back(std::vector<effect_descriptor_t>(1, descriptors[i]));
+            chainNames.push_back(descriptors[i].name);
+        }
+    }
+
+    std::vector<Signal> signals;
+    if (inputFile != NULL) {
+        signals.resize(1);
+        if (!readSignal(signals[0], inputFile)) {
+            return EXIT_FAILURE;
+        }
+    } else {
+        signals.resize(channelCounts.size());
+        for (size_t c = 0; c < channelCounts.size(); ++c) {
+            makeSyntheticSignal(signals[c], channelCounts[c], sampleRate);
+        }
+    }
+
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0 /*pid*/, sizeof(set), &set) != 0) {
+            fprintf(stderr, "cannot pin to cpu %d: %s\n", cpu, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+    CycleCounter counter;
+    if (!counter.isValid()) {
+        fprintf(stderr, "cpu cycle counter not available, cycles_per_frame reported as -1\n");
+    }
+
+    Report report(json);
+    for (size_t e = 0; e < chains.size(); ++e) {
+        for (size_t s = 0; s < signals.size(); ++s) {
+            for (size_t f = 0; f < frameCounts.size(); ++f) {
+                benchChain(report, chains[e], chainNames[e].c_str(), signals[s],
+                        frameCounts[f], useFloat, trials, counter);
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
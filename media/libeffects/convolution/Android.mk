@@ -0,0 +1,24 @@
+LOCAL_PATH:= $(call my-dir)
+
+# Convolution reverb library
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	EffectConvolutionReverb.cpp \
+	dsp/PartitionedConvolver.cpp \
+	dsp/ReverbImpulseResponse.cpp
+
+LOCAL_CFLAGS+= -O2 -fvisibility=hidden
+
+LOCAL_SHARED_LIBRARIES := \
+	libcutils \
+	liblog \
+
+LOCAL_MODULE_RELATIVE_PATH := soundfx
+LOCAL_MODULE:= libconvreverb
+
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-effects) \
+	$(call include-path-for, audio-utils) \
+
+include $(BUILD_SHARED_LIBRARY)
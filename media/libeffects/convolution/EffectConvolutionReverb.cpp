@@ -0,0 +1,803 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EffectConvReverb"
+//#define LOG_NDEBUG 0
+#include <cutils/log.h>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <audio_effects/effect_environmentalreverb.h>
+#include <audio_effects/effect_presetreverb.h>
+#include <audio_utils/primitives.h>
+
+#include "dsp/PartitionedConvolver.h"
+#include "dsp/ReverbImpulseResponse.h"
+
+// The convolution reverb implements the same environmental and preset reverb interfaces as the
+// LVM reverb: the impulse response is rendered from the OpenSL ES parameters, and convolved
+// with the input by a partitioned FFT convolver.  Its cost depends on the decay time only, up
+// to kReverbMaxDecayMs, and is paid in blocks of PartitionedConvolver::kBlockFrames frames.
+
+#define CONVREV_CPU_LOAD    0       // depends on the decay time
+#define CONVREV_MEM_USAGE   5300    // in kB, at 48 kHz
+
+extern "C" {
+
+// effect_handle_t interface implementation for the convolution reverb
+extern const struct effect_interface_s gConvReverbInterface;
+
+// AOSP auxiliary environmental reverb UUID: 7ef3d82a-7e68-4ba6-a36e-2b2eb1bf2d4c
+static const effect_descriptor_t gAuxEnvReverbDescriptor = {
+        {0xc2e5d5f0, 0x94bd, 0x4763, 0x9cac, {0x4e, 0x23, 0x4d, 0x06, 0x83, 0x9e}}, // type
+        {0x7ef3d82a, 0x7e68, 0x4ba6, 0xa36e, {0x2b, 0x2e, 0xb1, 0xbf, 0x2d, 0x4c}}, // uuid
+        EFFECT_CONTROL_API_VERSION,
+        EFFECT_FLAG_TYPE_AUXILIARY,
+        CONVREV_CPU_LOAD,
+        CONVREV_MEM_USAGE,
+        "Auxiliary Convolution Environmental Reverb",
+        "The Android Open Source Project",
+};
+
+// AOSP insert environmental reverb UUID: 93b0c1b6-4d7e-4b41-9f02-5a3c6e1db8f0
+static const effect_descriptor_t gInsertEnvReverbDescriptor = {
+        {0xc2e5d5f0, 0x94bd, 0x4763, 0x9cac, {0x4e, 0x23, 0x4d, 0x06, 0x83, 0x9e}}, // type
+        {0x93b0c1b6, 0x4d7e, 0x4b41, 0x9f02, {0x5a, 0x3c, 0x6e, 0x1d, 0xb8, 0xf0}}, // uuid
+        EFFECT_CONTROL_API_VERSION,
+        EFFECT_FLAG_TYPE_INSERT | EFFECT_FLAG_INSERT_FIRST | EFFECT_FLAG_VOLUME_CTRL,
+        CONVREV_CPU_LOAD,
+        CONVREV_MEM_USAGE,
+        "Insert Convolution Environmental Reverb",
+        "The Android Open Source Project",
+};
+
+// AOSP auxiliary preset reverb UUID: 2c4e95d4-1a8b-4f3c-8d67-0e5f9a7b3c21
+static const effect_descriptor_t gAuxPresetReverbDescriptor = {
+        {0x47382d60, 0xddd8, 0x11db, 0xbf3a, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}}, // type
+        {0x2c4e95d4, 0x1a8b, 0x4f3c, 0x8d67, {0x0e, 0x5f, 0x9a, 0x7b, 0x3c, 0x21}}, // uuid
+        EFFECT_CONTROL_API_VERSION,
+        EFFECT_FLAG_TYPE_AUXILIARY,
+        CONVREV_CPU_LOAD,
+        CONVREV_MEM_USAGE,
+        "Auxiliary Convolution Preset Reverb",
+        "The Android Open Source Project",
+};
+
+// AOSP insert preset reverb UUID: d4a7f0e2-63b9-4c58-b1d3-8f26e4c9a05b
+static const effect_descriptor_t gInsertPresetReverbDescriptor = {
+        {0x47382d60, 0xddd8, 0x11db, 0xbf3a, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}}, // type
+        {0xd4a7f0e2, 0x63b9, 0x4c58, 0xb1d3, {0x8f, 0x26, 0xe4, 0xc9, 0xa0, 0x5b}}, // uuid
+        EFFECT_CONTROL_API_VERSION,
+        EFFECT_FLAG_TYPE_INSERT | EFFECT_FLAG_INSERT_FIRST | EFFECT_FLAG_VOLUME_CTRL,
+        CONVREV_CPU_LOAD,
+        CONVREV_MEM_USAGE,
+        "Insert Convolution Preset Reverb",
+        "The Android Open Source Project",
+};
+
+static const effect_descriptor_t * const gDescriptors[] = {
+        &gAuxEnvReverbDescriptor,
+        &gInsertEnvReverbDescriptor,
+        &gAuxPresetReverbDescriptor,
+        &gInsertPresetReverbDescriptor,
+};
+
+// same presets as the LVM reverb, with their reflections
+static const t_reverb_settings sConvReverbPresets[] = {
+        // REVERB_PRESET_NONE: values are unused
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        // REVERB_PRESET_SMALLROOM
+        {-400, -600, 1100, 830, -400, 5, 500, 10, 1000, 1000},
+        // REVERB_PRESET_MEDIUMROOM
+        {-400, -600, 1300, 830, -1000, 20, -200, 20, 1000, 1000},
+        // REVERB_PRESET_LARGEROOM
+        {-400, -600, 1500, 830, -1600, 5, -1000, 40, 1000, 1000},
+        // REVERB_PRESET_MEDIUMHALL
+        {-400, -600, 1800, 700, -1300, 15, -800, 30, 1000, 1000},
+        // REVERB_PRESET_LARGEHALL
+        {-400, -600, 1800, 700, -2000, 30, -1400, 60, 1000, 1000},
+        // REVERB_PRESET_PLATE
+        {-400, -200, 1300, 900, 0, 2, 0, 10, 1000, 750},
+};
+
+// default environmental reverb: the OpenSL ES defaults
+static const t_reverb_settings sConvReverbDefaults =
+        {-9600, 0, 1000, 500, -9600, 20, -9600, 40, 1000, 1000};
+
+enum conv_reverb_volume_e {
+    CONV_REVERB_VOLUME_OFF,
+    CONV_REVERB_VOLUME_FLAT,
+    CONV_REVERB_VOLUME_RAMP,
+};
+
+#define CONV_REVERB_SEND_LEVEL  0.75f   // insert reverb input level
+
+struct ConvReverbContext {
+    const struct effect_interface_s *mItfe;
+    effect_config_t mConfig;
+    bool mAuxiliary;
+    bool mPreset;
+    uint16_t mCurPreset;
+    uint16_t mNextPreset;
+    t_reverb_settings mSettings;
+    bool mImpulseDirty;             // mSettings changed since the impulse response was rendered
+    bool mEnabled;
+    int mSamplesToExitCount;
+    float mLeftVolume;
+    float mRightVolume;
+    float mPrevLeftVolume;
+    float mPrevRightVolume;
+    int mVolumeMode;
+    android::PartitionedConvolver *mConvolver;
+    std::vector<float> mImpulse[2];
+    float mInput[android::PartitionedConvolver::kBlockFrames];
+    float mWet[2 * android::PartitionedConvolver::kBlockFrames];
+};
+
+//
+//--- Local functions (not directly used by effect interface)
+//
+
+static int ConvReverb_setConfig(ConvReverbContext *pContext, effect_config_t *pConfig)
+{
+    ALOGV("ConvReverb_setConfig(%p)", pContext);
+
+    if (pConfig->inputCfg.samplingRate != pConfig->outputCfg.samplingRate) return -EINVAL;
+    if (pConfig->inputCfg.samplingRate < 8000 || pConfig->inputCfg.samplingRate > 48000) {
+        return -EINVAL;
+    }
+    if (pConfig->inputCfg.format != pConfig->outputCfg.format) return -EINVAL;
+    if (pConfig->outputCfg.channels != AUDIO_CHANNEL_OUT_STEREO) return -EINVAL;
+    if (pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_WRITE &&
+            pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE) return -EINVAL;
+    if (pContext->mAuxiliary) {
+        // auxiliary effects are fed from the mono PCM 16 bit send buffer
+        if (pConfig->inputCfg.channels != AUDIO_CHANNEL_OUT_MONO) return -EINVAL;
+        if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) return -EINVAL;
+    } else {
+        if (pConfig->inputCfg.channels != AUDIO_CHANNEL_OUT_STEREO) return -EINVAL;
+        if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+                pConfig->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT) return -EINVAL;
+    }
+
+    if (pContext->mConvolver == NULL ||
+            pConfig->inputCfg.samplingRate != pContext->mConfig.inputCfg.samplingRate) {
+        const size_t frames = android::reverbMaxImpulseFrames(pConfig->inputCfg.samplingRate);
+        android::PartitionedConvolver *convolver =
+                new (std::nothrow) android::PartitionedConvolver(frames);
+        if (convolver == NULL) {
+            return -ENOMEM;
+        }
+        delete pContext->mConvolver;
+        pContext->mConvolver = convolver;
+        pContext->mImpulse[0].resize(frames);
+        pContext->mImpulse[1].resize(frames);
+        pContext->mImpulseDirty = true;
+    }
+    pContext->mConfig = *pConfig;
+    return 0;
+}
+
+static void ConvReverb_getConfig(ConvReverbContext *pContext, effect_config_t *pConfig)
+{
+    *pConfig = pContext->mConfig;
+}
+
+static int ConvReverb_init(ConvReverbContext *pContext)
+{
+    ALOGV("ConvReverb_init(%p)", pContext);
+
+    pContext->mConfig.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+    pContext->mConfig.inputCfg.channels =
+            pContext->mAuxiliary ? AUDIO_CHANNEL_OUT_MONO : AUDIO_CHANNEL_OUT_STEREO;
+    pContext->mConfig.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    pContext->mConfig.inputCfg.samplingRate = 44100;
+    pContext->mConfig.inputCfg.bufferProvider.getBuffer = NULL;
+    pContext->mConfig.inputCfg.bufferProvider.releaseBuffer = NULL;
+    pContext->mConfig.inputCfg.bufferProvider.cookie = NULL;
+    pContext->mConfig.inputCfg.mask = EFFECT_CONFIG_ALL;
+    pContext->mConfig.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_ACCUMULATE;
+    pContext->mConfig.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+    pContext->mConfig.outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    pContext->mConfig.outputCfg.samplingRate = 44100;
+    pContext->mConfig.outputCfg.bufferProvider.getBuffer = NULL;
+    pContext->mConfig.outputCfg.bufferProvider.releaseBuffer = NULL;
+    pContext->mConfig.outputCfg.bufferProvider.cookie = NULL;
+    pContext->mConfig.outputCfg.mask = EFFECT_CONFIG_ALL;
+
+    pContext->mLeftVolume = 1.0f;
+    pContext->mRightVolume = 1.0f;
+    pContext->mPrevLeftVolume = 1.0f;
+    pContext->mPrevRightVolume = 1.0f;
+    pContext->mVolumeMode = CONV_REVERB_VOLUME_FLAT;
+    pContext->mSettings = sConvReverbDefaults;
+    pContext->mImpulseDirty = true;
+    pContext->mEnabled = false;
+    pContext->mSamplesToExitCount = 0;
+
+    return ConvReverb_setConfig(pContext, &pContext->mConfig);
+}
+
+// Renders the impulse response of the current settings if they changed.  Called from process()
+// only, so that a burst of parameter changes renders a single impulse response.
+static void ConvReverb_updateImpulse(ConvReverbContext *pContext)
+{
+    if (pContext->mPreset && pContext->mNextPreset != pContext->mCurPreset) {
+        pContext->mCurPreset = pContext->mNextPreset;
+        pContext->mSettings = sConvReverbPresets[pContext->mCurPreset];
+        pContext->mImpulseDirty = true;
+        ALOGV("ConvReverb_updateImpulse() preset %d", pContext->mCurPreset);
+    }
+    if (!pContext->mImpulseDirty) {
+        return;
+    }
+    const uint32_t sampleRate = pContext->mConfig.inputCfg.samplingRate;
+    const size_t frames = android::reverbImpulseFrames(pContext->mSettings, sampleRate);
+    android::renderReverbImpulse(pContext->mSettings, sampleRate,
+            pContext->mImpulse[0].data(), pContext->mImpulse[1].data());
+    pContext->mConvolver->setImpulseResponse(pContext->mImpulse[0].data(),
+            pContext->mImpulse[1].data(), frames);
+    pContext->mImpulseDirty = false;
+}
+
+static size_t ConvReverb_exitFrames(ConvReverbContext *pContext)
+{
+    return android::reverbImpulseFrames(pContext->mSettings,
+            pContext->mConfig.inputCfg.samplingRate) +
+            android::PartitionedConvolver::kBlockFrames;
+}
+
+static void ConvReverb_processChunk(ConvReverbContext *pContext, audio_buffer_t *inBuffer,
+        audio_buffer_t *outBuffer, size_t offset, size_t frames,
+        float *leftVolume, float *rightVolume, float leftInc, float rightInc)
+{
+    const bool useFloat = pContext->mConfig.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT;
+    float *input = pContext->mInput;
+    float *wet = pContext->mWet;
+
+    if (!pContext->mEnabled) {
+        // let the tail ring out
+        memset(input, 0, frames * sizeof(float));
+    } else if (pContext->mAuxiliary) {
+        const int16_t *in = inBuffer->s16 + offset;
+        for (size_t i = 0; i < frames; i++) {
+            input[i] = in[i] * (1.0f / (1 << 15));
+        }
+    } else if (useFloat) {
+        const float *in = inBuffer->f32 + 2 * offset;
+        for (size_t i = 0; i < frames; i++) {
+            input[i] = (in[2 * i] + in[2 * i + 1]) * (0.5f * CONV_REVERB_SEND_LEVEL);
+        }
+    } else {
+        const int16_t *in = inBuffer->s16 + 2 * offset;
+        for (size_t i = 0; i < frames; i++) {
+            input[i] = (in[2 * i] + in[2 * i + 1]) *
+                    (0.5f * CONV_REVERB_SEND_LEVEL / (1 << 15));
+        }
+    }
+
+    if (pContext->mPreset && pContext->mCurPreset == REVERB_PRESET_NONE) {
+        memset(wet, 0, frames * 2 * sizeof(float));
+    } else {
+        pContext->mConvolver->process(input, wet, frames);
+    }
+
+    // insert reverb: add the dry signal and apply the volume
+    if (!pContext->mAuxiliary) {
+        float vl = *leftVolume;
+        float vr = *rightVolume;
+        for (size_t i = 0; i < frames; i++) {
+            float dryLeft, dryRight;
+            if (useFloat) {
+                dryLeft = inBuffer->f32[2 * (offset + i)];
+                dryRight = inBuffer->f32[2 * (offset + i) + 1];
+            } else {
+                dryLeft = inBuffer->s16[2 * (offset + i)] * (1.0f / (1 << 15));
+                dryRight = inBuffer->s16[2 * (offset + i) + 1] * (1.0f / (1 << 15));
+            }
+            wet[2 * i] = (wet[2 * i] + dryLeft) * vl;
+            wet[2 * i + 1] = (wet[2 * i + 1] + dryRight) * vr;
+            vl += leftInc;
+            vr += rightInc;
+        }
+        *leftVolume = vl;
+        *rightVolume = vr;
+    }
+
+    const bool accumulate =
+            pContext->mConfig.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE;
+    if (useFloat) {
+        float *out = outBuffer->f32 + 2 * offset;
+        for (size_t i = 0; i < frames * 2; i++) {
+            out[i] = accumulate ? out[i] + wet[i] : wet[i];
+        }
+    } else {
+        int16_t *out = outBuffer->s16 + 2 * offset;
+        for (size_t i = 0; i < frames * 2; i++) {
+            const float sample = accumulate ? out[i] * (1.0f / (1 << 15)) + wet[i] : wet[i];
+            out[i] = clamp16_from_float(sample);
+        }
+    }
+}
+
+static bool ConvReverb_validSettings(const t_reverb_settings &settings)
+{
+    return settings.decayTime >= 100 && settings.decayTime <= 20000 &&
+            settings.decayHFRatio >= 100 && settings.decayHFRatio <= 2000 &&
+            settings.reflectionsDelay <= 300 && settings.reverbDelay <= 100 &&
+            settings.diffusion >= 0 && settings.diffusion <= 1000 &&
+            settings.density >= 0 && settings.density <= 1000;
+}
+
+static int ConvReverb_getParameter(ConvReverbContext *pContext, int32_t param,
+        uint32_t *pValueSize, void *pValue)
+{
+    if (pContext->mPreset) {
+        if (param != REVERB_PARAM_PRESET || *pValueSize < sizeof(uint16_t)) {
+            return -EINVAL;
+        }
+        *(uint16_t *)pValue = pContext->mNextPreset;
+        *pValueSize = sizeof(uint16_t);
+        return 0;
+    }
+
+    size_t size;
+    switch (param) {
+    case REVERB_PARAM_DECAY_TIME:
+    case REVERB_PARAM_REFLECTIONS_DELAY:
+    case REVERB_PARAM_REVERB_DELAY:
+        size = sizeof(uint32_t);
+        break;
+    case REVERB_PARAM_PROPERTIES:
+        size = sizeof(t_reverb_settings);
+        break;
+    default:
+        size = sizeof(int16_t);
+        break;
+    }
+    if (*pValueSize < size) {
+        return -EINVAL;
+    }
+    *pValueSize = size;
+
+    const t_reverb_settings &settings = pContext->mSettings;
+    switch (param) {
+    case REVERB_PARAM_ROOM_LEVEL:
+        *(int16_t *)pValue = settings.roomLevel;
+        break;
+    case REVERB_PARAM_ROOM_HF_LEVEL:
+        *(int16_t *)pValue = settings.roomHFLevel;
+        break;
+    case REVERB_PARAM_DECAY_TIME:
+        *(uint32_t *)pValue = settings.decayTime;
+        break;
+    case REVERB_PARAM_DECAY_HF_RATIO:
+        *(int16_t *)pValue = settings.decayHFRatio;
+        break;
+    case REVERB_PARAM_REFLECTIONS_LEVEL:
+        *(int16_t *)pValue = settings.reflectionsLevel;
+        break;
+    case REVERB_PARAM_REFLECTIONS_DELAY:
+        *(uint32_t *)pValue = settings.reflectionsDelay;
+        break;
+    case REVERB_PARAM_REVERB_LEVEL:
+        *(int16_t *)pValue = settings.reverbLevel;
+        break;
+    case REVERB_PARAM_REVERB_DELAY:
+        *(uint32_t *)pValue = settings.reverbDelay;
+        break;
+    case REVERB_PARAM_DIFFUSION:
+        *(int16_t *)pValue = settings.diffusion;
+        break;
+    case REVERB_PARAM_DENSITY:
+        *(int16_t *)pValue = settings.density;
+        break;
+    case REVERB_PARAM_PROPERTIES:
+        *(t_reverb_settings *)pValue = settings;
+        break;
+    default:
+        ALOGV("ConvReverb_getParameter() invalid param %d", param);
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static int ConvReverb_setParameter(ConvReverbContext *pContext, int32_t param,
+        uint32_t valueSize, void *pValue)
+{
+    if (pContext->mPreset) {
+        if (param != REVERB_PARAM_PRESET || valueSize < sizeof(uint16_t)) {
+            return -EINVAL;
+        }
+        uint16_t preset = *(uint16_t *)pValue;
+        ALOGV("set REVERB_PARAM_PRESET, preset %d", preset);
+        if (preset > REVERB_PRESET_LAST) {
+            return -EINVAL;
+        }
+        pContext->mNextPreset = preset;
+        return 0;
+    }
+
+    t_reverb_settings settings = pContext->mSettings;
+    switch (param) {
+    case REVERB_PARAM_DECAY_TIME:
+    case REVERB_PARAM_REFLECTIONS_DELAY:
+    case REVERB_PARAM_REVERB_DELAY:
+        if (valueSize < sizeof(uint32_t)) return -EINVAL;
+        break;
+    case REVERB_PARAM_PROPERTIES:
+        if (valueSize < sizeof(t_reverb_settings)) return -EINVAL;
+        break;
+    default:
+        if (valueSize < sizeof(int16_t)) return -EINVAL;
+        break;
+    }
+
+    switch (param) {
+    case REVERB_PARAM_ROOM_LEVEL:
+        settings.roomLevel = *(int16_t *)pValue;
+        break;
+    case REVERB_PARAM_ROOM_HF_LEVEL:
+        settings.roomHFLevel = *(int16_t *)pValue;
+        break;
+    case REVERB_PARAM_DECAY_TIME:
+        settings.decayTime = *(uint32_t *)pValue;
+        break;
+    case REVERB_PARAM_DECAY_HF_RATIO:
+        settings.decayHFRatio = *(int16_t *)pValue;
+        break;
+    case REVERB_PARAM_REFLECTIONS_LEVEL:
+        settings.reflectionsLevel = *(int16_t *)pValue;
+        break;
+    case REVERB_PARAM_REFLECTIONS_DELAY:
+        settings.reflectionsDelay = *(uint32_t *)pValue;
+        break;
+    case REVERB_PARAM_REVERB_LEVEL:
+        settings.reverbLevel = *(int16_t *)pValue;
+        break;
+    case REVERB_PARAM_REVERB_DELAY:
+        settings.reverbDelay = *(uint32_t *)pValue;
+        break;
+    case REVERB_PARAM_DIFFUSION:
+        settings.diffusion = *(int16_t *)pValue;
+        break;
+    case REVERB_PARAM_DENSITY:
+        settings.density = *(int16_t *)pValue;
+        break;
+    case REVERB_PARAM_PROPERTIES:
+        settings = *(t_reverb_settings *)pValue;
+        break;
+    default:
+        ALOGV("ConvReverb_setParameter() invalid param %d", param);
+        return -EINVAL;
+    }
+    if (!ConvReverb_validSettings(settings)) {
+        return -EINVAL;
+    }
+    pContext->mSettings = settings;
+    pContext->mImpulseDirty = true;
+    return 0;
+}
+
+//
+//--- Effect Library Interface Implementation
+//
+
+int ConvReverbLib_Create(const effect_uuid_t *uuid,
+                         int32_t sessionId __unused,
+                         int32_t ioId __unused,
+                         effect_handle_t *pHandle)
+{
+    ALOGV("ConvReverbLib_Create()");
+
+    if (pHandle == NULL || uuid == NULL) {
+        return -EINVAL;
+    }
+
+    const effect_descriptor_t *desc = NULL;
+    for (size_t i = 0; i < sizeof(gDescriptors) / sizeof(gDescriptors[0]); i++) {
+        if (memcmp(uuid, &gDescriptors[i]->uuid, sizeof(effect_uuid_t)) == 0) {
+            desc = gDescriptors[i];
+            break;
+        }
+    }
+    if (desc == NULL) {
+        return -ENOENT;
+    }
+
+    ConvReverbContext *pContext = new (std::nothrow) ConvReverbContext;
+    if (pContext == NULL) {
+        return -ENOMEM;
+    }
+    pContext->mItfe = &gConvReverbInterface;
+    pContext->mConvolver = NULL;
+    pContext->mAuxiliary =
+            (desc->flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_AUXILIARY;
+    pContext->mPreset = memcmp(&desc->type, SL_IID_PRESETREVERB, sizeof(effect_uuid_t)) == 0;
+    // force loading the preset at first call to process()
+    pContext->mCurPreset = REVERB_PRESET_LAST + 1;
+    pContext->mNextPreset = REVERB_PRESET_NONE;
+
+    int ret = ConvReverb_init(pContext);
+    if (ret < 0) {
+        ALOGW("ConvReverbLib_Create() init failed");
+        delete pContext->mConvolver;
+        delete pContext;
+        return ret;
+    }
+
+    *pHandle = (effect_handle_t)pContext;
+    ALOGV("  ConvReverbLib_Create context is %p", pContext);
+    return 0;
+}
+
+int ConvReverbLib_Release(effect_handle_t handle)
+{
+    ConvReverbContext *pContext = (ConvReverbContext *)handle;
+
+    ALOGV("ConvReverbLib_Release %p", handle);
+    if (pContext == NULL) {
+        return -EINVAL;
+    }
+    delete pContext->mConvolver;
+    delete pContext;
+    return 0;
+}
+
+int ConvReverbLib_GetDescriptor(const effect_uuid_t *uuid,
+                                effect_descriptor_t *pDescriptor)
+{
+    if (pDescriptor == NULL || uuid == NULL) {
+        ALOGV("ConvReverbLib_GetDescriptor() called with NULL pointer");
+        return -EINVAL;
+    }
+
+    for (size_t i = 0; i < sizeof(gDescriptors) / sizeof(gDescriptors[0]); i++) {
+        if (memcmp(uuid, &gDescriptors[i]->uuid, sizeof(effect_uuid_t)) == 0) {
+            *pDescriptor = *gDescriptors[i];
+            return 0;
+        }
+    }
+    return -EINVAL;
+}
+
+//
+//--- Effect Control Interface Implementation
+//
+
+int ConvReverb_process(effect_handle_t self, audio_buffer_t *inBuffer,
+        audio_buffer_t *outBuffer)
+{
+    ConvReverbContext *pContext = (ConvReverbContext *)self;
+
+    if (pContext == NULL) {
+        return -EINVAL;
+    }
+    if (inBuffer == NULL || inBuffer->raw == NULL ||
+            outBuffer == NULL || outBuffer->raw == NULL ||
+            inBuffer->frameCount != outBuffer->frameCount) {
+        return -EINVAL;
+    }
+    const size_t frameCount = outBuffer->frameCount;
+
+    if (!pContext->mEnabled && pContext->mSamplesToExitCount <= 0) {
+        return -ENODATA;
+    }
+
+    ConvReverb_updateImpulse(pContext);
+
+    // volume ramp over the whole buffer, as the LVM reverb
+    float leftVolume = pContext->mLeftVolume;
+    float rightVolume = pContext->mRightVolume;
+    float leftInc = 0.0f;
+    float rightInc = 0.0f;
+    if (pContext->mVolumeMode == CONV_REVERB_VOLUME_RAMP && frameCount > 0 &&
+            (pContext->mLeftVolume != pContext->mPrevLeftVolume ||
+            pContext->mRightVolume != pContext->mPrevRightVolume)) {
+        leftVolume = pContext->mPrevLeftVolume;
+        rightVolume = pContext->mPrevRightVolume;
+        leftInc = (pContext->mLeftVolume - leftVolume) / frameCount;
+        rightInc = (pContext->mRightVolume - rightVolume) / frameCount;
+    } else if (pContext->mVolumeMode != CONV_REVERB_VOLUME_OFF) {
+        pContext->mVolumeMode = CONV_REVERB_VOLUME_RAMP;
+    }
+    pContext->mPrevLeftVolume = pContext->mLeftVolume;
+    pContext->mPrevRightVolume = pContext->mRightVolume;
+
+    for (size_t offset = 0; offset < frameCount; ) {
+        size_t frames = frameCount - offset;
+        if (frames > android::PartitionedConvolver::kBlockFrames) {
+            frames = android::PartitionedConvolver::kBlockFrames;
+        }
+        ConvReverb_processChunk(pContext, inBuffer, outBuffer, offset, frames,
+                &leftVolume, &rightVolume, leftInc, rightInc);
+        offset += frames;
+    }
+
+    if (!pContext->mEnabled) {
+        pContext->mSamplesToExitCount -= frameCount;
+    }
+    return 0;
+}
+
+int ConvReverb_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
+        void *pCmdData, uint32_t *replySize, void *pReplyData)
+{
+    ConvReverbContext *pContext = (ConvReverbContext *)self;
+
+    if (pContext == NULL) {
+        return -EINVAL;
+    }
+
+    switch (cmdCode) {
+    case EFFECT_CMD_INIT:
+        if (pReplyData == NULL || replySize == NULL || *replySize != sizeof(int)) {
+            return -EINVAL;
+        }
+        *(int *) pReplyData = ConvReverb_init(pContext);
+        break;
+    case EFFECT_CMD_SET_CONFIG:
+        if (pCmdData == NULL || cmdSize != sizeof(effect_config_t)
+                || pReplyData == NULL || replySize == NULL || *replySize != sizeof(int)) {
+            return -EINVAL;
+        }
+        *(int *) pReplyData = ConvReverb_setConfig(pContext, (effect_config_t *) pCmdData);
+        break;
+    case EFFECT_CMD_GET_CONFIG:
+        if (pReplyData == NULL || replySize == NULL ||
+                *replySize != sizeof(effect_config_t)) {
+            return -EINVAL;
+        }
+        ConvReverb_getConfig(pContext, (effect_config_t *)pReplyData);
+        break;
+    case EFFECT_CMD_RESET:
+        pContext->mConvolver->reset();
+        break;
+    case EFFECT_CMD_ENABLE:
+        if (pReplyData == NULL || replySize == NULL || *replySize != sizeof(int)) {
+            return -EINVAL;
+        }
+        if (pContext->mEnabled) {
+            return -EINVAL;
+        }
+        pContext->mEnabled = true;
+        // force no volume ramp for first buffer processed after enabling the effect
+        pContext->mVolumeMode = CONV_REVERB_VOLUME_FLAT;
+        *(int *)pReplyData = 0;
+        break;
+    case EFFECT_CMD_DISABLE:
+        if (pReplyData == NULL || replySize == NULL || *replySize != sizeof(int)) {
+            return -EINVAL;
+        }
+        if (!pContext->mEnabled) {
+            return -EINVAL;
+        }
+        pContext->mEnabled = false;
+        pContext->mSamplesToExitCount = ConvReverb_exitFrames(pContext);
+        *(int *)pReplyData = 0;
+        break;
+    case EFFECT_CMD_GET_PARAM: {
+        effect_param_t *p = (effect_param_t *)pCmdData;
+        if (pCmdData == NULL || cmdSize < sizeof(effect_param_t)) {
+            return -EINVAL;
+        }
+        if (SIZE_MAX - sizeof(effect_param_t) < (size_t)p->psize) {
+            android_errorWriteLog(0x534e4554, "26347509");
+            return -EINVAL;
+        }
+        if (cmdSize < (sizeof(effect_param_t) + p->psize) ||
+                pReplyData == NULL || replySize == NULL ||
+                *replySize < (sizeof(effect_param_t) + p->psize) ||
+                p->psize != sizeof(int32_t)) {
+            return -EINVAL;
+        }
+        memcpy(pReplyData, pCmdData, sizeof(effect_param_t) + p->psize);
+        p = (effect_param_t *)pReplyData;
+        const uint32_t voffset = ((p->psize - 1) / sizeof(int32_t) + 1) * sizeof(int32_t);
+        p->vsize = *replySize - sizeof(effect_param_t) - voffset;
+        p->status = ConvReverb_getParameter(pContext, *(int32_t *)p->data,
+                &p->vsize, p->data + voffset);
+        if (p->status != 0) {
+            p->vsize = 0;
+        }
+        *replySize = sizeof(effect_param_t) + voffset + p->vsize;
+        } break;
+    case EFFECT_CMD_SET_PARAM: {
+        if (pCmdData == NULL || cmdSize < (sizeof(effect_param_t) + sizeof(int32_t)) ||
+                pReplyData == NULL || replySize == NULL || *replySize != sizeof(int32_t)) {
+            return -EINVAL;
+        }
+        effect_param_t *p = (effect_param_t *) pCmdData;
+        if (p->psize != sizeof(int32_t) ||
+                cmdSize < sizeof(effect_param_t) + p->psize + p->vsize) {
+            return -EINVAL;
+        }
+        *(int *)pReplyData = ConvReverb_setParameter(pContext, *(int32_t *)p->data,
+                p->vsize, p->data + p->psize);
+        } break;
+    case EFFECT_CMD_SET_VOLUME:
+        if (pCmdData == NULL || cmdSize != 2 * sizeof(uint32_t)) {
+            return -EINVAL;
+        }
+        if (pReplyData != NULL) { // we have volume control
+            pContext->mLeftVolume = *(uint32_t *)pCmdData / (float) (1 << 24);
+            pContext->mRightVolume = *((uint32_t *)pCmdData + 1) / (float) (1 << 24);
+            *(uint32_t *)pReplyData = (1 << 24);
+            *((uint32_t *)pReplyData + 1) = (1 << 24);
+            if (pContext->mVolumeMode == CONV_REVERB_VOLUME_OFF) {
+                // force no volume ramp for first buffer processed after getting volume control
+                pContext->mVolumeMode = CONV_REVERB_VOLUME_FLAT;
+            }
+        } else { // we don't have volume control
+            pContext->mLeftVolume = 1.0f;
+            pContext->mRightVolume = 1.0f;
+            pContext->mVolumeMode = CONV_REVERB_VOLUME_OFF;
+        }
+        break;
+    case EFFECT_CMD_SET_DEVICE:
+    case EFFECT_CMD_SET_AUDIO_MODE:
+        break;
+
+    default:
+        ALOGW("ConvReverb_command invalid command %d", cmdCode);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/* Effect Control Interface Implementation: get_descriptor */
+int ConvReverb_getDescriptor(effect_handle_t self, effect_descriptor_t *pDescriptor)
+{
+    ConvReverbContext *pContext = (ConvReverbContext *) self;
+
+    if (pContext == NULL || pDescriptor == NULL) {
+        ALOGV("ConvReverb_getDescriptor() invalid param");
+        return -EINVAL;
+    }
+
+    if (pContext->mAuxiliary) {
+        *pDescriptor = pContext->mPreset ? gAuxPresetReverbDescriptor : gAuxEnvReverbDescriptor;
+    } else {
+        *pDescriptor = pContext->mPreset ?
+                gInsertPresetReverbDescriptor : gInsertEnvReverbDescriptor;
+    }
+    return 0;
+}
+
+// effect_handle_t interface implementation for the convolution reverb
+const struct effect_interface_s gConvReverbInterface = {
+        ConvReverb_process,
+        ConvReverb_command,
+        ConvReverb_getDescriptor,
+        NULL,
+};
+
+// This is the only symbol that needs to be exported
+__attribute__ ((visibility ("default")))
+audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM = {
+    .tag = AUDIO_EFFECT_LIBRARY_TAG,
+    .version = EFFECT_LIBRARY_API_VERSION,
+    .name = "Convolution Reverb Library",
+    .implementor = "The Android Open Source Project",
+    .create_effect = ConvReverbLib_Create,
+    .release_effect = ConvReverbLib_Release,
+    .get_descriptor = ConvReverbLib_GetDescriptor,
+};
+
+}; // extern "C"
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "PartitionedConvolver.h"
+
+namespace android {
+
+RealFft::RealFft(size_t size)
+    : mSize(size), mHalf(size / 2),
+      mBitReverse(mHalf), mTwiddles(mHalf / 2), mSplit(mHalf + 1), mWork(mHalf)
+{
+    unsigned bits = 0;
+    while (((size_t) 1 << bits) < mHalf) {
+        bits++;
+    }
+    for (size_t i = 0; i < mHalf; i++) {
+        uint32_t reversed = 0;
+        for (unsigned b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        mBitReverse[i] = reversed;
+    }
+    for (size_t k = 0; k < mHalf / 2; k++) {
+        const double phase = -2 * M_PI * k / mHalf;
+        mTwiddles[k] = std::complex<float>(cos(phase), sin(phase));
+    }
+    for (size_t k = 0; k <= mHalf; k++) {
+        const double phase = -2 * M_PI * k / mSize;
+        mSplit[k] = std::complex<float>(cos(phase), sin(phase));
+    }
+}
+
+// in place radix 2 FFT of mWork, whose elements are in bit reversed order
+void RealFft::transform(bool inverse)
+{
+    std::complex<float> *a = mWork.data();
+    for (size_t length = 2; length <= mHalf; length <<= 1) {
+        const size_t half = length / 2;
+        const size_t step = mHalf / length;
+        for (size_t i = 0; i < mHalf; i += length) {
+            for (size_t j = 0; j < half; j++) {
+                const std::complex<float> w =
+                        inverse ? std::conj(mTwiddles[j * step]) : mTwiddles[j * step];
+                const std::complex<float> u = a[i + j];
+                const std::complex<float> v = a[i + j + half] * w;
+                a[i + j] = u + v;
+                a[i + j + half] = u - v;
+            }
+        }
+    }
+}
+
+void RealFft::forward(const float *x, float *re, float *im)
+{
+    // even samples in the real part, odd samples in the imaginary part
+    for (size_t n = 0; n < mHalf; n++) {
+        mWork[mBitReverse[n]] = std::complex<float>(x[2 * n], x[2 * n + 1]);
+    }
+    transform(false /*inverse*/);
+
+    // X[k] = E[k] + exp(-2 pi i k / N) O[k], with E and O the spectra of the even and odd
+    // samples: E[k] = (Z[k] + conj(Z[M - k])) / 2, O[k] = (Z[k] - conj(Z[M - k])) / 2i
+    re[0] = mWork[0].real() + mWork[0].imag();
+    im[0] = 0;
+    re[mHalf] = mWork[0].real() - mWork[0].imag();
+    im[mHalf] = 0;
+    for (size_t k = 1; k < mHalf; k++) {
+        const std::complex<float> z = mWork[k];
+        const std::complex<float> zc = std::conj(mWork[mHalf - k]);
+        const std::complex<float> even = 0.5f * (z + zc);
+        const std::complex<float> odd = std::complex<float>(0, -0.5f) * (z - zc);
+        const std::complex<float> bin = even + mSplit[k] * odd;
+        re[k] = bin.real();
+        im[k] = bin.imag();
+    }
+}
+
+void RealFft::inverse(const float *re, const float *im, float *x)
+{
+    // Z[k] = 2 (E[k] + i O[k]): the scale and the 1 / M of the inverse FFT are left out
+    for (size_t k = 0; k < mHalf; k++) {
+        const std::complex<float> bin(re[k], im[k]);
+        const std::complex<float> binc(re[mHalf - k], -im[mHalf - k]);
+        const std::complex<float> even = bin + binc;
+        const std::complex<float> odd = (bin - binc) * std::conj(mSplit[k]);
+        mWork[mBitReverse[k]] = even + std::complex<float>(0, 1) * odd;
+    }
+    transform(true /*inverse*/);
+    for (size_t n = 0; n < mHalf; n++) {
+        x[2 * n] = mWork[n].real();
+        x[2 * n + 1] = mWork[n].imag();
+    }
+}
+
+PartitionedConvolver::PartitionedConvolver(size_t maxImpulseFrames)
+    : mFft(2 * kBlockFrames),
+      mBins(kBlockFrames + 1),
+      mMaxPartitions(maxImpulseFrames > kBlockFrames ?
+              (maxImpulseFrames + kBlockFrames - 1) / kBlockFrames : 1),
+      mPartitions(0),
+      mSkippedFrames(0),
+      mInputSpectra(mMaxPartitions * 2 * mBins),
+      mInputHead(0),
+      mTime(2 * kBlockFrames),
+      mAccumulators(2 * 2 * mBins),
+      mScratch(2 * kBlockFrames),
+      mOutput(2 * kBlockFrames),
+      mFill(0)
+{
+    mFilters[0].resize(mMaxPartitions * 2 * mBins);
+    mFilters[1].resize(mMaxPartitions * 2 * mBins);
+}
+
+void PartitionedConvolver::setImpulseResponse(const float *left, const float *right,
+                                              size_t frames)
+{
+    // The silence at the start of the impulse response stands for the block latency
+    size_t skipped = 0;
+    while (skipped < frames && skipped < kBlockFrames &&
+            left[skipped] == 0 && right[skipped] == 0) {
+        skipped++;
+    }
+    frames -= skipped;
+    if (frames > maxImpulseFrames()) {
+        frames = maxImpulseFrames();
+    }
+    mSkippedFrames = skipped;
+    mPartitions = (frames + kBlockFrames - 1) / kBlockFrames;
+
+    // scale the filters for the inverse FFT
+    const float scale = 1.0f / mFft.size();
+    const float *channels[2] = { left + skipped, right + skipped };
+    for (int ch = 0; ch < 2; ch++) {
+        for (size_t p = 0; p < mPartitions; p++) {
+            const size_t offset = p * kBlockFrames;
+            const size_t count = frames - offset < kBlockFrames ? frames - offset : kBlockFrames;
+            for (size_t i = 0; i < count; i++) {
+                mScratch[i] = channels[ch][offset + i] * scale;
+            }
+            memset(&mScratch[count], 0, (mScratch.size() - count) * sizeof(float));
+            float *filter = &mFilters[ch][p * 2 * mBins];
+            mFft.forward(mScratch.data(), filter, filter + mBins);
+        }
+    }
+}
+
+void PartitionedConvolver::process(const float *in, float *out, size_t frames)
+{
+    while (frames > 0) {
+        size_t count = kBlockFrames - mFill;
+        if (count > frames) {
+            count = frames;
+        }
+        memcpy(&mTime[kBlockFrames + mFill], in, count * sizeof(float));
+        memcpy(out, &mOutput[2 * mFill], count * 2 * sizeof(float));
+        mFill += count;
+        in += count;
+        out += 2 * count;
+        frames -= count;
+        if (mFill == kBlockFrames) {
+            processBlock();
+            mFill = 0;
+        }
+    }
+}
+
+void PartitionedConvolver::processBlock()
+{
+    float *spectrum = &mInputSpectra[mInputHead * 2 * mBins];
+    mFft.forward(mTime.data(), spectrum, spectrum + mBins);
+    // overlap-save: the current block is the previous block of the next FFT
+    memcpy(&mTime[0], &mTime[kBlockFrames], kBlockFrames * sizeof(float));
+
+    float *leftRe = &mAccumulators[0];
+    float *leftIm = leftRe + mBins;
+    float *rightRe = leftIm + mBins;
+    float *rightIm = rightRe + mBins;
+    memset(leftRe, 0, mAccumulators.size() * sizeof(float));
+    size_t slot = mInputHead;
+    for (size_t p = 0; p < mPartitions; p++) {
+        const float *xRe = &mInputSpectra[slot * 2 * mBins];
+        const float *xIm = xRe + mBins;
+        const float *lRe = &mFilters[0][p * 2 * mBins];
+        const float *lIm = lRe + mBins;
+        const float *rRe = &mFilters[1][p * 2 * mBins];
+        const float *rIm = rRe + mBins;
+        for (size_t k = 0; k < mBins; k++) {
+            leftRe[k] += xRe[k] * lRe[k] - xIm[k] * lIm[k];
+            leftIm[k] += xRe[k] * lIm[k] + xIm[k] * lRe[k];
+            rightRe[k] += xRe[k] * rRe[k] - xIm[k] * rIm[k];
+            rightIm[k] += xRe[k] * rIm[k] + xIm[k] * rRe[k];
+        }
+        slot = (slot == 0 ? mMaxPartitions : slot) - 1;
+    }
+    mInputHead = (mInputHead + 1 == mMaxPartitions) ? 0 : mInputHead + 1;
+
+    // the second half of each inverse FFT is the linear convolution of the current block
+    mFft.inverse(leftRe, leftIm, mScratch.data());
+    for (size_t i = 0; i < kBlockFrames; i++) {
+        mOutput[2 * i] = mScratch[kBlockFrames + i];
+    }
+    mFft.inverse(rightRe, rightIm, mScratch.data());
+    for (size_t i = 0; i < kBlockFrames; i++) {
+        mOutput[2 * i + 1] = mScratch[kBlockFrames + i];
+    }
+}
+
+void PartitionedConvolver::reset()
+{
+    memset(mInputSpectra.data(), 0, mInputSpectra.size() * sizeof(float));
+    memset(mTime.data(), 0, mTime.size() * sizeof(float));
+    memset(mOutput.data(), 0, mOutput.size() * sizeof(float));
+    mFill = 0;
+}
+
+}   // namespace android
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PARTITIONED_CONVOLVER_H
+#define ANDROID_PARTITIONED_CONVOLVER_H
+
+#include <complex>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace android {
+
+// Real FFT of a power of 2 size N, computed with a complex FFT of size N/2.
+// Spectra are the N/2 + 1 bins from 0 to the Nyquist frequency, in separate real and
+// imaginary arrays.
+class RealFft {
+public:
+    explicit RealFft(size_t size);
+
+    size_t size() const { return mSize; }
+    size_t bins() const { return mHalf + 1; }
+
+    // x has size() samples, re and im have bins() values.
+    void forward(const float *x, float *re, float *im);
+
+    // Inverse of forward(), scaled by size(): inverse(forward(x)) is x * size().
+    void inverse(const float *re, const float *im, float *x);
+
+private:
+    void transform(bool inverse);
+
+    const size_t                        mSize;
+    const size_t                        mHalf;      // size of the complex FFT
+    std::vector<uint32_t>               mBitReverse;
+    std::vector<std::complex<float> >   mTwiddles;  // exp(-2 pi i k / mHalf), k < mHalf / 2
+    std::vector<std::complex<float> >   mSplit;     // exp(-2 pi i k / mSize), k <= mHalf
+    std::vector<std::complex<float> >   mWork;
+};
+
+// Uniformly partitioned convolution of a mono signal with a stereo impulse response.
+//
+// The impulse response is cut into partitions of kBlockFrames frames, and the input into
+// blocks of the same size.  Each input block is transformed once (overlap-save, FFT of
+// 2 * kBlockFrames), multiplied with the spectra of all partitions in a frequency domain
+// delay line, and each output channel is transformed back once.  The cost per frame is thus
+// one forward and two inverse FFTs per block plus one complex multiply-add per bin and
+// partition: it depends on the length of the impulse response only, not on its content.
+//
+// Processing is block based: the output is delayed by kBlockFrames frames, minus the silent
+// frames at the start of the impulse response, up to kBlockFrames, which are skipped.
+//
+// Not thread safe.  Only setImpulseResponse() and process() are real time safe: all buffers
+// are allocated by the constructor for maxImpulseFrames.
+class PartitionedConvolver {
+public:
+    static const size_t kBlockFrames = 512;
+
+    explicit PartitionedConvolver(size_t maxImpulseFrames);
+
+    size_t maxImpulseFrames() const { return mMaxPartitions * kBlockFrames; }
+
+    // Replaces the impulse response.  Both channels have frames samples, frames is clipped to
+    // maxImpulseFrames().  The input history is kept so that the switch does not interrupt
+    // the output.
+    void setImpulseResponse(const float *left, const float *right, size_t frames);
+
+    // Filters frames mono samples of in into frames stereo interleaved frames to out.
+    void process(const float *in, float *out, size_t frames);
+
+    // Clears the input and output history.
+    void reset();
+
+private:
+    void processBlock();
+
+    RealFft             mFft;
+    const size_t        mBins;
+    const size_t        mMaxPartitions;
+    size_t              mPartitions;        // partitions of the current impulse response
+    size_t              mSkippedFrames;     // leading silence removed from the impulse response
+
+    // spectra are stored as mBins real parts followed by mBins imaginary parts
+    std::vector<float>  mFilters[2];        // mMaxPartitions spectra per channel
+    std::vector<float>  mInputSpectra;      // frequency domain delay line of mMaxPartitions spectra
+    size_t              mInputHead;         // most recent spectrum in mInputSpectra
+
+    std::vector<float>  mTime;              // FFT size: previous and current input blocks
+    std::vector<float>  mAccumulators;      // one spectrum per channel
+    std::vector<float>  mScratch;           // FFT size
+    std::vector<float>  mOutput;            // stereo interleaved output block
+    size_t              mFill;              // frames of the current block received so far
+};
+
+}   // namespace android
+
+#endif  // ANDROID_PARTITIONED_CONVOLVER_H
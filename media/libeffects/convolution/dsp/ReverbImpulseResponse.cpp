@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "ReverbImpulseResponse.h"
+
+namespace android {
+
+namespace {
+
+// crossover between the low and high frequency decays
+const float kCrossoverHz = 5000.0f;
+// part of the tail faded out when the decay time is longer than kReverbMaxDecayMs
+const float kFadeOutRatio = 0.125f;
+// the shortest interval over which the early reflections are spread
+const uint32_t kMinReflectionsMs = 10;
+
+// deterministic noise, so that the same settings always render the same impulse response
+class Random {
+public:
+    explicit Random(uint32_t seed) : mState(seed) {}
+
+    // uniform in [0, 1)
+    float next() {
+        mState = mState * 1664525u + 1013904223u;
+        return (mState >> 8) * (1.0f / (1 << 24));
+    }
+
+private:
+    uint32_t mState;
+};
+
+inline float millibelsToGain(int32_t millibels)
+{
+    return powf(10.0f, millibels / 2000.0f);
+}
+
+inline size_t msToFrames(uint32_t ms, uint32_t sampleRate)
+{
+    return (size_t) ((uint64_t) ms * sampleRate / 1000);
+}
+
+size_t tailFrames(const t_reverb_settings &settings, uint32_t sampleRate)
+{
+    uint32_t decayMs = settings.decayTime;
+    if (decayMs > kReverbMaxDecayMs) {
+        decayMs = kReverbMaxDecayMs;
+    }
+    return msToFrames(decayMs, sampleRate);
+}
+
+void renderReflections(const t_reverb_settings &settings, uint32_t sampleRate, uint32_t seed,
+                       float *ir, size_t frames)
+{
+    const size_t start = msToFrames(settings.reflectionsDelay, sampleRate);
+    uint32_t spreadMs = settings.reverbDelay;
+    if (spreadMs < kMinReflectionsMs) {
+        spreadMs = kMinReflectionsMs;
+    }
+    const size_t spread = msToFrames(spreadMs, sampleRate);
+    const int taps = 4 + settings.density * 12 / 1000;
+    const float gain = millibelsToGain(settings.roomLevel + settings.reflectionsLevel);
+
+    Random random(seed);
+    for (int i = 0; i < taps; i++) {
+        // one tap per interval, decreasing linearly in level
+        const size_t position = start + (size_t) (spread * (i + random.next()) / taps);
+        const float sign = random.next() < 0.5f ? -1.0f : 1.0f;
+        if (position < frames) {
+            ir[position] += sign * gain * (1.0f - 0.5f * i / taps);
+        }
+    }
+}
+
+void renderTail(const t_reverb_settings &settings, uint32_t sampleRate, uint32_t seed,
+                float *ir, size_t frames)
+{
+    // the sparser the noise, the less diffuse the tail
+    const float probability = 0.1f + 0.9f * settings.diffusion / 1000.0f;
+    const float amplitude = 1.0f / sqrtf(probability);
+    const float lowpass = 1.0f - expf(-2.0f * (float) M_PI * kCrossoverHz / sampleRate);
+
+    // decay of 60 dB in decayTime for the low band, decayTime * decayHFRatio for the high band
+    const float decayFrames = (float) settings.decayTime * sampleRate / 1000.0f;
+    const float hfDecayFrames = decayFrames * settings.decayHFRatio / 1000.0f;
+    const float lowDecay = powf(10.0f, -3.0f / (decayFrames > 1.0f ? decayFrames : 1.0f));
+    const float highDecay = powf(10.0f, -3.0f / (hfDecayFrames > 1.0f ? hfDecayFrames : 1.0f));
+    const float highGain = millibelsToGain(settings.roomHFLevel);
+
+    Random random(seed);
+    float low = 0.0f;
+    float lowEnvelope = 1.0f;
+    float highEnvelope = highGain;
+    double energy = 0.0;
+    for (size_t i = 0; i < frames; i++) {
+        float noise = 0.0f;
+        if (random.next() < probability) {
+            noise = random.next() < 0.5f ? -amplitude : amplitude;
+        }
+        low += lowpass * (noise - low);
+        const float sample = low * lowEnvelope + (noise - low) * highEnvelope;
+        ir[i] = sample;
+        energy += sample * sample;
+        lowEnvelope *= lowDecay;
+        highEnvelope *= highDecay;
+    }
+
+    // fade out the tail if it was truncated
+    if (settings.decayTime > kReverbMaxDecayMs) {
+        const size_t fadeFrames = (size_t) (frames * kFadeOutRatio);
+        for (size_t i = 0; i < fadeFrames; i++) {
+            ir[frames - 1 - i] *= (float) i / fadeFrames;
+        }
+    }
+
+    // unit energy tail scaled by the reverb level
+    if (energy > 0.0) {
+        const float gain = millibelsToGain(settings.roomLevel + settings.reverbLevel) /
+                sqrt(energy);
+        for (size_t i = 0; i < frames; i++) {
+            ir[i] *= gain;
+        }
+    }
+}
+
+}   // namespace
+
+size_t reverbMaxImpulseFrames(uint32_t sampleRate)
+{
+    return msToFrames(kReverbMaxPreDelayMs + kReverbMaxDecayMs, sampleRate);
+}
+
+size_t reverbImpulseFrames(const t_reverb_settings &settings, uint32_t sampleRate)
+{
+    uint32_t preDelayMs = settings.reflectionsDelay + settings.reverbDelay;
+    if (preDelayMs > kReverbMaxPreDelayMs) {
+        preDelayMs = kReverbMaxPreDelayMs;
+    }
+    return msToFrames(preDelayMs, sampleRate) + tailFrames(settings, sampleRate);
+}
+
+void renderReverbImpulse(const t_reverb_settings &settings, uint32_t sampleRate,
+                         float *left, float *right)
+{
+    const size_t frames = reverbImpulseFrames(settings, sampleRate);
+    const size_t tail = tailFrames(settings, sampleRate);
+    const size_t tailStart = frames - tail;
+    float *channels[2] = { left, right };
+    // different noise on each channel decorrelates the output
+    const uint32_t seeds[2] = { 0x2545f491, 0x9e3779b9 };
+
+    for (int ch = 0; ch < 2; ch++) {
+        memset(channels[ch], 0, frames * sizeof(float));
+        renderTail(settings, sampleRate, seeds[ch], channels[ch] + tailStart, tail);
+        renderReflections(settings, sampleRate, seeds[ch] + 1, channels[ch], frames);
+    }
+}
+
+}   // namespace android
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_REVERB_IMPULSE_RESPONSE_H
+#define ANDROID_REVERB_IMPULSE_RESPONSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <audio_effects/effect_environmentalreverb.h>
+
+namespace android {
+
+// Longest decay rendered in the impulse response: longer decay times are faded out.
+static const uint32_t kReverbMaxDecayMs = 3000;
+// Longest reflections delay plus reverb delay allowed by OpenSL ES.
+static const uint32_t kReverbMaxPreDelayMs = 300 + 100;
+
+// Frames of the longest impulse response for the sample rate.
+size_t reverbMaxImpulseFrames(uint32_t sampleRate);
+
+// Frames of the impulse response for the environmental reverb settings.
+size_t reverbImpulseFrames(const t_reverb_settings &settings, uint32_t sampleRate);
+
+// Renders the stereo impulse response of the settings: sparse early reflections starting at
+// reflectionsDelay, followed reverbDelay later by an exponentially decaying noise tail.
+// Density sets the number of reflections and diffusion the density of the tail; the tail is
+// split in two bands that decay in decayTime and decayTime * decayHFRatio.
+// left and right have reverbImpulseFrames(settings, sampleRate) frames.
+void renderReverbImpulse(const t_reverb_settings &settings, uint32_t sampleRate,
+                         float *left, float *right);
+
+}   // namespace android
+
+#endif  // ANDROID_REVERB_IMPULSE_RESPONSE_H
@@ -29,6 +29,7 @@
 //#define DOWNMIX_ALWAYS_USE_GENERIC_DOWNMIXER 0
 
 #define MINUS_3_DB_IN_Q19_12 2896 // -3dB = 0.707 * 2^12 = 2896
+#define MINUS_3_DB_FLOAT 0.70710678f
 
 // subset of possible audio_channel_mask_t values, and AUDIO_CHANNEL_OUT_* renamed to CHANNEL_MASK_*
 typedef enum {
@@ -321,6 +322,27 @@ static int Downmix_Process(effect_handle_t self,
             (pDwmModule->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE);
     const uint32_t downmixInputChannelMask = pDwmModule->config.inputCfg.channels;
 
+    if (pDwmModule->config.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT) {
+        switch(pDownmixer->type) {
+          case DOWNMIX_TYPE_STRIP:
+              Downmix_stripFloat((const float *)inBuffer->raw, (float *)outBuffer->raw,
+                      pDownmixer->input_channel_count, numFrames, accumulate);
+              break;
+          case DOWNMIX_TYPE_FOLD:
+              if (!Downmix_foldGenericFloat(downmixInputChannelMask,
+                      (const float *)inBuffer->raw, (float *)outBuffer->raw,
+                      numFrames, accumulate)) {
+                  ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported",
+                          downmixInputChannelMask);
+                  return -EINVAL;
+              }
+              break;
+          default:
+              return -EINVAL;
+        }
+        return 0;
+    }
+
     switch(pDownmixer->type) {
 
       case DOWNMIX_TYPE_STRIP:
@@ -640,8 +662,9 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
     // Check configuration compatibility with build options, and effect capabilities
     if (pConfig->inputCfg.samplingRate != pConfig->outputCfg.samplingRate
         || pConfig->outputCfg.channels != DOWNMIX_OUTPUT_CHANNELS
-        || pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT
-        || pConfig->outputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+        || (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT
+                && pConfig->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT)
+        || pConfig->outputCfg.format != pConfig->inputCfg.format) {
         ALOGE("Downmix_Configure error: invalid config");
         return -EINVAL;
     }
@@ -1090,3 +1113,127 @@ bool Downmix_foldGeneric(
     }
     return true;
 }
+
+
+/*----------------------------------------------------------------------------
+ * Downmix_stripFloat()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * keep the front left and right channels of a float multichannel signal
+ *
+ * Inputs:
+ *  pSrc       multichannel audio buffer to strip
+ *  numChan    the number of channels of pSrc
+ *  numFrames  the number of multichannel frames to strip
+ *  accumulate whether to mix (when true) the result with the contents of pDst,
+ *               or overwrite pDst (when false)
+ *
+ * Outputs:
+ *  pDst       stereo audio samples
+ *
+ *----------------------------------------------------------------------------
+ */
+void Downmix_stripFloat(
+        const float *pSrc, float *pDst, size_t numChan, size_t numFrames, bool accumulate) {
+    if (accumulate) {
+        while (numFrames) {
+            pDst[0] += pSrc[0];
+            pDst[1] += pSrc[1];
+            pSrc += numChan;
+            pDst += 2;
+            numFrames--;
+        }
+    } else {
+        while (numFrames) {
+            pDst[0] = pSrc[0];
+            pDst[1] = pSrc[1];
+            pSrc += numChan;
+            pDst += 2;
+            numFrames--;
+        }
+    }
+}
+
+
+/*----------------------------------------------------------------------------
+ * Downmix_foldGenericFloat()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * float version of Downmix_foldGeneric(), for any supported channel mask
+ * including the common ones enumerated in downmix_input_channel_mask_t.
+ * Samples are not clamped: the downmixed stereo signal keeps the headroom
+ * of the float format until the end of the effect chain.
+ *
+ * Inputs:
+ *  mask       the channel mask of pSrc
+ *  pSrc       multichannel audio buffer to downmix
+ *  numFrames  the number of multichannel frames to downmix
+ *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
+ *               or overwrite pDst (when false)
+ *
+ * Outputs:
+ *  pDst       downmixed stereo audio samples
+ *
+ * Returns: false if multichannel format is not supported
+ *
+ *----------------------------------------------------------------------------
+ */
+bool Downmix_foldGenericFloat(
+        uint32_t mask, const float *pSrc, float *pDst, size_t numFrames, bool accumulate) {
+
+    if (!Downmix_validChannelMask(mask)) {
+        return false;
+    }
+
+    const bool hasSides = (mask & kSides) != 0;
+    const bool hasBacks = (mask & kBacks) != 0;
+
+    const int numChan = audio_channel_count_from_out_mask(mask);
+    const bool hasFC = ((mask & AUDIO_CHANNEL_OUT_FRONT_CENTER) == AUDIO_CHANNEL_OUT_FRONT_CENTER);
+    const bool hasLFE =
+            ((mask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY) == AUDIO_CHANNEL_OUT_LOW_FREQUENCY);
+    const bool hasBC = ((mask & AUDIO_CHANNEL_OUT_BACK_CENTER) == AUDIO_CHANNEL_OUT_BACK_CENTER);
+    // same channel order and indexing as Downmix_foldGeneric()
+    const int indexFC  = hasFC    ? 2            : 1;        // front center
+    const int indexLFE = hasLFE   ? indexFC + 1  : indexFC;  // low frequency
+    const int indexBL  = hasBacks ? indexLFE + 1 : indexLFE; // back left
+    const int indexBR  = hasBacks ? indexBL + 1  : indexBL;  // back right
+    const int indexBC  = hasBC    ? indexBR + 1  : indexBR;  // back center
+    const int indexSL  = hasSides ? indexBC + 1  : indexBC;  // side left
+    const int indexSR  = hasSides ? indexSL + 1  : indexSL;  // side right
+
+    while (numFrames) {
+        // compute contribution of FC, BC and LFE
+        float centersLfeContrib = 0;
+        if (hasFC)  { centersLfeContrib += pSrc[indexFC]; }
+        if (hasLFE) { centersLfeContrib += pSrc[indexLFE]; }
+        if (hasBC)  { centersLfeContrib += pSrc[indexBC]; }
+        centersLfeContrib *= MINUS_3_DB_FLOAT;
+        // always has FL/FR
+        float lt = pSrc[0];
+        float rt = pSrc[1];
+        // mix in sides and backs
+        if (hasSides) {
+            lt += pSrc[indexSL];
+            rt += pSrc[indexSR];
+        }
+        if (hasBacks) {
+            lt += pSrc[indexBL];
+            rt += pSrc[indexBR];
+        }
+        lt += centersLfeContrib;
+        rt += centersLfeContrib;
+        // same -6dB scaling as the Q19.12 versions
+        if (accumulate) {
+            pDst[0] += lt * 0.5f;
+            pDst[1] += rt * 0.5f;
+        } else {
+            pDst[0] = lt * 0.5f;
+            pDst[1] = rt * 0.5f;
+        }
+        pSrc += numChan;
+        pDst += 2;
+        numFrames--;
+    }
+    return true;
+}
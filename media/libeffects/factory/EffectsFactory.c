@@ -18,9 +18,13 @@
 //#define LOG_NDEBUG 0
 
 #include "EffectsFactory.h"
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <dlfcn.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <cutils/misc.h>
 #include <cutils/config_utils.h>
@@ -44,6 +48,46 @@ static int gInitDone; // true is global initialization has been preformed
 static int gCanQueryEffect; // indicates that call to EffectQueryEffect() is valid, i.e. that the list of effects
                           // was not modified since last call to EffectQueryNumberEffects()
 
+// The descriptors returned by the effect libraries are cached in a file so that a library
+// is only opened when one of its effects is created. The cache is written after the first boot
+// (or after any library or the build changes) and is only trusted for a library whose file
+// is unchanged since the descriptors were queried.
+#ifdef __LP64__
+#define DESCRIPTOR_CACHE_FILE "/data/misc/audioserver/effects_descriptors64.cache"
+#else
+#define DESCRIPTOR_CACHE_FILE "/data/misc/audioserver/effects_descriptors.cache"
+#endif
+#define DESCRIPTOR_CACHE_MAGIC   0x43444645  // 'EFDC'
+#define DESCRIPTOR_CACHE_VERSION 1
+#define PROPERTY_BUILD_FINGERPRINT "ro.build.fingerprint"
+
+typedef struct desc_cache_header_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t descSize;      // sizeof(effect_descriptor_t)
+    uint32_t numLibs;
+    char fingerprint[PROPERTY_VALUE_MAX];
+} desc_cache_header_t;
+
+// one per library, followed in the file by pathLen bytes of path and numDescs descriptors
+typedef struct desc_cache_lib_header_s {
+    uint32_t pathLen;       // including the terminating NUL
+    uint32_t numDescs;
+    int64_t mtime;
+    uint64_t size;
+    uint64_t ino;
+} desc_cache_lib_header_t;
+
+typedef struct desc_cache_lib_s {
+    desc_cache_lib_header_t hdr;
+    char *path;
+    effect_descriptor_t *descs;
+    int used;               // library listed in the configuration file
+} desc_cache_lib_t;
+
+static list_elem_t *gDescriptorCache; // list of desc_cache_lib_t: only valid during init()
+static int gDescriptorCacheDirty;    // the cache file must be rewritten at the end of init()
+
 
 /////////////////////////////////////////////////
 //      Local functions prototypes
@@ -53,6 +97,14 @@ static int init();
 static int loadEffectConfigFile(const char *path);
 static int loadLibraries(cnode *root);
 static int loadLibrary(cnode *root, const char *name);
+static int openLibrary(lib_entry_t *l);
+static int openSubEffectLibraries(const effect_uuid_t *uuid);
+static int queryDescriptor(lib_entry_t *l, const effect_uuid_t *uuid, effect_descriptor_t *desc);
+static void readDescriptorCache();
+static void writeDescriptorCache();
+static void freeDescriptorCache();
+static desc_cache_lib_t *getCachedLibrary(const char *path, const struct stat *st);
+static void addCachedLibrary(const char *path, const struct stat *st);
 static int loadEffects(cnode *root);
 static int loadEffect(cnode *node);
 // To get and add the effect pointed by the passed node to the gSubEffectList
@@ -306,6 +358,18 @@ int EffectCreate(const effect_uuid_t *uuid, int32_t sessionId, int32_t ioId, eff
         }
     }
 
+    // libraries known from the descriptor cache are only opened now, along with the libraries
+    // of the sub effects the effect will query with EffectGetSubEffects()
+    ret = openLibrary(l);
+    if (ret == 0) {
+        ret = openSubEffectLibraries(uuid);
+    }
+    if (ret < 0) {
+        // do not trust the cache on next boot
+        unlink(DESCRIPTOR_CACHE_FILE);
+        goto exit;
+    }
+
     // create effect in library
     ret = l->desc->create_effect(uuid, sessionId, ioId, &itfe);
     if (ret != 0) {
@@ -427,6 +491,10 @@ int EffectGetSubEffects(const effect_uuid_t *uuid, sub_effect_entry_t **pSube,
            list_elem_t *subefx = e->sub_elem;
            while (subefx != NULL) {
                subeffect = (sub_effect_entry_t*)subefx->object;
+               if (subeffect->lib->desc == NULL) {
+                   ALOGW("EffectGetSubEffects: library %s not loaded", subeffect->lib->name);
+                   return -ENODEV;
+               }
                pSube[count++] = subeffect;
                subefx = subefx->next;
            }
@@ -456,11 +524,16 @@ int init() {
     if (ignoreFxConfFiles) {
         ALOGI("Audio effects in configuration files will be ignored");
     } else {
+        readDescriptorCache();
         if (access(AUDIO_EFFECT_VENDOR_CONFIG_FILE, R_OK) == 0) {
             loadEffectConfigFile(AUDIO_EFFECT_VENDOR_CONFIG_FILE);
         } else if (access(AUDIO_EFFECT_DEFAULT_CONFIG_FILE, R_OK) == 0) {
             loadEffectConfigFile(AUDIO_EFFECT_DEFAULT_CONFIG_FILE);
         }
+        if (gDescriptorCacheDirty) {
+            writeDescriptorCache();
+        }
+        freeDescriptorCache();
     }
 
     updateNumEffects();
@@ -508,10 +581,9 @@ int loadLibraries(cnode *root)
 int loadLibrary(cnode *root, const char *name)
 {
     cnode *node;
-    void *hdl;
-    audio_effect_library_t *desc;
     list_elem_t *e;
     lib_entry_t *l;
+    struct stat st;
     char path[PATH_MAX];
     char *str;
     size_t len;
@@ -534,46 +606,79 @@ int loadLibrary(cnode *root, const char *name)
     if (strlen(path) >= PATH_MAX - 1)
         return -EINVAL;
 
-    hdl = dlopen(path, RTLD_NOW);
-    if (hdl == NULL) {
+    if (stat(path, &st) != 0) {
         ALOGW("loadLibrary() failed to open %s", path);
+        return -EINVAL;
+    }
+
+    l = malloc(sizeof(lib_entry_t));
+    l->name = strndup(name, PATH_MAX);
+    l->path = strndup(path, PATH_MAX);
+    l->handle = NULL;
+    l->desc = NULL;
+    l->effects = NULL;
+    pthread_mutex_init(&l->lock, NULL);
+
+    // a library already seen with the same file is opened when one of its effects is created
+    if (getCachedLibrary(path, &st) == NULL) {
+        if (openLibrary(l) != 0) {
+            free(l->name);
+            free(l->path);
+            free(l);
+            return -EINVAL;
+        }
+        addCachedLibrary(path, &st);
+    }
+
+    // add entry for library in gLibraryList
+    e = malloc(sizeof(list_elem_t));
+    e->object = l;
+    pthread_mutex_lock(&gLibLock);
+    e->next = gLibraryList;
+    gLibraryList = e;
+    pthread_mutex_unlock(&gLibLock);
+    ALOGV("getLibrary() linked library %p for path %s%s", l, path,
+            l->handle == NULL ? " (not loaded)" : "");
+
+    return 0;
+}
+
+// Opens the library if not done yet. Called from init() or with gLibLock held.
+int openLibrary(lib_entry_t *l)
+{
+    void *hdl;
+    audio_effect_library_t *desc;
+
+    if (l->handle != NULL) {
+        return 0;
+    }
+
+    hdl = dlopen(l->path, RTLD_NOW);
+    if (hdl == NULL) {
+        ALOGW("openLibrary() failed to open %s", l->path);
         goto error;
     }
 
     desc = (audio_effect_library_t *)dlsym(hdl, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
     if (desc == NULL) {
-        ALOGW("loadLibrary() could not find symbol %s", AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+        ALOGW("openLibrary() could not find symbol %s", AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
         goto error;
     }
 
     if (AUDIO_EFFECT_LIBRARY_TAG != desc->tag) {
-        ALOGW("getLibrary() bad tag %08x in lib info struct", desc->tag);
+        ALOGW("openLibrary() bad tag %08x in lib info struct", desc->tag);
         goto error;
     }
 
     if (EFFECT_API_VERSION_MAJOR(desc->version) !=
             EFFECT_API_VERSION_MAJOR(EFFECT_LIBRARY_API_VERSION)) {
-        ALOGW("loadLibrary() bad lib version %08x", desc->version);
+        ALOGW("openLibrary() bad lib version %08x", desc->version);
         goto error;
     }
 
-    // add entry for library in gLibraryList
-    l = malloc(sizeof(lib_entry_t));
-    l->name = strndup(name, PATH_MAX);
-    l->path = strndup(path, PATH_MAX);
     l->handle = hdl;
     l->desc = desc;
-    l->effects = NULL;
-    pthread_mutex_init(&l->lock, NULL);
-
-    e = malloc(sizeof(list_elem_t));
-    e->object = l;
-    pthread_mutex_lock(&gLibLock);
-    e->next = gLibraryList;
-    gLibraryList = e;
-    pthread_mutex_unlock(&gLibLock);
-    ALOGV("getLibrary() linked library %p for path %s", l, path);
-
+    ALOGV("openLibrary() opened library %s", l->path);
     return 0;
 
 error:
@@ -583,6 +688,253 @@ error:
     return -EINVAL;
 }
 
+// Opens the libraries of the sub effects of the effect with the specified uuid, if any.
+// Called with gLibLock held.
+int openSubEffectLibraries(const effect_uuid_t *uuid)
+{
+    list_sub_elem_t *e = gSubEffectList;
+
+    while (e != NULL) {
+        effect_descriptor_t *d = (effect_descriptor_t *)e->object;
+        if (memcmp(uuid, &d->uuid, sizeof(effect_uuid_t)) == 0) {
+            list_elem_t *subefx = e->sub_elem;
+            while (subefx != NULL) {
+                sub_effect_entry_t *subeffect = (sub_effect_entry_t *)subefx->object;
+                int ret = openLibrary(subeffect->lib);
+                if (ret != 0) {
+                    return ret;
+                }
+                subefx = subefx->next;
+            }
+            break;
+        }
+        e = e->next;
+    }
+    return 0;
+}
+
+// Returns the descriptor of the effect with the specified uuid from the descriptor cache, or
+// from the library which is then opened and the result cached. Only called from init().
+int queryDescriptor(lib_entry_t *l, const effect_uuid_t *uuid, effect_descriptor_t *desc)
+{
+    desc_cache_lib_t *c = NULL;
+    list_elem_t *e;
+    uint32_t i;
+
+    for (e = gDescriptorCache; e != NULL; e = e->next) {
+        desc_cache_lib_t *cl = (desc_cache_lib_t *)e->object;
+        if (strcmp(cl->path, l->path) == 0) {
+            c = cl;
+            break;
+        }
+    }
+    if (c != NULL) {
+        for (i = 0; i < c->hdr.numDescs; i++) {
+            if (memcmp(&c->descs[i].uuid, uuid, sizeof(effect_uuid_t)) == 0) {
+                *desc = c->descs[i];
+                return 0;
+            }
+        }
+    }
+
+    if (openLibrary(l) != 0 || l->desc->get_descriptor(uuid, desc) != 0) {
+        return -EINVAL;
+    }
+
+    if (c != NULL) {
+        effect_descriptor_t *descs = realloc(c->descs,
+                (c->hdr.numDescs + 1) * sizeof(effect_descriptor_t));
+        if (descs != NULL) {
+            c->descs = descs;
+            c->descs[c->hdr.numDescs++] = *desc;
+            gDescriptorCacheDirty = 1;
+        }
+    }
+    return 0;
+}
+
+// Returns the cache entry for the library at path if its file was not modified since the entry
+// was written, or NULL. Only called from init().
+desc_cache_lib_t *getCachedLibrary(const char *path, const struct stat *st)
+{
+    list_elem_t *e = gDescriptorCache;
+    list_elem_t *prev = NULL;
+
+    while (e != NULL) {
+        desc_cache_lib_t *c = (desc_cache_lib_t *)e->object;
+        if (strcmp(c->path, path) == 0) {
+            if (c->hdr.mtime == (int64_t)st->st_mtime &&
+                    c->hdr.size == (uint64_t)st->st_size &&
+                    c->hdr.ino == (uint64_t)st->st_ino) {
+                c->used = 1;
+                return c;
+            }
+            // stale entry
+            if (prev != NULL) {
+                prev->next = e->next;
+            } else {
+                gDescriptorCache = e->next;
+            }
+            free(c->path);
+            free(c->descs);
+            free(c);
+            free(e);
+            gDescriptorCacheDirty = 1;
+            return NULL;
+        }
+        prev = e;
+        e = e->next;
+    }
+    return NULL;
+}
+
+// Adds an empty cache entry for a library opened by init().
+void addCachedLibrary(const char *path, const struct stat *st)
+{
+    desc_cache_lib_t *c = malloc(sizeof(desc_cache_lib_t));
+    list_elem_t *e = malloc(sizeof(list_elem_t));
+
+    c->path = strndup(path, PATH_MAX);
+    c->hdr.pathLen = strlen(c->path) + 1;
+    c->hdr.numDescs = 0;
+    c->hdr.mtime = (int64_t)st->st_mtime;
+    c->hdr.size = (uint64_t)st->st_size;
+    c->hdr.ino = (uint64_t)st->st_ino;
+    c->descs = NULL;
+    c->used = 1;
+    e->object = c;
+    e->next = gDescriptorCache;
+    gDescriptorCache = e;
+    gDescriptorCacheDirty = 1;
+}
+
+void readDescriptorCache()
+{
+    desc_cache_header_t *hdr;
+    char fingerprint[PROPERTY_VALUE_MAX];
+    unsigned size;
+    size_t offset;
+    char *data;
+    uint32_t i;
+
+    gDescriptorCacheDirty = 1;
+    data = load_file(DESCRIPTOR_CACHE_FILE, &size);
+    if (data == NULL) {
+        return;
+    }
+    hdr = (desc_cache_header_t *)data;
+    property_get(PROPERTY_BUILD_FINGERPRINT, fingerprint, "");
+    if (size < sizeof(desc_cache_header_t) ||
+            hdr->magic != DESCRIPTOR_CACHE_MAGIC ||
+            hdr->version != DESCRIPTOR_CACHE_VERSION ||
+            hdr->descSize != sizeof(effect_descriptor_t) ||
+            strncmp(hdr->fingerprint, fingerprint, PROPERTY_VALUE_MAX) != 0) {
+        ALOGI("readDescriptorCache() ignoring stale descriptor cache");
+        goto exit;
+    }
+
+    offset = sizeof(desc_cache_header_t);
+    for (i = 0; i < hdr->numLibs; i++) {
+        desc_cache_lib_header_t lhdr;
+        desc_cache_lib_t *c;
+        list_elem_t *e;
+
+        if (size - offset < sizeof(desc_cache_lib_header_t)) {
+            goto corrupt;
+        }
+        memcpy(&lhdr, data + offset, sizeof(desc_cache_lib_header_t));
+        offset += sizeof(desc_cache_lib_header_t);
+        if (lhdr.pathLen == 0 || lhdr.pathLen > PATH_MAX ||
+                lhdr.numDescs > (size - offset) / sizeof(effect_descriptor_t) ||
+                size - offset < lhdr.pathLen + lhdr.numDescs * sizeof(effect_descriptor_t) ||
+                data[offset + lhdr.pathLen - 1] != '\0') {
+            goto corrupt;
+        }
+        c = malloc(sizeof(desc_cache_lib_t));
+        c->hdr = lhdr;
+        c->path = strndup(data + offset, lhdr.pathLen);
+        offset += lhdr.pathLen;
+        c->descs = malloc(lhdr.numDescs * sizeof(effect_descriptor_t));
+        memcpy(c->descs, data + offset, lhdr.numDescs * sizeof(effect_descriptor_t));
+        offset += lhdr.numDescs * sizeof(effect_descriptor_t);
+        c->used = 0;
+        e = malloc(sizeof(list_elem_t));
+        e->object = c;
+        e->next = gDescriptorCache;
+        gDescriptorCache = e;
+    }
+    gDescriptorCacheDirty = 0;
+    ALOGV("readDescriptorCache() read %u libraries", hdr->numLibs);
+    goto exit;
+
+corrupt:
+    ALOGW("readDescriptorCache() corrupted descriptor cache");
+    freeDescriptorCache();
+exit:
+    free(data);
+}
+
+void writeDescriptorCache()
+{
+    const char *tmpPath = DESCRIPTOR_CACHE_FILE ".tmp";
+    desc_cache_header_t hdr;
+    list_elem_t *e;
+    FILE *f;
+    int ok;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = DESCRIPTOR_CACHE_MAGIC;
+    hdr.version = DESCRIPTOR_CACHE_VERSION;
+    hdr.descSize = sizeof(effect_descriptor_t);
+    property_get(PROPERTY_BUILD_FINGERPRINT, hdr.fingerprint, "");
+    // libraries no longer in the configuration file are dropped
+    for (e = gDescriptorCache; e != NULL; e = e->next) {
+        if (((desc_cache_lib_t *)e->object)->used) {
+            hdr.numLibs++;
+        }
+    }
+
+    f = fopen(tmpPath, "w");
+    if (f == NULL) {
+        ALOGW("writeDescriptorCache() cannot create %s: %s", tmpPath, strerror(errno));
+        return;
+    }
+    ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    for (e = gDescriptorCache; e != NULL && ok; e = e->next) {
+        desc_cache_lib_t *c = (desc_cache_lib_t *)e->object;
+        if (!c->used) {
+            continue;
+        }
+        ok = fwrite(&c->hdr, sizeof(c->hdr), 1, f) == 1 &&
+                fwrite(c->path, c->hdr.pathLen, 1, f) == 1 &&
+                fwrite(c->descs, sizeof(effect_descriptor_t), c->hdr.numDescs, f) ==
+                        c->hdr.numDescs;
+    }
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+    if (!ok || rename(tmpPath, DESCRIPTOR_CACHE_FILE) != 0) {
+        ALOGW("writeDescriptorCache() failed to write %s", DESCRIPTOR_CACHE_FILE);
+        unlink(tmpPath);
+        return;
+    }
+    gDescriptorCacheDirty = 0;
+    ALOGV("writeDescriptorCache() wrote %u libraries", hdr.numLibs);
+}
+
+void freeDescriptorCache()
+{
+    while (gDescriptorCache != NULL) {
+        list_elem_t *e = gDescriptorCache;
+        desc_cache_lib_t *c = (desc_cache_lib_t *)e->object;
+        gDescriptorCache = e->next;
+        free(c->path);
+        free(c->descs);
+        free(c);
+        free(e);
+    }
+}
+
 // This will find the library and UUID tags of the sub effect pointed by the
 // node, gets the effect descriptor and lib_entry_t and adds the subeffect -
 // sub_entry_t to the gSubEffectList
@@ -612,7 +964,7 @@ int addSubEffect(cnode *root)
         return -EINVAL;
     }
     d = malloc(sizeof(effect_descriptor_t));
-    if (l->desc->get_descriptor(&uuid, d) != 0) {
+    if (queryDescriptor(l, &uuid, d) != 0) {
         char s[40];
         uuidToString(&uuid, s, 40);
         ALOGW("Error querying effect %s on lib %s", s, l->name);
@@ -694,7 +1046,7 @@ int loadEffect(cnode *root)
     }
 
     d = malloc(sizeof(effect_descriptor_t));
-    if (l->desc->get_descriptor(&uuid, d) != 0) {
+    if (queryDescriptor(l, &uuid, d) != 0) {
         char s[40];
         uuidToString(&uuid, s, 40);
         ALOGW("Error querying effect %s on lib %s", s, l->name);
@@ -991,7 +1343,7 @@ int EffectDumpEffects(int fd) {
     while (e) {
         l = (lib_entry_t *)e->object;
         list_elem_t *efx = l->effects;
-        dprintf(fd, "Library %s\n", l->name);
+        dprintf(fd, "Library %s%s\n", l->name, l->handle == NULL ? " (not loaded)" : "");
         if (!efx) {
             dprintf(fd, "  (no effects)\n");
         }
@@ -43,10 +43,10 @@ typedef struct list_sub_elem_s {
 } list_sub_elem_t;
 
 typedef struct lib_entry_s {
-    audio_effect_library_t *desc;
+    audio_effect_library_t *desc;   // NULL until the library is opened
     char *name;
     char *path;
-    void *handle;
+    void *handle;                   // NULL until the library is opened
     list_elem_t *effects; //list of effect_descriptor_t
     pthread_mutex_t lock;
 } lib_entry_t;
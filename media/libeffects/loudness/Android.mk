@@ -8,6 +8,8 @@ LOCAL_SRC_FILES:= \
 	dsp/core/dynamic_range_compression.cpp
 
 LOCAL_CFLAGS+= -O2 -fvisibility=hidden
+# uncomment to use the per frame compressor on targets that support NEON
+#LOCAL_CFLAGS += -DLE_FX_DISABLE_NEON
 
 LOCAL_SHARED_LIBRARIES := \
 	libcutils \
@@ -43,6 +43,9 @@ const effect_descriptor_t gLEDescriptor = {
         "The Android Open Source Project",
 };
 
+// frames converted to float and compressed at a time by LE_process()
+#define LE_BLOCK_FRAMES 256
+
 enum le_state_e {
     LOUDNESS_ENHANCER_STATE_UNINITIALIZED,
     LOUDNESS_ENHANCER_STATE_INITIALIZED,
@@ -280,16 +283,22 @@ int LE_process(
     }
 
     //ALOGV("LE about to process %d samples", inBuffer->frameCount);
-    uint16_t inIdx;
     float inputAmp = pow(10, pContext->mTargetGainmB/2000.0f);
-    float leftSample, rightSample;
-    for (inIdx = 0 ; inIdx < inBuffer->frameCount ; inIdx++) {
+    float samples[LE_BLOCK_FRAMES * 2];
+    for (size_t offset = 0; offset < inBuffer->frameCount; offset += LE_BLOCK_FRAMES) {
+        size_t frames = inBuffer->frameCount - offset;
+        if (frames > LE_BLOCK_FRAMES) {
+            frames = LE_BLOCK_FRAMES;
+        }
+        int16_t *in = inBuffer->s16 + offset * 2;
         // makeup gain is applied on the input of the compressor
-        leftSample  = inputAmp * (float)inBuffer->s16[2*inIdx];
-        rightSample = inputAmp * (float)inBuffer->s16[2*inIdx +1];
-        pContext->mCompressor->Compress(&leftSample, &rightSample);
-        inBuffer->s16[2*inIdx]    = (int16_t) leftSample;
-        inBuffer->s16[2*inIdx +1] = (int16_t) rightSample;
+        for (size_t i = 0; i < frames * 2; i++) {
+            samples[i] = inputAmp * (float)in[i];
+        }
+        pContext->mCompressor->CompressStereo(samples, frames);
+        for (size_t i = 0; i < frames * 2; i++) {
+            in[i] = (int16_t) samples[i];
+        }
     }
 
     if (inBuffer->raw != outBuffer->raw) {
@@ -18,6 +18,7 @@
 #define LE_FX_ENGINE_COMMON_CORE_MATH_H_
 
 #include <math.h>
+#include <string.h>
 #include <algorithm>
 using ::std::min;
 using ::std::max;
@@ -65,6 +66,33 @@ inline T ExpApproximationViaTaylorExpansionOrder5(T x) {
       0.008333333333333333217685101601546193705871701240539550781250f * x5;
 }
 
+// A polynomial approximation to log2(.) for positive normal values, accurate
+// to 2e-5. Unlike fast_log2(.), it maps to vector instructions.
+inline float Log2ApproximationViaPolynomialOrder5(float val) {
+  int32 bits;
+  memcpy(&bits, &val, sizeof(bits));
+  const float exponent = static_cast<float>(((bits >> 23) & 255) - 127);
+  bits = (bits & 0x007fffff) | 0x3f800000;
+  float mantissa;
+  memcpy(&mantissa, &bits, sizeof(mantissa));
+  // log2(1 + x) for x in [0, 1)
+  const float x = mantissa - 1.0f;
+  return exponent + x * (1.441879896f + x * (-0.7088652175f + x * (0.4152455597f +
+      x * (-0.1935165238f + x * 0.04526829226f))));
+}
+
+// A polynomial approximation to 2^x for x >= -126, accurate to 5e-6 relative.
+inline float Exp2ApproximationViaPolynomialOrder4(float val) {
+  const float integer = std::floor(val);
+  // 2^x for x in [0, 1)
+  const float x = val - integer;
+  const int32 bits = (static_cast<int32>(integer) + 127) << 23;
+  float scale;
+  memcpy(&scale, &bits, sizeof(scale));
+  return scale * (1.0f + x * (0.6930175129f + x * (0.2414486597f +
+      x * (0.05194795275f + x * 0.01358166409f))));
+}
+
 }  // namespace math
 }  // namespace le_fx
 
@@ -26,4 +26,13 @@
 #    define LE_FX_OS_ANDROID
 #endif  // Android
 
+// -----------------------------------------------------------------------------
+// SIMD Identification:
+// -----------------------------------------------------------------------------
+
+// Build with -DLE_FX_DISABLE_NEON to use the C versions of the vectorized loops.
+#if (defined(__ARM_NEON__) || defined(__ARM_NEON)) && !defined(LE_FX_DISABLE_NEON)
+#    define LE_FX_NEON
+#endif  // NEON
+
 #endif // LE_FX_ENGINE_COMMON_CORE_OS_H_
@@ -22,12 +22,62 @@
 #include "dsp/core/interpolation.h"
 #include "dsp/core/dynamic_range_compression.h"
 
+#if defined(LE_FX_NEON)
+#include <arm_neon.h>
+#endif  // LE_FX_NEON
+
 //#define LOG_NDEBUG 0
 #include <cutils/log.h>
 
 
 namespace le_fx {
 
+#if defined(LE_FX_NEON)
+namespace {
+
+const float kLn2 = 0.693147180559945286226763982995180413126945495605468750f;
+const float kLog2e = 1.442695040888963387004650940070860087871551513671875f;
+// Smallest argument of Exp2ApproximationViaPolynomialOrder4(.)
+const float kMinExp2Argument = -126.0f;
+
+// NEON version of math::Log2ApproximationViaPolynomialOrder5(.) for positive
+// values.
+inline float32x4_t Log2ApproximationViaPolynomialOrder5(float32x4_t val) {
+  const int32x4_t bits = vreinterpretq_s32_f32(val);
+  const float32x4_t exponent = vcvtq_f32_s32(
+      vsubq_s32(vshrq_n_s32(bits, 23), vdupq_n_s32(127)));
+  const float32x4_t mantissa = vreinterpretq_f32_s32(vorrq_s32(
+      vandq_s32(bits, vdupq_n_s32(0x007fffff)), vdupq_n_s32(0x3f800000)));
+  const float32x4_t x = vsubq_f32(mantissa, vdupq_n_f32(1.0f));
+  float32x4_t p = vdupq_n_f32(0.04526829226f);
+  p = vmlaq_f32(vdupq_n_f32(-0.1935165238f), p, x);
+  p = vmlaq_f32(vdupq_n_f32(0.4152455597f), p, x);
+  p = vmlaq_f32(vdupq_n_f32(-0.7088652175f), p, x);
+  p = vmlaq_f32(vdupq_n_f32(1.441879896f), p, x);
+  return vmlaq_f32(exponent, p, x);
+}
+
+// NEON version of math::Exp2ApproximationViaPolynomialOrder4(.)
+inline float32x4_t Exp2ApproximationViaPolynomialOrder4(float32x4_t val) {
+  // floor(.) from the conversion that rounds toward zero
+  const int32x4_t truncated = vcvtq_s32_f32(val);
+  const uint32x4_t rounded_up = vcgtq_f32(vcvtq_f32_s32(truncated), val);
+  const int32x4_t integer =
+      vaddq_s32(truncated, vreinterpretq_s32_u32(rounded_up));
+  const float32x4_t x = vsubq_f32(val, vcvtq_f32_s32(integer));
+  float32x4_t p = vdupq_n_f32(0.01358166409f);
+  p = vmlaq_f32(vdupq_n_f32(0.05194795275f), p, x);
+  p = vmlaq_f32(vdupq_n_f32(0.2414486597f), p, x);
+  p = vmlaq_f32(vdupq_n_f32(0.6930175129f), p, x);
+  p = vmlaq_f32(vdupq_n_f32(1.0f), p, x);
+  const float32x4_t scale = vreinterpretq_f32_s32(
+      vshlq_n_s32(vaddq_s32(integer, vdupq_n_s32(127)), 23));
+  return vmulq_f32(scale, p);
+}
+
+}  // namespace
+#endif  // LE_FX_NEON
+
 // Definitions for static const class members declared in
 // dynamic_range_compression.h.
 const float AdaptiveDynamicRangeCompression::kMinAbsValue = 0.000001f;
@@ -137,5 +187,88 @@ void AdaptiveDynamicRangeCompression::Compress(float *x1, float *x2) {
   }
 }
 
-}  // namespace le_fx
+void AdaptiveDynamicRangeCompression::CompressStereo(float *x,
+                                                     int frame_count) {
+#if defined(LE_FX_NEON)
+  // The detector state is the log of the gain: Compress(.) tracks the gain
+  // through its variations, and this version computes the gain from the state.
+  float cv[kBlockFrames];
+  float log2_gain[kBlockFrames];
+  const float knee_threshold = knee_threshold_;
+  const float slope = slope_;
+  const float alpha_attack = alpha_attack_;
+  const float alpha_release = alpha_release_;
+  const float32x4_t min_abs_x = vdupq_n_f32(kMinLogAbsValue);
+  const float32x4_t minus_knee_threshold = vdupq_n_f32(-knee_threshold);
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  const float32x4_t limit = vdupq_n_f32(kFixedPointLimit);
+  const float32x4_t minus_limit = vdupq_n_f32(-kFixedPointLimit);
+  float state = state_;
 
+  while (frame_count > 0) {
+    const int frames = std::min(frame_count, kBlockFrames);
+    int i = 0;
+
+    // Control value of the peak of both channels
+    for (; i + 4 <= frames; i += 4) {
+      const float32x4x2_t xs = vld2q_f32(x + 2 * i);
+      const float32x4_t max_abs_x = vmaxq_f32(
+          vmaxq_f32(vabsq_f32(xs.val[0]), vabsq_f32(xs.val[1])), min_abs_x);
+      const float32x4_t overshoot = vmlaq_n_f32(minus_knee_threshold,
+          Log2ApproximationViaPolynomialOrder5(max_abs_x), kLn2);
+      vst1q_f32(cv + i, vmulq_n_f32(vmaxq_f32(overshoot, zero), slope));
+    }
+    for (; i < frames; i++) {
+      const float max_abs_x = std::max(std::fabs(x[2 * i]),
+          std::max(std::fabs(x[2 * i + 1]), kMinLogAbsValue));
+      const float overshoot =
+          math::Log2ApproximationViaPolynomialOrder5(max_abs_x) * kLn2 -
+          knee_threshold;
+      cv[i] = std::max(overshoot, 0.0f) * slope;
+    }
+
+    // Envelope detector, which depends on the previous frame
+    for (i = 0; i < frames; i++) {
+      if (cv[i] <= state) {
+        state = alpha_attack * state + (1.0f - alpha_attack) * cv[i];
+      } else {
+        state = alpha_release * state + (1.0f - alpha_release) * cv[i];
+      }
+      log2_gain[i] = std::max(state * kLog2e, kMinExp2Argument);
+    }
+
+    // Gain and hard limit
+    for (i = 0; i + 4 <= frames; i += 4) {
+      const float32x4_t gain =
+          Exp2ApproximationViaPolynomialOrder4(vld1q_f32(log2_gain + i));
+      float32x4x2_t xs = vld2q_f32(x + 2 * i);
+      xs.val[0] = vmaxq_f32(vminq_f32(vmulq_f32(xs.val[0], gain), limit),
+                            minus_limit);
+      xs.val[1] = vmaxq_f32(vminq_f32(vmulq_f32(xs.val[1], gain), limit),
+                            minus_limit);
+      vst2q_f32(x + 2 * i, xs);
+    }
+    for (; i < frames; i++) {
+      const float gain =
+          math::Exp2ApproximationViaPolynomialOrder4(log2_gain[i]);
+      x[2 * i] = std::max(std::min(x[2 * i] * gain, kFixedPointLimit),
+                          -kFixedPointLimit);
+      x[2 * i + 1] = std::max(std::min(x[2 * i + 1] * gain, kFixedPointLimit),
+                              -kFixedPointLimit);
+    }
+
+    compressor_gain_ =
+        math::Exp2ApproximationViaPolynomialOrder4(log2_gain[frames - 1]);
+    x += 2 * frames;
+    frame_count -= frames;
+  }
+  state_ = state;
+#else
+  // Without vector instructions the per frame version is the fastest
+  for (int i = 0; i < frame_count; i++) {
+    Compress(&x[2 * i], &x[2 * i + 1]);
+  }
+#endif  // LE_FX_NEON
+}
+
+}  // namespace le_fx
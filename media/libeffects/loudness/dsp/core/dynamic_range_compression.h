@@ -58,6 +58,14 @@ class AdaptiveDynamicRangeCompression {
   // Stereo channel version of the compressor
   void Compress(float *x1, float *x2);
 
+  // Stereo channel version of the compressor for a buffer of frame_count
+  // interleaved frames, processed in place. With NEON, the peak detection and
+  // the gain are computed four frames at a time with polynomial approximations
+  // of log2(.) and 2^(.), and the output is within 0.05 dB of the output of
+  // Compress(x1, x2), most of which is the error of fast_log(.). Without NEON,
+  // it calls Compress(x1, x2) on each frame.
+  void CompressStereo(float *x, int frame_count);
+
   // This version is slower than Compress(.) but faster than CompressSlow(.)
   float CompressNormalSpeed(float x);
 
@@ -91,6 +99,8 @@ class AdaptiveDynamicRangeCompression {
   static const float kTauAttack;
   // The release time of the envelope detector
   static const float kTauRelease;
+  // Frames processed by each pass of CompressStereo(.)
+  static const int kBlockFrames = 64;
 
   float sampling_rate_;
   // the internal state of the envelope detector
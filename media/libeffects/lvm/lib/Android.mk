@@ -121,6 +121,10 @@ LOCAL_C_INCLUDES += \
 
 LOCAL_CFLAGS += -fvisibility=hidden
 
+# uncomment to use the C versions of the core functions on targets that support NEON,
+# for benchmarking or bit exactness checks
+#LOCAL_CFLAGS += -DLVM_USE_NEON=0
+
 include $(BUILD_STATIC_LIBRARY)
 
 
@@ -18,6 +18,7 @@
 #include "BIQUAD.h"
 #include "BQ_2I_D16F32Css_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_Neon.h"
 
 /**************************************************************************
  ASSUMPTIONS:
@@ -37,14 +38,77 @@
  pBiquadState->pDelays[7] is y(n-2)R in Q16 format
 ***************************************************************************/
 
+#if LVM_USE_NEON
+/* One stereo frame, left channel in lane 0 and right channel in lane 1, returns y(n) in Q15.
+   (A * B) >> 16 computed on 64 bits is bit exact with MUL32x16INTO32 */
+static inline int32x2_t BQ_2I_D16F32C15_Frame( int32x2_t     xn,
+                                               int32x2_t     *pXn1,
+                                               int32x2_t     *pXn2,
+                                               int32x2_t     *pYn1,
+                                               int32x2_t     *pYn2,
+                                               const LVM_INT16  *pCoefs)
+    {
+        int32x2_t yn;
+
+        /* yn=A2 (Q15) * x(n-2) (Q0) + A1 (Q15) * x(n-1) (Q0) + A0 (Q15) * x(n) (Q0) in Q15*/
+        yn = vmul_n_s32(*pXn2, pCoefs[0]);
+        yn = vmla_n_s32(yn, *pXn1, pCoefs[1]);
+        yn = vmla_n_s32(yn, xn, pCoefs[2]);
+
+        /* yn+= ( (-B2 (Q15) * y(n-2) (Q16) )>>16) + ( (-B1 (Q15) * y(n-1) (Q16) )>>16) in Q15 */
+        yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(*pYn2, pCoefs[3]), 16));
+        yn = vadd_s32(yn, vshrn_n_s64(vmull_n_s32(*pYn1, pCoefs[4]), 16));
+
+        *pXn2 = *pXn1;
+        *pXn1 = xn;
+        *pYn2 = *pYn1;
+        *pYn1 = vshl_n_s32(yn, 1);                                  /* y(n-1) in Q16*/
+        return yn;
+    }
+#endif
+
 void BQ_2I_D16F32C15_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
                                             LVM_INT16                    *pDataIn,
                                             LVM_INT16                    *pDataOut,
                                             LVM_INT16                    NrSamples)
     {
-        LVM_INT32  ynL,ynR,templ;
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
+#if LVM_USE_NEON
+        int32x2_t xn1 = vld1_s32(&pBiquadState->pDelays[0]);      /* x(n-1) */
+        int32x2_t xn2 = vld1_s32(&pBiquadState->pDelays[2]);      /* x(n-2) */
+        int32x2_t yn1 = vld1_s32(&pBiquadState->pDelays[4]);      /* y(n-1) */
+        int32x2_t yn2 = vld1_s32(&pBiquadState->pDelays[6]);      /* y(n-2) */
+        int32x2_t yn0, yn;
+
+        /* two frames per iteration */
+        for (ii = NrSamples >> 1; ii != 0; ii--)
+        {
+            int32x4_t xn = vmovl_s16(vld1_s16(pDataIn));
+            pDataIn += 4;
+            yn0 = BQ_2I_D16F32C15_Frame(vget_low_s32(xn), &xn1, &xn2, &yn1, &yn2,
+                                        pBiquadState->coefs);
+            yn = BQ_2I_D16F32C15_Frame(vget_high_s32(xn), &xn1, &xn2, &yn1, &yn2,
+                                       pBiquadState->coefs);
+
+            /* Write the outputs in Q0*/
+            vst1_s16(pDataOut, vmovn_s32(vshrq_n_s32(vcombine_s32(yn0, yn), 15)));
+            pDataOut += 4;
+        }
+        if (NrSamples & 1)
+        {
+            yn = vset_lane_s32(pDataIn[1], vdup_n_s32(pDataIn[0]), 1);
+            yn = BQ_2I_D16F32C15_Frame(yn, &xn1, &xn2, &yn1, &yn2, pBiquadState->coefs);
+            pDataOut[0] = (LVM_INT16)(vget_lane_s32(yn, 0) >> 15);
+            pDataOut[1] = (LVM_INT16)(vget_lane_s32(yn, 1) >> 15);
+        }
+
+        vst1_s32(&pBiquadState->pDelays[0], xn1);
+        vst1_s32(&pBiquadState->pDelays[2], xn2);
+        vst1_s32(&pBiquadState->pDelays[4], yn1);
+        vst1_s32(&pBiquadState->pDelays[6], yn2);
+#else
+        LVM_INT32  ynL,ynR,templ;
 
          for (ii = NrSamples; ii != 0; ii--)
          {
@@ -112,6 +176,7 @@ void BQ_2I_D16F32C15_TRC_WRA_01 (           Biquad_Instance_t       *pInstance,
             *pDataOut=(LVM_INT16)(ynR>>15); /* Write Right ouput in Q0*/
             pDataOut++;
         }
+#endif
 
     }
 
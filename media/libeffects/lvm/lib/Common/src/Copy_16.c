@@ -20,6 +20,7 @@
 ***********************************************************************************/
 
 #include "VectorArithmetic.h"
+#include <string.h>
 
 /**********************************************************************************
    FUNCTION COPY_16
@@ -29,27 +30,12 @@ void Copy_16( const LVM_INT16 *src,
                     LVM_INT16 *dst,
                     LVM_INT16  n )
 {
-    LVM_INT16 ii;
-
-    if (src > dst)
-    {
-        for (ii = n; ii != 0; ii--)
-        {
-            *dst = *src;
-            dst++;
-            src++;
-        }
-    }
-    else
+    /* memmove() handles the overlapping buffers the same way as the forward and
+       backward element by element copies it replaces, and is optimized for the
+       target (with NEON on ARM) */
+    if ((n > 0) && (src != dst))
     {
-        src += n - 1;
-        dst += n - 1;
-        for (ii = n; ii != 0; ii--)
-        {
-            *dst = *src;
-            dst--;
-            src--;
-        }
+        memmove(dst, src, (size_t)n * sizeof(LVM_INT16));
     }
 
     return;
@@ -18,6 +18,27 @@
 #include "BIQUAD.h"
 #include "DC_2I_D16_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_Neon.h"
+
+#if LVM_USE_NEON
+/* One stereo frame, left channel in lane 0 and right channel in lane 1 */
+static inline int32x2_t DC_2I_D16_Frame( int32x2_t       xn,
+                                         int32x2_t       *pDC,
+                                         int32x2_t       Step)
+    {
+        int32x2_t Diff;
+        int32x2_t Negative;
+
+        /* Subtract DC an saturate */
+        Diff = vsub_s32(xn, vshr_n_s32(*pDC, 16));
+        Diff = vmax_s32(vmin_s32(Diff, vdup_n_s32(32767)), vdup_n_s32(-32768));
+
+        /* DC -= Step if Diff < 0, DC += Step otherwise */
+        Negative = vshr_n_s32(Diff, 31);
+        *pDC = vadd_s32(*pDC, vsub_s32(veor_s32(Step, Negative), Negative));
+        return Diff;
+    }
+#endif
 
 void DC_2I_D16_TRC_WRA_01( Biquad_Instance_t       *pInstance,
                            LVM_INT16               *pDataIn,
@@ -31,7 +52,29 @@ void DC_2I_D16_TRC_WRA_01( Biquad_Instance_t       *pInstance,
 
         LeftDC  =   pBiquadState->LeftDC;
         RightDC =   pBiquadState->RightDC;
+#if LVM_USE_NEON
+        {
+            const int32x2_t Step = vdup_n_s32(DC_D16_STEP);
+            int32x2_t DC = vset_lane_s32(RightDC, vdup_n_s32(LeftDC), 1);
+            int32x2_t Diff0, Diff1;
+
+            /* two frames per iteration */
+            for(j=(NrSamples>>1)-1;j>=0;j--)
+            {
+                int32x4_t xn = vmovl_s16(vld1_s16(pDataIn));
+                pDataIn += 4;
+                Diff0 = DC_2I_D16_Frame(vget_low_s32(xn), &DC, Step);
+                Diff1 = DC_2I_D16_Frame(vget_high_s32(xn), &DC, Step);
+                vst1_s16(pDataOut, vmovn_s32(vcombine_s32(Diff0, Diff1)));
+                pDataOut += 4;
+            }
+            LeftDC  =   vget_lane_s32(DC, 0);
+            RightDC =   vget_lane_s32(DC, 1);
+        }
+        for(j=(NrSamples&1)-1;j>=0;j--)
+#else
         for(j=NrSamples-1;j>=0;j--)
+#endif
         {
             /* Subtract DC an saturate */
             Diff=*(pDataIn++)-(LeftDC>>16);
@@ -18,7 +18,7 @@
 #ifndef _DC_2I_D16_TRC_WRA_01_PRIVATE_H_
 #define _DC_2I_D16_TRC_WRA_01_PRIVATE_H_
 
-#define DC_D16_STEP     0x200;
+#define DC_D16_STEP     0x200
 
 
 /* The internal state variables are implemented in a (for the user)  hidden structure */
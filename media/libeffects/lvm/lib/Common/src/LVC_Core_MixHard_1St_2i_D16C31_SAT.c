@@ -22,6 +22,7 @@
 #include "LVC_Mixer_Private.h"
 #include "LVM_Macros.h"
 #include "ScalarArithmetic.h"
+#include "LVM_Neon.h"
 
 
 /**********************************************************************************
@@ -45,6 +46,27 @@ void LVC_Core_MixHard_1St_2i_D16C31_SAT( LVMixer3_st        *ptrInstance1,
     Current1Short = (LVM_INT16)(pInstance1->Current >> 16);
     Current2Short = (LVM_INT16)(pInstance2->Current >> 16);
 
+#if LVM_USE_NEON
+    {
+        /* Current1Short for the left samples, Current2Short for the right samples */
+        int16x4_t Gain = vdup_n_s16(Current1Short);
+        Gain = vset_lane_s16(Current2Short, Gain, 1);
+        Gain = vset_lane_s16(Current2Short, Gain, 3);
+
+        /* 4 stereo frames per iteration, the C loop below does the rest */
+        for (ii = n >> 2; ii != 0; ii--)
+        {
+            int16x8_t In = vld1q_s16(src);
+            int32x4_t TempLow = vshrq_n_s32(vmull_s16(vget_low_s16(In), Gain), 15);
+            int32x4_t TempHigh = vshrq_n_s32(vmull_s16(vget_high_s16(In), Gain), 15);
+            vst1q_s16(dst, vcombine_s16(vqmovn_s32(TempLow), vqmovn_s32(TempHigh)));
+            src += 8;
+            dst += 8;
+        }
+        n &= 3;
+    }
+#endif
+
     for (ii = n; ii != 0; ii--)
     {
         Temp = ((LVM_INT32)*(src++) * (LVM_INT32)Current1Short)>>15;
@@ -20,6 +20,7 @@
 ***********************************************************************************/
 
 #include "LVC_Mixer_Private.h"
+#include "LVM_Neon.h"
 
 /**********************************************************************************
    FUNCTION LVCore_MIXHARD_2ST_D16C31_SAT
@@ -43,6 +44,30 @@ void LVC_Core_MixHard_2St_D16C31_SAT( LVMixer3_st *ptrInstance1,
     Current1Short = (LVM_INT16)(pInstance1->Current >> 16);
     Current2Short = (LVM_INT16)(pInstance2->Current >> 16);
 
+#if LVM_USE_NEON
+    {
+        const int16x4_t Gain1 = vdup_n_s16(Current1Short);
+        const int16x4_t Gain2 = vdup_n_s16(Current2Short);
+
+        /* 8 samples per iteration, the C loop below does the rest */
+        for (ii = n >> 3; ii != 0; ii--){
+            int16x8_t In1 = vld1q_s16(src1);
+            int16x8_t In2 = vld1q_s16(src2);
+            int32x4_t TempLow = vaddq_s32(
+                    vshrq_n_s32(vmull_s16(vget_low_s16(In1), Gain1), 15),
+                    vshrq_n_s32(vmull_s16(vget_low_s16(In2), Gain2), 15));
+            int32x4_t TempHigh = vaddq_s32(
+                    vshrq_n_s32(vmull_s16(vget_high_s16(In1), Gain1), 15),
+                    vshrq_n_s32(vmull_s16(vget_high_s16(In2), Gain2), 15));
+            vst1q_s16(dst, vcombine_s16(vqmovn_s32(TempLow), vqmovn_s32(TempHigh)));
+            src1 += 8;
+            src2 += 8;
+            dst += 8;
+        }
+        n &= 7;
+    }
+#endif
+
     for (ii = n; ii != 0; ii--){
         Temp = (((LVM_INT32)*(src1++) * (LVM_INT32)Current1Short)>>15) +
                (((LVM_INT32)*(src2++) * (LVM_INT32)Current2Short)>>15);
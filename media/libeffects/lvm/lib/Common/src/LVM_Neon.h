@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LVM_NEON_H__
+#define __LVM_NEON_H__
+
+/**********************************************************************************
+   NEON SELECTION
+
+   The core biquad, DC removal, mixer and shift functions have a NEON version that
+   is bit exact with the portable C version.  It is used on the targets that support
+   NEON, unless the library is built with -DLVM_USE_NEON=0.
+
+   The biquads and the DC removal filter are recursive: they process the left and
+   right channels of a stereo frame in the two lanes of a vector.  The mixer and
+   shift functions process consecutive samples in parallel.
+***********************************************************************************/
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#ifndef LVM_USE_NEON
+#define LVM_USE_NEON 1
+#endif
+#else
+#undef LVM_USE_NEON
+#define LVM_USE_NEON 0
+#endif
+
+#if LVM_USE_NEON
+#include <arm_neon.h>
+#endif
+
+#endif /* __LVM_NEON_H__ */
@@ -18,6 +18,7 @@
 #include "BIQUAD.h"
 #include "PK_2I_D32F32CssGss_TRC_WRA_01_Private.h"
 #include "LVM_Macros.h"
+#include "LVM_Neon.h"
 
 /**************************************************************************
  ASSUMPTIONS:
@@ -43,9 +44,53 @@ void PK_2I_D32F32C14G11_TRC_WRA_01 ( Biquad_Instance_t       *pInstance,
                                      LVM_INT32               *pDataOut,
                                      LVM_INT16               NrSamples)
     {
-        LVM_INT32 ynL,ynR,ynLO,ynRO,templ;
         LVM_INT16 ii;
         PFilter_State pBiquadState = (PFilter_State) pInstance;
+#if LVM_USE_NEON
+        /* Left channel in lane 0, right channel in lane 1. (A * B) >> Shift computed
+           on 64 bits is bit exact with MUL32x16INTO32 for Shift <= 16 */
+        int32x2_t xn1 = vld1_s32(&pBiquadState->pDelays[0]);      /* x(n-1) */
+        int32x2_t xn2 = vld1_s32(&pBiquadState->pDelays[2]);      /* x(n-2) */
+        int32x2_t yn1 = vld1_s32(&pBiquadState->pDelays[4]);      /* y(n-1) */
+        int32x2_t yn2 = vld1_s32(&pBiquadState->pDelays[6]);      /* y(n-2) */
+        const int32x2_t A0 = vdup_n_s32(pBiquadState->coefs[0]);
+        const int32x2_t B2 = vdup_n_s32(pBiquadState->coefs[1]);
+        const int32x2_t B1 = vdup_n_s32(pBiquadState->coefs[2]);
+        const int32x2_t Gain = vdup_n_s32(pBiquadState->coefs[3]);
+
+         for (ii = NrSamples; ii != 0; ii--)
+         {
+            int32x2_t xn = vld1_s32(pDataIn);
+            int32x2_t yn, ynO;
+
+            /* yn= (A0 (Q14) * (x(n) (Q0) - x(n-2) (Q0) ) >>14)  in Q0*/
+            yn = vshrn_n_s64(vmull_s32(vsub_s32(xn, xn2), A0), 14);
+
+            /* yn+= ((-B2 (Q14) * y(n-2) (Q0) ) >>14) in Q0*/
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_s32(yn2, B2), 14));
+
+            /* yn+= ((-B1 (Q14) * y(n-1) (Q0) ) >>14) in Q0 */
+            yn = vadd_s32(yn, vshrn_n_s64(vmull_s32(yn1, B1), 14));
+
+            /* ynO= ((Gain (Q11) * yn (Q0))>>11) + x(n) (Q0) in Q0*/
+            ynO = vadd_s32(vshrn_n_s64(vmull_s32(yn, Gain), 11), xn);
+
+            xn2 = xn1;
+            xn1 = xn;
+            yn2 = yn1;
+            yn1 = yn;
+            pDataIn += 2;
+
+            vst1_s32(pDataOut, ynO);
+            pDataOut += 2;
+        }
+
+        vst1_s32(&pBiquadState->pDelays[0], xn1);
+        vst1_s32(&pBiquadState->pDelays[2], xn2);
+        vst1_s32(&pBiquadState->pDelays[4], yn1);
+        vst1_s32(&pBiquadState->pDelays[6], yn2);
+#else
+        LVM_INT32 ynL,ynR,ynLO,ynRO,templ;
 
          for (ii = NrSamples; ii != 0; ii--)
          {
@@ -116,6 +161,7 @@ void PK_2I_D32F32C14G11_TRC_WRA_01 ( Biquad_Instance_t       *pInstance,
             pDataOut++;
 
         }
+#endif
 
     }
 
@@ -20,6 +20,7 @@
 ***********************************************************************************/
 
 #include "VectorArithmetic.h"
+#include "LVM_Neon.h"
 
 /**********************************************************************************
    FUNCTION Shift_Sat_v16xv16
@@ -35,6 +36,17 @@ void Shift_Sat_v16xv16 (const   LVM_INT16   val,
     LVM_INT16   RShift;
     if(val>0)
     {
+#if LVM_USE_NEON
+        /* 8 samples per iteration with a saturating shift, the C loop below does the rest */
+        const int16x8_t Shift = vdupq_n_s16(val);
+        for (ii = n >> 3; ii != 0; ii--)
+        {
+            vst1q_s16(dst, vqshlq_s16(vld1q_s16(src), Shift));
+            src += 8;
+            dst += 8;
+        }
+        n &= 7;
+#endif
         for (ii = n; ii != 0; ii--)
         {
             temp = (LVM_INT32)*src;
@@ -61,6 +73,19 @@ void Shift_Sat_v16xv16 (const   LVM_INT16   val,
     {
         RShift=(LVM_INT16)(-val);
 
+#if LVM_USE_NEON
+        {
+            /* a negative shift count shifts right */
+            const int16x8_t Shift = vdupq_n_s16(val);
+            for (ii = n >> 3; ii != 0; ii--)
+            {
+                vst1q_s16(dst, vshlq_s16(vld1q_s16(src), Shift));
+                src += 8;
+                dst += 8;
+            }
+            n &= 7;
+        }
+#endif
         for (ii = n; ii != 0; ii--)
         {
             *dst = (LVM_INT16)(*src >> RShift);
@@ -14,7 +14,8 @@ LOCAL_C_INCLUDES += \
     external/webrtc \
     external/webrtc/webrtc/modules/include \
     external/webrtc/webrtc/modules/audio_processing/include \
-    $(call include-path-for, audio-effects)
+    $(call include-path-for, audio-effects) \
+    $(call include-path-for, audio-utils)
 
 LOCAL_C_INCLUDES += $(call include-path-for, speex)
 
@@ -20,6 +20,7 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 #include <utils/Timers.h>
+#include <audio_utils/primitives.h>
 #include <hardware/audio_effect.h>
 #include <audio_effects/effect_aec.h>
 #include <audio_effects/effect_agc.h>
@@ -107,6 +108,7 @@ struct preproc_session_s {
     uint32_t apmSamplingRate;           // webRTC APM sampling rate (8/16 or 32 kHz)
     size_t frameCount;                  // buffer size before input resampler ( <=> apmFrameCount)
     uint32_t samplingRate;              // sampling rate at effect process interface
+    audio_format_t format;              // sample format at effect process interface
     uint32_t inChannelCount;            // input channel count
     uint32_t outChannelCount;           // output channel count
     uint32_t createdMsk;                // bit field containing IDs of crested pre processors
@@ -114,11 +116,14 @@ struct preproc_session_s {
     uint32_t processedMsk;              // bit field containing IDs of pre processors already
                                         // processed in current round
     webrtc::AudioFrame *procFrame;      // audio frame passed to webRTC AMP ProcessStream()
-    int16_t *inBuf;                     // input buffer used when resampling
+    bool floatApm;                      // near end frames go through the webRTC float API
+    uint8_t *apmBuf;                    // interleaved 10 ms frame for the float API
+    float *apmChannelBuf;               // planar 10 ms frame passed to the float API
+    uint8_t *inBuf;                     // input buffer used when resampling
     size_t inBufSize;                   // input buffer size in frames
     size_t framesIn;                    // number of frames in input buffer
     SpeexResamplerState *inResampler;   // handle on input speex resampler
-    int16_t *outBuf;                    // output buffer used when resampling
+    uint8_t *outBuf;                    // output buffer used when resampling
     size_t outBufSize;                  // output buffer size in frames
     size_t framesOut;                   // number of frames in output buffer
     SpeexResamplerState *outResampler;  // handle on output speex resampler
@@ -128,7 +133,10 @@ struct preproc_session_s {
     uint32_t revProcessedMsk;           // bit field containing IDs of pre processors with reverse
                                         // channel already processed in current round
     webrtc::AudioFrame *revFrame;       // audio frame passed to webRTC AMP AnalyzeReverseStream()
-    int16_t *revBuf;                    // reverse channel input buffer
+    bool revFloatApm;                   // reverse frames go through the webRTC float API
+    uint8_t *revApmBuf;                 // interleaved 10 ms reverse frame for the float API
+    float *revApmChannelBuf;            // planar 10 ms reverse frame passed to the float API
+    uint8_t *revBuf;                    // reverse channel input buffer
     size_t revBufSize;                  // reverse channel input buffer size
     size_t framesRev;                   // number of frames in reverse channel input buffer
     SpeexResamplerState *revResampler;  // handle on reverse channel input speex resampler
@@ -800,6 +808,176 @@ int Effect_Release(preproc_effect_t *effect)
 
 static const int kPreprocDefaultSr = 16000;
 static const int kPreProcDefaultCnl = 1;
+// most channels accepted on the capture and reverse streams
+static const uint32_t kPreProcMaxCnl = 8;
+
+// The webRTC AudioFrame API only takes 16 bit mono or stereo frames: float frames and frames
+// with more channels go through the float API, which takes planar frames in [-1.0, 1.0].
+bool Session_UsesFloatApm(preproc_session_t *session, uint32_t channelCount)
+{
+    return session->format == AUDIO_FORMAT_PCM_FLOAT || channelCount > 2;
+}
+
+// Allocates the buffers of the float API for 10 ms frames of inCnl channels in, outCnl out.
+int Session_AllocFloatApmBuffers(preproc_session_t *session, uint32_t inCnl, uint32_t outCnl,
+                                 uint8_t **buf, float **channelBuf)
+{
+    const uint32_t cnl = inCnl > outCnl ? inCnl : outCnl;
+    uint8_t *newBuf = (uint8_t *)realloc(*buf,
+            session->apmFrameCount * cnl * audio_bytes_per_sample(session->format));
+    if (newBuf == NULL) {
+        return -ENOMEM;
+    }
+    *buf = newBuf;
+    float *newChannelBuf = (float *)realloc(*channelBuf,
+            session->apmFrameCount * cnl * sizeof(float));
+    if (newChannelBuf == NULL) {
+        return -ENOMEM;
+    }
+    *channelBuf = newChannelBuf;
+    return 0;
+}
+
+// Splits interleaved frames of the session format in the planar buffers of the float API.
+void Session_Deinterleave(preproc_session_t *session, const uint8_t *in, uint32_t channelCount,
+                          float *channelBuf, float **channels)
+{
+    const size_t frames = session->apmFrameCount;
+    for (uint32_t ch = 0; ch < channelCount; ch++) {
+        channels[ch] = channelBuf + ch * frames;
+    }
+    if (session->format == AUDIO_FORMAT_PCM_FLOAT) {
+        const float *src = (const float *)in;
+        for (size_t i = 0; i < frames; i++) {
+            for (uint32_t ch = 0; ch < channelCount; ch++) {
+                channels[ch][i] = *src++;
+            }
+        }
+    } else {
+        const int16_t *src = (const int16_t *)in;
+        for (size_t i = 0; i < frames; i++) {
+            for (uint32_t ch = 0; ch < channelCount; ch++) {
+                channels[ch][i] = float_from_i16(*src++);
+            }
+        }
+    }
+}
+
+// Interleaves the planar buffers of the float API in frames of the session format.
+void Session_Interleave(preproc_session_t *session, float * const *channels,
+                        uint32_t channelCount, uint8_t *out)
+{
+    const size_t frames = session->apmFrameCount;
+    if (session->format == AUDIO_FORMAT_PCM_FLOAT) {
+        float *dst = (float *)out;
+        for (size_t i = 0; i < frames; i++) {
+            for (uint32_t ch = 0; ch < channelCount; ch++) {
+                *dst++ = channels[ch][i];
+            }
+        }
+    } else {
+        int16_t *dst = (int16_t *)out;
+        for (size_t i = 0; i < frames; i++) {
+            for (uint32_t ch = 0; ch < channelCount; ch++) {
+                *dst++ = clamp16_from_float(channels[ch][i]);
+            }
+        }
+    }
+}
+
+// Resamples interleaved frames of the session format.
+void Session_Resample(preproc_session_t *session, SpeexResamplerState *resampler,
+                      uint32_t channelCount, const uint8_t *in, spx_uint32_t *frIn,
+                      uint8_t *out, spx_uint32_t *frOut)
+{
+    if (session->format == AUDIO_FORMAT_PCM_FLOAT) {
+        if (channelCount == 1) {
+            speex_resampler_process_float(resampler, 0, (const float *)in, frIn,
+                                          (float *)out, frOut);
+        } else {
+            speex_resampler_process_interleaved_float(resampler, (const float *)in, frIn,
+                                                      (float *)out, frOut);
+        }
+    } else {
+        if (channelCount == 1) {
+            speex_resampler_process_int(resampler, 0, (const int16_t *)in, frIn,
+                                        (int16_t *)out, frOut);
+        } else {
+            speex_resampler_process_interleaved_int(resampler, (const int16_t *)in, frIn,
+                                                    (int16_t *)out, frOut);
+        }
+    }
+}
+
+// Frame in which the near end audio is gathered for Session_ProcessFrame().
+uint8_t *Session_ProcBuf(preproc_session_t *session)
+{
+    return session->floatApm ? session->apmBuf : (uint8_t *)session->procFrame->data_;
+}
+
+// Frame in which the far end audio is gathered for Session_AnalyzeReverseFrame().
+uint8_t *Session_RevProcBuf(preproc_session_t *session)
+{
+    return session->revFloatApm ? session->revApmBuf : (uint8_t *)session->revFrame->data_;
+}
+
+// Processes one 10 ms frame of near end audio read from in and written to out, which can be
+// the same buffer. When in is the frame returned by Session_ProcBuf() the AudioFrame API
+// does not copy it.
+void Session_ProcessFrame(preproc_session_t *session, const uint8_t *in, uint8_t *out)
+{
+    if (!session->floatApm) {
+        int16_t *data = session->procFrame->data_;
+        if (in != (const uint8_t *)data) {
+            memcpy(data, in, session->apmFrameCount * session->inChannelCount * sizeof(int16_t));
+        }
+        session->procFrame->samples_per_channel_ = session->apmFrameCount;
+        session->apm->ProcessStream(session->procFrame);
+        if (out != (uint8_t *)data) {
+            memcpy(out, data, session->apmFrameCount * session->outChannelCount * sizeof(int16_t));
+        }
+        return;
+    }
+
+    float *channels[kPreProcMaxCnl];
+    Session_Deinterleave(session, in, session->inChannelCount, session->apmChannelBuf, channels);
+    const webrtc::StreamConfig inConfig(session->apmSamplingRate, session->inChannelCount);
+    const webrtc::StreamConfig outConfig(session->apmSamplingRate, session->outChannelCount);
+    session->apm->ProcessStream(channels, inConfig, outConfig, channels);
+    Session_Interleave(session, channels, session->outChannelCount, out);
+}
+
+// Analyzes one 10 ms frame of far end audio.
+void Session_AnalyzeReverseFrame(preproc_session_t *session, const uint8_t *in)
+{
+    if (!session->revFloatApm) {
+        int16_t *data = session->revFrame->data_;
+        if (in != (const uint8_t *)data) {
+            memcpy(data, in, session->apmFrameCount * session->revChannelCount * sizeof(int16_t));
+        }
+        session->revFrame->samples_per_channel_ = session->apmFrameCount;
+        session->apm->AnalyzeReverseStream(session->revFrame);
+        return;
+    }
+
+    float *channels[kPreProcMaxCnl];
+    Session_Deinterleave(session, in, session->revChannelCount, session->revApmChannelBuf,
+                         channels);
+    const webrtc::StreamConfig revConfig(session->apmSamplingRate, session->revChannelCount);
+    session->apm->ProcessReverseStream(channels, revConfig, revConfig, channels);
+}
+
+#ifdef DUAL_MIC_TEST
+void Session_DumpPcm(preproc_session_t *session, const void *buf, size_t frames)
+{
+    pthread_mutex_lock(&gPcmDumpLock);
+    if (gPcmDumpFh != NULL) {
+        fwrite(buf, frames * session->inChannelCount * audio_bytes_per_sample(session->format),
+               1, gPcmDumpFh);
+    }
+    pthread_mutex_unlock(&gPcmDumpLock);
+}
+#endif
 
 int Session_Init(preproc_session_t *session)
 {
@@ -852,6 +1030,7 @@ extern "C" int Session_CreateEffect(preproc_session_t *session,
         session->apmFrameCount = (kPreprocDefaultSr) / 100;
         session->frameCount = session->apmFrameCount;
         session->samplingRate = kPreprocDefaultSr;
+        session->format = AUDIO_FORMAT_PCM_16_BIT;
         session->inChannelCount = kPreProcDefaultCnl;
         session->outChannelCount = kPreProcDefaultCnl;
         session->procFrame->sample_rate_hz_ = kPreprocDefaultSr;
@@ -863,6 +1042,12 @@ extern "C" int Session_CreateEffect(preproc_session_t *session,
         session->processedMsk = 0;
         session->revEnabledMsk = 0;
         session->revProcessedMsk = 0;
+        session->floatApm = false;
+        session->apmBuf = NULL;
+        session->apmChannelBuf = NULL;
+        session->revFloatApm = false;
+        session->revApmBuf = NULL;
+        session->revApmChannelBuf = NULL;
         session->inResampler = NULL;
         session->inBuf = NULL;
         session->inBufSize = 0;
@@ -917,12 +1102,20 @@ int Session_ReleaseEffect(preproc_session_t *session,
             speex_resampler_destroy(session->revResampler);
             session->revResampler = NULL;
         }
-        delete session->inBuf;
+        free(session->inBuf);
         session->inBuf = NULL;
-        delete session->outBuf;
+        free(session->outBuf);
         session->outBuf = NULL;
-        delete session->revBuf;
+        free(session->revBuf);
         session->revBuf = NULL;
+        free(session->apmBuf);
+        session->apmBuf = NULL;
+        free(session->apmChannelBuf);
+        session->apmChannelBuf = NULL;
+        free(session->revApmBuf);
+        session->revApmBuf = NULL;
+        free(session->revApmChannelBuf);
+        session->revApmChannelBuf = NULL;
 
         session->io = 0;
     }
@@ -939,7 +1132,11 @@ int Session_SetConfig(preproc_session_t *session, effect_config_t *config)
 
     if (config->inputCfg.samplingRate != config->outputCfg.samplingRate ||
         config->inputCfg.format != config->outputCfg.format ||
-        config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+        (config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+         config->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT)) {
+        return -EINVAL;
+    }
+    if (inCnl == 0 || inCnl > kPreProcMaxCnl || outCnl == 0 || outCnl > inCnl) {
         return -EINVAL;
     }
 
@@ -975,8 +1172,22 @@ int Session_SetConfig(preproc_session_t *session, effect_config_t *config)
         session->frameCount = (session->apmFrameCount * session->samplingRate) /
                 session->apmSamplingRate  + 1;
     }
+    session->format = config->inputCfg.format;
     session->inChannelCount = inCnl;
     session->outChannelCount = outCnl;
+    session->floatApm = Session_UsesFloatApm(session, inCnl);
+    session->revFloatApm = session->floatApm;
+    if (session->floatApm) {
+        if (Session_AllocFloatApmBuffers(session, inCnl, outCnl,
+                                         &session->apmBuf, &session->apmChannelBuf) != 0 ||
+                Session_AllocFloatApmBuffers(session, inCnl, inCnl,
+                                         &session->revApmBuf, &session->revApmChannelBuf) != 0) {
+            ALOGW("Session_SetConfig Cannot allocate float API buffers");
+            session->floatApm = false;
+            session->revFloatApm = false;
+            return -ENOMEM;
+        }
+    }
     session->procFrame->num_channels_ = inCnl;
     session->procFrame->sample_rate_hz_ = session->apmSamplingRate;
 
@@ -989,7 +1200,7 @@ int Session_SetConfig(preproc_session_t *session, effect_config_t *config)
     session->outBufSize = 0;
     session->framesIn = 0;
     session->framesOut = 0;
-
+    session->framesRev = 0;
 
     if (session->inResampler != NULL) {
         speex_resampler_destroy(session->inResampler);
@@ -1051,7 +1262,7 @@ void Session_GetConfig(preproc_session_t *session, effect_config_t *config)
 {
     memset(config, 0, sizeof(effect_config_t));
     config->inputCfg.samplingRate = config->outputCfg.samplingRate = session->samplingRate;
-    config->inputCfg.format = config->outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    config->inputCfg.format = config->outputCfg.format = session->format;
     config->inputCfg.channels = audio_channel_in_mask_from_count(session->inChannelCount);
     // "out" doesn't mean output device, so this is the correct API to convert channel count to mask
     config->outputCfg.channels = audio_channel_in_mask_from_count(session->outChannelCount);
@@ -1063,7 +1274,8 @@ int Session_SetReverseConfig(preproc_session_t *session, effect_config_t *config
 {
     if (config->inputCfg.samplingRate != config->outputCfg.samplingRate ||
             config->inputCfg.format != config->outputCfg.format ||
-            config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+            (config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+             config->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT)) {
         return -EINVAL;
     }
 
@@ -1074,10 +1286,13 @@ int Session_SetReverseConfig(preproc_session_t *session, effect_config_t *config
         return -ENOSYS;
     }
     if (config->inputCfg.samplingRate != session->samplingRate ||
-            config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+            config->inputCfg.format != session->format) {
         return -EINVAL;
     }
     uint32_t inCnl = audio_channel_count_from_out_mask(config->inputCfg.channels);
+    if (inCnl == 0 || inCnl > kPreProcMaxCnl) {
+        return -EINVAL;
+    }
     const webrtc::ProcessingConfig processing_config = {
        {{static_cast<int>(session->apmSamplingRate), session->inChannelCount},
         {static_cast<int>(session->apmSamplingRate), session->outChannelCount},
@@ -1087,6 +1302,28 @@ int Session_SetReverseConfig(preproc_session_t *session, effect_config_t *config
     if (status < 0) {
         return -EINVAL;
     }
+    session->revFloatApm = Session_UsesFloatApm(session, inCnl);
+    if (session->revFloatApm &&
+            Session_AllocFloatApmBuffers(session, inCnl, inCnl,
+                                         &session->revApmBuf, &session->revApmChannelBuf) != 0) {
+        ALOGW("Session_SetReverseConfig Cannot allocate float API buffers");
+        session->revFloatApm = false;
+        return -ENOMEM;
+    }
+    if (session->revResampler != NULL && inCnl != session->revChannelCount) {
+        int error;
+        speex_resampler_destroy(session->revResampler);
+        session->revResampler = speex_resampler_init(inCnl,
+                                                     session->samplingRate,
+                                                     session->apmSamplingRate,
+                                                     RESAMPLER_QUALITY,
+                                                     &error);
+        if (session->revResampler == NULL) {
+            ALOGW("Session_SetReverseConfig Cannot create speex resampler: %s",
+                 speex_resampler_strerror(error));
+            return -EINVAL;
+        }
+    }
     session->revChannelCount = inCnl;
     session->revFrame->num_channels_ = inCnl;
     session->revFrame->sample_rate_hz_ = session->apmSamplingRate;
@@ -1101,7 +1338,7 @@ void Session_GetReverseConfig(preproc_session_t *session, effect_config_t *confi
 {
     memset(config, 0, sizeof(effect_config_t));
     config->inputCfg.samplingRate = config->outputCfg.samplingRate = session->samplingRate;
-    config->inputCfg.format = config->outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    config->inputCfg.format = config->outputCfg.format = session->format;
     config->inputCfg.channels = config->outputCfg.channels =
             audio_channel_in_mask_from_count(session->revChannelCount);
     config->inputCfg.mask = config->outputCfg.mask =
@@ -1231,6 +1468,11 @@ int PreProcessingFx_Process(effect_handle_t     self,
 
     if ((session->processedMsk & session->enabledMsk) == session->enabledMsk) {
         effect->session->processedMsk = 0;
+        const size_t sampleSize = audio_bytes_per_sample(session->format);
+        const size_t inFrameSize = session->inChannelCount * sampleSize;
+        const size_t outFrameSize = session->outChannelCount * sampleSize;
+        const uint8_t *in = (const uint8_t *)inBuffer->raw;
+        uint8_t *out = (uint8_t *)outBuffer->raw;
         size_t framesRq = outBuffer->frameCount;
         size_t framesWr = 0;
         if (session->framesOut) {
@@ -1238,12 +1480,10 @@ int PreProcessingFx_Process(effect_handle_t     self,
             if (outBuffer->frameCount < fr) {
                 fr = outBuffer->frameCount;
             }
-            memcpy(outBuffer->s16,
-                  session->outBuf,
-                  fr * session->outChannelCount * sizeof(int16_t));
-            memcpy(session->outBuf,
-                  session->outBuf + fr * session->outChannelCount,
-                  (session->framesOut - fr) * session->outChannelCount * sizeof(int16_t));
+            memcpy(out, session->outBuf, fr * outFrameSize);
+            memmove(session->outBuf,
+                    session->outBuf + fr * outFrameSize,
+                    (session->framesOut - fr) * outFrameSize);
             session->framesOut -= fr;
             framesWr += fr;
         }
@@ -1253,16 +1493,39 @@ int PreProcessingFx_Process(effect_handle_t     self,
             return 0;
         }
 
+        // When nothing is pending, 10 ms frames go straight from the input to the output buffer
+        // instead of through the input and output buffers, as long as both buffers hold a whole
+        // frame: 10 ms aligned buffers never use the intermediate buffers.
+        if (session->inResampler == NULL && session->framesIn == 0 && framesWr == 0) {
+            size_t framesRd = 0;
+            while (inBuffer->frameCount - framesRd >= session->apmFrameCount &&
+                    framesRq - framesWr >= session->apmFrameCount) {
+#ifdef DUAL_MIC_TEST
+                Session_DumpPcm(session, in + framesRd * inFrameSize, session->apmFrameCount);
+#endif
+                Session_ProcessFrame(session,
+                                     in + framesRd * inFrameSize,
+                                     out + framesWr * outFrameSize);
+                framesRd += session->apmFrameCount;
+                framesWr += session->apmFrameCount;
+            }
+            if (framesRd != 0) {
+                inBuffer->frameCount = framesRd;
+                outBuffer->frameCount = framesWr;
+                return 0;
+            }
+        }
+
+        uint8_t *procBuf = Session_ProcBuf(session);
         if (session->inResampler != NULL) {
             size_t fr = session->frameCount - session->framesIn;
             if (inBuffer->frameCount < fr) {
                 fr = inBuffer->frameCount;
             }
             if (session->inBufSize < session->framesIn + fr) {
-                int16_t *buf;
+                uint8_t *buf;
                 session->inBufSize = session->framesIn + fr;
-                buf = (int16_t *)realloc(session->inBuf,
-                                 session->inBufSize * session->inChannelCount * sizeof(int16_t));
+                buf = (uint8_t *)realloc(session->inBuf, session->inBufSize * inFrameSize);
                 if (buf == NULL) {
                     session->framesIn = 0;
                     free(session->inBuf);
@@ -1271,16 +1534,9 @@ int PreProcessingFx_Process(effect_handle_t     self,
                 }
                 session->inBuf = buf;
             }
-            memcpy(session->inBuf + session->framesIn * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
+            memcpy(session->inBuf + session->framesIn * inFrameSize, in, fr * inFrameSize);
 #ifdef DUAL_MIC_TEST
-            pthread_mutex_lock(&gPcmDumpLock);
-            if (gPcmDumpFh != NULL) {
-                fwrite(inBuffer->raw,
-                       fr * session->inChannelCount * sizeof(int16_t), 1, gPcmDumpFh);
-            }
-            pthread_mutex_unlock(&gPcmDumpLock);
+            Session_DumpPcm(session, in, fr);
 #endif
 
             session->framesIn += fr;
@@ -1290,40 +1546,20 @@ int PreProcessingFx_Process(effect_handle_t     self,
             }
             spx_uint32_t frIn = session->framesIn;
             spx_uint32_t frOut = session->apmFrameCount;
-            if (session->inChannelCount == 1) {
-                speex_resampler_process_int(session->inResampler,
-                                            0,
-                                            session->inBuf,
-                                            &frIn,
-                                            session->procFrame->data_,
-                                            &frOut);
-            } else {
-                speex_resampler_process_interleaved_int(session->inResampler,
-                                                        session->inBuf,
-                                                        &frIn,
-                                                        session->procFrame->data_,
-                                                        &frOut);
-            }
-            memcpy(session->inBuf,
-                   session->inBuf + frIn * session->inChannelCount,
-                   (session->framesIn - frIn) * session->inChannelCount * sizeof(int16_t));
+            Session_Resample(session, session->inResampler, session->inChannelCount,
+                             session->inBuf, &frIn, procBuf, &frOut);
+            memmove(session->inBuf,
+                    session->inBuf + frIn * inFrameSize,
+                    (session->framesIn - frIn) * inFrameSize);
             session->framesIn -= frIn;
         } else {
             size_t fr = session->frameCount - session->framesIn;
             if (inBuffer->frameCount < fr) {
                 fr = inBuffer->frameCount;
             }
-            memcpy(session->procFrame->data_ + session->framesIn * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
-
+            memcpy(procBuf + session->framesIn * inFrameSize, in, fr * inFrameSize);
 #ifdef DUAL_MIC_TEST
-            pthread_mutex_lock(&gPcmDumpLock);
-            if (gPcmDumpFh != NULL) {
-                fwrite(inBuffer->raw,
-                       fr * session->inChannelCount * sizeof(int16_t), 1, gPcmDumpFh);
-            }
-            pthread_mutex_unlock(&gPcmDumpLock);
+            Session_DumpPcm(session, in, fr);
 #endif
 
             session->framesIn += fr;
@@ -1333,15 +1569,13 @@ int PreProcessingFx_Process(effect_handle_t     self,
             }
             session->framesIn = 0;
         }
-        session->procFrame->samples_per_channel_ = session->apmFrameCount;
 
-        effect->session->apm->ProcessStream(session->procFrame);
+        Session_ProcessFrame(session, procBuf, procBuf);
 
         if (session->outBufSize < session->framesOut + session->frameCount) {
-            int16_t *buf;
+            uint8_t *buf;
             session->outBufSize = session->framesOut + session->frameCount;
-            buf = (int16_t *)realloc(session->outBuf,
-                             session->outBufSize * session->outChannelCount * sizeof(int16_t));
+            buf = (uint8_t *)realloc(session->outBuf, session->outBufSize * outFrameSize);
             if (buf == NULL) {
                 session->framesOut = 0;
                 free(session->outBuf);
@@ -1354,37 +1588,24 @@ int PreProcessingFx_Process(effect_handle_t     self,
         if (session->outResampler != NULL) {
             spx_uint32_t frIn = session->apmFrameCount;
             spx_uint32_t frOut = session->frameCount;
-            if (session->inChannelCount == 1) {
-                speex_resampler_process_int(session->outResampler,
-                                    0,
-                                    session->procFrame->data_,
-                                    &frIn,
-                                    session->outBuf + session->framesOut * session->outChannelCount,
-                                    &frOut);
-            } else {
-                speex_resampler_process_interleaved_int(session->outResampler,
-                                    session->procFrame->data_,
-                                    &frIn,
-                                    session->outBuf + session->framesOut * session->outChannelCount,
-                                    &frOut);
-            }
+            Session_Resample(session, session->outResampler, session->outChannelCount,
+                             procBuf, &frIn,
+                             session->outBuf + session->framesOut * outFrameSize, &frOut);
             session->framesOut += frOut;
         } else {
-            memcpy(session->outBuf + session->framesOut * session->outChannelCount,
-                   session->procFrame->data_,
-                   session->frameCount * session->outChannelCount * sizeof(int16_t));
+            memcpy(session->outBuf + session->framesOut * outFrameSize,
+                   procBuf,
+                   session->frameCount * outFrameSize);
             session->framesOut += session->frameCount;
         }
         size_t fr = session->framesOut;
         if (framesRq - framesWr < fr) {
             fr = framesRq - framesWr;
         }
-        memcpy(outBuffer->s16 + framesWr * session->outChannelCount,
-              session->outBuf,
-              fr * session->outChannelCount * sizeof(int16_t));
-        memcpy(session->outBuf,
-              session->outBuf + fr * session->outChannelCount,
-              (session->framesOut - fr) * session->outChannelCount * sizeof(int16_t));
+        memcpy(out + framesWr * outFrameSize, session->outBuf, fr * outFrameSize);
+        memmove(session->outBuf,
+                session->outBuf + fr * outFrameSize,
+                (session->framesOut - fr) * outFrameSize);
         session->framesOut -= fr;
         outBuffer->frameCount += fr;
 
@@ -1798,16 +2019,32 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
 
     if ((session->revProcessedMsk & session->revEnabledMsk) == session->revEnabledMsk) {
         effect->session->revProcessedMsk = 0;
+        const size_t revFrameSize = session->revChannelCount *
+                audio_bytes_per_sample(session->format);
+        const uint8_t *in = (const uint8_t *)inBuffer->raw;
+
+        // 10 ms frames are analyzed in place when nothing is pending
+        if (session->revResampler == NULL && session->framesRev == 0 &&
+                inBuffer->frameCount >= session->apmFrameCount) {
+            size_t framesRd = 0;
+            while (inBuffer->frameCount - framesRd >= session->apmFrameCount) {
+                Session_AnalyzeReverseFrame(session, in + framesRd * revFrameSize);
+                framesRd += session->apmFrameCount;
+            }
+            inBuffer->frameCount = framesRd;
+            return 0;
+        }
+
+        uint8_t *revProcBuf = Session_RevProcBuf(session);
         if (session->revResampler != NULL) {
             size_t fr = session->frameCount - session->framesRev;
             if (inBuffer->frameCount < fr) {
                 fr = inBuffer->frameCount;
             }
             if (session->revBufSize < session->framesRev + fr) {
-                int16_t *buf;
+                uint8_t *buf;
                 session->revBufSize = session->framesRev + fr;
-                buf = (int16_t *)realloc(session->revBuf,
-                                 session->revBufSize * session->inChannelCount * sizeof(int16_t));
+                buf = (uint8_t *)realloc(session->revBuf, session->revBufSize * revFrameSize);
                 if (buf == NULL) {
                     session->framesRev = 0;
                     free(session->revBuf);
@@ -1816,9 +2053,7 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
                 }
                 session->revBuf = buf;
             }
-            memcpy(session->revBuf + session->framesRev * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
+            memcpy(session->revBuf + session->framesRev * revFrameSize, in, fr * revFrameSize);
 
             session->framesRev += fr;
             inBuffer->frameCount = fr;
@@ -1827,32 +2062,18 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
             }
             spx_uint32_t frIn = session->framesRev;
             spx_uint32_t frOut = session->apmFrameCount;
-            if (session->inChannelCount == 1) {
-                speex_resampler_process_int(session->revResampler,
-                                            0,
-                                            session->revBuf,
-                                            &frIn,
-                                            session->revFrame->data_,
-                                            &frOut);
-            } else {
-                speex_resampler_process_interleaved_int(session->revResampler,
-                                                        session->revBuf,
-                                                        &frIn,
-                                                        session->revFrame->data_,
-                                                        &frOut);
-            }
-            memcpy(session->revBuf,
-                   session->revBuf + frIn * session->inChannelCount,
-                   (session->framesRev - frIn) * session->inChannelCount * sizeof(int16_t));
+            Session_Resample(session, session->revResampler, session->revChannelCount,
+                             session->revBuf, &frIn, revProcBuf, &frOut);
+            memmove(session->revBuf,
+                    session->revBuf + frIn * revFrameSize,
+                    (session->framesRev - frIn) * revFrameSize);
             session->framesRev -= frIn;
         } else {
             size_t fr = session->frameCount - session->framesRev;
             if (inBuffer->frameCount < fr) {
                 fr = inBuffer->frameCount;
             }
-            memcpy(session->revFrame->data_ + session->framesRev * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
+            memcpy(revProcBuf + session->framesRev * revFrameSize, in, fr * revFrameSize);
             session->framesRev += fr;
             inBuffer->frameCount = fr;
             if (session->framesRev < session->frameCount) {
@@ -1860,8 +2081,7 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
             }
             session->framesRev = 0;
         }
-        session->revFrame->samples_per_channel_ = session->apmFrameCount;
-        effect->session->apm->AnalyzeReverseStream(session->revFrame);
+        Session_AnalyzeReverseFrame(session, revProcBuf);
         return 0;
     } else {
         return -ENODATA;
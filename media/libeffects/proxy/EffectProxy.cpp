@@ -136,8 +136,39 @@ int EffectProxyCreate(const effect_uuid_t *uuid,
         uuid_print.node[4], uuid_print.node[5]);
 #endif
 
+    // Both sub effects are created now so that switching between them never has to allocate
+    // or initialize one. Parameters and configuration are sent to both by Effect_command().
+    int status = pContext->aeli[SUB_FX_HOST]->create_effect(
+                          &pContext->desc[SUB_FX_HOST].uuid,
+                          pContext->sessionId, pContext->ioId,
+                          &(pContext->eHandle[SUB_FX_HOST]));
+    if (status != NO_ERROR || (pContext->eHandle[SUB_FX_HOST] == NULL)) {
+        ALOGV("EffectProxyCreate() Error creating SW sub effect");
+        delete[] pContext->sube;
+        delete[] pContext->desc;
+        delete[] pContext->aeli;
+        delete pContext;
+        return status != NO_ERROR ? status : -EINVAL;
+    }
+    status = pContext->aeli[SUB_FX_OFFLOAD]->create_effect(
+                          &pContext->desc[SUB_FX_OFFLOAD].uuid,
+                          pContext->sessionId, pContext->ioId,
+                          &(pContext->eHandle[SUB_FX_OFFLOAD]));
+    if (status != NO_ERROR || (pContext->eHandle[SUB_FX_OFFLOAD] == NULL)) {
+        ALOGV("EffectProxyCreate() Error creating HW effect");
+        pContext->eHandle[SUB_FX_OFFLOAD] = NULL;
+        // Do not return error here as SW effect is created
+        // Return error if the CMD_OFFLOAD sends the index as OFFLOAD
+    }
+    pContext->index = SUB_FX_HOST;
+
     pContext->replySize = PROXY_REPLY_SIZE_DEFAULT;
     pContext->replyData = (char *)malloc(PROXY_REPLY_SIZE_DEFAULT);
+    memset(&pContext->config, 0, sizeof(pContext->config));
+    pContext->canCrossfade = false;
+    pContext->crossfadeFrames = 0;
+    pContext->crossfadeBuffer = malloc(PROXY_CROSSFADE_FRAMES * PROXY_CROSSFADE_CHANNELS_MAX *
+                                       sizeof(float));
 
     *pHandle = (effect_handle_t)pContext;
     ALOGV("EffectCreate end");
@@ -153,6 +184,7 @@ int EffectProxyRelease(effect_handle_t handle) {
     ALOGV("EffectRelease");
     delete[] pContext->desc;
     free(pContext->replyData);
+    free(pContext->crossfadeBuffer);
 
     if (pContext->eHandle[SUB_FX_HOST])
        pContext->aeli[SUB_FX_HOST]->release_effect(pContext->eHandle[SUB_FX_HOST]);
@@ -178,6 +210,79 @@ int EffectProxyGetDescriptor(const effect_uuid_t *uuid,
     return 0;
 } /* end EffectProxyGetDescriptor */
 
+// Returns whether the host sub effect output can be faded in with this configuration
+static bool canCrossfade(const EffectContext *pContext, const effect_config_t *config) {
+    const buffer_config_t &in = config->inputCfg;
+    const buffer_config_t &out = config->outputCfg;
+    if (out.format != AUDIO_FORMAT_PCM_16_BIT && out.format != AUDIO_FORMAT_PCM_FLOAT) {
+        return false;
+    }
+    if (audio_channel_count_from_out_mask(out.channels) > PROXY_CROSSFADE_CHANNELS_MAX) {
+        return false;
+    }
+    // an insert effect writing its output fades in from its input
+    if (out.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE &&
+            (pContext->desc[SUB_FX_HOST].flags & EFFECT_FLAG_TYPE_MASK) !=
+                    EFFECT_FLAG_TYPE_AUXILIARY) {
+        return in.format == out.format && in.channels == out.channels;
+    }
+    return true;
+}
+
+// Processes with the host sub effect and fades its output in from the reference signal: the
+// previous output contents when accumulating, silence for an auxiliary effect or the input
+// for an insert effect.
+static int processCrossfade(EffectContext *pContext,
+                            audio_buffer_t *inBuffer,
+                            audio_buffer_t *outBuffer) {
+    const buffer_config_t &outCfg = pContext->config.outputCfg;
+    const uint32_t channelCount = audio_channel_count_from_out_mask(outCfg.channels);
+    const size_t sampleSize = audio_bytes_per_sample((audio_format_t)outCfg.format);
+    size_t frames = outBuffer->frameCount;
+    if (frames > pContext->crossfadeFrames) {
+        frames = pContext->crossfadeFrames;
+    }
+    const size_t samples = frames * channelCount;
+
+    if (outCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
+        memcpy(pContext->crossfadeBuffer, outBuffer->raw, samples * sampleSize);
+    } else if ((pContext->desc[SUB_FX_HOST].flags & EFFECT_FLAG_TYPE_MASK) ==
+            EFFECT_FLAG_TYPE_AUXILIARY) {
+        memset(pContext->crossfadeBuffer, 0, samples * sampleSize);
+    } else {
+        memcpy(pContext->crossfadeBuffer, inBuffer->raw, samples * sampleSize);
+    }
+
+    int ret = (*pContext->eHandle[SUB_FX_HOST])->process(pContext->eHandle[SUB_FX_HOST],
+                                                         inBuffer, outBuffer);
+    if (ret != 0) {
+        pContext->crossfadeFrames = 0;
+        return ret;
+    }
+
+    const float step = 1.0f / PROXY_CROSSFADE_FRAMES;
+    float gain = (PROXY_CROSSFADE_FRAMES - pContext->crossfadeFrames + 1) * step;
+    if (outCfg.format == AUDIO_FORMAT_PCM_FLOAT) {
+        const float *ref = (const float *)pContext->crossfadeBuffer;
+        float *out = outBuffer->f32;
+        for (size_t i = 0; i < frames; i++, gain += step) {
+            for (uint32_t ch = 0; ch < channelCount; ch++, ref++, out++) {
+                *out = *ref + gain * (*out - *ref);
+            }
+        }
+    } else {
+        const int16_t *ref = (const int16_t *)pContext->crossfadeBuffer;
+        int16_t *out = outBuffer->s16;
+        for (size_t i = 0; i < frames; i++, gain += step) {
+            for (uint32_t ch = 0; ch < channelCount; ch++, ref++, out++) {
+                *out = (int16_t)(*ref + gain * (*out - *ref));
+            }
+        }
+    }
+    pContext->crossfadeFrames -= frames;
+    return 0;
+}
+
 /* Effect Control Interface Implementation: Process */
 int Effect_process(effect_handle_t     self,
                               audio_buffer_t         *inBuffer,
@@ -189,6 +294,12 @@ int Effect_process(effect_handle_t     self,
         int index = pContext->index;
         // if the index refers to HW , do not do anything. Just return.
         if (index == SUB_FX_HOST) {
+            if (pContext->crossfadeFrames > 0) {
+                if (pContext->canCrossfade) {
+                    return processCrossfade(pContext, inBuffer, outBuffer);
+                }
+                pContext->crossfadeFrames = 0;
+            }
             ret = (*pContext->eHandle[index])->process(pContext->eHandle[index],
                                                        inBuffer, outBuffer);
         }
@@ -210,31 +321,6 @@ int Effect_command(effect_handle_t  self,
         ALOGV("Effect_command() Proxy context is NULL");
         return -EINVAL;
     }
-    if (pContext->eHandle[SUB_FX_HOST] == NULL) {
-        ALOGV("Effect_command() Calling HOST EffectCreate");
-        status = pContext->aeli[SUB_FX_HOST]->create_effect(
-                              &pContext->desc[SUB_FX_HOST].uuid,
-                              pContext->sessionId, pContext->ioId,
-                              &(pContext->eHandle[SUB_FX_HOST]));
-        if (status != NO_ERROR || (pContext->eHandle[SUB_FX_HOST] == NULL)) {
-            ALOGV("Effect_command() Error creating SW sub effect");
-            return status;
-        }
-    }
-    if (pContext->eHandle[SUB_FX_OFFLOAD] == NULL) {
-        ALOGV("Effect_command() Calling OFFLOAD EffectCreate");
-        status = pContext->aeli[SUB_FX_OFFLOAD]->create_effect(
-                              &pContext->desc[SUB_FX_OFFLOAD].uuid,
-                              pContext->sessionId, pContext->ioId,
-                              &(pContext->eHandle[SUB_FX_OFFLOAD]));
-        if (status != NO_ERROR || (pContext->eHandle[SUB_FX_OFFLOAD] == NULL)) {
-            ALOGV("Effect_command() Error creating HW effect");
-            pContext->eHandle[SUB_FX_OFFLOAD] = NULL;
-            // Do not return error here as SW effect is created
-            // Return error if the CMD_OFFLOAD sends the index as OFFLOAD
-        }
-        pContext->index = SUB_FX_HOST;
-    }
     // EFFECT_CMD_OFFLOAD used to (1) send whether the thread is offload or not
     // (2) Send the ioHandle of the effectThread when the effect
     // is moved from one type of thread to another.
@@ -248,14 +334,26 @@ int Effect_command(effect_handle_t  self,
         }
         effect_offload_param_t* offloadParam = (effect_offload_param_t*)pCmdData;
         // Assign the effect context index based on isOffload field of the structure
+        int previousIndex = pContext->index;
         pContext->index = offloadParam->isOffload ? SUB_FX_OFFLOAD : SUB_FX_HOST;
         // if the index is HW and the HW effect is unavailable, return error
         // and reset the index to SW
         if (pContext->eHandle[pContext->index] == NULL) {
             ALOGV("Effect_command()CMD_OFFLOAD sub effect unavailable");
+            pContext->index = SUB_FX_HOST;
             *(int*)pReplyData = FAILED_TRANSACTION;
             return FAILED_TRANSACTION;
         }
+        pContext->crossfadeFrames = 0;
+        if (previousIndex == SUB_FX_OFFLOAD && pContext->index == SUB_FX_HOST) {
+            // The host sub effect still holds the audio it processed before being offloaded:
+            // flush it (parameters are kept) and fade the fresh output in.
+            int resetStatus;
+            uint32_t resetSize = sizeof(resetStatus);
+            (*pContext->eHandle[SUB_FX_HOST])->command(pContext->eHandle[SUB_FX_HOST],
+                    EFFECT_CMD_RESET, 0, NULL, &resetSize, &resetStatus);
+            pContext->crossfadeFrames = PROXY_CROSSFADE_FRAMES;
+        }
         pContext->ioId = offloadParam->ioHandle;
         ALOGV("Effect_command()CMD_OFFLOAD index:%d io %d", pContext->index, pContext->ioId);
         // Update the DSP wrapper with the new ioHandle.
@@ -328,6 +426,16 @@ int Effect_command(effect_handle_t  self,
                              pCmdData, subReplySize[i], subReplyData[i]);
     }
 
+    // AudioFlinger configures the effect after moving it to a new output, so the crossfade
+    // started by EFFECT_CMD_OFFLOAD is checked against the configuration when processing.
+    if (cmdCode == EFFECT_CMD_SET_CONFIG && cmdSize == sizeof(effect_config_t) &&
+            pCmdData != NULL && *subStatus[SUB_FX_HOST] == 0 &&
+            subReplyData[SUB_FX_HOST] != NULL && *(int *)subReplyData[SUB_FX_HOST] == 0) {
+        pContext->config = *(effect_config_t *)pCmdData;
+        pContext->canCrossfade = pContext->crossfadeBuffer != NULL &&
+                canCrossfade(pContext, &pContext->config);
+    }
+
     return status;
 }    /* end Effect_command */
 
@@ -62,6 +62,12 @@ const struct effect_interface_s gEffectInterface = {
 #define PROXY_REPLY_SIZE_MAX     (64 * 1024) // must be power of two
 #define PROXY_REPLY_SIZE_DEFAULT 32          // must be power of two
 
+// When the effect moves from an offloaded output back to a PCM output, the host sub effect,
+// which was not processing while offloaded, is reset and its output faded in over
+// PROXY_CROSSFADE_FRAMES frames from the signal it would replace.
+#define PROXY_CROSSFADE_FRAMES       512
+#define PROXY_CROSSFADE_CHANNELS_MAX 8
+
 struct EffectContext {
   const struct effect_interface_s  *common_itfe; // Holds the itfe of the Proxy
   sub_effect_entry_t** sube;                     // Points to the sub effects
@@ -76,6 +82,10 @@ struct EffectContext {
   effect_uuid_t         uuid;        // UUID of the Proxy
   char*                 replyData;   // temporary buffer for non active sub effect command reply
   uint32_t              replySize;   // current size of temporary reply buffer
+  effect_config_t       config;      // last configuration accepted by the host sub effect
+  bool                  canCrossfade; // config is supported by the crossfade
+  uint32_t              crossfadeFrames; // frames left in the current crossfade
+  void*                 crossfadeBuffer; // signal the host sub effect output is faded in from
 };
 
 #if __cplusplus
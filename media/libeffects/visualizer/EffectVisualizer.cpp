@@ -18,6 +18,7 @@
 //#define LOG_NDEBUG 0
 #include <log/log.h>
 #include <assert.h>
+#include <atomic>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,6 +27,7 @@
 #include <math.h>
 #include <audio_effects/effect_visualizer.h>
 #include <cutils/log.h>
+#include <media/EffectVisualizerApi.h>
 
 
 extern "C" {
@@ -74,14 +76,31 @@ struct BufferStats {
 struct VisualizerContext {
     const struct effect_interface_s *mItfe;
     effect_config_t mConfig;
-    uint32_t mCaptureIdx;
+    // The capture buffer is a single writer ring: process() writes the samples and then
+    // publishes the write index and the update time, commands only read them.
+    std::atomic<uint32_t> mCaptureIdx;
     uint32_t mCaptureSize;
     uint32_t mScalingMode;
     uint8_t mState;
     uint32_t mLastCaptureIdx;
     uint32_t mLatency;
-    struct timespec mBufferUpdateTime;
+    std::atomic<int64_t> mBufferUpdateTimeNs; // CLOCK_MONOTONIC, 0 if not updated
     uint8_t mCaptureBuf[CAPTURE_BUF_SIZE];
+    // FFT of the latest capture, shared by all the clients of the effect
+    uint32_t mFftSize;          // 0 if mFft is not valid
+    uint32_t mFftWindow;
+    uint32_t mFftCaptureIdx;    // mCaptureIdx when mFft was computed
+    uint8_t mFft[VISUALIZER_FFT_SIZE_MAX];
+    uint8_t mFftCapture[VISUALIZER_FFT_SIZE_MAX];
+    // window and twiddle factors, exp(-2 pi i k / size) for k < size / 2, for the size and window
+    // of the last FFT
+    uint32_t mFftTableSize;
+    uint32_t mFftTableWindow;
+    float mFftWindowTable[VISUALIZER_FFT_SIZE_MAX];
+    float mFftCos[VISUALIZER_FFT_SIZE_MAX / 2];
+    float mFftSin[VISUALIZER_FFT_SIZE_MAX / 2];
+    float mFftReal[VISUALIZER_FFT_SIZE_MAX / 2];
+    float mFftImag[VISUALIZER_FFT_SIZE_MAX / 2];
     // for measurements
     uint8_t mChannelCount; // to avoid recomputing it every time a buffer is processed
     uint32_t mMeasurementMode;
@@ -93,18 +112,22 @@ struct VisualizerContext {
 //
 //--- Local functions
 //
+static int64_t Visualizer_getMonotonicNs() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+        return 0;
+    }
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 uint32_t Visualizer_getDeltaTimeMsFromUpdatedTime(VisualizerContext* pContext) {
     uint32_t deltaMs = 0;
-    if (pContext->mBufferUpdateTime.tv_sec != 0) {
-        struct timespec ts;
-        if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
-            time_t secs = ts.tv_sec - pContext->mBufferUpdateTime.tv_sec;
-            long nsec = ts.tv_nsec - pContext->mBufferUpdateTime.tv_nsec;
-            if (nsec < 0) {
-                --secs;
-                nsec += 1000000000;
-            }
-            deltaMs = secs * 1000 + nsec / 1000000;
+    const int64_t updateTimeNs =
+            pContext->mBufferUpdateTimeNs.load(std::memory_order_acquire);
+    if (updateTimeNs != 0) {
+        const int64_t nowNs = Visualizer_getMonotonicNs();
+        if (nowNs != 0) {
+            deltaMs = (nowNs - updateTimeNs) / 1000000;
         }
     }
     return deltaMs;
@@ -113,11 +136,208 @@ uint32_t Visualizer_getDeltaTimeMsFromUpdatedTime(VisualizerContext* pContext) {
 
 void Visualizer_reset(VisualizerContext *pContext)
 {
-    pContext->mCaptureIdx = 0;
+    pContext->mCaptureIdx.store(0, std::memory_order_relaxed);
     pContext->mLastCaptureIdx = 0;
-    pContext->mBufferUpdateTime.tv_sec = 0;
+    pContext->mBufferUpdateTimeNs.store(0, std::memory_order_relaxed);
     pContext->mLatency = 0;
     memset(pContext->mCaptureBuf, 0x80, CAPTURE_BUF_SIZE);
+    pContext->mFftSize = 0;
+}
+
+//----------------------------------------------------------------------------
+// Visualizer_capture()
+//----------------------------------------------------------------------------
+// Purpose: Copy the latest captureSize samples of the capture buffer, taking the latency
+//  into account, or silence if the framework has stopped playing audio.
+//
+// Inputs:
+//  pContext:   effect engine context
+//  captureSize: number of samples, at most CAPTURE_BUF_SIZE
+//
+// Outputs:
+//  pCapture:   captureSize samples, in PCM 8 bit unsigned format
+//
+//----------------------------------------------------------------------------
+
+static void Visualizer_capture(VisualizerContext *pContext, uint8_t *pCapture,
+        uint32_t captureSize)
+{
+    const uint32_t captureIdx = pContext->mCaptureIdx.load(std::memory_order_acquire);
+    const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
+
+    // if audio framework has stopped playing audio although the effect is still
+    // active we must clear the capture buffer to return silence
+    if ((pContext->mLastCaptureIdx == captureIdx) &&
+            (pContext->mBufferUpdateTimeNs.load(std::memory_order_relaxed) != 0) &&
+            (deltaMs > MAX_STALL_TIME_MS)) {
+            ALOGV("capture going to idle");
+            pContext->mBufferUpdateTimeNs.store(0, std::memory_order_relaxed);
+            memset(pCapture, 0x80, captureSize);
+    } else {
+        int32_t latencyMs = pContext->mLatency;
+        latencyMs -= deltaMs;
+        if (latencyMs < 0) {
+            latencyMs = 0;
+        }
+        uint32_t deltaSmpl = captureSize
+                + pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
+
+        // large sample rate, latency, or capture size, could cause overflow.
+        // do not offset more than the size of buffer.
+        if (deltaSmpl > CAPTURE_BUF_SIZE) {
+            android_errorWriteLog(0x534e4554, "31781965");
+            deltaSmpl = CAPTURE_BUF_SIZE;
+        }
+
+        int32_t capturePoint = captureIdx - deltaSmpl;
+        // a negative capturePoint means we wrap the buffer.
+        if (capturePoint < 0) {
+            uint32_t size = -capturePoint;
+            if (size > captureSize) {
+                size = captureSize;
+            }
+            memcpy(pCapture,
+                   pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
+                   size);
+            pCapture += size;
+            captureSize -= size;
+            capturePoint = 0;
+        }
+        memcpy(pCapture,
+               pContext->mCaptureBuf + capturePoint,
+               captureSize);
+    }
+
+    pContext->mLastCaptureIdx = captureIdx;
+}
+
+// Computes the window and the twiddle factors for FFTs of size samples.
+static void Visualizer_initFftTables(VisualizerContext *pContext, uint32_t size, uint32_t window)
+{
+    if (pContext->mFftTableSize == size && pContext->mFftTableWindow == window) {
+        return;
+    }
+    float sum = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        const double phase = 2 * M_PI * i / size;
+        double w;
+        switch (window) {
+        case VISUALIZER_FFT_WINDOW_HANN:
+            w = 0.5 - 0.5 * cos(phase);
+            break;
+        case VISUALIZER_FFT_WINDOW_HAMMING:
+            w = 0.54 - 0.46 * cos(phase);
+            break;
+        case VISUALIZER_FFT_WINDOW_BLACKMAN:
+            w = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2 * phase);
+            break;
+        default:
+            w = 1.0;
+            break;
+        }
+        pContext->mFftWindowTable[i] = w;
+        sum += w;
+    }
+    // unit coherent gain: a sine keeps the same peak whatever the window
+    const float scale = size / sum;
+    for (uint32_t i = 0; i < size; i++) {
+        pContext->mFftWindowTable[i] *= scale;
+    }
+    for (uint32_t k = 0; k < size / 2; k++) {
+        const double phase = -2 * M_PI * k / size;
+        pContext->mFftCos[k] = cos(phase);
+        pContext->mFftSin[k] = sin(phase);
+    }
+    pContext->mFftTableSize = size;
+    pContext->mFftTableWindow = window;
+}
+
+// Converts an FFT value to 8 bits the way the client side fixed point FFT does.
+static inline uint8_t Visualizer_fftByte(float value)
+{
+    int32_t tmp = (int32_t)value;
+    if (tmp > INT16_MAX) {
+        tmp = INT16_MAX;
+    } else if (tmp < INT16_MIN) {
+        tmp = INT16_MIN;
+    }
+    while (tmp > 127 || tmp < -128) tmp >>= 1;
+    return (uint8_t)tmp;
+}
+
+//----------------------------------------------------------------------------
+// Visualizer_fft()
+//----------------------------------------------------------------------------
+// Purpose: Compute the FFT of a capture of size samples, in the format of
+//  Visualizer::getFft() and with the same scale.  The real FFT is computed with a complex
+//  FFT of size / 2 points, in float.
+//
+// Inputs:
+//  pContext:   effect engine context
+//  pCapture:   size samples, in PCM 8 bit unsigned format
+//  size:       power of 2 in [VISUALIZER_FFT_SIZE_MIN, VISUALIZER_FFT_SIZE_MAX]
+//  window:     one of visualizer_fft_window_e
+//
+// Outputs:
+//  pFft:       size bytes
+//
+//----------------------------------------------------------------------------
+
+static void Visualizer_fft(VisualizerContext *pContext, const uint8_t *pCapture, uint32_t size,
+        uint32_t window, uint8_t *pFft)
+{
+    Visualizer_initFftTables(pContext, size, window);
+
+    const uint32_t half = size / 2;
+    const float *w = pContext->mFftWindowTable;
+    const float *c = pContext->mFftCos;
+    const float *s = pContext->mFftSin;
+    float *re = pContext->mFftReal;
+    float *im = pContext->mFftImag;
+
+    // even samples in the real part and odd samples in the imaginary part, in bit reversed order
+    for (uint32_t n = 0, r = 0; n < half; n++) {
+        re[r] = (int8_t)(pCapture[2 * n] ^ 0x80) * w[2 * n];
+        im[r] = (int8_t)(pCapture[2 * n + 1] ^ 0x80) * w[2 * n + 1];
+        // increment r in bit reversed order
+        uint32_t bit = half >> 1;
+        while (bit != 0 && (r & bit) != 0) {
+            r ^= bit;
+            bit >>= 1;
+        }
+        r |= bit;
+    }
+    for (uint32_t length = 2; length <= half; length <<= 1) {
+        const uint32_t step = size / length;
+        for (uint32_t i = 0; i < half; i += length) {
+            for (uint32_t j = 0; j < length / 2; j++) {
+                const float wr = c[j * step];
+                const float wi = s[j * step];
+                const uint32_t a = i + j;
+                const uint32_t b = a + length / 2;
+                const float vr = re[b] * wr - im[b] * wi;
+                const float vi = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - vr;
+                im[b] = im[a] - vi;
+                re[a] += vr;
+                im[a] += vi;
+            }
+        }
+    }
+
+    // the client side FFT output is the DFT of the signed 8 bit samples times 8 / size
+    const float scale = 8.0f / size;
+    pFft[0] = Visualizer_fftByte((re[0] + im[0]) * scale);
+    pFft[1] = Visualizer_fftByte((re[0] - im[0]) * scale);
+    for (uint32_t k = 1; k < half; k++) {
+        // split the spectra of the even and odd samples
+        const float er = 0.5f * (re[k] + re[half - k]);
+        const float ei = 0.5f * (im[k] - im[half - k]);
+        const float or_ = 0.5f * (im[k] + im[half - k]);
+        const float oi = -0.5f * (re[k] - re[half - k]);
+        pFft[2 * k] = Visualizer_fftByte((er + c[k] * or_ - s[k] * oi) * scale);
+        pFft[2 * k + 1] = Visualizer_fftByte((ei + c[k] * oi + s[k] * or_) * scale);
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -208,6 +428,8 @@ int Visualizer_init(VisualizerContext *pContext)
     // visualization initialization
     pContext->mCaptureSize = VISUALIZER_CAPTURE_SIZE_MAX;
     pContext->mScalingMode = VISUALIZER_SCALING_MODE_NORMALIZED;
+    pContext->mFftSize = 0;
+    pContext->mFftTableSize = 0;
 
     // measurement initialization
     pContext->mChannelCount =
@@ -378,7 +600,7 @@ int Visualizer_process(
     uint32_t captIdx;
     uint32_t inIdx;
     uint8_t *buf = pContext->mCaptureBuf;
-    for (inIdx = 0, captIdx = pContext->mCaptureIdx;
+    for (inIdx = 0, captIdx = pContext->mCaptureIdx.load(std::memory_order_relaxed);
          inIdx < inBuffer->frameCount;
          inIdx++, captIdx++) {
         if (captIdx >= CAPTURE_BUF_SIZE) {
@@ -390,13 +612,9 @@ int Visualizer_process(
         buf[captIdx] = ((uint8_t)smp)^0x80;
     }
 
-    // XXX the following two should really be atomic, though it probably doesn't
-    // matter much for visualization purposes
-    pContext->mCaptureIdx = captIdx;
-    // update last buffer update time stamp
-    if (clock_gettime(CLOCK_MONOTONIC, &pContext->mBufferUpdateTime) < 0) {
-        pContext->mBufferUpdateTime.tv_sec = 0;
-    }
+    // publish the samples, then the last buffer update time stamp
+    pContext->mCaptureIdx.store(captIdx, std::memory_order_release);
+    pContext->mBufferUpdateTimeNs.store(Visualizer_getMonotonicNs(), std::memory_order_release);
 
     if (inBuffer->raw != outBuffer->raw) {
         if (pContext->mConfig.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
@@ -568,58 +786,44 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             return -EINVAL;
         }
         if (pContext->mState == VISUALIZER_STATE_ACTIVE) {
-            const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
-
-            // if audio framework has stopped playing audio although the effect is still
-            // active we must clear the capture buffer to return silence
-            if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
-                    (pContext->mBufferUpdateTime.tv_sec != 0) &&
-                    (deltaMs > MAX_STALL_TIME_MS)) {
-                    ALOGV("capture going to idle");
-                    pContext->mBufferUpdateTime.tv_sec = 0;
-                    memset(pReplyData, 0x80, captureSize);
-            } else {
-                int32_t latencyMs = pContext->mLatency;
-                latencyMs -= deltaMs;
-                if (latencyMs < 0) {
-                    latencyMs = 0;
-                }
-                uint32_t deltaSmpl = captureSize
-                        + pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
-
-                // large sample rate, latency, or capture size, could cause overflow.
-                // do not offset more than the size of buffer.
-                if (deltaSmpl > CAPTURE_BUF_SIZE) {
-                    android_errorWriteLog(0x534e4554, "31781965");
-                    deltaSmpl = CAPTURE_BUF_SIZE;
-                }
-
-                int32_t capturePoint = pContext->mCaptureIdx - deltaSmpl;
-                // a negative capturePoint means we wrap the buffer.
-                if (capturePoint < 0) {
-                    uint32_t size = -capturePoint;
-                    if (size > captureSize) {
-                        size = captureSize;
-                    }
-                    memcpy(pReplyData,
-                           pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
-                           size);
-                    pReplyData = (char *)pReplyData + size;
-                    captureSize -= size;
-                    capturePoint = 0;
-                }
-                memcpy(pReplyData,
-                       pContext->mCaptureBuf + capturePoint,
-                       captureSize);
-            }
-
-            pContext->mLastCaptureIdx = pContext->mCaptureIdx;
+            Visualizer_capture(pContext, (uint8_t *)pReplyData, captureSize);
         } else {
             memset(pReplyData, 0x80, captureSize);
         }
 
         } break;
 
+    case VISUALIZER_CMD_FFT: {
+        if (pCmdData == NULL || cmdSize != 2 * sizeof(uint32_t)) {
+            return -EINVAL;
+        }
+        const uint32_t fftSize = *(uint32_t *)pCmdData;
+        const uint32_t window = *((uint32_t *)pCmdData + 1);
+        if (fftSize < VISUALIZER_FFT_SIZE_MIN || fftSize > VISUALIZER_FFT_SIZE_MAX ||
+                (fftSize & (fftSize - 1)) != 0 || window >= VISUALIZER_FFT_WINDOW_CNT ||
+                pReplyData == NULL || replySize == NULL || *replySize != fftSize) {
+            ALOGV("VISUALIZER_CMD_FFT() error size %" PRIu32 " window %" PRIu32,
+                    fftSize, window);
+            return -EINVAL;
+        }
+        if (pContext->mState != VISUALIZER_STATE_ACTIVE) {
+            memset(pReplyData, 0, fftSize);
+            break;
+        }
+        // all the clients polling within the same buffer get the same FFT
+        const uint32_t captureIdx = pContext->mCaptureIdx.load(std::memory_order_acquire);
+        if (pContext->mFftSize != fftSize || pContext->mFftWindow != window ||
+                pContext->mFftCaptureIdx != captureIdx ||
+                pContext->mBufferUpdateTimeNs.load(std::memory_order_relaxed) == 0) {
+            Visualizer_capture(pContext, pContext->mFftCapture, fftSize);
+            Visualizer_fft(pContext, pContext->mFftCapture, fftSize, window, pContext->mFft);
+            pContext->mFftSize = fftSize;
+            pContext->mFftWindow = window;
+            pContext->mFftCaptureIdx = captureIdx;
+        }
+        memcpy(pReplyData, pContext->mFft, fftSize);
+        } break;
+
     case VISUALIZER_CMD_MEASURE: {
         if (pReplyData == NULL || replySize == NULL ||
                 *replySize < (sizeof(int32_t) * MEASUREMENT_COUNT)) {
@@ -1092,15 +1092,28 @@ nsecs_t AudioRecord::processAudioBuffer()
             }
         }
 
+        // The callback reads directly from the shared buffer.  If it consumes only part of
+        // the chunk, offer it the rest of the same chunk, and release all it read at once.
         size_t reqSize = audioBuffer.size;
-        mCbf(EVENT_MORE_DATA, mUserData, &audioBuffer);
-        size_t readSize = audioBuffer.size;
-
-        // Sanity check on returned size
-        if (ssize_t(readSize) < 0 || readSize > reqSize) {
-            ALOGE("EVENT_MORE_DATA requested %zu bytes but callback returned %zd bytes",
-                    reqSize, ssize_t(readSize));
-            return NS_NEVER;
+        size_t readSize = 0;
+        Buffer chunk = audioBuffer;
+        while (readSize < reqSize) {
+            size_t chunkSize = chunk.size;
+            mCbf(EVENT_MORE_DATA, mUserData, &chunk);
+
+            // Sanity check on returned size
+            if (ssize_t(chunk.size) < 0 || chunk.size > chunkSize) {
+                ALOGE("EVENT_MORE_DATA requested %zu bytes but callback returned %zd bytes",
+                        chunkSize, ssize_t(chunk.size));
+                return NS_NEVER;
+            }
+            if (chunk.size == 0) {
+                break;
+            }
+            readSize += chunk.size;
+            chunk.i8 += chunk.size;
+            chunk.size = reqSize - readSize;
+            chunk.frameCount = chunk.size / mFrameSize;
         }
 
         if (readSize == 0) {
@@ -1113,6 +1126,7 @@ nsecs_t AudioRecord::processAudioBuffer()
 
         size_t releasedFrames = readSize / mFrameSize;
         audioBuffer.frameCount = releasedFrames;
+        audioBuffer.size = readSize;
         mRemainingFrames -= releasedFrames;
         if (misalignment >= releasedFrames) {
             misalignment -= releasedFrames;
@@ -1123,10 +1137,9 @@ nsecs_t AudioRecord::processAudioBuffer()
         releaseBuffer(&audioBuffer);
         readFrames += releasedFrames;
 
-        // FIXME here is where we would repeat EVENT_MORE_DATA again on same advanced buffer
-        // if callback doesn't like to accept the full chunk
         if (readSize < reqSize) {
-            continue;
+            // The callback stopped consuming part way through the chunk, same as above
+            return WAIT_PERIOD_MS * 1000000LL;
         }
 
         // There could be enough non-contiguous frames available to satisfy the remaining request
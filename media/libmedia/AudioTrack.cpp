@@ -68,6 +68,10 @@ static int64_t getNowUs()
     return convertTimespecToUs(tv);
 }
 
+// a timestamp published by the server for an offloaded or direct track is used
+// instead of a Binder call if it is at most this old
+static const int64_t kMaxSharedTimestampAgeNs = 100 * 1000000LL;   // 100 ms
+
 // FIXME: we don't use the pitch setting in the time stretcher (not working);
 // instead we emulate it using our sample rate converter.
 static const bool kFixPitch = true; // enable pitch fix
@@ -1593,13 +1597,16 @@ status_t AudioTrack::obtainBuffer(Buffer* audioBuffer, int32_t waitCount, size_t
 }
 
 status_t AudioTrack::obtainBuffer(Buffer* audioBuffer, const struct timespec *requested,
-        struct timespec *elapsed, size_t *nonContig)
+        struct timespec *elapsed, size_t *nonContig, Buffer* wrapped)
 {
     // previous and new IAudioTrack sequence numbers are used to detect track re-creation
     uint32_t oldSequence = 0;
     uint32_t newSequence;
 
-    Proxy::Buffer buffer;
+    Proxy::Buffer buffers[2];
+    Proxy::Buffer& buffer = buffers[0];
+    buffers[1].mFrameCount = 0;
+    buffers[1].mRaw = NULL;
     status_t status = NO_ERROR;
 
     static const int32_t kMaxTries = 5;
@@ -1655,7 +1662,11 @@ status_t AudioTrack::obtainBuffer(Buffer* audioBuffer, const struct timespec *re
 
         buffer.mFrameCount = audioBuffer->frameCount;
         // FIXME starts the requested timeout and elapsed over from scratch
-        status = proxy->obtainBuffer(&buffer, requested, elapsed);
+        if (wrapped != NULL) {
+            status = proxy->obtainBuffers(buffers, requested, elapsed);
+        } else {
+            status = proxy->obtainBuffer(&buffer, requested, elapsed);
+        }
     } while (((status == DEAD_OBJECT) || (status == NOT_ENOUGH_DATA)) && (tryCounter-- > 0));
 
     audioBuffer->frameCount = buffer.mFrameCount;
@@ -1664,6 +1675,11 @@ status_t AudioTrack::obtainBuffer(Buffer* audioBuffer, const struct timespec *re
     if (nonContig != NULL) {
         *nonContig = buffer.mNonContig;
     }
+    if (wrapped != NULL) {
+        wrapped->frameCount = buffers[1].mFrameCount;
+        wrapped->size = buffers[1].mFrameCount * mFrameSize;
+        wrapped->raw = buffers[1].mRaw;
+    }
     return status;
 }
 
@@ -1679,11 +1695,16 @@ void AudioTrack::releaseBuffer(const Buffer* audioBuffer)
         return;
     }
 
+    AutoMutex lock(mLock);
+    releaseBuffer_l(stepCount);
+}
+
+void AudioTrack::releaseBuffer_l(size_t stepCount)
+{
     Proxy::Buffer buffer;
     buffer.mFrameCount = stepCount;
-    buffer.mRaw = audioBuffer->raw;
+    buffer.mRaw = NULL;     // ignored
 
-    AutoMutex lock(mLock);
     mReleased += stepCount;
     mInUnderrun = false;
     mProxy->releaseBuffer(&buffer);
@@ -1728,14 +1749,30 @@ ssize_t AudioTrack::write(const void* buffer, size_t userSize, bool blocking)
     }
 
     size_t written = 0;
-    Buffer audioBuffer;
+    Buffer audioBuffers[2];
+
+    // A blocking write larger than the notification period does not need to be woken up
+    // by the server for every period it consumes, but only once there is room for the rest
+    // of the write.  The server caps this minimum at half the buffer.
+    const bool raiseMinimum = blocking && userSize / mFrameSize > mNotificationFramesAct;
+
+    if (raiseMinimum) {
+        AutoMutex lock(mLock);
+        mProxy->setMinimum(userSize / mFrameSize);
+    }
 
     while (userSize >= mFrameSize) {
-        audioBuffer.frameCount = userSize / mFrameSize;
+        audioBuffers[0].frameCount = userSize / mFrameSize;
 
-        status_t err = obtainBuffer(&audioBuffer,
-                blocking ? &ClientProxy::kForever : &ClientProxy::kNonBlocking);
+        // obtain both the contiguous frames and those that wrap around to the start of the buffer
+        status_t err = obtainBuffer(&audioBuffers[0],
+                blocking ? &ClientProxy::kForever : &ClientProxy::kNonBlocking,
+                NULL /*elapsed*/, NULL /*nonContig*/, &audioBuffers[1]);
         if (err < 0) {
+            if (raiseMinimum) {
+                AutoMutex lock(mLock);
+                mProxy->setMinimum(mNotificationFramesAct);
+            }
             if (written > 0) {
                 break;
             }
@@ -1745,13 +1782,21 @@ ssize_t AudioTrack::write(const void* buffer, size_t userSize, bool blocking)
             return ssize_t(err);
         }
 
-        size_t toWrite = audioBuffer.size;
-        memcpy(audioBuffer.i8, buffer, toWrite);
-        buffer = ((const char *) buffer) + toWrite;
+        size_t toWrite = 0;
+        for (size_t i = 0; i < 2 && audioBuffers[i].size > 0; ++i) {
+            memcpy(audioBuffers[i].i8, buffer, audioBuffers[i].size);
+            buffer = ((const char *) buffer) + audioBuffers[i].size;
+            toWrite += audioBuffers[i].size;
+        }
         userSize -= toWrite;
         written += toWrite;
 
-        releaseBuffer(&audioBuffer);
+        AutoMutex lock(mLock);
+        releaseBuffer_l(toWrite / mFrameSize);
+        if (raiseMinimum) {
+            // back to mNotificationFramesAct once the rest is no more than a notification period
+            mProxy->setMinimum(max(userSize / mFrameSize, size_t(mNotificationFramesAct)));
+        }
     }
 
     if (written > 0) {
@@ -2352,8 +2397,20 @@ status_t AudioTrack::getTimestamp(AudioTimestamp& timestamp)
 
     status_t status;
     if (isOffloadedOrDirect_l()) {
-        // use Binder to get timestamp
-        status = mAudioTrack->getTimestamp(timestamp);
+        // The server publishes the HAL position in shared memory after each write,
+        // use Binder only if it is missing or stale, for instance while paused.
+        ExtendedTimestamp ets;
+        const int64_t timeNs = mProxy->getTimestamp(&ets) == OK ?
+                ets.mTimeNs[ExtendedTimestamp::LOCATION_KERNEL] : -1;
+        if (timeNs > 0 && getNowUs() * 1000 - timeNs <= kMaxSharedTimestampAgeNs) {
+            timestamp.mPosition = (uint32_t) ets.mPosition[ExtendedTimestamp::LOCATION_KERNEL];
+            timestamp.mTime.tv_sec = timeNs / 1000000000;
+            timestamp.mTime.tv_nsec = timeNs % 1000000000;
+            status = NO_ERROR;
+        } else {
+            // use Binder to get timestamp
+            status = mAudioTrack->getTimestamp(timestamp);
+        }
     } else {
         // read timestamp from shared memory
         ExtendedTimestamp ets;
@@ -333,6 +333,32 @@ end:
     return status;
 }
 
+status_t ClientProxy::obtainBuffers(Buffer buffers[2], const struct timespec *requested,
+        struct timespec *elapsed)
+{
+    const size_t desired = buffers[0].mFrameCount;
+    buffers[1].mFrameCount = 0;
+    buffers[1].mRaw = NULL;
+    buffers[1].mNonContig = 0;
+    status_t status = obtainBuffer(&buffers[0], requested, elapsed);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    // the non-contiguous frames, if any, start at the beginning of the buffer
+    size_t part2 = desired - buffers[0].mFrameCount;
+    if (part2 > buffers[0].mNonContig) {
+        part2 = buffers[0].mNonContig;
+    }
+    if (part2 > 0) {
+        buffers[1].mFrameCount = part2;
+        buffers[1].mRaw = mBuffers;
+        buffers[1].mNonContig = buffers[0].mNonContig - part2;
+        buffers[0].mNonContig = buffers[1].mNonContig;
+        mUnreleased += part2;
+    }
+    return NO_ERROR;
+}
+
 __attribute__((no_sanitize("integer")))
 void ClientProxy::releaseBuffer(Buffer* buffer)
 {
@@ -20,6 +20,8 @@
 
 #include <binder/Parcel.h>
 #include <binder/IMemory.h>
+#include <binder/MemoryBase.h>
+#include <sys/mman.h>
 #include <media/ICrypto.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -36,6 +38,7 @@ enum {
     DECRYPT,
     NOTIFY_RESOLUTION,
     SET_MEDIADRM_SESSION,
+    SET_HEAP,
 };
 
 struct BpCrypto : public BpInterface<ICrypto> {
@@ -130,7 +133,20 @@ struct BpCrypto : public BpInterface<ICrypto> {
         }
 
         data.writeInt32(totalSize);
-        data.writeStrongBinder(IInterface::asBinder(sharedBuffer));
+
+        // Refer to sharedBuffer by its offset in the heap shared by
+        // setHeap() if it is allocated from it.
+        ssize_t heapOffset = 0;
+        size_t heapSize = 0;
+        sp<IMemoryHeap> heap = sharedBuffer->getMemory(&heapOffset, &heapSize);
+        if (mHeap != NULL && IInterface::asBinder(heap) == IInterface::asBinder(mHeap)) {
+            data.writeInt32(1);
+            data.writeInt32(heapOffset);
+            data.writeInt32(heapSize);
+        } else {
+            data.writeInt32(0);
+            data.writeStrongBinder(IInterface::asBinder(sharedBuffer));
+        }
         data.writeInt32(offset);
 
         data.writeInt32(numSubSamples);
@@ -178,6 +194,14 @@ struct BpCrypto : public BpInterface<ICrypto> {
         return reply.readInt32();
     }
 
+    virtual void setHeap(const sp<IMemoryHeap> &heap) {
+        Parcel data, reply;
+        data.writeInterfaceToken(ICrypto::getInterfaceDescriptor());
+        data.writeStrongBinder(IInterface::asBinder(heap));
+        remote()->transact(SET_HEAP, data, &reply);
+        mHeap = heap;
+    }
+
 private:
     void readVector(Parcel &reply, Vector<uint8_t> &vector) const {
         uint32_t size = reply.readInt32();
@@ -190,6 +214,8 @@ private:
         data.write(vector.array(), vector.size());
     }
 
+    sp<IMemoryHeap> mHeap;
+
     DISALLOW_EVIL_CONSTRUCTORS(BpCrypto);
 };
 
@@ -208,6 +234,11 @@ void BnCrypto::writeVector(Parcel *reply, Vector<uint8_t> const &vector) const {
     reply->write(vector.array(), vector.size());
 }
 
+void BnCrypto::setHeap(const sp<IMemoryHeap> &heap) {
+    Mutex::Autolock autoLock(mHeapLock);
+    mHeap = heap;
+}
+
 status_t BnCrypto::onTransact(
     uint32_t code, const Parcel &data, Parcel *reply, uint32_t flags) {
     switch (code) {
@@ -293,8 +324,21 @@ status_t BnCrypto::onTransact(
             data.read(iv, sizeof(iv));
 
             size_t totalSize = data.readInt32();
-            sp<IMemory> sharedBuffer =
-                interface_cast<IMemory>(data.readStrongBinder());
+            sp<IMemory> sharedBuffer;
+            if (data.readInt32() != 0) {
+                // A buffer in the heap shared by setHeap(), no need to ask
+                // the client for the memory
+                size_t heapOffset = data.readInt32();
+                size_t heapSize = data.readInt32();
+                Mutex::Autolock autoLock(mHeapLock);
+                if (mHeap != NULL && mHeap->getBase() != MAP_FAILED
+                        && heapOffset <= mHeap->getSize()
+                        && heapSize <= mHeap->getSize() - heapOffset) {
+                    sharedBuffer = new MemoryBase(mHeap, heapOffset, heapSize);
+                }
+            } else {
+                sharedBuffer = interface_cast<IMemory>(data.readStrongBinder());
+            }
             if (sharedBuffer == NULL) {
                 reply->writeInt32(BAD_VALUE);
                 return OK;
@@ -413,6 +457,15 @@ status_t BnCrypto::onTransact(
             return OK;
         }
 
+        case SET_HEAP:
+        {
+            CHECK_INTERFACE(ICrypto, data, reply);
+            sp<IMemoryHeap> heap =
+                interface_cast<IMemoryHeap>(data.readStrongBinder());
+            setHeap(heap);
+            return OK;
+        }
+
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -29,6 +29,7 @@ namespace android {
 enum {
     REGISTER_WRITER = IBinder::FIRST_CALL_TRANSACTION,
     UNREGISTER_WRITER,
+    GET_HISTOGRAM_SUMMARY,
 };
 
 class BpMediaLogService : public BpInterface<IMediaLogService>
@@ -57,6 +58,29 @@ public:
         // FIXME ignores status
     }
 
+    virtual status_t getHistogramSummary(const char *writerName, const char *name, bool recent,
+            NBLog::Histogram::Summary *summary) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IMediaLogService::getInterfaceDescriptor());
+        data.writeCString(writerName);
+        data.writeCString(name);
+        data.writeInt32(recent);
+        status_t status = remote()->transact(GET_HISTOGRAM_SUMMARY, data, &reply);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        status = reply.readInt32();
+        if (status == NO_ERROR) {
+            summary->mCount = (uint64_t) reply.readInt64();
+            summary->mMin = reply.readInt32();
+            summary->mP50 = reply.readInt32();
+            summary->mP99 = reply.readInt32();
+            summary->mP999 = reply.readInt32();
+            summary->mMax = reply.readInt32();
+        }
+        return status;
+    }
+
 };
 
 IMPLEMENT_META_INTERFACE(MediaLogService, "android.media.IMediaLogService");
@@ -84,6 +108,28 @@ status_t BnMediaLogService::onTransact(
             return NO_ERROR;
         }
 
+        case GET_HISTOGRAM_SUMMARY: {
+            CHECK_INTERFACE(IMediaLogService, data, reply);
+            const char *writerName = data.readCString();
+            const char *name = data.readCString();
+            bool recent = data.readInt32() != 0;
+            NBLog::Histogram::Summary summary;
+            status_t status = NAME_NOT_FOUND;
+            if (writerName != NULL && name != NULL) {
+                status = getHistogramSummary(writerName, name, recent, &summary);
+            }
+            reply->writeInt32(status);
+            if (status == NO_ERROR) {
+                reply->writeInt64((int64_t) summary.mCount);
+                reply->writeInt32(summary.mMin);
+                reply->writeInt32(summary.mP50);
+                reply->writeInt32(summary.mP99);
+                reply->writeInt32(summary.mP999);
+                reply->writeInt32(summary.mMax);
+            }
+            return NO_ERROR;
+        }
+
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -270,12 +270,59 @@ IMPLEMENT_META_INTERFACE(MediaSource, "android.media.IMediaSource");
 
 BnMediaSource::BnMediaSource()
     : mBuffersSinceStop(0)
-    , mGroup(new MediaBufferGroup(kBinderMediaBuffers /* growthLimit */)) {
+    , mGroup(new MediaBufferGroup(kBinderMediaBuffers /* growthLimit */))
+    , mRingBufferSize(0) {
 }
 
 BnMediaSource::~BnMediaSource() {
 }
 
+status_t BnMediaSource::acquireRingBuffer(MediaBuffer **out, size_t length) {
+    if (mRing == nullptr) {
+        if (mRingBufferSize != 0) {
+            return NO_MEMORY; // failed before
+        }
+
+        // Size the buffers for the largest sample the source announces, with
+        // room to spare for the first sample otherwise.
+        size_t bufferSize = length * 2;
+        sp<MetaData> format = getFormat();
+        int32_t maxInputSize;
+        if (format != nullptr && format->findInt32(kKeyMaxInputSize, &maxInputSize)
+                && maxInputSize > 0 && (size_t)maxInputSize > bufferSize) {
+            bufferSize = maxInputSize;
+        }
+        bufferSize = (bufferSize + 4095) & ~(size_t)4095;
+
+        size_t numBuffers = kBinderRingBytes / bufferSize;
+        if (numBuffers < kBinderMediaBuffers) {
+            numBuffers = kBinderMediaBuffers;
+        } else if (numBuffers > kBinderRingMaxBuffers) {
+            numBuffers = kBinderRingMaxBuffers;
+        }
+        mRingBufferSize = bufferSize;
+        mRing.reset(new MediaBufferGroup(numBuffers, bufferSize, numBuffers /* growthLimit */));
+        if (!mRing->has_buffers()) {
+            ALOGW("cannot allocate %zu transfer buffers of %zu bytes", numBuffers, bufferSize);
+            mRing.reset();
+            return NO_MEMORY;
+        }
+        ALOGV("transfer ring of %zu buffers of %zu bytes", numBuffers, bufferSize);
+    }
+    if (length > mRingBufferSize) {
+        return BAD_VALUE;
+    }
+    // Buffers the client still holds are not free, so a full ring does not
+    // block the read.
+    status_t err = mRing->acquire_buffer(out, true /* nonBlocking */, length);
+    if (err == OK && (*out)->mMemory == nullptr) {
+        (*out)->release();
+        *out = nullptr;
+        err = NO_MEMORY;
+    }
+    return err;
+}
+
 status_t BnMediaSource::onTransact(
     uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags)
 {
@@ -359,7 +406,15 @@ status_t BnMediaSource::onTransact(
                 MediaBuffer *transferBuf = nullptr;
                 const size_t length = buf->range_length();
                 size_t offset = buf->range_offset();
-                if (length >= (supportNonblockingRead() && buf->mMemory != nullptr ?
+                // Copy into the ring what would otherwise go inline, or in
+                // a shared buffer of the source that ends the read.
+                if (length >= kTransferSharedAsSharedThreshold
+                        && (buf->mMemory == nullptr || !supportNonblockingRead())
+                        && acquireRingBuffer(&transferBuf, length) == OK) {
+                    ALOGV("Use transfer ring: %zu", length);
+                    memcpy(transferBuf->data(), (uint8_t*)buf->data() + offset, length);
+                    offset = 0;
+                } else if (length >= (supportNonblockingRead() && buf->mMemory != nullptr ?
                         kTransferSharedAsSharedThreshold : kTransferInlineAsSharedThreshold)) {
                     if (buf->mMemory != nullptr) {
                         ALOGV("Use shared memory: %zu", length);
@@ -62,8 +62,20 @@ enum {
     UPDATE_GRAPHIC_BUFFER_IN_META,
     CONFIGURE_VIDEO_TUNNEL_MODE,
     UPDATE_NATIVE_HANDLE_IN_META,
+    FILL_BUFFERS,
+    EMPTY_BUFFERS,
 };
 
+// Closes the fences of the buffers not passed on by a batch.
+template<class T>
+static void closeFences(const T *buffers, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (buffers[i].mFenceFd >= 0) {
+            ::close(buffers[i].mFenceFd);
+        }
+    }
+}
+
 class BpOMX : public BpInterface<IOMX> {
 public:
     BpOMX(const sp<IBinder> &impl)
@@ -585,6 +597,84 @@ public:
         return reply.readInt32();
     }
 
+    virtual status_t fillBuffers(
+            node_id node, const FillBufferInfo *buffers, size_t count, size_t *numFilled) {
+        *numFilled = 0;
+        while (*numFilled < count) {
+            size_t n = count - *numFilled;
+            if (n > kMaxBatchBuffers) {
+                n = kMaxBatchBuffers;
+            }
+            const FillBufferInfo *batch = buffers + *numFilled;
+
+            Parcel data, reply;
+            data.writeInterfaceToken(IOMX::getInterfaceDescriptor());
+            data.writeInt32((int32_t)node);
+            data.writeInt32((int32_t)n);
+            for (size_t i = 0; i < n; ++i) {
+                data.writeInt32((int32_t)batch[i].mBuffer);
+                data.writeInt32(batch[i].mFenceFd >= 0);
+                if (batch[i].mFenceFd >= 0) {
+                    data.writeFileDescriptor(batch[i].mFenceFd, true /* takeOwnership */);
+                }
+            }
+            status_t err = remote()->transact(FILL_BUFFERS, data, &reply);
+            if (err == OK) {
+                err = reply.readInt32();
+            }
+            size_t filled = reply.readInt32();
+            size_t sent = *numFilled + n;
+            *numFilled += filled < n ? filled : n;
+            if (err != OK) {
+                // the fences sent were passed on with the parcel
+                closeFences(buffers + sent, count - sent);
+                return err;
+            }
+        }
+        return OK;
+    }
+
+    virtual status_t emptyBuffers(
+            node_id node, const EmptyBufferInfo *buffers, size_t count, size_t *numEmptied) {
+        *numEmptied = 0;
+        while (*numEmptied < count) {
+            size_t n = count - *numEmptied;
+            if (n > kMaxBatchBuffers) {
+                n = kMaxBatchBuffers;
+            }
+            const EmptyBufferInfo *batch = buffers + *numEmptied;
+
+            Parcel data, reply;
+            data.writeInterfaceToken(IOMX::getInterfaceDescriptor());
+            data.writeInt32((int32_t)node);
+            data.writeInt32((int32_t)n);
+            for (size_t i = 0; i < n; ++i) {
+                data.writeInt32((int32_t)batch[i].mBuffer);
+                data.writeInt32(batch[i].mRangeOffset);
+                data.writeInt32(batch[i].mRangeLength);
+                data.writeInt32(batch[i].mFlags);
+                data.writeInt64(batch[i].mTimestamp);
+                data.writeInt32(batch[i].mFenceFd >= 0);
+                if (batch[i].mFenceFd >= 0) {
+                    data.writeFileDescriptor(batch[i].mFenceFd, true /* takeOwnership */);
+                }
+            }
+            status_t err = remote()->transact(EMPTY_BUFFERS, data, &reply);
+            if (err == OK) {
+                err = reply.readInt32();
+            }
+            size_t emptied = reply.readInt32();
+            size_t sent = *numEmptied + n;
+            *numEmptied += emptied < n ? emptied : n;
+            if (err != OK) {
+                // the fences sent were passed on with the parcel
+                closeFences(buffers + sent, count - sent);
+                return err;
+            }
+        }
+        return OK;
+    }
+
     virtual status_t getExtensionIndex(
             node_id node,
             const char *parameter_name,
@@ -627,6 +717,38 @@ public:
 
 IMPLEMENT_META_INTERFACE(OMX, "android.hardware.IOMX");
 
+status_t IOMX::fillBuffers(
+        node_id node, const FillBufferInfo *buffers, size_t count, size_t *numFilled) {
+    *numFilled = 0;
+    while (*numFilled < count) {
+        const FillBufferInfo &info = buffers[*numFilled];
+        status_t err = fillBuffer(node, info.mBuffer, info.mFenceFd);
+        if (err != OK) {
+            closeFences(&info + 1, count - *numFilled - 1);
+            return err;
+        }
+        ++*numFilled;
+    }
+    return OK;
+}
+
+status_t IOMX::emptyBuffers(
+        node_id node, const EmptyBufferInfo *buffers, size_t count, size_t *numEmptied) {
+    *numEmptied = 0;
+    while (*numEmptied < count) {
+        const EmptyBufferInfo &info = buffers[*numEmptied];
+        status_t err = emptyBuffer(
+                node, info.mBuffer, info.mRangeOffset, info.mRangeLength,
+                info.mFlags, info.mTimestamp, info.mFenceFd);
+        if (err != OK) {
+            closeFences(&info + 1, count - *numEmptied - 1);
+            return err;
+        }
+        ++*numEmptied;
+    }
+    return OK;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #define CHECK_OMX_INTERFACE(interface, data, reply) \
@@ -1197,6 +1319,66 @@ status_t BnOMX::onTransact(
             return NO_ERROR;
         }
 
+        case FILL_BUFFERS:
+        {
+            CHECK_OMX_INTERFACE(IOMX, data, reply);
+
+            node_id node = (node_id)data.readInt32();
+            size_t count = (size_t)data.readInt32();
+            if (count > kMaxBatchBuffers) {
+                ALOGE("too many buffers in a batch: %zu", count);
+                reply->writeInt32(BAD_VALUE);
+                reply->writeInt32(0);
+                return NO_ERROR;
+            }
+
+            FillBufferInfo buffers[kMaxBatchBuffers];
+            for (size_t i = 0; i < count; ++i) {
+                buffers[i].mBuffer = (buffer_id)data.readInt32();
+                bool haveFence = data.readInt32();
+                buffers[i].mFenceFd = haveFence ? ::dup(data.readFileDescriptor()) : -1;
+            }
+
+            size_t numFilled;
+            status_t err = fillBuffers(node, buffers, count, &numFilled);
+            reply->writeInt32(err);
+            reply->writeInt32((int32_t)numFilled);
+
+            return NO_ERROR;
+        }
+
+        case EMPTY_BUFFERS:
+        {
+            CHECK_OMX_INTERFACE(IOMX, data, reply);
+
+            node_id node = (node_id)data.readInt32();
+            size_t count = (size_t)data.readInt32();
+            if (count > kMaxBatchBuffers) {
+                ALOGE("too many buffers in a batch: %zu", count);
+                reply->writeInt32(BAD_VALUE);
+                reply->writeInt32(0);
+                return NO_ERROR;
+            }
+
+            EmptyBufferInfo buffers[kMaxBatchBuffers];
+            for (size_t i = 0; i < count; ++i) {
+                buffers[i].mBuffer = (buffer_id)data.readInt32();
+                buffers[i].mRangeOffset = data.readInt32();
+                buffers[i].mRangeLength = data.readInt32();
+                buffers[i].mFlags = data.readInt32();
+                buffers[i].mTimestamp = data.readInt64();
+                bool haveFence = data.readInt32();
+                buffers[i].mFenceFd = haveFence ? ::dup(data.readFileDescriptor()) : -1;
+            }
+
+            size_t numEmptied;
+            status_t err = emptyBuffers(node, buffers, count, &numEmptied);
+            reply->writeInt32(err);
+            reply->writeInt32((int32_t)numEmptied);
+
+            return NO_ERROR;
+        }
+
         case GET_EXTENSION_INDEX:
         {
             CHECK_OMX_INTERFACE(IOMX, data, reply);
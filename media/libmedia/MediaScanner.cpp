@@ -106,6 +106,23 @@ MediaScanResult MediaScanner::processDirectory(
     return result;
 }
 
+MediaScanResult MediaScanner::processFiles(
+        const Vector<String8> &paths, MediaScannerClient &client,
+        Vector<MediaScanResult> *results) {
+    results->clear();
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+        MediaScanResult result = processFile(paths[i].string(), NULL, client);
+        results->push(result);
+
+        if (result == MEDIA_SCAN_RESULT_ERROR) {
+            return result;
+        }
+    }
+
+    return MEDIA_SCAN_RESULT_OK;
+}
+
 bool MediaScanner::shouldSkipDirectory(char *path) {
     if (path && mSkipList && mSkipIndex) {
         int len = strlen(path);
@@ -20,11 +20,15 @@
 #include <math.h>
 #include <utils/Log.h>
 #include <cutils/properties.h>
+#include <binder/MemoryBase.h>
+#include <binder/MemoryHeapBase.h>
 #include "media/ToneGenerator.h"
 
 
 namespace android {
 
+// Longest tone played from a static buffer instead of the callback
+static const int32_t kDefaultStaticToneMaxMs = 500;
 
 // Descriptors for all available tones (See ToneGenerator::ToneDescriptor class declaration for details)
 const ToneGenerator::ToneDescriptor ToneGenerator::sToneDescriptors[] = {
@@ -859,6 +863,7 @@ ToneGenerator::ToneGenerator(audio_stream_type_t streamType, float volume, bool
     mpNewToneDesc = NULL;
     // Generate tone by chunks of 20 ms to keep cadencing precision
     mProcessSize = (mSamplingRate * 20) / 1000;
+    mStaticToneMaxMs = property_get_int32("media.tonegen.static-max-ms", kDefaultStaticToneMaxMs);
 
     char value[PROPERTY_VALUE_MAX];
     if (property_get("gsm.operator.iso-country", value, "") == 0) {
@@ -904,6 +909,7 @@ ToneGenerator::ToneGenerator(audio_stream_type_t streamType, float volume, bool
 ToneGenerator::~ToneGenerator() {
     ALOGV("ToneGenerator destructor");
 
+    stopStaticTone_l();
     if (mpAudioTrack != 0) {
         stopTone();
         ALOGV("Delete Track: %p", mpAudioTrack.get());
@@ -956,6 +962,13 @@ bool ToneGenerator::startTone(tone_type toneType, int durationMs) {
 
     mDurationMs = durationMs;
 
+    if (mState == TONE_INIT && startStaticTone_l()) {
+        mLock.unlock();
+        ALOGV("Static tone started, time %d", (unsigned int)(systemTime()/1000000));
+        return true;
+    }
+    stopStaticTone_l();
+
     if (mState == TONE_STOPPED) {
         ALOGV("Start waiting for previous tone to stop");
         lStatus = mWaitCbkCond.waitRelative(mLock, seconds(3));
@@ -1029,6 +1042,8 @@ bool ToneGenerator::startTone(tone_type toneType, int durationMs) {
 void ToneGenerator::stopTone() {
     ALOGV("stopTone");
 
+    // A static tone is short and fades out at its end, so it is left to finish
+    // rather than cut off with a click.
     mLock.lock();
     if (mState != TONE_IDLE && mState != TONE_INIT) {
         if (mState == TONE_PLAYING || mState == TONE_STARTING || mState == TONE_RESTARTING) {
@@ -1126,6 +1141,103 @@ bool ToneGenerator::initAudioTrack() {
     return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+//    Method:        ToneGenerator::startStaticTone_l()
+//
+//    Description:    Renders a short tone made of a single ON segment, such as a
+//      DTMF key press, into a shared buffer and plays it with a static AudioTrack,
+//      so that no callback thread has to run for its duration. The samples are
+//      generated as in audioCallback(), including the fade out.
+//      mpNewToneDesc and mDurationMs must have been initialized and mLock held.
+//
+//    Input:
+//        none
+//
+//    Output:
+//        returned value:   true if the static tone was started, false if the tone
+//              must be played by audioCallback()
+//
+////////////////////////////////////////////////////////////////////////////////
+bool ToneGenerator::startStaticTone_l() {
+    const ToneSegment &segment = mpNewToneDesc->segments[0];
+    if (mDurationMs <= 0 || mDurationMs > mStaticToneMaxMs
+            || segment.waveFreq[0] == 0 || segment.duration <= (unsigned int)mDurationMs) {
+        return false;
+    }
+
+    size_t toneFrames = ((size_t)mDurationMs * mSamplingRate) / 1000;
+    size_t frameCount = toneFrames + mProcessSize;  // one more block to fade out
+    size_t size = frameCount * sizeof(short);
+    sp<MemoryHeapBase> heap = new MemoryHeapBase(size, 0, "ToneGenerator");
+    if (heap->getHeapID() < 0) {
+        return false;
+    }
+    sp<MemoryBase> buffer = new MemoryBase(heap, 0, size);
+    short *samples = static_cast<short *>(buffer->pointer());
+    memset(samples, 0, size);
+
+    // same gain as the wave generators created by prepareWave()
+    unsigned int lNumWaves = 1;
+    while (segment.waveFreq[lNumWaves - 1]) {
+        lNumWaves++;
+    }
+    for (unsigned int i = 0; segment.waveFreq[i] != 0; i++) {
+        WaveGenerator waveGen((unsigned short)mSamplingRate, segment.waveFreq[i],
+                TONEGEN_GAIN/lNumWaves);
+        waveGen.getSamples(samples, toneFrames, WaveGenerator::WAVEGEN_START);
+        waveGen.getSamples(samples + toneFrames, mProcessSize, WaveGenerator::WAVEGEN_STOP);
+    }
+
+    sp<AudioTrack> track = new AudioTrack();
+    status_t status = track->set(
+            mStreamType,
+            0,    // sampleRate
+            AUDIO_FORMAT_PCM_16_BIT,
+            AUDIO_CHANNEL_OUT_MONO,
+            0,    // frameCount
+            AUDIO_OUTPUT_FLAG_FAST,
+            NULL, // callback
+            NULL, // user
+            0,    // notificationFrames
+            buffer,
+            mThreadCanCallJava,
+            mpAudioTrack->getSessionId(),
+            AudioTrack::TRANSFER_SHARED);
+    if (status != NO_ERROR) {
+        ALOGW("static AudioTrack set failed with error %d", status);
+        return false;
+    }
+
+    stopStaticTone_l();
+    track->setVolume(mVolume);
+    if (track->start() != NO_ERROR) {
+        return false;
+    }
+    mpStaticTrack = track;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//    Method:        ToneGenerator::stopStaticTone_l()
+//
+//    Description:    Stops the static tone, if any.
+//
+//    Input:
+//        none
+//
+//    Output:
+//        none
+//
+////////////////////////////////////////////////////////////////////////////////
+void ToneGenerator::stopStaticTone_l() {
+    if (mpStaticTrack != 0) {
+        mpStaticTrack->stop();
+        mpStaticTrack.clear();
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //    Method:        ToneGenerator::audioCallback()
@@ -45,6 +45,7 @@ Visualizer::Visualizer (const String16& opPackageName,
         mSampleRate(44100000),
         mScalingMode(VISUALIZER_SCALING_MODE_NORMALIZED),
         mMeasurementMode(MEASUREMENT_MODE_NONE),
+        mFftWindow(VISUALIZER_FFT_WINDOW_RECTANGULAR),
         mCaptureCallBack(NULL),
         mCaptureCbkUser(NULL)
 {
@@ -286,20 +287,51 @@ status_t Visualizer::getFft(uint8_t *fft)
     if (mCaptureSize == 0) {
         return NO_INIT;
     }
+    return getFft(fft, mCaptureSize);
+}
+
+status_t Visualizer::getFft(uint8_t *fft, uint32_t size)
+{
+    if (fft == NULL ||
+        size > VISUALIZER_FFT_SIZE_MAX ||
+        size < VISUALIZER_FFT_SIZE_MIN ||
+        popcount(size) != 1) {
+        return BAD_VALUE;
+    }
 
     status_t status = NO_ERROR;
     if (mEnabled) {
-        uint8_t buf[mCaptureSize];
-        status = getWaveForm(buf);
-        if (status == NO_ERROR) {
-            status = doFft(fft, buf);
+        uint32_t cmd[2] = { size, mFftWindow };
+        uint32_t replySize = size;
+        status = command(VISUALIZER_CMD_FFT, sizeof(cmd), cmd, &replySize, fft);
+        ALOGV("getFft() command returned %d", status);
+        if (status == BAD_VALUE && size == mCaptureSize &&
+                mFftWindow == VISUALIZER_FFT_WINDOW_RECTANGULAR) {
+            // the effect engine does not compute FFTs
+            uint8_t buf[mCaptureSize];
+            status = getWaveForm(buf);
+            if (status == NO_ERROR) {
+                status = doFft(fft, buf);
+            }
+        } else if ((status == NO_ERROR) && (replySize == 0)) {
+            status = NOT_ENOUGH_DATA;
         }
     } else {
-        memset(fft, 0, mCaptureSize);
+        memset(fft, 0, size);
     }
     return status;
 }
 
+status_t Visualizer::setFftWindow(uint32_t window)
+{
+    if (window >= VISUALIZER_FFT_WINDOW_CNT) {
+        return BAD_VALUE;
+    }
+    Mutex::Autolock _l(mCaptureLock);
+    mFftWindow = window;
+    return NO_ERROR;
+}
+
 status_t Visualizer::doFft(uint8_t *fft, uint8_t *waveform)
 {
     int32_t workspace[mCaptureSize >> 1];
@@ -337,13 +369,16 @@ void Visualizer::periodicCapture()
         (mCaptureFlags & (CAPTURE_WAVEFORM|CAPTURE_FFT)) &&
         mCaptureSize != 0) {
         uint8_t waveform[mCaptureSize];
-        status_t status = getWaveForm(waveform);
+        status_t status = NO_ERROR;
+        if (mCaptureFlags & CAPTURE_WAVEFORM) {
+            status = getWaveForm(waveform);
+        }
         if (status != NO_ERROR) {
             return;
         }
         uint8_t fft[mCaptureSize];
         if (mCaptureFlags & CAPTURE_FFT) {
-            status = doFft(fft, waveform);
+            status = getFft(fft, mCaptureSize);
         }
         if (status != NO_ERROR) {
             return;
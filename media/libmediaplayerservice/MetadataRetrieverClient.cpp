@@ -43,6 +43,8 @@
 
 namespace android {
 
+static const int32_t kDefaultFrameCacheKb = 8192;
+
 MetadataRetrieverClient::MetadataRetrieverClient(pid_t pid)
 {
     ALOGV("MetadataRetrieverClient constructor pid(%d)", pid);
@@ -66,6 +68,12 @@ status_t MetadataRetrieverClient::dump(int fd, const Vector<String16>& /*args*/)
     result.append(" MetadataRetrieverClient\n");
     snprintf(buffer, 255, "  pid(%d)\n", mPid);
     result.append(buffer);
+    {
+        Mutex::Autolock glock(sLock);
+        snprintf(buffer, 255, "  frame cache: %zu frames, %zu bytes, %zu hits, %zu misses\n",
+                sFrameCache.size(), sFrameCacheBytes, sFrameCacheHits, sFrameCacheMisses);
+    }
+    result.append(buffer);
     write(fd, result.string(), result.size());
     write(fd, "\n", 1);
     return NO_ERROR;
@@ -76,6 +84,7 @@ void MetadataRetrieverClient::disconnect()
     ALOGV("disconnect from pid %d", mPid);
     Mutex::Autolock lock(mLock);
     mRetriever.clear();
+    mCacheKey.clear();
     mThumbnail.clear();
     mAlbumArt.clear();
     IPCThreadState::self()->flushCommands();
@@ -128,7 +137,10 @@ status_t MetadataRetrieverClient::setDataSource(
     sp<MediaMetadataRetrieverBase> p = createRetriever(playerType);
     if (p == NULL) return NO_INIT;
     status_t ret = p->setDataSource(httpService, url, headers);
-    if (ret == NO_ERROR) mRetriever = p;
+    if (ret == NO_ERROR) {
+        mRetriever = p;
+        mCacheKey.clear();
+    }
     return ret;
 }
 
@@ -170,7 +182,17 @@ status_t MetadataRetrieverClient::setDataSource(int fd, int64_t offset, int64_t
         return NO_INIT;
     }
     status_t status = p->setDataSource(fd, offset, length);
-    if (status == NO_ERROR) mRetriever = p;
+    if (status == NO_ERROR) {
+        mRetriever = p;
+        // a rewritten file gets a new modification or change time
+        mCacheKey = String8::format("%llu:%llu:%lld:%lld:%lld:%lld:%lld",
+                static_cast<unsigned long long>(sb.st_dev),
+                static_cast<unsigned long long>(sb.st_ino),
+                static_cast<long long>(sb.st_size),
+                static_cast<long long>(sb.st_mtime),
+                static_cast<long long>(sb.st_ctime),
+                (long long)offset, (long long)length);
+    }
     return status;
 }
 
@@ -187,11 +209,69 @@ status_t MetadataRetrieverClient::setDataSource(
     sp<MediaMetadataRetrieverBase> p = createRetriever(playerType);
     if (p == NULL) return NO_INIT;
     status_t ret = p->setDataSource(dataSource);
-    if (ret == NO_ERROR) mRetriever = p;
+    if (ret == NO_ERROR) {
+        mRetriever = p;
+        mCacheKey.clear();
+    }
     return ret;
 }
 
 Mutex MetadataRetrieverClient::sLock;
+List<MetadataRetrieverClient::CachedFrame> MetadataRetrieverClient::sFrameCache;
+size_t MetadataRetrieverClient::sFrameCacheBytes = 0;
+size_t MetadataRetrieverClient::sFrameCacheHits = 0;
+size_t MetadataRetrieverClient::sFrameCacheMisses = 0;
+
+static size_t getFrameCacheLimit() {
+    static int32_t limitKb = -1;
+    if (limitKb < 0) {
+        limitKb = property_get_int32("media.metadata.frame-cache-kb", kDefaultFrameCacheKb);
+        if (limitKb < 0) {
+            limitKb = 0;
+        }
+    }
+    return (size_t)limitKb * 1024;
+}
+
+// static
+sp<IMemory> MetadataRetrieverClient::findCachedFrame_l(
+        const String8 &key, int64_t timeUs, int option)
+{
+    for (List<CachedFrame>::iterator it = sFrameCache.begin(); it != sFrameCache.end(); ++it) {
+        if (it->mTimeUs == timeUs && it->mOption == option && it->mKey == key) {
+            // most recently used frames are at the back
+            CachedFrame entry = *it;
+            sFrameCache.erase(it);
+            sFrameCache.push_back(entry);
+            ++sFrameCacheHits;
+            return entry.mFrame;
+        }
+    }
+    ++sFrameCacheMisses;
+    return NULL;
+}
+
+// static
+void MetadataRetrieverClient::addCachedFrame_l(
+        const String8 &key, int64_t timeUs, int option, const sp<IMemory> &frame)
+{
+    size_t limit = getFrameCacheLimit();
+    if (frame->size() > limit) {
+        return;
+    }
+    while (!sFrameCache.empty() && sFrameCacheBytes + frame->size() > limit) {
+        sFrameCacheBytes -= sFrameCache.begin()->mFrame->size();
+        sFrameCache.erase(sFrameCache.begin());
+    }
+
+    CachedFrame entry;
+    entry.mKey = key;
+    entry.mTimeUs = timeUs;
+    entry.mOption = option;
+    entry.mFrame = frame;
+    sFrameCache.push_back(entry);
+    sFrameCacheBytes += frame->size();
+}
 
 sp<IMemory> MetadataRetrieverClient::getFrameAtTime(int64_t timeUs, int option)
 {
@@ -203,13 +283,22 @@ sp<IMemory> MetadataRetrieverClient::getFrameAtTime(int64_t timeUs, int option)
         ALOGE("retriever is not initialized");
         return NULL;
     }
+    if (!mCacheKey.isEmpty()) {
+        mThumbnail = findCachedFrame_l(mCacheKey, timeUs, option);
+        if (mThumbnail != NULL) {
+            ALOGV("using cached frame");
+            return mThumbnail;
+        }
+    }
     VideoFrame *frame = mRetriever->getFrameAtTime(timeUs, option);
     if (frame == NULL) {
         ALOGE("failed to capture a video frame");
         return NULL;
     }
     size_t size = sizeof(VideoFrame) + frame->mSize;
-    sp<MemoryHeapBase> heap = new MemoryHeapBase(size, 0, "MetadataRetrieverClient");
+    // read-only for the clients, since a cached copy is shared between them
+    sp<MemoryHeapBase> heap = new MemoryHeapBase(
+            size, MemoryHeapBase::READ_ONLY, "MetadataRetrieverClient");
     if (heap == NULL) {
         ALOGE("failed to create MemoryDealer");
         delete frame;
@@ -233,6 +322,9 @@ sp<IMemory> MetadataRetrieverClient::getFrameAtTime(int64_t timeUs, int option)
     memcpy(frameCopy->mData, frame->mData, frame->mSize);
     frameCopy->mData = 0;
     delete frame;  // Fix memory leakage
+    if (!mCacheKey.isEmpty()) {
+        addCachedFrame_l(mCacheKey, timeUs, option, mThumbnail);
+    }
     return mThumbnail;
 }
 
@@ -23,6 +23,7 @@
 #include <utils/List.h>
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
+#include <utils/String8.h>
 #include <binder/IMemory.h>
 
 #include <media/MediaMetadataRetrieverInterface.h>
@@ -62,10 +63,32 @@ private:
     explicit MetadataRetrieverClient(pid_t pid);
     virtual ~MetadataRetrieverClient();
 
+    // Recently captured frames, shared by all clients and bounded by
+    // media.metadata.frame-cache-kb (0 disables it).  Only file descriptor
+    // sources get a key, since only their identity and contents can be
+    // checked with fstat().  Must be called with sLock held.
+    struct CachedFrame {
+        String8 mKey;
+        int64_t mTimeUs;
+        int mOption;
+        sp<IMemory> mFrame;
+    };
+    static sp<IMemory> findCachedFrame_l(const String8 &key, int64_t timeUs, int option);
+    static void addCachedFrame_l(
+            const String8 &key, int64_t timeUs, int option, const sp<IMemory> &frame);
+
     mutable Mutex                          mLock;
     static  Mutex                          sLock;
     sp<MediaMetadataRetrieverBase>         mRetriever;
     pid_t                                  mPid;
+    // identifies the current data source in the frame cache, empty if the
+    // frames of this source are not cached
+    String8                                mCacheKey;
+
+    static  List<CachedFrame>              sFrameCache;
+    static  size_t                         sFrameCacheBytes;
+    static  size_t                         sFrameCacheHits;
+    static  size_t                         sFrameCacheMisses;
 
     // Keep the shared memory copy of album art and capture frame (for thumbnail)
     sp<IMemory>                            mAlbumArt;
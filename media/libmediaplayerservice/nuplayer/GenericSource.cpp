@@ -21,6 +21,7 @@
 
 #include "AnotherPacketSource.h"
 
+#include <cutils/properties.h>
 #include <media/IMediaHTTPService.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -45,6 +46,13 @@ static int64_t kHighWaterMarkUs = 5000000ll;  // 5secs
 static int64_t kHighWaterMarkRebufferUs = 15000000ll;  // 15secs
 static const ssize_t kLowWaterMarkBytes = 40000;
 static const ssize_t kHighWaterMarkBytes = 200000;
+static const int32_t kDefaultReadAheadLowMs = 500;
+static const int32_t kDefaultReadAheadHighMs = 2000;
+static const int32_t kDefaultTrickPlayMinSpeed = 4;
+// real time each video frame is shown for in trick play
+static const int64_t kTrickPlayFrameIntervalUs = 100000ll;
+// before retrying a read-ahead that got no data
+static const int64_t kReadAheadRetryDelayUs = 10000ll;
 
 NuPlayer::GenericSource::GenericSource(
         const sp<AMessage> &notify,
@@ -67,7 +75,17 @@ NuPlayer::GenericSource::GenericSource(
       mFd(-1),
       mDrmManagerClient(NULL),
       mBitrate(-1ll),
-      mPendingReadBufferTypes(0) {
+      mPendingReadBufferTypes(0),
+      mAudioUnderruns(0),
+      mVideoUnderruns(0),
+      mTrickPlayStepUs(0) {
+    mReadAheadLowUs = property_get_int32(
+            "media.generic.readahead-low-ms", kDefaultReadAheadLowMs) * 1000ll;
+    mReadAheadHighUs = property_get_int32(
+            "media.generic.readahead-high-ms", kDefaultReadAheadHighMs) * 1000ll;
+    mSeekClosest = property_get_bool("media.generic.seek-closest", false);
+    mTrickPlayMinSpeed = property_get_int32(
+            "media.generic.trickplay-min-speed", kDefaultTrickPlayMinSpeed);
     mBufferingMonitor = new BufferingMonitor(notify);
     resetDataSource();
     DataSource::RegisterDefaultSniffers();
@@ -347,7 +365,24 @@ void NuPlayer::GenericSource::setOffloadAudio(bool offload) {
     mBufferingMonitor->setOffloadAudio(offload);
 }
 
+void NuPlayer::GenericSource::setPlaybackSpeed(float speed) {
+    int64_t stepUs = 0;
+    if (mTrickPlayMinSpeed > 0 && speed >= mTrickPlayMinSpeed) {
+        stepUs = (int64_t)(speed * kTrickPlayFrameIntervalUs);
+    }
+
+    Mutex::Autolock _l(mReadLock);
+    if (stepUs != mTrickPlayStepUs) {
+        ALOGI("%s trick play at speed %.2f", stepUs > 0 ? "starting" : "stopping", speed);
+        mTrickPlayStepUs = stepUs;
+    }
+}
+
 NuPlayer::GenericSource::~GenericSource() {
+    if (mReadAheadLooper != NULL) {
+        mReadAheadLooper->unregisterHandler(mReadAheadHandler->id());
+        mReadAheadLooper->stop();
+    }
     if (mLooper != NULL) {
         mLooper->unregisterHandler(id());
         mLooper->stop();
@@ -364,6 +399,15 @@ void NuPlayer::GenericSource::prepareAsync() {
         mLooper->registerHandler(this);
     }
 
+    if (mReadAheadLooper == NULL) {
+        mReadAheadHandler = new ReadAheadHandler(this);
+        mReadAheadLooper = new ALooper;
+        mReadAheadLooper->setName("GSReadAhead");
+        mReadAheadLooper->start();
+
+        mReadAheadLooper->registerHandler(mReadAheadHandler);
+    }
+
     sp<AMessage> msg = new AMessage(kWhatPrepareAsync, this);
     msg->post();
 }
@@ -429,6 +473,22 @@ void NuPlayer::GenericSource::onPrepareAsync() {
         return;
     }
 
+    if (!mIsSecure) {
+        // secure decoders are instantiated by the player below
+        sp<MetaData> audioMeta, videoMeta;
+        const char *audioMime = NULL;
+        const char *videoMime = NULL;
+        if (mAudioTrack.mSource != NULL) {
+            audioMeta = mAudioTrack.mSource->getFormat();
+            audioMeta->findCString(kKeyMIMEType, &audioMime);
+        }
+        if (mVideoTrack.mSource != NULL) {
+            videoMeta = mVideoTrack.mSource->getFormat();
+            videoMeta->findCString(kKeyMIMEType, &videoMime);
+        }
+        notifyFormatsKnown(audioMime, videoMime);
+    }
+
     if (mVideoTrack.mSource != NULL) {
         sp<MetaData> meta = doGetFormatMeta(false /* audio */);
         sp<AMessage> msg = new AMessage;
@@ -533,6 +593,8 @@ void NuPlayer::GenericSource::start() {
 }
 
 void NuPlayer::GenericSource::stop() {
+    ALOGI("stop, underruns: audio %d video %d", mAudioUnderruns, mVideoUnderruns);
+
     // nothing to do, just account for DRM playback status
     setDrmPlaybackStatusIfNeeded(Playback::STOP, 0);
     mStarted = false;
@@ -633,6 +695,7 @@ void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
           int32_t trackIndex;
           CHECK(msg->findInt32("trackIndex", &trackIndex));
           const sp<IMediaSource> source = mSources.itemAt(trackIndex);
+          Mutex::Autolock _l(mReadLock);
 
           Track* track;
           const char *mime;
@@ -665,8 +728,8 @@ void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
           } else {
               timeUs = mVideoLastDequeueTimeUs;
           }
-          readBuffer(trackType, timeUs, &actualTimeUs, formatChange);
-          readBuffer(counterpartType, -1, NULL, formatChange);
+          readBuffer_l(trackType, timeUs, &actualTimeUs, formatChange);
+          readBuffer_l(counterpartType, -1, NULL, formatChange);
           ALOGV("timeUs %lld actualTimeUs %lld", (long long)timeUs, (long long)actualTimeUs);
 
           break;
@@ -721,6 +784,7 @@ void NuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
       {
           // mStopRead is only used for Widevine to prevent the video source
           // from being read while the associated video decoder is shutting down.
+          Mutex::Autolock _l(mReadLock);
           mStopRead = true;
           if (mVideoTrack.mSource != NULL) {
               mVideoTrack.mPackets->clear();
@@ -894,6 +958,11 @@ status_t NuPlayer::GenericSource::dequeueAccessUnit(
     status_t finalResult;
     if (!track->mPackets->hasBufferAvailable(&finalResult)) {
         if (finalResult == OK) {
+            if (mStarted && audio) {
+                ++mAudioUnderruns;
+            } else if (mStarted) {
+                ++mVideoUnderruns;
+            }
             postReadBuffer(
                     audio ? MEDIA_TRACK_TYPE_AUDIO : MEDIA_TRACK_TYPE_VIDEO);
             return -EWOULDBLOCK;
@@ -903,9 +972,12 @@ status_t NuPlayer::GenericSource::dequeueAccessUnit(
 
     status_t result = track->mPackets->dequeueAccessUnit(accessUnit);
 
-    // start pulling in more buffers if we only have one (or no) buffer left
-    // so that decoder has less chance of being starved
-    if (track->mPackets->getAvailableBufferCount(&finalResult) < 2) {
+    // start pulling in more buffers if we only have one (or no) buffer left,
+    // or are below the read-ahead low watermark, so that decoder has less
+    // chance of being starved
+    if (track->mPackets->getAvailableBufferCount(&finalResult) < 2
+            || (mReadAheadHighUs > 0
+                    && track->mPackets->getBufferedDurationUs(&finalResult) < mReadAheadLowUs)) {
         postReadBuffer(audio? MEDIA_TRACK_TYPE_AUDIO : MEDIA_TRACK_TYPE_VIDEO);
     }
 
@@ -1217,20 +1289,27 @@ status_t NuPlayer::GenericSource::doSeek(int64_t seekTimeUs) {
 
     // If the Widevine source is stopped, do not attempt to read any
     // more buffers.
-    if (mStopRead) {
-        return INVALID_OPERATION;
-    }
-    if (mVideoTrack.mSource != NULL) {
-        int64_t actualTimeUs;
-        readBuffer(MEDIA_TRACK_TYPE_VIDEO, seekTimeUs, &actualTimeUs);
-
-        seekTimeUs = actualTimeUs;
-        mVideoLastDequeueTimeUs = seekTimeUs;
-    }
+    {
+        Mutex::Autolock _l(mReadLock);
+        if (mStopRead) {
+            return INVALID_OPERATION;
+        }
+        if (mVideoTrack.mSource != NULL) {
+            int64_t actualTimeUs;
+            readBuffer_l(MEDIA_TRACK_TYPE_VIDEO, seekTimeUs, &actualTimeUs);
+
+            // With seek-closest, the decoders drop what comes before the
+            // requested time, so audio seeks to that time too.
+            if (!mSeekClosest) {
+                seekTimeUs = actualTimeUs;
+            }
+            mVideoLastDequeueTimeUs = seekTimeUs;
+        }
 
-    if (mAudioTrack.mSource != NULL) {
-        readBuffer(MEDIA_TRACK_TYPE_AUDIO, seekTimeUs);
-        mAudioLastDequeueTimeUs = seekTimeUs;
+        if (mAudioTrack.mSource != NULL) {
+            readBuffer_l(MEDIA_TRACK_TYPE_AUDIO, seekTimeUs);
+            mAudioLastDequeueTimeUs = seekTimeUs;
+        }
     }
 
     setDrmPlaybackStatusIfNeeded(Playback::START, seekTimeUs / 1000);
@@ -1250,7 +1329,7 @@ status_t NuPlayer::GenericSource::doSeek(int64_t seekTimeUs) {
 sp<ABuffer> NuPlayer::GenericSource::mediaBufferToABuffer(
         MediaBuffer* mb,
         media_track_type trackType,
-        int64_t /* seekTimeUs */,
+        int64_t seekTimeUs,
         int64_t *actualTimeUs) {
     bool audio = trackType == MEDIA_TRACK_TYPE_AUDIO;
     size_t outLength = mb->range_length();
@@ -1288,15 +1367,14 @@ sp<ABuffer> NuPlayer::GenericSource::mediaBufferToABuffer(
     CHECK(mb->meta_data()->findInt64(kKeyTime, &timeUs));
     meta->setInt64("timeUs", timeUs);
 
-#if 0
-    // Temporarily disable pre-roll till we have a full solution to handle
-    // both single seek and continous seek gracefully.
-    if (seekTimeUs > timeUs) {
+    // Pre-roll is only done for seek-closest, as continuous seeks would
+    // otherwise show nothing until the last one is reached.
+    if (mSeekClosest && seekTimeUs > timeUs
+            && (trackType == MEDIA_TRACK_TYPE_AUDIO || trackType == MEDIA_TRACK_TYPE_VIDEO)) {
         sp<AMessage> extra = new AMessage;
         extra->setInt64("resume-at-mediaTimeUs", seekTimeUs);
         meta->setMessage("extra", extra);
     }
-#endif
 
     if (trackType == MEDIA_TRACK_TYPE_VIDEO) {
         int32_t layerId;
@@ -1352,7 +1430,9 @@ void NuPlayer::GenericSource::postReadBuffer(media_track_type trackType) {
 
     if ((mPendingReadBufferTypes & (1 << trackType)) == 0) {
         mPendingReadBufferTypes |= (1 << trackType);
-        sp<AMessage> msg = new AMessage(kWhatReadBuffer, this);
+        sp<AMessage> msg = mReadAheadHandler != NULL
+                ? new AMessage(kWhatReadBuffer, mReadAheadHandler)
+                : new AMessage(kWhatReadBuffer, this);
         msg->setInt32("trackType", trackType);
         msg->post();
     }
@@ -1362,7 +1442,26 @@ void NuPlayer::GenericSource::onReadBuffer(sp<AMessage> msg) {
     int32_t tmpType;
     CHECK(msg->findInt32("trackType", &tmpType));
     media_track_type trackType = (media_track_type)tmpType;
+    Track *track = trackType == MEDIA_TRACK_TYPE_AUDIO ? &mAudioTrack : &mVideoTrack;
+    status_t finalResult;
+    size_t numBuffers = track->mPackets != NULL
+            ? track->mPackets->getAvailableBufferCount(&finalResult) : 0;
+
     readBuffer(trackType);
+
+    bool readAhead;
+    {
+        Mutex::Autolock _l(mReadLock);
+        readAhead = needsReadAhead_l(trackType);
+    }
+    if (readAhead) {
+        // keep the read pending and go on up to the high watermark, one
+        // batch at a time so that seeks get in between
+        bool gotData = track->mPackets->getAvailableBufferCount(&finalResult) > numBuffers;
+        msg->post(gotData ? 0 : kReadAheadRetryDelayUs);
+        return;
+    }
+
     {
         // only protect the variable change, as readBuffer may
         // take considerable time.
@@ -1371,8 +1470,28 @@ void NuPlayer::GenericSource::onReadBuffer(sp<AMessage> msg) {
     }
 }
 
+bool NuPlayer::GenericSource::needsReadAhead_l(media_track_type trackType) {
+    Track *track = trackType == MEDIA_TRACK_TYPE_AUDIO ? &mAudioTrack : &mVideoTrack;
+    if (mReadAheadHighUs <= 0 || mStopRead || mIsWidevine
+            || track->mSource == NULL || track->mPackets == NULL) {
+        return false;
+    }
+
+    status_t finalResult;
+    int64_t bufferedUs = track->mPackets->getBufferedDurationUs(&finalResult);
+    ALOGV("%s buffered %lld us", trackType == MEDIA_TRACK_TYPE_AUDIO ? "audio" : "video",
+            (long long)bufferedUs);
+    return finalResult == OK && bufferedUs < mReadAheadHighUs;
+}
+
 void NuPlayer::GenericSource::readBuffer(
         media_track_type trackType, int64_t seekTimeUs, int64_t *actualTimeUs, bool formatChange) {
+    Mutex::Autolock _l(mReadLock);
+    readBuffer_l(trackType, seekTimeUs, actualTimeUs, formatChange);
+}
+
+void NuPlayer::GenericSource::readBuffer_l(
+        media_track_type trackType, int64_t seekTimeUs, int64_t *actualTimeUs, bool formatChange) {
     // Do not read data if Widevine source is stopped
     if (mStopRead) {
         return;
@@ -1422,7 +1541,18 @@ void NuPlayer::GenericSource::readBuffer(
         seeking = true;
     }
 
-    const bool couldReadMultiple = (!mIsWidevine && track->mSource->supportReadMultiple());
+    // In trick play every video read jumps to the first sync sample after
+    // the media time covered by one displayed frame at the current speed.
+    const bool trickPlay = trackType == MEDIA_TRACK_TYPE_VIDEO
+            && mTrickPlayStepUs > 0 && !mIsWidevine && !seeking;
+    if (trickPlay) {
+        maxBuffers = 1;
+        options.setSeekTo(
+                mVideoTimeUs + mTrickPlayStepUs, MediaSource::ReadOptions::SEEK_NEXT_SYNC);
+    }
+
+    const bool couldReadMultiple =
+            (!mIsWidevine && !trickPlay && track->mSource->supportReadMultiple());
 
     if (mIsWidevine || couldReadMultiple) {
         options.setNonBlocking();
@@ -1513,6 +1643,30 @@ void NuPlayer::GenericSource::queueDiscontinuityIfNeeded(
     }
 }
 
+NuPlayer::GenericSource::ReadAheadHandler::ReadAheadHandler(
+        const wp<GenericSource> &source)
+    : mSource(source) {
+}
+
+void NuPlayer::GenericSource::ReadAheadHandler::onMessageReceived(const sp<AMessage> &msg) {
+    sp<GenericSource> source = mSource.promote();
+    if (source == NULL) {
+        return;
+    }
+
+    switch (msg->what()) {
+        case kWhatReadBuffer:
+        {
+            source->onReadBuffer(msg);
+            break;
+        }
+
+        default:
+            TRESPASS();
+            break;
+    }
+}
+
 NuPlayer::GenericSource::BufferingMonitor::BufferingMonitor(const sp<AMessage> &notify)
     : mNotify(notify),
       mDurationUs(-1ll),
@@ -79,6 +79,8 @@ struct NuPlayer::GenericSource : public NuPlayer::Source {
 
     virtual void setOffloadAudio(bool offload);
 
+    virtual void setPlaybackSpeed(float speed);
+
 protected:
     virtual ~GenericSource();
 
@@ -190,6 +192,20 @@ private:
         void schedulePollBuffering_l();
     };
 
+    // Reads audio and video ahead on a looper of its own, so that a slow
+    // IMediaSource::read() does not hold up the other messages of the source.
+    struct ReadAheadHandler : public AHandler {
+        ReadAheadHandler(const wp<GenericSource> &source);
+
+    protected:
+        virtual void onMessageReceived(const sp<AMessage> &msg);
+
+    private:
+        wp<GenericSource> mSource;
+
+        DISALLOW_EVIL_CONSTRUCTORS(ReadAheadHandler);
+    };
+
     Vector<sp<IMediaSource> > mSources;
     Track mAudioTrack;
     int64_t mAudioTimeUs;
@@ -232,9 +248,27 @@ private:
 
     mutable Mutex mReadBufferLock;
     mutable Mutex mDisconnectLock;
+    // held while reading the tracks, and while changing the audio and video
+    // tracks, as the read-ahead runs on mReadAheadLooper
+    Mutex mReadLock;
 
     sp<ALooper> mLooper;
     sp<ALooper> mBufferingMonitorLooper;
+    sp<ALooper> mReadAheadLooper;
+    sp<ReadAheadHandler> mReadAheadHandler;
+
+    // audio and video are read ahead until they have mReadAheadHighUs
+    // buffered, and again once they are down to mReadAheadLowUs
+    int64_t mReadAheadLowUs;
+    int64_t mReadAheadHighUs;
+    int32_t mAudioUnderruns;
+    int32_t mVideoUnderruns;
+    // seek to the requested time rather than to the preceding sync sample
+    bool mSeekClosest;
+    // at or above this speed only video sync samples are read (0 disables)
+    int32_t mTrickPlayMinSpeed;
+    // media time between the sync samples read in trick play, 0 otherwise
+    int64_t mTrickPlayStepUs;
 
     void resetDataSource();
 
@@ -285,6 +319,10 @@ private:
     void readBuffer(
             media_track_type trackType,
             int64_t seekTimeUs = -1ll, int64_t *actualTimeUs = NULL, bool formatChange = false);
+    void readBuffer_l(
+            media_track_type trackType,
+            int64_t seekTimeUs = -1ll, int64_t *actualTimeUs = NULL, bool formatChange = false);
+    bool needsReadAhead_l(media_track_type trackType);
 
     void queueDiscontinuityIfNeeded(
             bool seeking, bool formatChange, media_track_type trackType, Track *track);
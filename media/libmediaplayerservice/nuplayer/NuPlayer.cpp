@@ -45,6 +45,7 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaCodecPool.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaData.h>
@@ -195,6 +196,7 @@ NuPlayer::NuPlayer(pid_t pid)
       mPausedByClient(true),
       mPausedForBuffering(false) {
     clearFlushComplete();
+    resetMetrics_l();
 }
 
 NuPlayer::~NuPlayer() {
@@ -506,6 +508,11 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
 
         case kWhatPrepare:
         {
+            {
+                Mutex::Autolock autoLock(mMetricsLock);
+                resetMetrics_l();
+                mMetrics.mPrepareStartUs = ALooper::GetNowUs();
+            }
             mSource->prepareAsync();
             break;
         }
@@ -788,6 +795,9 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
                 params->setFloat("playback-speed", mPlaybackSettings.mSpeed);
                 mVideoDecoder->setParameters(params);
             }
+            if (mSource != NULL) {
+                mSource->setPlaybackSpeed(mPlaybackSettings.mSpeed);
+            }
 
             sp<AMessage> response = new AMessage;
             response->setInt32("err", err);
@@ -1148,6 +1158,12 @@ void NuPlayer::onMessageReceived(const sp<AMessage> &msg) {
                 notifyListener(MEDIA_INFO, MEDIA_INFO_RENDERING_START, 0);
             } else if (what == Renderer::kWhatMediaRenderingStart) {
                 ALOGV("media rendering started");
+                {
+                    Mutex::Autolock autoLock(mMetricsLock);
+                    if (mMetrics.mTimeToFirstFrameUs < 0 && mMetrics.mStartUs >= 0) {
+                        mMetrics.mTimeToFirstFrameUs = ALooper::GetNowUs() - mMetrics.mStartUs;
+                    }
+                }
                 notifyListener(MEDIA_STARTED, 0, 0);
             } else if (what == Renderer::kWhatAudioTearDown) {
                 int32_t reason;
@@ -1316,7 +1332,12 @@ status_t NuPlayer::onInstantiateSecureDecoders() {
 
 void NuPlayer::onStart(int64_t startPositionUs) {
     if (!mSourceStarted) {
+        {
+            Mutex::Autolock autoLock(mMetricsLock);
+            mMetrics.mStartUs = ALooper::GetNowUs();
+        }
         mSourceStarted = true;
+        mSource->setPlaybackSpeed(mPlaybackSettings.mSpeed);
         mSource->start();
     }
     if (startPositionUs > 0) {
@@ -1916,6 +1937,49 @@ void NuPlayer::getStats(Vector<sp<AMessage> > *mTrackStats) {
     if (mAudioDecoder != NULL) {
         mTrackStats->push_back(mAudioDecoder->getStats());
     }
+    if (mRenderer != NULL) {
+        mTrackStats->push_back(mRenderer->getStats());
+    }
+    mTrackStats->push_back(getMetrics());
+}
+
+sp<AMessage> NuPlayer::getMetrics() {
+    sp<AMessage> metrics = new AMessage;
+    {
+        Mutex::Autolock autoLock(mMetricsLock);
+        int64_t rebufferDurationUs = mMetrics.mRebufferDurationUs;
+        if (mMetrics.mRebufferStartUs >= 0) {
+            rebufferDurationUs += ALooper::GetNowUs() - mMetrics.mRebufferStartUs;
+        }
+        metrics->setInt64("prepare-duration-us", mMetrics.mPrepareDurationUs);
+        metrics->setInt64("time-to-first-frame-us", mMetrics.mTimeToFirstFrameUs);
+        metrics->setInt32("rebuffer-count", mMetrics.mNumRebuffers);
+        metrics->setInt64("rebuffer-duration-us", rebufferDurationUs);
+        metrics->setInt32("bandwidth-kbps", mMetrics.mBandwidthKbps);
+    }
+
+    int64_t framesTotal = 0, framesDropped = 0, decodeTimeUs = -1;
+    if (mVideoDecoder != NULL) {
+        sp<AMessage> stats = mVideoDecoder->getStats();
+        stats->findInt64("frames-total", &framesTotal);
+        stats->findInt64("frames-dropped-output", &framesDropped);
+        stats->findInt64("decode-time-avg-us", &decodeTimeUs);
+    }
+    metrics->setInt64("video-frames-total", framesTotal);
+    metrics->setInt64("video-frames-dropped", framesDropped);
+    metrics->setInt64("video-decode-time-avg-us", decodeTimeUs);
+    return metrics;
+}
+
+void NuPlayer::resetMetrics_l() {
+    mMetrics.mPrepareStartUs = -1;
+    mMetrics.mPrepareDurationUs = -1;
+    mMetrics.mStartUs = -1;
+    mMetrics.mTimeToFirstFrameUs = -1;
+    mMetrics.mNumRebuffers = 0;
+    mMetrics.mRebufferStartUs = -1;
+    mMetrics.mRebufferDurationUs = 0;
+    mMetrics.mBandwidthKbps = -1;
 }
 
 sp<MetaData> NuPlayer::getFileMeta() {
@@ -2145,6 +2209,27 @@ void NuPlayer::onSourceNotify(const sp<AMessage> &msg) {
             break;
         }
 
+        case Source::kWhatFormatsKnown:
+        {
+            if (mSource == NULL
+                    || !property_get_bool("media.nuplayer.prewarm-decoders", true)) {
+                break;
+            }
+
+            // Have the decoder components allocated while the source is
+            // still preparing; Decoder::onConfigure() picks them up from the
+            // pool, or waits for the ones still being created.  The video
+            // decoder goes first as it usually takes the longest.
+            AString mime;
+            if (mVideoDecoder == NULL && msg->findString("video-mime", &mime)) {
+                MediaCodecPool::Prewarm(mime, false /* encoder */, mPID);
+            }
+            if (mAudioDecoder == NULL && msg->findString("audio-mime", &mime)) {
+                MediaCodecPool::Prewarm(mime, false /* encoder */, mPID);
+            }
+            break;
+        }
+
         case Source::kWhatPrepared:
         {
             if (mSource == NULL) {
@@ -2167,6 +2252,14 @@ void NuPlayer::onSourceNotify(const sp<AMessage> &msg) {
                 mPrepared = true;
             }
 
+            {
+                Mutex::Autolock autoLock(mMetricsLock);
+                if (mMetrics.mPrepareStartUs >= 0) {
+                    mMetrics.mPrepareDurationUs =
+                        ALooper::GetNowUs() - mMetrics.mPrepareStartUs;
+                }
+            }
+
             sp<NuPlayerDriver> driver = mDriver.promote();
             if (driver != NULL) {
                 // notify duration first, so that it's definitely set when
@@ -2232,6 +2325,11 @@ void NuPlayer::onSourceNotify(const sp<AMessage> &msg) {
             if (mStarted) {
                 ALOGI("buffer low, pausing...");
 
+                if (!mPausedForBuffering) {
+                    Mutex::Autolock autoLock(mMetricsLock);
+                    ++mMetrics.mNumRebuffers;
+                    mMetrics.mRebufferStartUs = ALooper::GetNowUs();
+                }
                 mPausedForBuffering = true;
                 onPause();
             }
@@ -2245,6 +2343,14 @@ void NuPlayer::onSourceNotify(const sp<AMessage> &msg) {
             if (mStarted) {
                 ALOGI("buffer ready, resuming...");
 
+                {
+                    Mutex::Autolock autoLock(mMetricsLock);
+                    if (mMetrics.mRebufferStartUs >= 0) {
+                        mMetrics.mRebufferDurationUs +=
+                            ALooper::GetNowUs() - mMetrics.mRebufferStartUs;
+                        mMetrics.mRebufferStartUs = -1;
+                    }
+                }
                 mPausedForBuffering = false;
 
                 // do not resume yet if client didn't unpause
@@ -2261,6 +2367,10 @@ void NuPlayer::onSourceNotify(const sp<AMessage> &msg) {
             int32_t kbps;
             CHECK(msg->findInt32("bandwidth", &kbps));
 
+            {
+                Mutex::Autolock autoLock(mMetricsLock);
+                mMetrics.mBandwidthKbps = kbps;
+            }
             notifyListener(MEDIA_INFO, MEDIA_INFO_NETWORK_BANDWIDTH, kbps);
             break;
         }
@@ -2483,6 +2593,18 @@ void NuPlayer::Source::notifyInstantiateSecureDecoders(const sp<AMessage> &reply
     notify->post();
 }
 
+void NuPlayer::Source::notifyFormatsKnown(const char *audioMime, const char *videoMime) {
+    sp<AMessage> notify = dupNotify();
+    notify->setInt32("what", kWhatFormatsKnown);
+    if (audioMime != NULL) {
+        notify->setString("audio-mime", audioMime);
+    }
+    if (videoMime != NULL) {
+        notify->setString("video-mime", videoMime);
+    }
+    notify->post();
+}
+
 void NuPlayer::Source::onMessageReceived(const sp<AMessage> & /* msg */) {
     TRESPASS();
 }
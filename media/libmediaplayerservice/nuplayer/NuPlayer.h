@@ -78,6 +78,9 @@ struct NuPlayer : public AHandler {
     status_t selectTrack(size_t trackIndex, bool select, int64_t timeUs);
     status_t getCurrentPosition(int64_t *mediaUs);
     void getStats(Vector<sp<AMessage> > *mTrackStats);
+    // Playback metrics of the current session: start-up and rebuffering
+    // times, video frame drops, decode time and source bandwidth.
+    sp<AMessage> getMetrics();
 
     sp<MetaData> getFileMeta();
     float getFrameRate();
@@ -213,6 +216,22 @@ private:
     // Pause state as requested by source (internally) due to buffering
     bool mPausedForBuffering;
 
+    // Session metrics, updated on the looper and read by getMetrics().
+    struct Metrics {
+        int64_t mPrepareStartUs;
+        int64_t mPrepareDurationUs;
+        int64_t mStartUs;
+        int64_t mTimeToFirstFrameUs;
+        int32_t mNumRebuffers;
+        int64_t mRebufferStartUs;
+        int64_t mRebufferDurationUs;
+        int32_t mBandwidthKbps;
+    };
+    Mutex mMetricsLock;
+    Metrics mMetrics;
+
+    void resetMetrics_l();
+
     inline const sp<DecoderBase> &getDecoder(bool audio) {
         return audio ? mAudioDecoder : mVideoDecoder;
     }
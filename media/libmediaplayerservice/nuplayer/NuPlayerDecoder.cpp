@@ -33,6 +33,7 @@
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaCodecPool.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 
@@ -49,6 +50,9 @@ static float kDisplayRefreshingRate = 60.f; // TODO: get this from the display
 // the source.
 static float kDefaultVideoFrameRateTotal = 30.f;
 
+// inputs whose decode time is tracked at a time
+static const size_t kMaxTimedInputs = 64;
+
 static inline bool getAudioDeepBufferSetting() {
     return property_get_bool("media.stagefright.audio.deep", false /* default_value */);
 }
@@ -70,11 +74,15 @@ NuPlayer::Decoder::Decoder(
       mNumFramesTotal(0ll),
       mNumInputFramesDropped(0ll),
       mNumOutputFramesDropped(0ll),
+      mNumFramesTimed(0ll),
+      mDecodeTimeTotalUs(0ll),
+      mDecodeTimeMaxUs(0ll),
       mVideoWidth(0),
       mVideoHeight(0),
       mIsAudio(true),
       mIsVideoAVC(false),
       mIsSecure(false),
+      mLowLatency(false),
       mFormatChangePending(false),
       mTimeChangePending(false),
       mFrameRateTotal(kDefaultVideoFrameRateTotal),
@@ -99,6 +107,10 @@ sp<AMessage> NuPlayer::Decoder::getStats() const {
     mStats->setInt64("frames-total", mNumFramesTotal);
     mStats->setInt64("frames-dropped-input", mNumInputFramesDropped);
     mStats->setInt64("frames-dropped-output", mNumOutputFramesDropped);
+    if (mNumFramesTimed > 0) {
+        mStats->setInt64("decode-time-avg-us", mDecodeTimeTotalUs / mNumFramesTimed);
+        mStats->setInt64("decode-time-max-us", mDecodeTimeMaxUs);
+    }
     return mStats;
 }
 
@@ -260,11 +272,15 @@ void NuPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
     mIsAudio = !strncasecmp("audio/", mime.c_str(), 6);
     mIsVideoAVC = !strcasecmp(MEDIA_MIMETYPE_VIDEO_AVC, mime.c_str());
 
+    // the format is passed on to configure(), so the codec sees the key too
+    int32_t lowLatency;
+    mLowLatency = !mIsAudio && format->findInt32("low-latency", &lowLatency) && lowLatency;
+
     mComponentName = mime;
     mComponentName.append(" decoder");
     ALOGV("[%s] onConfigure (surface=%p)", mComponentName.c_str(), mSurface.get());
 
-    mCodec = MediaCodec::CreateByType(
+    mCodec = MediaCodecPool::CreateByType(
             mCodecLooper, mime.c_str(), false /* encoder */, NULL /* err */, mPid);
     int32_t secure = 0;
     if (format->findInt32("secure", &secure) && secure != 0) {
@@ -454,6 +470,7 @@ void NuPlayer::Decoder::doFlush(bool notifyComplete) {
         // we attempt to release the buffers even if flush fails.
     }
     releaseAndResetMediaBuffers();
+    mInputQueuedTimesUs.clear();
     mPaused = true;
 }
 
@@ -480,7 +497,8 @@ void NuPlayer::Decoder::onShutdown(bool notifyComplete) {
     notifyResumeCompleteIfNecessary();
 
     if (mCodec != NULL) {
-        err = mCodec->release();
+        // keep the component around for the next clip
+        err = mIsSecure ? mCodec->release() : MediaCodecPool::Recycle(mCodec, mPid);
         mCodec = NULL;
         ++mBufferGeneration;
 
@@ -646,6 +664,15 @@ bool NuPlayer::Decoder::handleAnOutputBuffer(
     bool eos = flags & MediaCodec::BUFFER_FLAG_EOS;
     // we do not expect CODECCONFIG or SYNCFRAME for decoder
 
+    ssize_t queuedIx = mInputQueuedTimesUs.indexOfKey(timeUs);
+    if (queuedIx >= 0) {
+        int64_t decodeTimeUs = ALooper::GetNowUs() - mInputQueuedTimesUs.valueAt(queuedIx);
+        mInputQueuedTimesUs.removeItemsAt(queuedIx);
+        mDecodeTimeTotalUs += decodeTimeUs;
+        mDecodeTimeMaxUs = std::max(mDecodeTimeMaxUs, decodeTimeUs);
+        ++mNumFramesTimed;
+    }
+
     sp<AMessage> reply = new AMessage(kWhatRenderBuffer, this);
     reply->setSize("buffer-ix", index);
     reply->setInt32("generation", mBufferGeneration);
@@ -672,7 +699,12 @@ bool NuPlayer::Decoder::handleAnOutputBuffer(
     // wait until 1st frame comes out to signal resume complete
     notifyResumeCompleteIfNecessary();
 
-    if (mRenderer != NULL) {
+    if (mLowLatency && !eos) {
+        // skip the renderer's A/V sync and vsync alignment
+        reply->setInt32("render", true);
+        reply->setInt64("timestampNs", systemTime(SYSTEM_TIME_MONOTONIC));
+        reply->post();
+    } else if (mRenderer != NULL) {
         // send the buffer to renderer.
         mRenderer->queueBuffer(mIsAudio, buffer, reply);
         if (eos && !isDiscontinuityPending()) {
@@ -812,6 +844,19 @@ status_t NuPlayer::Decoder::fetchInputData(sp<AMessage> &reply) {
             return ERROR_END_OF_STREAM;
         }
 
+        if (mSkipRenderingUntilMediaTimeUs >= 0 && mIsVideoAVC && !mIsSecure
+                && !IsAVCReferenceFrame(accessUnit)) {
+            // Pre-roll after a seek: nothing refers to this frame, and it
+            // would be dropped at the output anyway, so don't decode it.
+            int64_t timeUs;
+            CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
+            if (timeUs < mSkipRenderingUntilMediaTimeUs) {
+                ALOGV("[%s] skipping pre-roll frame at %lld us",
+                        mComponentName.c_str(), (long long)timeUs);
+                continue;
+            }
+        }
+
         dropAccessUnit = false;
         if (!mIsAudio && !mIsSecure) {
             int32_t layerId = 0;
@@ -984,6 +1029,13 @@ bool NuPlayer::Decoder::onInputBufferFetched(const sp<AMessage> &msg) {
                 CHECK(mMediaBuffers[bufferIx] == NULL);
                 mMediaBuffers.editItemAt(bufferIx) = mediaBuffer;
             }
+            if (flags == 0) {
+                if (mInputQueuedTimesUs.size() >= kMaxTimedInputs) {
+                    // the codec dropped some, forget the oldest
+                    mInputQueuedTimesUs.removeItemsAt(0);
+                }
+                mInputQueuedTimesUs.add(timeUs, ALooper::GetNowUs());
+            }
         }
     }
     return true;
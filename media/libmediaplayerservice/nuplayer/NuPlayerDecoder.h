@@ -21,6 +21,8 @@
 
 #include "NuPlayerDecoderBase.h"
 
+#include <utils/KeyedVector.h>
+
 namespace android {
 
 struct NuPlayer::Decoder : public DecoderBase {
@@ -87,11 +89,19 @@ private:
     int64_t mNumFramesTotal;
     int64_t mNumInputFramesDropped;
     int64_t mNumOutputFramesDropped;
+    // real time each pending input was queued at, by media time, so that
+    // the time it took to decode can be measured when it comes out
+    KeyedVector<int64_t, int64_t> mInputQueuedTimesUs;
+    int64_t mNumFramesTimed;
+    int64_t mDecodeTimeTotalUs;
+    int64_t mDecodeTimeMaxUs;
     int32_t mVideoWidth;
     int32_t mVideoHeight;
     bool mIsAudio;
     bool mIsVideoAVC;
     bool mIsSecure;
+    // video frames go to the surface as soon as they are decoded
+    bool mLowLatency;
     bool mFormatChangePending;
     bool mTimeChangePending;
     float mFrameRateTotal;
@@ -28,6 +28,7 @@
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/MediaErrors.h>
 
 #include "ATSParser.h"
@@ -49,6 +50,7 @@ NuPlayer::DecoderPassThrough::DecoderPassThrough(
       mSkipRenderingUntilMediaTimeUs(-1ll),
       mReachedEOS(true),
       mPendingAudioErr(OK),
+      mAggregateBytes(0),
       mPendingBuffersToDrain(0),
       mCachedBytes(0),
       mComponentName("pass through decoder") {
@@ -144,7 +146,7 @@ status_t NuPlayer::DecoderPassThrough::dequeueAccessUnit(sp<ABuffer> *accessUnit
     }
 
     if (err == INFO_DISCONTINUITY || err == ERROR_END_OF_STREAM) {
-        if (mAggregateBuffer != NULL) {
+        if (!mAggregateBuffers.isEmpty()) {
             // We already have some data so save this for later.
             mPendingAudioErr = err;
             mPendingAudioAccessUnit = *accessUnit;
@@ -157,75 +159,68 @@ status_t NuPlayer::DecoderPassThrough::dequeueAccessUnit(sp<ABuffer> *accessUnit
     return err;
 }
 
-sp<ABuffer> NuPlayer::DecoderPassThrough::aggregateBuffer(
-        const sp<ABuffer> &accessUnit) {
-    sp<ABuffer> aggregate;
-
+bool NuPlayer::DecoderPassThrough::aggregateBuffer(
+        const sp<ABuffer> &accessUnit, Vector<sp<ABuffer> > *batch) {
     if (accessUnit == NULL) {
         // accessUnit is saved to mPendingAudioAccessUnit
-        // return current mAggregateBuffer
-        aggregate = mAggregateBuffer;
-        mAggregateBuffer.clear();
-        return aggregate;
+        // return current aggregate
+        return takeAggregate(batch);
     }
 
     size_t smallSize = accessUnit->size();
-    if ((mAggregateBuffer == NULL)
+    if (mAggregateBuffers.isEmpty()
             // Don't bother if only room for a few small buffers.
-            && (smallSize < (kAggregateBufferSizeBytes / 3))) {
-        // Create a larger buffer for combining smaller buffers from the extractor.
-        mAggregateBuffer = new ABuffer(kAggregateBufferSizeBytes);
-        mAggregateBuffer->setRange(0, 0); // start empty
+            && (smallSize >= (kAggregateBufferSizeBytes / 3))) {
+        // decided not to aggregate
+        batch->push(accessUnit);
+        return true;
     }
 
-    if (mAggregateBuffer != NULL) {
-        int64_t timeUs;
+    if (!mAggregateBuffers.isEmpty()) {
         int64_t dummy;
-        bool smallTimestampValid = accessUnit->meta()->findInt64("timeUs", &timeUs);
-        bool bigTimestampValid = mAggregateBuffer->meta()->findInt64("timeUs", &dummy);
+        bool smallTimestampValid = accessUnit->meta()->findInt64("timeUs", &dummy);
+        bool bigTimestampValid = mAggregateBuffers[0]->meta()->findInt64("timeUs", &dummy);
         // Will the smaller buffer fit?
-        size_t bigSize = mAggregateBuffer->size();
-        size_t roomLeft = mAggregateBuffer->capacity() - bigSize;
-        // Should we save this small buffer for the next big buffer?
-        // If the first small buffer did not have a timestamp then save
-        // any buffer that does have a timestamp until the next big buffer.
-        if ((smallSize > roomLeft)
-            || (!bigTimestampValid && (bigSize > 0) && smallTimestampValid)) {
+        size_t roomLeft = kAggregateBufferSizeBytes - mAggregateBytes;
+        // Should we save this small buffer for the next batch?  The renderer
+        // looks up the time of every buffer it starts writing, so buffers
+        // with and without a timestamp are never batched together.
+        if ((smallSize > roomLeft) || (bigTimestampValid != smallTimestampValid)) {
             mPendingAudioErr = OK;
             mPendingAudioAccessUnit = accessUnit;
-            aggregate = mAggregateBuffer;
-            mAggregateBuffer.clear();
-        } else {
-            // Grab time from first small buffer if available.
-            if ((bigSize == 0) && smallTimestampValid) {
-                mAggregateBuffer->meta()->setInt64("timeUs", timeUs);
-            }
-            // Append small buffer to the bigger buffer.
-            memcpy(mAggregateBuffer->base() + bigSize, accessUnit->data(), smallSize);
-            bigSize += smallSize;
-            mAggregateBuffer->setRange(0, bigSize);
-
-            ALOGV("feedDecoderInputData() smallSize = %zu, bigSize = %zu, capacity = %zu",
-                    smallSize, bigSize, mAggregateBuffer->capacity());
+            return takeAggregate(batch);
         }
-    } else {
-        // decided not to aggregate
-        aggregate = accessUnit;
     }
 
-    return aggregate;
+    // Reference the small buffer from the batch instead of copying it.
+    mAggregateBuffers.push(accessUnit);
+    mAggregateBytes += smallSize;
+
+    ALOGV("feedDecoderInputData() smallSize = %zu, aggregated = %zu in %zu buffers",
+            smallSize, mAggregateBytes, mAggregateBuffers.size());
+    return false;
+}
+
+bool NuPlayer::DecoderPassThrough::takeAggregate(Vector<sp<ABuffer> > *batch) {
+    if (mAggregateBuffers.isEmpty()) {
+        return false;
+    }
+    *batch = mAggregateBuffers;
+    mAggregateBuffers.clear();
+    mAggregateBytes = 0;
+    return true;
 }
 
 status_t NuPlayer::DecoderPassThrough::fetchInputData(sp<AMessage> &reply) {
     sp<ABuffer> accessUnit;
+    Vector<sp<ABuffer> > batch;
 
     do {
         status_t err = dequeueAccessUnit(&accessUnit);
 
         if (err == -EWOULDBLOCK) {
             // Flush out the aggregate buffer to try to avoid underrun.
-            accessUnit = aggregateBuffer(NULL /* accessUnit */);
-            if (accessUnit != NULL) {
+            if (aggregateBuffer(NULL /* accessUnit */, &batch)) {
                 break;
             }
             return err;
@@ -267,18 +262,20 @@ status_t NuPlayer::DecoderPassThrough::fetchInputData(sp<AMessage> &reply) {
             reply->setInt32("err", err);
             return OK;
         }
-
-        accessUnit = aggregateBuffer(accessUnit);
-    } while (accessUnit == NULL);
+    } while (!aggregateBuffer(accessUnit, &batch));
 
 #if 0
     int64_t mediaTimeUs;
-    CHECK(accessUnit->meta()->findInt64("timeUs", &mediaTimeUs));
+    CHECK(batch[0]->meta()->findInt64("timeUs", &mediaTimeUs));
     ALOGV("feeding audio input buffer at media time %.2f secs",
          mediaTimeUs / 1E6);
 #endif
 
-    reply->setBuffer("buffer", accessUnit);
+    reply->setBuffer("buffer", batch[0]);
+    reply->setSize("count", batch.size());
+    for (size_t i = 1; i < batch.size(); ++i) {
+        reply->setBuffer(AStringPrintf("buffer-%zu", i).c_str(), batch[i]);
+    }
 
     return OK;
 }
@@ -316,12 +313,24 @@ void NuPlayer::DecoderPassThrough::onInputBufferFetched(
         }
     }
 
-    int32_t bufferSize = buffer->size();
+    Vector<sp<ABuffer> > batch;
+    batch.push(buffer);
+    size_t count;
+    CHECK(msg->findSize("count", &count));
+    for (size_t i = 1; i < count; ++i) {
+        CHECK(msg->findBuffer(AStringPrintf("buffer-%zu", i).c_str(), &buffer));
+        batch.push(buffer);
+    }
+
+    int32_t bufferSize = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        bufferSize += batch[i]->size();
+    }
     mCachedBytes += bufferSize;
 
     if (mSkipRenderingUntilMediaTimeUs >= 0) {
         int64_t timeUs = 0;
-        CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
+        CHECK(batch[0]->meta()->findInt64("timeUs", &timeUs));
 
         if (timeUs < mSkipRenderingUntilMediaTimeUs) {
             ALOGV("[%s] dropping buffer at time %lld as requested.",
@@ -343,7 +352,7 @@ void NuPlayer::DecoderPassThrough::onInputBufferFetched(
     reply->setInt32("generation", mBufferGeneration);
     reply->setInt32("size", bufferSize);
 
-    mRenderer->queueBuffer(true /* audio */, buffer, reply);
+    mRenderer->queueBuffers(true /* audio */, batch, reply);
 
     ++mPendingBuffersToDrain;
     ALOGV("onInputBufferFilled: #ToDrain = %zu, cachedBytes = %zu",
@@ -375,7 +384,8 @@ void NuPlayer::DecoderPassThrough::doFlush(bool notifyComplete) {
     mSkipRenderingUntilMediaTimeUs = -1;
     mPendingAudioAccessUnit.clear();
     mPendingAudioErr = OK;
-    mAggregateBuffer.clear();
+    mAggregateBuffers.clear();
+    mAggregateBytes = 0;
 
     if (mRenderer != NULL) {
         mRenderer->flush(true /* audio */, notifyComplete);
@@ -22,6 +22,8 @@
 
 #include "NuPlayerDecoderBase.h"
 
+#include <utils/Vector.h>
+
 namespace android {
 
 struct NuPlayer::DecoderPassThrough : public DecoderBase {
@@ -56,10 +58,12 @@ private:
     bool    mReachedEOS;
 
     // Used by feedDecoderInputData to aggregate small buffers into
-    // one large buffer.
+    // one batch, which the renderer writes to the sink without copying
+    // them into one large buffer first.
     sp<ABuffer> mPendingAudioAccessUnit;
     status_t    mPendingAudioErr;
-    sp<ABuffer> mAggregateBuffer;
+    Vector<sp<ABuffer> > mAggregateBuffers;
+    size_t      mAggregateBytes;
 
     // mPendingBuffersToDrain are only for debugging. It can be removed
     // when the power investigation is done.
@@ -71,7 +75,9 @@ private:
     bool isDoneFetching() const;
 
     status_t dequeueAccessUnit(sp<ABuffer> *accessUnit);
-    sp<ABuffer> aggregateBuffer(const sp<ABuffer> &accessUnit);
+    // returns true once *batch holds buffers ready to be queued
+    bool aggregateBuffer(const sp<ABuffer> &accessUnit, Vector<sp<ABuffer> > *batch);
+    bool takeAggregate(Vector<sp<ABuffer> > *batch);
     status_t fetchInputData(sp<AMessage> &reply);
     void doFlush(bool notifyComplete);
 
@@ -569,8 +569,32 @@ status_t NuPlayerDriver::setParameter(
     return INVALID_OPERATION;
 }
 
-status_t NuPlayerDriver::getParameter(int /* key */, Parcel * /* reply */) {
-    return INVALID_OPERATION;
+status_t NuPlayerDriver::getParameter(int key, Parcel *reply) {
+    if (key != KEY_PARAMETER_PLAYBACK_METRICS) {
+        return INVALID_OPERATION;
+    }
+
+    sp<AMessage> metrics = mPlayer->getMetrics();
+    int64_t prepareUs, firstFrameUs, rebufferUs, framesTotal, framesDropped, decodeUs;
+    int32_t rebuffers, kbps;
+    CHECK(metrics->findInt64("prepare-duration-us", &prepareUs));
+    CHECK(metrics->findInt64("time-to-first-frame-us", &firstFrameUs));
+    CHECK(metrics->findInt32("rebuffer-count", &rebuffers));
+    CHECK(metrics->findInt64("rebuffer-duration-us", &rebufferUs));
+    CHECK(metrics->findInt64("video-frames-total", &framesTotal));
+    CHECK(metrics->findInt64("video-frames-dropped", &framesDropped));
+    CHECK(metrics->findInt64("video-decode-time-avg-us", &decodeUs));
+    CHECK(metrics->findInt32("bandwidth-kbps", &kbps));
+
+    reply->writeInt64(prepareUs);
+    reply->writeInt64(firstFrameUs);
+    reply->writeInt64(rebuffers);
+    reply->writeInt64(rebufferUs);
+    reply->writeInt64(framesTotal);
+    reply->writeInt64(framesDropped);
+    reply->writeInt64(decodeUs);
+    reply->writeInt64(kbps);
+    return OK;
 }
 
 status_t NuPlayerDriver::getMetadata(
@@ -693,6 +717,48 @@ status_t NuPlayerDriver::dump(
                             ? 0.0 : (double)(numFramesDropped * 100) / numFramesTotal);
             logString.append(buf);
         }
+
+        int64_t decodeAvgUs, decodeMaxUs;
+        if (stats->findInt64("decode-time-avg-us", &decodeAvgUs)
+                && stats->findInt64("decode-time-max-us", &decodeMaxUs)) {
+            snprintf(buf, sizeof(buf), "    decodeTimeAvgUs(%lld), decodeTimeMaxUs(%lld)\n",
+                     (long long)decodeAvgUs, (long long)decodeMaxUs);
+            logString.append(buf);
+        }
+
+        int64_t firstFrameUs;
+        if (stats->findInt64("time-to-first-frame-us", &firstFrameUs)) {
+            int64_t prepareUs = -1, rebufferUs = 0;
+            int32_t rebuffers = 0, kbps = -1;
+            stats->findInt64("prepare-duration-us", &prepareUs);
+            stats->findInt32("rebuffer-count", &rebuffers);
+            stats->findInt64("rebuffer-duration-us", &rebufferUs);
+            stats->findInt32("bandwidth-kbps", &kbps);
+            snprintf(buf, sizeof(buf), "  session\n"
+                     "    prepareMs(%lld), timeToFirstFrameMs(%lld), rebuffers(%d), "
+                     "rebufferMs(%lld), bandwidthKbps(%d)\n",
+                     (long long)(prepareUs < 0 ? -1 : prepareUs / 1000),
+                     (long long)(firstFrameUs < 0 ? -1 : firstFrameUs / 1000),
+                     rebuffers, (long long)(rebufferUs / 1000), kbps);
+            logString.append(buf);
+        }
+
+        int64_t wakeups;
+        if (stats->findInt64("audio-drain-wakeups", &wakeups)) {
+            int64_t batches = 0, frames = 0, durationUs = 0, refillUs = 0;
+            stats->findInt64("audio-drain-batches", &batches);
+            stats->findInt64("audio-drain-frames", &frames);
+            stats->findInt64("audio-drain-duration-us", &durationUs);
+            stats->findInt64("audio-refill-us", &refillUs);
+            snprintf(buf, sizeof(buf), "  renderer\n"
+                     "    audioDrainWakeups(%lld), wakeupsPerSec(%.1f), "
+                     "framesPerWrite(%lld), refillMs(%lld)\n",
+                     (long long)wakeups,
+                     durationUs == 0 ? 0.0 : wakeups * 1E6 / durationUs,
+                     batches == 0 ? 0ll : (long long)(frames / batches),
+                     (long long)(refillUs / 1000));
+            logString.append(buf);
+        }
     }
 
     ALOGI("%s", logString.c_str());
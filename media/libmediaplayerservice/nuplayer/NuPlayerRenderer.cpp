@@ -24,6 +24,7 @@
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/AUtils.h>
 #include <media/stagefright/foundation/AWakeLock.h>
 #include <media/stagefright/MediaClock.h>
@@ -54,6 +55,10 @@ namespace android {
    #Set size of buffers for pcm audio sink in msec (example: 1000 msec)
    adb shell setprop media.stagefright.audio.sink 1000
 
+   #Refill the pcm audio sink only when it is down to this many msec of audio, writing what was
+   #queued meanwhile in one batch (example: 100 msec, 0 refills as soon as data is queued)
+   adb shell setprop media.stagefright.audio.refill 100
+
  * These configurations take effect for the next track played (not the current track).
  */
 
@@ -66,6 +71,11 @@ static inline int32_t getAudioSinkPcmMsSetting() {
             "media.stagefright.audio.sink", 500 /* default_value */);
 }
 
+static inline int32_t getAudioSinkRefillMsSetting() {
+    return property_get_int32(
+            "media.stagefright.audio.refill", 0 /* default_value */);
+}
+
 // Maximum time in paused state when offloading audio decompression. When elapsed, the AudioSink
 // is closed to allow the audio DSP to power down.
 static const int64_t kOffloadPauseMaxUs = 10000000ll;
@@ -129,7 +139,13 @@ NuPlayer::Renderer::Renderer(
       mTotalBuffersQueued(0),
       mLastAudioBufferDrained(0),
       mUseAudioCallback(false),
+      mAudioDrainWakeups(0),
+      mAudioDrainBatches(0),
+      mAudioDrainFramesWritten(0),
+      mFirstAudioDrainUs(-1),
+      mLastAudioDrainUs(-1),
       mWakeLock(new AWakeLock()) {
+    mAudioRefillUs = getAudioSinkRefillMsSetting() * 1000ll;
     mMediaClock = new MediaClock;
     mPlaybackRate = mPlaybackSettings.mSpeed;
     mMediaClock->setPlaybackRate(mPlaybackRate);
@@ -166,6 +182,22 @@ void NuPlayer::Renderer::queueBuffer(
     msg->post();
 }
 
+void NuPlayer::Renderer::queueBuffers(
+        bool audio,
+        const Vector<sp<ABuffer> > &buffers,
+        const sp<AMessage> &notifyConsumed) {
+    sp<AMessage> msg = new AMessage(kWhatQueueBuffer, this);
+    msg->setInt32("queueGeneration", getQueueGeneration(audio));
+    msg->setInt32("audio", static_cast<int32_t>(audio));
+    msg->setBuffer("buffer", buffers[0]);
+    msg->setSize("count", buffers.size());
+    for (size_t i = 1; i < buffers.size(); ++i) {
+        msg->setBuffer(AStringPrintf("buffer-%zu", i).c_str(), buffers[i]);
+    }
+    msg->setMessage("notifyConsumed", notifyConsumed);
+    msg->post();
+}
+
 void NuPlayer::Renderer::queueEOS(bool audio, status_t finalResult) {
     CHECK_NE(finalResult, (status_t)OK);
 
@@ -480,7 +512,23 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
                 break;
             }
 
-            if (onDrainAudioQueue()) {
+            uint32_t prevFramesWritten = mNumFramesWritten;
+            bool reschedule = onDrainAudioQueue();
+            {
+                Mutex::Autolock autoLock(mLock);
+                int64_t nowUs = ALooper::GetNowUs();
+                if (mFirstAudioDrainUs < 0) {
+                    mFirstAudioDrainUs = nowUs;
+                }
+                mLastAudioDrainUs = nowUs;
+                ++mAudioDrainWakeups;
+                if (mNumFramesWritten > prevFramesWritten) {
+                    ++mAudioDrainBatches;
+                    mAudioDrainFramesWritten += mNumFramesWritten - prevFramesWritten;
+                }
+            }
+
+            if (reschedule) {
                 uint32_t numFramesPlayed;
                 CHECK_EQ(mAudioSink->getPosition(&numFramesPlayed),
                          (status_t)OK);
@@ -497,9 +545,14 @@ void NuPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
                     delayUs /= mPlaybackRate;
                 }
 
-                // Let's give it more data after about half that time
-                // has elapsed.
-                delayUs /= 2;
+                if (batchingAudio()) {
+                    // Refill once it is down to the refill level.
+                    delayUs = delayUs > mAudioRefillUs ? delayUs - mAudioRefillUs : 0;
+                } else {
+                    // Let's give it more data after about half that time
+                    // has elapsed.
+                    delayUs /= 2;
+                }
                 // check the buffer size to estimate maximum delay permitted.
                 const int64_t maxDrainDelayUs = std::max(
                         mAudioSink->getBufferDurationInUs(), (int64_t)500000 /* half second */);
@@ -821,7 +874,9 @@ size_t NuPlayer::Renderer::fillAudioBuffer(void *buffer, size_t size) {
 
         entry->mOffset += copy;
         if (entry->mOffset == entry->mBuffer->size()) {
-            entry->mNotifyConsumed->post();
+            if (entry->mNotifyConsumed != NULL) {
+                entry->mNotifyConsumed->post();
+            }
             mAudioQueue.erase(mAudioQueue.begin());
             entry = NULL;
         }
@@ -870,7 +925,8 @@ void NuPlayer::Renderer::drainAudioQueueUntilLastEOS() {
         int32_t eos;
         QueueEntry *entry = &*it++;
         if (entry->mBuffer == NULL
-                || (entry->mNotifyConsumed->findInt32("eos", &eos) && eos != 0)) {
+                || (entry->mNotifyConsumed != NULL
+                        && entry->mNotifyConsumed->findInt32("eos", &eos) && eos != 0)) {
             itEOS = it;
             foundEOS = true;
         }
@@ -882,7 +938,7 @@ void NuPlayer::Renderer::drainAudioQueueUntilLastEOS() {
             if (it->mBuffer == NULL) {
                 // delay doesn't matter as we don't even have an AudioTrack
                 notifyEOS(true /* audio */, it->mFinalResult);
-            } else {
+            } else if (it->mNotifyConsumed != NULL) {
                 it->mNotifyConsumed->post();
             }
         }
@@ -992,7 +1048,9 @@ bool NuPlayer::Renderer::onDrainAudioQueue() {
                 copy -= remainder;
             }
 
-            entry->mNotifyConsumed->post();
+            if (entry->mNotifyConsumed != NULL) {
+                entry->mNotifyConsumed->post();
+            }
             mAudioQueue.erase(mAudioQueue.begin());
 
             entry = NULL;
@@ -1047,6 +1105,22 @@ bool NuPlayer::Renderer::onDrainAudioQueue() {
     return reschedule;
 }
 
+bool NuPlayer::Renderer::batchingAudio() const {
+    return mAudioRefillUs > 0 && !offloadingAudio() && !mUseAudioCallback;
+}
+
+sp<AMessage> NuPlayer::Renderer::getStats() {
+    sp<AMessage> stats = new AMessage;
+    Mutex::Autolock autoLock(mLock);
+    stats->setInt64("audio-drain-wakeups", mAudioDrainWakeups);
+    stats->setInt64("audio-drain-batches", mAudioDrainBatches);
+    stats->setInt64("audio-drain-frames", mAudioDrainFramesWritten);
+    stats->setInt64("audio-drain-duration-us",
+            mFirstAudioDrainUs < 0 ? 0 : mLastAudioDrainUs - mFirstAudioDrainUs);
+    stats->setInt64("audio-refill-us", batchingAudio() ? mAudioRefillUs : 0);
+    return stats;
+}
+
 int64_t NuPlayer::Renderer::getDurationUsIfPlayedAtSampleRate(uint32_t numFrames) {
     int32_t sampleRate = offloadingAudio() ?
             mCurrentOffloadInfo.sample_rate : mCurrentPcmInfo.mSampleRate;
@@ -1374,18 +1448,38 @@ void NuPlayer::Renderer::onQueueBuffer(const sp<AMessage> &msg) {
     sp<AMessage> notifyConsumed;
     CHECK(msg->findMessage("notifyConsumed", &notifyConsumed));
 
+    size_t count = 1;
+    msg->findSize("count", &count);
+
     QueueEntry entry;
     entry.mBuffer = buffer;
-    entry.mNotifyConsumed = notifyConsumed;
+    if (count == 1) {
+        entry.mNotifyConsumed = notifyConsumed;
+    }
     entry.mOffset = 0;
     entry.mFinalResult = OK;
     entry.mBufferOrdinal = ++mTotalBuffersQueued;
 
     if (audio) {
+        int64_t delayUs = 0;
+        if (batchingAudio() && mNumFramesWritten > 0 && !mPaused) {
+            // Let more buffers queue up while the sink has enough to play.
+            delayUs = getPendingAudioPlayoutDurationUs(ALooper::GetNowUs()) - mAudioRefillUs;
+        }
+
         Mutex::Autolock autoLock(mLock);
         mAudioQueue.push_back(entry);
-        postDrainAudioQueue_l();
+        for (size_t i = 1; i < count; ++i) {
+            CHECK(msg->findBuffer(AStringPrintf("buffer-%zu", i).c_str(), &entry.mBuffer));
+            if (i + 1 == count) {
+                entry.mNotifyConsumed = notifyConsumed;
+            }
+            entry.mBufferOrdinal = ++mTotalBuffersQueued;
+            mAudioQueue.push_back(entry);
+        }
+        postDrainAudioQueue_l(delayUs > 0 ? delayUs : 0);
     } else {
+        CHECK_EQ(count, (size_t)1);
         mVideoQueue.push_back(entry);
         postDrainVideoQueue();
     }
@@ -1419,7 +1513,9 @@ void NuPlayer::Renderer::onQueueBuffer(const sp<AMessage> &msg) {
         // Audio data starts More than 0.1 secs before video.
         // Drop some audio.
 
-        (*mAudioQueue.begin()).mNotifyConsumed->post();
+        if ((*mAudioQueue.begin()).mNotifyConsumed != NULL) {
+            (*mAudioQueue.begin()).mNotifyConsumed->post();
+        }
         mAudioQueue.erase(mAudioQueue.begin());
         return;
     }
@@ -1571,7 +1667,7 @@ void NuPlayer::Renderer::flushQueue(List<QueueEntry> *queue) {
     while (!queue->empty()) {
         QueueEntry *entry = &*queue->begin();
 
-        if (entry->mBuffer != NULL) {
+        if (entry->mBuffer != NULL && entry->mNotifyConsumed != NULL) {
             entry->mNotifyConsumed->post();
         }
 
@@ -49,6 +49,13 @@ struct NuPlayer::Renderer : public AHandler {
             const sp<ABuffer> &buffer,
             const sp<AMessage> &notifyConsumed);
 
+    // Queues buffers that are written one after the other, posting
+    // notifyConsumed once the last of them is consumed.
+    void queueBuffers(
+            bool audio,
+            const Vector<sp<ABuffer> > &buffers,
+            const sp<AMessage> &notifyConsumed);
+
     void queueEOS(bool audio, status_t finalResult);
 
     status_t setPlaybackSettings(const AudioPlaybackRate &rate /* sanitized */);
@@ -73,6 +80,9 @@ struct NuPlayer::Renderer : public AHandler {
     status_t getCurrentPosition(int64_t *mediaUs);
     int64_t getVideoLateByUs();
 
+    // Audio drain wakeups and batches, for dumpsys.
+    sp<AMessage> getStats();
+
     status_t openAudioSink(
             const sp<AMessage> &format,
             bool offloadOnly,
@@ -126,6 +136,7 @@ private:
 
     struct QueueEntry {
         sp<ABuffer> mBuffer;
+        // NULL for all but the last buffer of a batch
         sp<AMessage> mNotifyConsumed;
         size_t mOffset;
         status_t mFinalResult;
@@ -203,12 +214,22 @@ private:
     int32_t mLastAudioBufferDrained;
     bool mUseAudioCallback;
 
+    // PCM is written when the sink is down to mAudioRefillUs, if set.
+    int64_t mAudioRefillUs;
+    // protected by mLock
+    int64_t mAudioDrainWakeups;
+    int64_t mAudioDrainBatches;
+    int64_t mAudioDrainFramesWritten;
+    int64_t mFirstAudioDrainUs;
+    int64_t mLastAudioDrainUs;
+
     sp<AWakeLock> mWakeLock;
 
     status_t getCurrentPositionOnLooper(int64_t *mediaUs);
     status_t getCurrentPositionOnLooper(
             int64_t *mediaUs, int64_t nowUs, bool allowPastQueuedVideo = false);
     bool getCurrentPositionIfPaused_l(int64_t *mediaUs);
+    bool batchingAudio() const;
     status_t getCurrentPositionFromAnchor(
             int64_t *mediaUs, int64_t nowUs, bool allowPastQueuedVideo = false);
 
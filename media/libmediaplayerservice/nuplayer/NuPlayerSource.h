@@ -55,6 +55,7 @@ struct NuPlayer::Source : public AHandler {
         kWhatQueueDecoderShutdown,
         kWhatDrmNoLicense,
         kWhatInstantiateSecureDecoders,
+        kWhatFormatsKnown,
     };
 
     // The provides message is used to notify the player about various
@@ -122,6 +123,10 @@ struct NuPlayer::Source : public AHandler {
 
     virtual void setOffloadAudio(bool /* offload */) {}
 
+    // Tells the source the playback speed, so that it can skip video it
+    // will not be able to decode and render in time.
+    virtual void setPlaybackSpeed(float /* speed */) {}
+
 protected:
     virtual ~Source() {}
 
@@ -132,6 +137,9 @@ protected:
     void notifyFlagsChanged(uint32_t flags);
     void notifyVideoSizeChanged(const sp<AMessage> &format = NULL);
     void notifyInstantiateSecureDecoders(const sp<AMessage> &reply);
+    // Tells the player which decoders it is going to need before the source
+    // is prepared; either mime may be NULL.
+    void notifyFormatsKnown(const char *audioMime, const char *videoMime);
     void notifyPrepared(status_t err = OK);
 
 private:
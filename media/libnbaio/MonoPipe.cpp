@@ -30,6 +30,16 @@
 
 namespace android {
 
+// Gains of the PI rate controller, for a fill error in seconds.  The pipe integrates the
+// rate difference, so the closed loop is s^2 + Kp * s + Ki, critically damped for
+// Ki = Kp^2 / 4, here with a time constant of 2 / Kp = 20 seconds.
+static const double kRateKp = 0.1;
+static const double kRateKi = kRateKp * kRateKp / 4;
+// a longer gap between reads, for instance after a standby, restarts the estimation
+static const int64_t kRateMaxGapNs = 500000000;
+
+/*static*/ const double MonoPipe::kMaxRateCorrection = 0.001;
+
 MonoPipe::MonoPipe(size_t reqFrames, const NBAIO_Format& format, bool writeCanBlock) :
         NBAIO_Sink(format),
         mReqFrames(reqFrames),
@@ -42,6 +52,10 @@ MonoPipe::MonoPipe(size_t reqFrames, const NBAIO_Format& format, bool writeCanBl
         mSetpoint((reqFrames * 11) / 16),
         mWriteCanBlock(writeCanBlock),
         mIsShutdown(false),
+        mRateControl(false),
+        mRateLastNs(0),
+        mRateIntegral(0.0),
+        mRateCorrectionPpb(0),
         // mTimestampShared
         mTimestampMutator(&mTimestampShared),
         mTimestampObserver(&mTimestampShared)
@@ -183,6 +197,43 @@ bool MonoPipe::isShutdown()
     return mIsShutdown;
 }
 
+double MonoPipe::getRateCorrection() const
+{
+    return 1.0 + android_atomic_acquire_load(&mRateCorrectionPpb) * 1e-9;
+}
+
+void MonoPipe::updateRateCorrection(size_t filled)
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return;
+    }
+    const int64_t nowNs = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    const int64_t deltaNs = nowNs - mRateLastNs;
+    mRateLastNs = nowNs;
+    if (deltaNs <= 0 || deltaNs > kRateMaxGapNs) {
+        // first read, or the previous state no longer predicts anything; keep the drift estimate
+        return;
+    }
+    // positive when the pipe is fuller than the setpoint, so the writer should slow down
+    const double error = ((double) filled - (double) mSetpoint) / Format_sampleRate(mFormat);
+    mRateIntegral += error * (deltaNs * 1e-9);
+    // anti-windup: the integral term alone never exceeds the correction limit
+    const double maxIntegral = kMaxRateCorrection / kRateKi;
+    if (mRateIntegral > maxIntegral) {
+        mRateIntegral = maxIntegral;
+    } else if (mRateIntegral < -maxIntegral) {
+        mRateIntegral = -maxIntegral;
+    }
+    double correction = -(kRateKp * error + kRateKi * mRateIntegral);
+    if (correction > kMaxRateCorrection) {
+        correction = kMaxRateCorrection;
+    } else if (correction < -kMaxRateCorrection) {
+        correction = -kMaxRateCorrection;
+    }
+    android_atomic_release_store((int32_t) (correction * 1e9), &mRateCorrectionPpb);
+}
+
 status_t MonoPipe::getTimestamp(ExtendedTimestamp &timestamp)
 {
     ExtendedTimestamp ets;
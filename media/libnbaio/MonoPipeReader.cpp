@@ -68,6 +68,9 @@ ssize_t MonoPipeReader::read(void *buffer, size_t count)
         }
         android_atomic_release_store(red + mPipe->mFront, &mPipe->mFront);
         mFramesRead += red;
+        if (mPipe->mRateControl) {
+            mPipe->updateRateCorrection(android_atomic_acquire_load(&mPipe->mRear) - mPipe->mFront);
+        }
     }
     return red;
 }
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 #include <new>
 #include <cutils/atomic.h>
 #include <media/nbaio/NBLog.h>
@@ -30,6 +31,87 @@
 
 namespace android {
 
+namespace {
+
+// A printf conversion specification, following the '%'
+struct Conversion {
+    size_t  mLength;        // of the whole specification, 0 if it can't be logged
+    size_t  mFlagsLength;   // of the flags, field width and precision at its start
+    char    mModifier;      // 0, 'H' for "hh", 'h', 'l', 'L' for "ll", 'j', 'z', 't' or 'q' for "L"
+    char    mConversion;
+};
+
+// fmt need not be NUL-terminated, at most maxLength characters are parsed
+Conversion parseConversion(const char *fmt, size_t maxLength)
+{
+    Conversion c = { 0, 0, 0, 0 };
+    size_t i = 0;
+    while (i < maxLength && strchr("-+ #0'", fmt[i]) != NULL && fmt[i] != '\0') {
+        ++i;
+    }
+    // field width and precision, of at most 3 digits each to bound the formatted length
+    for (int part = 0; part < 2; ++part) {
+        if (part == 1) {
+            if (i >= maxLength || fmt[i] != '.') {
+                break;
+            }
+            ++i;
+        }
+        size_t digits = 0;
+        while (i < maxLength && '0' <= fmt[i] && fmt[i] <= '9') {
+            ++i;
+            ++digits;
+        }
+        if (digits > 3) {
+            return c;
+        }
+    }
+    // a '*' width or precision would need more bookkeeping than it is worth
+    if (i >= maxLength || fmt[i] == '*') {
+        return c;
+    }
+    c.mFlagsLength = i;
+    switch (fmt[i]) {
+    case 'h':
+        c.mModifier = (i + 1 < maxLength && fmt[i + 1] == 'h') ? 'H' : 'h';
+        i += c.mModifier == 'H' ? 2 : 1;
+        break;
+    case 'l':
+        c.mModifier = (i + 1 < maxLength && fmt[i + 1] == 'l') ? 'L' : 'l';
+        i += c.mModifier == 'L' ? 2 : 1;
+        break;
+    case 'L':
+        c.mModifier = 'q';
+        ++i;
+        break;
+    case 'j':
+    case 'z':
+    case 't':
+        c.mModifier = fmt[i++];
+        break;
+    default:
+        break;
+    }
+    if (i >= maxLength || fmt[i] == '\0' || strchr("%diouxXcpsfFeEgGaA", fmt[i]) == NULL) {
+        return c;
+    }
+    c.mConversion = fmt[i];
+    c.mLength = i + 1;
+    return c;
+}
+
+// Set timestamp from the data of an EVENT_TIMESTAMP, returns it in ns
+int64_t formatTimestamp(const void *data, String8& timestamp)
+{
+    struct timespec ts;
+    memcpy(&ts, data, sizeof(struct timespec));
+    timestamp.clear();
+    timestamp.appendFormat("[%d.%03d]", (int) ts.tv_sec, (int) (ts.tv_nsec / 1000000));
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+}   // anonymous namespace
+
 int NBLog::Entry::readAt(size_t offset) const
 {
     // FIXME This is too slow, despite the name it is used during writing
@@ -47,6 +129,114 @@ int NBLog::Entry::readAt(size_t offset) const
 
 // ---------------------------------------------------------------------------
 
+void NBLog::Histogram::reset()
+{
+    memset(mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mMin = INT32_MAX;
+    mMax = 0;
+}
+
+/*static*/
+size_t NBLog::Histogram::bucketOf(int32_t value)
+{
+    if (value < (int32_t) kSubBuckets) {
+        return value;
+    }
+    // value has its most significant bit at exponent >= kSubBits, followed by kSubBits bits
+    const int exponent = 31 - __builtin_clz((uint32_t) value);
+    return ((exponent - kSubBits + 1) << kSubBits) +
+            ((value >> (exponent - kSubBits)) & (kSubBuckets - 1));
+}
+
+/*static*/
+int32_t NBLog::Histogram::lowerBound(size_t bucket)
+{
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    const int exponent = (bucket >> kSubBits) + kSubBits - 1;
+    return (int32_t) ((kSubBuckets + (bucket & (kSubBuckets - 1))) << (exponent - kSubBits));
+}
+
+void NBLog::Histogram::add(int32_t value)
+{
+    if (value < 0) {
+        value = 0;
+    }
+    mBuckets[bucketOf(value)]++;
+    mCount++;
+    if (value < mMin) {
+        mMin = value;
+    }
+    if (value > mMax) {
+        mMax = value;
+    }
+}
+
+void NBLog::Histogram::add(const Histogram& other)
+{
+    if (other.mCount == 0) {
+        return;
+    }
+    for (size_t i = 0; i < kBuckets; ++i) {
+        mBuckets[i] += other.mBuckets[i];
+    }
+    mCount += other.mCount;
+    if (other.mMin < mMin) {
+        mMin = other.mMin;
+    }
+    if (other.mMax > mMax) {
+        mMax = other.mMax;
+    }
+}
+
+int32_t NBLog::Histogram::percentile(double percent) const
+{
+    if (mCount == 0) {
+        return 0;
+    }
+    // rank of the value, counting from 1
+    uint64_t rank = (uint64_t) (percent / 100.0 * mCount + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > mCount) {
+        rank = mCount;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += mBuckets[i];
+        if (seen >= rank) {
+            // middle of the bucket, but never outside of the values actually added
+            const int32_t lower = lowerBound(i);
+            const int32_t upper = i + 1 < kBuckets ? lowerBound(i + 1) - 1 : INT32_MAX;
+            int32_t value = lower + (upper - lower) / 2;
+            if (value < mMin) {
+                value = mMin;
+            }
+            if (value > mMax) {
+                value = mMax;
+            }
+            return value;
+        }
+    }
+    return mMax;
+}
+
+NBLog::Histogram::Summary NBLog::Histogram::summarize() const
+{
+    Summary summary;
+    summary.mCount = mCount;
+    summary.mMin = mCount > 0 ? mMin : 0;
+    summary.mP50 = percentile(50.0);
+    summary.mP99 = percentile(99.0);
+    summary.mP999 = percentile(99.9);
+    summary.mMax = mMax;
+    return summary;
+}
+
+// ---------------------------------------------------------------------------
+
 #if 0   // FIXME see note in NBLog.h
 NBLog::Timeline::Timeline(size_t size, void *shared)
     : mSize(roundup(size)), mOwn(shared == NULL),
@@ -147,6 +337,113 @@ void NBLog::Writer::logTimestamp(const struct timespec& ts)
     log(EVENT_TIMESTAMP, &ts, sizeof(struct timespec));
 }
 
+void NBLog::Writer::logFormat(const char *fmt, ...)
+{
+    if (!mEnabled) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    Writer::logVFormat(fmt, ap);
+    va_end(ap);
+}
+
+void NBLog::Writer::logVFormat(const char *fmt, va_list argp)
+{
+    if (!mEnabled) {
+        return;
+    }
+    size_t fmtLength = strlen(fmt);
+    if (fmtLength > 255) {
+        fmtLength = 255;
+    }
+    log(EVENT_START_FMT, fmt, fmtLength);
+    Writer::logTimestamp();
+    for (size_t i = 0; i < fmtLength; ) {
+        if (fmt[i++] != '%') {
+            continue;
+        }
+        const Conversion c = parseConversion(&fmt[i], fmtLength - i);
+        if (c.mLength == 0) {
+            break;
+        }
+        i += c.mLength;
+        int64_t integer;
+        switch (c.mConversion) {
+        case '%':
+            continue;
+        case 'd':
+        case 'i':
+            switch (c.mModifier) {
+            case 'H': integer = (signed char) va_arg(argp, int); break;
+            case 'h': integer = (short) va_arg(argp, int); break;
+            case 'l': integer = va_arg(argp, long); break;
+            case 'L': integer = va_arg(argp, long long); break;
+            case 'j': integer = va_arg(argp, intmax_t); break;
+            case 'z': integer = va_arg(argp, ssize_t); break;
+            case 't': integer = va_arg(argp, ptrdiff_t); break;
+            default:  integer = va_arg(argp, int); break;
+            }
+            break;
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            switch (c.mModifier) {
+            case 'H': integer = (unsigned char) va_arg(argp, unsigned); break;
+            case 'h': integer = (unsigned short) va_arg(argp, unsigned); break;
+            case 'l': integer = va_arg(argp, unsigned long); break;
+            case 'L': integer = va_arg(argp, unsigned long long); break;
+            case 'j': integer = va_arg(argp, uintmax_t); break;
+            case 'z': integer = va_arg(argp, size_t); break;
+            case 't': integer = va_arg(argp, ptrdiff_t); break;
+            default:  integer = va_arg(argp, unsigned); break;
+            }
+            break;
+        case 'c':
+            integer = va_arg(argp, int);
+            break;
+        case 'p':
+            integer = (uintptr_t) va_arg(argp, void *);
+            break;
+        case 's': {
+            const char *s = va_arg(argp, const char *);
+            if (s == NULL) {
+                s = "(null)";
+            }
+            size_t length = strlen(s);
+            log(EVENT_STRING, s, length > 255 ? 255 : length);
+            } continue;
+        default: {  // floating point
+            double d = c.mModifier == 'q' ? (double) va_arg(argp, long double) :
+                    va_arg(argp, double);
+            log(EVENT_DOUBLE, &d, sizeof(d));
+            } continue;
+        }
+        log(EVENT_INTEGER, &integer, sizeof(integer));
+    }
+    log(EVENT_END_FMT, fmt, 0);
+}
+
+void NBLog::Writer::logHistogram(const char *name, const int32_t *values, size_t count)
+{
+    if (!mEnabled || count == 0) {
+        return;
+    }
+    size_t nameLength = strlen(name);
+    if (nameLength > kMaxHistogramName) {
+        nameLength = kMaxHistogramName;
+    }
+    if (count > kMaxHistogramValues) {
+        count = kMaxHistogramValues;
+    }
+    uint8_t data[1 + kMaxHistogramName + kMaxHistogramValues * sizeof(int32_t)];
+    data[0] = nameLength;
+    memcpy(&data[1], name, nameLength);
+    memcpy(&data[1 + nameLength], values, count * sizeof(int32_t));
+    log(EVENT_HISTOGRAM, data, 1 + nameLength + count * sizeof(int32_t));
+}
+
 void NBLog::Writer::log(Event event, const void *data, size_t length)
 {
     if (!mEnabled) {
@@ -158,6 +455,11 @@ void NBLog::Writer::log(Event event, const void *data, size_t length)
     switch (event) {
     case EVENT_STRING:
     case EVENT_TIMESTAMP:
+    case EVENT_START_FMT:
+    case EVENT_INTEGER:
+    case EVENT_DOUBLE:
+    case EVENT_END_FMT:
+    case EVENT_HISTOGRAM:
         break;
     case EVENT_RESERVED:
     default:
@@ -258,6 +560,27 @@ void NBLog::LockedWriter::logTimestamp(const struct timespec& ts)
     Writer::logTimestamp(ts);
 }
 
+void NBLog::LockedWriter::logFormat(const char *fmt, ...)
+{
+    Mutex::Autolock _l(mLock);
+    va_list ap;
+    va_start(ap, fmt);
+    Writer::logVFormat(fmt, ap);
+    va_end(ap);
+}
+
+void NBLog::LockedWriter::logVFormat(const char *fmt, va_list ap)
+{
+    Mutex::Autolock _l(mLock);
+    Writer::logVFormat(fmt, ap);
+}
+
+void NBLog::LockedWriter::logHistogram(const char *name, const int32_t *values, size_t count)
+{
+    Mutex::Autolock _l(mLock);
+    Writer::logHistogram(name, values, count);
+}
+
 bool NBLog::LockedWriter::isEnabled() const
 {
     Mutex::Autolock _l(mLock);
@@ -273,40 +596,49 @@ bool NBLog::LockedWriter::setEnabled(bool enabled)
 // ---------------------------------------------------------------------------
 
 NBLog::Reader::Reader(size_t size, const void *shared)
-    : mSize(roundup(size)), mShared((const Shared *) shared), mFront(0)
+    : mSize(roundup(size)), mShared((const Shared *) shared), mFront(0), mLines(NULL),
+      mLineTimestampNs(0), mHistogramFront(0), mHistogramLost(0), mHistogramWindow(0)
 {
 }
 
 NBLog::Reader::Reader(size_t size, const sp<IMemory>& iMemory)
     : mSize(roundup(size)), mShared(iMemory != 0 ? (const Shared *) iMemory->pointer() : NULL),
-      mIMemory(iMemory), mFront(0)
+      mIMemory(iMemory), mFront(0), mLines(NULL), mLineTimestampNs(0), mHistogramFront(0),
+      mHistogramLost(0), mHistogramWindow(0)
 {
 }
 
-void NBLog::Reader::dump(int fd, size_t indent)
+void NBLog::Reader::dump(Vector<Line>& lines)
+{
+    mLines = &lines;
+    dump(-1, 0 /*indent*/);
+    mLines = NULL;
+}
+
+uint8_t *NBLog::Reader::copyEntries(int32_t& front, size_t& avail, size_t& lost) const
 {
     int32_t rear = android_atomic_acquire_load(&mShared->mRear);
-    size_t avail = rear - mFront;
+    avail = rear - front;
+    lost = 0;
     if (avail == 0) {
-        return;
+        return NULL;
     }
-    size_t lost = 0;
     if (avail > mSize) {
         lost = avail - mSize;
-        mFront += lost;
+        front += lost;
         avail = mSize;
     }
     size_t remaining = avail;       // remaining = number of bytes left to read
-    size_t front = mFront & (mSize - 1);
-    size_t read = mSize - front;    // read = number of bytes that have been read so far
+    size_t index = front & (mSize - 1);
+    size_t read = mSize - index;    // read = number of bytes that have been read so far
     if (read > remaining) {
         read = remaining;
     }
     // make a copy to avoid race condition with writer
     uint8_t *copy = new uint8_t[avail];
     // copy first part of circular buffer up until the wraparound point
-    memcpy(copy, &mShared->mBuffer[front], read);
-    if (front + read == mSize) {
+    memcpy(copy, &mShared->mBuffer[index], read);
+    if (index + read == mSize) {
         if ((remaining -= read) > 0) {
             // copy second part of circular buffer starting at beginning
             memcpy(&copy[read], mShared->mBuffer, remaining);
@@ -314,7 +646,17 @@ void NBLog::Reader::dump(int fd, size_t indent)
             // remaining = 0 but not necessary
         }
     }
-    mFront += read;
+    front += read;
+    return copy;
+}
+
+void NBLog::Reader::dump(int fd, size_t indent)
+{
+    size_t avail, lost;
+    uint8_t *copy = copyEntries(mFront, avail, lost);
+    if (copy == NULL) {
+        return;
+    }
     size_t i = avail;
     Event event;
     size_t length;
@@ -403,6 +745,7 @@ void NBLog::Reader::dump(int fd, size_t indent)
                 deferredTimestamp = false;
             }
             timestamp.clear();
+            mLineTimestampNs = ts.tv_sec * 1000000000LL + ts.tv_nsec;
             if (n >= kSquashTimestamp) {
                 timestamp.appendFormat("[%d.%03d to .%.03d by .%.03d to .%.03d]",
                         (int) ts.tv_sec, (int) (ts.tv_nsec / 1000000),
@@ -414,8 +757,25 @@ void NBLog::Reader::dump(int fd, size_t indent)
             }
             timestamp.appendFormat("[%d.%03d]", (int) ts.tv_sec,
                     (int) (ts.tv_nsec / 1000000));
+            mLineTimestampNs = ts.tv_sec * 1000000000LL + ts.tv_nsec;
             deferredTimestamp = true;
             } break;
+        case EVENT_START_FMT:
+            if (deferredTimestamp) {
+                dumpLine(timestamp, body);
+                deferredTimestamp = false;
+            }
+            i = formatEntry(copy, i, avail, timestamp, body);
+            advance = 0;
+            break;
+        case EVENT_INTEGER:
+        case EVENT_DOUBLE:
+        case EVENT_END_FMT:
+            // rest of a logFormat() entry whose start was lost
+            break;
+        case EVENT_HISTOGRAM:
+            // see updateHistograms()
+            break;
         case EVENT_RESERVED:
         default:
             body.appendFormat("warning: unknown event %d", event);
@@ -435,9 +795,109 @@ void NBLog::Reader::dump(int fd, size_t indent)
     delete[] copy;
 }
 
+size_t NBLog::Reader::formatEntry(const uint8_t *copy, size_t i, size_t avail,
+        String8& timestamp, String8& body)
+{
+    // entries from i to avail were checked by dump()
+    const char *fmt = (const char *) &copy[i + 2];
+    const size_t fmtLength = copy[i + 1];
+    i += fmtLength + 3;
+    size_t f = 0;
+    while (f < fmtLength) {
+        const char *literal = &fmt[f];
+        while (f < fmtLength && fmt[f] != '%') {
+            ++f;
+        }
+        body.append(literal, &fmt[f] - literal);
+        if (f++ >= fmtLength) {
+            break;
+        }
+        const Conversion c = parseConversion(&fmt[f], fmtLength - f);
+        if (c.mLength == 0 || c.mFlagsLength > 16) {
+            // the writer stopped logging arguments here
+            body.append(&fmt[f - 1], fmtLength - f + 1);
+            break;
+        }
+        const char *flags = &fmt[f];
+        f += c.mLength;
+        if (c.mConversion == '%') {
+            body.append("%");
+            continue;
+        }
+        // the timestamp precedes the first argument
+        while (i < avail && (Event) copy[i] == EVENT_TIMESTAMP) {
+            mLineTimestampNs = formatTimestamp(&copy[i + 2], timestamp);
+            i += sizeof(struct timespec) + 3;
+        }
+        if (i >= avail || (Event) copy[i] == EVENT_END_FMT || (Event) copy[i] == EVENT_START_FMT) {
+            body.append("?");
+            continue;
+        }
+        const Event event = (Event) copy[i];
+        const size_t length = copy[i + 1];
+        const void *data = &copy[i + 2];
+        i += length + 3;
+        // rebuild the specification without the length modifier, for the logged type
+        char spec[32] = "%";
+        memcpy(&spec[1], flags, c.mFlagsLength);
+        char *end = &spec[1 + c.mFlagsLength];
+        int64_t integer;
+        double d;
+        if (event == EVENT_INTEGER && length == sizeof(integer) &&
+                strchr("diouxXcp", c.mConversion) != NULL) {
+            memcpy(&integer, data, sizeof(integer));
+            if (c.mConversion == 'c') {
+                strcpy(end, "c");
+                body.appendFormat(spec, (int) integer);
+            } else if (c.mConversion == 'p') {
+                strcpy(end, "p");
+                body.appendFormat(spec, (void *) (uintptr_t) integer);
+            } else {
+                end[0] = 'l';
+                end[1] = 'l';
+                end[2] = c.mConversion;
+                end[3] = '\0';
+                body.appendFormat(spec, (long long) integer);
+            }
+        } else if (event == EVENT_DOUBLE && length == sizeof(d) &&
+                strchr("fFeEgGaA", c.mConversion) != NULL) {
+            memcpy(&d, data, sizeof(d));
+            end[0] = c.mConversion;
+            end[1] = '\0';
+            body.appendFormat(spec, d);
+        } else if (event == EVENT_STRING && c.mConversion == 's') {
+            String8 string((const char *) data, length);
+            strcpy(end, "s");
+            body.appendFormat(spec, string.string());
+        } else {
+            body.append("?");
+        }
+    }
+    // skip any arguments that were not used, up to the end of the entry
+    while (i < avail) {
+        const Event event = (Event) copy[i];
+        if (event == EVENT_START_FMT) {
+            break;
+        }
+        if (event == EVENT_TIMESTAMP) {
+            mLineTimestampNs = formatTimestamp(&copy[i + 2], timestamp);
+        }
+        i += copy[i + 1] + 3;
+        if (event == EVENT_END_FMT) {
+            break;
+        }
+    }
+    return i;
+}
+
 void NBLog::Reader::dumpLine(const String8& timestamp, String8& body)
 {
-    if (mFd >= 0) {
+    if (mLines != NULL) {
+        Line line;
+        line.mTimestampNs = mLineTimestampNs;
+        line.mText.appendFormat("%s %s", timestamp.string(), body.string());
+        mLines->add(line);
+    } else if (mFd >= 0) {
         dprintf(mFd, "%.*s%s %s\n", mIndent, "", timestamp.string(), body.string());
     } else {
         ALOGI("%.*s%s %s", mIndent, "", timestamp.string(), body.string());
@@ -445,6 +905,122 @@ void NBLog::Reader::dumpLine(const String8& timestamp, String8& body)
     body.clear();
 }
 
+void NBLog::Reader::updateHistograms()
+{
+    Mutex::Autolock _l(mHistogramLock);
+    size_t avail, lost;
+    uint8_t *copy = copyEntries(mHistogramFront, avail, lost);
+    if (copy == NULL) {
+        return;
+    }
+    // scan backwards to find the oldest complete entry, as in dump()
+    size_t i = avail;
+    while (i >= 3) {
+        const size_t length = copy[i - 1];
+        if (length + 3 > i || copy[i - length - 2] != length) {
+            break;
+        }
+        i -= length + 3;
+    }
+    mHistogramLost += lost + i;
+    for ( ; i < avail; i += copy[i + 1] + 3) {
+        if ((Event) copy[i] != EVENT_HISTOGRAM) {
+            continue;
+        }
+        const size_t length = copy[i + 1];
+        const uint8_t *data = &copy[i + 2];
+        const size_t nameLength = data[0];
+        if (length < 1 + nameLength) {
+            continue;   // corrupt
+        }
+        const String8 name((const char *) &data[1], nameLength);
+        NamedHistogram *histogram = NULL;
+        for (size_t j = 0; j < mHistograms.size(); ++j) {
+            if (mHistograms[j].mName == name) {
+                histogram = &mHistograms.editItemAt(j);
+                break;
+            }
+        }
+        if (histogram == NULL) {
+            NamedHistogram newHistogram;
+            newHistogram.mName = name;
+            mHistograms.add(newHistogram);
+            histogram = &mHistograms.editTop();
+        }
+        for (size_t j = 1 + nameLength; j + sizeof(int32_t) <= length; j += sizeof(int32_t)) {
+            int32_t value;
+            memcpy(&value, &data[j], sizeof(value));
+            histogram->mTotal.add(value);
+            histogram->mWindow[mHistogramWindow].add(value);
+        }
+    }
+    delete[] copy;
+}
+
+void NBLog::Reader::rotateHistograms()
+{
+    Mutex::Autolock _l(mHistogramLock);
+    mHistogramWindow ^= 1;
+    for (size_t i = 0; i < mHistograms.size(); ++i) {
+        mHistograms.editItemAt(i).mWindow[mHistogramWindow].reset();
+    }
+}
+
+void NBLog::Reader::dumpHistograms(int fd, size_t indent)
+{
+    Mutex::Autolock _l(mHistogramLock);
+    if (mHistograms.isEmpty()) {
+        return;
+    }
+    String8 result;
+    result.appendFormat("%*sHistograms:\n", (int) indent, "");
+    if (mHistogramLost > 0) {
+        result.appendFormat("%*s  warning: lost %zu bytes worth of events\n", (int) indent, "",
+                mHistogramLost);
+    }
+    result.appendFormat("%*s  %-15s %-6s %10s %10s %10s %10s %10s %10s\n", (int) indent, "",
+            "name", "window", "count", "min", "p50", "p99", "p99.9", "max");
+    for (size_t i = 0; i < mHistograms.size(); ++i) {
+        const NamedHistogram& histogram = mHistograms[i];
+        Histogram recent = histogram.mWindow[0];
+        recent.add(histogram.mWindow[1]);
+        for (int total = 0; total < 2; ++total) {
+            const Histogram::Summary summary = total ? histogram.mTotal.summarize() :
+                    recent.summarize();
+            result.appendFormat("%*s  %-15s %-6s %10llu %10d %10d %10d %10d %10d\n",
+                    (int) indent, "", total ? "" : histogram.mName.string(),
+                    total ? "total" : "recent", (unsigned long long) summary.mCount,
+                    summary.mMin, summary.mP50, summary.mP99, summary.mP999, summary.mMax);
+        }
+    }
+    if (fd >= 0) {
+        write(fd, result.string(), result.size());
+    } else {
+        ALOGI("%s", result.string());
+    }
+}
+
+bool NBLog::Reader::getHistogramSummary(const char *name, bool recent,
+        Histogram::Summary *summary)
+{
+    Mutex::Autolock _l(mHistogramLock);
+    for (size_t i = 0; i < mHistograms.size(); ++i) {
+        const NamedHistogram& histogram = mHistograms[i];
+        if (histogram.mName != name) {
+            continue;
+        }
+        if (recent) {
+            Histogram window = histogram.mWindow[0];
+            window.add(histogram.mWindow[1]);
+            *summary = window.summarize();
+        } else {
+            *summary = histogram.mTotal.summarize();
+        }
+        return true;
+    }
+    return false;
+}
+
 bool NBLog::Reader::isIMemory(const sp<IMemory>& iMemory) const
 {
     return iMemory != 0 && mIMemory != 0 && iMemory->pointer() == mIMemory->pointer();
@@ -28,8 +28,11 @@ PipeReader::PipeReader(Pipe& pipe) :
         mPipe(pipe),
         // any data already in the pipe is not visible to this PipeReader
         mFront(android_atomic_acquire_load(&pipe.mRear)),
+        mPublishedFront(mFront),
         mFramesOverrun(0),
-        mOverruns(0)
+        mOverruns(0),
+        mOverrunCallback(NULL),
+        mOverrunCookie(NULL)
 {
     android_atomic_inc(&pipe.mReaders);
 }
@@ -57,8 +60,12 @@ ssize_t PipeReader::availableToRead()
         // Discard 1/16 of the most recent data in pipe to avoid another overrun immediately
         int32_t oldFront = mFront;
         mFront = rear - mPipe.mMaxFrames + (mPipe.mMaxFrames >> 4);
+        android_atomic_release_store(mFront, &mPublishedFront);
         mFramesOverrun += (size_t) (mFront - oldFront);
         ++mOverruns;
+        if (mOverrunCallback != NULL) {
+            mOverrunCallback(mOverrunCookie, (size_t) (mFront - oldFront));
+        }
         return OVERRUN;
     }
     return avail;
@@ -92,9 +99,58 @@ ssize_t PipeReader::read(void *buffer, size_t count)
             red += count;
         }
     }
-    mFront += red;
-    mFramesRead += red;
+    advance(red);
     return red;
 }
 
+ssize_t PipeReader::obtain(Span spans[2], size_t count)
+{
+    ssize_t avail = availableToRead();
+    if (CC_UNLIKELY(avail <= 0)) {
+        return avail;
+    }
+    if (CC_LIKELY(count > (size_t) avail)) {
+        count = avail;
+    }
+    size_t front = mFront & (mPipe.mMaxFrames - 1);
+    size_t part1 = mPipe.mMaxFrames - front;
+    if (CC_LIKELY(part1 > count)) {
+        part1 = count;
+    }
+    spans[0].mData = (char *) mPipe.mBuffer + (front * mFrameSize);
+    spans[0].mFrames = part1;
+    spans[1].mData = mPipe.mBuffer;
+    spans[1].mFrames = count - part1;
+    return count;
+}
+
+ssize_t PipeReader::release(size_t count)
+{
+    // The frames are intact if the writer has not yet come round to the first of them
+    int32_t rear = android_atomic_acquire_load(&mPipe.mRear);
+    bool overrun = (size_t) (rear - mFront) > mPipe.mMaxFrames;
+    advance(count);
+    return overrun ? (ssize_t) OVERRUN : (ssize_t) count;
+}
+
+void PipeReader::setOverrunCallback(overrun_callback_t callback, void *cookie)
+{
+    mOverrunCallback = callback;
+    mOverrunCookie = cookie;
+}
+
+size_t PipeReader::fillLevel() const
+{
+    int32_t rear = android_atomic_acquire_load(&mPipe.mRear);
+    size_t fill = rear - android_atomic_acquire_load(&mPublishedFront);
+    return fill < mPipe.mMaxFrames ? fill : mPipe.mMaxFrames;
+}
+
+void PipeReader::advance(size_t count)
+{
+    mFront += count;
+    android_atomic_release_store(mFront, &mPublishedFront);
+    mFramesRead += count;
+}
+
 }   // namespace android
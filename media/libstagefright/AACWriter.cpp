@@ -34,6 +34,8 @@
 #include <media/stagefright/MetaData.h>
 #include <media/mediarecorder.h>
 
+#include "include/AsyncFileWriter.h"
+
 namespace android {
 
 AACWriter::AACWriter(int fd)
@@ -48,7 +50,8 @@ AACWriter::AACWriter(int fd)
       mChannelCount(-1),
       mSampleRate(-1),
       mAACProfile(OMX_AUDIO_AACObjectLC),
-      mFrameDurationUs(0) {
+      mFrameDurationUs(0),
+      mFileWriter(NULL) {
 }
 
 AACWriter::~AACWriter() {
@@ -236,8 +239,11 @@ static bool getSampleRateTableIndex(int sampleRate, uint8_t* tableIndex) {
  * 2 bits of frames count in one packet. Set to 0.
  */
 status_t AACWriter::writeAdtsHeader(uint32_t frameLength) {
+    uint8_t header[kAdtsHeaderLength];
+    size_t n = 0;
+
     uint8_t data = 0xFF;
-    write(mFd, &data, 1);
+    header[n++] = data;
 
     const uint8_t kFieldId = 0;
     const uint8_t kMpegLayer = 0;
@@ -246,7 +252,7 @@ status_t AACWriter::writeAdtsHeader(uint32_t frameLength) {
     data |= (kFieldId << 3);
     data |= (kMpegLayer << 1);
     data |= kProtectionAbsense;
-    write(mFd, &data, 1);
+    header[n++] = data;
 
     const uint8_t kProfileCode = mAACProfile - 1;
     uint8_t kSampleFreqIndex;
@@ -257,7 +263,7 @@ status_t AACWriter::writeAdtsHeader(uint32_t frameLength) {
     data |= (kSampleFreqIndex << 2);
     data |= (kPrivateStream << 1);
     data |= (kChannelConfigCode >> 2);
-    write(mFd, &data, 1);
+    header[n++] = data;
 
     // 4 bits from originality to copyright start
     const uint8_t kCopyright = 0;
@@ -265,22 +271,23 @@ status_t AACWriter::writeAdtsHeader(uint32_t frameLength) {
     data = ((kChannelConfigCode & 3) << 6);
     data |= (kCopyright << 2);
     data |= ((kFrameLength & 0x1800) >> 11);
-    write(mFd, &data, 1);
+    header[n++] = data;
 
     data = ((kFrameLength & 0x07F8) >> 3);
-    write(mFd, &data, 1);
+    header[n++] = data;
 
     const uint32_t kBufferFullness = 0x7FF;  // VBR
     data = ((kFrameLength & 0x07) << 5);
     data |= ((kBufferFullness & 0x07C0) >> 6);
-    write(mFd, &data, 1);
+    header[n++] = data;
 
     const uint8_t kFrameCount = 0;
     data = ((kBufferFullness & 0x03F) << 2);
     data |= kFrameCount;
-    write(mFd, &data, 1);
+    header[n++] = data;
 
-    return OK;
+    CHECK_EQ(n, (size_t)kAdtsHeaderLength);
+    return writeFile(header, n);
 }
 
 status_t AACWriter::threadFunc() {
@@ -293,6 +300,9 @@ status_t AACWriter::threadFunc() {
 
     prctl(PR_SET_NAME, (unsigned long)"AACWriterThread", 0, 0, 0);
 
+    mFileWriter = AsyncFileWriter::CreateFromProperties(
+            mFd, "media.audiowriter", kDefaultIOBufferSizeKB, kDefaultNumIOBuffers);
+
     while (!mDone && err == OK) {
         MediaBuffer *buffer;
         err = mSource->read(&buffer);
@@ -352,7 +362,7 @@ status_t AACWriter::threadFunc() {
         ssize_t dataLength = buffer->range_length();
         uint8_t *data = (uint8_t *)buffer->data() + buffer->range_offset();
         if (writeAdtsHeader(kAdtsHeaderLength + dataLength) != OK ||
-            dataLength != write(mFd, data, dataLength)) {
+            writeFile(data, dataLength) != OK) {
             err = ERROR_IO;
         }
 
@@ -372,6 +382,11 @@ status_t AACWriter::threadFunc() {
         err = ERROR_MALFORMED;
     }
 
+    if (AsyncFileWriter::Release(mFileWriter) != OK
+            && (err == OK || err == ERROR_END_OF_STREAM)) {
+        err = ERROR_IO;
+    }
+    mFileWriter = NULL;
     close(mFd);
     mFd = -1;
     mReachedEOS = true;
@@ -381,6 +396,14 @@ status_t AACWriter::threadFunc() {
     return err;
 }
 
+status_t AACWriter::writeFile(const void *data, size_t size) {
+    if (mFileWriter != NULL) {
+        mFileWriter->write(data, size);
+        return mFileWriter->getStatus();
+    }
+    return ::write(mFd, data, size) == (ssize_t)size ? OK : ERROR_IO;
+}
+
 bool AACWriter::reachedEOS() {
     return mReachedEOS;
 }
@@ -29,6 +29,7 @@
 #include <media/stagefright/ACodec.h>
 
 #include <binder/MemoryDealer.h>
+#include <cutils/properties.h>
 
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/foundation/ABuffer.h>
@@ -61,6 +62,19 @@ enum {
     kMaxIndicesToCheck = 32, // used when enumerating supported formats and profiles
 };
 
+// Extra output buffers allocated beyond what the component and the surface
+// need: two against starvation plus one for an incorrect minUndequeuedBufs.
+// With an adaptive output buffer count, the count starts at the minimum and
+// moves by one at each output buffer allocation, up if dequeueBuffer()
+// stalled for more than kOutputDequeueStallRatio of the dequeues since the
+// last allocation, down if it never did.
+static const OMX_U32 kDefaultExtraOutputBuffers = 2 + 1;
+static const OMX_U32 kMinExtraOutputBuffers = 1;
+static const OMX_U32 kMaxExtraOutputBuffers = 2 + 2;
+static const int64_t kOutputDequeueStallUs = 5000;
+static const int32_t kMinOutputDequeuesToAdapt = 30;
+static const float kOutputDequeueStallRatio = 0.05f;
+
 // OMX errors are directly mapped into status_t range if
 // there is no corresponding MediaError status code.
 // Use the statusFromOMXError(int32_t omxError) function.
@@ -516,6 +530,10 @@ ACodec::ACodec()
       mLegacyAdaptiveExperiment(false),
       mMetadataBuffersToSubmit(0),
       mNumUndequeuedBuffers(0),
+      mAdaptiveOutputBufferCount(false),
+      mExtraOutputBuffers(kDefaultExtraOutputBuffers),
+      mNumOutputDequeues(0),
+      mNumOutputDequeueStalls(0),
       mRepeatFrameDelayUs(-1ll),
       mMaxPtsGapUs(-1ll),
       mMaxFps(-1),
@@ -1052,7 +1070,10 @@ status_t ACodec::configureOutputBuffersFromNativeWindow(
     // 2. try to allocate two (2) additional buffers to reduce starvation from
     //    the consumer
     //    plus an extra buffer to account for incorrect minUndequeuedBufs
-    for (OMX_U32 extraBuffers = 2 + 1; /* condition inside loop */; extraBuffers--) {
+    //    (or as many as the adaptive buffer count settled on)
+    updateExtraOutputBuffers();
+    for (OMX_U32 extraBuffers = mExtraOutputBuffers; /* condition inside loop */;
+            extraBuffers--) {
         OMX_U32 newBufferCount =
             def.nBufferCountMin + *minUndequeuedBuffers + extraBuffers;
         def.nBufferCountActual = newBufferCount;
@@ -1086,6 +1107,68 @@ status_t ACodec::configureOutputBuffersFromNativeWindow(
     return err;
 }
 
+status_t ACodec::setLowLatency(bool lowLatency) {
+    OMX_INDEXTYPE index;
+    status_t err = mOMX->getExtensionIndex(
+            mNode, "OMX.google.android.index.lowLatency", &index);
+    if (err != OK) {
+        ALOGI("[%s] does not support low latency decoding", mComponentName.c_str());
+        return err;
+    }
+
+    // lets the component output each frame as soon as it is decoded,
+    // rather than in presentation order after reordering
+    OMX_CONFIG_BOOLEANTYPE config;
+    InitOMXParams(&config);
+    config.bEnabled = lowLatency ? OMX_TRUE : OMX_FALSE;
+    err = mOMX->setParameter(mNode, index, &config, sizeof(config));
+    ALOGW_IF(err != OK, "[%s] failed to set low latency decoding (%d)",
+            mComponentName.c_str(), err);
+    return err;
+}
+
+status_t ACodec::setEncoderSpeed(int32_t speed) {
+    OMX_INDEXTYPE index;
+    status_t err = mOMX->getExtensionIndex(
+            mNode, "OMX.google.android.index.encoderSpeed", &index);
+    if (err != OK) {
+        ALOGI("[%s] does not support encoder speed presets", mComponentName.c_str());
+        return err;
+    }
+
+    // 0 is the component's slowest, best quality preset
+    OMX_PARAM_U32TYPE params;
+    InitOMXParams(&params);
+    params.nPortIndex = kPortIndexOutput;
+    params.nU32 = speed;
+    err = mOMX->setParameter(mNode, index, &params, sizeof(params));
+    ALOGW_IF(err != OK, "[%s] failed to set encoder speed %d (%d)",
+            mComponentName.c_str(), speed, err);
+    return err;
+}
+
+void ACodec::updateExtraOutputBuffers() {
+    if (!mAdaptiveOutputBufferCount || mNumOutputDequeues < kMinOutputDequeuesToAdapt) {
+        return;
+    }
+
+    OMX_U32 extraBuffers = mExtraOutputBuffers;
+    if (mNumOutputDequeueStalls > mNumOutputDequeues * kOutputDequeueStallRatio) {
+        if (extraBuffers < kMaxExtraOutputBuffers) {
+            ++extraBuffers;
+        }
+    } else if (mNumOutputDequeueStalls == 0 && extraBuffers > kMinExtraOutputBuffers) {
+        --extraBuffers;
+    }
+
+    ALOGI("[%s] %d of %d output dequeues stalled, %u extra output buffers (was %u)",
+            mComponentName.c_str(), mNumOutputDequeueStalls, mNumOutputDequeues,
+            extraBuffers, mExtraOutputBuffers);
+    mExtraOutputBuffers = extraBuffers;
+    mNumOutputDequeues = 0;
+    mNumOutputDequeueStalls = 0;
+}
+
 status_t ACodec::allocateOutputBuffersFromNativeWindow() {
     OMX_U32 bufferCount, bufferSize, minUndequeuedBuffers;
     status_t err = configureOutputBuffersFromNativeWindow(
@@ -1402,11 +1485,18 @@ ACodec::BufferInfo *ACodec::dequeueBufferFromNativeWindow() {
 
     int fenceFd = -1;
     do {
+        int64_t startUs = mAdaptiveOutputBufferCount ? ALooper::GetNowUs() : 0;
         status_t err = mNativeWindow->dequeueBuffer(mNativeWindow.get(), &buf, &fenceFd);
         if (err != 0) {
             ALOGE("dequeueBuffer failed: %s(%d).", asString(err), err);
             return NULL;
         }
+        if (mAdaptiveOutputBufferCount) {
+            ++mNumOutputDequeues;
+            if (ALooper::GetNowUs() - startUs > kOutputDequeueStallUs) {
+                ++mNumOutputDequeueStalls;
+            }
+        }
 
         bool stale = false;
         for (size_t i = mBuffers[kPortIndexOutput].size(); i > 0;) {
@@ -1853,6 +1943,12 @@ status_t ACodec::configureCodec(
     if (video && !encoder) {
         inputFormat->setInt32("adaptive-playback", false);
 
+        int32_t lowLatency = 0;
+        if (msg->findInt32("low-latency", &lowLatency) && lowLatency != 0) {
+            // allow failure, the component just keeps reordering frames
+            (void)setLowLatency(true);
+        }
+
         int32_t usageProtected;
         if (msg->findInt32("protected", &usageProtected) && usageProtected) {
             if (!haveNativeWindow) {
@@ -2007,6 +2103,18 @@ status_t ACodec::configureCodec(
                     && push != 0) {
                 mFlags |= kFlagPushBlankBuffersToNativeWindowOnShutdown;
             }
+
+            int32_t adaptiveBufferCount;
+            if (!msg->findInt32("adaptive-buffer-count", &adaptiveBufferCount)) {
+                adaptiveBufferCount =
+                    property_get_bool("media.acodec.adaptive-buffer-count", false);
+            }
+            mAdaptiveOutputBufferCount = adaptiveBufferCount != 0;
+            // fewer buffers queued to the surface also means less latency
+            mExtraOutputBuffers = (mAdaptiveOutputBufferCount || lowLatency)
+                    ? kMinExtraOutputBuffers : kDefaultExtraOutputBuffers;
+            mNumOutputDequeues = 0;
+            mNumOutputDequeueStalls = 0;
         }
 
         int32_t rotationDegrees;
@@ -2031,6 +2139,12 @@ status_t ACodec::configureCodec(
 
         if (encoder) {
             err = setupVideoEncoder(mime, msg, outputFormat, inputFormat);
+
+            int32_t speed;
+            if (err == OK && msg->findInt32("encoder-speed", &speed) && speed >= 0) {
+                // allow failure, the component keeps its default preset
+                (void)setEncoderSpeed(speed);
+            }
         } else {
             err = setupVideoDecoder(mime, msg, haveNativeWindow, usingSwRenderer, outputFormat);
         }
@@ -7255,6 +7369,10 @@ void ACodec::ExecutingState::submitOutputMetaBuffers() {
 }
 
 void ACodec::ExecutingState::submitRegularOutputBuffers() {
+    // hand all the buffers to the component in a single IOMX call
+    Vector<size_t> indices;
+    Vector<IOMX::FillBufferInfo> fills;
+
     bool failed = false;
     for (size_t i = 0; i < mCodec->mBuffers[kPortIndexOutput].size(); ++i) {
         BufferInfo *info = &mCodec->mBuffers[kPortIndexOutput].editItemAt(i);
@@ -7281,14 +7399,25 @@ void ACodec::ExecutingState::submitRegularOutputBuffers() {
         ALOGV("[%s] calling fillBuffer %u", mCodec->mComponentName.c_str(), info->mBufferID);
 
         info->checkWriteFence("submitRegularOutputBuffers");
-        status_t err = mCodec->mOMX->fillBuffer(mCodec->mNode, info->mBufferID, info->mFenceFd);
+        IOMX::FillBufferInfo fill;
+        fill.mBuffer = info->mBufferID;
+        fill.mFenceFd = info->mFenceFd;
         info->mFenceFd = -1;
+        indices.push_back(i);
+        fills.push_back(fill);
+    }
+
+    if (!fills.isEmpty()) {
+        size_t numFilled;
+        status_t err = mCodec->mOMX->fillBuffers(
+                mCodec->mNode, fills.array(), fills.size(), &numFilled);
+        for (size_t i = 0; i < numFilled; ++i) {
+            mCodec->mBuffers[kPortIndexOutput].editItemAt(indices[i]).mStatus =
+                BufferInfo::OWNED_BY_COMPONENT;
+        }
         if (err != OK) {
             failed = true;
-            break;
         }
-
-        info->mStatus = BufferInfo::OWNED_BY_COMPONENT;
     }
 
     if (failed) {
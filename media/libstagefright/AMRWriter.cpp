@@ -29,6 +29,8 @@
 #include <media/stagefright/MetaData.h>
 #include <media/mediarecorder.h>
 
+#include "include/AsyncFileWriter.h"
+
 namespace android {
 
 AMRWriter::AMRWriter(int fd)
@@ -36,7 +38,8 @@ AMRWriter::AMRWriter(int fd)
       mInitCheck(mFd < 0? NO_INIT: OK),
       mStarted(false),
       mPaused(false),
-      mResumed(false) {
+      mResumed(false),
+      mFileWriter(NULL) {
 }
 
 AMRWriter::~AMRWriter() {
@@ -192,6 +195,10 @@ status_t AMRWriter::threadFunc() {
     status_t err = OK;
 
     prctl(PR_SET_NAME, (unsigned long)"AMRWriter", 0, 0, 0);
+
+    // the header was written by addSource()
+    mFileWriter = AsyncFileWriter::CreateFromProperties(
+            mFd, "media.audiowriter", kDefaultIOBufferSizeKB, kDefaultNumIOBuffers);
     while (!mDone) {
         MediaBuffer *buffer;
         err = mSource->read(&buffer);
@@ -236,11 +243,8 @@ status_t AMRWriter::threadFunc() {
             notify(MEDIA_RECORDER_EVENT_INFO, MEDIA_RECORDER_INFO_MAX_DURATION_REACHED, 0);
             break;
         }
-        ssize_t n = write(mFd,
-                        (const uint8_t *)buffer->data() + buffer->range_offset(),
-                        buffer->range_length());
-
-        if (n < (ssize_t)buffer->range_length()) {
+        if (writeFile((const uint8_t *)buffer->data() + buffer->range_offset(),
+                      buffer->range_length()) != OK) {
             buffer->release();
             buffer = NULL;
             err = ERROR_IO;
@@ -263,6 +267,11 @@ status_t AMRWriter::threadFunc() {
         err = ERROR_MALFORMED;
     }
 
+    if (AsyncFileWriter::Release(mFileWriter) != OK
+            && (err == OK || err == ERROR_END_OF_STREAM)) {
+        err = ERROR_IO;
+    }
+    mFileWriter = NULL;
     close(mFd);
     mFd = -1;
     mReachedEOS = true;
@@ -272,6 +281,14 @@ status_t AMRWriter::threadFunc() {
     return err;
 }
 
+status_t AMRWriter::writeFile(const void *data, size_t size) {
+    if (mFileWriter != NULL) {
+        mFileWriter->write(data, size);
+        return mFileWriter->getStatus();
+    }
+    return ::write(mFd, data, size) == (ssize_t)size ? OK : ERROR_IO;
+}
+
 bool AMRWriter::reachedEOS() {
     return mReachedEOS;
 }
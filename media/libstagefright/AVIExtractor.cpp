@@ -769,76 +769,84 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
         return ERROR_MALFORMED;
     }
 
-    sp<ABuffer> buffer = new ABuffer(size);
-    ssize_t n = mDataSource->readAt(offset, buffer->data(), buffer->size());
+    // read the index a block at a time rather than all at once
+    static const size_t kMaxBlockSize = 16 * 4096;
+    sp<ABuffer> buffer = new ABuffer(size < kMaxBlockSize ? size : kMaxBlockSize);
 
-    if (n < (ssize_t)size) {
-        return n < 0 ? (status_t)n : ERROR_MALFORMED;
-    }
+    while (size > 0) {
+        size_t blockSize = size < buffer->size() ? size : buffer->size();
+        ssize_t n = mDataSource->readAt(offset, buffer->data(), blockSize);
 
-    const uint8_t *data = buffer->data();
+        if (n < (ssize_t)blockSize) {
+            return n < 0 ? (status_t)n : ERROR_MALFORMED;
+        }
 
-    while (size > 0) {
-        uint32_t chunkType = U32_AT(data);
+        offset += blockSize;
+        size -= blockSize;
 
-        uint8_t hi = chunkType >> 24;
-        uint8_t lo = (chunkType >> 16) & 0xff;
+        const uint8_t *data = buffer->data();
 
-        if (hi < '0' || hi > '9' || lo < '0' || lo > '9') {
-            return ERROR_MALFORMED;
-        }
+        for (; blockSize > 0; data += 16, blockSize -= 16) {
+            uint32_t chunkType = U32_AT(data);
 
-        size_t trackIndex = 10 * (hi - '0') + (lo - '0');
+            uint8_t hi = chunkType >> 24;
+            uint8_t lo = (chunkType >> 16) & 0xff;
 
-        if (trackIndex >= mTracks.size()) {
-            return ERROR_MALFORMED;
-        }
+            if (hi < '0' || hi > '9' || lo < '0' || lo > '9') {
+                return ERROR_MALFORMED;
+            }
 
-        Track *track = &mTracks.editItemAt(trackIndex);
+            size_t trackIndex = 10 * (hi - '0') + (lo - '0');
 
-        if (!IsCorrectChunkType(-1, track->mKind, chunkType)) {
-            return ERROR_MALFORMED;
-        }
+            if (trackIndex >= mTracks.size()) {
+                return ERROR_MALFORMED;
+            }
 
-        if (track->mKind == Track::OTHER) {
-            data += 16;
-            size -= 16;
-            continue;
-        }
+            Track *track = &mTracks.editItemAt(trackIndex);
 
-        uint32_t flags = U32LE_AT(&data[4]);
-        uint32_t offset = U32LE_AT(&data[8]);
-        uint32_t chunkSize = U32LE_AT(&data[12]);
+            if (!IsCorrectChunkType(-1, track->mKind, chunkType)) {
+                return ERROR_MALFORMED;
+            }
 
-        if (chunkSize > track->mMaxSampleSize) {
-            track->mMaxSampleSize = chunkSize;
-        }
+            if (track->mKind == Track::OTHER) {
+                continue;
+            }
 
-        track->mSamples.push();
+            uint32_t flags = U32LE_AT(&data[4]);
+            uint32_t chunkOffset = U32LE_AT(&data[8]);
+            uint32_t chunkSize = U32LE_AT(&data[12]);
 
-        SampleInfo *info =
-            &track->mSamples.editItemAt(track->mSamples.size() - 1);
+            if (chunkSize > track->mMaxSampleSize) {
+                track->mMaxSampleSize = chunkSize;
+            }
 
-        info->mOffset = offset;
-        info->mIsKey = (flags & 0x10) != 0;
+            size_t sampleIndex = track->mSampleOffsets.size();
+            track->mSampleOffsets.push(chunkOffset);
 
-        if (info->mIsKey) {
-            static const size_t kMaxNumSyncSamplesToScan = 20;
+            if ((flags & 0x10) != 0) {
+                static const size_t kMaxNumSyncSamplesToScan = 20;
 
-            if (track->mNumSyncSamples < kMaxNumSyncSamplesToScan) {
-                if (chunkSize > track->mThumbnailSampleSize) {
-                    track->mThumbnailSampleSize = chunkSize;
+                if (track->mNumSyncSamples < kMaxNumSyncSamplesToScan) {
+                    if (chunkSize > track->mThumbnailSampleSize) {
+                        track->mThumbnailSampleSize = chunkSize;
 
-                    track->mThumbnailSampleIndex =
-                        track->mSamples.size() - 1;
+                        track->mThumbnailSampleIndex = sampleIndex;
+                    }
                 }
-            }
 
-            ++track->mNumSyncSamples;
-        }
+                // only start listing key chunks after the first non key one
+                if (track->mNumSyncSamples != sampleIndex) {
+                    track->mSyncSamples.push(sampleIndex);
+                }
 
-        data += 16;
-        size -= 16;
+                ++track->mNumSyncSamples;
+            } else if (track->mNumSyncSamples == sampleIndex) {
+                // all chunks so far were key chunks
+                for (size_t i = 0; i < sampleIndex; ++i) {
+                    track->mSyncSamples.push(i);
+                }
+            }
+        }
     }
 
     if (!mTracks.isEmpty()) {
@@ -870,7 +878,7 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
             // Compute the avg. size of the first 128 chunks (if there are
             // that many), but exclude the size of the first one, since
             // it may be an outlier.
-            size_t numSamplesToAverage = track->mSamples.size();
+            size_t numSamplesToAverage = track->mSampleOffsets.size();
             if (numSamplesToAverage > 256) {
                 numSamplesToAverage = 256;
             }
@@ -907,7 +915,7 @@ status_t AVIExtractor::parseIndex(off64_t offset, size_t size) {
 
         int64_t durationUs;
         CHECK_EQ((status_t)OK,
-                 getSampleTime(i, track->mSamples.size() - 1, &durationUs));
+                 getSampleTime(i, track->mSampleOffsets.size() - 1, &durationUs));
 
         ALOGV("track %d duration = %.2f secs", i, durationUs / 1E6);
 
@@ -1111,16 +1119,16 @@ status_t AVIExtractor::getSampleInfo(
 
     const Track &track = mTracks.itemAt(trackIndex);
 
-    if (sampleIndex >= track.mSamples.size()) {
+    if (sampleIndex >= track.mSampleOffsets.size()) {
         return -ERANGE;
     }
 
-    const SampleInfo &info = track.mSamples.itemAt(sampleIndex);
+    uint32_t sampleOffset = track.mSampleOffsets.itemAt(sampleIndex);
 
     if (!mOffsetsAreAbsolute) {
-        *offset = info.mOffset + mMovieOffset + 8;
+        *offset = sampleOffset + mMovieOffset + 8;
     } else {
-        *offset = info.mOffset;
+        *offset = sampleOffset;
     }
 
     *size = 0;
@@ -1141,7 +1149,7 @@ status_t AVIExtractor::getSampleInfo(
     *offset += 8;
     *size = U32LE_AT(&tmp[4]);
 
-    *isKey = info.mIsKey;
+    *isKey = IsSyncSample(track, sampleIndex);
 
     if (track.mBytesPerSample > 0) {
         size_t sampleStartInBytes;
@@ -1169,6 +1177,27 @@ status_t AVIExtractor::getSampleTime(
             trackIndex, sampleIndex, &offset, &size, &isKey, sampleTimeUs);
 }
 
+// static
+bool AVIExtractor::IsSyncSample(const Track &track, size_t sampleIndex) {
+    if (track.mNumSyncSamples == track.mSampleOffsets.size()) {
+        return true;
+    }
+
+    size_t lo = 0;
+    size_t hi = track.mSyncSamples.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (track.mSyncSamples.itemAt(mid) < sampleIndex) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo < track.mSyncSamples.size()
+        && track.mSyncSamples.itemAt(lo) == sampleIndex;
+}
+
 status_t AVIExtractor::getSampleIndexAtTime(
         size_t trackIndex,
         int64_t timeUs, MediaSource::ReadOptions::SeekMode mode,
@@ -1198,7 +1227,7 @@ status_t AVIExtractor::getSampleIndexAtTime(
         closestSampleIndex = timeUs / track.mRate * track.mScale / 1000000ll;
     }
 
-    ssize_t numSamples = track.mSamples.size();
+    ssize_t numSamples = track.mSampleOffsets.size();
 
     if (closestSampleIndex < 0) {
         closestSampleIndex = 0;
@@ -1213,27 +1242,28 @@ status_t AVIExtractor::getSampleIndexAtTime(
     }
 
     ssize_t prevSyncSampleIndex = closestSampleIndex;
-    while (prevSyncSampleIndex >= 0) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(prevSyncSampleIndex);
+    ssize_t nextSyncSampleIndex = closestSampleIndex;
 
-        if (info.mIsKey) {
-            break;
+    if (track.mNumSyncSamples != (size_t)numSamples) {
+        // first key chunk at or after the closest one
+        size_t lo = 0;
+        size_t hi = track.mSyncSamples.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (track.mSyncSamples.itemAt(mid) < (size_t)closestSampleIndex) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
         }
 
-        --prevSyncSampleIndex;
-    }
-
-    ssize_t nextSyncSampleIndex = closestSampleIndex;
-    while (nextSyncSampleIndex < numSamples) {
-        const SampleInfo &info =
-            track.mSamples.itemAt(nextSyncSampleIndex);
+        nextSyncSampleIndex = lo < track.mSyncSamples.size()
+            ? (ssize_t)track.mSyncSamples.itemAt(lo) : numSamples;
 
-        if (info.mIsKey) {
-            break;
+        if (nextSyncSampleIndex != closestSampleIndex) {
+            prevSyncSampleIndex =
+                lo > 0 ? (ssize_t)track.mSyncSamples.itemAt(lo - 1) : -1;
         }
-
-        ++nextSyncSampleIndex;
     }
 
     switch (mode) {
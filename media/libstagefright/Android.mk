@@ -8,6 +8,7 @@ LOCAL_SRC_FILES:=                         \
         AACWriter.cpp                     \
         AMRExtractor.cpp                  \
         AMRWriter.cpp                     \
+        AsyncFileWriter.cpp               \
         AudioPlayer.cpp                   \
         AudioSource.cpp                   \
         CallbackDataSource.cpp            \
@@ -23,6 +24,8 @@ LOCAL_SRC_FILES:=                         \
         FLACExtractor.cpp                 \
         FrameRenderTracker.cpp            \
         HTTPBase.cpp                      \
+        HTTPDiskCache.cpp                 \
+        HTTPRangeFetcher.cpp              \
         HevcUtils.cpp                     \
         JPEGSource.cpp                    \
         MP3Extractor.cpp                  \
@@ -34,11 +37,13 @@ LOCAL_SRC_FILES:=                         \
         MediaCodec.cpp                    \
         MediaCodecList.cpp                \
         MediaCodecListOverrides.cpp       \
+        MediaCodecPool.cpp                \
         MediaCodecSource.cpp              \
         MediaDefs.cpp                     \
         MediaExtractor.cpp                \
         MediaSync.cpp                     \
         MidiExtractor.cpp                 \
+        http/HTTPConnectionPool.cpp       \
         http/MediaHTTP.cpp                \
         MediaMuxer.cpp                    \
         MediaSource.cpp                   \
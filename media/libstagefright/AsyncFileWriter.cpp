@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AsyncFileWriter"
+#include <utils/Log.h>
+
+#include "include/AsyncFileWriter.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaErrors.h>
+
+#include <cutils/properties.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+namespace android {
+
+AsyncFileWriter::AsyncFileWriter(
+        int fd, off64_t offset, size_t bufferSize, size_t numBuffers)
+    : mFd(fd),
+      mBufferSize((bufferSize + kAlignment - 1) / kAlignment * kAlignment),
+      mInitCheck(NO_INIT),
+      mCurrent(NULL),
+      mLimit(0),
+      mOffset(offset),
+      mWriting(false),
+      mDone(false),
+      mStatus(OK),
+      mSyncIntervalBytes(0),
+      mBytesSinceSync(0),
+      mThreadStarted(false) {
+    memset(&mStats, 0, sizeof(mStats));
+
+    if (mBufferSize == 0 || numBuffers == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < numBuffers; ++i) {
+        void *data;
+        if (posix_memalign(&data, kAlignment, mBufferSize) != 0) {
+            ALOGE("cannot allocate %zu bytes for a write buffer", mBufferSize);
+            mInitCheck = NO_MEMORY;
+            return;
+        }
+        Buffer *buffer = new Buffer;
+        buffer->mData = (uint8_t *)data;
+        buffer->mSize = 0;
+        mBuffers.push(buffer);
+        mFree.push_back(buffer);
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    mThreadStarted = pthread_create(&mThread, &attr, ThreadWrapper, this) == 0;
+    pthread_attr_destroy(&attr);
+
+    mInitCheck = mThreadStarted ? OK : UNKNOWN_ERROR;
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    if (mThreadStarted) {
+        flush();
+
+        {
+            Mutex::Autolock autoLock(mLock);
+            mDone = true;
+            mCondition.broadcast();
+        }
+
+        void *dummy;
+        pthread_join(mThread, &dummy);
+        mThreadStarted = false;
+    }
+
+    for (size_t i = 0; i < mBuffers.size(); ++i) {
+        free(mBuffers[i]->mData);
+        delete mBuffers[i];
+    }
+    mBuffers.clear();
+}
+
+// static
+AsyncFileWriter *AsyncFileWriter::CreateFromProperties(
+        int fd, const char *prefix, int32_t defaultBufferSizeKB,
+        int32_t defaultNumBuffers) {
+    AString key = prefix;
+    key.append(".io-buffers");
+    int32_t numBuffers = property_get_int32(key.c_str(), defaultNumBuffers);
+
+    key = prefix;
+    key.append(".io-buffer-kb");
+    int32_t bufferSizeKB = property_get_int32(key.c_str(), defaultBufferSizeKB);
+
+    key = prefix;
+    key.append(".sync-kb");
+    int32_t syncIntervalKB = property_get_int32(key.c_str(), 0);
+
+    if (numBuffers <= 0 || bufferSizeKB <= 0 || bufferSizeKB > 65536) {
+        return NULL;
+    }
+
+    off64_t offset = lseek64(fd, 0, SEEK_CUR);
+    if (offset < 0) {
+        return NULL;
+    }
+
+    AsyncFileWriter *writer = new AsyncFileWriter(
+            fd, offset, (size_t)bufferSizeKB * 1024, numBuffers);
+    if (writer->initCheck() != OK) {
+        ALOGW("writing to the file directly");
+        delete writer;
+        return NULL;
+    }
+    if (syncIntervalKB > 0) {
+        writer->setSyncInterval((size_t)syncIntervalKB * 1024);
+    }
+    return writer;
+}
+
+// static
+status_t AsyncFileWriter::Release(AsyncFileWriter *writer) {
+    if (writer == NULL) {
+        return OK;
+    }
+
+    bool sync;
+    {
+        Mutex::Autolock autoLock(writer->mLock);
+        sync = writer->mSyncIntervalBytes > 0;
+    }
+    status_t err = sync ? writer->sync() : writer->flush();
+
+    Stats stats;
+    writer->getStats(&stats);
+    ALOGI("wrote %" PRId64 " bytes in %d writes, write time avg %" PRId64
+            " us max %" PRId64 " us, stalled %d times for %" PRId64 " us,"
+            " %d syncs max %" PRId64 " us",
+            stats.mBytesWritten, stats.mNumWrites,
+            stats.mNumWrites > 0 ? stats.mTotalWriteTimeUs / stats.mNumWrites : 0,
+            stats.mMaxWriteTimeUs, stats.mNumStalls, stats.mTotalStallTimeUs,
+            stats.mNumSyncs, stats.mMaxSyncTimeUs);
+
+    delete writer;
+    return err;
+}
+
+void AsyncFileWriter::write(const void *data, size_t size) {
+    CHECK_EQ(mInitCheck, (status_t)OK);
+
+    const uint8_t *ptr = (const uint8_t *)data;
+    while (size > 0) {
+        if (mCurrent == NULL) {
+            Mutex::Autolock autoLock(mLock);
+            if (mFree.empty()) {
+                int64_t startUs = ALooper::GetNowUs();
+                do {
+                    mCondition.wait(mLock);
+                } while (mFree.empty());
+                ++mStats.mNumStalls;
+                mStats.mTotalStallTimeUs += ALooper::GetNowUs() - startUs;
+            }
+            mCurrent = *mFree.begin();
+            mFree.erase(mFree.begin());
+            mCurrent->mSize = 0;
+
+            // end the buffer on an aligned offset of the file
+            mLimit = mBufferSize - mOffset % kAlignment;
+        }
+
+        size_t n = mLimit - mCurrent->mSize;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(mCurrent->mData + mCurrent->mSize, ptr, n);
+        mCurrent->mSize += n;
+        mOffset += n;
+        ptr += n;
+        size -= n;
+
+        if (mCurrent->mSize == mLimit) {
+            queueCurrent();
+        }
+    }
+}
+
+void AsyncFileWriter::queueCurrent() {
+    Mutex::Autolock autoLock(mLock);
+    if (mCurrent->mSize > 0) {
+        mQueued.push_back(mCurrent);
+    } else {
+        mFree.push_back(mCurrent);
+    }
+    mCurrent = NULL;
+    mCondition.broadcast();
+}
+
+void AsyncFileWriter::submit() {
+    if (mCurrent != NULL) {
+        queueCurrent();
+    }
+}
+
+status_t AsyncFileWriter::flush() {
+    if (mInitCheck != OK) {
+        return mInitCheck;
+    }
+
+    submit();
+
+    Mutex::Autolock autoLock(mLock);
+    while (!mQueued.empty() || mWriting) {
+        mCondition.wait(mLock);
+    }
+    return mStatus;
+}
+
+off64_t AsyncFileWriter::seek(off64_t offset) {
+    flush();
+
+    off64_t result = lseek64(mFd, offset, SEEK_SET);
+    if (result >= 0) {
+        mOffset = result;
+    }
+    return result;
+}
+
+void AsyncFileWriter::setSyncInterval(size_t intervalBytes) {
+    Mutex::Autolock autoLock(mLock);
+    mSyncIntervalBytes = intervalBytes;
+}
+
+status_t AsyncFileWriter::sync() {
+    status_t err = flush();
+    if (err != OK) {
+        return err;
+    }
+    return syncFile();
+}
+
+status_t AsyncFileWriter::getStatus() {
+    Mutex::Autolock autoLock(mLock);
+    return mStatus;
+}
+
+void AsyncFileWriter::getStats(Stats *stats) {
+    Mutex::Autolock autoLock(mLock);
+    *stats = mStats;
+}
+
+// static
+void *AsyncFileWriter::ThreadWrapper(void *me) {
+    static_cast<AsyncFileWriter *>(me)->threadFunc();
+    return NULL;
+}
+
+void AsyncFileWriter::threadFunc() {
+    prctl(PR_SET_NAME, (unsigned long)"AsyncFileWriter", 0, 0, 0);
+
+    Mutex::Autolock autoLock(mLock);
+    for (;;) {
+        while (!mDone && mQueued.empty()) {
+            mCondition.wait(mLock);
+        }
+        if (mQueued.empty()) {
+            break;
+        }
+
+        Buffer *buffer = *mQueued.begin();
+        mQueued.erase(mQueued.begin());
+        mWriting = true;
+
+        mLock.unlock();
+        writeBuffer(buffer);
+        mLock.lock();
+
+        mWriting = false;
+        mFree.push_back(buffer);
+        mCondition.broadcast();
+    }
+}
+
+// Called without the lock held, except for the stats.
+void AsyncFileWriter::writeBuffer(const Buffer *buffer) {
+    int64_t startUs = ALooper::GetNowUs();
+
+    status_t err = OK;
+    size_t written = 0;
+    while (written < buffer->mSize) {
+        ssize_t n = ::write(mFd, buffer->mData + written, buffer->mSize - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            err = n < 0 ? -errno : ERROR_IO;
+            break;
+        }
+        written += n;
+    }
+
+    int64_t durationUs = ALooper::GetNowUs() - startUs;
+    ALOGV("wrote %zu bytes in %lld us", written, (long long)durationUs);
+
+    bool needSync;
+    {
+        Mutex::Autolock autoLock(mLock);
+        mStats.mBytesWritten += written;
+        ++mStats.mNumWrites;
+        mStats.mTotalWriteTimeUs += durationUs;
+        if (durationUs > mStats.mMaxWriteTimeUs) {
+            mStats.mMaxWriteTimeUs = durationUs;
+        }
+        if (err != OK && mStatus == OK) {
+            ALOGE("write of %zu bytes failed (%s)", buffer->mSize, strerror(-err));
+            mStatus = err;
+        }
+
+        mBytesSinceSync += written;
+        needSync = mSyncIntervalBytes > 0 && mBytesSinceSync >= mSyncIntervalBytes;
+    }
+
+    if (needSync) {
+        syncFile();
+    }
+}
+
+// Called without the lock held.
+status_t AsyncFileWriter::syncFile() {
+    int64_t startUs = ALooper::GetNowUs();
+    status_t err = fsync(mFd) == 0 ? OK : -errno;
+    int64_t durationUs = ALooper::GetNowUs() - startUs;
+
+    Mutex::Autolock autoLock(mLock);
+    mBytesSinceSync = 0;
+    ++mStats.mNumSyncs;
+    mStats.mTotalSyncTimeUs += durationUs;
+    if (durationUs > mStats.mMaxSyncTimeUs) {
+        mStats.mMaxSyncTimeUs = durationUs;
+    }
+    if (err != OK && mStatus == OK) {
+        ALOGE("fsync failed (%s)", strerror(-err));
+        mStatus = err;
+    }
+    return err;
+}
+
+}  // namespace android
@@ -114,16 +114,39 @@ sp<DecryptHandle> CallbackDataSource::DrmInitialization(const char *mime) {
 }
 
 TinyCacheSource::TinyCacheSource(const sp<DataSource>& source)
-    : mSource(source), mCachedOffset(0), mCachedSize(0) {
+    : mSource(source),
+      mCache(new uint8_t[kMinCacheSize]),
+      mCacheSize(kMinCacheSize),
+      mCachedOffset(0),
+      mCachedSize(0) {
     mName = String8::format("TinyCacheSource(%s)", mSource->toString().string());
 }
 
+TinyCacheSource::~TinyCacheSource() {
+    delete[] mCache;
+    mCache = NULL;
+}
+
+void TinyCacheSource::resizeCache(size_t size) {
+    if (size == mCacheSize) {
+        return;
+    }
+    ALOGV("cache size %zu => %zu", mCacheSize, size);
+
+    // only called before refilling the cache, the content isn't kept
+    delete[] mCache;
+    mCache = new uint8_t[size];
+    mCacheSize = size;
+    mCachedOffset = 0;
+    mCachedSize = 0;
+}
+
 status_t TinyCacheSource::initCheck() const {
     return mSource->initCheck();
 }
 
 ssize_t TinyCacheSource::readAt(off64_t offset, void* data, size_t size) {
-    if (size >= kCacheSize) {
+    if (size >= mCacheSize) {
         return mSource->readAt(offset, data, size);
     }
 
@@ -151,15 +174,29 @@ ssize_t TinyCacheSource::readAt(off64_t offset, void* data, size_t size) {
     }
 
 
+    // A miss just ahead of the cached data is a sequential read, read further
+    // ahead from now on; anything else is a seek.
+    if (mCachedSize > 0 && offset >= mCachedOffset
+            && offset - mCachedOffset < (off64_t)(mCachedSize + mCacheSize)) {
+        if (mCacheSize < kMaxCacheSize) {
+            resizeCache(std::min(mCacheSize * 2, (size_t)kMaxCacheSize));
+        }
+    } else if (mCacheSize > kMinCacheSize) {
+        resizeCache(kMinCacheSize);
+        if (size >= mCacheSize) {
+            return mSource->readAt(offset, data, size);
+        }
+    }
+
     // Fill the cache and copy to the caller.
-    const ssize_t numRead = mSource->readAt(offset, mCache, kCacheSize);
+    const ssize_t numRead = mSource->readAt(offset, mCache, mCacheSize);
     if (numRead <= 0) {
         // Flush cache on error
         mCachedSize = 0;
         mCachedOffset = 0;
         return numRead;
     }
-    if ((size_t)numRead > kCacheSize) {
+    if ((size_t)numRead > mCacheSize) {
         // Flush cache on error
         mCachedSize = 0;
         mCachedOffset = 0;
@@ -168,7 +205,7 @@ ssize_t TinyCacheSource::readAt(off64_t offset, void* data, size_t size) {
 
     mCachedSize = numRead;
     mCachedOffset = offset;
-    CHECK(mCachedSize <= kCacheSize && mCachedOffset >= 0);
+    CHECK(mCachedSize <= mCacheSize && mCachedOffset >= 0);
     const size_t numToReturn = std::min(size, (size_t)numRead);
     memcpy(data, mCache, numToReturn);
 
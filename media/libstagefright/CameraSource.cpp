@@ -199,6 +199,8 @@ CameraSource::CameraSource(
       mFirstFrameTimeUs(0),
       mNumFramesDropped(0),
       mNumGlitches(0),
+      mNumMemoryBaseWaits(0),
+      mMaxMemoryBaseWaitUs(0),
       mGlitchDurationThresholdUs(200000),
       mCollectStats(false) {
     mVideoSize.width  = -1;
@@ -890,6 +892,11 @@ status_t CameraSource::reset() {
             ALOGW("%d long delays between neighboring video frames", mNumGlitches);
         }
 
+        if (mNumMemoryBaseWaits > 0) {
+            ALOGW("%d frames waited for the encoder to return a buffer, longest %" PRId64 " us",
+                    mNumMemoryBaseWaits, mMaxMemoryBaseWaitUs);
+        }
+
         CHECK_EQ(mNumFramesReceived, mNumFramesEncoded + mNumFramesDropped);
     }
 
@@ -967,13 +974,36 @@ void CameraSource::releaseRecordingFrame(const sp<IMemory>& frame) {
 }
 
 void CameraSource::releaseQueuedFrames() {
+    // Native handles go back to the camera in one call rather than one
+    // binder transaction per queued frame.
+    std::vector<native_handle_t*> handles;
     List<sp<IMemory> >::iterator it;
     while (!mFramesReceived.empty()) {
         it = mFramesReceived.begin();
-        releaseRecordingFrame(*it);
+        const sp<IMemory>& frame = *it;
+        native_handle_t* handle = nullptr;
+        if (mVideoBufferMode != hardware::ICamera::VIDEO_BUFFER_MODE_BUFFER_QUEUE
+                && frame->size() == sizeof(VideoNativeHandleMetadata)) {
+            VideoNativeHandleMetadata *metadata =
+                (VideoNativeHandleMetadata*)(frame->pointer());
+            if (metadata->eType == kMetadataBufferTypeNativeHandleSource) {
+                handle = metadata->pHandle;
+            }
+        }
+        if (handle != nullptr) {
+            handles.push_back(handle);
+            mMemoryBases.push_back(frame);
+        } else {
+            releaseRecordingFrame(frame);
+        }
         mFramesReceived.erase(it);
         ++mNumFramesDropped;
     }
+
+    if (!handles.empty()) {
+        releaseRecordingFrameHandleBatch(handles);
+        mMemoryBaseAvailableCond.signal();
+    }
 }
 
 sp<MetaData> CameraSource::getFormat() {
@@ -1123,6 +1153,44 @@ void CameraSource::releaseRecordingFrameHandle(native_handle_t* handle) {
     }
 }
 
+void CameraSource::releaseRecordingFrameHandleBatch(
+        const std::vector<native_handle_t*>& handles) {
+    if (mCameraRecordingProxy != nullptr) {
+        mCameraRecordingProxy->releaseRecordingFrameHandleBatch(handles);
+    } else if (mCamera != nullptr) {
+        int64_t token = IPCThreadState::self()->clearCallingIdentity();
+        mCamera->releaseRecordingFrameHandleBatch(handles);
+        IPCThreadState::self()->restoreCallingIdentity(token);
+    } else {
+        for (size_t i = 0; i < handles.size(); i++) {
+            native_handle_close(handles[i]);
+            native_handle_delete(handles[i]);
+        }
+    }
+}
+
+bool CameraSource::waitForMemoryBaseLocked() {
+    if (!mMemoryBases.empty()) {
+        return true;
+    }
+
+    // The encoder is holding on to every buffer; count how often and for how
+    // long that stalls the camera.
+    nsecs_t startNs = systemTime();
+    while (mMemoryBases.empty()) {
+        if (mMemoryBaseAvailableCond.waitRelative(mLock, kMemoryBaseAvailableTimeoutNs) ==
+                TIMED_OUT) {
+            break;
+        }
+    }
+    int64_t waitUs = (systemTime() - startNs) / 1000;
+    ++mNumMemoryBaseWaits;
+    if (waitUs > mMaxMemoryBaseWaitUs) {
+        mMaxMemoryBaseWaitUs = waitUs;
+    }
+    return !mMemoryBases.empty();
+}
+
 void CameraSource::recordingFrameHandleCallbackTimestamp(int64_t timestampUs,
                 native_handle_t* handle) {
     ALOGV("%s: timestamp %lld us", __FUNCTION__, (long long)timestampUs);
@@ -1134,13 +1202,10 @@ void CameraSource::recordingFrameHandleCallbackTimestamp(int64_t timestampUs,
         return;
     }
 
-    while (mMemoryBases.empty()) {
-        if (mMemoryBaseAvailableCond.waitRelative(mLock, kMemoryBaseAvailableTimeoutNs) ==
-                TIMED_OUT) {
-            ALOGW("Waiting on an available memory base timed out. Dropping a recording frame.");
-            releaseRecordingFrameHandle(handle);
-            return;
-        }
+    if (!waitForMemoryBaseLocked()) {
+        ALOGW("Waiting on an available memory base timed out. Dropping a recording frame.");
+        releaseRecordingFrameHandle(handle);
+        return;
     }
 
     ++mNumFramesReceived;
@@ -1210,13 +1275,10 @@ void CameraSource::processBufferQueueFrame(BufferItem& buffer) {
         return;
     }
 
-    while (mMemoryBases.empty()) {
-        if (mMemoryBaseAvailableCond.waitRelative(mLock, kMemoryBaseAvailableTimeoutNs) ==
-                TIMED_OUT) {
-            ALOGW("Waiting on an available memory base timed out. Dropping a recording frame.");
-            mVideoBufferConsumer->releaseBuffer(buffer);
-            return;
-        }
+    if (!waitForMemoryBaseLocked()) {
+        ALOGW("Waiting on an available memory base timed out. Dropping a recording frame.");
+        mVideoBufferConsumer->releaseBuffer(buffer);
+        return;
     }
 
     ++mNumFramesReceived;
@@ -23,6 +23,7 @@
 #include "include/DRMExtractor.h"
 #include "include/FLACExtractor.h"
 #include "include/HTTPBase.h"
+#include "include/HTTPRangeFetcher.h"
 #include "include/MidiExtractor.h"
 #include "include/MP3Extractor.h"
 #include "include/MPEG2PSExtractor.h"
@@ -112,6 +113,110 @@ status_t DataSource::getSize(off64_t *size) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Serves the first bytes of a source from memory while it is sniffed, so that
+// the sniffers, which mostly look at the same header, read it only once.
+struct SniffSource : public DataSource {
+    enum {
+        kHeaderSize = 16384,
+    };
+
+    SniffSource(const sp<DataSource> &source)
+        : mSource(source),
+          mHeaderSize(0) {
+        ssize_t n = mSource->readAt(0, mHeader, sizeof(mHeader));
+        if (n > 0) {
+            mHeaderSize = n;
+        }
+    }
+
+    const uint8_t *header() const { return mHeader; }
+    size_t headerSize() const { return mHeaderSize; }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        if (offset >= 0 && size <= mHeaderSize
+                && (uint64_t)offset <= mHeaderSize - size) {
+            memcpy(data, &mHeader[offset], size);
+            return size;
+        }
+
+        return mSource->readAt(offset, data, size);
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+    virtual uint32_t flags() {
+        return mSource->flags();
+    }
+
+    virtual String8 toString() {
+        return mSource->toString();
+    }
+
+    virtual FileMap *mapRange(off64_t offset, size_t size) {
+        return mSource->mapRange(offset, size);
+    }
+
+    virtual String8 getUri() {
+        return mSource->getUri();
+    }
+
+    virtual String8 getMIMEType() const {
+        return mSource->getMIMEType();
+    }
+
+private:
+    sp<DataSource> mSource;
+    uint8_t mHeader[kHeaderSize];
+    size_t mHeaderSize;
+
+    DISALLOW_EVIL_CONSTRUCTORS(SniffSource);
+};
+
+// Returns the sniffer of the container whose signature starts the data, if
+// that signature is unambiguous.
+static DataSource::SnifferFunc FindSnifferForSignature(
+        const uint8_t *header, size_t size) {
+    if (size >= 8 && !memcmp(&header[4], "ftyp", 4)) {
+        return SniffMPEG4;
+    }
+    if (size >= 4 && !memcmp(header, "\x1a\x45\xdf\xa3", 4)) {
+        return SniffMatroska;
+    }
+    if (size >= 4 && !memcmp(header, "OggS", 4)) {
+        return SniffOgg;
+    }
+    if (size >= 12 && !memcmp(header, "RIFF", 4) && !memcmp(&header[8], "WAVE", 4)) {
+        return SniffWAV;
+    }
+    if (size >= 4 && !memcmp(header, "fLaC", 4)) {
+        return SniffFLAC;
+    }
+    if (size >= 5 && !memcmp(header, "#!AMR", 5)) {
+        return SniffAMR;
+    }
+    if (size >= 4 && !memcmp(header, "MThd", 4)) {
+        return SniffMidi;
+    }
+
+    return NULL;
+}
+
+// The sniffers which search the data for frames rather than check a
+// signature. None of them reports more confidence than the sniffers of
+// FindSnifferForSignature() when those succeed on their own signature.
+static bool IsScanningSniffer(DataSource::SnifferFunc func) {
+    return func == SniffMPEG2TS
+            || func == SniffMP3
+            || func == SniffAAC
+            || func == SniffMPEG2PS;
+}
+
 Mutex DataSource::gSnifferMutex;
 List<DataSource::SnifferFunc> DataSource::gSniffers;
 bool DataSource::gSniffersRegistered = false;
@@ -129,12 +234,54 @@ bool DataSource::sniff(
         }
     }
 
+    sp<SniffSource> sniffSource = new SniffSource(this);
+
+    // If the data starts with a known signature, try its sniffer first, and
+    // skip the scanning sniffers if it succeeds.
+    SnifferFunc first = FindSnifferForSignature(
+            sniffSource->header(), sniffSource->headerSize());
+    bool skipScanningSniffers = false;
+
+    if (first != NULL) {
+        bool registered = false;
+        for (List<SnifferFunc>::iterator it = gSniffers.begin();
+             it != gSniffers.end(); ++it) {
+            if (*it == first) {
+                registered = true;
+                break;
+            }
+        }
+
+        String8 newMimeType;
+        float newConfidence;
+        sp<AMessage> newMeta;
+        if (registered
+                && first(sniffSource, &newMimeType, &newConfidence, &newMeta)) {
+            *mimeType = newMimeType;
+            *confidence = newConfidence;
+            *meta = newMeta;
+            skipScanningSniffers = true;
+        } else {
+            first = NULL;
+        }
+    }
+
     for (List<SnifferFunc>::iterator it = gSniffers.begin();
          it != gSniffers.end(); ++it) {
+        if (*it == first || (skipScanningSniffers && IsScanningSniffer(*it))) {
+            continue;
+        }
+
+        // WVM and DRM sniffers initialize the source itself.
+        sp<DataSource> source = sniffSource;
+        if (*it == SniffWVM || *it == SniffDRM) {
+            source = this;
+        }
+
         String8 newMimeType;
         float newConfidence;
         sp<AMessage> newMeta;
-        if ((*it)(this, &newMimeType, &newConfidence, &newMeta)) {
+        if ((*it)(source, &newMimeType, &newConfidence, &newMeta)) {
             if (newConfidence > *confidence) {
                 *mimeType = newMimeType;
                 *confidence = newConfidence;
@@ -214,12 +361,11 @@ sp<DataSource> DataSource::CreateFromURI(
         }
 
         if (httpSource == NULL) {
-            sp<IMediaHTTPConnection> conn = httpService->makeHTTPConnection();
-            if (conn == NULL) {
+            httpSource = new MediaHTTP(httpService);
+            if (httpSource->initCheck() != OK) {
                 ALOGE("Failed to make http connection from http service!");
                 return NULL;
             }
-            httpSource = new MediaHTTP(conn);
         }
 
         String8 tmp;
@@ -231,7 +377,7 @@ sp<DataSource> DataSource::CreateFromURI(
         }
 
         String8 cacheConfig;
-        bool disconnectAtHighwatermark;
+        bool disconnectAtHighwatermark = false;
         KeyedVector<String8, String8> nonCacheSpecificHeaders;
         if (headers != NULL) {
             nonCacheSpecificHeaders = *headers;
@@ -251,10 +397,22 @@ sp<DataSource> DataSource::CreateFromURI(
                 *contentType = httpSource->getMIMEType();
             }
 
+            // httpSource is not referenced by anyone yet if made above
+            sp<HTTPBase> connectedSource = httpSource;
+
+            // disconnecting at the high water mark leaves nothing to fetch
+            // in parallel
+            sp<HTTPRangeFetcher> rangeFetcher;
+            if (!disconnectAtHighwatermark) {
+                rangeFetcher = HTTPRangeFetcher::Create(
+                        httpService, uri, &nonCacheSpecificHeaders, connectedSource);
+            }
+
             source = NuCachedSource2::Create(
                     httpSource,
                     cacheConfig.isEmpty() ? NULL : cacheConfig.string(),
-                    disconnectAtHighwatermark);
+                    disconnectAtHighwatermark,
+                    rangeFetcher);
         } else {
             // We do not want that prefetching, caching, datasource wrapper
             // in the widevine:// case.
@@ -279,12 +437,11 @@ sp<DataSource> DataSource::CreateMediaHTTP(const sp<IMediaHTTPService> &httpServ
         return NULL;
     }
 
-    sp<IMediaHTTPConnection> conn = httpService->makeHTTPConnection();
-    if (conn == NULL) {
+    sp<MediaHTTP> source = new MediaHTTP(httpService);
+    if (source->initCheck() != OK) {
         return NULL;
-    } else {
-        return new MediaHTTP(conn);
     }
+    return source;
 }
 
 sp<DataSource> DataSource::CreateFromIDataSource(const sp<IDataSource> &source) {
@@ -31,6 +31,7 @@
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -121,6 +122,7 @@ private:
 
     // media buffers
     size_t mMaxBufferSize;
+    unsigned mMaxBufferSamples;
     MediaBufferGroup *mGroup;
     void (*mCopy)(short *dst, const int *const *src, unsigned nSamples, unsigned nChannels);
 
@@ -131,6 +133,17 @@ private:
     off64_t mCurrentPos;
     bool mEOF;
 
+    // Known frame positions, sorted by sample number: the SEEKTABLE points,
+    // and one frame per second of the stream decoded so far.  A seek starts
+    // decoding from the closest one, unless it is too far away and libFLAC
+    // has to search for the target.
+    struct SeekPoint {
+        FLAC__uint64 mSample;
+        off64_t mOffset;
+    };
+    Vector<SeekPoint> mSeekPoints;
+    bool mFrameError;
+
     // cached when the STREAMINFO metadata is parsed by libFLAC
     FLAC__StreamMetadata_StreamInfo mStreamInfo;
     bool mStreamInfoValid;
@@ -146,6 +159,10 @@ private:
 
     status_t init();
     MediaBuffer *readBuffer(bool doSeek, FLAC__uint64 sample);
+    void addSeekPoint(FLAC__uint64 sample, off64_t offset);
+    bool checkWriteHeader();
+    status_t decodeFrame();
+    status_t seekTo(FLAC__uint64 sample, unsigned *skip);
 
     // no copy constructor or assignment
     FLACParser(const FLACParser &);
@@ -199,6 +216,11 @@ private:
             FLAC__StreamDecoderErrorStatus status,
             void *client_data);
 
+    // minimum number of samples per media buffer, reached by batching frames
+    static const unsigned kMinBufferSamples = 4096;
+    // seeks further than this from a known frame are searched by libFLAC
+    static const unsigned kMaxSeekDecodeSeconds = 10;
+
 };
 
 // The FLAC parser calls our C++ static callbacks using C calling conventions,
@@ -357,6 +379,29 @@ void FLACParser::metadataCallback(const FLAC__StreamMetadata *metadata)
         }
         }
         break;
+    case FLAC__METADATA_TYPE_SEEKTABLE:
+        {
+        // offsets are relative to the first frame, rebased by init()
+        const FLAC__StreamMetadata_SeekTable *st = &metadata->data.seek_table;
+        for (unsigned i = 0; i < st->num_points; ++i) {
+            const FLAC__StreamMetadata_SeekPoint &point = st->points[i];
+            if (point.sample_number == FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER
+                    || point.stream_offset > INT64_MAX) {
+                continue;
+            }
+            if (!mSeekPoints.isEmpty()
+                    && point.sample_number <= mSeekPoints.top().mSample) {
+                ALOGW("FLACParser::metadataCallback unsorted SEEKTABLE");
+                mSeekPoints.clear();
+                break;
+            }
+            SeekPoint seekPoint;
+            seekPoint.mSample = point.sample_number;
+            seekPoint.mOffset = point.stream_offset;
+            mSeekPoints.push(seekPoint);
+        }
+        }
+        break;
     case FLAC__METADATA_TYPE_PICTURE:
         if (mFileMetadata != 0) {
             const FLAC__StreamMetadata_Picture *p = &metadata->data.picture;
@@ -378,7 +423,8 @@ void FLACParser::errorCallback(FLAC__StreamDecoderErrorStatus status)
 }
 
 // Copy samples from FLAC native 32-bit non-interleaved to 16-bit interleaved.
-// These are candidates for optimization if needed.
+// The mono and stereo loops use restrict pointers and no loop carried
+// pointer increment, so that the compiler vectorizes them.
 
 static void copyMono8(
         short *dst,
@@ -415,8 +461,10 @@ static void copyMono16(
         const int *const *src,
         unsigned nSamples,
         unsigned /* nChannels */) {
+    const int *__restrict src0 = src[0];
+    short *__restrict out = dst;
     for (unsigned i = 0; i < nSamples; ++i) {
-        *dst++ = src[0][i];
+        out[i] = src0[i];
     }
 }
 
@@ -425,9 +473,12 @@ static void copyStereo16(
         const int *const *src,
         unsigned nSamples,
         unsigned /* nChannels */) {
+    const int *__restrict src0 = src[0];
+    const int *__restrict src1 = src[1];
+    short *__restrict out = dst;
     for (unsigned i = 0; i < nSamples; ++i) {
-        *dst++ = src[0][i];
-        *dst++ = src[1][i];
+        out[2 * i] = src0[i];
+        out[2 * i + 1] = src1[i];
     }
 }
 
@@ -447,8 +498,10 @@ static void copyMono24(
         const int *const *src,
         unsigned nSamples,
         unsigned /* nChannels */) {
+    const int *__restrict src0 = src[0];
+    short *__restrict out = dst;
     for (unsigned i = 0; i < nSamples; ++i) {
-        *dst++ = src[0][i] >> 8;
+        out[i] = src0[i] >> 8;
     }
 }
 
@@ -457,9 +510,12 @@ static void copyStereo24(
         const int *const *src,
         unsigned nSamples,
         unsigned /* nChannels */) {
+    const int *__restrict src0 = src[0];
+    const int *__restrict src1 = src[1];
+    short *__restrict out = dst;
     for (unsigned i = 0; i < nSamples; ++i) {
-        *dst++ = src[0][i] >> 8;
-        *dst++ = src[1][i] >> 8;
+        out[2 * i] = src0[i] >> 8;
+        out[2 * i + 1] = src1[i] >> 8;
     }
 }
 
@@ -491,11 +547,13 @@ FLACParser::FLACParser(
       mTrackMetadata(trackMetadata),
       mInitCheck(false),
       mMaxBufferSize(0),
+      mMaxBufferSamples(0),
       mGroup(NULL),
       mCopy(copyTrespass),
       mDecoder(NULL),
       mCurrentPos(0LL),
       mEOF(false),
+      mFrameError(false),
       mStreamInfoValid(false),
       mWriteRequested(false),
       mWriteCompleted(false),
@@ -532,6 +590,8 @@ status_t FLACParser::init()
     FLAC__stream_decoder_set_metadata_ignore_all(mDecoder);
     FLAC__stream_decoder_set_metadata_respond(
             mDecoder, FLAC__METADATA_TYPE_STREAMINFO);
+    FLAC__stream_decoder_set_metadata_respond(
+            mDecoder, FLAC__METADATA_TYPE_SEEKTABLE);
     FLAC__stream_decoder_set_metadata_respond(
             mDecoder, FLAC__METADATA_TYPE_PICTURE);
     FLAC__stream_decoder_set_metadata_respond(
@@ -553,6 +613,23 @@ status_t FLACParser::init()
         ALOGE("end_of_metadata failed");
         return NO_INIT;
     }
+    FLAC__uint64 firstFrameOffset;
+    if (FLAC__stream_decoder_get_decode_position(mDecoder, &firstFrameOffset)
+            && firstFrameOffset <= INT64_MAX) {
+        off64_t firstFrame = firstFrameOffset;
+        for (size_t i = 0; i < mSeekPoints.size(); ++i) {
+            SeekPoint &point = mSeekPoints.editItemAt(i);
+            if (point.mOffset > INT64_MAX - firstFrame) {
+                mSeekPoints.removeItemsAt(i, mSeekPoints.size() - i);
+                break;
+            }
+            point.mOffset += firstFrame;
+        }
+        addSeekPoint(0, firstFrame);
+    } else {
+        // without the position of the frames, leave seeks to libFLAC
+        mSeekPoints.clear();
+    }
     if (mStreamInfoValid) {
         // check channel count
         if (getChannels() == 0 || getChannels() > 8) {
@@ -634,7 +711,12 @@ void FLACParser::allocateBuffers()
 {
     CHECK(mGroup == NULL);
     mGroup = new MediaBufferGroup;
-    mMaxBufferSize = getMaxBlockSize() * getChannels() * sizeof(short);
+    // small blocks are batched, to not return a buffer every few milliseconds
+    mMaxBufferSamples = getMaxBlockSize();
+    if (mMaxBufferSamples > 0 && mMaxBufferSamples < kMinBufferSamples) {
+        mMaxBufferSamples *= kMinBufferSamples / mMaxBufferSamples;
+    }
+    mMaxBufferSize = mMaxBufferSamples * getChannels() * sizeof(short);
     mGroup->add_buffer(new MediaBuffer(mMaxBufferSize));
 }
 
@@ -645,32 +727,35 @@ void FLACParser::releaseBuffers()
     mGroup = NULL;
 }
 
-MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
+void FLACParser::addSeekPoint(FLAC__uint64 sample, off64_t offset)
 {
-    mWriteRequested = true;
-    mWriteCompleted = false;
-    if (doSeek) {
-        // We implement the seek callback, so this works without explicit flush
-        if (!FLAC__stream_decoder_seek_absolute(mDecoder, sample)) {
-            ALOGE("FLACParser::readBuffer seek to sample %lld failed", (long long)sample);
-            return NULL;
-        }
-        ALOGV("FLACParser::readBuffer seek to sample %lld succeeded", (long long)sample);
-    } else {
-        if (!FLAC__stream_decoder_process_single(mDecoder)) {
-            ALOGE("FLACParser::readBuffer process_single failed");
-            return NULL;
+    // index of the first point after sample
+    size_t lo = 0;
+    size_t hi = mSeekPoints.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mSeekPoints[mid].mSample <= sample) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
     }
-    if (!mWriteCompleted) {
-        ALOGV("FLACParser::readBuffer write did not complete");
-        return NULL;
+    if (lo > 0 && sample - mSeekPoints[lo - 1].mSample < getSampleRate()) {
+        return;
     }
-    // verify that block header keeps the promises made by STREAMINFO
+    SeekPoint point;
+    point.mSample = sample;
+    point.mOffset = offset;
+    mSeekPoints.insertAt(point, lo);
+}
+
+// verify that block header keeps the promises made by STREAMINFO
+bool FLACParser::checkWriteHeader()
+{
     unsigned blocksize = mWriteHeader.blocksize;
     if (blocksize == 0 || blocksize > getMaxBlockSize()) {
         ALOGE("FLACParser::readBuffer write invalid blocksize %u", blocksize);
-        return NULL;
+        return false;
     }
     if (mWriteHeader.sample_rate != getSampleRate() ||
         mWriteHeader.channels != getChannels() ||
@@ -678,6 +763,117 @@ MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
         ALOGE("FLACParser::readBuffer write changed parameters mid-stream: %d/%d/%d -> %d/%d/%d",
                 getSampleRate(), getChannels(), getBitsPerSample(),
                 mWriteHeader.sample_rate, mWriteHeader.channels, mWriteHeader.bits_per_sample);
+        return false;
+    }
+    CHECK(mWriteHeader.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
+    return true;
+}
+
+// Decodes the next frame into mWriteHeader and mWriteBuffer.  Returns
+// ERROR_END_OF_STREAM if no frame was decoded, and ERROR_MALFORMED if the
+// frame does not match STREAMINFO.
+status_t FLACParser::decodeFrame()
+{
+    // an empty index means that frame positions are not available
+    FLAC__uint64 offset;
+    bool haveOffset = !mSeekPoints.isEmpty()
+            && FLAC__stream_decoder_get_decode_position(mDecoder, &offset)
+            && offset <= INT64_MAX;
+    mWriteRequested = true;
+    mWriteCompleted = false;
+    if (!FLAC__stream_decoder_process_single(mDecoder)) {
+        ALOGE("FLACParser::readBuffer process_single failed");
+        return ERROR_END_OF_STREAM;
+    }
+    if (!mWriteCompleted) {
+        ALOGV("FLACParser::readBuffer write did not complete");
+        return ERROR_END_OF_STREAM;
+    }
+    if (!checkWriteHeader()) {
+        return ERROR_MALFORMED;
+    }
+    if (haveOffset) {
+        addSeekPoint(mWriteHeader.number.sample_number, offset);
+    }
+    return OK;
+}
+
+// Positions the decoder on the frame holding sample, with *skip set to the
+// number of samples of that frame before the target.
+status_t FLACParser::seekTo(FLAC__uint64 sample, unsigned *skip)
+{
+    *skip = 0;
+    // last known frame at or before the target
+    size_t lo = 0;
+    size_t hi = mSeekPoints.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mSeekPoints[mid].mSample <= sample) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo > 0 && sample - mSeekPoints[lo - 1].mSample
+            <= (FLAC__uint64) kMaxSeekDecodeSeconds * getSampleRate()) {
+        // restart the frame sync search at the known frame, and decode up to
+        // the one holding the target
+        const SeekPoint point = mSeekPoints[lo - 1];
+        if (!FLAC__stream_decoder_flush(mDecoder)) {
+            ALOGE("FLACParser::readBuffer flush failed");
+            return ERROR_END_OF_STREAM;
+        }
+        mCurrentPos = point.mOffset;
+        mEOF = false;
+        status_t err;
+        while ((err = decodeFrame()) == OK) {
+            FLAC__uint64 frameSample = mWriteHeader.number.sample_number;
+            if (frameSample < point.mSample || frameSample > sample) {
+                break;
+            }
+            if (sample - frameSample < mWriteHeader.blocksize) {
+                *skip = (unsigned) (sample - frameSample);
+                ALOGV("FLACParser::readBuffer seek to sample %lld succeeded",
+                        (long long)sample);
+                return OK;
+            }
+        }
+        if (err != OK) {
+            return err;
+        }
+        // the seek point does not match the stream, let libFLAC search
+        ALOGW("FLACParser::readBuffer ignoring seek point at sample %lld",
+                (long long)point.mSample);
+        mSeekPoints.removeAt(lo - 1);
+    }
+
+    mWriteRequested = true;
+    mWriteCompleted = false;
+    // We implement the seek callback, so this works without explicit flush
+    if (!FLAC__stream_decoder_seek_absolute(mDecoder, sample)) {
+        ALOGE("FLACParser::readBuffer seek to sample %lld failed", (long long)sample);
+        return ERROR_END_OF_STREAM;
+    }
+    if (!mWriteCompleted) {
+        ALOGV("FLACParser::readBuffer write did not complete");
+        return ERROR_END_OF_STREAM;
+    }
+    if (!checkWriteHeader()) {
+        return ERROR_MALFORMED;
+    }
+    ALOGV("FLACParser::readBuffer seek to sample %lld succeeded", (long long)sample);
+    return OK;
+}
+
+MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
+{
+    unsigned skip = 0;
+    if (doSeek) {
+        mFrameError = false;
+        if (seekTo(sample, &skip) != OK) {
+            return NULL;
+        }
+    } else if (mFrameError || decodeFrame() != OK) {
         return NULL;
     }
     // acquire a media buffer
@@ -687,15 +883,38 @@ MediaBuffer *FLACParser::readBuffer(bool doSeek, FLAC__uint64 sample)
     if (err != OK) {
         return NULL;
     }
-    size_t bufferSize = blocksize * getChannels() * sizeof(short);
-    CHECK(bufferSize <= mMaxBufferSize);
     short *data = (short *) buffer->data();
-    buffer->set_range(0, bufferSize);
-    // copy PCM from FLAC write buffer to our media buffer, with interleaving
-    (*mCopy)(data, mWriteBuffer, blocksize, getChannels());
+    FLAC__uint64 sampleNumber = mWriteHeader.number.sample_number + skip;
+    unsigned nSamples = 0;
+    for (;;) {
+        // copy PCM from FLAC write buffer to our media buffer, with interleaving
+        const FLAC__int32 *src[FLAC__MAX_CHANNELS];
+        for (unsigned c = 0; c < getChannels(); ++c) {
+            src[c] = mWriteBuffer[c] + skip;
+        }
+        unsigned blocksize = mWriteHeader.blocksize - skip;
+        CHECK(nSamples + blocksize <= mMaxBufferSamples);
+        (*mCopy)(data + nSamples * getChannels(), src, blocksize, getChannels());
+        nSamples += blocksize;
+        skip = 0;
+        if (nSamples + getMaxBlockSize() > mMaxBufferSamples) {
+            break;
+        }
+        // an invalid frame ends the stream after the samples decoded so far
+        err = decodeFrame();
+        if (err != OK) {
+            mFrameError = err == ERROR_MALFORMED;
+            break;
+        }
+        if (mWriteHeader.number.sample_number != sampleNumber + nSamples) {
+            ALOGE("FLACParser::readBuffer discontinuity at sample %lld",
+                    (long long)mWriteHeader.number.sample_number);
+            mFrameError = true;
+            break;
+        }
+    }
+    buffer->set_range(0, nSamples * getChannels() * sizeof(short));
     // fill in buffer metadata
-    CHECK(mWriteHeader.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
-    FLAC__uint64 sampleNumber = mWriteHeader.number.sample_number;
     int64_t timeUs = (1000000LL * sampleNumber) / getSampleRate();
     buffer->meta_data()->setInt64(kKeyTime, timeUs);
     buffer->meta_data()->setInt32(kKeyIsSyncFrame, 1);
@@ -18,17 +18,31 @@
 #define LOG_TAG "FileSource"
 #include <utils/Log.h>
 
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/FileSource.h>
 #include <media/stagefright/Utils.h>
+#include <utils/FileMap.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include <new>
+
 namespace android {
 
+// Number of reads in a row after which the access pattern is considered
+// sequential, or random.
+static const int32_t kSequentialReads = 4;
+static const int32_t kRandomReads = -4;
+
+// Largest file read through a mapping, with media.stagefright.mmap-file set.
+// A mapping turns a file truncated while being read into a SIGBUS, which is
+// why it is not the default.
+static const int64_t kMaxMappedFileSize = 64 * 1024 * 1024;
+
 FileSource::FileSource(const char *filename)
     : mFd(-1),
       mOffset(0),
@@ -38,7 +52,14 @@ FileSource::FileSource(const char *filename)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL){
+      mDrmBuf(NULL),
+      mUseCount(0),
+      mLastReadEnd(-1),
+      mNumSequentialReads(0),
+      mAdvice(POSIX_FADV_NORMAL),
+      mMapChecked(false),
+      mMap(NULL) {
+    initBlocks();
 
     if (filename) {
         mName = String8::format("FileSource(%s)", filename);
@@ -62,7 +83,14 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
       mDrmManagerClient(NULL),
       mDrmBufOffset(0),
       mDrmBufSize(0),
-      mDrmBuf(NULL) {
+      mDrmBuf(NULL),
+      mUseCount(0),
+      mLastReadEnd(-1),
+      mNumSequentialReads(0),
+      mAdvice(POSIX_FADV_NORMAL),
+      mMapChecked(false),
+      mMap(NULL) {
+    initBlocks();
     ALOGV("fd=%d (%s), offset=%lld, length=%lld",
             fd, nameForFd(fd).c_str(), (long long) offset, (long long) length);
 
@@ -100,6 +128,16 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
 }
 
 FileSource::~FileSource() {
+    for (size_t i = 0; i < kNumBlocks; ++i) {
+        delete[] mBlocks[i].mData;
+        mBlocks[i].mData = NULL;
+    }
+
+    if (mMap != NULL) {
+        delete mMap;
+        mMap = NULL;
+    }
+
     if (mFd >= 0) {
         ::close(mFd);
         mFd = -1;
@@ -148,16 +186,156 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
             == mDecryptHandle->decryptApiType) {
         return readAtDRM(offset, data, size);
    } else {
-        off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
-        if (result == -1) {
+        if (offset < 0) {
             ALOGE("seek to %lld failed", (long long)(offset + mOffset));
             return UNKNOWN_ERROR;
         }
 
-        return ::read(mFd, data, size);
+        if (!mMapChecked) {
+            mapFile_l();
+        }
+        if (mMap != NULL) {
+            memcpy(data, (const uint8_t *)mMap->getDataPtr() + offset, size);
+            return size;
+        }
+
+        updateAdvice_l(offset, size);
+
+        if (size >= kBlockSize) {
+            return pread64(mFd, data, size, offset + mOffset);
+        }
+        return readCached_l(offset, data, size);
+    }
+}
+
+void FileSource::initBlocks() {
+    for (size_t i = 0; i < kNumBlocks; ++i) {
+        mBlocks[i].mOffset = -1;
+        mBlocks[i].mSize = 0;
+        mBlocks[i].mLastUse = 0;
+        mBlocks[i].mData = NULL;
+    }
+}
+
+ssize_t FileSource::readBlock_l(off64_t blockOffset, Block **block) {
+    // the block if cached, otherwise the least recently used one
+    Block *victim = &mBlocks[0];
+    for (size_t i = 0; i < kNumBlocks; ++i) {
+        if (mBlocks[i].mOffset == blockOffset) {
+            *block = &mBlocks[i];
+            (*block)->mLastUse = ++mUseCount;
+            return (*block)->mSize;
+        }
+        if (mBlocks[i].mLastUse < victim->mLastUse) {
+            victim = &mBlocks[i];
+        }
+    }
+
+    if (victim->mData == NULL) {
+        victim->mData = new (std::nothrow) uint8_t[kBlockSize];
+        if (victim->mData == NULL) {
+            return NO_MEMORY;
+        }
+    }
+
+    size_t blockSize = kBlockSize;
+    if (mLength >= 0 && (int64_t)blockSize > mLength - blockOffset) {
+        blockSize = mLength - blockOffset;
+    }
+    ssize_t n = pread64(mFd, victim->mData, blockSize, blockOffset + mOffset);
+    if (n < 0) {
+        victim->mOffset = -1;
+        victim->mSize = 0;
+        return n;
+    }
+
+    victim->mOffset = blockOffset;
+    victim->mSize = n;
+    victim->mLastUse = ++mUseCount;
+    *block = victim;
+    return n;
+}
+
+ssize_t FileSource::readCached_l(off64_t offset, void *data, size_t size) {
+    size_t copied = 0;
+    while (copied < size) {
+        off64_t position = offset + copied;
+        off64_t blockOffset = position - position % kBlockSize;
+
+        Block *block;
+        ssize_t n = readBlock_l(blockOffset, &block);
+        if (n < 0) {
+            return copied > 0 ? (ssize_t)copied : n;
+        }
+
+        size_t inBlock = position - blockOffset;
+        if (inBlock >= (size_t)n) {
+            break;
+        }
+
+        size_t available = n - inBlock;
+        if (available > size - copied) {
+            available = size - copied;
+        }
+        memcpy((uint8_t *)data + copied, block->mData + inBlock, available);
+        copied += available;
+
+        if (n < kBlockSize) {
+            // end of file
+            break;
+        }
+    }
+    return copied;
+}
+
+void FileSource::updateAdvice_l(off64_t offset, size_t size) {
+    // Extractors read mostly forward with small jumps, over the samples of
+    // other tracks for example, so only a jump beyond a block is random.
+    bool sequential = mLastReadEnd >= 0
+            && offset >= mLastReadEnd - kBlockSize
+            && offset <= mLastReadEnd + kBlockSize;
+    mLastReadEnd = offset + size;
+
+    if (sequential) {
+        mNumSequentialReads = mNumSequentialReads < 0 ? 1 : mNumSequentialReads + 1;
+    } else {
+        mNumSequentialReads = mNumSequentialReads > 0 ? -1 : mNumSequentialReads - 1;
+    }
+
+    int advice = mAdvice;
+    if (mNumSequentialReads >= kSequentialReads) {
+        mNumSequentialReads = kSequentialReads;
+        advice = POSIX_FADV_SEQUENTIAL;
+    } else if (mNumSequentialReads <= kRandomReads) {
+        mNumSequentialReads = kRandomReads;
+        advice = POSIX_FADV_RANDOM;
+    }
+
+    if (advice != mAdvice) {
+        ALOGV("%s: %s access", mName.string(),
+                advice == POSIX_FADV_SEQUENTIAL ? "sequential" : "random");
+        posix_fadvise(mFd, mOffset, mLength > 0 ? mLength : 0, advice);
+        mAdvice = advice;
     }
 }
 
+void FileSource::mapFile_l() {
+    mMapChecked = true;
+
+    if (mLength <= 0 || mLength > kMaxMappedFileSize
+            || !property_get_bool("media.stagefright.mmap-file", false)) {
+        return;
+    }
+
+    FileMap *map = new FileMap;
+    if (!map->create(NULL, mFd, mOffset, mLength, true /* readOnly */)) {
+        ALOGW("%s: mapping failed, using reads", mName.string());
+        delete map;
+        return;
+    }
+    mMap = map;
+}
+
 status_t FileSource::getSize(off64_t *size) {
     Mutex::Autolock autoLock(mLock);
 
@@ -170,6 +348,23 @@ status_t FileSource::getSize(off64_t *size) {
     return OK;
 }
 
+FileMap *FileSource::mapRange(off64_t offset, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    // DRM protected content is only available decrypted, through readAt()
+    if (mFd < 0 || mDecryptHandle != NULL
+            || offset < 0 || offset > mLength || (int64_t)size > mLength - offset) {
+        return NULL;
+    }
+
+    FileMap *map = new FileMap;
+    if (!map->create(NULL, mFd, mOffset + offset, size, true /* readOnly */)) {
+        delete map;
+        return NULL;
+    }
+    return map;
+}
+
 sp<DecryptHandle> FileSource::DrmInitialization(const char *mime) {
     if (mDrmManagerClient == NULL) {
         mDrmManagerClient = new DrmManagerClient();
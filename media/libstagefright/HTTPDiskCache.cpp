@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "HTTPDiskCache"
+#include <utils/Log.h>
+
+#include "include/HTTPDiskCache.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaErrors.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace android {
+
+// Index file layout: magic, content size (64-bit little endian), key length
+// (32-bit little endian), key, then one bit per block of the content.
+static const char kIndexMagic[4] = { 'M', 'D', 'C', '1' };
+static const size_t kIndexHeaderSize = 4 + 8 + 4;
+
+static const char kIndexSuffix[] = ".index";
+static const char kDataSuffix[] = ".data";
+
+// FNV-1a, which relies on wrapping arithmetic
+__attribute__((no_sanitize("integer")))
+static uint64_t HashKey(const String8 &key) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < key.length(); ++i) {
+        hash ^= (uint8_t)key.string()[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static void WriteLE(uint8_t *data, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = (value >> (8 * i)) & 0xff;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// static
+sp<HTTPDiskCache> HTTPDiskCache::Open(const sp<DataSource> &source) {
+    char dir[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.disk-cache-dir", dir, NULL) <= 0) {
+        return NULL;
+    }
+
+    // without a content length, a changed content cannot be told apart
+    off64_t size;
+    if (source->getSize(&size) != OK || size <= 0) {
+        return NULL;
+    }
+
+    int64_t maxBytes = property_get_int64(
+            "media.stagefright.disk-cache-size", kDefaultMaxSizeMB) * 1024 * 1024;
+    if (size > maxBytes / 4) {
+        ALOGV("content of %lld bytes too large to cache", (long long)size);
+        return NULL;
+    }
+
+    // The URI, content length and type stand in for the validators of the
+    // response, which IMediaHTTPConnection does not expose.
+    String8 uri = source->getUri();
+    if (uri.isEmpty()) {
+        return NULL;
+    }
+    String8 key = uri;
+    key.append("\n");
+    key.append(source->getMIMEType());
+
+    String8 path = String8::format("%s/%016" PRIx64, dir, HashKey(key));
+
+    Evict(dir, path, maxBytes - size);
+
+    sp<HTTPDiskCache> cache = new HTTPDiskCache;
+    if (cache->init(path, key, size) != OK) {
+        return NULL;
+    }
+    return cache;
+}
+
+HTTPDiskCache::HTTPDiskCache()
+    : mDataFd(-1),
+      mIndexFd(-1),
+      mSize(0),
+      mBitmapOffset(0),
+      mRunStart(-1),
+      mRunEnd(-1) {
+}
+
+HTTPDiskCache::~HTTPDiskCache() {
+    if (mDataFd >= 0) {
+        close(mDataFd);
+        mDataFd = -1;
+    }
+    if (mIndexFd >= 0) {
+        close(mIndexFd);
+        mIndexFd = -1;
+    }
+}
+
+status_t HTTPDiskCache::init(const String8 &path, const String8 &key, off64_t size) {
+    String8 indexPath = path;
+    indexPath.append(kIndexSuffix);
+    String8 dataPath = path;
+    dataPath.append(kDataSuffix);
+
+    mIndexFd = open(indexPath.string(), O_RDWR | O_CREAT | O_LARGEFILE | O_CLOEXEC, 0600);
+    mDataFd = open(dataPath.string(), O_RDWR | O_CREAT | O_LARGEFILE | O_CLOEXEC, 0600);
+    if (mIndexFd < 0 || mDataFd < 0) {
+        ALOGW("cannot open cache entry %s (%s)", path.string(), strerror(errno));
+        return ERROR_IO;
+    }
+
+    mSize = size;
+    mBitmapOffset = kIndexHeaderSize + key.length();
+    size_t numBlocks = (size + kBlockSize - 1) / kBlockSize;
+    mBitmap.insertAt((uint8_t)0, 0, (numBlocks + 7) / 8);
+
+    Vector<uint8_t> header;
+    header.insertAt((uint8_t)0, 0, mBitmapOffset);
+    uint8_t *data = header.editArray();
+    memcpy(data, kIndexMagic, sizeof(kIndexMagic));
+    WriteLE(&data[4], size, 8);
+    WriteLE(&data[12], key.length(), 4);
+    memcpy(&data[kIndexHeaderSize], key.string(), key.length());
+
+    // reuse the entry if it is for the same content
+    Vector<uint8_t> existing;
+    existing.insertAt((uint8_t)0, 0, mBitmapOffset);
+    if (pread64(mIndexFd, existing.editArray(), mBitmapOffset, 0) == mBitmapOffset
+            && !memcmp(existing.array(), header.array(), mBitmapOffset)
+            && pread64(mIndexFd, mBitmap.editArray(), mBitmap.size(), mBitmapOffset)
+                    == (ssize_t)mBitmap.size()) {
+        ALOGV("reusing cache entry %s", path.string());
+        // the modification time of the index orders the entries for eviction
+        futimens(mIndexFd, NULL);
+        return OK;
+    }
+
+    ALOGV("new cache entry %s", path.string());
+    memset(mBitmap.editArray(), 0, mBitmap.size());
+    if (ftruncate64(mIndexFd, 0) != 0 || ftruncate64(mDataFd, 0) != 0
+            || pwrite64(mIndexFd, header.array(), mBitmapOffset, 0) != mBitmapOffset
+            || pwrite64(mIndexFd, mBitmap.array(), mBitmap.size(), mBitmapOffset)
+                    != (ssize_t)mBitmap.size()) {
+        ALOGW("cannot create cache entry %s (%s)", path.string(), strerror(errno));
+        return ERROR_IO;
+    }
+    return OK;
+}
+
+bool HTTPDiskCache::isCached(size_t block) const {
+    return (mBitmap[block / 8] & (1 << (block % 8))) != 0;
+}
+
+void HTTPDiskCache::markCached(size_t firstBlock, size_t endBlock) {
+    for (size_t block = firstBlock; block < endBlock; ++block) {
+        if (isCached(block)) {
+            continue;
+        }
+        uint8_t *byte = &mBitmap.editItemAt(block / 8);
+        *byte |= 1 << (block % 8);
+        pwrite64(mIndexFd, byte, 1, mBitmapOffset + block / 8);
+    }
+}
+
+ssize_t HTTPDiskCache::readAt(off64_t offset, void *data, size_t size) {
+    if (offset < 0) {
+        return -EAGAIN;
+    }
+    if (offset >= mSize) {
+        return 0;
+    }
+    if ((off64_t)size > mSize - offset) {
+        size = mSize - offset;
+    }
+    if (size == 0) {
+        return 0;
+    }
+
+    size_t endBlock = (offset + size - 1) / kBlockSize + 1;
+    for (size_t block = offset / kBlockSize; block < endBlock; ++block) {
+        if (!isCached(block)) {
+            return -EAGAIN;
+        }
+    }
+
+    ssize_t n = pread64(mDataFd, data, size, offset);
+    if (n < (ssize_t)size) {
+        ALOGW("cached read at %lld failed", (long long)offset);
+        return -EAGAIN;
+    }
+    return n;
+}
+
+void HTTPDiskCache::write(off64_t offset, const void *data, size_t size) {
+    if (offset < 0 || offset >= mSize || (off64_t)size > mSize - offset) {
+        return;
+    }
+
+    if (offset != mRunEnd) {
+        mRunStart = offset;
+        mRunEnd = offset;
+    }
+
+    if (pwrite64(mDataFd, data, size, offset) != (ssize_t)size) {
+        ALOGW("cache write at %lld failed (%s)", (long long)offset, strerror(errno));
+        mRunStart = -1;
+        mRunEnd = -1;
+        return;
+    }
+    mRunEnd += size;
+
+    // only the blocks written entirely, or up to the end of the content
+    size_t firstBlock = (mRunStart + kBlockSize - 1) / kBlockSize;
+    size_t endBlock = mRunEnd == mSize
+            ? (mSize + kBlockSize - 1) / kBlockSize : mRunEnd / kBlockSize;
+    markCached(firstBlock, endBlock);
+}
+
+struct CacheEntry {
+    String8 mPath;
+    int64_t mBytes;
+    time_t mLastUse;
+};
+
+static int CompareLastUse(const CacheEntry *a, const CacheEntry *b) {
+    return a->mLastUse < b->mLastUse ? -1 : (a->mLastUse > b->mLastUse ? 1 : 0);
+}
+
+// static
+void HTTPDiskCache::Evict(const char *dir, const String8 &keep, int64_t maxBytes) {
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        ALOGW("cannot open cache directory %s (%s)", dir, strerror(errno));
+        return;
+    }
+
+    Vector<CacheEntry> entries;
+    int64_t totalBytes = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        size_t length = strlen(ent->d_name);
+        size_t suffixLength = sizeof(kIndexSuffix) - 1;
+        if (length <= suffixLength
+                || strcmp(ent->d_name + length - suffixLength, kIndexSuffix)) {
+            continue;
+        }
+
+        CacheEntry entry;
+        entry.mPath = String8::format("%s/%.*s",
+                dir, (int)(length - suffixLength), ent->d_name);
+
+        String8 indexPath = entry.mPath;
+        indexPath.append(kIndexSuffix);
+        String8 dataPath = entry.mPath;
+        dataPath.append(kDataSuffix);
+
+        struct stat indexStat, dataStat;
+        if (stat(indexPath.string(), &indexStat) != 0) {
+            continue;
+        }
+        // the data file is sparse, count the blocks actually used
+        entry.mBytes = indexStat.st_blocks * 512ll;
+        if (stat(dataPath.string(), &dataStat) == 0) {
+            entry.mBytes += dataStat.st_blocks * 512ll;
+        }
+        entry.mLastUse = indexStat.st_mtime;
+        totalBytes += entry.mBytes;
+
+        if (entry.mPath != keep) {
+            entries.push(entry);
+        }
+    }
+    closedir(d);
+
+    entries.sort(CompareLastUse);
+    for (size_t i = 0; i < entries.size() && totalBytes > maxBytes; ++i) {
+        const CacheEntry &entry = entries[i];
+        ALOGV("evicting cache entry %s", entry.mPath.string());
+
+        String8 indexPath = entry.mPath;
+        indexPath.append(kIndexSuffix);
+        String8 dataPath = entry.mPath;
+        dataPath.append(kDataSuffix);
+        unlink(indexPath.string());
+        unlink(dataPath.string());
+
+        totalBytes -= entry.mBytes;
+    }
+}
+
+}  // namespace android
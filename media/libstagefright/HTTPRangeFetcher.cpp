@@ -0,0 +1,421 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "HTTPRangeFetcher"
+#include <utils/Log.h>
+
+#include "include/HTTPRangeFetcher.h"
+#include "include/HTTPBase.h"
+
+#include <cutils/properties.h>
+#include <media/IMediaHTTPConnection.h>
+#include <media/IMediaHTTPService.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaHTTP.h>
+
+namespace android {
+
+struct HTTPRangeFetcher::Worker : public Thread {
+    Worker(HTTPRangeFetcher *fetcher, size_t index, const sp<HTTPBase> &connection)
+        // IMediaHTTPConnection is most likely implemented in JAVA, see
+        // NuCachedSource2's looper.
+        : Thread(true /* canCallJava */),
+          mFetcher(fetcher),
+          mIndex(index),
+          mConnection(connection),
+          mNeedsReconnect(false) {
+    }
+
+    HTTPRangeFetcher *mFetcher;
+    size_t mIndex;
+
+    // Written by the worker thread only, under the fetcher's lock.
+    sp<HTTPBase> mConnection;
+    bool mNeedsReconnect;
+
+private:
+    virtual bool threadLoop() {
+        return mFetcher->fetchChunk(this);
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(Worker);
+};
+
+// static
+sp<HTTPRangeFetcher> HTTPRangeFetcher::Create(
+        const sp<IMediaHTTPService> &httpService,
+        const char *uri,
+        const KeyedVector<String8, String8> *headers,
+        const sp<HTTPBase> &source) {
+    int32_t maxConnections = property_get_int32(
+            "media.stagefright.http-connections", kDefaultMaxConnections);
+    if (maxConnections <= 1 || httpService == NULL) {
+        return NULL;
+    }
+    if (maxConnections > kMaxConnections) {
+        maxConnections = kMaxConnections;
+    }
+
+    // below a few chunks, there is little to fetch in parallel
+    off64_t size;
+    if (source->getSize(&size) != OK
+            || size < (off64_t)kChunkSize * kChunksPerConnection * 2) {
+        return NULL;
+    }
+
+    sp<HTTPRangeFetcher> fetcher = new HTTPRangeFetcher(
+            httpService, uri, headers, size, maxConnections);
+
+    Mutex::Autolock autoLock(fetcher->mLock);
+    // the connection of the source is the first one
+    sp<Worker> worker = new Worker(fetcher.get(), 0, source);
+    fetcher->mWorkers.push(worker);
+    worker->run("HTTPRangeFetcher");
+
+    return fetcher;
+}
+
+HTTPRangeFetcher::HTTPRangeFetcher(
+        const sp<IMediaHTTPService> &httpService,
+        const char *uri,
+        const KeyedVector<String8, String8> *headers,
+        off64_t size,
+        size_t maxConnections)
+    : mHTTPService(httpService),
+      mUri(uri),
+      mSize(size),
+      mNextChunkOffset(0),
+      mDisconnecting(false),
+      mMaxConnections(maxConnections),
+      mNumActive(1),
+      mProbeBaseBps(0),
+      mProbeChunksLeft(0),
+      mUsefulConnections(maxConnections) {
+    if (headers != NULL) {
+        mHeaders = *headers;
+    }
+}
+
+HTTPRangeFetcher::~HTTPRangeFetcher() {
+    disconnect();
+
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->requestExitAndWait();
+    }
+    mWorkers.clear();
+}
+
+void HTTPRangeFetcher::disconnect() {
+    Vector<sp<HTTPBase> > connections;
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mDisconnecting) {
+            return;
+        }
+        mDisconnecting = true;
+        mChunkPending.broadcast();
+        mDataAvailable.broadcast();
+
+        for (size_t i = 0; i < mWorkers.size(); ++i) {
+            if (mWorkers[i]->mConnection != NULL) {
+                connections.push(mWorkers[i]->mConnection);
+            }
+        }
+    }
+
+    // outside of the lock, as the workers take it once their reads returned
+    for (size_t i = 0; i < connections.size(); ++i) {
+        connections[i]->disconnect();
+    }
+}
+
+size_t HTTPRangeFetcher::numActiveConnections() const {
+    Mutex::Autolock autoLock(mLock);
+    return mNumActive;
+}
+
+status_t HTTPRangeFetcher::getEstimatedBandwidthKbps(int32_t *kbps) {
+    Mutex::Autolock autoLock(mLock);
+    int32_t bps = aggregateBandwidthBps_l();
+    if (bps <= 0) {
+        return ERROR_UNSUPPORTED;
+    }
+    *kbps = bps / 1000;
+    return OK;
+}
+
+int32_t HTTPRangeFetcher::aggregateBandwidthBps_l() {
+    int64_t total = 0;
+    for (size_t i = 0; i < mWorkers.size() && i < mNumActive; ++i) {
+        int32_t bps;
+        if (mWorkers[i]->mConnection != NULL
+                && mWorkers[i]->mConnection->estimateBandwidth(&bps)) {
+            total += bps;
+        }
+    }
+    return total > INT32_MAX ? INT32_MAX : (int32_t)total;
+}
+
+ssize_t HTTPRangeFetcher::readAt(off64_t offset, void *data, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mDisconnecting) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    // drop the chunks read entirely
+    while (!mChunks.empty()) {
+        const sp<Chunk> &chunk = *mChunks.begin();
+        if (offset < chunk->mOffset + (off64_t)chunk->mSize) {
+            break;
+        }
+        chunk->mAbandoned = true;
+        mChunks.erase(mChunks.begin());
+    }
+
+    if (mChunks.empty() ? offset != mNextChunkOffset
+            : offset < (*mChunks.begin())->mOffset) {
+        ALOGV("restarting at %lld", (long long)offset);
+        abandonChunks_l();
+        mNextChunkOffset = offset;
+    }
+
+    if (offset >= mSize) {
+        return 0;
+    }
+
+    scheduleChunks_l();
+
+    sp<Chunk> chunk = *mChunks.begin();
+    size_t chunkOffset = offset - chunk->mOffset;
+    while (!mDisconnecting
+            && chunk->mFilled <= chunkOffset && chunk->mState != DONE) {
+        mDataAvailable.wait(mLock);
+    }
+
+    if (mDisconnecting) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    if (chunk->mFilled <= chunkOffset) {
+        // The chunk ended short of the offset, the chunks after it are
+        // fetched again on the next read.
+        status_t err = chunk->mStatus;
+        abandonChunks_l();
+        mNextChunkOffset = offset;
+        return err == ERROR_END_OF_STREAM ? 0 : err;
+    }
+
+    size_t n = chunk->mFilled - chunkOffset;
+    if (n > size) {
+        n = size;
+    }
+    memcpy(data, chunk->mData->data() + chunkOffset, n);
+    return n;
+}
+
+void HTTPRangeFetcher::abandonChunks_l() {
+    for (List<sp<Chunk> >::iterator it = mChunks.begin(); it != mChunks.end(); ++it) {
+        (*it)->mAbandoned = true;
+    }
+    mChunks.clear();
+
+    // the conditions may have changed
+    mUsefulConnections = mMaxConnections;
+}
+
+void HTTPRangeFetcher::scheduleChunks_l() {
+    bool scheduled = false;
+    while (mChunks.size() < mNumActive * kChunksPerConnection
+            && mNextChunkOffset < mSize) {
+        sp<Chunk> chunk = new Chunk;
+        chunk->mOffset = mNextChunkOffset;
+        chunk->mSize = kChunkSize;
+        if ((off64_t)chunk->mSize > mSize - mNextChunkOffset) {
+            chunk->mSize = mSize - mNextChunkOffset;
+        }
+        chunk->mData = new ABuffer(chunk->mSize);
+        chunk->mFilled = 0;
+        chunk->mState = PENDING;
+        chunk->mStatus = OK;
+        chunk->mAbandoned = false;
+
+        mChunks.push_back(chunk);
+        mNextChunkOffset += chunk->mSize;
+        scheduled = true;
+    }
+
+    if (scheduled) {
+        mChunkPending.broadcast();
+    }
+}
+
+sp<HTTPRangeFetcher::Chunk> HTTPRangeFetcher::nextPendingChunk_l(size_t index) {
+    if (index >= mNumActive) {
+        return NULL;
+    }
+    for (List<sp<Chunk> >::iterator it = mChunks.begin(); it != mChunks.end(); ++it) {
+        if ((*it)->mState == PENDING) {
+            return *it;
+        }
+    }
+    return NULL;
+}
+
+bool HTTPRangeFetcher::fetchChunk(Worker *worker) {
+    sp<Chunk> chunk;
+    {
+        Mutex::Autolock autoLock(mLock);
+        while (!mDisconnecting
+                && (chunk = nextPendingChunk_l(worker->mIndex)) == NULL) {
+            mChunkPending.wait(mLock);
+        }
+        if (mDisconnecting) {
+            return false;
+        }
+        chunk->mState = FETCHING;
+    }
+
+    int64_t startUs = ALooper::GetNowUs();
+
+    status_t err = OK;
+    if (worker->mConnection == NULL) {
+        sp<HTTPBase> connection = new MediaHTTP(mHTTPService);
+        if (connection->initCheck() != OK) {
+            err = ERROR_IO;
+        } else {
+            err = connection->connect(mUri.c_str(), &mHeaders, chunk->mOffset);
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        if (err == OK) {
+            worker->mConnection = connection;
+            if (mDisconnecting) {
+                connection->disconnect();
+                return false;
+            }
+        }
+    } else if (worker->mNeedsReconnect) {
+        err = worker->mConnection->reconnectAtOffset(chunk->mOffset);
+        if (err == OK) {
+            worker->mNeedsReconnect = false;
+        }
+    }
+
+    if (err != OK) {
+        ALOGW("connection %zu failed to connect (%d)", worker->mIndex, err);
+
+        Mutex::Autolock autoLock(mLock);
+        chunk->mStatus = err;
+        chunk->mState = DONE;
+        mDataAvailable.signal();
+        return !mDisconnecting;
+    }
+
+    // The first read of a chunk includes the round trip of its range
+    // request, which the number of connections in use makes up for.
+    int64_t firstReadUs = -1;
+    size_t filled = 0;
+    for (;;) {
+        size_t toRead = chunk->mSize - filled;
+        if (toRead > kReadSize) {
+            toRead = kReadSize;
+        }
+        ssize_t n = worker->mConnection->readAt(
+                chunk->mOffset + filled, chunk->mData->data() + filled, toRead);
+
+        int64_t nowUs = ALooper::GetNowUs();
+        if (firstReadUs < 0) {
+            firstReadUs = nowUs - startUs;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        if (mDisconnecting) {
+            return false;
+        }
+        if (chunk->mAbandoned) {
+            return true;
+        }
+
+        if (n > 0) {
+            filled += n;
+            chunk->mFilled = filled;
+        } else {
+            chunk->mStatus = n < 0 ? n : ERROR_END_OF_STREAM;
+            if (n < 0) {
+                ALOGW("connection %zu read error %zd at %lld",
+                      worker->mIndex, n, (long long)(chunk->mOffset + filled));
+                worker->mNeedsReconnect = true;
+            }
+        }
+        mDataAvailable.signal();
+
+        if (n <= 0) {
+            chunk->mState = DONE;
+            break;
+        }
+        if (filled == chunk->mSize) {
+            chunk->mState = DONE;
+            onChunkDone_l(firstReadUs, nowUs - startUs);
+            break;
+        }
+    }
+
+    return true;
+}
+
+void HTTPRangeFetcher::onChunkDone_l(int64_t firstReadUs, int64_t durationUs) {
+    if (mProbeChunksLeft > 0) {
+        if (--mProbeChunksLeft > 0) {
+            return;
+        }
+
+        int32_t bps = aggregateBandwidthBps_l();
+        if (bps < (int64_t)mProbeBaseBps * 11 / 10) {
+            ALOGV("connection %zu does not add bandwidth (%d vs %d bps)",
+                  mNumActive - 1, bps, mProbeBaseBps);
+            --mNumActive;
+            mUsefulConnections = mNumActive;
+        }
+        return;
+    }
+
+    if (firstReadUs * 4 > durationUs && mNumActive < mUsefulConnections) {
+        // latency bound, try another connection
+        mProbeBaseBps = aggregateBandwidthBps_l();
+        mProbeChunksLeft = (mNumActive + 1) * kChunksPerConnection * 2;
+
+        if (mWorkers.size() == mNumActive) {
+            sp<Worker> worker = new Worker(this, mNumActive, NULL);
+            mWorkers.push(worker);
+            worker->run("HTTPRangeFetcher");
+        }
+        ++mNumActive;
+        ALOGV("using %zu connections", mNumActive);
+
+        scheduleChunks_l();
+    } else if (firstReadUs * 16 < durationUs && mNumActive > 1) {
+        // bandwidth bound, fewer connections do
+        --mNumActive;
+        ALOGV("using %zu connections", mNumActive);
+    }
+}
+
+}  // namespace android
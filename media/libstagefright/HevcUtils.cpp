@@ -222,10 +222,8 @@ status_t HevcParameterSets::parseSps(const uint8_t* data, size_t size) {
         // Skip separate_colour_plane_flag
         reader.skipBits(1);
     }
-    // Skip pic_width_in_luma_samples
-    skipUE(&reader);
-    // Skip pic_height_in_luma_samples
-    skipUE(&reader);
+    mParams.add(kPicWidthInLumaSamples, parseUEWithFallback(&reader, 0));
+    mParams.add(kPicHeightInLumaSamples, parseUEWithFallback(&reader, 0));
     if (reader.getBitsWithFallback(1, 0) /* i.e. conformance_window_flag */) {
         // Skip conf_win_left_offset
         skipUE(&reader);
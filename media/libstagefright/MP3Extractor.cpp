@@ -35,7 +35,9 @@
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
+#include <utils/Mutex.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -209,12 +211,243 @@ static bool Resync(
     return valid;
 }
 
+// Seek table for files without a XING or VBRI header. It maps the start time
+// of a frame, about every second, to its offset, and is extended as the
+// frames are read in order. Seeks beyond the frames indexed so far scan the
+// frame headers forward, unless the source is remote.
+struct MP3FrameIndex : public MP3Seeker {
+    MP3FrameIndex(
+            const sp<DataSource> &source, off64_t first_frame_pos,
+            uint32_t fixed_header);
+
+    virtual bool getDuration(int64_t *durationUs);
+    virtual bool getOffsetForTime(int64_t *timeUs, off64_t *pos);
+
+    // Called for each frame read in order. "readPos" is where the read
+    // started, "framePos" where the frame was found after resyncing.
+    void addFrame(
+            off64_t readPos, off64_t framePos, size_t frameSize,
+            int numSamples);
+
+private:
+    enum {
+        kEntryIntervalUs = 1000000,
+        kScanBufferSize = 16384,
+    };
+
+    struct Entry {
+        int64_t mSamples;
+        off64_t mPos;
+    };
+
+    Mutex mLock;
+    sp<DataSource> mDataSource;
+    uint32_t mFixedHeader;
+    int mSampleRate;
+    bool mCanScan;
+
+    Vector<Entry> mEntries;
+
+    // The offset right after the last frame indexed, and the number of
+    // samples up to it. mComplete is set once it reached the end of the data.
+    off64_t mEndPos;
+    int64_t mEndSamples;
+    bool mComplete;
+
+    uint8_t mScanBuffer[kScanBufferSize];
+    off64_t mScanBufferPos;
+    size_t mScanBufferSize;
+
+    int64_t samplesToUs(int64_t samples) const;
+    void addFrame_l(off64_t pos, size_t frameSize, int numSamples);
+    bool readHeader_l(off64_t pos, uint32_t *header);
+
+    // Walks the frames from "*pos" until the one containing sample
+    // "targetSamples", indexing them if "extend" is set, in which case "pos"
+    // and "samples" are the end of the index. Returns false if the end of
+    // the data was reached first.
+    bool advance_l(
+            off64_t *pos, int64_t *samples, int64_t targetSamples, bool extend);
+
+    DISALLOW_EVIL_CONSTRUCTORS(MP3FrameIndex);
+};
+
+MP3FrameIndex::MP3FrameIndex(
+        const sp<DataSource> &source, off64_t first_frame_pos,
+        uint32_t fixed_header)
+    : mDataSource(source),
+      mFixedHeader(fixed_header),
+      mSampleRate(0),
+      mCanScan(!(source->flags() & DataSource::kIsHTTPBasedSource)),
+      mEndPos(first_frame_pos),
+      mEndSamples(0),
+      mComplete(false),
+      mScanBufferPos(0),
+      mScanBufferSize(0) {
+    size_t frame_size;
+    GetMPEGAudioFrameSize(fixed_header, &frame_size, &mSampleRate);
+}
+
+int64_t MP3FrameIndex::samplesToUs(int64_t samples) const {
+    return (samples * 1000000ll) / mSampleRate;
+}
+
+bool MP3FrameIndex::getDuration(int64_t *durationUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mComplete || mSampleRate <= 0) {
+        return false;
+    }
+
+    *durationUs = samplesToUs(mEndSamples);
+    return true;
+}
+
+bool MP3FrameIndex::getOffsetForTime(int64_t *timeUs, off64_t *pos) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mSampleRate <= 0) {
+        return false;
+    }
+
+    int64_t targetSamples = 0;
+    if (*timeUs > 0) {
+        targetSamples = (*timeUs / 1000000ll) * mSampleRate
+                + ((*timeUs % 1000000ll) * mSampleRate) / 1000000ll;
+    }
+
+    if (!mComplete && targetSamples >= mEndSamples) {
+        if (!mCanScan) {
+            return false;
+        }
+
+        if (!advance_l(&mEndPos, &mEndSamples, targetSamples, true)
+                && !mComplete) {
+            return false;
+        }
+    }
+
+    if (mEntries.isEmpty()) {
+        return false;
+    }
+
+    // Find the last entry at or before the target.
+    size_t lo = 0;
+    size_t hi = mEntries.size();
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mEntries.itemAt(mid).mSamples <= targetSamples) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // Then walk the frames from there to the one containing the target.
+    const Entry &entry = mEntries.itemAt(lo);
+    off64_t framePos = entry.mPos;
+    int64_t frameSamples = entry.mSamples;
+    advance_l(&framePos, &frameSamples, targetSamples, false);
+
+    *pos = framePos;
+    *timeUs = samplesToUs(frameSamples);
+
+    return true;
+}
+
+void MP3FrameIndex::addFrame(
+        off64_t readPos, off64_t framePos, size_t frameSize, int numSamples) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mComplete || readPos != mEndPos) {
+        return;
+    }
+
+    addFrame_l(framePos, frameSize, numSamples);
+}
+
+void MP3FrameIndex::addFrame_l(off64_t pos, size_t frameSize, int numSamples) {
+    if (mEntries.isEmpty()
+            || samplesToUs(mEndSamples - mEntries.top().mSamples)
+                    >= kEntryIntervalUs) {
+        Entry entry;
+        entry.mSamples = mEndSamples;
+        entry.mPos = pos;
+        mEntries.push(entry);
+    }
+
+    mEndPos = pos + frameSize;
+    mEndSamples += numSamples;
+}
+
+bool MP3FrameIndex::readHeader_l(off64_t pos, uint32_t *header) {
+    if (pos < mScanBufferPos
+            || pos + 4 > mScanBufferPos + (off64_t)mScanBufferSize) {
+        ssize_t n = mDataSource->readAt(pos, mScanBuffer, sizeof(mScanBuffer));
+        if (n < 4) {
+            mScanBufferSize = 0;
+            return false;
+        }
+
+        mScanBufferPos = pos;
+        mScanBufferSize = n;
+    }
+
+    *header = U32_AT(&mScanBuffer[pos - mScanBufferPos]);
+    return true;
+}
+
+bool MP3FrameIndex::advance_l(
+        off64_t *pos, int64_t *samples, int64_t targetSamples, bool extend) {
+    for (;;) {
+        uint32_t header;
+        if (!readHeader_l(*pos, &header)) {
+            if (extend) {
+                mComplete = true;
+            }
+            return false;
+        }
+
+        size_t frame_size;
+        int sample_rate;
+        int bitrate;
+        int num_samples;
+        if ((header & kMask) != (mFixedHeader & kMask)
+                || !GetMPEGAudioFrameSize(
+                        header, &frame_size, &sample_rate, NULL,
+                        &bitrate, &num_samples)) {
+            off64_t resyncPos = *pos;
+            if (!Resync(mDataSource, mFixedHeader, &resyncPos, NULL, NULL)) {
+                if (extend) {
+                    mComplete = true;
+                }
+                return false;
+            }
+
+            *pos = resyncPos;
+            continue;
+        }
+
+        if (*samples + num_samples > targetSamples) {
+            return true;
+        }
+
+        if (extend) {
+            // Updates *pos and *samples, which are mEndPos and mEndSamples.
+            addFrame_l(*pos, frame_size, num_samples);
+        } else {
+            *pos += frame_size;
+            *samples += num_samples;
+        }
+    }
+}
+
 class MP3Source : public MediaSource {
 public:
     MP3Source(
             const sp<MetaData> &meta, const sp<DataSource> &source,
             off64_t first_frame_pos, uint32_t fixed_header,
-            const sp<MP3Seeker> &seeker);
+            const sp<MP3Seeker> &seeker, const sp<MP3FrameIndex> &frameIndex);
 
     virtual status_t start(MetaData *params = NULL);
     virtual status_t stop();
@@ -237,6 +470,7 @@ private:
     int64_t mCurrentTimeUs;
     bool mStarted;
     sp<MP3Seeker> mSeeker;
+    sp<MP3FrameIndex> mFrameIndex;
     MediaBufferGroup *mGroup;
 
     int64_t mBasisTimeUs;
@@ -348,6 +582,10 @@ MP3Extractor::MP3Extractor(
 
     int64_t durationUs;
 
+    if (mSeeker == NULL) {
+        mFrameIndex = new MP3FrameIndex(mDataSource, mFirstFramePos, mFixedHeader);
+    }
+
     if (mSeeker == NULL || !mSeeker->getDuration(&durationUs)) {
         off64_t fileSize;
         if (mDataSource->getSize(&fileSize) == OK) {
@@ -414,7 +652,7 @@ sp<IMediaSource> MP3Extractor::getTrack(size_t index) {
 
     return new MP3Source(
             mMeta, mDataSource, mFirstFramePos, mFixedHeader,
-            mSeeker);
+            mSeeker, mFrameIndex);
 }
 
 sp<MetaData> MP3Extractor::getTrackMetaData(
@@ -438,7 +676,7 @@ const size_t MP3Source::kMaxFrameSize = (1 << 12); /* 4096 bytes */
 MP3Source::MP3Source(
         const sp<MetaData> &meta, const sp<DataSource> &source,
         off64_t first_frame_pos, uint32_t fixed_header,
-        const sp<MP3Seeker> &seeker)
+        const sp<MP3Seeker> &seeker, const sp<MP3FrameIndex> &frameIndex)
     : mMeta(meta),
       mDataSource(source),
       mFirstFramePos(first_frame_pos),
@@ -447,6 +685,7 @@ MP3Source::MP3Source(
       mCurrentTimeUs(0),
       mStarted(false),
       mSeeker(seeker),
+      mFrameIndex(frameIndex),
       mGroup(NULL),
       mBasisTimeUs(0),
       mSamplesRead(0) {
@@ -501,8 +740,13 @@ status_t MP3Source::read(
 
     if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
         int64_t actualSeekTimeUs = seekTimeUs;
-        if (mSeeker == NULL
-                || !mSeeker->getOffsetForTime(&actualSeekTimeUs, &mCurrentPos)) {
+        if (mSeeker != NULL
+                && mSeeker->getOffsetForTime(&actualSeekTimeUs, &mCurrentPos)) {
+            mCurrentTimeUs = actualSeekTimeUs;
+        } else if (mFrameIndex != NULL
+                && mFrameIndex->getOffsetForTime(&actualSeekTimeUs, &mCurrentPos)) {
+            mCurrentTimeUs = actualSeekTimeUs;
+        } else {
             int32_t bitrate;
             if (!mMeta->findInt32(kKeyBitRate, &bitrate)) {
                 // bitrate is in bits/sec.
@@ -514,8 +758,6 @@ status_t MP3Source::read(
             mCurrentTimeUs = seekTimeUs;
             mCurrentPos = mFirstFramePos + seekTimeUs * bitrate / 8000000;
             seekCBR = true;
-        } else {
-            mCurrentTimeUs = actualSeekTimeUs;
         }
 
         mBasisTimeUs = mCurrentTimeUs;
@@ -532,6 +774,7 @@ status_t MP3Source::read(
     int bitrate;
     int num_samples;
     int sample_rate;
+    off64_t readPos = mCurrentPos;
     for (;;) {
         ssize_t n = mDataSource->readAt(mCurrentPos, buffer->data(), 4);
         if (n < 4) {
@@ -587,6 +830,10 @@ status_t MP3Source::read(
 
     buffer->set_range(0, frame_size);
 
+    if (mFrameIndex != NULL) {
+        mFrameIndex->addFrame(readPos, mCurrentPos, frame_size, num_samples);
+    }
+
     buffer->meta_data()->setInt64(kKeyTime, mCurrentTimeUs);
     buffer->meta_data()->setInt32(kKeyIsSyncFrame, 1);
 
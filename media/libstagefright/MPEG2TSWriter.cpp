@@ -500,6 +500,9 @@ void MPEG2TSWriter::init() {
 
     initCrcTable();
 
+    mOutputBuffer = new ABuffer(kInitialOutputBufferSize);
+    mOutputBuffer->setRange(0, 0);
+
     mLooper = new ALooper;
     mLooper->setName("MPEG2TSWriter");
 
@@ -550,6 +553,10 @@ status_t MPEG2TSWriter::start(MetaData * /* param */) {
     mNumTSPacketsWritten = 0;
     mNumTSPacketsBeforeMeta = 0;
 
+    // the program tables only depend on the sources, so they are built once
+    initProgramAssociationTable();
+    initProgramMap();
+
     for (size_t i = 0; i < mSources.size(); ++i) {
         sp<AMessage> notify =
             new AMessage(kWhatSourceNotify, mReflector);
@@ -690,7 +697,7 @@ void MPEG2TSWriter::onMessageReceived(const sp<AMessage> &msg) {
     }
 }
 
-void MPEG2TSWriter::writeProgramAssociationTable() {
+void MPEG2TSWriter::initProgramAssociationTable() {
     // 0x47
     // transport_error_indicator = b0
     // payload_unit_start_indicator = b1
@@ -727,22 +734,15 @@ void MPEG2TSWriter::writeProgramAssociationTable() {
         0x00, 0x00, 0x00, 0x00   // b???? ???? ???? ???? ???? ???? ???? ????
     };
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0xff, buffer->size());
-    memcpy(buffer->data(), kData, sizeof(kData));
-
-    if (++mPATContinuityCounter == 16) {
-        mPATContinuityCounter = 0;
-    }
-    buffer->data()[3] |= mPATContinuityCounter;
-
-    uint32_t crc = htonl(crc32(&buffer->data()[5], 12));
-    memcpy(&buffer->data()[17], &crc, sizeof(crc));
+    uint8_t *packet = mPATPacket;
+    memset(packet, 0xff, kTSPacketSize);
+    memcpy(packet, kData, sizeof(kData));
 
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    uint32_t crc = htonl(crc32(&packet[5], 12));
+    memcpy(&packet[17], &crc, sizeof(crc));
 }
 
-void MPEG2TSWriter::writeProgramMap() {
+void MPEG2TSWriter::initProgramMap() {
     // 0x47
     // transport_error_indicator = b0
     // payload_unit_start_indicator = b1
@@ -784,24 +784,19 @@ void MPEG2TSWriter::writeProgramMap() {
         0xe0, 0x00, 0xf0, 0x00   // b111? ???? ???? ???? 1111 0000 0000 0000
     };
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0xff, buffer->size());
-    memcpy(buffer->data(), kData, sizeof(kData));
-
-    if (++mPMTContinuityCounter == 16) {
-        mPMTContinuityCounter = 0;
-    }
-    buffer->data()[3] |= mPMTContinuityCounter;
+    uint8_t *packet = mPMTPacket;
+    memset(packet, 0xff, kTSPacketSize);
+    memcpy(packet, kData, sizeof(kData));
 
     size_t section_length = 5 * mSources.size() + 4 + 9;
-    buffer->data()[6] |= section_length >> 8;
-    buffer->data()[7] = section_length & 0xff;
+    packet[6] |= section_length >> 8;
+    packet[7] = section_length & 0xff;
 
     static const unsigned kPCR_PID = 0x1e1;
-    buffer->data()[13] |= (kPCR_PID >> 8) & 0x1f;
-    buffer->data()[14] = kPCR_PID & 0xff;
+    packet[13] |= (kPCR_PID >> 8) & 0x1f;
+    packet[14] = kPCR_PID & 0xff;
 
-    uint8_t *ptr = &buffer->data()[sizeof(kData)];
+    uint8_t *ptr = &packet[sizeof(kData)];
     for (size_t i = 0; i < mSources.size(); ++i) {
         *ptr++ = mSources.editItemAt(i)->streamType();
 
@@ -812,10 +807,8 @@ void MPEG2TSWriter::writeProgramMap() {
         *ptr++ = 0x00;
     }
 
-    uint32_t crc = htonl(crc32(&buffer->data()[5], 12+mSources.size()*5));
-    memcpy(&buffer->data()[17+mSources.size()*5], &crc, sizeof(crc));
-
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
+    uint32_t crc = htonl(crc32(&packet[5], 12+mSources.size()*5));
+    memcpy(&packet[17+mSources.size()*5], &crc, sizeof(crc));
 }
 
 void MPEG2TSWriter::writeAccessUnit(
@@ -855,14 +848,8 @@ void MPEG2TSWriter::writeAccessUnit(
     // reserved = b1
     // the first fragment of "buffer" follows
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0xff, buffer->size());
-
     const unsigned PID = 0x1e0 + sourceIndex + 1;
 
-    const unsigned continuity_counter =
-        mSources.editItemAt(sourceIndex)->incrementContinuityCounter();
-
     // XXX if there are multiple streams of a kind (more than 1 audio or
     // more than 1 video) they need distinct stream_ids.
     const unsigned stream_id =
@@ -884,7 +871,19 @@ void MPEG2TSWriter::writeAccessUnit(
         PES_packet_length = 0;
     }
 
-    uint8_t *ptr = buffer->data();
+    // The first packet carries the 14 byte PES header and up to 170 bytes of
+    // the access unit, the following ones up to 184 bytes each; all of them
+    // are laid out in the output buffer and written at once.
+    size_t numPackets = 1;
+    if (accessUnit->size() > 188 - 18) {
+        numPackets += (accessUnit->size() - (188 - 18) + 183) / 184;
+    }
+    uint8_t *packet = appendPackets(numPackets);
+
+    const unsigned continuity_counter =
+        mSources.editItemAt(sourceIndex)->incrementContinuityCounter();
+
+    uint8_t *ptr = packet;
     *ptr++ = 0x47;
     *ptr++ = 0x40 | (PID >> 8);
     *ptr++ = PID & 0xff;
@@ -894,6 +893,7 @@ void MPEG2TSWriter::writeAccessUnit(
         *ptr++ = paddingSize - 1;
         if (paddingSize >= 2) {
             *ptr++ = 0x00;
+            memset(ptr, 0xff, paddingSize - 2);
             ptr += paddingSize - 2;
         }
     }
@@ -912,7 +912,7 @@ void MPEG2TSWriter::writeAccessUnit(
     *ptr++ = (PTS >> 7) & 0xff;
     *ptr++ = ((PTS & 0x7f) << 1) | 1;
 
-    size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+    size_t sizeLeft = packet + kTSPacketSize - ptr;
     size_t copy = accessUnit->size();
     if (copy > sizeLeft) {
         copy = sizeLeft;
@@ -920,8 +920,6 @@ void MPEG2TSWriter::writeAccessUnit(
 
     memcpy(ptr, accessUnit->data(), copy);
 
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), buffer->size());
-
     size_t offset = copy;
     while (offset < accessUnit->size()) {
         bool lastAccessUnit = ((accessUnit->size() - offset) < 184);
@@ -936,12 +934,12 @@ void MPEG2TSWriter::writeAccessUnit(
         // continuity_counter = b????
         // the fragment of "buffer" follows.
 
-        memset(buffer->data(), 0xff, buffer->size());
+        packet += kTSPacketSize;
 
         const unsigned continuity_counter =
             mSources.editItemAt(sourceIndex)->incrementContinuityCounter();
 
-        ptr = buffer->data();
+        ptr = packet;
         *ptr++ = 0x47;
         *ptr++ = 0x00 | (PID >> 8);
         *ptr++ = PID & 0xff;
@@ -954,33 +952,73 @@ void MPEG2TSWriter::writeAccessUnit(
             *ptr++ = paddingSize - 1;
             if (paddingSize >= 2) {
                 *ptr++ = 0x00;
+                memset(ptr, 0xff, paddingSize - 2);
                 ptr += paddingSize - 2;
             }
         }
 
-        size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+        size_t sizeLeft = packet + kTSPacketSize - ptr;
         size_t copy = accessUnit->size() - offset;
         if (copy > sizeLeft) {
             copy = sizeLeft;
         }
 
         memcpy(ptr, accessUnit->data() + offset, copy);
-        CHECK_EQ(internalWrite(buffer->data(), buffer->size()),
-                 buffer->size());
 
         offset += copy;
     }
+    CHECK(packet + kTSPacketSize == mOutputBuffer->data() + mOutputBuffer->size());
+
+    flushPackets();
 }
 
 void MPEG2TSWriter::writeTS() {
     if (mNumTSPacketsWritten >= mNumTSPacketsBeforeMeta) {
-        writeProgramAssociationTable();
-        writeProgramMap();
+        // Only the continuity counters change from one PAT/PMT to the
+        // next, and they are not covered by the CRC.
+        uint8_t *packet = appendPackets(2);
+
+        if (++mPATContinuityCounter == 16) {
+            mPATContinuityCounter = 0;
+        }
+        memcpy(packet, mPATPacket, kTSPacketSize);
+        packet[3] |= mPATContinuityCounter;
+        packet += kTSPacketSize;
+
+        if (++mPMTContinuityCounter == 16) {
+            mPMTContinuityCounter = 0;
+        }
+        memcpy(packet, mPMTPacket, kTSPacketSize);
+        packet[3] |= mPMTContinuityCounter;
 
         mNumTSPacketsBeforeMeta = mNumTSPacketsWritten + 2500;
     }
 }
 
+uint8_t *MPEG2TSWriter::appendPackets(size_t numPackets) {
+    size_t size = mOutputBuffer->size() + numPackets * kTSPacketSize;
+    if (size > mOutputBuffer->capacity()) {
+        sp<ABuffer> buffer = new ABuffer(size + size / 2);
+        memcpy(buffer->data(), mOutputBuffer->data(), mOutputBuffer->size());
+        buffer->setRange(0, mOutputBuffer->size());
+        mOutputBuffer = buffer;
+    }
+
+    uint8_t *packets = mOutputBuffer->data() + mOutputBuffer->size();
+    mOutputBuffer->setRange(0, size);
+    mNumTSPacketsWritten += numPackets;
+    return packets;
+}
+
+void MPEG2TSWriter::flushPackets() {
+    if (mOutputBuffer->size() == 0) {
+        return;
+    }
+    CHECK_EQ(internalWrite(mOutputBuffer->data(), mOutputBuffer->size()),
+             (ssize_t)mOutputBuffer->size());
+    mOutputBuffer->setRange(0, 0);
+}
+
 void MPEG2TSWriter::initCrcTable() {
     uint32_t poly = 0x04C11DB7;
 
@@ -40,6 +40,7 @@
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MetaData.h>
+#include <utils/FileMap.h>
 #include <utils/String8.h>
 
 #include <byteswap.h>
@@ -70,6 +71,7 @@ public:
                 int32_t timeScale,
                 const sp<SampleTable> &sampleTable,
                 Vector<SidxEntry> &sidx,
+                const Vector<FragmentEntry> &fragments,
                 const Trex *trex,
                 off64_t firstMoofOffset);
 
@@ -97,6 +99,9 @@ private:
     uint32_t mCurrentSampleIndex;
     uint32_t mCurrentFragmentIndex;
     Vector<SidxEntry> &mSegments;
+    // the fragments a seek can go to directly, from the sidx entries if there are, or else
+    // from the tfra box of the track
+    Vector<FragmentEntry> mFragments;
     const Trex *mTrex;
     off64_t mFirstMoofOffset;
     off64_t mCurrentMoofOffset;
@@ -192,6 +197,10 @@ struct MPEG4DataSource : public DataSource {
     virtual uint32_t flags();
 
     status_t setCachedRange(off64_t offset, size_t size);
+    // like setCachedRange(), with the range mapped from the file instead of read in memory
+    status_t setMappedRange(off64_t offset, size_t size);
+
+    virtual FileMap *mapRange(off64_t offset, size_t size);
 
 protected:
     virtual ~MPEG4DataSource();
@@ -203,6 +212,7 @@ private:
     off64_t mCachedOffset;
     size_t mCachedSize;
     uint8_t *mCache;
+    FileMap *mCacheMap;  // mapping backing mCache, if mapped
 
     void clearCache();
 
@@ -214,7 +224,8 @@ MPEG4DataSource::MPEG4DataSource(const sp<DataSource> &source)
     : mSource(source),
       mCachedOffset(0),
       mCachedSize(0),
-      mCache(NULL) {
+      mCache(NULL),
+      mCacheMap(NULL) {
 }
 
 MPEG4DataSource::~MPEG4DataSource() {
@@ -222,10 +233,13 @@ MPEG4DataSource::~MPEG4DataSource() {
 }
 
 void MPEG4DataSource::clearCache() {
-    if (mCache) {
+    if (mCacheMap) {
+        delete mCacheMap;
+        mCacheMap = NULL;
+    } else if (mCache) {
         free(mCache);
-        mCache = NULL;
     }
+    mCache = NULL;
 
     mCachedOffset = 0;
     mCachedSize = 0;
@@ -254,6 +268,10 @@ uint32_t MPEG4DataSource::flags() {
     return mSource->flags();
 }
 
+FileMap *MPEG4DataSource::mapRange(off64_t offset, size_t size) {
+    return mSource->mapRange(offset, size);
+}
+
 status_t MPEG4DataSource::setCachedRange(off64_t offset, size_t size) {
     Mutex::Autolock autoLock(mLock);
 
@@ -279,6 +297,23 @@ status_t MPEG4DataSource::setCachedRange(off64_t offset, size_t size) {
     return OK;
 }
 
+status_t MPEG4DataSource::setMappedRange(off64_t offset, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    clearCache();
+
+    mCacheMap = mSource->mapRange(offset, size);
+    if (mCacheMap == NULL) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    mCache = (uint8_t *)mCacheMap->getDataPtr();
+    mCachedOffset = offset;
+    mCachedSize = size;
+
+    return OK;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 static const bool kUseHexDump = false;
@@ -544,6 +579,14 @@ status_t MPEG4Extractor::readMetaData() {
         }
     }
 
+    if (mInitCheck == OK && mMoofOffset > 0 && mSidxEntries.size() == 0) {
+        // without it, the fragmented files without sidx can only be seeked to the start
+        status_t mfraErr = parseMovieFragmentRandomAccess();
+        if (mfraErr != OK && mfraErr != ERROR_UNSUPPORTED) {
+            ALOGW("ignoring malformed mfra box (%d)", mfraErr);
+        }
+    }
+
     if (mInitCheck == OK) {
         if (findTrackByMimePrefix("video/") != NULL) {
             mFileMetaData->setCString(
@@ -953,6 +996,15 @@ status_t MPEG4Extractor::parseChunk(off64_t *offset, int depth) {
                     if (cachedSource->setCachedRange(*offset, chunk_size) == OK) {
                         mDataSource = cachedSource;
                     }
+                } else {
+                    // Local files: the sample tables are read from a mapping of the file,
+                    // the pages touched by the lookups only, rather than with a read per sample.
+                    sp<MPEG4DataSource> mappedSource =
+                        new MPEG4DataSource(mDataSource);
+
+                    if (mappedSource->setMappedRange(*offset, chunk_size) == OK) {
+                        mDataSource = mappedSource;
+                    }
                 }
 
                 if (mLastTrack == NULL)
@@ -2482,6 +2534,143 @@ status_t MPEG4Extractor::parseSegmentIndex(off64_t offset, size_t size) {
     return OK;
 }
 
+static uint64_t U_AT(const uint8_t *ptr, size_t size) {
+    uint64_t x = 0;
+    for (size_t i = 0; i < size; i++) {
+        x = (x << 8) | ptr[i];
+    }
+    return x;
+}
+
+// The mfra box at the end of a fragmented file locates the fragments of each track, for
+// the files without sidx boxes. Its size is in the mfro box which ends it.
+status_t MPEG4Extractor::parseMovieFragmentRandomAccess() {
+    off64_t fileSize;
+    if (mDataSource->getSize(&fileSize) != OK || fileSize < 16) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    uint32_t mfroSize, mfroType, mfraSize;
+    if (!mDataSource->getUInt32(fileSize - 16, &mfroSize)
+            || !mDataSource->getUInt32(fileSize - 12, &mfroType)
+            || !mDataSource->getUInt32(fileSize - 4, &mfraSize)) {
+        return ERROR_IO;
+    }
+    if (mfroSize != 16 || mfroType != FOURCC('m', 'f', 'r', 'o')) {
+        return ERROR_UNSUPPORTED;
+    }
+    if (mfraSize < 8 + 16 || mfraSize > fileSize) {
+        return ERROR_MALFORMED;
+    }
+
+    off64_t offset = fileSize - mfraSize;
+    uint32_t size, type;
+    if (!mDataSource->getUInt32(offset, &size)
+            || !mDataSource->getUInt32(offset + 4, &type)) {
+        return ERROR_IO;
+    }
+    if (size != mfraSize || type != FOURCC('m', 'f', 'r', 'a')) {
+        return ERROR_MALFORMED;
+    }
+
+    off64_t stopOffset = fileSize - 16;
+    offset += 8;
+    while (offset + 8 <= stopOffset) {
+        if (!mDataSource->getUInt32(offset, &size)
+                || !mDataSource->getUInt32(offset + 4, &type)) {
+            return ERROR_IO;
+        }
+        if (size < 8 || size > stopOffset - offset) {
+            return ERROR_MALFORMED;
+        }
+        if (type == FOURCC('t', 'f', 'r', 'a')) {
+            status_t err = parseTrackFragmentRandomAccess(offset + 8, size - 8);
+            if (err != OK) {
+                return err;
+            }
+        }
+        offset += size;
+    }
+
+    return OK;
+}
+
+status_t MPEG4Extractor::parseTrackFragmentRandomAccess(off64_t offset, size_t size) {
+    if (size < 16) {
+        return ERROR_MALFORMED;
+    }
+
+    uint32_t flags, trackId, lengths, numEntries;
+    if (!mDataSource->getUInt32(offset, &flags)
+            || !mDataSource->getUInt32(offset + 4, &trackId)
+            || !mDataSource->getUInt32(offset + 8, &lengths)
+            || !mDataSource->getUInt32(offset + 12, &numEntries)) {
+        return ERROR_IO;
+    }
+    offset += 16;
+    size -= 16;
+
+    Track *track = mFirstTrack;
+    int32_t id;
+    while (track != NULL
+            && !(track->meta->findInt32(kKeyTrackID, &id) && (uint32_t)id == trackId)) {
+        track = track->next;
+    }
+    if (track == NULL || track->timescale == 0 || !track->fragments.isEmpty()) {
+        return OK;
+    }
+
+    size_t timeSize = (flags >> 24) == 1 ? 8 : 4;
+    size_t trafNumberSize = ((lengths >> 4) & 3) + 1;
+    size_t trunNumberSize = ((lengths >> 2) & 3) + 1;
+    size_t sampleNumberSize = (lengths & 3) + 1;
+    size_t entrySize = 2 * timeSize + trafNumberSize + trunNumberSize + sampleNumberSize;
+    if (numEntries > size / entrySize) {
+        return ERROR_MALFORMED;
+    }
+
+    track->fragments.setCapacity(numEntries);
+    for (uint32_t i = 0; i < numEntries; i++) {
+        uint8_t entry[2 * 8 + 3 * 4];
+        if (mDataSource->readAt(offset, entry, entrySize) < (ssize_t)entrySize) {
+            track->fragments.clear();
+            return ERROR_IO;
+        }
+        offset += entrySize;
+
+        const uint8_t *ptr = entry;
+        uint64_t time = U_AT(ptr, timeSize);
+        ptr += timeSize;
+        uint64_t moofOffset = U_AT(ptr, timeSize);
+        ptr += timeSize;
+        uint64_t trafNumber = U_AT(ptr, trafNumberSize);
+        ptr += trafNumberSize;
+        uint64_t trunNumber = U_AT(ptr, trunNumberSize);
+        ptr += trunNumberSize;
+        uint64_t sampleNumber = U_AT(ptr, sampleNumberSize);
+
+        // only the sync samples starting a fragment can be seeked to
+        if (trafNumber != 1 || trunNumber != 1 || sampleNumber != 1
+                || time > (uint64_t)INT64_MAX / 1000000 || moofOffset > (uint64_t)INT64_MAX) {
+            continue;
+        }
+
+        FragmentEntry fragment;
+        fragment.mTimeUs = time * 1000000ll / track->timescale;
+        fragment.mMoofOffset = moofOffset;
+        if (!track->fragments.isEmpty()
+                && (fragment.mTimeUs <= track->fragments.top().mTimeUs
+                    || fragment.mMoofOffset <= track->fragments.top().mMoofOffset)) {
+            ALOGW("tfra entries out of order, ignoring the entry %u", i);
+            continue;
+        }
+        track->fragments.push(fragment);
+    }
+    ALOGV("tfra: %zu fragments for track %u", track->fragments.size(), trackId);
+
+    return OK;
+}
+
 status_t MPEG4Extractor::parseQTMetaKey(off64_t offset, size_t size) {
     if (size < 8) {
         return ERROR_MALFORMED;
@@ -3174,9 +3363,15 @@ sp<IMediaSource> MPEG4Extractor::getTrack(size_t index) {
         }
     }
 
+    // Only the headers of the sample tables are parsed by readMetaData(), the tables of the
+    // tracks which are not selected are never read.
+    if (track->sampleTable != NULL && track->sampleTable->loadTables() != OK) {
+        return NULL;
+    }
+
     return new MPEG4Source(this,
             track->meta, mDataSource, track->timescale, track->sampleTable,
-            mSidxEntries, trex, mMoofOffset);
+            mSidxEntries, track->fragments, trex, mMoofOffset);
 }
 
 // static
@@ -3560,6 +3755,7 @@ MPEG4Source::MPEG4Source(
         int32_t timeScale,
         const sp<SampleTable> &sampleTable,
         Vector<SidxEntry> &sidx,
+        const Vector<FragmentEntry> &fragments,
         const Trex *trex,
         off64_t firstMoofOffset)
     : mOwner(owner),
@@ -3637,6 +3833,21 @@ MPEG4Source::MPEG4Source(
 
     CHECK(format->findInt32(kKeyTrackID, &mTrackId));
 
+    if (mSegments.size() != 0) {
+        FragmentEntry entry;
+        entry.mTimeUs = 0;
+        entry.mMoofOffset = mFirstMoofOffset;
+        for (size_t i = 0; i < mSegments.size(); i++) {
+            mFragments.push(entry);
+            entry.mTimeUs += mSegments[i].mDurationUs;
+            entry.mMoofOffset += mSegments[i].mSize;
+        }
+        // the end of the last segment
+        mFragments.push(entry);
+    } else {
+        mFragments = fragments;
+    }
+
     if (mFirstMoofOffset != 0) {
         off64_t offset = mFirstMoofOffset;
         parseChunk(&offset);
@@ -4629,34 +4840,39 @@ status_t MPEG4Source::fragmentedRead(
     ReadOptions::SeekMode mode;
     if (options && options->getSeekTo(&seekTimeUs, &mode)) {
 
-        int numSidxEntries = mSegments.size();
-        if (numSidxEntries != 0) {
-            int64_t totalTime = 0;
-            off64_t totalOffset = mFirstMoofOffset;
-            for (int i = 0; i < numSidxEntries; i++) {
-                const SidxEntry *se = &mSegments[i];
-                if (totalTime + se->mDurationUs > seekTimeUs) {
-                    // The requested time is somewhere in this segment
-                    if ((mode == ReadOptions::SEEK_NEXT_SYNC && seekTimeUs > totalTime) ||
+        size_t numFragments = mFragments.size();
+        if (numFragments != 0) {
+            // the last fragment starting at or before the requested time
+            size_t left = 0;
+            size_t right_plus_one = numFragments;
+            while (left < right_plus_one) {
+                size_t center = left + (right_plus_one - left) / 2;
+                if (mFragments[center].mTimeUs <= seekTimeUs) {
+                    left = center + 1;
+                } else {
+                    right_plus_one = center;
+                }
+            }
+            size_t i = left > 0 ? left - 1 : 0;
+            if (i + 1 < numFragments && seekTimeUs > mFragments[i].mTimeUs) {
+                int64_t startTimeUs = mFragments[i].mTimeUs;
+                int64_t endTimeUs = mFragments[i + 1].mTimeUs;
+                if (mode == ReadOptions::SEEK_NEXT_SYNC ||
                         (mode == ReadOptions::SEEK_CLOSEST_SYNC &&
-                        (seekTimeUs - totalTime) > (totalTime + se->mDurationUs - seekTimeUs))) {
-                        // requested next sync, or closest sync and it was closer to the end of
-                        // this segment
-                        totalTime += se->mDurationUs;
-                        totalOffset += se->mSize;
-                    }
-                    break;
+                        (seekTimeUs - startTimeUs) > (endTimeUs - seekTimeUs))) {
+                    // requested next sync, or closest sync and it was closer to the end of
+                    // this fragment
+                    ++i;
                 }
-                totalTime += se->mDurationUs;
-                totalOffset += se->mSize;
             }
-            mCurrentMoofOffset = totalOffset;
+            off64_t moofOffset = mFragments[i].mMoofOffset;
+            mCurrentMoofOffset = moofOffset;
             mCurrentSamples.clear();
             mCurrentSampleIndex = 0;
-            parseChunk(&totalOffset);
-            mCurrentTime = totalTime * mTimescale / 1000000ll;
+            parseChunk(&moofOffset);
+            mCurrentTime = mFragments[i].mTimeUs * mTimescale / 1000000ll;
         } else {
-            // without sidx boxes, we can only seek to 0
+            // without sidx or mfra boxes, we can only seek to 0
             mCurrentMoofOffset = mFirstMoofOffset;
             mCurrentSamples.clear();
             mCurrentSampleIndex = 0;
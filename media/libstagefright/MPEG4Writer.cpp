@@ -46,6 +46,7 @@
 #include <media/mediarecorder.h>
 #include <cutils/properties.h>
 
+#include "include/AsyncFileWriter.h"
 #include "include/ESDS.h"
 #include "include/HevcUtils.h"
 #include "include/avc_utils.h"
@@ -70,6 +71,15 @@ static const uint8_t kNalUnitTypeSeqParamSet = 0x07;
 static const uint8_t kNalUnitTypePicParamSet = 0x08;
 static const int64_t kInitialDelayTimeUs     = 700000LL;
 
+// Sample data is written to the file from a thread of its own, through
+// kDefaultNumIOBuffers buffers of kDefaultIOBufferSizeKB, so that a slow
+// storage does not hold the writer thread, and the encoder buffers with it.
+// Set media.mp4writer.io-buffers to 0 to write directly.
+static const int32_t kDefaultNumIOBuffers   = 4;
+static const int32_t kDefaultIOBufferSizeKB = 1024;
+
+static const int64_t kMaxFragmentDurationMs = 60000;
+
 static const char kMetaKey_Version[]    = "com.android.version";
 #ifdef SHOW_MODEL_BUILD
 static const char kMetaKey_Model[]      = "com.android.model";
@@ -108,6 +118,11 @@ public:
     int64_t getEstimatedTrackSizeBytes() const;
     void writeTrackHeader(bool use32BitOffset = true);
     void bufferChunk(int64_t timestampUs);
+
+    // Fragmented file only; call with the owner locked.
+    bool isReadyForFragments() const { return mFragmentReady; }
+    void writeTrexBox();
+    void writeTfraBox();
     bool isAvc() const { return mIsAvc; }
     bool isHevc() const { return mIsHevc; }
     bool isAudio() const { return mIsAudio; }
@@ -259,6 +274,154 @@ private:
         DISALLOW_EVIL_CONSTRUCTORS(ListTableEntries);
     };
 
+    // Table entries that are added once per sample or per chunk, stored in
+    // host byte order as the zigzag varint of their difference to the
+    // previous entry, in blocks allocated kBlockSize at a time.  Typically
+    // 1-3 bytes per value instead of sizeof(TYPE); values can only be
+    // appended, and read back by write().
+    template<class TYPE, unsigned ENTRY_SIZE>
+    struct CompactTableEntries {
+        static_assert(ENTRY_SIZE > 0, "ENTRY_SIZE must be positive");
+        CompactTableEntries()
+            : mTotalNumTableEntries(0),
+            mNumValuesInCurrEntry(0),
+            mCurrBlock(NULL),
+            mCurrBlockSize(0) {
+            memset(mLastValues, 0, sizeof(mLastValues));
+        }
+
+        ~CompactTableEntries() {
+            while (!mBlocks.empty()) {
+                delete[] mBlocks.begin()->mData;
+                mBlocks.erase(mBlocks.begin());
+            }
+        }
+
+        // Store a single value.
+        // @arg value in host byte order.
+        void add(TYPE value) {
+            if (mNumValuesInCurrEntry == 0
+                    && (mCurrBlock == NULL || kBlockSize - mCurrBlockSize < kMaxEntrySize)) {
+                // entries do not span blocks
+                if (mCurrBlock != NULL) {
+                    Block block = { mCurrBlock, mCurrBlockSize };
+                    mBlocks.push_back(block);
+                }
+                mCurrBlock = new uint8_t[kBlockSize];
+                mCurrBlockSize = 0;
+            }
+
+            int64_t delta = (int64_t)value - (int64_t)mLastValues[mNumValuesInCurrEntry];
+            mLastValues[mNumValuesInCurrEntry] = value;
+            uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+            while (zigzag >= 0x80) {
+                mCurrBlock[mCurrBlockSize++] = (zigzag & 0x7f) | 0x80;
+                zigzag >>= 7;
+            }
+            mCurrBlock[mCurrBlockSize++] = zigzag;
+
+            if (++mNumValuesInCurrEntry == ENTRY_SIZE) {
+                ++mTotalNumTableEntries;
+                mNumValuesInCurrEntry = 0;
+            }
+        }
+
+        // Write out the table entries:
+        // 1. the number of entries goes first
+        // 2. followed by the values in the table entries in order, in
+        // network byte order
+        // @arg writer the writer to actual write to the storage
+        // @arg update if set, adjusts each entry before it is written
+        void write(MPEG4Writer *writer,
+                std::function<void(TYPE(& /* entry */)[ENTRY_SIZE])> update = nullptr) const {
+            CHECK_EQ(mNumValuesInCurrEntry, 0);
+            writer->writeInt32(mTotalNumTableEntries);
+
+            TYPE out[kWriteBatchSize][ENTRY_SIZE];
+            size_t numOut = 0;
+            TYPE values[ENTRY_SIZE];
+            memset(values, 0, sizeof(values));
+
+            typename List<Block>::iterator it = mBlocks.begin();
+            for (;;) {
+                const uint8_t *data;
+                size_t size;
+                if (it != mBlocks.end()) {
+                    data = it->mData;
+                    size = it->mSize;
+                    ++it;
+                } else if (mCurrBlock != NULL) {
+                    data = mCurrBlock;
+                    size = mCurrBlockSize;
+                } else {
+                    break;
+                }
+
+                size_t offset = 0;
+                while (offset < size) {
+                    for (size_t i = 0; i < ENTRY_SIZE; ++i) {
+                        uint64_t zigzag = 0;
+                        unsigned shift = 0;
+                        uint8_t byte;
+                        do {
+                            CHECK_LT(offset, size);
+                            byte = data[offset++];
+                            zigzag |= (uint64_t)(byte & 0x7f) << shift;
+                            shift += 7;
+                        } while (byte & 0x80);
+                        int64_t delta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+                        values[i] = (int64_t)values[i] + delta;
+                        out[numOut][i] = values[i];
+                    }
+                    if (update != nullptr) {
+                        update(out[numOut]);
+                    }
+                    for (size_t i = 0; i < ENTRY_SIZE; ++i) {
+                        out[numOut][i] = HostToNetwork(out[numOut][i]);
+                    }
+                    if (++numOut == kWriteBatchSize) {
+                        writer->write(out, sizeof(TYPE) * ENTRY_SIZE, numOut);
+                        numOut = 0;
+                    }
+                }
+
+                if (data == mCurrBlock) {
+                    break;
+                }
+            }
+            if (numOut > 0) {
+                writer->write(out, sizeof(TYPE) * ENTRY_SIZE, numOut);
+            }
+        }
+
+        // Return the number of entries in the table.
+        uint32_t count() const { return mTotalNumTableEntries; }
+
+    private:
+        enum {
+            kBlockSize = 4096,
+            kMaxEntrySize = 10 * ENTRY_SIZE,  // 64-bit varints
+            kWriteBatchSize = 256,
+        };
+
+        struct Block {
+            uint8_t *mData;
+            size_t mSize;
+        };
+
+        static uint32_t HostToNetwork(uint32_t value) { return htonl(value); }
+        static off64_t HostToNetwork(off64_t value) { return hton64(value); }
+
+        uint32_t         mTotalNumTableEntries;
+        uint32_t         mNumValuesInCurrEntry;  // up to ENTRY_SIZE
+        TYPE             mLastValues[ENTRY_SIZE];
+        uint8_t          *mCurrBlock;
+        size_t           mCurrBlockSize;
+        mutable List<Block> mBlocks;
+
+        DISALLOW_EVIL_CONSTRUCTORS(CompactTableEntries);
+    };
+
 
 
     MPEG4Writer *mOwner;
@@ -288,18 +451,41 @@ private:
     List<MediaBuffer *> mChunkSamples;
 
     bool                mSamplesHaveSameSize;
-    ListTableEntries<uint32_t, 1> *mStszTableEntries;
+    CompactTableEntries<uint32_t, 1> *mStszTableEntries;
 
-    ListTableEntries<uint32_t, 1> *mStcoTableEntries;
-    ListTableEntries<off64_t, 1> *mCo64TableEntries;
+    CompactTableEntries<uint32_t, 1> *mStcoTableEntries;
+    CompactTableEntries<off64_t, 1> *mCo64TableEntries;
     ListTableEntries<uint32_t, 3> *mStscTableEntries;
-    ListTableEntries<uint32_t, 1> *mStssTableEntries;
+    CompactTableEntries<uint32_t, 1> *mStssTableEntries;
     ListTableEntries<uint32_t, 2> *mSttsTableEntries;
-    ListTableEntries<uint32_t, 2> *mCttsTableEntries;
+    CompactTableEntries<uint32_t, 2> *mCttsTableEntries;
 
     int64_t mMinCttsOffsetTimeUs;
     int64_t mMaxCttsOffsetTimeUs;
 
+    // Samples of the fragment being built, in a fragmented file.
+    struct FragmentSample {
+        MediaBuffer *mBuffer;
+        int64_t mDecodingTimeTicks;  // since the start of the track
+        int32_t mCompositionOffsetTicks;
+        uint32_t mSize;
+        bool mIsSync;
+    };
+    List<FragmentSample> mFragmentSamples;
+    int64_t mFragmentStartTimeUs;
+    int64_t mStartTimeOffsetTicks;
+    bool mFragmentReady;  // got the first sample, set with the owner locked
+
+    // Fragments starting with a sync sample, for the tfra box.
+    struct TfraEntry {
+        int64_t mTimeTicks;
+        off64_t mMoofOffset;
+    };
+    Vector<TfraEntry> mTfraEntries;
+
+    uint32_t mNumSamples;
+    uint32_t mNumSyncSamples;
+
     // Sequence parameter set or picture parameter set
     struct AVCParamSet {
         AVCParamSet(uint16_t length, const uint8_t *data)
@@ -365,6 +551,7 @@ private:
     int32_t mRotation;
 
     void updateTrackSizeEstimate();
+    bool writeFragment(int64_t nextDecodingTimeTicks, bool eos = false);
     void addOneStscTableEntry(size_t chunkId, size_t sampleId);
     void addOneStssTableEntry(size_t sampleId);
 
@@ -432,6 +619,11 @@ MPEG4Writer::MPEG4Writer(int fd)
       mLongitudex10000(0),
       mAreGeoTagsAvailable(false),
       mStartTimeOffsetMs(-1),
+      mFileWriter(NULL),
+      mFragmentDurationUs(0),
+      mFragmentedMoovWritten(false),
+      mFragmentSequenceNumber(0),
+      mMehdOffset(0),
       mMetaKeys(new AMessage()) {
     addDeviceMeta();
 
@@ -743,13 +935,26 @@ status_t MPEG4Writer::start(MetaData *param) {
     CHECK_GT(mTimeScale, 0);
     ALOGV("movie time scale: %d", mTimeScale);
 
+    // Fragmented recordings survive a crash of the recorder and do not keep
+    // the sample tables in memory, which suits long recordings.
+    mFragmentDurationUs = 0;
+    int64_t fragmentDurationUs;
+    if (param && param->findInt64(kKeyFragmentDurationUs, &fragmentDurationUs)) {
+        mFragmentDurationUs = std::max(fragmentDurationUs, (int64_t)0);
+    } else if (mIsRealTimeRecording) {
+        int64_t fragmentDurationMs = property_get_int64("media.mp4writer.fragment-ms", 0);
+        if (fragmentDurationMs > 0 && fragmentDurationMs <= kMaxFragmentDurationMs) {
+            mFragmentDurationUs = fragmentDurationMs * 1000;
+        }
+    }
+
     /*
      * When the requested file size limit is small, the priority
      * is to meet the file size limit requirement, rather than
      * to make the file streamable. mStreamableFile does not tell
      * whether the actual recorded file is streamable or not.
      */
-    mStreamableFile =
+    mStreamableFile = !isFragmented() &&
         (mMaxFileSizeLimitBytes != 0 &&
          mMaxFileSizeLimitBytes >= kMinStreamableFileSizeInBytes);
 
@@ -793,34 +998,44 @@ status_t MPEG4Writer::start(MetaData *param) {
     mMoovBoxBuffer = NULL;
     mMoovBoxBufferOffset = 0;
 
+    startFileWriter();
+
     writeFtypBox(param);
 
-    mFreeBoxOffset = mOffset;
+    if (isFragmented()) {
+        ALOGI("writing fragments of %" PRId64 " us", mFragmentDurationUs);
+        mFragmentedMoovWritten = false;
+        mFragmentSequenceNumber = 0;
+        mFreeBoxOffset = mOffset;
+        mMdatOffset = mOffset;
+    } else {
+        mFreeBoxOffset = mOffset;
 
-    if (mEstimatedMoovBoxSize == 0) {
-        int32_t bitRate = -1;
-        if (param) {
-            param->findInt32(kKeyBitRate, &bitRate);
+        if (mEstimatedMoovBoxSize == 0) {
+            int32_t bitRate = -1;
+            if (param) {
+                param->findInt32(kKeyBitRate, &bitRate);
+            }
+            mEstimatedMoovBoxSize = estimateMoovBoxSize(bitRate);
+        }
+        CHECK_GE(mEstimatedMoovBoxSize, 8);
+        if (mStreamableFile) {
+            // Reserve a 'free' box only for streamable file
+            seekFile(mFreeBoxOffset);
+            writeInt32(mEstimatedMoovBoxSize);
+            write("free", 4);
+            mMdatOffset = mFreeBoxOffset + mEstimatedMoovBoxSize;
+        } else {
+            mMdatOffset = mOffset;
         }
-        mEstimatedMoovBoxSize = estimateMoovBoxSize(bitRate);
-    }
-    CHECK_GE(mEstimatedMoovBoxSize, 8);
-    if (mStreamableFile) {
-        // Reserve a 'free' box only for streamable file
-        lseek64(mFd, mFreeBoxOffset, SEEK_SET);
-        writeInt32(mEstimatedMoovBoxSize);
-        write("free", 4);
-        mMdatOffset = mFreeBoxOffset + mEstimatedMoovBoxSize;
-    } else {
-        mMdatOffset = mOffset;
-    }
 
-    mOffset = mMdatOffset;
-    lseek64(mFd, mMdatOffset, SEEK_SET);
-    if (mUse32BitOffset) {
-        write("????mdat", 8);
-    } else {
-        write("\x00\x00\x00\x01mdat????????", 16);
+        mOffset = mMdatOffset;
+        seekFile(mMdatOffset);
+        if (mUse32BitOffset) {
+            write("????mdat", 8);
+        } else {
+            write("\x00\x00\x00\x01mdat????????", 16);
+        }
     }
 
     status_t err = startWriterThread();
@@ -928,7 +1143,38 @@ void MPEG4Writer::writeCompositionMatrix(int degrees) {
     writeInt32(0x40000000);  // w
 }
 
+void MPEG4Writer::startFileWriter() {
+    if (mFileWriter != NULL) {
+        return;
+    }
+
+    mFileWriter = AsyncFileWriter::CreateFromProperties(
+            mFd, "media.mp4writer", kDefaultIOBufferSizeKB, kDefaultNumIOBuffers);
+}
+
+void MPEG4Writer::stopFileWriter() {
+    AsyncFileWriter::Release(mFileWriter);
+    mFileWriter = NULL;
+}
+
+void MPEG4Writer::writeFile(const void *data, size_t size) {
+    if (mFileWriter != NULL) {
+        mFileWriter->write(data, size);
+    } else {
+        ::write(mFd, data, size);
+    }
+}
+
+void MPEG4Writer::seekFile(off64_t offset) {
+    if (mFileWriter != NULL) {
+        mFileWriter->seek(offset);
+    } else {
+        lseek64(mFd, offset, SEEK_SET);
+    }
+}
+
 void MPEG4Writer::release() {
+    stopFileWriter();
     close(mFd);
     mFd = -1;
     mInitCheck = NO_INIT;
@@ -983,18 +1229,24 @@ status_t MPEG4Writer::reset() {
         return err;
     }
 
+    if (isFragmented()) {
+        finishFragmentedFile(maxDurationUs);
+        release();
+        return err;
+    }
+
     // Fix up the size of the 'mdat' chunk.
     if (mUse32BitOffset) {
-        lseek64(mFd, mMdatOffset, SEEK_SET);
+        seekFile(mMdatOffset);
         uint32_t size = htonl(static_cast<uint32_t>(mOffset - mMdatOffset));
-        ::write(mFd, &size, 4);
+        writeFile(&size, 4);
     } else {
-        lseek64(mFd, mMdatOffset + 8, SEEK_SET);
+        seekFile(mMdatOffset + 8);
         uint64_t size = mOffset - mMdatOffset;
         size = hton64(size);
-        ::write(mFd, &size, 8);
+        writeFile(&size, 8);
     }
-    lseek64(mFd, mOffset, SEEK_SET);
+    seekFile(mOffset);
 
     // Construct moov box now
     mMoovBoxBufferOffset = 0;
@@ -1018,12 +1270,12 @@ status_t MPEG4Writer::reset() {
         CHECK_LE(mMoovBoxBufferOffset + 8, mEstimatedMoovBoxSize);
 
         // Moov box
-        lseek64(mFd, mFreeBoxOffset, SEEK_SET);
+        seekFile(mFreeBoxOffset);
         mOffset = mFreeBoxOffset;
         write(mMoovBoxBuffer, 1, mMoovBoxBufferOffset);
 
         // Free box
-        lseek64(mFd, mOffset, SEEK_SET);
+        seekFile(mOffset);
         writeInt32(mEstimatedMoovBoxSize - mMoovBoxBufferOffset);
         write("free", 4);
     } else {
@@ -1093,9 +1345,76 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
         it != mTracks.end(); ++it, ++id) {
         (*it)->writeTrackHeader(mUse32BitOffset);
     }
+    if (isFragmented()) {
+        writeMvexBox();
+    }
     endBox();  // moov
 }
 
+void MPEG4Writer::writeMvexBox() {
+    beginBox("mvex");
+    mMehdOffset = mOffset;
+    beginBox("mehd");
+    writeInt32(0x01000000);  // version=1, flags=0
+    writeInt64(0);           // fragment duration, set by finishFragmentedFile()
+    endBox();  // mehd
+    for (List<Track *>::iterator it = mTracks.begin();
+        it != mTracks.end(); ++it) {
+        (*it)->writeTrexBox();
+    }
+    endBox();  // mvex
+}
+
+bool MPEG4Writer::tracksReadyForFragments_l() {
+    for (List<Track *>::iterator it = mTracks.begin();
+         it != mTracks.end(); ++it) {
+        if (!(*it)->isReadyForFragments()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The sample descriptions of all the tracks go in the moov box, which must
+// precede the first fragment.
+void MPEG4Writer::writeFragmentedMoovBox_l() {
+    CHECK(!mFragmentedMoovWritten);
+    writeMoovBox(0);
+    mFragmentedMoovWritten = true;
+}
+
+void MPEG4Writer::onFragmentWritten_l() {
+    // the file is playable up to the end of this fragment once it is out
+    // of the process
+    if (mFileWriter != NULL) {
+        mFileWriter->submit();
+    }
+}
+
+void MPEG4Writer::finishFragmentedFile(int64_t durationUs) {
+    if (!mFragmentedMoovWritten) {
+        writeFragmentedMoovBox_l();
+    }
+
+    off64_t mfraOffset = mOffset;
+    beginBox("mfra");
+    for (List<Track *>::iterator it = mTracks.begin();
+         it != mTracks.end(); ++it) {
+        (*it)->writeTfraBox();
+    }
+    writeInt32(16);
+    writeFourcc("mfro");
+    writeInt32(0);  // version=0, flags=0
+    writeInt32(mOffset + 4 - mfraOffset);  // size of the mfra box
+    endBox();  // mfra
+
+    off64_t endOffset = mOffset;
+    seekFile(mMehdOffset + 12);
+    writeInt64((durationUs * mTimeScale + 500000LL) / 1000000LL);
+    mOffset = endOffset;
+    seekFile(mOffset);
+}
+
 void MPEG4Writer::writeFtypBox(MetaData *param) {
     beginBox("ftyp");
 
@@ -1162,9 +1481,8 @@ void MPEG4Writer::unlock() {
 off64_t MPEG4Writer::addSample_l(MediaBuffer *buffer) {
     off64_t old_offset = mOffset;
 
-    ::write(mFd,
-          (const uint8_t *)buffer->data() + buffer->range_offset(),
-          buffer->range_length());
+    writeFile((const uint8_t *)buffer->data() + buffer->range_offset(),
+            buffer->range_length());
 
     mOffset += buffer->range_length();
 
@@ -1222,28 +1540,24 @@ off64_t MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
     size_t length = buffer->range_length();
 
     if (mUse4ByteNalLength) {
-        uint8_t x = length >> 24;
-        ::write(mFd, &x, 1);
-        x = (length >> 16) & 0xff;
-        ::write(mFd, &x, 1);
-        x = (length >> 8) & 0xff;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-
-        ::write(mFd,
-              (const uint8_t *)buffer->data() + buffer->range_offset(),
-              length);
+        uint8_t x[4];
+        x[0] = length >> 24;
+        x[1] = (length >> 16) & 0xff;
+        x[2] = (length >> 8) & 0xff;
+        x[3] = length & 0xff;
+        writeFile(x, 4);
+
+        writeFile((const uint8_t *)buffer->data() + buffer->range_offset(), length);
 
         mOffset += length + 4;
     } else {
         CHECK_LT(length, 65536);
 
-        uint8_t x = length >> 8;
-        ::write(mFd, &x, 1);
-        x = length & 0xff;
-        ::write(mFd, &x, 1);
-        ::write(mFd, (const uint8_t *)buffer->data() + buffer->range_offset(), length);
+        uint8_t x[2];
+        x[0] = length >> 8;
+        x[1] = length & 0xff;
+        writeFile(x, 2);
+        writeFile((const uint8_t *)buffer->data() + buffer->range_offset(), length);
         mOffset += length + 2;
     }
 
@@ -1269,9 +1583,9 @@ size_t MPEG4Writer::write(
                  it != mBoxes.end(); ++it) {
                 (*it) += mOffset;
             }
-            lseek64(mFd, mOffset, SEEK_SET);
-            ::write(mFd, mMoovBoxBuffer, mMoovBoxBufferOffset);
-            ::write(mFd, ptr, bytes);
+            seekFile(mOffset);
+            writeFile(mMoovBoxBuffer, mMoovBoxBufferOffset);
+            writeFile(ptr, bytes);
             mOffset += (bytes + mMoovBoxBufferOffset);
 
             // All subsequent moov box content will be written
@@ -1282,7 +1596,7 @@ size_t MPEG4Writer::write(
             mMoovBoxBufferOffset += bytes;
         }
     } else {
-        ::write(mFd, ptr, size * nmemb);
+        writeFile(ptr, bytes);
         mOffset += bytes;
     }
     return bytes;
@@ -1316,10 +1630,10 @@ void MPEG4Writer::endBox() {
        int32_t x = htonl(mMoovBoxBufferOffset - offset);
        memcpy(mMoovBoxBuffer + offset, &x, 4);
     } else {
-        lseek64(mFd, offset, SEEK_SET);
+        seekFile(offset);
         writeInt32(mOffset - offset);
         mOffset -= 4;
-        lseek64(mFd, mOffset, SEEK_SET);
+        seekFile(mOffset);
     }
 }
 
@@ -1542,13 +1856,18 @@ MPEG4Writer::Track::Track(
       mTrackDurationUs(0),
       mEstimatedTrackSizeBytes(0),
       mSamplesHaveSameSize(true),
-      mStszTableEntries(new ListTableEntries<uint32_t, 1>(1000)),
-      mStcoTableEntries(new ListTableEntries<uint32_t, 1>(1000)),
-      mCo64TableEntries(new ListTableEntries<off64_t, 1>(1000)),
+      mStszTableEntries(new CompactTableEntries<uint32_t, 1>()),
+      mStcoTableEntries(new CompactTableEntries<uint32_t, 1>()),
+      mCo64TableEntries(new CompactTableEntries<off64_t, 1>()),
       mStscTableEntries(new ListTableEntries<uint32_t, 3>(1000)),
-      mStssTableEntries(new ListTableEntries<uint32_t, 1>(1000)),
+      mStssTableEntries(new CompactTableEntries<uint32_t, 1>()),
       mSttsTableEntries(new ListTableEntries<uint32_t, 2>(1000)),
-      mCttsTableEntries(new ListTableEntries<uint32_t, 2>(1000)),
+      mCttsTableEntries(new CompactTableEntries<uint32_t, 2>()),
+      mFragmentStartTimeUs(0),
+      mStartTimeOffsetTicks(-1),
+      mFragmentReady(false),
+      mNumSamples(0),
+      mNumSyncSamples(0),
       mCodecSpecificData(NULL),
       mCodecSpecificDataSize(0),
       mGotAllCodecSpecificData(false),
@@ -1594,6 +1913,9 @@ void MPEG4Writer::Track::updateTrackSizeEstimate() {
                                     stcoBoxSizeBytes +           // stco box size
                                     stszBoxSizeBytes;            // stsz box size
     }
+    if (mOwner->isFragmented()) {
+        mEstimatedTrackSizeBytes += mNumSamples * 16;  // trun entries
+    }
 }
 
 void MPEG4Writer::Track::addOneStscTableEntry(
@@ -1605,7 +1927,7 @@ void MPEG4Writer::Track::addOneStscTableEntry(
 }
 
 void MPEG4Writer::Track::addOneStssTableEntry(size_t sampleId) {
-    mStssTableEntries->add(htonl(sampleId));
+    mStssTableEntries->add(sampleId);
 }
 
 void MPEG4Writer::Track::addOneSttsTableEntry(
@@ -1624,16 +1946,16 @@ void MPEG4Writer::Track::addOneCttsTableEntry(
     if (mIsAudio) {
         return;
     }
-    mCttsTableEntries->add(htonl(sampleCount));
-    mCttsTableEntries->add(htonl(duration));
+    mCttsTableEntries->add(sampleCount);
+    mCttsTableEntries->add(duration);
 }
 
 void MPEG4Writer::Track::addChunkOffset(off64_t offset) {
     if (mOwner->use32BitFileOffset()) {
         uint32_t value = offset;
-        mStcoTableEntries->add(htonl(value));
+        mStcoTableEntries->add(value);
     } else {
-        mCo64TableEntries->add(hton64(offset));
+        mCo64TableEntries->add(offset);
     }
 }
 
@@ -1704,6 +2026,11 @@ MPEG4Writer::Track::~Track() {
     mStssTableEntries = NULL;
     mCttsTableEntries = NULL;
 
+    while (!mFragmentSamples.empty()) {
+        mFragmentSamples.begin()->mBuffer->release();
+        mFragmentSamples.erase(mFragmentSamples.begin());
+    }
+
     if (mCodecSpecificData != NULL) {
         free(mCodecSpecificData);
         mCodecSpecificData = NULL;
@@ -2378,6 +2705,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     int64_t lastCttsOffsetTimeTicks = -1;  // Timescale based ticks
     int32_t cttsSampleCount = 0;           // Sample count in the current ctts table entry
     uint32_t lastSamplesPerChunk = 0;
+    int64_t lastDecodingTimeTicks = 0;    // Fragmented file only
 
     if (mIsAudio) {
         prctl(PR_SET_NAME, (unsigned long)"AudioTrackEncoding", 0, 0, 0);
@@ -2500,7 +2828,7 @@ status_t MPEG4Writer::Track::threadEntry() {
         CHECK(meta_data->findInt64(kKeyTime, &timestampUs));
 
 ////////////////////////////////////////////////////////////////////////////////
-        if (mStszTableEntries->count() == 0) {
+        if (mNumSamples == 0) {
             mFirstSampleTimeRealUs = systemTime() / 1000;
             mStartTimestampUs = timestampUs;
             mOwner->setStartTimestampUs(mStartTimestampUs);
@@ -2579,7 +2907,9 @@ status_t MPEG4Writer::Track::threadEntry() {
                 break;
             }
 
-            if (mStszTableEntries->count() == 0) {
+            if (mOwner->isFragmented()) {
+                // the offsets go to the trun boxes of the fragments instead
+            } else if (mNumSamples == 0) {
                 // Force the first ctts table entry to have one single entry
                 // so that we can do adjustment for the initial track start
                 // time offset easily in writeCttsBox().
@@ -2597,7 +2927,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
 
             // Update ctts time offset range
-            if (mStszTableEntries->count() == 0) {
+            if (mNumSamples == 0) {
                 mMinCttsOffsetTimeUs = currCttsOffsetTimeTicks;
                 mMaxCttsOffsetTimeUs = currCttsOffsetTimeTicks;
             } else {
@@ -2629,6 +2959,69 @@ status_t MPEG4Writer::Track::threadEntry() {
             mTrackDurationUs = timestampUs;
         }
 
+        if (mOwner->isFragmented()) {
+            int64_t decodingTimeTicks = (timestampUs * mTimeScale + 500000LL) / 1000000LL;
+            if (mNumSamples > 0 && decodingTimeTicks < lastDecodingTimeTicks) {
+                ALOGE("do not support out of order frames (timestamp: %lld < last: %lld for %s track",
+                        (long long)timestampUs, (long long)lastTimestampUs, trackName);
+                copy->release();
+                mSource->stop();
+                mIsMalformed = true;
+                break;
+            }
+
+            // Cut the audio fragments when they are long enough, and the
+            // video ones at the next sync frame; unless there is none for
+            // too long, as the samples are in memory until written.
+            int64_t fragmentDurationUs = timestampUs - mFragmentStartTimeUs;
+            if (!mFragmentSamples.empty()
+                    && ((fragmentDurationUs >= mOwner->mFragmentDurationUs
+                            && (mIsAudio || isSync))
+                        || fragmentDurationUs >= 4 * mOwner->mFragmentDurationUs)) {
+                writeFragment(decodingTimeTicks);
+            }
+
+            if (mFragmentSamples.empty()) {
+                mFragmentStartTimeUs = timestampUs;
+            }
+            FragmentSample sample;
+            sample.mBuffer = copy;
+            sample.mDecodingTimeTicks = decodingTimeTicks;
+            sample.mCompositionOffsetTicks = 0;
+            if (!mIsAudio) {
+                int64_t compositionTimeUs = timestampUs + cttsOffsetTimeUs - kMaxCttsOffsetTimeUs;
+                sample.mCompositionOffsetTicks =
+                    (compositionTimeUs * mTimeScale + 500000LL) / 1000000LL - decodingTimeTicks;
+            }
+            sample.mSize = sampleSize;
+            sample.mIsSync = mIsAudio || isSync;
+            mFragmentSamples.push_back(sample);
+            copy = NULL;
+
+            if (mNumSamples == 0) {
+                mOwner->lock();
+                mFragmentReady = true;
+                mOwner->unlock();
+            } else {
+                lastDurationTicks = decodingTimeTicks - lastDecodingTimeTicks;
+            }
+            ++mNumSamples;
+            if (isSync != 0) {
+                ++mNumSyncSamples;
+            }
+            lastDurationUs = timestampUs - lastTimestampUs;
+            lastTimestampUs = timestampUs;
+            lastDecodingTimeTicks = decodingTimeTicks;
+
+            if (mTrackingProgressStatus) {
+                if (mPreviousTrackTimeUs <= 0) {
+                    mPreviousTrackTimeUs = mStartTimestampUs;
+                }
+                trackProgressStatus(timestampUs);
+            }
+            continue;
+        }
+
         // We need to use the time scale based ticks, rather than the
         // timestamp itself to determine whether we have to use a new
         // stts entry, since we may have rounding errors.
@@ -2662,7 +3055,8 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
         }
 
-        mStszTableEntries->add(htonl(sampleSize));
+        mStszTableEntries->add(sampleSize);
+        ++mNumSamples;
         if (mStszTableEntries->count() > 2) {
 
             // Force the first sample to have its own stts entry so that
@@ -2689,6 +3083,7 @@ status_t MPEG4Writer::Track::threadEntry() {
 
         if (isSync != 0) {
             addOneStssTableEntry(mStszTableEntries->count());
+            ++mNumSyncSamples;
         }
 
         if (mTrackingProgressStatus) {
@@ -2746,6 +3141,11 @@ status_t MPEG4Writer::Track::threadEntry() {
 
     mOwner->trackProgressStatus(mTrackId, -1, err);
 
+    if (mOwner->isFragmented()) {
+        // The last sample lasts as long as the one before it.
+        writeFragment(lastDecodingTimeTicks + lastDurationTicks, true /* eos */);
+    }
+
     // Last chunk
     if (!hasMultipleTracks) {
         addOneStscTableEntry(1, mStszTableEntries->count());
@@ -2787,7 +3187,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     sendTrackSummary(hasMultipleTracks);
 
     ALOGI("Received total/0-length (%d/%d) buffers and encoded %d frames. - %s",
-            count, nZeroLengthFrames, mStszTableEntries->count(), trackName);
+            count, nZeroLengthFrames, mNumSamples, trackName);
     if (mIsAudio) {
         ALOGI("Audio track drift time: %" PRId64 " us", mOwner->getDriftTimeUs());
     }
@@ -2803,12 +3203,12 @@ bool MPEG4Writer::Track::isTrackMalFormed() const {
         return true;
     }
 
-    if (mStszTableEntries->count() == 0) {                      // no samples written
+    if (mNumSamples == 0) {                      // no samples written
         ALOGE("The number of recorded samples is 0");
         return true;
     }
 
-    if (!mIsAudio && mStssTableEntries->count() == 0) {  // no sync frames for video
+    if (!mIsAudio && mNumSyncSamples == 0) {  // no sync frames for video
         ALOGE("There are no sync frames for video track");
         return true;
     }
@@ -2839,7 +3239,7 @@ void MPEG4Writer::Track::sendTrackSummary(bool hasMultipleTracks) {
 
     mOwner->notify(MEDIA_RECORDER_TRACK_EVENT_INFO,
                     trackNum | MEDIA_RECORDER_TRACK_INFO_ENCODED_FRAMES,
-                    mStszTableEntries->count());
+                    mNumSamples);
 
     {
         // The system delay time excluding the requested initial delay that
@@ -2941,6 +3341,153 @@ void MPEG4Writer::Track::bufferChunk(int64_t timestampUs) {
     mChunkSamples.clear();
 }
 
+// Writes the pending samples as a moof/mdat pair, the last sample lasting
+// until nextDecodingTimeTicks.  The fragments wait for all the tracks to
+// start, since the moov box goes first, unless the track reached its end.
+bool MPEG4Writer::Track::writeFragment(int64_t nextDecodingTimeTicks, bool eos) {
+    if (mFragmentSamples.empty()) {
+        return true;
+    }
+
+    mOwner->lock();
+    bool ready = mOwner->mFragmentedMoovWritten || eos || mOwner->tracksReadyForFragments_l();
+    mOwner->unlock();
+    if (!ready) {
+        return false;
+    }
+
+    if (mStartTimeOffsetTicks < 0) {
+        // final once all the tracks started
+        mStartTimeOffsetTicks = getStartTimeOffsetScaledTime();
+    }
+
+    Mutex::Autolock autoLock(mOwner->mLock);
+    if (!mOwner->mFragmentedMoovWritten) {
+        mOwner->writeFragmentedMoovBox_l();
+    }
+
+    bool hasCompositionOffsets = false;
+    bool hasNegativeCompositionOffsets = false;
+    uint64_t mdatSize = 8;
+    for (List<FragmentSample>::iterator it = mFragmentSamples.begin();
+         it != mFragmentSamples.end(); ++it) {
+        if (it->mCompositionOffsetTicks != 0) {
+            hasCompositionOffsets = true;
+        }
+        if (it->mCompositionOffsetTicks < 0) {
+            hasNegativeCompositionOffsets = true;
+        }
+        mdatSize += it->mSize;
+    }
+    CHECK_LE(mdatSize, (uint64_t)UINT32_MAX);
+
+    // data offset, sample duration, size and flags present
+    uint32_t trunFlags = 0x000701;
+    size_t entrySize = 12;
+    if (hasCompositionOffsets) {
+        trunFlags |= 0x000800;  // sample composition time offsets present
+        entrySize += 4;
+    }
+    uint32_t numSamples = mFragmentSamples.size();
+    uint32_t trunSize = 20 + numSamples * entrySize;
+    uint32_t trafSize = 8 + 16 /* tfhd */ + 20 /* tfdt */ + trunSize;
+    uint32_t moofSize = 8 + 16 /* mfhd */ + trafSize;
+
+    int64_t baseTicks = mStartTimeOffsetTicks + mFragmentSamples.begin()->mDecodingTimeTicks;
+    off64_t moofOffset = mOwner->mOffset;
+    if (mFragmentSamples.begin()->mIsSync) {
+        TfraEntry entry;
+        entry.mTimeTicks = baseTicks + mFragmentSamples.begin()->mCompositionOffsetTicks;
+        entry.mMoofOffset = moofOffset;
+        mTfraEntries.push(entry);
+    }
+
+    mOwner->writeInt32(moofSize);
+    mOwner->writeFourcc("moof");
+
+    mOwner->writeInt32(16);
+    mOwner->writeFourcc("mfhd");
+    mOwner->writeInt32(0);  // version=0, flags=0
+    mOwner->writeInt32(++mOwner->mFragmentSequenceNumber);
+
+    mOwner->writeInt32(trafSize);
+    mOwner->writeFourcc("traf");
+
+    mOwner->writeInt32(16);
+    mOwner->writeFourcc("tfhd");
+    mOwner->writeInt32(0x020000);  // version=0, flags=default-base-is-moof
+    mOwner->writeInt32(mTrackId);
+
+    mOwner->writeInt32(20);
+    mOwner->writeFourcc("tfdt");
+    mOwner->writeInt32(0x01000000);  // version=1, flags=0
+    mOwner->writeInt64(baseTicks);   // base media decode time
+
+    mOwner->writeInt32(trunSize);
+    mOwner->writeFourcc("trun");
+    // version 1 for signed composition time offsets
+    mOwner->writeInt32((hasNegativeCompositionOffsets ? 0x01000000 : 0) | trunFlags);
+    mOwner->writeInt32(numSamples);
+    mOwner->writeInt32(moofSize + 8);  // data offset, past the mdat header
+    for (List<FragmentSample>::iterator it = mFragmentSamples.begin();
+         it != mFragmentSamples.end(); ++it) {
+        List<FragmentSample>::iterator next = it;
+        ++next;
+        int64_t nextTicks = next == mFragmentSamples.end()
+                ? nextDecodingTimeTicks : next->mDecodingTimeTicks;
+        mOwner->writeInt32(nextTicks - it->mDecodingTimeTicks);  // duration
+        mOwner->writeInt32(it->mSize);
+        // sync samples do not depend on others, the others are non sync
+        mOwner->writeInt32(it->mIsSync ? 0x02000000 : 0x01010000);
+        if (hasCompositionOffsets) {
+            mOwner->writeInt32(it->mCompositionOffsetTicks);
+        }
+    }
+
+    mOwner->writeInt32(mdatSize);
+    mOwner->writeFourcc("mdat");
+    while (!mFragmentSamples.empty()) {
+        MediaBuffer *buffer = mFragmentSamples.begin()->mBuffer;
+        if (mIsAvc || mIsHevc) {
+            mOwner->addMultipleLengthPrefixedSamples_l(buffer);
+        } else {
+            mOwner->addSample_l(buffer);
+        }
+        buffer->release();
+        mFragmentSamples.erase(mFragmentSamples.begin());
+    }
+
+    mOwner->onFragmentWritten_l();
+    return true;
+}
+
+void MPEG4Writer::Track::writeTrexBox() {
+    mOwner->beginBox("trex");
+    mOwner->writeInt32(0);         // version=0, flags=0
+    mOwner->writeInt32(mTrackId);
+    mOwner->writeInt32(1);         // default sample description index
+    mOwner->writeInt32(0);         // default sample duration
+    mOwner->writeInt32(0);         // default sample size
+    mOwner->writeInt32(0);         // default sample flags
+    mOwner->endBox();  // trex
+}
+
+void MPEG4Writer::Track::writeTfraBox() {
+    mOwner->beginBox("tfra");
+    mOwner->writeInt32(0x01000000);  // version=1, flags=0
+    mOwner->writeInt32(mTrackId);
+    mOwner->writeInt32(0);           // 1 byte traf, trun and sample numbers
+    mOwner->writeInt32(mTfraEntries.size());
+    for (size_t i = 0; i < mTfraEntries.size(); ++i) {
+        mOwner->writeInt64(mTfraEntries[i].mTimeTicks);
+        mOwner->writeInt64(mTfraEntries[i].mMoofOffset);
+        mOwner->writeInt8(1);        // traf number
+        mOwner->writeInt8(1);        // trun number
+        mOwner->writeInt8(1);        // sample number
+    }
+    mOwner->endBox();  // tfra
+}
+
 int64_t MPEG4Writer::Track::getDurationUs() const {
     return mTrackDurationUs;
 }
@@ -3006,6 +3553,28 @@ void MPEG4Writer::Track::writeStblBox(bool use32BitOffset) {
         writeVideoFourCCBox();
     }
     mOwner->endBox();  // stsd
+    if (mOwner->isFragmented()) {
+        // the samples are all in the fragments
+        mOwner->beginBox("stts");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stts
+        mOwner->beginBox("stsc");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stsc
+        mOwner->beginBox("stsz");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // sample size
+        mOwner->writeInt32(0);  // sample count
+        mOwner->endBox();  // stsz
+        mOwner->beginBox(use32BitOffset? "stco": "co64");
+        mOwner->writeInt32(0);  // version=0, flags=0
+        mOwner->writeInt32(0);  // entry count
+        mOwner->endBox();  // stco or co64
+        mOwner->endBox();  // stbl
+        return;
+    }
     writeSttsBox();
     writeCttsBox();
     if (!mIsAudio) {
@@ -3226,7 +3795,8 @@ void MPEG4Writer::Track::writeTkhdBox(uint32_t now) {
     mOwner->writeInt32(now);           // modification time
     mOwner->writeInt32(mTrackId);      // track id starts with 1
     mOwner->writeInt32(0);             // reserved
-    int64_t trakDurationUs = getDurationUs();
+    // the duration of a fragmented file is in its mehd box
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getDurationUs();
     int32_t mvhdTimeScale = mOwner->getTimeScale();
     int32_t tkhdDuration =
         (trakDurationUs * mvhdTimeScale + 5E5) / 1E6;
@@ -3287,7 +3857,7 @@ void MPEG4Writer::Track::writeHdlrBox() {
 }
 
 void MPEG4Writer::Track::writeMdhdBox(uint32_t now) {
-    int64_t trakDurationUs = getDurationUs();
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getDurationUs();
     mOwner->beginBox("mdhd");
     mOwner->writeInt32(0);             // version=0, flags=0
     mOwner->writeInt32(now);           // creation time
@@ -3424,12 +3994,10 @@ void MPEG4Writer::Track::writeCttsBox() {
     mOwner->beginBox("ctts");
     mOwner->writeInt32(0);  // version=0, flags=0
     uint32_t delta = mMinCttsOffsetTimeUs - getStartTimeOffsetScaledTime();
-    mCttsTableEntries->adjustEntries([delta](size_t /* ix */, uint32_t (&value)[2]) {
+    mCttsTableEntries->write(mOwner, [delta](uint32_t (&value)[2]) {
         // entries are <count, ctts> pairs; adjust only ctts
-        uint32_t duration = htonl(value[1]); // back to host byte order
-        value[1] = htonl(duration - delta);
+        value[1] -= delta;
     });
-    mCttsTableEntries->write(mOwner);
     mOwner->endBox();  // ctts
 }
 
@@ -24,8 +24,54 @@
 
 namespace android {
 
+// How long stop() lets the reader drain the queued buffers.
+static const int64_t kDrainTimeoutNs = 3000000000ll;
+
+MediaBufferBudget::MediaBufferBudget(size_t maxBytes)
+    : mMaxBytes(maxBytes),
+      mAcquiredBytes(0) {
+}
+
+void MediaBufferBudget::setMaxBytes(size_t maxBytes) {
+    Mutex::Autolock autoLock(mLock);
+    mMaxBytes = maxBytes;
+    mReleasedCond.broadcast();
+}
+
+bool MediaBufferBudget::fits_l(size_t size) const {
+    return mAcquiredBytes == 0
+            || (mAcquiredBytes <= mMaxBytes && size <= mMaxBytes - mAcquiredBytes);
+}
+
+bool MediaBufferBudget::tryAcquire(size_t size) {
+    Mutex::Autolock autoLock(mLock);
+    if (!fits_l(size)) {
+        return false;
+    }
+    mAcquiredBytes += size;
+    return true;
+}
+
+void MediaBufferBudget::acquire(size_t size) {
+    Mutex::Autolock autoLock(mLock);
+    while (!fits_l(size)) {
+        mReleasedCond.wait(mLock);
+    }
+    mAcquiredBytes += size;
+}
+
+void MediaBufferBudget::release(size_t size) {
+    Mutex::Autolock autoLock(mLock);
+    CHECK_LE(size, mAcquiredBytes);
+    mAcquiredBytes -= size;
+    mReleasedCond.broadcast();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
 MediaAdapter::MediaAdapter(const sp<MetaData> &meta)
     : mCurrentMediaBuffer(NULL),
+      mPushedMediaBuffer(NULL),
       mStarted(false),
       mOutputFormat(meta) {
 }
@@ -34,6 +80,7 @@ MediaAdapter::~MediaAdapter() {
     Mutex::Autolock autoLock(mAdapterLock);
     mOutputFormat.clear();
     CHECK(mCurrentMediaBuffer == NULL);
+    dropQueuedBuffers_l();
 }
 
 status_t MediaAdapter::start(MetaData * /* params */) {
@@ -47,6 +94,18 @@ status_t MediaAdapter::start(MetaData * /* params */) {
 status_t MediaAdapter::stop() {
     Mutex::Autolock autoLock(mAdapterLock);
     if (mStarted) {
+        // Give the reader a chance to take the queued buffers.
+        nsecs_t deadlineNs = systemTime() + kDrainTimeoutNs;
+        while (!mQueuedBuffers.empty()) {
+            nsecs_t leftNs = deadlineNs - systemTime();
+            if (leftNs <= 0) {
+                ALOGW("dropping buffers the reader did not take before stop");
+                break;
+            }
+            mQueueDrainedCond.waitRelative(mAdapterLock, leftNs);
+        }
+        dropQueuedBuffers_l();
+
         mStarted = false;
         // If stop() happens immediately after a pushBuffer(), we should
         // clean up the mCurrentMediaBuffer
@@ -69,11 +128,32 @@ void MediaAdapter::signalBufferReturned(MediaBuffer *buffer) {
     Mutex::Autolock autoLock(mAdapterLock);
     CHECK(buffer != NULL);
     buffer->setObserver(0);
+    if (buffer != mPushedMediaBuffer) {
+        // queued by queueBuffer()
+        if (mBudget != NULL) {
+            mBudget->release(buffer->size());
+        }
+        buffer->release();
+        return;
+    }
+    mPushedMediaBuffer = NULL;
     buffer->release();
     ALOGV("buffer returned %p", buffer);
     mBufferReturnedCond.signal();
 }
 
+void MediaAdapter::dropQueuedBuffers_l() {
+    while (!mQueuedBuffers.empty()) {
+        MediaBuffer *buffer = *mQueuedBuffers.begin();
+        mQueuedBuffers.erase(mQueuedBuffers.begin());
+        if (mBudget != NULL) {
+            mBudget->release(buffer->size());
+        }
+        buffer->release();
+    }
+    mQueueDrainedCond.broadcast();
+}
+
 status_t MediaAdapter::read(
             MediaBuffer **buffer, const ReadOptions * /* options */) {
     Mutex::Autolock autoLock(mAdapterLock);
@@ -82,7 +162,7 @@ status_t MediaAdapter::read(
         return ERROR_END_OF_STREAM;
     }
 
-    while (mCurrentMediaBuffer == NULL && mStarted) {
+    while (mCurrentMediaBuffer == NULL && mQueuedBuffers.empty() && mStarted) {
         ALOGV("waiting @ read()");
         mBufferReadCond.wait(mAdapterLock);
     }
@@ -93,6 +173,17 @@ status_t MediaAdapter::read(
         return ERROR_END_OF_STREAM;
     }
 
+    if (!mQueuedBuffers.empty()) {
+        *buffer = *mQueuedBuffers.begin();
+        mQueuedBuffers.erase(mQueuedBuffers.begin());
+        if (mQueuedBuffers.empty()) {
+            mQueueDrainedCond.broadcast();
+        }
+        (*buffer)->add_ref();
+        (*buffer)->setObserver(this);
+        return OK;
+    }
+
     CHECK(mCurrentMediaBuffer != NULL);
 
     *buffer = mCurrentMediaBuffer;
@@ -114,6 +205,7 @@ status_t MediaAdapter::pushBuffer(MediaBuffer *buffer) {
         return INVALID_OPERATION;
     }
     mCurrentMediaBuffer = buffer;
+    mPushedMediaBuffer = buffer;
     mBufferReadCond.signal();
 
     ALOGV("wait for the buffer returned @ pushBuffer! %p", buffer);
@@ -122,5 +214,27 @@ status_t MediaAdapter::pushBuffer(MediaBuffer *buffer) {
     return OK;
 }
 
+status_t MediaAdapter::queueBuffer(MediaBuffer *buffer) {
+    if (buffer == NULL) {
+        ALOGE("queueBuffer get an NULL buffer");
+        return -EINVAL;
+    }
+
+    Mutex::Autolock autoLock(mAdapterLock);
+    if (!mStarted) {
+        ALOGE("queueBuffer called before start");
+        return INVALID_OPERATION;
+    }
+    CHECK_EQ(buffer->refcount(), 0);
+    mQueuedBuffers.push_back(buffer);
+    mBufferReadCond.signal();
+    return OK;
+}
+
+void MediaAdapter::setBudget(const sp<MediaBufferBudget> &budget) {
+    Mutex::Autolock autoLock(mAdapterLock);
+    mBudget = budget;
+}
+
 }  // namespace android
 
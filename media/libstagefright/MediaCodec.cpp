@@ -279,6 +279,8 @@ MediaCodec::MediaCodec(const sp<ALooper> &looper, pid_t pid)
       mDequeueOutputReplyID(0),
       mHaveInputSurface(false),
       mHavePendingInputBuffers(false) {
+    mDirectDequeueAllowed[kPortIndexInput] = false;
+    mDirectDequeueAllowed[kPortIndexOutput] = false;
 }
 
 MediaCodec::~MediaCodec() {
@@ -708,6 +710,37 @@ status_t MediaCodec::queueInputBuffer(
     return PostAndAwaitResponse(msg, &response);
 }
 
+status_t MediaCodec::queueInputBuffers(
+        const BatchBuffer *buffers,
+        size_t count,
+        size_t *numQueued,
+        AString *errorDetailMsg) {
+    *numQueued = 0;
+    if (errorDetailMsg != NULL) {
+        errorDetailMsg->clear();
+    }
+    if (count == 0) {
+        return OK;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatQueueInputBuffers, this);
+    msg->setPointer("buffers", (void *)buffers);
+    msg->setSize("count", count);
+    msg->setPointer("errorDetailMsg", errorDetailMsg);
+
+    sp<AMessage> response;
+    status_t err = msg->postAndAwaitResponse(&response);
+    if (err != OK) {
+        return err;
+    }
+
+    CHECK(response->findSize("numQueued", numQueued));
+    if (!response->findInt32("err", &err)) {
+        err = OK;
+    }
+    return err;
+}
+
 status_t MediaCodec::queueSecureInputBuffer(
         size_t index,
         size_t offset,
@@ -745,6 +778,17 @@ status_t MediaCodec::queueSecureInputBuffer(
 }
 
 status_t MediaCodec::dequeueInputBuffer(size_t *index, int64_t timeoutUs) {
+    {
+        Mutex::Autolock al(mBufferLock);
+        if (mDirectDequeueAllowed[kPortIndexInput]) {
+            ssize_t directIndex = dequeuePortBuffer_l(kPortIndexInput);
+            if (directIndex >= 0) {
+                *index = directIndex;
+                return OK;
+            }
+        }
+    }
+
     sp<AMessage> msg = new AMessage(kWhatDequeueInputBuffer, this);
     msg->setInt64("timeoutUs", timeoutUs);
 
@@ -766,6 +810,18 @@ status_t MediaCodec::dequeueOutputBuffer(
         int64_t *presentationTimeUs,
         uint32_t *flags,
         int64_t timeoutUs) {
+    {
+        Mutex::Autolock al(mBufferLock);
+        if (mDirectDequeueAllowed[kPortIndexOutput]) {
+            ssize_t directIndex = dequeuePortBuffer_l(kPortIndexOutput);
+            if (directIndex >= 0) {
+                *index = directIndex;
+                getOutputBufferInfo_l(directIndex, offset, size, presentationTimeUs, flags);
+                return OK;
+            }
+        }
+    }
+
     sp<AMessage> msg = new AMessage(kWhatDequeueOutputBuffer, this);
     msg->setInt64("timeoutUs", timeoutUs);
 
@@ -784,6 +840,63 @@ status_t MediaCodec::dequeueOutputBuffer(
     return OK;
 }
 
+status_t MediaCodec::dequeueOutputBuffers(
+        BatchBuffer *buffers,
+        size_t maxCount,
+        size_t *count,
+        int64_t timeoutUs) {
+    *count = 0;
+    if (maxCount == 0) {
+        return OK;
+    }
+
+    // Wait through the looper for the first buffer only if none can be
+    // taken directly, then take whatever else is available.
+    size_t n = dequeueAvailableOutputBuffers(buffers, maxCount);
+    if (n == 0) {
+        BatchBuffer *buffer = &buffers[0];
+        status_t err = dequeueOutputBuffer(
+                &buffer->mIndex, &buffer->mOffset, &buffer->mSize,
+                &buffer->mPresentationTimeUs, &buffer->mFlags, timeoutUs);
+        if (err != OK) {
+            return err;
+        }
+        n = 1;
+        if (!(buffer->mFlags & BUFFER_FLAG_EOS)) {
+            n += dequeueAvailableOutputBuffers(buffers + 1, maxCount - 1);
+        }
+    }
+
+    *count = n;
+    return OK;
+}
+
+size_t MediaCodec::dequeueAvailableOutputBuffers(BatchBuffer *buffers, size_t maxCount) {
+    Mutex::Autolock al(mBufferLock);
+    if (!mDirectDequeueAllowed[kPortIndexOutput]) {
+        return 0;
+    }
+
+    size_t n = 0;
+    while (n < maxCount) {
+        ssize_t index = dequeuePortBuffer_l(kPortIndexOutput);
+        if (index < 0) {
+            break;
+        }
+        BatchBuffer *buffer = &buffers[n++];
+        buffer->mIndex = index;
+        getOutputBufferInfo_l(
+                index, &buffer->mOffset, &buffer->mSize,
+                &buffer->mPresentationTimeUs, &buffer->mFlags);
+
+        // let the client handle the end of stream before anything else
+        if (buffer->mFlags & BUFFER_FLAG_EOS) {
+            break;
+        }
+    }
+    return n;
+}
+
 status_t MediaCodec::renderOutputBufferAndRelease(size_t index) {
     sp<AMessage> msg = new AMessage(kWhatReleaseOutputBuffer, this);
     msg->setSize("index", index);
@@ -1039,39 +1152,25 @@ bool MediaCodec::handleDequeueOutputBuffer(const sp<AReplyToken> &replyID, bool
         mFlags &= ~kFlagOutputFormatChanged;
     } else {
         sp<AMessage> response = new AMessage;
-        ssize_t index = dequeuePortBuffer(kPortIndexOutput);
-
-        if (index < 0) {
-            CHECK_EQ(index, -EAGAIN);
-            return false;
-        }
-
-        const sp<ABuffer> &buffer =
-            mPortBuffers[kPortIndexOutput].itemAt(index).mData;
-
-        response->setSize("index", index);
-        response->setSize("offset", buffer->offset());
-        response->setSize("size", buffer->size());
-
+        size_t offset, size;
         int64_t timeUs;
-        CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
-
-        response->setInt64("timeUs", timeUs);
+        uint32_t flags;
+        {
+            Mutex::Autolock al(mBufferLock);
+            ssize_t index = dequeuePortBuffer_l(kPortIndexOutput);
 
-        int32_t omxFlags;
-        CHECK(buffer->meta()->findInt32("omxFlags", &omxFlags));
+            if (index < 0) {
+                CHECK_EQ(index, -EAGAIN);
+                return false;
+            }
 
-        uint32_t flags = 0;
-        if (omxFlags & OMX_BUFFERFLAG_SYNCFRAME) {
-            flags |= BUFFER_FLAG_SYNCFRAME;
-        }
-        if (omxFlags & OMX_BUFFERFLAG_CODECCONFIG) {
-            flags |= BUFFER_FLAG_CODECCONFIG;
-        }
-        if (omxFlags & OMX_BUFFERFLAG_EOS) {
-            flags |= BUFFER_FLAG_EOS;
+            getOutputBufferInfo_l(index, &offset, &size, &timeUs, &flags);
+            response->setSize("index", index);
         }
 
+        response->setSize("offset", offset);
+        response->setSize("size", size);
+        response->setInt64("timeUs", timeUs);
         response->setInt32("flags", flags);
         response->postReply(replyID);
     }
@@ -1079,7 +1178,59 @@ bool MediaCodec::handleDequeueOutputBuffer(const sp<AReplyToken> &replyID, bool
     return true;
 }
 
+void MediaCodec::getOutputBufferInfo_l(
+        size_t index, size_t *offset, size_t *size, int64_t *timeUs, uint32_t *flags) {
+    const sp<ABuffer> &buffer =
+        mPortBuffers[kPortIndexOutput].itemAt(index).mData;
+
+    *offset = buffer->offset();
+    *size = buffer->size();
+
+    CHECK(buffer->meta()->findInt64("timeUs", timeUs));
+
+    int32_t omxFlags;
+    CHECK(buffer->meta()->findInt32("omxFlags", &omxFlags));
+
+    *flags = 0;
+    if (omxFlags & OMX_BUFFERFLAG_SYNCFRAME) {
+        *flags |= BUFFER_FLAG_SYNCFRAME;
+    }
+    if (omxFlags & OMX_BUFFERFLAG_CODECCONFIG) {
+        *flags |= BUFFER_FLAG_CODECCONFIG;
+    }
+    if (omxFlags & OMX_BUFFERFLAG_EOS) {
+        *flags |= BUFFER_FLAG_EOS;
+    }
+}
+
 void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
+    // The buffer state only changes here, so the callers may take buffers
+    // without a round trip while no message is being handled.
+    {
+        Mutex::Autolock al(mBufferLock);
+        mDirectDequeueAllowed[kPortIndexInput] = false;
+        mDirectDequeueAllowed[kPortIndexOutput] = false;
+    }
+
+    handleMessage(msg);
+
+    updateDirectDequeue();
+}
+
+// Mirrors the checks of handleDequeueInputBuffer() and
+// handleDequeueOutputBuffer() that do not depend on the buffers.
+void MediaCodec::updateDirectDequeue() {
+    bool allowed = isExecuting() && !(mFlags & (kFlagIsAsync | kFlagStickyError));
+
+    Mutex::Autolock al(mBufferLock);
+    mDirectDequeueAllowed[kPortIndexInput] =
+        allowed && !(mFlags & kFlagDequeueInputPending);
+    mDirectDequeueAllowed[kPortIndexOutput] =
+        allowed && !(mFlags & (kFlagDequeueOutputPending
+                | kFlagOutputBuffersChanged | kFlagOutputFormatChanged));
+}
+
+void MediaCodec::handleMessage(const sp<AMessage> &msg) {
     switch (msg->what()) {
         case kWhatCodecNotify:
         {
@@ -1364,6 +1515,9 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
 
                     if (totalSize) {
                         mDealer = new MemoryDealer(totalSize, "MediaCodec");
+                        // The encrypted input buffers are all allocated from
+                        // this heap; share it once instead of per decrypt().
+                        mCrypto->setHeap(mDealer->getMemoryHeap());
                     }
 
                     for (size_t i = 0; i < numBuffers; ++i) {
@@ -2044,6 +2198,52 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatQueueInputBuffers:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            const BatchBuffer *buffers;
+            size_t count;
+            AString *errorDetailMsg;
+            CHECK(msg->findPointer("buffers", (void **)&buffers));
+            CHECK(msg->findSize("count", &count));
+            CHECK(msg->findPointer("errorDetailMsg", (void **)&errorDetailMsg));
+
+            status_t err = OK;
+            size_t numQueued = 0;
+            if (!isExecuting()) {
+                err = INVALID_OPERATION;
+            } else if (mFlags & kFlagStickyError) {
+                err = getStickyError();
+            } else {
+                // onQueueInputBuffer() takes its arguments from a message;
+                // reuse a single one for the whole batch.
+                sp<AMessage> bufferMsg = new AMessage;
+                bufferMsg->setPointer("errorDetailMsg", errorDetailMsg);
+                while (numQueued < count) {
+                    const BatchBuffer &buffer = buffers[numQueued];
+                    bufferMsg->setSize("index", buffer.mIndex);
+                    bufferMsg->setSize("offset", buffer.mOffset);
+                    bufferMsg->setSize("size", buffer.mSize);
+                    bufferMsg->setInt64("timeUs", buffer.mPresentationTimeUs);
+                    bufferMsg->setInt32("flags", buffer.mFlags);
+
+                    err = onQueueInputBuffer(bufferMsg);
+                    if (err != OK) {
+                        break;
+                    }
+                    ++numQueued;
+                }
+            }
+
+            sp<AMessage> response = new AMessage;
+            response->setInt32("err", err);
+            response->setSize("numQueued", numQueued);
+            response->postReply(replyID);
+            break;
+        }
+
         case kWhatDequeueOutputBuffer:
         {
             sp<AReplyToken> replyID;
@@ -2651,6 +2851,11 @@ status_t MediaCodec::onReleaseOutputBuffer(const sp<AMessage> &msg) {
 }
 
 ssize_t MediaCodec::dequeuePortBuffer(int32_t portIndex) {
+    Mutex::Autolock al(mBufferLock);
+    return dequeuePortBuffer_l(portIndex);
+}
+
+ssize_t MediaCodec::dequeuePortBuffer_l(int32_t portIndex) {
     CHECK(portIndex == kPortIndexInput || portIndex == kPortIndexOutput);
 
     List<size_t> *availBuffers = &mAvailPortBuffers[portIndex];
@@ -2664,20 +2869,17 @@ ssize_t MediaCodec::dequeuePortBuffer(int32_t portIndex) {
 
     BufferInfo *info = &mPortBuffers[portIndex].editItemAt(index);
     CHECK(!info->mOwnedByClient);
-    {
-        Mutex::Autolock al(mBufferLock);
-        info->mOwnedByClient = true;
+    info->mOwnedByClient = true;
 
-        // set image-data
-        if (info->mFormat != NULL) {
-            sp<ABuffer> imageData;
-            if (info->mFormat->findBuffer("image-data", &imageData)) {
-                info->mData->meta()->setBuffer("image-data", imageData);
-            }
-            int32_t left, top, right, bottom;
-            if (info->mFormat->findRect("crop", &left, &top, &right, &bottom)) {
-                info->mData->meta()->setRect("crop-rect", left, top, right, bottom);
-            }
+    // set image-data
+    if (info->mFormat != NULL) {
+        sp<ABuffer> imageData;
+        if (info->mFormat->findBuffer("image-data", &imageData)) {
+            info->mData->meta()->setBuffer("image-data", imageData);
+        }
+        int32_t left, top, right, bottom;
+        if (info->mFormat->findRect("crop", &left, &top, &right, &bottom)) {
+            info->mData->meta()->setRect("crop-rect", left, top, right, bottom);
         }
     }
 
@@ -36,7 +36,12 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/OMXClient.h>
 
+#include <binder/Parcel.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <utils/threads.h>
 
 #include <cutils/properties.h>
@@ -46,6 +51,12 @@ namespace android {
 
 const char *kMaxEncoderInputBuffers = "max-video-encoder-input-buffers";
 
+static const char *kCodecListCache = "/data/misc/media/media_codecs_cache.bin";
+static const int32_t kCacheVersion = 1;
+static const off_t kMaxCacheSize = 4 * 1024 * 1024;
+static const size_t kMaxCacheFiles = 64;
+static const size_t kMaxCacheCodecs = 1024;
+
 static Mutex sInitMutex;
 
 static bool parseBoolean(const char *s) {
@@ -103,6 +114,7 @@ void *MediaCodecList::profilerThreadWrapper(void * /*arg*/) {
     profileCodecs(infos);
     ALOGV("Codec profiling completed.");
     codecList->parseTopLevelXMLFile(kProfilingResults, true /* ignore_errors */);
+    codecList->writeCache();
 
     {
         Mutex::Autolock autoLock(sInitMutex);
@@ -175,9 +187,151 @@ MediaCodecList::MediaCodecList()
     : mInitCheck(NO_INIT),
       mUpdate(false),
       mGlobalSettings(new AMessage()) {
+    if (readCache() == OK) {
+        mInitCheck = OK;
+        configureResourcePolicies();
+        return;
+    }
+
     parseTopLevelXMLFile("/etc/media_codecs.xml");
     parseTopLevelXMLFile("/etc/media_codecs_performance.xml", true/* ignore_errors */);
     parseTopLevelXMLFile(kProfilingResults, true/* ignore_errors */);
+
+    if (mInitCheck == OK) {
+        writeCache();
+    }
+}
+
+static void statFile(const char *path, int64_t *size, int64_t *modifiedTimeNs) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        // missing files are part of the cache key too, as they may show up
+        *size = -1;
+        *modifiedTimeNs = 0;
+        return;
+    }
+    *size = st.st_size;
+    *modifiedTimeNs = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+}
+
+// The cache holds the build, the size and modification time of every XML
+// file parsed, the global settings and the codec infos.  It is only used if
+// the build and all the files are unchanged.
+status_t MediaCodecList::readCache() {
+    int fd = open(kCodecListCache, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size <= kMaxCacheSize) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NAME_NOT_FOUND;
+    }
+
+    Parcel parcel;
+    parcel.setData((const uint8_t *)data, st.st_size);
+    munmap(data, st.st_size);
+
+    if (parcel.readInt32() != kCacheVersion
+            || AString::FromParcel(parcel) != getProfilingVersionString()) {
+        ALOGV("codec list cache is from another build");
+        return INVALID_OPERATION;
+    }
+
+    size_t numFiles = parcel.readInt32();
+    if (numFiles > kMaxCacheFiles) {
+        return BAD_VALUE;
+    }
+    for (size_t i = 0; i < numFiles; ++i) {
+        ParsedFile file;
+        file.mPath = AString::FromParcel(parcel);
+        file.mSize = parcel.readInt64();
+        file.mModifiedTimeNs = parcel.readInt64();
+
+        int64_t size, modifiedTimeNs;
+        statFile(file.mPath.c_str(), &size, &modifiedTimeNs);
+        if (size != file.mSize || modifiedTimeNs != file.mModifiedTimeNs) {
+            ALOGV("codec list cache is out of date with %s", file.mPath.c_str());
+            return INVALID_OPERATION;
+        }
+        mParsedFiles.push_back(file);
+    }
+
+    sp<AMessage> globalSettings = AMessage::FromParcel(parcel);
+    size_t numCodecs = parcel.readInt32();
+    if (globalSettings == NULL || numCodecs > kMaxCacheCodecs) {
+        mParsedFiles.clear();
+        return BAD_VALUE;
+    }
+
+    Vector<sp<MediaCodecInfo> > infos;
+    for (size_t i = 0; i < numCodecs; ++i) {
+        sp<MediaCodecInfo> info = MediaCodecInfo::FromParcel(parcel);
+        if (info == NULL) {
+            mParsedFiles.clear();
+            return BAD_VALUE;
+        }
+        infos.push_back(info);
+    }
+
+    mGlobalSettings = globalSettings;
+    mCodecInfos = infos;
+    ALOGV("read %zu codecs from the cache", mCodecInfos.size());
+    return OK;
+}
+
+void MediaCodecList::writeCache() const {
+    Parcel parcel;
+    parcel.writeInt32(kCacheVersion);
+    getProfilingVersionString().writeToParcel(&parcel);
+    parcel.writeInt32(mParsedFiles.size());
+    for (size_t i = 0; i < mParsedFiles.size(); ++i) {
+        const ParsedFile &file = mParsedFiles[i];
+        file.mPath.writeToParcel(&parcel);
+        parcel.writeInt64(file.mSize);
+        parcel.writeInt64(file.mModifiedTimeNs);
+    }
+    mGlobalSettings->writeToParcel(&parcel);
+    parcel.writeInt32(mCodecInfos.size());
+    for (size_t i = 0; i < mCodecInfos.size(); ++i) {
+        mCodecInfos[i]->writeToParcel(&parcel);
+    }
+
+    // write to a temporary file and rename it, so that a reader never sees
+    // a partial cache
+    AString tmpPath = AStringPrintf("%s.%d", kCodecListCache, getpid());
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ALOGV("cannot write the codec list cache (%s)", strerror(errno));
+        return;
+    }
+
+    const uint8_t *data = parcel.data();
+    size_t size = parcel.dataSize();
+    bool ok = true;
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ok = false;
+            break;
+        }
+        data += n;
+        size -= n;
+    }
+    close(fd);
+
+    if (!ok || rename(tmpPath.c_str(), kCodecListCache) != 0) {
+        ALOGW("failed to write the codec list cache");
+        unlink(tmpPath.c_str());
+    }
 }
 
 void MediaCodecList::parseTopLevelXMLFile(const char *codecs_xml, bool ignore_errors) {
@@ -209,30 +363,7 @@ void MediaCodecList::parseTopLevelXMLFile(const char *codecs_xml, bool ignore_er
         return;
     }
 
-    Vector<MediaResourcePolicy> policies;
-    AString value;
-    if (mGlobalSettings->findString(kPolicySupportsMultipleSecureCodecs, &value)) {
-        policies.push_back(
-                MediaResourcePolicy(
-                        String8(kPolicySupportsMultipleSecureCodecs),
-                        String8(value.c_str())));
-    }
-    if (mGlobalSettings->findString(kPolicySupportsSecureWithNonSecureCodec, &value)) {
-        policies.push_back(
-                MediaResourcePolicy(
-                        String8(kPolicySupportsSecureWithNonSecureCodec),
-                        String8(value.c_str())));
-    }
-    if (policies.size() > 0) {
-        sp<IServiceManager> sm = defaultServiceManager();
-        sp<IBinder> binder = sm->getService(String16("media.resource_manager"));
-        sp<IResourceManagerService> service = interface_cast<IResourceManagerService>(binder);
-        if (service == NULL) {
-            ALOGE("MediaCodecList: failed to get ResourceManagerService");
-        } else {
-            service->config(policies);
-        }
-    }
+    configureResourcePolicies();
 
     for (size_t i = mCodecInfos.size(); i > 0;) {
         i--;
@@ -315,6 +446,33 @@ void MediaCodecList::parseTopLevelXMLFile(const char *codecs_xml, bool ignore_er
 #endif
 }
 
+void MediaCodecList::configureResourcePolicies() {
+    Vector<MediaResourcePolicy> policies;
+    AString value;
+    if (mGlobalSettings->findString(kPolicySupportsMultipleSecureCodecs, &value)) {
+        policies.push_back(
+                MediaResourcePolicy(
+                        String8(kPolicySupportsMultipleSecureCodecs),
+                        String8(value.c_str())));
+    }
+    if (mGlobalSettings->findString(kPolicySupportsSecureWithNonSecureCodec, &value)) {
+        policies.push_back(
+                MediaResourcePolicy(
+                        String8(kPolicySupportsSecureWithNonSecureCodec),
+                        String8(value.c_str())));
+    }
+    if (policies.size() > 0) {
+        sp<IServiceManager> sm = defaultServiceManager();
+        sp<IBinder> binder = sm->getService(String16("media.resource_manager"));
+        sp<IResourceManagerService> service = interface_cast<IResourceManagerService>(binder);
+        if (service == NULL) {
+            ALOGE("MediaCodecList: failed to get ResourceManagerService");
+        } else {
+            service->config(policies);
+        }
+    }
+}
+
 MediaCodecList::~MediaCodecList() {
 }
 
@@ -323,6 +481,11 @@ status_t MediaCodecList::initCheck() const {
 }
 
 void MediaCodecList::parseXMLFile(const char *path) {
+    ParsedFile parsedFile;
+    parsedFile.mPath = path;
+    statFile(path, &parsedFile.mSize, &parsedFile.mModifiedTimeNs);
+    mParsedFiles.push_back(parsedFile);
+
     FILE *file = fopen(path, "r");
 
     if (file == NULL) {
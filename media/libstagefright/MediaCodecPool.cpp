@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaCodecPool"
+#include <utils/Log.h>
+
+#include <media/stagefright/MediaCodecPool.h>
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaCodecList.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+static const int32_t kDefaultPoolSize = 2;
+static const int32_t kDefaultPoolTimeoutMs = 3000;
+
+static Mutex sInstanceLock;
+static sp<MediaCodecPool> sInstance;
+
+// static
+sp<MediaCodecPool> MediaCodecPool::getInstance() {
+    Mutex::Autolock autoLock(sInstanceLock);
+    if (sInstance == NULL) {
+        sInstance = new MediaCodecPool;
+        if (sInstance->mMaxEntries > 0) {
+            sInstance->mLooper = new ALooper;
+            sInstance->mLooper->setName("MediaCodecPool");
+            sInstance->mLooper->start();
+            sInstance->mLooper->registerHandler(sInstance);
+        }
+    }
+    return sInstance;
+}
+
+// static
+sp<MediaCodec> MediaCodecPool::CreateByType(
+        const sp<ALooper> &looper, const AString &mime, bool encoder,
+        status_t *err, pid_t pid) {
+    sp<MediaCodec> codec = getInstance()->acquire(mime, encoder, pid);
+    if (codec != NULL) {
+        if (err != NULL) {
+            *err = OK;
+        }
+        return codec;
+    }
+    return MediaCodec::CreateByType(looper, mime, encoder, err, pid);
+}
+
+// static
+sp<MediaCodec> MediaCodecPool::CreateByComponentName(
+        const sp<ALooper> &looper, const AString &name, status_t *err, pid_t pid) {
+    sp<MediaCodec> codec = getInstance()->acquireByName(name, pid);
+    if (codec != NULL) {
+        if (err != NULL) {
+            *err = OK;
+        }
+        return codec;
+    }
+    return MediaCodec::CreateByComponentName(looper, name, err, pid);
+}
+
+// static
+status_t MediaCodecPool::Recycle(const sp<MediaCodec> &codec, pid_t pid) {
+    return getInstance()->recycle(codec, pid);
+}
+
+// static
+void MediaCodecPool::Prewarm(const AString &mime, bool encoder, pid_t pid) {
+    getInstance()->prewarm(mime, encoder, pid);
+}
+
+MediaCodecPool::MediaCodecPool()
+    : mNumEntries(0),
+      mMaxEntries(0),
+      mTimeoutUs(0) {
+    int32_t size = property_get_int32("media.codec.pool-size", kDefaultPoolSize);
+    int32_t timeoutMs =
+        property_get_int32("media.codec.pool-timeout-ms", kDefaultPoolTimeoutMs);
+    if (size > 0 && timeoutMs > 0) {
+        mMaxEntries = size;
+        mTimeoutUs = timeoutMs * 1000ll;
+    }
+}
+
+MediaCodecPool::~MediaCodecPool() {
+}
+
+sp<MediaCodec> MediaCodecPool::acquire(const AString &mime, bool encoder, pid_t pid) {
+    if (mMaxEntries == 0) {
+        return NULL;
+    }
+
+    Vector<AString> matchingCodecs;
+    MediaCodecList::findMatchingCodecs(
+            mime.c_str(), encoder, 0 /* flags */, &matchingCodecs);
+
+    Mutex::Autolock autoLock(mLock);
+    for (size_t i = 0; i < matchingCodecs.size(); ++i) {
+        sp<MediaCodec> codec = takeEntry_l(matchingCodecs[i], pid);
+        if (codec != NULL) {
+            return codec;
+        }
+    }
+    return NULL;
+}
+
+sp<MediaCodec> MediaCodecPool::acquireByName(const AString &name, pid_t pid) {
+    if (mMaxEntries == 0) {
+        return NULL;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    return takeEntry_l(name, pid);
+}
+
+sp<MediaCodec> MediaCodecPool::takeEntry_l(const AString &name, pid_t pid) {
+    while (isPrewarming_l(name, pid)) {
+        mCondition.wait(mLock);
+    }
+    for (List<Entry>::iterator it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (it->mPid == pid && it->mName == name) {
+            sp<MediaCodec> codec = it->mCodec;
+            ALOGV("reusing %s", it->mName.c_str());
+            mEntries.erase(it);
+            --mNumEntries;
+            return codec;
+        }
+    }
+    return NULL;
+}
+
+status_t MediaCodecPool::recycle(const sp<MediaCodec> &codec, pid_t pid) {
+    AString name;
+    if (mMaxEntries == 0 || codec->getName(&name) != OK || name.endsWith(".secure")) {
+        return codec->release();
+    }
+
+    // stop() keeps the component allocated, unlike release()
+    status_t err = codec->stop();
+    if (err != OK) {
+        ALOGW("cannot stop %s for the pool (%d)", name.c_str(), err);
+        return codec->release();
+    }
+
+    sp<MediaCodec> evicted;
+    {
+        Mutex::Autolock autoLock(mLock);
+        evicted = addEntry_l(codec, name, pid);
+    }
+    ALOGV("pooled %s", name.c_str());
+
+    if (evicted != NULL) {
+        evicted->release();
+    }
+    return OK;
+}
+
+void MediaCodecPool::prewarm(const AString &mime, bool encoder, pid_t pid) {
+    if (mMaxEntries == 0) {
+        return;
+    }
+
+    Vector<AString> matchingCodecs;
+    MediaCodecList::findMatchingCodecs(
+            mime.c_str(), encoder, 0 /* flags */, &matchingCodecs);
+    if (matchingCodecs.isEmpty() || matchingCodecs[0].endsWith(".secure")) {
+        return;
+    }
+    const AString &name = matchingCodecs[0];
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (isPrewarming_l(name, pid)) {
+            return;
+        }
+        for (List<Entry>::iterator it = mEntries.begin(); it != mEntries.end(); ++it) {
+            if (it->mPid == pid && it->mName == name) {
+                return;
+            }
+        }
+
+        Entry entry;
+        entry.mName = name;
+        entry.mPid = pid;
+        entry.mRecycledUs = ALooper::GetNowUs();
+        mPrewarming.push_back(entry);
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatPrewarm, this);
+    msg->setString("name", name);
+    msg->setInt32("pid", pid);
+    msg->post();
+}
+
+void MediaCodecPool::onPrewarm(const sp<AMessage> &msg) {
+    AString name;
+    int32_t pid;
+    CHECK(msg->findString("name", &name));
+    CHECK(msg->findInt32("pid", &pid));
+
+    // like the decoders' own codec loopers
+    sp<ALooper> looper = new ALooper;
+    looper->setName("MediaCodecPool-CL");
+    looper->start(false, false, ANDROID_PRIORITY_AUDIO);
+
+    int64_t startUs = ALooper::GetNowUs();
+    sp<MediaCodec> codec = MediaCodec::CreateByComponentName(looper, name, NULL /* err */, pid);
+    ALOGV("prewarmed %s in %lld us", name.c_str(), (long long)(ALooper::GetNowUs() - startUs));
+
+    sp<MediaCodec> evicted;
+    {
+        Mutex::Autolock autoLock(mLock);
+        for (List<Entry>::iterator it = mPrewarming.begin(); it != mPrewarming.end(); ++it) {
+            if (it->mPid == pid && it->mName == name) {
+                mPrewarming.erase(it);
+                break;
+            }
+        }
+        if (codec != NULL) {
+            evicted = addEntry_l(codec, name, pid);
+        } else {
+            ALOGW("cannot prewarm %s", name.c_str());
+        }
+        mCondition.broadcast();
+    }
+
+    if (evicted != NULL) {
+        evicted->release();
+    }
+}
+
+sp<MediaCodec> MediaCodecPool::addEntry_l(
+        const sp<MediaCodec> &codec, const AString &name, pid_t pid) {
+    sp<MediaCodec> evicted;
+    if (mNumEntries == mMaxEntries) {
+        evicted = mEntries.begin()->mCodec;
+        mEntries.erase(mEntries.begin());
+        --mNumEntries;
+    }
+
+    Entry entry;
+    entry.mCodec = codec;
+    entry.mName = name;
+    entry.mPid = pid;
+    entry.mRecycledUs = ALooper::GetNowUs();
+    mEntries.push_back(entry);
+    ++mNumEntries;
+
+    (new AMessage(kWhatExpire, this))->post(mTimeoutUs);
+    return evicted;
+}
+
+bool MediaCodecPool::isPrewarming_l(const AString &name, pid_t pid) const {
+    for (List<Entry>::const_iterator it = mPrewarming.begin(); it != mPrewarming.end(); ++it) {
+        if (it->mPid == pid && it->mName == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MediaCodecPool::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatExpire:
+        {
+            // Every recycle() posts one of these, so the oldest entry has
+            // always expired by the time its message arrives.
+            Vector<sp<MediaCodec> > expired;
+            {
+                Mutex::Autolock autoLock(mLock);
+                int64_t nowUs = ALooper::GetNowUs();
+                while (!mEntries.empty()
+                        && nowUs - mEntries.begin()->mRecycledUs >= mTimeoutUs) {
+                    ALOGV("releasing %s", mEntries.begin()->mName.c_str());
+                    expired.push_back(mEntries.begin()->mCodec);
+                    mEntries.erase(mEntries.begin());
+                    --mNumEntries;
+                }
+            }
+
+            for (size_t i = 0; i < expired.size(); ++i) {
+                expired.editItemAt(i)->release();
+            }
+            break;
+        }
+
+        case kWhatPrewarm:
+        {
+            onPrewarm(msg);
+            break;
+        }
+
+        default:
+            TRESPASS();
+    }
+}
+
+}  // namespace android
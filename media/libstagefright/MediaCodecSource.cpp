@@ -57,6 +57,7 @@ struct MediaCodecSource::Puller : public AHandler {
     void resume();
 
     bool readBuffer(MediaBuffer **buffer);
+    void logStats();
 
 protected:
     virtual void onMessageReceived(const sp<AMessage> &msg);
@@ -78,11 +79,34 @@ private:
         Queue()
             : mReadPendingSince(0),
               mPaused(false),
-              mPulling(false) { }
+              mPulling(false),
+              mNotifyPending(false),
+              mNumReads(0),
+              mReadTotalUs(0),
+              mReadMaxUs(0),
+              mNumQueued(0),
+              mQueuedTotalUs(0),
+              mQueuedMaxUs(0) { }
         int64_t mReadPendingSince;
         bool mPaused;
         bool mPulling;
-        Vector<MediaBuffer *> mReadBuffers;
+        // set while a notify is posted that the reader hasn't drained the
+        // queue for yet, so that a busy reader gets one notify per batch
+        // instead of one per buffer
+        bool mNotifyPending;
+        struct ReadBuffer {
+            MediaBuffer *mBuffer;
+            int64_t mQueuedUs;
+        };
+        Vector<ReadBuffer> mReadBuffers;
+
+        // time spent in source reads, and buffers waiting for the encoder
+        int64_t mNumReads;
+        int64_t mReadTotalUs;
+        int64_t mReadMaxUs;
+        int64_t mNumQueued;
+        int64_t mQueuedTotalUs;
+        int64_t mQueuedMaxUs;
 
         void flush();
         // if queue is empty, return false and set *|buffer| to NULL . Otherwise, pop
@@ -120,15 +144,26 @@ MediaCodecSource::Puller::~Puller() {
 }
 
 void MediaCodecSource::Puller::Queue::pushBuffer(MediaBuffer *mbuf) {
-    mReadBuffers.push_back(mbuf);
+    ReadBuffer entry;
+    entry.mBuffer = mbuf;
+    entry.mQueuedUs = ALooper::GetNowUs();
+    mReadBuffers.push_back(entry);
 }
 
 bool MediaCodecSource::Puller::Queue::readBuffer(MediaBuffer **mbuf) {
     if (mReadBuffers.empty()) {
         *mbuf = NULL;
+        mNotifyPending = false;
         return false;
     }
-    *mbuf = *mReadBuffers.begin();
+    const ReadBuffer &entry = *mReadBuffers.begin();
+    *mbuf = entry.mBuffer;
+    int64_t queuedUs = ALooper::GetNowUs() - entry.mQueuedUs;
+    ++mNumQueued;
+    mQueuedTotalUs += queuedUs;
+    if (queuedUs > mQueuedMaxUs) {
+        mQueuedMaxUs = queuedUs;
+    }
     mReadBuffers.erase(mReadBuffers.begin());
     return true;
 }
@@ -146,6 +181,20 @@ bool MediaCodecSource::Puller::readBuffer(MediaBuffer **mbuf) {
     return queue->readBuffer(mbuf);
 }
 
+void MediaCodecSource::Puller::logStats() {
+    Mutexed<Queue>::Locked queue(mQueue);
+    if (queue->mNumReads == 0 || queue->mNumQueued == 0) {
+        return;
+    }
+    ALOGI("puller (%s) read %lld buffers: read avg %lld max %lld us, "
+            "queued avg %lld max %lld us",
+            mIsAudio ? "audio" : "video", (long long)queue->mNumReads,
+            (long long)(queue->mReadTotalUs / queue->mNumReads),
+            (long long)queue->mReadMaxUs,
+            (long long)(queue->mQueuedTotalUs / queue->mNumQueued),
+            (long long)queue->mQueuedMaxUs);
+}
+
 status_t MediaCodecSource::Puller::postSynchronouslyAndReturnError(
         const sp<AMessage> &msg) {
     sp<AMessage> response;
@@ -273,11 +322,20 @@ void MediaCodecSource::Puller::onMessageReceived(const sp<AMessage> &msg) {
                 break;
             }
 
+            int64_t readStartUs = queue->mReadPendingSince;
             queue.unlock();
             MediaBuffer *mbuf = NULL;
             status_t err = mSource->read(&mbuf);
             queue.lock();
 
+            if (err == OK) {
+                int64_t readUs = ALooper::GetNowUs() - readStartUs;
+                ++queue->mNumReads;
+                queue->mReadTotalUs += readUs;
+                if (readUs > queue->mReadMaxUs) {
+                    queue->mReadMaxUs = readUs;
+                }
+            }
             queue->mReadPendingSince = 0;
             // if we need to discard buffer
             if (!queue->mPulling || queue->mPaused || err != OK) {
@@ -295,14 +353,19 @@ void MediaCodecSource::Puller::onMessageReceived(const sp<AMessage> &msg) {
                 }
             }
 
+            bool notify = false;
             if (mbuf != NULL) {
                 queue->pushBuffer(mbuf);
+                notify = !queue->mNotifyPending;
+                queue->mNotifyPending = true;
             }
 
             queue.unlock();
 
             if (mbuf != NULL) {
-                mNotify->post();
+                if (notify) {
+                    mNotify->post();
+                }
                 msg->post();
             } else {
                 handleEOS();
@@ -612,6 +675,9 @@ void MediaCodecSource::signalEOS(status_t err) {
 
     if (mStopping && reachedEOS) {
         ALOGI("encoder (%s) stopped", mIsVideo ? "video" : "audio");
+        if (mPuller != NULL) {
+            mPuller->logStats();
+        }
         mPuller->stopSource();
         ALOGV("source (%s) stopped", mIsVideo ? "video" : "audio");
         // posting reply to everyone that's waiting
@@ -23,6 +23,8 @@
 
 #include <media/stagefright/MediaMuxer.h>
 
+#include <cutils/properties.h>
+
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
@@ -38,9 +40,24 @@
 
 namespace android {
 
+// Default budget of the samples from queueSampleData() not written yet.
+static const int32_t kDefaultMaxBufferedKB = 16 * 1024;
+
+// How often stop() checks whether the writer is done while it waits for the
+// tracks added by addSourceTrack() to end.
+static const nsecs_t kSourceTrackPollNs = 100000000ll;
+
 MediaMuxer::MediaMuxer(int fd, OutputFormat format)
     : mFormat(format),
+      mNumTracksWithoutPendingSamples(0),
       mState(UNINITIALIZED) {
+    int32_t maxBufferedKB =
+        property_get_int32("media.muxer.max-buffered-kb", kDefaultMaxBufferedKB);
+    if (maxBufferedKB <= 0) {
+        maxBufferedKB = kDefaultMaxBufferedKB;
+    }
+    mBudget = new MediaBufferBudget((size_t)maxBufferedKB * 1024);
+
     if (format == OUTPUT_FORMAT_MPEG_4) {
         mWriter = new MPEG4Writer(fd);
     } else if (format == OUTPUT_FORMAT_WEBM) {
@@ -57,6 +74,15 @@ MediaMuxer::~MediaMuxer() {
     Mutex::Autolock autoLock(mMuxerLock);
 
     // Clean up all the internal resources.
+    for (size_t i = 0; i < mPendingSamples.size(); ++i) {
+        List<PendingSample> &samples = mPendingSamples.editItemAt(i);
+        for (List<PendingSample>::iterator it = samples.begin(); it != samples.end(); ++it) {
+            mBudget->release(it->mBuffer->size());
+            it->mBuffer->release();
+        }
+    }
+    mPendingSamples.clear();
+    mSourceTrackList.clear();
     mFileMeta.clear();
     mWriter.clear();
     mTrackList.clear();
@@ -81,11 +107,131 @@ ssize_t MediaMuxer::addTrack(const sp<AMessage> &format) {
     sp<MediaAdapter> newTrack = new MediaAdapter(trackMeta);
     status_t result = mWriter->addSource(newTrack);
     if (result == OK) {
+        newTrack->setBudget(mBudget);
+        mPendingSamples.push(List<PendingSample>());
+        ++mNumTracksWithoutPendingSamples;
         return mTrackList.add(newTrack);
     }
     return -1;
 }
 
+// Passes the buffers of a track through to the writer, within the trimming
+// range, and lets stop() wait for the writer to have read them all.
+struct MediaMuxer::PassThroughSource : public MediaSource {
+    PassThroughSource(const sp<IMediaSource> &source, int64_t startTimeUs, int64_t endTimeUs)
+        : mSource(source),
+          mStartTimeUs(startTimeUs),
+          mEndTimeUs(endTimeUs),
+          mSeekPending(false),
+          mReachedEnd(false) {
+    }
+
+    virtual status_t start(MetaData *params) {
+        Mutex::Autolock autoLock(mLock);
+        mSeekPending = mStartTimeUs > 0;
+        mReachedEnd = false;
+        return mSource->start(params);
+    }
+
+    virtual status_t stop() {
+        return mSource->stop();
+    }
+
+    virtual sp<MetaData> getFormat() {
+        return mSource->getFormat();
+    }
+
+    virtual status_t read(MediaBuffer **buffer, const ReadOptions *options) {
+        *buffer = NULL;
+
+        Mutex::Autolock autoLock(mLock);
+        if (mReachedEnd) {
+            return ERROR_END_OF_STREAM;
+        }
+
+        ReadOptions seekOptions;
+        if (mSeekPending && options == NULL) {
+            seekOptions.setSeekTo(mStartTimeUs, ReadOptions::SEEK_PREVIOUS_SYNC);
+            options = &seekOptions;
+        }
+        mSeekPending = false;
+
+        status_t err = mSource->read(buffer, options);
+        int64_t timeUs;
+        if (err == OK && mEndTimeUs >= 0
+                && (*buffer)->meta_data()->findInt64(kKeyTime, &timeUs)
+                && timeUs > mEndTimeUs) {
+            (*buffer)->release();
+            *buffer = NULL;
+            err = ERROR_END_OF_STREAM;
+        }
+        if (err != OK && err != INFO_FORMAT_CHANGED) {
+            mReachedEnd = true;
+            mEndCond.broadcast();
+        }
+        return err;
+    }
+
+    // Returns false if it is still not reached after timeoutNs.
+    bool waitForEnd(nsecs_t timeoutNs) {
+        Mutex::Autolock autoLock(mLock);
+        if (!mReachedEnd) {
+            mEndCond.waitRelative(mLock, timeoutNs);
+        }
+        return mReachedEnd;
+    }
+
+protected:
+    virtual ~PassThroughSource() {}
+
+private:
+    sp<IMediaSource> mSource;
+    int64_t mStartTimeUs;
+    int64_t mEndTimeUs;
+
+    Mutex mLock;
+    Condition mEndCond;
+    bool mSeekPending;
+    bool mReachedEnd;
+
+    DISALLOW_EVIL_CONSTRUCTORS(PassThroughSource);
+};
+
+ssize_t MediaMuxer::addSourceTrack(
+        const sp<IMediaSource> &source, int64_t startTimeUs, int64_t endTimeUs) {
+    Mutex::Autolock autoLock(mMuxerLock);
+
+    if (source == NULL) {
+        ALOGE("addSourceTrack() get a null source");
+        return -EINVAL;
+    }
+
+    if (mState != INITIALIZED) {
+        ALOGE("addSourceTrack() must be called after constructor and before start().");
+        return INVALID_OPERATION;
+    }
+
+    sp<PassThroughSource> track = new PassThroughSource(source, startTimeUs, endTimeUs);
+    status_t result = mWriter->addSource(track);
+    if (result == OK) {
+        mSourceTrackList.push(track);
+        // stays empty, and does not hold back the interleaving
+        mPendingSamples.push(List<PendingSample>());
+        return mTrackList.add(NULL);
+    }
+    return -1;
+}
+
+status_t MediaMuxer::setMaxBufferedBytes(size_t maxBytes) {
+    Mutex::Autolock autoLock(mMuxerLock);
+    if (maxBytes == 0) {
+        ALOGE("setMaxBufferedBytes() get a zero budget");
+        return -EINVAL;
+    }
+    mBudget->setMaxBytes(maxBytes);
+    return OK;
+}
+
 status_t MediaMuxer::setOrientationHint(int degrees) {
     Mutex::Autolock autoLock(mMuxerLock);
     if (mState != INITIALIZED) {
@@ -134,8 +280,20 @@ status_t MediaMuxer::stop() {
 
     if (mState == STARTED) {
         mState = STOPPED;
+        // Let the writer read the tracks added by addSourceTrack() to their
+        // end, unless it stopped reading.
+        for (size_t i = 0; i < mSourceTrackList.size(); ++i) {
+            while (!mSourceTrackList[i]->waitForEnd(kSourceTrackPollNs)) {
+                if (mWriter->reachedEOS()) {
+                    break;
+                }
+            }
+        }
+        if (flushPendingSamples_l() != OK) {
+            ALOGW("stop() could not hand all the queued samples to the writer");
+        }
         for (size_t i = 0; i < mTrackList.size(); i++) {
-            if (mTrackList[i]->stop() != OK) {
+            if (mTrackList[i] != NULL && mTrackList[i]->stop() != OK) {
                 return INVALID_OPERATION;
             }
         }
@@ -146,10 +304,7 @@ status_t MediaMuxer::stop() {
     }
 }
 
-status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
-                                     int64_t timeUs, uint32_t flags) {
-    Mutex::Autolock autoLock(mMuxerLock);
-
+status_t MediaMuxer::checkSample_l(const sp<ABuffer> &buffer, size_t trackIndex) {
     if (buffer.get() == NULL) {
         ALOGE("WriteSampleData() get an NULL buffer.");
         return -EINVAL;
@@ -165,9 +320,18 @@ status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackInde
         return -EINVAL;
     }
 
+    if (mTrackList[trackIndex] == NULL) {
+        ALOGE("WriteSampleData() track %zu is read from its source", trackIndex);
+        return -EINVAL;
+    }
+    return OK;
+}
+
+// static
+MediaBuffer *MediaMuxer::makeSample(
+        const sp<ABuffer> &buffer, int64_t timeUs, uint32_t flags) {
     MediaBuffer* mediaBuffer = new MediaBuffer(buffer);
 
-    mediaBuffer->add_ref(); // Released in MediaAdapter::signalBufferReturned().
     mediaBuffer->set_range(buffer->offset(), buffer->size());
 
     sp<MetaData> sampleMetaData = mediaBuffer->meta_data();
@@ -178,10 +342,118 @@ status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackInde
     if (flags & MediaCodec::BUFFER_FLAG_SYNCFRAME) {
         sampleMetaData->setInt32(kKeyIsSyncFrame, true);
     }
+    return mediaBuffer;
+}
+
+status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
+                                     int64_t timeUs, uint32_t flags) {
+    Mutex::Autolock autoLock(mMuxerLock);
+
+    status_t err = checkSample_l(buffer, trackIndex);
+    if (err != OK) {
+        return err;
+    }
+
+    // keep the order with the samples sent by queueSampleData()
+    err = flushPendingSamples_l();
+    if (err != OK) {
+        return err;
+    }
+
+    MediaBuffer* mediaBuffer = makeSample(buffer, timeUs, flags);
+    mediaBuffer->add_ref(); // Released in MediaAdapter::signalBufferReturned().
 
     sp<MediaAdapter> currentTrack = mTrackList[trackIndex];
     // This pushBuffer will wait until the mediaBuffer is consumed.
     return currentTrack->pushBuffer(mediaBuffer);
 }
 
+status_t MediaMuxer::queueSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
+                                     int64_t timeUs, uint32_t flags) {
+    Mutex::Autolock autoLock(mMuxerLock);
+
+    status_t err = checkSample_l(buffer, trackIndex);
+    if (err != OK) {
+        return err;
+    }
+
+    MediaBuffer* mediaBuffer = makeSample(buffer, timeUs, flags);
+    if (!mBudget->tryAcquire(mediaBuffer->size())) {
+        // The writer can only free up the budget with the samples it has.
+        err = flushPendingSamples_l();
+        if (err != OK) {
+            mediaBuffer->release();
+            return err;
+        }
+        mBudget->acquire(mediaBuffer->size());
+    }
+
+    List<PendingSample> &samples = mPendingSamples.editItemAt(trackIndex);
+    if (samples.empty()) {
+        --mNumTracksWithoutPendingSamples;
+    }
+    PendingSample sample;
+    sample.mBuffer = mediaBuffer;
+    sample.mTimeUs = timeUs;
+    samples.push_back(sample);
+
+    return interleavePendingSamples_l();
+}
+
+status_t MediaMuxer::queuePendingSample_l(size_t trackIndex) {
+    List<PendingSample> &samples = mPendingSamples.editItemAt(trackIndex);
+    CHECK(!samples.empty());
+
+    MediaBuffer *mediaBuffer = samples.begin()->mBuffer;
+    samples.erase(samples.begin());
+    if (samples.empty()) {
+        ++mNumTracksWithoutPendingSamples;
+    }
+
+    size_t size = mediaBuffer->size();
+    status_t err = mTrackList[trackIndex]->queueBuffer(mediaBuffer);
+    if (err != OK) {
+        mBudget->release(size);
+        mediaBuffer->release();
+    }
+    return err;
+}
+
+// No later sample of a track can be earlier than the ones it has pending, so
+// once every track has one, the earliest pending sample can go.
+status_t MediaMuxer::interleavePendingSamples_l() {
+    while (mNumTracksWithoutPendingSamples == 0) {
+        status_t err = queuePendingSample_l(earliestPendingSample_l());
+        if (err != OK) {
+            return err;
+        }
+    }
+    return OK;
+}
+
+// The tracks added by addSourceTrack() never have pending samples.
+ssize_t MediaMuxer::earliestPendingSample_l() const {
+    ssize_t index = -1;
+    for (size_t i = 0; i < mPendingSamples.size(); ++i) {
+        if (!mPendingSamples[i].empty() && (index < 0
+                || mPendingSamples[i].begin()->mTimeUs
+                        < mPendingSamples[index].begin()->mTimeUs)) {
+            index = i;
+        }
+    }
+    return index;
+}
+
+status_t MediaMuxer::flushPendingSamples_l() {
+    status_t result = OK;
+    ssize_t index;
+    while ((index = earliestPendingSample_l()) >= 0) {
+        status_t err = queuePendingSample_l(index);
+        if (err != OK && result == OK) {
+            result = err;
+        }
+    }
+    return result;
+}
+
 }  // namespace android
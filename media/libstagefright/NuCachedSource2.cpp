@@ -22,6 +22,8 @@
 
 #include "include/NuCachedSource2.h"
 #include "include/HTTPBase.h"
+#include "include/HTTPDiskCache.h"
+#include "include/HTTPRangeFetcher.h"
 
 #include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -43,6 +45,7 @@ struct PageCache {
     void releasePage(Page *page);
 
     void appendPage(Page *page);
+    void appendPages(PageCache *other);
     size_t releaseFromStart(size_t maxBytes);
 
     size_t totalSize() const {
@@ -112,6 +115,19 @@ void PageCache::appendPage(Page *page) {
     mActivePages.push_back(page);
 }
 
+// Moves the pages of other to the end of this cache.
+void PageCache::appendPages(PageCache *other) {
+    List<Page *>::iterator it = other->mActivePages.begin();
+    while (it != other->mActivePages.end()) {
+        mActivePages.push_back(*it);
+        ++it;
+    }
+    other->mActivePages.clear();
+
+    mTotalSize += other->mTotalSize;
+    other->mTotalSize = 0;
+}
+
 size_t PageCache::releaseFromStart(size_t maxBytes) {
     size_t bytesReleased = 0;
 
@@ -182,12 +198,15 @@ void PageCache::copy(size_t from, void *data, size_t size) {
 NuCachedSource2::NuCachedSource2(
         const sp<DataSource> &source,
         const char *cacheConfig,
-        bool disconnectAtHighwatermark)
+        bool disconnectAtHighwatermark,
+        const sp<HTTPRangeFetcher> &rangeFetcher)
     : mSource(source),
       mReflector(new AHandlerReflector<NuCachedSource2>(this)),
       mLooper(new ALooper),
       mCache(new PageCache(kPageSize)),
       mCacheOffset(0),
+      mRetainedSize(0),
+      mRetainedUseCount(0),
       mFinalStatus(OK),
       mLastAccessPos(0),
       mFetching(true),
@@ -197,7 +216,8 @@ NuCachedSource2::NuCachedSource2(
       mHighwaterThresholdBytes(kDefaultHighWaterThreshold),
       mLowwaterThresholdBytes(kDefaultLowWaterThreshold),
       mKeepAliveIntervalUs(kDefaultKeepAliveIntervalUs),
-      mDisconnectAtHighwatermark(disconnectAtHighwatermark) {
+      mDisconnectAtHighwatermark(disconnectAtHighwatermark),
+      mRangeFetcher(rangeFetcher) {
     // We are NOT going to support disconnect-at-highwatermark indefinitely
     // and we are not guaranteeing support for client-specified cache
     // parameters. Both of these are temporary measures to solve a specific
@@ -214,6 +234,10 @@ NuCachedSource2::NuCachedSource2(
         mKeepAliveIntervalUs = 0;
     }
 
+    if (mSource->flags() & kIsHTTPBasedSource) {
+        mDiskCache = HTTPDiskCache::Open(mSource);
+    }
+
     mLooper->setName("NuCachedSource2");
     mLooper->registerHandler(mReflector);
 
@@ -234,21 +258,30 @@ NuCachedSource2::~NuCachedSource2() {
 
     delete mCache;
     mCache = NULL;
+
+    for (size_t i = 0; i < mRetainedRanges.size(); ++i) {
+        delete mRetainedRanges[i].mCache;
+    }
+    mRetainedRanges.clear();
 }
 
 // static
 sp<NuCachedSource2> NuCachedSource2::Create(
         const sp<DataSource> &source,
         const char *cacheConfig,
-        bool disconnectAtHighwatermark) {
+        bool disconnectAtHighwatermark,
+        const sp<HTTPRangeFetcher> &rangeFetcher) {
     sp<NuCachedSource2> instance = new NuCachedSource2(
-            source, cacheConfig, disconnectAtHighwatermark);
+            source, cacheConfig, disconnectAtHighwatermark, rangeFetcher);
     Mutex::Autolock autoLock(instance->mLock);
     (new AMessage(kWhatFetchMore, instance->mReflector))->post();
     return instance;
 }
 
 status_t NuCachedSource2::getEstimatedBandwidthKbps(int32_t *kbps) {
+    if (mRangeFetcher != NULL) {
+        return mRangeFetcher->getEstimatedBandwidthKbps(kbps);
+    }
     if (mSource->flags() & kIsHTTPBasedSource) {
         HTTPBase* source = static_cast<HTTPBase *>(mSource.get());
         return source->getEstimatedBandwidthKbps(kbps);
@@ -273,6 +306,9 @@ void NuCachedSource2::disconnect() {
 
         // explicitly disconnect from the source, to allow any
         // pending reads to return more promptly
+        if (mRangeFetcher != NULL) {
+            mRangeFetcher->disconnect();
+        }
         static_cast<HTTPBase *>(mSource.get())->disconnect();
     }
 }
@@ -330,7 +366,8 @@ void NuCachedSource2::fetchInternal() {
         if (mFinalStatus != OK) {
             --mNumRetriesLeft;
 
-            reconnect = true;
+            // the range fetcher reconnects by itself
+            reconnect = mRangeFetcher == NULL;
         }
     }
 
@@ -357,10 +394,36 @@ void NuCachedSource2::fetchInternal() {
         }
     }
 
+    size_t maxSize;
+    {
+        Mutex::Autolock autoLock(mLock);
+        maxSize = spliceRetainedRange_l();
+
+        // make room for the page within the high water budget, the pinned
+        // ranges are kept at the expense of the fetched range
+        size_t activeSize = mCache->totalSize() + maxSize;
+        trimRetainedRanges_l(activeSize < mHighwaterThresholdBytes
+                ? mHighwaterThresholdBytes - activeSize : 0, false /* evictPinned */);
+    }
+
     PageCache::Page *page = mCache->acquirePage();
 
-    ssize_t n = mSource->readAt(
-            mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+    off64_t fetchOffset = mCacheOffset + mCache->totalSize();
+    ssize_t n = -EAGAIN;
+    if (mDiskCache != NULL) {
+        n = mDiskCache->readAt(fetchOffset, page->mData, maxSize);
+    }
+    if (n == -EAGAIN) {
+        if (mRangeFetcher != NULL) {
+            n = mRangeFetcher->readAt(fetchOffset, page->mData, maxSize);
+        } else {
+            n = mSource->readAt(fetchOffset, page->mData, maxSize);
+        }
+
+        if (n > 0 && mDiskCache != NULL) {
+            mDiskCache->write(fetchOffset, page->mData, n);
+        }
+    }
 
     Mutex::Autolock autoLock(mLock);
 
@@ -416,7 +479,7 @@ void NuCachedSource2::onFetch() {
 
         mLastFetchTimeUs = ALooper::GetNowUs();
 
-        if (mFetching && mCache->totalSize() >= mHighwaterThresholdBytes) {
+        if (mFetching && mCache->totalSize() + mRetainedSize >= mHighwaterThresholdBytes) {
             ALOGI("Cache full, done prefetching for now");
             mFetching = false;
 
@@ -533,6 +596,15 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
         return size;
     }
 
+    ssize_t index = findRetainedRange_l(offset, size);
+    if (index >= 0) {
+        RetainedRange *range = &mRetainedRanges.editItemAt(index);
+        range->mCache->copy(offset - range->mOffset, data, size);
+        range->mLastUse = ++mRetainedUseCount;
+
+        return size;
+    }
+
     sp<AMessage> msg = new AMessage(kWhatRead, mReflector);
     msg->setInt64("offset", offset);
     msg->setPointer("data", data);
@@ -601,6 +673,17 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
         return ERROR_END_OF_STREAM;
     }
 
+    // A range retained from before a seek serves the read without moving
+    // the fetched range.
+    ssize_t index = findRetainedRange_l(offset, size);
+    if (index >= 0) {
+        RetainedRange *range = &mRetainedRanges.editItemAt(index);
+        range->mCache->copy(offset - range->mOffset, data, size);
+        range->mLastUse = ++mRetainedUseCount;
+
+        return size;
+    }
+
     if (!mFetching) {
         mLastAccessPos = offset;
         restartPrefetcherIfNecessary_l(
@@ -660,10 +743,32 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
 
     ALOGI("new range: offset= %lld", (long long)offset);
 
-    mCacheOffset = offset;
+    retainCurrentRange_l();
 
-    size_t totalSize = mCache->totalSize();
-    CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
+    // resume a retained range holding the offset, or start a new one
+    ssize_t index = -1;
+    for (size_t i = 0; i < mRetainedRanges.size(); ++i) {
+        const RetainedRange &range = mRetainedRanges.itemAt(i);
+        if (offset >= range.mOffset
+                && offset <= (off64_t)(range.mOffset + range.mCache->totalSize())) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index >= 0) {
+        const RetainedRange &range = mRetainedRanges.itemAt(index);
+        ALOGV("resuming range at %lld, size %zu",
+                (long long)range.mOffset, range.mCache->totalSize());
+
+        delete mCache;
+        mCache = range.mCache;
+        mCacheOffset = range.mOffset;
+        mRetainedSize -= mCache->totalSize();
+        mRetainedRanges.removeAt(index);
+    } else {
+        mCacheOffset = offset;
+    }
 
     mNumRetriesLeft = kMaxNumRetries;
     mFetching = true;
@@ -671,6 +776,120 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
     return OK;
 }
 
+ssize_t NuCachedSource2::findRetainedRange_l(off64_t offset, size_t size) const {
+    for (size_t i = 0; i < mRetainedRanges.size(); ++i) {
+        const RetainedRange &range = mRetainedRanges.itemAt(i);
+        if (offset >= range.mOffset
+                && offset + size <= range.mOffset + range.mCache->totalSize()) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Moves the pages of mCache into a retained range, leaving mCache empty.
+void NuCachedSource2::retainCurrentRange_l() {
+    size_t totalSize = mCache->totalSize();
+    if (totalSize == 0) {
+        return;
+    }
+
+    if (mRetainedRanges.size() >= kMaxNumRetainedRanges) {
+        evictRetainedRange_l(true /* evictPinned */);
+    }
+
+    off64_t size;
+    RetainedRange range;
+    range.mOffset = mCacheOffset;
+    range.mCache = new PageCache(kPageSize);
+    range.mCache->appendPages(mCache);
+    range.mLastUse = ++mRetainedUseCount;
+    range.mPinned = totalSize <= kMaxPinnedRangeSize
+            && (mCacheOffset == 0
+                || (mSource->getSize(&size) == OK
+                    && mCacheOffset + (off64_t)totalSize >= size));
+
+    mRetainedRanges.push(range);
+    mRetainedSize += totalSize;
+}
+
+// Evicts the least recently used retained range, not pinned if possible.
+// Returns false if there is none to evict.
+bool NuCachedSource2::evictRetainedRange_l(bool evictPinned) {
+    ssize_t victim = -1;
+    for (size_t i = 0; i < mRetainedRanges.size(); ++i) {
+        const RetainedRange &range = mRetainedRanges.itemAt(i);
+        if (range.mPinned && !evictPinned) {
+            continue;
+        }
+        if (victim < 0) {
+            victim = i;
+            continue;
+        }
+        const RetainedRange &other = mRetainedRanges.itemAt(victim);
+        if (range.mPinned != other.mPinned
+                ? !range.mPinned : range.mLastUse < other.mLastUse) {
+            victim = i;
+        }
+    }
+
+    if (victim < 0) {
+        return false;
+    }
+
+    const RetainedRange &range = mRetainedRanges.itemAt(victim);
+    ALOGV("evicting range at %lld, size %zu",
+            (long long)range.mOffset, range.mCache->totalSize());
+
+    mRetainedSize -= range.mCache->totalSize();
+    delete range.mCache;
+    mRetainedRanges.removeAt(victim);
+
+    return true;
+}
+
+void NuCachedSource2::trimRetainedRanges_l(size_t maxBytes, bool evictPinned) {
+    while (mRetainedSize > maxBytes && evictRetainedRange_l(evictPinned)) {
+    }
+}
+
+// Appends a retained range that starts where the fetched range ends, and
+// returns how much to fetch next so as to stop at the next one.
+size_t NuCachedSource2::spliceRetainedRange_l() {
+    bool joined;
+    size_t maxSize;
+    do {
+        joined = false;
+        maxSize = kPageSize;
+
+        off64_t fetchOffset = mCacheOffset + mCache->totalSize();
+        for (size_t i = 0; i < mRetainedRanges.size(); ++i) {
+            const RetainedRange &range = mRetainedRanges.itemAt(i);
+
+            if (range.mOffset == fetchOffset) {
+                ALOGV("joining range at %lld, size %zu",
+                        (long long)range.mOffset, range.mCache->totalSize());
+
+                mRetainedSize -= range.mCache->totalSize();
+                mCache->appendPages(range.mCache);
+                delete range.mCache;
+                mRetainedRanges.removeAt(i);
+
+                // the next range may now follow
+                joined = true;
+                break;
+            }
+
+            if (range.mOffset > fetchOffset
+                    && range.mOffset - fetchOffset < (off64_t)maxSize) {
+                maxSize = range.mOffset - fetchOffset;
+            }
+        }
+    } while (joined);
+
+    return maxSize;
+}
+
 void NuCachedSource2::resumeFetchingIfNecessary() {
     Mutex::Autolock autoLock(mLock);
 
@@ -255,6 +255,30 @@ status_t NuMediaExtractor::getTrackFormat(
     return convertMetaDataToMessage(meta, format);
 }
 
+status_t NuMediaExtractor::getTrackSource(size_t index, sp<IMediaSource> *source) const {
+    Mutex::Autolock autoLock(mLock);
+
+    *source = NULL;
+
+    if (mImpl == NULL) {
+        return -EINVAL;
+    }
+
+    if (index >= mImpl->countTracks()) {
+        return -ERANGE;
+    }
+
+    for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
+        if (mSelectedTracks.itemAt(i).mTrackIndex == index) {
+            ALOGE("track %zu is selected", index);
+            return INVALID_OPERATION;
+        }
+    }
+
+    *source = mImpl->getTrack(index);
+    return *source == NULL ? ERROR_MALFORMED : OK;
+}
+
 status_t NuMediaExtractor::getFileFormat(sp<AMessage> *format) const {
     Mutex::Autolock autoLock(mLock);
 
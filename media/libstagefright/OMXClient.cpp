@@ -148,6 +148,12 @@ struct MuxOMX : public IOMX {
             OMX_U32 range_offset, OMX_U32 range_length,
             OMX_U32 flags, OMX_TICKS timestamp, int fenceFd);
 
+    virtual status_t fillBuffers(
+            node_id node, const FillBufferInfo *buffers, size_t count, size_t *numFilled);
+
+    virtual status_t emptyBuffers(
+            node_id node, const EmptyBufferInfo *buffers, size_t count, size_t *numEmptied);
+
     virtual status_t getExtensionIndex(
             node_id node,
             const char *parameter_name,
@@ -476,6 +482,16 @@ status_t MuxOMX::emptyBuffer(
             node, buffer, range_offset, range_length, flags, timestamp, fenceFd);
 }
 
+status_t MuxOMX::fillBuffers(
+        node_id node, const FillBufferInfo *buffers, size_t count, size_t *numFilled) {
+    return getOMX(node)->fillBuffers(node, buffers, count, numFilled);
+}
+
+status_t MuxOMX::emptyBuffers(
+        node_id node, const EmptyBufferInfo *buffers, size_t count, size_t *numEmptied) {
+    return getOMX(node)->emptyBuffers(node, buffers, count, numEmptied);
+}
+
 status_t MuxOMX::getExtensionIndex(
         node_id node,
         const char *parameter_name,
@@ -33,6 +33,9 @@
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
 #include <utils/String8.h>
+#include <utils/threads.h>
+
+#include <pthread.h>
 
 extern "C" {
     #include <Tremolo/codec_internal.h>
@@ -102,7 +105,7 @@ protected:
 
     struct TOCEntry {
         off64_t mPageOffset;
-        int64_t mTimeUs;
+        uint64_t mGranulePosition;
     };
 
     sp<DataSource> mSource;
@@ -127,7 +130,20 @@ protected:
     sp<MetaData> mMeta;
     sp<MetaData> mFileMeta;
 
+    // The table of contents lists pages in stream order, covering the
+    // stream up to mTOCEndOffset and keeping one page out of mTOCStride to
+    // stay within kMaxNumTOCEntries.  It is filled in by the pages read for
+    // playback, and for local files by a scan on mTOCThread, so that seeks
+    // into the part of the stream seen so far need not estimate an offset.
+    Mutex mTOCLock;
     Vector<TOCEntry> mTableOfContents;
+    off64_t mTOCEndOffset;
+    size_t mTOCStride;
+    size_t mTOCSkipped;
+    bool mTOCComplete;
+    bool mTOCThreadStop;
+    bool mTOCThreadStarted;
+    pthread_t mTOCThread;
 
     ssize_t readPage(off64_t offset, Page *page);
     status_t findNextPage(off64_t startOffset, off64_t *pageOffset);
@@ -157,7 +173,9 @@ protected:
 
     status_t findPrevGranulePosition(off64_t pageOffset, uint64_t *granulePos);
 
-    void buildTableOfContents();
+    void addTOCEntry_l(off64_t offset, size_t pageSize, const Page &page);
+    static void *TOCThreadWrapper(void *me);
+    void scanTableOfContents();
 
     MyOggExtractor(const MyOggExtractor &);
     MyOggExtractor &operator=(const MyOggExtractor &);
@@ -309,7 +327,13 @@ MyOggExtractor::MyOggExtractor(
       mMimeType(mimeType),
       mNumHeaders(numHeaders),
       mSeekPreRollUs(seekPreRollUs),
-      mFirstDataOffset(-1) {
+      mFirstDataOffset(-1),
+      mTOCEndOffset(-1),
+      mTOCStride(1),
+      mTOCSkipped(0),
+      mTOCComplete(false),
+      mTOCThreadStop(false),
+      mTOCThreadStarted(false) {
     mCurrentPage.mNumSegments = 0;
 
     vorbis_info_init(&mVi);
@@ -317,6 +341,14 @@ MyOggExtractor::MyOggExtractor(
 }
 
 MyOggExtractor::~MyOggExtractor() {
+    if (mTOCThreadStarted) {
+        {
+            Mutex::Autolock autoLock(mTOCLock);
+            mTOCThreadStop = true;
+        }
+        void *dummy;
+        pthread_join(mTOCThread, &dummy);
+    }
     vorbis_comment_clear(&mVc);
     vorbis_info_clear(&mVi);
 }
@@ -416,46 +448,67 @@ status_t MyOggExtractor::seekToTime(int64_t timeUs) {
         timeUs = 0;
     }
 
-    if (mTableOfContents.isEmpty()) {
-        // Perform approximate seeking based on avg. bitrate.
-        uint64_t bps = approxBitrate();
-        if (bps <= 0) {
-            return INVALID_OPERATION;
-        }
-
-        off64_t pos = timeUs * bps / 8000000ll;
+    off64_t pos = -1;
+    {
+        Mutex::Autolock autoLock(mTOCLock);
+        if (!mTableOfContents.isEmpty()) {
+            const TOCEntry &last = mTableOfContents.top();
+            int64_t lastTimeUs = getTimeUsOfGranule(last.mGranulePosition);
+            if (timeUs <= lastTimeUs || mTOCComplete) {
+                size_t left = 0;
+                size_t right_plus_one = mTableOfContents.size();
+                while (left < right_plus_one) {
+                    size_t center = left + (right_plus_one - left) / 2;
+
+                    const TOCEntry &entry = mTableOfContents.itemAt(center);
+                    int64_t entryTimeUs = getTimeUsOfGranule(entry.mGranulePosition);
+
+                    if (timeUs < entryTimeUs) {
+                        right_plus_one = center;
+                    } else if (timeUs > entryTimeUs) {
+                        left = center + 1;
+                    } else {
+                        left = center;
+                        break;
+                    }
+                }
 
-        ALOGV("seeking to offset %lld", (long long)pos);
-        return seekToOffset(pos);
-    }
+                if (left == mTableOfContents.size()) {
+                    --left;
+                }
 
-    size_t left = 0;
-    size_t right_plus_one = mTableOfContents.size();
-    while (left < right_plus_one) {
-        size_t center = left + (right_plus_one - left) / 2;
+                pos = mTableOfContents.itemAt(left).mPageOffset;
 
-        const TOCEntry &entry = mTableOfContents.itemAt(center);
+                ALOGV("seeking to entry %zu / %zu at offset %lld",
+                     left, mTableOfContents.size(), (long long)pos);
+            } else {
+                // Past the pages seen so far, estimate the offset from the
+                // last one instead of from the start of the stream.
+                pos = last.mPageOffset;
+                uint64_t bps = approxBitrate();
+                if (bps > 0 && lastTimeUs >= 0) {
+                    pos += (timeUs - lastTimeUs) * bps / 8000000ll;
+                }
 
-        if (timeUs < entry.mTimeUs) {
-            right_plus_one = center;
-        } else if (timeUs > entry.mTimeUs) {
-            left = center + 1;
-        } else {
-            left = center;
-            break;
+                ALOGV("seeking past entry %zu to offset %lld",
+                     mTableOfContents.size(), (long long)pos);
+            }
         }
     }
 
-    if (left == mTableOfContents.size()) {
-        --left;
-    }
+    if (pos < 0) {
+        // Perform approximate seeking based on avg. bitrate.
+        uint64_t bps = approxBitrate();
+        if (bps <= 0) {
+            return INVALID_OPERATION;
+        }
 
-    const TOCEntry &entry = mTableOfContents.itemAt(left);
+        pos = timeUs * bps / 8000000ll;
 
-    ALOGV("seeking to entry %zu / %zu at offset %lld",
-         left, mTableOfContents.size(), (long long)entry.mPageOffset);
+        ALOGV("seeking to offset %lld", (long long)pos);
+    }
 
-    return seekToOffset(entry.mPageOffset);
+    return seekToOffset(pos);
 }
 
 status_t MyOggExtractor::seekToOffset(off64_t offset) {
@@ -789,6 +842,11 @@ status_t MyOggExtractor::_readNextPacket(MediaBuffer **out, bool calcVorbisTimes
             return n < 0 ? n : (status_t)ERROR_END_OF_STREAM;
         }
 
+        {
+            Mutex::Autolock autoLock(mTOCLock);
+            addTOCEntry_l(mOffset, n, mCurrentPage);
+        }
+
         // Prevent a harmless unsigned integer overflow by clamping to 0
         if (mCurrentPage.mGranulePosition >= mPrevGranulePosition) {
             mCurrentPageSamples =
@@ -846,6 +904,11 @@ status_t MyOggExtractor::init() {
 
     mFirstDataOffset = mOffset + mCurrentPageSize;
 
+    {
+        Mutex::Autolock autoLock(mTOCLock);
+        mTOCEndOffset = mFirstDataOffset;
+    }
+
     off64_t size;
     uint64_t lastGranulePosition;
     if (!(mSource->flags() & DataSource::kIsCachingDataSource)
@@ -861,49 +924,78 @@ status_t MyOggExtractor::init() {
 
         mMeta->setInt64(kKeyDuration, durationUs);
 
-        buildTableOfContents();
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+        mTOCThreadStarted =
+            pthread_create(&mTOCThread, &attr, TOCThreadWrapper, this) == 0;
+        pthread_attr_destroy(&attr);
     }
 
     return OK;
 }
 
-void MyOggExtractor::buildTableOfContents() {
-    off64_t offset = mFirstDataOffset;
-    Page page;
-    ssize_t pageSize;
-    while ((pageSize = readPage(offset, &page)) > 0) {
-        mTableOfContents.push();
+// Limit the maximum amount of RAM we spend on the table of contents,
+// if necessary thin out the table evenly to trim it down to maximum
+// size.
+static const size_t kMaxTOCSize = 8192;
 
-        TOCEntry &entry =
-            mTableOfContents.editItemAt(mTableOfContents.size() - 1);
+void MyOggExtractor::addTOCEntry_l(
+        off64_t offset, size_t pageSize, const Page &page) {
+    if (mTOCComplete || offset != mTOCEndOffset) {
+        // not contiguous with the pages already listed
+        return;
+    }
+    mTOCEndOffset = offset + pageSize;
 
-        entry.mPageOffset = offset;
-        entry.mTimeUs = getTimeUsOfGranule(page.mGranulePosition);
+    // a page on which no packet ends has no granule position
+    if (page.mGranulePosition == (uint64_t)-1) {
+        return;
+    }
+    if (!mTableOfContents.isEmpty() && ++mTOCSkipped < mTOCStride) {
+        return;
+    }
+    mTOCSkipped = 0;
 
-        offset += (size_t)pageSize;
+    static const size_t kMaxNumTOCEntries = kMaxTOCSize / sizeof(TOCEntry);
+    if (mTableOfContents.size() >= kMaxNumTOCEntries) {
+        // keep every other entry, and from now on every other page
+        for (size_t i = 1; i < mTableOfContents.size(); ++i) {
+            mTableOfContents.removeAt(i);
+        }
+        mTOCStride *= 2;
     }
 
-    // Limit the maximum amount of RAM we spend on the table of contents,
-    // if necessary thin out the table evenly to trim it down to maximum
-    // size.
+    TOCEntry entry;
+    entry.mPageOffset = offset;
+    entry.mGranulePosition = page.mGranulePosition;
+    mTableOfContents.push(entry);
+}
 
-    static const size_t kMaxTOCSize = 8192;
-    static const size_t kMaxNumTOCEntries = kMaxTOCSize / sizeof(TOCEntry);
+// static
+void *MyOggExtractor::TOCThreadWrapper(void *me) {
+    static_cast<MyOggExtractor *>(me)->scanTableOfContents();
+    return NULL;
+}
 
-    size_t numerator = mTableOfContents.size();
+void MyOggExtractor::scanTableOfContents() {
+    mTOCLock.lock();
+    while (!mTOCComplete && !mTOCThreadStop) {
+        off64_t offset = mTOCEndOffset;
+        mTOCLock.unlock();
 
-    if (numerator > kMaxNumTOCEntries) {
-        size_t denom = numerator - kMaxNumTOCEntries;
+        Page page;
+        ssize_t pageSize = readPage(offset, &page);
 
-        size_t accum = 0;
-        for (ssize_t i = mTableOfContents.size() - 1; i >= 0; --i) {
-            accum += denom;
-            if (accum >= numerator) {
-                mTableOfContents.removeAt(i);
-                accum -= numerator;
-            }
+        mTOCLock.lock();
+        if (pageSize > 0) {
+            addTOCEntry_l(offset, pageSize, page);
+        } else if (offset == mTOCEndOffset) {
+            mTOCComplete = true;
         }
     }
+    ALOGV("table of contents has %zu entries", mTableOfContents.size());
+    mTOCLock.unlock();
 }
 
 int32_t MyOggExtractor::getPacketBlockSize(MediaBuffer *buffer) {
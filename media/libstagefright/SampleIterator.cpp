@@ -155,6 +155,22 @@ status_t SampleIterator::seekTo(uint32_t sampleIndex) {
 status_t SampleIterator::findChunkRange(uint32_t sampleIndex) {
     CHECK(sampleIndex >= mFirstChunkSampleIndex);
 
+    // skip to the last entry starting at or before the sample
+    uint32_t left = 0;
+    uint32_t right_plus_one = mTable->mNumSampleToChunkFirstSamples;
+    while (left < right_plus_one) {
+        uint32_t center = left + (right_plus_one - left) / 2;
+        if (mTable->mSampleToChunkFirstSamples[center] <= sampleIndex) {
+            left = center + 1;
+        } else {
+            right_plus_one = center;
+        }
+    }
+    if (left > 0 && left - 1 > mSampleToChunkIndex) {
+        mSampleToChunkIndex = left - 1;
+        mStopChunkSampleIndex = mTable->mSampleToChunkFirstSamples[mSampleToChunkIndex];
+    }
+
     while (sampleIndex >= mStopChunkSampleIndex) {
         if (mSampleToChunkIndex == mTable->mNumSampleToChunkOffsets) {
             return ERROR_OUT_OF_RANGE;
@@ -305,6 +321,28 @@ status_t SampleIterator::findSampleTimeAndDuration(
         return ERROR_OUT_OF_RANGE;
     }
 
+    if (sampleIndex >= mTTSSampleIndex + mTTSCount && mTable->buildTimeIndex_l()) {
+        // skip to the last block of time-to-sample entries starting at or before the sample
+        uint32_t left = 0;
+        uint32_t right_plus_one = mTable->mNumTimeIndexEntries;
+        while (left < right_plus_one) {
+            uint32_t center = left + (right_plus_one - left) / 2;
+            if (mTable->mTimeIndex[center].mSampleIndex <= sampleIndex) {
+                left = center + 1;
+            } else {
+                right_plus_one = center;
+            }
+        }
+        if (left > 0 && (left - 1) * SampleTable::kTimeIndexBlockSize > mTimeToSampleIndex) {
+            const SampleTable::TimeIndexEntry &entry = mTable->mTimeIndex[left - 1];
+            mTimeToSampleIndex = (left - 1) * SampleTable::kTimeIndexBlockSize;
+            mTTSSampleIndex = entry.mSampleIndex;
+            mTTSSampleTime = entry.mSampleTime;
+            mTTSCount = 0;
+            mTTSDuration = 0;
+        }
+    }
+
     while (sampleIndex >= mTTSSampleIndex + mTTSCount) {
         if (mTimeToSampleIndex == mTable->mTimeToSampleCount) {
             return ERROR_OUT_OF_RANGE;
@@ -28,6 +28,7 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/Utils.h>
+#include <utils/Vector.h>
 
 /* TODO: remove after being merged into other branches */
 #ifndef UINT32_MAX
@@ -66,6 +67,11 @@ private:
     size_t mCurrentDeltaEntry;
     size_t mCurrentEntrySampleIndex;
 
+    // index of the first sample of every kBlockSize entries, so that seeks do not have to
+    // go through the entries from the start
+    enum { kBlockSize = 64 };
+    Vector<size_t> mBlockSampleIndex;
+
     DISALLOW_EVIL_CONSTRUCTORS(CompositionDeltaLookup);
 };
 
@@ -84,6 +90,16 @@ void SampleTable::CompositionDeltaLookup::setEntries(
     mNumDeltaEntries = numDeltaEntries;
     mCurrentDeltaEntry = 0;
     mCurrentEntrySampleIndex = 0;
+
+    mBlockSampleIndex.clear();
+    mBlockSampleIndex.setCapacity((numDeltaEntries + kBlockSize - 1) / kBlockSize);
+    size_t sampleIndex = 0;
+    for (size_t i = 0; i < numDeltaEntries; ++i) {
+        if (i % kBlockSize == 0) {
+            mBlockSampleIndex.push(sampleIndex);
+        }
+        sampleIndex += (uint32_t)deltaEntries[2 * i];
+    }
 }
 
 int32_t SampleTable::CompositionDeltaLookup::getCompositionTimeOffset(
@@ -94,9 +110,24 @@ int32_t SampleTable::CompositionDeltaLookup::getCompositionTimeOffset(
         return 0;
     }
 
-    if (sampleIndex < mCurrentEntrySampleIndex) {
-        mCurrentDeltaEntry = 0;
-        mCurrentEntrySampleIndex = 0;
+    size_t nextBlock = mCurrentDeltaEntry / kBlockSize + 1;
+    if (sampleIndex < mCurrentEntrySampleIndex
+            || (nextBlock < mBlockSampleIndex.size()
+                    && sampleIndex >= mBlockSampleIndex[nextBlock])) {
+        // the last block starting at or before the sample
+        size_t left = 0;
+        size_t right_plus_one = mBlockSampleIndex.size();
+        while (left < right_plus_one) {
+            size_t center = left + (right_plus_one - left) / 2;
+            if (mBlockSampleIndex[center] <= sampleIndex) {
+                left = center + 1;
+            } else {
+                right_plus_one = center;
+            }
+        }
+        size_t block = left > 0 ? left - 1 : 0;
+        mCurrentDeltaEntry = block * kBlockSize;
+        mCurrentEntrySampleIndex = block < mBlockSampleIndex.size() ? mBlockSampleIndex[block] : 0;
     }
 
     while (mCurrentDeltaEntry < mNumDeltaEntries) {
@@ -125,10 +156,17 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mSampleSizeFieldSize(0),
       mDefaultSampleSize(0),
       mNumSampleSizes(0),
+      mTablesLoaded(false),
+      mTablesStatus(OK),
       mHasTimeToSample(false),
+      mTimeToSampleOffset(-1),
       mTimeToSampleCount(0),
       mTimeToSample(NULL),
       mSampleTimeEntries(NULL),
+      mTimeIndex(NULL),
+      mNumTimeIndexEntries(0),
+      mTimeIndexFailed(false),
+      mCompositionTimeToSampleOffset(-1),
       mCompositionTimeDeltaEntries(NULL),
       mNumCompositionTimeDeltaEntries(0),
       mCompositionDeltaLookup(new CompositionDeltaLookup),
@@ -137,6 +175,8 @@ SampleTable::SampleTable(const sp<DataSource> &source)
       mSyncSamples(NULL),
       mLastSyncSampleIndex(0),
       mSampleToChunkEntries(NULL),
+      mSampleToChunkFirstSamples(NULL),
+      mNumSampleToChunkFirstSamples(0),
       mTotalSize(0) {
     mSampleIterator = new SampleIterator(this);
 }
@@ -145,6 +185,9 @@ SampleTable::~SampleTable() {
     delete[] mSampleToChunkEntries;
     mSampleToChunkEntries = NULL;
 
+    delete[] mSampleToChunkFirstSamples;
+    mSampleToChunkFirstSamples = NULL;
+
     delete[] mSyncSamples;
     mSyncSamples = NULL;
 
@@ -160,6 +203,9 @@ SampleTable::~SampleTable() {
     delete[] mSampleTimeEntries;
     mSampleTimeEntries = NULL;
 
+    delete[] mTimeIndex;
+    mTimeIndex = NULL;
+
     delete mSampleIterator;
     mSampleIterator = NULL;
 }
@@ -261,6 +307,20 @@ status_t SampleTable::setSampleToChunkParams(
         return ERROR_OUT_OF_RANGE;
     }
 
+    if (mNumSampleToChunkOffsets > 0 && (off64_t)(kMaxOffset - 8 -
+            ((mNumSampleToChunkOffsets - 1) * sizeof(SampleToChunkEntry)))
+            < mSampleToChunkOffset) {
+        return ERROR_MALFORMED;
+    }
+
+    return OK;
+}
+
+status_t SampleTable::loadSampleToChunkTable_l() {
+    if (mSampleToChunkOffset < 0) {
+        return OK;
+    }
+
     mSampleToChunkEntries =
         new (std::nothrow) SampleToChunkEntry[mNumSampleToChunkOffsets];
     if (!mSampleToChunkEntries) {
@@ -269,16 +329,6 @@ status_t SampleTable::setSampleToChunkParams(
         return ERROR_OUT_OF_RANGE;
     }
 
-    if (mNumSampleToChunkOffsets == 0) {
-        return OK;
-    }
-
-    if ((off64_t)(kMaxOffset - 8 -
-            ((mNumSampleToChunkOffsets - 1) * sizeof(SampleToChunkEntry)))
-            < mSampleToChunkOffset) {
-        return ERROR_MALFORMED;
-    }
-
     for (uint32_t i = 0; i < mNumSampleToChunkOffsets; ++i) {
         uint8_t buffer[sizeof(SampleToChunkEntry)];
 
@@ -301,9 +351,43 @@ status_t SampleTable::setSampleToChunkParams(
         mSampleToChunkEntries[i].chunkDesc = U32_AT(&buffer[8]);
     }
 
+    buildSampleToChunkIndex();
+
     return OK;
 }
 
+// Lets SampleIterator find the sample-to-chunk entry of a sample with a binary search, rather
+// than going through the entries from the start. The checks match SampleIterator's.
+void SampleTable::buildSampleToChunkIndex() {
+    mSampleToChunkFirstSamples =
+        new (std::nothrow) uint32_t[mNumSampleToChunkOffsets];
+    if (!mSampleToChunkFirstSamples) {
+        return;
+    }
+    mTotalSize += (uint64_t)mNumSampleToChunkOffsets * sizeof(uint32_t);
+
+    uint32_t firstSample = 0;
+    uint32_t i = 0;
+    while (i < mNumSampleToChunkOffsets) {
+        mSampleToChunkFirstSamples[i++] = firstSample;
+        if (i == mNumSampleToChunkOffsets) {
+            break;
+        }
+
+        const SampleToChunkEntry &entry = mSampleToChunkEntries[i - 1];
+        uint32_t stopChunk = mSampleToChunkEntries[i].startChunk;
+        if (entry.samplesPerChunk == 0
+                || stopChunk < entry.startChunk
+                || (stopChunk - entry.startChunk) > UINT32_MAX / entry.samplesPerChunk
+                || (stopChunk - entry.startChunk) * entry.samplesPerChunk
+                        > UINT32_MAX - firstSample) {
+            break;
+        }
+        firstSample += (stopChunk - entry.startChunk) * entry.samplesPerChunk;
+    }
+    mNumSampleToChunkFirstSamples = i;
+}
+
 status_t SampleTable::setSampleSizeParams(
         uint32_t type, off64_t data_offset, size_t data_size) {
     if (mSampleSizeOffset >= 0) {
@@ -413,6 +497,17 @@ status_t SampleTable::setTimeToSampleParams(
         return ERROR_OUT_OF_RANGE;
     }
 
+    mTimeToSampleOffset = data_offset;
+    mHasTimeToSample = true;
+    return OK;
+}
+
+status_t SampleTable::loadTimeToSampleTable_l() {
+    if (mTimeToSampleOffset < 0) {
+        return OK;
+    }
+
+    uint64_t allocSize = (uint64_t)mTimeToSampleCount * 2 * sizeof(uint32_t);
     mTimeToSample = new (std::nothrow) uint32_t[mTimeToSampleCount * 2];
     if (!mTimeToSample) {
         ALOGE("Cannot allocate time-to-sample table with %llu entries.",
@@ -420,7 +515,7 @@ status_t SampleTable::setTimeToSampleParams(
         return ERROR_OUT_OF_RANGE;
     }
 
-    if (mDataSource->readAt(data_offset + 8, mTimeToSample,
+    if (mDataSource->readAt(mTimeToSampleOffset + 8, mTimeToSample,
             (size_t)allocSize) < (ssize_t)allocSize) {
         ALOGE("Incomplete data read for time-to-sample table.");
         return ERROR_IO;
@@ -430,7 +525,6 @@ status_t SampleTable::setTimeToSampleParams(
         mTimeToSample[i] = ntohl(mTimeToSample[i]);
     }
 
-    mHasTimeToSample = true;
     return OK;
 }
 
@@ -442,7 +536,7 @@ status_t SampleTable::setCompositionTimeToSampleParams(
         off64_t data_offset, size_t data_size) {
     ALOGI("There are reordered frames present.");
 
-    if (mCompositionTimeDeltaEntries != NULL || data_size < 8) {
+    if (mCompositionTimeToSampleOffset >= 0 || data_size < 8) {
         return ERROR_MALFORMED;
     }
 
@@ -487,6 +581,17 @@ status_t SampleTable::setCompositionTimeToSampleParams(
         return ERROR_OUT_OF_RANGE;
     }
 
+    mCompositionTimeToSampleOffset = data_offset;
+    return OK;
+}
+
+status_t SampleTable::loadCompositionTimeToSampleTable_l() {
+    if (mCompositionTimeToSampleOffset < 0) {
+        return OK;
+    }
+
+    size_t numEntries = mNumCompositionTimeDeltaEntries;
+    uint64_t allocSize = (uint64_t)numEntries * 2 * sizeof(int32_t);
     mCompositionTimeDeltaEntries = new (std::nothrow) int32_t[2 * numEntries];
     if (!mCompositionTimeDeltaEntries) {
         ALOGE("Cannot allocate composition-time-to-sample table with %llu "
@@ -494,7 +599,7 @@ status_t SampleTable::setCompositionTimeToSampleParams(
         return ERROR_OUT_OF_RANGE;
     }
 
-    if (mDataSource->readAt(data_offset + 8, mCompositionTimeDeltaEntries,
+    if (mDataSource->readAt(mCompositionTimeToSampleOffset + 8, mCompositionTimeDeltaEntries,
             (size_t)allocSize) < (ssize_t)allocSize) {
         delete[] mCompositionTimeDeltaEntries;
         mCompositionTimeDeltaEntries = NULL;
@@ -552,6 +657,19 @@ status_t SampleTable::setSyncSampleParams(off64_t data_offset, size_t data_size)
         return ERROR_OUT_OF_RANGE;
     }
 
+    mSyncSampleOffset = data_offset;
+    mNumSyncSamples = numSyncSamples;
+
+    return OK;
+}
+
+status_t SampleTable::loadSyncSampleTable_l() {
+    if (mSyncSampleOffset < 0) {
+        return OK;
+    }
+
+    uint32_t numSyncSamples = mNumSyncSamples;
+    uint64_t allocSize = (uint64_t)numSyncSamples * sizeof(uint32_t);
     mSyncSamples = new (std::nothrow) uint32_t[numSyncSamples];
     if (!mSyncSamples) {
         ALOGE("Cannot allocate sync sample table with %llu entries.",
@@ -559,9 +677,9 @@ status_t SampleTable::setSyncSampleParams(off64_t data_offset, size_t data_size)
         return ERROR_OUT_OF_RANGE;
     }
 
-    if (mDataSource->readAt(data_offset + 8, mSyncSamples,
+    if (mDataSource->readAt(mSyncSampleOffset + 8, mSyncSamples,
             (size_t)allocSize) != (ssize_t)allocSize) {
-        delete mSyncSamples;
+        delete[] mSyncSamples;
         mSyncSamples = NULL;
         return ERROR_IO;
     }
@@ -574,12 +692,28 @@ status_t SampleTable::setSyncSampleParams(off64_t data_offset, size_t data_size)
         mSyncSamples[i] = ntohl(mSyncSamples[i]) - 1;
     }
 
-    mSyncSampleOffset = data_offset;
-    mNumSyncSamples = numSyncSamples;
-
     return OK;
 }
 
+status_t SampleTable::loadTables() {
+    Mutex::Autolock autoLock(mLock);
+
+    return loadTables_l();
+}
+
+status_t SampleTable::loadTables_l() {
+    if (!mTablesLoaded) {
+        mTablesLoaded = true;
+        if ((mTablesStatus = loadSampleToChunkTable_l()) != OK
+                || (mTablesStatus = loadTimeToSampleTable_l()) != OK
+                || (mTablesStatus = loadCompositionTimeToSampleTable_l()) != OK
+                || (mTablesStatus = loadSyncSampleTable_l()) != OK) {
+            ALOGE("Cannot load the sample tables (%d).", mTablesStatus);
+        }
+    }
+    return mTablesStatus;
+}
+
 uint32_t SampleTable::countChunkOffsets() const {
     return mNumChunkOffsets;
 }
@@ -630,13 +764,21 @@ int SampleTable::CompareIncreasingTime(const void *_a, const void *_b) {
 void SampleTable::buildSampleEntriesTable() {
     Mutex::Autolock autoLock(mLock);
 
-    if (mSampleTimeEntries != NULL || mNumSampleSizes == 0) {
+    if (loadTables_l() != OK) {
+        return;
+    }
+
+    if (hasSortedSampleTimes() || mNumSampleSizes == 0) {
         if (mNumSampleSizes == 0) {
             ALOGE("b/23247055, mNumSampleSizes(%u)", mNumSampleSizes);
         }
         return;
     }
 
+    if (mCompositionTimeDeltaEntries == NULL && buildTimeIndex_l()) {
+        return;
+    }
+
     mTotalSize += (uint64_t)mNumSampleSizes * sizeof(SampleTimeEntry);
     if (mTotalSize > kMaxTotalSize) {
         ALOGE("Sample entry table size would make sample table too large.\n"
@@ -704,12 +846,88 @@ void SampleTable::buildSampleEntriesTable() {
           CompareIncreasingTime);
 }
 
+// Returns false if the times do not fit the 32 bits of the sample entries, the sample entry
+// table then wraps them around as before.
+bool SampleTable::buildTimeIndex_l() {
+    if (mTimeIndex != NULL || mTimeIndexFailed) {
+        return mTimeIndex != NULL;
+    }
+
+    uint32_t numEntries = mTimeToSampleCount / kTimeIndexBlockSize + 1;
+    mTimeIndex = new (std::nothrow) TimeIndexEntry[numEntries];
+    if (!mTimeIndex) {
+        ALOGE("Cannot allocate time index with %u entries.", numEntries);
+        mTimeIndexFailed = true;
+        return false;
+    }
+
+    uint64_t sampleIndex = 0;
+    uint64_t sampleTime = 0;
+    for (uint32_t i = 0; i <= mTimeToSampleCount; ++i) {
+        if (sampleIndex > UINT32_MAX || sampleTime > UINT32_MAX) {
+            delete[] mTimeIndex;
+            mTimeIndex = NULL;
+            mTimeIndexFailed = true;
+            return false;
+        }
+        if (i % kTimeIndexBlockSize == 0 && i < mTimeToSampleCount) {
+            mTimeIndex[i / kTimeIndexBlockSize].mSampleIndex = sampleIndex;
+            mTimeIndex[i / kTimeIndexBlockSize].mSampleTime = sampleTime;
+        }
+        if (i < mTimeToSampleCount) {
+            sampleIndex += mTimeToSample[2 * i];
+            sampleTime += (uint64_t)mTimeToSample[2 * i] * mTimeToSample[2 * i + 1];
+        }
+    }
+
+    mNumTimeIndexEntries = (mTimeToSampleCount + kTimeIndexBlockSize - 1) / kTimeIndexBlockSize;
+    mTotalSize += (uint64_t)numEntries * sizeof(TimeIndexEntry);
+    return true;
+}
+
+uint32_t SampleTable::getSortedSampleTime(uint32_t index) const {
+    if (mSampleTimeEntries != NULL) {
+        return mSampleTimeEntries[index].mCompositionTime;
+    }
+
+    // the last block starting at or before the sample
+    uint32_t left = 0;
+    uint32_t right_plus_one = mNumTimeIndexEntries;
+    while (left < right_plus_one) {
+        uint32_t center = left + (right_plus_one - left) / 2;
+        if (mTimeIndex[center].mSampleIndex <= index) {
+            left = center + 1;
+        } else {
+            right_plus_one = center;
+        }
+    }
+    if (left == 0) {
+        // no time-to-sample entries
+        return 0;
+    }
+
+    uint32_t i = (left - 1) * kTimeIndexBlockSize;
+    uint64_t sampleIndex = mTimeIndex[left - 1].mSampleIndex;
+    uint64_t sampleTime = mTimeIndex[left - 1].mSampleTime;
+    for (; i < mTimeToSampleCount; ++i) {
+        uint32_t n = mTimeToSample[2 * i];
+        uint32_t delta = mTimeToSample[2 * i + 1];
+        if (index < sampleIndex + n) {
+            return sampleTime + (index - sampleIndex) * (uint64_t)delta;
+        }
+        sampleIndex += n;
+        sampleTime += (uint64_t)n * delta;
+    }
+    // past the samples the time-to-sample table describes
+    return sampleTime;
+}
+
 status_t SampleTable::findSampleAtTime(
         uint64_t req_time, uint64_t scale_num, uint64_t scale_den,
         uint32_t *sample_index, uint32_t flags) {
     buildSampleEntriesTable();
 
-    if (mSampleTimeEntries == NULL) {
+    if (!hasSortedSampleTimes()) {
         return ERROR_OUT_OF_RANGE;
     }
 
@@ -725,7 +943,7 @@ status_t SampleTable::findSampleAtTime(
         } else if (req_time > centerTime) {
             left = center + 1;
         } else {
-            *sample_index = mSampleTimeEntries[center].mSampleIndex;
+            *sample_index = getSortedSampleIndex(center);
             return OK;
         }
     }
@@ -774,7 +992,7 @@ status_t SampleTable::findSampleAtTime(
         }
     }
 
-    *sample_index = mSampleTimeEntries[closestIndex].mSampleIndex;
+    *sample_index = getSortedSampleIndex(closestIndex);
     return OK;
 }
 
@@ -784,6 +1002,11 @@ status_t SampleTable::findSyncSampleNear(
 
     *sample_index = 0;
 
+    status_t err = loadTables_l();
+    if (err != OK) {
+        return err;
+    }
+
     if (mSyncSampleOffset < 0) {
         // All samples are sync-samples.
         *sample_index = start_sample_index;
@@ -847,7 +1070,7 @@ status_t SampleTable::findSyncSampleNear(
             // this route is not used, but implement it nonetheless
             CHECK(flags == kFlagClosest);
 
-            status_t err = mSampleIterator->seekTo(start_sample_index);
+            err = mSampleIterator->seekTo(start_sample_index);
             if (err != OK) {
                 return err;
             }
@@ -881,6 +1104,11 @@ status_t SampleTable::findSyncSampleNear(
 status_t SampleTable::findThumbnailSample(uint32_t *sample_index) {
     Mutex::Autolock autoLock(mLock);
 
+    status_t err = loadTables_l();
+    if (err != OK) {
+        return err;
+    }
+
     if (mSyncSampleOffset < 0) {
         // All samples are sync-samples.
         *sample_index = 0;
@@ -905,7 +1133,7 @@ status_t SampleTable::findThumbnailSample(uint32_t *sample_index) {
 
         // Now x is a sample index.
         size_t sampleSize;
-        status_t err = getSampleSize_l(x, &sampleSize);
+        err = getSampleSize_l(x, &sampleSize);
         if (err != OK) {
             return err;
         }
@@ -937,7 +1165,8 @@ status_t SampleTable::getMetaDataForSample(
     Mutex::Autolock autoLock(mLock);
 
     status_t err;
-    if ((err = mSampleIterator->seekTo(sampleIndex)) != OK) {
+    if ((err = loadTables_l()) != OK
+            || (err = mSampleIterator->seekTo(sampleIndex)) != OK) {
         return err;
     }
 
@@ -963,8 +1192,17 @@ status_t SampleTable::getMetaDataForSample(
                     && (mSyncSamples[mLastSyncSampleIndex] <= sampleIndex)
                 ? mLastSyncSampleIndex : 0;
 
-            while (i < mNumSyncSamples && mSyncSamples[i] < sampleIndex) {
-                ++i;
+            // the first sync sample at or after sampleIndex
+            if (i < mNumSyncSamples && mSyncSamples[i] < sampleIndex) {
+                size_t right_plus_one = mNumSyncSamples;
+                while (i < right_plus_one) {
+                    size_t center = i + (right_plus_one - i) / 2;
+                    if (mSyncSamples[center] < sampleIndex) {
+                        i = center + 1;
+                    } else {
+                        right_plus_one = center;
+                    }
+                }
             }
 
             if (i < mNumSyncSamples && mSyncSamples[i] == sampleIndex) {
@@ -18,6 +18,8 @@
 #define LOG_TAG "SkipCutBuffer"
 #include <utils/Log.h>
 
+#include <string.h>
+
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/SkipCutBuffer.h>
@@ -26,10 +28,13 @@ namespace android {
 
 SkipCutBuffer::SkipCutBuffer(size_t skip, size_t cut, size_t num16BitChannels) {
 
-    mWriteHead = 0;
-    mReadHead = 0;
-    mCapacity = 0;
-    mCutBuffer = NULL;
+    mSkip = 0;
+    mFrontPadding = 0;
+    mBackPadding = 0;
+    mHeldSize = 0;
+    mHeld = NULL;
+    mSpare = NULL;
+    mPassthrough = true;
 
     if (num16BitChannels == 0 || num16BitChannels > INT32_MAX / 2) {
         ALOGW("# channels out of range: %zu, using passthrough instead", num16BitChannels);
@@ -45,153 +50,111 @@ SkipCutBuffer::SkipCutBuffer(size_t skip, size_t cut, size_t num16BitChannels) {
     skip *= frameSize;
     cut *= frameSize;
 
+    if (cut > 0) {
+        mHeld = new (std::nothrow) char[cut];
+        mSpare = new (std::nothrow) char[cut];
+        if (mHeld == NULL || mSpare == NULL) {
+            ALOGW("cannot allocate %zu bytes, using passthrough instead", cut);
+            return;
+        }
+    }
+
     mFrontPadding = mSkip = skip;
     mBackPadding = cut;
-    mCapacity = cut + 4096;
-    mCutBuffer = new (std::nothrow) char[mCapacity];
-    ALOGV("skipcutbuffer %zu %zu %d", skip, cut, mCapacity);
+    mPassthrough = false;
+    ALOGV("skipcutbuffer %zu %zu", skip, cut);
 }
 
 SkipCutBuffer::~SkipCutBuffer() {
-    delete[] mCutBuffer;
+    delete[] mHeld;
+    delete[] mSpare;
 }
 
 void SkipCutBuffer::submit(MediaBuffer *buffer) {
-    if (mCutBuffer == NULL) {
-        // passthrough mode
+    if (mPassthrough) {
         return;
     }
 
-    int32_t offset = buffer->range_offset();
-    int32_t buflen = buffer->range_length();
-
-    // drop the initial data from the buffer if needed
-    if (mFrontPadding > 0) {
-        // still data left to drop
-        int32_t to_drop = (buflen < mFrontPadding) ? buflen : mFrontPadding;
-        offset += to_drop;
-        buflen -= to_drop;
-        buffer->set_range(offset, buflen);
-        mFrontPadding -= to_drop;
-    }
-
-
-    // append data to cutbuffer
-    char *src = ((char*) buffer->data()) + offset;
-    write(src, buflen);
-
-
-    // the mediabuffer is now empty. Fill it from cutbuffer, always leaving
-    // at least mBackPadding bytes in the cutbuffer
-    char *dst = (char*) buffer->data();
-    size_t copied = read(dst, buffer->size());
-    buffer->set_range(0, copied);
+    size_t offset = buffer->range_offset();
+    size_t length = buffer->range_length();
+    submit((char *)buffer->data(), &offset, &length);
+    buffer->set_range(offset, length);
 }
 
 void SkipCutBuffer::submit(const sp<ABuffer>& buffer) {
-    if (mCutBuffer == NULL) {
-        // passthrough mode
+    if (mPassthrough) {
         return;
     }
 
-    int32_t offset = buffer->offset();
-    int32_t buflen = buffer->size();
+    size_t offset = buffer->offset();
+    size_t length = buffer->size();
+    submit((char *)buffer->base(), &offset, &length);
+    buffer->setRange(offset, length);
+}
 
+void SkipCutBuffer::submit(char *base, size_t *offset, size_t *length) {
     // drop the initial data from the buffer if needed
     if (mFrontPadding > 0) {
         // still data left to drop
-        int32_t to_drop = (buflen < mFrontPadding) ? buflen : mFrontPadding;
-        offset += to_drop;
-        buflen -= to_drop;
-        buffer->setRange(offset, buflen);
-        mFrontPadding -= to_drop;
+        size_t toDrop = *length < (size_t)mFrontPadding ? *length : (size_t)mFrontPadding;
+        *offset += toDrop;
+        *length -= toDrop;
+        mFrontPadding -= toDrop;
     }
 
+    if (mBackPadding == 0) {
+        return;
+    }
 
-    // append data to cutbuffer
-    char *src = (char*) buffer->data();
-    write(src, buflen);
-
-
-    // the mediabuffer is now empty. Fill it from cutbuffer, always leaving
-    // at least mBackPadding bytes in the cutbuffer
-    char *dst = (char*) buffer->base();
-    size_t copied = read(dst, buffer->capacity());
-    buffer->setRange(0, copied);
-}
-
-void SkipCutBuffer::clear() {
-    mWriteHead = mReadHead = 0;
-    mFrontPadding = mSkip;
-}
-
-void SkipCutBuffer::write(const char *src, size_t num) {
-    int32_t sizeused = (mWriteHead - mReadHead);
-    if (sizeused < 0) sizeused += mCapacity;
-
-    // Everything must fit. Make sure the buffer is a little larger than needed,
-    // so there is no ambiguity as to whether mWriteHead == mReadHead means buffer
-    // full or empty
-    size_t available = mCapacity - sizeused - 32;
-    if (available < num) {
-        int32_t newcapacity = mCapacity + (num - available);
-        char * newbuffer = new char[newcapacity];
-        memcpy(newbuffer, mCutBuffer, mCapacity);
-        delete [] mCutBuffer;
-        mCapacity = newcapacity;
-        mCutBuffer = newbuffer;
-        ALOGV("reallocated buffer at size %d", newcapacity);
+    // The last mBackPadding bytes seen so far are held back, since they are
+    // dropped if the stream ends here.  The output is what was held back,
+    // followed by the buffer without its own last mBackPadding bytes, which
+    // are held back instead.  It is never longer than the input.
+    char *data = base + *offset;
+    size_t held = mHeldSize;
+    size_t cut = mBackPadding;
+    if (held + *length <= cut) {
+        memcpy(mHeld + held, data, *length);
+        mHeldSize += *length;
+        *length = 0;
+        return;
     }
 
-    size_t copyfirst = (mCapacity - mWriteHead);
-    if (copyfirst > num) copyfirst = num;
-    if (copyfirst) {
-        memcpy(mCutBuffer + mWriteHead, src, copyfirst);
-        num -= copyfirst;
-        src += copyfirst;
-        mWriteHead += copyfirst;
-        CHECK_LE(mWriteHead, mCapacity);
-        if (mWriteHead == mCapacity) mWriteHead = 0;
-        if (num) {
-            memcpy(mCutBuffer, src, num);
-            mWriteHead += num;
+    size_t outLength = held + *length - cut;
+    if (*length < cut) {
+        // everything output comes from the held back data
+        size_t keep = held - outLength;
+        memcpy(mSpare, mHeld + outLength, keep);
+        memcpy(mSpare + keep, data, *length);
+        memcpy(base, mHeld, outLength);
+        *offset = 0;
+        *length = outLength;
+    } else {
+        memcpy(mSpare, data + *length - cut, cut);
+        if (*offset >= held) {
+            // room in front of the data, no need to move it
+            *offset -= held;
+        } else {
+            memmove(base + held, data, *length - cut);
+            *offset = 0;
         }
+        memcpy(base + *offset, mHeld, held);
+        *length = outLength;
     }
-}
 
-size_t SkipCutBuffer::read(char *dst, size_t num) {
-    int32_t available = (mWriteHead - mReadHead);
-    if (available < 0) available += mCapacity;
-
-    available -= mBackPadding;
-    if (available <=0) {
-        return 0;
-    }
-    if (available < int32_t(num)) {
-        num = available;
-    }
+    char *tmp = mHeld;
+    mHeld = mSpare;
+    mSpare = tmp;
+    mHeldSize = cut;
+}
 
-    size_t copyfirst = (mCapacity - mReadHead);
-    if (copyfirst > num) copyfirst = num;
-    if (copyfirst) {
-        memcpy(dst, mCutBuffer + mReadHead, copyfirst);
-        num -= copyfirst;
-        dst += copyfirst;
-        mReadHead += copyfirst;
-        CHECK_LE(mReadHead, mCapacity);
-        if (mReadHead == mCapacity) mReadHead = 0;
-        if (num) {
-            memcpy(dst, mCutBuffer, num);
-            mReadHead += num;
-        }
-    }
-    return available;
+void SkipCutBuffer::clear() {
+    mHeldSize = 0;
+    mFrontPadding = mSkip;
 }
 
 size_t SkipCutBuffer::size() {
-    int32_t available = (mWriteHead - mReadHead);
-    if (available < 0) available += mCapacity;
-    return available;
+    return mHeldSize;
 }
 
 }  // namespace android
@@ -27,6 +27,7 @@
 #include <media/IMediaHTTPService.h>
 #include <media/mediametadataretriever.h>
 #include <private/media/VideoFrame.h>
+#include <utils/threads.h>
 
 namespace android {
 
@@ -54,29 +55,31 @@ static bool FileHasAcceptableExtension(const char *extension) {
     return false;
 }
 
-MediaScanResult StagefrightMediaScanner::processFile(
-        const char *path, const char *mimeType,
-        MediaScannerClient &client) {
-    ALOGV("processFile '%s'.", path);
+// The metadata of a file, extracted before it is reported to the client.
+struct ScannedFile {
+    ScannedFile()
+        : mResult(MEDIA_SCAN_RESULT_SKIPPED),
+          mHasMimeType(false) {
+    }
 
-    client.setLocale(locale());
-    client.beginFile();
-    MediaScanResult result = processFileInternal(path, mimeType, client);
-    client.endFile();
-    return result;
-}
+    MediaScanResult mResult;
+    bool mHasMimeType;
+    String8 mMimeType;
+    Vector<String8> mTags;
+    Vector<String8> mValues;
+};
 
-MediaScanResult StagefrightMediaScanner::processFileInternal(
-        const char *path, const char * /* mimeType */,
-        MediaScannerClient &client) {
+static void ExtractFileMetadata(const char *path, ScannedFile *file) {
     const char *extension = strrchr(path, '.');
 
     if (!extension) {
-        return MEDIA_SCAN_RESULT_SKIPPED;
+        file->mResult = MEDIA_SCAN_RESULT_SKIPPED;
+        return;
     }
 
     if (!FileHasAcceptableExtension(extension)) {
-        return MEDIA_SCAN_RESULT_SKIPPED;
+        file->mResult = MEDIA_SCAN_RESULT_SKIPPED;
+        return;
     }
 
     sp<MediaMetadataRetriever> mRetriever(new MediaMetadataRetriever);
@@ -92,16 +95,15 @@ MediaScanResult StagefrightMediaScanner::processFileInternal(
     }
 
     if (status) {
-        return MEDIA_SCAN_RESULT_ERROR;
+        file->mResult = MEDIA_SCAN_RESULT_ERROR;
+        return;
     }
 
     const char *value;
     if ((value = mRetriever->extractMetadata(
                     METADATA_KEY_MIMETYPE)) != NULL) {
-        status = client.setMimeType(value);
-        if (status) {
-            return MEDIA_SCAN_RESULT_ERROR;
-        }
+        file->mHasMimeType = true;
+        file->mMimeType = value;
     }
 
     struct KeyMap {
@@ -131,16 +133,174 @@ MediaScanResult StagefrightMediaScanner::processFileInternal(
     for (size_t i = 0; i < kNumEntries; ++i) {
         const char *value;
         if ((value = mRetriever->extractMetadata(kKeyMap[i].key)) != NULL) {
-            status = client.addStringTag(kKeyMap[i].tag, value);
-            if (status != OK) {
-                return MEDIA_SCAN_RESULT_ERROR;
-            }
+            file->mTags.push(String8(kKeyMap[i].tag));
+            file->mValues.push(String8(value));
+        }
+    }
+
+    file->mResult = MEDIA_SCAN_RESULT_OK;
+}
+
+static MediaScanResult ReportFileMetadata(
+        const ScannedFile &file, MediaScannerClient &client) {
+    if (file.mResult != MEDIA_SCAN_RESULT_OK) {
+        return file.mResult;
+    }
+
+    if (file.mHasMimeType) {
+        status_t status = client.setMimeType(file.mMimeType.string());
+        if (status) {
+            return MEDIA_SCAN_RESULT_ERROR;
+        }
+    }
+
+    for (size_t i = 0; i < file.mTags.size(); ++i) {
+        status_t status = client.addStringTag(
+                file.mTags[i].string(), file.mValues[i].string());
+        if (status != OK) {
+            return MEDIA_SCAN_RESULT_ERROR;
         }
     }
 
     return MEDIA_SCAN_RESULT_OK;
 }
 
+MediaScanResult StagefrightMediaScanner::processFile(
+        const char *path, const char * /* mimeType */,
+        MediaScannerClient &client) {
+    ALOGV("processFile '%s'.", path);
+
+    ScannedFile file;
+    ExtractFileMetadata(path, &file);
+
+    client.setLocale(locale());
+    client.beginFile();
+    MediaScanResult result = ReportFileMetadata(file, client);
+    client.endFile();
+    return result;
+}
+
+// The files of a processFiles() call, whose metadata is extracted by the
+// threads in turn.
+struct ScanBatch {
+    enum {
+        kMaxThreads = 4,
+    };
+
+    ScanBatch(const Vector<String8> &paths)
+        : mPaths(paths),
+          mFiles(new ScannedFile[paths.size()]),
+          mDone(new bool[paths.size()]),
+          mNext(0),
+          mAborted(false) {
+        for (size_t i = 0; i < paths.size(); ++i) {
+            mDone[i] = false;
+        }
+    }
+
+    ~ScanBatch() {
+        delete[] mFiles;
+        delete[] mDone;
+    }
+
+    static void *ThreadWrapper(void *me) {
+        static_cast<ScanBatch *>(me)->threadEntry();
+        return NULL;
+    }
+
+    void threadEntry() {
+        Mutex::Autolock autoLock(mLock);
+
+        while (!mAborted && mNext < mPaths.size()) {
+            size_t index = mNext++;
+
+            mLock.unlock();
+            ExtractFileMetadata(mPaths[index].string(), &mFiles[index]);
+            mLock.lock();
+
+            mDone[index] = true;
+            mCondition.broadcast();
+        }
+    }
+
+    const Vector<String8> &mPaths;
+
+    // Each entry is written by a single thread before it is marked done,
+    // and only read once it is.
+    ScannedFile *mFiles;
+    bool *mDone;
+
+    Mutex mLock;
+    Condition mCondition;
+    size_t mNext;
+    bool mAborted;
+
+private:
+    ScanBatch(const ScanBatch &);
+    ScanBatch &operator=(const ScanBatch &);
+};
+
+MediaScanResult StagefrightMediaScanner::processFiles(
+        const Vector<String8> &paths, MediaScannerClient &client,
+        Vector<MediaScanResult> *results) {
+    results->clear();
+
+    if (paths.size() < 2) {
+        return MediaScanner::processFiles(paths, client, results);
+    }
+
+    ScanBatch batch(paths);
+
+    pthread_t threads[ScanBatch::kMaxThreads];
+    size_t numThreads = 0;
+    while (numThreads < ScanBatch::kMaxThreads && numThreads < paths.size()) {
+        if (pthread_create(
+                    &threads[numThreads], NULL, ScanBatch::ThreadWrapper, &batch)) {
+            break;
+        }
+        ++numThreads;
+    }
+
+    if (numThreads == 0) {
+        return MediaScanner::processFiles(paths, client, results);
+    }
+
+    MediaScanResult result = MEDIA_SCAN_RESULT_OK;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        {
+            Mutex::Autolock autoLock(batch.mLock);
+            while (!batch.mDone[i]) {
+                batch.mCondition.wait(batch.mLock);
+            }
+        }
+
+        ALOGV("processFile '%s'.", paths[i].string());
+
+        client.setLocale(locale());
+        client.beginFile();
+        MediaScanResult fileResult = ReportFileMetadata(batch.mFiles[i], client);
+        client.endFile();
+
+        results->push(fileResult);
+
+        if (fileResult == MEDIA_SCAN_RESULT_ERROR) {
+            result = fileResult;
+            break;
+        }
+    }
+
+    {
+        Mutex::Autolock autoLock(batch.mLock);
+        batch.mAborted = true;
+    }
+
+    for (size_t i = 0; i < numThreads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    return result;
+}
+
 MediaAlbumArt *StagefrightMediaScanner::extractAlbumArt(int fd) {
     ALOGV("extractAlbumArt %d", fd);
 
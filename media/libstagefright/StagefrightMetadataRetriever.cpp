@@ -25,6 +25,7 @@
 #include "include/avc_utils.h"
 #include "include/StagefrightMetadataRetriever.h"
 
+#include <cutils/properties.h>
 #include <media/ICrypto.h>
 #include <media/IMediaHTTPService.h>
 
@@ -37,6 +38,7 @@
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaCodec.h>
 #include <media/stagefright/MediaCodecList.h>
+#include <media/stagefright/MediaCodecPool.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MediaExtractor.h>
@@ -50,6 +52,7 @@ namespace android {
 
 static const int64_t kBufferTimeOutUs = 30000ll; // 30 msec
 static const size_t kRetryCount = 20; // must be >0
+static const int32_t kDefaultThumbnailThreads = 4;
 
 StagefrightMetadataRetriever::StagefrightMetadataRetriever()
     : mParsedMetaData(false),
@@ -170,7 +173,8 @@ static VideoFrame *extractVideoFrame(
     status_t err;
     sp<ALooper> looper = new ALooper;
     looper->start();
-    sp<MediaCodec> decoder = MediaCodec::CreateByComponentName(
+    // thumbnail strips ask for many frames in a row, so keep the decoder
+    sp<MediaCodec> decoder = MediaCodecPool::CreateByComponentName(
             looper, componentName, &err);
 
     if (decoder.get() == NULL || err != OK) {
@@ -404,9 +408,33 @@ static VideoFrame *extractVideoFrame(
         rotationAngle = 0;  // By default, no rotation
     }
 
+    // Frames larger than media.stagefright.thumb-max-dim (0, the default,
+    // keeps the full size) are downscaled while they are converted.
+    int32_t cropWidth = crop_right - crop_left + 1;
+    int32_t cropHeight = crop_bottom - crop_top + 1;
+    int32_t maxDim = property_get_int32("media.stagefright.thumb-max-dim", 0);
+    int32_t dstWidth = cropWidth;
+    int32_t dstHeight = cropHeight;
+    if (maxDim > 0 && (cropWidth > maxDim || cropHeight > maxDim)) {
+        if (cropWidth >= cropHeight) {
+            dstWidth = maxDim;
+            dstHeight = (int32_t)((int64_t)cropHeight * maxDim / cropWidth);
+        } else {
+            dstHeight = maxDim;
+            dstWidth = (int32_t)((int64_t)cropWidth * maxDim / cropHeight);
+        }
+        if (dstWidth < 1) {
+            dstWidth = 1;
+        }
+        if (dstHeight < 1) {
+            dstHeight = 1;
+        }
+        ALOGV("scaling %dx%d frame to %dx%d", cropWidth, cropHeight, dstWidth, dstHeight);
+    }
+
     VideoFrame *frame = new VideoFrame;
-    frame->mWidth = crop_right - crop_left + 1;
-    frame->mHeight = crop_bottom - crop_top + 1;
+    frame->mWidth = dstWidth;
+    frame->mHeight = dstHeight;
     frame->mDisplayWidth = frame->mWidth;
     frame->mDisplayHeight = frame->mHeight;
     frame->mSize = frame->mWidth * frame->mHeight * 2;
@@ -426,14 +454,25 @@ static VideoFrame *extractVideoFrame(
     ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, OMX_COLOR_Format16bitRGB565);
 
     if (converter.isValid()) {
-        err = converter.convert(
-                (const uint8_t *)videoFrameBuffer->data(),
-                width, height,
-                crop_left, crop_top, crop_right, crop_bottom,
-                frame->mData,
-                frame->mWidth,
-                frame->mHeight,
-                0, 0, frame->mWidth - 1, frame->mHeight - 1);
+        int32_t numThreads = property_get_int32(
+                "media.stagefright.thumb-threads", kDefaultThumbnailThreads);
+        if (dstWidth == cropWidth && dstHeight == cropHeight && numThreads <= 1) {
+            err = converter.convert(
+                    (const uint8_t *)videoFrameBuffer->data(),
+                    width, height,
+                    crop_left, crop_top, crop_right, crop_bottom,
+                    frame->mData,
+                    frame->mWidth,
+                    frame->mHeight,
+                    0, 0, frame->mWidth - 1, frame->mHeight - 1);
+        } else {
+            err = converter.convertScaled(
+                    (const uint8_t *)videoFrameBuffer->data(),
+                    width, height,
+                    crop_left, crop_top, crop_right, crop_bottom,
+                    frame->mData, frame->mWidth, frame->mHeight,
+                    numThreads > 1 ? numThreads : 1);
+        }
     } else {
         ALOGE("Unable to convert from format 0x%08x to RGB565", srcFormat);
 
@@ -443,7 +482,7 @@ static VideoFrame *extractVideoFrame(
     videoFrameBuffer.clear();
     source->stop();
     decoder->releaseOutputBuffer(index);
-    decoder->release();
+    MediaCodecPool::Recycle(decoder);
 
     if (err != OK) {
         ALOGE("Colorconverter failed to convert frame.");
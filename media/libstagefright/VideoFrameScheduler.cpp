@@ -20,6 +20,7 @@
 #define ATRACE_TAG ATRACE_TAG_VIDEO
 #include <utils/Trace.h>
 
+#include <string.h>
 #include <sys/time.h>
 
 #include <binder/IServiceManager.h>
@@ -333,6 +334,7 @@ VideoFrameScheduler::VideoFrameScheduler()
       mVsyncRefreshAt(0),
       mLastVsyncTime(-1),
       mTimeCorrection(0) {
+    memset(&mStats, 0, sizeof(mStats));
 }
 
 void VideoFrameScheduler::updateVsync() {
@@ -364,6 +366,8 @@ void VideoFrameScheduler::updateVsync() {
 }
 
 void VideoFrameScheduler::init(float videoFps) {
+    logStats();
+    memset(&mStats, 0, sizeof(mStats));
     updateVsync();
 
     mLastVsyncTime = -1;
@@ -386,6 +390,21 @@ nsecs_t VideoFrameScheduler::getVsyncPeriod() {
     return kDefaultVsyncPeriod;
 }
 
+void VideoFrameScheduler::getStats(Stats *stats) const {
+    *stats = mStats;
+}
+
+void VideoFrameScheduler::logStats() const {
+    if (mStats.mNumFrames == 0) {
+        return;
+    }
+    nsecs_t videoPeriod = mPll.getPeriod();
+    ALOGI("%zu frames at %.3f fps on %.3f Hz: %zu cadence breaks, %zu vsync corrections",
+            mStats.mNumFrames, videoPeriod > 0 ? 1e9 / videoPeriod : 0.,
+            mVsyncPeriod > 0 ? 1e9 / mVsyncPeriod : 0.,
+            mStats.mNumCadenceBreaks, mStats.mNumCorrections);
+}
+
 float VideoFrameScheduler::getFrameRate() {
     nsecs_t videoPeriod = mPll.getPeriod();
     if (videoPeriod > 0) {
@@ -462,6 +481,7 @@ nsecs_t VideoFrameScheduler::schedule(nsecs_t renderTime) {
                 nextVsyncTime -= mVsyncPeriod;
                 if (vsyncsForLastFrame > 0)
                     --vsyncsForLastFrame;
+                ++mStats.mNumCorrections;
             } else if (mTimeCorrection < -correctionLimit &&
                     (vsyncsPerFrameAreNearlyConstant || vsyncsForLastFrame == minVsyncsPerFrame)) {
                 // add a VSYNC
@@ -470,8 +490,21 @@ nsecs_t VideoFrameScheduler::schedule(nsecs_t renderTime) {
                 nextVsyncTime += mVsyncPeriod;
                 if (vsyncsForLastFrame < ULONG_MAX)
                     ++vsyncsForLastFrame;
+                ++mStats.mNumCorrections;
             }
             ATRACE_INT("FRAME_VSYNCS", vsyncsForLastFrame);
+
+            // a steady cadence only alternates between the two vsync counts
+            // around the period ratio (e.g. 3:2 for 24fps on 60Hz), or holds
+            // one count if the ratio is integral
+            ++mStats.mNumFrames;
+            if (vsyncsForLastFrame < minVsyncsPerFrame
+                    || vsyncsForLastFrame > minVsyncsPerFrame + 1
+                    || (vsyncsPerFrameAreNearlyConstant && vsyncsForLastFrame
+                            != (size_t)divRound(videoPeriod, mVsyncPeriod))) {
+                ++mStats.mNumCadenceBreaks;
+                ATRACE_INT("FRAME_CADENCE_BREAKS", mStats.mNumCadenceBreaks);
+            }
         }
         mLastVsyncTime = nextVsyncTime;
     }
@@ -485,6 +518,8 @@ nsecs_t VideoFrameScheduler::schedule(nsecs_t renderTime) {
 }
 
 void VideoFrameScheduler::release() {
+    logStats();
+    memset(&mStats, 0, sizeof(mStats));
     mComposer.clear();
 }
 
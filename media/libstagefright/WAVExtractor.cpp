@@ -382,11 +382,6 @@ status_t WAVSource::start(MetaData * /* params */) {
     // some WAV files may have large audio buffers that use shared memory transfer.
     mGroup = new MediaBufferGroup(4 /* buffers */, kMaxFrameSize);
 
-    if (mBitsPerSample == 8) {
-        // As a temporary buffer for 8->16 bit conversion.
-        mGroup->add_buffer(new MediaBuffer(kMaxFrameSize));
-    }
-
     mCurrentPos = mOffset;
 
     mStarted = true;
@@ -488,16 +483,10 @@ status_t WAVSource::read(
     // TODO: add capability to return data as float PCM instead of 16 bit PCM.
     if (mWaveFormat == WAVE_FORMAT_PCM) {
         if (mBitsPerSample == 8) {
-            // Convert 8-bit unsigned samples to 16-bit signed.
-
-            // Create new buffer with 2 byte wide samples
-            MediaBuffer *tmp;
-            CHECK_EQ(mGroup->acquire_buffer(&tmp), (status_t)OK);
-            tmp->set_range(0, 2 * n);
-
-            memcpy_to_i16_from_u8((int16_t *)tmp->data(), (const uint8_t *)buffer->data(), n);
-            buffer->release();
-            buffer = tmp;
+            // Convert 8-bit unsigned samples to 16-bit signed in place, the
+            // conversion runs backwards when both buffers start together.
+            memcpy_to_i16_from_u8((int16_t *)buffer->data(), (const uint8_t *)buffer->data(), n);
+            buffer->set_range(0, 2 * n);
         } else if (mBitsPerSample == 24) {
             // Convert 24-bit signed samples to 16-bit signed in place
             const size_t numSamples = n / 3;
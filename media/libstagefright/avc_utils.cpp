@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include "include/avc_utils.h"
+#include "include/HevcUtils.h"
 
 #include <media/stagefright/foundation/ABitReader.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -31,32 +32,17 @@
 namespace android {
 
 unsigned parseUE(ABitReader *br) {
-    unsigned numZeroes = 0;
-    while (br->getBits(1) == 0) {
-        ++numZeroes;
-    }
-
-    unsigned x = br->getBits(numZeroes);
-
-    return x + (1u << numZeroes) - 1;
+    uint32_t x;
+    CHECK(br->getUEGraceful(&x));
+    return x;
 }
 
 unsigned parseUEWithFallback(ABitReader *br, unsigned fallback) {
-    unsigned numZeroes = 0;
-    while (br->getBitsWithFallback(1, 1) == 0) {
-        ++numZeroes;
-    }
     uint32_t x;
-    if (numZeroes < 32) {
-        if (br->getBitsGraceful(numZeroes, &x)) {
-            return x + (1u << numZeroes) - 1;
-        } else {
-            return fallback;
-        }
-    } else {
-        br->skipBits(numZeroes);
-        return fallback;
+    if (br->getUEGraceful(&x)) {
+        return x;
     }
+    return fallback;
 }
 
 signed parseSE(ABitReader *br) {
@@ -271,9 +257,22 @@ status_t getNextNALUnit(
     size_t offset = 0;
 
     // A valid startcode consists of at least two 0x00 bytes followed by 0x01.
-    for (; offset + 2 < size; ++offset) {
-        if (data[offset + 2] == 0x01 && data[offset] == 0x00
-                && data[offset + 1] == 0x00) {
+    // Search for the 0x01 with memchr() and check the two bytes before it.
+    for (;;) {
+        const uint8_t *one = (const uint8_t *)memchr(
+                &data[offset + 2], 0x01, size - offset - 2);
+
+        if (one == NULL) {
+            offset = size - 2;
+            break;
+        }
+
+        offset = one - data - 2;
+        if (data[offset] == 0x00 && data[offset + 1] == 0x00) {
+            break;
+        }
+
+        if (++offset + 2 >= size) {
             break;
         }
     }
@@ -287,9 +286,11 @@ status_t getNextNALUnit(
     size_t startOffset = offset;
 
     for (;;) {
-        while (offset < size && data[offset] != 0x01) {
-            ++offset;
+        const uint8_t *one = NULL;
+        if (offset < size) {
+            one = (const uint8_t *)memchr(&data[offset], 0x01, size - offset);
         }
+        offset = (one == NULL) ? size : one - data;
 
         if (offset == size) {
             if (startCodeFollows) {
@@ -447,6 +448,66 @@ sp<MetaData> MakeAVCCodecSpecificData(const sp<ABuffer> &accessUnit) {
     return meta;
 }
 
+sp<MetaData> MakeHEVCCodecSpecificData(const sp<ABuffer> &accessUnit) {
+    const uint8_t *data = accessUnit->data();
+    size_t size = accessUnit->size();
+
+    HevcParameterSets paramSets;
+    const uint8_t *nalStart;
+    size_t nalSize;
+    while (getNextNALUnit(&data, &size, &nalStart, &nalSize, true) == OK) {
+        if (nalSize < 2) {
+            continue;
+        }
+
+        unsigned nalType = (nalStart[0] >> 1) & 0x3f;
+        if (nalType != kHevcNalUnitTypeVps
+                && nalType != kHevcNalUnitTypeSps
+                && nalType != kHevcNalUnitTypePps) {
+            continue;
+        }
+
+        if (paramSets.addNalUnit(nalStart, nalSize) != OK) {
+            ALOGW("malformed HEVC parameter set");
+            return NULL;
+        }
+    }
+
+    if (paramSets.getNumNalUnitsOfType(kHevcNalUnitTypeVps) == 0
+            || paramSets.getNumNalUnitsOfType(kHevcNalUnitTypeSps) == 0
+            || paramSets.getNumNalUnitsOfType(kHevcNalUnitTypePps) == 0) {
+        return NULL;
+    }
+
+    uint32_t width, height;
+    if (!paramSets.findParam32(kPicWidthInLumaSamples, &width)
+            || !paramSets.findParam32(kPicHeightInLumaSamples, &height)) {
+        return NULL;
+    }
+
+    // 23 bytes of header, 3 per NAL unit array and 2 per NAL unit.
+    size_t hvccSize = 23 + 3 * 3;
+    for (size_t i = 0; i < paramSets.getNumNalUnits(); ++i) {
+        hvccSize += 2 + paramSets.getSize(i);
+    }
+
+    sp<ABuffer> hvcc = new ABuffer(hvccSize);
+    if (paramSets.makeHvcc(hvcc->data(), &hvccSize, 4 /* nalSizeLength */) != OK) {
+        return NULL;
+    }
+
+    sp<MetaData> meta = new MetaData;
+    meta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_VIDEO_HEVC);
+
+    meta->setData(kKeyHVCC, kTypeHVCC, hvcc->data(), hvccSize);
+    meta->setInt32(kKeyWidth, width);
+    meta->setInt32(kKeyHeight, height);
+
+    ALOGI("found HEVC codec config (%u x %u)", width, height);
+
+    return meta;
+}
+
 bool IsIDR(const sp<ABuffer> &buffer) {
     const uint8_t *data = buffer->data();
     size_t size = buffer->size();
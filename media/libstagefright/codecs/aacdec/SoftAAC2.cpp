@@ -77,7 +77,9 @@ SoftAAC2::SoftAAC2(
       mOutputBufferCount(0),
       mSignalledError(false),
       mLastInHeader(NULL),
+      mOutputBatchMs(0),
       mOutputPortSettingsChange(NONE) {
+    mOutputBatchMs = property_get_int32("media.swcodec.audio-batch-ms", 0);
     initPorts();
     CHECK_EQ(initDecoder(), (status_t)OK);
 }
@@ -542,6 +544,26 @@ int32_t SoftAAC2::outputDelayRingBufferSpaceLeft() {
 }
 
 
+// Returns how many AAC frames to collect into an output buffer, 1 for one
+// input buffer's worth.
+int32_t SoftAAC2::getOutputBatchFrames() {
+    if (mOutputBatchMs <= 0 || mStreamInfo->frameSize <= 0
+            || mStreamInfo->numChannels <= 0) {
+        return 1;
+    }
+
+    int64_t frames = (int64_t)mOutputBatchMs * mStreamInfo->sampleRate
+            / 1000 / mStreamInfo->frameSize;
+
+    // leave room in the ring buffer to keep decoding while a batch fills up
+    int64_t maxFrames = mOutputDelayRingBufferSize / 2
+            / (mStreamInfo->frameSize * mStreamInfo->numChannels);
+    if (frames > maxFrames) {
+        frames = maxFrames;
+    }
+    return frames > 1 ? (int32_t)frames : 1;
+}
+
 void SoftAAC2::onQueueFilled(OMX_U32 /* portIndex */) {
     if (mSignalledError || mOutputPortSettingsChange != NONE) {
         return;
@@ -875,9 +897,17 @@ void SoftAAC2::onQueueFilled(OMX_U32 /* portIndex */) {
             }
         }
 
+        int32_t batchFrames = getOutputBatchFrames();
         while (!outQueue.empty()
                 && outputDelayRingBufferSamplesAvailable()
                         >= mStreamInfo->frameSize * mStreamInfo->numChannels) {
+            if (batchFrames > 1 && !mEndOfInput && !inQueue.empty()
+                    && outputDelayRingBufferSamplesAvailable() < batchFrames
+                            * mStreamInfo->frameSize * mStreamInfo->numChannels) {
+                // decode the queued input before handing out a buffer
+                break;
+            }
+
             BufferInfo *outInfo = *outQueue.begin();
             OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
@@ -910,6 +940,9 @@ void SoftAAC2::onQueueFilled(OMX_U32 /* portIndex */) {
             if (available) {
 
                 int numFrames = numSamples / (mStreamInfo->frameSize * mStreamInfo->numChannels);
+                if (batchFrames > 1 && numFrames > batchFrames) {
+                    numFrames = batchFrames;
+                }
                 numSamples = numFrames * (mStreamInfo->frameSize * mStreamInfo->numChannels);
 
                 ALOGV("%d samples available (%d), or %d frames",
@@ -941,11 +974,14 @@ void SoftAAC2::onQueueFilled(OMX_U32 /* portIndex */) {
                         // try to limit output buffer size to match input buffers
                         // (e.g when an input buffer contained 4 "sub" frames, output
                         // at most 4 decoded units in the corresponding output buffer)
-                        // This is optional. Remove the next three lines to fill the output
-                        // buffer with as many units as available.
-                        numFrames = i + 1;
-                        numSamples = numFrames * mStreamInfo->frameSize * mStreamInfo->numChannels;
-                        break;
+                        // This is optional, and skipped when batching output across
+                        // input buffers.
+                        if (batchFrames <= 1 || mBufferTimestamps.empty()) {
+                            numFrames = i + 1;
+                            numSamples = numFrames * mStreamInfo->frameSize
+                                    * mStreamInfo->numChannels;
+                            break;
+                        }
                     }
                 }
 
@@ -65,6 +65,10 @@ private:
 
     CDrcPresModeWrapper mDrcWrap;
 
+    // Decoded audio to collect into one output buffer, across input buffers,
+    // from media.swcodec.audio-batch-ms; 0 matches output to input buffers.
+    int32_t mOutputBatchMs;
+
     enum {
         NONE,
         AWAITING_DISABLED,
@@ -75,6 +79,7 @@ private:
     status_t initDecoder();
     bool isConfigured() const;
     void drainDecoder();
+    int32_t getOutputBatchFrames();
 
 //      delay compensation
     bool mEndOfInput;
@@ -74,6 +74,10 @@ terms listed above has been obtained from the copyright holder.
 #include "typedef.h"
 #include "cnst.h"
 
+#ifdef NEON_INTRINSICS
+#include <arm_neon.h>
+#endif
+
 /*----------------------------------------------------------------------------
 ; MACROS
 ; Define module specific macros here
@@ -200,7 +204,24 @@ void Residu(
     Word16 input_len        /* (i)     : size of filtering      */
 )
 {
+#ifdef NEON_INTRINSICS
+    /*
+     * Same outputs as the C loop below, four neighbouring ones per pass.
+     * The 32 bit sums wrap the same way, so the result is bit-exact.
+     */
+    for (Word16 n = input_len & 3; n < input_len; n += 4)
+    {
+        int32x4_t acc = vdupq_n_s32(0x0000800L);
 
+        for (Word16 k = 0; k <= M; k++)
+        {
+            acc = vmlal_n_s16(acc, vld1_s16(&input_ptr[n - k]), coef_ptr[k]);
+        }
+
+        vst1_s16(&residual_ptr[n], vshrn_n_s32(acc, 12));
+    }
+    return;
+#endif
 
     Word16 i, j;
     Word32 s1;
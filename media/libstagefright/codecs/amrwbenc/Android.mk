@@ -86,6 +86,9 @@ else
     LOCAL_C_INCLUDES_arm += $(LOCAL_PATH)/src/asm/ARMV7
 endif
 
+# arm64 has no asm versions, use the NEON intrinsics in the C code
+LOCAL_CFLAGS_arm64 := -DNEON_INTRINSICS
+
 LOCAL_MODULE := libstagefright_amrwbenc
 
 LOCAL_ARM_MODE := arm
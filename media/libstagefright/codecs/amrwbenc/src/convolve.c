@@ -25,6 +25,10 @@
 #include "typedef.h"
 #include "basic_op.h"
 
+#ifdef NEON_INTRINSICS
+#include <arm_neon.h>
+#endif
+
 #define UNUSED(x) (void)(x)
 
 void Convolve (
@@ -39,6 +43,70 @@ void Convolve (
     Word32 s;
         UNUSED(L);
 
+#ifdef NEON_INTRINSICS
+    /*
+     * Four neighbouring outputs per pass, summed in 64 bits. The C code
+     * saturates every partial sum, so a sum is only used as is when the
+     * sum of the magnitudes of its products shows that no partial sum can
+     * overflow; otherwise that output is recomputed the C way, which keeps
+     * the result bit-exact.
+     */
+    Word16 hz[3 + 64];
+    int64_t sums[4];
+    uint64_t mags[4];
+    Word32 k;
+
+    hz[0] = hz[1] = hz[2] = 0;
+    for (i = 0; i < 64; i++)
+    {
+        hz[3 + i] = h[i];
+    }
+
+    for (n = 0; n < 64; n += 4)
+    {
+        int64x2_t sum01 = vdupq_n_s64(0);
+        int64x2_t sum23 = vdupq_n_s64(0);
+        uint64x2_t mag01 = vdupq_n_u64(0);
+        uint64x2_t mag23 = vdupq_n_u64(0);
+
+        /* output n + k takes h[n + k - i], zero when that is negative */
+        for (i = 0; i <= n + 3; i++)
+        {
+            int32x4_t p = vmull_n_s16(vld1_s16(&hz[3 + n - i]), x[i]);
+            uint32x4_t m = vreinterpretq_u32_s32(vabsq_s32(p));
+            sum01 = vaddw_s32(sum01, vget_low_s32(p));
+            sum23 = vaddw_s32(sum23, vget_high_s32(p));
+            mag01 = vaddw_u32(mag01, vget_low_u32(m));
+            mag23 = vaddw_u32(mag23, vget_high_u32(m));
+        }
+
+        vst1q_s64(&sums[0], sum01);
+        vst1q_s64(&sums[2], sum23);
+        vst1q_u64(&mags[0], mag01);
+        vst1q_u64(&mags[2], mag23);
+
+        for (k = 0; k < 4; k++)
+        {
+            if (mags[k] <= (uint64_t)MAX_32)
+            {
+                s = (Word32)sums[k];
+            }
+            else
+            {
+                tmpH = h + n + k;
+                tmpX = x;
+                s = vo_mult32((*tmpX++), (*tmpH--));
+                for (i = n + k; i > 0; i--)
+                {
+                    s = L_add(s, vo_mult32((*tmpX++), (*tmpH--)));
+                }
+            }
+            y[n + k] = voround(L_shl(s, 1));
+        }
+    }
+    return;
+#endif
+
     for (n = 0; n < 64;)
     {
         tmpH = h+n;
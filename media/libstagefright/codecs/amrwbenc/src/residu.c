@@ -25,6 +25,10 @@
 #include "typedef.h"
 #include "basic_op.h"
 
+#ifdef NEON_INTRINSICS
+#include <arm_neon.h>
+#endif
+
 void Residu(
         Word16 a[],                           /* (i) Q12 : prediction coefficients                     */
         Word16 x[],                           /* (i)     : speech (values x[-m..-1] are needed         */
@@ -34,7 +38,29 @@ void Residu(
 {
     Word16 i,*p1, *p2;
     Word32 s;
-    for (i = 0; i < lg; i++)
+#ifdef NEON_INTRINSICS
+    /* four neighbouring outputs per pass; the 32 bit sums wrap the same
+       way as the C ones, so the result is bit-exact */
+    Word32 sums[4];
+    Word16 j, k;
+    for (i = 0; i + 4 <= lg; i += 4)
+    {
+        int32x4_t acc = vmull_n_s16(vld1_s16(&x[i]), a[0]);
+        for (j = 1; j <= 16; j++)
+        {
+            acc = vmlal_n_s16(acc, vld1_s16(&x[i - j]), a[j]);
+        }
+        vst1q_s32(sums, acc);
+        for (k = 0; k < 4; k++)
+        {
+            s = L_shl2(sums[k], 5);
+            y[i + k] = extract_h(L_add(s, 0x8000));
+        }
+    }
+#else
+    i = 0;
+#endif
+    for (; i < lg; i++)
     {
         p1 = a;
         p2 = &x[i];
@@ -147,19 +147,6 @@ static void ivd_aligned_free(void *ctxt, void *buf) {
     return;
 }
 
-static size_t GetCPUCoreCount() {
-    long cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
-    return (size_t)cpuCoreCount;
-}
-
 void SoftAVC::logVersion() {
     ivd_ctl_getversioninfo_ip_t s_ctl_ip;
     ivd_ctl_getversioninfo_op_t s_ctl_op;
@@ -295,7 +282,7 @@ status_t SoftAVC::setFlushMode() {
 status_t SoftAVC::initDecoder() {
     IV_API_CALL_STATUS_T status;
 
-    mNumCores = GetCPUCoreCount();
+    mNumCores = GetDecoderThreadCount(CODEC_MAX_NUM_CORES);
     mCodecCtx = NULL;
 
     mStride = outputBufferWidth();
@@ -22,6 +22,7 @@ LOCAL_SHARED_LIBRARIES  += libstagefright_omx
 LOCAL_SHARED_LIBRARIES  += libstagefright_foundation
 LOCAL_SHARED_LIBRARIES  += libutils
 LOCAL_SHARED_LIBRARIES  += liblog
+LOCAL_SHARED_LIBRARIES  += libcutils
 
 LOCAL_CLANG := true
 LOCAL_SANITIZE := signed-integer-overflow
@@ -18,6 +18,7 @@
 #define LOG_TAG "SoftAVCEnc"
 #include <utils/Log.h>
 #include <utils/misc.h>
+#include <cutils/properties.h>
 
 #include "OMX_Video.h"
 
@@ -206,7 +207,11 @@ void  SoftAVC::initEncParams() {
     mDisableDeblkLevel = DEFAULT_DISABLE_DEBLK_LEVEL;
     mEnableFastSad = DEFAULT_ENABLE_FAST_SAD;
     mEnableAltRef = DEFAULT_ENABLE_ALT_REF;
-    mEncSpeed = DEFAULT_ENC_SPEED;
+    mEncSpeed = (IVE_SPEED_CONFIG)property_get_int32(
+            "media.avcenc.speed", DEFAULT_ENC_SPEED);
+    if (mEncSpeed < IVE_SLOWEST || mEncSpeed > IVE_FASTEST) {
+        mEncSpeed = DEFAULT_ENC_SPEED;
+    }
     mIntra4x4 = DEFAULT_INTRA4x4;
     mConstrainedIntraFlag = DEFAULT_CONSTRAINED_INTRA;
     mAIRMode = DEFAULT_AIR;
@@ -219,6 +224,9 @@ void  SoftAVC::initEncParams() {
     gettimeofday(&mTimeStart, NULL);
     gettimeofday(&mTimeEnd, NULL);
 
+    mNumFramesEncoded = 0;
+    mTotalEncodeTimeUs = 0;
+    mMaxEncodeTimeUs = 0;
 }
 
 
@@ -889,6 +897,16 @@ OMX_ERRORTYPE SoftAVC::releaseEncoder() {
         return OMX_ErrorNone;
     }
 
+    if (mNumFramesEncoded > 0) {
+        ALOGD("encoded %u frames at speed %d, encode time avg %lld us max %lld us",
+                mNumFramesEncoded, mEncSpeed,
+                (long long)(mTotalEncodeTimeUs / mNumFramesEncoded),
+                (long long)mMaxEncodeTimeUs);
+        mNumFramesEncoded = 0;
+        mTotalEncodeTimeUs = 0;
+        mMaxEncodeTimeUs = 0;
+    }
+
     s_retrieve_mem_ip.u4_size = sizeof(iv_retrieve_mem_rec_ip_t);
     s_retrieve_mem_op.u4_size = sizeof(iv_retrieve_mem_rec_op_t);
     s_retrieve_mem_ip.e_cmd = IV_CMD_RETRIEVE_MEMREC;
@@ -1049,11 +1067,43 @@ OMX_ERRORTYPE SoftAVC::internalSetParameter(OMX_INDEXTYPE index, const OMX_PTR p
             return OMX_ErrorNone;
         }
 
+        case kEncoderSpeedExtensionIndex:
+        {
+            OMX_PARAM_U32TYPE *speedParams = (OMX_PARAM_U32TYPE *)params;
+
+            if (!isValidOMXParam(speedParams)) {
+                return OMX_ErrorBadParameter;
+            }
+
+            if (speedParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorBadPortIndex;
+            }
+
+            // 0 is the slowest preset, anything past the fastest is the fastest
+            OMX_U32 speed = IVE_SLOWEST + speedParams->nU32;
+            if (speedParams->nU32 > IVE_FASTEST - IVE_SLOWEST) {
+                speed = IVE_FASTEST;
+            }
+            if (mEncSpeed != (IVE_SPEED_CONFIG)speed) {
+                mEncSpeed = (IVE_SPEED_CONFIG)speed;
+                mUpdateFlag |= kUpdateEncSpeed;
+            }
+            return OMX_ErrorNone;
+        }
+
         default:
             return SoftVideoEncoderOMXComponent::internalSetParameter(index, params);
     }
 }
 
+OMX_ERRORTYPE SoftAVC::getExtensionIndex(const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, "OMX.google.android.index.encoderSpeed")) {
+        *(int32_t *)index = kEncoderSpeedExtensionIndex;
+        return OMX_ErrorNone;
+    }
+    return SoftVideoEncoderOMXComponent::getExtensionIndex(name, index);
+}
+
 OMX_ERRORTYPE SoftAVC::getConfig(
         OMX_INDEXTYPE index, OMX_PTR _params) {
     switch ((int)index) {
@@ -1390,6 +1440,9 @@ void SoftAVC::onQueueFilled(OMX_U32 portIndex) {
                 notify(OMX_EventPortSettingsChanged, kOutputPortIndex,
                         OMX_IndexConfigAndroidIntraRefresh, NULL);
             }
+            if (mUpdateFlag & kUpdateEncSpeed) {
+                setIpeParams();
+            }
             mUpdateFlag = 0;
         }
 
@@ -1442,6 +1495,12 @@ void SoftAVC::onQueueFilled(OMX_U32 portIndex) {
         ALOGV("timeTaken=%6d delay=%6d numBytes=%6d", timeTaken, timeDelay,
                 s_encode_op.s_out_buf.u4_bytes);
 
+        ++mNumFramesEncoded;
+        mTotalEncodeTimeUs += timeTaken;
+        if (timeTaken > mMaxEncodeTimeUs) {
+            mMaxEncodeTimeUs = timeTaken;
+        }
+
         /* In encoder frees up an input buffer, mark it as free */
         if (s_encode_op.s_inp_buf.apv_bufs[0] != NULL) {
             if (mInputDataIsMeta) {
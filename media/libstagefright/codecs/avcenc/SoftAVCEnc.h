@@ -133,6 +133,8 @@ struct SoftAVC : public SoftVideoEncoderOMXComponent {
 
     virtual void onQueueFilled(OMX_U32 portIndex);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(const char *name, OMX_INDEXTYPE *index);
+
 protected:
     virtual ~SoftAVC();
 
@@ -147,6 +149,7 @@ private:
         kUpdateBitrate            = 1 << 0,
         kRequestKeyFrame          = 1 << 1,
         kUpdateAIRMode            = 1 << 2,
+        kUpdateEncSpeed           = 1 << 3,
     };
 
     // OMX input buffer's timestamp and flags
@@ -162,6 +165,11 @@ private:
 
     int mUpdateFlag;
 
+    // Encode time of the frames encoded so far, logged on release
+    uint32_t mNumFramesEncoded;
+    int64_t mTotalEncodeTimeUs;
+    int64_t mMaxEncodeTimeUs;
+
 #ifdef FILE_DUMP_ENABLE
     char mInFile[200];
     char mOutFile[200];
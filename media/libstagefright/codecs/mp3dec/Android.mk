@@ -53,6 +53,8 @@ LOCAL_C_INCLUDES := \
 LOCAL_CFLAGS := \
         -D"OSCL_UNUSED_ARG(x)=(void)(x)"
 
+LOCAL_CFLAGS_arm64 := -DNEON_INTRINSICS
+
 LOCAL_CFLAGS += -Werror
 LOCAL_CLANG := true
 LOCAL_SANITIZE := signed-integer-overflow
@@ -76,11 +76,27 @@ Input
 #include "pvmp3_dec_defs.h"
 #include "pvmp3_tables.h"
 
+#ifdef NEON_INTRINSICS
+#include <arm_neon.h>
+#endif
+
 /*----------------------------------------------------------------------------
 ; MACROS
 ; Define module1 specific macros here
 ----------------------------------------------------------------------------*/
 
+#ifdef NEON_INTRINSICS
+/*
+ *  Lane-wise fxp_mul32_Q32(): (int32)(((int64)a*b) >> 32) of each lane, so
+ *  the sums below are bit exact with the C version.
+ */
+static inline int32x4_t mul32_Q32_x4(int32x4_t a, int32x4_t b)
+{
+    int32x2_t lo = vshrn_n_s64(vmull_s32(vget_low_s32(a), vget_low_s32(b)), 32);
+    int32x2_t hi = vshrn_n_s64(vmull_s32(vget_high_s32(a), vget_high_s32(b)), 32);
+    return vcombine_s32(lo, hi);
+}
+#endif
 
 
 /*----------------------------------------------------------------------------
@@ -122,6 +138,47 @@ void pvmp3_polyphase_filter_window(int32 *synth_buffer,
     int32 i;
 
 
+#ifdef NEON_INTRINSICS
+    /*
+     *  Every group of 4 taps below adds the products of (temp1, temp3, temp2,
+     *  temp4) with winPtr[0..3] to sum1 with the signs (+, -, +, +), and the
+     *  products of (temp3, temp1, temp4, temp2) to sum2 with (+, +, -, +), so
+     *  the 4 groups are accumulated lane by lane and the signs are applied
+     *  once at the end.
+     */
+    static const int32 kSign1[4] = { 1, -1,  1, 1 };
+    static const int32 kSign2[4] = { 1,  1, -1, 1 };
+    const int32x4_t sign1 = vld1q_s32(kSign1);
+    const int32x4_t sign2 = vld1q_s32(kSign2);
+
+    for (int16 j = 1; j < SUBBANDS_NUMBER / 2; j++)
+    {
+        int32 *pt_1 = &synth_buffer[(SUBBANDS_NUMBER >> 1) + j];
+        int32 *pt_2 = &synth_buffer[(SUBBANDS_NUMBER >> 1) - j];
+        int32x4_t acc1 = vdupq_n_s32(0);
+        int32x4_t acc2 = vdupq_n_s32(0);
+
+        for (i = 0; i < 4; i++)
+        {
+            int32x4_t temp = vdupq_n_s32(pt_1[SUBBANDS_NUMBER * 2 * i]);
+            temp = vsetq_lane_s32(pt_2[SUBBANDS_NUMBER * (15 - 2 * i)], temp, 1);
+            temp = vsetq_lane_s32(pt_2[SUBBANDS_NUMBER * (2 * i + 1)], temp, 2);
+            temp = vsetq_lane_s32(pt_1[SUBBANDS_NUMBER * (14 - 2 * i)], temp, 3);
+            int32x4_t win = vld1q_s32(&winPtr[4 * i]);
+
+            acc1 = vaddq_s32(acc1, mul32_Q32_x4(temp, win));
+            acc2 = vaddq_s32(acc2, mul32_Q32_x4(vrev64q_s32(temp), win));
+        }
+        winPtr += 16;
+
+        sum1 = 0x00000020 + vaddvq_s32(vmulq_s32(acc1, sign1));
+        sum2 = 0x00000020 + vaddvq_s32(vmulq_s32(acc2, sign2));
+
+        int32 k = j << (numChannels - 1);
+        outPcm[k] = saturate16(sum1 >> 6);
+        outPcm[(numChannels<<5) - k] = saturate16(sum2 >> 6);
+    }
+#else
     for (int16 j = 1; j < SUBBANDS_NUMBER / 2; j++)
     {
         sum1 = 0x00000020;
@@ -199,6 +256,7 @@ void pvmp3_polyphase_filter_window(int32 *synth_buffer,
         outPcm[k] = saturate16(sum1 >> 6);
         outPcm[(numChannels<<5) - k] = saturate16(sum2 >> 6);
     }
+#endif
 
 
 
@@ -21,9 +21,11 @@
 #include <utils/Log.h>
 #include <utils/misc.h>
 
+#include <cutils/properties.h>
 #include <media/hardware/HardwareAPI.h>
 #include <media/hardware/MetadataBufferType.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/MediaDefs.h>
 
 #ifndef INT32_MAX
@@ -55,6 +57,17 @@ static int GetCPUCoreCount() {
     return cpuCoreCount;
 }
 
+// Range of the VP8 real-time speed presets the speed control moves within.
+static const int32_t kMinCpuUsed = 4;
+static const int32_t kMaxCpuUsed = 16;
+static const int32_t kDefaultCpuUsed = 8;
+
+// Share of the frame interval the speed control aims to encode a frame in.
+static const int32_t kDefaultTargetLoadPercent = 70;
+
+// Frames to wait after a speed change before judging its effect.
+static const uint32_t kSpeedSettleFrames = 8;
+
 static const CodecProfileLevel kProfileLevels[] = {
     { OMX_VIDEO_VP8ProfileMain, OMX_VIDEO_VP8Level_Version0 },
     { OMX_VIDEO_VP8ProfileMain, OMX_VIDEO_VP8Level_Version1 },
@@ -88,7 +101,15 @@ SoftVPXEncoder::SoftVPXEncoder(const char *name,
       mTemporalPatternIdx(0),
       mLastTimestamp(0x7FFFFFFFFFFFFFFFLL),
       mConversionBuffer(NULL),
-      mKeyFrameRequested(false) {
+      mKeyFrameRequested(false),
+      mSpeedControl(false),
+      mTargetLoadPercent(kDefaultTargetLoadPercent),
+      mCpuUsed(kDefaultCpuUsed),
+      mFramesSinceSpeedChange(0),
+      mAvgEncodeTimeUs(0),
+      mMaxEncodeTimeUs(0),
+      mTotalEncodeTimeUs(0),
+      mNumEncodedFrames(0) {
     memset(mTemporalLayerBitrateRatio, 0, sizeof(mTemporalLayerBitrateRatio));
     mTemporalLayerBitrateRatio[0] = 100;
 
@@ -291,6 +312,30 @@ status_t SoftVPXEncoder::initEncoder() {
         goto CLEAN_UP;
     }
 
+    // Real-time speed control defaults to on for CBR, the mode real-time
+    // clients use, and replaces libvpx's own speed selection there.
+    mSpeedControl = property_get_bool(
+            "media.vpxenc.speed-control", mBitrateControlMode == VPX_CBR);
+    mTargetLoadPercent = property_get_int32(
+            "media.vpxenc.target-load-pct", kDefaultTargetLoadPercent);
+    if (mTargetLoadPercent <= 0 || mTargetLoadPercent > 100) {
+        mTargetLoadPercent = kDefaultTargetLoadPercent;
+    }
+    mCpuUsed = kDefaultCpuUsed;
+    mFramesSinceSpeedChange = 0;
+    mAvgEncodeTimeUs = 0;
+    mMaxEncodeTimeUs = 0;
+    mTotalEncodeTimeUs = 0;
+    mNumEncodedFrames = 0;
+
+    if (mSpeedControl) {
+        codec_return = vpx_codec_control(mCodecContext, VP8E_SET_CPUUSED, mCpuUsed);
+        if (codec_return != VPX_CODEC_OK) {
+            ALOGE("Error setting cpu-used for vpx encoder.");
+            goto CLEAN_UP;
+        }
+    }
+
     // Extra CBR settings
     if (mBitrateControlMode == VPX_CBR) {
         codec_return = vpx_codec_control(mCodecContext,
@@ -307,7 +352,7 @@ status_t SoftVPXEncoder::initEncoder() {
                                              VP8E_SET_MAX_INTRA_BITRATE_PCT,
                                              rc_max_intra_target);
         }
-        if (codec_return == VPX_CODEC_OK) {
+        if (codec_return == VPX_CODEC_OK && !mSpeedControl) {
             codec_return = vpx_codec_control(mCodecContext,
                                              VP8E_SET_CPUUSED,
                                              -8);
@@ -340,6 +385,14 @@ CLEAN_UP:
 
 
 status_t SoftVPXEncoder::releaseEncoder() {
+    if (mNumEncodedFrames > 0) {
+        ALOGD("VP8: encoded %u frames, encode time avg %lld us max %lld us,"
+              " cpu-used %d",
+              mNumEncodedFrames, (long long)(mTotalEncodeTimeUs / mNumEncodedFrames),
+              (long long)mMaxEncodeTimeUs, mCpuUsed);
+        mNumEncodedFrames = 0;
+    }
+
     if (mCodecContext != NULL) {
         vpx_codec_destroy(mCodecContext);
         delete mCodecContext;
@@ -692,6 +745,44 @@ vpx_enc_frame_flags_t SoftVPXEncoder::getEncodeFlags() {
     return flags;
 }
 
+void SoftVPXEncoder::updateSpeed(int64_t encodeTimeUs, uint32_t frameDurationUs) {
+    ++mNumEncodedFrames;
+    mTotalEncodeTimeUs += encodeTimeUs;
+    if (encodeTimeUs > mMaxEncodeTimeUs) {
+        mMaxEncodeTimeUs = encodeTimeUs;
+    }
+    // running average over roughly the last 8 frames
+    mAvgEncodeTimeUs = mNumEncodedFrames == 1
+            ? encodeTimeUs : (mAvgEncodeTimeUs * 7 + encodeTimeUs) / 8;
+
+    ALOGV("VP8: frame encoded in %lld us (avg %lld us), cpu-used %d",
+          (long long)encodeTimeUs, (long long)mAvgEncodeTimeUs, mCpuUsed);
+
+    if (!mSpeedControl || ++mFramesSinceSpeedChange < kSpeedSettleFrames) {
+        return;
+    }
+
+    int64_t targetUs = (int64_t)frameDurationUs * mTargetLoadPercent / 100;
+    int32_t cpuUsed = mCpuUsed;
+    if (mAvgEncodeTimeUs > targetUs && cpuUsed < kMaxCpuUsed) {
+        ++cpuUsed;
+    } else if (mAvgEncodeTimeUs < targetUs / 2 && cpuUsed > kMinCpuUsed) {
+        --cpuUsed;
+    } else {
+        return;
+    }
+
+    if (vpx_codec_control(mCodecContext, VP8E_SET_CPUUSED, cpuUsed) != VPX_CODEC_OK) {
+        ALOGW("VP8: cannot change cpu-used to %d", cpuUsed);
+        mSpeedControl = false;
+        return;
+    }
+    ALOGV("VP8: cpu-used %d -> %d (avg %lld us, target %lld us)",
+          mCpuUsed, cpuUsed, (long long)mAvgEncodeTimeUs, (long long)targetUs);
+    mCpuUsed = cpuUsed;
+    mFramesSinceSpeedChange = 0;
+}
+
 void SoftVPXEncoder::onQueueFilled(OMX_U32 /* portIndex */) {
     // Initialize encoder if not already
     if (mCodecContext == NULL) {
@@ -798,6 +889,7 @@ void SoftVPXEncoder::onQueueFilled(OMX_U32 /* portIndex */) {
             frameDuration = (uint32_t)(((uint64_t)1000000 << 16) / framerate);
         }
         mLastTimestamp = inputBufferHeader->nTimeStamp;
+        int64_t encodeStartUs = ALooper::GetNowUs();
         codec_return = vpx_codec_encode(
                 mCodecContext,
                 &raw_frame,
@@ -813,6 +905,7 @@ void SoftVPXEncoder::onQueueFilled(OMX_U32 /* portIndex */) {
                    NULL);  // Notification data pointer
             return;
         }
+        updateSpeed(ALooper::GetNowUs() - encodeStartUs, frameDuration);
 
         vpx_codec_iter_t encoded_packet_iterator = NULL;
         const vpx_codec_cx_pkt_t* encoded_packet;
@@ -218,6 +218,20 @@ private:
 
     bool mKeyFrameRequested;
 
+    // Real-time speed control: cpu-used goes up while encoding takes more
+    // than mTargetLoadPercent of the frame interval, and back down when it
+    // takes less than half of that.
+    bool mSpeedControl;
+    int32_t mTargetLoadPercent;
+    int32_t mCpuUsed;
+    uint32_t mFramesSinceSpeedChange;
+
+    // Per-frame encode time, logged when the encoder is released
+    int64_t mAvgEncodeTimeUs;
+    int64_t mMaxEncodeTimeUs;
+    int64_t mTotalEncodeTimeUs;
+    uint32_t mNumEncodedFrames;
+
     // Initializes vpx encoder with available settings.
     status_t initEncoder();
 
@@ -228,6 +242,9 @@ private:
     // dtor.
     status_t releaseEncoder();
 
+    // Records how long a frame took to encode and adjusts cpu-used.
+    void updateSpeed(int64_t encodeTimeUs, uint32_t frameDurationUs);
+
     // Get current encode flags
     vpx_enc_frame_flags_t getEncodeFlags();
 
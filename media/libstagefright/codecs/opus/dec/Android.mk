@@ -11,7 +11,7 @@ LOCAL_C_INCLUDES := \
 
 LOCAL_SHARED_LIBRARIES := \
         libopus libstagefright libstagefright_omx \
-        libstagefright_foundation libutils liblog
+        libstagefright_foundation libutils libcutils liblog
 
 LOCAL_CLANG := true
 LOCAL_SANITIZE := signed-integer-overflow unsigned-integer-overflow
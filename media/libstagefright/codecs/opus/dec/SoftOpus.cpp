@@ -22,6 +22,7 @@
 #include <OMX_AudioExt.h>
 #include <OMX_IndexExt.h>
 
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaDefs.h>
 
@@ -62,7 +63,10 @@ SoftOpus::SoftOpus(
       mSeekPreRoll(0),
       mAnchorTimeUs(0),
       mNumFramesOutput(0),
+      mOutputBatchMs(0),
+      mOutputBatchFrames(0),
       mOutputPortSettingsChange(NONE) {
+    mOutputBatchMs = property_get_int32("media.swcodec.audio-batch-ms", 0);
     initPorts();
     CHECK_EQ(initDecoder(), (status_t)OK);
 }
@@ -435,8 +439,12 @@ void SoftOpus::onQueueFilled(OMX_U32 portIndex) {
             inInfo->mOwnedByUs = false;
             notifyEmptyBufferDone(inHeader);
 
-            outHeader->nFilledLen = 0;
+            // a partially collected batch goes out with the EOS
+            if (mOutputBatchFrames == 0) {
+                outHeader->nFilledLen = 0;
+            }
             outHeader->nFlags = OMX_BUFFERFLAG_EOS;
+            mOutputBatchFrames = 0;
 
             outQueue.erase(outQueue.begin());
             outInfo->mOwnedByUs = false;
@@ -456,18 +464,32 @@ void SoftOpus::onQueueFilled(OMX_U32 portIndex) {
             mSamplesToDiscard = mCodecDelay;
         }
 
+        const size_t frameBytes = sizeof(int16_t) * mHeader->channels;
+        if (mOutputBatchFrames > 0 && mSamplesToDiscard > 0) {
+            // only whole packets are appended to a batch
+            sendOutputBatch();
+            continue;
+        }
+
+        // appends to the batch collected so far, if any
+        size_t usedFrames = 0;
+        if (mOutputBatchFrames > 0) {
+            usedFrames = (outHeader->nOffset + outHeader->nFilledLen) / frameBytes;
+        }
+
         const uint8_t *data = inHeader->pBuffer + inHeader->nOffset;
         const uint32_t size = inHeader->nFilledLen;
         size_t frameSize = kMaxOpusOutputPacketSizeSamples;
-        if (frameSize > outHeader->nAllocLen / sizeof(int16_t) / mHeader->channels) {
-            frameSize = outHeader->nAllocLen / sizeof(int16_t) / mHeader->channels;
+        if (frameSize > outHeader->nAllocLen / frameBytes - usedFrames) {
+            frameSize = outHeader->nAllocLen / frameBytes - usedFrames;
             android_errorWriteLog(0x534e4554, "27833616");
         }
 
         int numFrames = opus_multistream_decode(mDecoder,
                                                 data,
                                                 size,
-                                                (int16_t *)outHeader->pBuffer,
+                                                (int16_t *)outHeader->pBuffer
+                                                        + usedFrames * mHeader->channels,
                                                 frameSize,
                                                 0);
         if (numFrames < 0) {
@@ -476,6 +498,25 @@ void SoftOpus::onQueueFilled(OMX_U32 portIndex) {
             return;
         }
 
+        if (mOutputBatchFrames > 0) {
+            outHeader->nFilledLen += numFrames * frameBytes;
+            mOutputBatchFrames += numFrames;
+            mNumFramesOutput += numFrames;
+            usedFrames += numFrames;
+
+            inInfo->mOwnedByUs = false;
+            inQueue.erase(inQueue.begin());
+            inInfo = NULL;
+            notifyEmptyBufferDone(inHeader);
+            inHeader = NULL;
+            ++mInputBufferCount;
+
+            if (isOutputBatchDone(outHeader, usedFrames, inQueue.empty())) {
+                sendOutputBatch();
+            }
+            continue;
+        }
+
         outHeader->nOffset = 0;
         if (mSamplesToDiscard > 0) {
             if (mSamplesToDiscard > numFrames) {
@@ -504,14 +545,45 @@ void SoftOpus::onQueueFilled(OMX_U32 portIndex) {
         notifyEmptyBufferDone(inHeader);
         inHeader = NULL;
 
+        ++mInputBufferCount;
+
+        if (mOutputBatchMs > 0 && numFrames > 0) {
+            mOutputBatchFrames = numFrames;
+            usedFrames = (outHeader->nOffset + outHeader->nFilledLen) / frameBytes;
+            if (!isOutputBatchDone(outHeader, usedFrames, inQueue.empty())) {
+                continue;
+            }
+        }
+
+        mOutputBatchFrames = 0;
         outInfo->mOwnedByUs = false;
         outQueue.erase(outQueue.begin());
         outInfo = NULL;
         notifyFillBufferDone(outHeader);
         outHeader = NULL;
+    }
+}
 
-        ++mInputBufferCount;
+bool SoftOpus::isOutputBatchDone(
+        const OMX_BUFFERHEADERTYPE *outHeader, size_t usedFrames, bool noMoreInput) {
+    if (noMoreInput
+            || mOutputBatchFrames >= (size_t)mOutputBatchMs * kRate / 1000) {
+        return true;
     }
+    // the next packet must fit entirely
+    size_t maxFrames = outHeader->nAllocLen / sizeof(int16_t) / mHeader->channels;
+    return maxFrames < usedFrames + kMaxOpusOutputPacketSizeSamples;
+}
+
+void SoftOpus::sendOutputBatch() {
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+    BufferInfo *outInfo = *outQueue.begin();
+    OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+    mOutputBatchFrames = 0;
+    outInfo->mOwnedByUs = false;
+    outQueue.erase(outQueue.begin());
+    notifyFillBufferDone(outHeader);
 }
 
 void SoftOpus::onPortFlushCompleted(OMX_U32 portIndex) {
@@ -519,6 +591,7 @@ void SoftOpus::onPortFlushCompleted(OMX_U32 portIndex) {
         // Make sure that the next buffer output does not still
         // depend on fragments from the last one decoded.
         mNumFramesOutput = 0;
+        mOutputBatchFrames = 0;
         opus_multistream_decoder_ctl(mDecoder, OPUS_RESET_STATE);
         mAnchorTimeUs = 0;
         mSamplesToDiscard = mSeekPreRoll;
@@ -528,6 +601,7 @@ void SoftOpus::onPortFlushCompleted(OMX_U32 portIndex) {
 void SoftOpus::onReset() {
     mInputBufferCount = 0;
     mNumFramesOutput = 0;
+    mOutputBatchFrames = 0;
     if (mDecoder != NULL) {
         opus_multistream_decoder_destroy(mDecoder);
         mDecoder = NULL;
@@ -76,6 +76,12 @@ private:
     int64_t mAnchorTimeUs;
     int64_t mNumFramesOutput;
 
+    // Decoded audio to collect into one output buffer, across input buffers,
+    // from media.swcodec.audio-batch-ms; 0 outputs every packet on its own.
+    int32_t mOutputBatchMs;
+    // frames collected so far into the output buffer at the queue's head
+    size_t mOutputBatchFrames;
+
     enum {
         NONE,
         AWAITING_DISABLED,
@@ -84,6 +90,10 @@ private:
 
     void initPorts();
     status_t initDecoder();
+
+    bool isOutputBatchDone(
+            const OMX_BUFFERHEADERTYPE *outHeader, size_t usedFrames, bool noMoreInput);
+    void sendOutputBatch();
     bool isConfigured() const;
 
     DISALLOW_EVIL_CONSTRUCTORS(SoftOpus);
@@ -14,6 +14,7 @@ LOCAL_STATIC_LIBRARIES := \
         libyuv_static \
 
 LOCAL_CFLAGS += -Werror
+LOCAL_CFLAGS_arm64 := -DNEON_INTRINSICS
 LOCAL_CLANG := true
 LOCAL_SANITIZE := signed-integer-overflow
 
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+
 //#define LOG_NDEBUG 0
 #define LOG_TAG "ColorConverter"
 #include <utils/Log.h>
@@ -24,25 +25,199 @@
 
 #include "libyuv/convert_from.h"
 
+#include <pthread.h>
+
+#ifdef NEON_INTRINSICS
+#include <arm_neon.h>
+#endif
+
 #define USE_LIBYUV
 
 namespace android {
 
+// R = Y' * mY / 256 + V' * mVR / 256
+// G = Y' * mY / 256 - U' * mUG / 256 - V' * mVG / 256
+// B = Y' * mY / 256 + U' * mUB / 256
+// with Y' = Y - mYOffset, U' = U - 128 and V' = V - 128
+struct YUVCoeffs {
+    int16_t mYOffset;
+    int16_t mY;
+    int16_t mUB;
+    int16_t mUG;
+    int16_t mVG;
+    int16_t mVR;
+};
+
+// indexed by ColorConverter::Matrix
+static const YUVCoeffs kYUVCoeffs[] = {
+    { 16, 298, 517, 100, 208, 409 },  // BT.601
+    {  0, 256, 454,  88, 183, 359 },  // BT.601 full range
+    { 16, 298, 541,  55, 136, 459 },  // BT.709
+};
+
+static inline uint8_t clip(signed x) {
+    return x < 0 ? 0 : x > 255 ? 255 : (uint8_t)x;
+}
+
+// Writes pixel i of dst.
+static inline void convertPixel(
+        const YUVCoeffs &c, OMX_COLOR_FORMATTYPE dstFormat,
+        signed y, signed u, signed v, uint8_t *dst, size_t i) {
+    signed tmp = (y - c.mYOffset) * c.mY;
+    u -= 128;
+    v -= 128;
+
+    uint8_t r = clip((tmp + v * c.mVR) / 256);
+    uint8_t g = clip((tmp - v * c.mVG - u * c.mUG) / 256);
+    uint8_t b = clip((tmp + u * c.mUB) / 256);
+
+    switch (dstFormat) {
+        case OMX_COLOR_Format16bitRGB565:
+            ((uint16_t *)dst)[i] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+            break;
+
+        case OMX_COLOR_Format32BitRGBA8888:
+            dst[4 * i] = r;
+            dst[4 * i + 1] = g;
+            dst[4 * i + 2] = b;
+            dst[4 * i + 3] = 0xff;
+            break;
+
+        default:
+            dst[4 * i] = b;
+            dst[4 * i + 1] = g;
+            dst[4 * i + 2] = r;
+            dst[4 * i + 3] = 0xff;
+            break;
+    }
+}
+
+#ifdef NEON_INTRINSICS
+// (lo, hi) / 256, clipped to 0..255
+static inline uint8x8_t clipShift8(int32x4_t lo, int32x4_t hi) {
+    return vqmovn_u16(vcombine_u16(vqshrun_n_s32(lo, 8), vqshrun_n_s32(hi, 8)));
+}
+
+// Converts 8 pixels sharing the 8 chroma terms, as in the scalar loop.
+static inline void yuvToRgbNEON(
+        uint8x8_t y, uint8x8_t yOffset, int16_t yCoeff,
+        int32x4_t rLo, int32x4_t rHi, int32x4_t gLo, int32x4_t gHi,
+        int32x4_t bLo, int32x4_t bHi,
+        uint8x8_t *r, uint8x8_t *g, uint8x8_t *b) {
+    int16x8_t y16 = vreinterpretq_s16_u16(vsubl_u8(y, yOffset));
+    int32x4_t tLo = vmull_n_s16(vget_low_s16(y16), yCoeff);
+    int32x4_t tHi = vmull_n_s16(vget_high_s16(y16), yCoeff);
+
+    *r = clipShift8(vaddq_s32(tLo, rLo), vaddq_s32(tHi, rHi));
+    *g = clipShift8(vaddq_s32(tLo, gLo), vaddq_s32(tHi, gHi));
+    *b = clipShift8(vaddq_s32(tLo, bLo), vaddq_s32(tHi, bHi));
+}
+
+// Converts as many pixels of a row as it can 16 at a time and returns
+// their number.
+static size_t convertRowNEON(
+        const YUVCoeffs &c, OMX_COLOR_FORMATTYPE dstFormat,
+        const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV, size_t uvStep,
+        size_t width, uint8_t *dst) {
+    const uint8x8_t bias = vdup_n_u8(128);
+    const uint8x8_t yOffset = vdup_n_u8(c.mYOffset);
+    const uint8x8_t alpha = vdup_n_u8(0xff);
+
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x8_t yEven, yOdd, u, v;
+        if (uvStep == 4) {
+            // U Y V Y
+            uint8x8x4_t uyvy = vld4_u8(srcU + x * 2);
+            u = uyvy.val[0];
+            yEven = uyvy.val[1];
+            v = uyvy.val[2];
+            yOdd = uyvy.val[3];
+        } else {
+            uint8x8x2_t y2 = vld2_u8(srcY + x);
+            yEven = y2.val[0];
+            yOdd = y2.val[1];
+            if (uvStep == 1) {
+                u = vld1_u8(srcU + x / 2);
+                v = vld1_u8(srcV + x / 2);
+            } else if (srcU < srcV) {
+                uint8x8x2_t uv = vld2_u8(srcU + x);
+                u = uv.val[0];
+                v = uv.val[1];
+            } else {
+                uint8x8x2_t vu = vld2_u8(srcV + x);
+                v = vu.val[0];
+                u = vu.val[1];
+            }
+        }
+
+        int16x8_t u16 = vreinterpretq_s16_u16(vsubl_u8(u, bias));
+        int16x8_t v16 = vreinterpretq_s16_u16(vsubl_u8(v, bias));
+
+        int32x4_t rLo = vmull_n_s16(vget_low_s16(v16), c.mVR);
+        int32x4_t rHi = vmull_n_s16(vget_high_s16(v16), c.mVR);
+        int32x4_t gLo = vmlal_n_s16(
+                vmull_n_s16(vget_low_s16(u16), -c.mUG), vget_low_s16(v16), -c.mVG);
+        int32x4_t gHi = vmlal_n_s16(
+                vmull_n_s16(vget_high_s16(u16), -c.mUG), vget_high_s16(v16), -c.mVG);
+        int32x4_t bLo = vmull_n_s16(vget_low_s16(u16), c.mUB);
+        int32x4_t bHi = vmull_n_s16(vget_high_s16(u16), c.mUB);
+
+        uint8x8_t rEven, gEven, bEven, rOdd, gOdd, bOdd;
+        yuvToRgbNEON(yEven, yOffset, c.mY, rLo, rHi, gLo, gHi, bLo, bHi,
+                &rEven, &gEven, &bEven);
+        yuvToRgbNEON(yOdd, yOffset, c.mY, rLo, rHi, gLo, gHi, bLo, bHi,
+                &rOdd, &gOdd, &bOdd);
+
+        // back to pixel order, 8 pixels in each half
+        uint8x8x2_t r = vzip_u8(rEven, rOdd);
+        uint8x8x2_t g = vzip_u8(gEven, gOdd);
+        uint8x8x2_t b = vzip_u8(bEven, bOdd);
+
+        for (int h = 0; h < 2; ++h) {
+            if (dstFormat == OMX_COLOR_Format16bitRGB565) {
+                uint16x8_t rgb = vshll_n_u8(r.val[h], 8);
+                rgb = vsriq_n_u16(rgb, vshll_n_u8(g.val[h], 8), 5);
+                rgb = vsriq_n_u16(rgb, vshll_n_u8(b.val[h], 8), 11);
+                vst1q_u16((uint16_t *)dst + x + 8 * h, rgb);
+            } else {
+                uint8x8x4_t rgba;
+                if (dstFormat == OMX_COLOR_Format32BitRGBA8888) {
+                    rgba.val[0] = r.val[h];
+                    rgba.val[2] = b.val[h];
+                } else {
+                    rgba.val[0] = b.val[h];
+                    rgba.val[2] = r.val[h];
+                }
+                rgba.val[1] = g.val[h];
+                rgba.val[3] = alpha;
+                vst4_u8(dst + (x + 8 * h) * 4, rgba);
+            }
+        }
+    }
+    return x;
+}
+#endif
+
 ColorConverter::ColorConverter(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
       mDstFormat(to),
-      mClip(NULL) {
+      mMatrix(MATRIX_BT601) {
 }
 
 ColorConverter::~ColorConverter() {
-    delete[] mClip;
-    mClip = NULL;
 }
 
 bool ColorConverter::isValid() const {
-    if (mDstFormat != OMX_COLOR_Format16bitRGB565) {
-        return false;
+    switch (mDstFormat) {
+        case OMX_COLOR_Format16bitRGB565:
+        case OMX_COLOR_Format32BitRGBA8888:
+        case OMX_COLOR_Format32bitBGRA8888:
+            break;
+
+        default:
+            return false;
     }
 
     switch (mSrcFormat) {
@@ -58,6 +233,15 @@ bool ColorConverter::isValid() const {
     }
 }
 
+void ColorConverter::setMatrix(Matrix matrix) {
+    CHECK_LT((size_t)matrix, sizeof(kYUVCoeffs) / sizeof(kYUVCoeffs[0]));
+    mMatrix = matrix;
+}
+
+size_t ColorConverter::dstBytesPerPixel() const {
+    return mDstFormat == OMX_COLOR_Format16bitRGB565 ? 2 : 4;
+}
+
 ColorConverter::BitmapParams::BitmapParams(
         void *bits,
         size_t width, size_t height,
@@ -89,7 +273,7 @@ status_t ColorConverter::convert(
         size_t dstWidth, size_t dstHeight,
         size_t dstCropLeft, size_t dstCropTop,
         size_t dstCropRight, size_t dstCropBottom) {
-    if (mDstFormat != OMX_COLOR_Format16bitRGB565) {
+    if (!isValid()) {
         return ERROR_UNSUPPORTED;
     }
 
@@ -103,458 +287,245 @@ status_t ColorConverter::convert(
             dstWidth, dstHeight,
             dstCropLeft, dstCropTop, dstCropRight, dstCropBottom);
 
-    status_t err;
-
-    switch (mSrcFormat) {
-        case OMX_COLOR_FormatYUV420Planar:
-#ifdef USE_LIBYUV
-            err = convertYUV420PlanarUseLibYUV(src, dst);
-#else
-            err = convertYUV420Planar(src, dst);
-#endif
-            break;
-
-        case OMX_COLOR_FormatCbYCrY:
-            err = convertCbYCrY(src, dst);
-            break;
-
-        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
-            err = convertQCOMYUV420SemiPlanar(src, dst);
-            break;
-
-        case OMX_COLOR_FormatYUV420SemiPlanar:
-            err = convertYUV420SemiPlanar(src, dst);
-            break;
-
-        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
-            err = convertTIYUV420PackedSemiPlanar(src, dst);
-            break;
-
-        default:
-        {
-            CHECK(!"Should not be here. Unknown color conversion.");
-            break;
-        }
-    }
-
-    return err;
-}
-
-status_t ColorConverter::convertCbYCrY(
-        const BitmapParams &src, const BitmapParams &dst) {
-    // XXX Untested
-
-    uint8_t *kAdjustedClip = initClip();
-
     if (!((src.mCropLeft & 1) == 0
-        && src.cropWidth() == dst.cropWidth()
-        && src.cropHeight() == dst.cropHeight())) {
+            && src.cropWidth() == dst.cropWidth()
+            && src.cropHeight() == dst.cropHeight())) {
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+#ifdef USE_LIBYUV
+    if (mSrcFormat == OMX_COLOR_FormatYUV420Planar
+            && mDstFormat == OMX_COLOR_Format16bitRGB565 && mMatrix == MATRIX_BT601) {
+        return convertYUV420PlanarUseLibYUV(src, dst);
+    }
+#endif
 
-    const uint8_t *src_ptr = (const uint8_t *)src.mBits
-        + (src.mCropTop * dst.mWidth + src.mCropLeft) * 2;
+    size_t bpp = dstBytesPerPixel();
+    uint8_t *dst_ptr = (uint8_t *)dst.mBits
+        + (dst.mCropTop * dst.mWidth + dst.mCropLeft) * bpp;
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_ptr[2 * x + 1] - 16;
-            signed y2 = (signed)src_ptr[2 * x + 3] - 16;
-            signed u = (signed)src_ptr[2 * x] - 128;
-            signed v = (signed)src_ptr[2 * x + 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+        SourceRow row;
+        getSourceRow(src, y, &row);
+        convertRow(row.mY, row.mYStep, row.mU, row.mV, row.mUVStep, src.cropWidth(), dst_ptr);
 
-        src_ptr += src.mWidth * 2;
-        dst_ptr += dst.mWidth;
+        dst_ptr += dst.mWidth * bpp;
     }
 
     return OK;
 }
 
-status_t ColorConverter::convertYUV420PlanarUseLibYUV(
-        const BitmapParams &src, const BitmapParams &dst) {
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
+status_t ColorConverter::convertScaled(
+        const void *srcBits,
+        size_t srcWidth, size_t srcHeight,
+        size_t srcCropLeft, size_t srcCropTop,
+        size_t srcCropRight, size_t srcCropBottom,
+        void *dstBits, size_t dstWidth, size_t dstHeight,
+        size_t numThreads) {
+    if (!isValid()) {
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
-    const uint8_t *src_y =
-        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
-
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * (src.mWidth / 2) + src.mCropLeft / 2;
-
-    const uint8_t *src_v =
-        src_u + (src.mWidth / 2) * (src.mHeight / 2);
-
-
-    libyuv::I420ToRGB565(src_y, src.mWidth, src_u, src.mWidth / 2, src_v, src.mWidth / 2,
-            (uint8 *)dst_ptr, dst.mWidth * 2, dst.mWidth, dst.mHeight);
-
-    return OK;
-}
+    BitmapParams src(
+            const_cast<void *>(srcBits),
+            srcWidth, srcHeight,
+            srcCropLeft, srcCropTop, srcCropRight, srcCropBottom);
 
-status_t ColorConverter::convertYUV420Planar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
+    if ((src.mCropLeft & 1) != 0 || dstWidth == 0 || dstHeight == 0
+            || dstWidth > src.cropWidth() || dstHeight > src.cropHeight()) {
         return ERROR_UNSUPPORTED;
     }
 
-    uint8_t *kAdjustedClip = initClip();
-
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
-    const uint8_t *src_y =
-        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
-
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * (src.mWidth / 2) + src.mCropLeft / 2;
-
-    const uint8_t *src_v =
-        src_u + (src.mWidth / 2) * (src.mHeight / 2);
+    size_t *srcX = new size_t[dstWidth];
+    for (size_t x = 0; x < dstWidth; ++x) {
+        // centre of the source pixels covered by destination column x
+        srcX[x] = (2 * x + 1) * src.cropWidth() / (2 * dstWidth);
+    }
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
-            // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
-            // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
-
-            // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
-            // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
-            // R = .................. + 409/256 * (V - 128)
-
-            // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
-            // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
-            // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
-
-            // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
-            // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
-            // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
-
-            // clip range -278 .. 535
-
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x / 2] - 128;
-            signed v = (signed)src_v[x / 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    if (numThreads < 1) {
+        numThreads = 1;
+    } else if (numThreads > dstHeight) {
+        numThreads = dstHeight;
+    }
 
-        src_y += src.mWidth;
+    Band *bands = new Band[numThreads];
+    pthread_t *threads = new pthread_t[numThreads];
+    bool *started = new bool[numThreads];
+    for (size_t i = 0; i < numThreads; ++i) {
+        Band &band = bands[i];
+        band.mConverter = this;
+        band.mSrc = &src;
+        band.mSrcX = srcX;
+        band.mDst = (uint8_t *)dstBits;
+        band.mDstWidth = dstWidth;
+        band.mDstHeight = dstHeight;
+        band.mStartRow = dstHeight * i / numThreads;
+        band.mEndRow = dstHeight * (i + 1) / numThreads;
+
+        // the calling thread converts the first band itself
+        started[i] = i > 0 && pthread_create(&threads[i], NULL, BandThread, &band) == 0;
+    }
 
-        if (y & 1) {
-            src_u += src.mWidth / 2;
-            src_v += src.mWidth / 2;
+    convertBand(bands[0]);
+    for (size_t i = 1; i < numThreads; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            convertBand(bands[i]);
         }
-
-        dst_ptr += dst.mWidth;
     }
 
+    delete[] started;
+    delete[] threads;
+    delete[] bands;
+    delete[] srcX;
+
     return OK;
 }
 
-status_t ColorConverter::convertQCOMYUV420SemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
+// static
+void *ColorConverter::BandThread(void *band) {
+    const Band *me = static_cast<const Band *>(band);
+    me->mConverter->convertBand(*me);
+    return NULL;
+}
 
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
+void ColorConverter::convertBand(const Band &band) const {
+    const BitmapParams &src = *band.mSrc;
+    size_t bpp = dstBytesPerPixel();
+    bool sameWidth = band.mDstWidth == src.cropWidth();
+
+    for (size_t y = band.mStartRow; y < band.mEndRow; ++y) {
+        SourceRow row;
+        getSourceRow(src, (2 * y + 1) * src.cropHeight() / (2 * band.mDstHeight), &row);
+
+        uint8_t *dst_ptr = band.mDst + y * band.mDstWidth * bpp;
+        if (sameWidth) {
+            convertRow(row.mY, row.mYStep, row.mU, row.mV, row.mUVStep,
+                    band.mDstWidth, dst_ptr);
+        } else {
+            convertRowSampled(row, band.mSrcX, band.mDstWidth, dst_ptr);
+        }
     }
+}
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+void ColorConverter::getSourceRow(
+        const BitmapParams &src, size_t row, SourceRow *out) const {
+    const uint8_t *bits = (const uint8_t *)src.mBits;
+    size_t y = src.mCropTop + row;
 
-    const uint8_t *src_y =
-        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    switch (mSrcFormat) {
+        case OMX_COLOR_FormatYUV420Planar:
+        {
+            out->mY = bits + y * src.mWidth + src.mCropLeft;
+            out->mU = bits + src.mWidth * src.mHeight
+                + (y / 2) * (src.mWidth / 2) + src.mCropLeft / 2;
+            out->mV = out->mU + (src.mWidth / 2) * (src.mHeight / 2);
+            out->mYStep = 1;
+            out->mUVStep = 1;
+            break;
+        }
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * src.mWidth + src.mCropLeft;
+        case OMX_COLOR_FormatCbYCrY:
+        {
+            // U Y V Y ...
+            const uint8_t *base = bits + (y * src.mWidth + src.mCropLeft) * 2;
+            out->mY = base + 1;
+            out->mU = base;
+            out->mV = base + 2;
+            out->mYStep = 2;
+            out->mUVStep = 4;
+            break;
+        }
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+        {
+            out->mY = bits + y * src.mWidth + src.mCropLeft;
+            const uint8_t *uv = bits + src.mWidth * src.mHeight
+                + (y / 2) * src.mWidth + src.mCropLeft;
+            if (mSrcFormat == OMX_QCOM_COLOR_FormatYVU420SemiPlanar) {
+                // V U V U ...
+                out->mU = uv + 1;
+                out->mV = uv;
             } else {
-                dst_ptr[x] = rgb1;
+                // U V U V ...
+                out->mU = uv;
+                out->mV = uv + 1;
             }
+            out->mYStep = 1;
+            out->mUVStep = 2;
+            break;
         }
 
-        src_y += src.mWidth;
-
-        if (y & 1) {
-            src_u += src.mWidth;
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+        {
+            // the crop is already applied to the planes
+            out->mY = bits + row * src.mWidth;
+            out->mU = bits + src.mWidth * (src.mHeight - src.mCropTop / 2)
+                + (row / 2) * src.mWidth;
+            out->mV = out->mU + 1;
+            out->mYStep = 1;
+            out->mUVStep = 2;
+            break;
         }
 
-        dst_ptr += dst.mWidth;
+        default:
+            TRESPASS();
     }
-
-    return OK;
 }
 
-status_t ColorConverter::convertYUV420SemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    // XXX Untested
-
-    uint8_t *kAdjustedClip = initClip();
-
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
-
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+void ColorConverter::convertRow(
+        const uint8_t *srcY, size_t yStep,
+        const uint8_t *srcU, const uint8_t *srcV, size_t uvStep,
+        size_t width, uint8_t *dst) const {
+    const YUVCoeffs &c = kYUVCoeffs[mMatrix];
 
-    const uint8_t *src_y =
-        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
-
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
-        + src.mCropTop * src.mWidth + src.mCropLeft;
-
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed v = (signed)src_u[x & ~1] - 128;
-            signed u = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    size_t x = 0;
+#ifdef NEON_INTRINSICS
+    x = convertRowNEON(c, mDstFormat, srcY, srcU, srcV, uvStep, width, dst);
+#endif
 
-        src_y += src.mWidth;
+    for (; x < width; x += 2) {
+        signed u = srcU[x / 2 * uvStep];
+        signed v = srcV[x / 2 * uvStep];
 
-        if (y & 1) {
-            src_u += src.mWidth;
+        for (size_t i = x; i < x + 2 && i < width; ++i) {
+            convertPixel(c, mDstFormat, srcY[i * yStep], u, v, dst, i);
         }
-
-        dst_ptr += dst.mWidth;
     }
-
-    return OK;
 }
 
-status_t ColorConverter::convertTIYUV420PackedSemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
+void ColorConverter::convertRowSampled(
+        const SourceRow &row, const size_t *srcX, size_t width, uint8_t *dst) const {
+    const YUVCoeffs &c = kYUVCoeffs[mMatrix];
 
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
+    for (size_t i = 0; i < width; ++i) {
+        size_t x = srcX[i];
+        convertPixel(c, mDstFormat, row.mY[x * row.mYStep],
+                row.mU[x / 2 * row.mUVStep], row.mV[x / 2 * row.mUVStep], dst, i);
     }
+}
 
+status_t ColorConverter::convertYUV420PlanarUseLibYUV(
+        const BitmapParams &src, const BitmapParams &dst) {
     uint16_t *dst_ptr = (uint16_t *)dst.mBits
         + dst.mCropTop * dst.mWidth + dst.mCropLeft;
 
-    const uint8_t *src_y = (const uint8_t *)src.mBits;
+    const uint8_t *src_y =
+        (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
 
     const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * (src.mHeight - src.mCropTop / 2);
-
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+        (const uint8_t *)src.mBits + src.mWidth * src.mHeight
+        + (src.mCropTop / 2) * (src.mWidth / 2) + src.mCropLeft / 2;
 
-        src_y += src.mWidth;
-
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
+    const uint8_t *src_v =
+        src_u + (src.mWidth / 2) * (src.mHeight / 2);
 
-        dst_ptr += dst.mWidth;
-    }
+    libyuv::I420ToRGB565(src_y, src.mWidth, src_u, src.mWidth / 2, src_v, src.mWidth / 2,
+            (uint8 *)dst_ptr, dst.mWidth * 2, src.cropWidth(), src.cropHeight());
 
     return OK;
 }
 
-uint8_t *ColorConverter::initClip() {
-    static const signed kClipMin = -278;
-    static const signed kClipMax = 535;
-
-    if (mClip == NULL) {
-        mClip = new uint8_t[kClipMax - kClipMin + 1];
-
-        for (signed i = kClipMin; i <= kClipMax; ++i) {
-            mClip[i - kClipMin] = (i < 0) ? 0 : (i > 255) ? 255 : (uint8_t)i;
-        }
-    }
-
-    return &mClip[-kClipMin];
-}
-
 }  // namespace android
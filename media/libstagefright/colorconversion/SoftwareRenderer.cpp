@@ -21,11 +21,18 @@
 
 #include <cutils/properties.h> // for property_get
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <system/window.h>
 #include <ui/GraphicBufferMapper.h>
 #include <gui/IGraphicBufferProducer.h>
 
+#include <inttypes.h>
+
+#ifdef NEON_INTRINSICS
+#include <arm_neon.h>
+#endif
+
 namespace android {
 
 static bool runningInEmulator() {
@@ -38,6 +45,53 @@ static int ALIGN(int x, int y) {
     return (x + y - 1) & ~(y - 1);
 }
 
+static bool isYUV420(OMX_COLOR_FORMATTYPE colorFormat) {
+    switch (colorFormat) {
+        case OMX_COLOR_FormatYUV420Planar:
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Copies width bytes of each of height rows, in one go when the strides
+// match.
+static void copyPlane(
+        uint8_t *dst, size_t dstStride, const uint8_t *src, size_t srcStride,
+        size_t width, size_t height) {
+    if (height == 0) {
+        return;
+    }
+    if (dstStride == srcStride) {
+        memcpy(dst, src, dstStride * (height - 1) + width);
+        return;
+    }
+    for (size_t y = 0; y < height; ++y) {
+        memcpy(dst, src, width);
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+// Splits n interleaved sample pairs into dst0 and dst1.
+static void splitRow(const uint8_t *src, uint8_t *dst0, uint8_t *dst1, size_t n) {
+    size_t x = 0;
+#ifdef NEON_INTRINSICS
+    for (; x + 16 <= n; x += 16) {
+        uint8x16x2_t pairs = vld2q_u8(src + 2 * x);
+        vst1q_u8(dst0 + x, pairs.val[0]);
+        vst1q_u8(dst1 + x, pairs.val[1]);
+    }
+#endif
+    for (; x < n; ++x) {
+        dst0[x] = src[2 * x];
+        dst1[x] = src[2 * x + 1];
+    }
+}
+
 SoftwareRenderer::SoftwareRenderer(
         const sp<ANativeWindow> &nativeWindow, int32_t rotation)
     : mColorFormat(OMX_COLOR_FormatUnused),
@@ -52,10 +106,19 @@ SoftwareRenderer::SoftwareRenderer(
       mCropBottom(0),
       mCropWidth(0),
       mCropHeight(0),
-      mRotationDegrees(rotation) {
+      mRotationDegrees(rotation),
+      mNumFramesRendered(0),
+      mTotalRenderTimeUs(0),
+      mMaxRenderTimeUs(0) {
 }
 
 SoftwareRenderer::~SoftwareRenderer() {
+    if (mNumFramesRendered > 0) {
+        ALOGI("rendered %d frames, render time avg %" PRId64 " us max %" PRId64 " us",
+                mNumFramesRendered, mTotalRenderTimeUs / mNumFramesRendered,
+                mMaxRenderTimeUs);
+    }
+
     delete mConverter;
     mConverter = NULL;
 }
@@ -105,14 +168,27 @@ void SoftwareRenderer::resetFormatIfChanged(const sp<AMessage> &format) {
     size_t bufWidth = mCropWidth;
     size_t bufHeight = mCropHeight;
 
-    // hardware has YUV12 and RGBA8888 support, so convert known formats
+    delete mConverter;
+    mConverter = NULL;
+    mYUVMode = None;
+
+    // hardware has YUV12 and RGBA8888 support, so convert known formats.
+    // Windows that take flexible YUV can be asked for it with
+    // media.swrenderer.flex-yuv, which keeps semi-planar chroma interleaved.
     if (!runningInEmulator()) {
         switch (mColorFormat) {
             case OMX_COLOR_FormatYUV420Planar:
             case OMX_COLOR_FormatYUV420SemiPlanar:
+            case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
             case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
             {
-                halFormat = HAL_PIXEL_FORMAT_YV12;
+                if (property_get_bool("media.swrenderer.flex-yuv", false)) {
+                    halFormat = HAL_PIXEL_FORMAT_YCbCr_420_888;
+                    mYUVMode = FlexibleYUV;
+                } else {
+                    halFormat = HAL_PIXEL_FORMAT_YV12;
+                    mYUVMode = YV12;
+                }
                 bufWidth = (mCropWidth + 1) & ~1;
                 bufHeight = (mCropHeight + 1) & ~1;
                 break;
@@ -198,6 +274,87 @@ void SoftwareRenderer::resetFormatIfChanged(const sp<AMessage> &format) {
                 mNativeWindow.get(), transform));
 }
 
+bool SoftwareRenderer::copyYUV(const void *data, size_t size, const android_ycbcr &dst) {
+    if ((size_t)mWidth * mHeight * 3 / 2 > size) {
+        return false;
+    }
+
+    const uint8_t *src_y = (const uint8_t *)data;
+    const uint8_t *src_u, *src_v;
+    size_t src_c_stride, src_c_step;
+    switch (mColorFormat) {
+        case OMX_COLOR_FormatYUV420Planar:
+            src_u = src_y + mWidth * mHeight;
+            src_v = src_u + (mWidth / 2 * mHeight / 2);
+            src_c_stride = mWidth / 2;
+            src_c_step = 1;
+            break;
+
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+            src_v = src_y + mWidth * mHeight;
+            src_u = src_v + 1;
+            src_c_stride = mWidth;
+            src_c_step = 2;
+            break;
+
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+            src_u = src_y + mWidth * (mHeight - mCropTop / 2);
+            src_v = src_u + 1;
+            src_c_stride = mWidth;
+            src_c_step = 2;
+            break;
+
+        default:
+            src_u = src_y + mWidth * mHeight;
+            src_v = src_u + 1;
+            src_c_stride = mWidth;
+            src_c_step = 2;
+            break;
+    }
+
+    copyPlane((uint8_t *)dst.y, dst.ystride, src_y, mWidth, mCropWidth, mCropHeight);
+
+    uint8_t *dst_u = (uint8_t *)dst.cb;
+    uint8_t *dst_v = (uint8_t *)dst.cr;
+    size_t width = (mCropWidth + 1) / 2;
+    size_t height = (mCropHeight + 1) / 2;
+
+    if (src_c_step == dst.chroma_step && dst_v - dst_u == src_v - src_u) {
+        // same chroma layout, e.g. NV12 into NV12
+        if (src_c_step == 1) {
+            copyPlane(dst_u, dst.cstride, src_u, src_c_stride, width, height);
+            copyPlane(dst_v, dst.cstride, src_v, src_c_stride, width, height);
+        } else {
+            copyPlane(dst_u < dst_v ? dst_u : dst_v, dst.cstride,
+                    src_u < src_v ? src_u : src_v, src_c_stride, 2 * width, height);
+        }
+    } else if (src_c_step == 2 && dst.chroma_step == 1) {
+        for (size_t y = 0; y < height; ++y) {
+            if (src_v == src_u + 1) {
+                splitRow(src_u, dst_u, dst_v, width);
+            } else {
+                splitRow(src_v, dst_v, dst_u, width);
+            }
+            src_u += src_c_stride;
+            src_v += src_c_stride;
+            dst_u += dst.cstride;
+            dst_v += dst.cstride;
+        }
+    } else {
+        for (size_t y = 0; y < height; ++y) {
+            for (size_t x = 0; x < width; ++x) {
+                dst_u[x * dst.chroma_step] = src_u[x * src_c_step];
+                dst_v[x * dst.chroma_step] = src_v[x * src_c_step];
+            }
+            src_u += src_c_stride;
+            src_v += src_c_stride;
+            dst_u += dst.cstride;
+            dst_v += dst.cstride;
+        }
+    }
+    return true;
+}
+
 void SoftwareRenderer::clearTracker() {
     mRenderTracker.clear(-1 /* lastRenderTimeNs */);
 }
@@ -226,6 +383,15 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
     GraphicBufferMapper &mapper = GraphicBufferMapper::get();
 
     Rect bounds(mCropWidth, mCropHeight);
+    int64_t startUs = ALooper::GetNowUs();
+
+    if (mYUVMode == FlexibleYUV) {
+        android_ycbcr ycbcr;
+        CHECK_EQ(0, mapper.lockYCbCr(
+                    buf->handle, GRALLOC_USAGE_SW_WRITE_OFTEN, bounds, &ycbcr));
+        copyYUV(data, size, ycbcr);
+        goto skip_copying;
+    }
 
     void *dst;
     CHECK_EQ(0, mapper.lock(
@@ -241,73 +407,15 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
                 dst,
                 buf->stride, buf->height,
                 0, 0, mCropWidth - 1, mCropHeight - 1);
-    } else if (mColorFormat == OMX_COLOR_FormatYUV420Planar) {
-        if ((size_t)mWidth * mHeight * 3 / 2 > size) {
-            goto skip_copying;
-        }
-        const uint8_t *src_y = (const uint8_t *)data;
-        const uint8_t *src_u =
-                (const uint8_t *)data + mWidth * mHeight;
-        const uint8_t *src_v = src_u + (mWidth / 2 * mHeight / 2);
-
-        uint8_t *dst_y = (uint8_t *)dst;
-        size_t dst_y_size = buf->stride * buf->height;
-        size_t dst_c_stride = ALIGN(buf->stride / 2, 16);
-        size_t dst_c_size = dst_c_stride * buf->height / 2;
-        uint8_t *dst_v = dst_y + dst_y_size;
-        uint8_t *dst_u = dst_v + dst_c_size;
-
-        for (int y = 0; y < mCropHeight; ++y) {
-            memcpy(dst_y, src_y, mCropWidth);
-
-            src_y += mWidth;
-            dst_y += buf->stride;
-        }
-
-        for (int y = 0; y < (mCropHeight + 1) / 2; ++y) {
-            memcpy(dst_u, src_u, (mCropWidth + 1) / 2);
-            memcpy(dst_v, src_v, (mCropWidth + 1) / 2);
-
-            src_u += mWidth / 2;
-            src_v += mWidth / 2;
-            dst_u += dst_c_stride;
-            dst_v += dst_c_stride;
-        }
-    } else if (mColorFormat == OMX_TI_COLOR_FormatYUV420PackedSemiPlanar
-            || mColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) {
-        if ((size_t)mWidth * mHeight * 3 / 2 > size) {
-            goto skip_copying;
-        }
-        const uint8_t *src_y = (const uint8_t *)data;
-        const uint8_t *src_uv = (const uint8_t *)data
-                + mWidth * (mHeight - mCropTop / 2);
-
-        uint8_t *dst_y = (uint8_t *)dst;
-
-        size_t dst_y_size = buf->stride * buf->height;
-        size_t dst_c_stride = ALIGN(buf->stride / 2, 16);
-        size_t dst_c_size = dst_c_stride * buf->height / 2;
-        uint8_t *dst_v = dst_y + dst_y_size;
-        uint8_t *dst_u = dst_v + dst_c_size;
-
-        for (int y = 0; y < mCropHeight; ++y) {
-            memcpy(dst_y, src_y, mCropWidth);
-
-            src_y += mWidth;
-            dst_y += buf->stride;
-        }
-
-        for (int y = 0; y < (mCropHeight + 1) / 2; ++y) {
-            size_t tmp = (mCropWidth + 1) / 2;
-            for (size_t x = 0; x < tmp; ++x) {
-                dst_u[x] = src_uv[2 * x];
-                dst_v[x] = src_uv[2 * x + 1];
-            }
-
-            src_uv += mWidth;
-            dst_u += dst_c_stride;
-            dst_v += dst_c_stride;
-        }
+    } else if (mYUVMode == YV12) {
+        android_ycbcr ycbcr;
+        ycbcr.y = dst;
+        ycbcr.ystride = buf->stride;
+        ycbcr.cstride = ALIGN(buf->stride / 2, 16);
+        ycbcr.cr = (uint8_t *)dst + buf->stride * buf->height;
+        ycbcr.cb = (uint8_t *)ycbcr.cr + ycbcr.cstride * buf->height / 2;
+        ycbcr.chroma_step = 1;
+        copyYUV(data, size, ycbcr);
     } else if (mColorFormat == OMX_COLOR_Format24bitRGB888) {
         if ((size_t)mWidth * mHeight * 3 > size) {
             goto skip_copying;
@@ -356,6 +464,14 @@ std::list<FrameRenderTracker::Info> SoftwareRenderer::render(
 skip_copying:
     CHECK_EQ(0, mapper.unlock(buf->handle));
 
+    int64_t renderTimeUs = ALooper::GetNowUs() - startUs;
+    ALOGV("filled buffer in %lld us", (long long)renderTimeUs);
+    ++mNumFramesRendered;
+    mTotalRenderTimeUs += renderTimeUs;
+    if (renderTimeUs > mMaxRenderTimeUs) {
+        mMaxRenderTimeUs = renderTimeUs;
+    }
+
     if (renderTimeNs >= 0) {
         if ((err = native_window_set_buffers_timestamp(mNativeWindow.get(),
                 renderTimeNs)) != 0) {
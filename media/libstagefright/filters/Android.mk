@@ -3,10 +3,12 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
         ColorConvert.cpp          \
+        FilterChain.cpp           \
         GraphicBufferListener.cpp \
         IntrinsicBlurFilter.cpp   \
         MediaFilter.cpp           \
         RSFilter.cpp              \
+        RSStageFilter.cpp         \
         SaturationFilter.cpp      \
         saturationARGB.rs         \
         SimpleFilter.cpp          \
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FilterChain"
+
+#include <utils/Log.h>
+
+#include <strings.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+#include "FilterChain.h"
+#include "IntrinsicBlurFilter.h"
+#include "SaturationFilter.h"
+
+namespace android {
+
+static sp<RSStageFilter> createStage(const AString &name) {
+    if (!strcasecmp(name.c_str(), "saturation")) {
+        return new SaturationFilter;
+    } else if (!strcasecmp(name.c_str(), "intrinsicblur")) {
+        return new IntrinsicBlurFilter;
+    }
+    return NULL;
+}
+
+status_t FilterChain::configure(const sp<AMessage> &msg) {
+    status_t err = SimpleFilter::configure(msg);
+    if (err != OK) {
+        return err;
+    }
+
+    if (!msg->findString("cacheDir", &mCacheDir)) {
+        ALOGE("Failed to find cache directory in config message.");
+        return NAME_NOT_FOUND;
+    }
+
+    AString filters;
+    if (!msg->findString("filters", &filters)) {
+        ALOGE("Failed to find filters in config message.");
+        return NAME_NOT_FOUND;
+    }
+
+    mStages.clear();
+    size_t start = 0;
+    while (start <= filters.size()) {
+        ssize_t end = filters.find(",", start);
+        if (end < 0) {
+            end = filters.size();
+        }
+
+        AString name(filters, start, end - start);
+        name.trim();
+
+        sp<RSStageFilter> stage = createStage(name);
+        if (stage == NULL) {
+            ALOGE("Unrecognized filter in chain: '%s'", name.c_str());
+            mStages.clear();
+            return BAD_VALUE;
+        }
+
+        err = stage->configure(msg);
+        if (err != OK) {
+            mStages.clear();
+            return err;
+        }
+        mStages.push_back(stage);
+
+        start = end + 1;
+    }
+
+    ALOGV("chaining %zu filters: %s", mStages.size(), filters.c_str());
+    return OK;
+}
+
+status_t FilterChain::start() {
+    mRS = new RSC::RS();
+
+    if (!mRS->init(mCacheDir.c_str())) {
+        ALOGE("Failed to initialize RenderScript context.");
+        return NO_INIT;
+    }
+
+    // 32-bit elements for ARGB8888
+    RSC::sp<const RSC::Element> e = RSC::Element::U8_4(mRS);
+
+    RSC::Type::Builder tb(mRS, e);
+    tb.setX(mWidth);
+    tb.setY(mHeight);
+    RSC::sp<const RSC::Type> t = tb.create();
+
+    mAlloc[0] = RSC::Allocation::createTyped(mRS, t);
+    mAlloc[1] = RSC::Allocation::createTyped(mRS, t);
+
+    for (size_t i = 0; i < mStages.size(); ++i) {
+        status_t err = mStages[i]->startStage(mRS);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    return OK;
+}
+
+void FilterChain::reset() {
+    for (size_t i = 0; i < mStages.size(); ++i) {
+        mStages[i]->reset();
+    }
+    mAlloc[1].clear();
+    mAlloc[0].clear();
+    mRS.clear();
+}
+
+status_t FilterChain::setParameters(const sp<AMessage> &msg) {
+    for (size_t i = 0; i < mStages.size(); ++i) {
+        status_t err = mStages[i]->setParameters(msg);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    return OK;
+}
+
+status_t FilterChain::processBuffers(
+        const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer) {
+    mAlloc[0]->copy1DRangeFrom(0, mWidth * mHeight, srcBuffer->data());
+
+    size_t current = 0;
+    for (size_t i = 0; i < mStages.size(); ++i) {
+        status_t err = mStages[i]->processAllocations(
+                mAlloc[current], mAlloc[current ^ 1]);
+        if (err != OK) {
+            return err;
+        }
+        current ^= 1;
+    }
+
+    mAlloc[current]->copy1DRangeTo(0, mWidth * mHeight, outBuffer->data());
+
+    return OK;
+}
+
+}   // namespace android
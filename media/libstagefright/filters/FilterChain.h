@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FILTER_CHAIN_H_
+#define FILTER_CHAIN_H_
+
+#include <media/stagefright/foundation/AString.h>
+#include <RenderScript.h>
+#include <utils/Vector.h>
+
+#include "RSStageFilter.h"
+
+namespace android {
+
+// Runs the RenderScript filters named by the comma separated "filters"
+// config entry, e.g. "saturation,intrinsicblur", one after the other on a
+// single context.  Frames are copied into RenderScript memory once and out
+// once; in between the stages ping-pong between two allocations.
+// Parameters are passed to every stage.
+struct FilterChain : public SimpleFilter {
+public:
+    FilterChain() {};
+
+    virtual status_t configure(const sp<AMessage> &msg);
+    virtual status_t start();
+    virtual void reset();
+    virtual status_t setParameters(const sp<AMessage> &msg);
+    virtual status_t processBuffers(
+            const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer);
+
+protected:
+    virtual ~FilterChain() {};
+
+private:
+    AString mCacheDir;
+    Vector<sp<RSStageFilter> > mStages;
+    RSC::sp<RSC::RS> mRS;
+    RSC::sp<RSC::Allocation> mAlloc[2];
+};
+
+}   // namespace android
+
+#endif  // FILTER_CHAIN_H_
@@ -27,52 +27,18 @@
 
 namespace android {
 
-status_t IntrinsicBlurFilter::configure(const sp<AMessage> &msg) {
-    status_t err = SimpleFilter::configure(msg);
-    if (err != OK) {
-        return err;
-    }
-
-    if (!msg->findString("cacheDir", &mCacheDir)) {
-        ALOGE("Failed to find cache directory in config message.");
-        return NAME_NOT_FOUND;
-    }
-
-    return OK;
-}
-
-status_t IntrinsicBlurFilter::start() {
-    // TODO: use a single RS context object for entire application
-    mRS = new RSC::RS();
-
-    if (!mRS->init(mCacheDir.c_str())) {
-        ALOGE("Failed to initialize RenderScript context.");
-        return NO_INIT;
-    }
-
+status_t IntrinsicBlurFilter::onStart() {
     // 32-bit elements for ARGB8888
     RSC::sp<const RSC::Element> e = RSC::Element::U8_4(mRS);
 
-    RSC::Type::Builder tb(mRS, e);
-    tb.setX(mWidth);
-    tb.setY(mHeight);
-    RSC::sp<const RSC::Type> t = tb.create();
-
-    mAllocIn = RSC::Allocation::createTyped(mRS, t);
-    mAllocOut = RSC::Allocation::createTyped(mRS, t);
-
     mBlur = RSC::ScriptIntrinsicBlur::create(mRS, e);
     mBlur->setRadius(mBlurRadius);
-    mBlur->setInput(mAllocIn);
 
     return OK;
 }
 
-void IntrinsicBlurFilter::reset() {
+void IntrinsicBlurFilter::onReset() {
     mBlur.clear();
-    mAllocOut.clear();
-    mAllocIn.clear();
-    mRS.clear();
 }
 
 status_t IntrinsicBlurFilter::setParameters(const sp<AMessage> &msg) {
@@ -82,16 +48,19 @@ status_t IntrinsicBlurFilter::setParameters(const sp<AMessage> &msg) {
     float blurRadius;
     if (params->findFloat("blur-radius", &blurRadius)) {
         mBlurRadius = blurRadius;
+        if (mBlur != NULL) {
+            mBlur->setRadius(mBlurRadius);
+        }
     }
 
     return OK;
 }
 
-status_t IntrinsicBlurFilter::processBuffers(
-        const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer) {
-    mAllocIn->copy1DRangeFrom(0, mWidth * mHeight, srcBuffer->data());
-    mBlur->forEach(mAllocOut);
-    mAllocOut->copy1DRangeTo(0, mWidth * mHeight, outBuffer->data());
+status_t IntrinsicBlurFilter::processAllocations(
+        const RSC::sp<RSC::Allocation> &in,
+        const RSC::sp<RSC::Allocation> &out) {
+    mBlur->setInput(in);
+    mBlur->forEach(out);
 
     return OK;
 }
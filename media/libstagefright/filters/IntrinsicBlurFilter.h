@@ -17,30 +17,26 @@
 #ifndef INTRINSIC_BLUR_FILTER_H_
 #define INTRINSIC_BLUR_FILTER_H_
 
-#include "RenderScript.h"
-#include "SimpleFilter.h"
+#include "RSStageFilter.h"
 
 namespace android {
 
-struct IntrinsicBlurFilter : public SimpleFilter {
+struct IntrinsicBlurFilter : public RSStageFilter {
 public:
     IntrinsicBlurFilter() : mBlurRadius(1.f) {};
 
-    virtual status_t configure(const sp<AMessage> &msg);
-    virtual status_t start();
-    virtual void reset();
     virtual status_t setParameters(const sp<AMessage> &msg);
-    virtual status_t processBuffers(
-            const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer);
+    virtual status_t processAllocations(
+            const RSC::sp<RSC::Allocation> &in,
+            const RSC::sp<RSC::Allocation> &out);
 
 protected:
     virtual ~IntrinsicBlurFilter() {};
 
+    virtual status_t onStart();
+    virtual void onReset();
+
 private:
-    AString mCacheDir;
-    RSC::sp<RSC::RS> mRS;
-    RSC::sp<RSC::Allocation> mAllocIn;
-    RSC::sp<RSC::Allocation> mAllocOut;
     RSC::sp<RSC::ScriptIntrinsicBlur> mBlur;
     float mBlurRadius;
 };
@@ -34,6 +34,7 @@
 #include <gui/BufferItem.h>
 
 #include "ColorConvert.h"
+#include "FilterChain.h"
 #include "GraphicBufferListener.h"
 #include "IntrinsicBlurFilter.h"
 #include "RSFilter.h"
@@ -453,6 +454,8 @@ void MediaFilter::onAllocateComponent(const sp<AMessage> &msg) {
         mFilter = new IntrinsicBlurFilter;
     } else if (!strcasecmp(name, "android.filter.RenderScript")) {
         mFilter = new RSFilter;
+    } else if (!strcasecmp(name, "android.filter.chain")) {
+        mFilter = new FilterChain;
     } else {
         ALOGE("Unrecognized filter name: %s", name);
         signalError(NAME_NOT_FOUND);
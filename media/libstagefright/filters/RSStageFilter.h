@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RS_STAGE_FILTER_H_
+#define RS_STAGE_FILTER_H_
+
+#include <media/stagefright/foundation/AString.h>
+#include <RenderScript.h>
+
+#include "SimpleFilter.h"
+
+namespace android {
+
+// A filter running RenderScript kernels on ARGB8888 allocations.  Run on
+// its own, start() creates a context with an input and an output
+// allocation and every frame is copied through them.  FilterChain starts
+// several of them as stages of one context with startStage() instead, so
+// that frames stay in RenderScript memory from one filter to the next.
+struct RSStageFilter : public SimpleFilter {
+public:
+    RSStageFilter() {};
+
+    virtual status_t configure(const sp<AMessage> &msg);
+    virtual status_t start();
+    virtual void reset();
+    virtual status_t processBuffers(
+            const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer);
+
+    // Starts the filter on the context rs, without allocations of its own.
+    status_t startStage(const RSC::sp<RSC::RS> &rs);
+
+    // Filters in into out, both width x height allocations of the context.
+    virtual status_t processAllocations(
+            const RSC::sp<RSC::Allocation> &in,
+            const RSC::sp<RSC::Allocation> &out) = 0;
+
+protected:
+    RSC::sp<RSC::RS> mRS;
+
+    virtual ~RSStageFilter() {};
+
+    // Creates the kernels on mRS.
+    virtual status_t onStart() = 0;
+    virtual void onReset() = 0;
+
+private:
+    AString mCacheDir;
+    RSC::sp<RSC::Allocation> mAllocIn;
+    RSC::sp<RSC::Allocation> mAllocOut;
+};
+
+}   // namespace android
+
+#endif  // RS_STAGE_FILTER_H_
@@ -27,40 +27,7 @@
 
 namespace android {
 
-status_t SaturationFilter::configure(const sp<AMessage> &msg) {
-    status_t err = SimpleFilter::configure(msg);
-    if (err != OK) {
-        return err;
-    }
-
-    if (!msg->findString("cacheDir", &mCacheDir)) {
-        ALOGE("Failed to find cache directory in config message.");
-        return NAME_NOT_FOUND;
-    }
-
-    return OK;
-}
-
-status_t SaturationFilter::start() {
-    // TODO: use a single RS context object for entire application
-    mRS = new RSC::RS();
-
-    if (!mRS->init(mCacheDir.c_str())) {
-        ALOGE("Failed to initialize RenderScript context.");
-        return NO_INIT;
-    }
-
-    // 32-bit elements for ARGB8888
-    RSC::sp<const RSC::Element> e = RSC::Element::U8_4(mRS);
-
-    RSC::Type::Builder tb(mRS, e);
-    tb.setX(mWidth);
-    tb.setY(mHeight);
-    RSC::sp<const RSC::Type> t = tb.create();
-
-    mAllocIn = RSC::Allocation::createTyped(mRS, t);
-    mAllocOut = RSC::Allocation::createTyped(mRS, t);
-
+status_t SaturationFilter::onStart() {
     mScript = new ScriptC_saturationARGB(mRS);
 
     mScript->set_gSaturation(mSaturation);
@@ -68,11 +35,8 @@ status_t SaturationFilter::start() {
     return OK;
 }
 
-void SaturationFilter::reset() {
+void SaturationFilter::onReset() {
     mScript.clear();
-    mAllocOut.clear();
-    mAllocIn.clear();
-    mRS.clear();
 }
 
 status_t SaturationFilter::setParameters(const sp<AMessage> &msg) {
@@ -82,16 +46,18 @@ status_t SaturationFilter::setParameters(const sp<AMessage> &msg) {
     float saturation;
     if (params->findFloat("saturation", &saturation)) {
         mSaturation = saturation;
+        if (mScript != NULL) {
+            mScript->set_gSaturation(mSaturation);
+        }
     }
 
     return OK;
 }
 
-status_t SaturationFilter::processBuffers(
-        const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer) {
-    mAllocIn->copy1DRangeFrom(0, mWidth * mHeight, srcBuffer->data());
-    mScript->forEach_root(mAllocIn, mAllocOut);
-    mAllocOut->copy1DRangeTo(0, mWidth * mHeight, outBuffer->data());
+status_t SaturationFilter::processAllocations(
+        const RSC::sp<RSC::Allocation> &in,
+        const RSC::sp<RSC::Allocation> &out) {
+    mScript->forEach_root(in, out);
 
     return OK;
 }
@@ -19,30 +19,27 @@
 
 #include <RenderScript.h>
 
+#include "RSStageFilter.h"
 #include "ScriptC_saturationARGB.h"
-#include "SimpleFilter.h"
 
 namespace android {
 
-struct SaturationFilter : public SimpleFilter {
+struct SaturationFilter : public RSStageFilter {
 public:
     SaturationFilter() : mSaturation(1.f) {};
 
-    virtual status_t configure(const sp<AMessage> &msg);
-    virtual status_t start();
-    virtual void reset();
     virtual status_t setParameters(const sp<AMessage> &msg);
-    virtual status_t processBuffers(
-            const sp<ABuffer> &srcBuffer, const sp<ABuffer> &outBuffer);
+    virtual status_t processAllocations(
+            const RSC::sp<RSC::Allocation> &in,
+            const RSC::sp<RSC::Allocation> &out);
 
 protected:
     virtual ~SaturationFilter() {};
 
+    virtual status_t onStart();
+    virtual void onReset();
+
 private:
-    AString mCacheDir;
-    RSC::sp<RSC::RS> mRS;
-    RSC::sp<RSC::Allocation> mAllocIn;
-    RSC::sp<RSC::Allocation> mAllocOut;
     RSC::sp<ScriptC_saturationARGB> mScript;
     float mSaturation;
 };
@@ -25,20 +25,26 @@ AAtomizer AAtomizer::gAtomizer;
 
 // static
 const char *AAtomizer::Atomize(const char *name) {
-    return gAtomizer.atomize(name);
+    return gAtomizer.atomize(name, Hash(name), false /* limited */);
 }
 
-AAtomizer::AAtomizer() {
+// static
+const char *AAtomizer::TryAtomize(const char *name, uint32_t hash) {
+    return gAtomizer.atomize(name, hash, true /* limited */);
+}
+
+AAtomizer::AAtomizer()
+    : mNumAtoms(0) {
     for (size_t i = 0; i < 128; ++i) {
         mAtoms.push(List<AString>());
     }
 }
 
-const char *AAtomizer::atomize(const char *name) {
+const char *AAtomizer::atomize(const char *name, uint32_t hash, bool limited) {
     Mutex::Autolock autoLock(mLock);
 
     const size_t n = mAtoms.size();
-    size_t index = AAtomizer::Hash(name) % n;
+    size_t index = hash % n;
     List<AString> &entry = mAtoms.editItemAt(index);
     List<AString>::iterator it = entry.begin();
     while (it != entry.end()) {
@@ -48,19 +54,28 @@ const char *AAtomizer::atomize(const char *name) {
         ++it;
     }
 
+    if (limited && mNumAtoms >= kMaxAtoms) {
+        return NULL;
+    }
     entry.push_back(AString(name));
+    ++mNumAtoms;
 
     return (*--entry.end()).c_str();
 }
 
 // static
-uint32_t AAtomizer::Hash(const char *s) {
+__attribute__((no_sanitize("integer")))  // the hash wraps around
+uint32_t AAtomizer::Hash(const char *s, size_t *length) {
+    const char *start = s;
     uint32_t sum = 0;
     while (*s != '\0') {
         sum = (sum * 31) + *s;
         ++s;
     }
 
+    if (length != NULL) {
+        *length = s - start;
+    }
     return sum;
 }
 
@@ -18,6 +18,8 @@
 
 #include <media/stagefright/foundation/ADebug.h>
 
+#include <string.h>
+
 namespace android {
 
 ABitReader::ABitReader(const uint8_t *data, size_t size)
@@ -31,23 +33,43 @@ ABitReader::ABitReader(const uint8_t *data, size_t size)
 ABitReader::~ABitReader() {
 }
 
+namespace {
+
+inline uint64_t loadBigEndian64(const uint8_t *data) {
+    uint64_t x;
+    memcpy(&x, data, sizeof(x));
+    return __builtin_bswap64(x);
+}
+
+// true iff one of the bytes of x is 0
+inline bool hasZeroByte(uint64_t x) {
+    return ((x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull) != 0;
+}
+
+}  // namespace
+
 bool ABitReader::fillReservoir() {
     if (mSize == 0) {
-        mOverRead = true;
         return false;
     }
 
-    mReservoir = 0;
-    size_t i;
-    for (i = 0; mSize > 0 && i < 4; ++i) {
-        mReservoir = (mReservoir << 8) | *mData;
+    if (mSize >= 8) {
+        // load as many whole bytes as fit, at least 1 as at most 56 bits are left when refilling
+        size_t numBytes = (64 - mNumBitsLeft) / 8;
+        uint64_t bytes = loadBigEndian64(mData) >> (64 - 8 * numBytes);
+        mReservoir |= bytes << (64 - mNumBitsLeft - 8 * numBytes);
+        mNumBitsLeft += 8 * numBytes;
+        mData += numBytes;
+        mSize -= numBytes;
+        return true;
+    }
 
+    while (mSize > 0 && mNumBitsLeft <= 56) {
+        mReservoir |= (uint64_t)*mData << (56 - mNumBitsLeft);
+        mNumBitsLeft += 8;
         ++mData;
         --mSize;
     }
-
-    mNumBitsLeft = 8 * i;
-    mReservoir <<= 32 - mNumBitsLeft;
     return true;
 }
 
@@ -68,27 +90,61 @@ bool ABitReader::getBitsGraceful(size_t n, uint32_t *out) {
         return false;
     }
 
-    uint32_t result = 0;
-    while (n > 0) {
-        if (mNumBitsLeft == 0) {
-            if (!fillReservoir()) {
-                return false;
-            }
+    if (n > mNumBitsLeft) {
+        (void)fillReservoir();
+        if (n > mNumBitsLeft) {
+            // consume what is left, as reading bit by bit would
+            mData += mSize;
+            mSize = 0;
+            mReservoir = 0;
+            mNumBitsLeft = 0;
+            mOverRead = true;
+            return false;
         }
+    }
 
-        size_t m = n;
-        if (m > mNumBitsLeft) {
-            m = mNumBitsLeft;
-        }
+    if (n == 0) {
+        *out = 0;
+        return true;
+    }
 
-        result = (result << m) | (mReservoir >> (32 - m));
-        mReservoir <<= m;
-        mNumBitsLeft -= m;
+    *out = (uint32_t)(mReservoir >> (64 - n));
+    mReservoir <<= n;
+    mNumBitsLeft -= n;
+    return true;
+}
 
-        n -= m;
+bool ABitReader::getUEGraceful(uint32_t *out) {
+    if (mNumBitsLeft <= 56) {
+        (void)fillReservoir();
     }
 
-    *out = result;
+    // the whole code is usually in the reservoir: leading zeros, then the value + 1 in
+    // numZeroes + 1 bits
+    if (mReservoir != 0) {
+        size_t numZeroes = __builtin_clzll(mReservoir);
+        size_t codeLength = 2 * numZeroes + 1;
+        if (numZeroes < 32 && codeLength <= mNumBitsLeft) {
+            *out = (uint32_t)((mReservoir >> (64 - codeLength)) - 1);
+            mReservoir <<= codeLength;
+            mNumBitsLeft -= codeLength;
+            return true;
+        }
+    }
+
+    unsigned numZeroes = 0;
+    while (getBitsWithFallback(1, 1) == 0) {
+        ++numZeroes;
+    }
+    if (numZeroes >= 32) {
+        (void)skipBits(numZeroes);
+        return false;
+    }
+    uint32_t x;
+    if (!getBitsGraceful(numZeroes, &x)) {
+        return false;
+    }
+    *out = x + (1u << numZeroes) - 1;
     return true;
 }
 
@@ -108,20 +164,23 @@ bool ABitReader::skipBits(size_t n) {
 }
 
 void ABitReader::putBits(uint32_t x, size_t n) {
-    if (mOverRead) {
+    if (mOverRead || n == 0) {
         return;
     }
 
     CHECK_LE(n, 32u);
 
-    while (mNumBitsLeft + n > 32) {
+    while (mNumBitsLeft + n > 64) {
         mNumBitsLeft -= 8;
         --mData;
         ++mSize;
     }
 
-    mReservoir = (mReservoir >> n) | (x << (32 - n));
+    mReservoir = (mReservoir >> n) | ((uint64_t)x << (64 - n));
     mNumBitsLeft += n;
+    if (mNumBitsLeft < 64) {
+        mReservoir &= ~(~0ull >> mNumBitsLeft);
+    }
 }
 
 size_t ABitReader::numBitsLeft() const {
@@ -171,13 +230,25 @@ bool NALBitReader::atLeastNumBitsLeft(size_t n) const {
 
 bool NALBitReader::fillReservoir() {
     if (mSize == 0) {
-        mOverRead = true;
         return false;
     }
 
-    mReservoir = 0;
-    size_t i = 0;
-    while (mSize > 0 && i < 4) {
+    // Bytes preceded by fewer than 2 zeros and containing no zero cannot hold an
+    // emulation_prevention_three_byte, take them as they are.
+    if (mSize >= 8 && mNumZeros < 2) {
+        uint64_t word = loadBigEndian64(mData);
+        if (!hasZeroByte(word)) {
+            size_t numBytes = (64 - mNumBitsLeft) / 8;
+            mReservoir |= (word >> (64 - 8 * numBytes)) << (64 - mNumBitsLeft - 8 * numBytes);
+            mNumBitsLeft += 8 * numBytes;
+            mData += numBytes;
+            mSize -= numBytes;
+            mNumZeros = 0;
+            return true;
+        }
+    }
+
+    while (mSize > 0 && mNumBitsLeft <= 56) {
         bool isEmulationPreventionByte = (mNumZeros >= 2 && *mData == 3);
 
         if (*mData == 0) {
@@ -188,16 +259,13 @@ bool NALBitReader::fillReservoir() {
 
         // skip emulation_prevention_three_byte
         if (!isEmulationPreventionByte) {
-            mReservoir = (mReservoir << 8) | *mData;
-            ++i;
+            mReservoir |= (uint64_t)*mData << (56 - mNumBitsLeft);
+            mNumBitsLeft += 8;
         }
 
         ++mData;
         --mSize;
     }
-
-    mNumBitsLeft = 8 * i;
-    mReservoir <<= 32 - mNumBitsLeft;
     return true;
 }
 
@@ -21,13 +21,76 @@
 #include "AMessage.h"
 #include "MediaBufferBase.h"
 
+#include <utils/threads.h>
+
 namespace android {
 
+namespace {
+
+// Blocks of pooled buffers are powers of 2 from 1 KB to 4 MB, larger buffers are not pooled.
+// Released blocks are kept for reuse up to kMaxPooledBytes in total.
+const size_t kMinPooledSizeLog2 = 10;
+const size_t kMaxPooledSizeLog2 = 22;
+const size_t kNumPooledSizes = kMaxPooledSizeLog2 - kMinPooledSizeLog2 + 1;
+const size_t kMaxPooledBytes = 8 * 1024 * 1024;
+
+struct PooledBlock {
+    PooledBlock *mNext;
+};
+
+Mutex gBlockPoolLock;
+PooledBlock *gBlockPool[kNumPooledSizes];
+size_t gNumPooledBytes = 0;
+
+// returns the size class of blocks of at least capacity bytes
+bool pooledSizeClass(size_t capacity, size_t *sizeClass) {
+    if (capacity > ((size_t)1 << kMaxPooledSizeLog2)) {
+        return false;
+    }
+    size_t i = 0;
+    while (((size_t)1 << (kMinPooledSizeLog2 + i)) < capacity) {
+        ++i;
+    }
+    *sizeClass = i;
+    return true;
+}
+
+void *allocatePooledBlock(size_t sizeClass) {
+    {
+        Mutex::Autolock autoLock(gBlockPoolLock);
+        PooledBlock *block = gBlockPool[sizeClass];
+        if (block != NULL) {
+            gBlockPool[sizeClass] = block->mNext;
+            gNumPooledBytes -= (size_t)1 << (kMinPooledSizeLog2 + sizeClass);
+            return block;
+        }
+    }
+    return malloc((size_t)1 << (kMinPooledSizeLog2 + sizeClass));
+}
+
+void freePooledBlock(void *data, size_t sizeClass) {
+    const size_t blockSize = (size_t)1 << (kMinPooledSizeLog2 + sizeClass);
+    {
+        Mutex::Autolock autoLock(gBlockPoolLock);
+        if (gNumPooledBytes + blockSize <= kMaxPooledBytes) {
+            PooledBlock *block = static_cast<PooledBlock *>(data);
+            block->mNext = gBlockPool[sizeClass];
+            gBlockPool[sizeClass] = block;
+            gNumPooledBytes += blockSize;
+            return;
+        }
+    }
+    free(data);
+}
+
+}  // namespace
+
 ABuffer::ABuffer(size_t capacity)
     : mMediaBufferBase(NULL),
       mRangeOffset(0),
       mInt32Data(0),
-      mOwnsData(true) {
+      mOwnsData(true),
+      mPooled(false) {
     mData = malloc(capacity);
     if (mData == NULL) {
         mCapacity = 0;
@@ -45,7 +108,8 @@ ABuffer::ABuffer(void *data, size_t capacity)
       mRangeOffset(0),
       mRangeLength(capacity),
       mInt32Data(0),
-      mOwnsData(false) {
+      mOwnsData(false),
+      mPooled(false) {
 }
 
 // static
@@ -59,10 +123,41 @@ sp<ABuffer> ABuffer::CreateAsCopy(const void *data, size_t capacity)
     return res;
 }
 
+// static
+sp<ABuffer> ABuffer::CreatePooled(size_t capacity) {
+    size_t sizeClass;
+    if (!pooledSizeClass(capacity, &sizeClass)) {
+        return new ABuffer(capacity);
+    }
+    sp<ABuffer> res = new ABuffer(allocatePooledBlock(sizeClass), capacity);
+    if (res->base() == NULL) {
+        res->mCapacity = 0;
+        res->mRangeLength = 0;
+        return res;
+    }
+    res->mOwnsData = true;
+    res->mPooled = true;
+    return res;
+}
+
+sp<ABuffer> ABuffer::slice(size_t offset, size_t size) {
+    CHECK_LE(offset, mRangeLength);
+    CHECK_LE(size, mRangeLength - offset);
+
+    sp<ABuffer> res = new ABuffer(data() + offset, size);
+    res->mParent = mParent != NULL ? mParent : this;
+    return res;
+}
+
 ABuffer::~ABuffer() {
     if (mOwnsData) {
         if (mData != NULL) {
-            free(mData);
+            size_t sizeClass;
+            if (mPooled && pooledSizeClass(mCapacity, &sizeClass)) {
+                freePooledBlock(mData, sizeClass);
+            } else {
+                free(mData);
+            }
             mData = NULL;
         }
     }
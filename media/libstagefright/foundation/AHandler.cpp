@@ -16,26 +16,80 @@
 
 //#define LOG_NDEBUG 0
 #define LOG_TAG "AHandler"
+#define ATRACE_TAG ATRACE_TAG_VIDEO
 #include <utils/Log.h>
+#include <utils/Trace.h>
 
 #include <media/stagefright/foundation/AHandler.h>
 #include <media/stagefright/foundation/AMessage.h>
 
 namespace android {
 
-void AHandler::deliverMessage(const sp<AMessage> &msg) {
+static int32_t clampToInt32(int64_t x) {
+    return x > INT32_MAX ? INT32_MAX : (int32_t)x;
+}
+
+void AHandler::deliverMessage(const sp<AMessage> &msg, int64_t whenUs) {
+    if (!mVerboseStats) {
+        onMessageReceived(msg);
+        mMessageCounter++;
+        return;
+    }
+
+    uint32_t what = msg->what();
+    int64_t startUs = ALooper::GetNowUs();
+    const int64_t waitUs = startUs - whenUs;
+    const bool tracing = ATRACE_ENABLED();
+    if (tracing) {
+        if (mWaitCounterName.empty()) {
+            sp<ALooper> looper = mLooper.promote();
+            AString name = AStringPrintf(
+                    "%s.%d", looper != NULL ? looper->getName() : "AHandler", mID);
+            mWaitCounterName = AStringPrintf("%s.waitUs", name.c_str());
+            mExecCounterName = AStringPrintf("%s.execUs", name.c_str());
+        }
+        ATRACE_INT(mWaitCounterName.c_str(), clampToInt32(waitUs));
+    }
+
     onMessageReceived(msg);
     mMessageCounter++;
 
-    if (mVerboseStats) {
-        uint32_t what = msg->what();
-        ssize_t idx = mMessages.indexOfKey(what);
-        if (idx < 0) {
-            mMessages.add(what, 1);
-        } else {
-            mMessages.editValueAt(idx)++;
-        }
+    const int64_t execUs = ALooper::GetNowUs() - startUs;
+    if (tracing) {
+        ATRACE_INT(mExecCounterName.c_str(), clampToInt32(execUs));
     }
+
+    ssize_t idx = mMessages.indexOfKey(what);
+    if (idx < 0) {
+        MessageStats stats = {};
+        idx = mMessages.add(what, stats);
+    }
+    MessageStats &stats = mMessages.editValueAt(idx);
+    stats.mCount++;
+    stats.mTotalWaitUs += waitUs;
+    stats.mTotalExecUs += execUs;
+    if (waitUs > stats.mMaxWaitUs) {
+        stats.mMaxWaitUs = waitUs;
+    }
+    if (execUs > stats.mMaxExecUs) {
+        stats.mMaxExecUs = execUs;
+    }
+
+    RecentMessage &recent = mRecentMessages[mNextRecent];
+    recent.mWhat = what;
+    recent.mWaitUs = clampToInt32(waitUs);
+    recent.mExecUs = clampToInt32(execUs);
+    mNextRecent = (mNextRecent + 1) % kNumRecentMessages;
+    if (mNumRecent < kNumRecentMessages) {
+        mNumRecent++;
+    }
+}
+
+void AHandler::clearStats() {
+    mMessageCounter = 0;
+    mMessages.clear();
+    mNumRecent = 0;
+    mNextRecent = 0;
 }
 
 }  // namespace android
@@ -20,6 +20,7 @@
 #include <media/stagefright/foundation/ADebug.h>
 
 #include <utils/Log.h>
+#include <utils/String8.h>
 
 #include <sys/time.h>
 
@@ -70,7 +71,13 @@ int64_t ALooper::GetNowUs() {
 }
 
 ALooper::ALooper()
-    : mRunningLocally(false) {
+    : mNextEventSequence(0),
+      mMaxQueueDepth(0),
+      mEventsDelivered(0),
+      mTotalLatencyUs(0),
+      mMaxLatencyUs(0),
+      mRunningLocally(false),
+      mNumThreads(1) {
     // clean up stale AHandlers. Doing it here instead of in the destructor avoids
     // the side effect of objects being deleted from the unregister function recursively.
     gLooperRoster.unregisterStaleHandlers();
@@ -79,12 +86,20 @@ ALooper::ALooper()
 ALooper::~ALooper() {
     stop();
     // stale AHandlers are now cleaned up in the constructor of the next ALooper to come along
+    for (size_t i = 0; i < mHandlerQueues.size(); ++i) {
+        delete mHandlerQueues.valueAt(i);
+    }
 }
 
 void ALooper::setName(const char *name) {
     mName = name;
 }
 
+void ALooper::setNumThreads(size_t numThreads) {
+    Mutex::Autolock autoLock(mLock);
+    mNumThreads = numThreads > 0 ? numThreads : 1;
+}
+
 ALooper::handler_id ALooper::registerHandler(const sp<AHandler> &handler) {
     return gLooperRoster.registerHandler(this, handler);
 }
@@ -99,7 +114,7 @@ status_t ALooper::start(
         {
             Mutex::Autolock autoLock(mLock);
 
-            if (mThread != NULL || mRunningLocally) {
+            if (mThread != NULL || mRunningLocally || mNumThreads > 1) {
                 return INVALID_OPERATION;
             }
 
@@ -120,25 +135,39 @@ status_t ALooper::start(
 
     mThread = new LooperThread(this, canCallJava);
 
-    status_t err = mThread->run(
-            mName.empty() ? "ALooper" : mName.c_str(), priority);
+    const char *name = mName.empty() ? "ALooper" : mName.c_str();
+    status_t err = mThread->run(name, priority);
     if (err != OK) {
         mThread.clear();
+        return err;
     }
 
-    return err;
+    for (size_t i = 1; i < mNumThreads; ++i) {
+        sp<LooperThread> thread = new LooperThread(this, canCallJava);
+        AString threadName = AStringPrintf("%s.%zu", name, i);
+        if (thread->run(threadName.c_str(), priority) != OK) {
+            ALOGW("%s: could only start %zu of %zu threads", name, i, mNumThreads);
+            break;
+        }
+        mPoolThreads.push(thread);
+    }
+
+    return OK;
 }
 
 status_t ALooper::stop() {
     sp<LooperThread> thread;
+    Vector<sp<LooperThread> > poolThreads;
     bool runningLocally;
 
     {
         Mutex::Autolock autoLock(mLock);
 
         thread = mThread;
+        poolThreads = mPoolThreads;
         runningLocally = mRunningLocally;
         mThread.clear();
+        mPoolThreads.clear();
         mRunningLocally = false;
     }
 
@@ -149,8 +178,11 @@ status_t ALooper::stop() {
     if (thread != NULL) {
         thread->requestExit();
     }
+    for (size_t i = 0; i < poolThreads.size(); ++i) {
+        poolThreads[i]->requestExit();
+    }
 
-    mQueueChangedCondition.signal();
+    mQueueChangedCondition.broadcast();
     {
         Mutex::Autolock autoLock(mRepliesLock);
         mRepliesCondition.broadcast();
@@ -161,6 +193,11 @@ status_t ALooper::stop() {
         // the loop() function will return and never be called again.
         thread->requestExitAndWait();
     }
+    for (size_t i = 0; i < poolThreads.size(); ++i) {
+        if (!poolThreads[i]->isCurrentThread()) {
+            poolThreads[i]->requestExitAndWait();
+        }
+    }
 
     return OK;
 }
@@ -175,24 +212,79 @@ void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
         whenUs = GetNowUs();
     }
 
-    List<Event>::iterator it = mEventQueue.begin();
-    while (it != mEventQueue.end() && (*it).mWhenUs <= whenUs) {
-        ++it;
+    if (pushEvent_l(whenUs, msg)) {
+        mQueueChangedCondition.signal();
     }
+}
 
+bool ALooper::pushEvent_l(int64_t whenUs, const sp<AMessage> &msg) {
     Event event;
     event.mWhenUs = whenUs;
-    event.mMessage = msg;
+    event.mSequence = mNextEventSequence++;
+    if (mFreeEventSlots.isEmpty()) {
+        event.mSlot = mEventMessages.add(msg);
+    } else {
+        event.mSlot = mFreeEventSlots.top();
+        mFreeEventSlots.pop();
+        mEventMessages.editItemAt(event.mSlot) = msg;
+    }
 
-    if (it == mEventQueue.begin()) {
-        mQueueChangedCondition.signal();
+    // sift up
+    size_t i = mEventQueue.add(event);
+    Event *heap = mEventQueue.editArray();
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!isEarlier(event, heap[parent])) {
+            break;
+        }
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = event;
+
+    if (mEventQueue.size() > mMaxQueueDepth) {
+        mMaxQueueDepth = mEventQueue.size();
     }
+    return i == 0;
+}
 
-    mEventQueue.insert(it, event);
+sp<AMessage> ALooper::popEvent_l() {
+    Event *heap = mEventQueue.editArray();
+    const size_t slot = heap[0].mSlot;
+    sp<AMessage> msg = mEventMessages[slot];
+    mEventMessages.editItemAt(slot).clear();
+    mFreeEventSlots.push(slot);
+
+    // sift down the last event from the root
+    const size_t n = mEventQueue.size() - 1;
+    const Event last = heap[n];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && isEarlier(heap[child + 1], heap[child])) {
+            ++child;
+        }
+        if (!isEarlier(heap[child], last)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    mEventQueue.removeAt(n);
+    return msg;
 }
 
 bool ALooper::loop() {
-    Event event;
+    if (mNumThreads > 1) {
+        return loopPool();
+    }
+
+    sp<AMessage> msg;
+    int64_t whenUs;
 
     {
         Mutex::Autolock autoLock(mLock);
@@ -203,7 +295,7 @@ bool ALooper::loop() {
             mQueueChangedCondition.wait(mLock);
             return true;
         }
-        int64_t whenUs = (*mEventQueue.begin()).mWhenUs;
+        whenUs = mEventQueue[0].mWhenUs;
         int64_t nowUs = GetNowUs();
 
         if (whenUs > nowUs) {
@@ -213,11 +305,11 @@ bool ALooper::loop() {
             return true;
         }
 
-        event = *mEventQueue.begin();
-        mEventQueue.erase(mEventQueue.begin());
+        msg = popEvent_l();
+        updateStats_l(nowUs - whenUs);
     }
 
-    event.mMessage->deliver();
+    msg->deliver(whenUs);
 
     // NOTE: It's important to note that at this point our "ALooper" object
     // may no longer exist (its final reference may have gone away while
@@ -227,6 +319,108 @@ bool ALooper::loop() {
     return true;
 }
 
+bool ALooper::loopPool() {
+    // see the note in loop(): the looper may go away while delivering the message
+    wp<ALooper> self(this);
+    HandlerQueue *queue;
+    DueMessage due;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mThread == NULL) {
+            return false;
+        }
+
+        // move the events due to the queues of their handlers
+        int64_t nowUs = GetNowUs();
+        while (!mEventQueue.isEmpty() && mEventQueue[0].mWhenUs <= nowUs) {
+            DueMessage next;
+            next.mWhenUs = mEventQueue[0].mWhenUs;
+            next.mMessage = popEvent_l();
+            updateStats_l(nowUs - next.mWhenUs);
+
+            const handler_id target = next.mMessage->mTarget;
+            ssize_t index = mHandlerQueues.indexOfKey(target);
+            if (index >= 0) {
+                // already runnable or being delivered
+                mHandlerQueues.valueAt(index)->mMessages.push_back(next);
+            } else {
+                HandlerQueue *newQueue = new HandlerQueue;
+                newQueue->mHandlerID = target;
+                newQueue->mMessages.push_back(next);
+                mHandlerQueues.add(target, newQueue);
+                mRunnableQueues.push_back(newQueue);
+            }
+        }
+
+        if (mRunnableQueues.empty()) {
+            if (mEventQueue.isEmpty()) {
+                mQueueChangedCondition.wait(mLock);
+            } else {
+                int64_t delayUs = mEventQueue[0].mWhenUs - nowUs;
+                mQueueChangedCondition.waitRelative(mLock, delayUs * 1000ll);
+            }
+            return true;
+        }
+
+        queue = *mRunnableQueues.begin();
+        mRunnableQueues.erase(mRunnableQueues.begin());
+        due = *queue->mMessages.begin();
+        queue->mMessages.erase(queue->mMessages.begin());
+        if (!mRunnableQueues.empty()) {
+            // let another thread take the next handler
+            mQueueChangedCondition.signal();
+        }
+    }
+
+    due.mMessage->deliver(due.mWhenUs);
+    due.mMessage.clear();
+
+    sp<ALooper> looper = self.promote();
+    if (looper == NULL) {
+        // the looper was stopped and destroyed by the message delivered
+        return false;
+    }
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (queue->mMessages.empty()) {
+            mHandlerQueues.removeItem(queue->mHandlerID);
+            delete queue;
+        } else {
+            mRunnableQueues.push_back(queue);
+            mQueueChangedCondition.signal();
+        }
+    }
+
+    return true;
+}
+
+void ALooper::updateStats_l(int64_t latencyUs) {
+    ++mEventsDelivered;
+    mTotalLatencyUs += latencyUs;
+    if (latencyUs > mMaxLatencyUs) {
+        mMaxLatencyUs = latencyUs;
+    }
+}
+
+void ALooper::appendStats(String8 *s, bool clear) {
+    Mutex::Autolock autoLock(mLock);
+    s->appendFormat("queue depth %zu (max %zu), %llu events delivered",
+            mEventQueue.size(), mMaxQueueDepth, (unsigned long long)mEventsDelivered);
+    if (mEventsDelivered > 0) {
+        s->appendFormat(", latency avg %lld us max %lld us",
+                (long long)(mTotalLatencyUs / (int64_t)mEventsDelivered),
+                (long long)mMaxLatencyUs);
+    }
+    if (clear) {
+        mMaxQueueDepth = mEventQueue.size();
+        mEventsDelivered = 0;
+        mTotalLatencyUs = 0;
+        mMaxLatencyUs = 0;
+    }
+}
+
 // to be called by AMessage::postAndAwaitResponse only
 sp<AReplyToken> ALooper::createReplyToken() {
     return new AReplyToken(this);
@@ -133,11 +133,19 @@ void ALooperRoster::dump(int fd, const Vector<String16>& args) {
     size_t n = mHandlers.size();
     s.appendFormat(" %zu registered handlers:\n", n);
 
+    Vector<sp<ALooper> > loopers;
     for (size_t i = 0; i < n; i++) {
         s.appendFormat("  %d: ", mHandlers.keyAt(i));
         HandlerInfo &info = mHandlers.editValueAt(i);
         sp<ALooper> looper = info.mLooper.promote();
         if (looper != NULL) {
+            size_t j = 0;
+            while (j < loopers.size() && loopers[j] != looper) {
+                ++j;
+            }
+            if (j == loopers.size()) {
+                loopers.push(looper);
+            }
             s.append(looper->getName());
             sp<AHandler> handler = info.mHandler.promote();
             if (handler != NULL) {
@@ -147,16 +155,35 @@ void ALooperRoster::dump(int fd, const Vector<String16>& args) {
                     for (size_t j = 0; j < handler->mMessages.size(); j++) {
                         char fourcc[15];
                         makeFourCC(handler->mMessages.keyAt(j), fourcc);
-                        s.appendFormat("\n    %s: %u",
+                        const AHandler::MessageStats &stats = handler->mMessages.valueAt(j);
+                        s.appendFormat("\n    %s: %u, wait avg %lld max %lld us"
+                                ", exec avg %lld max %lld us",
                                 fourcc,
-                                handler->mMessages.valueAt(j));
+                                stats.mCount,
+                                (long long)(stats.mTotalWaitUs / stats.mCount),
+                                (long long)stats.mMaxWaitUs,
+                                (long long)(stats.mTotalExecUs / stats.mCount),
+                                (long long)stats.mMaxExecUs);
+                    }
+                    if (handler->mNumRecent > 0) {
+                        s.append("\n    recent (what wait/exec us):");
+                        const uint32_t n = AHandler::kNumRecentMessages;
+                        uint32_t first = (handler->mNextRecent + n - handler->mNumRecent) % n;
+                        for (uint32_t j = 0; j < handler->mNumRecent; j++) {
+                            const AHandler::RecentMessage &recent =
+                                    handler->mRecentMessages[(first + j) % n];
+                            char fourcc[15];
+                            makeFourCC(recent.mWhat, fourcc);
+                            s.appendFormat(" %s %d/%d", fourcc, recent.mWaitUs, recent.mExecUs);
+                        }
                     }
                 } else {
                     handler->mMessages.clear();
+                    handler->mNumRecent = 0;
+                    handler->mNextRecent = 0;
                 }
                 if (clear || (verboseStats && !oldVerbose)) {
-                    handler->mMessageCounter = 0;
-                    handler->mMessages.clear();
+                    handler->clearStats();
                 }
             } else {
                 s.append(": <stale handler>");
@@ -166,6 +193,13 @@ void ALooperRoster::dump(int fd, const Vector<String16>& args) {
         }
         s.append("\n");
     }
+
+    s.appendFormat(" %zu loopers:\n", loopers.size());
+    for (size_t i = 0; i < loopers.size(); i++) {
+        s.appendFormat("  %s: ", loopers[i]->getName());
+        loopers[i]->appendStats(&s, clear);
+        s.append("\n");
+    }
     write(fd, s.string(), s.size());
 }
 
@@ -48,6 +48,54 @@ status_t AReplyToken::setReply(const sp<AMessage> &reply) {
     return OK;
 }
 
+namespace {
+
+// Free list of released messages, reused by AMessage::operator new(). It is bounded so that a
+// burst of messages does not pin memory.
+const size_t kMaxPooledMessages = 32;
+
+struct PooledMessage {
+    PooledMessage *mNext;
+};
+
+Mutex gMessagePoolLock;
+PooledMessage *gMessagePool = NULL;
+size_t gNumPooledMessages = 0;
+
+}  // namespace
+
+// static
+void *AMessage::operator new(size_t size) {
+    if (size == sizeof(AMessage)) {
+        Mutex::Autolock autoLock(gMessagePoolLock);
+        PooledMessage *msg = gMessagePool;
+        if (msg != NULL) {
+            gMessagePool = msg->mNext;
+            --gNumPooledMessages;
+            return msg;
+        }
+    }
+    return ::operator new(size);
+}
+
+// static
+void AMessage::operator delete(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+    if (size == sizeof(AMessage)) {
+        Mutex::Autolock autoLock(gMessagePoolLock);
+        if (gNumPooledMessages < kMaxPooledMessages) {
+            PooledMessage *msg = static_cast<PooledMessage *>(ptr);
+            msg->mNext = gMessagePool;
+            gMessagePool = msg;
+            ++gNumPooledMessages;
+            return;
+        }
+    }
+    ::operator delete(ptr);
+}
+
 AMessage::AMessage(void)
     : mWhat(0),
       mTarget(0),
@@ -87,8 +135,7 @@ void AMessage::setTarget(const sp<const AHandler> &handler) {
 void AMessage::clear() {
     for (size_t i = 0; i < mNumItems; ++i) {
         Item *item = &mItems[i];
-        delete[] item->mName;
-        item->mName = NULL;
+        item->freeName();
         freeItemValue(item);
     }
     mNumItems = 0;
@@ -147,13 +194,16 @@ static void reportStats() {
 }
 #endif
 
-inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
+inline size_t AMessage::findItemIndex(const char *name, size_t len, uint32_t hash) const {
 #ifdef DUMP_STATS
     size_t memchecks = 0;
 #endif
     size_t i = 0;
     for (; i < mNumItems; i++) {
-        if (len != mItems[i].mNameLength) {
+        if (name == mItems[i].mName) {
+            break;
+        }
+        if (hash != mItems[i].mNameHash || len != mItems[i].mNameLength) {
             continue;
         }
 #ifdef DUMP_STATS
@@ -177,15 +227,41 @@ inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
 }
 
 // assumes item's name was uninitialized or NULL
-void AMessage::Item::setName(const char *name, size_t len) {
+void AMessage::Item::setName(const char *name, size_t len, uint32_t hash) {
     mNameLength = len;
-    mName = new char[len + 1];
-    memcpy((void*)mName, name, len + 1);
+    mNameHash = hash;
+    mName = AAtomizer::TryAtomize(name, hash);
+    mNameOwned = mName == NULL;
+    if (mNameOwned) {
+        char *copy = new char[len + 1];
+        memcpy(copy, name, len + 1);
+        mName = copy;
+    }
+}
+
+// assumes item's name was uninitialized or NULL
+void AMessage::Item::setName(const Item &other) {
+    if (other.mNameOwned) {
+        setName(other.mName, other.mNameLength, other.mNameHash);
+    } else {
+        mName = other.mName;
+        mNameLength = other.mNameLength;
+        mNameHash = other.mNameHash;
+        mNameOwned = false;
+    }
+}
+
+void AMessage::Item::freeName() {
+    if (mNameOwned) {
+        delete[] mName;
+    }
+    mName = NULL;
 }
 
 AMessage::Item *AMessage::allocateItem(const char *name) {
-    size_t len = strlen(name);
-    size_t i = findItemIndex(name, len);
+    size_t len;
+    uint32_t hash = AAtomizer::Hash(name, &len);
+    size_t i = findItemIndex(name, len, hash);
     Item *item;
 
     if (i < mNumItems) {
@@ -195,7 +271,7 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
         CHECK(mNumItems < kMaxNumItems);
         i = mNumItems++;
         item = &mItems[i];
-        item->setName(name, len);
+        item->setName(name, len, hash);
     }
 
     return item;
@@ -203,7 +279,9 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
 
 const AMessage::Item *AMessage::findItem(
         const char *name, Type type) const {
-    size_t i = findItemIndex(name, strlen(name));
+    size_t len;
+    uint32_t hash = AAtomizer::Hash(name, &len);
+    size_t i = findItemIndex(name, len, hash);
     if (i < mNumItems) {
         const Item *item = &mItems[i];
         return item->mType == type ? item : NULL;
@@ -213,7 +291,9 @@ const AMessage::Item *AMessage::findItem(
 }
 
 bool AMessage::findAsFloat(const char *name, float *value) const {
-    size_t i = findItemIndex(name, strlen(name));
+    size_t len;
+    uint32_t hash = AAtomizer::Hash(name, &len);
+    size_t i = findItemIndex(name, len, hash);
     if (i < mNumItems) {
         const Item *item = &mItems[i];
         switch (item->mType) {
@@ -240,7 +320,9 @@ bool AMessage::findAsFloat(const char *name, float *value) const {
 }
 
 bool AMessage::contains(const char *name) const {
-    size_t i = findItemIndex(name, strlen(name));
+    size_t len;
+    uint32_t hash = AAtomizer::Hash(name, &len);
+    size_t i = findItemIndex(name, len, hash);
     return i < mNumItems;
 }
 
@@ -371,14 +453,14 @@ bool AMessage::findRect(
     return true;
 }
 
-void AMessage::deliver() {
+void AMessage::deliver(int64_t whenUs) {
     sp<AHandler> handler = mHandler.promote();
     if (handler == NULL) {
         ALOGW("failed to deliver message as target handler %d is gone.", mTarget);
         return;
     }
 
-    handler->deliverMessage(this);
+    handler->deliverMessage(this, whenUs);
 }
 
 status_t AMessage::post(int64_t delayUs) {
@@ -456,7 +538,7 @@ sp<AMessage> AMessage::dup() const {
         const Item *from = &mItems[i];
         Item *to = &msg->mItems[i];
 
-        to->setName(from->mName, from->mNameLength);
+        to->setName(*from);
         to->mType = from->mType;
 
         switch (from->mType) {
@@ -696,6 +778,7 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel, size_t maxNestingLevel)
             {
                 if (maxNestingLevel == 0) {
                     ALOGE("Too many levels of AMessage nesting.");
+                    msg->mNumItems = i;
                     return NULL;
                 }
                 sp<AMessage> subMsg = AMessage::FromParcel(
@@ -705,6 +788,7 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel, size_t maxNestingLevel)
                     // This condition will be triggered when there exists an
                     // object that cannot cross process boundaries or when the
                     // level of nested AMessage is too deep.
+                    msg->mNumItems = i;
                     return NULL;
                 }
                 subMsg->incStrong(msg.get());
@@ -716,11 +800,14 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel, size_t maxNestingLevel)
             default:
             {
                 ALOGE("This type of object cannot cross process boundaries.");
+                msg->mNumItems = i;
                 return NULL;
             }
         }
 
-        item->setName(name, strlen(name));
+        size_t len;
+        uint32_t hash = AAtomizer::Hash(name, &len);
+        item->setName(name, len, hash);
     }
 
     return msg;
@@ -27,6 +27,7 @@
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 
@@ -35,6 +36,8 @@
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/hexdump.h>
 
+#include <cutils/properties.h>
+
 namespace android {
 
 static uint16_t U16_AT(const uint8_t *ptr) {
@@ -52,6 +55,14 @@ static uint64_t U64_AT(const uint8_t *ptr) {
 static const size_t kMaxUDPSize = 1500;
 static const int32_t kMaxUDPRetries = 200;
 
+// Queued datagrams are handed to sendmmsg() this many at a time.
+static const size_t kMaxSendBatch = 16;
+
+static const int kMaxEpollEvents = 32;
+
+// epoll data of the interrupt pipe, session IDs start at 1.
+static const uint32_t kPipeEpollID = 0;
+
 struct ANetworkSession::NetworkThread : public Thread {
     NetworkThread(ANetworkSession *session);
 
@@ -92,10 +103,21 @@ struct ANetworkSession::Session : public RefBase {
 
     bool isRTSPServer() const;
     bool isTCPDatagramServer() const;
+    bool isUDPSession() const;
 
     bool wantsToRead();
     bool wantsToWrite();
 
+    // The events the socket is registered for in the epoll set, 0 if it
+    // is not in it.
+    uint32_t epollEvents() const;
+    void setEpollEvents(uint32_t events);
+
+    // Whether the last writeMore() of a UDP session left datagrams queued
+    // because the socket buffer was full.
+    bool isWriteBlocked() const;
+    void clearWriteBlocked();
+
     status_t readMore();
     status_t writeMore();
 
@@ -116,6 +138,7 @@ private:
     struct Fragment {
         uint32_t mFlags;
         int64_t mTimeUs;
+        int64_t mQueuedUs;
         sp<ABuffer> mBuffer;
     };
 
@@ -128,15 +151,29 @@ private:
     int32_t mUDPRetries;
 
     List<Fragment> mOutFragments;
+    size_t mNumOutFragments;
 
     AString mInBuffer;
 
     int64_t mLastStallReportUs;
 
+    uint32_t mEpollEvents;
+    bool mWriteBlocked;
+    bool mBatchedSend;
+
+    // send queue statistics, logged when the session goes away
+    int64_t mNumFragmentsSent;
+    int64_t mNumSendCalls;
+    int32_t mNumSendsBlocked;
+    size_t mMaxQueuedFragments;
+    int64_t mMaxQueueDelayUs;
+
     void notifyError(bool send, status_t err, const char *detail);
     void notify(NotificationReason reason);
 
     void dumpFragmentStats(const Fragment &frag);
+    void onFragmentSent(const Fragment &frag);
+    status_t sendDatagrams();
 
     DISALLOW_EVIL_CONSTRUCTORS(Session);
 };
@@ -170,7 +207,16 @@ ANetworkSession::Session::Session(
       mSawReceiveFailure(false),
       mSawSendFailure(false),
       mUDPRetries(kMaxUDPRetries),
-      mLastStallReportUs(-1ll) {
+      mNumOutFragments(0),
+      mLastStallReportUs(-1ll),
+      mEpollEvents(0),
+      mWriteBlocked(false),
+      mBatchedSend(true),
+      mNumFragmentsSent(0),
+      mNumSendCalls(0),
+      mNumSendsBlocked(0),
+      mMaxQueuedFragments(0),
+      mMaxQueueDelayUs(0) {
     if (mState == CONNECTED) {
         struct sockaddr_in localAddr;
         socklen_t localAddrLen = sizeof(localAddr);
@@ -216,6 +262,13 @@ ANetworkSession::Session::Session(
 ANetworkSession::Session::~Session() {
     ALOGV("Session %d gone", mSessionID);
 
+    if (mNumSendCalls > 0) {
+        ALOGI("session %d sent %lld fragments in %lld send calls, blocked %d times, "
+              "max %zu queued, max queue delay %lld us",
+              mSessionID, (long long)mNumFragmentsSent, (long long)mNumSendCalls,
+              mNumSendsBlocked, mMaxQueuedFragments, (long long)mMaxQueueDelayUs);
+    }
+
     close(mSocket);
     mSocket = -1;
 }
@@ -254,6 +307,26 @@ bool ANetworkSession::Session::isTCPDatagramServer() const {
     return mState == LISTENING_TCP_DGRAMS;
 }
 
+bool ANetworkSession::Session::isUDPSession() const {
+    return mState == DATAGRAM;
+}
+
+uint32_t ANetworkSession::Session::epollEvents() const {
+    return mEpollEvents;
+}
+
+void ANetworkSession::Session::setEpollEvents(uint32_t events) {
+    mEpollEvents = events;
+}
+
+bool ANetworkSession::Session::isWriteBlocked() const {
+    return mWriteBlocked;
+}
+
+void ANetworkSession::Session::clearWriteBlocked() {
+    mWriteBlocked = false;
+}
+
 bool ANetworkSession::Session::wantsToRead() {
     return !mSawReceiveFailure && mState != CONNECTING;
 }
@@ -548,38 +621,92 @@ void ANetworkSession::Session::dumpFragmentStats(const Fragment & /* frag */) {
 #endif
 }
 
-status_t ANetworkSession::Session::writeMore() {
-    if (mState == DATAGRAM) {
-        CHECK(!mOutFragments.empty());
+void ANetworkSession::Session::onFragmentSent(const Fragment &frag) {
+    if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
+        dumpFragmentStats(frag);
+    }
+
+    int64_t delayUs = ALooper::GetNowUs() - frag.mQueuedUs;
+    if (delayUs > mMaxQueueDelayUs) {
+        mMaxQueueDelayUs = delayUs;
+    }
+    ++mNumFragmentsSent;
+
+    mOutFragments.erase(mOutFragments.begin());
+    --mNumOutFragments;
+}
+
+// Sends up to kMaxSendBatch of the queued datagrams with a single syscall.
+status_t ANetworkSession::Session::sendDatagrams() {
+    struct mmsghdr msgs[kMaxSendBatch];
+    struct iovec iovecs[kMaxSendBatch];
+
+    int n = -1;
+    if (mBatchedSend) {
+        size_t count = 0;
+        for (List<Fragment>::iterator it = mOutFragments.begin();
+                it != mOutFragments.end() && count < kMaxSendBatch; ++it, ++count) {
+            const sp<ABuffer> &datagram = it->mBuffer;
+            iovecs[count].iov_base = datagram->data();
+            iovecs[count].iov_len = datagram->size();
+
+            memset(&msgs[count], 0, sizeof(msgs[count]));
+            msgs[count].msg_hdr.msg_iov = &iovecs[count];
+            msgs[count].msg_hdr.msg_iovlen = 1;
+        }
 
-        status_t err;
         do {
-            const Fragment &frag = *mOutFragments.begin();
-            const sp<ABuffer> &datagram = frag.mBuffer;
+            n = sendmmsg(mSocket, msgs, count, 0);
+        } while (n < 0 && errno == EINTR);
 
-            int n;
-            do {
-                n = send(mSocket, datagram->data(), datagram->size(), 0);
-            } while (n < 0 && errno == EINTR);
+        if (n < 0 && errno == ENOSYS) {
+            ALOGW("sendmmsg is not supported, sending one datagram at a time");
+            mBatchedSend = false;
+        }
+    }
 
-            err = OK;
+    if (!mBatchedSend) {
+        const sp<ABuffer> &datagram = mOutFragments.begin()->mBuffer;
+        do {
+            n = send(mSocket, datagram->data(), datagram->size(), 0);
+        } while (n < 0 && errno == EINTR);
 
-            if (n > 0) {
-                if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
-                    dumpFragmentStats(frag);
-                }
+        if (n > 0) {
+            n = 1;
+        }
+    }
 
-                mOutFragments.erase(mOutFragments.begin());
-            } else if (n < 0) {
-                err = -errno;
-            } else if (n == 0) {
-                err = -ECONNRESET;
-            }
+    ++mNumSendCalls;
+
+    if (n < 0) {
+        return -errno;
+    } else if (n == 0) {
+        return -ECONNRESET;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        onFragmentSent(*mOutFragments.begin());
+    }
+    return OK;
+}
+
+status_t ANetworkSession::Session::writeMore() {
+    if (mState == DATAGRAM) {
+        CHECK(!mOutFragments.empty());
+
+        status_t err;
+        do {
+            err = sendDatagrams();
         } while (err == OK && !mOutFragments.empty());
 
+        mWriteBlocked = err == -EAGAIN;
+        if (mWriteBlocked) {
+            ++mNumSendsBlocked;
+        }
+
         if (err == -EAGAIN) {
             if (!mOutFragments.empty()) {
-                ALOGI("%zu datagrams remain queued.", mOutFragments.size());
+                ALOGI("%zu datagrams remain queued.", mNumOutFragments);
             }
             err = OK;
         }
@@ -630,6 +757,7 @@ status_t ANetworkSession::Session::writeMore() {
         do {
             n = send(mSocket, frag.mBuffer->data(), frag.mBuffer->size(), 0);
         } while (n < 0 && errno == EINTR);
+        ++mNumSendCalls;
 
         if (n <= 0) {
             break;
@@ -642,11 +770,7 @@ status_t ANetworkSession::Session::writeMore() {
             break;
         }
 
-        if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
-            dumpFragmentStats(frag);
-        }
-
-        mOutFragments.erase(mOutFragments.begin());
+        onFragmentSent(frag);
     }
 
     status_t err = OK;
@@ -770,9 +894,13 @@ status_t ANetworkSession::Session::sendRequest(
         frag.mTimeUs = timeUs;
     }
 
+    frag.mQueuedUs = ALooper::GetNowUs();
     frag.mBuffer = buffer;
 
     mOutFragments.push_back(frag);
+    if (++mNumOutFragments > mMaxQueuedFragments) {
+        mMaxQueuedFragments = mNumOutFragments;
+    }
 
     return OK;
 }
@@ -798,7 +926,9 @@ void ANetworkSession::Session::notify(NotificationReason reason) {
 ////////////////////////////////////////////////////////////////////////////////
 
 ANetworkSession::ANetworkSession()
-    : mNextSessionID(1) {
+    : mNextSessionID(1),
+      mEpollFd(-1),
+      mEdgeTriggered(property_get_bool("media.network-session.edge-triggered", false)) {
     mPipeFd[0] = mPipeFd[1] = -1;
 }
 
@@ -817,6 +947,21 @@ status_t ANetworkSession::start() {
         return -errno;
     }
 
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd >= 0) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u32 = kPipeEpollID;
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mPipeFd[0], &event) < 0) {
+            close(mEpollFd);
+            mEpollFd = -1;
+        }
+    }
+    if (mEpollFd < 0) {
+        ALOGW("cannot use epoll (%s), using select", strerror(errno));
+    }
+
     mThread = new NetworkThread(this);
 
     status_t err = mThread->run("ANetworkSession", ANDROID_PRIORITY_AUDIO);
@@ -824,6 +969,11 @@ status_t ANetworkSession::start() {
     if (err != OK) {
         mThread.clear();
 
+        if (mEpollFd >= 0) {
+            close(mEpollFd);
+            mEpollFd = -1;
+        }
+
         close(mPipeFd[0]);
         close(mPipeFd[1]);
         mPipeFd[0] = mPipeFd[1] = -1;
@@ -849,6 +999,16 @@ status_t ANetworkSession::stop() {
     close(mPipeFd[1]);
     mPipeFd[0] = mPipeFd[1] = -1;
 
+    if (mEpollFd >= 0) {
+        close(mEpollFd);
+        mEpollFd = -1;
+
+        Mutex::Autolock autoLock(mLock);
+        for (size_t i = 0; i < mSessions.size(); ++i) {
+            mSessions.valueAt(i)->setEpollEvents(0);
+        }
+    }
+
     return OK;
 }
 
@@ -1249,6 +1409,14 @@ void ANetworkSession::interrupt() {
 }
 
 void ANetworkSession::threadLoop() {
+    if (mEpollFd >= 0) {
+        threadLoopEpoll();
+    } else {
+        threadLoopSelect();
+    }
+}
+
+void ANetworkSession::threadLoopSelect() {
     fd_set rs, ws;
     FD_ZERO(&rs);
     FD_ZERO(&ws);
@@ -1332,79 +1500,226 @@ void ANetworkSession::threadLoop() {
                 --res;
             }
 
-            if (FD_ISSET(s, &rs)) {
-                if (session->isRTSPServer() || session->isTCPDatagramServer()) {
-                    struct sockaddr_in remoteAddr;
-                    socklen_t remoteAddrLen = sizeof(remoteAddr);
-
-                    int clientSocket = accept(
-                            s, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
-
-                    if (clientSocket >= 0) {
-                        status_t err = MakeSocketNonBlocking(clientSocket);
-
-                        if (err != OK) {
-                            ALOGE("Unable to make client socket non blocking, "
-                                  "failed w/ error %d (%s)",
-                                  err, strerror(-err));
-
-                            close(clientSocket);
-                            clientSocket = -1;
-                        } else {
-                            in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
-
-                            ALOGI("incoming connection from %d.%d.%d.%d:%d "
-                                  "(socket %d)",
-                                  (addr >> 24),
-                                  (addr >> 16) & 0xff,
-                                  (addr >> 8) & 0xff,
-                                  addr & 0xff,
-                                  ntohs(remoteAddr.sin_port),
-                                  clientSocket);
-
-                            sp<Session> clientSession =
-                                new Session(
-                                        mNextSessionID++,
-                                        Session::CONNECTED,
-                                        clientSocket,
-                                        session->getNotificationMessage());
-
-                            clientSession->setMode(
-                                    session->isRTSPServer()
-                                        ? Session::MODE_RTSP
-                                        : Session::MODE_DATAGRAM);
-
-                            sessionsToAdd.push_back(clientSession);
-                        }
-                    } else {
-                        ALOGE("accept returned error %d (%s)",
-                              errno, strerror(errno));
-                    }
-                } else {
-                    status_t err = session->readMore();
-                    if (err != OK) {
-                        ALOGE("readMore on socket %d failed w/ error %d (%s)",
-                              s, err, strerror(-err));
-                    }
-                }
+            processSession_l(
+                    session, FD_ISSET(s, &rs), FD_ISSET(s, &ws), &sessionsToAdd);
+        }
+
+        while (!sessionsToAdd.empty()) {
+            sp<Session> session = *sessionsToAdd.begin();
+            sessionsToAdd.erase(sessionsToAdd.begin());
+
+            mSessions.add(session->sessionID(), session);
+
+            ALOGI("added clientSession %d", session->sessionID());
+        }
+    }
+}
+
+void ANetworkSession::threadLoopEpoll() {
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        for (size_t i = 0; i < mSessions.size(); ++i) {
+            const sp<Session> &session = mSessions.valueAt(i);
+
+            if (session->socket() < 0) {
+                continue;
             }
 
-            if (FD_ISSET(s, &ws)) {
+            updateEpollEvents_l(session);
+
+            if ((session->epollEvents() & EPOLLET)
+                    && session->wantsToWrite() && !session->isWriteBlocked()) {
+                // No edge will tell us about datagrams queued since the
+                // last wakeup, send them right away.
                 status_t err = session->writeMore();
                 if (err != OK) {
                     ALOGE("writeMore on socket %d failed w/ error %d (%s)",
-                          s, err, strerror(-err));
+                          session->socket(), err, strerror(-err));
                 }
             }
         }
+    }
 
-        while (!sessionsToAdd.empty()) {
-            sp<Session> session = *sessionsToAdd.begin();
-            sessionsToAdd.erase(sessionsToAdd.begin());
+    struct epoll_event events[kMaxEpollEvents];
+    int res = epoll_wait(mEpollFd, events, kMaxEpollEvents, -1 /* timeout */);
 
-            mSessions.add(session->sessionID(), session);
+    if (res < 0) {
+        if (errno == EINTR) {
+            return;
+        }
 
-            ALOGI("added clientSession %d", session->sessionID());
+        ALOGE("epoll_wait failed w/ error %d (%s)", errno, strerror(errno));
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    List<sp<Session> > sessionsToAdd;
+
+    for (int i = 0; i < res; ++i) {
+        if (events[i].data.u32 == kPipeEpollID) {
+            char c;
+            ssize_t n;
+            do {
+                n = read(mPipeFd[0], &c, 1);
+            } while (n < 0 && errno == EINTR);
+
+            if (n < 0) {
+                ALOGW("Error reading from pipe (%s)", strerror(errno));
+            }
+            continue;
+        }
+
+        ssize_t index = mSessions.indexOfKey((int32_t)events[i].data.u32);
+        if (index < 0) {
+            // destroyed since
+            continue;
+        }
+
+        // Like select(), report errors to whatever the session waits for.
+        sp<Session> session = mSessions.valueAt(index);
+        uint32_t registered = session->epollEvents();
+        uint32_t ready = events[i].events;
+        if (ready & (EPOLLERR | EPOLLHUP)) {
+            ready |= EPOLLIN | EPOLLOUT;
+        }
+
+        bool writable = (ready & registered & EPOLLOUT) != 0;
+        if (registered & EPOLLET) {
+            if (writable) {
+                session->clearWriteBlocked();
+            }
+            writable = writable && session->wantsToWrite();
+        }
+
+        processSession_l(
+                session, (ready & registered & EPOLLIN) != 0, writable,
+                &sessionsToAdd);
+    }
+
+    while (!sessionsToAdd.empty()) {
+        sp<Session> session = *sessionsToAdd.begin();
+        sessionsToAdd.erase(sessionsToAdd.begin());
+
+        mSessions.add(session->sessionID(), session);
+
+        ALOGI("added clientSession %d", session->sessionID());
+    }
+}
+
+void ANetworkSession::updateEpollEvents_l(const sp<Session> &session) {
+    uint32_t events = 0;
+    if (mEdgeTriggered && session->isUDPSession()) {
+        // readMore() and writeMore() of UDP sessions run until EAGAIN
+        if (session->wantsToRead()) {
+            events |= EPOLLIN;
+        }
+        events |= EPOLLOUT | EPOLLET;
+    } else {
+        if (session->wantsToRead()) {
+            events |= EPOLLIN;
+        }
+        if (session->wantsToWrite()) {
+            events |= EPOLLOUT;
+        }
+    }
+
+    uint32_t current = session->epollEvents();
+    if (events == current) {
+        return;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u32 = session->sessionID();
+
+    int op = current == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (events == 0) {
+        // otherwise errors would still be reported
+        op = EPOLL_CTL_DEL;
+    }
+
+    int res = epoll_ctl(mEpollFd, op, session->socket(), &event);
+    if (res < 0 && op == EPOLL_CTL_ADD && errno == EEXIST) {
+        res = epoll_ctl(mEpollFd, EPOLL_CTL_MOD, session->socket(), &event);
+    }
+    if (res < 0) {
+        ALOGW("epoll_ctl on socket %d failed (%s)", session->socket(), strerror(errno));
+        return;
+    }
+
+    session->setEpollEvents(events);
+}
+
+void ANetworkSession::processSession_l(
+        const sp<Session> &session, bool readable, bool writable,
+        List<sp<Session> > *sessionsToAdd) {
+    int s = session->socket();
+
+    if (readable) {
+        if (session->isRTSPServer() || session->isTCPDatagramServer()) {
+            struct sockaddr_in remoteAddr;
+            socklen_t remoteAddrLen = sizeof(remoteAddr);
+
+            int clientSocket = accept(
+                    s, (struct sockaddr *)&remoteAddr, &remoteAddrLen);
+
+            if (clientSocket >= 0) {
+                status_t err = MakeSocketNonBlocking(clientSocket);
+
+                if (err != OK) {
+                    ALOGE("Unable to make client socket non blocking, "
+                          "failed w/ error %d (%s)",
+                          err, strerror(-err));
+
+                    close(clientSocket);
+                    clientSocket = -1;
+                } else {
+                    in_addr_t addr = ntohl(remoteAddr.sin_addr.s_addr);
+
+                    ALOGI("incoming connection from %d.%d.%d.%d:%d "
+                          "(socket %d)",
+                          (addr >> 24),
+                          (addr >> 16) & 0xff,
+                          (addr >> 8) & 0xff,
+                          addr & 0xff,
+                          ntohs(remoteAddr.sin_port),
+                          clientSocket);
+
+                    sp<Session> clientSession =
+                        new Session(
+                                mNextSessionID++,
+                                Session::CONNECTED,
+                                clientSocket,
+                                session->getNotificationMessage());
+
+                    clientSession->setMode(
+                            session->isRTSPServer()
+                                ? Session::MODE_RTSP
+                                : Session::MODE_DATAGRAM);
+
+                    sessionsToAdd->push_back(clientSession);
+                }
+            } else {
+                ALOGE("accept returned error %d (%s)",
+                      errno, strerror(errno));
+            }
+        } else {
+            status_t err = session->readMore();
+            if (err != OK) {
+                ALOGE("readMore on socket %d failed w/ error %d (%s)",
+                      s, err, strerror(-err));
+            }
+        }
+    }
+
+    if (writable) {
+        status_t err = session->writeMore();
+        if (err != OK) {
+            ALOGE("writeMore on socket %d failed w/ error %d (%s)",
+                  s, err, strerror(-err));
         }
     }
 }
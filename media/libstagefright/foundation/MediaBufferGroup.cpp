@@ -33,11 +33,13 @@ static const size_t kSharedMemoryThreshold = MIN(
         (size_t)MediaBuffer::kSharedMemThreshold, (size_t)(4 * 1024));
 
 MediaBufferGroup::MediaBufferGroup(size_t growthLimit) :
-    mGrowthLimit(growthLimit) {
+    mGrowthLimit(growthLimit),
+    mStats() {
 }
 
 MediaBufferGroup::MediaBufferGroup(size_t buffers, size_t buffer_size, size_t growthLimit)
-    : mGrowthLimit(growthLimit) {
+    : mGrowthLimit(growthLimit),
+      mStats() {
 
     if (mGrowthLimit > 0 && buffers > mGrowthLimit) {
         ALOGW("Preallocated buffers %zu > growthLimit %zu, increasing growthLimit",
@@ -114,6 +116,7 @@ void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
             && mBuffers.size() >= mGrowthLimit
             && it != mBuffers.end();) {
         if ((*it)->refcount() == 0) {
+            removeFreeBuffer_l(*it);
             (*it)->setObserver(nullptr);
             (*it)->release();
             it = mBuffers.erase(it);
@@ -124,6 +127,9 @@ void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
 
     buffer->setObserver(this);
     mBuffers.emplace_back(buffer);
+    if (buffer->refcount() == 0) {
+        mFreeBuffers[sizeClass(buffer->size())].push_back(buffer);
+    }
 }
 
 bool MediaBufferGroup::has_buffers() {
@@ -142,8 +148,16 @@ status_t MediaBufferGroup::acquire_buffer(
         MediaBuffer **out, bool nonBlocking, size_t requestedSize) {
     Mutex::Autolock autoLock(mLock);
     for (;;) {
+        MediaBuffer *buffer = popFreeBuffer_l(requestedSize);
+        if (buffer != nullptr) {
+            ++mStats.mHits;
+            buffer->add_ref();
+            buffer->reset();
+            *out = buffer;
+            return OK;
+        }
+
         size_t smallest = requestedSize;
-        MediaBuffer *buffer = nullptr;
         auto free = mBuffers.end();
         for (auto it = mBuffers.begin(); it != mBuffers.end(); ++it) {
             if ((*it)->refcount() == 0) {
@@ -169,10 +183,12 @@ status_t MediaBufferGroup::acquire_buffer(
                 delete buffer; // Invalid alloc, prefer not to call release.
                 buffer = nullptr;
             } else {
+                ++mStats.mAllocations;
                 buffer->setObserver(this);
                 if (free != mBuffers.end()) {
                     ALOGV("reallocate buffer, requested size %zu vs available %zu",
                             requestedSize, (*free)->size());
+                    removeFreeBuffer_l(*free);
                     (*free)->setObserver(nullptr);
                     (*free)->release();
                     *free = buffer; // in-place replace
@@ -183,6 +199,7 @@ status_t MediaBufferGroup::acquire_buffer(
             }
         }
         if (buffer != nullptr) {
+            ++mStats.mMisses;
             buffer->add_ref();
             buffer->reset();
             *out = buffer;
@@ -193,13 +210,65 @@ status_t MediaBufferGroup::acquire_buffer(
             return WOULD_BLOCK;
         }
         // All buffers are in use, block until one of them is returned.
+        ++mStats.mWaits;
         mCondition.wait(mLock);
     }
     // Never gets here.
 }
 
-void MediaBufferGroup::signalBufferReturned(MediaBuffer *) {
+void MediaBufferGroup::signalBufferReturned(MediaBuffer *buffer) {
+    if (buffer != nullptr) {
+        Mutex::Autolock autoLock(mLock);
+        mFreeBuffers[sizeClass(buffer->size())].push_back(buffer);
+    }
     mCondition.signal();
 }
 
+void MediaBufferGroup::get_stats(Stats *stats) {
+    Mutex::Autolock autoLock(mLock);
+    *stats = mStats;
+}
+
+// static
+size_t MediaBufferGroup::sizeClass(size_t size) {
+    size_t sizeClass = 0;
+    while (size > 1 && sizeClass < kNumSizeClasses - 1) {
+        size >>= 1;
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+// Returns the most recently returned free buffer of at least requestedSize bytes, from the
+// smallest size class that has one. Only the size class of requestedSize itself may have to be
+// searched: the larger ones return their last buffer.
+MediaBuffer *MediaBufferGroup::popFreeBuffer_l(size_t requestedSize) {
+    for (size_t k = sizeClass(requestedSize); k < kNumSizeClasses; ++k) {
+        std::vector<MediaBuffer *> &freeBuffers = mFreeBuffers[k];
+        for (size_t i = freeBuffers.size(); i > 0; --i) {
+            MediaBuffer *buffer = freeBuffers[i - 1];
+            if (buffer->refcount() != 0) {
+                // Held remotely, or acquired again. It will be found by the scan of mBuffers
+                // once released remotely, or returned to the group again.
+                freeBuffers.erase(freeBuffers.begin() + (i - 1));
+                continue;
+            }
+            if (buffer->size() >= requestedSize) {
+                freeBuffers.erase(freeBuffers.begin() + (i - 1));
+                return buffer;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void MediaBufferGroup::removeFreeBuffer_l(MediaBuffer *buffer) {
+    std::vector<MediaBuffer *> &freeBuffers = mFreeBuffers[sizeClass(buffer->size())];
+    for (size_t i = freeBuffers.size(); i > 0; --i) {
+        if (freeBuffers[i - 1] == buffer) {
+            freeBuffers.erase(freeBuffers.begin() + (i - 1));
+        }
+    }
+}
+
 }  // namespace android
@@ -29,12 +29,37 @@
 
 namespace android {
 
-MetaData::MetaData() {
+static const uint32_t kHotKeys[] = {
+    kKeyTime,
+    kKeyDecodingTime,
+    kKeyDuration,
+    kKeyIsSyncFrame,
+};
+
+// static
+ssize_t MetaData::HotKeyIndex(uint32_t key) {
+    switch (key) {
+        case kKeyTime:          return 0;
+        case kKeyDecodingTime:  return 1;
+        case kKeyDuration:      return 2;
+        case kKeyIsSyncFrame:   return 3;
+        default:                return -1;
+    }
+}
+
+MetaData::MetaData()
+    : mHotItemsPresent(0) {
 }
 
 MetaData::MetaData(const MetaData &from)
     : RefBase(),
-      mItems(from.mItems) {
+      mItems(from.mItems),
+      mHotItemsPresent(from.mHotItemsPresent) {
+    for (size_t i = 0; i < kNumHotKeys; ++i) {
+        if (mHotItemsPresent & (1u << i)) {
+            mHotItems[i] = from.mHotItems[i];
+        }
+    }
 }
 
 MetaData::~MetaData() {
@@ -43,9 +68,47 @@ MetaData::~MetaData() {
 
 void MetaData::clear() {
     mItems.clear();
+    for (size_t i = 0; i < kNumHotKeys; ++i) {
+        if (mHotItemsPresent & (1u << i)) {
+            mHotItems[i].clear();
+        }
+    }
+    mHotItemsPresent = 0;
+}
+
+size_t MetaData::numItems() const {
+    return mItems.size() + __builtin_popcount(mHotItemsPresent);
+}
+
+// mItems first, then the hot items
+const MetaData::typed_data &MetaData::itemAt(size_t index, uint32_t *key) const {
+    if (index < mItems.size()) {
+        *key = mItems.keyAt(index);
+        return mItems.valueAt(index);
+    }
+    index -= mItems.size();
+    size_t i = 0;
+    for (;; ++i) {
+        CHECK_LT(i, (size_t)kNumHotKeys);
+        if ((mHotItemsPresent & (1u << i)) && index-- == 0) {
+            break;
+        }
+    }
+    *key = kHotKeys[i];
+    return mHotItems[i];
 }
 
 bool MetaData::remove(uint32_t key) {
+    ssize_t hot = HotKeyIndex(key);
+    if (hot >= 0) {
+        if (!(mHotItemsPresent & (1u << hot))) {
+            return false;
+        }
+        mHotItems[hot].clear();
+        mHotItemsPresent &= ~(1u << hot);
+        return true;
+    }
+
     ssize_t i = mItems.indexOfKey(key);
 
     if (i < 0) {
@@ -192,6 +255,14 @@ bool MetaData::setData(
         uint32_t key, uint32_t type, const void *data, size_t size) {
     bool overwrote_existing = true;
 
+    ssize_t hot = HotKeyIndex(key);
+    if (hot >= 0) {
+        overwrote_existing = (mHotItemsPresent & (1u << hot)) != 0;
+        mHotItems[hot].setData(type, data, size);
+        mHotItemsPresent |= 1u << hot;
+        return overwrote_existing;
+    }
+
     ssize_t i = mItems.indexOfKey(key);
     if (i < 0) {
         typed_data item;
@@ -209,6 +280,15 @@ bool MetaData::setData(
 
 bool MetaData::findData(uint32_t key, uint32_t *type,
                         const void **data, size_t *size) const {
+    ssize_t hot = HotKeyIndex(key);
+    if (hot >= 0) {
+        if (!(mHotItemsPresent & (1u << hot))) {
+            return false;
+        }
+        mHotItems[hot].getData(type, data, size);
+        return true;
+    }
+
     ssize_t i = mItems.indexOfKey(key);
 
     if (i < 0) {
@@ -223,6 +303,11 @@ bool MetaData::findData(uint32_t key, uint32_t *type,
 }
 
 bool MetaData::hasData(uint32_t key) const {
+    ssize_t hot = HotKeyIndex(key);
+    if (hot >= 0) {
+        return (mHotItemsPresent & (1u << hot)) != 0;
+    }
+
     ssize_t i = mItems.indexOfKey(key);
 
     if (i < 0) {
@@ -243,11 +328,10 @@ MetaData::typed_data::~typed_data() {
 
 MetaData::typed_data::typed_data(const typed_data &from)
     : mType(from.mType),
-      mSize(0) {
-
-    void *dst = allocateStorage(from.mSize);
-    if (dst) {
-        memcpy(dst, from.storage(), mSize);
+      mSize(from.mSize),
+      u(from.u) {
+    if (!usesReservoir()) {
+        __sync_fetch_and_add(&u.ext_data->mRefCount, 1);
     }
 }
 
@@ -256,9 +340,10 @@ MetaData::typed_data &MetaData::typed_data::operator=(
     if (this != &from) {
         clear();
         mType = from.mType;
-        void *dst = allocateStorage(from.mSize);
-        if (dst) {
-            memcpy(dst, from.storage(), mSize);
+        mSize = from.mSize;
+        u = from.u;
+        if (!usesReservoir()) {
+            __sync_fetch_and_add(&u.ext_data->mRefCount, 1);
         }
     }
 
@@ -297,18 +382,22 @@ void *MetaData::typed_data::allocateStorage(size_t size) {
         return &u.reservoir;
     }
 
-    u.ext_data = malloc(mSize);
+    u.ext_data = (shared_storage *)malloc(sizeof(shared_storage) + mSize);
     if (u.ext_data == NULL) {
         ALOGE("Couldn't allocate %zu bytes for item", size);
         mSize = 0;
+        return NULL;
     }
-    return u.ext_data;
+    u.ext_data->mRefCount = 1;
+    return u.ext_data + 1;
 }
 
 void MetaData::typed_data::freeStorage() {
     if (!usesReservoir()) {
         if (u.ext_data) {
-            free(u.ext_data);
+            if (__sync_fetch_and_sub(&u.ext_data->mRefCount, 1) == 1) {
+                free(u.ext_data);
+            }
             u.ext_data = NULL;
         }
     }
@@ -369,11 +458,11 @@ static void MakeFourCCString(uint32_t x, char *s) {
 
 String8 MetaData::toString() const {
     String8 s;
-    for (int i = mItems.size(); --i >= 0;) {
-        int32_t key = mItems.keyAt(i);
+    for (int i = numItems(); --i >= 0;) {
+        uint32_t key;
+        const typed_data &item = itemAt(i, &key);
         char cc[5];
         MakeFourCCString(key, cc);
-        const typed_data &item = mItems.valueAt(i);
         s.appendFormat("%s: %s", cc, item.asString(false).string());
         if (i != 0) {
             s.append(", ");
@@ -382,25 +471,25 @@ String8 MetaData::toString() const {
     return s;
 }
 void MetaData::dumpToLog() const {
-    for (int i = mItems.size(); --i >= 0;) {
-        int32_t key = mItems.keyAt(i);
+    for (int i = numItems(); --i >= 0;) {
+        uint32_t key;
+        const typed_data &item = itemAt(i, &key);
         char cc[5];
         MakeFourCCString(key, cc);
-        const typed_data &item = mItems.valueAt(i);
         ALOGI("%s: %s", cc, item.asString(true /* verbose */).string());
     }
 }
 
 status_t MetaData::writeToParcel(Parcel &parcel) {
     status_t ret;
-    size_t numItems = mItems.size();
+    size_t numItems = this->numItems();
     ret = parcel.writeUint32(uint32_t(numItems));
     if (ret) {
         return ret;
     }
     for (size_t i = 0; i < numItems; i++) {
-        int32_t key = mItems.keyAt(i);
-        const typed_data &item = mItems.valueAt(i);
+        uint32_t key;
+        const typed_data &item = itemAt(i, &key);
         uint32_t type;
         const void *data;
         size_t size;
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "HTTPConnectionPool"
+#include <utils/Log.h>
+
+#include "include/HTTPConnectionPool.h"
+
+#include <cutils/properties.h>
+#include <media/IMediaHTTPConnection.h>
+#include <media/IMediaHTTPService.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <utils/List.h>
+#include <utils/Mutex.h>
+
+namespace android {
+
+static const int32_t kDefaultMaxIdleConnections = 4;
+
+// idle connections are dropped after this long
+static const int64_t kMaxIdleTimeUs = 60000000ll;
+
+struct IdleConnection {
+    sp<IBinder> mService;
+    sp<IMediaHTTPConnection> mConnection;
+    int64_t mIdleSinceUs;
+};
+
+static Mutex sPoolLock;
+static List<IdleConnection> sIdleConnections;
+static HTTPConnectionPool::Metrics sMetrics;
+
+static size_t MaxIdleConnections() {
+    int32_t size = property_get_int32(
+            "media.stagefright.http-pool-size", kDefaultMaxIdleConnections);
+    return size < 0 ? 0 : size;
+}
+
+static void DropExpired_l(int64_t nowUs) {
+    List<IdleConnection>::iterator it = sIdleConnections.begin();
+    while (it != sIdleConnections.end()) {
+        if (nowUs - (*it).mIdleSinceUs > kMaxIdleTimeUs) {
+            it = sIdleConnections.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// static
+sp<IMediaHTTPConnection> HTTPConnectionPool::Acquire(
+        const sp<IMediaHTTPService> &service) {
+    if (service == NULL) {
+        return NULL;
+    }
+
+    {
+        Mutex::Autolock autoLock(sPoolLock);
+        DropExpired_l(ALooper::GetNowUs());
+
+        sp<IBinder> binder = IInterface::asBinder(service);
+        for (List<IdleConnection>::iterator it = sIdleConnections.begin();
+                it != sIdleConnections.end(); ++it) {
+            if ((*it).mService == binder) {
+                sp<IMediaHTTPConnection> connection = (*it).mConnection;
+                sIdleConnections.erase(it);
+                ++sMetrics.mNumReused;
+                ALOGV("reusing connection (%d reused, %d created)",
+                        sMetrics.mNumReused, sMetrics.mNumCreated);
+                return connection;
+            }
+        }
+    }
+
+    sp<IMediaHTTPConnection> connection = service->makeHTTPConnection();
+    if (connection != NULL) {
+        Mutex::Autolock autoLock(sPoolLock);
+        ++sMetrics.mNumCreated;
+    }
+    return connection;
+}
+
+// static
+void HTTPConnectionPool::Release(
+        const sp<IMediaHTTPService> &service,
+        const sp<IMediaHTTPConnection> &connection) {
+    if (service == NULL || connection == NULL) {
+        return;
+    }
+
+    size_t maxIdle = MaxIdleConnections();
+    if (maxIdle == 0) {
+        return;
+    }
+
+    sp<IBinder> binder = IInterface::asBinder(service);
+    int64_t nowUs = ALooper::GetNowUs();
+
+    Mutex::Autolock autoLock(sPoolLock);
+    DropExpired_l(nowUs);
+
+    size_t count = 0;
+    List<IdleConnection>::iterator oldest = sIdleConnections.end();
+    for (List<IdleConnection>::iterator it = sIdleConnections.begin();
+            it != sIdleConnections.end(); ++it) {
+        if ((*it).mService == binder) {
+            if (count++ == 0) {
+                oldest = it;
+            }
+        }
+    }
+    if (count >= maxIdle) {
+        sIdleConnections.erase(oldest);
+    }
+
+    IdleConnection idle;
+    idle.mService = binder;
+    idle.mConnection = connection;
+    idle.mIdleSinceUs = nowUs;
+    sIdleConnections.push_back(idle);
+}
+
+// static
+void HTTPConnectionPool::RecordConnect(bool success, int64_t durationUs) {
+    Mutex::Autolock autoLock(sPoolLock);
+    ++sMetrics.mNumConnects;
+    if (!success) {
+        ++sMetrics.mNumFailedConnects;
+    }
+    sMetrics.mTotalConnectTimeUs += durationUs;
+
+    ALOGV("connect took %lld us (%d connects, %d failed, %lld us on average)",
+            (long long)durationUs, sMetrics.mNumConnects, sMetrics.mNumFailedConnects,
+            (long long)(sMetrics.mTotalConnectTimeUs / sMetrics.mNumConnects));
+}
+
+// static
+void HTTPConnectionPool::GetMetrics(Metrics *metrics) {
+    Mutex::Autolock autoLock(sPoolLock);
+    *metrics = sMetrics;
+}
+
+}  // namespace android
@@ -20,6 +20,8 @@
 
 #include <media/stagefright/MediaHTTP.h>
 
+#include "include/HTTPConnectionPool.h"
+
 #include <binder/IServiceManager.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
@@ -37,8 +39,25 @@ MediaHTTP::MediaHTTP(const sp<IMediaHTTPConnection> &conn)
       mDrmManagerClient(NULL) {
 }
 
+MediaHTTP::MediaHTTP(const sp<IMediaHTTPService> &service)
+    : mInitCheck(NO_INIT),
+      mHTTPService(service),
+      mHTTPConnection(HTTPConnectionPool::Acquire(service)),
+      mCachedSizeValid(false),
+      mCachedSize(0ll),
+      mDrmManagerClient(NULL) {
+    if (mHTTPConnection != NULL) {
+        mInitCheck = OK;
+    }
+}
+
 MediaHTTP::~MediaHTTP() {
     clearDRMState_l();
+
+    if (mHTTPService != NULL && mHTTPConnection != NULL) {
+        mHTTPConnection->disconnect();
+        HTTPConnectionPool::Release(mHTTPService, mHTTPConnection);
+    }
 }
 
 status_t MediaHTTP::connect(
@@ -63,7 +82,9 @@ status_t MediaHTTP::connect(
     // as part of the above assignment. Ensure no accidental later use.
     uri = NULL;
 
+    int64_t startTimeUs = ALooper::GetNowUs();
     bool success = mHTTPConnection->connect(mLastURI.c_str(), &extHeaders);
+    HTTPConnectionPool::RecordConnect(success, ALooper::GetNowUs() - startTimeUs);
 
     mLastHeaders = extHeaders;
 
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ABRPolicy"
+#include <utils/Log.h>
+
+#include "ABRPolicy.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+
+#include <math.h>
+#include <string.h>
+
+namespace android {
+
+struct ThroughputABRPolicy : public ABRPolicy {
+    ThroughputABRPolicy() {}
+
+    virtual const char *name() const {
+        return "throughput";
+    }
+
+    virtual size_t selectVariant(
+            const Input &input, const Vector<Variant> &variants) {
+        int32_t curBandwidth = variants[input.mCurIndex].mBandwidthBps;
+        int32_t bandwidthBps = input.mBandwidthBps;
+
+        // we only want to switch up when measured bw is 120% higher than
+        // current variant, and we only want to switch down when measured bw
+        // is below current variant.
+        bool canSwitchDown = input.mBufferLow && bandwidthBps < curBandwidth;
+        bool canSwitchUp = input.mBufferHigh && !input.mPreparing
+                && bandwidthBps > (int64_t)curBandwidth * 12 / 10;
+        if (!canSwitchDown && !canSwitchUp) {
+            return input.mCurIndex;
+        }
+
+        // bandwidth estimating has some delay, if we have to downswitch when
+        // it hasn't stabilized, use the short term to guess real bandwidth,
+        // since it may be dropping too fast.
+        if (!input.mBandwidthStable && canSwitchDown
+                && input.mShortTermBps < bandwidthBps) {
+            bandwidthBps = input.mShortTermBps;
+        }
+
+        // SelectByBandwidth() only uses 70% of the bandwidth, it may pick a
+        // lower variant when switching up, or a higher one when switching
+        // down; stay in both cases.
+        size_t index = SelectByBandwidth(variants, bandwidthBps);
+        if ((canSwitchUp && index > input.mCurIndex)
+                || (canSwitchDown && index < input.mCurIndex)) {
+            return index;
+        }
+        return input.mCurIndex;
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(ThroughputABRPolicy);
+};
+
+struct BOLAABRPolicy : public ABRPolicy {
+    BOLAABRPolicy() {}
+
+    virtual const char *name() const {
+        return "bola";
+    }
+
+    virtual size_t selectVariant(
+            const Input &input, const Vector<Variant> &variants) {
+        size_t index = SelectBOLA(input, variants);
+        if (index > input.mCurIndex && input.mPreparing) {
+            return input.mCurIndex;
+        }
+        return index;
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(BOLAABRPolicy);
+};
+
+struct HybridABRPolicy : public ABRPolicy {
+    HybridABRPolicy() {}
+
+    virtual const char *name() const {
+        return "hybrid";
+    }
+
+    virtual size_t selectVariant(
+            const Input &input, const Vector<Variant> &variants) {
+        size_t sustained = SelectByBandwidth(variants, input.mEstimatedBps);
+
+        size_t index;
+        if (input.mBufferedDurationUs < input.mMinBufferUs) {
+            // too little buffer for BOLA to tell the variants apart
+            index = sustained;
+        } else {
+            index = SelectBOLA(input, variants);
+            if (index > input.mCurIndex) {
+                index = sustained > input.mCurIndex
+                        ? (index < sustained ? index : sustained) : input.mCurIndex;
+            } else if (index < input.mCurIndex && sustained >= input.mCurIndex
+                    && !input.mBufferLow) {
+                index = input.mCurIndex;
+            }
+        }
+
+        if (index > input.mCurIndex && input.mPreparing) {
+            return input.mCurIndex;
+        }
+        return index;
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(HybridABRPolicy);
+};
+
+// static
+sp<ABRPolicy> ABRPolicy::Create(const char *name) {
+    if (name != NULL && !strcmp(name, "bola")) {
+        return new BOLAABRPolicy;
+    } else if (name != NULL && !strcmp(name, "hybrid")) {
+        return new HybridABRPolicy;
+    } else if (name != NULL && *name != '\0' && strcmp(name, "throughput")) {
+        ALOGW("unknown ABR policy '%s', using throughput", name);
+    }
+    return new ThroughputABRPolicy;
+}
+
+// static
+size_t ABRPolicy::SelectByBandwidth(
+        const Vector<Variant> &variants, int32_t bandwidthBps) {
+    // be conservative (70%) to avoid overestimating and immediately
+    // switching down again.
+    int64_t adjustedBandwidthBps = (int64_t)bandwidthBps * 7 / 10;
+
+    ssize_t lowest = 0;
+    for (size_t i = 0; i < variants.size(); ++i) {
+        if (variants[i].mValid) {
+            lowest = i;
+            break;
+        }
+    }
+
+    ssize_t index = variants.size() - 1;
+    while (index > lowest) {
+        const Variant &variant = variants[index];
+        if (variant.mBandwidthBps <= adjustedBandwidthBps && variant.mValid) {
+            break;
+        }
+        --index;
+    }
+    return index;
+}
+
+// BOLA-BASIC (Spiteri et al., "BOLA: Near-Optimal Bitrate Adaptation for
+// Online Videos"), in the form of dash.js: the utility of a variant is
+// ln(bitrate / lowest bitrate) + 1, and the variant maximizing
+// (V * (utility + gp) - buffer) / bitrate is picked, with V and gp set such
+// that the lowest variant is picked at the minimum buffer and the highest
+// one at the maximum buffer.
+// static
+size_t ABRPolicy::SelectBOLA(const Input &input, const Vector<Variant> &variants) {
+    ssize_t lowest = -1;
+    for (size_t i = 0; i < variants.size(); ++i) {
+        if (variants[i].mValid && variants[i].mBandwidthBps > 0) {
+            lowest = i;
+            break;
+        }
+    }
+    if (lowest < 0 || input.mMaxBufferUs <= input.mMinBufferUs
+            || input.mMinBufferUs <= 0) {
+        return input.mCurIndex;
+    }
+
+    double lowestBps = variants[lowest].mBandwidthBps;
+    double maxUtility = log(variants[variants.size() - 1].mBandwidthBps / lowestBps) + 1.0;
+    if (maxUtility <= 1.0) {
+        return input.mCurIndex;
+    }
+    double minBufferS = input.mMinBufferUs / 1E6;
+    double gp = (maxUtility - 1.0) / ((double)input.mMaxBufferUs / input.mMinBufferUs - 1.0);
+    double v = minBufferS / gp;
+    double bufferS = input.mBufferedDurationUs / 1E6;
+
+    size_t index = lowest;
+    double bestScore = 0.0;
+    for (size_t i = lowest; i < variants.size(); ++i) {
+        if (!variants[i].mValid) {
+            continue;
+        }
+        double bps = variants[i].mBandwidthBps;
+        double score = (v * (log(bps / lowestBps) + 1.0 + gp) - bufferS) / bps;
+        if (i == (size_t)lowest || score >= bestScore) {
+            bestScore = score;
+            index = i;
+        }
+    }
+
+    ALOGV("BOLA picks %zu at buffer %.2f s", index, bufferS);
+    return index;
+}
+
+}  // namespace android
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ABR_POLICY_H_
+
+#define ABR_POLICY_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Picks the variant LiveSession plays.  LiveSession asks the policy on every
+// buffering poll, and switches to the variant returned if it differs from
+// the current one.
+//
+// The policy is chosen with media.httplive.abr:
+//   "throughput" (default): switches down when the buffer is below the down
+//       switch mark and up when it is above the up switch mark, to the
+//       variant the estimated bandwidth sustains.
+//   "bola": buffer based, BOLA-BASIC with the logarithmic utility of the
+//       bitrates.
+//   "hybrid": uses the throughput while the buffer is below the minimum
+//       buffer, then BOLA, switching up no further than the throughput
+//       sustains, and down only once the throughput does not sustain the
+//       current variant either.
+struct ABRPolicy : public RefBase {
+    struct Variant {
+        int32_t mBandwidthBps;
+
+        // false if blacklisted after a failure
+        bool mValid;
+    };
+
+    struct Input {
+        // long term average of the measured bandwidth, its short term
+        // average and whether it is stable
+        int32_t mBandwidthBps;
+        int32_t mShortTermBps;
+        bool mBandwidthStable;
+
+        // smoothed estimate, minimum of the EWMAs and the harmonic mean of
+        // the recent measurements
+        int32_t mEstimatedBps;
+
+        // least buffered duration of the streams played
+        int64_t mBufferedDurationUs;
+        int64_t mMinBufferUs;
+        int64_t mMaxBufferUs;
+
+        // above the up switch mark, below the down switch mark
+        bool mBufferHigh;
+        bool mBufferLow;
+
+        // switching up is not allowed while preparing
+        bool mPreparing;
+
+        size_t mCurIndex;
+    };
+
+    static sp<ABRPolicy> Create(const char *name);
+
+    virtual const char *name() const = 0;
+
+    // variants are sorted by increasing bandwidth; returns input.mCurIndex
+    // to stay on the current variant.
+    virtual size_t selectVariant(
+            const Input &input, const Vector<Variant> &variants) = 0;
+
+    // Highest valid variant within 70% of bandwidthBps, to avoid switching
+    // down again right away; the lowest valid variant if none.
+    static size_t SelectByBandwidth(
+            const Vector<Variant> &variants, int32_t bandwidthBps);
+
+protected:
+    ABRPolicy() {}
+    virtual ~ABRPolicy() {}
+
+    static size_t SelectBOLA(const Input &input, const Vector<Variant> &variants);
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(ABRPolicy);
+};
+
+}  // namespace android
+
+#endif  // ABR_POLICY_H_
@@ -38,7 +38,7 @@ namespace android {
 HTTPDownloader::HTTPDownloader(
         const sp<IMediaHTTPService> &httpService,
         const KeyedVector<String8, String8> &headers) :
-    mHTTPDataSource(new MediaHTTP(httpService->makeHTTPConnection())),
+    mHTTPDataSource(new MediaHTTP(httpService)),
     mExtraHeaders(headers),
     mDisconnecting(false) {
 }
@@ -82,7 +82,8 @@ ssize_t HTTPDownloader::fetchBlock(
         int64_t range_offset, int64_t range_length,
         uint32_t block_size, /* download block size */
         String8 *actualUrl,
-        bool reconnect /* force connect HTTP when resuing source */) {
+        bool reconnect /* force connect HTTP when resuing source */,
+        bool partial) {
     if (isDisconnecting()) {
         return ERROR_NOT_CONNECTED;
     }
@@ -198,6 +199,10 @@ ssize_t HTTPDownloader::fetchBlock(
 
         buffer->setRange(0, buffer->size() + (size_t)n);
         bytesRead += n;
+
+        if (partial) {
+            break;
+        }
     }
 
     *out = buffer;
@@ -222,7 +227,8 @@ ssize_t HTTPDownloader::fetchFile(
 }
 
 sp<M3UParser> HTTPDownloader::fetchPlaylist(
-        const char *url, uint8_t *curPlaylistHash, bool *unchanged) {
+        const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+        const sp<M3UParser> &previous) {
     ALOGV("fetchPlaylist '%s'", url);
 
     *unchanged = false;
@@ -263,7 +269,7 @@ sp<M3UParser> HTTPDownloader::fetchPlaylist(
 #endif
 
     sp<M3UParser> playlist =
-        new M3UParser(actualUrl.string(), buffer->data(), buffer->size());
+        new M3UParser(actualUrl.string(), buffer->data(), buffer->size(), previous);
 
     if (playlist->initCheck() != OK) {
         ALOGE("failed to parse .m3u8 playlist");
@@ -50,6 +50,9 @@ struct HTTPDownloader : public RefBase {
     //
     // For reused HTTP sources, the caller must download a file sequentially without
     // any overlaps or gaps to prevent reconnection.
+    //
+    // If partial is set, returns as soon as the DataSource returned some
+    // content, rather than once the block is complete.
     ssize_t fetchBlock(
             const char *url,
             sp<ABuffer> *out,
@@ -57,7 +60,8 @@ struct HTTPDownloader : public RefBase {
             int64_t range_length, /* open file for range_length (-1: entire file) */
             uint32_t block_size,  /* download block size (0: entire range) */
             String8 *actualUrl,   /* returns actual URL */
-            bool reconnect        /* force connect http */
+            bool reconnect,       /* force connect http */
+            bool partial = false  /* return after the first read */
             );
 
     // simplified version to fetch a single file
@@ -66,9 +70,11 @@ struct HTTPDownloader : public RefBase {
             sp<ABuffer> *out,
             String8 *actualUrl = NULL);
 
-    // fetch a playlist file
+    // fetch a playlist file, parsed on top of the previous version of it
+    // if given (see M3UParser)
     sp<M3UParser> fetchPlaylist(
-            const char *url, uint8_t *curPlaylistHash, bool *unchanged);
+            const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+            const sp<M3UParser> &previous = NULL);
 
 private:
     sp<HTTPBase> mHTTPDataSource;
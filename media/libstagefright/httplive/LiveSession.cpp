@@ -39,6 +39,7 @@
 
 #include <ctype.h>
 #include <inttypes.h>
+#include <math.h>
 
 namespace android {
 
@@ -54,6 +55,13 @@ const int64_t LiveSession::kReadyMarkUs = 5000000ll;
 const int64_t LiveSession::kPrepareMarkUs = 1500000ll;
 const int64_t LiveSession::kUnderflowMarkUs = 1000000ll;
 
+const int64_t LiveSession::kMaxLastSessionBandwidthAgeUs = 600000000ll; // 10 min
+
+// bandwidth estimate at the end of the last session, and its time
+static Mutex sLastSessionLock;
+static int32_t sLastSessionBandwidthBps = -1;
+static int64_t sLastSessionTimeUs = -1ll;
+
 struct LiveSession::BandwidthEstimator : public RefBase {
     BandwidthEstimator();
 
@@ -63,6 +71,11 @@ struct LiveSession::BandwidthEstimator : public RefBase {
             bool *isStable = NULL,
             int32_t *shortTermBps = NULL);
 
+    // Smoothed estimate: the least of a fast and a slow EWMA of the
+    // measurements, weighted by their transfer time, and of the harmonic
+    // mean of the recent measurements without the outliers.
+    bool estimateSmoothedBandwidth(int32_t *bandwidthBps);
+
 private:
     // Bandwidth estimation parameters
     static const int32_t kShortTermBandwidthItems = 3;
@@ -71,6 +84,23 @@ private:
     static const int64_t kMaxBandwidthHistoryWindowUs = 30000000ll; // 30 sec
     static const int64_t kMaxBandwidthHistoryAgeUs = 60000000ll; // 60 sec
 
+    static const int64_t kFastEWMAHalfLifeUs = 2000000ll; // 2 sec
+    static const int64_t kSlowEWMAHalfLifeUs = 5000000ll; // 5 sec
+    // EWMAs are used once their weight exceeds this transfer time
+    static const int64_t kMinEWMAWeightUs = 500000ll;
+    static const size_t kHarmonicMeanItems = 10;
+    // measurements off the median by more than this factor are outliers
+    static const int32_t kOutlierFactor = 4;
+
+    struct EWMA {
+        double mEstimate;
+        double mTotalWeight;
+        double mHalfLifeS;
+
+        void add(double weightS, double value);
+        double get() const;
+    };
+
     struct BandwidthEntry {
         int64_t mTimestampUs;
         int64_t mDelayUs;
@@ -85,6 +115,9 @@ private:
     bool mIsStable;
     int64_t mTotalTransferTimeUs;
     size_t mTotalTransferBytes;
+    EWMA mFastEWMA;
+    EWMA mSlowEWMA;
+    List<int32_t> mRecentBps;
 
     DISALLOW_EVIL_CONSTRUCTORS(BandwidthEstimator);
 };
@@ -95,6 +128,21 @@ LiveSession::BandwidthEstimator::BandwidthEstimator() :
     mIsStable(true),
     mTotalTransferTimeUs(0),
     mTotalTransferBytes(0) {
+    mFastEWMA.mEstimate = mSlowEWMA.mEstimate = 0.0;
+    mFastEWMA.mTotalWeight = mSlowEWMA.mTotalWeight = 0.0;
+    mFastEWMA.mHalfLifeS = kFastEWMAHalfLifeUs / 1E6;
+    mSlowEWMA.mHalfLifeS = kSlowEWMAHalfLifeUs / 1E6;
+}
+
+void LiveSession::BandwidthEstimator::EWMA::add(double weightS, double value) {
+    double alpha = pow(0.5, weightS / mHalfLifeS);
+    mEstimate = value * (1.0 - alpha) + mEstimate * alpha;
+    mTotalWeight += weightS;
+}
+
+double LiveSession::BandwidthEstimator::EWMA::get() const {
+    // correct the bias towards the initial 0 estimate
+    return mEstimate / (1.0 - pow(0.5, mTotalWeight / mHalfLifeS));
 }
 
 void LiveSession::BandwidthEstimator::addBandwidthMeasurement(
@@ -111,6 +159,17 @@ void LiveSession::BandwidthEstimator::addBandwidthMeasurement(
     mBandwidthHistory.push_back(entry);
     mHasNewSample = true;
 
+    if (delayUs > 0) {
+        double bps = numBytes * 8E6 / delayUs;
+        mFastEWMA.add(delayUs / 1E6, bps);
+        mSlowEWMA.add(delayUs / 1E6, bps);
+
+        mRecentBps.push_back(bps > INT32_MAX ? INT32_MAX : (int32_t)bps);
+        while (mRecentBps.size() > kHarmonicMeanItems) {
+            mRecentBps.erase(mRecentBps.begin());
+        }
+    }
+
     // Remove no more than 10% of total transfer time at a time
     // to avoid sudden jump on bandwidth estimation. There might
     // be long blocking reads that takes up signification time,
@@ -223,6 +282,47 @@ bool LiveSession::BandwidthEstimator::estimateBandwidth(
     return true;
 }
 
+static int CompareBps(const int32_t *a, const int32_t *b) {
+    return *a < *b ? -1 : (*a > *b ? 1 : 0);
+}
+
+bool LiveSession::BandwidthEstimator::estimateSmoothedBandwidth(int32_t *bandwidthBps) {
+    AutoMutex autoLock(mLock);
+
+    if (mRecentBps.size() < 2 || mFastEWMA.mTotalWeight * 1E6 < kMinEWMAWeightUs) {
+        return false;
+    }
+
+    Vector<int32_t> sorted;
+    for (List<int32_t>::iterator it = mRecentBps.begin(); it != mRecentBps.end(); ++it) {
+        sorted.push(*it);
+    }
+    sorted.sort(CompareBps);
+    int64_t medianBps = sorted[sorted.size() / 2];
+
+    double inverseSum = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        int64_t bps = sorted[i];
+        if (bps <= 0 || bps * kOutlierFactor < medianBps
+                || bps > medianBps * kOutlierFactor) {
+            continue;
+        }
+        inverseSum += 1.0 / bps;
+        ++count;
+    }
+
+    double estimate = mFastEWMA.get();
+    if (mSlowEWMA.get() < estimate) {
+        estimate = mSlowEWMA.get();
+    }
+    if (count > 0 && count / inverseSum < estimate) {
+        estimate = count / inverseSum;
+    }
+    *bandwidthBps = estimate > INT32_MAX ? INT32_MAX : (int32_t)estimate;
+    return true;
+}
+
 //static
 const char *LiveSession::getKeyForStream(StreamType type) {
     switch (type) {
@@ -288,6 +388,7 @@ LiveSession::LiveSession(
       mLastBandwidthBps(-1ll),
       mLastBandwidthStable(false),
       mBandwidthEstimator(new BandwidthEstimator()),
+      mLastBufferedDurationUs(-1ll),
       mMaxWidth(720),
       mMaxHeight(480),
       mStreamMask(0),
@@ -314,6 +415,19 @@ LiveSession::LiveSession(
         mPacketSources.add(indexToType(i), new AnotherPacketSource(NULL /* meta */));
         mPacketSources2.add(indexToType(i), new AnotherPacketSource(NULL /* meta */));
     }
+
+    char value[PROPERTY_VALUE_MAX];
+    if (!property_get("media.httplive.abr", value, NULL)) {
+        value[0] = '\0';
+    }
+    mABRPolicy = ABRPolicy::Create(value);
+    ALOGV("using %s ABR policy", mABRPolicy->name());
+
+    memset(&mMetrics, 0, sizeof(mMetrics));
+    mMetrics.mConnectTimeUs = -1ll;
+    mMetrics.mStartupDelayUs = -1ll;
+    mMetrics.mRebufferStartTimeUs = -1ll;
+    mMetrics.mBitrateStartTimeUs = -1ll;
 }
 
 LiveSession::~LiveSession() {
@@ -983,6 +1097,11 @@ void LiveSession::onConnect(const sp<AMessage> &msg) {
     // TODO currently we don't know if we are coming here from incognito mode
     ALOGI("onConnect %s", uriDebugString(mMasterURL).c_str());
 
+    {
+        Mutex::Autolock autoLock(mMetricsLock);
+        mMetrics.mConnectTimeUs = ALooper::GetNowUs();
+    }
+
     KeyedVector<String8, String8> *headers = NULL;
     if (!msg->findPointer("headers", (void **)&headers)) {
         mExtraHeaders.clear();
@@ -1084,6 +1203,24 @@ void LiveSession::onMasterPlaylistFetched(const sp<AMessage> &msg) {
                 break;
             }
         }
+
+        // unless a recent session measured the bandwidth already
+        int32_t lastSessionBps = -1;
+        {
+            Mutex::Autolock autoLock(sLastSessionLock);
+            if (sLastSessionTimeUs >= 0 && ALooper::GetNowUs()
+                    - sLastSessionTimeUs < kMaxLastSessionBandwidthAgeUs) {
+                lastSessionBps = sLastSessionBandwidthBps;
+            }
+        }
+        if (lastSessionBps > 0) {
+            Vector<ABRPolicy::Variant> variants;
+            getVariants(&variants);
+            initialBandwidthIndex =
+                    ABRPolicy::SelectByBandwidth(variants, lastSessionBps);
+            ALOGV("last session estimated %.2f kbps, starting at %zu",
+                    lastSessionBps / 1024.0f, initialBandwidthIndex);
+        }
     } else {
         // dummy item.
         BandwidthItem item;
@@ -1103,6 +1240,29 @@ void LiveSession::onMasterPlaylistFetched(const sp<AMessage> &msg) {
 void LiveSession::finishDisconnect() {
     ALOGV("finishDisconnect");
 
+    int32_t estimatedBps;
+    if (mBandwidthEstimator->estimateSmoothedBandwidth(&estimatedBps)) {
+        Mutex::Autolock autoLock(sLastSessionLock);
+        sLastSessionBandwidthBps = estimatedBps;
+        sLastSessionTimeUs = ALooper::GetNowUs();
+    }
+
+    recordVariantChange(mOrigBandwidthIndex, -1);
+    sp<AMessage> metrics = getMetrics();
+    int32_t upSwitches, downSwitches, rebuffers, averageBitrate;
+    int64_t startupDelayUs, rebufferDurationUs;
+    CHECK(metrics->findInt64("startup-delay-us", &startupDelayUs));
+    CHECK(metrics->findInt32("up-switches", &upSwitches));
+    CHECK(metrics->findInt32("down-switches", &downSwitches));
+    CHECK(metrics->findInt32("rebuffers", &rebuffers));
+    CHECK(metrics->findInt64("rebuffer-duration-us", &rebufferDurationUs));
+    CHECK(metrics->findInt32("average-bitrate", &averageBitrate));
+    ALOGI("session metrics (%s): startup %lld ms, switches %d up %d down, "
+            "%d rebuffers for %lld ms, average bitrate %d",
+            mABRPolicy->name(), (long long)startupDelayUs / 1000,
+            upSwitches, downSwitches, rebuffers,
+            (long long)rebufferDurationUs / 1000, averageBitrate);
+
     // No reconfiguration is currently pending, make sure none will trigger
     // during disconnection either.
     cancelBandwidthSwitch();
@@ -1325,7 +1485,18 @@ ssize_t LiveSession::getLowestValidBandwidthIndex() const {
     return 0;
 }
 
-size_t LiveSession::getBandwidthIndex(int32_t bandwidthBps) {
+void LiveSession::getVariants(Vector<ABRPolicy::Variant> *variants) const {
+    variants->clear();
+    for (size_t i = 0; i < mBandwidthItems.size(); ++i) {
+        ABRPolicy::Variant variant;
+        variant.mBandwidthBps = mBandwidthItems[i].mBandwidth > INT32_MAX
+                ? INT32_MAX : (int32_t)mBandwidthItems[i].mBandwidth;
+        variant.mValid = isBandwidthValid(mBandwidthItems[i]);
+        variants->push(variant);
+    }
+}
+
+size_t LiveSession::getBandwidthIndex(const ABRPolicy::Input &input) {
     if (mBandwidthItems.size() < 2) {
         // shouldn't be here if we only have 1 bandwidth, check
         // logic to get rid of redundant bandwidth polling
@@ -1347,34 +1518,28 @@ size_t LiveSession::getBandwidthIndex(int32_t bandwidthBps) {
     }
 
     if (index < 0) {
+        ABRPolicy::Input capped = input;
         char value[PROPERTY_VALUE_MAX];
         if (property_get("media.httplive.max-bw", value, NULL)) {
             char *end;
             long maxBw = strtoul(value, &end, 10);
-            if (end > value && *end == '\0') {
-                if (maxBw > 0 && bandwidthBps > maxBw) {
+            if (end > value && *end == '\0' && maxBw > 0 && maxBw <= INT32_MAX) {
+                if (capped.mBandwidthBps > maxBw) {
                     ALOGV("bandwidth capped to %ld bps", maxBw);
-                    bandwidthBps = maxBw;
+                    capped.mBandwidthBps = maxBw;
+                }
+                if (capped.mShortTermBps > maxBw) {
+                    capped.mShortTermBps = maxBw;
+                }
+                if (capped.mEstimatedBps > maxBw) {
+                    capped.mEstimatedBps = maxBw;
                 }
             }
         }
 
-        // Pick the highest bandwidth stream that's not currently blacklisted
-        // below or equal to estimated bandwidth.
-
-        index = mBandwidthItems.size() - 1;
-        ssize_t lowestBandwidth = getLowestValidBandwidthIndex();
-        while (index > lowestBandwidth) {
-            // be conservative (70%) to avoid overestimating and immediately
-            // switching down again.
-            size_t adjustedBandwidthBps = bandwidthBps * 7 / 10;
-            const BandwidthItem &item = mBandwidthItems[index];
-            if (item.mBandwidth <= adjustedBandwidthBps
-                    && isBandwidthValid(item)) {
-                break;
-            }
-            --index;
-        }
+        Vector<ABRPolicy::Variant> variants;
+        getVariants(&variants);
+        index = mABRPolicy->selectVariant(capped, variants);
     }
 #elif 0
     // Change bandwidth at random()
@@ -1935,6 +2100,7 @@ void LiveSession::onChangeConfiguration3(const sp<AMessage> &msg) {
         if (mOrigBandwidthIndex != mCurBandwidthIndex) {
             ALOGV("#### Finished Bandwidth Switch Early: %zd => %zd",
                     mOrigBandwidthIndex, mCurBandwidthIndex);
+            recordVariantChange(mOrigBandwidthIndex, mCurBandwidthIndex);
             mOrigBandwidthIndex = mCurBandwidthIndex;
         }
     }
@@ -2031,6 +2197,7 @@ void LiveSession::tryToFinishBandwidthSwitch(const AString &oldUri) {
 
     ALOGI("#### Finished Bandwidth Switch: %zd => %zd",
             mOrigBandwidthIndex, mCurBandwidthIndex);
+    recordVariantChange(mOrigBandwidthIndex, mCurBandwidthIndex);
 
     mStreamMask = mNewStreamMask;
     mSwitchInProgress = false;
@@ -2148,6 +2315,7 @@ bool LiveSession::checkBuffering(
     size_t activeCount, underflowCount, readyCount, downCount, upCount;
     activeCount = underflowCount = readyCount = downCount = upCount =0;
     int32_t minBufferPercent = -1;
+    int64_t minBufferedDurationUs = -1ll;
     int64_t durationUs;
     if (getDuration(&durationUs) != OK) {
         durationUs = -1;
@@ -2184,6 +2352,11 @@ bool LiveSession::checkBuffering(
             }
         }
 
+        if (!mPacketSources[i]->isFinished(0) && (minBufferedDurationUs < 0
+                || bufferedDurationUs < minBufferedDurationUs)) {
+            minBufferedDurationUs = bufferedDurationUs;
+        }
+
         ++activeCount;
         int64_t readyMark = mInPreparationPhase ? kPrepareMarkUs : kReadyMarkUs;
         if (bufferedDurationUs > readyMark
@@ -2208,6 +2381,10 @@ bool LiveSession::checkBuffering(
     }
 
     if (activeCount > 0) {
+        // all finished, as much buffer as the policy could wish for
+        mLastBufferedDurationUs = minBufferedDurationUs >= 0
+                ? minBufferedDurationUs : PlaylistFetcher::kMinBufferedDurationUs;
+
         up        = (upCount == activeCount);
         down      = (downCount > 0);
         ready     = (readyCount == activeCount);
@@ -2224,6 +2401,12 @@ void LiveSession::startBufferingIfNecessary() {
     if (!mBuffering) {
         mBuffering = true;
 
+        if (!mInPreparationPhase) {
+            Mutex::Autolock autoLock(mMetricsLock);
+            ++mMetrics.mRebuffers;
+            mMetrics.mRebufferStartTimeUs = ALooper::GetNowUs();
+        }
+
         sp<AMessage> notify = mNotify->dup();
         notify->setInt32("what", kWhatBufferingStart);
         notify->post();
@@ -2237,6 +2420,15 @@ void LiveSession::stopBufferingIfNecessary() {
     if (mBuffering) {
         mBuffering = false;
 
+        {
+            Mutex::Autolock autoLock(mMetricsLock);
+            if (mMetrics.mRebufferStartTimeUs >= 0) {
+                mMetrics.mRebufferDurationUs +=
+                        ALooper::GetNowUs() - mMetrics.mRebufferStartTimeUs;
+                mMetrics.mRebufferStartTimeUs = -1ll;
+            }
+        }
+
         sp<AMessage> notify = mNotify->dup();
         notify->setInt32("what", kWhatBufferingEnd);
         notify->post();
@@ -2316,40 +2508,33 @@ bool LiveSession::switchBandwidthIfNeeded(bool bufferHigh, bool bufferLow) {
         return false;
     }
 
-    int32_t curBandwidth = mBandwidthItems.itemAt(mCurBandwidthIndex).mBandwidth;
-    // canSwithDown and canSwitchUp can't both be true.
-    // we only want to switch up when measured bw is 120% higher than current variant,
-    // and we only want to switch down when measured bw is below current variant.
-    bool canSwitchDown = bufferLow
-            && (bandwidthBps < (int32_t)curBandwidth);
-    bool canSwitchUp = bufferHigh
-            && (bandwidthBps > (int32_t)curBandwidth * 12 / 10);
-
-    if (canSwitchDown || canSwitchUp) {
-        // bandwidth estimating has some delay, if we have to downswitch when
-        // it hasn't stabilized, use the short term to guess real bandwidth,
-        // since it may be dropping too fast.
-        // (note this doesn't apply to upswitch, always use longer average there)
-        if (!isStable && canSwitchDown) {
-            if (shortTermBps < bandwidthBps) {
-                bandwidthBps = shortTermBps;
-            }
-        }
-
-        ssize_t bandwidthIndex = getBandwidthIndex(bandwidthBps);
-
-        // it's possible that we're checking for canSwitchUp case, but the returned
-        // bandwidthIndex is < mCurBandwidthIndex, as getBandwidthIndex() only uses 70%
-        // of measured bw. In that case we don't want to do anything, since we have
-        // both enough buffer and enough bw.
-        if ((canSwitchUp && bandwidthIndex > mCurBandwidthIndex)
-         || (canSwitchDown && bandwidthIndex < mCurBandwidthIndex)) {
-            // if not yet prepared, just restart again with new bw index.
-            // this is faster and playback experience is cleaner.
-            changeConfiguration(
-                    mInPreparationPhase ? 0 : -1ll, bandwidthIndex);
-            return true;
-        }
+    ABRPolicy::Input input;
+    input.mBandwidthBps = bandwidthBps;
+    input.mShortTermBps = shortTermBps;
+    input.mBandwidthStable = isStable;
+    if (!mBandwidthEstimator->estimateSmoothedBandwidth(&input.mEstimatedBps)) {
+        input.mEstimatedBps = isStable || shortTermBps > bandwidthBps
+                ? bandwidthBps : shortTermBps;
+    }
+    input.mBufferedDurationUs = mLastBufferedDurationUs;
+    input.mMinBufferUs = kReadyMarkUs;
+    input.mMaxBufferUs = PlaylistFetcher::kMinBufferedDurationUs;
+    input.mBufferHigh = bufferHigh;
+    input.mBufferLow = bufferLow;
+    input.mPreparing = mInPreparationPhase;
+    input.mCurIndex = mCurBandwidthIndex;
+
+    ssize_t bandwidthIndex = getBandwidthIndex(input);
+    if (bandwidthIndex != mCurBandwidthIndex) {
+        ALOGV("%s policy switches %zd => %zd (estimated %.2f kbps, buffered %lld us)",
+                mABRPolicy->name(), mCurBandwidthIndex, bandwidthIndex,
+                input.mEstimatedBps / 1024.0f, (long long)input.mBufferedDurationUs);
+
+        // if not yet prepared, just restart again with new bw index.
+        // this is faster and playback experience is cleaner.
+        changeConfiguration(
+                mInPreparationPhase ? 0 : -1ll, bandwidthIndex);
+        return true;
     }
     return false;
 }
@@ -2386,6 +2571,51 @@ void LiveSession::postPrepared(status_t err) {
     notify->post();
 
     mInPreparationPhase = false;
+
+    Mutex::Autolock autoLock(mMetricsLock);
+    if (mMetrics.mConnectTimeUs >= 0) {
+        mMetrics.mStartupDelayUs = ALooper::GetNowUs() - mMetrics.mConnectTimeUs;
+    }
+}
+
+void LiveSession::recordVariantChange(ssize_t prevIndex, ssize_t newIndex) {
+    Mutex::Autolock autoLock(mMetricsLock);
+
+    int64_t nowUs = ALooper::GetNowUs();
+    if (prevIndex >= 0 && (size_t)prevIndex < mBandwidthItems.size()
+            && mMetrics.mBitrateStartTimeUs >= 0) {
+        int64_t durationUs = nowUs - mMetrics.mBitrateStartTimeUs;
+        mMetrics.mBitrateTimeProduct +=
+                (double)mBandwidthItems[prevIndex].mBandwidth * durationUs;
+        mMetrics.mBitrateDurationUs += durationUs;
+    }
+    mMetrics.mBitrateStartTimeUs = newIndex >= 0 ? nowUs : -1ll;
+
+    if (prevIndex >= 0 && newIndex > prevIndex) {
+        ++mMetrics.mUpSwitches;
+    } else if (newIndex >= 0 && newIndex < prevIndex) {
+        ++mMetrics.mDownSwitches;
+    }
+}
+
+sp<AMessage> LiveSession::getMetrics() const {
+    Mutex::Autolock autoLock(mMetricsLock);
+
+    sp<AMessage> metrics = new AMessage;
+    metrics->setInt64("startup-delay-us", mMetrics.mStartupDelayUs);
+    metrics->setInt32("up-switches", mMetrics.mUpSwitches);
+    metrics->setInt32("down-switches", mMetrics.mDownSwitches);
+    metrics->setInt32("rebuffers", mMetrics.mRebuffers);
+
+    int64_t rebufferDurationUs = mMetrics.mRebufferDurationUs;
+    if (mMetrics.mRebufferStartTimeUs >= 0) {
+        rebufferDurationUs += ALooper::GetNowUs() - mMetrics.mRebufferStartTimeUs;
+    }
+    metrics->setInt64("rebuffer-duration-us", rebufferDurationUs);
+
+    metrics->setInt32("average-bitrate", mMetrics.mBitrateDurationUs > 0
+            ? (int32_t)(mMetrics.mBitrateTimeProduct / mMetrics.mBitrateDurationUs) : 0);
+    return metrics;
 }
 
 
@@ -22,7 +22,9 @@
 #include <media/mediaplayer.h>
 
 #include <utils/String8.h>
+#include <utils/threads.h>
 
+#include "ABRPolicy.h"
 #include "mpeg2ts/ATSParser.h"
 
 namespace android {
@@ -97,6 +99,11 @@ struct LiveSession : public AHandler {
     bool isSeekable() const;
     bool hasDynamicDuration() const;
 
+    // Playback quality of the session so far: "startup-delay-us",
+    // "up-switches", "down-switches", "rebuffers", "rebuffer-duration-us" and
+    // "average-bitrate".
+    sp<AMessage> getMetrics() const;
+
     static const char *getKeyForStream(StreamType type);
     static const char *getNameForStream(StreamType type);
     static ATSParser::SourceType getSourceTypeForStream(StreamType type);
@@ -142,6 +149,10 @@ private:
     static const int64_t kPrepareMarkUs;
     static const int64_t kUnderflowMarkUs;
 
+    // the bandwidth estimate of the last session is used to pick the
+    // initial variant if it is no older than this
+    static const int64_t kMaxLastSessionBandwidthAgeUs;
+
     struct BandwidthEstimator;
     struct BandwidthItem {
         size_t mPlaylistIndex;
@@ -202,6 +213,27 @@ private:
     int32_t mLastBandwidthBps;
     bool mLastBandwidthStable;
     sp<BandwidthEstimator> mBandwidthEstimator;
+    sp<ABRPolicy> mABRPolicy;
+
+    // least buffered duration of the streams played, at the last poll
+    int64_t mLastBufferedDurationUs;
+
+    struct Metrics {
+        int64_t mConnectTimeUs;
+        int64_t mStartupDelayUs;
+        int32_t mUpSwitches;
+        int32_t mDownSwitches;
+        int32_t mRebuffers;
+        int64_t mRebufferStartTimeUs;
+        int64_t mRebufferDurationUs;
+
+        // time weighted bitrate of the variants played
+        int64_t mBitrateStartTimeUs;
+        double mBitrateTimeProduct;
+        int64_t mBitrateDurationUs;
+    };
+    mutable Mutex mMetricsLock;
+    Metrics mMetrics;
 
     sp<M3UParser> mPlaylist;
     int32_t mMaxWidth;
@@ -269,7 +301,8 @@ private:
     float getAbortThreshold(
             ssize_t currentBWIndex, ssize_t targetBWIndex) const;
     void addBandwidthMeasurement(size_t numBytes, int64_t delayUs);
-    size_t getBandwidthIndex(int32_t bandwidthBps);
+    void getVariants(Vector<ABRPolicy::Variant> *variants) const;
+    size_t getBandwidthIndex(const ABRPolicy::Input &input);
     ssize_t getLowestValidBandwidthIndex() const;
     HLSTime latestMediaSegmentStartTime() const;
 
@@ -302,6 +335,9 @@ private:
     void stopBufferingIfNecessary();
     void notifyBufferingUpdate(int32_t percentage);
 
+    // prevIndex or newIndex is -1 when the session starts or ends
+    void recordVariantChange(ssize_t prevIndex, ssize_t newIndex);
+
     void finishDisconnect();
 
     void postPrepared(status_t err);
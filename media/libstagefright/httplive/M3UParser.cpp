@@ -243,7 +243,8 @@ bool M3UParser::MediaGroup::getActiveURI(AString *uri) const {
 ////////////////////////////////////////////////////////////////////////////////
 
 M3UParser::M3UParser(
-        const char *baseURI, const void *data, size_t size)
+        const char *baseURI, const void *data, size_t size,
+        const sp<M3UParser> &previous)
     : mInitCheck(NO_INIT),
       mBaseURI(baseURI),
       mIsExtM3U(false),
@@ -255,8 +256,12 @@ M3UParser::M3UParser(
       mTargetDurationUs(-1ll),
       mDiscontinuitySeq(0),
       mDiscontinuityCount(0),
+      mCanSkipUntilUs(-1ll),
+      mNumSharedItems(0),
       mSelectedIndex(-1) {
-    mInitCheck = parse(data, size);
+    mInitCheck = parse(data, size, previous);
+    ALOGV("%zu of %zu items from the previous playlist",
+            mNumSharedItems, mItems.size());
 }
 
 M3UParser::~M3UParser() {
@@ -299,6 +304,10 @@ void M3UParser::getSeqNumberRange(int32_t *firstSeq, int32_t *lastSeq) const {
     *lastSeq = mLastSeqNumber;
 }
 
+int64_t M3UParser::getCanSkipUntilUs() const {
+    return mCanSkipUntilUs;
+}
+
 sp<AMessage> M3UParser::meta() {
     return mMeta;
 }
@@ -544,14 +553,156 @@ static bool MakeURL(const char *baseURL, const char *url, AString *out) {
     return true;
 }
 
-status_t M3UParser::parse(const void *_data, size_t size) {
+// FNV-1a, which relies on wrapping arithmetic
+__attribute__((no_sanitize("integer")))
+static uint64_t HashEntry(const char *data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 0x100000001b3ull;
+    }
+    // 0 marks the items that can't be shared
+    return hash != 0 ? hash : 1;
+}
+
+// Relative URIs resolve the same against both, the query string aside.
+static bool IsSameBaseURI(const AString &a, const AString &b) {
+    ssize_t aEnd = a.find("?");
+    ssize_t bEnd = b.find("?");
+    size_t aLength = aEnd < 0 ? a.size() : (size_t)aEnd;
+    size_t bLength = bEnd < 0 ? b.size() : (size_t)bEnd;
+    return aLength == bLength && !strncmp(a.c_str(), b.c_str(), aLength);
+}
+
+static bool StartsWith(const char *data, size_t size, const char *prefix) {
+    size_t length = strlen(prefix);
+    return size >= length && !strncmp(data, prefix, length);
+}
+
+const M3UParser::Item *M3UParser::findPreviousItem(
+        const sp<M3UParser> &previous, int32_t seqNumber) const {
+    if (seqNumber < previous->mFirstSeqNumber || seqNumber > previous->mLastSeqNumber) {
+        return NULL;
+    }
+    return &previous->mItems.itemAt(seqNumber - previous->mFirstSeqNumber);
+}
+
+void M3UParser::addItem(const Item &item) {
+    mItems.push(item);
+
+    int32_t discontinuity;
+    if (item.mMeta->findInt32("discontinuity", &discontinuity) && discontinuity) {
+        ++mDiscontinuityCount;
+    }
+}
+
+// Takes the item of the previous playlist for the segment at *offset if its
+// lines are the same, and moves *offset past them.  Segments with tags that
+// depend on the segments before them (byte ranges) are parsed again.
+bool M3UParser::shareItem(
+        const sp<M3UParser> &previous,
+        const char *data, size_t size, size_t *offset) {
+    size_t end = *offset;
+    bool discontinuity = false;
+    for (;;) {
+        if (end >= size) {
+            return false;
+        }
+        size_t endLF = end;
+        while (endLF < size && data[endLF] != '\n') {
+            ++endLF;
+        }
+        const char *line = &data[end];
+        size_t length = endLF - end;
+        end = endLF + 1;
+
+        if (length == 0 || (length == 1 && line[0] == '\r')) {
+            continue;
+        }
+        if (line[0] != '#') {
+            break;
+        }
+        if (StartsWith(line, length, "#EXT-X-DISCONTINUITY-SEQUENCE")) {
+            return false;
+        } else if (StartsWith(line, length, "#EXT-X-DISCONTINUITY")) {
+            discontinuity = true;
+        } else if (!StartsWith(line, length, "#EXTINF")
+                && !StartsWith(line, length, "#EXT-X-KEY")
+                && StartsWith(line, length, "#EXT")) {
+            return false;
+        }
+    }
+    if (end > size) {
+        end = size;
+    }
+
+    int32_t seqNumber = 0;
+    mMeta->findInt32("media-sequence", &seqNumber);
+    seqNumber += mItems.size();
+
+    const Item *item = findPreviousItem(previous, seqNumber);
+    if (item == NULL || item->mEntryHash == 0
+            || item->mEntryHash != HashEntry(&data[*offset], end - *offset)) {
+        return false;
+    }
+
+    int32_t discontinuitySeq;
+    if (!item->mMeta->findInt32("discontinuity-sequence", &discontinuitySeq)
+            || (size_t)discontinuitySeq != mDiscontinuitySeq + mDiscontinuityCount
+                    + (discontinuity ? 1 : 0)) {
+        return false;
+    }
+
+    addItem(*item);
+    ++mNumSharedItems;
+    *offset = end;
+    return true;
+}
+
+// EXT-X-SKIP:SKIPPED-SEGMENTS=<n> stands for the n segments from the media
+// sequence on, which the previous playlist must have.
+status_t M3UParser::copySkippedItems(
+        const AString &line, const sp<M3UParser> &previous) {
+    ssize_t pos = line.find("SKIPPED-SEGMENTS=");
+    int32_t count;
+    if (pos < 0 || ParseInt32(line.c_str() + pos + strlen("SKIPPED-SEGMENTS="), &count) != OK
+            || count < 0 || mMeta == NULL || !mItems.empty()) {
+        return ERROR_MALFORMED;
+    }
+
+    int32_t seqNumber = 0;
+    mMeta->findInt32("media-sequence", &seqNumber);
+    for (int32_t i = 0; i < count; ++i) {
+        const Item *item = previous == NULL ? NULL : findPreviousItem(previous, seqNumber + i);
+        if (item == NULL) {
+            ALOGE("delta update skipped segment %d we don't have", seqNumber + i);
+            return ERROR_MALFORMED;
+        }
+        addItem(*item);
+    }
+    mNumSharedItems += count;
+    return OK;
+}
+
+status_t M3UParser::parse(
+        const void *_data, size_t size, const sp<M3UParser> &_previous) {
     int32_t lineNo = 0;
 
     sp<AMessage> itemMeta;
 
+    // items can only be shared between versions of the same media playlist
+    sp<M3UParser> previous = _previous;
+    if (previous != NULL && (previous->mIsVariantPlaylist
+            || previous->initCheck() != OK
+            || !IsSameBaseURI(previous->mBaseURI, mBaseURI))) {
+        previous.clear();
+    }
+
     const char *data = (const char *)_data;
     size_t offset = 0;
+    size_t entryOffset = 0;
     uint64_t segmentRangeOffset = 0;
+    bool entryShareable = true;
     while (offset < size) {
         size_t offsetLF = offset;
         while (offsetLF < size && data[offsetLF] != '\n') {
@@ -576,6 +727,16 @@ status_t M3UParser::parse(const void *_data, size_t size) {
             mIsExtM3U = true;
         }
 
+        if (mIsExtM3U && !mIsVariantPlaylist && itemMeta == NULL
+                && mMeta != NULL && line.startsWith("#EXTINF")) {
+            entryOffset = offset;
+            entryShareable = true;
+            if (previous != NULL && shareItem(previous, data, size, &offset)) {
+                ++lineNo;
+                continue;
+            }
+        }
+
         if (mIsExtM3U) {
             status_t err = OK;
 
@@ -635,6 +796,7 @@ status_t M3UParser::parse(const void *_data, size_t size) {
                     return ERROR_MALFORMED;
                 }
 
+                entryShareable = false;
                 uint64_t length, offset;
                 err = parseByteRange(line, segmentRangeOffset, &length, &offset);
 
@@ -650,6 +812,13 @@ status_t M3UParser::parse(const void *_data, size_t size) {
                 }
             } else if (line.startsWith("#EXT-X-MEDIA")) {
                 err = parseMedia(line);
+            } else if (line.startsWith("#EXT-X-SERVER-CONTROL")) {
+                err = parseCanSkipUntil(line, &mCanSkipUntilUs);
+            } else if (line.startsWith("#EXT-X-SKIP")) {
+                if (mIsVariantPlaylist) {
+                    return ERROR_MALFORMED;
+                }
+                err = copySkippedItems(line, previous);
             }
 
             if (err != OK) {
@@ -674,6 +843,14 @@ status_t M3UParser::parse(const void *_data, size_t size) {
             CHECK(MakeURL(mBaseURI.c_str(), line.c_str(), &item->mURI));
 
             item->mMeta = itemMeta;
+            item->mEntryHash = 0;
+            if (!mIsVariantPlaylist && entryShareable && entryOffset < offset
+                    && data[entryOffset] == '#') {
+                size_t end = offsetLF < size ? offsetLF + 1 : size;
+                item->mEntryHash = HashEntry(&data[entryOffset], end - entryOffset);
+            }
+            entryOffset = offsetLF + 1;
+            entryShareable = true;
 
             itemMeta.clear();
         }
@@ -1276,6 +1453,24 @@ status_t M3UParser::parseDiscontinuitySequence(const AString &line, size_t *seq)
     return OK;
 }
 
+// static
+status_t M3UParser::parseCanSkipUntil(const AString &line, int64_t *durationUs) {
+    ssize_t pos = line.find("CAN-SKIP-UNTIL=");
+    if (pos < 0) {
+        // other server controls aren't used
+        return OK;
+    }
+
+    double x;
+    status_t err = ParseDouble(line.c_str() + pos + strlen("CAN-SKIP-UNTIL="), &x);
+    if (err != OK || x <= 0) {
+        return ERROR_MALFORMED;
+    }
+
+    *durationUs = (int64_t)(x * 1E6);
+    return OK;
+}
+
 // static
 status_t M3UParser::ParseInt32(const char *s, int32_t *x) {
     char *end;
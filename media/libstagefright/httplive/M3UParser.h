@@ -27,7 +27,12 @@
 namespace android {
 
 struct M3UParser : public RefBase {
-    M3UParser(const char *baseURI, const void *data, size_t size);
+    // previous is the last version of the same media playlist, if any: the
+    // segments the playlists have in common share their items instead of
+    // being parsed again, and the segments a delta update (EXT-X-SKIP)
+    // skipped are taken from it.
+    M3UParser(const char *baseURI, const void *data, size_t size,
+            const sp<M3UParser> &previous = NULL);
 
     status_t initCheck() const;
 
@@ -40,6 +45,10 @@ struct M3UParser : public RefBase {
     int32_t getFirstSeqNumber() const;
     void getSeqNumberRange(int32_t *firstSeq, int32_t *lastSeq) const;
 
+    // Age of the segments a delta update may skip, from
+    // EXT-X-SERVER-CONTROL:CAN-SKIP-UNTIL, -1 if the server offers none.
+    int64_t getCanSkipUntilUs() const;
+
     sp<AMessage> meta();
 
     size_t size();
@@ -64,6 +73,10 @@ private:
     struct Item {
         AString mURI;
         sp<AMessage> mMeta;
+
+        // hash of the lines of the segment, 0 for items that can't be
+        // shared
+        uint64_t mEntryHash;
     };
 
     status_t mInitCheck;
@@ -78,6 +91,10 @@ private:
     int64_t mTargetDurationUs;
     size_t mDiscontinuitySeq;
     int32_t mDiscontinuityCount;
+    int64_t mCanSkipUntilUs;
+
+    // items shared with, or copied from, the previous playlist
+    size_t mNumSharedItems;
 
     sp<AMessage> mMeta;
     Vector<Item> mItems;
@@ -86,7 +103,16 @@ private:
     // Media groups keyed by group ID.
     KeyedVector<AString, sp<MediaGroup> > mMediaGroups;
 
-    status_t parse(const void *data, size_t size);
+    status_t parse(const void *data, size_t size, const sp<M3UParser> &previous);
+
+    const Item *findPreviousItem(
+            const sp<M3UParser> &previous, int32_t seqNumber) const;
+    bool shareItem(
+            const sp<M3UParser> &previous,
+            const char *data, size_t size, size_t *offset);
+    status_t copySkippedItems(
+            const AString &line, const sp<M3UParser> &previous);
+    void addItem(const Item &item);
 
     static status_t parseMetaData(
             const AString &line, sp<AMessage> *meta, const char *key);
@@ -108,6 +134,8 @@ private:
 
     static status_t parseDiscontinuitySequence(const AString &line, size_t *seq);
 
+    static status_t parseCanSkipUntil(const AString &line, int64_t *durationUs);
+
     static status_t ParseInt32(const char *s, int32_t *x);
     static status_t ParseDouble(const char *s, double *x);
 
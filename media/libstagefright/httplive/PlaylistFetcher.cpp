@@ -27,9 +27,11 @@
 #include "include/ID3.h"
 #include "mpeg2ts/AnotherPacketSource.h"
 
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ABitReader.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
@@ -49,6 +51,7 @@ const int64_t PlaylistFetcher::kMinBufferedDurationUs = 30000000ll;
 const int64_t PlaylistFetcher::kMaxMonitorDelayUs = 3000000ll;
 // LCM of 188 (size of a TS packet) & 1k works well
 const int32_t PlaylistFetcher::kDownloadBlockSize = 47 * 1024;
+const size_t PlaylistFetcher::kDefaultNumPrefetchSegments = 2;
 
 struct PlaylistFetcher::DownloadState : public RefBase {
     DownloadState();
@@ -136,6 +139,119 @@ void PlaylistFetcher::DownloadState::saveState(
     mLastSeqNumberInPlaylist = lastSeqNumberInPlaylist;
 }
 
+// Downloads segments, and the keys they need, over a connection of its own,
+// on its own looper.  Downloads posted before a cancel() are dropped.
+struct PlaylistFetcher::Prefetcher : public AHandler {
+    Prefetcher(
+            const sp<AMessage> &notify, const sp<HTTPDownloader> &downloader,
+            int32_t generation);
+
+    void fetchAsync(
+            int32_t generation, int32_t seqNumber, const AString &uri,
+            int64_t rangeOffset, int64_t rangeLength, const AString &keyURI);
+
+    // Aborts the download in progress and drops the ones older than
+    // generation.
+    void cancel(int32_t generation);
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatFetch = 'ftch',
+    };
+
+    sp<AMessage> mNotify;
+    sp<HTTPDownloader> mHTTPDownloader;
+
+    Mutex mLock;
+    int32_t mGeneration;
+
+    DISALLOW_EVIL_CONSTRUCTORS(Prefetcher);
+};
+
+PlaylistFetcher::Prefetcher::Prefetcher(
+        const sp<AMessage> &notify, const sp<HTTPDownloader> &downloader,
+        int32_t generation)
+    : mNotify(notify),
+      mHTTPDownloader(downloader),
+      mGeneration(generation) {
+}
+
+void PlaylistFetcher::Prefetcher::fetchAsync(
+        int32_t generation, int32_t seqNumber, const AString &uri,
+        int64_t rangeOffset, int64_t rangeLength, const AString &keyURI) {
+    sp<AMessage> msg = new AMessage(kWhatFetch, this);
+    msg->setInt32("generation", generation);
+    msg->setInt32("seqNumber", seqNumber);
+    msg->setString("uri", uri.c_str());
+    msg->setInt64("rangeOffset", rangeOffset);
+    msg->setInt64("rangeLength", rangeLength);
+    msg->setString("keyURI", keyURI.c_str());
+    msg->post();
+}
+
+void PlaylistFetcher::Prefetcher::cancel(int32_t generation) {
+    AutoMutex _l(mLock);
+    mGeneration = generation;
+    mHTTPDownloader->disconnect();
+}
+
+void PlaylistFetcher::Prefetcher::onMessageReceived(const sp<AMessage> &msg) {
+    CHECK_EQ(msg->what(), (uint32_t)kWhatFetch);
+
+    int32_t generation, seqNumber;
+    AString uri, keyURI;
+    int64_t rangeOffset, rangeLength;
+    CHECK(msg->findInt32("generation", &generation));
+    CHECK(msg->findInt32("seqNumber", &seqNumber));
+    CHECK(msg->findString("uri", &uri));
+    CHECK(msg->findInt64("rangeOffset", &rangeOffset));
+    CHECK(msg->findInt64("rangeLength", &rangeLength));
+    CHECK(msg->findString("keyURI", &keyURI));
+
+    {
+        AutoMutex _l(mLock);
+        if (generation != mGeneration) {
+            return;
+        }
+        // undo the disconnect of the last cancel()
+        mHTTPDownloader->reconnect();
+    }
+
+    ssize_t err = OK;
+    sp<ABuffer> key;
+    if (!keyURI.empty()) {
+        err = mHTTPDownloader->fetchFile(keyURI.c_str(), &key);
+    }
+
+    sp<ABuffer> buffer;
+    int64_t startUs = ALooper::GetNowUs();
+    if (err >= 0) {
+        err = mHTTPDownloader->fetchBlock(
+                uri.c_str(), &buffer, rangeOffset, rangeLength,
+                0 /* block_size */, NULL /* actualUrl */, true /* reconnect */);
+    }
+    int64_t delayUs = ALooper::GetNowUs() - startUs;
+
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("generation", generation);
+    notify->setInt32("seqNumber", seqNumber);
+    notify->setInt32("err", err < 0 ? (status_t)err : OK);
+    if (err >= 0) {
+        notify->setBuffer("buffer", buffer);
+        notify->setInt64("delayUs", delayUs);
+        if (key != NULL) {
+            notify->setString("keyURI", keyURI.c_str());
+            notify->setBuffer("key", key);
+        }
+    }
+    notify->post();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 PlaylistFetcher::PlaylistFetcher(
         const sp<AMessage> &notify,
         const sp<LiveSession> &session,
@@ -169,12 +285,32 @@ PlaylistFetcher::PlaylistFetcher(
       mVideoBuffer(new AnotherPacketSource(NULL)),
       mThresholdRatio(-1.0f),
       mDownloadState(new DownloadState()),
-      mHasMetadata(false) {
+      mHasMetadata(false),
+      mMaxNumPrefetchSegments(kDefaultNumPrefetchSegments),
+      mPrefetchGeneration(0),
+      mLastBufferedDurationUs(0ll),
+      mPrefetchWaitGeneration(-1),
+      mChunkedParsing(property_get_bool("media.httplive.chunked-parsing", true)) {
     memset(mPlaylistHash, 0, sizeof(mPlaylistHash));
     mHTTPDownloader = mSession->getHTTPDownloader();
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.prefetch-segments", value, NULL)) {
+        char *end;
+        unsigned long n = strtoul(value, &end, 10);
+        if (end != value && *end == '\0') {
+            mMaxNumPrefetchSegments =
+                n < kMaxNumPrefetchSegments ? n : kMaxNumPrefetchSegments;
+        }
+    }
 }
 
 PlaylistFetcher::~PlaylistFetcher() {
+    for (size_t i = 0; i < mPrefetchers.size(); ++i) {
+        mPrefetchers[i]->cancel(mPrefetchGeneration + 1);
+        mPrefetchLoopers[i]->unregisterHandler(mPrefetchers[i]->id());
+        mPrefetchLoopers[i]->stop();
+    }
 }
 
 int32_t PlaylistFetcher::getFetcherID() const {
@@ -345,10 +481,13 @@ status_t PlaylistFetcher::decryptBuffer(
         mAESKeyForURI.add(keyURI, key);
     }
 
-    AES_KEY aes_key;
-    if (AES_set_decrypt_key(key->data(), 128, &aes_key) != 0) {
-        ALOGE("failed to set AES decryption key.");
-        return UNKNOWN_ERROR;
+    if (mAESKeyScheduleURI.empty() || mAESKeyScheduleURI != keyURI) {
+        if (AES_set_decrypt_key(key->data(), 128, &mAESKeySchedule) != 0) {
+            ALOGE("failed to set AES decryption key.");
+            mAESKeyScheduleURI.clear();
+            return UNKNOWN_ERROR;
+        }
+        mAESKeyScheduleURI = keyURI;
     }
 
     size_t n = buffer->size();
@@ -401,7 +540,7 @@ status_t PlaylistFetcher::decryptBuffer(
 
     AES_cbc_encrypt(
             buffer->data(), buffer->data(), buffer->size(),
-            &aes_key, mAESInitVec, AES_DECRYPT);
+            &mAESKeySchedule, mAESInitVec, AES_DECRYPT);
 
     return OK;
 }
@@ -413,6 +552,11 @@ status_t PlaylistFetcher::checkDecryptPadding(const sp<ABuffer> &buffer) {
         return OK;
     }
 
+    // the trailing bytes of an incomplete cipher block were left encrypted
+    if (buffer->size() % 16) {
+        return ERROR_MALFORMED;
+    }
+
     uint8_t padding = 0;
     if (buffer->size() > 0) {
         padding = buffer->data()[buffer->size() - 1];
@@ -432,6 +576,215 @@ status_t PlaylistFetcher::checkDecryptPadding(const sp<ABuffer> &buffer) {
     return OK;
 }
 
+bool PlaylistFetcher::getCipherKeyURI(size_t playlistIndex, AString *keyURI) const {
+    for (ssize_t i = playlistIndex; i >= 0; --i) {
+        AString uri;
+        sp<AMessage> itemMeta;
+        CHECK(mPlaylist->itemAt(i, &uri, &itemMeta));
+
+        AString method;
+        if (itemMeta->findString("cipher-method", &method)) {
+            return method == "AES-128" && itemMeta->findString("cipher-uri", keyURI);
+        }
+    }
+    return false;
+}
+
+void PlaylistFetcher::schedulePrefetches() {
+    if (mMaxNumPrefetchSegments == 0 || mPlaylist == NULL || mSeqNumber < 0
+            || mStopParams != NULL
+            || (mStreamTypeMask & (LiveSession::STREAMTYPE_AUDIO
+                    | LiveSession::STREAMTYPE_VIDEO)) == 0) {
+        return;
+    }
+
+    int32_t firstSeqNumberInPlaylist, lastSeqNumberInPlaylist;
+    mPlaylist->getSeqNumberRange(
+            &firstSeqNumberInPlaylist, &lastSeqNumberInPlaylist);
+
+    // drop the segments the download has moved past
+    for (size_t i = mPrefetchedSegments.size(); i-- > 0;) {
+        if (mPrefetchedSegments.keyAt(i) < mSeqNumber) {
+            mPrefetchedSegments.removeItemsAt(i);
+        }
+    }
+
+    // the current segment is not buffered yet, count it in
+    int64_t bufferedDurationUs = mLastBufferedDurationUs;
+    if (mSeqNumber >= firstSeqNumberInPlaylist
+            && mSeqNumber <= lastSeqNumberInPlaylist) {
+        bufferedDurationUs += getSegmentDurationUs(mSeqNumber);
+    }
+
+    for (int32_t seqNumber = mSeqNumber + 1;
+            seqNumber <= lastSeqNumberInPlaylist
+            && seqNumber <= mSeqNumber + (int32_t)mMaxNumPrefetchSegments;
+            ++seqNumber) {
+        if (seqNumber < firstSeqNumberInPlaylist) {
+            continue;
+        }
+
+        int64_t durationUs = getSegmentDurationUs(seqNumber);
+        if (bufferedDurationUs + durationUs > kMinBufferedDurationUs) {
+            break;
+        }
+        bufferedDurationUs += durationUs;
+
+        if (mPrefetchedSegments.indexOfKey(seqNumber) >= 0) {
+            continue;
+        }
+
+        // a prefetcher per segment in flight
+        size_t index = 0;
+        for (; index < mPrefetchers.size(); ++index) {
+            bool busy = false;
+            for (size_t i = 0; i < mPrefetchedSegments.size(); ++i) {
+                const PrefetchedSegment &segment = mPrefetchedSegments.valueAt(i);
+                if (segment.mPrefetcherIndex == index && segment.mBuffer == NULL) {
+                    busy = true;
+                    break;
+                }
+            }
+            if (!busy) {
+                break;
+            }
+        }
+        if (index == mPrefetchers.size()) {
+            if (index == mMaxNumPrefetchSegments) {
+                break;
+            }
+            sp<ALooper> looper = new ALooper;
+            looper->setName("PlaylistPrefetcher");
+            looper->start(false, false);
+
+            sp<AMessage> notify = new AMessage(kWhatPrefetched, this);
+            sp<Prefetcher> prefetcher = new Prefetcher(
+                    notify, mSession->getHTTPDownloader(), mPrefetchGeneration);
+            looper->registerHandler(prefetcher);
+
+            mPrefetchLoopers.push(looper);
+            mPrefetchers.push(prefetcher);
+        }
+
+        AString uri;
+        sp<AMessage> itemMeta;
+        size_t playlistIndex = seqNumber - firstSeqNumberInPlaylist;
+        CHECK(mPlaylist->itemAt(playlistIndex, &uri, &itemMeta));
+
+        int64_t rangeOffset, rangeLength;
+        if (!itemMeta->findInt64("range-offset", &rangeOffset)
+                || !itemMeta->findInt64("range-length", &rangeLength)) {
+            rangeOffset = 0;
+            rangeLength = -1;
+        }
+
+        AString keyURI;
+        if (getCipherKeyURI(playlistIndex, &keyURI)
+                && mAESKeyForURI.indexOfKey(keyURI) >= 0) {
+            keyURI.clear();
+        }
+
+        FLOGV("prefetching segment %d", seqNumber);
+
+        PrefetchedSegment segment;
+        segment.mUri = uri;
+        segment.mRangeOffset = rangeOffset;
+        segment.mDurationUs = durationUs;
+        segment.mPrefetcherIndex = index;
+        mPrefetchedSegments.add(seqNumber, segment);
+
+        mPrefetchers[index]->fetchAsync(
+                mPrefetchGeneration, seqNumber, uri, rangeOffset, rangeLength, keyURI);
+    }
+}
+
+void PlaylistFetcher::cancelPrefetches() {
+    ++mPrefetchGeneration;
+    for (size_t i = 0; i < mPrefetchers.size(); ++i) {
+        mPrefetchers[i]->cancel(mPrefetchGeneration);
+    }
+    mPrefetchedSegments.clear();
+    mPrefetchWaitGeneration = -1;
+}
+
+status_t PlaylistFetcher::takePrefetchedSegment(
+        const AString &uri, int64_t rangeOffset, sp<ABuffer> *buffer) {
+    ssize_t index = mPrefetchedSegments.indexOfKey(mSeqNumber);
+    if (index < 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    const PrefetchedSegment &segment = mPrefetchedSegments.valueAt(index);
+    if (segment.mUri != uri || segment.mRangeOffset != rangeOffset) {
+        // the playlist changed under us
+        mPrefetchedSegments.removeItemsAt(index);
+        return NAME_NOT_FOUND;
+    }
+
+    if (segment.mBuffer == NULL) {
+        return -EAGAIN;
+    }
+
+    // handed over as if it were downloaded, starting empty
+    *buffer = segment.mBuffer;
+    (*buffer)->meta()->setInt64("prefetched-size", (*buffer)->size());
+    (*buffer)->setRange(0, 0);
+
+    mPrefetchedSegments.removeItemsAt(index);
+    return OK;
+}
+
+void PlaylistFetcher::onPrefetched(const sp<AMessage> &msg) {
+    int32_t generation, seqNumber, err;
+    CHECK(msg->findInt32("generation", &generation));
+    CHECK(msg->findInt32("seqNumber", &seqNumber));
+    CHECK(msg->findInt32("err", &err));
+
+    ssize_t index = mPrefetchedSegments.indexOfKey(seqNumber);
+    if (generation != mPrefetchGeneration || index < 0) {
+        return;
+    }
+
+    if (err != OK) {
+        // downloaded again when its turn comes
+        FLOGV("prefetching segment %d failed (%d)", seqNumber, err);
+        mPrefetchedSegments.removeItemsAt(index);
+    } else {
+        PrefetchedSegment &segment = mPrefetchedSegments.editValueAt(index);
+        CHECK(msg->findBuffer("buffer", &segment.mBuffer));
+
+        AString keyURI;
+        sp<ABuffer> key;
+        if (msg->findString("keyURI", &keyURI) && msg->findBuffer("key", &key)
+                && key->size() == 16 && mAESKeyForURI.indexOfKey(keyURI) < 0) {
+            mAESKeyForURI.add(keyURI, key);
+        }
+
+        // Measurements of downloads in parallel with others would
+        // underestimate the bandwidth.
+        bool alone = true;
+        for (size_t i = 0; i < mPrefetchedSegments.size(); ++i) {
+            if (mPrefetchedSegments.valueAt(i).mBuffer == NULL) {
+                alone = false;
+                break;
+            }
+        }
+        int64_t delayUs;
+        CHECK(msg->findInt64("delayUs", &delayUs));
+        if (alone && !mStartup && mStopParams == NULL
+                && segment.mBuffer->size() > 0) {
+            mSession->addBandwidthMeasurement(segment.mBuffer->size(), delayUs);
+        }
+    }
+
+    if (mPrefetchWaitGeneration == mMonitorQueueGeneration && seqNumber == mSeqNumber) {
+        mPrefetchWaitGeneration = -1;
+        postMonitorQueue();
+    } else {
+        schedulePrefetches();
+    }
+}
+
 void PlaylistFetcher::postMonitorQueue(int64_t delayUs, int64_t minDelayUs) {
     int64_t maxDelayUs = delayUsToRefreshPlaylist();
     if (maxDelayUs < minDelayUs) {
@@ -628,6 +981,12 @@ void PlaylistFetcher::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatPrefetched:
+        {
+            onPrefetched(msg);
+            break;
+        }
+
         default:
             TRESPASS();
     }
@@ -711,6 +1070,7 @@ status_t PlaylistFetcher::onStart(const sp<AMessage> &msg) {
         mSeqNumber = -1;
         mTimeChangeSignaled = false;
         mDownloadState->resetState();
+        cancelPrefetches();
     }
 
     postMonitorQueue();
@@ -738,6 +1098,7 @@ void PlaylistFetcher::onStop(const sp<AMessage> &msg) {
     }
 
     mDownloadState->resetState();
+    cancelPrefetches();
     mPacketSources.clear();
     mStreamTypeMask = 0;
 
@@ -826,6 +1187,7 @@ void PlaylistFetcher::onMonitorQueue() {
             bufferedDurationUs = 0ll;
         }
     }
+    mLastBufferedDurationUs = bufferedDurationUs;
 
     if (finalResult == OK && bufferedDurationUs < kMinBufferedDurationUs) {
         FLOGV("monitoring, buffered=%lld < %lld",
@@ -857,9 +1219,28 @@ void PlaylistFetcher::onMonitorQueue() {
 
 status_t PlaylistFetcher::refreshPlaylist() {
     if (delayUsToRefreshPlaylist() <= 0) {
+        // Ask for a delta update if the server offers them, and the segments
+        // it may skip are all in the playlist we have.
+        AString url = mURI;
+        int64_t canSkipUntilUs =
+                mPlaylist != NULL ? mPlaylist->getCanSkipUntilUs() : -1ll;
+        bool delta = canSkipUntilUs > 0 && mLastPlaylistFetchTimeUs >= 0
+                && ALooper::GetNowUs() - mLastPlaylistFetchTimeUs < canSkipUntilUs / 2;
+        if (delta) {
+            url.append(url.find("?") < 0 ? "?" : "&");
+            url.append("_HLS_skip=YES");
+        }
+
         bool unchanged;
         sp<M3UParser> playlist = mHTTPDownloader->fetchPlaylist(
-                mURI.c_str(), mPlaylistHash, &unchanged);
+                url.c_str(), mPlaylistHash, &unchanged, mPlaylist);
+
+        if (playlist == NULL && !unchanged && delta) {
+            ALOGW("delta update of '%s' failed, reloading it",
+                    uriDebugString(mURI).c_str());
+            playlist = mHTTPDownloader->fetchPlaylist(
+                    mURI.c_str(), mPlaylistHash, &unchanged, mPlaylist);
+        }
 
         if (playlist == NULL) {
             if (unchanged) {
@@ -1256,14 +1637,59 @@ void PlaylistFetcher::onDownloadNext() {
         range_length = -1;
     }
 
+    if (buffer == NULL) {
+        status_t err = takePrefetchedSegment(uri, range_offset, &buffer);
+        if (err == -EAGAIN) {
+            // already on its way, resumed once it arrived
+            FLOGV("waiting for prefetch of segment %d", mSeqNumber);
+            mDownloadState->saveState(
+                    uri,
+                    itemMeta,
+                    buffer,
+                    tsBuffer,
+                    firstSeqNumberInPlaylist,
+                    lastSeqNumberInPlaylist);
+            mPrefetchWaitGeneration = mMonitorQueueGeneration;
+            return;
+        } else if (err != OK) {
+            // a wait for a prefetch that failed leaves no connection
+            connectHTTP = true;
+        }
+    }
+
+    // the segments after this one download while it is demuxed
+    schedulePrefetches();
+
+    int64_t prefetchedSize = 0;
+    bool prefetched = buffer != NULL
+            && buffer->meta()->findInt64("prefetched-size", &prefetchedSize);
+
+    bool chunked = mChunkedParsing && !prefetched
+            && (buffer == NULL || buffer->size() == 0 || bufferStartsWithTsSyncByte(buffer));
+
+    // bandwidth samples are taken over kDownloadBlockSize at least, the
+    // partial reads are too short to be representative
+    size_t measuredBytes = 0;
+    int64_t measuredDelayUs = 0;
+
     // block-wise download
     bool shouldPause = false;
     ssize_t bytesRead;
     do {
         int64_t startUs = ALooper::GetNowUs();
-        bytesRead = mHTTPDownloader->fetchBlock(
-                uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize,
-                NULL /* actualURL */, connectHTTP);
+        if (prefetched) {
+            // handed over in blocks as well, the stopping threshold and
+            // the decryption work the same
+            bytesRead = prefetchedSize - buffer->size();
+            if (bytesRead > kDownloadBlockSize) {
+                bytesRead = kDownloadBlockSize;
+            }
+            buffer->setRange(0, buffer->size() + bytesRead);
+        } else {
+            bytesRead = mHTTPDownloader->fetchBlock(
+                    uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize,
+                    NULL /* actualURL */, connectHTTP, chunked);
+        }
         int64_t delayUs = ALooper::GetNowUs() - startUs;
 
         if (bytesRead == ERROR_NOT_CONNECTED) {
@@ -1279,26 +1705,36 @@ void PlaylistFetcher::onDownloadNext() {
         // add sample for bandwidth estimation, excluding samples from subtitles (as
         // its too small), or during startup/resumeUntil (when we could have more than
         // one connection open which affects bandwidth)
-        if (!mStartup && mStopParams == NULL && bytesRead > 0
+        measuredBytes += bytesRead;
+        measuredDelayUs += delayUs;
+        if (!prefetched && !mStartup && mStopParams == NULL && measuredBytes > 0
+                && (measuredBytes >= (size_t)kDownloadBlockSize || bytesRead == 0)
                 && (mStreamTypeMask
                         & (LiveSession::STREAMTYPE_AUDIO
                         | LiveSession::STREAMTYPE_VIDEO))) {
-            mSession->addBandwidthMeasurement(bytesRead, delayUs);
-            if (delayUs > 2000000ll) {
-                FLOGV("bytesRead %zd took %.2f seconds - abnormal bandwidth dip",
-                        bytesRead, (double)delayUs / 1.0e6);
+            mSession->addBandwidthMeasurement(measuredBytes, measuredDelayUs);
+            if (measuredDelayUs > 2000000ll) {
+                FLOGV("bytesRead %zu took %.2f seconds - abnormal bandwidth dip",
+                        measuredBytes, (double)measuredDelayUs / 1.0e6);
             }
         }
+        if (measuredBytes >= (size_t)kDownloadBlockSize) {
+            measuredBytes = 0;
+            measuredDelayUs = 0;
+        }
 
         connectHTTP = false;
 
         CHECK(buffer != NULL);
 
+        // Set decryption range. AES-128 works on whole cipher blocks, the
+        // bytes of an incomplete one are decrypted once the rest arrived.
         size_t size = buffer->size();
-        // Set decryption range.
-        buffer->setRange(size - bytesRead, bytesRead);
+        size_t decryptStart = (size - bytesRead) / 16 * 16;
+        size_t decryptEnd = size / 16 * 16;
+        buffer->setRange(decryptStart, decryptEnd - decryptStart);
         status_t err = decryptBuffer(mSeqNumber - firstSeqNumberInPlaylist, buffer,
-                buffer->offset() == 0 /* first */);
+                decryptStart == 0 /* first */);
         // Unset decryption range.
         buffer->setRange(0, size);
 
@@ -1309,6 +1745,11 @@ void PlaylistFetcher::onDownloadNext() {
             return;
         }
 
+        // other formats are only parsed once the segment is complete
+        if (chunked && decryptEnd > 0 && !bufferStartsWithTsSyncByte(buffer)) {
+            chunked = false;
+        }
+
         bool startUp = mStartup; // save current start up state
 
         err = OK;
@@ -1322,7 +1763,11 @@ void PlaylistFetcher::onDownloadNext() {
                 tsBuffer = new ABuffer(buffer->data(), buffer->capacity());
                 tsBuffer->setRange(tsOff, tsSize);
             }
-            tsBuffer->setRange(tsBuffer->offset(), tsBuffer->size() + bytesRead);
+            // only what is decrypted already goes to the parser
+            AString method;
+            CHECK(buffer->meta()->findString("cipher-method", &method));
+            size_t available = method == "NONE" ? bytesRead : decryptEnd - decryptStart;
+            tsBuffer->setRange(tsBuffer->offset(), tsBuffer->size() + available);
             err = extractAndQueueAccessUnitsFromTs(tsBuffer);
         }
 
@@ -1627,15 +2072,10 @@ status_t PlaylistFetcher::extractAndQueueAccessUnitsFromTs(const sp<ABuffer> &bu
         mNextPTSTimeUs = -1ll;
     }
 
-    size_t offset = 0;
-    while (offset + 188 <= buffer->size()) {
-        status_t err = mTSParser->feedTSPacket(buffer->data() + offset, 188);
-
-        if (err != OK) {
-            return err;
-        }
-
-        offset += 188;
+    size_t offset;
+    status_t feedErr = mTSParser->feedTSPackets(buffer->data(), buffer->size(), &offset);
+    if (feedErr != OK) {
+        return feedErr;
     }
     // setRange to indicate consumed bytes.
     buffer->setRange(buffer->offset() + offset, buffer->size() - offset);
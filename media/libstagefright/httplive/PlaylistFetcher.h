@@ -19,6 +19,7 @@
 #define PLAYLIST_FETCHER_H_
 
 #include <media/stagefright/foundation/AHandler.h>
+#include <openssl/aes.h>
 
 #include "mpeg2ts/ATSParser.h"
 #include "LiveSession.h"
@@ -26,6 +27,7 @@
 namespace android {
 
 struct ABuffer;
+struct ALooper;
 struct AnotherPacketSource;
 class DataSource;
 struct HTTPBase;
@@ -36,6 +38,7 @@ class String8;
 struct PlaylistFetcher : public AHandler {
     static const int64_t kMinBufferedDurationUs;
     static const int32_t kDownloadBlockSize;
+    static const size_t kDefaultNumPrefetchSegments;
     static const int64_t kFetcherResumeThreshold;
 
     enum {
@@ -92,6 +95,7 @@ protected:
 private:
     enum {
         kMaxNumRetries         = 5,
+        kMaxNumPrefetchSegments = 8,
     };
 
     enum {
@@ -101,10 +105,22 @@ private:
         kWhatMonitorQueue   = 'moni',
         kWhatResumeUntil    = 'rsme',
         kWhatDownloadNext   = 'dlnx',
-        kWhatFetchPlaylist  = 'flst'
+        kWhatFetchPlaylist  = 'flst',
+        kWhatPrefetched     = 'pref',
     };
 
     struct DownloadState;
+    struct Prefetcher;
+
+    // A segment downloaded ahead by a Prefetcher, mBuffer is NULL while the
+    // download is in progress.
+    struct PrefetchedSegment {
+        AString mUri;
+        int64_t mRangeOffset;
+        int64_t mDurationUs;
+        size_t mPrefetcherIndex;
+        sp<ABuffer> mBuffer;
+    };
 
     static const int64_t kMaxMonitorDelayUs;
     static const int32_t kNumSkipFrames;
@@ -177,6 +193,11 @@ private:
     // the last block of cipher text (cipher-block chaining).
     unsigned char mAESInitVec[16];
 
+    // Key schedule of mAESKeyScheduleURI, set up once per key rather than
+    // for every block decrypted.
+    AES_KEY mAESKeySchedule;
+    AString mAESKeyScheduleURI;
+
     Mutex mThresholdLock;
     float mThresholdRatio;
 
@@ -184,6 +205,27 @@ private:
 
     bool mHasMetadata;
 
+    // Up to mMaxNumPrefetchSegments segments after mSeqNumber, and their
+    // keys, are downloaded in parallel while the current one is demuxed,
+    // as long as they fit within kMinBufferedDurationUs of buffering.
+    // media.httplive.prefetch-segments sets the number, 0 disables it.
+    size_t mMaxNumPrefetchSegments;
+    Vector<sp<ALooper> > mPrefetchLoopers;
+    Vector<sp<Prefetcher> > mPrefetchers;
+    KeyedVector<int32_t, PrefetchedSegment> mPrefetchedSegments;
+    int32_t mPrefetchGeneration;
+    int64_t mLastBufferedDurationUs;
+
+    // mMonitorQueueGeneration when a download started waiting for the
+    // prefetch of its segment, -1 if none is waiting.
+    int32_t mPrefetchWaitGeneration;
+
+    // Transport stream segments are decrypted and fed to the parser as
+    // their bytes arrive rather than in kDownloadBlockSize blocks, so the
+    // first access units are available before the block completes.
+    // media.httplive.chunked-parsing disables it.
+    bool mChunkedParsing;
+
     // Set first to true if decrypting the first segment of a playlist segment. When
     // first is true, reset the initialization vector based on the available
     // information in the manifest; otherwise, use the initialization vector as
@@ -196,6 +238,13 @@ private:
             size_t playlistIndex, const sp<ABuffer> &buffer,
             bool first = true);
     status_t checkDecryptPadding(const sp<ABuffer> &buffer);
+    bool getCipherKeyURI(size_t playlistIndex, AString *keyURI) const;
+
+    void schedulePrefetches();
+    void cancelPrefetches();
+    status_t takePrefetchedSegment(
+            const AString &uri, int64_t rangeOffset, sp<ABuffer> *buffer);
+    void onPrefetched(const sp<AMessage> &msg);
 
     void postMonitorQueue(int64_t delayUs = 0, int64_t minDelayUs = 0);
     void cancelMonitorQueue();
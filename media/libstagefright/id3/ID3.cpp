@@ -196,37 +196,23 @@ struct id3_header {
     }
 
     if (header.version_major == 4) {
-        void *copy = malloc(size);
-        if (copy == NULL) {
-            free(mData);
-            mData = NULL;
-            ALOGE("b/24623447, no more memory");
-            return false;
-        }
+        // Check the frames first, so that the tag need not be restored if
+        // it only parses with the iTunes hack.
+        bool iTunesHack = false;
+        if (!removeUnsynchronizationV2_4(false /* iTunesHack */, false /* apply */)) {
+            iTunesHack = true;
 
-        memcpy(copy, mData, size);
+            if (!removeUnsynchronizationV2_4(true /* iTunesHack */, false /* apply */)) {
+                free(mData);
+                mData = NULL;
 
-        bool success = removeUnsynchronizationV2_4(false /* iTunesHack */);
-        if (!success) {
-            memcpy(mData, copy, size);
-            mSize = size;
-
-            success = removeUnsynchronizationV2_4(true /* iTunesHack */);
-
-            if (success) {
-                ALOGV("Had to apply the iTunes hack to parse this ID3 tag");
+                return false;
             }
-        }
 
-        free(copy);
-        copy = NULL;
-
-        if (!success) {
-            free(mData);
-            mData = NULL;
-
-            return false;
+            ALOGV("Had to apply the iTunes hack to parse this ID3 tag");
         }
+
+        removeUnsynchronizationV2_4(iTunesHack, true /* apply */);
     } else if (header.flags & 0x80) {
         ALOGV("removing unsynchronization");
 
@@ -328,12 +314,18 @@ struct id3_header {
 }
 
 void ID3::removeUnsynchronization() {
-    for (size_t i = 0; i + 1 < mSize; ++i) {
-        if (mData[i] == 0xff && mData[i + 1] == 0x00) {
-            memmove(&mData[i + 1], &mData[i + 2], mSize - i - 2);
-            --mSize;
+    // Replace each 0xff 0x00 with 0xff, in a single pass.
+    size_t writeOffset = 0;
+    for (size_t readOffset = 0; readOffset < mSize; ++readOffset) {
+        mData[writeOffset++] = mData[readOffset];
+
+        if (mData[readOffset] == 0xff
+                && readOffset + 1 < mSize && mData[readOffset + 1] == 0x00) {
+            ++readOffset;
         }
     }
+
+    mSize = writeOffset;
 }
 
 static void WriteSyncsafeInteger(uint8_t *dst, size_t x) {
@@ -343,68 +335,96 @@ static void WriteSyncsafeInteger(uint8_t *dst, size_t x) {
     }
 }
 
-bool ID3::removeUnsynchronizationV2_4(bool iTunesHack) {
+bool ID3::removeUnsynchronizationV2_4(bool iTunesHack, bool apply) {
+    // The frames are compacted in a single pass: the data is read at
+    // "readOffset" and written back at "offset", which never passes it.
+    // Unless "apply" is set, nothing is written and this only checks that
+    // the frames can be parsed.
     size_t oldSize = mSize;
+    size_t readOffset = 0;
 
     size_t offset = 0;
-    while (mSize >= 10 && offset <= mSize - 10) {
-        if (!memcmp(&mData[offset], "\0\0\0\0", 4)) {
+    while (oldSize >= 10 && readOffset <= oldSize - 10) {
+        const uint8_t *frame = &mData[readOffset];
+        if (!memcmp(frame, "\0\0\0\0", 4)) {
             break;
         }
 
         size_t dataSize;
         if (iTunesHack) {
-            dataSize = U32_AT(&mData[offset + 4]);
-        } else if (!ParseSyncsafeInteger(&mData[offset + 4], &dataSize)) {
+            dataSize = U32_AT(&frame[4]);
+        } else if (!ParseSyncsafeInteger(&frame[4], &dataSize)) {
             return false;
         }
 
-        if (dataSize > mSize - 10 - offset) {
+        if (dataSize > oldSize - 10 - readOffset) {
             return false;
         }
 
-        uint16_t flags = U16_AT(&mData[offset + 8]);
+        uint16_t flags = U16_AT(&frame[8]);
         uint16_t prevFlags = flags;
 
+        if (apply) {
+            memmove(&mData[offset], frame, 10);
+        }
+        readOffset += 10;
+
         if (flags & 1) {
             // Strip data length indicator
 
-            if (mSize < 14 || mSize - 14 < offset || dataSize < 4) {
+            if (dataSize < 4) {
                 return false;
             }
-            memmove(&mData[offset + 10], &mData[offset + 14], mSize - offset - 14);
-            mSize -= 4;
+            readOffset += 4;
             dataSize -= 4;
 
             flags &= ~1;
         }
 
+        size_t writeOffset = offset + 10;
         if ((flags & 2) && (dataSize >= 2)) {
             // This file has "unsynchronization", so we have to replace occurrences
             // of 0xff 0x00 with just 0xff in order to get the real data.
 
-            size_t readOffset = offset + 11;
-            size_t writeOffset = offset + 11;
+            if (apply) {
+                mData[writeOffset] = mData[readOffset];
+            }
+            ++writeOffset;
+            ++readOffset;
+
             for (size_t i = 0; i + 1 < dataSize; ++i) {
                 if (mData[readOffset - 1] == 0xff
                         && mData[readOffset] == 0x00) {
                     ++readOffset;
-                    --mSize;
                     --dataSize;
                 }
-                mData[writeOffset++] = mData[readOffset++];
-            }
-            // move the remaining data following this frame
-            if (readOffset <= oldSize) {
-                memmove(&mData[writeOffset], &mData[readOffset], oldSize - readOffset);
-            } else {
-                ALOGE("b/34618607 (%zu %zu %zu %zu)", readOffset, writeOffset, oldSize, mSize);
-                android_errorWriteLog(0x534e4554, "34618607");
+                if (readOffset >= oldSize) {
+                    ALOGE("b/34618607 (%zu %zu %zu)", readOffset, writeOffset, oldSize);
+                    android_errorWriteLog(0x534e4554, "34618607");
+                    dataSize = writeOffset - offset - 10;
+                    break;
+                }
+                if (apply) {
+                    mData[writeOffset] = mData[readOffset];
+                }
+                ++writeOffset;
+                ++readOffset;
             }
 
+            // A frame ending in 0xff 0x00 copies one byte too many, which is
+            // the first one of the next frame.
+            if (writeOffset > offset + 10 + dataSize) {
+                --readOffset;
+            }
+        } else {
+            if (apply) {
+                memmove(&mData[writeOffset], &mData[readOffset], dataSize);
+            }
+            readOffset += dataSize;
         }
+
         flags &= ~2;
-        if (flags != prevFlags || iTunesHack) {
+        if (apply && (flags != prevFlags || iTunesHack)) {
             WriteSyncsafeInteger(&mData[offset + 4], dataSize);
             mData[offset + 8] = flags >> 8;
             mData[offset + 9] = flags & 0xff;
@@ -413,7 +433,13 @@ bool ID3::removeUnsynchronizationV2_4(bool iTunesHack) {
         offset += 10 + dataSize;
     }
 
-    memset(&mData[mSize], 0, oldSize - mSize);
+    if (apply) {
+        // Keep whatever follows the last frame, such as padding.
+        memmove(&mData[offset], &mData[readOffset], oldSize - readOffset);
+        mSize = offset + oldSize - readOffset;
+
+        memset(&mData[mSize], 0, oldSize - mSize);
+    }
 
     return true;
 }
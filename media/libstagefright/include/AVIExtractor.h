@@ -45,14 +45,14 @@ private:
     struct AVISource;
     struct MP3Splitter;
 
-    struct SampleInfo {
-        uint32_t mOffset;
-        bool mIsKey;
-    };
-
     struct Track {
         sp<MetaData> mMeta;
-        Vector<SampleInfo> mSamples;
+
+        // Chunk offsets from the index, and the sorted indices of the key
+        // chunks.  The latter are not stored if every chunk is a key chunk,
+        // i.e. if mNumSyncSamples == mSampleOffsets.size().
+        Vector<uint32_t> mSampleOffsets;
+        Vector<uint32_t> mSyncSamples;
         uint32_t mRate;
         uint32_t mScale;
 
@@ -101,6 +101,8 @@ private:
     status_t getSampleTime(
             size_t trackIndex, size_t sampleIndex, int64_t *sampleTimeUs);
 
+    static bool IsSyncSample(const Track &track, size_t sampleIndex);
+
     status_t getSampleIndexAtTime(
             size_t trackIndex,
             int64_t timeUs, MediaSource::ReadOptions::SeekMode mode,
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ASYNC_FILE_WRITER_H_
+
+#define ASYNC_FILE_WRITER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Errors.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+#include <pthread.h>
+#include <sys/types.h>
+
+namespace android {
+
+// Writes sequentially to a file from a thread of its own.  The data written
+// is copied into one of a few large buffers, and a buffer is handed to the
+// I/O thread once it is full, so that the caller only blocks on the storage
+// when all the buffers are waiting to be written.  Full buffers end on a
+// kAlignment boundary of the file.
+//
+// Writes and seeks are not thread safe with each other; the file position
+// of the fd must only be changed through seek().
+struct AsyncFileWriter {
+    struct Stats {
+        int64_t mBytesWritten;
+        int32_t mNumWrites;
+        int64_t mTotalWriteTimeUs;
+        int64_t mMaxWriteTimeUs;
+
+        // times the caller waited for a free buffer, and for how long
+        int32_t mNumStalls;
+        int64_t mTotalStallTimeUs;
+
+        int32_t mNumSyncs;
+        int64_t mTotalSyncTimeUs;
+        int64_t mMaxSyncTimeUs;
+    };
+
+    // offset is the current file position of fd.
+    AsyncFileWriter(int fd, off64_t offset, size_t bufferSize, size_t numBuffers);
+    ~AsyncFileWriter();
+
+    // Creates a writer from the current file position of fd, set up by the
+    // <prefix>.io-buffer-kb, <prefix>.io-buffers and <prefix>.sync-kb
+    // properties; returns NULL if the data should be written to fd directly.
+    static AsyncFileWriter *CreateFromProperties(
+            int fd, const char *prefix, int32_t defaultBufferSizeKB,
+            int32_t defaultNumBuffers);
+
+    // Flushes the writer, or syncs it if it has a sync interval, logs its
+    // stats and deletes it; returns the first error it ran into.
+    static status_t Release(AsyncFileWriter *writer);
+
+    status_t initCheck() const { return mInitCheck; }
+
+    void write(const void *data, size_t size);
+
+    // Hands the data written so far to the I/O thread without waiting for
+    // it to be in the file.
+    void submit();
+
+    // Waits until all the data written so far is in the file; returns the
+    // first error the writes ran into.
+    status_t flush();
+
+    // Flushes, then moves the file position.
+    off64_t seek(off64_t offset);
+
+    // Makes the I/O thread fsync() the file every intervalBytes written;
+    // 0, the default, never does.
+    void setSyncInterval(size_t intervalBytes);
+
+    // Flushes, then fsync()s the file.
+    status_t sync();
+
+    // The first error the writes ran into so far, without waiting.
+    status_t getStatus();
+
+    void getStats(Stats *stats);
+
+private:
+    enum {
+        kAlignment = 4096,
+    };
+
+    struct Buffer {
+        uint8_t *mData;
+        size_t mSize;
+    };
+
+    int mFd;
+    size_t mBufferSize;
+    status_t mInitCheck;
+
+    // owned by the caller
+    Buffer *mCurrent;
+    size_t mLimit;
+    off64_t mOffset;
+
+    Mutex mLock;
+    Condition mCondition;
+    List<Buffer *> mFree;
+    List<Buffer *> mQueued;
+    bool mWriting;
+    bool mDone;
+    status_t mStatus;
+    Stats mStats;
+    size_t mSyncIntervalBytes;
+    size_t mBytesSinceSync;
+    Vector<Buffer *> mBuffers;
+
+    pthread_t mThread;
+    bool mThreadStarted;
+
+    static void *ThreadWrapper(void *me);
+    void threadFunc();
+
+    void queueCurrent();
+    void writeBuffer(const Buffer *buffer);
+    status_t syncFile();
+
+    DISALLOW_EVIL_CONSTRUCTORS(AsyncFileWriter);
+};
+
+}  // namespace android
+
+#endif  // ASYNC_FILE_WRITER_H_
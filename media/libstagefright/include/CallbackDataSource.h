@@ -54,12 +54,16 @@ private:
 
 
 // A caching DataSource that wraps a CallbackDataSource. For reads smaller
-// than kCacheSize it will read up to kCacheSize ahead and cache it.
+// than the cache it will read up to the cache size ahead and cache it.
 // This reduces the number of binder round trips to the IDataSource and has a significant
 // impact on time taken for filetype sniffing and metadata extraction.
+// The cache starts at kMinCacheSize and doubles, up to kMaxCacheSize, with
+// every miss just ahead of the cached data, as playback reads the content
+// from start to end; a miss elsewhere shrinks it back.
 class TinyCacheSource : public DataSource {
 public:
     TinyCacheSource(const sp<DataSource>& source);
+    virtual ~TinyCacheSource();
 
     virtual status_t initCheck() const;
     virtual ssize_t readAt(off64_t offset, void* data, size_t size);
@@ -76,15 +80,19 @@ private:
     // with an in-memory MediaDataSource source on a Nexus 5. Beyond 2kb there was
     // no improvement.
     enum {
-        kCacheSize = 2048,
+        kMinCacheSize = 2048,
+        kMaxCacheSize = 256 * 1024,
     };
 
     sp<DataSource> mSource;
-    uint8_t mCache[kCacheSize];
+    uint8_t *mCache;
+    size_t mCacheSize;
     off64_t mCachedOffset;
     size_t mCachedSize;
     String8 mName;
 
+    void resizeCache(size_t size);
+
     DISALLOW_EVIL_CONSTRUCTORS(TinyCacheSource);
 };
 
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HTTP_CONNECTION_POOL_H_
+
+#define HTTP_CONNECTION_POOL_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+struct IMediaHTTPConnection;
+struct IMediaHTTPService;
+
+// Process wide pool of the idle connections of each IMediaHTTPService.
+// MediaHTTP sources take their connection from here and give it back once
+// they go away, so the next source, or the next segment fetcher, reuses it
+// and the transport the service kept alive behind it, instead of making a
+// new one.  media.stagefright.http-pool-size sets the number of idle
+// connections kept per service, 0 disables the pool.
+struct HTTPConnectionPool {
+    struct Metrics {
+        int32_t mNumCreated;
+        int32_t mNumReused;
+        int32_t mNumConnects;
+        int32_t mNumFailedConnects;
+        int64_t mTotalConnectTimeUs;
+    };
+
+    // An idle connection of the service, or a new one; NULL if the service
+    // could not make one.
+    static sp<IMediaHTTPConnection> Acquire(const sp<IMediaHTTPService> &service);
+
+    // Takes back a disconnected connection.
+    static void Release(
+            const sp<IMediaHTTPService> &service,
+            const sp<IMediaHTTPConnection> &connection);
+
+    static void RecordConnect(bool success, int64_t durationUs);
+
+    static void GetMetrics(Metrics *metrics);
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(HTTPConnectionPool);
+};
+
+}  // namespace android
+
+#endif  // HTTP_CONNECTION_POOL_H_
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HTTP_DISK_CACHE_H_
+
+#define HTTP_DISK_CACHE_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/DataSource.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// On-disk cache of HTTP content, beneath NuCachedSource2.  An entry holds
+// the blocks of a content fetched so far, in a sparse data file, and its
+// key and the map of the blocks present in an index file.  It is disabled
+// unless media.stagefright.disk-cache-dir names a directory writable by
+// the media server; media.stagefright.disk-cache-size sets the size limit of
+// the directory in MB.
+struct HTTPDiskCache : public RefBase {
+    // Returns the entry for the content of source, creating it if needed,
+    // or NULL if the content cannot be cached.
+    static sp<HTTPDiskCache> Open(const sp<DataSource> &source);
+
+    // Reads [offset, offset + size) if all of it is cached, and returns
+    // -EAGAIN otherwise.
+    ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    // Stores content fetched from the source.
+    void write(off64_t offset, const void *data, size_t size);
+
+protected:
+    virtual ~HTTPDiskCache();
+
+private:
+    enum {
+        kBlockSize              = 65536,
+        kDefaultMaxSizeMB       = 256,
+    };
+
+    int mDataFd;
+    int mIndexFd;
+    off64_t mSize;
+    off64_t mBitmapOffset;
+    Vector<uint8_t> mBitmap;
+
+    // content written contiguously since the last discontinuity, of which
+    // the whole blocks are marked present
+    off64_t mRunStart;
+    off64_t mRunEnd;
+
+    HTTPDiskCache();
+
+    status_t init(const String8 &path, const String8 &key, off64_t size);
+    bool isCached(size_t block) const;
+    void markCached(size_t firstBlock, size_t endBlock);
+
+    static void Evict(const char *dir, const String8 &keep, int64_t maxBytes);
+
+    DISALLOW_EVIL_CONSTRUCTORS(HTTPDiskCache);
+};
+
+}  // namespace android
+
+#endif  // HTTP_DISK_CACHE_H_
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HTTP_RANGE_FETCHER_H_
+
+#define HTTP_RANGE_FETCHER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+struct HTTPBase;
+struct IMediaHTTPService;
+
+// Fetches HTTP content ahead of a sequential reader, NuCachedSource2, in
+// chunks requested in parallel over connections of its own.  The number of
+// connections in use grows while the time to the first byte of a range
+// request dominates the time to fetch a chunk, as long as the aggregate
+// bandwidth grows with it, and shrinks once the transfers are bandwidth
+// bound.  media.stagefright.http-connections sets the maximum number of
+// connections; 0 or 1 disables the fetcher.
+struct HTTPRangeFetcher : public RefBase {
+    // Returns NULL if the content is too small, of unknown size, or the
+    // fetcher is disabled.
+    static sp<HTTPRangeFetcher> Create(
+            const sp<IMediaHTTPService> &httpService,
+            const char *uri,
+            const KeyedVector<String8, String8> *headers,
+            const sp<HTTPBase> &source);
+
+    // Returns up to size bytes at offset, blocking until the first of them
+    // arrived.  Reads following each other are served from the chunks
+    // fetched ahead, any other read restarts the fetching at its offset.
+    ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    // Aborts the pending transfers; reads return ERROR_END_OF_STREAM from
+    // now on.
+    void disconnect();
+
+    // Sum of the bandwidths of the connections in use.
+    status_t getEstimatedBandwidthKbps(int32_t *kbps);
+
+    size_t numActiveConnections() const;
+
+protected:
+    virtual ~HTTPRangeFetcher();
+
+private:
+    struct Worker;
+
+    enum {
+        kChunkSize              = 512 * 1024,
+        kReadSize               = 65536,
+        kDefaultMaxConnections  = 4,
+        kMaxConnections         = 8,
+
+        // chunks fetched ahead per connection in use
+        kChunksPerConnection    = 2,
+    };
+
+    enum State {
+        PENDING,
+        FETCHING,
+        DONE,
+    };
+
+    struct Chunk : public RefBase {
+        off64_t mOffset;
+        size_t mSize;
+        sp<ABuffer> mData;
+        size_t mFilled;
+        State mState;
+        status_t mStatus;
+
+        // set when the reader moved away while the chunk was fetched
+        bool mAbandoned;
+    };
+
+    sp<IMediaHTTPService> mHTTPService;
+    AString mUri;
+    KeyedVector<String8, String8> mHeaders;
+    off64_t mSize;
+
+    mutable Mutex mLock;
+    Condition mChunkPending;
+    Condition mDataAvailable;
+
+    List<sp<Chunk> > mChunks;
+    off64_t mNextChunkOffset;
+    bool mDisconnecting;
+
+    Vector<sp<Worker> > mWorkers;
+    size_t mMaxConnections;
+    size_t mNumActive;
+
+    // State of the last attempt to add a connection: the aggregate bandwidth
+    // before it, and the number of chunks to fetch before judging it.
+    int32_t mProbeBaseBps;
+    size_t mProbeChunksLeft;
+    size_t mUsefulConnections;
+
+    HTTPRangeFetcher(
+            const sp<IMediaHTTPService> &httpService,
+            const char *uri,
+            const KeyedVector<String8, String8> *headers,
+            off64_t size,
+            size_t maxConnections);
+
+    bool fetchChunk(Worker *worker);
+    sp<Chunk> nextPendingChunk_l(size_t index);
+    void scheduleChunks_l();
+    void abandonChunks_l();
+    void onChunkDone_l(int64_t firstByteUs, int64_t durationUs);
+    int32_t aggregateBandwidthBps_l();
+
+    DISALLOW_EVIL_CONSTRUCTORS(HTTPRangeFetcher);
+};
+
+}  // namespace android
+
+#endif  // HTTP_RANGE_FETCHER_H_
@@ -64,6 +64,10 @@ enum {
     kTransferCharacteristics,
     // uint8_t
     kMatrixCoeffs,
+    // uint32_t
+    kPicWidthInLumaSamples,
+    // uint32_t
+    kPicHeightInLumaSamples,
 };
 
 class HevcParameterSets {
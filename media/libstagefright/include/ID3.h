@@ -88,7 +88,7 @@ private:
     bool parseV1(const sp<DataSource> &source);
     bool parseV2(const sp<DataSource> &source, off64_t offset);
     void removeUnsynchronization();
-    bool removeUnsynchronizationV2_4(bool iTunesHack);
+    bool removeUnsynchronizationV2_4(bool iTunesHack, bool apply);
 
     static bool ParseSyncsafeInteger(const uint8_t encoded[4], size_t *x);
 
@@ -25,6 +25,7 @@ namespace android {
 
 struct AMessage;
 class DataSource;
+struct MP3FrameIndex;
 struct MP3Seeker;
 class String8;
 
@@ -48,6 +49,7 @@ private:
     sp<MetaData> mMeta;
     uint32_t mFixedHeader;
     sp<MP3Seeker> mSeeker;
+    sp<MP3FrameIndex> mFrameIndex;
 
     MP3Extractor(const MP3Extractor &);
     MP3Extractor &operator=(const MP3Extractor &);
@@ -29,6 +29,7 @@
 
 namespace android {
 
+struct ABuffer;
 struct AMessage;
 struct AnotherPacketSource;
 struct ATSParser;
@@ -70,6 +71,10 @@ private:
 
     off64_t mOffset;
 
+    // the packets read from mReadBufferOffset, fed one by one by feedMore()
+    sp<ABuffer> mReadBuffer;
+    off64_t mReadBufferOffset;
+
     void init();
     // Try to feed more data from source to parser.
     // |isInit| means this function is called inside init(). This is a signal to
@@ -39,6 +39,12 @@ struct SidxEntry {
     uint32_t mDurationUs;
 };
 
+// start of a fragment, from the sidx or mfra boxes
+struct FragmentEntry {
+    int64_t mTimeUs;
+    off64_t mMoofOffset;
+};
+
 struct Trex {
     uint32_t track_ID;
     uint32_t default_sample_description_index;
@@ -80,6 +86,7 @@ private:
         sp<SampleTable> sampleTable;
         bool includes_expensive_metadata;
         bool skipTrack;
+        Vector<FragmentEntry> fragments;  // from the tfra box, in increasing time
     };
 
     Vector<SidxEntry> mSidxEntries;
@@ -138,6 +145,9 @@ private:
 
     status_t parseSegmentIndex(off64_t data_offset, size_t data_size);
 
+    status_t parseMovieFragmentRandomAccess();
+    status_t parseTrackFragmentRandomAccess(off64_t data_offset, size_t data_size);
+
     Track *findTrackByMimePrefix(const char *mimePrefix);
 
     MPEG4Extractor(const MPEG4Extractor &);
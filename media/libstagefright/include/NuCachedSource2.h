@@ -21,17 +21,21 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/DataSource.h>
+#include <utils/Vector.h>
 
 namespace android {
 
 struct ALooper;
+struct HTTPDiskCache;
+struct HTTPRangeFetcher;
 struct PageCache;
 
 struct NuCachedSource2 : public DataSource {
     static sp<NuCachedSource2> Create(
             const sp<DataSource> &source,
             const char *cacheConfig = NULL,
-            bool disconnectAtHighwatermark = false);
+            bool disconnectAtHighwatermark = false,
+            const sp<HTTPRangeFetcher> &rangeFetcher = NULL);
 
     virtual status_t initCheck() const;
 
@@ -79,7 +83,8 @@ private:
     NuCachedSource2(
             const sp<DataSource> &source,
             const char *cacheConfig,
-            bool disconnectAtHighwatermark);
+            bool disconnectAtHighwatermark,
+            const sp<HTTPRangeFetcher> &rangeFetcher);
 
     enum {
         kPageSize                       = 65536,
@@ -100,6 +105,25 @@ private:
         kMaxNumRetries = 10,
     };
 
+    enum {
+        kMaxNumRetainedRanges           = 8,
+
+        // Retained ranges up to this size at the start or the end of the
+        // content, where the headers and indices usually are, are evicted
+        // last.
+        kMaxPinnedRangeSize             = 2 * 1024 * 1024,
+    };
+
+    // Ranges cached before a seek to another part of the content.  They
+    // share the high water budget with mCache, are still read from, and
+    // become the fetched range again on a seek back into them.
+    struct RetainedRange {
+        off64_t mOffset;
+        PageCache *mCache;
+        uint64_t mLastUse;
+        bool mPinned;
+    };
+
     sp<DataSource> mSource;
     sp<AHandlerReflector<NuCachedSource2> > mReflector;
     sp<ALooper> mLooper;
@@ -111,6 +135,9 @@ private:
 
     PageCache *mCache;
     off64_t mCacheOffset;
+    Vector<RetainedRange> mRetainedRanges;
+    size_t mRetainedSize;
+    uint64_t mRetainedUseCount;
     status_t mFinalStatus;
     off64_t mLastAccessPos;
     sp<AMessage> mAsyncResult;
@@ -128,6 +155,13 @@ private:
 
     bool mDisconnectAtHighwatermark;
 
+    // Second level cache of HTTP content, NULL if disabled.
+    sp<HTTPDiskCache> mDiskCache;
+
+    // Fetches the content over parallel connections instead of mSource,
+    // NULL if disabled.
+    sp<HTTPRangeFetcher> mRangeFetcher;
+
     void onMessageReceived(const sp<AMessage> &msg);
     void onFetch();
     void onRead(const sp<AMessage> &msg);
@@ -136,6 +170,12 @@ private:
     ssize_t readInternal(off64_t offset, void *data, size_t size);
     status_t seekInternal_l(off64_t offset);
 
+    ssize_t findRetainedRange_l(off64_t offset, size_t size) const;
+    void retainCurrentRange_l();
+    bool evictRetainedRange_l(bool evictPinned);
+    void trimRetainedRanges_l(size_t maxBytes, bool evictPinned);
+    size_t spliceRetainedRange_l();
+
     size_t approxDataRemaining_l(status_t *finalStatus) const;
 
     void restartPrefetcherIfNecessary_l(
@@ -53,6 +53,11 @@ public:
 
     status_t setSyncSampleParams(off64_t data_offset, size_t data_size);
 
+    // The set*Params() methods above only check the headers of the boxes, the sample-to-chunk,
+    // time-to-sample, composition time and sync sample tables are read on first use, or by
+    // this method.
+    status_t loadTables();
+
     ////////////////////////////////////////////////////////////////////////////
 
     uint32_t countChunkOffsets() const;
@@ -113,7 +118,11 @@ private:
     uint32_t mDefaultSampleSize;
     uint32_t mNumSampleSizes;
 
+    bool mTablesLoaded;
+    status_t mTablesStatus;
+
     bool mHasTimeToSample;
+    off64_t mTimeToSampleOffset;
     uint32_t mTimeToSampleCount;
     uint32_t* mTimeToSample;
 
@@ -123,6 +132,19 @@ private:
     };
     SampleTimeEntry *mSampleTimeEntries;
 
+    // Without composition time offsets, the samples are in time order and their times are
+    // found from the time-to-sample runs, starting from the time index: the first sample and
+    // its time for every kTimeIndexBlockSize runs. Used instead of mSampleTimeEntries.
+    struct TimeIndexEntry {
+        uint32_t mSampleIndex;
+        uint32_t mSampleTime;
+    };
+    static const uint32_t kTimeIndexBlockSize = 64;
+    TimeIndexEntry *mTimeIndex;
+    uint32_t mNumTimeIndexEntries;
+    bool mTimeIndexFailed;  // the times do not fit 32 bits
+
+    off64_t mCompositionTimeToSampleOffset;
     int32_t *mCompositionTimeDeltaEntries;
     size_t mNumCompositionTimeDeltaEntries;
     CompositionDeltaLookup *mCompositionDeltaLookup;
@@ -140,26 +162,51 @@ private:
         uint32_t chunkDesc;
     };
     SampleToChunkEntry *mSampleToChunkEntries;
+    // index of the first sample of each of the first mNumSampleToChunkFirstSamples entries,
+    // those up to the first one describing an invalid range
+    uint32_t *mSampleToChunkFirstSamples;
+    uint32_t mNumSampleToChunkFirstSamples;
 
     // Approximate size of all tables combined.
     uint64_t mTotalSize;
 
     friend struct SampleIterator;
 
+    // the time and index of the sample at position |index| in time order
+    uint32_t getSortedSampleTime(uint32_t index) const;
+    uint32_t getSortedSampleIndex(uint32_t index) const {
+        return mSampleTimeEntries != NULL ? mSampleTimeEntries[index].mSampleIndex : index;
+    }
+
+    bool hasSortedSampleTimes() const {
+        return mSampleTimeEntries != NULL
+                || (mTimeIndex != NULL && mCompositionTimeDeltaEntries == NULL);
+    }
+
     // normally we don't round
     inline uint64_t getSampleTime(
             size_t sample_index, uint64_t scale_num, uint64_t scale_den) const {
-        return (sample_index < (size_t)mNumSampleSizes && mSampleTimeEntries != NULL
+        return (sample_index < (size_t)mNumSampleSizes
+                && hasSortedSampleTimes()
                 && scale_den != 0)
-                ? (mSampleTimeEntries[sample_index].mCompositionTime * scale_num) / scale_den : 0;
+                ? (getSortedSampleTime(sample_index) * scale_num) / scale_den : 0;
     }
 
+    status_t loadTables_l();
+    status_t loadSampleToChunkTable_l();
+    status_t loadTimeToSampleTable_l();
+    status_t loadCompositionTimeToSampleTable_l();
+    status_t loadSyncSampleTable_l();
+
     status_t getSampleSize_l(uint32_t sample_index, size_t *sample_size);
     int32_t getCompositionTimeOffset(uint32_t sampleIndex);
 
     static int CompareIncreasingTime(const void *, const void *);
 
     void buildSampleEntriesTable();
+    // builds mTimeIndex if needed, returns whether it is available
+    bool buildTimeIndex_l();
+    void buildSampleToChunkIndex();
 
     SampleTable(const SampleTable &);
     SampleTable &operator=(const SampleTable &);
@@ -61,6 +61,7 @@ protected:
     enum {
         kStoreMetaDataExtensionIndex = OMX_IndexVendorStartUnused + 1,
         kPrepareForAdaptivePlaybackIndex,
+        kEncoderSpeedExtensionIndex,
     };
 
     void addPort(const OMX_PARAM_PORTDEFINITIONTYPE &def);
@@ -76,6 +76,13 @@ protected:
 
     virtual int getColorAspectPreference();
 
+    // Number of threads a software decoder should run, at most maxThreads:
+    // media.swcodec.threads if set, otherwise the number of online cores
+    // running at the highest maximum frequency, so that the decode threads
+    // are not held back by the slow cores of a big.LITTLE system; all the
+    // online cores if fewer than two run at that frequency.
+    static size_t GetDecoderThreadCount(size_t maxThreads);
+
     // This function sets both minimum buffer count and actual buffer count of
     // input port to be |numInputBuffers|. It will also set both minimum buffer
     // count and actual buffer count of output port to be |numOutputBuffers|.
@@ -44,6 +44,10 @@ public:
 private:
     enum YUVMode {
         None,
+        // HAL_PIXEL_FORMAT_YV12 buffers
+        YV12,
+        // HAL_PIXEL_FORMAT_YCbCr_420_888 buffers, locked with lockYCbCr()
+        FlexibleYUV,
     };
 
     OMX_COLOR_FORMATTYPE mColorFormat;
@@ -57,10 +61,19 @@ private:
     android_dataspace mDataSpace;
     FrameRenderTracker mRenderTracker;
 
+    // time spent locking, filling and unlocking buffers
+    int32_t mNumFramesRendered;
+    int64_t mTotalRenderTimeUs;
+    int64_t mMaxRenderTimeUs;
+
     SoftwareRenderer(const SoftwareRenderer &);
     SoftwareRenderer &operator=(const SoftwareRenderer &);
 
     void resetFormatIfChanged(const sp<AMessage> &format);
+
+    // Copies the YUV 4:2:0 source frame into the buffer layout in dst,
+    // returning false if the source is too small.
+    bool copyYUV(const void *data, size_t size, const android_ycbcr &dst);
 };
 
 }  // namespace android
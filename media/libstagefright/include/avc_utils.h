@@ -83,6 +83,10 @@ status_t getNextNALUnit(
 class MetaData;
 sp<MetaData> MakeAVCCodecSpecificData(const sp<ABuffer> &accessUnit);
 
+// Builds the HEVC format, with an hvcC codec specific data, from the
+// parameter sets of an Annex B access unit. Returns NULL if any is missing.
+sp<MetaData> MakeHEVCCodecSpecificData(const sp<ABuffer> &accessUnit);
+
 bool IsIDR(const sp<ABuffer> &accessUnit);
 bool IsAVCReferenceFrame(const sp<ABuffer> &accessUnit);
 uint32_t FindAVCLayerId(const uint8_t *data, size_t size);
@@ -39,9 +39,13 @@
 
 namespace android {
 
+// mkvparser reads the element headers a few bytes at a time, the reads are served from a few
+// blocks of the file kept in memory: the clusters being played, prefetched whole, or else
+// the kReadAheadSize bytes following a read.
 struct DataSourceReader : public mkvparser::IMkvReader {
     DataSourceReader(const sp<DataSource> &source)
-        : mSource(source) {
+        : mSource(source),
+          mUseCount(0) {
     }
 
     virtual int Read(long long position, long length, unsigned char* buffer) {
@@ -52,6 +56,22 @@ struct DataSourceReader : public mkvparser::IMkvReader {
             return 0;
         }
 
+        Mutex::Autolock autoLock(mLock);
+
+        const CacheBlock *block = findBlock_l(position, length);
+        if (block == NULL && length < (long)kReadAheadSize) {
+            block = fillBlock_l(position, kReadAheadSize);
+            if (block != NULL && block->mData->size() < (size_t)length) {
+                // the source ends sooner, the range is read below
+                block = NULL;
+            }
+        }
+
+        if (block != NULL) {
+            memcpy(buffer, block->mData->data() + (position - block->mOffset), length);
+            return 0;
+        }
+
         ssize_t n = mSource->readAt(position, buffer, length);
 
         if (n <= 0) {
@@ -61,6 +81,20 @@ struct DataSourceReader : public mkvparser::IMkvReader {
         return 0;
     }
 
+    // Reads [position, position + length) in memory for the reads to come, if it is not
+    // larger than kMaxPrefetchSize.
+    void prefetch(long long position, long long length) {
+        if (position < 0 || length <= 0 || length > (long long)kMaxPrefetchSize) {
+            return;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+
+        if (findBlock_l(position, length) == NULL) {
+            fillBlock_l(position, length);
+        }
+    }
+
     virtual int Length(long long* total, long long* available) {
         off64_t size;
         if (mSource->getSize(&size) != OK) {
@@ -82,8 +116,65 @@ struct DataSourceReader : public mkvparser::IMkvReader {
     }
 
 private:
+    enum {
+        kNumCacheBlocks = 3,
+        kReadAheadSize = 64 * 1024,
+        kMaxPrefetchSize = 4 * 1024 * 1024,
+    };
+
+    struct CacheBlock {
+        off64_t mOffset;
+        sp<ABuffer> mData;
+        uint64_t mLastUse;
+    };
+
     sp<DataSource> mSource;
 
+    Mutex mLock;
+    CacheBlock mBlocks[kNumCacheBlocks];
+    uint64_t mUseCount;
+
+    // the block holding all of the range
+    const CacheBlock *findBlock_l(off64_t position, size_t length) {
+        for (size_t i = 0; i < kNumCacheBlocks; ++i) {
+            CacheBlock *block = &mBlocks[i];
+            if (block->mData != NULL && position >= block->mOffset
+                    && (off64_t)(position + length)
+                            <= block->mOffset + (off64_t)block->mData->size()) {
+                block->mLastUse = ++mUseCount;
+                return block;
+            }
+        }
+        return NULL;
+    }
+
+    // replaces the least recently used block
+    const CacheBlock *fillBlock_l(off64_t position, size_t length) {
+        CacheBlock *block = &mBlocks[0];
+        for (size_t i = 1; i < kNumCacheBlocks; ++i) {
+            if (mBlocks[i].mData == NULL
+                    || (block->mData != NULL && mBlocks[i].mLastUse < block->mLastUse)) {
+                block = &mBlocks[i];
+            }
+        }
+
+        block->mData.clear();
+        sp<ABuffer> data = ABuffer::CreatePooled(length);
+        if (data->capacity() < length) {
+            return NULL;
+        }
+        ssize_t n = mSource->readAt(position, data->data(), length);
+        if (n <= 0) {
+            return NULL;
+        }
+        data->setRange(0, n);
+
+        block->mOffset = position;
+        block->mData = data;
+        block->mLastUse = ++mUseCount;
+        return block;
+    }
+
     DataSourceReader(const DataSourceReader &);
     DataSourceReader &operator=(const DataSourceReader &);
 };
@@ -116,6 +207,11 @@ private:
 
     void advance_l();
 
+    void seekToCluster_l(
+            int64_t seekTimeUs, long long seekTimeNs, bool isAudio,
+            int64_t *actualFrameTimeUs);
+    void seekToFrame_l(int64_t seekTimeUs, bool isAudio, int64_t *actualFrameTimeUs);
+
     BlockIterator(const BlockIterator &);
     BlockIterator &operator=(const BlockIterator &);
 };
@@ -344,6 +440,9 @@ void BlockIterator::advance_l() {
             ALOGV("Parse (2) returned %ld", res);
             CHECK_GE(res, 0);
 
+            mExtractor->mReader->prefetch(
+                    mCluster->m_element_start, mCluster->GetElementSize());
+
             mBlockEntryIndex = 0;
             continue;
         }
@@ -416,12 +515,14 @@ void BlockIterator::seek(
         }
 
         if (!pCues) {
-            ALOGE("No Cues in file");
+            ALOGV("No Cues in file");
+            seekToCluster_l(seekTimeUs, seekTimeNs, isAudio, actualFrameTimeUs);
             return;
         }
     }
     else if (!pSH) {
-        ALOGE("No SeekHead");
+        ALOGV("No SeekHead");
+        seekToCluster_l(seekTimeUs, seekTimeNs, isAudio, actualFrameTimeUs);
         return;
     }
 
@@ -467,7 +568,8 @@ void BlockIterator::seek(
 
     // Always *search* based on the video track, but finalize based on mTrackNum
     if (!pTP) {
-        ALOGE("Did not locate the video track for seeking");
+        ALOGV("Did not locate the video track for seeking");
+        seekToCluster_l(seekTimeUs, seekTimeNs, isAudio, actualFrameTimeUs);
         return;
     }
 
@@ -480,6 +582,31 @@ void BlockIterator::seek(
     CHECK_GT(pTP->m_block, 0);
     mBlockEntryIndex = pTP->m_block - 1;
 
+    seekToFrame_l(seekTimeUs, isAudio, actualFrameTimeUs);
+}
+
+// Without cues, or none for the video track, the seek starts from the cluster of the seek time.
+void BlockIterator::seekToCluster_l(
+        int64_t seekTimeUs, long long seekTimeNs, bool isAudio,
+        int64_t *actualFrameTimeUs) {
+    const mkvparser::Cluster *cluster = mExtractor->findCluster_l(seekTimeNs);
+    if (cluster == NULL) {
+        ALOGE("Did not locate the cluster for seeking");
+        return;
+    }
+
+    mCluster = cluster;
+    mBlockEntryIndex = 0;
+    mExtractor->mReader->prefetch(mCluster->m_element_start, mCluster->GetElementSize());
+
+    seekToFrame_l(seekTimeUs, isAudio, actualFrameTimeUs);
+}
+
+void BlockIterator::seekToFrame_l(
+        int64_t seekTimeUs, bool isAudio, int64_t *actualFrameTimeUs) {
+    const mkvparser::Track *thisTrack =
+            mExtractor->mSegment->GetTracks()->GetTrackByNumber(mTrackNum);
+
     for (;;) {
         advance_l();
 
@@ -513,6 +640,58 @@ int64_t BlockIterator::blockTimeUs() const {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+const mkvparser::Cluster *MatroskaExtractor::findCluster_l(long long timeNs) {
+    if (mLastIndexedCluster == NULL) {
+        mLastIndexedCluster = mSegment->GetFirst();
+        if (mLastIndexedCluster == NULL || mLastIndexedCluster->EOS()) {
+            mLastIndexedCluster = NULL;
+            return NULL;
+        }
+        ClusterIndexEntry entry;
+        entry.mTimeNs = mLastIndexedCluster->GetTime();
+        entry.mCluster = mLastIndexedCluster;
+        mClusterIndex.push(entry);
+    }
+
+    while (!mAllClustersIndexed && mClusterIndex.top().mTimeNs <= timeNs) {
+        const mkvparser::Cluster *nextCluster;
+        long long pos;
+        long len;
+        long res = mSegment->ParseNext(mLastIndexedCluster, nextCluster, pos, len);
+        if (res != 0 || nextCluster == NULL || nextCluster->EOS()) {
+            // EOF or error
+            mAllClustersIndexed = true;
+            break;
+        }
+        mLastIndexedCluster = nextCluster;
+
+        ClusterIndexEntry entry;
+        entry.mTimeNs = nextCluster->GetTime();
+        entry.mCluster = nextCluster;
+        if (entry.mTimeNs <= mClusterIndex.top().mTimeNs) {
+            ALOGW("cluster out of order, not indexed");
+            continue;
+        }
+        mClusterIndex.push(entry);
+    }
+
+    // the last cluster starting at or before the time
+    size_t lo = 0;
+    size_t hi = mClusterIndex.size();
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (mClusterIndex.itemAt(mid).mTimeNs <= timeNs) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return mClusterIndex.itemAt(lo > 0 ? lo - 1 : 0).mCluster;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 static unsigned U24_AT(const uint8_t *ptr) {
     return ptr[0] << 16 | ptr[1] << 8 | ptr[2];
 }
@@ -792,6 +971,8 @@ MatroskaExtractor::MatroskaExtractor(const sp<DataSource> &source)
     : mDataSource(source),
       mReader(new DataSourceReader(mDataSource)),
       mSegment(NULL),
+      mLastIndexedCluster(NULL),
+      mAllClustersIndexed(false),
       mExtractedThumbnails(false),
       mIsWebm(false),
       mSeekPreRollNs(0) {
@@ -67,9 +67,20 @@ private:
         const mkvparser::CuePoint::TrackPosition *find(long long timeNs) const;
     };
 
+    // start of a cluster, to seek without cues
+    struct ClusterIndexEntry {
+        long long mTimeNs;
+        const mkvparser::Cluster *mCluster;
+    };
+
     Mutex mLock;
     Vector<TrackInfo> mTracks;
 
+    // the clusters parsed by findCluster_l(), in increasing time
+    Vector<ClusterIndexEntry> mClusterIndex;
+    const mkvparser::Cluster *mLastIndexedCluster;
+    bool mAllClustersIndexed;
+
     sp<DataSource> mDataSource;
     DataSourceReader *mReader;
     mkvparser::Segment *mSegment;
@@ -84,6 +95,10 @@ private:
     void getColorInformation(const mkvparser::VideoTrack *vtrack, sp<MetaData> &meta);
     bool isLiveStreaming() const;
 
+    // the last cluster starting at or before timeNs, the clusters are parsed up to it the first
+    // time, their headers only
+    const mkvparser::Cluster *findCluster_l(long long timeNs);
+
     MatroskaExtractor(const MatroskaExtractor &);
     MatroskaExtractor &operator=(const MatroskaExtractor &);
 };
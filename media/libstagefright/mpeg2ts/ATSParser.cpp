@@ -603,6 +603,9 @@ ATSParser::Stream::Stream(
                     (mProgram->parserFlags() & ALIGNED_VIDEO_DATA)
                         ? ElementaryStreamQueue::kFlag_AlignedData : 0);
             break;
+        case STREAMTYPE_H265:
+            mQueue = new ElementaryStreamQueue(ElementaryStreamQueue::H265);
+            break;
         case STREAMTYPE_MPEG2_AUDIO_ADTS:
             mQueue = new ElementaryStreamQueue(ElementaryStreamQueue::AAC);
             break;
@@ -740,6 +743,7 @@ status_t ATSParser::Stream::parse(
 bool ATSParser::Stream::isVideo() const {
     switch (mStreamType) {
         case STREAMTYPE_H264:
+        case STREAMTYPE_H265:
         case STREAMTYPE_MPEG1_VIDEO:
         case STREAMTYPE_MPEG2_VIDEO:
         case STREAMTYPE_MPEG4_VIDEO:
@@ -1089,9 +1093,13 @@ void ATSParser::Stream::onPayloadData(
                      mElementaryPID, mStreamType);
 
                 const char *mime;
+                int32_t isSync;
                 if (meta->findCString(kKeyMIMEType, &mime)
-                        && !strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC)
-                        && !IsIDR(accessUnit)) {
+                        && ((!strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC)
+                                && !IsIDR(accessUnit))
+                            || (!strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_HEVC)
+                                && !accessUnit->meta()->findInt32(
+                                        "isSync", &isSync)))) {
                     continue;
                 }
                 mSource = new AnotherPacketSource(meta);
@@ -1188,6 +1196,37 @@ status_t ATSParser::feedTSPacket(const void *data, size_t size,
     return parseTS(&br, event);
 }
 
+status_t ATSParser::feedTSPackets(const void *data, size_t size, size_t *numBytesParsed) {
+    const uint8_t *packets = (const uint8_t *)data;
+    size_t numPackets = size / kTSPacketSize;
+    *numBytesParsed = 0;
+
+    // The sync bytes are checked first, so that the packets of a stream which is in sync are
+    // parsed without checking for the remaining size of the buffer after each one.
+    size_t numSyncedPackets = 0;
+    while (numSyncedPackets < numPackets
+            && packets[numSyncedPackets * kTSPacketSize] == 0x47) {
+        ++numSyncedPackets;
+    }
+
+    for (size_t i = 0; i < numSyncedPackets; ++i) {
+        ABitReader br(packets + i * kTSPacketSize, kTSPacketSize);
+        status_t err = parseTS(&br, NULL);
+        if (err != OK) {
+            return err;
+        }
+        *numBytesParsed += kTSPacketSize;
+    }
+
+    if (numSyncedPackets < numPackets) {
+        // lost sync, the packet is parsed as by feedTSPacket() to report the error
+        ABitReader br(packets + numSyncedPackets * kTSPacketSize, kTSPacketSize);
+        return parseTS(&br, NULL);
+    }
+
+    return OK;
+}
+
 void ATSParser::signalDiscontinuity(
         DiscontinuityType type, const sp<AMessage> &extra) {
     int64_t mediaTimeUs;
@@ -1465,31 +1504,35 @@ status_t ATSParser::parseAdaptationField(ABitReader *br, unsigned PID) {
 status_t ATSParser::parseTS(ABitReader *br, SyncEvent *event) {
     ALOGV("---");
 
-    unsigned sync_byte = br->getBits(8);
+    // the fixed header is decoded from its bytes, the rest of the packet with the bit reader
+    const uint8_t *header = br->data();
+    br->skipBits(32);
+
+    unsigned sync_byte = header[0];
     if (sync_byte != 0x47u) {
         ALOGE("[error] parseTS: return error as sync_byte=0x%x", sync_byte);
         return BAD_VALUE;
     }
 
-    if (br->getBits(1)) {  // transport_error_indicator
+    if (header[1] & 0x80) {  // transport_error_indicator
         // silently ignore.
         return OK;
     }
 
-    unsigned payload_unit_start_indicator = br->getBits(1);
+    unsigned payload_unit_start_indicator = (header[1] >> 6) & 1;
     ALOGV("payload_unit_start_indicator = %u", payload_unit_start_indicator);
 
-    MY_LOGV("transport_priority = %u", br->getBits(1));
+    MY_LOGV("transport_priority = %u", (header[1] >> 5) & 1);
 
-    unsigned PID = br->getBits(13);
+    unsigned PID = ((header[1] & 0x1f) << 8) | header[2];
     ALOGV("PID = 0x%04x", PID);
 
-    MY_LOGV("transport_scrambling_control = %u", br->getBits(2));
+    MY_LOGV("transport_scrambling_control = %u", header[3] >> 6);
 
-    unsigned adaptation_field_control = br->getBits(2);
+    unsigned adaptation_field_control = (header[3] >> 4) & 3;
     ALOGV("adaptation_field_control = %u", adaptation_field_control);
 
-    unsigned continuity_counter = br->getBits(4);
+    unsigned continuity_counter = header[3] & 0x0f;
     ALOGV("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
 
     // ALOGI("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
@@ -102,6 +102,11 @@ struct ATSParser : public RefBase {
     status_t feedTSPacket(
             const void *data, size_t size, SyncEvent *event = NULL);
 
+    // Feeds the TS packets of a buffer, up to the last complete one, without sync events.
+    // Stops at the first packet which fails to parse and returns its error. |numBytesParsed|
+    // is the size of the packets parsed before it.
+    status_t feedTSPackets(const void *data, size_t size, size_t *numBytesParsed);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -129,6 +134,7 @@ struct ATSParser : public RefBase {
         STREAMTYPE_MPEG4_VIDEO          = 0x10,
         STREAMTYPE_METADATA             = 0x15,
         STREAMTYPE_H264                 = 0x1b,
+        STREAMTYPE_H265                 = 0x24,
 
         // From ATSC A/53 Part 3:2009, 6.7.1
         STREAMTYPE_AC3                  = 0x81,
@@ -40,6 +40,7 @@ ElementaryStreamQueue::ElementaryStreamQueue(Mode mode, uint32_t flags)
     : mMode(mode),
       mFlags(flags),
       mEOSReached(false) {
+    resetScan();
 }
 
 sp<MetaData> ElementaryStreamQueue::getFormat() {
@@ -52,6 +53,7 @@ void ElementaryStreamQueue::clear(bool clearFormat) {
     }
 
     mRangeInfos.clear();
+    resetScan();
 
     if (clearFormat) {
         mFormat.clear();
@@ -60,6 +62,51 @@ void ElementaryStreamQueue::clear(bool clearFormat) {
     mEOSReached = false;
 }
 
+void ElementaryStreamQueue::resetScan() {
+    mScannedSize = 0;
+    mScanOffset = 0;
+    mScanNALs.clear();
+    mScanTotalSize = 0;
+    mScanSEICount = 0;
+    mScanFoundSlice = false;
+    mScanFoundIDR = false;
+}
+
+// Returns the offset of the first 0x00 0x00 0x01 start code at or after
+// "offset", or -EAGAIN if there is none in the first "size" bytes of "data".
+static ssize_t findStartCode(const uint8_t *data, size_t size, size_t offset) {
+    while (offset + 2 < size) {
+        const uint8_t *one = (const uint8_t *)memchr(
+                &data[offset + 2], 0x01, size - offset - 2);
+
+        if (one == NULL) {
+            break;
+        }
+
+        offset = one - data - 2;
+        if (data[offset] == 0x00 && data[offset + 1] == 0x00) {
+            return offset;
+        }
+
+        ++offset;
+    }
+
+    return -EAGAIN;
+}
+
+// Returns true if a scan that covered the first "scannedSize" bytes of "data"
+// may find more now that it has grown to "size" bytes, i.e. a start code
+// reaches past what that scan could process.
+static bool hasNewStartCode(
+        const uint8_t *data, size_t size, size_t scannedSize, size_t scanOffset) {
+    size_t offset = (scannedSize >= 3) ? scannedSize - 3 : 0;
+    if (offset < scanOffset) {
+        offset = scanOffset;
+    }
+
+    return findStartCode(data, size, offset) >= 0;
+}
+
 // Parse AC3 header assuming the current ptr is start position of syncframe,
 // update metadata only applicable, and return the payload size
 static unsigned parseAC3SyncFrame(
@@ -255,6 +302,7 @@ status_t ElementaryStreamQueue::appendData(
     if (mBuffer == NULL || mBuffer->size() == 0) {
         switch (mMode) {
             case H264:
+            case H265:
             case MPEG_VIDEO:
             {
 #if 0
@@ -434,7 +482,7 @@ status_t ElementaryStreamQueue::appendData(
 
         ALOGV("resizing buffer to size %zu", neededSize);
 
-        sp<ABuffer> buffer = new ABuffer(neededSize);
+        sp<ABuffer> buffer = ABuffer::CreatePooled(neededSize);
         if (mBuffer != NULL) {
             memcpy(buffer->data(), mBuffer->data(), mBuffer->size());
             buffer->setRange(0, mBuffer->size());
@@ -472,16 +520,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
         RangeInfo info = *mRangeInfos.begin();
         mRangeInfos.erase(mRangeInfos.begin());
 
-        sp<ABuffer> accessUnit = new ABuffer(info.mLength);
-        memcpy(accessUnit->data(), mBuffer->data(), info.mLength);
+        sp<ABuffer> accessUnit = takeAccessUnitData(info.mLength);
         accessUnit->meta()->setInt64("timeUs", info.mTimestampUs);
 
-        memmove(mBuffer->data(),
-                mBuffer->data() + info.mLength,
-                mBuffer->size() - info.mLength);
-
-        mBuffer->setRange(0, mBuffer->size() - info.mLength);
-
         if (mFormat == NULL) {
             mFormat = MakeAVCCodecSpecificData(accessUnit);
         }
@@ -492,6 +533,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
     switch (mMode) {
         case H264:
             return dequeueAccessUnitH264();
+        case H265:
+            return dequeueAccessUnitH265();
         case AAC:
             return dequeueAccessUnitAAC();
         case AC3:
@@ -751,6 +794,32 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC() {
     return accessUnit;
 }
 
+sp<ABuffer> ElementaryStreamQueue::takeAccessUnitData(size_t size) {
+    // A large access unit is handed out as a slice of mBuffer, and the data following it moves
+    // to a new buffer, which saves copying the access unit itself. The slice keeps all of
+    // mBuffer's memory alive, so smaller ones are copied out and the data compacted instead.
+    const size_t remaining = mBuffer->size() - size;
+    if (size >= mBuffer->capacity() / 2) {
+        sp<ABuffer> buffer = ABuffer::CreatePooled(mBuffer->capacity());
+        if (buffer->base() != NULL) {
+            memcpy(buffer->data(), mBuffer->data() + size, remaining);
+            buffer->setRange(0, remaining);
+
+            sp<ABuffer> accessUnit = mBuffer->slice(0, size);
+            mBuffer = buffer;
+            return accessUnit;
+        }
+    }
+
+    sp<ABuffer> accessUnit = new ABuffer(size);
+    memcpy(accessUnit->data(), mBuffer->data(), size);
+
+    memmove(mBuffer->data(), mBuffer->data() + size, remaining);
+    mBuffer->setRange(0, remaining);
+
+    return accessUnit;
+}
+
 int64_t ElementaryStreamQueue::fetchTimestamp(size_t size) {
     int64_t timeUs = -1;
     bool first = true;
@@ -788,19 +857,25 @@ int64_t ElementaryStreamQueue::fetchTimestamp(size_t size) {
 
 sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
     const uint8_t *data = mBuffer->data();
-
     size_t size = mBuffer->size();
-    Vector<NALPosition> nals;
 
-    size_t totalSize = 0;
-    size_t seiCount = 0;
+    // The scan resumes after the last NAL unit found, and only once the NAL
+    // unit following it can be complete.
+    if (mScannedSize > 0
+            && !hasNewStartCode(data, size, mScannedSize, mScanOffset)) {
+        return NULL;
+    }
+    mScannedSize = 0;
+
+    const uint8_t *scan = data + mScanOffset;
+    size_t scanSize = size - mScanOffset;
 
     status_t err;
     const uint8_t *nalStart;
     size_t nalSize;
-    bool foundSlice = false;
-    bool foundIDR = false;
-    while ((err = getNextNALUnit(&data, &size, &nalStart, &nalSize)) == OK) {
+    while ((err = getNextNALUnit(&scan, &scanSize, &nalStart, &nalSize)) == OK) {
+        mScanOffset = nalStart + nalSize - data;
+
         if (nalSize == 0) continue;
 
         unsigned nalType = nalStart[0] & 0x1f;
@@ -808,9 +883,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
 
         if (nalType == 1 || nalType == 5) {
             if (nalType == 5) {
-                foundIDR = true;
+                mScanFoundIDR = true;
             }
-            if (foundSlice) {
+            if (mScanFoundSlice) {
                 ABitReader br(nalStart + 1, nalSize);
                 unsigned first_mb_in_slice = parseUE(&br);
 
@@ -821,27 +896,27 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
                 }
             }
 
-            foundSlice = true;
-        } else if ((nalType == 9 || nalType == 7) && foundSlice) {
+            mScanFoundSlice = true;
+        } else if ((nalType == 9 || nalType == 7) && mScanFoundSlice) {
             // Access unit delimiter and SPS will be associated with the
             // next frame.
 
             flush = true;
         } else if (nalType == 6 && nalSize > 0) {
             // found non-zero sized SEI
-            ++seiCount;
+            ++mScanSEICount;
         }
 
         if (flush) {
             // The access unit will contain all nal units up to, but excluding
             // the current one, separated by 0x00 0x00 0x00 0x01 startcodes.
 
-            size_t auSize = 4 * nals.size() + totalSize;
+            size_t auSize = 4 * mScanNALs.size() + mScanTotalSize;
             sp<ABuffer> accessUnit = new ABuffer(auSize);
             sp<ABuffer> sei;
 
-            if (seiCount > 0) {
-                sei = new ABuffer(seiCount * sizeof(NALPosition));
+            if (mScanSEICount > 0) {
+                sei = new ABuffer(mScanSEICount * sizeof(NALPosition));
                 accessUnit->meta()->setBuffer("sei", sei);
             }
 
@@ -851,8 +926,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
 
             size_t dstOffset = 0;
             size_t seiIndex = 0;
-            for (size_t i = 0; i < nals.size(); ++i) {
-                const NALPosition &pos = nals.itemAt(i);
+            for (size_t i = 0; i < mScanNALs.size(); ++i) {
+                const NALPosition &pos = mScanNALs.itemAt(i);
 
                 unsigned nalType = mBuffer->data()[pos.nalOffset] & 0x1f;
 
@@ -888,14 +963,16 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             ALOGV("accessUnit contains nal types %s", out.c_str());
 #endif
 
-            const NALPosition &pos = nals.itemAt(nals.size() - 1);
+            const NALPosition &pos = mScanNALs.itemAt(mScanNALs.size() - 1);
             size_t nextScan = pos.nalOffset + pos.nalSize;
+            bool foundIDR = mScanFoundIDR;
 
             memmove(mBuffer->data(),
                     mBuffer->data() + nextScan,
                     mBuffer->size() - nextScan);
 
             mBuffer->setRange(0, mBuffer->size() - nextScan);
+            resetScan();
 
             int64_t timeUs = fetchTimestamp(nextScan);
             if (timeUs < 0ll) {
@@ -916,18 +993,139 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
         }
 
         NALPosition pos;
-        pos.nalOffset = nalStart - mBuffer->data();
+        pos.nalOffset = nalStart - data;
         pos.nalSize = nalSize;
 
-        nals.push(pos);
+        mScanNALs.push(pos);
 
-        totalSize += nalSize;
+        mScanTotalSize += nalSize;
     }
     if (err != (status_t)-EAGAIN) {
         ALOGE("Unexpeted err");
         return NULL;
     }
 
+    if (scan != NULL) {
+        mScanOffset = scan - data;
+    }
+    mScannedSize = size;
+
+    return NULL;
+}
+
+sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH265() {
+    const uint8_t *data = mBuffer->data();
+    size_t size = mBuffer->size();
+
+    if (mScannedSize > 0
+            && !hasNewStartCode(data, size, mScannedSize, mScanOffset)) {
+        return NULL;
+    }
+    mScannedSize = 0;
+
+    const uint8_t *scan = data + mScanOffset;
+    size_t scanSize = size - mScanOffset;
+
+    status_t err;
+    const uint8_t *nalStart;
+    size_t nalSize;
+    while ((err = getNextNALUnit(&scan, &scanSize, &nalStart, &nalSize)) == OK) {
+        mScanOffset = nalStart + nalSize - data;
+
+        // Skip anything shorter than the two byte NAL unit header.
+        if (nalSize < 2) continue;
+
+        unsigned nalType = (nalStart[0] >> 1) & 0x3f;
+        bool flush = false;
+
+        if (nalType < 32) {
+            // A slice segment, which starts a new picture if its
+            // first_slice_segment_in_pic_flag is set.
+            if (mScanFoundSlice && nalSize > 2 && (nalStart[2] & 0x80)) {
+                flush = true;
+            }
+        } else if (mScanFoundSlice
+                && ((nalType >= 32 && nalType <= 35)      // VPS/SPS/PPS/AUD
+                    || nalType == 39                      // prefix SEI
+                    || (nalType >= 41 && nalType <= 44)
+                    || (nalType >= 48 && nalType <= 55))) {
+            // These precede the first slice of the next access unit,
+            // see Rec. ITU-T H.265 7.4.2.4.4.
+            flush = true;
+        }
+
+        if (flush) {
+            size_t auSize = 4 * mScanNALs.size() + mScanTotalSize;
+            sp<ABuffer> accessUnit = new ABuffer(auSize);
+
+            size_t dstOffset = 0;
+            for (size_t i = 0; i < mScanNALs.size(); ++i) {
+                const NALPosition &pos = mScanNALs.itemAt(i);
+
+                memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
+
+                memcpy(accessUnit->data() + dstOffset + 4,
+                       data + pos.nalOffset,
+                       pos.nalSize);
+
+                dstOffset += pos.nalSize + 4;
+            }
+
+            const NALPosition &pos = mScanNALs.itemAt(mScanNALs.size() - 1);
+            size_t nextScan = pos.nalOffset + pos.nalSize;
+            bool isIRAP = mScanFoundIDR;
+
+            memmove(mBuffer->data(),
+                    mBuffer->data() + nextScan,
+                    mBuffer->size() - nextScan);
+
+            mBuffer->setRange(0, mBuffer->size() - nextScan);
+            resetScan();
+
+            int64_t timeUs = fetchTimestamp(nextScan);
+            if (timeUs < 0ll) {
+                ALOGE("Negative timeUs");
+                return NULL;
+            }
+
+            accessUnit->meta()->setInt64("timeUs", timeUs);
+            if (isIRAP) {
+                accessUnit->meta()->setInt32("isSync", 1);
+            }
+
+            if (mFormat == NULL) {
+                mFormat = MakeHEVCCodecSpecificData(accessUnit);
+            }
+
+            return accessUnit;
+        }
+
+        if (nalType < 32) {
+            if (nalType >= 16 && nalType <= 23) {
+                // BLA, IDR or CRA picture.
+                mScanFoundIDR = true;
+            }
+            mScanFoundSlice = true;
+        }
+
+        NALPosition pos;
+        pos.nalOffset = nalStart - data;
+        pos.nalSize = nalSize;
+
+        mScanNALs.push(pos);
+
+        mScanTotalSize += nalSize;
+    }
+    if (err != (status_t)-EAGAIN) {
+        ALOGE("Unexpeted err");
+        return NULL;
+    }
+
+    if (scan != NULL) {
+        mScanOffset = scan - data;
+    }
+    mScannedSize = size;
+
     return NULL;
 }
 
@@ -1058,12 +1256,18 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
     bool isClosedGop = false;
     bool brokenLink = false;
 
+    if (mScannedSize > 0 && !hasNewStartCode(data, size, mScannedSize, 0)) {
+        return NULL;
+    }
+    mScannedSize = 0;
+
     size_t offset = 0;
-    while (offset + 3 < size) {
-        if (memcmp(&data[offset], "\x00\x00\x01", 3)) {
-            ++offset;
-            continue;
+    for (;;) {
+        ssize_t startCodeOffset = findStartCode(data, size, offset);
+        if (startCodeOffset < 0 || (size_t)startCodeOffset + 3 >= size) {
+            break;
         }
+        offset = startCodeOffset;
 
         pprevStartCode = prevStartCode;
         prevStartCode = currentStartCode;
@@ -1143,14 +1347,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
             if (!sawPictureStart) {
                 sawPictureStart = true;
             } else {
-                sp<ABuffer> accessUnit = new ABuffer(offset);
-                memcpy(accessUnit->data(), data, offset);
-
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                sp<ABuffer> accessUnit = takeAccessUnitData(offset);
 
                 int64_t timeUs = fetchTimestamp(offset);
                 if (timeUs < 0ll) {
@@ -1190,6 +1387,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
         ++offset;
     }
 
+    mScannedSize = mBuffer->size();
+
     return NULL;
 }
 
@@ -1205,16 +1404,7 @@ static ssize_t getNextChunkSize(
         return -EAGAIN;
     }
 
-    size_t offset = 3;
-    while (offset + 2 < size) {
-        if (!memcmp(&data[offset], kStartCode, 3)) {
-            return offset;
-        }
-
-        ++offset;
-    }
-
-    return -EAGAIN;
+    return findStartCode(data, size, 3);
 }
 
 sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
@@ -1239,6 +1429,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
     int32_t width = -1, height = -1;
 
+    if (mScannedSize > 0 && !hasNewStartCode(data, size, mScannedSize, 0)) {
+        return NULL;
+    }
+    mScannedSize = 0;
+
     size_t offset = 0;
     ssize_t chunkSize;
     while ((chunkSize = getNextChunkSize(
@@ -1337,12 +1532,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
                     offset += chunkSize;
 
-                    sp<ABuffer> accessUnit = new ABuffer(offset);
-                    memcpy(accessUnit->data(), data, offset);
-
-                    memmove(data, &data[offset], size - offset);
-                    size -= offset;
-                    mBuffer->setRange(0, size);
+                    sp<ABuffer> accessUnit = takeAccessUnitData(offset);
 
                     int64_t timeUs = fetchTimestamp(offset);
                     if (timeUs < 0ll) {
@@ -1387,6 +1577,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
         }
     }
 
+    mScannedSize = mBuffer->size();
+
     return NULL;
 }
 
@@ -22,6 +22,9 @@
 #include <utils/Errors.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+#include "include/avc_utils.h"
 
 namespace android {
 
@@ -38,6 +41,7 @@ struct ElementaryStreamQueue {
         MPEG4_VIDEO,
         PCM_AUDIO,
         METADATA,
+        H265,
     };
 
     enum Flags {
@@ -69,7 +73,24 @@ private:
 
     sp<MetaData> mFormat;
 
+    // The size of mBuffer covered by the last access unit scan that ran out
+    // of data, 0 if there was none since mBuffer last lost data at its front.
+    // Until a start code is appended beyond it, a new scan cannot find more.
+    size_t mScannedSize;
+
+    // H.264/H.265 scan state kept across calls: where the scan resumes and
+    // the NAL units of the pending access unit found so far.
+    size_t mScanOffset;
+    Vector<NALPosition> mScanNALs;
+    size_t mScanTotalSize;
+    size_t mScanSEICount;
+    bool mScanFoundSlice;
+    bool mScanFoundIDR;
+
+    void resetScan();
+
     sp<ABuffer> dequeueAccessUnitH264();
+    sp<ABuffer> dequeueAccessUnitH265();
     sp<ABuffer> dequeueAccessUnitAAC();
     sp<ABuffer> dequeueAccessUnitAC3();
     sp<ABuffer> dequeueAccessUnitMPEGAudio();
@@ -82,6 +103,9 @@ private:
     // returns its timestamp in us (or -1 if no time information).
     int64_t fetchTimestamp(size_t size);
 
+    // removes the first "size" bytes of mBuffer and returns them as a new buffer.
+    sp<ABuffer> takeAccessUnitData(size_t size);
+
     DISALLOW_EVIL_CONSTRUCTORS(ElementaryStreamQueue);
 };
 
@@ -40,6 +40,8 @@
 namespace android {
 
 static const size_t kTSPacketSize = 188;
+// the packets read from the source at once
+static const size_t kNumReadPackets = 64;
 
 struct MPEG2TSSource : public MediaSource {
     MPEG2TSSource(
@@ -113,7 +115,10 @@ MPEG2TSExtractor::MPEG2TSExtractor(const sp<DataSource> &source)
     : mDataSource(source),
       mParser(new ATSParser),
       mLastSyncEvent(0),
-      mOffset(0) {
+      mOffset(0),
+      mReadBuffer(new ABuffer(kNumReadPackets * kTSPacketSize)),
+      mReadBufferOffset(0) {
+    mReadBuffer->setRange(0, 0);
     init();
 }
 
@@ -254,18 +259,28 @@ void MPEG2TSExtractor::init() {
 status_t MPEG2TSExtractor::feedMore(bool isInit) {
     Mutex::Autolock autoLock(mLock);
 
-    uint8_t packet[kTSPacketSize];
-    ssize_t n = mDataSource->readAt(mOffset, packet, kTSPacketSize);
+    // the packet at mOffset, from the read buffer, refilled after seeks and once all of it
+    // has been fed
+    if (mOffset < mReadBufferOffset
+            || mOffset + (off64_t)kTSPacketSize
+                    > mReadBufferOffset + (off64_t)mReadBuffer->size()) {
+        ssize_t n = mDataSource->readAt(
+                mOffset, mReadBuffer->base(), mReadBuffer->capacity());
 
-    if (n < (ssize_t)kTSPacketSize) {
-        if (n >= 0) {
-            mParser->signalEOS(ERROR_END_OF_STREAM);
+        mReadBufferOffset = mOffset;
+        mReadBuffer->setRange(0, n > 0 ? n : 0);
+
+        if (n < (ssize_t)kTSPacketSize) {
+            if (n >= 0) {
+                mParser->signalEOS(ERROR_END_OF_STREAM);
+            }
+            return (n < 0) ? (status_t)n : ERROR_END_OF_STREAM;
         }
-        return (n < 0) ? (status_t)n : ERROR_END_OF_STREAM;
     }
+    const uint8_t *packet = mReadBuffer->data() + (mOffset - mReadBufferOffset);
 
     ATSParser::SyncEvent event(mOffset);
-    mOffset += n;
+    mOffset += kTSPacketSize;
     status_t err = mParser->feedTSPacket(packet, kTSPacketSize, &event);
     if (event.hasReturnedData()) {
         if (isInit) {
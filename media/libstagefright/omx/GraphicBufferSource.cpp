@@ -27,6 +27,7 @@
 
 #include <OMX_Core.h>
 #include <OMX_IndexExt.h>
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/ColorUtils.h>
@@ -145,7 +146,9 @@ GraphicBufferSource::GraphicBufferSource(
     mTimePerFrameUs(-1ll),
     mPrevCaptureUs(-1ll),
     mPrevFrameUs(-1ll),
-    mInputBufferTimeOffsetUs(0ll) {
+    mInputBufferTimeOffsetUs(0ll),
+    mSkipUnchangedFrames(property_get_bool("media.stagefright.gbs-skip-unchanged", false)),
+    mNumUnchangedFramesSkipped(0) {
 
     ALOGV("GraphicBufferSource w=%u h=%u c=%u",
             bufferWidth, bufferHeight, bufferCount);
@@ -289,6 +292,8 @@ void GraphicBufferSource::omxLoaded(){
         // This can happen if something failed very early.
         ALOGW("Dropped back down to Loaded without Executing");
     }
+    ALOGI_IF(mNumUnchangedFramesSkipped > 0,
+            "skipped %zu unchanged frames", mNumUnchangedFramesSkipped);
 
     if (mLooper != NULL) {
         mLooper->unregisterHandler(mReflector->id());
@@ -650,6 +655,15 @@ bool GraphicBufferSource::fillCodecBuffer_l() {
         }
 
         int64_t timeUs = item.mTimestamp / 1000;
+        if (isUnchangedFrame_l(item)) {
+            // Same content as the latest buffer, which the repeat timer
+            // keeps refreshing anyway; don't restart it, and don't replace
+            // the latest buffer so its timestamp keeps advancing from there.
+            ALOGV("skipping unchanged frame (%lld)", static_cast<long long>(timeUs));
+            ++mNumUnchangedFramesSkipped;
+            releaseBuffer(item.mSlot, item.mFrameNumber, item.mGraphicBuffer, item.mFence);
+            return true;
+        }
         if (mFrameDropper != NULL && mFrameDropper->shouldDrop(timeUs)) {
             ALOGV("skipping frame (%lld) to meet max framerate", static_cast<long long>(timeUs));
             // set err to OK so that the skipped frame can still be saved as the lastest frame
@@ -671,6 +685,21 @@ bool GraphicBufferSource::fillCodecBuffer_l() {
     return true;
 }
 
+bool GraphicBufferSource::isUnchangedFrame_l(const BufferItem &item) const {
+    // Only for sources that repeat frames, e.g. screen recording, where the
+    // encoder is expected to see gaps.  An empty damage region means the
+    // producer redrew nothing since its previous frame; producers that don't
+    // track damage report the whole buffer (INVALID_REGION) instead.
+    if (!mSkipUnchangedFrames || mRepeatAfterUs <= 0ll || mLatestBufferId < 0) {
+        return false;
+    }
+    if (item.mSurfaceDamage.isRect()
+            && item.mSurfaceDamage.getBounds() == Rect::INVALID_RECT) {
+        return false;
+    }
+    return item.mSurfaceDamage.isEmpty();
+}
+
 bool GraphicBufferSource::repeatLatestBuffer_l() {
     CHECK(mExecuting && mNumFramesAvailable == 0);
 
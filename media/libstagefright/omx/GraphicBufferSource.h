@@ -246,6 +246,10 @@ private:
 
     void setLatestBuffer_l(const BufferItem &item, bool dropped);
     bool repeatLatestBuffer_l();
+
+    // Returns true if item has the same content as the latest buffer and
+    // doesn't need to be encoded.
+    bool isUnchangedFrame_l(const BufferItem &item) const;
     int64_t getTimestamp(const BufferItem &item);
 
     // called when the data space of the input buffer changes
@@ -338,6 +342,11 @@ private:
 
     int64_t mInputBufferTimeOffsetUs;
 
+    // Drop frames whose surface damage says nothing changed, set by
+    // media.stagefright.gbs-skip-unchanged.
+    bool mSkipUnchangedFrames;
+    size_t mNumUnchangedFramesSkipped;
+
     MetadataBufferType mMetadataBufferType;
     ColorAspects mColorAspects;
 
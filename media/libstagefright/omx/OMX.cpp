@@ -27,6 +27,7 @@
 #include "../include/OMXNodeInstance.h"
 
 #include <binder/IMemory.h>
+#include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <utils/threads.h>
 
@@ -74,6 +75,11 @@ struct OMX::CallbackDispatcher : public RefBase {
 
     bool loop();
 
+    enum {
+        // most buffer messages held back for a single dispatch
+        kMaxCoalescedMessages = 16,
+    };
+
 protected:
     virtual ~CallbackDispatcher();
 
@@ -85,6 +91,13 @@ private:
     Condition mQueueChanged;
     std::list<omx_message> mQueue;
 
+    // Buffer messages are held back for up to mCoalesceNs after the first
+    // one is queued, so that they reach the observer in fewer transactions;
+    // events are dispatched right away together with them.
+    nsecs_t mCoalesceNs;
+    nsecs_t mFirstQueuedNs;
+    bool mHaveEvent;
+
     sp<CallbackDispatcherThread> mThread;
 
     void dispatch(std::list<omx_message> &messages);
@@ -95,7 +108,15 @@ private:
 
 OMX::CallbackDispatcher::CallbackDispatcher(OMXNodeInstance *owner)
     : mOwner(owner),
-      mDone(false) {
+      mDone(false),
+      mCoalesceNs(0),
+      mFirstQueuedNs(0),
+      mHaveEvent(false) {
+    int32_t coalesceUs = property_get_int32("media.omx.coalesce-us", 0);
+    if (coalesceUs > 0) {
+        mCoalesceNs = (nsecs_t)coalesceUs * 1000;
+    }
+
     mThread = new CallbackDispatcherThread(this);
     mThread->run("OMXCallbackDisp", ANDROID_PRIORITY_FOREGROUND);
 }
@@ -121,7 +142,13 @@ OMX::CallbackDispatcher::~CallbackDispatcher() {
 void OMX::CallbackDispatcher::post(const omx_message &msg, bool realTime) {
     Mutex::Autolock autoLock(mLock);
 
+    if (mQueue.empty()) {
+        mFirstQueuedNs = systemTime();
+    }
     mQueue.push_back(msg);
+    if (msg.type == omx_message::EVENT) {
+        mHaveEvent = true;
+    }
     if (realTime) {
         mQueueChanged.signal();
     }
@@ -145,11 +172,23 @@ bool OMX::CallbackDispatcher::loop() {
                 mQueueChanged.wait(mLock);
             }
 
+            if (mCoalesceNs > 0) {
+                nsecs_t deadlineNs = mFirstQueuedNs + mCoalesceNs;
+                while (!mDone && !mHaveEvent && mQueue.size() < kMaxCoalescedMessages) {
+                    nsecs_t nowNs = systemTime();
+                    if (nowNs >= deadlineNs) {
+                        break;
+                    }
+                    mQueueChanged.waitRelative(mLock, deadlineNs - nowNs);
+                }
+            }
+
             if (mDone) {
                 break;
             }
 
             messages.swap(mQueue);
+            mHaveEvent = false;
         }
 
         dispatch(messages);
@@ -15,6 +15,8 @@
  */
 
 #include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
 
 //#define LOG_NDEBUG 0
 #define LOG_TAG "SoftVideoDecoderOMXComponent"
@@ -22,6 +24,7 @@
 
 #include "include/SoftVideoDecoderOMXComponent.h"
 
+#include <cutils/properties.h>
 #include <media/hardware/HardwareAPI.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
@@ -309,6 +312,26 @@ void SoftVideoDecoderOMXComponent::copyYV12FrameToOutputBuffer(
     size_t dstHeight = outputBufferHeight();
     uint8_t *dstStart = dst;
 
+    // A decoder that already wrote the frame into the output buffer has
+    // nothing left to copy.  One whose planes are laid out like the output
+    // buffer's gets a single copy per plane instead of one per row.
+    if (srcYStride == dstYStride && srcUStride == dstUVStride && srcVStride == dstUVStride
+            && dstHeight == mHeight) {
+        uint8_t *dstU = dstStart + dstYStride * dstHeight;
+        uint8_t *dstV = dstStart + (5 * dstYStride * dstHeight) / 4;
+        size_t uvSize = dstUVStride * (mHeight / 2);
+        if (srcY != dst) {
+            memmove(dst, srcY, dstYStride * mHeight);
+        }
+        if (srcU != dstU) {
+            memmove(dstU, srcU, uvSize);
+        }
+        if (srcV != dstV) {
+            memmove(dstV, srcV, uvSize);
+        }
+        return;
+    }
+
     for (size_t i = 0; i < mHeight; ++i) {
          memcpy(dst, srcY, mWidth);
          srcY += srcYStride;
@@ -626,6 +649,46 @@ int SoftVideoDecoderOMXComponent::getColorAspectPreference() {
     return kNotSupported;
 }
 
+// static
+size_t SoftVideoDecoderOMXComponent::GetDecoderThreadCount(size_t maxThreads) {
+    int32_t threads = property_get_int32("media.swcodec.threads", 0);
+    if (threads <= 0) {
+        long numOnline = sysconf(_SC_NPROCESSORS_ONLN);
+        long numConfigured = sysconf(_SC_NPROCESSORS_CONF);
+        threads = numOnline > 0 ? numOnline : 1;
+
+        long maxFreqKHz = 0;
+        int32_t numFastest = 0;
+        for (long cpu = 0; cpu < numConfigured; ++cpu) {
+            char path[80];
+            snprintf(path, sizeof(path),
+                    "/sys/devices/system/cpu/cpu%ld/cpufreq/cpuinfo_max_freq", cpu);
+            FILE *file = fopen(path, "r");
+            if (file == NULL) {
+                // offline, or no cpufreq
+                continue;
+            }
+            long freqKHz;
+            if (fscanf(file, "%ld", &freqKHz) == 1) {
+                if (freqKHz > maxFreqKHz) {
+                    maxFreqKHz = freqKHz;
+                    numFastest = 1;
+                } else if (freqKHz == maxFreqKHz) {
+                    ++numFastest;
+                }
+            }
+            fclose(file);
+        }
+        if (numFastest >= 2 && numFastest < threads) {
+            threads = numFastest;
+        }
+    }
+
+    size_t numThreads = (size_t)threads < maxThreads ? threads : maxThreads;
+    ALOGV("using %zu decoder threads", numThreads);
+    return numThreads;
+}
+
 void SoftVideoDecoderOMXComponent::onReset() {
     mOutputPortSettingsChange = NONE;
 }
@@ -138,6 +138,7 @@ void AAVCAssembler::addSingleNALUnit(const sp<ABuffer> &buffer) {
     mAccessUnitRTPTime = rtpTime;
 
     mNALUnits.push_back(buffer);
+    mNALUnitPieces.push_back(1);
 }
 
 bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
@@ -159,8 +160,7 @@ bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
             return false;
         }
 
-        sp<ABuffer> unit = new ABuffer(nalSize);
-        memcpy(unit->data(), &data[2], nalSize);
+        sp<ABuffer> unit = buffer->slice(&data[2] - buffer->data(), nalSize);
 
         CopyTimes(unit, buffer);
 
@@ -212,7 +212,6 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
     uint32_t nri = (data[0] >> 5) & 3;
 
     uint32_t expectedSeqNo = (uint32_t)buffer->int32Data() + 1;
-    size_t totalSize = size - 2;
     size_t totalCount = 1;
     bool complete = false;
 
@@ -257,7 +256,6 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
                 return MALFORMED_PACKET;
             }
 
-            totalSize += size - 2;
             ++totalCount;
 
             expectedSeqNo = expectedSeqNo + 1;
@@ -279,36 +277,31 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
     mNextExpectedSeqNo = expectedSeqNo;
 
     // We found all the fragments that make up the complete NAL unit.
+    // They become its pieces in place: the FU header of the first one is
+    // replaced by the NAL unit header, and the others lose both headers.
 
-    // Leave room for the header. So far totalSize did not include the
-    // header byte.
-    ++totalSize;
-
-    sp<ABuffer> unit = new ABuffer(totalSize);
-    CopyTimes(unit, *queue->begin());
-
-    unit->data()[0] = (nri << 5) | nalType;
-
-    size_t offset = 1;
     List<sp<ABuffer> >::iterator it = queue->begin();
     for (size_t i = 0; i < totalCount; ++i) {
-        const sp<ABuffer> &buffer = *it;
+        sp<ABuffer> fragment = *it;
 
         ALOGV("piece #%zu/%zu", i + 1, totalCount);
 #if !LOG_NDEBUG
-        hexdump(buffer->data(), buffer->size());
+        hexdump(fragment->data(), fragment->size());
 #endif
 
-        memcpy(unit->data() + offset, buffer->data() + 2, buffer->size() - 2);
-        offset += buffer->size() - 2;
+        if (i == 0) {
+            fragment->data()[1] = (nri << 5) | nalType;
+            fragment->setRange(fragment->offset() + 1, fragment->size() - 1);
+            addSingleNALUnit(fragment);
+        } else {
+            fragment->setRange(fragment->offset() + 2, fragment->size() - 2);
+            mNALUnits.push_back(fragment);
+            ++*--mNALUnitPieces.end();
+        }
 
         it = queue->erase(it);
     }
 
-    unit->setRange(0, totalSize);
-
-    addSingleNALUnit(unit);
-
     ALOGV("successfully assembled a NAL unit from fragments.");
 
     return OK;
@@ -317,24 +310,35 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
 void AAVCAssembler::submitAccessUnit() {
     CHECK(!mNALUnits.empty());
 
-    ALOGV("Access unit complete (%zu nal units)", mNALUnits.size());
+    ALOGV("Access unit complete (%zu nal units)", mNALUnitPieces.size());
 
-    size_t totalSize = 0;
+    size_t totalSize = 4 * mNALUnitPieces.size();
     for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
          it != mNALUnits.end(); ++it) {
-        totalSize += 4 + (*it)->size();
+        totalSize += (*it)->size();
+    }
+
+    sp<ABuffer> accessUnit = ABuffer::CreatePooled(totalSize);
+    if (accessUnit->capacity() < totalSize) {
+        ALOGE("cannot allocate a %zu byte access unit", totalSize);
+        mNALUnits.clear();
+        mNALUnitPieces.clear();
+        mAccessUnitDamaged = false;
+        return;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(totalSize);
     size_t offset = 0;
-    for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
-         it != mNALUnits.end(); ++it) {
+    List<sp<ABuffer> >::iterator it = mNALUnits.begin();
+    for (List<size_t>::iterator pieces = mNALUnitPieces.begin();
+         pieces != mNALUnitPieces.end(); ++pieces) {
         memcpy(accessUnit->data() + offset, "\x00\x00\x00\x01", 4);
         offset += 4;
 
-        sp<ABuffer> nal = *it;
-        memcpy(accessUnit->data() + offset, nal->data(), nal->size());
-        offset += nal->size();
+        for (size_t i = 0; i < *pieces; ++i, ++it) {
+            const sp<ABuffer> &piece = *it;
+            memcpy(accessUnit->data() + offset, piece->data(), piece->size());
+            offset += piece->size();
+        }
     }
 
     CopyTimes(accessUnit, *mNALUnits.begin());
@@ -349,6 +353,7 @@ void AAVCAssembler::submitAccessUnit() {
     }
 
     mNALUnits.clear();
+    mNALUnitPieces.clear();
     mAccessUnitDamaged = false;
 
     sp<AMessage> msg = mNotifyMsg->dup();
@@ -45,7 +45,10 @@ private:
     bool mNextExpectedSeqNoValid;
     uint32_t mNextExpectedSeqNo;
     bool mAccessUnitDamaged;
+    // The NAL units of the current access unit, as pieces of the received
+    // packets, and the number of pieces of each NAL unit.
     List<sp<ABuffer> > mNALUnits;
+    List<size_t> mNALUnitPieces;
 
     AssemblyStatus addNALUnit(const sp<ARTPSource> &source);
     void addSingleNALUnit(const sp<ABuffer> &buffer);
@@ -165,7 +165,14 @@ void AH263Assembler::submitAccessUnit() {
         ++it;
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(totalSize);
+    sp<ABuffer> accessUnit = ABuffer::CreatePooled(totalSize);
+    if (accessUnit->capacity() < totalSize) {
+        ALOGE("cannot allocate a %zu byte access unit", totalSize);
+        mPackets.clear();
+        mAccessUnitDamaged = false;
+        return;
+    }
+
     size_t offset = 0;
     it = mPackets.begin();
     while (it != mPackets.end()) {
@@ -31,12 +31,17 @@
 #include <media/stagefright/foundation/hexdump.h>
 
 #include <arpa/inet.h>
+#include <errno.h>
+#include <string.h>
 #include <sys/socket.h>
 
 namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+// Datagrams are received into buffers large enough for any of them.
+static const size_t kReceiveBufferSize = 65536;
+
 static uint16_t u16at(const uint8_t *data) {
     return data[0] << 8 | data[1];
 }
@@ -52,6 +57,9 @@ static uint64_t u64at(const uint8_t *data) {
 // static
 const int64_t ARTPConnection::kSelectTimeoutUs = 1000ll;
 
+// static
+const size_t ARTPConnection::kMaxReceiveBatch = 16;
+
 struct ARTPConnection::StreamInfo {
     int mRTPSocket;
     int mRTCPSocket;
@@ -70,7 +78,8 @@ struct ARTPConnection::StreamInfo {
 ARTPConnection::ARTPConnection(uint32_t flags)
     : mFlags(flags),
       mPollEventPending(false),
-      mLastReceiverReportTimeUs(-1) {
+      mLastReceiverReportTimeUs(-1),
+      mBatchedReceive(true) {
 }
 
 ARTPConnection::~ARTPConnection() {
@@ -375,39 +384,96 @@ status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
 
     CHECK(!s->mIsInjected);
 
-    sp<ABuffer> buffer = new ABuffer(65536);
+    int sock = receiveRTP ? s->mRTPSocket : s->mRTCPSocket;
+
+    // Until the first RTCP packet arrives we don't know where to send
+    // receiver reports to.
+    bool needRemoteAddr = !receiveRTP && s->mNumRTCPPacketsReceived == 0;
+
+    size_t numBuffers = mBatchedReceive ? kMaxReceiveBatch : 1;
+    while (mReceiveBuffers.size() < numBuffers) {
+        mReceiveBuffers.push(ABuffer::CreatePooled(kReceiveBufferSize));
+    }
 
-    socklen_t remoteAddrLen =
-        (!receiveRTP && s->mNumRTCPPacketsReceived == 0)
-            ? sizeof(s->mRemoteRTCPAddr) : 0;
+    struct mmsghdr msgs[kMaxReceiveBatch];
+    struct iovec iovs[kMaxReceiveBatch];
+    struct sockaddr_in remoteAddr;
+
+    ssize_t n = -1;
+    if (mBatchedReceive) {
+        memset(msgs, 0, sizeof(msgs));
+        for (size_t i = 0; i < numBuffers; ++i) {
+            const sp<ABuffer> &buffer = mReceiveBuffers.itemAt(i);
+            iovs[i].iov_base = buffer->base();
+            iovs[i].iov_len = buffer->capacity();
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        if (needRemoteAddr) {
+            msgs[0].msg_hdr.msg_name = &remoteAddr;
+            msgs[0].msg_hdr.msg_namelen = sizeof(remoteAddr);
+        }
 
-    ssize_t nbytes;
-    do {
-        nbytes = recvfrom(
-            receiveRTP ? s->mRTPSocket : s->mRTCPSocket,
-            buffer->data(),
-            buffer->capacity(),
-            0,
-            remoteAddrLen > 0 ? (struct sockaddr *)&s->mRemoteRTCPAddr : NULL,
-            remoteAddrLen > 0 ? &remoteAddrLen : NULL);
-    } while (nbytes < 0 && errno == EINTR);
+        // select() said there is at least one datagram, take whatever else
+        // has queued up since without blocking.
+        do {
+            n = recvmmsg(sock, msgs, numBuffers, MSG_DONTWAIT, NULL);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0 && errno == ENOSYS) {
+            ALOGW("recvmmsg is not supported, receiving one datagram at a time");
+            mBatchedReceive = false;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return OK;
+        }
+    }
 
-    if (nbytes <= 0) {
+    if (!mBatchedReceive) {
+        socklen_t remoteAddrLen = sizeof(remoteAddr);
+        ssize_t nbytes;
+        do {
+            nbytes = recvfrom(
+                sock,
+                mReceiveBuffers[0]->base(),
+                mReceiveBuffers[0]->capacity(),
+                0,
+                needRemoteAddr ? (struct sockaddr *)&remoteAddr : NULL,
+                needRemoteAddr ? &remoteAddrLen : NULL);
+        } while (nbytes < 0 && errno == EINTR);
+
+        n = nbytes < 0 ? -1 : 1;
+        msgs[0].msg_len = nbytes < 0 ? 0 : nbytes;
+    }
+
+    if (n <= 0) {
         return -ECONNRESET;
     }
 
-    buffer->setRange(0, nbytes);
+    if (needRemoteAddr) {
+        s->mRemoteRTCPAddr = remoteAddr;
+    }
 
-    // ALOGI("received %d bytes.", buffer->size());
+    for (ssize_t i = 0; i < n; ++i) {
+        if (msgs[i].msg_len == 0) {
+            return -ECONNRESET;
+        }
 
-    status_t err;
-    if (receiveRTP) {
-        err = parseRTP(s, buffer);
-    } else {
-        err = parseRTCP(s, buffer);
+        // The received buffer now belongs to the sources' queues, replace
+        // it with a fresh one for the next receive.
+        sp<ABuffer> buffer = mReceiveBuffers[i];
+        mReceiveBuffers.editItemAt(i) = ABuffer::CreatePooled(kReceiveBufferSize);
+        buffer->setRange(0, msgs[i].msg_len);
+
+        // ALOGI("received %d bytes.", buffer->size());
+
+        if (receiveRTP) {
+            parseRTP(s, buffer);
+        } else {
+            parseRTCP(s, buffer);
+        }
     }
 
-    return err;
+    return OK;
 }
 
 status_t ARTPConnection::parseRTP(StreamInfo *s, const sp<ABuffer> &buffer) {
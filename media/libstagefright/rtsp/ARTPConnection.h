@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/AHandler.h>
 #include <utils/List.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -63,6 +64,7 @@ private:
     };
 
     static const int64_t kSelectTimeoutUs;
+    static const size_t kMaxReceiveBatch;
 
     uint32_t mFlags;
 
@@ -72,6 +74,11 @@ private:
     bool mPollEventPending;
     int64_t mLastReceiverReportTimeUs;
 
+    // Datagram buffers for the next receive(), from the ABuffer block pool.
+    // Only the ones handed to parseRTP/parseRTCP are replaced.
+    Vector<sp<ABuffer> > mReceiveBuffers;
+    bool mBatchedReceive;
+
     void onAddStream(const sp<AMessage> &msg);
     void onRemoveStream(const sp<AMessage> &msg);
     void onPollStreams();
@@ -37,6 +37,11 @@ namespace android {
 
 static const uint32_t kSourceID = 0xdeadbeef;
 
+static const size_t kJitterRingSize = 64;
+static const uint32_t kMaxJitterDepth = kJitterRingSize / 2;
+static const int64_t kMaxJitterHoldUs = 50000ll;
+static const uint32_t kJitterDecayPackets = 1000;
+
 ARTPSource::ARTPSource(
         uint32_t id,
         const sp<ASessionDescription> &sessionDesc, size_t index,
@@ -44,12 +49,19 @@ ARTPSource::ARTPSource(
     : mID(id),
       mHighestSeqNumber(0),
       mNumBuffersReceived(0),
+      mNextSeqNumber(0),
+      mNumHeldBuffers(0),
+      mHeldSinceUs(0),
+      mJitterDepth(0),
+      mNumInOrderSinceReorder(0),
       mLastNTPTime(0),
       mLastNTPTimeUpdateUs(0),
       mIssueFIRRequests(false),
       mLastFIRRequestUs(-1),
       mNextFIRSeqNo((rand() * 256.0) / RAND_MAX),
       mNotify(notify) {
+    mJitterRing.insertAt(0, kJitterRingSize);
+
     unsigned long PT;
     AString desc;
     AString params;
@@ -107,6 +119,7 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     if (mNumBuffersReceived++ == 0) {
         mHighestSeqNumber = seqNum;
+        mNextSeqNumber = seqNum + 1;
         mQueue.push_back(buffer);
         return true;
     }
@@ -151,22 +164,117 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     buffer->setInt32Data(seqNum);
 
-    List<sp<ABuffer> >::iterator it = mQueue.begin();
-    while (it != mQueue.end() && (uint32_t)(*it)->int32Data() < seqNum) {
-        ++it;
+    if (seqNum < mNextSeqNumber) {
+        if (!insertLatePacket(buffer)) {
+            return false;
+        }
+
+        // Later than the jitter buffer waited for, make it wait longer.
+        uint32_t lateness = mNextSeqNumber - seqNum;
+        if (lateness > mJitterDepth) {
+            mJitterDepth = lateness < kMaxJitterDepth ? lateness : kMaxJitterDepth;
+            ALOGV("jitter buffer depth now %u", mJitterDepth);
+        }
+        mNumInOrderSinceReorder = 0;
+        return true;
+    }
+
+    if (seqNum == mNextSeqNumber) {
+        mQueue.push_back(buffer);
+        ++mNextSeqNumber;
+
+        if (mNumHeldBuffers > 0) {
+            // filled the gap at the head of the jitter buffer
+            mNumInOrderSinceReorder = 0;
+            releaseHeldPackets(false /* all */);
+        } else if (mJitterDepth > 0
+                && ++mNumInOrderSinceReorder >= kJitterDecayPackets) {
+            --mJitterDepth;
+            mNumInOrderSinceReorder = 0;
+        }
+        return true;
+    }
+
+    if (seqNum - mNextSeqNumber >= kJitterRingSize) {
+        // Too far ahead to be held, give up on everything before it.
+        releaseHeldPackets(true /* all */);
+        mNextSeqNumber = seqNum + 1;
+        mQueue.push_back(buffer);
+        return true;
     }
 
-    if (it != mQueue.end() && (uint32_t)(*it)->int32Data() == seqNum) {
+    sp<ABuffer> *slot = &mJitterRing.editItemAt(seqNum & (kJitterRingSize - 1));
+    if (*slot != NULL) {
         ALOGW("Discarding duplicate buffer");
         return false;
     }
+    *slot = buffer;
+    if (mNumHeldBuffers++ == 0) {
+        mHeldSinceUs = ALooper::GetNowUs();
+    }
 
-    mQueue.insert(it, buffer);
+    // Stop waiting for the missing packets once enough have arrived after
+    // them, or the oldest held one has waited too long.
+    size_t queueSize = mQueue.size();
+    while (mNumHeldBuffers > 0
+            && (mHighestSeqNumber - mNextSeqNumber >= mJitterDepth
+                || ALooper::GetNowUs() - mHeldSinceUs > kMaxJitterHoldUs)) {
+        while (mJitterRing[mNextSeqNumber & (kJitterRingSize - 1)] == NULL) {
+            ++mNextSeqNumber;
+        }
+        releaseHeldPackets(false /* all */);
+        mHeldSinceUs = ALooper::GetNowUs();
+    }
+    return mQueue.size() > queueSize;
+}
+
+bool ARTPSource::insertLatePacket(const sp<ABuffer> &buffer) {
+    uint32_t seqNum = (uint32_t)buffer->int32Data();
+
+    // Late packets are usually close to the end of the queue.
+    List<sp<ABuffer> >::iterator it = mQueue.end();
+    while (it != mQueue.begin()) {
+        List<sp<ABuffer> >::iterator prev = it;
+        --prev;
+
+        uint32_t prevSeqNum = (uint32_t)(*prev)->int32Data();
+        if (prevSeqNum == seqNum) {
+            ALOGW("Discarding duplicate buffer");
+            return false;
+        }
+        if (prevSeqNum < seqNum) {
+            break;
+        }
+        it = prev;
+    }
 
+    mQueue.insert(it, buffer);
     return true;
 }
 
+// Moves the held packets from mNextSeqNumber on up to the next gap to
+// mQueue, or all of them, skipping over the gaps.
+void ARTPSource::releaseHeldPackets(bool all) {
+    while (mNumHeldBuffers > 0) {
+        sp<ABuffer> *slot = &mJitterRing.editItemAt(mNextSeqNumber & (kJitterRingSize - 1));
+        if (*slot == NULL) {
+            if (!all) {
+                break;
+            }
+        } else {
+            mQueue.push_back(*slot);
+            slot->clear();
+            --mNumHeldBuffers;
+        }
+        ++mNextSeqNumber;
+    }
+}
+
 void ARTPSource::byeReceived() {
+    if (mNumHeldBuffers > 0) {
+        releaseHeldPackets(true /* all */);
+        mAssembler->onPacketReceived(this);
+    }
     mAssembler->onByeReceived();
 }
 
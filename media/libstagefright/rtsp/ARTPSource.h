@@ -23,6 +23,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -51,7 +52,22 @@ private:
     uint32_t mHighestSeqNumber;
     int32_t mNumBuffersReceived;
 
+    // Packets in sequence number order, for the assembler.
     List<sp<ABuffer> > mQueue;
+
+    // Jitter buffer: packets that arrived after a gap in the sequence
+    // numbers are held in mJitterRing, indexed by sequence number, until
+    // the gap is filled, more than mJitterDepth packets have arrived after
+    // it or the oldest has been held for too long.  mJitterDepth grows with
+    // the reordering observed and decays while packets arrive in order; at
+    // 0 every packet goes to mQueue as it arrives.
+    Vector<sp<ABuffer> > mJitterRing;
+    uint32_t mNextSeqNumber;
+    size_t mNumHeldBuffers;
+    int64_t mHeldSinceUs;
+    uint32_t mJitterDepth;
+    uint32_t mNumInOrderSinceReorder;
+
     sp<ARTPAssembler> mAssembler;
 
     uint64_t mLastNTPTime;
@@ -64,6 +80,8 @@ private:
     sp<AMessage> mNotify;
 
     bool queuePacket(const sp<ABuffer> &buffer);
+    bool insertLatePacket(const sp<ABuffer> &buffer);
+    void releaseHeldPackets(bool all);
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPSource);
 };
@@ -20,6 +20,7 @@
 
 #include "ARTPWriter.h"
 
+#include <errno.h>
 #include <fcntl.h>
 
 #include <media/stagefright/foundation/ABuffer.h>
@@ -40,6 +41,9 @@ namespace android {
 // static const size_t kMaxPacketSize = 65507;  // maximum payload in UDP over IP
 static const size_t kMaxPacketSize = 1500;
 
+// Packets are handed to sendmmsg() this many at a time.
+static const size_t kMaxSendBatch = 16;
+
 static int UniformRand(int limit) {
     return ((double)rand() * limit) / RAND_MAX;
 }
@@ -48,9 +52,13 @@ ARTPWriter::ARTPWriter(int fd)
     : mFlags(0),
       mFd(dup(fd)),
       mLooper(new ALooper),
-      mReflector(new AHandlerReflector<ARTPWriter>(this)) {
+      mReflector(new AHandlerReflector<ARTPWriter>(this)),
+      mPacketBuffer(new ABuffer(kMaxSendBatch * kMaxPacketSize)),
+      mBatchedSend(true) {
     CHECK_GE(fd, 0);
 
+    mPacketBuffer->setRange(0, 0);
+
     mLooper->setName("rtp writer");
     mLooper->registerHandler(mReflector);
     mLooper->start();
@@ -308,6 +316,100 @@ void ARTPWriter::onSendSR(const sp<AMessage> &msg) {
     msg->post(3000000);
 }
 
+uint8_t *ARTPWriter::appendPacket(
+        size_t size, bool marker, uint32_t rtpTime) {
+    CHECK_GE(size, 12u);
+    CHECK_LE(size, kMaxPacketSize);
+
+    size_t offset = mPacketBuffer->size();
+    if (offset + size > mPacketBuffer->capacity()) {
+        sp<ABuffer> buffer = new ABuffer(2 * mPacketBuffer->capacity());
+        memcpy(buffer->data(), mPacketBuffer->data(), offset);
+        mPacketBuffer = buffer;
+    }
+    mPacketBuffer->setRange(0, offset + size);
+    mPacketSizes.push(size);
+
+    uint8_t *data = mPacketBuffer->data() + offset;
+    data[0] = 0x80;
+    data[1] = (marker ? (1 << 7) : 0x00) | PT;  // M-bit
+    data[2] = (mSeqNo >> 8) & 0xff;
+    data[3] = mSeqNo & 0xff;
+    data[4] = rtpTime >> 24;
+    data[5] = (rtpTime >> 16) & 0xff;
+    data[6] = (rtpTime >> 8) & 0xff;
+    data[7] = rtpTime & 0xff;
+    data[8] = mSourceID >> 24;
+    data[9] = (mSourceID >> 16) & 0xff;
+    data[10] = (mSourceID >> 8) & 0xff;
+    data[11] = mSourceID & 0xff;
+
+    ++mSeqNo;
+    ++mNumRTPSent;
+    mNumRTPOctetsSent += size - 12;
+
+    return data;
+}
+
+void ARTPWriter::flushPackets() {
+    const uint8_t *data = mPacketBuffer->data();
+    size_t i = 0;
+    while (i < mPacketSizes.size()) {
+        ssize_t n = -1;
+
+        if (mBatchedSend) {
+            struct mmsghdr msgs[kMaxSendBatch];
+            struct iovec iovecs[kMaxSendBatch];
+
+            size_t count = 0;
+            size_t offset = 0;
+            while (count < kMaxSendBatch && i + count < mPacketSizes.size()) {
+                iovecs[count].iov_base = (void *)(data + offset);
+                iovecs[count].iov_len = mPacketSizes[i + count];
+                offset += mPacketSizes[i + count];
+
+                memset(&msgs[count], 0, sizeof(msgs[count]));
+                msgs[count].msg_hdr.msg_name = &mRTPAddr;
+                msgs[count].msg_hdr.msg_namelen = sizeof(mRTPAddr);
+                msgs[count].msg_hdr.msg_iov = &iovecs[count];
+                msgs[count].msg_hdr.msg_iovlen = 1;
+                ++count;
+            }
+
+            do {
+                n = sendmmsg(mSocket, msgs, count, 0);
+            } while (n < 0 && errno == EINTR);
+
+            if (n < 0 && errno == ENOSYS) {
+                ALOGW("sendmmsg is not supported, sending one packet at a time");
+                mBatchedSend = false;
+            }
+        }
+
+        if (!mBatchedSend) {
+            do {
+                n = sendto(
+                        mSocket, data, mPacketSizes[i], 0,
+                        (const struct sockaddr *)&mRTPAddr, sizeof(mRTPAddr));
+            } while (n < 0 && errno == EINTR);
+
+            CHECK_EQ(n, (ssize_t)mPacketSizes[i]);
+            n = 1;
+        }
+
+        CHECK_GT(n, 0);
+
+        for (ssize_t k = 0; k < n; ++k) {
+            logPacket(data, mPacketSizes[i], false /* isRTCP */);
+            data += mPacketSizes[i];
+            ++i;
+        }
+    }
+
+    mPacketBuffer->setRange(0, 0);
+    mPacketSizes.clear();
+}
+
 void ARTPWriter::send(const sp<ABuffer> &buffer, bool isRTCP) {
     ssize_t n = sendto(
             mSocket, buffer->data(), buffer->size(), 0,
@@ -316,14 +418,20 @@ void ARTPWriter::send(const sp<ABuffer> &buffer, bool isRTCP) {
 
     CHECK_EQ(n, (ssize_t)buffer->size());
 
+    logPacket(buffer->data(), buffer->size(), isRTCP);
+}
+
+void ARTPWriter::logPacket(
+        const uint8_t *data __unused, size_t size __unused,
+        bool isRTCP __unused) {
 #if LOG_TO_FILES
     int fd = isRTCP ? mRTCPFd : mRTPFd;
 
     uint32_t ms = tolel(ALooper::GetNowUs() / 1000ll);
-    uint32_t length = tolel(buffer->size());
+    uint32_t length = tolel(size);
     write(fd, &ms, sizeof(ms));
     write(fd, &length, sizeof(length));
-    write(fd, buffer->data(), buffer->size());
+    write(fd, data, size);
 #endif
 }
 
@@ -579,33 +687,13 @@ void ARTPWriter::sendAVCData(MediaBuffer *mediaBuf) {
     const uint8_t *mediaData =
         (const uint8_t *)mediaBuf->data() + mediaBuf->range_offset();
 
-    sp<ABuffer> buffer = new ABuffer(kMaxPacketSize);
-    if (mediaBuf->range_length() + 12 <= buffer->capacity()) {
+    if (mediaBuf->range_length() + 12 <= kMaxPacketSize) {
         // The data fits into a single packet
-        uint8_t *data = buffer->data();
-        data[0] = 0x80;
-        data[1] = (1 << 7) | PT;  // M-bit
-        data[2] = (mSeqNo >> 8) & 0xff;
-        data[3] = mSeqNo & 0xff;
-        data[4] = rtpTime >> 24;
-        data[5] = (rtpTime >> 16) & 0xff;
-        data[6] = (rtpTime >> 8) & 0xff;
-        data[7] = rtpTime & 0xff;
-        data[8] = mSourceID >> 24;
-        data[9] = (mSourceID >> 16) & 0xff;
-        data[10] = (mSourceID >> 8) & 0xff;
-        data[11] = mSourceID & 0xff;
+        uint8_t *data = appendPacket(
+                mediaBuf->range_length() + 12, true /* marker */, rtpTime);
 
         memcpy(&data[12],
                mediaData, mediaBuf->range_length());
-
-        buffer->setRange(0, mediaBuf->range_length() + 12);
-
-        send(buffer, false /* isRTCP */);
-
-        ++mSeqNo;
-        ++mNumRTPSent;
-        mNumRTPOctetsSent += buffer->size() - 12;
     } else {
         // FU-A
 
@@ -616,24 +704,12 @@ void ARTPWriter::sendAVCData(MediaBuffer *mediaBuf) {
         while (offset < mediaBuf->range_length()) {
             size_t size = mediaBuf->range_length() - offset;
             bool lastPacket = true;
-            if (size + 12 + 2 > buffer->capacity()) {
+            if (size + 12 + 2 > kMaxPacketSize) {
                 lastPacket = false;
-                size = buffer->capacity() - 12 - 2;
+                size = kMaxPacketSize - 12 - 2;
             }
 
-            uint8_t *data = buffer->data();
-            data[0] = 0x80;
-            data[1] = (lastPacket ? (1 << 7) : 0x00) | PT;  // M-bit
-            data[2] = (mSeqNo >> 8) & 0xff;
-            data[3] = mSeqNo & 0xff;
-            data[4] = rtpTime >> 24;
-            data[5] = (rtpTime >> 16) & 0xff;
-            data[6] = (rtpTime >> 8) & 0xff;
-            data[7] = rtpTime & 0xff;
-            data[8] = mSourceID >> 24;
-            data[9] = (mSourceID >> 16) & 0xff;
-            data[10] = (mSourceID >> 8) & 0xff;
-            data[11] = mSourceID & 0xff;
+            uint8_t *data = appendPacket(14 + size, lastPacket, rtpTime);
 
             data[12] = 28 | (nalType & 0xe0);
 
@@ -646,19 +722,13 @@ void ARTPWriter::sendAVCData(MediaBuffer *mediaBuf) {
 
             memcpy(&data[14], &mediaData[offset], size);
 
-            buffer->setRange(0, 14 + size);
-
-            send(buffer, false /* isRTCP */);
-
-            ++mSeqNo;
-            ++mNumRTPSent;
-            mNumRTPOctetsSent += buffer->size() - 12;
-
             firstPacket = false;
             offset += size;
         }
     }
 
+    flushPackets();
+
     mLastRTPTime = rtpTime;
     mLastNTPTime = GetNowNTP();
 }
@@ -683,44 +753,23 @@ void ARTPWriter::sendH263Data(MediaBuffer *mediaBuf) {
     size_t size = mediaBuf->range_length();
 
     while (offset < size) {
-        sp<ABuffer> buffer = new ABuffer(kMaxPacketSize);
-        // CHECK_LE(mediaBuf->range_length() -2 + 14, buffer->capacity());
-
         size_t remaining = size - offset;
-        bool lastPacket = (remaining + 14 <= buffer->capacity());
+        bool lastPacket = (remaining + 14 <= kMaxPacketSize);
         if (!lastPacket) {
-            remaining = buffer->capacity() - 14;
+            remaining = kMaxPacketSize - 14;
         }
 
-        uint8_t *data = buffer->data();
-        data[0] = 0x80;
-        data[1] = (lastPacket ? 0x80 : 0x00) | PT;  // M-bit
-        data[2] = (mSeqNo >> 8) & 0xff;
-        data[3] = mSeqNo & 0xff;
-        data[4] = rtpTime >> 24;
-        data[5] = (rtpTime >> 16) & 0xff;
-        data[6] = (rtpTime >> 8) & 0xff;
-        data[7] = rtpTime & 0xff;
-        data[8] = mSourceID >> 24;
-        data[9] = (mSourceID >> 16) & 0xff;
-        data[10] = (mSourceID >> 8) & 0xff;
-        data[11] = mSourceID & 0xff;
+        uint8_t *data = appendPacket(remaining + 14, lastPacket, rtpTime);
 
         data[12] = (offset == 2) ? 0x04 : 0x00;  // P=?, V=0
         data[13] = 0x00;  // PLEN = PEBIT = 0
 
         memcpy(&data[14], &mediaData[offset], remaining);
         offset += remaining;
-
-        buffer->setRange(0, remaining + 14);
-
-        send(buffer, false /* isRTCP */);
-
-        ++mSeqNo;
-        ++mNumRTPSent;
-        mNumRTPOctetsSent += buffer->size() - 12;
     }
 
+    flushPackets();
+
     mLastRTPTime = rtpTime;
     mLastNTPTime = GetNowNTP();
 }
@@ -770,27 +819,10 @@ void ARTPWriter::sendAMRData(MediaBuffer *mediaBuf) {
     }
     CHECK_EQ(srcOffset, mediaLength);
 
-    sp<ABuffer> buffer = new ABuffer(kMaxPacketSize);
-    CHECK_LE(mediaLength + 12 + 1, buffer->capacity());
-
-    // The data fits into a single packet
-    uint8_t *data = buffer->data();
-    data[0] = 0x80;
-    data[1] = PT;
-    if (mNumRTPSent == 0) {
-        // Signal start of talk-spurt.
-        data[1] |= 0x80;  // M-bit
-    }
-    data[2] = (mSeqNo >> 8) & 0xff;
-    data[3] = mSeqNo & 0xff;
-    data[4] = rtpTime >> 24;
-    data[5] = (rtpTime >> 16) & 0xff;
-    data[6] = (rtpTime >> 8) & 0xff;
-    data[7] = rtpTime & 0xff;
-    data[8] = mSourceID >> 24;
-    data[9] = (mSourceID >> 16) & 0xff;
-    data[10] = (mSourceID >> 8) & 0xff;
-    data[11] = mSourceID & 0xff;
+    // The data fits into a single packet, the first one signals the start
+    // of the talk-spurt.
+    uint8_t *data = appendPacket(
+            mediaLength + 12 + 1, mNumRTPSent == 0 /* marker */, rtpTime);
 
     data[12] = 0xf0;  // CMR=15, RR=0
 
@@ -820,13 +852,9 @@ void ARTPWriter::sendAMRData(MediaBuffer *mediaBuf) {
         dstOffset += frameSize - 1;
     }
 
-    buffer->setRange(0, dstOffset);
-
-    send(buffer, false /* isRTCP */);
+    CHECK_EQ(dstOffset, mediaLength + 12 + 1);
 
-    ++mSeqNo;
-    ++mNumRTPSent;
-    mNumRTPOctetsSent += buffer->size() - 12;
+    flushPackets();
 
     mLastRTPTime = rtpTime;
     mLastNTPTime = GetNowNTP();
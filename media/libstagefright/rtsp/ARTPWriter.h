@@ -23,6 +23,7 @@
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/base64.h>
 #include <media/stagefright/MediaWriter.h>
+#include <utils/Vector.h>
 
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -94,6 +95,12 @@ private:
 
     int32_t mNumSRsSent;
 
+    // The RTP packets of an access unit, back to back, until
+    // flushPackets() sends them.
+    sp<ABuffer> mPacketBuffer;
+    Vector<size_t> mPacketSizes;
+    bool mBatchedSend;
+
     enum {
         INVALID,
         H264,
@@ -118,7 +125,13 @@ private:
     void sendH263Data(MediaBuffer *mediaBuf);
     void sendAMRData(MediaBuffer *mediaBuf);
 
+    // Appends an RTP packet of size bytes, including its header, to
+    // mPacketBuffer and returns it with the header filled in.
+    uint8_t *appendPacket(size_t size, bool marker, uint32_t rtpTime);
+    void flushPackets();
+
     void send(const sp<ABuffer> &buffer, bool isRTCP);
+    void logPacket(const uint8_t *data, size_t size, bool isRTCP);
 
     DISALLOW_EVIL_CONSTRUCTORS(ARTPWriter);
 };
@@ -17,26 +17,66 @@
 #ifndef LINKEDBLOCKINGQUEUE_H_
 #define LINKEDBLOCKINGQUEUE_H_
 
-#include <utils/List.h>
+#include <media/stagefright/foundation/ABase.h>
 #include <utils/Mutex.h>
 #include <utils/Condition.h>
 
+#include <atomic>
+#include <type_traits>
+
 namespace android {
 
+// Bounded queue between a producer and a consumer thread.  The elements live
+// in a ring allocated up front, and the indices are atomics, so that neither
+// side takes the lock unless it has to wait: on an empty queue for the
+// consumer, and on a full one for the producer.
+//
+// There must be at most one thread pushing and one thread peeking/taking at
+// any one time; clear() must only be called while neither is running.
 template<typename T>
 class LinkedBlockingQueue {
-    List<T> mList;
+    typedef typename std::remove_const<T>::type Element;
+
+    Element *mRing;
+    const size_t mCapacity;
+    std::atomic<size_t> mHead;   // next to take, written by the consumer
+    std::atomic<size_t> mTail;   // next to push, written by the producer
+    std::atomic<int32_t> mNumWaiters;
+
     Mutex mLock;
-    Condition mContentAvailableCondition;
+    Condition mCondition;
 
-    T front(bool remove) {
+    template<typename Predicate>
+    void waitFor(Predicate ready) {
         Mutex::Autolock autolock(mLock);
-        while (mList.empty()) {
-            mContentAvailableCondition.wait(mLock);
+        ++mNumWaiters;
+        while (!ready()) {
+            mCondition.wait(mLock);
         }
-        T e = *(mList.begin());
+        --mNumWaiters;
+    }
+
+    // The other side's index must be stored before calling this; together
+    // with the waiter count being raised under the lock before checking the
+    // indices in waitFor(), this does not miss a wakeup.
+    void wakeWaiters() {
+        if (mNumWaiters.load() > 0) {
+            Mutex::Autolock autolock(mLock);
+            mCondition.broadcast();
+        }
+    }
+
+    T front(bool remove) {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        if (mTail.load(std::memory_order_acquire) == head) {
+            waitFor([this, head] { return mTail.load() != head; });
+        }
+        Element &slot = mRing[head % mCapacity];
+        T e = slot;
         if (remove) {
-            mList.erase(mList.begin());
+            slot = Element();
+            mHead.store(head + 1);
+            wakeWaiters();
         }
         return e;
     }
@@ -44,20 +84,33 @@ class LinkedBlockingQueue {
     DISALLOW_EVIL_CONSTRUCTORS(LinkedBlockingQueue);
 
 public:
-    LinkedBlockingQueue() {
+    enum {
+        kDefaultCapacity = 256,
+    };
+
+    explicit LinkedBlockingQueue(size_t capacity = kDefaultCapacity)
+        : mRing(new Element[capacity]),
+          mCapacity(capacity),
+          mHead(0),
+          mTail(0),
+          mNumWaiters(0) {
     }
 
     ~LinkedBlockingQueue() {
+        delete[] mRing;
     }
 
     bool empty() {
-        Mutex::Autolock autolock(mLock);
-        return mList.empty();
+        return mHead.load() == mTail.load();
     }
 
     void clear() {
-        Mutex::Autolock autolock(mLock);
-        mList.clear();
+        size_t tail = mTail.load();
+        for (size_t i = mHead.load(); i != tail; ++i) {
+            mRing[i % mCapacity] = Element();
+        }
+        mHead.store(tail);
+        wakeWaiters();
     }
 
     T peek() {
@@ -68,10 +121,15 @@ public:
         return front(true);
     }
 
+    // Blocks while the queue is full.
     void push(T e) {
-        Mutex::Autolock autolock(mLock);
-        mList.push_back(e);
-        mContentAvailableCondition.signal();
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) == mCapacity) {
+            waitFor([this, tail] { return tail - mHead.load() < mCapacity; });
+        }
+        mRing[tail % mCapacity] = e;
+        mTail.store(tail + 1);
+        wakeWaiters();
     }
 };
 
@@ -27,9 +27,20 @@ using namespace android;
 using namespace webm;
 
 namespace {
+// Takes over the reference to mbuf.  A buffer of a MediaBufferGroup is copied
+// and returned to its group right away, so that the frames waiting to be
+// written do not starve the source; otherwise the ABuffer points to the data
+// of mbuf, and releases it once the frame is written.
 sp<ABuffer> toABuffer(MediaBuffer *mbuf) {
-    sp<ABuffer> abuf = new ABuffer(mbuf->range_length());
-    memcpy(abuf->data(), (uint8_t*) mbuf->data() + mbuf->range_offset(), mbuf->range_length());
+    uint8_t *data = (uint8_t*) mbuf->data() + mbuf->range_offset();
+    if (mbuf->refcount() > 0) {
+        sp<ABuffer> abuf = new ABuffer(mbuf->range_length());
+        memcpy(abuf->data(), data, mbuf->range_length());
+        mbuf->release();
+        return abuf;
+    }
+    sp<ABuffer> abuf = new ABuffer(data, mbuf->range_length());
+    abuf->setMediaBufferBase(mbuf);
     return abuf;
 }
 }
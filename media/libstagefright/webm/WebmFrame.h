@@ -30,6 +30,7 @@ public:
     const bool mEos;
 
     WebmFrame();
+    // Takes over the reference to buf; the caller must not release it.
     WebmFrame(int type, bool key, uint64_t absTimecode, MediaBuffer *buf);
     ~WebmFrame() {}
 
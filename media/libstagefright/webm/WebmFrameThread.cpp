@@ -24,12 +24,19 @@
 #include <media/stagefright/foundation/ADebug.h>
 
 #include <utils/Log.h>
+#include <errno.h>
 #include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
 
 using namespace webm;
 
 namespace android {
 
+// Clusters are serialized into one buffer reused across clusters; it is
+// allocated up front, and grown if a cluster does not fit.
+static const size_t kInitialClusterBufferSize = 1024 * 1024;
+
 void *WebmFrameThread::wrap(void *arg) {
     WebmFrameThread *worker = reinterpret_cast<WebmFrameThread*>(arg);
     worker->run();
@@ -72,6 +79,7 @@ WebmFrameSinkThread::WebmFrameSinkThread(
       mVideoFrames(videoThread->mSink),
       mAudioFrames(audioThread->mSink),
       mCues(cues),
+      mClusterBuffer(new ABuffer(kInitialClusterBufferSize)),
       mDone(true) {
 }
 
@@ -86,6 +94,7 @@ WebmFrameSinkThread::WebmFrameSinkThread(
       mVideoFrames(videoSource),
       mAudioFrames(audioSource),
       mCues(cues),
+      mClusterBuffer(new ABuffer(kInitialClusterBufferSize)),
       mDone(true) {
 }
 
@@ -120,10 +129,28 @@ void WebmFrameSinkThread::writeCluster(List<sp<WebmElement> >& children) {
     // children must contain at least one simpleblock and its timecode
     CHECK_GE(children.size(), 2);
 
-    uint64_t size;
     sp<WebmElement> cluster = new WebmMaster(kMkvCluster, children);
-    cluster->write(mFd, size);
+    uint64_t size = cluster->totalSize();
+    if (mClusterBuffer->capacity() < size) {
+        mClusterBuffer = new ABuffer(size + size / 2);
+    }
+    cluster->serializeInto(mClusterBuffer->data());
     children.clear();
+
+    // a single write instead of extending and mapping the file for each cluster
+    const uint8_t *data = mClusterBuffer->data();
+    while (size > 0) {
+        ssize_t n = ::write(mFd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ALOGE("failed to write cluster (%s)", n < 0 ? strerror(errno) : "no progress");
+            break;
+        }
+        data += n;
+        size -= n;
+    }
 }
 
 // Write out (possibly multiple) webm cluster(s) from frames split on video key frames.
@@ -369,13 +396,6 @@ void WebmFrameMediaSourceThread::run() {
 
         int32_t isSync = false;
         md->findInt32(kKeyIsSyncFrame, &isSync);
-        const sp<WebmFrame> f = new WebmFrame(
-            mType,
-            isSync,
-            timestampUs * 1000 / mTimeCodeScale,
-            buffer);
-        mSink.push(f);
-
         ALOGV(
             "%s %s frame at %" PRId64 " size %zu\n",
             mType == kVideoType ? "video" : "audio",
@@ -383,8 +403,14 @@ void WebmFrameMediaSourceThread::run() {
             timestampUs * 1000 / mTimeCodeScale,
             buffer->range_length());
 
-        buffer->release();
+        // the frame holds on to buffer until it is written
+        const sp<WebmFrame> f = new WebmFrame(
+            mType,
+            isSync,
+            timestampUs * 1000 / mTimeCodeScale,
+            buffer);
         buffer = NULL;
+        mSink.push(f);
 
         if (timestampUs > mTrackDurationUs) {
             mTrackDurationUs = timestampUs;
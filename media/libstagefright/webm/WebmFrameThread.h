@@ -83,6 +83,7 @@ private:
     LinkedBlockingQueue<const sp<WebmFrame> >& mVideoFrames;
     LinkedBlockingQueue<const sp<WebmFrame> >& mAudioFrames;
     List<sp<WebmElement> >& mCues;
+    sp<ABuffer> mClusterBuffer;
 
     volatile bool mDone;
 
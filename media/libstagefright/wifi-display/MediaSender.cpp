@@ -25,6 +25,7 @@
 
 #include "include/avc_utils.h"
 
+#include <cutils/properties.h>
 #include <media/IHDCP.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/foundation/ABuffer.h>
@@ -44,7 +45,8 @@ MediaSender::MediaSender(
       mGeneration(0),
       mPrevTimeUs(-1ll),
       mInitDoneCount(0),
-      mLogFile(NULL) {
+      mLogFile(NULL),
+      mLowLatency(property_get_bool("media.wfd.low-latency", false)) {
     // mLogFile = fopen("/data/misc/log.ts", "wb");
 }
 
@@ -213,10 +215,15 @@ status_t MediaSender::queueAccessUnit(
 
     if (mMode == MODE_TRANSPORT_STREAM) {
         TrackInfo *info = &mTrackInfos.editItemAt(trackIndex);
-        info->mAccessUnits.push_back(accessUnit);
 
         mTSPacketizer->extractCSDIfNecessary(info->mPacketizerTrackIndex);
 
+        if (mLowLatency) {
+            return sendTSAccessUnit(trackIndex, accessUnit);
+        }
+
+        info->mAccessUnits.push_back(accessUnit);
+
         for (;;) {
             ssize_t minTrackIndex = -1;
             int64_t minTimeUs = -1ll;
@@ -248,24 +255,7 @@ status_t MediaSender::queueAccessUnit(
             sp<ABuffer> accessUnit = *info->mAccessUnits.begin();
             info->mAccessUnits.erase(info->mAccessUnits.begin());
 
-            sp<ABuffer> tsPackets;
-            status_t err = packetizeAccessUnit(
-                    minTrackIndex, accessUnit, &tsPackets);
-
-            if (err == OK) {
-                if (mLogFile != NULL) {
-                    fwrite(tsPackets->data(), 1, tsPackets->size(), mLogFile);
-                }
-
-                int64_t timeUs;
-                CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
-                tsPackets->meta()->setInt64("timeUs", timeUs);
-
-                err = mTSSender->queueBuffer(
-                        tsPackets,
-                        33 /* packetType */,
-                        RTPSender::PACKETIZATION_TRANSPORT_STREAM);
-            }
+            status_t err = sendTSAccessUnit(minTrackIndex, accessUnit);
 
             if (err != OK) {
                 return err;
@@ -282,6 +272,29 @@ status_t MediaSender::queueAccessUnit(
                 ? RTPSender::PACKETIZATION_AAC : RTPSender::PACKETIZATION_H264);
 }
 
+status_t MediaSender::sendTSAccessUnit(
+        size_t trackIndex, const sp<ABuffer> &accessUnit) {
+    sp<ABuffer> tsPackets;
+    status_t err = packetizeAccessUnit(trackIndex, accessUnit, &tsPackets);
+
+    if (err == OK) {
+        if (mLogFile != NULL) {
+            fwrite(tsPackets->data(), 1, tsPackets->size(), mLogFile);
+        }
+
+        int64_t timeUs;
+        CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
+        tsPackets->meta()->setInt64("timeUs", timeUs);
+
+        err = mTSSender->queueBuffer(
+                tsPackets,
+                33 /* packetType */,
+                RTPSender::PACKETIZATION_TRANSPORT_STREAM);
+    }
+
+    return err;
+}
+
 void MediaSender::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
         case kWhatSenderNotify:
@@ -359,6 +372,22 @@ void MediaSender::onSenderNotify(const sp<AMessage> &msg) {
             break;
         }
 
+        case RTPSender::kWhatReceiverReport:
+        {
+            int32_t fractionLost;
+            CHECK(msg->findInt32("fractionLost", &fractionLost));
+
+            int64_t jitterUs;
+            CHECK(msg->findInt64("jitterUs", &jitterUs));
+
+            sp<AMessage> notify = mNotify->dup();
+            notify->setInt32("what", kWhatReceiverReport);
+            notify->setInt32("fractionLost", fractionLost);
+            notify->setInt64("jitterUs", jitterUs);
+            notify->post();
+            break;
+        }
+
         default:
             TRESPASS();
     }
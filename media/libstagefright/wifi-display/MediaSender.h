@@ -38,12 +38,16 @@ struct TSPacketizer;
 // track to RTP channel or muxing all tracks into a single RTP channel and
 // using transport stream encapsulation.
 // Optionally the (video) data is encrypted using the provided hdcp object.
+// With media.wfd.low-latency set, access units are muxed into the transport
+// stream as they arrive instead of being interleaved by timestamp, which
+// would hold video back until the next audio access unit is there.
 struct MediaSender : public AHandler {
     enum {
         kWhatInitDone,
         kWhatError,
         kWhatNetworkStall,
         kWhatInformSender,
+        kWhatReceiverReport,
     };
 
     MediaSender(
@@ -112,6 +116,8 @@ private:
 
     FILE *mLogFile;
 
+    bool mLowLatency;
+
     void onSenderNotify(const sp<AMessage> &msg);
 
     void notifyInitDone(status_t err);
@@ -123,6 +129,8 @@ private:
             sp<ABuffer> accessUnit,
             sp<ABuffer> *tsPackets);
 
+    status_t sendTSAccessUnit(size_t trackIndex, const sp<ABuffer> &accessUnit);
+
     DISALLOW_EVIL_CONSTRUCTORS(MediaSender);
 };
 
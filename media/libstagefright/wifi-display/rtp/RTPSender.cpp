@@ -684,12 +684,26 @@ status_t RTPSender::onRTCPData(const sp<ABuffer> &buffer) {
 }
 
 status_t RTPSender::parseReceiverReport(
-        const uint8_t *data, size_t /* size */) {
+        const uint8_t *data, size_t size) {
     float fractionLost = data[12] / 256.0f;
 
     ALOGI("lost %.2f %% of packets during report interval.",
           100.0f * fractionLost);
 
+    // Only RRs with a report block tell us how the sink is doing.
+    if (data[1] != 201 || (data[0] & 0x1f) == 0 || size < 32) {
+        return OK;
+    }
+
+    // interarrival jitter is in units of the 90kHz RTP clock
+    uint32_t jitter = U32_AT(&data[20]);
+
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatReceiverReport);
+    notify->setInt32("fractionLost", data[12]);
+    notify->setInt64("jitterUs", jitter * 1000000ll / 90000);
+    notify->post();
+
     return OK;
 }
 
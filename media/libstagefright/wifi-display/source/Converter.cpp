@@ -171,7 +171,17 @@ status_t Converter::initEncoder() {
         mOutputFormat->setInt32("bitrate", videoBitrate);
         mOutputFormat->setInt32("bitrate-mode", OMX_Video_ControlRateConstant);
         mOutputFormat->setInt32("frame-rate", 30);
-        mOutputFormat->setInt32("i-frame-interval", 15);  // Iframes every 15 secs
+
+        if (property_get_bool("media.wfd.low-latency", false)) {
+            // A single IDR frame, the intra refresh below and the IDR frames
+            // the sink asks for after losses keep the stream decodable
+            // without the bitrate spike of a periodic IDR frame.
+            ALOGI("using low latency video encoding");
+            mOutputFormat->setInt32("i-frame-interval", -1);
+            mOutputFormat->setInt32("priority", 0);  // realtime
+        } else {
+            mOutputFormat->setInt32("i-frame-interval", 15);  // Iframes every 15 secs
+        }
 
         // Configure encoder to use intra macroblock refresh mode
         mOutputFormat->setInt32("intra-refresh-mode", OMX_VIDEO_IntraRefreshCyclic);
@@ -96,6 +96,10 @@ struct WifiDisplaySource::PlaybackSession::Track : public AHandler {
 
     void requestIDRFrame();
 
+    // Tracks the time from a repeater frame being captured until its
+    // access unit is handed to the sender.
+    void noteAccessUnitSent(const sp<ABuffer> &accessUnit);
+
 protected:
     virtual void onMessageReceived(const sp<AMessage> &msg);
     virtual ~Track();
@@ -118,6 +122,9 @@ private:
     sp<RepeaterSource> mRepeaterSource;
     List<sp<ABuffer> > mQueuedOutputBuffers;
     int64_t mLastOutputBufferQueuedTimeUs;
+    int32_t mNumAccessUnitsSent;
+    int64_t mTotalSendLatencyUs;
+    int64_t mMaxSendLatencyUs;
 
     static bool IsAudioFormat(const sp<AMessage> &format);
 
@@ -137,7 +144,10 @@ WifiDisplaySource::PlaybackSession::Track::Track(
       mConverter(converter),
       mStarted(false),
       mIsAudio(IsAudioFormat(mConverter->getOutputFormat())),
-      mLastOutputBufferQueuedTimeUs(-1ll) {
+      mLastOutputBufferQueuedTimeUs(-1ll),
+      mNumAccessUnitsSent(0),
+      mTotalSendLatencyUs(0ll),
+      mMaxSendLatencyUs(0ll) {
 }
 
 WifiDisplaySource::PlaybackSession::Track::Track(
@@ -146,7 +156,10 @@ WifiDisplaySource::PlaybackSession::Track::Track(
       mFormat(format),
       mStarted(false),
       mIsAudio(IsAudioFormat(format)),
-      mLastOutputBufferQueuedTimeUs(-1ll) {
+      mLastOutputBufferQueuedTimeUs(-1ll),
+      mNumAccessUnitsSent(0),
+      mTotalSendLatencyUs(0ll),
+      mMaxSendLatencyUs(0ll) {
 }
 
 WifiDisplaySource::PlaybackSession::Track::~Track() {
@@ -294,6 +307,32 @@ void WifiDisplaySource::PlaybackSession::Track::requestIDRFrame() {
     mConverter->requestIDRFrame();
 }
 
+void WifiDisplaySource::PlaybackSession::Track::noteAccessUnitSent(
+        const sp<ABuffer> &accessUnit) {
+    int64_t timeUs;
+    if (mRepeaterSource == NULL
+            || !accessUnit->meta()->findInt64("timeUs", &timeUs)) {
+        return;
+    }
+
+    // RepeaterSource timestamps frames with ALooper::GetNowUs().
+    int64_t latencyUs = ALooper::GetNowUs() - timeUs;
+    mTotalSendLatencyUs += latencyUs;
+    if (latencyUs > mMaxSendLatencyUs) {
+        mMaxSendLatencyUs = latencyUs;
+    }
+
+    if (++mNumAccessUnitsSent == 300) {
+        ALOGI("encode to send latency avg %lld us max %lld us",
+              (long long)(mTotalSendLatencyUs / mNumAccessUnitsSent),
+              (long long)mMaxSendLatencyUs);
+
+        mNumAccessUnitsSent = 0;
+        mTotalSendLatencyUs = 0ll;
+        mMaxSendLatencyUs = 0ll;
+    }
+}
+
 bool WifiDisplaySource::PlaybackSession::Track::hasOutputBuffer(
         int64_t *timeUs) const {
     *timeUs = 0ll;
@@ -503,6 +542,8 @@ void WifiDisplaySource::PlaybackSession::onMessageReceived(
                         track->mediaSenderTrackIndex(),
                         accessUnit);
 
+                track->noteAccessUnitSent(accessUnit);
+
                 if (err != OK) {
                     notifySessionDead();
                 }
@@ -568,6 +609,8 @@ void WifiDisplaySource::PlaybackSession::onMessageReceived(
                 }
             } else if (what == MediaSender::kWhatInformSender) {
                 onSinkFeedback(msg);
+            } else if (what == MediaSender::kWhatReceiverReport) {
+                onReceiverReport(msg);
             } else {
                 TRESPASS();
             }
@@ -746,6 +789,51 @@ void WifiDisplaySource::PlaybackSession::onSinkFeedback(const sp<AMessage> &msg)
     }
 }
 
+// Backs off the adaptive video bitrate as soon as the sink reports packet
+// loss, rather than waiting for the loss to show up as latency.
+void WifiDisplaySource::PlaybackSession::onReceiverReport(const sp<AMessage> &msg) {
+    int32_t fractionLost;
+    CHECK(msg->findInt32("fractionLost", &fractionLost));
+
+    int64_t jitterUs;
+    CHECK(msg->findInt64("jitterUs", &jitterUs));
+
+    ALOGV("sink lost %d/256 of packets, jitter %lld us", fractionLost, (long long)jitterUs);
+
+    char val[PROPERTY_VALUE_MAX];
+    if (mVideoTrackIndex < 0
+            || !property_get("media.wfd.video-bitrate", val, NULL)
+            || strcasecmp("adaptive", val)) {
+        return;
+    }
+
+    const sp<Track> &videoTrack = mTracks.valueFor(mVideoTrackIndex);
+    sp<Converter> converter = videoTrack->converter();
+    if (converter == NULL) {
+        return;
+    }
+
+    int32_t videoBitrate = converter->getVideoBitrate();
+    if (fractionLost > 25) {  // 10%
+        videoBitrate *= 0.6;
+    } else if (fractionLost > 5) {  // 2%
+        videoBitrate *= 0.85;
+    } else {
+        return;
+    }
+
+    if (videoBitrate < 500000) {
+        videoBitrate = 500000;
+    }
+
+    if (videoBitrate != converter->getVideoBitrate()) {
+        ALOGI("setting video bitrate to %d bps after %d/256 packets were lost",
+              videoBitrate, fractionLost);
+
+        converter->setVideoBitrate(videoBitrate);
+    }
+}
+
 status_t WifiDisplaySource::PlaybackSession::setupMediaPacketizer(
         bool enableAudio, bool enableVideo) {
     DataSource::RegisterDefaultSniffers();
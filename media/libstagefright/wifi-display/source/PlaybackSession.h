@@ -166,6 +166,7 @@ private:
     void onPullExtractor();
 
     void onSinkFeedback(const sp<AMessage> &msg);
+    void onReceiverReport(const sp<AMessage> &msg);
 
     DISALLOW_EVIL_CONSTRUCTORS(PlaybackSession);
 };
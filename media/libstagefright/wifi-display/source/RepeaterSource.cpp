@@ -10,8 +10,14 @@
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MetaData.h>
 
+#include <cutils/properties.h>
+#include <inttypes.h>
+
 namespace android {
 
+static const int32_t kDefaultIdleDelayMs = 500;
+static const int32_t kDefaultIdleFrameRate = 1;
+
 RepeaterSource::RepeaterSource(const sp<MediaSource> &source, double rateHz)
     : mStarted(false),
       mSource(source),
@@ -19,8 +25,25 @@ RepeaterSource::RepeaterSource(const sp<MediaSource> &source, double rateHz)
       mBuffer(NULL),
       mResult(OK),
       mLastBufferUpdateUs(-1ll),
-      mStartTimeUs(-1ll),
-      mFrameCount(0) {
+      mBufferGeneration(0),
+      mReadGeneration(0),
+      mWakeUpPending(false),
+      mIdleDelayUs(0ll),
+      mIdleFrameDurationUs(0ll),
+      mLastReadUs(-1ll),
+      mNumNewFrames(0),
+      mNumRepeatedFrames(0),
+      mTotalNewFrameDelayUs(0ll),
+      mMaxNewFrameDelayUs(0ll) {
+    int32_t idleDelayMs =
+        property_get_int32("media.wfd.idle-delay-ms", kDefaultIdleDelayMs);
+    int32_t idleFrameRate =
+        property_get_int32("media.wfd.idle-frame-rate", kDefaultIdleFrameRate);
+
+    if (idleDelayMs >= 0 && idleFrameRate > 0) {
+        mIdleDelayUs = idleDelayMs * 1000ll;
+        mIdleFrameDurationUs = 1000000ll / idleFrameRate;
+    }
 }
 
 RepeaterSource::~RepeaterSource() {
@@ -34,15 +57,6 @@ double RepeaterSource::getFrameRate() const {
 void RepeaterSource::setFrameRate(double rateHz) {
     Mutex::Autolock autoLock(mLock);
 
-    if (rateHz == mRateHz) {
-        return;
-    }
-
-    if (mStartTimeUs >= 0ll) {
-        int64_t nextTimeUs = mStartTimeUs + (mFrameCount * 1000000ll) / mRateHz;
-        mStartTimeUs = nextTimeUs;
-        mFrameCount = 0;
-    }
     mRateHz = rateHz;
 }
 
@@ -57,8 +71,14 @@ status_t RepeaterSource::start(MetaData *params) {
 
     mBuffer = NULL;
     mResult = OK;
-    mStartTimeUs = -1ll;
-    mFrameCount = 0;
+    mBufferGeneration = 0;
+    mReadGeneration = 0;
+    mWakeUpPending = false;
+    mLastReadUs = -1ll;
+    mNumNewFrames = 0;
+    mNumRepeatedFrames = 0;
+    mTotalNewFrameDelayUs = 0ll;
+    mMaxNewFrameDelayUs = 0ll;
 
     mLooper = new ALooper;
     mLooper->setName("repeater_looper");
@@ -94,6 +114,14 @@ status_t RepeaterSource::stop() {
         mBuffer = NULL;
     }
 
+    {
+        Mutex::Autolock autoLock(mLock);
+        ALOGI("delivered %d new and %d repeated frames, new frame delay "
+              "avg %" PRId64 " us max %" PRId64 " us",
+              mNumNewFrames, mNumRepeatedFrames,
+              mNumNewFrames > 0 ? mTotalNewFrameDelayUs / mNumNewFrames : 0ll,
+              mMaxNewFrameDelayUs);
+    }
 
     ALOGV("stopped");
 
@@ -112,61 +140,68 @@ status_t RepeaterSource::read(
     ReadOptions::SeekMode seekMode;
     CHECK(options == NULL || !options->getSeekTo(&seekTimeUs, &seekMode));
 
+    Mutex::Autolock autoLock(mLock);
     for (;;) {
-        int64_t bufferTimeUs = -1ll;
-
-        if (mStartTimeUs < 0ll) {
-            Mutex::Autolock autoLock(mLock);
+        if (mLastReadUs < 0ll) {
             while ((mLastBufferUpdateUs < 0ll || mBuffer == NULL)
                     && mResult == OK) {
                 mCondition.wait(mLock);
             }
 
             ALOGV("now resuming.");
-            mStartTimeUs = ALooper::GetNowUs();
-            bufferTimeUs = mStartTimeUs;
-        } else {
-            bufferTimeUs = mStartTimeUs + (mFrameCount * 1000000ll) / mRateHz;
-
-            int64_t nowUs = ALooper::GetNowUs();
-            int64_t delayUs = bufferTimeUs - nowUs;
+        }
 
-            if (delayUs > 0ll) {
-                usleep(delayUs);
-            }
+        if (mResult != OK) {
+            CHECK(mBuffer == NULL);
+            return mResult;
         }
 
-        bool stale = false;
+        int64_t nowUs = ALooper::GetNowUs();
+        bool isNew = mBufferGeneration != mReadGeneration;
 
-        {
-            Mutex::Autolock autoLock(mLock);
-            if (mResult != OK) {
-                CHECK(mBuffer == NULL);
-                return mResult;
+        if (mLastReadUs >= 0ll) {
+            int64_t nextReadUs = mLastReadUs + (int64_t)(1E6 / mRateHz);
+
+            if (!isNew && !mWakeUpPending && mIdleFrameDurationUs > 0ll
+                    && nowUs - mLastBufferUpdateUs >= mIdleDelayUs) {
+                nextReadUs = mLastReadUs + mIdleFrameDurationUs;
             }
 
+            if (nextReadUs > nowUs) {
+                // A new buffer, wakeUp() or an error ends the wait early.
+                mCondition.waitRelative(mLock, (nextReadUs - nowUs) * 1000ll);
+                continue;
+            }
+        }
+
 #if SUSPEND_VIDEO_IF_IDLE
-            int64_t nowUs = ALooper::GetNowUs();
-            if (nowUs - mLastBufferUpdateUs > 1000000ll) {
-                mLastBufferUpdateUs = -1ll;
-                stale = true;
-            } else
+        if (nowUs - mLastBufferUpdateUs > 1000000ll) {
+            mLastBufferUpdateUs = -1ll;
+            mLastReadUs = -1ll;
+            ALOGV("now dormant");
+            continue;
+        }
 #endif
-            {
-                mBuffer->add_ref();
-                *buffer = mBuffer;
-                (*buffer)->meta_data()->setInt64(kKeyTime, bufferTimeUs);
-                ++mFrameCount;
+
+        if (isNew) {
+            int64_t delayUs = nowUs - mLastBufferUpdateUs;
+            ++mNumNewFrames;
+            mTotalNewFrameDelayUs += delayUs;
+            if (delayUs > mMaxNewFrameDelayUs) {
+                mMaxNewFrameDelayUs = delayUs;
             }
+        } else {
+            ++mNumRepeatedFrames;
         }
 
-        if (!stale) {
-            break;
-        }
+        mReadGeneration = mBufferGeneration;
+        mWakeUpPending = false;
+        mLastReadUs = nowUs;
 
-        mStartTimeUs = -1ll;
-        mFrameCount = 0;
-        ALOGV("now dormant");
+        mBuffer->add_ref();
+        *buffer = mBuffer;
+        (*buffer)->meta_data()->setInt64(kKeyTime, nowUs);
+        break;
     }
 
     return OK;
@@ -193,6 +228,7 @@ void RepeaterSource::onMessageReceived(const sp<AMessage> &msg) {
             mBuffer = buffer;
             mResult = err;
             mLastBufferUpdateUs = ALooper::GetNowUs();
+            ++mBufferGeneration;
 
             mCondition.broadcast();
 
@@ -210,10 +246,15 @@ void RepeaterSource::onMessageReceived(const sp<AMessage> &msg) {
 void RepeaterSource::wakeUp() {
     ALOGV("wakeUp");
     Mutex::Autolock autoLock(mLock);
-    if (mLastBufferUpdateUs < 0ll && mBuffer != NULL) {
+    if (mBuffer == NULL) {
+        return;
+    }
+    if (mLastBufferUpdateUs < 0ll) {
         mLastBufferUpdateUs = ALooper::GetNowUs();
-        mCondition.broadcast();
     }
+    // e.g. an IDR frame was requested, don't wait for the idle rate
+    mWakeUpPending = true;
+    mCondition.broadcast();
 }
 
 }  // namespace android
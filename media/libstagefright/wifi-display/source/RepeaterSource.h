@@ -10,8 +10,13 @@
 
 namespace android {
 
-// This MediaSource delivers frames at a constant rate by repeating buffers
-// if necessary.
+// This MediaSource delivers frames at up to mRateHz by repeating buffers
+// if necessary.  A new buffer from the source is delivered as soon as a
+// frame interval has passed since the previous one, so that frames follow
+// SurfaceFlinger's composition instead of a fixed grid.  Once the source
+// hasn't produced anything new for media.wfd.idle-delay-ms (default 500),
+// the last buffer is only repeated at media.wfd.idle-frame-rate (default 1,
+// 0 repeats at mRateHz) to save encoder work on a static screen.
 struct RepeaterSource : public MediaSource {
     RepeaterSource(const sp<MediaSource> &source, double rateHz);
 
@@ -25,7 +30,8 @@ struct RepeaterSource : public MediaSource {
     void onMessageReceived(const sp<AMessage> &msg);
 
     // If RepeaterSource is currently dormant, because SurfaceFlinger didn't
-    // send updates in a while, this is its wakeup call.
+    // send updates in a while, this is its wakeup call.  It also makes the
+    // next frame follow at mRateHz if the screen is idle.
     void wakeUp();
 
     double getFrameRate() const;
@@ -54,8 +60,23 @@ private:
     status_t mResult;
     int64_t mLastBufferUpdateUs;
 
-    int64_t mStartTimeUs;
-    int32_t mFrameCount;
+    // incremented for every buffer read from mSource
+    int32_t mBufferGeneration;
+    // mBufferGeneration of the last buffer delivered by read()
+    int32_t mReadGeneration;
+    // wakeUp() asks for a frame at the full rate even if nothing changed
+    bool mWakeUpPending;
+
+    int64_t mIdleDelayUs;
+    int64_t mIdleFrameDurationUs;
+
+    // the time the last frame was delivered, -1 while dormant
+    int64_t mLastReadUs;
+
+    int32_t mNumNewFrames;
+    int32_t mNumRepeatedFrames;
+    int64_t mTotalNewFrameDelayUs;
+    int64_t mMaxNewFrameDelayUs;
 
     void postRead();
 
@@ -13,6 +13,7 @@ LOCAL_MODULE:= libstagefright_yuv
 
 
 LOCAL_CFLAGS += -Werror -Wall
+LOCAL_CFLAGS_arm64 := -DNEON_INTRINSICS
 LOCAL_CLANG := true
 LOCAL_SANITIZE := signed-integer-overflow
 
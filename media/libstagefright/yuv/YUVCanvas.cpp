@@ -32,20 +32,13 @@ YUVCanvas::~YUVCanvas() {
 }
 
 void YUVCanvas::FillYUV(uint8_t yValue, uint8_t uValue, uint8_t vValue) {
-    for (int32_t y = 0; y < mYUVImage.height(); ++y) {
-        for (int32_t x = 0; x < mYUVImage.width(); ++x) {
-            mYUVImage.setPixelValue(x, y, yValue, uValue, vValue);
-        }
-    }
+    mYUVImage.fillRectangle(Rect(mYUVImage.width(), mYUVImage.height()),
+            yValue, uValue, vValue);
 }
 
 void YUVCanvas::FillYUVRectangle(const Rect& rect,
         uint8_t yValue, uint8_t uValue, uint8_t vValue) {
-    for (int32_t y = rect.top; y < rect.bottom; ++y) {
-        for (int32_t x = rect.left; x < rect.right; ++x) {
-            mYUVImage.setPixelValue(x, y, yValue, uValue, vValue);
-        }
-    }
+    mYUVImage.fillRectangle(rect, yValue, uValue, vValue);
 }
 
 void YUVCanvas::CopyImageRect(
@@ -87,25 +80,10 @@ void YUVCanvas::downsample(
         const YUVImage &srcImage) {
     // TODO: Add a low pass filter for downsampling.
 
-    // Check that srcImage is big enough to fill mYUVImage.
-    CHECK((srcOffsetX + (mYUVImage.width() - 1) * skipX) < srcImage.width());
-    CHECK((srcOffsetY + (mYUVImage.height() - 1) * skipY) < srcImage.height());
-
-    uint8_t yValue;
-    uint8_t uValue;
-    uint8_t vValue;
-
-    int32_t srcY = srcOffsetY;
-    for (int32_t y = 0; y < mYUVImage.height(); ++y) {
-        int32_t srcX = srcOffsetX;
-        for (int32_t x = 0; x < mYUVImage.width(); ++x) {
-            srcImage.getPixelValue(srcX, srcY, &yValue, &uValue, &vValue);
-            mYUVImage.setPixelValue(x, y, yValue, uValue, vValue);
-
-            srcX += skipX;
-        }
-        srcY += skipY;
-    }
+    YUVImage::downsample(
+            srcOffsetX, srcOffsetY,
+            skipX, skipY,
+            srcImage, mYUVImage);
 }
 
 }  // namespace android
@@ -21,8 +21,67 @@
 #include <media/stagefright/YUVImage.h>
 #include <ui/Rect.h>
 
+#ifdef NEON_INTRINSICS
+#include <arm_neon.h>
+#endif
+
 namespace android {
 
+// Sets dst[i * dstStep] = src[i * srcStep] for i in [0, n).
+static void copyStrided(
+        const uint8_t *src, int32_t srcStep, uint8_t *dst, int32_t dstStep, int32_t n) {
+    if (srcStep == 1 && dstStep == 1) {
+        memcpy(dst, src, n);
+        return;
+    }
+
+    int32_t i = 0;
+#ifdef NEON_INTRINSICS
+    // The loads read up to srcStep - 1 bytes past the last sample they
+    // use, which i + 16 < n keeps within the samples of the row.
+    if (dstStep == 1 && srcStep == 2) {
+        for (; i + 16 < n; i += 16) {
+            vst1q_u8(dst + i, vld2q_u8(src + 2 * i).val[0]);
+        }
+    } else if (dstStep == 1 && srcStep == 4) {
+        for (; i + 16 < n; i += 16) {
+            vst1q_u8(dst + i, vld4q_u8(src + 4 * i).val[0]);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i * dstStep] = src[i * srcStep];
+    }
+}
+
+// Copies n U/V pairs from a row with srcStep to one with dstStep, either
+// of which may be interleaved (step 2, V first) or planar (step 1).
+static void copyUVRow(
+        const uint8_t *srcU, const uint8_t *srcV, int32_t srcStep,
+        uint8_t *dstU, uint8_t *dstV, int32_t dstStep, int32_t n) {
+    int32_t i = 0;
+#ifdef NEON_INTRINSICS
+    if (srcStep == 2 && dstStep == 1 && srcU == srcV + 1) {
+        for (; i + 16 <= n; i += 16) {
+            uint8x16x2_t vu = vld2q_u8(srcV + 2 * i);
+            vst1q_u8(dstV + i, vu.val[0]);
+            vst1q_u8(dstU + i, vu.val[1]);
+        }
+    } else if (srcStep == 1 && dstStep == 2 && dstU == dstV + 1) {
+        for (; i + 16 <= n; i += 16) {
+            uint8x16x2_t vu;
+            vu.val[0] = vld1q_u8(srcV + i);
+            vu.val[1] = vld1q_u8(srcU + i);
+            vst2q_u8(dstV + 2 * i, vu);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        dstU[i * dstStep] = srcU[i * srcStep];
+        dstV[i * dstStep] = srcV[i * srcStep];
+    }
+}
+
 YUVImage::YUVImage(YUVFormat yuvFormat, int32_t width, int32_t height) {
     mYUVFormat = yuvFormat;
     mWidth = width;
@@ -129,6 +188,16 @@ bool YUVImage::getOffsetIncrementsPerDataRow(
     return true;
 }
 
+void YUVImage::getUVRow(int32_t uvRow,
+        uint8_t **uAddr, uint8_t **vAddr, int32_t *uvStep) const {
+    int32_t yIncrement, uIncrement, vIncrement;
+    getOffsetIncrementsPerDataRow(&yIncrement, &uIncrement, &vIncrement);
+
+    *uAddr = getUAddress(uvRow * uIncrement);
+    *vAddr = getVAddress(uvRow * vIncrement);
+    *uvStep = (mYUVFormat == YUV420SemiPlanar) ? 2 : 1;
+}
+
 uint8_t* YUVImage::getYAddress(int32_t offset) const {
     return mYdata + offset;
 }
@@ -342,6 +411,38 @@ void YUVImage::fastCopyRectangle420SemiPlanar(
     }
 }
 
+void YUVImage::fastCopyRectangle420Mixed(
+        const Rect& srcRect,
+        int32_t destStartX, int32_t destStartY,
+        const YUVImage &srcImage, YUVImage &destImage) {
+    int32_t srcStartX = srcRect.left;
+    int32_t srcStartY = srcRect.top;
+    int32_t width = srcRect.width();
+    int32_t height = srcRect.height();
+
+    // Copy Y
+    for (int32_t offsetY = 0; offsetY < height; ++offsetY) {
+        memcpy(destImage.mYdata + (destStartY + offsetY) * destImage.mWidth + destStartX,
+                srcImage.mYdata + (srcStartY + offsetY) * srcImage.mWidth + srcStartX,
+                width);
+    }
+
+    // Copy UV. With even start coordinates a trailing odd row or column
+    // still owns a U/V value of its own.
+    for (int32_t offsetY = 0; offsetY < (height + 1) >> 1; ++offsetY) {
+        uint8_t *uSrcAddr, *vSrcAddr, *uDestAddr, *vDestAddr;
+        int32_t srcStep, destStep;
+        srcImage.getUVRow((srcStartY >> 1) + offsetY, &uSrcAddr, &vSrcAddr, &srcStep);
+        destImage.getUVRow((destStartY >> 1) + offsetY, &uDestAddr, &vDestAddr, &destStep);
+
+        int32_t srcOffset = (srcStartX >> 1) * srcStep;
+        int32_t destOffset = (destStartX >> 1) * destStep;
+        copyUVRow(uSrcAddr + srcOffset, vSrcAddr + srcOffset, srcStep,
+                uDestAddr + destOffset, vDestAddr + destOffset, destStep,
+                (width + 1) >> 1);
+    }
+}
+
 // static
 bool YUVImage::fastCopyRectangle(
         const Rect& srcRect,
@@ -361,9 +462,106 @@ bool YUVImage::fastCopyRectangle(
         }
         return true;
     }
+
+    if (((srcRect.left | srcRect.top | destStartX | destStartY) & 1) == 0) {
+        fastCopyRectangle420Mixed(
+                srcRect,
+                destStartX, destStartY,
+                srcImage, destImage);
+        return true;
+    }
     return false;
 }
 
+void YUVImage::fillRectangle(const Rect& rect,
+        uint8_t yValue, uint8_t uValue, uint8_t vValue) {
+    if (rect.isEmpty()) {
+        return;
+    }
+    CHECK(validPixel(rect.left, rect.top));
+    CHECK(validPixel(rect.right - 1, rect.bottom - 1));
+
+    for (int32_t y = rect.top; y < rect.bottom; ++y) {
+        memset(mYdata + y * mWidth + rect.left, yValue, rect.width());
+    }
+
+    // every U/V value shared by a pixel of the rectangle
+    int32_t uvLeft = rect.left >> 1;
+    int32_t uvWidth = ((rect.right - 1) >> 1) - uvLeft + 1;
+    for (int32_t uvY = rect.top >> 1; uvY <= (rect.bottom - 1) >> 1; ++uvY) {
+        uint8_t *uAddr, *vAddr;
+        int32_t uvStep;
+        getUVRow(uvY, &uAddr, &vAddr, &uvStep);
+        uAddr += uvLeft * uvStep;
+        vAddr += uvLeft * uvStep;
+
+        if (uvStep == 1) {
+            memset(uAddr, uValue, uvWidth);
+            memset(vAddr, vValue, uvWidth);
+            continue;
+        }
+
+        int32_t x = 0;
+#ifdef NEON_INTRINSICS
+        uint8x16x2_t vu;
+        vu.val[0] = vdupq_n_u8(vValue);
+        vu.val[1] = vdupq_n_u8(uValue);
+        for (; x + 16 <= uvWidth; x += 16) {
+            vst2q_u8(vAddr + 2 * x, vu);
+        }
+#endif
+        for (; x < uvWidth; ++x) {
+            uAddr[2 * x] = uValue;
+            vAddr[2 * x] = vValue;
+        }
+    }
+}
+
+// static
+void YUVImage::downsample(
+        int32_t srcOffsetX, int32_t srcOffsetY,
+        int32_t skipX, int32_t skipY,
+        const YUVImage &srcImage, YUVImage &destImage) {
+    int32_t width = destImage.mWidth;
+    int32_t height = destImage.mHeight;
+
+    CHECK(srcOffsetX >= 0 && srcOffsetY >= 0 && skipX > 0 && skipY > 0);
+    CHECK((srcOffsetX + (width - 1) * skipX) < srcImage.mWidth);
+    CHECK((srcOffsetY + (height - 1) * skipY) < srcImage.mHeight);
+
+    for (int32_t y = 0; y < height; ++y) {
+        copyStrided(
+                srcImage.mYdata + (srcOffsetY + y * skipY) * srcImage.mWidth + srcOffsetX,
+                skipX, destImage.mYdata + y * width, 1, width);
+    }
+
+    // Going pixel by pixel, each U/V value ends up with the one of the last
+    // pixel sharing it: that of odd pixel (2 * i + 1) unless the image ends
+    // at the even one before it.
+    for (int32_t uvY = 0; uvY < (height + 1) >> 1; ++uvY) {
+        int32_t y = (2 * uvY + 1 < height) ? 2 * uvY + 1 : 2 * uvY;
+
+        uint8_t *uSrcAddr, *vSrcAddr, *uDestAddr, *vDestAddr;
+        int32_t srcStep, destStep;
+        srcImage.getUVRow((srcOffsetY + y * skipY) >> 1, &uSrcAddr, &vSrcAddr, &srcStep);
+        destImage.getUVRow(uvY, &uDestAddr, &vDestAddr, &destStep);
+
+        // source U/V index of odd pixel 2 * i + 1 is first + i * skipX
+        int32_t first = (srcOffsetX + skipX) >> 1;
+        int32_t n = width >> 1;
+        copyStrided(uSrcAddr + first * srcStep, skipX * srcStep,
+                uDestAddr, destStep, n);
+        copyStrided(vSrcAddr + first * srcStep, skipX * srcStep,
+                vDestAddr, destStep, n);
+
+        if (width & 1) {
+            int32_t last = (srcOffsetX + (width - 1) * skipX) >> 1;
+            uDestAddr[n * destStep] = uSrcAddr[last * srcStep];
+            vDestAddr[n * destStep] = vSrcAddr[last * srcStep];
+        }
+    }
+}
+
 uint8_t clamp(uint8_t v, uint8_t minValue, uint8_t maxValue) {
     CHECK(maxValue >= minValue);
 
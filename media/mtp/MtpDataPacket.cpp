@@ -348,24 +348,28 @@ void MtpDataPacket::putUInt128(uint64_t value) {
 }
 
 void MtpDataPacket::putAInt8(const int8_t* values, int count) {
+    allocate(mOffset + sizeof(uint32_t) + count * sizeof(int8_t));
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putInt8(*values++);
 }
 
 void MtpDataPacket::putAUInt8(const uint8_t* values, int count) {
+    allocate(mOffset + sizeof(uint32_t) + count * sizeof(uint8_t));
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putUInt8(*values++);
 }
 
 void MtpDataPacket::putAInt16(const int16_t* values, int count) {
+    allocate(mOffset + sizeof(uint32_t) + count * sizeof(int16_t));
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putInt16(*values++);
 }
 
 void MtpDataPacket::putAUInt16(const uint16_t* values, int count) {
+    allocate(mOffset + sizeof(uint32_t) + count * sizeof(uint16_t));
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putUInt16(*values++);
@@ -373,18 +377,21 @@ void MtpDataPacket::putAUInt16(const uint16_t* values, int count) {
 
 void MtpDataPacket::putAUInt16(const UInt16List* values) {
     size_t count = (values ? values->size() : 0);
+    allocate(mOffset + sizeof(uint32_t) + count * sizeof(uint16_t));
     putUInt32(count);
     for (size_t i = 0; i < count; i++)
         putUInt16((*values)[i]);
 }
 
 void MtpDataPacket::putAInt32(const int32_t* values, int count) {
+    allocate(mOffset + sizeof(uint32_t) + count * sizeof(int32_t));
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putInt32(*values++);
 }
 
 void MtpDataPacket::putAUInt32(const uint32_t* values, int count) {
+    allocate(mOffset + sizeof(uint32_t) + count * sizeof(uint32_t));
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putUInt32(*values++);
@@ -395,6 +402,7 @@ void MtpDataPacket::putAUInt32(const UInt32List* list) {
         putEmptyArray();
     } else {
         size_t size = list->size();
+        allocate(mOffset + sizeof(uint32_t) + size * sizeof(uint32_t));
         putUInt32(size);
         for (size_t i = 0; i < size; i++)
             putUInt32((*list)[i]);
@@ -402,12 +410,14 @@ void MtpDataPacket::putAUInt32(const UInt32List* list) {
 }
 
 void MtpDataPacket::putAInt64(const int64_t* values, int count) {
+    allocate(mOffset + sizeof(uint32_t) + count * sizeof(int64_t));
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putInt64(*values++);
 }
 
 void MtpDataPacket::putAUInt64(const uint64_t* values, int count) {
+    allocate(mOffset + sizeof(uint32_t) + count * sizeof(uint64_t));
     putUInt32(count);
     for (int i = 0; i < count; i++)
         putUInt64(*values++);
@@ -438,6 +448,14 @@ void MtpDataPacket::putString(const uint16_t* string) {
         putUInt16(0);
 }
 
+void MtpDataPacket::putRawData(const void* data, size_t length) {
+    allocate(mOffset + length);
+    memcpy(mBuffer + mOffset, data, length);
+    mOffset += length;
+    if (mPacketSize < mOffset)
+        mPacketSize = mOffset;
+}
+
 #ifdef MTP_DEVICE 
 int MtpDataPacket::read(int fd) {
     int ret = ::read(fd, mBuffer, MTP_BUFFER_SIZE);
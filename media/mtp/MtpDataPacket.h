@@ -90,6 +90,8 @@ public:
     void                putString(const MtpStringBuffer& string);
     void                putString(const char* string);
     void                putString(const uint16_t* string);
+    // appends already serialized data
+    void                putRawData(const void* data, size_t length);
     inline void         putEmptyString() { putUInt8(0); }
     inline void         putEmptyArray() { putUInt32(0); }
 
@@ -47,14 +47,24 @@ MtpPacket::~MtpPacket() {
 }
 
 void MtpPacket::reset() {
+    // Only clear what the last packet used, plus the initial allocation
+    // that request parameters are read from, rather than everything a
+    // large transfer may have grown the buffer to.
+    size_t used = (mPacketSize > mAllocationIncrement ? mPacketSize : mAllocationIncrement);
+    if (used > mBufferSize)
+        used = mBufferSize;
     allocate(MTP_CONTAINER_HEADER_SIZE);
     mPacketSize = MTP_CONTAINER_HEADER_SIZE;
-    memset(mBuffer, 0, mBufferSize);
+    memset(mBuffer, 0, used);
 }
 
 void MtpPacket::allocate(size_t length) {
     if (length > mBufferSize) {
-        int newLength = length + mAllocationIncrement;
+        // grow geometrically so that large property lists and object
+        // handle arrays don't realloc every mAllocationIncrement bytes
+        size_t newLength = length + mAllocationIncrement;
+        if (newLength < mBufferSize * 2)
+            newLength = mBufferSize * 2;
         mBuffer = (uint8_t *)realloc(mBuffer, newLength);
         if (!mBuffer) {
             ALOGE("out of memory!");
@@ -37,6 +37,7 @@
 #include "MtpStorage.h"
 #include "MtpStringBuffer.h"
 
+#include <linux/falloc.h>
 #include <linux/usb/f_mtp.h>
 
 namespace android {
@@ -109,7 +110,8 @@ MtpServer::MtpServer(int fd, MtpDatabase* database, bool ptp,
         mSessionOpen(false),
         mSendObjectHandle(kInvalidObjectHandle),
         mSendObjectFormat(0),
-        mSendObjectFileSize(0)
+        mSendObjectFileSize(0),
+        mPropListCacheGeneration(0)
 {
 }
 
@@ -129,6 +131,7 @@ void MtpServer::removeStorage(MtpStorage* storage) {
     for (size_t i = 0; i < mStorages.size(); i++) {
         if (mStorages[i] == storage) {
             mStorages.removeAt(i);
+            clearPropListCache();
             sendStoreRemoved(storage->getStorageID());
             break;
         }
@@ -240,17 +243,20 @@ void MtpServer::run() {
 
     if (mSessionOpen)
         mDatabase->sessionEnded();
+    clearPropListCache();
     close(fd);
     mFD = -1;
 }
 
 void MtpServer::sendObjectAdded(MtpObjectHandle handle) {
     ALOGV("sendObjectAdded %d\n", handle);
+    invalidatePropListCache(handle);
     sendEvent(MTP_EVENT_OBJECT_ADDED, handle);
 }
 
 void MtpServer::sendObjectRemoved(MtpObjectHandle handle) {
     ALOGV("sendObjectRemoved %d\n", handle);
+    invalidatePropListCache(handle);
     sendEvent(MTP_EVENT_OBJECT_REMOVED, handle);
 }
 
@@ -309,6 +315,139 @@ void MtpServer::removeEditObject(MtpObjectHandle handle) {
 
 void MtpServer::commitEdit(ObjectEdit* edit) {
     mDatabase->endSendObject((const char *)edit->mPath, edit->mHandle, edit->mFormat, true);
+    invalidatePropListCache(edit->mHandle);
+}
+
+// Returns the size of the ObjectPropList element at offset in data, or 0 if
+// it is truncated or has an unknown type.
+static size_t getPropListElementSize(const uint8_t* data, size_t length, size_t offset) {
+    // handle, property code and data type
+    static const size_t kElementHeaderSize = 8;
+    if (length < offset + kElementHeaderSize)
+        return 0;
+    uint16_t type = data[offset + 6] | (data[offset + 7] << 8);
+    size_t valueOffset = offset + kElementHeaderSize;
+
+    size_t size;
+    if (type == MTP_TYPE_STR) {
+        if (length < valueOffset + 1)
+            return 0;
+        size = 1 + data[valueOffset] * sizeof(uint16_t);
+    } else {
+        size_t elementSize;
+        switch (type & 0xFF) {
+            case MTP_TYPE_INT8: case MTP_TYPE_UINT8: elementSize = 1; break;
+            case MTP_TYPE_INT16: case MTP_TYPE_UINT16: elementSize = 2; break;
+            case MTP_TYPE_INT32: case MTP_TYPE_UINT32: elementSize = 4; break;
+            case MTP_TYPE_INT64: case MTP_TYPE_UINT64: elementSize = 8; break;
+            case MTP_TYPE_INT128: case MTP_TYPE_UINT128: elementSize = 16; break;
+            default: return 0;
+        }
+        if ((type & 0xFF00) == 0) {
+            size = elementSize;
+        } else if ((type & 0xFF00) == 0x4000) {
+            if (length < valueOffset + 4)
+                return 0;
+            uint32_t count = data[valueOffset] | (data[valueOffset + 1] << 8) |
+                    (data[valueOffset + 2] << 16) | ((uint32_t)data[valueOffset + 3] << 24);
+            if (count > (length - valueOffset - 4) / elementSize)
+                return 0;
+            size = 4 + count * elementSize;
+        } else {
+            return 0;
+        }
+    }
+    if (length - valueOffset < size)
+        return 0;
+    return kElementHeaderSize + size;
+}
+
+bool MtpServer::getCachedObjectPropList(MtpObjectHandle handle, uint32_t format,
+        uint32_t property) {
+    // don't keep more than a few MB of property lists around
+    static const size_t kMaxCachedPropLists = 16384;
+
+    Vector<uint8_t> list;
+    uint32_t generation;
+    {
+        Mutex::Autolock autoLock(mPropListCacheMutex);
+        ssize_t index = mPropListCache.indexOfKey(handle);
+        if (index >= 0 && mPropListCache[index].mFormat == format)
+            list = mPropListCache[index].mData;
+        generation = mPropListCacheGeneration;
+    }
+
+    if (list.isEmpty()) {
+        MtpDataPacket packet;
+        if (mDatabase->getObjectPropertyList(handle, format, 0xFFFFFFFF, 0, 0, packet)
+                != MTP_RESPONSE_OK)
+            return false;
+        int length;
+        void* data = packet.getData(&length);
+        if (!data)
+            return false;
+        list.appendArray((const uint8_t *)data, length);
+        free(data);
+
+        Mutex::Autolock autoLock(mPropListCacheMutex);
+        if (generation == mPropListCacheGeneration) {
+            if (mPropListCache.size() >= kMaxCachedPropLists)
+                mPropListCache.clear();
+            CachedPropList entry;
+            entry.mFormat = format;
+            entry.mData = list;
+            mPropListCache.add(handle, entry);
+        }
+    }
+
+    const uint8_t* data = list.array();
+    size_t length = list.size();
+    if (length < 4)
+        return false;
+    if (property == 0xFFFFFFFF) {
+        mData.putRawData(data, length);
+        return true;
+    }
+
+    // pick the elements for the requested property
+    uint32_t count = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    Vector<size_t> offsets;
+    Vector<size_t> sizes;
+    size_t offset = 4;
+    for (uint32_t i = 0; i < count; i++) {
+        size_t size = getPropListElementSize(data, length, offset);
+        if (size == 0) {
+            ALOGW("can't parse cached property list for %d", handle);
+            invalidatePropListCache(handle);
+            return false;
+        }
+        if ((uint32_t)(data[offset + 4] | (data[offset + 5] << 8)) == property) {
+            offsets.push(offset);
+            sizes.push(size);
+        }
+        offset += size;
+    }
+    if (offsets.isEmpty()) {
+        // let the database report why
+        return false;
+    }
+
+    mData.putUInt32(offsets.size());
+    for (size_t i = 0; i < offsets.size(); i++)
+        mData.putRawData(data + offsets[i], sizes[i]);
+    return true;
+}
+
+void MtpServer::invalidatePropListCache(MtpObjectHandle handle) {
+    Mutex::Autolock autoLock(mPropListCacheMutex);
+    mPropListCache.removeItem(handle);
+    mPropListCacheGeneration++;
+}
+
+void MtpServer::clearPropListCache() {
+    Mutex::Autolock autoLock(mPropListCacheMutex);
+    mPropListCache.clear();
+    mPropListCacheGeneration++;
 }
 
 
@@ -502,6 +641,7 @@ MtpResponseCode MtpServer::doOpenSession() {
     mSessionID = mRequest.getParameter(1);
     mSessionOpen = true;
 
+    clearPropListCache();
     mDatabase->sessionStarted();
 
     return MTP_RESPONSE_OK;
@@ -513,6 +653,7 @@ MtpResponseCode MtpServer::doCloseSession() {
     mSessionID = 0;
     mSessionOpen = false;
     mDatabase->sessionEnded();
+    clearPropListCache();
     return MTP_RESPONSE_OK;
 }
 
@@ -667,7 +808,9 @@ MtpResponseCode MtpServer::doSetObjectPropValue() {
     ALOGV("SetObjectPropValue %d %s\n", handle,
             MtpDebug::getObjectPropCodeName(property));
 
-    return mDatabase->setObjectPropertyValue(handle, property, mData);
+    MtpResponseCode result = mDatabase->setObjectPropertyValue(handle, property, mData);
+    invalidatePropListCache(handle);
+    return result;
 }
 
 MtpResponseCode MtpServer::doGetDevicePropValue() {
@@ -716,6 +859,11 @@ MtpResponseCode MtpServer::doGetObjectPropList() {
             handle, MtpDebug::getFormatCodeName(format),
             MtpDebug::getObjectPropCodeName(property), groupCode, depth);
 
+    // Lists of a single object that is not being edited come from the cache
+    if (handle != 0 && handle != 0xFFFFFFFF && groupCode == 0 && depth == 0 &&
+            !getEditObject(handle) && getCachedObjectPropList(handle, format, property))
+        return MTP_RESPONSE_OK;
+
     return mDatabase->getObjectPropertyList(handle, format, property, groupCode, depth, mData);
 }
 
@@ -785,6 +933,8 @@ MtpResponseCode MtpServer::doGetObject() {
     mfr.length = fileLength;
     mfr.command = mRequest.getOperationCode();
     mfr.transaction_id = mRequest.getTransactionID();
+    // the driver reads the file front to back, let readahead keep up with USB
+    posix_fadvise(mfr.fd, mfr.offset, mfr.length, POSIX_FADV_SEQUENTIAL);
 
     // then transfer the file
     int ret = ioctl(mFD, MTP_SEND_FILE_WITH_HEADER, (unsigned long)&mfr);
@@ -864,6 +1014,7 @@ MtpResponseCode MtpServer::doGetPartialObject(MtpOperationCode operation) {
     mfr.length = length;
     mfr.command = mRequest.getOperationCode();
     mfr.transaction_id = mRequest.getTransactionID();
+    posix_fadvise(mfr.fd, mfr.offset, mfr.length, POSIX_FADV_SEQUENTIAL);
     mResponse.setParameter(1, length);
 
     // transfer the file
@@ -1021,6 +1172,19 @@ MtpResponseCode MtpServer::doSendObject() {
     fchmod(mfr.fd, mFilePermission);
     umask(mask);
 
+    // Reserve the whole file up front, so that its blocks are not allocated
+    // piecemeal while the driver writes it, and so that a file that cannot
+    // fit fails now rather than after most of it has been transferred.
+    if (mSendObjectFileSize > 0 && mSendObjectFileSize != 0xFFFFFFFF &&
+            fallocate(mfr.fd, FALLOC_FL_KEEP_SIZE, 0, mSendObjectFileSize) < 0 &&
+            errno == ENOSPC) {
+        ALOGE("not enough space to receive %s", (const char *)mSendObjectFilePath);
+        close(mfr.fd);
+        unlink(mSendObjectFilePath);
+        result = MTP_RESPONSE_STORAGE_FULL;
+        goto done;
+    }
+
     if (initialData > 0) {
         ret = write(mfr.fd, mData.getData(), initialData);
     }
@@ -1064,6 +1228,7 @@ done:
 
     mDatabase->endSendObject(mSendObjectFilePath, mSendObjectHandle, mSendObjectFormat,
             result == MTP_RESPONSE_OK);
+    invalidatePropListCache(mSendObjectHandle);
     mSendObjectHandle = kInvalidObjectHandle;
     mSendObjectFormat = 0;
     return result;
@@ -1148,6 +1313,11 @@ MtpResponseCode MtpServer::doDeleteObject() {
         if (result == MTP_RESPONSE_OK) {
             deletePath((const char *)filePath);
         }
+        // a folder takes all the objects below it along
+        if (format == MTP_FORMAT_ASSOCIATION)
+            clearPropListCache();
+        else
+            invalidatePropListCache(handle);
     }
 
     return result;
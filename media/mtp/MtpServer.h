@@ -24,6 +24,7 @@
 #include "mtp.h"
 #include "MtpUtils.h"
 
+#include <utils/KeyedVector.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -89,6 +90,20 @@ private:
     };
     Vector<ObjectEdit*>  mObjectEditList;
 
+    // Complete property lists of single objects, as returned by the database
+    // for GetObjectPropList with all properties and depth 0. Initiators
+    // often ask for one property of an object at a time; these are answered
+    // from the cached list instead of with one database query each.
+    struct CachedPropList {
+        MtpObjectFormat     mFormat;
+        Vector<uint8_t>     mData;
+    };
+    Mutex               mPropListCacheMutex;
+    KeyedVector<MtpObjectHandle, CachedPropList> mPropListCache;
+    // incremented on every invalidation, so that a list fetched meanwhile
+    // is not cached
+    uint32_t            mPropListCacheGeneration;
+
 public:
                         MtpServer(int fd, MtpDatabase* database, bool ptp,
                                     int fileGroup, int filePerm, int directoryPerm);
@@ -117,6 +132,11 @@ private:
     void                removeEditObject(MtpObjectHandle handle);
     void                commitEdit(ObjectEdit* edit);
 
+    bool                getCachedObjectPropList(MtpObjectHandle handle,
+                                uint32_t format, uint32_t property);
+    void                invalidatePropListCache(MtpObjectHandle handle);
+    void                clearPropListCache();
+
     bool                handleRequest();
 
     MtpResponseCode     doGetDeviceInfo();
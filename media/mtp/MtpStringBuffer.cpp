@@ -156,28 +156,43 @@ void MtpStringBuffer::writeToPacket(MtpDataPacket* packet) const {
     const uint8_t* src = mBuffer;
     packet->putUInt8(count > 0 ? count + 1 : 0);
 
-    // expand utf8 to 16 bit chars
-    for (int i = 0; i < count; i++) {
-        uint16_t ch;
-        uint16_t ch1 = *src++;
-        if ((ch1 & 0x80) == 0) {
-            // single byte character
-            ch = ch1;
-        } else if ((ch1 & 0xE0) == 0xC0) {
-            // two byte character
-            uint16_t ch2 = *src++;
-            ch = ((ch1 & 0x1F) << 6) | (ch2 & 0x3F);
-        } else {
-            // three byte character
-            uint16_t ch2 = *src++;
-            uint16_t ch3 = *src++;
-            ch = ((ch1 & 0x0F) << 12) | ((ch2 & 0x3F) << 6) | (ch3 & 0x3F);
+    // only terminate with zero if string is not empty
+    if (count == 0)
+        return;
+
+    // expand utf8 to little endian 16 bit chars and write them all at once
+    uint8_t chars[(MTP_STRING_MAX_CHARACTER_NUMBER + 1) * 2];
+    uint8_t* dest = chars;
+    if (mByteCount == count + 1) {
+        // all single byte characters
+        for (int i = 0; i < count; i++) {
+            *dest++ = *src++;
+            *dest++ = 0;
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            uint16_t ch;
+            uint16_t ch1 = *src++;
+            if ((ch1 & 0x80) == 0) {
+                // single byte character
+                ch = ch1;
+            } else if ((ch1 & 0xE0) == 0xC0) {
+                // two byte character
+                uint16_t ch2 = *src++;
+                ch = ((ch1 & 0x1F) << 6) | (ch2 & 0x3F);
+            } else {
+                // three byte character
+                uint16_t ch2 = *src++;
+                uint16_t ch3 = *src++;
+                ch = ((ch1 & 0x0F) << 12) | ((ch2 & 0x3F) << 6) | (ch3 & 0x3F);
+            }
+            *dest++ = (uint8_t)(ch & 0xFF);
+            *dest++ = (uint8_t)(ch >> 8);
         }
-        packet->putUInt16(ch);
     }
-    // only terminate with zero if string is not empty
-    if (count > 0)
-        packet->putUInt16(0);
+    *dest++ = 0;
+    *dest++ = 0;
+    packet->putRawData(chars, dest - chars);
 }
 
 }  // namespace android
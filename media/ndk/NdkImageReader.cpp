@@ -85,15 +85,21 @@ AImageReader::FrameListener::onFrameAvailable(const BufferItem& /*item*/) {
         return; // No callback registered
     }
 
-    sp<AMessage> msg = new AMessage(AImageReader::kWhatImageAvailable, reader->mHandler);
-    msg->setPointer(AImageReader::kCallbackFpKey, (void *) mListener.onImageAvailable);
-    msg->setPointer(AImageReader::kContextKey, mListener.context);
-    msg->post();
+    // The message only carries the listener, so one is built per listener
+    // and posted for every frame instead of allocating one per frame.
+    if (mCallbackMsg == nullptr) {
+        mCallbackMsg = new AMessage(AImageReader::kWhatImageAvailable, reader->mHandler);
+        mCallbackMsg->setPointer(
+                AImageReader::kCallbackFpKey, (void *) mListener.onImageAvailable);
+        mCallbackMsg->setPointer(AImageReader::kContextKey, mListener.context);
+    }
+    mCallbackMsg->post();
 }
 
 media_status_t
 AImageReader::FrameListener::setImageListener(AImageReader_ImageListener* listener) {
     Mutex::Autolock _l(mLock);
+    mCallbackMsg.clear();
     if (listener == nullptr) {
         mListener.context = nullptr;
         mListener.onImageAvailable = nullptr;
@@ -250,8 +256,8 @@ AImageReader::~AImageReader() {
 }
 
 media_status_t
-AImageReader::acquireCpuConsumerImageLocked(/*out*/AImage** image) {
-    *image = nullptr;
+AImageReader::lockNextBufferLocked(/*out*/CpuConsumer::LockedBuffer** lockedBuffer) {
+    *lockedBuffer = nullptr;
     CpuConsumer::LockedBuffer* buffer = getLockedBufferLocked();
     if (buffer == nullptr) {
         ALOGW("Unable to acquire a lockedBuffer, very likely client tries to lock more than"
@@ -274,8 +280,12 @@ AImageReader::acquireCpuConsumerImageLocked(/*out*/AImage** image) {
         return AMEDIA_IMGREADER_NO_BUFFER_AVAILABLE;
     }
 
+    // Buffers rejected below go straight back to the queue; holding on to
+    // them would permanently take a slot away from the producer.
     if (buffer->flexFormat == HAL_PIXEL_FORMAT_YCrCb_420_SP) {
         ALOGE("NV21 format is not supported by AImageReader");
+        mCpuConsumer->unlockBuffer(*buffer);
+        returnLockedBufferLocked(buffer);
         return AMEDIA_ERROR_UNSUPPORTED;
     }
 
@@ -284,6 +294,8 @@ AImageReader::acquireCpuConsumerImageLocked(/*out*/AImage** image) {
     Point lt = buffer->crop.leftTop();
     if (lt.x != 0 || lt.y != 0) {
         ALOGE("crop left top corner [%d, %d] need to be at origin", lt.x, lt.y);
+        mCpuConsumer->unlockBuffer(*buffer);
+        returnLockedBufferLocked(buffer);
         return AMEDIA_ERROR_UNKNOWN;
     }
 
@@ -325,14 +337,33 @@ AImageReader::acquireCpuConsumerImageLocked(/*out*/AImage** image) {
         }
     }
 
+    *lockedBuffer = buffer;
+    return AMEDIA_OK;
+}
+
+AImage*
+AImageReader::createImageLocked(CpuConsumer::LockedBuffer* buffer) {
+    AImage* image;
     if (mHalFormat == HAL_PIXEL_FORMAT_BLOB) {
-        *image = new AImage(this, mFormat, buffer, buffer->timestamp,
-                            readerWidth, readerHeight, mNumPlanes);
+        image = new AImage(this, mFormat, buffer, buffer->timestamp,
+                           mWidth, mHeight, mNumPlanes);
     } else {
-        *image = new AImage(this, mFormat, buffer, buffer->timestamp,
-                            outputWidth, outputHeight, mNumPlanes);
+        image = new AImage(this, mFormat, buffer, buffer->timestamp,
+                           getBufferWidth(buffer), getBufferHeight(buffer), mNumPlanes);
+    }
+    mAcquiredImages.push_back(image);
+    return image;
+}
+
+media_status_t
+AImageReader::acquireCpuConsumerImageLocked(/*out*/AImage** image) {
+    *image = nullptr;
+    CpuConsumer::LockedBuffer* buffer;
+    media_status_t ret = lockNextBufferLocked(&buffer);
+    if (ret != AMEDIA_OK) {
+        return ret;
     }
-    mAcquiredImages.push_back(*image);
+    *image = createImageLocked(buffer);
     return AMEDIA_OK;
 }
 
@@ -416,23 +447,24 @@ AImageReader::acquireLatestImage(/*out*/AImage** image) {
     }
     Mutex::Autolock _l(mLock);
     *image = nullptr;
-    AImage* prevImage = nullptr;
-    AImage* nextImage = nullptr;
-    media_status_t ret = acquireCpuConsumerImageLocked(&prevImage);
-    if (prevImage == nullptr) {
+    CpuConsumer::LockedBuffer* prevBuffer;
+    media_status_t ret = lockNextBufferLocked(&prevBuffer);
+    if (ret != AMEDIA_OK) {
         return ret;
     }
+    // Skip to the newest buffer without wrapping the stale ones in AImages
+    // that would only be closed again.
     for (;;) {
-        ret = acquireCpuConsumerImageLocked(&nextImage);
-        if (nextImage == nullptr) {
-            *image = prevImage;
-            return AMEDIA_OK;
+        CpuConsumer::LockedBuffer* nextBuffer;
+        if (lockNextBufferLocked(&nextBuffer) != AMEDIA_OK) {
+            break;
         }
-        prevImage->close();
-        prevImage->free();
-        prevImage = nextImage;
-        nextImage = nullptr;
+        mCpuConsumer->unlockBuffer(*prevBuffer);
+        returnLockedBufferLocked(prevBuffer);
+        prevBuffer = nextBuffer;
     }
+    *image = createImageLocked(prevBuffer);
+    return AMEDIA_OK;
 }
 
 EXPORT
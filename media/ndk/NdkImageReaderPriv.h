@@ -76,6 +76,10 @@ struct AImageReader : public RefBase {
     friend struct AImage; // for grabing reader lock
 
     media_status_t acquireCpuConsumerImageLocked(/*out*/AImage** image);
+    // Locks the next buffer from mCpuConsumer and checks it against the reader
+    // configuration. Rejected buffers are returned to the queue.
+    media_status_t lockNextBufferLocked(/*out*/CpuConsumer::LockedBuffer** buffer);
+    AImage* createImageLocked(CpuConsumer::LockedBuffer* buffer);
     CpuConsumer::LockedBuffer* getLockedBufferLocked();
     void returnLockedBufferLocked(CpuConsumer::LockedBuffer* buffer);
 
@@ -120,6 +124,7 @@ struct AImageReader : public RefBase {
 
       private:
         AImageReader_ImageListener mListener = {nullptr, nullptr};
+        sp<AMessage>               mCallbackMsg;
         wp<AImageReader>           mReader;
         Mutex                      mLock;
     };
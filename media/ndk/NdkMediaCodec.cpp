@@ -311,6 +311,62 @@ media_status_t AMediaCodec_queueInputBuffer(AMediaCodec *mData,
     return translate_error(ret);
 }
 
+EXPORT
+media_status_t AMediaCodec_queueInputBuffers(AMediaCodec *mData,
+        const AMediaCodecIndexedBufferInfo *buffers, size_t count, size_t *numQueued) {
+    android::Vector<MediaCodec::BatchBuffer> batch;
+    batch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const AMediaCodecIndexedBufferInfo &buffer = buffers[i];
+        if (buffer.info.offset < 0 || buffer.info.size < 0) {
+            *numQueued = 0;
+            return AMEDIA_ERROR_INVALID_PARAMETER;
+        }
+        MediaCodec::BatchBuffer &entry = batch.editItemAt(i);
+        entry.mIndex = buffer.index;
+        entry.mOffset = buffer.info.offset;
+        entry.mSize = buffer.info.size;
+        entry.mPresentationTimeUs = buffer.info.presentationTimeUs;
+        entry.mFlags = buffer.info.flags;
+    }
+
+    AString errorMsg;
+    status_t ret = mData->mCodec->queueInputBuffers(batch.array(), count, numQueued, &errorMsg);
+    return translate_error(ret);
+}
+
+EXPORT
+ssize_t AMediaCodec_dequeueOutputBuffers(AMediaCodec *mData,
+        AMediaCodecIndexedBufferInfo *buffers, size_t maxCount, int64_t timeoutUs) {
+    android::Vector<MediaCodec::BatchBuffer> batch;
+    batch.resize(maxCount);
+    size_t count;
+    status_t ret = mData->mCodec->dequeueOutputBuffers(
+            batch.editArray(), maxCount, &count, timeoutUs);
+    requestActivityNotification(mData);
+    switch (ret) {
+        case OK:
+            for (size_t i = 0; i < count; i++) {
+                const MediaCodec::BatchBuffer &entry = batch[i];
+                buffers[i].index = entry.mIndex;
+                buffers[i].info.offset = entry.mOffset;
+                buffers[i].info.size = entry.mSize;
+                buffers[i].info.flags = entry.mFlags;
+                buffers[i].info.presentationTimeUs = entry.mPresentationTimeUs;
+            }
+            return count;
+        case -EAGAIN:
+            return AMEDIACODEC_INFO_TRY_AGAIN_LATER;
+        case android::INFO_FORMAT_CHANGED:
+            return AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED;
+        case INFO_OUTPUT_BUFFERS_CHANGED:
+            return AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED;
+        default:
+            break;
+    }
+    return translate_error(ret);
+}
+
 EXPORT
 ssize_t AMediaCodec_dequeueOutputBuffer(AMediaCodec *mData,
         AMediaCodecBufferInfo *info, int64_t timeoutUs) {
@@ -58,6 +58,8 @@
 #include "SpdifStreamOut.h"
 #include "AudioHwDevice.h"
 #include "LinearMap.h"
+#include "ParameterQueue.h"
+#include "ThreadCycleStats.h"
 
 #include <powermanager/IPowerManager.h>
 
@@ -456,6 +458,7 @@ private:
     class OffloadThread;
     class DuplicatingThread;
     class AsyncCallbackThread;
+    class PipelinedWriteThread;
     class Track;
     class RecordTrack;
     class EffectModule;
@@ -38,6 +38,7 @@
 #include <audio_utils/format.h>
 
 #include "AudioMixerOps.h"
+#include "AudioMixerOpsSimd.h"
 #include "AudioMixer.h"
 
 // The FCC_2 macro refers to the Fixed Channel Count of 2 for the legacy integer mixer.
@@ -83,6 +84,10 @@ static const bool kUseFloat = true;
 // Set to default copy buffer size in frames for input processing.
 static const size_t kCopyBufferFrameCount = 256;
 
+// Minimum number of enabled tracks before the mixer workers are used,
+// below this the synchronization cost outweighs the parallel mix.
+static const int kMinTracksForParallelMix = 4;
+
 namespace android {
 
 // ----------------------------------------------------------------------------
@@ -100,7 +105,8 @@ T min(const T& a, const T& b)
 
 AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTracks)
     :   mTrackNames(0), mConfiguredNames((maxNumTracks >= 32 ? 0 : 1 << maxNumTracks) - 1),
-        mSampleRate(sampleRate)
+        mSampleRate(sampleRate),
+        mResamplerQualityCap(AudioResampler::DYN_HIGH_QUALITY)
 {
     ALOG_ASSERT(maxNumTracks <= MAX_NUM_TRACKS, "maxNumTracks %u > MAX_NUM_TRACKS %u",
             maxNumTracks, MAX_NUM_TRACKS);
@@ -117,7 +123,9 @@ AudioMixer::AudioMixer(size_t frameCount, uint32_t sampleRate, uint32_t maxNumTr
     mState.outputTemp   = NULL;
     mState.resampleTemp = NULL;
     mState.mLog         = &mDummyLog;
-    // mState.reserved
+    mState.workerCount  = 0;
+    mState.mutedTracks  = 0;
+    mState.skippedTrackCycles = 0;
 
     // FIXME Most of the following initialization is probably redundant since
     // tracks[i] should only be referenced if (mTrackNames & (1 << i)) != 0
@@ -145,6 +153,7 @@ AudioMixer::~AudioMixer()
     }
     delete [] mState.outputTemp;
     delete [] mState.resampleTemp;
+    setWorkerCount(0);
 }
 
 void AudioMixer::setLog(NBLog::Writer *log)
@@ -152,6 +161,112 @@ void AudioMixer::setLog(NBLog::Writer *log)
     mState.mLog = log;
 }
 
+// ----------------------------------------------------------------------------
+
+// A MixWorker mixes a subset of the tracks of a main buffer group into its own
+// accumulation buffer, see process__genericResamplingParallel().
+class AudioMixer::MixWorker : public Thread {
+public:
+    explicit MixWorker(size_t frameCount)
+        :   Thread(false /*canCallJava*/),
+            mState(NULL), mTracks(0), mSampleCount(0), mPending(false),
+            mOutputTemp(new int32_t[MAX_NUM_CHANNELS * frameCount]),
+            mResampleTemp(new int32_t[MAX_NUM_CHANNELS * frameCount]) { }
+
+    virtual ~MixWorker() {
+        delete [] mOutputTemp;
+        delete [] mResampleTemp;
+    }
+
+    // Starts mixing the tracks in the bitmask into outputTemp(),
+    // which is first cleared for sampleCount samples.
+    void post(state_t* state, uint32_t tracks, size_t sampleCount) {
+        Mutex::Autolock _l(mLock);
+        mState = state;
+        mTracks = tracks;
+        mSampleCount = sampleCount;
+        mPending = true;
+        mWorkCond.signal();
+    }
+
+    // Blocks until the most recently posted mix is complete.
+    void wait() {
+        Mutex::Autolock _l(mLock);
+        while (mPending) {
+            mDoneCond.wait(mLock);
+        }
+    }
+
+    const int32_t* outputTemp() const { return mOutputTemp; }
+
+    virtual void requestExit() {
+        Thread::requestExit();
+        Mutex::Autolock _l(mLock);
+        mWorkCond.signal();
+    }
+
+private:
+    virtual bool threadLoop() {
+        state_t* state;
+        uint32_t tracks;
+        size_t sampleCount;
+        {
+            Mutex::Autolock _l(mLock);
+            while (!mPending) {
+                if (exitPending()) {
+                    return false;
+                }
+                mWorkCond.wait(mLock);
+            }
+            state = mState;
+            tracks = mTracks;
+            sampleCount = mSampleCount;
+        }
+        memset(mOutputTemp, 0, sizeof(*mOutputTemp) * sampleCount);
+        mixTracks(state, tracks, mOutputTemp, mResampleTemp);
+        {
+            Mutex::Autolock _l(mLock);
+            mPending = false;
+            mDoneCond.signal();
+        }
+        return true;
+    }
+
+    Mutex           mLock;
+    Condition       mWorkCond;  // signaled when work is posted or exit is requested
+    Condition       mDoneCond;  // signaled when the posted work is done
+    state_t*        mState;
+    uint32_t        mTracks;
+    size_t          mSampleCount;
+    bool            mPending;   // true from post() until the mix is done
+    int32_t* const  mOutputTemp;
+    int32_t* const  mResampleTemp;
+};
+
+void AudioMixer::setWorkerCount(uint32_t workerCount)
+{
+    if (workerCount > MAX_NUM_WORKERS) {
+        ALOGW("%s: clamping %u workers to %u", __func__, workerCount, MAX_NUM_WORKERS);
+        workerCount = MAX_NUM_WORKERS;
+    }
+    while (mState.workerCount > workerCount) {
+        sp<MixWorker> worker = mState.workers[--mState.workerCount];
+        mState.workers[mState.workerCount].clear();
+        worker->requestExit(); // wakes the worker, requestExitAndWait() alone does not
+        worker->requestExitAndWait();
+    }
+    while (mState.workerCount < workerCount) {
+        sp<MixWorker> worker = new MixWorker(mState.frameCount);
+        status_t status = worker->run("AudioMixerWorker", ANDROID_PRIORITY_URGENT_AUDIO);
+        if (status != NO_ERROR) {
+            ALOGE("%s: cannot start mixer worker: %d", __func__, status);
+            break;
+        }
+        mState.workers[mState.workerCount++] = worker;
+    }
+    invalidateState(mTrackNames);
+}
+
 static inline audio_format_t selectMixerInFormat(audio_format_t inputFormat __unused) {
     return kUseFloat && kUseNewMixer ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
 }
@@ -211,6 +326,7 @@ int AudioMixer::getTrackName(audio_channel_mask_t channelMask,
         t->hook = NULL;
         t->in = NULL;
         t->resampler = NULL;
+        t->mResamplerQuality = AudioResampler::DEFAULT_QUALITY;
         t->sampleRate = mSampleRate;
         // setParameter(name, TRACK, MAIN_BUFFER, mixBuffer) is required before enable(name)
         t->mainBuffer = NULL;
@@ -224,6 +340,7 @@ int AudioMixer::getTrackName(audio_channel_mask_t channelMask,
         t->mFormat = format;
         t->mMixerInFormat = selectMixerInFormat(format);
         t->mDownmixRequiresFormat = AUDIO_FORMAT_INVALID; // no format required
+        t->mDownmixReformats = false;
         t->mMixerChannelMask = audio_channel_mask_from_representation_and_bits(
                 AUDIO_CHANNEL_REPRESENTATION_POSITION, AUDIO_CHANNEL_OUT_STEREO);
         t->mMixerChannelCount = audio_channel_count_from_out_mask(t->mMixerChannelMask);
@@ -279,12 +396,14 @@ bool AudioMixer::setChannelMasks(int name,
     // channel masks have changed, does this track need a downmixer?
     // update to try using our desired format (if we aren't already using it)
     const audio_format_t prevDownmixerFormat = track.mDownmixRequiresFormat;
+    const bool prevDownmixReformats = track.mDownmixReformats;
     const status_t status = mState.tracks[name].prepareForDownmix();
     ALOGE_IF(status != OK,
             "prepareForDownmix error %d, track channel mask %#x, mixer channel mask %#x",
             status, track.channelMask, track.mMixerChannelMask);
 
-    if (prevDownmixerFormat != track.mDownmixRequiresFormat) {
+    if (prevDownmixerFormat != track.mDownmixRequiresFormat
+            || prevDownmixReformats != track.mDownmixReformats) {
         track.prepareForReformat(); // because of downmixer, track format may change!
     }
 
@@ -296,6 +415,7 @@ bool AudioMixer::setChannelMasks(int name,
         track.sampleRate = mSampleRate; // without resampler, track rate is device sample rate.
         // recreate the resampler with updated format, channels, saved sampleRate.
         track.setResampler(resetToSampleRate /*trackSampleRate*/, mSampleRate /*devSampleRate*/);
+        track.applyResamplerQualityCap(mResamplerQualityCap, mSampleRate);
     }
     return true;
 }
@@ -304,6 +424,7 @@ void AudioMixer::track_t::unprepareForDownmix() {
     ALOGV("AudioMixer::unprepareForDownmix(%p)", this);
 
     mDownmixRequiresFormat = AUDIO_FORMAT_INVALID;
+    mDownmixReformats = false;
     if (downmixerBufferProvider != NULL) {
         // this track had previously been configured with a downmixer, delete it
         ALOGV(" deleting old downmixer");
@@ -329,22 +450,38 @@ status_t AudioMixer::track_t::prepareForDownmix()
                     && mMixerChannelMask == AUDIO_CHANNEL_OUT_STEREO)) {
         return NO_ERROR;
     }
+    // Folding down to stereo is done in-process, together with the format conversion.
+    if (MatrixDownmixBufferProvider::isSupported(channelMask, mMixerChannelMask,
+            mFormat, mMixerInFormat)) {
+        downmixerBufferProvider = new MatrixDownmixBufferProvider(channelMask,
+                mFormat, mMixerInFormat, kCopyBufferFrameCount);
+        mDownmixReformats = true;
+        reconfigureBufferProviders();
+        return NO_ERROR;
+    }
     // DownmixerBufferProvider is only used for position masks.
     if (audio_channel_mask_get_representation(channelMask)
                 == AUDIO_CHANNEL_REPRESENTATION_POSITION
             && DownmixerBufferProvider::isMultichannelCapable()) {
-        DownmixerBufferProvider* pDbp = new DownmixerBufferProvider(channelMask,
-                mMixerChannelMask,
-                AUDIO_FORMAT_PCM_16_BIT /* TODO: use mMixerInFormat, now only PCM 16 */,
-                sampleRate, sessionId, kCopyBufferFrameCount);
-
-        if (pDbp->isValid()) { // if constructor completed properly
-            mDownmixRequiresFormat = AUDIO_FORMAT_PCM_16_BIT; // PCM 16 bit required for downmix
-            downmixerBufferProvider = pDbp;
-            reconfigureBufferProviders();
-            return NO_ERROR;
+        // prefer downmixing in the mixer input format if the downmix effect supports it,
+        // so that float tracks are not converted to and from PCM 16 around the downmix.
+        const audio_format_t downmixFormats[] = { mMixerInFormat, AUDIO_FORMAT_PCM_16_BIT };
+        for (size_t i = 0; i < sizeof(downmixFormats) / sizeof(downmixFormats[0]); ++i) {
+            if (i > 0 && downmixFormats[i] == downmixFormats[0]) {
+                break;
+            }
+            DownmixerBufferProvider* pDbp = new DownmixerBufferProvider(channelMask,
+                    mMixerChannelMask, downmixFormats[i],
+                    sampleRate, sessionId, kCopyBufferFrameCount);
+
+            if (pDbp->isValid()) { // if constructor completed properly
+                mDownmixRequiresFormat = downmixFormats[i];
+                downmixerBufferProvider = pDbp;
+                reconfigureBufferProviders();
+                return NO_ERROR;
+            }
+            delete pDbp;
         }
-        delete pDbp;
     }
 
     // Effect downmixer does not accept the channel conversion.  Let's use our remixer.
@@ -383,7 +520,7 @@ status_t AudioMixer::track_t::prepareForReformat()
     const audio_format_t targetFormat = mDownmixRequiresFormat != AUDIO_FORMAT_INVALID
             ? mDownmixRequiresFormat : mMixerInFormat;
     bool requiresReconfigure = false;
-    if (mFormat != targetFormat) {
+    if (mFormat != targetFormat && !mDownmixReformats) {
         mReformatBufferProvider = new ReformatBufferProvider(
                 audio_channel_count_from_out_mask(channelMask),
                 mFormat,
@@ -642,6 +779,9 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
                 ALOG_ASSERT(audio_is_linear_pcm(format), "Invalid format %#x", format);
                 track.mFormat = format;
                 ALOGV("setParameter(TRACK, FORMAT, %#x)", format);
+                if (track.mDownmixReformats) {
+                    track.prepareForDownmix(); // the downmixer input format has changed
+                }
                 track.prepareForReformat();
                 invalidateState(1 << name);
             }
@@ -675,6 +815,7 @@ void AudioMixer::setParameter(int name, int target, int param, void *value)
         case SAMPLE_RATE:
             ALOG_ASSERT(valueInt > 0, "bad sample rate %d", valueInt);
             if (track.setResampler(uint32_t(valueInt), mSampleRate)) {
+                track.applyResamplerQualityCap(mResamplerQualityCap, mSampleRate);
                 ALOGV("setParameter(RESAMPLE, SAMPLE_RATE, %u)",
                         uint32_t(valueInt));
                 invalidateState(1 << name);
@@ -784,6 +925,7 @@ bool AudioMixer::track_t::setResampler(uint32_t trackSampleRate, uint32_t devSam
                         mMixerInFormat,
                         resamplerChannelCount,
                         devSampleRate, quality);
+                mResamplerQuality = resampler->getQuality();
             }
             return true;
         }
@@ -791,6 +933,46 @@ bool AudioMixer::track_t::setResampler(uint32_t trackSampleRate, uint32_t devSam
     return false;
 }
 
+bool AudioMixer::track_t::applyResamplerQualityCap(AudioResampler::src_quality cap,
+        uint32_t devSampleRate)
+{
+    // only the dynamic resamplers are scaled, the others have a fixed cost.
+    if (resampler == NULL || mResamplerQuality < AudioResampler::DYN_LOW_QUALITY) {
+        return false;
+    }
+    const AudioResampler::src_quality quality = mResamplerQuality < cap ? mResamplerQuality : cap;
+    if (quality == resampler->getQuality()) {
+        return false;
+    }
+    ALOGV("resampler quality %d -> %d (cap %d)", resampler->getQuality(), quality, cap);
+    // The dynamic resampler releases its input buffer at the end of each resample(),
+    // so it can be replaced between two mixes; only its filter history is lost.
+    const int resamplerChannelCount = downmixerBufferProvider != NULL
+            ? mMixerChannelCount : channelCount;
+    delete resampler;
+    resampler = AudioResampler::create(
+            mMixerInFormat,
+            resamplerChannelCount,
+            devSampleRate, quality);
+    return true;
+}
+
+void AudioMixer::setResamplerQualityCap(AudioResampler::src_quality cap)
+{
+    LOG_ALWAYS_FATAL_IF(cap < AudioResampler::DYN_LOW_QUALITY
+            || cap > AudioResampler::DYN_HIGH_QUALITY, "bad resampler quality cap %d", cap);
+    if (cap == mResamplerQualityCap) {
+        return;
+    }
+    mResamplerQualityCap = cap;
+    uint32_t names = mTrackNames;
+    while (names) {
+        const int i = 31 - __builtin_clz(names);
+        names &= ~(1 << i);
+        mState.tracks[i].applyResamplerQualityCap(cap, mSampleRate);
+    }
+}
+
 bool AudioMixer::track_t::setPlaybackRate(const AudioPlaybackRate &playbackRate)
 {
     if ((mTimestretchBufferProvider == NULL &&
@@ -906,6 +1088,8 @@ void AudioMixer::setBufferProvider(int name, AudioBufferProvider* bufferProvider
 void AudioMixer::process()
 {
     mState.hook(&mState);
+    // muted tracks are only advanced by every process hook, never mixed.
+    mState.skippedTrackCycles += __builtin_popcount(mState.mutedTracks & mState.enabledTracks);
 }
 
 
@@ -997,15 +1181,18 @@ void AudioMixer::process__validate(state_t* state)
 
     // select the processing hooks
     state->hook = process__nop;
+    const bool parallel = state->workerCount > 0
+            && countActiveTracks >= kMinTracksForParallelMix;
     if (countActiveTracks > 0) {
-        if (resampling) {
+        if (resampling || parallel) {
             if (!state->outputTemp) {
                 state->outputTemp = new int32_t[MAX_NUM_CHANNELS * state->frameCount];
             }
             if (!state->resampleTemp) {
                 state->resampleTemp = new int32_t[MAX_NUM_CHANNELS * state->frameCount];
             }
-            state->hook = process__genericResampling;
+            state->hook = parallel ? process__genericResamplingParallel
+                    : process__genericResampling;
         } else {
             if (state->outputTemp) {
                 delete [] state->outputTemp;
@@ -1035,14 +1222,15 @@ void AudioMixer::process__validate(state_t* state)
     }
 
     ALOGV("mixer configuration change: %d activeTracks (%08x) "
-        "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d",
+        "all16BitsStereoNoResample=%d, resampling=%d, volumeRamp=%d, parallel=%d",
         countActiveTracks, state->enabledTracks,
-        all16BitsStereoNoResample, resampling, volumeRamp);
+        all16BitsStereoNoResample, resampling, volumeRamp, parallel);
 
    state->hook(state);
 
     // Now that the volume ramp has been done, set optimal state and
     // track hooks for subsequent mixer process
+    state->mutedTracks = 0;
     if (countActiveTracks > 0) {
         bool allMuted = true;
         uint32_t en = state->enabledTracks;
@@ -1053,12 +1241,16 @@ void AudioMixer::process__validate(state_t* state)
             if (!t.doesResample() && t.volumeRL == 0) {
                 t.needs |= NEEDS_MUTE;
                 t.hook = track__nop;
+                state->mutedTracks |= 1 << i;
             } else {
                 allMuted = false;
             }
         }
         if (allMuted) {
             state->hook = process__nop;
+        } else if (countActiveTracks == 1
+                && isPassthroughTrack(state->tracks[31 - __builtin_clz(state->enabledTracks)])) {
+            state->hook = process__OneTrackPassthrough;
         } else if (all16BitsStereoNoResample) {
             if (countActiveTracks == 1) {
                 const int i = 31 - __builtin_clz(state->enabledTracks);
@@ -1393,21 +1585,23 @@ void AudioMixer::process__nop(state_t* state)
         while (e1) {
             i = 31 - __builtin_clz(e1);
             e1 &= ~(1<<i);
-            {
-                track_t& t3 = state->tracks[i];
-                size_t outFrames = state->frameCount;
-                while (outFrames) {
-                    t3.buffer.frameCount = outFrames;
-                    t3.bufferProvider->getNextBuffer(&t3.buffer);
-                    if (t3.buffer.raw == NULL) break;
-                    outFrames -= t3.buffer.frameCount;
-                    t3.bufferProvider->releaseBuffer(&t3.buffer);
-                }
-            }
+            advanceTrack(state->tracks[i], state->frameCount);
         }
     }
 }
 
+// consume frameCount frames of a track without mixing them, so that its position advances
+void AudioMixer::advanceTrack(track_t& t, size_t frameCount)
+{
+    while (frameCount) {
+        t.buffer.frameCount = frameCount;
+        t.bufferProvider->getNextBuffer(&t.buffer);
+        if (t.buffer.raw == NULL) break;
+        frameCount -= t.buffer.frameCount;
+        t.bufferProvider->releaseBuffer(&t.buffer);
+    }
+}
+
 // generic code without resampling
 void AudioMixer::process__genericNoResampling(state_t* state)
 {
@@ -1421,6 +1615,13 @@ void AudioMixer::process__genericNoResampling(state_t* state)
         const int i = 31 - __builtin_clz(e0);
         e0 &= ~(1<<i);
         track_t& t = state->tracks[i];
+        if (CC_UNLIKELY(t.needs & NEEDS_MUTE)) {
+            // muted tracks only need to advance; t.in == NULL drops them from the mix below.
+            advanceTrack(t, state->frameCount);
+            t.frameCount = 0;
+            t.in = NULL;
+            continue;
+        }
         t.buffer.frameCount = state->frameCount;
         t.bufferProvider->getNextBuffer(&t.buffer);
         t.frameCount = t.buffer.frameCount;
@@ -1541,44 +1742,128 @@ void AudioMixer::process__genericResampling(state_t* state)
         e0 &= ~(e1);
         int32_t *out = t1.mainBuffer;
         memset(outTemp, 0, sizeof(*outTemp) * t1.mMixerChannelCount * state->frameCount);
-        while (e1) {
-            const int i = 31 - __builtin_clz(e1);
-            e1 &= ~(1<<i);
-            track_t& t = state->tracks[i];
-            int32_t *aux = NULL;
-            if (CC_UNLIKELY(t.needs & NEEDS_AUX)) {
-                aux = t.auxBuffer;
+        mixTracks(state, e1, outTemp, state->resampleTemp);
+        convertMixerFormat(out, t1.mMixerFormat,
+                outTemp, t1.mMixerInFormat, numFrames * t1.mMixerChannelCount);
+    }
+}
+
+// generic code with resampling, where the tracks of each output buffer group
+// are distributed across the calling thread and the mixer workers
+void AudioMixer::process__genericResamplingParallel(state_t* state)
+{
+    ALOGVV("process__genericResamplingParallel\n");
+    int32_t* const outTemp = state->outputTemp;
+    size_t numFrames = state->frameCount;
+
+    uint32_t e0 = state->enabledTracks;
+    while (e0) {
+        uint32_t e1 = e0, e2 = e0;
+        int j = 31 - __builtin_clz(e1);
+        track_t& t1 = state->tracks[j];
+        e2 &= ~(1<<j);
+        while (e2) {
+            j = 31 - __builtin_clz(e2);
+            e2 &= ~(1<<j);
+            track_t& t2 = state->tracks[j];
+            if (CC_UNLIKELY(t2.mainBuffer != t1.mainBuffer)) {
+                e1 &= ~(1<<j);
             }
+        }
+        e0 &= ~(e1);
 
-            // this is a little goofy, on the resampling case we don't
-            // acquire/release the buffers because it's done by
-            // the resampler.
-            if (t.needs & NEEDS_RESAMPLE) {
-                t.hook(&t, outTemp, numFrames, state->resampleTemp, aux);
+        // Deal the tracks round robin, the calling thread taking share 0.
+        // Tracks with an aux buffer stay on the calling thread, as several
+        // tracks may accumulate into the same aux buffer.
+        uint32_t shares[MAX_NUM_WORKERS + 1] = {};
+        const uint32_t numShares = state->workerCount + 1;
+        uint32_t next = 0;
+        e2 = e1;
+        while (e2) {
+            const int i = 31 - __builtin_clz(e2);
+            e2 &= ~(1<<i);
+            if (state->tracks[i].needs & NEEDS_AUX) {
+                shares[0] |= 1<<i;
             } else {
+                shares[next] |= 1<<i;
+                next = (next + 1) % numShares;
+            }
+        }
 
-                size_t outFrames = 0;
+        const size_t sampleCount = numFrames * t1.mMixerChannelCount;
+        for (uint32_t k = 1; k < numShares; ++k) {
+            if (shares[k] != 0) {
+                state->workers[k - 1]->post(state, shares[k], sampleCount);
+            }
+        }
+        memset(outTemp, 0, sizeof(*outTemp) * sampleCount);
+        mixTracks(state, shares[0], outTemp, state->resampleTemp);
 
-                while (outFrames < numFrames) {
-                    t.buffer.frameCount = numFrames - outFrames;
-                    t.bufferProvider->getNextBuffer(&t.buffer);
-                    t.in = t.buffer.raw;
-                    // t.in == NULL can happen if the track was flushed just after having
-                    // been enabled for mixing.
-                    if (t.in == NULL) break;
+        // reduce the partial mixes in worker order, so the result is deterministic.
+        for (uint32_t k = 1; k < numShares; ++k) {
+            if (shares[k] == 0) {
+                continue;
+            }
+            state->workers[k - 1]->wait();
+            const int32_t *partial = state->workers[k - 1]->outputTemp();
+            if (t1.mMixerInFormat == AUDIO_FORMAT_PCM_FLOAT) {
+                float *sum = reinterpret_cast<float *>(outTemp);
+                const float *in = reinterpret_cast<const float *>(partial);
+                for (size_t i = 0; i < sampleCount; ++i) {
+                    sum[i] += in[i];
+                }
+            } else {
+                for (size_t i = 0; i < sampleCount; ++i) {
+                    outTemp[i] += partial[i];
+                }
+            }
+        }
+        convertMixerFormat(t1.mainBuffer, t1.mMixerFormat,
+                outTemp, t1.mMixerInFormat, sampleCount);
+    }
+}
 
-                    if (CC_UNLIKELY(aux != NULL)) {
-                        aux += outFrames;
-                    }
-                    t.hook(&t, outTemp + outFrames * t.mMixerChannelCount, t.buffer.frameCount,
-                            state->resampleTemp, aux);
-                    outFrames += t.buffer.frameCount;
-                    t.bufferProvider->releaseBuffer(&t.buffer);
+void AudioMixer::mixTracks(state_t* state, uint32_t tracks, int32_t* outTemp,
+        int32_t* resampleTemp)
+{
+    const size_t numFrames = state->frameCount;
+    while (tracks) {
+        const int i = 31 - __builtin_clz(tracks);
+        tracks &= ~(1<<i);
+        track_t& t = state->tracks[i];
+        int32_t *aux = NULL;
+        if (CC_UNLIKELY(t.needs & NEEDS_AUX)) {
+            aux = t.auxBuffer;
+        }
+
+        // this is a little goofy, on the resampling case we don't
+        // acquire/release the buffers because it's done by
+        // the resampler.
+        if (t.needs & NEEDS_RESAMPLE) {
+            t.hook(&t, outTemp, numFrames, resampleTemp, aux);
+        } else if (CC_UNLIKELY(t.needs & NEEDS_MUTE)) {
+            advanceTrack(t, numFrames);
+        } else {
+
+            size_t outFrames = 0;
+
+            while (outFrames < numFrames) {
+                t.buffer.frameCount = numFrames - outFrames;
+                t.bufferProvider->getNextBuffer(&t.buffer);
+                t.in = t.buffer.raw;
+                // t.in == NULL can happen if the track was flushed just after having
+                // been enabled for mixing.
+                if (t.in == NULL) break;
+
+                if (CC_UNLIKELY(aux != NULL)) {
+                    aux += outFrames;
                 }
+                t.hook(&t, outTemp + outFrames * t.mMixerChannelCount, t.buffer.frameCount,
+                        resampleTemp, aux);
+                outFrames += t.buffer.frameCount;
+                t.bufferProvider->releaseBuffer(&t.buffer);
             }
         }
-        convertMixerFormat(out, t1.mMixerFormat,
-                outTemp, t1.mMixerInFormat, numFrames * t1.mMixerChannelCount);
     }
 }
 
@@ -1801,6 +2086,54 @@ void AudioMixer::volumeMix(TO *out, size_t outFrames,
     }
 }
 
+bool AudioMixer::isPassthroughTrack(const track_t& t)
+{
+    return !t.doesResample()
+            && t.auxBuffer == NULL
+            && (t.needs & NEEDS_MUTE) == 0
+            && (t.volumeInc[0] | t.volumeInc[1]) == 0
+            && t.volume[0] == UNITY_GAIN_INT && t.volume[1] == UNITY_GAIN_INT
+            && t.mVolume[0] == UNITY_GAIN_FLOAT && t.mVolume[1] == UNITY_GAIN_FLOAT
+            && t.mMixerInFormat == t.mMixerFormat
+            && t.channelCount == t.mMixerChannelCount;
+}
+
+/* This process hook is called when the single enabled track satisfies
+ * isPassthroughTrack(): the provider data is copied to the main buffer
+ * as is, skipping the volume multiply and format conversion.
+ * If the main buffer is the sink buffer (see MixerThread::prepareTracks_l),
+ * this is the only copy the data undergoes before the sink write.
+ */
+void AudioMixer::process__OneTrackPassthrough(state_t* state)
+{
+    ALOGVV("process__OneTrackPassthrough\n");
+    const int i = 31 - __builtin_clz(state->enabledTracks);
+    ALOG_ASSERT((1 << i) == state->enabledTracks, "more than 1 track enabled");
+    track_t *t = &state->tracks[i];
+    const size_t frameSize = t->mMixerChannelCount * audio_bytes_per_sample(t->mMixerFormat);
+    uint8_t *out = reinterpret_cast<uint8_t*>(t->mainBuffer);
+
+    for (size_t numFrames = state->frameCount; numFrames; ) {
+        AudioBufferProvider::Buffer& b(t->buffer);
+        b.frameCount = numFrames;
+        t->bufferProvider->getNextBuffer(&b);
+
+        // in == NULL can happen if the track was flushed just after having
+        // been enabled for mixing.
+        if (b.raw == NULL) {
+            memset(out, 0, numFrames * frameSize);
+            return;
+        }
+
+        const size_t bytes = b.frameCount * frameSize;
+        memcpy(out, b.raw, bytes);
+        out += bytes;
+        numFrames -= b.frameCount;
+
+        t->bufferProvider->releaseBuffer(&b);
+    }
+}
+
 /* This process hook is called when there is a single track without
  * aux buffer, volume ramp, or resampling.
  * TODO: Update the hook selection: this can properly handle aux and ramp.
@@ -1856,6 +2189,10 @@ void AudioMixer::process_NoResampleOneTrack(state_t* state)
     }
     if (ramp) {
         t->adjustVolumeRamp(aux != NULL, is_same<TI, float>::value);
+        // once the ramp has reached unity gain, the volume multiply is a copy.
+        if (isPassthroughTrack(*t)) {
+            state->hook = process__OneTrackPassthrough;
+        }
     }
 }
 
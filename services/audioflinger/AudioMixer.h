@@ -59,6 +59,9 @@ public:
     // maximum number of channels supported for the content
     static const uint32_t MAX_NUM_CHANNELS_TO_DOWNMIX = AUDIO_CHANNEL_COUNT_MAX;
 
+    // maximum number of additional threads used to mix tracks in parallel
+    static const uint32_t MAX_NUM_WORKERS = 4;
+
     static const uint16_t UNITY_GAIN_INT = 0x1000;
     static const CONSTEXPR float UNITY_GAIN_FLOAT = 1.0f;
 
@@ -132,6 +135,25 @@ public:
 
     size_t      getUnreleasedFrames(int name) const;
 
+    // Sets the number of worker threads, in addition to the caller of process(),
+    // that mix the enabled tracks of a main buffer in parallel.  Each worker
+    // accumulates its share of the tracks in a private buffer, and the partial
+    // mixes are summed on the calling thread.  0 (the default) disables parallel mixing.
+    // Must not be called concurrently with process().
+    void        setWorkerCount(uint32_t workerCount);
+    uint32_t    workerCount() const { return mState.workerCount; }
+
+    // Limits the dynamic resamplers (AudioResampler::DYN_*_QUALITY) of all tracks to at most
+    // quality cap, recreating them as needed; raising the cap restores each track's original
+    // quality.  The default AudioResampler::DYN_HIGH_QUALITY means no limit.
+    // Must not be called concurrently with process().
+    void        setResamplerQualityCap(AudioResampler::src_quality cap);
+    AudioResampler::src_quality resamplerQualityCap() const { return mResamplerQualityCap; }
+
+    // Number of track mix cycles skipped because the track was muted (zero volume, no
+    // resampling). Muted tracks still consume their frames but are not mixed.
+    uint32_t    skippedTrackCycles() const { return mState.skippedTrackCycles; }
+
     static inline bool isValidPcmTrackFormat(audio_format_t format) {
         switch (format) {
         case AUDIO_FORMAT_PCM_8_BIT:
@@ -165,6 +187,7 @@ private:
 
     struct state_t;
     struct track_t;
+    class MixWorker;
 
     typedef void (*hook_t)(track_t* t, int32_t* output, size_t numOutFrames, int32_t* temp,
                            int32_t* aux);
@@ -248,6 +271,8 @@ private:
         audio_format_t mDownmixRequiresFormat;  // required downmixer format
                                                 // AUDIO_FORMAT_PCM_16_BIT if 16 bit necessary
                                                 // AUDIO_FORMAT_INVALID if no required format
+        bool           mDownmixReformats;       // downmixer converts mFormat to mMixerInFormat
+                                                // itself, no reformatters are needed
 
         float          mVolume[MAX_NUM_VOLUMES];     // floating point set volume
         float          mPrevVolume[MAX_NUM_VOLUMES]; // floating point previous volume
@@ -262,8 +287,12 @@ private:
 
         AudioPlaybackRate    mPlaybackRate;
 
+        AudioResampler::src_quality mResamplerQuality; // resampler quality before any cap
+
         bool        needsRamp() { return (volumeInc[0] | volumeInc[1] | auxInc) != 0; }
         bool        setResampler(uint32_t trackSampleRate, uint32_t devSampleRate);
+        bool        applyResamplerQualityCap(AudioResampler::src_quality cap,
+                                                 uint32_t devSampleRate);
         bool        doesResample() const { return resampler != NULL; }
         void        resetResampler() { if (resampler != NULL) resampler->reset(); }
         void        adjustVolumeRamp(bool aux, bool useFloat = false);
@@ -289,7 +318,10 @@ private:
         int32_t         *outputTemp;
         int32_t         *resampleTemp;
         NBLog::Writer*  mLog;
-        int32_t         reserved[1];
+        uint32_t        workerCount;    // number of valid entries in workers[]
+        uint32_t        mutedTracks;    // enabled tracks flagged NEEDS_MUTE by process__validate
+        uint32_t        skippedTrackCycles; // see skippedTrackCycles()
+        sp<MixWorker>   workers[MAX_NUM_WORKERS];
         // FIXME allocate dynamically to save some memory when maxNumTracks < MAX_NUM_TRACKS
         track_t         tracks[MAX_NUM_TRACKS] __attribute__((aligned(32)));
     };
@@ -303,6 +335,8 @@ private:
 
     const uint32_t  mSampleRate;
 
+    AudioResampler::src_quality mResamplerQualityCap; // see setResamplerQualityCap()
+
     NBLog::Writer   mDummyLog;
 public:
     void            setLog(NBLog::Writer* log);
@@ -332,7 +366,14 @@ private:
     static void process__nop(state_t* state);
     static void process__genericNoResampling(state_t* state);
     static void process__genericResampling(state_t* state);
+    static void process__genericResamplingParallel(state_t* state);
     static void process__OneTrack16BitsStereoNoResampling(state_t* state);
+    static void process__OneTrackPassthrough(state_t* state);
+    static void advanceTrack(track_t& t, size_t frameCount);
+
+    // true if the track output is a bit-exact copy of its input (unity volume, no ramp,
+    // no resampler, no aux, and no format or channel conversion in the mixer).
+    static bool isPassthroughTrack(const track_t& t);
 
     static pthread_once_t   sOnceControl;
     static void             sInitRoutine();
@@ -364,6 +405,11 @@ private:
     static void track__NoResample(track_t* t, TO* out, size_t frameCount,
             TO* temp __unused, TA* aux);
 
+    // mixes the tracks in the bitmask into outTemp, as the inner loop of
+    // process__genericResampling.
+    static void mixTracks(state_t* state, uint32_t tracks, int32_t* outTemp,
+            int32_t* resampleTemp);
+
     static void convertMixerFormat(void *out, audio_format_t mixerOutFormat,
             void *in, audio_format_t mixerInFormat, size_t sampleCount);
 
@@ -230,6 +230,29 @@ enum {
     MIXTYPE_MULTI_SAVEONLY_MONOVOL,
 };
 
+/*
+ * VolumeMixSimd provides vectorized versions of the volumeRampMulti() and
+ * volumeMulti() inner loops for the common cases without an aux buffer.
+ *
+ * The generic template does nothing and returns false, in which case the
+ * scalar loop runs. Specializations are in AudioMixerOpsSimd.h. Each must
+ * produce results that are bit-exact with the scalar loop, including the
+ * final volume values left in the vol array after a ramp. In particular,
+ * float multiplies and adds are not fused, and ramped volumes are
+ * accumulated sequentially frame by frame, exactly as the scalar code does.
+ */
+template <int MIXTYPE, int NCHAN, typename TO, typename TI, typename TV>
+struct VolumeMixSimd {
+    static inline bool volumeRamp(TO* /* out */, size_t /* frameCount */,
+            const TI* /* in */, TV* /* vol */, const TV* /* volinc */) {
+        return false;
+    }
+    static inline bool volume(TO* /* out */, size_t /* frameCount */,
+            const TI* /* in */, const TV* /* vol */) {
+        return false;
+    }
+};
+
 /*
  * The volumeRampMulti and volumeRamp functions take a MIXTYPE
  * which indicates the per-frame mixing and accumulation strategy.
@@ -322,6 +345,10 @@ inline void volumeRampMulti(TO* out, size_t frameCount,
             vola[0] += volainc;
         } while (--frameCount);
     } else {
+        if (VolumeMixSimd<MIXTYPE, NCHAN, TO, TI, TV>::volumeRamp(
+                out, frameCount, in, vol, volinc)) {
+            return;
+        }
         do {
             switch (MIXTYPE) {
             case MIXTYPE_MULTI:
@@ -409,6 +436,9 @@ inline void volumeMulti(TO* out, size_t frameCount,
             *aux++ += MixMul<TA, TA, TAV>(auxaccum, vola);
         } while (--frameCount);
     } else {
+        if (VolumeMixSimd<MIXTYPE, NCHAN, TO, TI, TV>::volume(out, frameCount, in, vol)) {
+            return;
+        }
         do {
             switch (MIXTYPE) {
             case MIXTYPE_MULTI:
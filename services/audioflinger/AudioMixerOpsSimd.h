@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MIXER_OPS_SIMD_H
+#define ANDROID_AUDIO_MIXER_OPS_SIMD_H
+
+// depends on AudioMixerOps.h
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#ifndef MIXER_USE_NEON
+#define MIXER_USE_NEON (true)
+#endif
+#else
+#define MIXER_USE_NEON (false)
+#endif
+
+#if !MIXER_USE_NEON && defined(__SSE2__)
+#ifndef MIXER_USE_SSE
+#define MIXER_USE_SSE (true)
+#endif
+#else
+#define MIXER_USE_SSE (false)
+#endif
+
+#if MIXER_USE_NEON
+#include <arm_neon.h>
+#elif MIXER_USE_SSE
+#include <emmintrin.h>
+#endif
+
+namespace android {
+
+// Specializations of VolumeMixSimd, see AudioMixerOps.h.
+// These must be visible before volumeRampMulti() and volumeMulti() are instantiated.
+
+#if MIXER_USE_NEON || MIXER_USE_SSE
+
+#if MIXER_USE_NEON
+typedef float32x4_t mixer_float4_t;
+
+static inline mixer_float4_t mixer_load4(const float *p) { return vld1q_f32(p); }
+static inline void mixer_store4(float *p, mixer_float4_t v) { vst1q_f32(p, v); }
+static inline mixer_float4_t mixer_dup4(float f) { return vdupq_n_f32(f); }
+static inline mixer_float4_t mixer_set4(float a, float b, float c, float d) {
+    const float f[4] = { a, b, c, d };
+    return vld1q_f32(f);
+}
+static inline mixer_float4_t mixer_add4(mixer_float4_t a, mixer_float4_t b) {
+    return vaddq_f32(a, b);
+}
+// vmulq_f32 followed by vaddq_f32 is used instead of vmlaq_f32 / vfmaq_f32
+// so that the intermediate product is rounded as in the scalar code.
+static inline mixer_float4_t mixer_mul4(mixer_float4_t a, mixer_float4_t b) {
+    return vmulq_f32(a, b);
+}
+#else
+typedef __m128 mixer_float4_t;
+
+static inline mixer_float4_t mixer_load4(const float *p) { return _mm_loadu_ps(p); }
+static inline void mixer_store4(float *p, mixer_float4_t v) { _mm_storeu_ps(p, v); }
+static inline mixer_float4_t mixer_dup4(float f) { return _mm_set1_ps(f); }
+static inline mixer_float4_t mixer_set4(float a, float b, float c, float d) {
+    return _mm_setr_ps(a, b, c, d);
+}
+static inline mixer_float4_t mixer_add4(mixer_float4_t a, mixer_float4_t b) {
+    return _mm_add_ps(a, b);
+}
+static inline mixer_float4_t mixer_mul4(mixer_float4_t a, mixer_float4_t b) {
+    return _mm_mul_ps(a, b);
+}
+#endif
+
+// Returns true for the MIXTYPEs which store rather than accumulate into out.
+template <int MIXTYPE>
+struct MixTypeSaveOnly {
+    static const bool value = MIXTYPE == MIXTYPE_MULTI_SAVEONLY
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_MONOVOL;
+};
+
+// out[i] (+)= in[i] * volq for count samples, count a multiple of 4.
+template <bool SAVEONLY>
+static inline void mixer_mul4_block(float *out, const float *in, size_t count,
+        mixer_float4_t volq) {
+    for (; count >= 4; count -= 4) {
+        mixer_float4_t prod = mixer_mul4(mixer_load4(in), volq);
+        if (!SAVEONLY) {
+            prod = mixer_add4(mixer_load4(out), prod);
+        }
+        mixer_store4(out, prod);
+        in += 4;
+        out += 4;
+    }
+}
+
+// out[i] (+)= in[i] * vol for count samples, any count.
+template <bool SAVEONLY>
+static inline void mixer_mul_frame(float *out, const float *in, size_t count, float vol) {
+    const size_t vcount = count & ~3;
+    mixer_mul4_block<SAVEONLY>(out, in, vcount, mixer_dup4(vol));
+    for (size_t i = vcount; i < count; ++i) {
+        if (SAVEONLY) {
+            out[i] = MixMul<float, float, float>(in[i], vol);
+        } else {
+            out[i] += MixMul<float, float, float>(in[i], vol);
+        }
+    }
+}
+
+/*
+ * float mono and stereo, one volume per channel.
+ */
+template <int MIXTYPE, int NCHAN>
+struct VolumeMixSimdFloat {
+    static const bool SAVEONLY = MixTypeSaveOnly<MIXTYPE>::value;
+
+    static inline bool volumeRamp(float *out, size_t frameCount,
+            const float *in, float *vol, const float *volinc) {
+        if (NCHAN == 1) {
+            // four frames per vector, volume accumulated sequentially.
+            float v = vol[0];
+            const float inc = volinc[0];
+            for (; frameCount >= 4; frameCount -= 4) {
+                const float v1 = v + inc;
+                const float v2 = v1 + inc;
+                const float v3 = v2 + inc;
+                mixer_mul4_block<SAVEONLY>(out, in, 4, mixer_set4(v, v1, v2, v3));
+                v = v3 + inc;
+                in += 4;
+                out += 4;
+            }
+            for (; frameCount > 0; --frameCount) {
+                mixer_mul_frame<SAVEONLY>(out++, in++, 1, v);
+                v += inc;
+            }
+            vol[0] = v;
+        } else { // NCHAN == 2
+            // two frames per vector.
+            float vl = vol[0];
+            float vr = vol[1];
+            const float incl = volinc[0];
+            const float incr = volinc[1];
+            for (; frameCount >= 2; frameCount -= 2) {
+                const float vl1 = vl + incl;
+                const float vr1 = vr + incr;
+                mixer_mul4_block<SAVEONLY>(out, in, 4, mixer_set4(vl, vr, vl1, vr1));
+                vl = vl1 + incl;
+                vr = vr1 + incr;
+                in += 4;
+                out += 4;
+            }
+            if (frameCount > 0) {
+                mixer_mul_frame<SAVEONLY>(out, in, 1, vl);
+                mixer_mul_frame<SAVEONLY>(out + 1, in + 1, 1, vr);
+                vl += incl;
+                vr += incr;
+            }
+            vol[0] = vl;
+            vol[1] = vr;
+        }
+        return true;
+    }
+
+    static inline bool volume(float *out, size_t frameCount,
+            const float *in, const float *vol) {
+        const size_t count = frameCount * NCHAN;
+        const size_t vcount = count & ~3;
+        if (NCHAN == 1) {
+            mixer_mul4_block<SAVEONLY>(out, in, vcount, mixer_dup4(vol[0]));
+        } else { // NCHAN == 2
+            mixer_mul4_block<SAVEONLY>(out, in, vcount,
+                    mixer_set4(vol[0], vol[1], vol[0], vol[1]));
+        }
+        for (size_t i = vcount; i < count; ++i) {
+            mixer_mul_frame<SAVEONLY>(out + i, in + i, 1, vol[i % NCHAN]);
+        }
+        return true;
+    }
+};
+
+/*
+ * float multichannel, volume[0] applied to every channel.
+ */
+template <int MIXTYPE, int NCHAN>
+struct VolumeMixSimdFloatMonoVol {
+    static const bool SAVEONLY = MixTypeSaveOnly<MIXTYPE>::value;
+
+    static inline bool volumeRamp(float *out, size_t frameCount,
+            const float *in, float *vol, const float *volinc) {
+        float v = vol[0];
+        const float inc = volinc[0];
+        do {
+            mixer_mul_frame<SAVEONLY>(out, in, NCHAN, v);
+            v += inc;
+            in += NCHAN;
+            out += NCHAN;
+        } while (--frameCount);
+        vol[0] = v;
+        return true;
+    }
+
+    static inline bool volume(float *out, size_t frameCount,
+            const float *in, const float *vol) {
+        mixer_mul_frame<SAVEONLY>(out, in, frameCount * NCHAN, vol[0]);
+        return true;
+    }
+};
+
+// MIXTYPE_MULTI and MIXTYPE_MULTI_SAVEONLY are only used for mono and stereo;
+// more channels are remapped to the MONOVOL variants by AudioMixer.
+template <>
+struct VolumeMixSimd<MIXTYPE_MULTI, 1, float, float, float>
+        : public VolumeMixSimdFloat<MIXTYPE_MULTI, 1> {};
+
+template <>
+struct VolumeMixSimd<MIXTYPE_MULTI, 2, float, float, float>
+        : public VolumeMixSimdFloat<MIXTYPE_MULTI, 2> {};
+
+template <>
+struct VolumeMixSimd<MIXTYPE_MULTI_SAVEONLY, 1, float, float, float>
+        : public VolumeMixSimdFloat<MIXTYPE_MULTI_SAVEONLY, 1> {};
+
+template <>
+struct VolumeMixSimd<MIXTYPE_MULTI_SAVEONLY, 2, float, float, float>
+        : public VolumeMixSimdFloat<MIXTYPE_MULTI_SAVEONLY, 2> {};
+
+template <int NCHAN>
+struct VolumeMixSimd<MIXTYPE_MULTI_MONOVOL, NCHAN, float, float, float>
+        : public VolumeMixSimdFloatMonoVol<MIXTYPE_MULTI_MONOVOL, NCHAN> {};
+
+template <int NCHAN>
+struct VolumeMixSimd<MIXTYPE_MULTI_SAVEONLY_MONOVOL, NCHAN, float, float, float>
+        : public VolumeMixSimdFloatMonoVol<MIXTYPE_MULTI_SAVEONLY_MONOVOL, NCHAN> {};
+
+/*
+ * int16_t stereo input accumulated into int32_t (Q4.27) with U4.12 volume.
+ * This is the legacy integer mixer path used by most 16 bit tracks.
+ */
+template <>
+struct VolumeMixSimd<MIXTYPE_MULTI, 2, int32_t, int16_t, int16_t> {
+    static inline bool volumeRamp(int32_t* /* out */, size_t /* frameCount */,
+            const int16_t* /* in */, int16_t* /* vol */, const int16_t* /* volinc */) {
+        return false;
+    }
+
+    static inline bool volume(int32_t *out, size_t frameCount,
+            const int16_t *in, const int16_t *vol) {
+        // four frames (eight samples) per iteration.
+        size_t count = frameCount & ~3;
+#if MIXER_USE_NEON
+        const int16_t v[4] = { vol[0], vol[1], vol[0], vol[1] };
+        const int16x4_t volv = vld1_s16(v);
+        for (size_t i = 0; i < count; i += 4) {
+            const int16x8_t inv = vld1q_s16(in);
+            int32x4_t lo = vld1q_s32(out);
+            int32x4_t hi = vld1q_s32(out + 4);
+            lo = vmlal_s16(lo, vget_low_s16(inv), volv);
+            hi = vmlal_s16(hi, vget_high_s16(inv), volv);
+            vst1q_s32(out, lo);
+            vst1q_s32(out + 4, hi);
+            in += 8;
+            out += 8;
+        }
+#else
+        const __m128i volv = _mm_setr_epi16(vol[0], vol[1], vol[0], vol[1],
+                vol[0], vol[1], vol[0], vol[1]);
+        for (size_t i = 0; i < count; i += 4) {
+            const __m128i inv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+            const __m128i prodlo = _mm_mullo_epi16(inv, volv);
+            const __m128i prodhi = _mm_mulhi_epi16(inv, volv);
+            __m128i *outv = reinterpret_cast<__m128i *>(out);
+            _mm_storeu_si128(outv, _mm_add_epi32(_mm_loadu_si128(outv),
+                    _mm_unpacklo_epi16(prodlo, prodhi)));
+            _mm_storeu_si128(outv + 1, _mm_add_epi32(_mm_loadu_si128(outv + 1),
+                    _mm_unpackhi_epi16(prodlo, prodhi)));
+            in += 8;
+            out += 8;
+        }
+#endif
+        for (size_t i = count; i < frameCount; ++i) {
+            *out++ += MixMul<int32_t, int16_t, int16_t>(*in++, vol[0]);
+            *out++ += MixMul<int32_t, int16_t, int16_t>(*in++, vol[1]);
+        }
+        return true;
+    }
+};
+
+#if MIXER_USE_NEON
+/*
+ * int16_t stereo input accumulated into int32_t (Q4.27) with a U4.28 volume ramp.
+ * Needs a 32 bit vector multiply, so this is only provided for NEON.
+ */
+template <>
+struct VolumeMixSimd<MIXTYPE_MULTI, 2, int32_t, int16_t, int32_t> {
+    static inline bool volumeRamp(int32_t *out, size_t frameCount,
+            const int16_t *in, int32_t *vol, const int32_t *volinc) {
+        // two frames per iteration; integer volumes accumulate exactly.
+        const int32_t inc[4] = { volinc[0], volinc[1], volinc[0], volinc[1] };
+        const int32x4_t incv = vld1q_s32(inc);
+        const int32x4_t inc2v = vaddq_s32(incv, incv);
+        const int32_t v[4] = { vol[0], vol[1], vol[0] + volinc[0], vol[1] + volinc[1] };
+        int32x4_t volv = vld1q_s32(v);
+        size_t count = frameCount & ~1;
+        for (size_t i = 0; i < count; i += 2) {
+            const int32x4_t inv = vmovl_s16(vld1_s16(in));
+            const int32x4_t prod = vmulq_s32(inv, vshrq_n_s32(volv, 16));
+            vst1q_s32(out, vaddq_s32(vld1q_s32(out), prod));
+            volv = vaddq_s32(volv, inc2v);
+            in += 4;
+            out += 4;
+        }
+        int32_t vl = vgetq_lane_s32(volv, 0);
+        int32_t vr = vgetq_lane_s32(volv, 1);
+        if (count < frameCount) {
+            *out++ += MixMul<int32_t, int16_t, int32_t>(*in++, vl);
+            *out++ += MixMul<int32_t, int16_t, int32_t>(*in++, vr);
+            vl += volinc[0];
+            vr += volinc[1];
+        }
+        vol[0] = vl;
+        vol[1] = vr;
+        return true;
+    }
+
+    static inline bool volume(int32_t* /* out */, size_t /* frameCount */,
+            const int16_t* /* in */, const int32_t* /* vol */) {
+        return false;
+    }
+};
+#endif // MIXER_USE_NEON
+
+#endif // MIXER_USE_NEON || MIXER_USE_SSE
+
+} // namespace android
+
+#endif /* ANDROID_AUDIO_MIXER_OPS_SIMD_H */
@@ -18,6 +18,7 @@
 //#define LOG_NDEBUG 0
 
 #include <malloc.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 #include <dlfcn.h>
@@ -148,6 +149,109 @@ void AudioResamplerDyn<TC, TI, TO>::InBuffer::readAdvance(TI*& impulse, const in
     readAgain<CHANNELS>(impulse, halfNumCoefs, in, inputIndex);
 }
 
+/*
+ * FirCoefCache is a process-wide cache of polyphase filter banks.
+ *
+ * Filter generation is expensive and many tracks typically resample with
+ * the same design (e.g. 44.1kHz to 48kHz at the default quality), so identical
+ * filter banks are computed once and shared read-only between resamplers.
+ * Entries are reference counted and freed when the last user releases them.
+ * There is a separate cache for each coefficient type TC.
+ */
+template<typename TC>
+class FirCoefCache {
+public:
+    // Returns the filter bank for the design, generating it if not yet cached.
+    static const TC* acquire(int L, int halfNumCoefs,
+            double stopBandAtten, double fcr, double atten);
+
+    // Releases a filter bank returned by acquire(). NULL is ignored.
+    static void release(const TC* coefs);
+
+private:
+    struct Entry {
+        int     mL;
+        int     mHalfNumCoefs;
+        double  mStopBandAtten;
+        double  mFcr;
+        double  mAtten;
+        TC*     mCoefs;
+        int     mRefCount;
+        Entry*  mNext;
+    };
+
+    static pthread_mutex_t sLock;
+    static Entry* sEntries; // singly linked list, protected by sLock
+};
+
+template<typename TC>
+pthread_mutex_t FirCoefCache<TC>::sLock = PTHREAD_MUTEX_INITIALIZER;
+
+template<typename TC>
+typename FirCoefCache<TC>::Entry* FirCoefCache<TC>::sEntries = NULL;
+
+template<typename TC>
+const TC* FirCoefCache<TC>::acquire(int L, int halfNumCoefs,
+        double stopBandAtten, double fcr, double atten)
+{
+    pthread_mutex_lock(&sLock);
+    Entry* entry = sEntries;
+    for (; entry != NULL; entry = entry->mNext) {
+        if (entry->mL == L && entry->mHalfNumCoefs == halfNumCoefs
+                && entry->mStopBandAtten == stopBandAtten
+                && entry->mFcr == fcr && entry->mAtten == atten) {
+            break;
+        }
+    }
+    if (entry == NULL) {
+        // Generated with the lock held, so concurrent requests for the
+        // same design wait here instead of computing it again.
+        TC* coefs = NULL;
+        (void)posix_memalign(reinterpret_cast<void**>(&coefs), 32,
+                (L+1)*halfNumCoefs*sizeof(TC));
+        firKaiserGen(coefs, L, halfNumCoefs, stopBandAtten, fcr, atten);
+        entry = new Entry;
+        entry->mL = L;
+        entry->mHalfNumCoefs = halfNumCoefs;
+        entry->mStopBandAtten = stopBandAtten;
+        entry->mFcr = fcr;
+        entry->mAtten = atten;
+        entry->mCoefs = coefs;
+        entry->mRefCount = 0;
+        entry->mNext = sEntries;
+        sEntries = entry;
+        ALOGV("FirCoefCache created L:%d halfNumCoefs:%d stopBandAtten:%lf fcr:%lf",
+                L, halfNumCoefs, stopBandAtten, fcr);
+    }
+    ++entry->mRefCount;
+    const TC* coefs = entry->mCoefs;
+    pthread_mutex_unlock(&sLock);
+    return coefs;
+}
+
+template<typename TC>
+void FirCoefCache<TC>::release(const TC* coefs)
+{
+    if (coefs == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&sLock);
+    for (Entry** link = &sEntries; *link != NULL; link = &(*link)->mNext) {
+        Entry* entry = *link;
+        if (entry->mCoefs == coefs) {
+            if (--entry->mRefCount == 0) {
+                *link = entry->mNext;
+                free(entry->mCoefs);
+                delete entry;
+            }
+            pthread_mutex_unlock(&sLock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+    ALOGE("FirCoefCache::release unknown filter bank %p", coefs);
+}
+
 template<typename TC, typename TI, typename TO>
 void AudioResamplerDyn<TC, TI, TO>::Constants::set(
         int L, int halfNumCoefs, int inSampleRate, int outSampleRate)
@@ -180,7 +284,7 @@ AudioResamplerDyn<TC, TI, TO>::AudioResamplerDyn(
 template<typename TC, typename TI, typename TO>
 AudioResamplerDyn<TC, TI, TO>::~AudioResamplerDyn()
 {
-    free(mCoefBuffer);
+    FirCoefCache<TC>::release(mCoefBuffer);
 }
 
 template<typename TC, typename TI, typename TO>
@@ -213,23 +317,20 @@ template<typename TC, typename TI, typename TO>
 void AudioResamplerDyn<TC, TI, TO>::createKaiserFir(Constants &c,
         double stopBandAtten, int inSampleRate, int outSampleRate, double tbwCheat)
 {
-    TC* buf = NULL;
     static const double atten = 0.9998;   // to avoid ripple overflow
     double fcr;
     double tbw = firKaiserTbw(c.mHalfNumCoefs, stopBandAtten);
 
-    (void)posix_memalign(reinterpret_cast<void**>(&buf), 32, (c.mL+1)*c.mHalfNumCoefs*sizeof(TC));
     if (inSampleRate < outSampleRate) { // upsample
         fcr = max(0.5*tbwCheat - tbw/2, tbw/2);
     } else { // downsample
         fcr = max(0.5*tbwCheat*outSampleRate/inSampleRate - tbw/2, tbw/2);
     }
-    // create and set filter
-    firKaiserGen(buf, c.mL, c.mHalfNumCoefs, stopBandAtten, fcr, atten);
+    // get (or create) and set filter; acquire before release so an
+    // unchanged design is not regenerated.
+    const TC* buf = FirCoefCache<TC>::acquire(c.mL, c.mHalfNumCoefs, stopBandAtten, fcr, atten);
     c.mFirCoefs = buf;
-    if (mCoefBuffer) {
-        free(mCoefBuffer);
-    }
+    FirCoefCache<TC>::release(mCoefBuffer);
     mCoefBuffer = buf;
 #ifdef DEBUG_RESAMPLER
     // print basic filter stats
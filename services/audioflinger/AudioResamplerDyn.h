@@ -124,7 +124,8 @@ private:
      resample_ABP_t mResampleFunc;     // called function for resampling
             int32_t mFilterSampleRate; // designed filter sample rate.
         src_quality mFilterQuality;    // designed filter quality.
-              void* mCoefBuffer;       // if a filter is created, this is not null
+          const TC* mCoefBuffer;       // if a filter is created, this is not null
+                                       // shared through FirCoefCache, do not modify
 };
 
 } // namespace android
@@ -1207,6 +1207,184 @@ inline void Process<2, 16>(float* const out,
             lerpP, coefsP1, coefsN1);
 }
 
+//
+// Multichannel (4, 6 and 8 channel) float specializations.
+//
+// Unlike the mono and stereo kernels, which vectorize across filter taps, these
+// vectorize across channels: each tap multiplies a whole interleaved frame, kept in
+// channel blocks of 4 (and 2 for 6 channels).  Coefficients are still loaded
+// and interpolated 4 taps at a time.
+//
+// As with the generic ProcessBase() for more than 2 channels, volumeLR[0] is
+// applied to all channels and the result is stored (not accumulated) into out.
+//
+
+template <int CHANNELS>
+static inline void ProcessNeonMultiMac(float32x4_t& accum0, float32x4_t& accum1,
+        float32x2_t& accum2, const float* samples, float coef)
+{
+    accum0 = vmlaq_n_f32(accum0, vld1q_f32(samples), coef);
+    if (CHANNELS == 8) {
+        accum1 = vmlaq_n_f32(accum1, vld1q_f32(samples + 4), coef);
+    } else if (CHANNELS == 6) {
+        accum2 = vmla_n_f32(accum2, vld1_f32(samples + 4), coef);
+    }
+}
+
+template <int CHANNELS, bool FIXED>
+static inline void ProcessNeonIntrinsicMulti(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 3) == 0); // multiple of 4
+    COMPILE_TIME_ASSERT_FUNCTION_SCOPE(CHANNELS == 4 || CHANNELS == 6 || CHANNELS == 8);
+
+    coefsP = (const float*)__builtin_assume_aligned(coefsP, 16);
+    coefsN = (const float*)__builtin_assume_aligned(coefsN, 16);
+    if (!FIXED) {
+        coefsP1 = (const float*)__builtin_assume_aligned(coefsP1, 16);
+        coefsN1 = (const float*)__builtin_assume_aligned(coefsN1, 16);
+    }
+    float32x4_t accum0 = vdupq_n_f32(0); // channels 0-3
+    float32x4_t accum1 = vdupq_n_f32(0); // channels 4-7 (8 channels)
+    float32x2_t accum2 = vdup_n_f32(0);  // channels 4-5 (6 channels)
+    do {
+        float32x4_t posCoef = vld1q_f32(coefsP);
+        coefsP += 4;
+        float32x4_t negCoef = vld1q_f32(coefsN);
+        coefsN += 4;
+        if (!FIXED) { // interpolate
+            float32x4_t posCoef1 = vld1q_f32(coefsP1);
+            coefsP1 += 4;
+            float32x4_t negCoef1 = vld1q_f32(coefsN1);
+            coefsN1 += 4;
+            // interpolated[P] = lerpP * (P1 - P) + P
+            // interpolated[N] = lerpP * (N - N1) + N1
+            posCoef = vmlaq_n_f32(posCoef, vsubq_f32(posCoef1, posCoef), lerpP);
+            negCoef = vmlaq_n_f32(negCoef1, vsubq_f32(negCoef, negCoef1), lerpP);
+        }
+        ProcessNeonMultiMac<CHANNELS>(accum0, accum1, accum2, sP, vgetq_lane_f32(posCoef, 0));
+        sP -= CHANNELS;
+        ProcessNeonMultiMac<CHANNELS>(accum0, accum1, accum2, sN, vgetq_lane_f32(negCoef, 0));
+        sN += CHANNELS;
+        ProcessNeonMultiMac<CHANNELS>(accum0, accum1, accum2, sP, vgetq_lane_f32(posCoef, 1));
+        sP -= CHANNELS;
+        ProcessNeonMultiMac<CHANNELS>(accum0, accum1, accum2, sN, vgetq_lane_f32(negCoef, 1));
+        sN += CHANNELS;
+        ProcessNeonMultiMac<CHANNELS>(accum0, accum1, accum2, sP, vgetq_lane_f32(posCoef, 2));
+        sP -= CHANNELS;
+        ProcessNeonMultiMac<CHANNELS>(accum0, accum1, accum2, sN, vgetq_lane_f32(negCoef, 2));
+        sN += CHANNELS;
+        ProcessNeonMultiMac<CHANNELS>(accum0, accum1, accum2, sP, vgetq_lane_f32(posCoef, 3));
+        sP -= CHANNELS;
+        ProcessNeonMultiMac<CHANNELS>(accum0, accum1, accum2, sN, vgetq_lane_f32(negCoef, 3));
+        sN += CHANNELS;
+    } while (count -= 4);
+
+    // multiply by volume and save
+    const float vol = volumeLR[0];
+    vst1q_f32(out, vmulq_n_f32(accum0, vol));
+    if (CHANNELS == 8) {
+        vst1q_f32(out + 4, vmulq_n_f32(accum1, vol));
+    } else if (CHANNELS == 6) {
+        vst1_f32(out + 4, vmul_n_f32(accum2, vol));
+    }
+}
+
+template<>
+inline void ProcessL<4, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* const volumeLR)
+{
+    ProcessNeonIntrinsicMulti<4, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
+}
+
+template<>
+inline void Process<4, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* coefsP1,
+        const float* coefsN1,
+        const float* sP,
+        const float* sN,
+        float lerpP,
+        const float* const volumeLR)
+{
+    ProcessNeonIntrinsicMulti<4, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            lerpP, coefsP1, coefsN1);
+}
+
+template<>
+inline void ProcessL<6, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* const volumeLR)
+{
+    ProcessNeonIntrinsicMulti<6, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
+}
+
+template<>
+inline void Process<6, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* coefsP1,
+        const float* coefsN1,
+        const float* sP,
+        const float* sN,
+        float lerpP,
+        const float* const volumeLR)
+{
+    ProcessNeonIntrinsicMulti<6, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            lerpP, coefsP1, coefsN1);
+}
+
+template<>
+inline void ProcessL<8, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* const volumeLR)
+{
+    ProcessNeonIntrinsicMulti<8, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
+}
+
+template<>
+inline void Process<8, 16>(float* const out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* coefsP1,
+        const float* coefsN1,
+        const float* sP,
+        const float* sN,
+        float lerpP,
+        const float* const volumeLR)
+{
+    ProcessNeonIntrinsicMulti<8, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            lerpP, coefsP1, coefsN1);
+}
+
 #endif //USE_NEON
 
 } // namespace android
@@ -18,13 +18,79 @@
 //#define LOG_NDEBUG 0
 
 #include "Configuration.h"
+#include <stdio.h>
 #include <utils/Log.h>
 #include "AudioWatchdog.h"
 
-#ifdef AUDIO_WATCHDOG
-
 namespace android {
 
+void WakeupLatencyDump::add(nsecs_t latencyNs)
+{
+    if (latencyNs < 0) {
+        latencyNs = 0;
+    }
+    mWakeups++;
+    if (latencyNs > kLateNs) {
+        mLateWakeups++;
+    }
+    if (latencyNs > mMaxNs) {
+        mMaxNs = latencyNs;
+    }
+    mTotalNs += latencyNs;
+}
+
+void WakeupLatencyDump::dump(int fd) const
+{
+    if (mWakeups == 0) {
+        return;
+    }
+    dprintf(fd, "  Wakeup latency: %u timed sleeps, mean %lld us, max %lld us, %u over %lld us\n",
+            mWakeups, (long long) (mTotalNs / mWakeups / 1000), (long long) (mMaxNs / 1000),
+            mLateWakeups, (long long) (kLateNs / 1000));
+}
+
+void dumpThreadSchedStats(int fd, pid_t tid)
+{
+    if (tid <= 0) {
+        return;
+    }
+    char path[64];
+    char line[128];
+    long long voluntary = -1;
+    long long involuntary = -1;
+    snprintf(path, sizeof(path), "/proc/self/task/%d/status", tid);
+    FILE *f = fopen(path, "re");
+    if (f == NULL) {
+        return;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        (void) sscanf(line, "voluntary_ctxt_switches: %lld", &voluntary);
+        (void) sscanf(line, "nonvoluntary_ctxt_switches: %lld", &involuntary);
+    }
+    fclose(f);
+    // only available if the kernel has CONFIG_SCHED_DEBUG
+    long long migrations = -1;
+    snprintf(path, sizeof(path), "/proc/self/task/%d/sched", tid);
+    f = fopen(path, "re");
+    if (f != NULL) {
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (sscanf(line, "se.nr_migrations : %lld", &migrations) == 1) {
+                break;
+            }
+        }
+        fclose(f);
+    }
+    dprintf(fd, "  Scheduler tid %d: voluntary switches=%lld, involuntary switches=%lld",
+            tid, voluntary, involuntary);
+    if (migrations >= 0) {
+        dprintf(fd, ", CPU migrations=%lld\n", migrations);
+    } else {
+        dprintf(fd, ", CPU migrations=N/A\n");
+    }
+}
+
+#ifdef AUDIO_WATCHDOG
+
 void AudioWatchdogDump::dump(int fd)
 {
     char buf[32];
@@ -36,6 +102,7 @@ void AudioWatchdogDump::dump(int fd)
     }
     dprintf(fd, "Watchdog: underruns=%u, logs=%u, most recent underrun log at %s",
             mUnderruns, mLogs, buf);
+    mWakeupLatency.dump(fd);
 }
 
 bool AudioWatchdog::threadLoop()
@@ -99,11 +166,15 @@ bool AudioWatchdog::threadLoop()
     struct timespec req;
     req.tv_sec = 0;
     req.tv_nsec = mPeriodNs;
+    const nsecs_t sleepStartNs = systemTime();
     rc = nanosleep(&req, NULL);
     if (!((rc == 0) || (rc == -1 && errno == EINTR))) {
         pause();
         return false;
     }
+    if (rc == 0) {
+        mDump->mWakeupLatency.add(systemTime() - sleepStartNs - mPeriodNs);
+    }
     return true;
 }
 
@@ -134,6 +205,6 @@ void AudioWatchdog::setDump(AudioWatchdogDump *dump)
     mDump = dump != NULL ? dump : &mDummyDump;
 }
 
-}   // namespace android
-
 #endif // AUDIO_WATCHDOG
+
+}   // namespace android
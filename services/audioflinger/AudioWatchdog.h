@@ -18,15 +18,36 @@
 //   (a) verify that adequate CPU time is available, and log
 //       as soon as possible when there appears to be a CPU shortage
 //   (b) monitor the other threads [not yet implemented]
+// This file also has the scheduling latency statistics kept by the normal and fast threads.
 
 #ifndef AUDIO_WATCHDOG_H
 #define AUDIO_WATCHDOG_H
 
+#include <sys/types.h>
 #include <time.h>
 #include <utils/Thread.h>
+#include <utils/Timers.h>
 
 namespace android {
 
+// How late a thread ran again after its timed sleeps, compared to the requested wakeup time.
+// This is time lost to the scheduler rather than to the thread's own work.
+// Updated by the sleeping thread only; the usual caveats about atomicity of information apply.
+struct WakeupLatencyDump {
+    WakeupLatencyDump() : mWakeups(0), mLateWakeups(0), mMaxNs(0), mTotalNs(0) { }
+    static const nsecs_t kLateNs = 1000000;     // a wakeup later than this counts as late
+    void     add(nsecs_t latencyNs);
+    void     dump(int fd) const;    // should only be called on a stable copy, not the original
+    uint32_t mWakeups;      // total number of timed sleeps that ran to completion
+    uint32_t mLateWakeups;  // number of those later than kLateNs
+    nsecs_t  mMaxNs;        // worst latency
+    int64_t  mTotalNs;      // for the mean
+};
+
+// Dumps the context switch and CPU migration counters the kernel keeps for thread tid.
+// They are read from /proc at dump time, so the thread being observed pays nothing for them.
+void dumpThreadSchedStats(int fd, pid_t tid);
+
 // Keeps a cache of AudioWatchdog statistics that can be logged by dumpsys.
 // The usual caveats about atomicity of information apply.
 struct AudioWatchdogDump {
@@ -35,6 +56,7 @@ struct AudioWatchdogDump {
     uint32_t mUnderruns;    // total number of underruns
     uint32_t mLogs;         // total number of log messages
     time_t   mMostRecent;   // time of most recent log
+    WakeupLatencyDump mWakeupLatency;   // of the watchdog's own periodic sleeps
     void     dump(int fd);  // should only be called on a stable copy, not the original
 };
 
@@ -17,12 +17,16 @@
 #define LOG_TAG "BufferProvider"
 //#define LOG_NDEBUG 0
 
+#include <math.h>
+#include <stdlib.h>
+
 #include <audio_effects/effect_downmix.h>
 #include <audio_utils/primitives.h>
 #include <audio_utils/format.h>
 #include <media/AudioResamplerPublic.h>
 #include <media/EffectsFactoryApi.h>
 
+#include <cutils/properties.h>
 #include <utils/Log.h>
 
 #include "Configuration.h"
@@ -32,6 +36,10 @@
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof((x)[0]))
 #endif
 
+#ifndef FCC_2
+#define FCC_2 2
+#endif
+
 namespace android {
 
 // ----------------------------------------------------------------------------
@@ -42,6 +50,12 @@ static inline T min(const T& a, const T& b)
     return a < b ? a : b;
 }
 
+template <typename T>
+static inline T max(const T& a, const T& b)
+{
+    return a > b ? a : b;
+}
+
 CopyBufferProvider::CopyBufferProvider(size_t inputFrameSize,
         size_t outputFrameSize, size_t bufferFrameCount) :
         mInputFrameSize(inputFrameSize),
@@ -274,6 +288,141 @@ void DownmixerBufferProvider::copyFrames(void *dst, const void *src, size_t fram
 /*static*/ bool DownmixerBufferProvider::sIsMultichannelCapable = false;
 /*static*/ effect_descriptor_t DownmixerBufferProvider::sDwnmFxDesc;
 
+// -3dB, used for the channels that fold into both sides (as the downmix effect does).
+static const float kMinus3dB = 0.70710678f;
+
+MatrixDownmixBufferProvider::MatrixDownmixBufferProvider(
+        audio_channel_mask_t inputChannelMask,
+        audio_format_t inputFormat, audio_format_t outputFormat,
+        size_t bufferFrameCount) :
+        CopyBufferProvider(
+                audio_bytes_per_sample(inputFormat)
+                    * audio_channel_count_from_out_mask(inputChannelMask),
+                audio_bytes_per_sample(outputFormat) * FCC_2,
+                bufferFrameCount),
+        mInputFormat(inputFormat),
+        mOutputFormat(outputFormat),
+        mInputChannels(audio_channel_count_from_out_mask(inputChannelMask))
+{
+    ALOGV("MatrixDownmixBufferProvider(%p)(%#x, %#x, %#x)",
+            this, inputChannelMask, inputFormat, outputFormat);
+    memset(mMatrix, 0, sizeof(mMatrix));
+
+    // Default fold-down: left channels to left, right channels to right,
+    // center and LFE channels to both sides at -3dB.
+    uint32_t bits = audio_channel_mask_get_bits(inputChannelMask);
+    for (uint32_t i = 0; i < mInputChannels; ++i) {
+        const uint32_t channel = bits & -bits; // lowest set bit is the next channel
+        bits &= ~channel;
+        switch (channel) {
+        case AUDIO_CHANNEL_OUT_FRONT_LEFT:
+        case AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER:
+        case AUDIO_CHANNEL_OUT_BACK_LEFT:
+        case AUDIO_CHANNEL_OUT_SIDE_LEFT:
+        case AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT:
+        case AUDIO_CHANNEL_OUT_TOP_BACK_LEFT:
+            mMatrix[0][i] = 1.f;
+            break;
+        case AUDIO_CHANNEL_OUT_FRONT_RIGHT:
+        case AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER:
+        case AUDIO_CHANNEL_OUT_BACK_RIGHT:
+        case AUDIO_CHANNEL_OUT_SIDE_RIGHT:
+        case AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT:
+        case AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT:
+            mMatrix[1][i] = 1.f;
+            break;
+        default: // center, LFE and top center channels
+            mMatrix[0][i] = kMinus3dB;
+            mMatrix[1][i] = kMinus3dB;
+            break;
+        }
+    }
+}
+
+void MatrixDownmixBufferProvider::setMatrix(const float *matrix)
+{
+    for (uint32_t i = 0; i < mInputChannels; ++i) {
+        mMatrix[0][i] = matrix[i];
+        mMatrix[1][i] = matrix[mInputChannels + i];
+    }
+}
+
+/*static*/ bool MatrixDownmixBufferProvider::isSupported(audio_channel_mask_t inputChannelMask,
+        audio_channel_mask_t outputChannelMask,
+        audio_format_t inputFormat, audio_format_t outputFormat)
+{
+    return audio_channel_mask_get_representation(inputChannelMask)
+                    == AUDIO_CHANNEL_REPRESENTATION_POSITION
+            && outputChannelMask == AUDIO_CHANNEL_OUT_STEREO
+            && audio_channel_count_from_out_mask(inputChannelMask) <= MAX_INPUT_CHANNELS
+            && (inputFormat == AUDIO_FORMAT_PCM_16_BIT || inputFormat == AUDIO_FORMAT_PCM_FLOAT)
+            && (outputFormat == AUDIO_FORMAT_PCM_16_BIT || outputFormat == AUDIO_FORMAT_PCM_FLOAT);
+}
+
+static inline float sampleToFloat(int16_t sample) { return float_from_i16(sample); }
+static inline float sampleToFloat(float sample) { return sample; }
+
+static inline void floatToSample(int16_t *dst, float value) { *dst = clamp16_from_float(value); }
+static inline void floatToSample(float *dst, float value) { *dst = value; }
+
+// Applies the 2 x CHANNELS matrix to each frame. The channel count is a template
+// parameter for the common 5.1 and 7.1 layouts (CHANNELS = 0 uses the run-time count),
+// which lets the compiler unroll and vectorize the inner loop.
+template <int CHANNELS, typename TO, typename TI>
+static void downmixMatrixChannels(TO *dst, const TI *src, size_t frames,
+        const float (*matrix)[MatrixDownmixBufferProvider::MAX_INPUT_CHANNELS],
+        uint32_t inputChannels)
+{
+    const uint32_t channels = CHANNELS != 0 ? CHANNELS : inputChannels;
+    for (; frames > 0; --frames) {
+        float left = 0.f;
+        float right = 0.f;
+        for (uint32_t i = 0; i < channels; ++i) {
+            const float sample = sampleToFloat(src[i]);
+            left += matrix[0][i] * sample;
+            right += matrix[1][i] * sample;
+        }
+        floatToSample(dst++, left);
+        floatToSample(dst++, right);
+        src += channels;
+    }
+}
+
+template <typename TO, typename TI>
+static void downmixMatrix(TO *dst, const TI *src, size_t frames,
+        const float (*matrix)[MatrixDownmixBufferProvider::MAX_INPUT_CHANNELS],
+        uint32_t inputChannels)
+{
+    switch (inputChannels) {
+    case 6:
+        downmixMatrixChannels<6>(dst, src, frames, matrix, inputChannels);
+        break;
+    case 8:
+        downmixMatrixChannels<8>(dst, src, frames, matrix, inputChannels);
+        break;
+    default:
+        downmixMatrixChannels<0>(dst, src, frames, matrix, inputChannels);
+        break;
+    }
+}
+
+void MatrixDownmixBufferProvider::copyFrames(void *dst, const void *src, size_t frames)
+{
+    if (mInputFormat == AUDIO_FORMAT_PCM_FLOAT) {
+        if (mOutputFormat == AUDIO_FORMAT_PCM_FLOAT) {
+            downmixMatrix((float *)dst, (const float *)src, frames, mMatrix, mInputChannels);
+        } else {
+            downmixMatrix((int16_t *)dst, (const float *)src, frames, mMatrix, mInputChannels);
+        }
+    } else {
+        if (mOutputFormat == AUDIO_FORMAT_PCM_FLOAT) {
+            downmixMatrix((float *)dst, (const int16_t *)src, frames, mMatrix, mInputChannels);
+        } else {
+            downmixMatrix((int16_t *)dst, (const int16_t *)src, frames, mMatrix, mInputChannels);
+        }
+    }
+}
+
 RemixBufferProvider::RemixBufferProvider(audio_channel_mask_t inputChannelMask,
         audio_channel_mask_t outputChannelMask, audio_format_t format,
         size_t bufferFrameCount) :
@@ -321,6 +470,202 @@ void ReformatBufferProvider::copyFrames(void *dst, const void *src, size_t frame
     memcpy_by_audio_format(dst, mOutputFormat, src, mInputFormat, frames * mChannelCount);
 }
 
+// WSOLA segment length and search range. 20 ms segments are long enough to hold a
+// period of low voices and short enough not to smear transients.
+static const uint32_t kWsolaWindowMs = 20;
+// The correlation search first tests every kWsolaSearchStep-th position, then refines.
+static const size_t kWsolaSearchStep = 4;
+
+/*static*/ const CONSTEXPR float WsolaStretcher::SPEED_MIN;
+/*static*/ const CONSTEXPR float WsolaStretcher::SPEED_MAX;
+
+WsolaStretcher::WsolaStretcher(uint32_t channelCount, audio_format_t format,
+        uint32_t sampleRate) :
+        mChannelCount(channelCount),
+        mFormat(format),
+        mWindowFrames(((sampleRate * kWsolaWindowMs / 1000) + 7) & ~7), // multiple of 8
+        mHopFrames(mWindowFrames / 2),
+        mSearchFrames(mWindowFrames / 4),
+        // a segment spans at most |speed - 1| hops plus the search range from the previous,
+        // see processSegment(); keep a segment of room for writes.
+        mInputCapacity(mWindowFrames * 4 + mHopFrames * (size_t)SPEED_MAX),
+        mInputFrames(0),
+        mDiscardFrames(0),
+        mOutputOffset(0),
+        mOutputFrames(0),
+        mPrevious(0),
+        mHasPrevious(false),
+        mNominal(0),
+        mSpeed(AUDIO_TIMESTRETCH_SPEED_NORMAL)
+{
+    (void)posix_memalign((void **)&mWindow, 32, mWindowFrames * sizeof(float));
+    (void)posix_memalign((void **)&mInput, 32, mInputCapacity * mChannelCount * sizeof(float));
+    (void)posix_memalign((void **)&mOverlap, 32, mWindowFrames * mChannelCount * sizeof(float));
+    (void)posix_memalign((void **)&mOutput, 32, mHopFrames * mChannelCount * sizeof(float));
+    // periodic Hann window: windows at half window hops sum to one.
+    for (size_t i = 0; i < mWindowFrames; ++i) {
+        mWindow[i] = 0.5f - 0.5f * cosf(2. * M_PI * i / mWindowFrames);
+    }
+    memset(mOverlap, 0, mWindowFrames * mChannelCount * sizeof(float));
+    // start with silence so that the first segments can be searched around input position 0.
+    mInputFrames = mSearchFrames;
+    memset(mInput, 0, mInputFrames * mChannelCount * sizeof(float));
+    mNominal = mSearchFrames;
+}
+
+WsolaStretcher::~WsolaStretcher()
+{
+    free(mWindow);
+    free(mInput);
+    free(mOverlap);
+    free(mOutput);
+}
+
+void WsolaStretcher::setSpeed(float speed)
+{
+    ALOG_ASSERT(isSpeedSupported(speed), "unsupported WSOLA speed %f", speed);
+    mSpeed = speed;
+}
+
+size_t WsolaStretcher::write(const void *src, size_t frames)
+{
+    if (mInputFrames + frames > mInputCapacity && mDiscardFrames > 0) {
+        memmove(mInput, mInput + mDiscardFrames * mChannelCount,
+                (mInputFrames - mDiscardFrames) * mChannelCount * sizeof(float));
+        mInputFrames -= mDiscardFrames;
+        mPrevious -= mDiscardFrames;
+        mNominal -= mDiscardFrames;
+        mDiscardFrames = 0;
+    }
+    frames = min(frames, mInputCapacity - mInputFrames);
+    float *dst = mInput + mInputFrames * mChannelCount;
+    if (mFormat == AUDIO_FORMAT_PCM_FLOAT) {
+        memcpy(dst, src, frames * mChannelCount * sizeof(float));
+    } else {
+        memcpy_to_float_from_i16(dst, (const int16_t *)src, frames * mChannelCount);
+    }
+    mInputFrames += frames;
+    return frames;
+}
+
+size_t WsolaStretcher::read(void *dst, size_t frames)
+{
+    size_t produced = 0;
+    while (produced < frames) {
+        if (mOutputFrames == 0) {
+            if (!canProcessSegment()) {
+                break;
+            }
+            processSegment();
+        }
+        const size_t count = min(frames - produced, mOutputFrames);
+        const float *src = mOutput + mOutputOffset * mChannelCount;
+        if (mFormat == AUDIO_FORMAT_PCM_FLOAT) {
+            memcpy((float *)dst + produced * mChannelCount, src,
+                    count * mChannelCount * sizeof(float));
+        } else {
+            memcpy_to_i16_from_float((int16_t *)dst + produced * mChannelCount, src,
+                    count * mChannelCount);
+        }
+        mOutputOffset += count;
+        mOutputFrames -= count;
+        produced += count;
+    }
+    return produced;
+}
+
+bool WsolaStretcher::canProcessSegment() const
+{
+    const size_t nominalEnd = (size_t)mNominal + mSearchFrames + mWindowFrames;
+    const size_t naturalEnd = mPrevious + mHopFrames * 2;
+    return max(nominalEnd, naturalEnd) <= mInputFrames;
+}
+
+// Dot product with four partial sums, so that the compiler can vectorize it
+// without reassociating floating point additions by itself.
+static inline float dotProduct(const float *a, const float *b, size_t count)
+{
+    float sum0 = 0.f, sum1 = 0.f, sum2 = 0.f, sum3 = 0.f;
+    for (; count >= 4; count -= 4) {
+        sum0 += a[0] * b[0];
+        sum1 += a[1] * b[1];
+        sum2 += a[2] * b[2];
+        sum3 += a[3] * b[3];
+        a += 4;
+        b += 4;
+    }
+    for (; count > 0; --count) {
+        sum0 += *a++ * *b++;
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+// Returns the input position within mSearchFrames of nominal whose first half segment
+// is most similar (normalized cross-correlation) to the half segment at natural.
+size_t WsolaStretcher::findBestSegment(size_t natural, size_t nominal) const
+{
+    const size_t samples = mHopFrames * mChannelCount;
+    const float *target = mInput + natural * mChannelCount;
+    const size_t first = nominal - mSearchFrames;
+    const size_t last = nominal + mSearchFrames;
+
+    size_t best = nominal;
+    float bestScore = -HUGE_VALF;
+    size_t coarseBest = nominal;
+    for (int pass = 0; pass < 2; ++pass) {
+        // pass 0 is a coarse search over the range, pass 1 refines around its result.
+        const size_t step = pass == 0 ? kWsolaSearchStep : 1;
+        const size_t from = pass == 0 ? first
+                : max(first, coarseBest - min(coarseBest, kWsolaSearchStep - 1));
+        const size_t to = pass == 0 ? last : min(last, coarseBest + kWsolaSearchStep - 1);
+        for (size_t candidate = from; candidate <= to; candidate += step) {
+            const float *segment = mInput + candidate * mChannelCount;
+            const float energy = dotProduct(segment, segment, samples);
+            const float correlation = dotProduct(target, segment, samples);
+            // compare correlation / sqrt(energy), keeping the sign, without a square root.
+            const float score = energy > 0.f
+                    ? correlation * fabsf(correlation) / energy : 0.f;
+            if (score > bestScore) {
+                bestScore = score;
+                best = candidate;
+            }
+        }
+        coarseBest = best;
+    }
+    return best;
+}
+
+void WsolaStretcher::processSegment()
+{
+    const size_t nominal = (size_t)mNominal;
+    const size_t segment = mHasPrevious
+            ? findBestSegment(mPrevious + mHopFrames, nominal) : nominal;
+
+    // overlap-add the windowed segment
+    const float *in = mInput + segment * mChannelCount;
+    float *overlap = mOverlap;
+    for (size_t i = 0; i < mWindowFrames; ++i) {
+        const float w = mWindow[i];
+        for (uint32_t c = 0; c < mChannelCount; ++c) {
+            *overlap++ += w * *in++;
+        }
+    }
+
+    // the first half is complete, the second half waits for the next segment.
+    const size_t hopSamples = mHopFrames * mChannelCount;
+    memcpy(mOutput, mOverlap, hopSamples * sizeof(float));
+    memcpy(mOverlap, mOverlap + hopSamples, hopSamples * sizeof(float));
+    memset(mOverlap + hopSamples, 0, hopSamples * sizeof(float));
+    mOutputOffset = 0;
+    mOutputFrames = mHopFrames;
+
+    mPrevious = segment;
+    mHasPrevious = true;
+    mNominal += mHopFrames * mSpeed;
+    // input before both the previous segment and the next search range is not needed.
+    mDiscardFrames = min(mPrevious, (size_t)mNominal - mSearchFrames);
+}
+
 TimestretchBufferProvider::TimestretchBufferProvider(int32_t channelCount,
         audio_format_t format, uint32_t sampleRate, const AudioPlaybackRate &playbackRate) :
         mChannelCount(channelCount),
@@ -331,6 +676,9 @@ TimestretchBufferProvider::TimestretchBufferProvider(int32_t channelCount,
         mLocalBufferData(NULL),
         mRemaining(0),
         mSonicStream(sonicCreateStream(sampleRate, mChannelCount)),
+        mWsola(channelCount, format, sampleRate),
+        mWsolaEnabled(property_get_bool("af.timestretch.wsola", true /* default_value */)),
+        mUseWsola(false),
         mFallbackFailErrorShown(false),
         mAudioPlaybackRateValid(false)
 {
@@ -461,6 +809,14 @@ status_t TimestretchBufferProvider::setPlaybackRate(const AudioPlaybackRate &pla
     mPlaybackRate = playbackRate;
     mFallbackFailErrorShown = false;
     sonicSetSpeed(mSonicStream, mPlaybackRate.mSpeed);
+    // WSOLA serves the default stretch mode over its speed range, sonic serves speech
+    // and the speeds beyond.
+    mUseWsola = mWsolaEnabled
+            && mPlaybackRate.mStretchMode == AUDIO_TIMESTRETCH_STRETCH_DEFAULT
+            && WsolaStretcher::isSpeedSupported(mPlaybackRate.mSpeed);
+    if (mUseWsola) {
+        mWsola.setSpeed(mPlaybackRate.mSpeed);
+    }
     //TODO: pitch is ignored for now
     //TODO: optimize: if parameters are the same, don't do any extra computation.
 
@@ -515,6 +871,9 @@ void TimestretchBufferProvider::processFrames(void *dstBuffer, size_t *dstFrames
                 break;
             }
         }
+    } else if (mUseWsola) {
+        *srcFrames = mWsola.write(srcBuffer, *srcFrames);
+        *dstFrames = mWsola.read(dstBuffer, *dstFrames);
     } else {
         switch (mFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
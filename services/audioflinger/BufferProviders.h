@@ -23,6 +23,7 @@
 #include <hardware/audio_effect.h>
 #include <media/AudioBufferProvider.h>
 #include <system/audio.h>
+#include <utils/Compat.h>
 #include <sonic.h>
 
 namespace android {
@@ -114,6 +115,38 @@ protected:
     static const int32_t SESSION_ID_INVALID_AND_IGNORED = -2;
 };
 
+// MatrixDownmixBufferProvider derives from CopyBufferProvider to fold a positional
+// multichannel input down to stereo without going through the downmix effect.
+// Each output sample is a weighted sum of the input channels, given by a 2 x N
+// coefficient matrix. The input format conversion is fused into the same pass,
+// so that the track data is read once and written once in the mixer input format.
+class MatrixDownmixBufferProvider : public CopyBufferProvider {
+public:
+    MatrixDownmixBufferProvider(audio_channel_mask_t inputChannelMask,
+            audio_format_t inputFormat, audio_format_t outputFormat,
+            size_t bufferFrameCount);
+    //Overrides
+    virtual void copyFrames(void *dst, const void *src, size_t frames);
+
+    // Replaces the default fold-down coefficients. matrix holds the left output
+    // row followed by the right output row, each with one gain per input channel.
+    void setMatrix(const float *matrix);
+
+    // true if the conversion can be done by this provider: positional input of at most
+    // MAX_INPUT_CHANNELS channels to stereo, with PCM 16 bit or float input and output.
+    static bool isSupported(audio_channel_mask_t inputChannelMask,
+            audio_channel_mask_t outputChannelMask,
+            audio_format_t inputFormat, audio_format_t outputFormat);
+
+    static const uint32_t MAX_INPUT_CHANNELS = 8;
+
+protected:
+    const audio_format_t mInputFormat;
+    const audio_format_t mOutputFormat;
+    const uint32_t       mInputChannels;
+    float                mMatrix[2][MAX_INPUT_CHANNELS];
+};
+
 // RemixBufferProvider derives from CopyBufferProvider to perform an
 // upmix or downmix to the proper channel count and mask.
 class RemixBufferProvider : public CopyBufferProvider {
@@ -147,6 +180,55 @@ protected:
     const audio_format_t mOutputFormat;
 };
 
+// WsolaStretcher changes the speed of the input without changing its pitch, by
+// waveform similarity overlap-add (WSOLA): Hann windowed segments are overlap-added
+// at a fixed output hop, each taken from the input position near the nominal one
+// whose waveform best continues the previous segment.
+// All buffers are allocated on construction; processing is done in float.
+class WsolaStretcher {
+public:
+    WsolaStretcher(uint32_t channelCount, audio_format_t format, uint32_t sampleRate);
+    ~WsolaStretcher();
+
+    // speed must satisfy isSpeedSupported().
+    void setSpeed(float speed);
+    static bool isSpeedSupported(float speed) {
+        return speed >= SPEED_MIN && speed <= SPEED_MAX;
+    }
+
+    // Copies up to frames input frames, returns the number of frames consumed.
+    size_t write(const void *src, size_t frames);
+    // Produces up to frames output frames, returns the number of frames produced.
+    size_t read(void *dst, size_t frames);
+
+    static const CONSTEXPR float SPEED_MIN = 0.25f;
+    static const CONSTEXPR float SPEED_MAX = 4.0f;
+
+private:
+    bool canProcessSegment() const;
+    void processSegment();
+    size_t findBestSegment(size_t natural, size_t nominal) const;
+
+    const uint32_t       mChannelCount;
+    const audio_format_t mFormat;
+    const size_t         mWindowFrames;   // segment length
+    const size_t         mHopFrames;      // output hop, half a segment
+    const size_t         mSearchFrames;   // max distance of a segment from its nominal position
+    const size_t         mInputCapacity;  // in frames
+    float               *mWindow;         // mWindowFrames Hann window
+    float               *mInput;          // mInputCapacity frames
+    float               *mOverlap;        // mWindowFrames frames being overlap-added
+    float               *mOutput;         // mHopFrames frames ready to be read
+    size_t               mInputFrames;    // valid frames in mInput
+    size_t               mDiscardFrames;  // frames at the start of mInput no longer needed
+    size_t               mOutputOffset;   // next frame of mOutput to read
+    size_t               mOutputFrames;   // frames of mOutput not yet read
+    size_t               mPrevious;       // input position of the last segment
+    bool                 mHasPrevious;    // false until the first segment is processed
+    double               mNominal;        // nominal input position of the next segment
+    float                mSpeed;
+};
+
 // TimestretchBufferProvider derives from PassthruBufferProvider for time stretching
 class TimestretchBufferProvider : public PassthruBufferProvider {
 public:
@@ -187,6 +269,9 @@ private:
     size_t               mRemaining;              // remaining data in local buffer
     sonicStream          mSonicStream;            // handle to sonic timestretch object
     //FIXME: this dependency should be abstracted out
+    WsolaStretcher       mWsola;                  // used instead of sonic if mUseWsola
+    const bool           mWsolaEnabled;           // from af.timestretch.wsola
+    bool                 mUseWsola;
     bool                 mFallbackFailErrorShown; // log fallback error only once
     bool                 mAudioPlaybackRateValid; // flag for current parameters validity
 };
@@ -32,6 +32,10 @@
 // uncomment to enable fast threads to take performance samples for later statistical analysis
 #define FAST_THREAD_STATISTICS
 
+// uncomment to also sample hardware performance counters (cycles, instructions, cache misses)
+// of fast threads, requires FAST_THREAD_STATISTICS and a kernel that allows perf_event_open()
+//#define PERF_COUNTER_STATISTICS
+
 // uncomment for debugging timing problems related to StateQueue::push()
 //#define STATE_QUEUE_DUMP
 
@@ -20,6 +20,7 @@
 //#define LOG_NDEBUG 0
 
 #include "Configuration.h"
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <audio_effects/effect_visualizer.h>
 #include <audio_utils/primitives.h>
@@ -46,6 +47,14 @@
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Descriptor flag of insert effects whose output does not depend on how the frames of a buffer
+// are split across process() calls, so that they can be run over sub-blocks of the buffer.
+// Takes the first flag bit unused by audio_effect.h.
+#ifndef EFFECT_FLAG_BLOCK_PROCESS_SUPPORTED
+#define EFFECT_FLAG_BLOCK_PROCESS_SUPPORTED \
+        (1 << (EFFECT_FLAG_NO_PROCESS_SHIFT + EFFECT_FLAG_NO_PROCESS_SIZE))
+#endif
+
 namespace android {
 
 // ----------------------------------------------------------------------------
@@ -70,6 +79,7 @@ AudioFlinger::EffectModule::EffectModule(ThreadBase *thread,
       // mMaxDisableWaitCnt is set by configure() and not used before then
       // mDisableWaitCnt is set by process() and updateState() and not used before then
       mSuspended(false),
+      mFloatCapable(false),
       mAudioFlinger(thread->mAudioFlinger)
 {
     ALOGV("Constructor %p pinned %d", this, pinned);
@@ -88,6 +98,7 @@ AudioFlinger::EffectModule::EffectModule(ThreadBase *thread,
     }
 
     setOffloaded(thread->type() == ThreadBase::OFFLOAD, thread->id());
+    mFloatCapable = probeFloatConfig(thread);
 
     ALOGV("Constructor success name %s, Interface %p", mDescriptor.name, mEffectInterface);
     return;
@@ -97,6 +108,43 @@ Error:
     ALOGV("Constructor Error %d", mStatus);
 }
 
+// Tells whether the effect engine can process float buffers on a mixer thread, so that the
+// thread can run its effect chains in float. The engine is configured for real by configure()
+// once added to a chain.
+bool AudioFlinger::EffectModule::probeFloatConfig(ThreadBase *thread)
+{
+    if (mEffectInterface == NULL || thread->type() != ThreadBase::MIXER ||
+            (mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) != EFFECT_FLAG_TYPE_INSERT) {
+        return false;
+    }
+    effect_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.inputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+    config.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+    config.inputCfg.format = AUDIO_FORMAT_PCM_FLOAT;
+    config.outputCfg.format = AUDIO_FORMAT_PCM_FLOAT;
+    config.inputCfg.samplingRate = thread->sampleRate();
+    config.outputCfg.samplingRate = config.inputCfg.samplingRate;
+    config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+    config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+    config.inputCfg.mask = EFFECT_CONFIG_ALL;
+    config.outputCfg.mask = EFFECT_CONFIG_ALL;
+    config.inputCfg.buffer.frameCount = thread->frameCount();
+    config.outputCfg.buffer.frameCount = config.inputCfg.buffer.frameCount;
+
+    status_t cmdStatus;
+    uint32_t size = sizeof(int);
+    status_t status = (*mEffectInterface)->command(mEffectInterface,
+                                                   EFFECT_CMD_SET_CONFIG,
+                                                   sizeof(effect_config_t),
+                                                   &config,
+                                                   &size,
+                                                   &cmdStatus);
+    ALOGV("probeFloatConfig() effect %s status %d cmdStatus %d",
+            mDescriptor.name, status, cmdStatus);
+    return status == NO_ERROR && cmdStatus == NO_ERROR;
+}
+
 AudioFlinger::EffectModule::~EffectModule()
 {
     ALOGV("Destructor %p", this);
@@ -263,16 +311,67 @@ bool AudioFlinger::EffectModule::updateState() {
     return started;
 }
 
+// accumulate sampleCount samples of in onto out; float samples are not clamped
+// as their headroom is kept until the end of the chain.
+static void accumulate(const audio_buffer_t& out, const audio_buffer_t& in,
+        size_t sampleCount, bool isFloat)
+{
+    if (isFloat) {
+        float *dst = (float *)out.raw;
+        const float *src = (const float *)in.raw;
+        for (size_t i = 0; i < sampleCount; i++) {
+            dst[i] += src[i];
+        }
+    } else {
+        int16_t *dst = out.s16;
+        const int16_t *src = in.s16;
+        for (size_t i = 0; i < sampleCount; i++) {
+            dst[i] = clamp16((int32_t)dst[i] + (int32_t)src[i]);
+        }
+    }
+}
+
 void AudioFlinger::EffectModule::process()
 {
     Mutex::Autolock _l(mLock);
+    process_l(0, mConfig.inputCfg.buffer.frameCount);
+}
+
+void AudioFlinger::EffectModule::processBlock(size_t frameOffset, size_t frameCount)
+{
+    Mutex::Autolock _l(mLock);
+    ALOG_ASSERT(supportsBlockProcessing());
+    process_l(frameOffset, frameCount);
+}
 
+bool AudioFlinger::EffectModule::supportsBlockProcessing() const
+{
+    return (mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_INSERT &&
+            (mDescriptor.flags & EFFECT_FLAG_BLOCK_PROCESS_SUPPORTED) != 0;
+}
+
+// must be called with EffectModule::mLock held
+void AudioFlinger::EffectModule::process_l(size_t frameOffset, size_t frameCount)
+{
     if (mState == DESTROYED || mEffectInterface == NULL ||
             mConfig.inputCfg.buffer.raw == NULL ||
             mConfig.outputCfg.buffer.raw == NULL) {
         return;
     }
 
+    // the frames to process; a block of the configured buffers is only requested
+    // for insert effects, whose buffers are always stereo here
+    const bool isFloat = mConfig.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT;
+    audio_buffer_t inBuffer = mConfig.inputCfg.buffer;
+    audio_buffer_t outBuffer = mConfig.outputCfg.buffer;
+    if (frameOffset != 0 || frameCount != inBuffer.frameCount) {
+        const size_t offset = frameOffset * FCC_2 * (isFloat ? sizeof(float) : sizeof(int16_t));
+        inBuffer.u8 += offset;
+        inBuffer.frameCount = frameCount;
+        outBuffer.u8 += offset;
+        outBuffer.frameCount = frameCount;
+    }
+
     if (isProcessEnabled()) {
         // do 32 bit to 16 bit conversion for auxiliary effect input buffer
         if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_AUXILIARY) {
@@ -284,21 +383,17 @@ void AudioFlinger::EffectModule::process()
         if (isProcessImplemented()) {
             // do the actual processing in the effect engine
             ret = (*mEffectInterface)->process(mEffectInterface,
-                                                   &mConfig.inputCfg.buffer,
-                                                   &mConfig.outputCfg.buffer);
+                                                   &inBuffer,
+                                                   &outBuffer);
         } else {
-            if (mConfig.inputCfg.buffer.raw != mConfig.outputCfg.buffer.raw) {
-                size_t frameCnt = mConfig.inputCfg.buffer.frameCount * FCC_2;  //always stereo here
-                int16_t *in = mConfig.inputCfg.buffer.s16;
-                int16_t *out = mConfig.outputCfg.buffer.s16;
+            if (inBuffer.raw != outBuffer.raw) {
+                size_t frameCnt = inBuffer.frameCount * FCC_2;  //always stereo here
 
                 if (mConfig.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
-                    for (size_t i = 0; i < frameCnt; i++) {
-                        out[i] = clamp16((int32_t)out[i] + (int32_t)in[i]);
-                    }
+                    accumulate(outBuffer, inBuffer, frameCnt, isFloat);
                 } else {
-                    memcpy(mConfig.outputCfg.buffer.raw, mConfig.inputCfg.buffer.raw,
-                           frameCnt * sizeof(int16_t));
+                    memcpy(outBuffer.raw, inBuffer.raw,
+                           frameCnt * (isFloat ? sizeof(float) : sizeof(int16_t)));
                 }
             }
             ret = -ENODATA;
@@ -314,17 +409,13 @@ void AudioFlinger::EffectModule::process()
                    mConfig.inputCfg.buffer.frameCount*sizeof(int32_t));
         }
     } else if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_INSERT &&
-                mConfig.inputCfg.buffer.raw != mConfig.outputCfg.buffer.raw) {
+                inBuffer.raw != outBuffer.raw) {
         // If an insert effect is idle and input buffer is different from output buffer,
         // accumulate input onto output
         sp<EffectChain> chain = mChain.promote();
         if (chain != 0 && chain->activeTrackCnt() != 0) {
-            size_t frameCnt = mConfig.inputCfg.buffer.frameCount * FCC_2;  //always stereo here
-            int16_t *in = mConfig.inputCfg.buffer.s16;
-            int16_t *out = mConfig.outputCfg.buffer.s16;
-            for (size_t i = 0; i < frameCnt; i++) {
-                out[i] = clamp16((int32_t)out[i] + (int32_t)in[i]);
-            }
+            size_t frameCnt = inBuffer.frameCount * FCC_2;  //always stereo here
+            accumulate(outBuffer, inBuffer, frameCnt, isFloat);
         }
     }
 }
@@ -343,6 +434,8 @@ status_t AudioFlinger::EffectModule::configure()
     sp<ThreadBase> thread;
     uint32_t size;
     audio_channel_mask_t channelMask;
+    audio_format_t format;
+    sp<EffectChain> chain;
 
     if (mEffectInterface == NULL) {
         status = NO_INIT;
@@ -372,8 +465,17 @@ status_t AudioFlinger::EffectModule::configure()
         }
     }
 
-    mConfig.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
-    mConfig.outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    // insert effects use the format of the chain buffers,
+    // auxiliary effects always read 16 bit samples and only live in 16 bit chains.
+    format = AUDIO_FORMAT_PCM_16_BIT;
+    if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_INSERT) {
+        chain = mChain.promote();
+        if (chain != 0) {
+            format = chain->bufferFormat();
+        }
+    }
+    mConfig.inputCfg.format = format;
+    mConfig.outputCfg.format = format;
     mConfig.inputCfg.samplingRate = thread->sampleRate();
     mConfig.outputCfg.samplingRate = mConfig.inputCfg.samplingRate;
     mConfig.inputCfg.bufferProvider.cookie = NULL;
@@ -1483,10 +1585,14 @@ void AudioFlinger::EffectHandle::dumpToBuffer(char* buffer, size_t size)
 AudioFlinger::EffectChain::EffectChain(ThreadBase *thread,
                                         audio_session_t sessionId)
     : mThread(thread), mSessionId(sessionId), mActiveTrackCnt(0), mTrackCnt(0), mTailBufferCount(0),
+      mBufferFormat(AUDIO_FORMAT_PCM_16_BIT),
       mOwnInBuffer(false), mVolumeCtrlIdx(-1), mLeftVolume(UINT_MAX), mRightVolume(UINT_MAX),
       mNewLeftVolume(UINT_MAX), mNewRightVolume(UINT_MAX)
 {
     mStrategy = AudioSystem::getStrategyForStream(AUDIO_STREAM_MUSIC);
+    const int32_t blockFrames = property_get_int32("af.effect.block_frames",
+            kDefaultBlockFrames);
+    mBlockFrames = blockFrames > 0 ? blockFrames : 0;
     if (thread == NULL) {
         return;
     }
@@ -1557,12 +1663,11 @@ void AudioFlinger::EffectChain::clearInputBuffer()
 // Must be called with EffectChain::mLock locked
 void AudioFlinger::EffectChain::clearInputBuffer_l(sp<ThreadBase> thread)
 {
-    // TODO: This will change in the future, depending on multichannel
-    // and sample format changes for effects.
+    // TODO: This will change in the future, depending on multichannel effects.
     // Currently effects processing is only available for stereo, AUDIO_FORMAT_PCM_16_BIT
-    // (4 bytes frame size)
+    // or AUDIO_FORMAT_PCM_FLOAT (4 or 8 bytes frame size)
     const size_t frameSize =
-            audio_bytes_per_sample(AUDIO_FORMAT_PCM_16_BIT) * min(FCC_2, thread->channelCount());
+            audio_bytes_per_sample(mBufferFormat) * min(FCC_2, thread->channelCount());
     memset(mInBuffer, 0, thread->frameCount() * frameSize);
 }
 
@@ -1601,8 +1706,31 @@ void AudioFlinger::EffectChain::process_l()
 
     size_t size = mEffects.size();
     if (doProcess) {
-        for (size_t i = 0; i < size; i++) {
-            mEffects[i]->process();
+        for (size_t i = 0; i < size; ) {
+            // Run consecutive effects supporting it over blocks of mBlockFrames, so that
+            // each block stays in cache from one effect to the next.
+            // Each insert effect only reads and writes the frames of its own block
+            // position in the chain buffers, so processing block by block gives the
+            // same result as processing buffer by buffer.
+            size_t end = i;
+            if (mBlockFrames > 0) {
+                while (end < size && mEffects[end]->supportsBlockProcessing()) {
+                    end++;
+                }
+            }
+            if (end - i < 2) {
+                mEffects[i]->process();
+                i++;
+                continue;
+            }
+            const size_t frameCount = thread->frameCount();
+            for (size_t offset = 0; offset < frameCount; offset += mBlockFrames) {
+                const size_t frames = min(mBlockFrames, frameCount - offset);
+                for (size_t j = i; j < end; j++) {
+                    mEffects[j]->processBlock(offset, frames);
+                }
+            }
+            i = end;
         }
     }
     bool doResetVolume = false;
@@ -2202,4 +2330,16 @@ bool AudioFlinger::EffectChain::isCompatibleWithThread_l(const sp<ThreadBase>& t
     return true;
 }
 
+// isFloatCapable_l() must be called with thread->mLock held
+bool AudioFlinger::EffectChain::isFloatCapable_l() const
+{
+    Mutex::Autolock _l(mLock);
+    for (size_t i = 0; i < mEffects.size(); i++) {
+        if (!mEffects[i]->isFloatCapable()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 } // namespace android
@@ -61,6 +61,9 @@ public:
 
     int         id() const { return mId; }
     void process();
+    // process frameCount frames from frameOffset of the configured buffers;
+    // only for effects with supportsBlockProcessing()
+    void processBlock(size_t frameOffset, size_t frameCount);
     bool updateState();
     status_t command(uint32_t cmdCode,
                      uint32_t cmdSize,
@@ -123,6 +126,10 @@ public:
                         { return (mDescriptor.flags & EFFECT_FLAG_HW_ACC_MASK) == 0; }
     bool             isProcessImplemented() const
                         { return (mDescriptor.flags & EFFECT_FLAG_NO_PROCESS) == 0; }
+    // true for insert effects declaring EFFECT_FLAG_BLOCK_PROCESS_SUPPORTED
+    bool             supportsBlockProcessing() const;
+    // true for insert effects whose engine accepted a float configuration at creation
+    bool             isFloatCapable() const { return mFloatCapable; }
     status_t         setOffloaded(bool offloaded, audio_io_handle_t io);
     bool             isOffloaded() const;
     void             addEffectToHal_l();
@@ -142,7 +149,9 @@ protected:
 
     status_t start_l();
     status_t stop_l();
+    void process_l(size_t frameOffset, size_t frameCount);
     status_t remove_effect_from_hal_l();
+    bool probeFloatConfig(ThreadBase *thread);
 
 mutable Mutex               mLock;      // mutex for process, commands and handles list protection
     wp<ThreadBase>      mThread;    // parent thread
@@ -161,6 +170,7 @@ mutable Mutex               mLock;      // mutex for process, commands and handl
     uint32_t mDisableWaitCnt;       // current process() calls count during disable period.
     bool     mSuspended;            // effect is suspended: temporarily disabled by framework
     bool     mOffloaded;            // effect is currently offloaded to the audio DSP
+    bool     mFloatCapable;         // engine accepts AUDIO_FORMAT_PCM_FLOAT buffers
     wp<AudioFlinger>    mAudioFlinger;
 };
 
@@ -267,6 +277,9 @@ public:
     // minimum duration during which we force calling effect process when last track on
     // a session is stopped or removed to allow effect tail to be rendered
     static const int        kProcessTailDurationMs = 1000;
+    // default frames per block for effects supporting block processing,
+    // overridden by property af.effect.block_frames
+    static const int32_t    kDefaultBlockFrames = 64;
 
     void process_l();
 
@@ -313,6 +326,14 @@ public:
     int16_t *outBuffer() const {
         return mOutBuffer;
     }
+    // sample format of the chain input and output buffers, set by the thread
+    // before any effect is added: AUDIO_FORMAT_PCM_16_BIT or AUDIO_FORMAT_PCM_FLOAT
+    void setBufferFormat(audio_format_t format) {
+        mBufferFormat = format;
+    }
+    audio_format_t bufferFormat() const {
+        return mBufferFormat;
+    }
 
     void incTrackCnt() { android_atomic_inc(&mTrackCnt); }
     void decTrackCnt() { android_atomic_dec(&mTrackCnt); }
@@ -358,6 +379,10 @@ public:
     // isCompatibleWithThread_l() must be called with thread->mLock held
     bool isCompatibleWithThread_l(const sp<ThreadBase>& thread) const;
 
+    // true if all effects in the chain can process float buffers.
+    // Must be called with thread->mLock held
+    bool isFloatCapable_l() const;
+
     void dump(int fd, const Vector<String16>& args);
 
 protected:
@@ -395,6 +420,7 @@ protected:
              audio_session_t mSessionId; // audio session ID
              int16_t *mInBuffer;         // chain input buffer
              int16_t *mOutBuffer;        // chain output buffer
+             audio_format_t mBufferFormat; // format of mInBuffer and mOutBuffer
 
     // 'volatile' here means these are accessed with atomic operations instead of mutex
     volatile int32_t mActiveTrackCnt;    // number of active tracks connected
@@ -402,6 +428,8 @@ protected:
 
              int32_t mTailBufferCount;   // current effect tail buffer count
              int32_t mMaxTailBuffers;    // maximum effect tail buffers
+             size_t mBlockFrames;        // frames per block when running consecutive
+                                         // block processing effects, 0 to disable
              bool mOwnInBuffer;          // true if the chain owns its input buffer
              int mVolumeCtrlIdx;         // index of insert effect having control over volume
              uint32_t mLeftVolume;       // previous volume on left channel
@@ -48,6 +48,10 @@ void FastCaptureDumpState::dump(int fd) const
                 FastCaptureState::commandToString(mCommand), mReadSequence, mFramesRead,
                 mReadErrors, mSampleRate, mFrameCount, measuredWarmupMs, mWarmupCycles,
                 periodSec * 1e3);
+    mWakeupLatency.dump(fd);
+#ifdef PERF_COUNTER_STATISTICS
+    dumpPerfCounters(fd);
+#endif
 }
 
 }   // android
@@ -63,6 +63,7 @@ FastMixer::FastMixer() : FastThread("cycle_ms", "load_us"),
     mSampleRate(0),
     mFastTracksGen(0),
     mTotalNativeFramesWritten(0),
+    mWriteUsHistogram("write_us"),
     // timestamp
     mNativeFramesWrittenButNotPresented(0),   // the = 0 is to silence the compiler
     mMasterMono(false)
@@ -452,7 +453,9 @@ void FastMixer::onWork()
         //       but this code should be modified to handle both non-blocking and blocking sinks
         dumpState->mWriteSequence++;
         ATRACE_BEGIN("write");
+        const nsecs_t writeStartNs = systemTime();
         ssize_t framesWritten = mOutputSink->write(buffer, frameCount);
+        mWriteUsHistogram.add(mLogWriter, (systemTime() - writeStartNs) / 1000);
         ATRACE_END();
         dumpState->mWriteSequence++;
         if (framesWritten >= 0) {
@@ -81,6 +81,7 @@ private:
     int             mFastTracksGen;
     FastMixerDumpState mDummyFastMixerDumpState;
     int64_t         mTotalNativeFramesWritten;  // copied to dumpState->mFramesWritten
+    HistogramBatch  mWriteUsHistogram;  // duration of mOutputSink->write() in us
 
     // next 2 fields are valid only when timestampStatus == NO_ERROR
     ExtendedTimestamp mTimestamp;
@@ -73,6 +73,7 @@ void FastMixerDumpState::dump(int fd) const
                 mNumTracks, mWriteErrors, mUnderruns, mOverruns,
                 mSampleRate, mFrameCount, measuredWarmupMs, mWarmupCycles,
                 mixPeriodSec * 1e3);
+    mWakeupLatency.dump(fd);
 #ifdef FAST_THREAD_STATISTICS
     // find the interval of valid samples
     uint32_t bounds = mBounds;
@@ -133,6 +134,9 @@ void FastMixerDumpState::dump(int fd) const
     } else {
         dprintf(fd, "  No FastMixer statistics available currently\n");
     }
+#ifdef PERF_COUNTER_STATISTICS
+    dumpPerfCounters(fd);
+#endif
 #ifdef CPU_FREQUENCY_STATISTICS
     dprintf(fd, "  CPU clock frequency in MHz:\n"
                 "    mean=%.0f min=%.0f max=%.0f stddev=%.0f\n",
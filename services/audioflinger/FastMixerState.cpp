@@ -50,6 +50,9 @@ unsigned FastMixerState::sMaxFastTracks = kDefaultFastTracks;
 // static
 pthread_once_t FastMixerState::sMaxFastTracksOnce = PTHREAD_ONCE_INIT;
 
+// static
+unsigned FastMixerState::sMaxFastSubmixTracks = 0;
+
 // static
 const char *FastMixerState::commandToString(Command command)
 {
@@ -77,6 +80,16 @@ void FastMixerState::sMaxFastTracksInit()
         }
     }
     ALOGI("sMaxFastTracks = %u", sMaxFastTracks);
+    if (property_get("ro.audio.max_fast_submix_tracks", value, NULL) > 0) {
+        char *endptr;
+        unsigned long ul = strtoul(value, &endptr, 0);
+        // the submix occupies a primary slot, so at least one other slot must remain
+        if (*endptr == '\0' && kMinFastTracks <= ul && ul <= sMaxFastTracks &&
+                sMaxFastTracks > kMinFastTracks) {
+            sMaxFastSubmixTracks = (unsigned) ul;
+        }
+    }
+    ALOGI("sMaxFastSubmixTracks = %u", sMaxFastSubmixTracks);
 }
 
 }   // namespace android
@@ -62,6 +62,15 @@ struct FastMixerState : FastThreadState {
     static unsigned sMaxFastTracks;             // Configured maximum number of fast tracks
     static pthread_once_t sMaxFastTracksOnce;   // Protects initializer for sMaxFastTracks
 
+    // Configured number of additional fast tracks pre-mixed by a second fast mixer stage,
+    // whose submix is then a single fast track of the primary fast mixer.
+    // 0 if there is no submix stage, otherwise at most sMaxFastTracks.
+    static unsigned sMaxFastSubmixTracks;
+
+    // Fast track indices at or above this value designate slot (index - kSubmixFastIndexBase)
+    // of the submix stage rather than a slot of the primary fast mixer.
+    static const unsigned kSubmixFastIndexBase = kMaxFastTracks;
+
     // all pointer fields use raw pointers; objects are owned and ref-counted by the normal mixer
     FastTrack   mFastTracks[kMaxFastTracks];
     int         mFastTracksGen; // increment when any mFastTracks[i].mGeneration is incremented
@@ -83,7 +92,7 @@ struct FastMixerState : FastThreadState {
     // never returns NULL; asserts if command is invalid
     static const char *commandToString(Command command);
 
-    // initialize sMaxFastTracks
+    // initialize sMaxFastTracks and sMaxFastSubmixTracks
     static void sMaxFastTracksInit();
 
 };  // struct FastMixerState
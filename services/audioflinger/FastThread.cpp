@@ -57,6 +57,12 @@ FastThread::FastThread(const char *cycleMs, const char *loadUs) : Thread(false /
     mBounds(0),
     mFull(false),
     // mTcu
+#ifdef PERF_COUNTER_STATISTICS
+    // mPerfCounters
+    mOldPerfValid(false),
+#endif
+    mCycleUsHistogram("cycle_us"),
+    mLoadUsHistogram("load_us"),
 #endif
     mColdGen(0),
     mIsWarm(false),
@@ -89,6 +95,11 @@ FastThread::~FastThread()
 
 bool FastThread::threadLoop()
 {
+#ifdef PERF_COUNTER_STATISTICS
+    if (!mPerfCounters.open()) {
+        ALOGW("hardware performance counters are not available");
+    }
+#endif
     for (;;) {
 
         // either nanosleep, sched_yield, or busy wait
@@ -96,7 +107,10 @@ bool FastThread::threadLoop()
             if (mSleepNs > 0) {
                 ALOG_ASSERT(mSleepNs < 1000000000);
                 const struct timespec req = {0, mSleepNs};
-                nanosleep(&req, NULL);
+                const nsecs_t sleepStartNs = systemTime();
+                if (nanosleep(&req, NULL) == 0) {
+                    mDumpState->mWakeupLatency.add(systemTime() - sleepStartNs - mSleepNs);
+                }
             } else {
                 sched_yield();
             }
@@ -136,6 +150,9 @@ bool FastThread::threadLoop()
                     mOldTsValid = false;
 #ifdef FAST_THREAD_STATISTICS
                     mOldLoadValid = false;
+#endif
+#ifdef PERF_COUNTER_STATISTICS
+                    mOldPerfValid = false;
 #endif
                     mIgnoreNextOverrun = true;
                 }
@@ -323,6 +340,20 @@ bool FastThread::threadLoop()
                         }
                         mOldLoad = newLoad;
                     }
+#ifdef PERF_COUNTER_STATISTICS
+                    // hardware counter deltas over the same cycle, 0 if unknown
+                    uint32_t perfCounts[ThreadPerfCounters::kNumCounters] = { };
+                    uint64_t perfDeltas[ThreadPerfCounters::kNumCounters];
+                    if (mPerfCounters.sample(perfDeltas)) {
+                        if (mOldPerfValid) {
+                            for (int c = 0; c < ThreadPerfCounters::kNumCounters; ++c) {
+                                perfCounts[c] = perfDeltas[c] > UINT32_MAX ? UINT32_MAX :
+                                        (uint32_t) perfDeltas[c];
+                            }
+                        }
+                        mOldPerfValid = true;
+                    }
+#endif
 #ifdef CPU_FREQUENCY_STATISTICS
                     // get the absolute value of CPU clock frequency in kHz
                     int cpuNum = sched_getcpu();
@@ -336,12 +367,19 @@ bool FastThread::threadLoop()
                     mDumpState->mLoadNs[i] = loadNs;
 #ifdef CPU_FREQUENCY_STATISTICS
                     mDumpState->mCpukHz[i] = kHz;
+#endif
+#ifdef PERF_COUNTER_STATISTICS
+                    for (int c = 0; c < ThreadPerfCounters::kNumCounters; ++c) {
+                        mDumpState->mPerfCounts[c][i] = perfCounts[c];
+                    }
 #endif
                     // this store #4 is not atomic with respect to stores #1, #2, #3 above, but
                     // the newest open & oldest closed halves are atomic with respect to each other
                     mDumpState->mBounds = mBounds;
                     ATRACE_INT(mCycleMs, monotonicNs / 1000000);
                     ATRACE_INT(mLoadUs, loadNs / 1000);
+                    mCycleUsHistogram.add(mLogWriter, monotonicNs / 1000);
+                    mLoadUsHistogram.add(mLogWriter, loadNs / 1000);
                 }
 #endif
             } else {
@@ -21,6 +21,9 @@
 #ifdef CPU_FREQUENCY_STATISTICS
 #include <cpustats/ThreadCpuUsage.h>
 #endif
+#ifdef PERF_COUNTER_STATISTICS
+#include <cpustats/ThreadPerfCounters.h>
+#endif
 #include <utils/Thread.h>
 #include "FastThreadState.h"
 
@@ -48,6 +51,23 @@ protected:
     virtual void onStateChange() = 0;
     virtual void onWork() = 0;
 
+    // Values of one measurement, batched for NBLog::Writer::logHistogram()
+    class HistogramBatch {
+    public:
+        explicit HistogramBatch(const char *name) : mName(name), mCount(0) { }
+        void add(NBLog::Writer *logWriter, int32_t value) {
+            mValues[mCount++] = value;
+            if (mCount == NBLog::Writer::kMaxHistogramValues) {
+                logWriter->logHistogram(mName, mValues, mCount);
+                mCount = 0;
+            }
+        }
+    private:
+        const char * const  mName;
+        size_t              mCount;
+        int32_t             mValues[NBLog::Writer::kMaxHistogramValues];
+    };
+
     // FIXME these former local variables need comments
     const FastThreadState*  mPrevious;
     const FastThreadState*  mCurrent;
@@ -74,6 +94,12 @@ protected:
 #ifdef CPU_FREQUENCY_STATISTICS
     ThreadCpuUsage  mTcu;           // for reading the current CPU clock frequency in kHz
 #endif
+#ifdef PERF_COUNTER_STATISTICS
+    ThreadPerfCounters mPerfCounters;   // opened by threadLoop() for the fast thread itself
+    bool            mOldPerfValid;  // whether mPerfCounters has a previous sample in this cycle
+#endif
+    HistogramBatch  mCycleUsHistogram;  // cycle time in us, aggregated by media.log
+    HistogramBatch  mLoadUsHistogram;   // CPU load in us
 #endif
     unsigned        mColdGen;       // last observed mColdGen
     bool            mIsWarm;        // true means ready to mix,
@@ -14,6 +14,10 @@
  * limitations under the License.
  */
 
+#include "Configuration.h"
+#ifdef PERF_COUNTER_STATISTICS
+#include <cpustats/CentralTendencyStatistics.h>
+#endif
 #include "FastThreadDumpState.h"
 
 namespace android {
@@ -50,9 +54,54 @@ void FastThreadDumpState::increaseSamplingN(uint32_t samplingN)
     memset(&mLoadNs[mSamplingN], 0, sizeof(mLoadNs[0]) * additional);
 #ifdef CPU_FREQUENCY_STATISTICS
     memset(&mCpukHz[mSamplingN], 0, sizeof(mCpukHz[0]) * additional);
+#endif
+#ifdef PERF_COUNTER_STATISTICS
+    for (int c = 0; c < ThreadPerfCounters::kNumCounters; ++c) {
+        memset(&mPerfCounts[c][mSamplingN], 0, sizeof(mPerfCounts[c][0]) * additional);
+    }
 #endif
     mSamplingN = samplingN;
 }
 #endif
 
+#ifdef PERF_COUNTER_STATISTICS
+void FastThreadDumpState::dumpPerfCounters(int fd) const
+{
+    // find the interval of valid samples, as for the timing statistics
+    uint32_t bounds = mBounds;
+    uint32_t oldestClosed = bounds >> 16;
+    uint32_t n = ((bounds & 0xFFFF) - oldestClosed) & 0xFFFF;
+    if (n > mSamplingN) {
+        n = mSamplingN;
+    }
+    CentralTendencyStatistics counts[ThreadPerfCounters::kNumCounters], ipc;
+    for (uint32_t j = 0; j < n; ++j) {
+        size_t i = oldestClosed++ & (mSamplingN - 1);
+        const uint32_t cycles = mPerfCounts[ThreadPerfCounters::CYCLES][i];
+        if (cycles == 0) {
+            continue;   // counters were not available for this cycle
+        }
+        for (int c = 0; c < ThreadPerfCounters::kNumCounters; ++c) {
+            counts[c].sample(mPerfCounts[c][i]);
+        }
+        ipc.sample((double) mPerfCounts[ThreadPerfCounters::INSTRUCTIONS][i] / cycles);
+    }
+    if (counts[ThreadPerfCounters::CYCLES].n() == 0) {
+        dprintf(fd, "  No hardware performance counter statistics available\n");
+        return;
+    }
+    dprintf(fd, "  Hardware performance counters in thousands per loop cycle, over %u cycles:\n",
+            counts[ThreadPerfCounters::CYCLES].n());
+    for (int c = 0; c < ThreadPerfCounters::kNumCounters; ++c) {
+        const CentralTendencyStatistics& stats = counts[c];
+        dprintf(fd, "    %-12s mean=%.1f min=%.1f max=%.1f stddev=%.1f\n",
+                ThreadPerfCounters::counterToString((ThreadPerfCounters::Counter) c),
+                stats.mean()*1e-3, stats.minimum()*1e-3, stats.maximum()*1e-3,
+                stats.stddev()*1e-3);
+    }
+    dprintf(fd, "    instructions per CPU cycle: mean=%.2f min=%.2f max=%.2f stddev=%.2f\n",
+            ipc.mean(), ipc.minimum(), ipc.maximum(), ipc.stddev());
+}
+#endif
+
 }   // android
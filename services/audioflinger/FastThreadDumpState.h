@@ -19,6 +19,10 @@
 
 #include "Configuration.h"
 #include "FastThreadState.h"
+#include "AudioWatchdog.h"
+#ifdef PERF_COUNTER_STATISTICS
+#include <cpustats/ThreadPerfCounters.h>
+#endif
 
 namespace android {
 
@@ -37,6 +41,7 @@ struct FastThreadDumpState {
     uint32_t mOverruns;         // total number of overruns
     struct timespec mMeasuredWarmupTs;  // measured warmup time
     uint32_t mWarmupCycles;     // number of loop cycles required to warmup
+    WakeupLatencyDump mWakeupLatency;   // of the nanosleep() between cycles
 
 #ifdef FAST_THREAD_STATISTICS
     // Recently collected samples of per-cycle monotonic time, thread CPU time, and CPU frequency.
@@ -60,11 +65,20 @@ struct FastThreadDumpState {
 #ifdef CPU_FREQUENCY_STATISTICS
     uint32_t mCpukHz[kSamplingN];       // absolute CPU clock frequency in kHz, bits 0-3 are CPU#
 #endif
+#ifdef PERF_COUNTER_STATISTICS
+    // delta hardware counts per cycle, indexed by ThreadPerfCounters::Counter, 0 if unknown
+    uint32_t mPerfCounts[ThreadPerfCounters::kNumCounters][kSamplingN];
+#endif
 
     // Increase sampling window after construction, must be a power of 2 <= kSamplingN
     void    increaseSamplingN(uint32_t samplingN);
 #endif
 
+#ifdef PERF_COUNTER_STATISTICS
+    // Dump the per-cycle statistics of mPerfCounts, including instructions per cycle
+    void    dumpPerfCounters(int fd) const;
+#endif
+
 };  // struct FastThreadDumpState
 
 }   // android
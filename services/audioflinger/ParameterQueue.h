@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_PARAMETER_QUEUE_H
+#define ANDROID_AUDIO_PARAMETER_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// ParameterQueue is a bounded multiple producer, single consumer FIFO of small values,
+// used by binder threads to post parameter changes to a playback thread without taking
+// the thread lock.  Producers never block: push() fails when the queue is full.
+// The single consumer is whoever holds the thread lock; a value whose producer was
+// preempted in the middle of push() is seen on a later pop().
+// T must be trivially copyable, kCapacity a power of 2.
+template<typename T, size_t kCapacity>
+class ParameterQueue {
+public:
+    ParameterQueue() : mHead(0), mTail(0) {
+        for (size_t i = 0; i < kCapacity; ++i) {
+            mCells[i].mSequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Any thread.  Returns false if the queue is full.
+    bool push(const T& value) {
+        size_t pos = mTail.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &mCells[pos & (kCapacity - 1)];
+            const size_t sequence = cell->mSequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+            if (diff == 0) {
+                // cell is free at this position, claim it
+                if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;   // full
+            } else {
+                pos = mTail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->mValue = value;
+        cell->mSequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Single consumer only.  Returns false if there is no value ready.
+    bool pop(T& value) {
+        const size_t pos = mHead;
+        Cell *cell = &mCells[pos & (kCapacity - 1)];
+        const size_t sequence = cell->mSequence.load(std::memory_order_acquire);
+        if ((intptr_t) sequence - (intptr_t) (pos + 1) < 0) {
+            return false;
+        }
+        value = cell->mValue;
+        cell->mSequence.store(pos + kCapacity, std::memory_order_release);
+        mHead = pos + 1;
+        return true;
+    }
+
+private:
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "kCapacity must be a power of 2");
+
+    struct Cell {
+        std::atomic<size_t> mSequence;
+        T                   mValue;
+    };
+
+    Cell                mCells[kCapacity];
+    size_t              mHead;      // accessed by consumer only
+    std::atomic<size_t> mTail;
+};
+
+// SeqlockValue publishes a value from a single writer to any number of readers.
+// Neither side ever blocks; a reader that keeps racing with the writer gives up.
+// T must be trivially copyable.
+template<typename T>
+class SeqlockValue {
+public:
+    SeqlockValue() : mSequence(0), mValue() { }
+
+    // Writer only.
+    void publish(const T& value) {
+        const uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+        mSequence.store(sequence + 1, std::memory_order_relaxed);   // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        mValue = value;
+        mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Any thread.  Returns false if nothing was published yet,
+    // or if no consistent copy could be made.
+    bool read(T& value) const {
+        static const int kMaxTries = 5;
+        for (int tries = 0; tries < kMaxTries; ++tries) {
+            const uint32_t before = mSequence.load(std::memory_order_acquire);
+            if (before == 0) {
+                return false;
+            }
+            if (before & 1) {
+                continue;
+            }
+            T temp = mValue;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mSequence.load(std::memory_order_relaxed) == before) {
+                value = temp;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::atomic<uint32_t>   mSequence;
+    T                       mValue;
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_PARAMETER_QUEUE_H
@@ -21,6 +21,7 @@
 
 #include "Configuration.h"
 #include <utils/Log.h>
+#include <cutils/properties.h>
 #include <audio_utils/primitives.h>
 
 #include "AudioFlinger.h"
@@ -454,8 +455,6 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
         shift = playbackShift;
     }
     size_t frameCount = (playbackFrameCount * recordFramecount) >> shift;
-    ALOGV("createPatchConnections() playframeCount %zu recordFramecount %zu frameCount %zu",
-          playbackFrameCount, recordFramecount, frameCount);
 
     // create a special record track to capture from record thread
     uint32_t channelCount = patch->mPlaybackThread->channelCount();
@@ -464,6 +463,25 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
     uint32_t sampleRate = patch->mPlaybackThread->sampleRate();
     audio_format_t format = patch->mPlaybackThread->format();
 
+    // The pseudo LCM can be several hundred ms when the periods are not powers of 2.
+    // An explicit latency target replaces it, but never below two periods of the slower
+    // thread, expressed at the patch sample rate, so that neither side starves the other.
+    const int32_t latencyMs = property_get_int32("af.patch.latency_ms", 0 /* default_value */);
+    if (latencyMs > 0) {
+        const uint32_t recordSampleRate = patch->mRecordThread->sampleRate();
+        const size_t recordFramesAtPatchRate =
+                ((uint64_t)recordFramecount * sampleRate + recordSampleRate - 1)
+                        / recordSampleRate;
+        const size_t minFrameCount = 2 * (playbackFrameCount > recordFramesAtPatchRate ?
+                playbackFrameCount : recordFramesAtPatchRate);
+        frameCount = ((size_t)latencyMs * sampleRate) / 1000;
+        if (frameCount < minFrameCount) {
+            frameCount = minFrameCount;
+        }
+    }
+    ALOGV("createPatchConnections() playframeCount %zu recordFramecount %zu frameCount %zu",
+          playbackFrameCount, recordFramecount, frameCount);
+
     patch->mPatchRecord = new RecordThread::PatchRecord(
                                              patch->mRecordThread.get(),
                                              sampleRate,
@@ -106,6 +106,9 @@ protected:
     void resumeAck();
     void updateTrackFrameInfo(int64_t trackFramesReleased, int64_t sinkFramesWritten,
             const ExtendedTimestamp &timeStamp);
+    // for offloaded and direct tracks, whose client reads the HAL position
+    // as LOCATION_KERNEL of the extended timestamp in the control block
+    void publishTimestamp(const AudioTimestamp &timestamp);
 
     sp<IMemory> sharedBuffer() const { return mSharedBuffer; }
 
@@ -158,6 +161,8 @@ private:
                                     // either mFastIndex == -1 if not isFastTrack()
                                     // or 0 < mFastIndex < FastMixerState::kMaxFast because
                                     // index 0 is reserved for normal mixer's submix;
+                                    // indices from FastMixerState::kSubmixFastIndexBase
+                                    // designate slots of the fast submix stage, if any;
                                     // index is allocated statically at track creation time
                                     // but the slot is only used if track is active
     FastTrackUnderruns  mObservedUnderruns; // Most recently observed value of
@@ -195,8 +200,11 @@ public:
                                     AudioSystem::SYNC_EVENT_NONE,
                              audio_session_t triggerSession = AUDIO_SESSION_NONE);
     virtual void        stop();
-            bool        write(void* data, uint32_t frames);
+            // With dropOnOverrun, frames that do not fit in the track buffer within the wait
+            // time are discarded instead of being copied to an overflow buffer for later.
+            bool        write(void* data, uint32_t frames, bool dropOnOverrun = false);
             bool        bufferQueueEmpty() const { return mBufferQueue.size() == 0; }
+            uint64_t    framesDropped() const { return mFramesDropped; }
             bool        isActive() const { return mActive; }
     const wp<ThreadBase>& thread() const { return mThread; }
 
@@ -216,6 +224,7 @@ private:
     bool                        mActive;
     DuplicatingThread* const mSourceThread; // for waitTimeMs() in write()
     AudioTrackClientProxy*      mClientProxy;
+    uint64_t                    mFramesDropped;     // by write() with dropOnOverrun
 };  // end of OutputTrack
 
 // playback track, used by PatchPanel
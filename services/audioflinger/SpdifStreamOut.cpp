@@ -17,6 +17,9 @@
 
 #define LOG_TAG "AudioFlinger"
 //#define LOG_NDEBUG 0
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/properties.h>
 #include <hardware/audio.h>
 #include <utils/Log.h>
 
@@ -28,6 +31,12 @@
 
 namespace android {
 
+static uint32_t burstsPerWrite()
+{
+    int32_t bursts = property_get_int32("af.spdif.bursts_per_write", 1 /* default_value */);
+    return bursts > 1 ? bursts : 1;
+}
+
 /**
  * If the AudioFlinger is processing encoded data and the HAL expects
  * PCM then we need to wrap the data in an SPDIF wrapper.
@@ -41,9 +50,19 @@ SpdifStreamOut::SpdifStreamOut(AudioHwDevice *dev,
         , mApplicationFormat(AUDIO_FORMAT_DEFAULT)
         , mApplicationSampleRate(0)
         , mApplicationChannelMask(0)
+        , mBurstsPerWrite(burstsPerWrite())
+        , mBatchBuffer(NULL)
+        , mBatchCapacity(0)
+        , mBatchSize(0)
+        , mBatchBursts(0)
 {
 }
 
+SpdifStreamOut::~SpdifStreamOut()
+{
+    free(mBatchBuffer);
+}
+
 status_t SpdifStreamOut::open(
                               audio_io_handle_t handle,
                               audio_devices_t devices,
@@ -105,18 +124,71 @@ status_t SpdifStreamOut::open(
 int SpdifStreamOut::flush()
 {
     mSpdifEncoder.reset();
+    mBatchSize = 0;
+    mBatchBursts = 0;
     return AudioStreamOut::flush();
 }
 
 int SpdifStreamOut::standby()
 {
     mSpdifEncoder.reset();
+    // play out what was already accepted
+    (void) flushBatch();
     return AudioStreamOut::standby();
 }
 
 ssize_t SpdifStreamOut::writeDataBurst(const void* buffer, size_t bytes)
 {
-    return AudioStreamOut::write(buffer, bytes);
+    if (mBurstsPerWrite <= 1) {
+        return AudioStreamOut::write(buffer, bytes);
+    }
+    if (mBatchSize + bytes > mBatchCapacity) {
+        // bursts of a stream are usually the same size, so this settles after the first batch
+        size_t capacity = mBatchSize + bytes * (mBurstsPerWrite - mBatchBursts);
+        uint8_t *batchBuffer = (uint8_t *) realloc(mBatchBuffer, capacity);
+        if (batchBuffer == NULL) {
+            ssize_t status = flushBatch();
+            return status < 0 ? status : AudioStreamOut::write(buffer, bytes);
+        }
+        mBatchBuffer = batchBuffer;
+        mBatchCapacity = capacity;
+    }
+    memcpy(mBatchBuffer + mBatchSize, buffer, bytes);
+    mBatchSize += bytes;
+    if (++mBatchBursts >= mBurstsPerWrite) {
+        ssize_t status = flushBatch();
+        if (status < 0) {
+            return status;
+        }
+    }
+    return bytes;
+}
+
+ssize_t SpdifStreamOut::writeFully(const void* buffer, size_t bytes)
+{
+    size_t written = 0;
+    while (written < bytes) {
+        ssize_t ret = AudioStreamOut::write((const uint8_t *) buffer + written, bytes - written);
+        if (ret <= 0) {
+            return written > 0 ? (ssize_t) written : ret;
+        }
+        written += ret;
+    }
+    return written;
+}
+
+ssize_t SpdifStreamOut::flushBatch()
+{
+    if (mBatchSize == 0) {
+        return 0;
+    }
+    ssize_t ret = writeFully(mBatchBuffer, mBatchSize);
+    if (ret < (ssize_t) mBatchSize) {
+        ALOGW("SpdifStreamOut::flushBatch() wrote %zd of %zu bytes", ret, mBatchSize);
+    }
+    mBatchSize = 0;
+    mBatchBursts = 0;
+    return ret;
 }
 
 ssize_t SpdifStreamOut::write(const void* buffer, size_t numBytes)
@@ -41,7 +41,7 @@ public:
     SpdifStreamOut(AudioHwDevice *dev, audio_output_flags_t flags,
             audio_format_t format);
 
-    virtual ~SpdifStreamOut() { }
+    virtual ~SpdifStreamOut();
 
     virtual status_t open(
             audio_io_handle_t handle,
@@ -113,8 +113,19 @@ private:
     uint32_t             mApplicationSampleRate;
     audio_channel_mask_t mApplicationChannelMask;
 
+    // Data bursts are collected and written to the HAL mBurstsPerWrite at a time,
+    // so that the HAL write blocks, and the thread wakes up, once per batch.
+    const uint32_t       mBurstsPerWrite;   // 1 writes each burst as soon as it is packed
+    uint8_t             *mBatchBuffer;
+    size_t               mBatchCapacity;    // bytes allocated for mBatchBuffer
+    size_t               mBatchSize;        // bytes of mBatchBuffer in use
+    uint32_t             mBatchBursts;      // bursts in mBatchBuffer
+
     ssize_t  writeDataBurst(const void* data, size_t bytes);
     ssize_t  writeInternal(const void* buffer, size_t bytes);
+    // Write all of buffer to the HAL, returns bytes or a negative status_t
+    ssize_t  writeFully(const void* buffer, size_t bytes);
+    ssize_t  flushBatch();
 
 };
 
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ThreadCycleStats"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <string.h>
+#include <utils/Log.h>
+#include "ThreadCycleStats.h"
+
+namespace android {
+
+ThreadCycleStats::ThreadCycleStats()
+    : mCycleStartNs(0), mPeriodNs(0), mDeadlineMisses(0)
+{
+    memset(mStages, 0, sizeof(mStages));
+    reset(mLastCycleNs);
+}
+
+// static
+void ThreadCycleStats::reset(nsecs_t (&cycleNs)[STAGE_CNT])
+{
+    for (int i = 0; i < STAGE_CNT; ++i) {
+        cycleNs[i] = 0;
+    }
+}
+
+void ThreadCycleStats::addStage(Stage stage, nsecs_t durationNs)
+{
+    ALOG_ASSERT(0 <= stage && stage < STAGE_CNT);
+    if (durationNs < 0) {
+        durationNs = 0;
+    }
+    mLastCycleNs[stage] += durationNs;
+
+    StageStats *stats = &mStages[stage];
+    const uint64_t us = durationNs / 1000;
+    uint32_t bucket = 0;
+    while (bucket < kBuckets - 1 && us >= ((uint64_t) kFirstBucketUs << bucket)) {
+        ++bucket;
+    }
+    stats->mBuckets[bucket]++;
+    stats->mCount++;
+    stats->mTotalNs += durationNs;
+    if (durationNs > stats->mMaxNs) {
+        stats->mMaxNs = durationNs;
+    }
+}
+
+bool ThreadCycleStats::endCycle()
+{
+    const nsecs_t cycleNs = systemTime() - mCycleStartNs;
+    addStage(STAGE_LOOP, cycleNs);
+    if (mPeriodNs > 0 && cycleNs * 100 > mPeriodNs * kDeadlineMissPercent) {
+        mDeadlineMisses++;
+        return true;
+    }
+    return false;
+}
+
+void ThreadCycleStats::dump(int fd) const
+{
+    const uint32_t cycles = mStages[STAGE_LOOP].mCount;
+    dprintf(fd, "  Cycle times: %u cycles, period %lld us, %u deadline misses\n",
+            cycles, (long long) (mPeriodNs / 1000), mDeadlineMisses);
+    if (cycles == 0) {
+        return;
+    }
+    dprintf(fd, "    stage  mean(us)   max(us)  histogram (buckets below %u us << i)\n",
+            kFirstBucketUs);
+    for (int i = 0; i < STAGE_CNT; ++i) {
+        const StageStats *stats = &mStages[i];
+        if (stats->mCount == 0) {
+            continue;
+        }
+        char histogram[kBuckets * 11 + 1];
+        size_t len = 0;
+        for (uint32_t j = 0; j < kBuckets; ++j) {
+            len += snprintf(histogram + len, sizeof(histogram) - len, " %u", stats->mBuckets[j]);
+        }
+        dprintf(fd, "    %-6s %9lld %9lld %s\n", stageToString((Stage) i),
+                (long long) (stats->mTotalNs / stats->mCount / 1000),
+                (long long) (stats->mMaxNs / 1000), histogram);
+    }
+}
+
+// static
+const char *ThreadCycleStats::stageToString(Stage stage)
+{
+    switch (stage) {
+    case STAGE_LOOP:    return "loop";
+    case STAGE_MIX:     return "mix";
+    case STAGE_EFFECT:  return "effect";
+    case STAGE_IO:      return "io";
+    default:            return "?";
+    }
+}
+
+}   // namespace android
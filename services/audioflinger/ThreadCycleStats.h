@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_THREAD_CYCLE_STATS_H
+#define ANDROID_AUDIO_THREAD_CYCLE_STATS_H
+
+#include <stdint.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// Cycle time instrumentation for the normal (non-fast) playback and record threads.
+// Each active cycle records the duration of its stages into log2 histograms,
+// and the cycle counts as a deadline miss if it took longer than
+// kDeadlineMissPercent of the sink (or source) period.
+// Written by the owning thread only without locks; dump() may observe a torn update,
+// as with FastThreadDumpState.
+class ThreadCycleStats {
+public:
+    enum Stage {
+        STAGE_LOOP,     // the whole active cycle
+        STAGE_MIX,      // mixing, or conversion to the record tracks
+        STAGE_EFFECT,   // effect chains
+        STAGE_IO,       // HAL or pipe write, or read
+        STAGE_CNT
+    };
+
+    // bucket i counts durations below (kFirstBucketUs << i) us, the last one all longer ones
+    static const uint32_t kBuckets = 12;
+    static const uint32_t kFirstBucketUs = 64;
+    static const uint32_t kDeadlineMissPercent = 150;
+
+    ThreadCycleStats();
+
+    // period of the sink or source in ns, or 0 to not count deadline misses
+    void        setPeriodNs(nsecs_t periodNs) { mPeriodNs = periodNs; }
+    nsecs_t     periodNs() const { return mPeriodNs; }
+
+    // Start of an active cycle; stage durations may then be added.
+    void        beginCycle() { mCycleStartNs = systemTime(); reset(mLastCycleNs); }
+    void        addStage(Stage stage, nsecs_t durationNs);
+    // End of the active cycle; returns true if it missed its deadline.
+    // The cycle's stage durations are then available from lastCycleNs() until the next one.
+    bool        endCycle();
+    nsecs_t     lastCycleNs(Stage stage) const { return mLastCycleNs[stage]; }
+    uint32_t    deadlineMisses() const { return mDeadlineMisses; }
+
+    void        dump(int fd) const;
+
+    static const char *stageToString(Stage stage);
+
+private:
+    static void reset(nsecs_t (&cycleNs)[STAGE_CNT]);
+
+    struct StageStats {
+        uint32_t    mCount;
+        uint32_t    mBuckets[kBuckets];
+        nsecs_t     mMaxNs;
+        int64_t     mTotalNs;   // for the mean
+    };
+
+    StageStats  mStages[STAGE_CNT];
+    nsecs_t     mLastCycleNs[STAGE_CNT];    // of the current or last cycle
+    nsecs_t     mCycleStartNs;
+    nsecs_t     mPeriodNs;
+    uint32_t    mDeadlineMisses;
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_THREAD_CYCLE_STATS_H
@@ -211,6 +211,37 @@ static void sFastTrackMultiplierInit()
 
 // ----------------------------------------------------------------------------
 
+// Parameter key to set the number of AudioMixer workers of an output, see AudioMixer.h.
+static const char * const kKeyMixerWorkers = "mixer_workers";
+
+// Default number of AudioMixer worker threads for a MixerThread with channelCount channels.
+// Parallel mixing only helps when there is a lot of multichannel data to mix,
+// so by default it is only enabled for outputs of at least af.mixer.workers_min_channels.
+static uint32_t defaultMixerWorkerCount(uint32_t channelCount)
+{
+    const uint32_t minChannels =
+            property_get_int32("af.mixer.workers_min_channels", 8 /* default_value */);
+    if (channelCount < minChannels) {
+        return 0;
+    }
+    const int32_t workers = property_get_int32("af.mixer.workers", 0 /* default_value */);
+    if (workers <= 0) {
+        return 0;
+    }
+    return (uint32_t) workers > AudioMixer::MAX_NUM_WORKERS
+            ? AudioMixer::MAX_NUM_WORKERS : (uint32_t) workers;
+}
+
+// Adaptive resampler quality thresholds, as a percentage of the mix period spent in
+// AudioMixer::process(), and the minimum time between two steps of the quality cap.
+// Downgrades step quickly to avoid underruns, upgrades wait for the load to stay low.
+static const int kResamplerDowngradeLoadPercent = 50;
+static const int kResamplerUpgradeLoadPercent = 25;
+static const nsecs_t kResamplerDowngradeHoldNs = milliseconds(100);
+static const nsecs_t kResamplerUpgradeHoldNs = seconds(5);
+
+// ----------------------------------------------------------------------------
+
 #ifdef ADD_BATTERY_DATA
 // To collect the amplifier usage
 static void addBatteryData(uint32_t params) {
@@ -958,6 +989,12 @@ void AudioFlinger::ThreadBase::dumpBase(int fd, const Vector<String16>& args __u
     dprintf(fd, "  Output device: %#x (%s)\n", mOutDevice, devicesToString(mOutDevice).string());
     dprintf(fd, "  Input device: %#x (%s)\n", mInDevice, devicesToString(mInDevice).string());
     dprintf(fd, "  Audio source: %d (%s)\n", mAudioSource, sourceToString(mAudioSource));
+    // make a copy, as the stats are updated by the thread loop without the lock
+    const ThreadCycleStats cycleStats(mCycleStats);
+    cycleStats.dump(fd);
+    const WakeupLatencyDump wakeupLatency(mWakeupLatency);
+    wakeupLatency.dump(fd);
+    dumpThreadSchedStats(fd, getTid());
 
     if (locked) {
         mLock.unlock();
@@ -1539,6 +1576,9 @@ sp<AudioFlinger::EffectModule> AudioFlinger::ThreadBase::getEffect_l(audio_sessi
 // PlaybackThread::mLock held
 status_t AudioFlinger::ThreadBase::addEffect_l(const sp<EffectModule>& effect)
 {
+    // select the chain buffer format first, as changing it recreates the effect chains
+    checkEffectBufferFormat_l(effect);
+
     // check for existing effect chain with the requested audio session
     audio_session_t sessionId = effect->sessionId();
     sp<EffectChain> chain = getEffectChain_l(sessionId);
@@ -1595,6 +1635,7 @@ void AudioFlinger::ThreadBase::removeEffect_l(const sp<EffectModule>& effect, bo
         if (chain->removeEffect_l(effect, release) == 0) {
             removeEffectChain_l(chain);
         }
+        checkEffectBufferFormat_l(0);
     } else {
         ALOGW("removeEffect_l() %p cannot promote chain for effect %p", this, effect.get());
     }
@@ -1691,6 +1732,8 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         mEffectBuffer(NULL),
         mEffectBufferSize(0),
         mEffectBufferFormat(AUDIO_FORMAT_INVALID),
+        mFloatEffectsEnabled(property_get_bool("af.effect.float", true /* default_value */)),
+        mEffectBufferFormatChanging(false),
         mEffectBufferValid(false),
         mSuspended(0), mBytesWritten(0),
         mFramesWritten(0),
@@ -1711,6 +1754,8 @@ AudioFlinger::PlaybackThread::PlaybackThread(const sp<AudioFlinger>& audioFlinge
         mScreenState(AudioFlinger::mScreenState),
         // index 0 is reserved for normal mixer's submix
         mFastTrackAvailMask(((1 << FastMixerState::sMaxFastTracks) - 1) & ~1),
+        // the submix stage, if any, is set up by MixerThread
+        mFastSubmixTrackAvailMask(0),
         mHwSupportsPause(false), mHwPaused(false), mFlushPending(false)
 {
     snprintf(mThreadName, kThreadNameLength, "AudioOut_%X", id);
@@ -1840,8 +1885,9 @@ void AudioFlinger::PlaybackThread::dumpInternals(int fd, const Vector<String16>&
     dprintf(fd, "  Suspend count: %d\n", mSuspended);
     dprintf(fd, "  Sink buffer : %p\n", mSinkBuffer);
     dprintf(fd, "  Mixer buffer: %p\n", mMixerBuffer);
-    dprintf(fd, "  Effect buffer: %p\n", mEffectBuffer);
+    dprintf(fd, "  Effect buffer: %p format %#x\n", mEffectBuffer, mEffectBufferFormat);
     dprintf(fd, "  Fast track availMask=%#x\n", mFastTrackAvailMask);
+    dprintf(fd, "  Fast submix track availMask=%#x\n", mFastSubmixTrackAvailMask);
     dprintf(fd, "  Standby delay ns=%lld\n", (long long)mStandbyDelayNs);
     AudioStreamOut *output = mOutput;
     audio_output_flags_t flags = output != NULL ? output->flags : AUDIO_OUTPUT_FLAG_NONE;
@@ -1922,7 +1968,7 @@ sp<AudioFlinger::PlaybackThread::Track> AudioFlinger::PlaybackThread::createTrac
             // normal mixer has an associated fast mixer
             hasFastMixer() &&
             // there are sufficient fast track slots available
-            (mFastTrackAvailMask != 0)
+            (mFastTrackAvailMask != 0 || mFastSubmixTrackAvailMask != 0)
             // FIXME test that MixerThread for this fast track has a capable output HAL
             // FIXME add a permission test also?
         ) {
@@ -1962,10 +2008,11 @@ sp<AudioFlinger::PlaybackThread::Track> AudioFlinger::PlaybackThread::createTrac
         ALOGV("AUDIO_OUTPUT_FLAG_FAST denied: sharedBuffer=%p frameCount=%zu "
                 "mFrameCount=%zu format=%#x mFormat=%#x isLinear=%d channelMask=%#x "
                 "sampleRate=%u mSampleRate=%u "
-                "hasFastMixer=%d tid=%d fastTrackAvailMask=%#x",
+                "hasFastMixer=%d tid=%d fastTrackAvailMask=%#x fastSubmixTrackAvailMask=%#x",
                 sharedBuffer.get(), frameCount, mFrameCount, format, mFormat,
                 audio_is_linear_pcm(format),
-                channelMask, sampleRate, mSampleRate, hasFastMixer(), tid, mFastTrackAvailMask);
+                channelMask, sampleRate, mSampleRate, hasFastMixer(), tid, mFastTrackAvailMask,
+                mFastSubmixTrackAvailMask);
         *flags = (audio_output_flags_t)(*flags & ~AUDIO_OUTPUT_FLAG_FAST);
       }
     }
@@ -2118,45 +2165,106 @@ uint32_t AudioFlinger::PlaybackThread::latency_l() const
 
 void AudioFlinger::PlaybackThread::setMasterVolume(float value)
 {
-    Mutex::Autolock _l(mLock);
-    // Don't apply master volume in SW if our HAL can do it for us.
-    if (mOutput && mOutput->audioHwDev &&
-        mOutput->audioHwDev->canSetMasterVolume()) {
-        mMasterVolume = 1.0;
-    } else {
-        mMasterVolume = value;
-    }
+    PlaybackParameter parameter;
+    parameter.mType = PlaybackParameter::MASTER_VOLUME;
+    parameter.mVolume = value;
+    postParameter(parameter);
 }
 
 void AudioFlinger::PlaybackThread::setMasterMute(bool muted)
 {
-    Mutex::Autolock _l(mLock);
-    // Don't apply master mute in SW if our HAL can do it for us.
-    if (mOutput && mOutput->audioHwDev &&
-        mOutput->audioHwDev->canSetMasterMute()) {
-        mMasterMute = false;
-    } else {
-        mMasterMute = muted;
-    }
+    PlaybackParameter parameter;
+    parameter.mType = PlaybackParameter::MASTER_MUTE;
+    parameter.mMute = muted;
+    postParameter(parameter);
 }
 
 void AudioFlinger::PlaybackThread::setStreamVolume(audio_stream_type_t stream, float value)
 {
-    Mutex::Autolock _l(mLock);
-    mStreamTypes[stream].volume = value;
-    broadcast_l();
+    PlaybackParameter parameter;
+    parameter.mType = PlaybackParameter::STREAM_VOLUME;
+    parameter.mStream = stream;
+    parameter.mVolume = value;
+    postParameter(parameter);
 }
 
 void AudioFlinger::PlaybackThread::setStreamMute(audio_stream_type_t stream, bool muted)
 {
-    Mutex::Autolock _l(mLock);
-    mStreamTypes[stream].mute = muted;
-    broadcast_l();
+    PlaybackParameter parameter;
+    parameter.mType = PlaybackParameter::STREAM_MUTE;
+    parameter.mStream = stream;
+    parameter.mMute = muted;
+    postParameter(parameter);
 }
 
-float AudioFlinger::PlaybackThread::streamVolume(audio_stream_type_t stream) const
+void AudioFlinger::PlaybackThread::postParameter(const PlaybackParameter& parameter)
+{
+    if (!mParameterQueue.push(parameter)) {
+        // queue full: apply in order with what is already queued
+        Mutex::Autolock _l(mLock);
+        bool wake = drainParameters_l();
+        if (applyParameter_l(parameter) || wake) {
+            broadcast_l();
+        }
+        return;
+    }
+    // Apply right away if the thread lock is free, for instance in standby,
+    // otherwise threadLoop() picks it up before its next prepareTracks_l().
+    if (mLock.tryLock() == NO_ERROR) {
+        if (drainParameters_l()) {
+            broadcast_l();
+        }
+        mLock.unlock();
+    }
+}
+
+bool AudioFlinger::PlaybackThread::drainParameters_l()
+{
+    bool streamChanged = false;
+    PlaybackParameter parameter;
+    while (mParameterQueue.pop(parameter)) {
+        streamChanged |= applyParameter_l(parameter);
+    }
+    return streamChanged;
+}
+
+bool AudioFlinger::PlaybackThread::applyParameter_l(const PlaybackParameter& parameter)
+{
+    switch (parameter.mType) {
+    case PlaybackParameter::MASTER_VOLUME:
+        // Don't apply master volume in SW if our HAL can do it for us.
+        if (mOutput && mOutput->audioHwDev &&
+            mOutput->audioHwDev->canSetMasterVolume()) {
+            mMasterVolume = 1.0;
+        } else {
+            mMasterVolume = parameter.mVolume;
+        }
+        return false;
+    case PlaybackParameter::MASTER_MUTE:
+        // Don't apply master mute in SW if our HAL can do it for us.
+        if (mOutput && mOutput->audioHwDev &&
+            mOutput->audioHwDev->canSetMasterMute()) {
+            mMasterMute = false;
+        } else {
+            mMasterMute = parameter.mMute;
+        }
+        return false;
+    case PlaybackParameter::STREAM_VOLUME:
+        mStreamTypes[parameter.mStream].volume = parameter.mVolume;
+        return true;
+    case PlaybackParameter::STREAM_MUTE:
+        mStreamTypes[parameter.mStream].mute = parameter.mMute;
+        return true;
+    }
+    return false;
+}
+
+float AudioFlinger::PlaybackThread::streamVolume(audio_stream_type_t stream)
 {
     Mutex::Autolock _l(mLock);
+    if (drainParameters_l()) {
+        broadcast_l();
+    }
     return mStreamTypes[stream].volume;
 }
 
@@ -2253,9 +2361,16 @@ void AudioFlinger::PlaybackThread::removeTrack_l(const sp<Track>& track)
     track->mName = -1;
     if (track->isFastTrack()) {
         int index = track->mFastIndex;
-        ALOG_ASSERT(0 < index && index < (int)FastMixerState::sMaxFastTracks);
-        ALOG_ASSERT(!(mFastTrackAvailMask & (1 << index)));
-        mFastTrackAvailMask |= 1 << index;
+        if (index >= (int)FastMixerState::kSubmixFastIndexBase) {
+            index -= FastMixerState::kSubmixFastIndexBase;
+            ALOG_ASSERT(index < (int)FastMixerState::sMaxFastSubmixTracks);
+            ALOG_ASSERT(!(mFastSubmixTrackAvailMask & (1 << index)));
+            mFastSubmixTrackAvailMask |= 1 << index;
+        } else {
+            ALOG_ASSERT(0 < index && index < (int)FastMixerState::sMaxFastTracks);
+            ALOG_ASSERT(!(mFastTrackAvailMask & (1 << index)));
+            mFastTrackAvailMask |= 1 << index;
+        }
         // redundant as track is about to be destroyed, for dumpsys only
         track->mFastIndex = -1;
     }
@@ -2493,6 +2608,9 @@ void AudioFlinger::PlaybackThread::readOutputParameters_l()
     mThreadThrottleEndMs = 0;
     mHalfBufferMs = mNormalFrameCount * 1000 / (2 * mSampleRate);
 
+    // offloaded writes are asynchronous and much longer than a cycle, so have no deadline
+    mCycleStats.setPeriodNs(mType == OFFLOAD ? 0 : seconds(mNormalFrameCount) / mSampleRate);
+
     // mSinkBuffer is the sink buffer.  Size is always multiple-of-16 frames.
     // Originally this was int16_t[] array, need to remove legacy implications.
     free(mSinkBuffer);
@@ -2515,9 +2633,10 @@ void AudioFlinger::PlaybackThread::readOutputParameters_l()
     free(mEffectBuffer);
     mEffectBuffer = NULL;
     if (mEffectBufferEnabled) {
-        mEffectBufferFormat = AUDIO_FORMAT_PCM_16_BIT; // Note: Effects support 16b only
+        mEffectBufferFormat = selectEffectBufferFormat_l(0);
+        // sized for float so that the format can change without reallocating
         mEffectBufferSize = mNormalFrameCount * mChannelCount
-                * audio_bytes_per_sample(mEffectBufferFormat);
+                * audio_bytes_per_sample(AUDIO_FORMAT_PCM_FLOAT);
         (void)posix_memalign(&mEffectBuffer, 32, mEffectBufferSize);
     }
 
@@ -2528,9 +2647,11 @@ void AudioFlinger::PlaybackThread::readOutputParameters_l()
     // matter.
     // create a copy of mEffectChains as calling moveEffectChain_l() can reorder some effect chains
     Vector< sp<EffectChain> > effectChains = mEffectChains;
+    mEffectBufferFormatChanging = true;
     for (size_t i = 0; i < effectChains.size(); i ++) {
         mAudioFlinger->moveEffectChain_l(effectChains[i]->sessionId(), this, this, false);
     }
+    mEffectBufferFormatChanging = false;
 }
 
 
@@ -2724,7 +2845,13 @@ ssize_t AudioFlinger::PlaybackThread::threadLoop_write()
                         (pipe->maxFrames() * 7) / 8 : mNormalFrameCount * 2);
             }
         }
-        ssize_t framesWritten = mNormalSink->write((char *)mSinkBuffer + offset, count);
+        ssize_t framesWritten;
+        if (mPipelinedWriter != 0 && mNormalSink == mOutputSink) {
+            // only waits for the previous period to be written
+            framesWritten = mPipelinedWriter->write((char *)mSinkBuffer + offset, count);
+        } else {
+            framesWritten = mNormalSink->write((char *)mSinkBuffer + offset, count);
+        }
         ATRACE_END();
         if (framesWritten > 0) {
             bytesWritten = framesWritten * mFrameSize;
@@ -2858,7 +2985,9 @@ status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& c
         // Only one effect chain can be present in direct output thread and it uses
         // the sink buffer as input
         if (mType != DIRECT) {
-            size_t numSamples = mNormalFrameCount * mChannelCount;
+            // allocated as int16_t for EffectChain, sized for mEffectBufferFormat
+            size_t numSamples = mNormalFrameCount * mChannelCount
+                    * audio_bytes_per_sample(mEffectBufferFormat) / sizeof(int16_t);
             buffer = new int16_t[numSamples];
             memset(buffer, 0, numSamples * sizeof(int16_t));
             ALOGV("addEffectChain_l() creating new input buffer %p session %d", buffer, session);
@@ -2889,6 +3018,7 @@ status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& c
         }
     }
     chain->setThread(this);
+    chain->setBufferFormat(mEffectBufferEnabled ? mEffectBufferFormat : AUDIO_FORMAT_PCM_16_BIT);
     chain->setInBuffer(buffer, ownsBuffer);
     chain->setOutBuffer(reinterpret_cast<int16_t*>(mEffectBufferEnabled
             ? mEffectBuffer : mSinkBuffer));
@@ -2918,6 +3048,52 @@ status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& c
     return NO_ERROR;
 }
 
+audio_format_t AudioFlinger::PlaybackThread::selectEffectBufferFormat_l(
+        const sp<EffectModule>& effect) const
+{
+    // Mixer threads run the effect chains in float when all effects support it, so that the
+    // float mix is only converted once, from mEffectBuffer to the sink buffer.
+    // Auxiliary effects read the 32 bit mixer aux buffer as PCM 16 and are never float capable.
+    if (mType != MIXER || !mEffectBufferEnabled || !mFloatEffectsEnabled ||
+            (effect != 0 && !effect->isFloatCapable())) {
+        return AUDIO_FORMAT_PCM_16_BIT;
+    }
+    for (size_t i = 0; i < mEffectChains.size(); i++) {
+        if (!mEffectChains[i]->isFloatCapable_l()) {
+            return AUDIO_FORMAT_PCM_16_BIT;
+        }
+    }
+    return AUDIO_FORMAT_PCM_FLOAT;
+}
+
+// checkEffectBufferFormat_l() must be called with AudioFlinger::mLock and
+// PlaybackThread::mLock held
+void AudioFlinger::PlaybackThread::checkEffectBufferFormat_l(const sp<EffectModule>& effect)
+{
+    // moving the chains below adds and removes effects again
+    if (mEffectBufferFormatChanging || !mEffectBufferEnabled) {
+        return;
+    }
+    const audio_format_t format = selectEffectBufferFormat_l(effect);
+    if (format == mEffectBufferFormat) {
+        return;
+    }
+    ALOGV("checkEffectBufferFormat_l() thread %p effect buffer format %#x -> %#x",
+            this, mEffectBufferFormat, format);
+    mEffectBufferFormat = format;
+
+    // Recreate all effect chains so that their buffers are allocated and their effects are
+    // configured with the new format, as done by readOutputParameters_l().
+    // The thread loop picks up the new track main buffers and mixer formats
+    // in the next prepareTracks_l().
+    mEffectBufferFormatChanging = true;
+    Vector< sp<EffectChain> > effectChains = mEffectChains;
+    for (size_t i = 0; i < effectChains.size(); i ++) {
+        mAudioFlinger->moveEffectChain_l(effectChains[i]->sessionId(), this, this, false);
+    }
+    mEffectBufferFormatChanging = false;
+}
+
 size_t AudioFlinger::PlaybackThread::removeEffectChain_l(const sp<EffectChain>& chain)
 {
     audio_session_t session = chain->sessionId();
@@ -3027,12 +3203,16 @@ bool AudioFlinger::PlaybackThread::threadLoop()
     // So if you need to log when mutex is unlocked, set logString to a non-NULL string,
     // and then that string will be logged at the next convenient opportunity.
     const char *logString = NULL;
+    // similarly, stage durations of a cycle that missed its deadline, logged next when locked
+    bool logDeadlineMiss = false;
+    nsecs_t missedCycleNs[ThreadCycleStats::STAGE_CNT];
 
     checkSilentMode_l();
 
     while (!exitPending())
     {
         cpuStats.sample(myName);
+        mCycleStats.beginCycle();
 
         Vector< sp<EffectChain> > effectChains;
 
@@ -3047,6 +3227,15 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                 mNBLogWriter->log(logString);
                 logString = NULL;
             }
+            if (logDeadlineMiss) {
+                mNBLogWriter->logFormat(
+                        "deadline miss: loop %lld us, mix %lld, effect %lld, io %lld",
+                        (long long) ns2us(missedCycleNs[ThreadCycleStats::STAGE_LOOP]),
+                        (long long) ns2us(missedCycleNs[ThreadCycleStats::STAGE_MIX]),
+                        (long long) ns2us(missedCycleNs[ThreadCycleStats::STAGE_EFFECT]),
+                        (long long) ns2us(missedCycleNs[ThreadCycleStats::STAGE_IO]));
+                logDeadlineMiss = false;
+            }
 
             // Gather the framesReleased counters for all active tracks,
             // and associate with the sink frames written out.  We need
@@ -3190,6 +3379,9 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                     continue;
                 }
             }
+            // apply volume and mute changes posted by binder threads
+            (void) drainParameters_l();
+
             // mMixerStatusIgnoringFastTracks is also updated internally
             mMixerStatus = prepareTracks_l(&tracksToRemove);
 
@@ -3210,7 +3402,9 @@ bool AudioFlinger::PlaybackThread::threadLoop()
             mCurrentWriteLength = 0;
             if (mMixerStatus == MIXER_TRACKS_READY) {
                 // threadLoop_mix() sets mCurrentWriteLength
+                const nsecs_t mixStartNs = systemTime();
                 threadLoop_mix();
+                mCycleStats.addStage(ThreadCycleStats::STAGE_MIX, systemTime() - mixStartNs);
             } else if ((mMixerStatus != MIXER_DRAIN_TRACK)
                         && (mMixerStatus != MIXER_DRAIN_ALL)) {
                 // threadLoop_sleepTime sets mSleepTimeUs to 0 if data
@@ -3257,20 +3451,25 @@ bool AudioFlinger::PlaybackThread::threadLoop()
             }
 
             // only process effects if we're going to write
-            if (mSleepTimeUs == 0 && mType != OFFLOAD) {
+            if (mSleepTimeUs == 0 && mType != OFFLOAD && effectChains.size() > 0) {
+                const nsecs_t effectStartNs = systemTime();
                 for (size_t i = 0; i < effectChains.size(); i ++) {
                     effectChains[i]->process_l();
                 }
+                mCycleStats.addStage(ThreadCycleStats::STAGE_EFFECT,
+                        systemTime() - effectStartNs);
             }
         }
         // Process effect chains for offloaded thread even if no audio
         // was read from audio track: process only updates effect state
         // and thus does have to be synchronized with audio writes but may have
         // to be called while waiting for async write callback
-        if (mType == OFFLOAD) {
+        if (mType == OFFLOAD && effectChains.size() > 0) {
+            const nsecs_t effectStartNs = systemTime();
             for (size_t i = 0; i < effectChains.size(); i ++) {
                 effectChains[i]->process_l();
             }
+            mCycleStats.addStage(ThreadCycleStats::STAGE_EFFECT, systemTime() - effectStartNs);
         }
 
         // Only if the Effects buffer is enabled and there is data in the
@@ -3307,6 +3506,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                     ret = threadLoop_write();
                     lastWriteFinished = systemTime();
                     delta = lastWriteFinished - mLastWriteTime;
+                    mCycleStats.addStage(ThreadCycleStats::STAGE_IO, delta);
                     if (ret < 0) {
                         mBytesRemaining = 0;
                     } else {
@@ -3314,6 +3514,14 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                         mBytesRemaining -= ret;
                         mFramesWritten += ret / mFrameSize;
                     }
+                    threadLoop_publishTimestamp();
+                    // only cycles that write are timed, before any throttling sleep
+                    if (mCycleStats.endCycle() && !logDeadlineMiss) {
+                        for (int i = 0; i < ThreadCycleStats::STAGE_CNT; ++i) {
+                            missedCycleNs[i] = mCycleStats.lastCycleNs((ThreadCycleStats::Stage) i);
+                        }
+                        logDeadlineMiss = true;
+                    }
                 } else if ((mMixerStatus == MIXER_DRAIN_TRACK) ||
                         (mMixerStatus == MIXER_DRAIN_ALL)) {
                     threadLoop_drain();
@@ -3383,7 +3591,11 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                 ATRACE_BEGIN("sleep");
                 Mutex::Autolock _l(mLock);
                 if (!mSignalPending && mConfigEvents.isEmpty() && !exitPending()) {
-                    mWaitWorkCV.waitRelative(mLock, microseconds((nsecs_t)mSleepTimeUs));
+                    const nsecs_t sleepNs = microseconds((nsecs_t)mSleepTimeUs);
+                    const nsecs_t sleepStartNs = systemTime();
+                    if (mWaitWorkCV.waitRelative(mLock, sleepNs) == TIMED_OUT) {
+                        mWakeupLatency.add(systemTime() - sleepStartNs - sleepNs);
+                    }
                 }
                 ATRACE_END();
             }
@@ -3470,6 +3682,18 @@ status_t AudioFlinger::PlaybackThread::getTimestamp_l(AudioTimestamp& timestamp)
     return INVALID_OPERATION;
 }
 
+bool AudioFlinger::PlaybackThread::getPublishedTimestamp(AudioTimestamp& timestamp,
+        nsecs_t maxAgeNs) const
+{
+    PublishedTimestamp published;
+    if (!mPublishedTimestamp.read(published) ||
+            systemTime() - published.mPublishedNs > maxAgeNs) {
+        return false;
+    }
+    timestamp = published.mTimestamp;
+    return true;
+}
+
 status_t AudioFlinger::MixerThread::createAudioPatch_l(const struct audio_patch *patch,
                                                           audio_patch_handle_t *handle)
 {
@@ -3620,8 +3844,19 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
     :   PlaybackThread(audioFlinger, output, id, device, type, systemReady),
         // mAudioMixer below
         // mFastMixer below
+        // mFastSubmixer below
+        // mFastSubmixPipe below
+        mFastSubmixIndex(-1),
         mFastMixerFutex(0),
-        mMasterMono(false)
+        mFastSubmixerFutex(0),
+        mMasterMono(false),
+        // mMixerWorkerCount below
+        mAdaptiveResamplerQuality(
+                property_get_bool("af.resampler.adaptive", true /* default_value */)),
+        mResamplerQualityCap(AudioResampler::DYN_HIGH_QUALITY),
+        mMixNsAverage(0),
+        mResamplerQualityChangeNs(0),
+        mLowMixLoadSinceNs(0)
         // mOutputSink below
         // mPipeSink below
         // mNormalSink below
@@ -3632,6 +3867,8 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
             mSampleRate, mChannelMask, mChannelCount, mFormat, mFrameSize, mFrameCount,
             mNormalFrameCount);
     mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+    mMixerWorkerCount = defaultMixerWorkerCount(mChannelCount);
+    mAudioMixer->setWorkerCount(mMixerWorkerCount);
 
     if (type == DUPLICATING) {
         // The Duplicating thread uses the AudioMixer and delivers data to OutputTracks
@@ -3725,6 +3962,28 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         }
 #endif
 
+        // create a MonoPipe to connect the optional fast submix stage to FastMixer
+        MonoPipe *submixPipe = NULL;
+        if (FastMixerState::sMaxFastSubmixTracks > 0) {
+            // The submix stage runs one fast mixer period ahead of FastMixer and blocks
+            // once two periods are buffered, so this is the latency it adds to its tracks.
+            submixPipe = new MonoPipe(mFrameCount * 4, format, true /*writeCanBlock*/);
+            size_t numCounterOffers = 0;
+#if !LOG_NDEBUG
+            ssize_t index =
+#else
+            (void)
+#endif
+                    submixPipe->negotiate(offers, 1, NULL, numCounterOffers);
+            ALOG_ASSERT(index == 0);
+            submixPipe->setAvgFrames(mFrameCount * 2);
+            mFastSubmixPipe = submixPipe;
+            // the last primary slot carries the submix
+            mFastSubmixIndex = FastMixerState::sMaxFastTracks - 1;
+            mFastTrackAvailMask &= ~(1 << mFastSubmixIndex);
+            mFastSubmixTrackAvailMask = (1 << FastMixerState::sMaxFastSubmixTracks) - 1;
+        }
+
         // create fast mixer and configure it initially with just one fast track for our submix
         mFastMixer = new FastMixer();
         FastMixerStateQueue *sq = mFastMixer->sq();
@@ -3740,6 +3999,16 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         fastTrack->mChannelMask = mChannelMask; // mPipeSink channel mask for audio to FastMixer
         fastTrack->mFormat = mFormat; // mPipeSink format for audio to FastMixer
         fastTrack->mGeneration++;
+        if (submixPipe != NULL) {
+            // the slot is only marked active while the submix stage has active tracks
+            fastTrack = &state->mFastTracks[mFastSubmixIndex];
+            fastTrack->mBufferProvider =
+                    new SourceAudioBufferProvider(new MonoPipeReader(submixPipe));
+            fastTrack->mVolumeProvider = NULL;
+            fastTrack->mChannelMask = mChannelMask;
+            fastTrack->mFormat = mFormat;
+            fastTrack->mGeneration++;
+        }
         state->mFastTracksGen++;
         state->mTrackMask = 1;
         // fast mixer will use the HAL output sink
@@ -3765,6 +4034,30 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         pid_t tid = mFastMixer->getTid();
         sendPrioConfigEvent(getpid_cached, tid, kPriorityFastMixer);
 
+        if (submixPipe != NULL) {
+            // create the fast submix stage, initially without tracks, writing to the submix pipe
+            mFastSubmixer = new FastMixer();
+            sq = mFastSubmixer->sq();
+            state = sq->begin();
+            state->mTrackMask = 0;
+            state->mOutputSink = submixPipe;
+            state->mOutputSinkGen++;
+            state->mFrameCount = mFrameCount;
+            state->mCommand = FastMixerState::COLD_IDLE;
+            state->mColdFutexAddr = &mFastSubmixerFutex;
+            state->mColdGen++;
+            state->mDumpState = &mFastSubmixerDumpState;
+            mFastSubmixerNBLogWriter = audioFlinger->newWriter_l(kFastMixerLogSize,
+                    "FastSubmixer");
+            state->mNBLogWriter = mFastSubmixerNBLogWriter.get();
+            sq->end();
+            sq->push(FastMixerStateQueue::BLOCK_UNTIL_PUSHED);
+
+            mFastSubmixer->run("FastSubmixer", PRIORITY_URGENT_AUDIO);
+            tid = mFastSubmixer->getTid();
+            sendPrioConfigEvent(getpid_cached, tid, kPriorityFastMixer);
+        }
+
 #ifdef AUDIO_WATCHDOG
         // create and start the watchdog
         mAudioWatchdog = new AudioWatchdog();
@@ -3788,10 +4081,45 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
         mNormalSink = initFastMixer ? mPipeSink : mOutputSink;
         break;
     }
+
+    updatePipelinedWriter_l();
+}
+
+// Outputs whose flags intersect af.mixer.pipelined_write_flags, a mask of audio_output_flags_t,
+// hand their HAL writes to a PipelinedWriteThread. Outputs with a fast mixer are already
+// decoupled from the HAL by the fast mixer pipe and never use it.
+void AudioFlinger::MixerThread::updatePipelinedWriter_l()
+{
+    if (mPipelinedWriter != 0) {
+        mPipelinedWriter->exit();
+        mPipelinedWriter.clear();
+    }
+    const uint32_t pipelinedWriteFlags =
+            property_get_int32("af.mixer.pipelined_write_flags", 0 /* default_value */);
+    if (mFastMixer == 0 && mOutputSink != 0 && (mOutput->flags & pipelinedWriteFlags) != 0) {
+        mPipelinedWriter = new PipelinedWriteThread(mOutputSink, mFrameSize, mNormalFrameCount);
+    }
 }
 
 AudioFlinger::MixerThread::~MixerThread()
 {
+    if (mFastSubmixer != 0) {
+        // exit the submix stage first, the fast mixer is still reading the submix pipe
+        FastMixerStateQueue *sq = mFastSubmixer->sq();
+        FastMixerState *state = sq->begin();
+        if (state->mCommand == FastMixerState::COLD_IDLE) {
+            int32_t old = android_atomic_inc(&mFastSubmixerFutex);
+            if (old == -1) {
+                (void) syscall(__NR_futex, &mFastSubmixerFutex, FUTEX_WAKE_PRIVATE, 1);
+            }
+        }
+        state->mCommand = FastMixerState::EXIT;
+        sq->end();
+        sq->push(FastMixerStateQueue::BLOCK_UNTIL_PUSHED);
+        mFastSubmixer->join();
+        mFastSubmixer.clear();
+        mAudioFlinger->unregisterWriter(mFastSubmixerNBLogWriter);
+    }
     if (mFastMixer != 0) {
         FastMixerStateQueue *sq = mFastMixer->sq();
         FastMixerState *state = sq->begin();
@@ -3813,6 +4141,12 @@ AudioFlinger::MixerThread::~MixerThread()
         FastTrack *fastTrack = &state->mFastTracks[0];
         ALOG_ASSERT(fastTrack->mBufferProvider != NULL);
         delete fastTrack->mBufferProvider;
+        if (mFastSubmixIndex >= 0) {
+            // the fast submix stage source is owned by us whether it is active or not
+            fastTrack = &state->mFastTracks[mFastSubmixIndex];
+            ALOG_ASSERT(fastTrack->mBufferProvider != NULL);
+            delete fastTrack->mBufferProvider;
+        }
         sq->end(false /*didModify*/);
         mFastMixer.clear();
 #ifdef AUDIO_WATCHDOG
@@ -3823,6 +4157,10 @@ AudioFlinger::MixerThread::~MixerThread()
         }
 #endif
     }
+    if (mPipelinedWriter != 0) {
+        mPipelinedWriter->exit();
+        mPipelinedWriter.clear();
+    }
     mAudioFlinger->unregisterWriter(mFastMixerNBLogWriter);
     delete mAudioMixer;
 }
@@ -3834,6 +4172,10 @@ uint32_t AudioFlinger::MixerThread::correctLatency_l(uint32_t latency) const
         MonoPipe *pipe = (MonoPipe *)mPipeSink.get();
         latency += (pipe->getAvgFrames() * 1000) / mSampleRate;
     }
+    if (mPipelinedWriter != 0) {
+        // the period being written by the writer thread
+        latency += (mNormalFrameCount * 1000) / mSampleRate;
+    }
     return latency;
 }
 
@@ -3888,6 +4230,21 @@ ssize_t AudioFlinger::MixerThread::threadLoop_write()
 
 void AudioFlinger::MixerThread::threadLoop_standby()
 {
+    // Idle the fast submix stage before the fast mixer that reads from it
+    if (mFastSubmixer != 0) {
+        FastMixerStateQueue *sq = mFastSubmixer->sq();
+        FastMixerState *state = sq->begin();
+        if (!(state->mCommand & FastMixerState::IDLE)) {
+            state->mCommand = FastMixerState::COLD_IDLE;
+            state->mColdFutexAddr = &mFastSubmixerFutex;
+            state->mColdGen++;
+            mFastSubmixerFutex = 0;
+            sq->end();
+            sq->push(FastMixerStateQueue::BLOCK_UNTIL_ACKED);
+        } else {
+            sq->end(false /*didModify*/);
+        }
+    }
     // Idle the fast mixer if it's currently running
     if (mFastMixer != 0) {
         FastMixerStateQueue *sq = mFastMixer->sq();
@@ -3912,6 +4269,10 @@ void AudioFlinger::MixerThread::threadLoop_standby()
             sq->end(false /*didModify*/);
         }
     }
+    if (mPipelinedWriter != 0) {
+        // the HAL must not be written to once in standby
+        mPipelinedWriter->waitIdle();
+    }
     PlaybackThread::threadLoop_standby();
 }
 
@@ -3963,7 +4324,11 @@ void AudioFlinger::PlaybackThread::onAsyncError()
 void AudioFlinger::MixerThread::threadLoop_mix()
 {
     // mix buffers...
+    const nsecs_t mixStartNs = mAdaptiveResamplerQuality ? systemTime() : 0;
     mAudioMixer->process();
+    if (mAdaptiveResamplerQuality) {
+        updateResamplerQualityCap(systemTime() - mixStartNs);
+    }
     mCurrentWriteLength = mSinkBufferSize;
     // increase sleep time progressively when application underrun condition clears.
     // Only increase sleep time if the mixer is ready for two consecutive times to avoid
@@ -3978,6 +4343,43 @@ void AudioFlinger::MixerThread::threadLoop_mix()
 
 }
 
+void AudioFlinger::MixerThread::updateResamplerQualityCap(nsecs_t mixNs)
+{
+    // exponential average over about 8 mixes, so that a single long mix does not count.
+    mMixNsAverage += (mixNs - mMixNsAverage) / 8;
+    const nsecs_t periodNs = (nsecs_t)mNormalFrameCount * 1000000000LL / mSampleRate;
+    const nsecs_t now = systemTime();
+    AudioResampler::src_quality cap = mResamplerQualityCap;
+
+    if (mMixNsAverage * 100 > periodNs * kResamplerDowngradeLoadPercent) {
+        mLowMixLoadSinceNs = 0;
+        if (cap > AudioResampler::DYN_LOW_QUALITY
+                && now - mResamplerQualityChangeNs >= kResamplerDowngradeHoldNs) {
+            cap = (AudioResampler::src_quality)(cap - 1);
+        }
+    } else if (mMixNsAverage * 100 < periodNs * kResamplerUpgradeLoadPercent) {
+        if (mLowMixLoadSinceNs == 0) {
+            mLowMixLoadSinceNs = now;
+        }
+        if (cap < AudioResampler::DYN_HIGH_QUALITY
+                && now - mLowMixLoadSinceNs >= kResamplerUpgradeHoldNs
+                && now - mResamplerQualityChangeNs >= kResamplerUpgradeHoldNs) {
+            cap = (AudioResampler::src_quality)(cap + 1);
+        }
+    } else {
+        mLowMixLoadSinceNs = 0;
+    }
+
+    if (cap != mResamplerQualityCap) {
+        ALOGD("mix load %lld of %lld ns: resampler quality cap %d -> %d",
+                (long long)mMixNsAverage, (long long)periodNs, mResamplerQualityCap, cap);
+        mResamplerQualityCap = cap;
+        mResamplerQualityChangeNs = now;
+        mLowMixLoadSinceNs = 0;
+        mAudioMixer->setResamplerQualityCap(cap);
+    }
+}
+
 void AudioFlinger::MixerThread::threadLoop_sleepTime()
 {
     // If no tracks are ready, sleep once for the duration of an output
@@ -4051,6 +4453,15 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
         sq = mFastMixer->sq();
         state = sq->begin();
     }
+    // and for the fast submix stage
+    FastMixerStateQueue *submixSq = NULL;
+    FastMixerState *submixState = NULL;
+    bool submixDidModify = false;
+    FastMixerStateQueue::block_t submixBlock = FastMixerStateQueue::BLOCK_UNTIL_PUSHED;
+    if (mFastSubmixer != 0) {
+        submixSq = mFastSubmixer->sq();
+        submixState = submixSq->begin();
+    }
 
     mMixerBufferValid = false;  // mMixerBuffer has no valid data until appropriate tracks found.
     mEffectBufferValid = false; // mEffectBuffer has no valid data until tracks found.
@@ -4074,13 +4485,28 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
             // at the identical fast mixer slot within the same normal mix cycle,
             // is impossible because the slot isn't marked available until the end of each cycle.
             int j = track->mFastIndex;
-            ALOG_ASSERT(0 < j && j < (int)FastMixerState::sMaxFastTracks);
-            ALOG_ASSERT(!(mFastTrackAvailMask & (1 << j)));
-            FastTrack *fastTrack = &state->mFastTracks[j];
+            // the fast mixer or fast submix stage state and dump holding the track
+            FastMixerState *trackState = state;
+            FastMixerDumpState *trackDumpState = &mFastMixerDumpState;
+            bool *trackDidModify = &didModify;
+            FastMixerStateQueue::block_t *trackBlock = &block;
+            if (j >= (int)FastMixerState::kSubmixFastIndexBase) {
+                j -= FastMixerState::kSubmixFastIndexBase;
+                ALOG_ASSERT(j < (int)FastMixerState::sMaxFastSubmixTracks);
+                ALOG_ASSERT(!(mFastSubmixTrackAvailMask & (1 << j)));
+                trackState = submixState;
+                trackDumpState = &mFastSubmixerDumpState;
+                trackDidModify = &submixDidModify;
+                trackBlock = &submixBlock;
+            } else {
+                ALOG_ASSERT(0 < j && j < (int)FastMixerState::sMaxFastTracks);
+                ALOG_ASSERT(!(mFastTrackAvailMask & (1 << j)));
+            }
+            FastTrack *fastTrack = &trackState->mFastTracks[j];
 
             // Determine whether the track is currently in underrun condition,
             // and whether it had a recent underrun.
-            FastTrackDump *ftDump = &mFastMixerDumpState.mTracks[j];
+            FastTrackDump *ftDump = &trackDumpState->mTracks[j];
             FastTrackUnderruns underruns = ftDump->mUnderruns;
             uint32_t recentFull = (underruns.mBitFields.mFull -
                     track->mObservedUnderruns.mBitFields.mFull) & UNDERRUN_MASK;
@@ -4180,7 +4606,7 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
 
             if (isActive) {
                 // was it previously inactive?
-                if (!(state->mTrackMask & (1 << j))) {
+                if (!(trackState->mTrackMask & (1 << j))) {
                     ExtendedAudioBufferProvider *eabp = track;
                     VolumeProvider *vp = track;
                     fastTrack->mBufferProvider = eabp;
@@ -4188,8 +4614,8 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                     fastTrack->mChannelMask = track->mChannelMask;
                     fastTrack->mFormat = track->mFormat;
                     fastTrack->mGeneration++;
-                    state->mTrackMask |= 1 << j;
-                    didModify = true;
+                    trackState->mTrackMask |= 1 << j;
+                    *trackDidModify = true;
                     // no acknowledgement required for newly active tracks
                 }
                 // cache the combined master volume and stream type volume for fast mixer; this
@@ -4198,18 +4624,19 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 ++fastTracks;
             } else {
                 // was it previously active?
-                if (state->mTrackMask & (1 << j)) {
+                if (trackState->mTrackMask & (1 << j)) {
                     fastTrack->mBufferProvider = NULL;
                     fastTrack->mGeneration++;
-                    state->mTrackMask &= ~(1 << j);
-                    didModify = true;
+                    trackState->mTrackMask &= ~(1 << j);
+                    *trackDidModify = true;
                     // If any fast tracks were removed, we must wait for acknowledgement
                     // because we're about to decrement the last sp<> on those tracks.
-                    block = FastMixerStateQueue::BLOCK_UNTIL_ACKED;
+                    *trackBlock = FastMixerStateQueue::BLOCK_UNTIL_ACKED;
                 } else {
                     LOG_ALWAYS_FATAL("fast track %d should have been active; "
                             "mState=%d, mTrackMask=%#x, recentUnderruns=%u, isShared=%d",
-                            j, track->mState, state->mTrackMask, recentUnderruns,
+                            track->mFastIndex, track->mState, trackState->mTrackMask,
+                            recentUnderruns,
                             track->sharedBuffer() != 0);
                 }
                 tracksToRemove->add(track);
@@ -4423,8 +4850,28 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
              * (mMixerBufferEnabled true), then selected tracks will accumulate
              * into it.
              *
+             * A lone track whose format and channel mask already match the sink
+             * mixes directly into mSinkBuffer, so that the mixer passthrough hook
+             * copies it there once instead of going through mMixerBuffer.
+             *
              */
-            if (mMixerBufferEnabled
+            const bool sinkPassthrough = mMixerBufferEnabled
+                    && count == 1
+                    && track->mainBuffer() == mSinkBuffer
+                    && track->format() == mFormat
+                    && track->channelMask() == mChannelMask
+                    && (mFormat == AUDIO_FORMAT_PCM_16_BIT || mFormat == AUDIO_FORMAT_PCM_FLOAT)
+                    && !requireMonoBlend();
+            if (sinkPassthrough) {
+                mAudioMixer->setParameter(
+                        name,
+                        AudioMixer::TRACK,
+                        AudioMixer::MIXER_FORMAT, (void *)mFormat);
+                mAudioMixer->setParameter(
+                        name,
+                        AudioMixer::TRACK,
+                        AudioMixer::MAIN_BUFFER, (void *)mSinkBuffer);
+            } else if (mMixerBufferEnabled
                     && (track->mainBuffer() == mSinkBuffer
                             || track->mainBuffer() == mMixerBuffer)) {
                 mAudioMixer->setParameter(
@@ -4438,10 +4885,14 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
                 // TODO: override track->mainBuffer()?
                 mMixerBufferValid = true;
             } else {
+                // tracks with effects mix in the format of their effect chain buffer
+                const audio_format_t mainBufferFormat =
+                        mEffectBufferEnabled && track->mainBuffer() != mSinkBuffer
+                                ? mEffectBufferFormat : AUDIO_FORMAT_PCM_16_BIT;
                 mAudioMixer->setParameter(
                         name,
                         AudioMixer::TRACK,
-                        AudioMixer::MIXER_FORMAT, (void *)AUDIO_FORMAT_PCM_16_BIT);
+                        AudioMixer::MIXER_FORMAT, (void *)mainBufferFormat);
                 mAudioMixer->setParameter(
                         name,
                         AudioMixer::TRACK,
@@ -4517,6 +4968,46 @@ AudioFlinger::PlaybackThread::mixer_state AudioFlinger::MixerThread::prepareTrac
 
     }
 
+    // Run the fast submix stage only while it has active tracks, and play its submix
+    // on the fast mixer only then, so that an idle submix stage does not keep
+    // a dynamic fast mixer out of cold idle.
+    if (submixSq != NULL) {
+        if (submixDidModify) {
+            submixState->mFastTracksGen++;
+            if (submixState->mTrackMask != 0) {
+                if (submixState->mCommand != FastMixerState::MIX_WRITE) {
+                    if (submixState->mCommand == FastMixerState::COLD_IDLE) {
+                        int32_t old = android_atomic_inc(&mFastSubmixerFutex);
+                        if (old == -1) {
+                            (void) syscall(__NR_futex, &mFastSubmixerFutex,
+                                    FUTEX_WAKE_PRIVATE, 1);
+                        }
+                    }
+                    submixState->mCommand = FastMixerState::MIX_WRITE;
+                }
+            } else if (submixState->mCommand == FastMixerState::MIX_WRITE) {
+                submixState->mCommand = FastMixerState::COLD_IDLE;
+                submixState->mColdFutexAddr = &mFastSubmixerFutex;
+                submixState->mColdGen++;
+                mFastSubmixerFutex = 0;
+            }
+        }
+        const unsigned submixBit = 1 << mFastSubmixIndex;
+        const bool submixActive = submixState->mTrackMask != 0;
+        if (submixActive != ((state->mTrackMask & submixBit) != 0)) {
+            // the submix source is owned by this thread, so no acknowledgement is required
+            state->mFastTracks[mFastSubmixIndex].mGeneration++;
+            if (submixActive) {
+                state->mTrackMask |= submixBit;
+            } else {
+                state->mTrackMask &= ~submixBit;
+            }
+            didModify = true;
+        }
+        submixSq->end(submixDidModify);
+        submixSq->push(submixBlock);
+    }
+
     // Push the new FastMixer state if necessary
     bool pauseAudioWatchdog = false;
     if (didModify) {
@@ -4710,7 +5201,19 @@ bool AudioFlinger::MixerThread::checkForNewParameter_l(const String8& keyValuePa
         }
     }
 
+    if (param.getInt(String8(kKeyMixerWorkers), value) == NO_ERROR) {
+        if (value < 0 || (uint32_t) value > AudioMixer::MAX_NUM_WORKERS) {
+            status = BAD_VALUE;
+        } else {
+            mMixerWorkerCount = value;
+            mAudioMixer->setWorkerCount(mMixerWorkerCount);
+        }
+    }
+
     if (status == NO_ERROR) {
+        if (mPipelinedWriter != 0) {
+            mPipelinedWriter->waitIdle();
+        }
         status = mOutput->stream->common.set_parameters(&mOutput->stream->common,
                                                 keyValuePair.string());
         if (!mStandby && status == INVALID_OPERATION) {
@@ -4722,8 +5225,11 @@ bool AudioFlinger::MixerThread::checkForNewParameter_l(const String8& keyValuePa
         }
         if (status == NO_ERROR && reconfig) {
             readOutputParameters_l();
+            updatePipelinedWriter_l();
             delete mAudioMixer;
             mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+            mAudioMixer->setWorkerCount(mMixerWorkerCount);
+            mAudioMixer->setResamplerQualityCap(mResamplerQualityCap);
             for (size_t i = 0; i < mTracks.size() ; i++) {
                 int name = getTrackName_l(mTracks[i]->mChannelMask,
                         mTracks[i]->mFormat, mTracks[i]->mSessionId, mTracks[i]->uid());
@@ -4745,6 +5251,12 @@ void AudioFlinger::MixerThread::dumpInternals(int fd, const Vector<String16>& ar
     PlaybackThread::dumpInternals(fd, args);
     dprintf(fd, "  Thread throttle time (msecs): %u\n", mThreadThrottleTimeMs);
     dprintf(fd, "  AudioMixer tracks: 0x%08x\n", mAudioMixer->trackNames());
+    dprintf(fd, "  AudioMixer workers: %u\n", mAudioMixer->workerCount());
+    dprintf(fd, "  Pipelined HAL write: %s\n", mPipelinedWriter != 0 ? "yes" : "no");
+    dprintf(fd, "  AudioMixer muted track cycles skipped: %u\n",
+            mAudioMixer->skippedTrackCycles());
+    dprintf(fd, "  Resampler quality cap: %d (adaptive %s)\n",
+            mAudioMixer->resamplerQualityCap(), mAdaptiveResamplerQuality ? "on" : "off");
     dprintf(fd, "  Master mono: %s\n", mMasterMono ? "on" : "off");
 
     // Make a non-atomic copy of fast mixer dump state so it won't change underneath us
@@ -4754,6 +5266,16 @@ void AudioFlinger::MixerThread::dumpInternals(int fd, const Vector<String16>& ar
     const FastMixerDumpState *copy = new FastMixerDumpState(mFastMixerDumpState);
     copy->dump(fd);
     delete copy;
+    if (mFastMixer != 0) {
+        dumpThreadSchedStats(fd, mFastMixer->getTid());
+    }
+
+    if (mFastSubmixer != 0) {
+        dprintf(fd, "  Fast submix stage, played as fast track %d:\n", mFastSubmixIndex);
+        copy = new FastMixerDumpState(mFastSubmixerDumpState);
+        copy->dump(fd);
+        delete copy;
+    }
 
 #ifdef STATE_QUEUE_DUMP
     // Similar for state queue
@@ -5112,6 +5634,21 @@ void AudioFlinger::DirectOutputThread::threadLoop_mix()
     mActiveTrack.clear();
 }
 
+void AudioFlinger::DirectOutputThread::threadLoop_publishTimestamp()
+{
+    // publish for Track::getTimestamp(), which then needs no mLock,
+    // and in the control block of the track, so that AudioTrack needs no Binder call
+    PublishedTimestamp published;
+    if (getTimestamp_l(published.mTimestamp) == NO_ERROR) {
+        published.mPublishedNs = systemTime();
+        mPublishedTimestamp.publish(published);
+        sp<Track> track = mPreviousTrack.promote();
+        if (track != 0) {
+            track->publishTimestamp(published.mTimestamp);
+        }
+    }
+}
+
 void AudioFlinger::DirectOutputThread::threadLoop_sleepTime()
 {
     // do not write to HAL when paused
@@ -5408,17 +5945,139 @@ void AudioFlinger::AsyncCallbackThread::setAsyncError()
     mWaitWorkCV.signal();
 }
 
+// ----------------------------------------------------------------------------
+
+AudioFlinger::PipelinedWriteThread::PipelinedWriteThread(const sp<NBAIO_Sink>& sink,
+        size_t frameSize, size_t frameCount)
+    :   Thread(false /*canCallJava*/),
+        mSink(sink),
+        mFrameSize(frameSize),
+        mFrameCount(frameCount),
+        mBuffer(NULL),
+        mPendingFrames(0),
+        mWriteError(0)
+{
+    (void)posix_memalign(&mBuffer, 32, mFrameCount * mFrameSize);
+}
+
+AudioFlinger::PipelinedWriteThread::~PipelinedWriteThread()
+{
+    free(mBuffer);
+}
+
+void AudioFlinger::PipelinedWriteThread::onFirstRef()
+{
+    run("Mixer Write", ANDROID_PRIORITY_URGENT_AUDIO);
+}
+
+bool AudioFlinger::PipelinedWriteThread::threadLoop()
+{
+    while (!exitPending()) {
+        size_t frames;
+        {
+            Mutex::Autolock _l(mLock);
+            while (mPendingFrames == 0 && !exitPending()) {
+                mWorkCV.wait(mLock);
+            }
+            if (exitPending()) {
+                break;
+            }
+            frames = mPendingFrames;
+        }
+
+        // the buffer is not accessed by write() while frames are pending
+        ssize_t error = 0;
+        size_t written = 0;
+        while (written < frames) {
+            ATRACE_BEGIN("write");
+            const ssize_t ret = mSink->write((char *)mBuffer + written * mFrameSize,
+                    frames - written);
+            ATRACE_END();
+            if (ret <= 0) {
+                error = ret;
+                break;
+            }
+            written += ret;
+        }
+        ALOGW_IF(written < frames, "PipelinedWriteThread wrote %zu of %zu frames, error %zd",
+                written, frames, error);
+
+        Mutex::Autolock _l(mLock);
+        mPendingFrames = 0;
+        if (error < 0) {
+            mWriteError = error;
+        }
+        mIdleCV.broadcast();
+    }
+    // release waiters in write() and waitIdle()
+    Mutex::Autolock _l(mLock);
+    mPendingFrames = 0;
+    mIdleCV.broadcast();
+    return false;
+}
+
+ssize_t AudioFlinger::PipelinedWriteThread::write(const void *buffer, size_t frames)
+{
+    Mutex::Autolock _l(mLock);
+    while (mPendingFrames != 0) {
+        mIdleCV.wait(mLock);
+    }
+    if (mWriteError < 0) {
+        const ssize_t error = mWriteError;
+        mWriteError = 0;
+        return error;
+    }
+    if (mBuffer == NULL || exitPending()) {
+        return NO_INIT;
+    }
+    if (frames > mFrameCount) {
+        frames = mFrameCount;
+    }
+    memcpy(mBuffer, buffer, frames * mFrameSize);
+    mPendingFrames = frames;
+    mWorkCV.signal();
+    return frames;
+}
+
+void AudioFlinger::PipelinedWriteThread::waitIdle()
+{
+    Mutex::Autolock _l(mLock);
+    while (mPendingFrames != 0) {
+        mIdleCV.wait(mLock);
+    }
+}
+
+void AudioFlinger::PipelinedWriteThread::exit()
+{
+    ALOGV("PipelinedWriteThread::exit");
+    {
+        Mutex::Autolock _l(mLock);
+        requestExit();
+        mWorkCV.broadcast();
+    }
+    requestExitAndWait();
+}
+
 
 // ----------------------------------------------------------------------------
 AudioFlinger::OffloadThread::OffloadThread(const sp<AudioFlinger>& audioFlinger,
         AudioStreamOut* output, audio_io_handle_t id, uint32_t device, bool systemReady)
     :   DirectOutputThread(audioFlinger, output, id, device, OFFLOAD, systemReady),
         mPausedWriteLength(0), mPausedBytesRemaining(0), mKeepWakeLock(true),
+        mKeepWakeLockEarlyDrain(true), mEarlyDrain(false),
         mOffloadUnderrunPosition(~0LL)
 {
     //FIXME: mStandby should be set to true by ThreadBase constructor
     mStandby = true;
     mKeepWakeLock = property_get_bool("ro.audio.offload_wakelock", true /* default_value */);
+    mKeepWakeLockEarlyDrain = property_get_bool("ro.audio.offload_drain_wakelock",
+            true /* default_value */);
+}
+
+void AudioFlinger::OffloadThread::threadLoop_drain()
+{
+    mEarlyDrain = mMixerStatus == MIXER_DRAIN_TRACK;
+    PlaybackThread::threadLoop_drain();
 }
 
 void AudioFlinger::OffloadThread::threadLoop_exit()
@@ -5730,7 +6389,9 @@ AudioFlinger::DuplicatingThread::DuplicatingThread(const sp<AudioFlinger>& audio
         AudioFlinger::MixerThread* mainThread, audio_io_handle_t id, bool systemReady)
     :   MixerThread(audioFlinger, mainThread->getOutput(), id, mainThread->outDevice(),
                     systemReady, DUPLICATING),
-        mWaitTimeMs(UINT_MAX)
+        mWaitTimeMs(UINT_MAX),
+        mDropOnOverrun(property_get_bool("af.duplicating.drop_on_overrun",
+                false /* default_value */))
 {
     addOutputTrack(mainThread);
 }
@@ -5783,7 +6444,7 @@ void AudioFlinger::DuplicatingThread::threadLoop_sleepTime()
 ssize_t AudioFlinger::DuplicatingThread::threadLoop_write()
 {
     for (size_t i = 0; i < outputTracks.size(); i++) {
-        outputTracks[i]->write(mSinkBuffer, writeFrames);
+        outputTracks[i]->write(mSinkBuffer, writeFrames, mDropOnOverrun);
     }
     mStandby = false;
     return (ssize_t)mSinkBufferSize;
@@ -5891,6 +6552,17 @@ bool AudioFlinger::DuplicatingThread::outputsReady(
     return true;
 }
 
+void AudioFlinger::DuplicatingThread::dumpInternals(int fd, const Vector<String16>& args)
+{
+    MixerThread::dumpInternals(fd, args);
+
+    dprintf(fd, "  Drop on overrun: %s\n", mDropOnOverrun ? "yes" : "no");
+    for (size_t i = 0; i < mOutputTracks.size(); i++) {
+        dprintf(fd, "  Output track %p: %llu frames dropped\n", mOutputTracks[i].get(),
+                (unsigned long long) mOutputTracks[i]->framesDropped());
+    }
+}
+
 uint32_t AudioFlinger::DuplicatingThread::activeSleepTimeUs() const
 {
     return (mWaitTimeMs * 1000) / 2;
@@ -5936,6 +6608,7 @@ AudioFlinger::RecordThread::RecordThread(const sp<AudioFlinger>& audioFlinger,
     // mPipeMemory
     // mFastCaptureNBLogWriter
     , mFastTrackAvail(false)
+    , mDirectReadEnabled(property_get_bool("af.record.direct_read", true /* default_value */))
 {
     snprintf(mThreadName, kThreadNameLength, "AudioIn_%X", id);
     mNBLogWriter = audioFlinger->newWriter_l(kLogSize, mThreadName);
@@ -6100,6 +6773,10 @@ reacquire_wakelock:
     // used to request a deferred sleep, to be executed later while mutex is unlocked
     uint32_t sleepUs = 0;
 
+    // stage durations of a cycle that missed its deadline, logged next when mutex is locked
+    bool logDeadlineMiss = false;
+    nsecs_t missedCycleNs[ThreadCycleStats::STAGE_CNT];
+
     // loop while there is work to do
     for (;;) {
         Vector< sp<EffectChain> > effectChains;
@@ -6118,6 +6795,16 @@ reacquire_wakelock:
 
             processConfigEvents_l();
 
+            if (logDeadlineMiss) {
+                mNBLogWriter->logFormat("deadline miss: loop %lld us, convert %lld, effect %lld, "
+                        "read %lld",
+                        (long long) ns2us(missedCycleNs[ThreadCycleStats::STAGE_LOOP]),
+                        (long long) ns2us(missedCycleNs[ThreadCycleStats::STAGE_MIX]),
+                        (long long) ns2us(missedCycleNs[ThreadCycleStats::STAGE_EFFECT]),
+                        (long long) ns2us(missedCycleNs[ThreadCycleStats::STAGE_IO]));
+                logDeadlineMiss = false;
+            }
+
             // check exitPending here because checkForNewParameters_l() and
             // checkForNewParameters_l() can temporarily release mLock
             if (exitPending()) {
@@ -6127,7 +6814,11 @@ reacquire_wakelock:
             // sleep with mutex unlocked
             if (sleepUs > 0) {
                 ATRACE_BEGIN("sleepC");
-                mWaitWorkCV.waitRelative(mLock, microseconds((nsecs_t)sleepUs));
+                const nsecs_t sleepNs = microseconds((nsecs_t)sleepUs);
+                const nsecs_t sleepStartNs = systemTime();
+                if (mWaitWorkCV.waitRelative(mLock, sleepNs) == TIMED_OUT) {
+                    mWakeupLatency.add(systemTime() - sleepStartNs - sleepNs);
+                }
                 ATRACE_END();
                 sleepUs = 0;
                 continue;
@@ -6238,10 +6929,18 @@ reacquire_wakelock:
 
         // thread mutex is now unlocked, mActiveTracks unknown, activeTracks.size() > 0
 
+        // the stages of the cycle are timed from here, excluding waits for the mutex
+        mCycleStats.beginCycle();
+        nsecs_t readEndNs = 0;
+
         size_t size = effectChains.size();
-        for (size_t i = 0; i < size; i++) {
-            // thread mutex is not locked, but effect chain is locked
-            effectChains[i]->process_l();
+        if (size > 0) {
+            const nsecs_t effectStartNs = systemTime();
+            for (size_t i = 0; i < size; i++) {
+                // thread mutex is not locked, but effect chain is locked
+                effectChains[i]->process_l();
+            }
+            mCycleStats.addStage(ThreadCycleStats::STAGE_EFFECT, systemTime() - effectStartNs);
         }
 
         // Push a new fast capture state if fast capture is not already running, or cblk change
@@ -6298,12 +6997,18 @@ reacquire_wakelock:
 
         int32_t rear = mRsmpInRear & (mRsmpInFramesP2 - 1);
         ssize_t framesRead;
+        const nsecs_t readStartNs = systemTime();
+
+        // With a single normal client that needs no conversion, skip mRsmpInBuffer and the
+        // converter copy, and read straight into the client buffer.
+        const size_t framesToRead = mBufferSize / mFrameSize;
+        const sp<RecordTrack> directTrack = directReadTrack(activeTracks, framesToRead);
+        uint8_t *readDst = directTrack != 0 ? (uint8_t*)directTrack->mSink.raw :
+                (uint8_t*)mRsmpInBuffer + rear * mFrameSize;
 
         // If an NBAIO source is present, use it to read the normal capture's data
         if (mPipeSource != 0) {
-            size_t framesToRead = mBufferSize / mFrameSize;
-            framesRead = mPipeSource->read((uint8_t*)mRsmpInBuffer + rear * mFrameSize,
-                    framesToRead);
+            framesRead = mPipeSource->read(readDst, framesToRead);
             if (framesRead == 0) {
                 // since pipe is non-blocking, simulate blocking input
                 sleepUs = (framesToRead * 1000000LL) / mSampleRate;
@@ -6311,8 +7016,7 @@ reacquire_wakelock:
         // otherwise use the HAL / AudioStreamIn directly
         } else {
             ATRACE_BEGIN("read");
-            ssize_t bytesRead = mInput->stream->read(mInput->stream,
-                    (uint8_t*)mRsmpInBuffer + rear * mFrameSize, mBufferSize);
+            ssize_t bytesRead = mInput->stream->read(mInput->stream, readDst, mBufferSize);
             ATRACE_END();
             if (bytesRead < 0) {
                 framesRead = bytesRead;
@@ -6321,10 +7025,13 @@ reacquire_wakelock:
             }
         }
 
+        readEndNs = systemTime();
+        mCycleStats.addStage(ThreadCycleStats::STAGE_IO, readEndNs - readStartNs);
+
         // Update server timestamp with server stats
         // systemTime() is optional if the hardware supports timestamps.
         mTimestamp.mPosition[ExtendedTimestamp::LOCATION_SERVER] += framesRead;
-        mTimestamp.mTimeNs[ExtendedTimestamp::LOCATION_SERVER] = systemTime();
+        mTimestamp.mTimeNs[ExtendedTimestamp::LOCATION_SERVER] = readEndNs;
 
         // Update server timestamp with kernel stats
         if (mInput->stream->get_capture_position != nullptr
@@ -6356,7 +7063,18 @@ reacquire_wakelock:
         ALOG_ASSERT(framesRead > 0);
 
         if (mTeeSink != 0) {
-            (void) mTeeSink->write((uint8_t*)mRsmpInBuffer + rear * mFrameSize, framesRead);
+            (void) mTeeSink->write(readDst, framesRead);
+        }
+        if (directTrack != 0) {
+            // mRsmpInRear is left alone, so the track's buffer provider stays in sync
+            directTrack->mSink.frameCount = framesRead;
+            directTrack->releaseBuffer(&directTrack->mSink);
+            directTrack->clearOverflow();
+            directTrack->updateTrackFrameInfo(
+                    directTrack->mServerProxy->framesReleased(),
+                    mTimestamp.mPosition[ExtendedTimestamp::LOCATION_SERVER],
+                    mSampleRate, mTimestamp);
+            goto unlock;
         }
         // If destination is non-contiguous, we now correct for reading past end of buffer.
         {
@@ -6481,6 +7199,15 @@ reacquire_wakelock:
         }
 
 unlock:
+        // delivery to the tracks follows the read
+        mCycleStats.addStage(ThreadCycleStats::STAGE_MIX, systemTime() - readEndNs);
+        if (mCycleStats.endCycle() && !logDeadlineMiss) {
+            for (int i = 0; i < ThreadCycleStats::STAGE_CNT; ++i) {
+                missedCycleNs[i] = mCycleStats.lastCycleNs((ThreadCycleStats::Stage) i);
+            }
+            logDeadlineMiss = true;
+        }
+
         // enable changes in effect chain
         unlockEffectChains(effectChains);
         // effectChains doesn't need to be cleared, since it is cleared by destructor at scope end
@@ -6505,6 +7232,34 @@ unlock:
     return false;
 }
 
+sp<AudioFlinger::RecordThread::RecordTrack> AudioFlinger::RecordThread::directReadTrack(
+        const Vector< sp<RecordTrack> >& activeTracks, size_t frames)
+{
+    if (!mDirectReadEnabled || activeTracks.size() != 1) {
+        return 0;
+    }
+    const sp<RecordTrack>& track = activeTracks[0];
+    if (track->isFastTrack() || track->mFramesToDrop != 0 ||
+            track->mSampleRate != mSampleRate || track->mFormat != mFormat ||
+            track->mChannelMask != mChannelMask) {
+        return 0;
+    }
+    // frames already in mRsmpInBuffer must be delivered first, in order
+    size_t framesIn;
+    bool hasOverrun;
+    track->mResamplerBufferProvider->sync(&framesIn, &hasOverrun);
+    if (framesIn != 0) {
+        return 0;
+    }
+    // the HAL read size is fixed, so a full period must fit contiguously
+    track->mSink.frameCount = frames;
+    status_t status = track->getNextBuffer(&track->mSink);
+    if (status != OK || track->mSink.frameCount < frames) {
+        return 0;
+    }
+    return track;
+}
+
 void AudioFlinger::RecordThread::standbyIfNotAlreadyInStandby()
 {
     if (!mStandby) {
@@ -6887,6 +7642,7 @@ void AudioFlinger::RecordThread::dumpInternals(int fd, const Vector<String16>& a
     }
     dprintf(fd, "  Fast capture thread: %s\n", hasFastCapture() ? "yes" : "no");
     dprintf(fd, "  Fast track available: %s\n", mFastTrackAvail ? "yes" : "no");
+    dprintf(fd, "  Direct read: %s\n", mDirectReadEnabled ? "enabled" : "disabled");
 
     // Make a non-atomic copy of fast capture dump state so it won't change underneath us
     // while we are dumping it.  It may be inconsistent, but it won't mutate!
@@ -6895,6 +7651,9 @@ void AudioFlinger::RecordThread::dumpInternals(int fd, const Vector<String16>& a
     const FastCaptureDumpState *copy = new FastCaptureDumpState(mFastCaptureDumpState);
     copy->dump(fd);
     delete copy;
+    if (mFastCapture != 0) {
+        dumpThreadSchedStats(fd, mFastCapture->getTid());
+    }
 }
 
 void AudioFlinger::RecordThread::dumpTracks(int fd, const Vector<String16>& args __unused)
@@ -7462,6 +8221,7 @@ void AudioFlinger::RecordThread::readInputParameters_l()
     mFrameSize = audio_stream_in_frame_size(mInput->stream);
     mBufferSize = mInput->stream->common.get_buffer_size(&mInput->stream->common);
     mFrameCount = mBufferSize / mFrameSize;
+    mCycleStats.setPeriodNs(seconds(mFrameCount) / mSampleRate);
     // This is the formula for calculating the temporary buffer size.
     // With 7 HAL buffers, we can guarantee ability to down-sample the input by ratio of 6:1 to
     // 1 full output buffer, regardless of the alignment of the available input.
@@ -336,6 +336,9 @@ public:
                 // remove and effect module. Also removes the effect chain is this was the last
                 // effect
                 void removeEffect_l(const sp< EffectModule>& effect, bool release = false);
+                // select the sample format of the effect chain buffers before 'effect' is
+                // added, or after an effect was removed if 'effect' is 0
+    virtual     void checkEffectBufferFormat_l(const sp<EffectModule>& effect __unused) {}
                 // disconnect an effect handle from module and destroy module if last handle
                 void disconnectEffectHandle(EffectHandle *handle, bool unpinIfLast);
                 // detach all tracks connected to an auxiliary effect
@@ -481,6 +484,11 @@ protected:
                                         mSuspendedSessions;
                 static const size_t     kLogSize = 4 * 1024;
                 sp<NBLog::Writer>       mNBLogWriter;
+                // stage durations and deadline misses of the threadLoop() cycles, for dumpsys;
+                // deadline misses are also logged to mNBLogWriter
+                ThreadCycleStats        mCycleStats;
+                // lateness of the threadLoop() timed sleeps, for dumpsys
+                WakeupLatencyDump       mWakeupLatency;
                 bool                    mSystemReady;
                 bool                    mNotifiedBatteryStart;
                 ExtendedTimestamp       mTimestamp;
@@ -536,6 +544,8 @@ protected:
     virtual     void        threadLoop_standby();
     virtual     void        threadLoop_exit();
     virtual     void        threadLoop_removeTracks(const Vector< sp<Track> >& tracksToRemove);
+                // called without mLock after each write to the HAL
+    virtual     void        threadLoop_publishTimestamp() { }
 
                 // prepareTracks_l reads and writes mActiveTracks, and returns
                 // the pending set of tracks to remove via Vector 'tracksToRemove'.  The caller
@@ -578,7 +588,7 @@ public:
                 void        setStreamVolume(audio_stream_type_t stream, float value);
                 void        setStreamMute(audio_stream_type_t stream, bool muted);
 
-                float       streamVolume(audio_stream_type_t stream) const;
+                float       streamVolume(audio_stream_type_t stream);
 
                 sp<Track>   createTrack_l(
                                 const sp<AudioFlinger::Client>& client,
@@ -628,6 +638,7 @@ public:
 
                 virtual status_t addEffectChain_l(const sp<EffectChain>& chain);
                 virtual size_t removeEffectChain_l(const sp<EffectChain>& chain);
+                virtual void checkEffectBufferFormat_l(const sp<EffectModule>& effect);
                 virtual uint32_t hasAudioSession_l(audio_session_t sessionId) const;
                 virtual uint32_t getStrategyForSession_l(audio_session_t sessionId);
 
@@ -642,6 +653,10 @@ public:
     virtual     size_t      frameCount() const { return mNormalFrameCount; }
 
                 status_t    getTimestamp_l(AudioTimestamp& timestamp);
+                // Returns the timestamp last published by threadLoop() for DIRECT and OFFLOAD
+                // threads, without the thread lock; false if none or older than maxAgeNs.
+                bool        getPublishedTimestamp(AudioTimestamp& timestamp,
+                                                  nsecs_t maxAgeNs) const;
 
                 void        addPatchTrack(const sp<PatchTrack>& track);
                 void        deletePatchTrack(const sp<PatchTrack>& track);
@@ -707,9 +722,20 @@ protected:
     // Size of mEffectsBuffer in bytes: mNormalFrameCount * #channels * sampsize.
     size_t                          mEffectBufferSize;
 
-    // The audio format of mEffectsBuffer. Set to AUDIO_FORMAT_PCM_16_BIT only.
+    // The audio format of mEffectsBuffer and of the effect chain buffers:
+    // AUDIO_FORMAT_PCM_FLOAT on mixer threads when all effects can process float,
+    // AUDIO_FORMAT_PCM_16_BIT otherwise. mEffectBuffer is sized for float in both cases.
     audio_format_t                  mEffectBufferFormat;
 
+    // Set from property af.effect.float to allow float effect chains.
+    const bool                      mFloatEffectsEnabled;
+
+    // True while checkEffectBufferFormat_l() reattaches the effect chains.
+    bool                            mEffectBufferFormatChanging;
+
+    audio_format_t                  selectEffectBufferFormat_l(
+                                            const sp<EffectModule>& effect) const;
+
     // An internal flag set to true by MixerThread::prepareTracks_l()
     // when mEffectsBuffer contains valid data after mixing.
     //
@@ -790,6 +816,36 @@ private:
     virtual void dumpInternals(int fd, const Vector<String16>& args);
     void        dumpTracks(int fd, const Vector<String16>& args);
 
+    // Volume and mute changes from binder threads are posted to mParameterQueue and applied
+    // under mLock, by threadLoop() before prepareTracks_l() or by the poster if mLock is free,
+    // so that binder threads never wait for the mix to change a volume.
+    struct PlaybackParameter {
+        enum Type {
+            MASTER_VOLUME,
+            MASTER_MUTE,
+            STREAM_VOLUME,
+            STREAM_MUTE,
+        };
+        Type                mType;
+        audio_stream_type_t mStream;    // STREAM_VOLUME and STREAM_MUTE
+        float               mVolume;    // MASTER_VOLUME and STREAM_VOLUME
+        bool                mMute;      // MASTER_MUTE and STREAM_MUTE
+    };
+    static const size_t kParameterQueueSize = 64;
+
+    void        postParameter(const PlaybackParameter& parameter);
+    // returns true if a stream parameter was applied
+    bool        drainParameters_l();
+    bool        applyParameter_l(const PlaybackParameter& parameter);
+
+    ParameterQueue<PlaybackParameter, kParameterQueueSize> mParameterQueue;
+
+    struct PublishedTimestamp {
+        AudioTimestamp  mTimestamp;
+        nsecs_t         mPublishedNs;   // systemTime() when published
+    };
+    SeqlockValue<PublishedTimestamp> mPublishedTimestamp;  // written by threadLoop() only
+
     SortedVector< sp<Track> >       mTracks;
     stream_type_t                   mStreamTypes[AUDIO_STREAM_CNT];
     AudioStreamOut                  *mOutput;
@@ -849,6 +905,9 @@ private:
     // for async write callback in the thread loop before evaluating it
     bool                            mSignalPending;
     sp<AsyncCallbackThread>         mCallbackThread;
+    // If not 0, writes the normal mixer output to mOutputSink one period behind the mix,
+    // see PipelinedWriteThread. Only used by MixerThread when there is no fast mixer.
+    sp<PipelinedWriteThread>        mPipelinedWriter;
 
 private:
     // The HAL output sink is treated as non-blocking, but current implementation is blocking
@@ -873,6 +932,8 @@ public:
 protected:
                 // accessed by both binder threads and within threadLoop(), lock on mutex needed
                 unsigned    mFastTrackAvailMask;    // bit i set if fast track [i] is available
+                unsigned    mFastSubmixTrackAvailMask; // bit i set if fast track
+                                                    // [kSubmixFastIndexBase + i] is available
                 bool        mHwSupportsPause;
                 bool        mHwPaused;
                 bool        mFlushPending;
@@ -925,12 +986,24 @@ protected:
 
                 AudioMixer* mAudioMixer;    // normal mixer
 private:
+                // (re)creates mPipelinedWriter for the current sink buffer size if this
+                // output is configured for pipelined writes
+                void        updatePipelinedWriter_l();
+
                 // one-time initialization, no locks required
                 sp<FastMixer>     mFastMixer;     // non-0 if there is also a fast mixer
                 sp<AudioWatchdog> mAudioWatchdog; // non-0 if there is an audio watchdog thread
 
+                // Optional second fast mixer stage; it mixes the fast tracks with indices at or
+                // above FastMixerState::kSubmixFastIndexBase into mFastSubmixPipe, which is
+                // played by the primary fast mixer as fast track mFastSubmixIndex.
+                sp<FastMixer>     mFastSubmixer;  // non-0 if there is a submix stage
+                sp<NBAIO_Sink>    mFastSubmixPipe;
+                int               mFastSubmixIndex; // primary fast mixer slot for the submix
+
                 // contents are not guaranteed to be consistent, no locks required
                 FastMixerDumpState mFastMixerDumpState;
+                FastMixerDumpState mFastSubmixerDumpState;
 #ifdef STATE_QUEUE_DUMP
                 StateQueueObserverDump mStateQueueObserverDump;
                 StateQueueMutatorDump  mStateQueueMutatorDump;
@@ -940,11 +1013,33 @@ private:
                 // accessible only within the threadLoop(), no locks required
                 //          mFastMixer->sq()    // for mutating and pushing state
                 int32_t     mFastMixerFutex;    // for cold idle
+                int32_t     mFastSubmixerFutex; // for cold idle of mFastSubmixer
+                sp<NBLog::Writer> mFastSubmixerNBLogWriter;
 
                 std::atomic_bool mMasterMono;
+
+                // number of AudioMixer worker threads for parallel mixing, 0 if disabled.
+                // Initialized from system properties, may be overridden per output
+                // by the "mixer_workers" parameter.  Accessed only by the MixerThread.
+                uint32_t    mMixerWorkerCount;
+
+                // Adaptive resampler quality: the AudioMixer resampler quality cap is lowered
+                // when the mix takes too large a share of the period, and raised again after
+                // the load has stayed low.  Accessed only by the MixerThread.
+                void        updateResamplerQualityCap(nsecs_t mixNs);
+                bool        mAdaptiveResamplerQuality;      // from af.resampler.adaptive
+                AudioResampler::src_quality mResamplerQualityCap;
+                nsecs_t     mMixNsAverage;                  // smoothed AudioMixer::process() time
+                nsecs_t     mResamplerQualityChangeNs;      // time of the last cap change
+                nsecs_t     mLowMixLoadSinceNs;             // 0 if the mix load is not low
 public:
     virtual     bool        hasFastMixer() const { return mFastMixer != 0; }
     virtual     FastTrackUnderruns getFastTrackUnderruns(size_t fastIndex) const {
+                              if (fastIndex >= FastMixerState::kSubmixFastIndexBase) {
+                                  fastIndex -= FastMixerState::kSubmixFastIndexBase;
+                                  ALOG_ASSERT(fastIndex < FastMixerState::sMaxFastSubmixTracks);
+                                  return mFastSubmixerDumpState.mTracks[fastIndex].mUnderruns;
+                              }
                               ALOG_ASSERT(fastIndex < FastMixerState::sMaxFastTracks);
                               return mFastMixerDumpState.mTracks[fastIndex].mUnderruns;
                             }
@@ -989,6 +1084,7 @@ protected:
     virtual     void        threadLoop_mix();
     virtual     void        threadLoop_sleepTime();
     virtual     void        threadLoop_exit();
+    virtual     void        threadLoop_publishTimestamp();
     virtual     bool        shouldStandby_l();
 
     virtual     void        onAddNewTrack_l();
@@ -1023,17 +1119,26 @@ protected:
     // threadLoop snippets
     virtual     mixer_state prepareTracks_l(Vector< sp<Track> > *tracksToRemove);
     virtual     void        threadLoop_exit();
+    virtual     void        threadLoop_drain();
 
     virtual     bool        waitingAsyncCallback();
     virtual     bool        waitingAsyncCallback_l();
     virtual     void        invalidateTracks(audio_stream_type_t streamType);
 
-    virtual     bool        keepWakeLock() const { return (mKeepWakeLock || (mDrainSequence & 1)); }
+    // While waiting for an early drain callback (gapless transition to the next track),
+    // the HAL callback wakes the thread in time for the next track's data, so the wake lock
+    // may be dropped as for write callbacks.
+    virtual     bool        keepWakeLock() const {
+                                return mKeepWakeLock || ((mDrainSequence & 1) &&
+                                        (mKeepWakeLockEarlyDrain || !mEarlyDrain));
+                            }
 
 private:
     size_t      mPausedWriteLength;     // length in bytes of write interrupted by pause
     size_t      mPausedBytesRemaining;  // bytes still waiting in mixbuffer after resume
     bool        mKeepWakeLock;          // keep wake lock while waiting for write callback
+    bool        mKeepWakeLockEarlyDrain; // keep wake lock while waiting for early drain callback
+    bool        mEarlyDrain;            // the pending or last drain is AUDIO_DRAIN_EARLY_NOTIFY
     uint64_t    mOffloadUnderrunPosition; // Current frame position for offloaded playback
                                           // used and valid only during underrun.  ~0 if
                                           // no underrun has occurred during playback and
@@ -1075,6 +1180,43 @@ private:
     bool                       mAsyncError;
 };
 
+// PipelinedWriteThread performs the sink writes of a MixerThread that has no fast mixer,
+// so that the next period is mixed while the previous one is written to the HAL.
+// write() copies the period into the writer buffer and only blocks until the previous
+// write has completed: this adds one period of latency, but a HAL write taking up to
+// two periods does not make the mixer miss its deadline.
+class PipelinedWriteThread : public Thread {
+public:
+
+    PipelinedWriteThread(const sp<NBAIO_Sink>& sink, size_t frameSize, size_t frameCount);
+
+    virtual             ~PipelinedWriteThread();
+
+    // Thread virtuals
+    virtual bool        threadLoop();
+
+    // RefBase
+    virtual void        onFirstRef();
+
+            // Returns the number of frames accepted, or the error of the previous write.
+            ssize_t     write(const void *buffer, size_t frames);
+            // Waits until the pending write, if any, has completed.
+            void        waitIdle();
+            // Stops and joins the thread; must not be called by the thread itself.
+            void        exit();
+
+private:
+    const sp<NBAIO_Sink>    mSink;
+    const size_t            mFrameSize;
+    const size_t            mFrameCount;        // capacity of mBuffer in frames
+    void                    *mBuffer;
+    Mutex                   mLock;
+    Condition               mWorkCV;            // signaled when frames are pending
+    Condition               mIdleCV;            // signaled when the pending write completed
+    size_t                  mPendingFrames;     // frames of mBuffer not written yet
+    ssize_t                 mWriteError;        // error of the last write, reported by write()
+};
+
 class DuplicatingThread : public MixerThread {
 public:
     DuplicatingThread(const sp<AudioFlinger>& audioFlinger, MixerThread* mainThread,
@@ -1097,6 +1239,7 @@ protected:
     virtual     ssize_t     threadLoop_write();
     virtual     void        threadLoop_standby();
     virtual     void        cacheParameters_l();
+    virtual     void        dumpInternals(int fd, const Vector<String16>& args);
 
 private:
     // called from threadLoop, addOutputTrack, removeOutputTrack
@@ -1107,6 +1250,8 @@ protected:
 private:
 
                 uint32_t    mWaitTimeMs;
+    // output tracks drop what they cannot take instead of queueing overflow buffers
+    const       bool        mDropOnOverrun;
     SortedVector < sp<OutputTrack> >  outputTracks;
     SortedVector < sp<OutputTrack> >  mOutputTracks;
 public:
@@ -1350,6 +1495,11 @@ private:
             // Call the HAL standby method unconditionally, and don't change mStandby flag
             void    inputStandBy();
 
+            // Returns the only active track if the next read of frames can go straight into its
+            // buffer, with the buffer obtained in track->mSink, otherwise returns 0.
+            sp<RecordTrack> directReadTrack(const Vector< sp<RecordTrack> >& activeTracks,
+                                            size_t frames);
+
             AudioStreamIn                       *mInput;
             SortedVector < sp<RecordTrack> >    mTracks;
             // mActiveTracks has dual roles:  it indicates the current active track(s), and
@@ -1409,4 +1559,7 @@ private:
             sp<NBLog::Writer>                   mFastCaptureNBLogWriter;
 
             bool                                mFastTrackAvail;    // true if fast track available
+
+            // read directly into the client buffer when a single normal track matches the input
+            const bool                          mDirectReadEnabled;
 };
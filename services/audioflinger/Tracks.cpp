@@ -62,6 +62,9 @@ namespace android {
 
 static volatile int32_t nextTrackId = 55;
 
+// A published DIRECT or OFFLOAD thread timestamp older than this is queried again from the HAL
+static const nsecs_t kMaxPublishedTimestampAgeNs = 100 * 1000000LL;  // 100 ms
+
 // TrackBase constructor must be called with AudioFlinger::mLock held
 AudioFlinger::ThreadBase::TrackBase::TrackBase(
             ThreadBase *thread,
@@ -414,15 +417,23 @@ AudioFlinger::PlaybackThread::Track::Track(
         // race with setSyncEvent(). However, if we call it, we cannot properly start
         // static fast tracks (SoundPool) immediately after stopping.
         //mAudioTrackServerProxy->framesReadyIsCalledByMultipleThreads();
-        ALOG_ASSERT(thread->mFastTrackAvailMask != 0);
-        int i = __builtin_ctz(thread->mFastTrackAvailMask);
-        ALOG_ASSERT(0 < i && i < (int)FastMixerState::sMaxFastTracks);
+        ALOG_ASSERT(thread->mFastTrackAvailMask != 0 || thread->mFastSubmixTrackAvailMask != 0);
         // FIXME This is too eager.  We allocate a fast track index before the
         //       fast track becomes active.  Since fast tracks are a scarce resource,
         //       this means we are potentially denying other more important fast tracks from
         //       being created.  It would be better to allocate the index dynamically.
-        mFastIndex = i;
-        thread->mFastTrackAvailMask &= ~(1 << i);
+        if (thread->mFastTrackAvailMask != 0) {
+            int i = __builtin_ctz(thread->mFastTrackAvailMask);
+            ALOG_ASSERT(0 < i && i < (int)FastMixerState::sMaxFastTracks);
+            mFastIndex = i;
+            thread->mFastTrackAvailMask &= ~(1 << i);
+        } else {
+            // primary fast mixer is full, use the submix stage
+            int i = __builtin_ctz(thread->mFastSubmixTrackAvailMask);
+            ALOG_ASSERT(0 <= i && i < (int)FastMixerState::sMaxFastSubmixTracks);
+            mFastIndex = FastMixerState::kSubmixFastIndexBase + i;
+            thread->mFastSubmixTrackAvailMask &= ~(1 << i);
+        }
     }
 }
 
@@ -897,8 +908,13 @@ status_t AudioFlinger::PlaybackThread::Track::getTimestamp(AudioTimestamp& times
         return INVALID_OPERATION;
     }
 
-    Mutex::Autolock _l(thread->mLock);
+    // Serve high rate polling from the timestamp published by the thread loop, and only
+    // take the thread lock to query the HAL when that timestamp is missing or stale.
     PlaybackThread *playbackThread = (PlaybackThread *)thread.get();
+    if (playbackThread->getPublishedTimestamp(timestamp, kMaxPublishedTimestampAgeNs)) {
+        return NO_ERROR;
+    }
+    Mutex::Autolock _l(thread->mLock);
     return playbackThread->getTimestamp_l(timestamp);
 }
 
@@ -1146,6 +1162,15 @@ void AudioFlinger::PlaybackThread::Track::updateTrackFrameInfo(
     mServerProxy->setTimestamp(local);
 }
 
+void AudioFlinger::PlaybackThread::Track::publishTimestamp(const AudioTimestamp &timestamp)
+{
+    ExtendedTimestamp local;
+    local.mPosition[ExtendedTimestamp::LOCATION_KERNEL] = timestamp.mPosition;
+    local.mTimeNs[ExtendedTimestamp::LOCATION_KERNEL] =
+            timestamp.mTime.tv_sec * 1000000000LL + timestamp.mTime.tv_nsec;
+    mServerProxy->setTimestamp(local);
+}
+
 // ----------------------------------------------------------------------------
 
 AudioFlinger::PlaybackThread::OutputTrack::OutputTrack(
@@ -1160,7 +1185,7 @@ AudioFlinger::PlaybackThread::OutputTrack::OutputTrack(
               sampleRate, format, channelMask, frameCount,
               NULL, 0, AUDIO_SESSION_NONE, uid, AUDIO_OUTPUT_FLAG_NONE,
               TYPE_OUTPUT),
-    mActive(false), mSourceThread(sourceThread), mClientProxy(NULL)
+    mActive(false), mSourceThread(sourceThread), mClientProxy(NULL), mFramesDropped(0)
 {
 
     if (mCblk != NULL) {
@@ -1210,7 +1235,8 @@ void AudioFlinger::PlaybackThread::OutputTrack::stop()
     mActive = false;
 }
 
-bool AudioFlinger::PlaybackThread::OutputTrack::write(void* data, uint32_t frames)
+bool AudioFlinger::PlaybackThread::OutputTrack::write(void* data, uint32_t frames,
+                                                      bool dropOnOverrun)
 {
     Buffer *pInBuffer;
     Buffer inBuffer;
@@ -1284,8 +1310,13 @@ bool AudioFlinger::PlaybackThread::OutputTrack::write(void* data, uint32_t frame
         }
     }
 
-    // If we could not write all frames, allocate a buffer and queue it for next time.
-    if (inBuffer.frameCount) {
+    // If we could not write all frames, allocate a buffer and queue it for next time,
+    // unless the caller prefers losing them to adding latency.
+    if (inBuffer.frameCount && dropOnOverrun) {
+        mFramesDropped += inBuffer.frameCount;
+        ALOGV("OutputTrack::write() %p thread %p dropped %zu frames", this,
+                mThread.unsafe_get(), inBuffer.frameCount);
+    } else if (inBuffer.frameCount) {
         sp<ThreadBase> thread = mThread.promote();
         if (thread != 0 && !thread->standby()) {
             if (mBufferQueue.size() < kMaxOverFlowBuffers) {
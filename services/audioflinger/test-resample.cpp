@@ -36,12 +36,13 @@ using namespace android;
 static bool gVerbose = false;
 
 static int usage(const char* name) {
-    fprintf(stderr,"Usage: %s [-p] [-f] [-F] [-v] [-c channels]"
+    fprintf(stderr,"Usage: %s [-p] [-b] [-f] [-F] [-v] [-c channels]"
                    " [-q {dq|lq|mq|hq|vhq|dlq|dmq|dhq}]"
                    " [-i input-sample-rate] [-o output-sample-rate]"
                    " [-O csv] [-P csv] [<input-file>]"
                    " <output-file>\n", name);
     fprintf(stderr,"    -p    enable profiling\n");
+    fprintf(stderr,"    -b    benchmark ns/frame for each supported channel count\n");
     fprintf(stderr,"    -f    enable filter profiling\n");
     fprintf(stderr,"    -F    enable floating point -q {dlq|dmq|dhq} only");
     fprintf(stderr,"    -v    verbose : log buffer provider calls\n");
@@ -104,6 +105,7 @@ int parseCSV(const char *string, Vector<int>& values)
 int main(int argc, char* argv[]) {
     const char* const progname = argv[0];
     bool profileResample = false;
+    bool benchmarkChannels = false;
     bool profileFilter = false;
     bool useFloat = false;
     int channels = 1;
@@ -114,11 +116,14 @@ int main(int argc, char* argv[]) {
     Vector<int> Pvalues;
 
     int ch;
-    while ((ch = getopt(argc, argv, "pfFvc:q:i:o:O:P:")) != -1) {
+    while ((ch = getopt(argc, argv, "pbfFvc:q:i:o:O:P:")) != -1) {
         switch (ch) {
         case 'p':
             profileResample = true;
             break;
+        case 'b':
+            benchmarkChannels = true;
+            break;
         case 'f':
             profileFilter = true;
             break;
@@ -435,6 +440,64 @@ int main(int argc, char* argv[]) {
         resampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT, AudioResampler::UNITY_GAIN_FLOAT);
     }
 
+    if (benchmarkChannels) {
+        // Same measurement as profileResample, repeated for each channel count
+        // the quality supports, and reported as ns per output frame.
+        // The input for each channel count replicates the first input channel.
+        static const int kChannelCounts[] = { 1, 2, 4, 6, 8 };
+        const int maxChannels = quality < AudioResampler::DYN_LOW_QUALITY ? 2 : 8;
+        const size_t sampleSize = useFloat ? sizeof(float) : sizeof(int16_t);
+        const int trials = 4;
+        const int looplimit = 4;
+
+        for (size_t c = 0; c < sizeof(kChannelCounts) / sizeof(kChannelCounts[0]); ++c) {
+            const int bchannels = kChannelCounts[c];
+            if (bchannels > maxChannels) {
+                break;
+            }
+            const size_t bframesize = bchannels * sampleSize;
+            uint8_t* binput = (uint8_t*) malloc(input_frames * bframesize);
+            for (size_t i = 0; i < input_frames; ++i) {
+                for (int j = 0; j < bchannels; ++j) {
+                    memcpy(binput + (i * bchannels + j) * sampleSize,
+                            (const uint8_t*) input_vaddr + i * input_framesize, sampleSize);
+                }
+            }
+            Provider bprovider(binput, input_frames, bframesize, Pvalues);
+            const int boutputChannels = bchannels > 2 ? bchannels : 2;
+            void* boutput = malloc(output_frames * boutputChannels
+                    * (useFloat ? sizeof(float) : sizeof(int32_t)));
+            AudioResampler* bresampler = AudioResampler::create(format, bchannels,
+                    output_freq, quality);
+            bresampler->setSampleRate(input_freq);
+            bresampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT,
+                    AudioResampler::UNITY_GAIN_FLOAT);
+
+            timespec start, end;
+            int64_t time = 0;
+            for (int n = 0; n < trials; ++n) {
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for (int i = 0; i < looplimit; ++i) {
+                    bresampler->resample((int*) boutput, output_frames, &bprovider);
+                    bprovider.reset();
+                }
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                int64_t start_ns = start.tv_sec * 1000000000LL + start.tv_nsec;
+                int64_t end_ns = end.tv_sec * 1000000000LL + end.tv_nsec;
+                int64_t diff_ns = end_ns - start_ns;
+                if (n == 0 || diff_ns < time) {
+                    time = diff_ns;   // save the best out of our trials.
+                }
+            }
+            printf("quality: %d  channels: %d  ns/frame: %.2lf  ns/frame/channel: %.2lf\n",
+                    quality, bchannels, (double) time / (output_frames * looplimit),
+                    (double) time / (output_frames * looplimit) / bchannels);
+            delete bresampler;
+            free(boutput);
+            free(binput);
+        }
+    }
+
     memset(output_vaddr, 0, output_size);
     if (gVerbose) {
         printf("resample() %zu output frames\n", output_frames);
@@ -27,6 +27,31 @@ LOCAL_CFLAGS := -Werror -Wall
 
 include $(BUILD_NATIVE_TEST)
 
+#
+# mixer ops unit test
+#
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libutils \
+	libcutils \
+	libaudioutils
+
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils) \
+	frameworks/av/services/audioflinger
+
+LOCAL_SRC_FILES := \
+	mixerops_tests.cpp
+
+LOCAL_MODULE := mixerops_tests
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_CFLAGS := -Werror -Wall
+
+include $(BUILD_NATIVE_TEST)
+
 #
 # audio mixer test tool
 #
@@ -66,3 +91,43 @@ LOCAL_CXX_STL := libc++
 LOCAL_CFLAGS := -Werror -Wall
 
 include $(BUILD_EXECUTABLE)
+
+#
+# audio mixer and resampler benchmark
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	mixer_benchmark.cpp \
+	../AudioMixer.cpp.arm \
+	../BufferProviders.cpp
+
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-effects) \
+	$(call include-path-for, audio-utils) \
+	frameworks/av/services/audioflinger \
+	external/sonic
+
+LOCAL_STATIC_LIBRARIES := \
+	libsndfile
+
+LOCAL_SHARED_LIBRARIES := \
+	libeffects \
+	libnbaio \
+	libaudioresampler \
+	libaudioutils \
+	libdl \
+	libcutils \
+	libutils \
+	liblog \
+	libsonic
+
+LOCAL_MODULE:= mixer_benchmark
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CXX_STL := libc++
+
+LOCAL_CFLAGS := -Werror -Wall
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <vector>
+#include <audio_utils/primitives.h>
+#include <audio_utils/sndfile.h>
+#include <media/AudioBufferProvider.h>
+#include <utils/Timers.h>
+#include "AudioMixer.h"
+#include "AudioResampler.h"
+#include "test_utils.h"
+
+/* Offline benchmark of the AudioMixer and AudioResampler.
+ *
+ * Each configuration is run for a number of trials over the same synthetic input
+ * (a sine per track), and the best trial is reported, as ns per output frame and,
+ * where the kernel permits access to the cycle counter, CPU cycles per output frame.
+ * Pinning to a single cpu (-C) and fixing the cpu frequency makes runs comparable
+ * across builds and devices.
+ *
+ * The report is CSV by default, one line per configuration, or JSON with -j.
+ */
+
+// The FCC_2 macro refers to the Fixed Channel Count of 2 for the legacy integer mixer.
+#ifndef FCC_2
+#define FCC_2 2
+#endif
+
+using namespace android;
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-j] [-m] [-r] [-t trials] [-C cpu]\n", name);
+    fprintf(stderr, "    -j    report in JSON (default CSV)\n");
+    fprintf(stderr, "    -m    mixer sweep only\n");
+    fprintf(stderr, "    -r    resampler sweep only\n");
+    fprintf(stderr, "    -t    number of trials per configuration (default 5)\n");
+    fprintf(stderr, "    -C    pin the benchmark to this cpu\n");
+}
+
+static const uint32_t kSampleRate = 48000;       // mixer and resampler output rate
+static const uint32_t kResampleRate = 44100;     // track rate when resampling
+static const size_t kMixerFrameCount = 320;      // as test-mixer
+static const double kSeconds = 1.;               // input length per trial
+
+// Counts CPU cycles of this thread with perf_event_open(), if available.
+class CycleCounter {
+public:
+    CycleCounter() : mFd(-1) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        mFd = syscall(__NR_perf_event_open, &attr, 0 /*pid*/, -1 /*cpu*/,
+                -1 /*group_fd*/, 0 /*flags*/);
+    }
+    ~CycleCounter() {
+        if (mFd >= 0) {
+            close(mFd);
+        }
+    }
+    bool isValid() const { return mFd >= 0; }
+    void start() {
+        if (mFd >= 0) {
+            ioctl(mFd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(mFd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    // returns the cycles since start(), or -1 if not available.
+    int64_t stop() {
+        if (mFd < 0) {
+            return -1;
+        }
+        ioctl(mFd, PERF_EVENT_IOC_DISABLE, 0);
+        int64_t cycles;
+        if (read(mFd, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+            return -1;
+        }
+        return cycles;
+    }
+private:
+    int mFd;
+};
+
+struct Result {
+    const char *benchmark;   // "mixer" or "resampler"
+    uint32_t tracks;
+    uint32_t channels;       // track channels
+    bool useFloat;           // track format
+    int quality;             // AudioResampler::src_quality, -1 if not resampling
+    bool ramp;
+    double nsPerFrame;
+    double cyclesPerFrame;   // negative if not available
+};
+
+class Report {
+public:
+    explicit Report(bool json) : mJson(json), mCount(0) {
+        if (mJson) {
+            printf("[\n");
+        } else {
+            printf("benchmark,tracks,channels,format,quality,ramp,ns_per_frame,cycles_per_frame\n");
+        }
+    }
+    ~Report() {
+        if (mJson) {
+            printf("\n]\n");
+        }
+    }
+    void add(const Result &r) {
+        const char *format = r.useFloat ? "float" : "int16";
+        if (mJson) {
+            printf("%s  {\"benchmark\": \"%s\", \"tracks\": %u, \"channels\": %u,"
+                    " \"format\": \"%s\", \"quality\": %d, \"ramp\": %s,"
+                    " \"ns_per_frame\": %.3f, \"cycles_per_frame\": %.3f}",
+                    mCount == 0 ? "" : ",\n", r.benchmark, r.tracks, r.channels,
+                    format, r.quality, r.ramp ? "true" : "false",
+                    r.nsPerFrame, r.cyclesPerFrame);
+        } else {
+            printf("%s,%u,%u,%s,%d,%d,%.3f,%.3f\n", r.benchmark, r.tracks, r.channels,
+                    format, r.quality, r.ramp, r.nsPerFrame, r.cyclesPerFrame);
+        }
+        fflush(stdout);
+        ++mCount;
+    }
+private:
+    const bool mJson;
+    size_t mCount;
+};
+
+// Mixes tracks sine tracks of the given channel count and format into a stereo float
+// mix buffer, resampling each track from kResampleRate if resample is set.
+static void benchMixer(Report &report, int trials, uint32_t tracks, uint32_t channels,
+        bool useFloat, bool resample, bool ramp)
+{
+    const uint32_t trackRate = resample ? kResampleRate : kSampleRate;
+    const audio_format_t format = useFloat ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
+    const audio_channel_mask_t channelMask = audio_channel_out_mask_from_count(channels);
+    std::vector<SignalProvider> providers(tracks);
+    std::vector<int32_t> names(tracks);
+
+    float *out = NULL;
+    (void) posix_memalign((void **)&out, 32, kMixerFrameCount * FCC_2 * sizeof(float));
+    AudioMixer *mixer = new AudioMixer(kMixerFrameCount, kSampleRate);
+    for (uint32_t i = 0; i < tracks; ++i) {
+        // distinct frequencies so that tracks do not cancel or saturate identically.
+        const double freq = 440. * (i + 1);
+        if (useFloat) {
+            providers[i].setSine<float>(channels, freq, trackRate, kSeconds);
+        } else {
+            providers[i].setSine<int16_t>(channels, freq, trackRate, kSeconds);
+        }
+        names[i] = mixer->getTrackName(channelMask, format, AUDIO_SESSION_OUTPUT_MIX);
+        ALOG_ASSERT(names[i] >= 0);
+        mixer->setBufferProvider(names[i], &providers[i]);
+        mixer->setParameter(names[i], AudioMixer::TRACK, AudioMixer::MAIN_BUFFER, out);
+        mixer->setParameter(names[i], AudioMixer::TRACK, AudioMixer::MIXER_FORMAT,
+                (void *)(uintptr_t)AUDIO_FORMAT_PCM_FLOAT);
+        mixer->setParameter(names[i], AudioMixer::TRACK, AudioMixer::FORMAT,
+                (void *)(uintptr_t)format);
+        mixer->setParameter(names[i], AudioMixer::TRACK, AudioMixer::MIXER_CHANNEL_MASK,
+                (void *)(uintptr_t)AUDIO_CHANNEL_OUT_STEREO);
+        mixer->setParameter(names[i], AudioMixer::TRACK, AudioMixer::CHANNEL_MASK,
+                (void *)(uintptr_t)channelMask);
+        mixer->setParameter(names[i], AudioMixer::RESAMPLE, AudioMixer::SAMPLE_RATE,
+                (void *)(uintptr_t)trackRate);
+        mixer->enable(names[i]);
+    }
+
+    // leave a margin so that no track underruns during a trial.
+    const size_t cycles = (size_t)(kSeconds * kSampleRate) / kMixerFrameCount - 2;
+    const float volume = AudioMixer::UNITY_GAIN_FLOAT / tracks;
+    const float volumes[2] = { volume, volume * 0.5f };
+    CycleCounter counter;
+    int64_t bestNs = 0;
+    int64_t bestCycles = -1;
+    for (int n = 0; n < trials; ++n) {
+        for (uint32_t i = 0; i < tracks; ++i) {
+            providers[i].reset();
+            mixer->setParameter(names[i], AudioMixer::VOLUME, AudioMixer::VOLUME0,
+                    (void *)&volumes[0]);
+            mixer->setParameter(names[i], AudioMixer::VOLUME, AudioMixer::VOLUME1,
+                    (void *)&volumes[0]);
+        }
+        const nsecs_t startNs = systemTime();
+        counter.start();
+        for (size_t c = 0; c < cycles; ++c) {
+            if (ramp) {
+                // alternate the target volume so that every cycle ramps.
+                const float *v = &volumes[(c + 1) & 1];
+                for (uint32_t i = 0; i < tracks; ++i) {
+                    mixer->setParameter(names[i], AudioMixer::RAMP_VOLUME,
+                            AudioMixer::VOLUME0, (void *)v);
+                    mixer->setParameter(names[i], AudioMixer::RAMP_VOLUME,
+                            AudioMixer::VOLUME1, (void *)v);
+                }
+            }
+            mixer->process();
+        }
+        const int64_t elapsedCycles = counter.stop();
+        const int64_t elapsedNs = systemTime() - startNs;
+        if (n == 0 || elapsedNs < bestNs) {
+            bestNs = elapsedNs;   // save the best out of our trials.
+            bestCycles = elapsedCycles;
+        }
+    }
+    delete mixer;
+    free(out);
+
+    const size_t frames = cycles * kMixerFrameCount;
+    const Result r = { "mixer", tracks, channels, useFloat,
+            resample ? AudioResampler::DEFAULT_QUALITY : -1, ramp,
+            (double)bestNs / frames, bestCycles < 0 ? -1. : (double)bestCycles / frames };
+    report.add(r);
+}
+
+// Resamples a single sine of the given channel count and format from kResampleRate.
+static void benchResampler(Report &report, int trials, uint32_t channels, bool useFloat,
+        AudioResampler::src_quality quality)
+{
+    const audio_format_t format = useFloat ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
+    SignalProvider provider;
+    if (useFloat) {
+        provider.setSine<float>(channels, 1000., kResampleRate, kSeconds);
+    } else {
+        provider.setSine<int16_t>(channels, 1000., kResampleRate, kSeconds);
+    }
+    // output is at least stereo, in Q4.27 or float.
+    const size_t outChannels = channels > FCC_2 ? channels : FCC_2;
+    int32_t *out = NULL;
+    (void) posix_memalign((void **)&out, 32, kMixerFrameCount * outChannels * sizeof(int32_t));
+    AudioResampler *resampler = AudioResampler::create(format, channels, kSampleRate, quality);
+    resampler->setSampleRate(kResampleRate);
+    resampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT, AudioResampler::UNITY_GAIN_FLOAT);
+
+    const size_t cycles = (size_t)(kSeconds * kSampleRate) / kMixerFrameCount - 2;
+    CycleCounter counter;
+    int64_t bestNs = 0;
+    int64_t bestCycles = -1;
+    for (int n = 0; n < trials; ++n) {
+        provider.reset();
+        resampler->reset();
+        const nsecs_t startNs = systemTime();
+        counter.start();
+        for (size_t c = 0; c < cycles; ++c) {
+            memset(out, 0, kMixerFrameCount * outChannels * sizeof(int32_t));
+            resampler->resample(out, kMixerFrameCount, &provider);
+        }
+        const int64_t elapsedCycles = counter.stop();
+        const int64_t elapsedNs = systemTime() - startNs;
+        if (n == 0 || elapsedNs < bestNs) {
+            bestNs = elapsedNs;   // save the best out of our trials.
+            bestCycles = elapsedCycles;
+        }
+    }
+    delete resampler;
+    free(out);
+
+    const size_t frames = cycles * kMixerFrameCount;
+    const Result r = { "resampler", 1, channels, useFloat, quality, false,
+            (double)bestNs / frames, bestCycles < 0 ? -1. : (double)bestCycles / frames };
+    report.add(r);
+}
+
+int main(int argc, char* argv[]) {
+    const char* const progname = argv[0];
+    bool json = false;
+    bool runMixer = true;
+    bool runResampler = true;
+    int trials = 5;
+    int cpu = -1;
+
+    for (int ch; (ch = getopt(argc, argv, "jmrt:C:")) != -1;) {
+        switch (ch) {
+        case 'j':
+            json = true;
+            break;
+        case 'm':
+            runResampler = false;
+            break;
+        case 'r':
+            runMixer = false;
+            break;
+        case 't':
+            trials = atoi(optarg);
+            break;
+        case 'C':
+            cpu = atoi(optarg);
+            break;
+        case '?':
+        default:
+            usage(progname);
+            return EXIT_FAILURE;
+        }
+    }
+    if (trials <= 0) {
+        usage(progname);
+        return EXIT_FAILURE;
+    }
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0 /*pid*/, sizeof(set), &set) != 0) {
+            fprintf(stderr, "cannot pin to cpu %d: %s\n", cpu, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+    if (!CycleCounter().isValid()) {
+        fprintf(stderr, "cpu cycle counter not available, cycles_per_frame reported as -1\n");
+    }
+
+    Report report(json);
+    if (runMixer) {
+        static const uint32_t kTracks[] = { 1, 2, 4, 8, 16 };
+        static const uint32_t kChannels[] = { 1, 2, 6, 8 };
+        for (size_t t = 0; t < ARRAY_SIZE(kTracks); ++t) {
+            for (size_t c = 0; c < ARRAY_SIZE(kChannels); ++c) {
+                for (int useFloat = 0; useFloat < 2; ++useFloat) {
+                    for (int resample = 0; resample < 2; ++resample) {
+                        for (int ramp = 0; ramp < 2; ++ramp) {
+                            benchMixer(report, trials, kTracks[t], kChannels[c],
+                                    useFloat, resample, ramp);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (runResampler) {
+        static const uint32_t kChannels[] = { 1, 2, 4, 6, 8 };
+        static const AudioResampler::src_quality kQualities[] = {
+            AudioResampler::LOW_QUALITY,
+            AudioResampler::MED_QUALITY,
+            AudioResampler::HIGH_QUALITY,
+            AudioResampler::VERY_HIGH_QUALITY,
+            AudioResampler::DYN_LOW_QUALITY,
+            AudioResampler::DYN_MED_QUALITY,
+            AudioResampler::DYN_HIGH_QUALITY,
+        };
+        for (size_t q = 0; q < ARRAY_SIZE(kQualities); ++q) {
+            // only the dynamic resamplers support float and more than 2 channels.
+            const bool dynamic = kQualities[q] >= AudioResampler::DYN_LOW_QUALITY;
+            for (size_t c = 0; c < ARRAY_SIZE(kChannels); ++c) {
+                if (!dynamic && kChannels[c] > FCC_2) {
+                    continue;
+                }
+                for (int useFloat = 0; useFloat < (dynamic ? 2 : 1); ++useFloat) {
+                    benchResampler(report, trials, kChannels[c], useFloat, kQualities[q]);
+                }
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
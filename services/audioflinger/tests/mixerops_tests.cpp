@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audioflinger_mixerops_tests"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <cutils/log.h>
+#include <gtest/gtest.h>
+#include <audio_utils/primitives.h>
+#include "AudioMixerOps.h"
+#include "AudioMixerOpsSimd.h"
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(x) (sizeof(x)/sizeof((x)[0]))
+#endif
+
+using namespace android;
+
+/*
+ * Scalar reference of the MIXTYPE_MULTI (or MONOVOL) loop without aux,
+ * written out independently of AudioMixerOps.h so that any
+ * VolumeMixSimd specialization is compared against plain C.
+ */
+template <bool SAVEONLY, bool MONOVOL, typename TO, typename TI, typename TV>
+static void referenceMix(TO *out, size_t frameCount, size_t channels,
+        const TI *in, TV *vol, const TV *volinc, bool ramp)
+{
+    for (size_t f = 0; f < frameCount; ++f) {
+        for (size_t c = 0; c < channels; ++c) {
+            const TV v = vol[MONOVOL ? 0 : c];
+            const TO prod = MixMul<TO, TI, TV>(*in++, v);
+            if (SAVEONLY) {
+                *out++ = prod;
+            } else {
+                *out++ += prod;
+            }
+            if (ramp && !MONOVOL) {
+                vol[c] += volinc[c];
+            }
+        }
+        if (ramp && MONOVOL) {
+            vol[0] += volinc[0];
+        }
+    }
+}
+
+template <typename T>
+static void fillRandom(std::vector<T> &v, T scale) {
+    for (size_t i = 0; i < v.size(); ++i) {
+        v[i] = static_cast<T>((static_cast<float>(rand()) / RAND_MAX * 2 - 1) * scale);
+    }
+}
+
+template <int MIXTYPE, int NCHAN, bool SAVEONLY, bool MONOVOL>
+static void testFloat(size_t frameCount, bool ramp)
+{
+    const size_t samples = frameCount * NCHAN;
+    std::vector<float> in(samples);
+    std::vector<float> ref(samples);
+    fillRandom(in, 1.f);
+    fillRandom(ref, 1.f);
+    std::vector<float> test(ref);
+
+    float volRef[2] = { 0.30f, 0.85f };
+    const float volinc[2] = { 0.00017f, -0.00031f };
+    float volTest[2] = { volRef[0], volRef[1] };
+
+    referenceMix<SAVEONLY, MONOVOL>(&ref[0], frameCount, NCHAN, &in[0],
+            volRef, volinc, ramp);
+    if (ramp) {
+        volumeRampMulti<MIXTYPE, NCHAN>(&test[0], frameCount, &in[0],
+                (int32_t *)NULL, volTest, volinc, (int32_t *)NULL, (int32_t)0);
+    } else {
+        volumeMulti<MIXTYPE, NCHAN>(&test[0], frameCount, &in[0],
+                (int32_t *)NULL, volTest, (int16_t)0);
+    }
+    ASSERT_EQ(0, memcmp(&ref[0], &test[0], samples * sizeof(float)))
+            << "mixtype:" << MIXTYPE << " channels:" << NCHAN
+            << " frames:" << frameCount << " ramp:" << ramp;
+    ASSERT_EQ(0, memcmp(volRef, volTest, sizeof(volRef)));
+}
+
+static const size_t kFrameCounts[] = { 1, 2, 3, 5, 8, 63, 256, 1023 };
+
+TEST(audioflinger_mixerops, float_multi) {
+    for (size_t i = 0; i < ARRAY_SIZE(kFrameCounts); ++i) {
+        for (int ramp = 0; ramp < 2; ++ramp) {
+            testFloat<MIXTYPE_MULTI, 1, false, false>(kFrameCounts[i], ramp);
+            testFloat<MIXTYPE_MULTI, 2, false, false>(kFrameCounts[i], ramp);
+            testFloat<MIXTYPE_MULTI_SAVEONLY, 1, true, false>(kFrameCounts[i], ramp);
+            testFloat<MIXTYPE_MULTI_SAVEONLY, 2, true, false>(kFrameCounts[i], ramp);
+        }
+    }
+}
+
+TEST(audioflinger_mixerops, float_multi_monovol) {
+    for (size_t i = 0; i < ARRAY_SIZE(kFrameCounts); ++i) {
+        for (int ramp = 0; ramp < 2; ++ramp) {
+            testFloat<MIXTYPE_MULTI_MONOVOL, 3, false, true>(kFrameCounts[i], ramp);
+            testFloat<MIXTYPE_MULTI_MONOVOL, 4, false, true>(kFrameCounts[i], ramp);
+            testFloat<MIXTYPE_MULTI_MONOVOL, 6, false, true>(kFrameCounts[i], ramp);
+            testFloat<MIXTYPE_MULTI_MONOVOL, 8, false, true>(kFrameCounts[i], ramp);
+            testFloat<MIXTYPE_MULTI_SAVEONLY_MONOVOL, 6, true, true>(kFrameCounts[i], ramp);
+            testFloat<MIXTYPE_MULTI_SAVEONLY_MONOVOL, 8, true, true>(kFrameCounts[i], ramp);
+        }
+    }
+}
+
+TEST(audioflinger_mixerops, int16_stereo) {
+    for (size_t i = 0; i < ARRAY_SIZE(kFrameCounts); ++i) {
+        const size_t frameCount = kFrameCounts[i];
+        const size_t samples = frameCount * 2;
+        std::vector<int16_t> in(samples);
+        std::vector<int32_t> ref(samples);
+        fillRandom(in, (int16_t)32767);
+        fillRandom(ref, (int32_t)(1 << 26));
+        std::vector<int32_t> test(ref);
+
+        // U4.12 fixed volume
+        int16_t vol16[2] = { 0x0800, 0x1000 };
+        referenceMix<false, false>(&ref[0], frameCount, 2, &in[0],
+                vol16, (const int16_t *)NULL, false);
+        volumeMulti<MIXTYPE_MULTI, 2>(&test[0], frameCount, &in[0],
+                (int32_t *)NULL, vol16, (int16_t)0);
+        ASSERT_EQ(0, memcmp(&ref[0], &test[0], samples * sizeof(int32_t)));
+
+        // U4.28 volume ramp
+        int32_t volRef[2] = { 0x04000000, 0x10000000 };
+        const int32_t volinc[2] = { 0x1234, -0x2345 };
+        int32_t volTest[2] = { volRef[0], volRef[1] };
+        referenceMix<false, false>(&ref[0], frameCount, 2, &in[0],
+                volRef, volinc, true);
+        volumeRampMulti<MIXTYPE_MULTI, 2>(&test[0], frameCount, &in[0],
+                (int32_t *)NULL, volTest, volinc, (int32_t *)NULL, (int32_t)0);
+        ASSERT_EQ(0, memcmp(&ref[0], &test[0], samples * sizeof(int32_t)));
+        ASSERT_EQ(0, memcmp(volRef, volTest, sizeof(volRef)));
+    }
+}
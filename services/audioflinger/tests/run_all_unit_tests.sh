@@ -10,3 +10,4 @@ adb root && adb wait-for-device remount
 
 #adb shell /system/bin/resampler_tests
 adb shell /data/nativetest/resampler_tests/resampler_tests
+adb shell /data/nativetest/mixerops_tests/mixerops_tests
@@ -21,6 +21,7 @@
 #include <audio_utils/primitives.h>
 #include <audio_utils/sndfile.h>
 #include <media/AudioBufferProvider.h>
+#include <utils/Timers.h>
 #include "AudioMixer.h"
 #include "test_utils.h"
 
@@ -36,13 +37,14 @@
 using namespace android;
 
 static void usage(const char* name) {
-    fprintf(stderr, "Usage: %s [-f] [-m] [-c channels]"
+    fprintf(stderr, "Usage: %s [-f] [-m] [-c channels] [-w workers]"
                     " [-s sample-rate] [-o <output-file>] [-a <aux-buffer-file>] [-P csv]"
                     " (<input-file> | <command>)+\n", name);
     fprintf(stderr, "    -f    enable floating point input track by default\n");
     fprintf(stderr, "    -m    enable floating point mixer output\n");
     fprintf(stderr, "    -c    number of mixer output channels\n");
     fprintf(stderr, "    -s    mixer sample-rate\n");
+    fprintf(stderr, "    -w    number of mixer worker threads (default 0)\n");
     fprintf(stderr, "    -o    <output-file> WAV file, pcm16 (or float if -m specified)\n");
     fprintf(stderr, "    -a    <aux-buffer-file>\n");
     fprintf(stderr, "    -P    # frames provided per call to resample() in CSV format\n");
@@ -97,6 +99,7 @@ int main(int argc, char* argv[]) {
     bool useRamp = true;
     uint32_t outputSampleRate = 48000;
     uint32_t outputChannels = 2; // stereo for now
+    uint32_t workers = 0;
     std::vector<int> Pvalues;
     const char* outputFilename = NULL;
     const char* auxFilename = NULL;
@@ -104,7 +107,7 @@ int main(int argc, char* argv[]) {
     std::vector<SignalProvider> providers;
     std::vector<audio_format_t> formats;
 
-    for (int ch; (ch = getopt(argc, argv, "fmc:s:o:a:P:")) != -1;) {
+    for (int ch; (ch = getopt(argc, argv, "fmc:s:w:o:a:P:")) != -1;) {
         switch (ch) {
         case 'f':
             useInputFloat = true;
@@ -118,6 +121,9 @@ int main(int argc, char* argv[]) {
         case 's':
             outputSampleRate = atoi(optarg);
             break;
+        case 'w':
+            workers = atoi(optarg);
+            break;
         case 'o':
             outputFilename = optarg;
             break;
@@ -237,6 +243,7 @@ int main(int argc, char* argv[]) {
     // create the mixer.
     const size_t mixerFrameCount = 320; // typical numbers may range from 240 or 960
     AudioMixer *mixer = new AudioMixer(mixerFrameCount, outputSampleRate);
+    mixer->setWorkerCount(workers);
     audio_format_t mixerFormat = useMixerFloat
             ? AUDIO_FORMAT_PCM_FLOAT : AUDIO_FORMAT_PCM_16_BIT;
     float f = AudioMixer::UNITY_GAIN_FLOAT / providers.size(); // normalize volume by # tracks
@@ -297,6 +304,7 @@ int main(int argc, char* argv[]) {
     }
 
     // pump the mixer to process data.
+    const nsecs_t startNs = systemTime();
     size_t i;
     for (i = 0; i < outputFrames - mixerFrameCount; i += mixerFrameCount) {
         for (size_t j = 0; j < names.size(); ++j) {
@@ -310,6 +318,10 @@ int main(int argc, char* argv[]) {
         mixer->process();
     }
     outputFrames = i; // reset output frames to the data actually produced.
+    const nsecs_t elapsedNs = systemTime() - startNs;
+    printf("mixed %zu frames with %u workers in %lld ns (%.2f ns/frame)\n",
+            outputFrames, mixer->workerCount(), (long long)elapsedNs,
+            outputFrames > 0 ? (double)elapsedNs / outputFrames : 0.);
 
     // write to files
     writeFile(outputFilename, outputAddr,
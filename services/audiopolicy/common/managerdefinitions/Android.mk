@@ -36,7 +36,9 @@ LOCAL_C_INCLUDES := \
 
 ifeq ($(USE_XML_AUDIO_POLICY_CONF), 1)
 
-LOCAL_SRC_FILES += src/Serializer.cpp
+LOCAL_SRC_FILES += \
+    src/Serializer.cpp \
+    src/BinarySerializer.cpp
 
 LOCAL_STATIC_LIBRARIES += libxml2
 
@@ -65,3 +67,47 @@ LOCAL_CFLAGS := -Wall -Werror
 LOCAL_MODULE := libaudiopolicycomponents
 
 include $(BUILD_STATIC_LIBRARY)
+
+ifeq ($(USE_XML_AUDIO_POLICY_CONF), 1)
+
+# Build time compiler of audio_policy_configuration.xml into its binary form
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/audio_policy_config_compiler.cpp \
+    src/DeviceDescriptor.cpp \
+    src/AudioGain.cpp \
+    src/HwModule.cpp \
+    src/IOProfile.cpp \
+    src/AudioPort.cpp \
+    src/AudioProfile.cpp \
+    src/AudioRoute.cpp \
+    src/AudioCollections.cpp \
+    src/VolumeCurve.cpp \
+    src/TypeConverter.cpp \
+    src/Serializer.cpp \
+    src/BinarySerializer.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+    libxml2 \
+    libicuuc \
+    libicuuc_stubdata \
+    libutils \
+    libcutils \
+    liblog
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/include \
+    $(TOPDIR)frameworks/av/services/audiopolicy/common/include \
+    $(TOPDIR)frameworks/av/services/audiopolicy \
+    $(TOPDIR)frameworks/av/services/audiopolicy/utilities \
+    $(TOPDIR)external/libxml2/include \
+    $(TOPDIR)external/icu/icu4c/source/common
+
+LOCAL_CFLAGS := -Wall -Werror
+
+LOCAL_MODULE := audio_policy_config_compiler
+
+include $(BUILD_HOST_EXECUTABLE)
+
+endif #ifeq ($(USE_XML_AUDIO_POLICY_CONF), 1)
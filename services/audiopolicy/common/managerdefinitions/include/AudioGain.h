@@ -60,6 +60,9 @@ public:
 
     const struct audio_gain &getGain() const { return mGain; }
 
+    int getIndex() const { return mIndex; }
+    bool getUseInChannelMask() const { return mUseInChannelMask; }
+
 private:
     int               mIndex;
     struct audio_gain mGain;
@@ -56,6 +56,8 @@ public:
         }
     }
 
+    const VolumeCurvesCollection *getVolumes() const { return mVolumeCurves; }
+
     void setHwModules(const HwModuleCollection &hwModules)
     {
         mHwModules = hwModules;
@@ -85,6 +87,8 @@ public:
         mIsSpeakerDrcEnabled = isSpeakerDrcEnabled;
     }
 
+    bool isSpeakerDrcEnabled() const { return mIsSpeakerDrcEnabled; }
+
     const HwModuleCollection getHwModules() const { return mHwModules; }
 
     const DeviceVector &getAvailableInputDevices() const
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "AudioPolicyConfig.h"
+#include <utils/Errors.h>
+#include <string>
+#include <vector>
+
+namespace android {
+
+/**
+ * Compact binary form of the XML audio policy configuration.
+ *
+ * The binary configuration is produced at build time by audio_policy_config_compiler from
+ * audio_policy_configuration.xml and its included files, and is read back at boot from an mmap
+ * of the file, without libxml2.  It records the path, size and checksum of each XML source it
+ * was compiled from: deserialize() fails, so that the caller can fall back to the XML,
+ * if any of the sources on the device does not match, or if the file is missing or malformed.
+ *
+ * Modules (with their mix ports, device ports, gains and routes), attached and default
+ * devices, volume curves and the global configuration are covered, i.e. everything
+ * populated into AudioPolicyConfig by PolicySerializer.
+ */
+class PolicyBinarySerializer
+{
+public:
+    /** An XML file the binary configuration was compiled from. */
+    struct Source
+    {
+        std::string mDevicePath; /**< path of the file on the device, checked at load time. */
+        std::string mHostPath;   /**< path of the file read at compile time. */
+    };
+
+    status_t serialize(const char *binaryFile, const AudioPolicyConfig &config,
+                       const std::vector<Source> &sources);
+
+    status_t deserialize(const char *binaryFile, AudioPolicyConfig &config);
+
+private:
+    static const uint32_t gMagic;   /**< "APCB" */
+    static const uint32_t gVersion; /**< version of the binary format. */
+};
+
+}; // namespace android
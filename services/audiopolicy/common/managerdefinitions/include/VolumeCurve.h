@@ -56,14 +56,24 @@ public:
     device_category getDeviceCategory() const { return mDeviceCategory; }
     audio_stream_type_t getStreamType() const { return mStreamType; }
 
-    void add(const CurvePoint &point) { mCurvePoints.add(point); }
+    void add(const CurvePoint &point)
+    {
+        mCurvePoints.add(point);
+        mDbPerCurveIndex.clear();
+    }
+    const SortedVector<CurvePoint> &getCurvePoints() const { return mCurvePoints; }
 
     float volIndexToDb(int indexInUi, int volIndexMin, int volIndexMax) const;
 
     void dump(int fd) const;
 
 private:
+    // interpolation of the curve points at a volume index of the curve
+    float curveIndexToDb(int volIdx) const;
+
     SortedVector<CurvePoint> mCurvePoints;
+    // attenuation in dB for each volume index of the curve, built on first use
+    mutable Vector<float> mDbPerCurveIndex;
     device_category mDeviceCategory;
     audio_stream_type_t mStreamType;
 };
@@ -0,0 +1,585 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "APM::BinarySerializer"
+//#define LOG_NDEBUG 0
+
+#include "BinarySerializer.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+
+using std::string;
+
+namespace android {
+
+const uint32_t PolicyBinarySerializer::gMagic = 0x42435041; // "APCB", little endian
+const uint32_t PolicyBinarySerializer::gVersion = 1;
+
+// Flags of a serialized AudioProfile
+static const uint8_t kDynamicFormat = 1 << 0;
+static const uint8_t kDynamicChannels = 1 << 1;
+static const uint8_t kDynamicRate = 1 << 2;
+
+static const int32_t kNoDefaultOutputDevice = -1;
+
+// FNV-1a, good enough to detect a configuration file changed after the binary was compiled
+static uint32_t checksum(const uint8_t *data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool checksumFile(const char *path, uint32_t &size, uint32_t &sum)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    string content;
+    char buffer[4096];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+        content.append(buffer, count);
+    }
+    close(fd);
+    if (count < 0) {
+        return false;
+    }
+    size = content.size();
+    sum = checksum((const uint8_t *)content.data(), content.size());
+    return true;
+}
+
+/** Appends little endian fields to a buffer. */
+class BinaryWriter
+{
+public:
+    void writeU8(uint8_t value) { mData.push_back((char)value); }
+    void writeU32(uint32_t value)
+    {
+        for (int i = 0; i < 4; i++) {
+            mData.push_back((char)(value >> (8 * i)));
+        }
+    }
+    void writeI32(int32_t value) { writeU32((uint32_t)value); }
+    void writeString(const char *value)
+    {
+        size_t length = strlen(value);
+        writeU32(length);
+        mData.append(value, length);
+    }
+
+    const string &data() const { return mData; }
+
+private:
+    string mData;
+};
+
+/** Reads little endian fields from a mapped file; any read past the end sets an error. */
+class BinaryReader
+{
+public:
+    BinaryReader(const uint8_t *data, size_t size) : mData(data), mSize(size), mOffset(0),
+            mError(false) {}
+
+    uint8_t readU8()
+    {
+        if (!check(1)) {
+            return 0;
+        }
+        return mData[mOffset++];
+    }
+    uint32_t readU32()
+    {
+        if (!check(4)) {
+            return 0;
+        }
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= (uint32_t)mData[mOffset++] << (8 * i);
+        }
+        return value;
+    }
+    int32_t readI32() { return (int32_t)readU32(); }
+    String8 readString()
+    {
+        uint32_t length = readU32();
+        if (!check(length)) {
+            return String8("");
+        }
+        String8 value((const char *)&mData[mOffset], length);
+        mOffset += length;
+        return value;
+    }
+    /** Element count of a collection, each element being at least elementSize bytes. */
+    uint32_t readCount(size_t elementSize)
+    {
+        uint32_t count = readU32();
+        if (!mError && count > (mSize - mOffset) / elementSize) {
+            mError = true;
+        }
+        return mError ? 0 : count;
+    }
+
+    bool hasError() const { return mError; }
+    bool atEnd() const { return mOffset == mSize; }
+
+private:
+    bool check(size_t size)
+    {
+        if (mError || size > mSize - mOffset) {
+            mError = true;
+            return false;
+        }
+        return true;
+    }
+
+    const uint8_t *mData;
+    const size_t mSize;
+    size_t mOffset;
+    bool mError;
+};
+
+static void writeProfiles(BinaryWriter &writer, AudioProfileVector &profiles)
+{
+    writer.writeU32(profiles.size());
+    for (size_t i = 0; i < profiles.size(); i++) {
+        const sp<AudioProfile> &profile = profiles[i];
+        writer.writeU32(profile->getFormat());
+        writer.writeU8((profile->isDynamicFormat() ? kDynamicFormat : 0) |
+                       (profile->isDynamicChannels() ? kDynamicChannels : 0) |
+                       (profile->isDynamicRate() ? kDynamicRate : 0));
+        const ChannelsVector &channels = profile->getChannels();
+        writer.writeU32(channels.size());
+        for (size_t j = 0; j < channels.size(); j++) {
+            writer.writeU32(channels[j]);
+        }
+        const SampleRateVector &rates = profile->getSampleRates();
+        writer.writeU32(rates.size());
+        for (size_t j = 0; j < rates.size(); j++) {
+            writer.writeU32(rates[j]);
+        }
+    }
+}
+
+static AudioProfileVector readProfiles(BinaryReader &reader)
+{
+    AudioProfileVector profiles;
+    uint32_t count = reader.readCount(13);
+    for (uint32_t i = 0; i < count && !reader.hasError(); i++) {
+        audio_format_t format = (audio_format_t)reader.readU32();
+        uint8_t flags = reader.readU8();
+        ChannelsVector channels;
+        uint32_t channelCount = reader.readCount(4);
+        for (uint32_t j = 0; j < channelCount; j++) {
+            channels.add((audio_channel_mask_t)reader.readU32());
+        }
+        SampleRateVector rates;
+        uint32_t rateCount = reader.readCount(4);
+        for (uint32_t j = 0; j < rateCount; j++) {
+            rates.add(reader.readU32());
+        }
+        sp<AudioProfile> profile = new AudioProfile(format, channels, rates);
+        profile->setDynamicFormat(flags & kDynamicFormat);
+        profile->setDynamicChannels(flags & kDynamicChannels);
+        profile->setDynamicRate(flags & kDynamicRate);
+        profiles.add(profile);
+    }
+    return profiles;
+}
+
+static void writeGains(BinaryWriter &writer, const AudioGainCollection &gains)
+{
+    writer.writeU32(gains.size());
+    for (size_t i = 0; i < gains.size(); i++) {
+        const sp<AudioGain> &gain = gains[i];
+        writer.writeI32(gain->getIndex());
+        writer.writeU8(gain->getUseInChannelMask());
+        writer.writeU32(gain->getMode());
+        writer.writeU32(gain->getChannelMask());
+        writer.writeI32(gain->getMinValueInMb());
+        writer.writeI32(gain->getMaxValueInMb());
+        writer.writeI32(gain->getDefaultValueInMb());
+        writer.writeU32(gain->getStepValueInMb());
+        writer.writeU32(gain->getMinRampInMs());
+        writer.writeU32(gain->getMaxRampInMs());
+    }
+}
+
+static AudioGainCollection readGains(BinaryReader &reader)
+{
+    AudioGainCollection gains;
+    uint32_t count = reader.readCount(37);
+    for (uint32_t i = 0; i < count && !reader.hasError(); i++) {
+        int index = reader.readI32();
+        bool useInChannelMask = reader.readU8();
+        sp<AudioGain> gain = new AudioGain(index, useInChannelMask);
+        gain->setMode((audio_gain_mode_t)reader.readU32());
+        gain->setChannelMask((audio_channel_mask_t)reader.readU32());
+        gain->setMinValueInMb(reader.readI32());
+        gain->setMaxValueInMb(reader.readI32());
+        gain->setDefaultValueInMb(reader.readI32());
+        gain->setStepValueInMb(reader.readU32());
+        gain->setMinRampInMs(reader.readU32());
+        gain->setMaxRampInMs(reader.readU32());
+        gains.add(gain);
+    }
+    return gains;
+}
+
+static void writeMixPorts(BinaryWriter &writer, const IOProfileCollection &mixPorts)
+{
+    for (size_t i = 0; i < mixPorts.size(); i++) {
+        const sp<IOProfile> &mixPort = mixPorts[i];
+        writer.writeString(mixPort->getName().string());
+        writer.writeU32(mixPort->getRole());
+        writer.writeU32(mixPort->getFlags());
+        writeProfiles(writer, mixPort->getAudioProfiles());
+        writeGains(writer, mixPort->getGains());
+    }
+}
+
+static void writeModule(BinaryWriter &writer, const sp<HwModule> &module,
+                        const AudioPolicyConfig &config)
+{
+    writer.writeString(module->getName());
+    writer.writeU32(module->getHalVersion());
+
+    writer.writeU32(module->getOutputProfiles().size() + module->getInputProfiles().size());
+    writeMixPorts(writer, module->getOutputProfiles());
+    writeMixPorts(writer, module->getInputProfiles());
+
+    const DeviceVector &devicePorts = module->getDeclaredDevices();
+    writer.writeU32(devicePorts.size());
+    for (size_t i = 0; i < devicePorts.size(); i++) {
+        const sp<DeviceDescriptor> &devicePort = devicePorts[i];
+        writer.writeString(devicePort->getTagName().string());
+        writer.writeU32(devicePort->type());
+        writer.writeString(devicePort->mAddress.string());
+        writeProfiles(writer, devicePort->getAudioProfiles());
+        writeGains(writer, devicePort->getGains());
+    }
+
+    const AudioRouteVector &routes = module->getRoutes();
+    writer.writeU32(routes.size());
+    for (size_t i = 0; i < routes.size(); i++) {
+        const sp<AudioRoute> &route = routes[i];
+        writer.writeU32(route->getType());
+        writer.writeString(route->getSink()->getTagName().string());
+        const AudioPortVector &sources = route->getSources();
+        writer.writeU32(sources.size());
+        for (size_t j = 0; j < sources.size(); j++) {
+            writer.writeString(sources[j]->getTagName().string());
+        }
+    }
+
+    // Attached devices are the declared devices that ended up in the available devices,
+    // stored by index in the declared devices
+    std::vector<uint32_t> attached;
+    for (size_t i = 0; i < devicePorts.size(); i++) {
+        const DeviceVector &available = audio_is_output_device(devicePorts[i]->type()) ?
+                config.getAvailableOutputDevices() : config.getAvailableInputDevices();
+        for (size_t j = 0; j < available.size(); j++) {
+            if (available[j] == devicePorts[i]) {
+                attached.push_back(i);
+                break;
+            }
+        }
+    }
+    writer.writeU32(attached.size());
+    for (size_t i = 0; i < attached.size(); i++) {
+        writer.writeU32(attached[i]);
+    }
+}
+
+static sp<HwModule> readModule(BinaryReader &reader, DeviceVector &attachedDevices,
+                               Vector<sp<DeviceDescriptor> > &devicePorts)
+{
+    String8 name = reader.readString();
+    uint32_t halVersion = reader.readU32();
+    sp<HwModule> module = new HwModule(name.string(), halVersion);
+
+    IOProfileCollection mixPorts;
+    uint32_t mixPortCount = reader.readCount(20);
+    for (uint32_t i = 0; i < mixPortCount && !reader.hasError(); i++) {
+        String8 mixPortName = reader.readString();
+        audio_port_role_t role = (audio_port_role_t)reader.readU32();
+        uint32_t flags = reader.readU32();
+        sp<IOProfile> mixPort = new IOProfile(mixPortName, role);
+        mixPort->setAudioProfiles(readProfiles(reader));
+        mixPort->setFlags(flags);
+        mixPort->setGains(readGains(reader));
+        mixPorts.add(mixPort);
+    }
+    module->setProfiles(mixPorts);
+
+    DeviceVector declaredDevices;
+    uint32_t devicePortCount = reader.readCount(20);
+    for (uint32_t i = 0; i < devicePortCount && !reader.hasError(); i++) {
+        String8 tagName = reader.readString();
+        audio_devices_t type = (audio_devices_t)reader.readU32();
+        sp<DeviceDescriptor> devicePort = new DeviceDescriptor(type, tagName);
+        devicePort->mAddress = reader.readString();
+        devicePort->setAudioProfiles(readProfiles(reader));
+        devicePort->setGains(readGains(reader));
+        declaredDevices.add(devicePort);
+        devicePorts.add(devicePort);
+    }
+    module->setDeclaredDevices(declaredDevices);
+
+    AudioRouteVector routes;
+    uint32_t routeCount = reader.readCount(12);
+    for (uint32_t i = 0; i < routeCount && !reader.hasError(); i++) {
+        sp<AudioRoute> route = new AudioRoute((audio_route_type_t)reader.readU32());
+        sp<AudioPort> sink = module->findPortByTagName(reader.readString());
+        AudioPortVector sources;
+        uint32_t sourceCount = reader.readCount(4);
+        for (uint32_t j = 0; j < sourceCount; j++) {
+            sp<AudioPort> source = module->findPortByTagName(reader.readString());
+            if (source == 0) {
+                ALOGE("%s: no route source in module %s", __FUNCTION__, name.string());
+                return 0;
+            }
+            sources.add(source);
+        }
+        if (sink == 0 || reader.hasError()) {
+            ALOGE("%s: no route sink in module %s", __FUNCTION__, name.string());
+            return 0;
+        }
+        route->setSink(sink);
+        sink->addRoute(route);
+        for (size_t j = 0; j < sources.size(); j++) {
+            sources[j]->addRoute(route);
+        }
+        route->setSources(sources);
+        routes.add(route);
+    }
+    module->setRoutes(routes);
+
+    uint32_t attachedCount = reader.readCount(4);
+    for (uint32_t i = 0; i < attachedCount; i++) {
+        uint32_t index = reader.readU32();
+        if (index >= devicePorts.size()) {
+            ALOGE("%s: invalid attached device in module %s", __FUNCTION__, name.string());
+            return 0;
+        }
+        attachedDevices.add(devicePorts[index]);
+    }
+    return reader.hasError() ? 0 : module;
+}
+
+status_t PolicyBinarySerializer::serialize(const char *binaryFile, const AudioPolicyConfig &config,
+                                           const std::vector<Source> &sources)
+{
+    BinaryWriter writer;
+    writer.writeU32(gMagic);
+    writer.writeU32(gVersion);
+
+    writer.writeU32(sources.size());
+    for (size_t i = 0; i < sources.size(); i++) {
+        uint32_t size, sum;
+        if (!checksumFile(sources[i].mHostPath.c_str(), size, sum)) {
+            ALOGE("%s: could not read %s", __FUNCTION__, sources[i].mHostPath.c_str());
+            return BAD_VALUE;
+        }
+        writer.writeString(sources[i].mDevicePath.c_str());
+        writer.writeU32(size);
+        writer.writeU32(sum);
+    }
+
+    writer.writeU8(config.isSpeakerDrcEnabled());
+
+    const HwModuleCollection modules = config.getHwModules();
+    writer.writeU32(modules.size());
+    int32_t defaultModule = kNoDefaultOutputDevice;
+    uint32_t defaultDevice = 0;
+    for (size_t i = 0; i < modules.size(); i++) {
+        writeModule(writer, modules[i], config);
+        const DeviceVector &devicePorts = modules[i]->getDeclaredDevices();
+        for (size_t j = 0; j < devicePorts.size(); j++) {
+            if (defaultModule == kNoDefaultOutputDevice &&
+                    devicePorts[j] == config.getDefaultOutputDevice()) {
+                defaultModule = i;
+                defaultDevice = j;
+            }
+        }
+    }
+    writer.writeI32(defaultModule);
+    writer.writeU32(defaultDevice);
+
+    std::vector<sp<VolumeCurve> > curves;
+    const VolumeCurvesCollection *volumes = config.getVolumes();
+    if (volumes != nullptr) {
+        for (size_t i = 0; i < volumes->size(); i++) {
+            const VolumeCurvesForStream &curvesForStream = volumes->valueAt(i);
+            for (size_t j = 0; j < curvesForStream.size(); j++) {
+                curves.push_back(curvesForStream.valueAt(j));
+            }
+        }
+    }
+    writer.writeU32(curves.size());
+    for (size_t i = 0; i < curves.size(); i++) {
+        writer.writeU32(curves[i]->getStreamType());
+        writer.writeU32(curves[i]->getDeviceCategory());
+        const SortedVector<CurvePoint> &points = curves[i]->getCurvePoints();
+        writer.writeU32(points.size());
+        for (size_t j = 0; j < points.size(); j++) {
+            writer.writeU32(points[j].mIndex);
+            writer.writeI32(points[j].mAttenuationInMb);
+        }
+    }
+
+    std::ofstream out(binaryFile, std::ios::out | std::ios::binary | std::ios::trunc);
+    out.write(writer.data().data(), writer.data().size());
+    out.close();
+    if (!out) {
+        ALOGE("%s: could not write %s", __FUNCTION__, binaryFile);
+        return BAD_VALUE;
+    }
+    return NO_ERROR;
+}
+
+status_t PolicyBinarySerializer::deserialize(const char *binaryFile, AudioPolicyConfig &config)
+{
+    int fd = open(binaryFile, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGV("%s: no binary configuration %s", __FUNCTION__, binaryFile);
+        return NAME_NOT_FOUND;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return BAD_VALUE;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        ALOGE("%s: could not map %s", __FUNCTION__, binaryFile);
+        return BAD_VALUE;
+    }
+    BinaryReader reader((const uint8_t *)map, st.st_size);
+
+    status_t status = NO_ERROR;
+    HwModuleCollection modules;
+    DeviceVector attachedDevices;
+    sp<DeviceDescriptor> defaultOutputDevice;
+    VolumeCurvesCollection volumes;
+    bool speakerDrcEnabled = false;
+
+    if (reader.readU32() != gMagic || reader.readU32() != gVersion) {
+        ALOGE("%s: %s is not a binary configuration of version %u", __FUNCTION__, binaryFile,
+              gVersion);
+        status = BAD_VALUE;
+        goto exit;
+    }
+
+    // The binary configuration is only valid for the exact XML files it was compiled from
+    {
+        uint32_t sourceCount = reader.readCount(12);
+        for (uint32_t i = 0; i < sourceCount && status == NO_ERROR; i++) {
+            String8 path = reader.readString();
+            uint32_t expectedSize = reader.readU32();
+            uint32_t expectedSum = reader.readU32();
+            uint32_t size, sum;
+            if (reader.hasError() || !checksumFile(path.string(), size, sum) ||
+                    size != expectedSize || sum != expectedSum) {
+                ALOGW("%s: %s is stale with respect to %s", __FUNCTION__, binaryFile,
+                      path.string());
+                status = BAD_VALUE;
+            }
+        }
+    }
+    if (status != NO_ERROR) {
+        goto exit;
+    }
+
+    speakerDrcEnabled = reader.readU8();
+
+    {
+        Vector<Vector<sp<DeviceDescriptor> > > devicePorts;
+        uint32_t moduleCount = reader.readCount(24);
+        for (uint32_t i = 0; i < moduleCount; i++) {
+            devicePorts.add();
+            sp<HwModule> module = readModule(reader, attachedDevices, devicePorts.editTop());
+            if (module == 0) {
+                status = BAD_VALUE;
+                goto exit;
+            }
+            modules.add(module);
+        }
+        int32_t defaultModule = reader.readI32();
+        uint32_t defaultDevice = reader.readU32();
+        if (defaultModule != kNoDefaultOutputDevice) {
+            if (defaultModule < 0 || (size_t)defaultModule >= devicePorts.size() ||
+                    defaultDevice >= devicePorts[defaultModule].size()) {
+                status = BAD_VALUE;
+                goto exit;
+            }
+            defaultOutputDevice = devicePorts[defaultModule][defaultDevice];
+        }
+    }
+
+    {
+        uint32_t curveCount = reader.readCount(12);
+        for (uint32_t i = 0; i < curveCount && !reader.hasError(); i++) {
+            uint32_t stream = reader.readU32();
+            device_category category = (device_category)reader.readU32();
+            if (stream >= AUDIO_STREAM_CNT) {
+                status = BAD_VALUE;
+                goto exit;
+            }
+            sp<VolumeCurve> curve = new VolumeCurve(category, (audio_stream_type_t)stream);
+            uint32_t pointCount = reader.readCount(8);
+            for (uint32_t j = 0; j < pointCount; j++) {
+                uint32_t index = reader.readU32();
+                curve->add(CurvePoint(index, reader.readI32()));
+            }
+            volumes.add(curve);
+        }
+    }
+
+    if (reader.hasError() || !reader.atEnd()) {
+        ALOGE("%s: %s is truncated or malformed", __FUNCTION__, binaryFile);
+        status = BAD_VALUE;
+        goto exit;
+    }
+
+    // Only populate the configuration once the whole file has been read,
+    // so that a failure leaves it untouched for the XML fallback
+    config.setHwModules(modules);
+    for (size_t i = 0; i < attachedDevices.size(); i++) {
+        config.addAvailableDevice(attachedDevices[i]);
+    }
+    if (defaultOutputDevice != 0) {
+        config.setDefaultOutputDevice(defaultOutputDevice);
+    }
+    config.setVolumes(volumes);
+    config.setSpeakerDrcEnabled(speakerDrcEnabled);
+    ALOGV("%s: loaded %zu modules from %s", __FUNCTION__, modules.size(), binaryFile);
+
+exit:
+    munmap(map, st.st_size);
+    return status;
+}
+
+}; // namespace android
@@ -31,6 +31,24 @@ float VolumeCurve::volIndexToDb(int indexInUi, int volIndexMin, int volIndexMax)
     int nbSteps = 1 + mCurvePoints[nbCurvePoints - 1].mIndex - mCurvePoints[0].mIndex;
     int volIdx = (nbSteps * (indexInUi - volIndexMin)) / (volIndexMax - volIndexMin);
 
+    // The curve only changes at load time, so interpolate each of its indices once
+    int lastIndex = mCurvePoints[nbCurvePoints - 1].mIndex;
+    if (volIdx < 0 || volIdx > lastIndex) {
+        return curveIndexToDb(volIdx);
+    }
+    if (mDbPerCurveIndex.isEmpty()) {
+        mDbPerCurveIndex.setCapacity(lastIndex + 1);
+        for (int i = 0; i <= lastIndex; i++) {
+            mDbPerCurveIndex.add(curveIndexToDb(i));
+        }
+    }
+    return mDbPerCurveIndex[volIdx];
+}
+
+float VolumeCurve::curveIndexToDb(int volIdx) const
+{
+    size_t nbCurvePoints = mCurvePoints.size();
+
     // Where would this volume index been inserted in the curve point
     size_t indexInUiPosition = mCurvePoints.orderOf(CurvePoint(volIdx, 0));
     if (indexInUiPosition >= nbCurvePoints) {
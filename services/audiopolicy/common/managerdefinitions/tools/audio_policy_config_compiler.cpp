@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiles audio_policy_configuration.xml into the binary form loaded by PolicyBinarySerializer.
+//
+// usage: audio_policy_config_compiler [-d <device dir>] <output.bin> <config.xml> [<included.xml>...]
+//
+// Every XML file is recorded in the output with the path it will have on the device,
+// <device dir>/<file name> (by default /system/etc), so that the binary configuration is
+// ignored at boot if any of them was changed after it was compiled.
+
+#include <BinarySerializer.h>
+#include <Serializer.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace android;
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-d <device dir>] <output.bin> <config.xml> [<included.xml>...]\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    std::string deviceDir = "/system/etc";
+    int opt;
+    while ((opt = getopt(argc, argv, "d:")) != -1) {
+        switch (opt) {
+        case 'd':
+            deviceDir = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *output = argv[optind];
+
+    std::vector<PolicyBinarySerializer::Source> sources;
+    for (int i = optind + 1; i < argc; i++) {
+        PolicyBinarySerializer::Source source;
+        const char *fileName = strrchr(argv[i], '/');
+        source.mDevicePath = deviceDir + "/" + (fileName != NULL ? fileName + 1 : argv[i]);
+        source.mHostPath = argv[i];
+        sources.push_back(source);
+    }
+
+    HwModuleCollection hwModules;
+    DeviceVector availableOutputDevices;
+    DeviceVector availableInputDevices;
+    sp<DeviceDescriptor> defaultOutputDevice;
+    bool speakerDrcEnabled = false;
+    VolumeCurvesCollection volumes;
+    AudioPolicyConfig config(hwModules, availableOutputDevices, availableInputDevices,
+                             defaultOutputDevice, speakerDrcEnabled, &volumes);
+
+    PolicySerializer serializer;
+    if (serializer.deserialize(argv[optind + 1], config) != NO_ERROR) {
+        fprintf(stderr, "%s: could not parse %s\n", argv[0], argv[optind + 1]);
+        return 1;
+    }
+    PolicyBinarySerializer binarySerializer;
+    if (binarySerializer.serialize(output, config, sources) != NO_ERROR) {
+        fprintf(stderr, "%s: could not write %s\n", argv[0], output);
+        return 1;
+    }
+    return 0;
+}
@@ -45,6 +45,7 @@ Engine::Engine()
     for (int i = 0; i < AUDIO_POLICY_FORCE_USE_CNT; i++) {
         mForceUse[i] = AUDIO_POLICY_FORCE_NONE;
     }
+    invalidateRoutingCache();
 }
 
 Engine::~Engine()
@@ -55,6 +56,7 @@ void Engine::setObserver(AudioPolicyManagerObserver *observer)
 {
     ALOG_ASSERT(observer != NULL, "Invalid Audio Policy Manager observer");
     mApmObserver = observer;
+    invalidateRoutingCache();
 }
 
 status_t Engine::initCheck()
@@ -79,6 +81,7 @@ status_t Engine::setPhoneState(audio_mode_t state)
     // store previous phone state for management of sonification strategy below
     int oldState = mPhoneState;
     mPhoneState = state;
+    invalidateRoutingCache();
 
     if (!is_state_in_call(oldState) && is_state_in_call(state)) {
         ALOGV("  Entering call in setPhoneState()");
@@ -93,6 +96,8 @@ status_t Engine::setPhoneState(audio_mode_t state)
 
 status_t Engine::setForceUse(audio_policy_force_use_t usage, audio_policy_forced_cfg_t config)
 {
+    invalidateRoutingCache();
+
     switch(usage) {
     case AUDIO_POLICY_FORCE_FOR_COMMUNICATION:
         if (config != AUDIO_POLICY_FORCE_SPEAKER && config != AUDIO_POLICY_FORCE_BT_SCO &&
@@ -229,6 +234,27 @@ routing_strategy Engine::getStrategyForUsage(audio_usage_t usage)
     }
 }
 
+bool Engine::isRoutingCacheable(routing_strategy strategy, audio_devices_t availableOutputDevices)
+{
+    switch (strategy) {
+    case STRATEGY_SONIFICATION_RESPECTFUL:
+    case STRATEGY_ACCESSIBILITY:
+        // depend on stream and output activity
+        return false;
+    default:
+        // remote submix routing depends on the device address, not only its type
+        return (strategy >= 0) && (strategy < NUM_STRATEGIES) &&
+                ((availableOutputDevices & AUDIO_DEVICE_OUT_REMOTE_SUBMIX) == 0);
+    }
+}
+
+void Engine::invalidateRoutingCache()
+{
+    for (int i = 0; i < NUM_STRATEGIES; i++) {
+        mRoutingCache[i].mValid = false;
+    }
+}
+
 audio_devices_t Engine::getDeviceForStrategy(routing_strategy strategy) const
 {
     DeviceVector availableOutputDevices = mApmObserver->getAvailableOutputDevices();
@@ -236,8 +262,26 @@ audio_devices_t Engine::getDeviceForStrategy(routing_strategy strategy) const
 
     const SwAudioOutputCollection &outputs = mApmObserver->getOutputs();
 
-    return getDeviceForStrategyInt(strategy, availableOutputDevices,
-                                   availableInputDevices, outputs);
+    if (!isRoutingCacheable(strategy, availableOutputDevices.types())) {
+        return getDeviceForStrategyInt(strategy, availableOutputDevices,
+                                       availableInputDevices, outputs);
+    }
+
+    RoutingCacheEntry &entry = mRoutingCache[strategy];
+    const bool a2dpOutput = outputs.getA2dpOutput() != 0;
+    if (entry.mValid &&
+            entry.mAvailableOutputDevices == availableOutputDevices.types() &&
+            entry.mAvailableInputDevices == availableInputDevices.types() &&
+            entry.mA2dpOutput == a2dpOutput) {
+        return entry.mDevice;
+    }
+    entry.mDevice = getDeviceForStrategyInt(strategy, availableOutputDevices,
+                                            availableInputDevices, outputs);
+    entry.mAvailableOutputDevices = availableOutputDevices.types();
+    entry.mAvailableInputDevices = availableInputDevices.types();
+    entry.mA2dpOutput = a2dpOutput;
+    entry.mValid = true;
+    return entry.mDevice;
 }
 
 
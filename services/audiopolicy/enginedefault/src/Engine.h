@@ -90,6 +90,7 @@ private:
         virtual status_t setDeviceConnectionState(const sp<DeviceDescriptor> /*devDesc*/,
                                                   audio_policy_dev_state_t /*state*/)
         {
+            mPolicyEngine->invalidateRoutingCache();
             return NO_ERROR;
         }
     private:
@@ -130,12 +131,31 @@ private:
                                             DeviceVector availableInputDevices,
                                             const SwAudioOutputCollection &outputs) const;
     audio_devices_t getDeviceForInputSource(audio_source_t inputSource) const;
+
+    /**
+     * Routing decisions that do not depend on stream activity are memoized per strategy,
+     * and reused while the available devices and the presence of an A2DP output are unchanged.
+     * The cache is cleared whenever phone state, forced use or device connection state change.
+     */
+    struct RoutingCacheEntry {
+        bool mValid;
+        audio_devices_t mAvailableOutputDevices;
+        audio_devices_t mAvailableInputDevices;
+        bool mA2dpOutput;
+        audio_devices_t mDevice;
+    };
+    static bool isRoutingCacheable(routing_strategy strategy,
+                                   audio_devices_t availableOutputDevices);
+    void invalidateRoutingCache();
+
     audio_mode_t mPhoneState;  /**< current phone state. */
 
     /** current forced use configuration. */
     audio_policy_forced_cfg_t mForceUse[AUDIO_POLICY_FORCE_USE_CNT];
 
     AudioPolicyManagerObserver *mApmObserver;
+
+    mutable RoutingCacheEntry mRoutingCache[NUM_STRATEGIES];
 };
 } // namespace audio_policy
 } // namespace android
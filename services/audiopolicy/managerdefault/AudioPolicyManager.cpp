@@ -25,6 +25,8 @@
 #endif
 
 #define AUDIO_POLICY_XML_CONFIG_FILE "/system/etc/audio_policy_configuration.xml"
+// Compiled from AUDIO_POLICY_XML_CONFIG_FILE by audio_policy_config_compiler, optional
+#define AUDIO_POLICY_BINARY_CONFIG_FILE "/system/etc/audio_policy_configuration.bin"
 
 #include <inttypes.h>
 #include <math.h>
@@ -44,6 +46,7 @@
 #include <StreamDescriptor.h>
 #endif
 #include <Serializer.h>
+#include <BinarySerializer.h>
 #include "TypeConverter.h"
 #include <policy.h>
 
@@ -3207,8 +3210,10 @@ AudioPolicyManager::AudioPolicyManager(AudioPolicyClientInterface *clientInterfa
     AudioPolicyConfig config(mHwModules, mAvailableOutputDevices, mAvailableInputDevices,
                              mDefaultOutputDevice, speakerDrcEnabled,
                              static_cast<VolumeCurvesCollection *>(mVolumeCurves));
+    PolicyBinarySerializer binarySerializer;
     PolicySerializer serializer;
-    if (serializer.deserialize(AUDIO_POLICY_XML_CONFIG_FILE, config) != NO_ERROR) {
+    if ((binarySerializer.deserialize(AUDIO_POLICY_BINARY_CONFIG_FILE, config) != NO_ERROR) &&
+            (serializer.deserialize(AUDIO_POLICY_XML_CONFIG_FILE, config) != NO_ERROR)) {
 #else
     mVolumeCurves = new StreamDescriptorCollection();
     AudioPolicyConfig config(mHwModules, mAvailableOutputDevices, mAvailableInputDevices,
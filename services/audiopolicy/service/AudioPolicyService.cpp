@@ -499,9 +499,43 @@ bool AudioPolicyService::AudioCommandThread::threadLoop()
                     }break;
                 case SET_PARAMETERS: {
                     ParametersData *data = (ParametersData *)command->mParam.get();
+                    // Bundle the parameters of the following due commands for the same I/O
+                    // handle into a single transaction: keys of a later command replace the
+                    // same keys of an earlier one, as they would have if sent one by one.
+                    Vector < sp<AudioCommand> > bundledCommands;
+                    AudioParameter param = AudioParameter(data->mKeyValuePairs);
+                    while (!mAudioCommands.isEmpty() &&
+                            mAudioCommands[0]->mTime <= curTime &&
+                            mAudioCommands[0]->mCommand == SET_PARAMETERS) {
+                        ParametersData *data2 = (ParametersData *)mAudioCommands[0]->mParam.get();
+                        if (data2->mIO != data->mIO) {
+                            break;
+                        }
+                        AudioParameter param2 = AudioParameter(data2->mKeyValuePairs);
+                        for (size_t j = 0; j < param2.size(); j++) {
+                            String8 key;
+                            String8 value;
+                            param2.getAt(j, key, value);
+                            param.remove(key);
+                            param.add(key, value);
+                        }
+                        bundledCommands.add(mAudioCommands[0]);
+                        mAudioCommands.removeAt(0);
+                    }
+                    String8 keyValuePairs = bundledCommands.isEmpty() ?
+                            data->mKeyValuePairs : param.toString();
                     ALOGV("AudioCommandThread() processing set parameters string %s, io %d",
-                            data->mKeyValuePairs.string(), data->mIO);
-                    command->mStatus = AudioSystem::setParameters(data->mIO, data->mKeyValuePairs);
+                            keyValuePairs.string(), data->mIO);
+                    command->mStatus = AudioSystem::setParameters(data->mIO, keyValuePairs);
+                    for (size_t j = 0; j < bundledCommands.size(); j++) {
+                        sp<AudioCommand> command2 = bundledCommands[j];
+                        Mutex::Autolock _l(command2->mLock);
+                        command2->mStatus = command->mStatus;
+                        if (command2->mWaitStatus) {
+                            command2->mWaitStatus = false;
+                            command2->mCond.signal();
+                        }
+                    }
                     }break;
                 case SET_VOICE_VOLUME: {
                     VoiceVolumeData *data = (VoiceVolumeData *)command->mParam.get();
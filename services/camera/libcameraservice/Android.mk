@@ -52,6 +52,7 @@ LOCAL_SRC_FILES :=  \
     gui/RingBufferConsumer.cpp \
     utils/CameraTraces.cpp \
     utils/AutoConditionLock.cpp \
+    utils/LatencyHistogram.cpp \
     utils/TagMonitor.cpp
 
 LOCAL_SHARED_LIBRARIES:= \
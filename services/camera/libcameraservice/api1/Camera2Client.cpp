@@ -361,6 +361,8 @@ status_t Camera2Client::dumpClient(int fd, const Vector<String16>& args) {
 
     mCaptureSequencer->dump(fd, args);
 
+    mJpegProcessor->dump(fd, args);
+
     mFrameProcessor->dump(fd, args);
 
     mZslProcessor->dump(fd, args);
@@ -1251,6 +1253,13 @@ void Camera2Client::releaseRecordingFrameHandle(native_handle_t *handle) {
     ALOGW("%s: Not supported in buffer queue mode.", __FUNCTION__);
 }
 
+void Camera2Client::releaseRecordingFrameHandleBatch(
+        const std::vector<native_handle_t*>& handles) {
+    (void)handles;
+    ATRACE_CALL();
+    ALOGW("%s: Not supported in buffer queue mode.", __FUNCTION__);
+}
+
 status_t Camera2Client::autoFocus() {
     ATRACE_CALL();
     Mutex::Autolock icl(mBinderSerializationLock);
@@ -1493,6 +1502,14 @@ status_t Camera2Client::setParameters(const String8& params) {
 
     SharedParameters::Lock l(mParameters);
 
+    // Apps commonly pass back what getParameters() returned, unchanged; parsing
+    // it again would give the same parameters, and rebuilding the requests
+    // would only restart streaming.
+    if (params == l.mParameters.paramsFlattened) {
+        ALOGV("%s: Camera %d: Parameters unchanged", __FUNCTION__, mCameraId);
+        return OK;
+    }
+
     Parameters::focusMode_t focusModeBefore = l.mParameters.focusMode;
     res = l.mParameters.set(params);
     if (res != OK) return res;
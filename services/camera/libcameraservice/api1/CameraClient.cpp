@@ -522,6 +522,13 @@ void CameraClient::releaseRecordingFrameHandle(native_handle_t *handle) {
     mHardware->releaseRecordingFrame(dataPtr);
 }
 
+void CameraClient::releaseRecordingFrameHandleBatch(
+        const std::vector<native_handle_t*>& handles) {
+    for (size_t i = 0; i < handles.size(); i++) {
+        releaseRecordingFrameHandle(handles[i]);
+    }
+}
+
 status_t CameraClient::setVideoBufferMode(int32_t videoBufferMode) {
     LOG1("setVideoBufferMode: %d", videoBufferMode);
     bool enableMetadataInBuffers = false;
@@ -18,6 +18,7 @@
 #define ATRACE_TAG ATRACE_TAG_CAMERA
 //#define LOG_NDEBUG 0
 
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
 #include <gui/Surface.h>
@@ -38,7 +39,13 @@ CallbackProcessor::CallbackProcessor(sp<Camera2Client> client):
         mId(client->getCameraId()),
         mCallbackAvailable(false),
         mCallbackToApp(false),
-        mCallbackStreamId(NO_STREAM) {
+        mCallbackStreamId(NO_STREAM),
+        mCallbackHeapCount(kMinCallbackHeapCount) {
+    int32_t heapCount = property_get_int32("camera.callback.heap-count",
+            kMinCallbackHeapCount);
+    if (heapCount > static_cast<int32_t>(kMinCallbackHeapCount)) {
+        mCallbackHeapCount = heapCount;
+    }
 }
 
 CallbackProcessor::~CallbackProcessor() {
@@ -113,7 +120,7 @@ status_t CallbackProcessor::updateStream(const Parameters &params) {
         sp<IGraphicBufferProducer> producer;
         sp<IGraphicBufferConsumer> consumer;
         BufferQueue::createBufferQueue(&producer, &consumer);
-        mCallbackConsumer = new CpuConsumer(consumer, kCallbackHeapCount);
+        mCallbackConsumer = new CpuConsumer(consumer, kMinCallbackHeapCount);
         mCallbackConsumer->setFrameAvailableListener(this);
         mCallbackConsumer->setName(String8("Camera2-CallbackConsumer"));
         mCallbackWindow = new Surface(producer);
@@ -370,10 +377,10 @@ status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client) {
                 imgBuffer.width, imgBuffer.height,
                 previewFormat, destYStride);
         size_t currentBufferSize = (mCallbackHeap == 0) ?
-                0 : (mCallbackHeap->mHeap->getSize() / kCallbackHeapCount);
+                0 : (mCallbackHeap->mHeap->getSize() / mCallbackHeapCount);
         if (bufferSize != currentBufferSize) {
             mCallbackHeap.clear();
-            mCallbackHeap = new Camera2Heap(bufferSize, kCallbackHeapCount,
+            mCallbackHeap = new Camera2Heap(bufferSize, mCallbackHeapCount,
                     "Camera2Client::CallbackHeap");
             if (mCallbackHeap->mHeap->getSize() == 0) {
                 ALOGE("%s: Camera %d: Unable to allocate memory for callbacks",
@@ -383,7 +390,7 @@ status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client) {
             }
 
             mCallbackHeapHead = 0;
-            mCallbackHeapFree = kCallbackHeapCount;
+            mCallbackHeapFree = mCallbackHeapCount;
         }
 
         if (mCallbackHeapFree == 0) {
@@ -395,7 +402,7 @@ status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client) {
 
         heapIdx = mCallbackHeapHead;
 
-        mCallbackHeapHead = (mCallbackHeapHead + 1) % kCallbackHeapCount;
+        mCallbackHeapHead = (mCallbackHeapHead + 1) % mCallbackHeapCount;
         mCallbackHeapFree--;
 
         // TODO: Get rid of this copy by passing the gralloc queue all the way
@@ -465,10 +472,16 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
     // Copy Y plane, adjusting for stride
     const uint8_t *ySrc = src.data;
     uint8_t *yDst = dst;
-    for (size_t row = 0; row < src.height; row++) {
-        memcpy(yDst, ySrc, src.width);
-        ySrc += src.stride;
-        yDst += dstYStride;
+    if (src.stride == dstYStride) {
+        // Same layout, copy the plane at once
+        memcpy(yDst, ySrc, src.stride * src.height);
+        yDst += dstYStride * src.height;
+    } else {
+        for (size_t row = 0; row < src.height; row++) {
+            memcpy(yDst, ySrc, src.width);
+            ySrc += src.stride;
+            yDst += dstYStride;
+        }
     }
 
     // Copy/swizzle chroma planes, 4:2:0 subsampling
@@ -487,10 +500,26 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
         if (cbSrc == crSrc + 1 && src.chromaStep == 2) {
             ALOGV("%s: Fast NV21->NV21", __FUNCTION__);
             // Source has semiplanar CrCb chroma layout, can copy by rows
+            if (src.chromaStride == src.width) {
+                memcpy(crcbDst, crSrc, src.width * chromaHeight);
+            } else {
+                for (size_t row = 0; row < chromaHeight; row++) {
+                    memcpy(crcbDst, crSrc, src.width);
+                    crcbDst += src.width;
+                    crSrc += src.chromaStride;
+                }
+            }
+        } else if (crSrc == cbSrc + 1 && src.chromaStep == 2) {
+            ALOGV("%s: Fast NV12->NV21", __FUNCTION__);
+            // Source has semiplanar CbCr chroma layout, swap each pair. Fixed
+            // offsets let the compiler vectorize the loop.
             for (size_t row = 0; row < chromaHeight; row++) {
-                memcpy(crcbDst, crSrc, src.width);
-                crcbDst += src.width;
-                crSrc += src.chromaStride;
+                for (size_t col = 0; col < chromaWidth * 2; col += 2) {
+                    crcbDst[col] = cbSrc[col + 1];
+                    crcbDst[col + 1] = cbSrc[col];
+                }
+                crcbDst += chromaWidth * 2;
+                cbSrc += src.chromaStride;
             }
         } else {
             ALOGV("%s: Generic->NV21", __FUNCTION__);
@@ -515,15 +544,20 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
         if (src.chromaStep == 1) {
             ALOGV("%s: Fast YV12->YV12", __FUNCTION__);
             // Source has planar chroma layout, can copy by row
-            for (size_t row = 0; row < chromaHeight; row++) {
-                memcpy(crDst, crSrc, chromaWidth);
-                crDst += dstCStride;
-                crSrc += src.chromaStride;
-            }
-            for (size_t row = 0; row < chromaHeight; row++) {
-                memcpy(cbDst, cbSrc, chromaWidth);
-                cbDst += dstCStride;
-                cbSrc += src.chromaStride;
+            if (src.chromaStride == dstCStride) {
+                memcpy(crDst, crSrc, dstCStride * chromaHeight);
+                memcpy(cbDst, cbSrc, dstCStride * chromaHeight);
+            } else {
+                for (size_t row = 0; row < chromaHeight; row++) {
+                    memcpy(crDst, crSrc, chromaWidth);
+                    crDst += dstCStride;
+                    crSrc += src.chromaStride;
+                }
+                for (size_t row = 0; row < chromaHeight; row++) {
+                    memcpy(cbDst, cbSrc, chromaWidth);
+                    cbDst += dstCStride;
+                    cbSrc += src.chromaStride;
+                }
             }
         } else {
             ALOGV("%s: Generic->YV12", __FUNCTION__);
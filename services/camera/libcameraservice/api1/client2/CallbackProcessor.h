@@ -71,7 +71,11 @@ class CallbackProcessor:
     // mCallbackConsumer
     bool mCallbackToApp;
     int mCallbackStreamId;
-    static const size_t kCallbackHeapCount = 6;
+    // Number of heap buffers delivered in rotation; the app may still be
+    // reading a buffer while the next ones are filled.
+    // camera.callback.heap-count, at least kMinCallbackHeapCount.
+    static const size_t kMinCallbackHeapCount = 6;
+    size_t mCallbackHeapCount;
     sp<CpuConsumer>    mCallbackConsumer;
     sp<Surface>        mCallbackWindow;
     sp<Camera2Heap>    mCallbackHeap;
@@ -18,6 +18,7 @@
 #define ATRACE_TAG ATRACE_TAG_CAMERA
 //#define LOG_NDEBUG 0
 
+#include <inttypes.h>
 #include <netinet/in.h>
 
 #include <binder/MemoryBase.h>
@@ -44,7 +45,14 @@ JpegProcessor::JpegProcessor(
         mId(client->getCameraId()),
         mCaptureDone(false),
         mCaptureSuccess(false),
-        mCaptureStreamId(NO_STREAM) {
+        mCaptureStreamId(NO_STREAM),
+        mFrameAvailableTime(0),
+        mNumCaptures(0),
+        mLastJpegSize(0),
+        mTotalCopyTime(0),
+        mMaxCopyTime(0),
+        mTotalDeliveryTime(0),
+        mMaxDeliveryTime(0) {
 }
 
 JpegProcessor::~JpegProcessor() {
@@ -58,6 +66,7 @@ void JpegProcessor::onFrameAvailable(const BufferItem& /*item*/) {
     if (!mCaptureDone) {
         mCaptureDone = true;
         mCaptureSuccess = true;
+        mFrameAvailableTime = systemTime();
         mCaptureDoneSignal.signal();
     }
 }
@@ -215,7 +224,18 @@ int JpegProcessor::getStreamId() const {
     return mCaptureStreamId;
 }
 
-void JpegProcessor::dump(int /*fd*/, const Vector<String16>& /*args*/) const {
+void JpegProcessor::dump(int fd, const Vector<String16>& /*args*/) const {
+    Mutex::Autolock l(mInputMutex);
+    String8 result;
+    result.appendFormat("    JPEG captures: %zu, last size %zu bytes\n",
+            mNumCaptures, mLastJpegSize);
+    if (mNumCaptures > 0) {
+        result.appendFormat("      Copy time avg %" PRId64 " us, max %" PRId64 " us\n",
+                ns2us(mTotalCopyTime) / (int64_t)mNumCaptures, ns2us(mMaxCopyTime));
+        result.appendFormat("      Delivery time avg %" PRId64 " us, max %" PRId64 " us\n",
+                ns2us(mTotalDeliveryTime) / (int64_t)mNumCaptures, ns2us(mMaxDeliveryTime));
+    }
+    write(fd, result.string(), result.size());
 }
 
 bool JpegProcessor::threadLoop() {
@@ -291,11 +311,29 @@ status_t JpegProcessor::processNewCapture(bool captureSuccess) {
         }
 
         // TODO: Optimize this to avoid memcopy
+        nsecs_t copyStart = systemTime();
         captureBuffer = new MemoryBase(mCaptureHeap, 0, jpegSize);
         void* captureMemory = mCaptureHeap->getBase();
         memcpy(captureMemory, imgBuffer.data, jpegSize);
 
         mCaptureConsumer->unlockBuffer(imgBuffer);
+
+        nsecs_t now = systemTime();
+        nsecs_t copyTime = now - copyStart;
+        nsecs_t deliveryTime = now - mFrameAvailableTime;
+        mNumCaptures++;
+        mLastJpegSize = jpegSize;
+        mTotalCopyTime += copyTime;
+        if (copyTime > mMaxCopyTime) {
+            mMaxCopyTime = copyTime;
+        }
+        mTotalDeliveryTime += deliveryTime;
+        if (deliveryTime > mMaxDeliveryTime) {
+            mMaxDeliveryTime = deliveryTime;
+        }
+        ALOGV("%s: Camera %d: JPEG of %zu bytes copied in %" PRId64 " us, %" PRId64
+                " us after it was available", __FUNCTION__, mId, jpegSize,
+                ns2us(copyTime), ns2us(deliveryTime));
     }
 
     sp<CaptureSequencer> sequencer = mSequencer.promote();
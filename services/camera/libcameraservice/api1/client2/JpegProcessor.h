@@ -79,6 +79,16 @@ class JpegProcessor:
     sp<Surface>        mCaptureWindow;
     sp<MemoryHeapBase> mCaptureHeap;
 
+    // Capture statistics, for dump(). The delivery time runs from the JPEG
+    // buffer becoming available to handing the copy to the sequencer.
+    nsecs_t mFrameAvailableTime;
+    size_t mNumCaptures;
+    size_t mLastJpegSize;
+    nsecs_t mTotalCopyTime;
+    nsecs_t mMaxCopyTime;
+    nsecs_t mTotalDeliveryTime;
+    nsecs_t mMaxDeliveryTime;
+
     virtual bool threadLoop();
 
     status_t processNewCapture(bool captureSuccess);
@@ -86,6 +86,7 @@ ZslProcessor::ZslProcessor(
 
     mZslQueue.insertAt(0, mBufferQueueDepth);
     mFrameList.insertAt(0, mFrameListDepth);
+    mFrameCandidateTimestamps.insertAt(-1, 0, mFrameListDepth);
     sp<CaptureSequencer> captureSequencer = mSequencer.promote();
     if (captureSequencer != 0) captureSequencer->setZslProcessor(this);
 }
@@ -122,6 +123,8 @@ void ZslProcessor::onResultAvailable(const CaptureResult &result) {
     if (timestamp <= mLatestClearedBufferTimestamp) return;
 
     mFrameList.editItemAt(mFrameListHead) = result.mMetadata;
+    mFrameCandidateTimestamps.editItemAt(mFrameListHead) =
+            isCandidateFrame(result.mMetadata) ? timestamp : -1;
     mFrameListHead = (mFrameListHead + 1) % mFrameListDepth;
 }
 
@@ -320,7 +323,11 @@ status_t ZslProcessor::pushToReprocess(int32_t requestId) {
     }
 
     {
-        CameraMetadata request = mFrameList[metadataIdx];
+        // The result queue is cleared once the reprocessed buffer comes back, so the frame can
+        // be taken over instead of copied.
+        CameraMetadata request;
+        request.acquire(mFrameList.editItemAt(metadataIdx));
+        mFrameCandidateTimestamps.editItemAt(metadataIdx) = -1;
 
         // Verify that the frame is reasonable for reprocessing
 
@@ -449,6 +456,8 @@ void ZslProcessor::clearZslResultQueueLocked() {
     mFrameList.clear();
     mFrameListHead = 0;
     mFrameList.insertAt(0, mFrameListDepth);
+    mFrameCandidateTimestamps.clear();
+    mFrameCandidateTimestamps.insertAt(-1, 0, mFrameListDepth);
 }
 
 void ZslProcessor::dump(int fd, const Vector<String16>& /*args*/) const {
@@ -519,10 +528,68 @@ bool ZslProcessor::isFixedFocusMode(uint8_t afMode) const {
     }
 }
 
+bool ZslProcessor::isCandidateFrame(const CameraMetadata &frame) const {
+    /**
+     * Ensure that aeState is either converged or locked, and that the frame
+     * is in focus
+     */
+    camera_metadata_ro_entry_t entry;
+    entry = frame.find(ANDROID_CONTROL_AE_STATE);
+    if (entry.count == 0) {
+        /**
+         * This is most likely a HAL bug. The aeState field is
+         * mandatory, so it should always be in a metadata packet.
+         */
+        ALOGW("%s: ZSL queue frame has no AE state field!",
+                __FUNCTION__);
+        return false;
+    }
+    if (entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_CONVERGED &&
+            entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_LOCKED) {
+        ALOGVV("%s: ZSL queue frame AE state is %d, need "
+               "full capture",  __FUNCTION__, entry.data.u8[0]);
+        return false;
+    }
+
+    entry = frame.find(ANDROID_CONTROL_AF_MODE);
+    if (entry.count == 0) {
+        ALOGW("%s: ZSL queue frame has no AF mode field!",
+                __FUNCTION__);
+        return false;
+    }
+    uint8_t afMode = entry.data.u8[0];
+    if (afMode == ANDROID_CONTROL_AF_MODE_OFF) {
+        // Skip all the ZSL buffer for manual AF mode, as we don't really
+        // know the af state.
+        return false;
+    }
+
+    // Check AF state if device has focuser and focus mode isn't fixed
+    if (mHasFocuser && !isFixedFocusMode(afMode)) {
+        // Make sure the candidate frame has good focus.
+        entry = frame.find(ANDROID_CONTROL_AF_STATE);
+        if (entry.count == 0) {
+            ALOGW("%s: ZSL queue frame has no AF state field!",
+                    __FUNCTION__);
+            return false;
+        }
+        uint8_t afState = entry.data.u8[0];
+        if (afState != ANDROID_CONTROL_AF_STATE_PASSIVE_FOCUSED &&
+                afState != ANDROID_CONTROL_AF_STATE_FOCUSED_LOCKED &&
+                afState != ANDROID_CONTROL_AF_STATE_NOT_FOCUSED_LOCKED) {
+            ALOGVV("%s: ZSL queue frame AF state is %d is not good for capture, skip it",
+                    __FUNCTION__, afState);
+            return false;
+        }
+    }
+
+    return true;
+}
+
 nsecs_t ZslProcessor::getCandidateTimestampLocked(size_t* metadataIdx) const {
     /**
-     * Find the smallest timestamp we know about so far
-     * - ensure that aeState is either converged or locked
+     * Find the smallest timestamp we know about so far among the frames
+     * found good for reprocessing when their results arrived
      */
 
     size_t idx = 0;
@@ -531,77 +598,18 @@ nsecs_t ZslProcessor::getCandidateTimestampLocked(size_t* metadataIdx) const {
     size_t emptyCount = mFrameList.size();
 
     for (size_t j = 0; j < mFrameList.size(); j++) {
-        const CameraMetadata &frame = mFrameList[j];
-        if (!frame.isEmpty()) {
-
-            emptyCount--;
-
-            camera_metadata_ro_entry_t entry;
-            entry = frame.find(ANDROID_SENSOR_TIMESTAMP);
-            if (entry.count == 0) {
-                ALOGE("%s: Can't find timestamp in frame!",
-                        __FUNCTION__);
-                continue;
-            }
-            nsecs_t frameTimestamp = entry.data.i64[0];
-            if (minTimestamp > frameTimestamp || minTimestamp == -1) {
-
-                entry = frame.find(ANDROID_CONTROL_AE_STATE);
-
-                if (entry.count == 0) {
-                    /**
-                     * This is most likely a HAL bug. The aeState field is
-                     * mandatory, so it should always be in a metadata packet.
-                     */
-                    ALOGW("%s: ZSL queue frame has no AE state field!",
-                            __FUNCTION__);
-                    continue;
-                }
-                if (entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_CONVERGED &&
-                        entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_LOCKED) {
-                    ALOGVV("%s: ZSL queue frame AE state is %d, need "
-                           "full capture",  __FUNCTION__, entry.data.u8[0]);
-                    continue;
-                }
-
-                entry = frame.find(ANDROID_CONTROL_AF_MODE);
-                if (entry.count == 0) {
-                    ALOGW("%s: ZSL queue frame has no AF mode field!",
-                            __FUNCTION__);
-                    continue;
-                }
-                uint8_t afMode = entry.data.u8[0];
-                if (afMode == ANDROID_CONTROL_AF_MODE_OFF) {
-                    // Skip all the ZSL buffer for manual AF mode, as we don't really
-                    // know the af state.
-                    continue;
-                }
-
-                // Check AF state if device has focuser and focus mode isn't fixed
-                if (mHasFocuser && !isFixedFocusMode(afMode)) {
-                    // Make sure the candidate frame has good focus.
-                    entry = frame.find(ANDROID_CONTROL_AF_STATE);
-                    if (entry.count == 0) {
-                        ALOGW("%s: ZSL queue frame has no AF state field!",
-                                __FUNCTION__);
-                        continue;
-                    }
-                    uint8_t afState = entry.data.u8[0];
-                    if (afState != ANDROID_CONTROL_AF_STATE_PASSIVE_FOCUSED &&
-                            afState != ANDROID_CONTROL_AF_STATE_FOCUSED_LOCKED &&
-                            afState != ANDROID_CONTROL_AF_STATE_NOT_FOCUSED_LOCKED) {
-                        ALOGVV("%s: ZSL queue frame AF state is %d is not good for capture, skip it",
-                                __FUNCTION__, afState);
-                        continue;
-                    }
-                }
-
-                minTimestamp = frameTimestamp;
-                idx = j;
-            }
+        if (mFrameList[j].isEmpty()) {
+            continue;
+        }
+        emptyCount--;
 
-            ALOGVV("%s: Saw timestamp %" PRId64, __FUNCTION__, frameTimestamp);
+        nsecs_t frameTimestamp = mFrameCandidateTimestamps[j];
+        if (frameTimestamp != -1 && (minTimestamp > frameTimestamp || minTimestamp == -1)) {
+            minTimestamp = frameTimestamp;
+            idx = j;
         }
+
+        ALOGVV("%s: Saw timestamp %" PRId64, __FUNCTION__, frameTimestamp);
     }
 
     if (emptyCount == mFrameList.size()) {
@@ -125,6 +125,9 @@ class ZslProcessor :
     size_t mBufferQueueDepth;
     size_t mFrameListDepth;
     Vector<CameraMetadata> mFrameList;
+    // Timestamp of each mFrameList entry that is good for reprocessing, -1
+    // for the others; evaluated once when the result arrives.
+    Vector<nsecs_t> mFrameCandidateTimestamps;
     size_t mFrameListHead;
 
     ZslPair mNextPair;
@@ -145,6 +148,9 @@ class ZslProcessor :
 
     nsecs_t getCandidateTimestampLocked(size_t* metadataIdx) const;
 
+    // Check AE and AF state of a result to see if its buffer can be reprocessed
+    bool isCandidateFrame(const CameraMetadata &frame) const;
+
     bool isFixedFocusMode(uint8_t afMode) const;
 
     // Update the post-processing metadata with the default still capture request template
@@ -18,6 +18,9 @@
 #define LOG_TAG "Camera3-BufferManager"
 #define ATRACE_TAG ATRACE_TAG_CAMERA
 
+#include <inttypes.h>
+
+#include <cutils/properties.h>
 #include <gui/ISurfaceComposer.h>
 #include <private/gui/ComposerService.h>
 #include <utils/Log.h>
@@ -30,7 +33,24 @@ namespace android {
 namespace camera3 {
 
 Camera3BufferManager::Camera3BufferManager(const sp<IGraphicBufferAlloc>& allocator) :
-        mAllocator(allocator) {
+        mAllocator(allocator),
+        mMemoryBudget(0),
+        mIdleTrimTimeout(0),
+        mNumAllocations(0),
+        mTotalAllocationTime(0),
+        mMaxAllocationTime(0),
+        mNumOverBudgetAllocations(0),
+        mNumTrimmedBuffers(0),
+        mPeakAllocatedBytes(0) {
+    int32_t budgetMb = property_get_int32("camera.bufmgr.budget-mb", 0);
+    if (budgetMb > 0) {
+        mMemoryBudget = (size_t)budgetMb << 20;
+    }
+    int32_t idleTrimMs = property_get_int32("camera.bufmgr.idle-trim-ms", 3000);
+    if (idleTrimMs > 0) {
+        mIdleTrimTimeout = milliseconds(idleTrimMs);
+    }
+
     if (allocator == NULL) {
         sp<ISurfaceComposer> composer(ComposerService::getComposerService());
         mAllocator = composer->createGraphicBufferAlloc();
@@ -192,6 +212,10 @@ status_t Camera3BufferManager::getBufferForStream(int streamId, int streamSetId,
         return BAD_VALUE;
     }
 
+    if (mIdleTrimTimeout > 0) {
+        trimFreeBuffersLocked(systemTime() - mIdleTrimTimeout, 0);
+    }
+
     StreamSet &streamSet = mStreamSetMap.editValueFor(streamSetId);
     BufferCountMap& handOutBufferCounts = streamSet.handoutBufferCountMap;
     size_t& bufferCount = handOutBufferCounts.editValueFor(streamId);
@@ -218,10 +242,26 @@ status_t Camera3BufferManager::getBufferForStream(int streamId, int streamSetId,
         // Allocate one if there is no free buffer available.
         if (buffer.graphicBuffer == nullptr) {
             const StreamInfo& info = streamSet.streamInfoMap.valueFor(streamId);
+            size_t bufferSize = getBufferSize(info);
+            size_t allocatedBytes = getAllocatedBytesLocked();
+            if (mMemoryBudget > 0 && allocatedBytes + bufferSize > mMemoryBudget) {
+                // Make room by dropping the oldest free buffers of any stream set. If that is not
+                // enough, allocate anyway: failing the request would stall the stream.
+                trimFreeBuffersLocked(0, allocatedBytes + bufferSize - mMemoryBudget);
+                allocatedBytes = getAllocatedBytesLocked();
+                if (allocatedBytes + bufferSize > mMemoryBudget) {
+                    ALOGV("%s: stream %d exceeds the memory budget (%zu + %zu > %zu bytes)",
+                            __FUNCTION__, streamId, allocatedBytes, bufferSize, mMemoryBudget);
+                    mNumOverBudgetAllocations++;
+                }
+            }
+
             status_t res = OK;
             buffer.fenceFd = -1;
+            nsecs_t allocStart = systemTime();
             buffer.graphicBuffer = mAllocator->createGraphicBuffer(
                     info.width, info.height, info.format, info.combinedUsage, &res);
+            nsecs_t allocTime = systemTime() - allocStart;
             ALOGV("%s: allocating a new graphic buffer (%dx%d, format 0x%x) %p with handle %p",
                     __FUNCTION__, info.width, info.height, info.format,
                     buffer.graphicBuffer.get(), buffer.graphicBuffer->handle);
@@ -230,7 +270,15 @@ status_t Camera3BufferManager::getBufferForStream(int streamId, int streamSetId,
                         __FUNCTION__, res, strerror(-res));
                 return res;
             }
-            ALOGV("%s: allocation done", __FUNCTION__);
+            ALOGV("%s: allocation done in %" PRId64 " us", __FUNCTION__, ns2us(allocTime));
+            mNumAllocations++;
+            mTotalAllocationTime += allocTime;
+            if (allocTime > mMaxAllocationTime) {
+                mMaxAllocationTime = allocTime;
+            }
+            if (allocatedBytes + bufferSize > mPeakAllocatedBytes) {
+                mPeakAllocatedBytes = allocatedBytes + bufferSize;
+            }
         }
 
         // Increase the hand-out and attached buffer counts for tracking purposes.
@@ -377,7 +425,7 @@ status_t Camera3BufferManager::returnBufferForStream(int streamId,
         StreamSet& streamSet = mStreamSetMap.editValueFor(streamSetId);
         if (buffer != 0) {
             BufferEntry entry;
-            entry.add(streamId, GraphicBufferEntry(buffer, fenceFd));
+            entry.add(streamId, GraphicBufferEntry(buffer, fenceFd, systemTime()));
             status_t res = addBufferToBufferListLocked(streamSet.freeBuffers, entry);
             if (res != OK) {
                 ALOGE("%s: add buffer to free buffer list failed", __FUNCTION__);
@@ -404,6 +452,13 @@ void Camera3BufferManager::dump(int fd, const Vector<String16>& args) const {
 
     (void) args;
     String8 lines;
+    lines.appendFormat("      Allocated buffer memory: %zu KB (peak %zu KB, budget %zu KB)\n",
+            getAllocatedBytesLocked() >> 10, mPeakAllocatedBytes >> 10, mMemoryBudget >> 10);
+    lines.appendFormat("      Buffer allocations: %zu, avg %" PRId64 " us, max %" PRId64 " us,"
+            " %zu over budget\n", mNumAllocations,
+            mNumAllocations > 0 ? ns2us(mTotalAllocationTime) / (int64_t)mNumAllocations : 0,
+            ns2us(mMaxAllocationTime), mNumOverBudgetAllocations);
+    lines.appendFormat("      Trimmed free buffers: %zu\n", mNumTrimmedBuffers);
     lines.appendFormat("      Total stream sets: %zu\n", mStreamSetMap.size());
     for (size_t i = 0; i < mStreamSetMap.size(); i++) {
         lines.appendFormat("        Stream set %d has below streams:\n", mStreamSetMap.keyAt(i));
@@ -530,5 +585,94 @@ Camera3BufferManager::GraphicBufferEntry Camera3BufferManager::getFirstBufferFro
     return entry;
 }
 
+size_t Camera3BufferManager::getBufferSize(const StreamInfo& info) {
+    size_t pixels = (size_t)info.width * info.height;
+    switch (info.format) {
+        case HAL_PIXEL_FORMAT_BLOB:
+            // The width is the buffer size
+            return pixels;
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+        case HAL_PIXEL_FORMAT_BGRA_8888:
+            return pixels * 4;
+        case HAL_PIXEL_FORMAT_RGB_888:
+            return pixels * 3;
+        case HAL_PIXEL_FORMAT_RGB_565:
+        case HAL_PIXEL_FORMAT_RAW16:
+        case HAL_PIXEL_FORMAT_Y16:
+        case HAL_PIXEL_FORMAT_YCbCr_422_SP:
+        case HAL_PIXEL_FORMAT_YCbCr_422_I:
+            return pixels * 2;
+        default:
+            // YUV 4:2:0 and most implementation defined formats
+            return pixels * 3 / 2;
+    }
+}
+
+size_t Camera3BufferManager::getAllocatedBytesLocked() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < mStreamSetMap.size(); i++) {
+        const StreamSet& streamSet = mStreamSetMap[i];
+        for (size_t j = 0; j < streamSet.attachedBufferCountMap.size(); j++) {
+            ssize_t idx = streamSet.streamInfoMap.indexOfKey(
+                    streamSet.attachedBufferCountMap.keyAt(j));
+            if (idx != NAME_NOT_FOUND) {
+                bytes += streamSet.attachedBufferCountMap.valueAt(j) *
+                        getBufferSize(streamSet.streamInfoMap[idx]);
+            }
+        }
+        for (auto& bufEntry : streamSet.freeBuffers) {
+            for (size_t m = 0; m < bufEntry.size(); m++) {
+                ssize_t idx = streamSet.streamInfoMap.indexOfKey(bufEntry.keyAt(m));
+                if (idx != NAME_NOT_FOUND) {
+                    bytes += getBufferSize(streamSet.streamInfoMap[idx]);
+                }
+            }
+        }
+    }
+    return bytes;
+}
+
+void Camera3BufferManager::trimFreeBuffersLocked(nsecs_t idleBefore, size_t bytesToFree) {
+    size_t freedBytes = 0;
+    for (;;) {
+        // The free buffer lists are in returning order, so the oldest free buffer is at the front
+        // of one of them.
+        StreamSet* oldestSet = nullptr;
+        for (size_t i = 0; i < mStreamSetMap.size(); i++) {
+            StreamSet& streamSet = mStreamSetMap.editValueAt(i);
+            if (streamSet.freeBuffers.empty()) {
+                continue;
+            }
+            if (oldestSet == nullptr || streamSet.freeBuffers.front().valueAt(0).returnTime <
+                    oldestSet->freeBuffers.front().valueAt(0).returnTime) {
+                oldestSet = &streamSet;
+            }
+        }
+        if (oldestSet == nullptr) {
+            break;
+        }
+
+        const BufferEntry& oldest = oldestSet->freeBuffers.front();
+        if (oldest.valueAt(0).returnTime >= idleBefore && freedBytes >= bytesToFree) {
+            break;
+        }
+        for (size_t m = 0; m < oldest.size(); m++) {
+            ssize_t idx = oldestSet->streamInfoMap.indexOfKey(oldest.keyAt(m));
+            if (idx != NAME_NOT_FOUND) {
+                freedBytes += getBufferSize(oldestSet->streamInfoMap[idx]);
+            }
+            int fenceFd = oldest.valueAt(m).fenceFd;
+            if (fenceFd >= 0) {
+                close(fenceFd);
+            }
+        }
+        ALOGV("%s: drop a free buffer for stream %d", __FUNCTION__, oldest.keyAt(0));
+        // This drops the last reference to the buffer, which frees it.
+        oldestSet->freeBuffers.pop_front();
+        mNumTrimmedBuffers++;
+    }
+}
+
 } // namespace camera3
 } // namespace android
@@ -41,6 +41,11 @@ class Camera3OutputStream;
  * In doing so, it reduces the memory footprint unless it is already minimal without impacting
  * performance.
  *
+ * Free buffers that stay unused for longer than camera.bufmgr.idle-trim-ms (default 3000, 0
+ * disables trimming) are dropped. If camera.bufmgr.budget-mb is set, the oldest free buffers of
+ * all stream sets are also dropped before an allocation would take the total memory of the
+ * buffers allocated by this manager over that budget.
+ *
  */
 class Camera3BufferManager: public virtual RefBase {
 public:
@@ -195,9 +200,12 @@ private:
     struct GraphicBufferEntry {
         sp<GraphicBuffer> graphicBuffer;
         int fenceFd;
-        GraphicBufferEntry(const sp<GraphicBuffer>& gb = 0, int fd = -1) :
+        // when the buffer was returned to the free buffer list
+        nsecs_t returnTime;
+        GraphicBufferEntry(const sp<GraphicBuffer>& gb = 0, int fd = -1, nsecs_t time = 0) :
             graphicBuffer(gb),
-            fenceFd(fd) {}
+            fenceFd(fd),
+            returnTime(time) {}
     };
 
     /**
@@ -289,6 +297,23 @@ private:
     KeyedVector<StreamSetId, StreamSet> mStreamSetMap;
     KeyedVector<StreamId, wp<Camera3OutputStream>> mStreamMap;
 
+    /**
+     * Memory budget for all the buffers allocated by this buffer manager in bytes, 0 if there is
+     * none, and the time after which unused free buffers are dropped, 0 if they are kept.
+     */
+    size_t mMemoryBudget;
+    nsecs_t mIdleTrimTimeout;
+
+    /**
+     * Allocation and trimming statistics, for dump().
+     */
+    size_t mNumAllocations;
+    nsecs_t mTotalAllocationTime;
+    nsecs_t mMaxAllocationTime;
+    size_t mNumOverBudgetAllocations;
+    size_t mNumTrimmedBuffers;
+    size_t mPeakAllocatedBytes;
+
     // TODO: There is no easy way to query the Gralloc version in this code yet, we have different
     // code paths for different Gralloc versions, hardcode something here for now.
     const uint32_t mGrallocVersion = GRALLOC_DEVICE_API_VERSION_0_1;
@@ -331,6 +356,28 @@ private:
      *
      */
     bool inline hasBufferForStreamLocked(BufferList& buffers, int streamId);
+
+    /**
+     * Estimate the memory used by one buffer of a stream from its size and format.
+     */
+    static size_t getBufferSize(const StreamInfo& info);
+
+    /**
+     * Get the total size of the buffers allocated by this buffer manager that are either attached
+     * to a stream or on a free buffer list.
+     *
+     * This method needs to be called with mLock held.
+     */
+    size_t getAllocatedBytesLocked() const;
+
+    /**
+     * Drop the free buffers that were returned before idleBefore, then keep dropping the oldest
+     * free buffers of any stream set until at least bytesToFree bytes were freed. Stream sets are
+     * never removed from mStreamSetMap by this call.
+     *
+     * This method needs to be called with mLock held.
+     */
+    void trimFreeBuffersLocked(nsecs_t idleBefore, size_t bytesToFree);
 };
 
 } // namespace camera3
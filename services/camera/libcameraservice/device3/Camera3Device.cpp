@@ -59,6 +59,47 @@ using namespace android::camera3;
 
 namespace android {
 
+namespace {
+
+/**
+ * Opens the HAL device on its own thread, so that the service-side setup in
+ * Camera3Device::initialize can run while the HAL powers up the sensor.
+ */
+class HalOpenThread : public Thread {
+  public:
+    HalOpenThread(CameraModule *module, const String8 &deviceName) :
+            Thread(/*canCallJava*/false),
+            mModule(module),
+            mDeviceName(deviceName),
+            mDevice(NULL),
+            mRes(NO_INIT) {
+    }
+
+    void open() {
+        ATRACE_BEGIN("camera3->open");
+        mRes = mModule->open(mDeviceName.string(),
+                reinterpret_cast<hw_device_t**>(&mDevice));
+        ATRACE_END();
+    }
+
+    // Only valid once the thread has been joined, or after open()
+    status_t getResult() const { return mRes; }
+    camera3_device_t *getDevice() const { return mDevice; }
+
+  private:
+    virtual bool threadLoop() {
+        open();
+        return false;
+    }
+
+    CameraModule *mModule;
+    const String8 mDeviceName;
+    camera3_device_t *mDevice;
+    status_t mRes;
+};
+
+} // anonymous namespace
+
 Camera3Device::Camera3Device(int id):
         mId(id),
         mIsConstrainedHighSpeedConfiguration(false),
@@ -77,6 +118,7 @@ Camera3Device::Camera3Device(int id):
     ATRACE_CALL();
     camera3_callback_ops::notify = &sNotify;
     camera3_callback_ops::process_capture_result = &sProcessCaptureResult;
+    mTimelineEnabled = false;
     ALOGV("%s: Created device for camera %d", __FUNCTION__, id);
 }
 
@@ -107,22 +149,60 @@ status_t Camera3Device::initialize(CameraModule *module)
         return INVALID_OPERATION;
     }
 
-    /** Open HAL device */
-
     status_t res;
+    camera_info info;
+    res = module->getCameraInfo(mId, &info);
+    if (res != OK) return res;
+
+    /** Open HAL device, in parallel with the setup that doesn't need it */
+
     String8 deviceName = String8::format("%d", mId);
+    sp<HalOpenThread> openThread = new HalOpenThread(module, deviceName);
+    char value[PROPERTY_VALUE_MAX];
+    property_get("camera.open_thread.disable", value, "0");
+    bool openInParallel = atoi(value) != 1 &&
+            openThread->run(String8::format("C3Dev-%d-Open", mId).string()) == OK;
+    if (!openInParallel) {
+        openThread->open();
+    }
+
+    /** Start up status tracker thread */
+    mStatusTracker = new StatusTracker(this);
+    status_t trackerRes =
+            mStatusTracker->run(String8::format("C3Dev-%d-Status", mId).string());
 
-    camera3_device_t *device;
+    /** Create buffer manager */
+    mBufferManager = new Camera3BufferManager();
 
-    ATRACE_BEGIN("camera3->open");
-    res = module->open(deviceName.string(),
-            reinterpret_cast<hw_device_t**>(&device));
-    ATRACE_END();
+    if (openInParallel) {
+        openThread->join();
+    }
+    camera3_device_t *device = openThread->getDevice();
+    res = openThread->getResult();
+    openThread.clear();
+
+    // Undo the setup above if the device can't be used
+    auto cleanUpSetup = [&]() {
+        if (trackerRes == OK) {
+            mStatusTracker->requestExit();
+            mStatusTracker->join();
+        }
+        mStatusTracker.clear();
+        mBufferManager.clear();
+    };
 
     if (res != OK) {
         SET_ERR_L("Could not open camera: %s (%d)", strerror(-res), res);
+        cleanUpSetup();
         return res;
     }
+    if (trackerRes != OK) {
+        SET_ERR_L("Unable to start status tracking thread: %s (%d)",
+                strerror(-trackerRes), trackerRes);
+        device->common.close(&device->common);
+        cleanUpSetup();
+        return trackerRes;
+    }
 
     /** Cross-check device version */
     if (device->common.version < CAMERA_DEVICE_API_VERSION_3_0) {
@@ -131,18 +211,16 @@ status_t Camera3Device::initialize(CameraModule *module)
                 CAMERA_DEVICE_API_VERSION_3_0,
                 device->common.version);
         device->common.close(&device->common);
+        cleanUpSetup();
         return BAD_VALUE;
     }
 
-    camera_info info;
-    res = module->getCameraInfo(mId, &info);
-    if (res != OK) return res;
-
     if (info.device_version != device->common.version) {
         SET_ERR_L("HAL reporting mismatched camera_info version (%x)"
                 " and device version (%x).",
                 info.device_version, device->common.version);
         device->common.close(&device->common);
+        cleanUpSetup();
         return BAD_VALUE;
     }
 
@@ -156,26 +234,13 @@ status_t Camera3Device::initialize(CameraModule *module)
         SET_ERR_L("Unable to initialize HAL device: %s (%d)",
                 strerror(-res), res);
         device->common.close(&device->common);
+        cleanUpSetup();
         return BAD_VALUE;
     }
 
-    /** Start up status tracker thread */
-    mStatusTracker = new StatusTracker(this);
-    res = mStatusTracker->run(String8::format("C3Dev-%d-Status", mId).string());
-    if (res != OK) {
-        SET_ERR_L("Unable to start status tracking thread: %s (%d)",
-                strerror(-res), res);
-        device->common.close(&device->common);
-        mStatusTracker.clear();
-        return res;
-    }
-
     /** Register in-flight map to the status tracker */
     mInFlightStatusId = mStatusTracker->addComponent();
 
-    /** Create buffer manager */
-    mBufferManager = new Camera3BufferManager();
-
     bool aeLockAvailable = false;
     camera_metadata_ro_entry aeLockAvailableEntry;
     res = find_camera_metadata_ro_entry(info.static_camera_characteristics,
@@ -196,8 +261,22 @@ status_t Camera3Device::initialize(CameraModule *module)
         return res;
     }
 
+    /** Start up result assembly thread */
+    property_get("camera.result_thread.disable", value, "0");
+    if (atoi(value) != 1) {
+        mResultThread = new ResultThread(this, mStatusTracker);
+        res = mResultThread->run(String8::format("C3Dev-%d-Result", mId).string());
+        if (res != OK) {
+            // Results are then assembled on the HAL callback threads
+            ALOGW("Unable to start result thread: %s (%d)", strerror(-res), res);
+            mResultThread.clear();
+        }
+    }
+
     mPreparerThread = new PreparerThread();
 
+    mTimelineEnabled = property_get_bool("camera.timeline.enable", false);
+
     /** Everything is good to go */
 
     mDeviceVersion = device->common.version;
@@ -295,6 +374,10 @@ status_t Camera3Device::disconnect() {
             mRequestThread->requestExit();
         }
 
+        if (mResultThread != NULL) {
+            mResultThread->requestExit();
+        }
+
         mOutputStreams.clear();
         mInputStream.clear();
     }
@@ -308,6 +391,10 @@ status_t Camera3Device::disconnect() {
         mRequestThread->join();
     }
 
+    if (mResultThread != NULL) {
+        mResultThread->join();
+    }
+
     if (mStatusTracker != NULL) {
         mStatusTracker->join();
     }
@@ -317,6 +404,7 @@ status_t Camera3Device::disconnect() {
         Mutex::Autolock l(mLock);
 
         mRequestThread.clear();
+        mResultThread.clear();
         mStatusTracker.clear();
         mBufferManager.clear();
 
@@ -595,8 +683,9 @@ status_t Camera3Device::dump(int fd, const Vector<String16> &args) {
     if (mInFlightMap.size() == 0) {
         lines.append("      None\n");
     } else {
-        for (size_t i = 0; i < mInFlightMap.size(); i++) {
-            InFlightRequest r = mInFlightMap.valueAt(i);
+        for (size_t i = 0; i < InFlightMap::kCapacity; i++) {
+            if (!mInFlightMap.hasValueAt(i)) continue;
+            const InFlightRequest &r = mInFlightMap.valueAt(i);
             lines.appendFormat("      Frame %d |  Timestamp: %" PRId64 ", metadata"
                     " arrived: %s, buffers left: %d\n", mInFlightMap.keyAt(i),
                     r.shutterTimestamp, r.haveResultMetadata ? "true" : "false",
@@ -605,6 +694,18 @@ status_t Camera3Device::dump(int fd, const Vector<String16> &args) {
     }
     write(fd, lines.string(), lines.size());
 
+    if (mTimelineEnabled) {
+        // mInFlightLock is taken before mLock on the error paths
+        bool gotInFlightLock = tryLockSpinRightRound(mInFlightLock);
+        lines = String8("    Frame latency timeline:\n");
+        mSubmitToShutterLatency.dump(lines, "Submit to shutter notify");
+        mSubmitToResultLatency.dump(lines, "Submit to result metadata");
+        mSubmitToBuffersLatency.dump(lines, "Submit to buffers returned");
+        mSensorToBuffersLatency.dump(lines, "Start of exposure to buffers returned");
+        if (gotInFlightLock) mInFlightLock.unlock();
+        write(fd, lines.string(), lines.size());
+    }
+
     {
         lines = String8("    Last request sent:\n");
         write(fd, lines.string(), lines.size());
@@ -613,6 +714,12 @@ status_t Camera3Device::dump(int fd, const Vector<String16> &args) {
         lastRequest.dump(fd, /*verbosity*/2, /*indentation*/6);
     }
 
+    if (mRequestThread != NULL) {
+        lines = String8();
+        mRequestThread->dumpPrepareStats(lines);
+        write(fd, lines.string(), lines.size());
+    }
+
     if (dumpTemplates) {
         const char *templateNames[] = {
             "TEMPLATE_PREVIEW",
@@ -728,6 +835,10 @@ status_t Camera3Device::convertMetadataListToRequestListLocked(
                 break;
             }
         }
+        // Let the streams dequeue their buffers for the whole batch at once
+        for (auto& outputStream : (*firstRequest)->mOutputStreams) {
+            outputStream->setBatchSize((*firstRequest)->mBatchSize);
+        }
     }
 
     return OK;
@@ -2188,6 +2299,72 @@ void Camera3Device::setErrorStateLockedV(const char *fmt, va_list args) {
  * In-flight request management
  */
 
+Camera3Device::InFlightMap::InFlightMap() :
+        mSlots(new Slot[kCapacity]),
+        mSize(0) {
+}
+
+Camera3Device::InFlightMap::~InFlightMap() {
+    delete[] mSlots;
+}
+
+ssize_t Camera3Device::InFlightMap::add(uint32_t frameNumber,
+        const InFlightRequest &request) {
+    size_t idx = frameNumber % kCapacity;
+    Slot &slot = mSlots[idx];
+    if (slot.used) {
+        ALOGE("%s: frame %d is still in flight, can't add frame %d",
+                __FUNCTION__, slot.frameNumber, frameNumber);
+        return NO_MEMORY;
+    }
+
+    slot.used = true;
+    slot.frameNumber = frameNumber;
+    slot.request = request;
+    mSize++;
+    return idx;
+}
+
+ssize_t Camera3Device::InFlightMap::indexOfKey(uint32_t frameNumber) const {
+    size_t idx = frameNumber % kCapacity;
+    const Slot &slot = mSlots[idx];
+    if (!slot.used || slot.frameNumber != frameNumber) {
+        return NAME_NOT_FOUND;
+    }
+    return idx;
+}
+
+bool Camera3Device::InFlightMap::hasValueAt(size_t idx) const {
+    return mSlots[idx].used;
+}
+
+uint32_t Camera3Device::InFlightMap::keyAt(size_t idx) const {
+    return mSlots[idx].frameNumber;
+}
+
+const Camera3Device::InFlightRequest&
+Camera3Device::InFlightMap::valueAt(size_t idx) const {
+    return mSlots[idx].request;
+}
+
+Camera3Device::InFlightRequest& Camera3Device::InFlightMap::editValueAt(size_t idx) {
+    return mSlots[idx].request;
+}
+
+void Camera3Device::InFlightMap::removeItemAt(size_t idx) {
+    Slot &slot = mSlots[idx];
+    if (!slot.used) return;
+
+    slot.used = false;
+    // Release the metadata and buffer lists right away
+    slot.request = InFlightRequest();
+    mSize--;
+}
+
+size_t Camera3Device::InFlightMap::size() const {
+    return mSize;
+}
+
 status_t Camera3Device::registerInFlight(uint32_t frameNumber,
         int32_t numBuffers, CaptureResultExtras resultExtras, bool hasInput,
         const AeTriggerCancelOverride_t &aeTriggerCancelOverride) {
@@ -2199,6 +2376,12 @@ status_t Camera3Device::registerInFlight(uint32_t frameNumber,
             aeTriggerCancelOverride));
     if (res < 0) return res;
 
+    if (mTimelineEnabled) {
+        mInFlightMap.editValueAt(res).submitTime = systemTime();
+        ATRACE_ASYNC_BEGIN("frame shutter", frameNumber);
+        ATRACE_ASYNC_BEGIN("frame result", frameNumber);
+    }
+
     if (mInFlightMap.size() == 1) {
         mStatusTracker->markComponentActive(mInFlightStatusId);
     }
@@ -2222,8 +2405,8 @@ void Camera3Device::returnOutputBuffers(
     }
 }
 
-void Camera3Device::removeInFlightMapEntryLocked(int idx) {
-    mInFlightMap.removeItemsAt(idx, 1);
+void Camera3Device::removeInFlightMapEntryLocked(size_t idx) {
+    mInFlightMap.removeItemAt(idx);
 
     // Indicate idle inFlightMap to the status tracker
     if (mInFlightMap.size() == 0) {
@@ -2231,7 +2414,7 @@ void Camera3Device::removeInFlightMapEntryLocked(int idx) {
     }
 }
 
-void Camera3Device::removeInFlightRequestIfReadyLocked(int idx) {
+void Camera3Device::removeInFlightRequestIfReadyLocked(size_t idx) {
 
     const InFlightRequest &request = mInFlightMap.valueAt(idx);
     const uint32_t frameNumber = mInFlightMap.keyAt(idx);
@@ -2250,6 +2433,10 @@ void Camera3Device::removeInFlightRequestIfReadyLocked(int idx) {
             (request.haveResultMetadata && shutterTimestamp != 0))) {
         ATRACE_ASYNC_END("frame capture", frameNumber);
 
+        if (mTimelineEnabled && request.requestStatus == OK) {
+            recordTimelineLocked(frameNumber, request);
+        }
+
         // Sanity check - if sensor timestamp matches shutter timestamp
         if (request.requestStatus == OK &&
                 sensorTimestamp != shutterTimestamp) {
@@ -2280,6 +2467,28 @@ void Camera3Device::removeInFlightRequestIfReadyLocked(int idx) {
     }
 }
 
+void Camera3Device::recordTimelineLocked(uint32_t frameNumber,
+        const InFlightRequest &request) {
+    if (request.submitTime == 0) return;
+
+    mSubmitToShutterLatency.add(request.shutterNotifyTime - request.submitTime);
+    mSubmitToResultLatency.add(request.resultTime - request.submitTime);
+    mSubmitToBuffersLatency.add(request.buffersTime - request.submitTime);
+
+    // Sensor timestamps are in the boot time base if mTimestampOffset is set
+    nsecs_t sensorTime = request.shutterTimestamp - mTimestampOffset;
+    if (sensorTime > 0 && request.buffersTime > sensorTime) {
+        mSensorToBuffersLatency.add(request.buffersTime - sensorTime);
+    }
+
+    ALOGVV("%s: frame %d: shutter %" PRId64 " us, result %" PRId64 " us, buffers %" PRId64
+            " us after submit", __FUNCTION__, frameNumber,
+            ns2us(request.shutterNotifyTime - request.submitTime),
+            ns2us(request.resultTime - request.submitTime),
+            ns2us(request.buffersTime - request.submitTime));
+    (void) frameNumber;
+}
+
 void Camera3Device::insertResultLocked(CaptureResult *result, uint32_t frameNumber,
             const AeTriggerCancelOverride_t &aeTriggerCancelOverride) {
     if (result == nullptr) return;
@@ -2313,13 +2522,14 @@ void Camera3Device::insertResultLocked(CaptureResult *result, uint32_t frameNumb
 void Camera3Device::sendPartialCaptureResult(const camera_metadata_t * partialResult,
         const CaptureResultExtras &resultExtras, uint32_t frameNumber,
         const AeTriggerCancelOverride_t &aeTriggerCancelOverride) {
-    Mutex::Autolock l(mOutputLock);
-
-    CaptureResult captureResult;
-    captureResult.mResultExtras = resultExtras;
-    captureResult.mMetadata = partialResult;
-
-    insertResultLocked(&captureResult, frameNumber, aeTriggerCancelOverride);
+    PendingResult result;
+    result.metadata = partialResult;
+    result.resultExtras = resultExtras;
+    result.frameNumber = frameNumber;
+    result.partial = true;
+    result.aeTriggerCancelOverride = aeTriggerCancelOverride;
+
+    queueResult(result);
 }
 
 
@@ -2332,34 +2542,44 @@ void Camera3Device::sendCaptureResult(CameraMetadata &pendingMetadata,
     if (pendingMetadata.isEmpty())
         return;
 
-    Mutex::Autolock l(mOutputLock);
+    PendingResult result;
+    result.metadata.acquire(pendingMetadata);
+    result.collectedPartialResult.acquire(collectedPartialResult);
+    result.resultExtras = resultExtras;
+    result.frameNumber = frameNumber;
+    result.reprocess = reprocess;
+    result.aeTriggerCancelOverride = aeTriggerCancelOverride;
 
-    // TODO: need to track errors for tighter bounds on expected frame number
-    if (reprocess) {
-        if (frameNumber < mNextReprocessResultFrameNumber) {
-            SET_ERR("Out-of-order reprocess capture result metadata submitted! "
-                "(got frame number %d, expecting %d)",
-                frameNumber, mNextReprocessResultFrameNumber);
-            return;
-        }
-        mNextReprocessResultFrameNumber = frameNumber + 1;
+    queueResult(result);
+}
+
+void Camera3Device::queueResult(PendingResult &result) {
+    // The in-flight lock is held by the callers, so results are queued in the
+    // order the HAL reported them.
+    if (mResultThread != NULL) {
+        mResultThread->queueResult(result);
     } else {
-        if (frameNumber < mNextResultFrameNumber) {
-            SET_ERR("Out-of-order capture result metadata submitted! "
-                    "(got frame number %d, expecting %d)",
-                    frameNumber, mNextResultFrameNumber);
-            return;
-        }
-        mNextResultFrameNumber = frameNumber + 1;
+        deliverResult(result);
     }
+}
+
+void Camera3Device::deliverResult(PendingResult &result) {
+    ATRACE_CALL();
+    uint32_t frameNumber = result.frameNumber;
 
     CaptureResult captureResult;
-    captureResult.mResultExtras = resultExtras;
-    captureResult.mMetadata = pendingMetadata;
+    captureResult.mResultExtras = result.resultExtras;
+    captureResult.mMetadata.acquire(result.metadata);
+
+    if (result.partial) {
+        Mutex::Autolock l(mOutputLock);
+        insertResultLocked(&captureResult, frameNumber, result.aeTriggerCancelOverride);
+        return;
+    }
 
     // Append any previous partials to form a complete result
-    if (mUsePartialResult && !collectedPartialResult.isEmpty()) {
-        captureResult.mMetadata.append(collectedPartialResult);
+    if (mUsePartialResult && !result.collectedPartialResult.isEmpty()) {
+        captureResult.mMetadata.append(result.collectedPartialResult);
     }
 
     // Derive some new keys for backward compaibility
@@ -2373,6 +2593,27 @@ void Camera3Device::sendCaptureResult(CameraMetadata &pendingMetadata,
 
     captureResult.mMetadata.sort();
 
+    Mutex::Autolock l(mOutputLock);
+
+    // TODO: need to track errors for tighter bounds on expected frame number
+    if (result.reprocess) {
+        if (frameNumber < mNextReprocessResultFrameNumber) {
+            SET_ERR("Out-of-order reprocess capture result metadata submitted! "
+                "(got frame number %d, expecting %d)",
+                frameNumber, mNextReprocessResultFrameNumber);
+            return;
+        }
+        mNextReprocessResultFrameNumber = frameNumber + 1;
+    } else {
+        if (frameNumber < mNextResultFrameNumber) {
+            SET_ERR("Out-of-order capture result metadata submitted! "
+                    "(got frame number %d, expecting %d)",
+                    frameNumber, mNextResultFrameNumber);
+            return;
+        }
+        mNextResultFrameNumber = frameNumber + 1;
+    }
+
     // Check that there's a timestamp in the result metadata
     camera_metadata_entry timestamp = captureResult.mMetadata.find(ANDROID_SENSOR_TIMESTAMP);
     if (timestamp.count == 0) {
@@ -2384,7 +2625,7 @@ void Camera3Device::sendCaptureResult(CameraMetadata &pendingMetadata,
     mTagMonitor.monitorMetadata(TagMonitor::RESULT,
             frameNumber, timestamp.data.i64[0], captureResult.mMetadata);
 
-    insertResultLocked(&captureResult, frameNumber, aeTriggerCancelOverride);
+    insertResultLocked(&captureResult, frameNumber, result.aeTriggerCancelOverride);
 }
 
 /**
@@ -2504,6 +2745,10 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
                     request.collectedPartialResult);
             }
             request.haveResultMetadata = true;
+            if (mTimelineEnabled) {
+                request.resultTime = systemTime();
+                ATRACE_ASYNC_END("frame result", frameNumber);
+            }
         }
 
         uint32_t numBuffersReturned = result->num_output_buffers;
@@ -2522,6 +2767,9 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
                     frameNumber);
             return;
         }
+        if (mTimelineEnabled && numBuffersReturned > 0 && request.numBuffersLeft == 0) {
+            request.buffersTime = systemTime();
+        }
 
         camera_metadata_ro_entry_t entry;
         res = find_camera_metadata_ro_entry(result->result,
@@ -2720,6 +2968,10 @@ void Camera3Device::notifyShutter(const camera3_shutter_msg_t &msg,
             }
 
             r.shutterTimestamp = msg.timestamp;
+            if (mTimelineEnabled) {
+                r.shutterNotifyTime = systemTime();
+                ATRACE_ASYNC_END("frame shutter", msg.frame_number);
+            }
 
             // send pending result and buffers
             sendCaptureResult(r.pendingMetadata, r.resultExtras,
@@ -2781,7 +3033,11 @@ Camera3Device::RequestThread::RequestThread(wp<Camera3Device> parent,
         mRepeatingLastFrameNumber(
             hardware::camera2::ICameraDeviceUser::NO_IN_FLIGHT_REPEATING_FRAMES),
         mAeLockAvailable(aeLockAvailable),
-        mPrepareVideoStream(false) {
+        mPrepareVideoStream(false),
+        mNumSettingsSent(0),
+        mNumSettingsReused(0),
+        mTotalPrepareTime(0),
+        mMaxPrepareTime(0) {
     mStatusId = statusTracker->addComponent();
 }
 
@@ -3225,10 +3481,35 @@ bool Camera3Device::RequestThread::threadLoop() {
     return true;
 }
 
+// Whether settings hold the same entries as prevSettings, both sorted.
+static bool isSameSettings(const camera_metadata_t *settings,
+        const CameraMetadata &prevSettings) {
+    if (prevSettings.isEmpty()) return false;
+
+    const camera_metadata_t *prev = prevSettings.getAndLock();
+    bool same = get_camera_metadata_entry_count(settings) ==
+            get_camera_metadata_entry_count(prev);
+    for (size_t i = 0; same && i < get_camera_metadata_entry_count(prev); i++) {
+        camera_metadata_ro_entry_t entry, prevEntry;
+        if (get_camera_metadata_ro_entry(settings, i, &entry) != OK ||
+                get_camera_metadata_ro_entry(prev, i, &prevEntry) != OK) {
+            same = false;
+            break;
+        }
+        same = entry.tag == prevEntry.tag && entry.type == prevEntry.type &&
+                entry.count == prevEntry.count &&
+                memcmp(entry.data.u8, prevEntry.data.u8,
+                        entry.count * camera_metadata_type_size[entry.type]) == 0;
+    }
+    prevSettings.unlock(prev);
+    return same;
+}
+
 status_t Camera3Device::RequestThread::prepareHalRequests() {
     ATRACE_CALL();
 
     for (auto& nextRequest : mNextRequests) {
+        nsecs_t prepareStart = systemTime();
         sp<CaptureRequest> captureRequest = nextRequest.captureRequest;
         camera3_capture_request_t* halRequest = &nextRequest.halRequest;
         Vector<camera3_stream_buffer_t>* outputBuffers = &nextRequest.outputBuffers;
@@ -3250,7 +3531,8 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
         mPrevTriggers = triggerCount;
 
         // If the request is the same as last, or we had triggers last time
-        if (mPrevRequest != captureRequest || triggersMixedIn) {
+        bool settingsReused = false;
+        if (mPrevRequest != captureRequest || triggersMixedIn || mPrevSettings.isEmpty()) {
             /**
              * HAL workaround:
              * Insert a dummy trigger ID if a trigger is set but no trigger ID is
@@ -3270,24 +3552,37 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
             captureRequest->mSettings.sort();
             halRequest->settings = captureRequest->mSettings.getAndLock();
             mPrevRequest = captureRequest;
-            ALOGVV("%s: Request settings are NEW", __FUNCTION__);
-
-            IF_ALOGV() {
-                camera_metadata_ro_entry_t e = camera_metadata_ro_entry_t();
-                find_camera_metadata_ro_entry(
-                        halRequest->settings,
-                        ANDROID_CONTROL_AF_TRIGGER,
-                        &e
-                );
-                if (e.count > 0) {
-                    ALOGV("%s: Request (frame num %d) had AF trigger 0x%x",
-                          __FUNCTION__,
-                          halRequest->frame_number,
-                          e.data.u8[0]);
+
+            if (!triggersMixedIn && isSameSettings(halRequest->settings, mPrevSettings)) {
+                // A different request with the same settings, as in a
+                // repeating burst; no need for the HAL to parse them again.
+                captureRequest->mSettings.unlock(halRequest->settings);
+                halRequest->settings = NULL;
+                settingsReused = true;
+                ALOGVV("%s: Request settings are REUSED from an identical request",
+                       __FUNCTION__);
+            } else {
+                mPrevSettings = halRequest->settings;
+                ALOGVV("%s: Request settings are NEW", __FUNCTION__);
+
+                IF_ALOGV() {
+                    camera_metadata_ro_entry_t e = camera_metadata_ro_entry_t();
+                    find_camera_metadata_ro_entry(
+                            halRequest->settings,
+                            ANDROID_CONTROL_AF_TRIGGER,
+                            &e
+                    );
+                    if (e.count > 0) {
+                        ALOGV("%s: Request (frame num %d) had AF trigger 0x%x",
+                              __FUNCTION__,
+                              halRequest->frame_number,
+                              e.data.u8[0]);
+                    }
                 }
             }
         } else {
             // leave request.settings NULL to indicate 'reuse latest given'
+            settingsReused = true;
             ALOGVV("%s: Request settings are REUSED",
                    __FUNCTION__);
         }
@@ -3359,11 +3654,36 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
                     " %s (%d)", strerror(-res), res);
             return INVALID_OPERATION;
         }
+
+        nsecs_t prepareTime = systemTime() - prepareStart;
+        {
+            Mutex::Autolock al(mLatestRequestMutex);
+            if (settingsReused) {
+                mNumSettingsReused++;
+            } else {
+                mNumSettingsSent++;
+            }
+            mTotalPrepareTime += prepareTime;
+            if (prepareTime > mMaxPrepareTime) {
+                mMaxPrepareTime = prepareTime;
+            }
+        }
     }
 
     return OK;
 }
 
+void Camera3Device::RequestThread::dumpPrepareStats(String8 &lines) const {
+    Mutex::Autolock al(mLatestRequestMutex);
+
+    uint32_t numRequests = mNumSettingsSent + mNumSettingsReused;
+    lines.appendFormat("    Requests prepared: %u, settings sent: %u, reused: %u\n",
+            numRequests, mNumSettingsSent, mNumSettingsReused);
+    lines.appendFormat("    Request prepare time: avg %" PRId64 " us, max %" PRId64 " us\n",
+            numRequests > 0 ? ns2us(mTotalPrepareTime / numRequests) : 0,
+            ns2us(mMaxPrepareTime));
+}
+
 CameraMetadata Camera3Device::RequestThread::getLatestRequest() const {
     Mutex::Autolock al(mLatestRequestMutex);
 
@@ -3407,6 +3727,10 @@ void Camera3Device::RequestThread::cleanUpFailedRequests(bool sendRequestError)
         return;
     }
 
+    // The HAL may not have seen the settings these requests were prepared
+    // with, make sure the next request carries its own.
+    mPrevSettings.clear();
+
     for (auto& nextRequest : mNextRequests) {
         // Skip the ones that have been submitted successfully.
         if (nextRequest.submitted) {
@@ -3570,6 +3894,7 @@ sp<Camera3Device::CaptureRequest>
     // request if so. Can't use 'NULL request == repeat' across configure calls.
     if (mReconfigured) {
         mPrevRequest.clear();
+        mPrevSettings.clear();
         mReconfigured = false;
     }
 
@@ -3848,6 +4173,87 @@ status_t Camera3Device::RequestThread::addDummyTriggerIds(
     return OK;
 }
 
+/**
+ * ResultThread inner class methods
+ */
+
+void Camera3Device::PendingResult::acquire(PendingResult &other) {
+    metadata.acquire(other.metadata);
+    collectedPartialResult.acquire(other.collectedPartialResult);
+    resultExtras = other.resultExtras;
+    frameNumber = other.frameNumber;
+    partial = other.partial;
+    reprocess = other.reprocess;
+    aeTriggerCancelOverride = other.aeTriggerCancelOverride;
+}
+
+Camera3Device::ResultThread::ResultThread(wp<Camera3Device> parent,
+        sp<StatusTracker> statusTracker) :
+        Thread(/*canCallJava*/false),
+        mParent(parent),
+        mStatusTracker(statusTracker),
+        mBusy(false) {
+    mStatusId = statusTracker->addComponent();
+}
+
+void Camera3Device::ResultThread::queueResult(PendingResult &result) {
+    Mutex::Autolock l(mLock);
+
+    // The device isn't idle while results are still being assembled
+    if (mPendingResults.empty() && !mBusy) {
+        sp<StatusTracker> statusTracker = mStatusTracker.promote();
+        if (statusTracker != 0) {
+            statusTracker->markComponentActive(mStatusId);
+        }
+    }
+
+    // Insert an empty result and acquire into it, copying metadata is what
+    // this thread is here to avoid
+    List<PendingResult>::iterator it =
+            mPendingResults.insert(mPendingResults.end(), PendingResult());
+    it->acquire(result);
+
+    mPendingSignal.signal();
+}
+
+void Camera3Device::ResultThread::requestExit() {
+    Thread::requestExit();
+
+    Mutex::Autolock l(mLock);
+    mPendingSignal.signal();
+}
+
+bool Camera3Device::ResultThread::threadLoop() {
+    PendingResult result;
+    {
+        Mutex::Autolock l(mLock);
+        // Queued results are delivered before exiting
+        while (mPendingResults.empty()) {
+            if (exitPending()) return false;
+            mPendingSignal.wait(mLock);
+        }
+
+        result.acquire(*mPendingResults.begin());
+        mPendingResults.erase(mPendingResults.begin());
+        mBusy = true;
+    }
+
+    sp<Camera3Device> parent = mParent.promote();
+    if (parent != NULL) {
+        parent->deliverResult(result);
+    }
+
+    Mutex::Autolock l(mLock);
+    mBusy = false;
+    if (mPendingResults.empty()) {
+        sp<StatusTracker> statusTracker = mStatusTracker.promote();
+        if (statusTracker != 0) {
+            statusTracker->markComponentIdle(mStatusId, Fence::NO_FENCE);
+        }
+    }
+    return true;
+}
+
 /**
  * PreparerThread inner class methods
  */
@@ -30,6 +30,7 @@
 #include "common/CameraDeviceBase.h"
 #include "device3/StatusTracker.h"
 #include "device3/Camera3BufferManager.h"
+#include "utils/LatencyHistogram.h"
 #include "utils/TagMonitor.h"
 
 /**
@@ -527,6 +528,12 @@ class Camera3Device :
          */
         CameraMetadata getLatestRequest() const;
 
+        /**
+         * Append how many requests reused the previous settings and how
+         * long preparing a request for the HAL took, for dumpsys.
+         */
+        void dumpPrepareStats(String8 &lines) const;
+
         /**
          * Returns true if the stream is a target of any queued or repeating
          * capture request
@@ -630,6 +637,10 @@ class Camera3Device :
 
         sp<CaptureRequest> mPrevRequest;
         int32_t            mPrevTriggers;
+        // Copy of the settings last given to the HAL, so that a different
+        // request with the same settings can be sent with NULL settings.
+        // Empty when the HAL must get settings with the next request.
+        CameraMetadata     mPrevSettings;
 
         uint32_t           mFrameNumber;
 
@@ -639,6 +650,12 @@ class Camera3Device :
         int32_t            mLatestRequestId;
         CameraMetadata     mLatestRequest;
 
+        // Request preparation stats, guarded by mLatestRequestMutex
+        uint32_t           mNumSettingsSent;
+        uint32_t           mNumSettingsReused;
+        nsecs_t            mTotalPrepareTime;
+        nsecs_t            mMaxPrepareTime;
+
         typedef KeyedVector<uint32_t/*tag*/, RequestTrigger> TriggerMap;
         Mutex              mTriggerMutex;
         TriggerMap         mTriggerMap;
@@ -696,7 +713,15 @@ class Camera3Device :
         // CONTROL_AE_PRECAPTURE_TRIGGER_CANCEL
         AeTriggerCancelOverride_t aeTriggerCancelOverride;
 
-        // Default constructor needed by KeyedVector
+        // Frame timeline (systemTime): registered right before submission to
+        // the HAL, shutter notify, final result metadata and last buffer
+        // returned by the HAL. Only filled in if mTimelineEnabled.
+        nsecs_t submitTime;
+        nsecs_t shutterNotifyTime;
+        nsecs_t resultTime;
+        nsecs_t buffersTime;
+
+        // Default constructor needed by InFlightMap
         InFlightRequest() :
                 shutterTimestamp(0),
                 sensorTimestamp(0),
@@ -704,7 +729,11 @@ class Camera3Device :
                 haveResultMetadata(false),
                 numBuffersLeft(0),
                 hasInputBuffer(false),
-                aeTriggerCancelOverride({false, 0, false, 0}){
+                aeTriggerCancelOverride({false, 0, false, 0}),
+                submitTime(0),
+                shutterNotifyTime(0),
+                resultTime(0),
+                buffersTime(0) {
         }
 
         InFlightRequest(int numBuffers, CaptureResultExtras extras, bool hasInput,
@@ -716,12 +745,53 @@ class Camera3Device :
                 numBuffersLeft(numBuffers),
                 resultExtras(extras),
                 hasInputBuffer(hasInput),
-                aeTriggerCancelOverride(aeTriggerCancelOverride){
+                aeTriggerCancelOverride(aeTriggerCancelOverride),
+                submitTime(0),
+                shutterNotifyTime(0),
+                resultTime(0),
+                buffersTime(0) {
         }
     };
 
-    // Map from frame number to the in-flight request state
-    typedef KeyedVector<uint32_t, InFlightRequest> InFlightMap;
+    // Map from frame number to the in-flight request state. Requests live in
+    // a fixed table indexed by frame number modulo its capacity, so adding or
+    // removing one doesn't copy the others the way a KeyedVector would.
+    class InFlightMap {
+      public:
+        // Twice the high speed in-flight limit, so frames in flight at the
+        // same time don't share a slot.
+        static const size_t kCapacity = 2 * kInFlightWarnLimitHighSpeed;
+
+        InFlightMap();
+        ~InFlightMap();
+
+        // Returns the index of the new entry, or NO_MEMORY if its slot is
+        // still taken by another frame.
+        ssize_t add(uint32_t frameNumber, const InFlightRequest &request);
+        // Returns NAME_NOT_FOUND if frameNumber isn't in flight.
+        ssize_t indexOfKey(uint32_t frameNumber) const;
+
+        // Whether the index, in [0, kCapacity), holds a request.
+        bool hasValueAt(size_t idx) const;
+        uint32_t keyAt(size_t idx) const;
+        const InFlightRequest &valueAt(size_t idx) const;
+        InFlightRequest &editValueAt(size_t idx);
+
+        void removeItemAt(size_t idx);
+        size_t size() const;
+
+      private:
+        struct Slot {
+            bool used;
+            uint32_t frameNumber;
+            InFlightRequest request;
+
+            Slot() : used(false), frameNumber(0) {}
+        };
+
+        Slot *mSlots;
+        size_t mSize;
+    };
 
     Mutex                  mInFlightLock; // Protects mInFlightMap
     InFlightMap            mInFlightMap;
@@ -750,6 +820,61 @@ class Camera3Device :
      */
     sp<camera3::Camera3BufferManager> mBufferManager;
 
+    /**
+     * A capture result waiting to be assembled and inserted into the result
+     * queue.
+     */
+    struct PendingResult {
+        CameraMetadata metadata;
+        // Partial results to append to a complete result
+        CameraMetadata collectedPartialResult;
+        CaptureResultExtras resultExtras;
+        uint32_t frameNumber;
+        bool partial;
+        bool reprocess;
+        AeTriggerCancelOverride_t aeTriggerCancelOverride;
+
+        PendingResult() :
+                frameNumber(0),
+                partial(false),
+                reprocess(false),
+                aeTriggerCancelOverride({false, 0, false, 0}) {
+        }
+
+        // Takes over other's metadata instead of copying it.
+        void acquire(PendingResult &other);
+    };
+
+    /**
+     * Thread assembling capture results, so that the HAL result and shutter
+     * callbacks only have to hand the metadata over. Results are inserted
+     * into the result queue in the order they're queued.
+     */
+    class ResultThread : public Thread {
+      public:
+        ResultThread(wp<Camera3Device> parent,
+                sp<camera3::StatusTracker> statusTracker);
+
+        // Takes over result's metadata.
+        void queueResult(PendingResult &result);
+
+        virtual void requestExit();
+
+      private:
+        virtual bool threadLoop();
+
+        wp<Camera3Device> mParent;
+        wp<camera3::StatusTracker> mStatusTracker;
+        int mStatusId;
+
+        Mutex mLock;
+        Condition mPendingSignal;
+        List<PendingResult> mPendingResults;
+        // Whether threadLoop is assembling a result
+        bool mBusy;
+    };
+    sp<ResultThread> mResultThread;
+
     /**
      * Thread for preparing streams
      */
@@ -835,12 +960,20 @@ class Camera3Device :
             const AeTriggerCancelOverride_t &aeTriggerCancelOverride);
 
     // Send a total capture result given the pending metadata and result extras,
-    // partial results, and the frame number to the result queue.
+    // partial results, and the frame number to the result queue. The pending
+    // metadata and partial results are taken over, leaving them empty.
     void sendCaptureResult(CameraMetadata &pendingMetadata,
             CaptureResultExtras &resultExtras,
             CameraMetadata &collectedPartialResult, uint32_t frameNumber,
             bool reprocess, const AeTriggerCancelOverride_t &aeTriggerCancelOverride);
 
+    // Hand a result to mResultThread, or deliver it right away without one.
+    void queueResult(PendingResult &result);
+
+    // Assemble a result and insert it into the result queue. Called on
+    // mResultThread, with no locks held.
+    void deliverResult(PendingResult &result);
+
     // Insert the result to the result queue after updating frame number and overriding AE
     // trigger cancel.
     // mOutputLock must be held when calling this function.
@@ -851,10 +984,10 @@ class Camera3Device :
 
     // Remove the in-flight map entry of the given index from mInFlightMap.
     // It must only be called with mInFlightLock held.
-    void removeInFlightMapEntryLocked(int idx);
+    void removeInFlightMapEntryLocked(size_t idx);
     // Remove the in-flight request of the given index from mInFlightMap
     // if it's no longer needed. It must only be called with mInFlightLock held.
-    void removeInFlightRequestIfReadyLocked(int idx);
+    void removeInFlightRequestIfReadyLocked(size_t idx);
 
     /**** End scope for mInFlightLock ****/
 
@@ -865,6 +998,20 @@ class Camera3Device :
     // - dumpsys -m 3a is a shortcut for ae/af/awbMode, State, and Triggers
     TagMonitor mTagMonitor;
 
+    /**
+     * Per-frame latency timeline, enabled with camera.timeline.enable=1 when
+     * the device is opened. Aggregated when a request leaves the in-flight
+     * map; protected by mInFlightLock.
+     */
+    bool mTimelineEnabled;
+    LatencyHistogram mSubmitToShutterLatency;
+    LatencyHistogram mSubmitToResultLatency;
+    LatencyHistogram mSubmitToBuffersLatency;
+    LatencyHistogram mSensorToBuffersLatency;
+
+    // Add the timeline of a completed request to the histograms
+    void recordTimelineLocked(uint32_t frameNumber, const InFlightRequest &request);
+
     void monitorMetadata(TagMonitor::eventSource source, int64_t frameNumber,
             nsecs_t timestamp, const CameraMetadata& metadata);
 
@@ -103,6 +103,12 @@ bool Camera3DummyStream::isVideoStream() const {
     return false;
 }
 
+status_t Camera3DummyStream::setBatchSize(size_t batchSize) {
+    (void) batchSize;
+    // Do nothing
+    return OK;
+}
+
 bool Camera3DummyStream::isConsumerConfigurationDeferred() const {
     return false;
 }
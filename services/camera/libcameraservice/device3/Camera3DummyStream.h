@@ -71,6 +71,8 @@ class Camera3DummyStream :
      */
     virtual status_t setConsumer(sp<Surface> consumer);
 
+    virtual status_t setBatchSize(size_t batchSize);
+
   protected:
 
     /**
@@ -43,7 +43,8 @@ Camera3OutputStream::Camera3OutputStream(int id,
         mTraceFirstBuffer(true),
         mUseBufferManager(false),
         mTimestampOffset(timestampOffset),
-        mConsumerUsage(0) {
+        mConsumerUsage(0),
+        mBatchSize(1) {
 
     if (mConsumer == NULL) {
         ALOGE("%s: Consumer is NULL!", __FUNCTION__);
@@ -68,7 +69,8 @@ Camera3OutputStream::Camera3OutputStream(int id,
         mUseMonoTimestamp(false),
         mUseBufferManager(false),
         mTimestampOffset(timestampOffset),
-        mConsumerUsage(0) {
+        mConsumerUsage(0),
+        mBatchSize(1) {
 
     if (format != HAL_PIXEL_FORMAT_BLOB && format != HAL_PIXEL_FORMAT_RAW_OPAQUE) {
         ALOGE("%s: Bad format for size-only stream: %d", __FUNCTION__,
@@ -97,7 +99,8 @@ Camera3OutputStream::Camera3OutputStream(int id,
         mTraceFirstBuffer(true),
         mUseBufferManager(false),
         mTimestampOffset(timestampOffset),
-        mConsumerUsage(consumerUsage) {
+        mConsumerUsage(consumerUsage),
+        mBatchSize(1) {
     // Deferred consumer only support preview surface format now.
     if (format != HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED) {
         ALOGE("%s: Deferred consumer only supports IMPLEMENTATION_DEFINED format now!",
@@ -132,7 +135,8 @@ Camera3OutputStream::Camera3OutputStream(int id, camera3_stream_type_t type,
         mTraceFirstBuffer(true),
         mUseMonoTimestamp(false),
         mUseBufferManager(false),
-        mConsumerUsage(0) {
+        mConsumerUsage(0),
+        mBatchSize(1) {
 
     if (setId > CAMERA3_STREAM_SET_ID_INVALID) {
         mBufferReleasedListener = new BufferReleasedListener(this);
@@ -184,7 +188,12 @@ status_t Camera3OutputStream::getBufferLocked(camera3_stream_buffer *buffer) {
             return res;
         }
     }
-    if (!gotBufferFromManager) {
+    if (!gotBufferFromManager && !mDequeuedBuffers.isEmpty()) {
+        // Dequeued ahead by an earlier request of the batch
+        anb = mDequeuedBuffers[0].anb;
+        fenceFd = mDequeuedBuffers[0].fenceFd;
+        mDequeuedBuffers.removeAt(0);
+    } else if (!gotBufferFromManager) {
         /**
          * Release the lock briefly to avoid deadlock for below scenario:
          * Thread 1: StreamingProcessor::startStream -> Camera3Stream::isConfiguring().
@@ -197,10 +206,30 @@ status_t Camera3OutputStream::getBufferLocked(camera3_stream_buffer *buffer) {
          * Then there is circular locking dependency.
          */
         sp<ANativeWindow> currentConsumer = mConsumer;
+
+        // For a request batch, dequeue the buffers of the following requests
+        // too, while the lock is released, as long as the HAL limit allows.
+        size_t aheadCount = 0;
+        size_t handoutCount = getHandoutOutputBufferCountLocked() + 1;
+        if (!mUseBufferManager && mBatchSize > 1 && handoutCount < camera3_stream::max_buffers) {
+            size_t available = camera3_stream::max_buffers - handoutCount;
+            aheadCount = (mBatchSize - 1 < available) ? mBatchSize - 1 : available;
+        }
+        Vector<DequeuedBuffer> dequeuedAhead;
         mLock.unlock();
 
         res = currentConsumer->dequeueBuffer(currentConsumer.get(), &anb, &fenceFd);
+        for (size_t i = 0; res == OK && i < aheadCount; i++) {
+            DequeuedBuffer ahead;
+            if (currentConsumer->dequeueBuffer(currentConsumer.get(), &ahead.anb,
+                    &ahead.fenceFd) != OK) {
+                // Not fatal, the next request will dequeue its own
+                break;
+            }
+            dequeuedAhead.push_back(ahead);
+        }
         mLock.lock();
+        mDequeuedBuffers.appendVector(dequeuedAhead);
         if (res != OK) {
             ALOGE("%s: Stream %d: Can't dequeue next output buffer: %s (%d)",
                     __FUNCTION__, mId, strerror(-res), res);
@@ -335,6 +364,10 @@ void Camera3OutputStream::dump(int fd, const Vector<String16> &args) const {
     String8 lines;
     lines.appendFormat("    Stream[%d]: Output\n", mId);
     lines.appendFormat("      Consumer name: %s\n", mConsumerName.string());
+    if (mBatchSize > 1) {
+        lines.appendFormat("      Batch size: %zu, buffers dequeued ahead: %zu\n",
+                mBatchSize, mDequeuedBuffers.size());
+    }
     write(fd, lines.string(), lines.size());
 
     Camera3IOStreamBase::dump(fd, args);
@@ -524,6 +557,8 @@ status_t Camera3OutputStream::disconnectLocked() {
         return OK;
     }
 
+    cancelDequeuedBuffersLocked();
+
     ALOGV("%s: disconnecting stream %d from native window", __FUNCTION__, getId());
 
     res = native_window_api_disconnect(mConsumer.get(),
@@ -676,6 +711,28 @@ status_t Camera3OutputStream::detachBuffer(sp<GraphicBuffer>* buffer, int* fence
     return OK;
 }
 
+status_t Camera3OutputStream::setBatchSize(size_t batchSize) {
+    Mutex::Autolock l(mLock);
+    if (batchSize == 0) {
+        ALOGE("%s: Stream %d: Invalid batch size 0", __FUNCTION__, mId);
+        return BAD_VALUE;
+    }
+    mBatchSize = batchSize;
+    return OK;
+}
+
+void Camera3OutputStream::cancelDequeuedBuffersLocked() {
+    for (size_t i = 0; i < mDequeuedBuffers.size(); i++) {
+        const DequeuedBuffer &b = mDequeuedBuffers[i];
+        status_t res = mConsumer->cancelBuffer(mConsumer.get(), b.anb, b.fenceFd);
+        if (res != OK) {
+            ALOGW("%s: Stream %d: Can't cancel buffer dequeued ahead: %s (%d)",
+                    __FUNCTION__, mId, strerror(-res), res);
+        }
+    }
+    mDequeuedBuffers.clear();
+}
+
 bool Camera3OutputStream::isConsumerConfigurationDeferred() const {
     Mutex::Autolock l(mLock);
     return mConsumer == nullptr;
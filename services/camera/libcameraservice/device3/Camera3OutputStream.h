@@ -165,6 +165,12 @@ class Camera3OutputStream :
      */
     status_t setBufferManager(sp<Camera3BufferManager> bufferManager);
 
+    /**
+     * Set the number of requests submitted together for this stream, so
+     * getBuffer can dequeue the buffers for the whole batch at once.
+     */
+    virtual status_t setBatchSize(size_t batchSize);
+
   protected:
     Camera3OutputStream(int id, camera3_stream_type_t type,
             uint32_t width, uint32_t height, int format,
@@ -229,6 +235,22 @@ class Camera3OutputStream :
      */
     uint32_t    mConsumerUsage;
 
+    /**
+     * Number of requests submitted together (constrained high speed mode),
+     * and the buffers dequeued for the later requests of the current batch,
+     * handed out in order by getBufferLocked. Not used with the buffer
+     * manager.
+     */
+    struct DequeuedBuffer {
+        ANativeWindowBuffer *anb;
+        int fenceFd;
+    };
+    size_t      mBatchSize;
+    Vector<DequeuedBuffer> mDequeuedBuffers;
+
+    // Return the buffers dequeued ahead to the consumer
+    void cancelDequeuedBuffersLocked();
+
     /**
      * Internal Camera3Stream interface
      */
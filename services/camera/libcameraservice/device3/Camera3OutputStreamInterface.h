@@ -59,6 +59,12 @@ class Camera3OutputStreamInterface : public virtual Camera3StreamInterface {
      *
      */
     virtual status_t detachBuffer(sp<GraphicBuffer>* buffer, int* fenceFd) = 0;
+
+    /**
+     * Set the number of capture requests submitted to the HAL together that
+     * use this stream; 1 unless in constrained high speed mode.
+     */
+    virtual status_t setBatchSize(size_t batchSize) = 0;
 };
 
 } // namespace camera3
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "LatencyHistogram.h"
+
+#include <string.h>
+
+namespace android {
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::add(nsecs_t latency) {
+    if (latency < 0) latency = 0;
+    size_t bin = ns2ms(latency) / kBinSizeMs;
+    if (bin > kNumBins) bin = kNumBins;
+    mBins[bin]++;
+    mCount++;
+    mTotal += latency;
+    if (latency > mMax) mMax = latency;
+}
+
+void LatencyHistogram::reset() {
+    memset(mBins, 0, sizeof(mBins));
+    mCount = 0;
+    mTotal = 0;
+    mMax = 0;
+}
+
+void LatencyHistogram::dump(String8& lines, const char *name) const {
+    lines.appendFormat("      %s: %zu frames", name, mCount);
+    if (mCount == 0) {
+        lines.append("\n");
+        return;
+    }
+    lines.appendFormat(", avg %.1f ms, max %.1f ms\n",
+            mTotal / 1e6 / mCount, mMax / 1e6);
+    lines.append("        ");
+    for (size_t i = 0; i <= kNumBins; i++) {
+        if (mBins[i] == 0) continue;
+        if (i < kNumBins) {
+            lines.appendFormat("[%zu-%zu ms]: %zu  ", i * kBinSizeMs, (i + 1) * kBinSizeMs,
+                    mBins[i]);
+        } else {
+            lines.appendFormat("[>%zu ms]: %zu", kNumBins * kBinSizeMs, mBins[i]);
+        }
+    }
+    lines.append("\n");
+}
+
+} // namespace android
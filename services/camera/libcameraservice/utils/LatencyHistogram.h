@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_SERVERS_CAMERA_LATENCYHISTOGRAM_H
+#define ANDROID_SERVERS_CAMERA_LATENCYHISTOGRAM_H
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/**
+ * Histogram of latencies in fixed 10 ms bins up to 200 ms, plus an overflow
+ * bin, with the count, average and maximum. Not thread-safe.
+ */
+class LatencyHistogram {
+  public:
+    LatencyHistogram();
+
+    void add(nsecs_t latency);
+    void reset();
+
+    // Append a one-line summary and the non-empty bins to lines
+    void dump(String8& lines, const char *name) const;
+
+  private:
+    static const size_t kBinSizeMs = 10;
+    static const size_t kNumBins = 20;
+
+    size_t mBins[kNumBins + 1];
+    size_t mCount;
+    nsecs_t mTotal;
+    nsecs_t mMax;
+};
+
+} // namespace android
+
+#endif
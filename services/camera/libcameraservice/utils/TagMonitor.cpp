@@ -20,6 +20,7 @@
 
 #include "TagMonitor.h"
 
+#include <algorithm>
 #include <inttypes.h>
 #include <utils/Log.h>
 #include <camera/VendorTagDescriptor.h>
@@ -28,7 +29,9 @@ namespace android {
 
 TagMonitor::TagMonitor():
         mMonitoringEnabled(false),
-        mMonitoringEvents(kMaxMonitorEvents)
+        mMonitoringEvents(kMaxMonitorEvents),
+        mMonitoringEventHead(0),
+        mMonitoringEventCount(0)
 {}
 
 const char* TagMonitor::k3aTags =
@@ -80,14 +83,17 @@ void TagMonitor::parseTagsToMonitor(String8 tagNames) {
 
     if (gotTag) {
         // Got at least one new tag
+        mLastMonitoredRequestValues.assign(mMonitoredTagList.size(), LastValue());
+        mLastMonitoredResultValues.assign(mMonitoredTagList.size(), LastValue());
         mMonitoringEnabled = true;
     }
 }
 
 void TagMonitor::disableMonitoring() {
     mMonitoringEnabled = false;
-    mLastMonitoredRequestValues.clear();
-    mLastMonitoredResultValues.clear();
+    std::lock_guard<std::mutex> lock(mMonitorMutex);
+    for (auto& value : mLastMonitoredRequestValues) value.present = false;
+    for (auto& value : mLastMonitoredResultValues) value.present = false;
 }
 
 void TagMonitor::monitorMetadata(eventSource source, int64_t frameNumber, nsecs_t timestamp,
@@ -100,51 +106,64 @@ void TagMonitor::monitorMetadata(eventSource source, int64_t frameNumber, nsecs_
         timestamp = systemTime(SYSTEM_TIME_BOOTTIME);
     }
 
-    for (auto tag : mMonitoredTagList) {
+    std::vector<LastValue> &lastValues = (source == REQUEST) ?
+            mLastMonitoredRequestValues : mLastMonitoredResultValues;
+
+    for (size_t i = 0; i < mMonitoredTagList.size(); i++) {
+        uint32_t tag = mMonitoredTagList[i];
         camera_metadata_ro_entry entry = metadata.find(tag);
-        CameraMetadata &lastValues = (source == REQUEST) ?
-                mLastMonitoredRequestValues : mLastMonitoredResultValues;
-        camera_metadata_entry lastEntry = lastValues.find(tag);
+        LastValue &lastValue = lastValues[i];
 
         if (entry.count > 0) {
-            bool isDifferent = false;
-            if (lastEntry.count > 0) {
-                // Have a last value, compare to see if changed
-                if (lastEntry.type == entry.type &&
-                        lastEntry.count == entry.count) {
-                    // Same type and count, compare values
-                    size_t bytesPerValue = camera_metadata_type_size[lastEntry.type];
-                    size_t entryBytes = bytesPerValue * lastEntry.count;
-                    int cmp = memcmp(entry.data.u8, lastEntry.data.u8, entryBytes);
-                    if (cmp != 0) {
-                        isDifferent = true;
-                    }
-                } else {
-                    // Count or type has changed
-                    isDifferent = true;
-                }
-            } else {
-                // No last entry, so always consider to be different
-                isDifferent = true;
-            }
+            size_t entryBytes = camera_metadata_type_size[entry.type] * entry.count;
+            // No last value, or count, type or values changed
+            bool isDifferent = !lastValue.present ||
+                    lastValue.type != entry.type ||
+                    lastValue.count != entry.count ||
+                    memcmp(entry.data.u8, lastValue.data.data(), entryBytes) != 0;
 
             if (isDifferent) {
                 ALOGV("%s: Tag %s changed", __FUNCTION__, get_camera_metadata_tag_name(tag));
-                lastValues.update(entry);
-                mMonitoringEvents.emplace(source, frameNumber, timestamp, entry);
+                lastValue.present = true;
+                lastValue.type = entry.type;
+                lastValue.count = entry.count;
+                lastValue.data.assign(entry.data.u8, entry.data.u8 + entryBytes);
+                recordEvent(source, frameNumber, timestamp, entry);
             }
-        } else if (lastEntry.count > 0) {
+        } else if (lastValue.present) {
             // Value has been removed
             ALOGV("%s: Tag %s removed", __FUNCTION__, get_camera_metadata_tag_name(tag));
-            lastValues.erase(tag);
+            lastValue.present = false;
             entry.tag = tag;
             entry.type = get_camera_metadata_tag_type(tag);
             entry.count = 0;
-            mMonitoringEvents.emplace(source, frameNumber, timestamp, entry);
+            recordEvent(source, frameNumber, timestamp, entry);
         }
     }
 }
 
+void TagMonitor::recordEvent(eventSource source, uint32_t frameNumber, nsecs_t timestamp,
+        const camera_metadata_ro_entry &entry) {
+    // Overwrite the oldest event once the ring is full
+    size_t idx = (mMonitoringEventHead + mMonitoringEventCount) % kMaxMonitorEvents;
+    if (mMonitoringEventCount < kMaxMonitorEvents) {
+        mMonitoringEventCount++;
+    } else {
+        mMonitoringEventHead = (mMonitoringEventHead + 1) % kMaxMonitorEvents;
+    }
+
+    MonitorEvent &event = mMonitoringEvents[idx];
+    event.source = source;
+    event.frameNumber = frameNumber;
+    event.timestamp = timestamp;
+    event.tag = entry.tag;
+    event.type = entry.type;
+    event.count = entry.count;
+    size_t bytes = camera_metadata_type_size[entry.type] * entry.count;
+    memcpy(event.newData, entry.data.u8,
+            bytes < kMaxEventDataBytes ? bytes : kMaxEventDataBytes);
+}
+
 void TagMonitor::dumpMonitoredMetadata(int fd) {
     std::lock_guard<std::mutex> lock(mMonitorMutex);
 
@@ -158,9 +177,11 @@ void TagMonitor::dumpMonitoredMetadata(int fd) {
     } else {
         dprintf(fd, "     Tag monitoring disabled (enable with -m <name1,..,nameN>)\n");
     }
-    if (mMonitoringEvents.size() > 0) {
+    if (mMonitoringEventCount > 0) {
         dprintf(fd, "     Monitored tag event log:\n");
-        for (const auto& event : mMonitoringEvents) {
+        for (size_t i = 0; i < mMonitoringEventCount; i++) {
+            const MonitorEvent &event =
+                    mMonitoringEvents[(mMonitoringEventHead + i) % kMaxMonitorEvents];
             int indentation = (event.source == REQUEST) ? 15 : 30;
             dprintf(fd, "        f%d:%" PRId64 "ns: %*s%s.%s: ",
                     event.frameNumber, event.timestamp,
@@ -168,12 +189,16 @@ void TagMonitor::dumpMonitoredMetadata(int fd) {
                     event.source == REQUEST ? "REQ:" : "RES:",
                     get_camera_metadata_section_name(event.tag),
                     get_camera_metadata_tag_name(event.tag));
-            if (event.newData.size() == 0) {
+            if (event.count == 0) {
                 dprintf(fd, " (Removed)\n");
             } else {
-                printData(fd, event.newData.data(), event.tag,
-                        event.type, event.newData.size() / camera_metadata_type_size[event.type],
-                        indentation + 18);
+                size_t typeSize = camera_metadata_type_size[event.type];
+                size_t keptCount = std::min<size_t>(event.count, kMaxEventDataBytes / typeSize);
+                if (keptCount < event.count) {
+                    dprintf(fd, "(first %zu of %u) ", keptCount, event.count);
+                }
+                printData(fd, event.newData, event.tag,
+                        event.type, keptCount, indentation + 18);
             }
         }
     }
@@ -264,18 +289,4 @@ void TagMonitor::printData(int fd, const uint8_t *data_ptr, uint32_t tag,
     }
 }
 
-template<typename T>
-TagMonitor::MonitorEvent::MonitorEvent(eventSource src, uint32_t frameNumber, nsecs_t timestamp,
-        const T &value) :
-        source(src),
-        frameNumber(frameNumber),
-        timestamp(timestamp),
-        tag(value.tag),
-        type(value.type),
-        newData(value.data.u8, value.data.u8 + camera_metadata_type_size[value.type] * value.count) {
-}
-
-TagMonitor::MonitorEvent::~MonitorEvent() {
-}
-
 } // namespace android
@@ -25,7 +25,6 @@
 #include <utils/String8.h>
 #include <utils/Timers.h>
 
-#include <media/RingBuffer.h>
 #include <system/camera_metadata.h>
 #include <camera/CameraMetadata.h>
 
@@ -34,7 +33,10 @@ namespace android {
 /**
  * A monitor for camera metadata values.
  * Tracks changes to specified metadata values over time, keeping a circular
- * buffer log that can be dumped at will. */
+ * buffer log that can be dumped at will.
+ * Recording a change only copies the raw value into a preallocated event, so
+ * that monitoring is cheap enough to leave on; values are only formatted when
+ * dumped. */
 class TagMonitor {
   public:
     enum eventSource {
@@ -71,32 +73,49 @@ class TagMonitor {
     // Current tags to monitor and record changes to
     std::vector<uint32_t> mMonitoredTagList;
 
-    // Latest-seen values of tracked tags
-    CameraMetadata mLastMonitoredRequestValues;
-    CameraMetadata mLastMonitoredResultValues;
+    /**
+     * Latest-seen value of a tracked tag, indexed like mMonitoredTagList.
+     * The data vector keeps its capacity, so updates don't allocate in steady
+     * state.
+     */
+    struct LastValue {
+        bool present;
+        uint8_t type;
+        size_t count;
+        std::vector<uint8_t> data;
+        LastValue() : present(false), type(0), count(0) {}
+    };
+    std::vector<LastValue> mLastMonitoredRequestValues;
+    std::vector<LastValue> mLastMonitoredResultValues;
+
+    // Values longer than this are truncated in the event log; enough for four
+    // 3A regions
+    static const size_t kMaxEventDataBytes = 80;
 
     /**
      * A monitoring event
      * Stores a new metadata field value and the timestamp at which it changed.
-     * Copies the source metadata value array and frees it on destruct.
      */
     struct MonitorEvent {
-        template<typename T>
-        MonitorEvent(eventSource src, uint32_t frameNumber, nsecs_t timestamp,
-                const T &newValue);
-        ~MonitorEvent();
-
         eventSource source;
         uint32_t frameNumber;
         nsecs_t timestamp;
         uint32_t tag;
         uint8_t type;
-        std::vector<uint8_t> newData;
+        // Number of values of the new value, 0 if the tag was removed
+        uint32_t count;
+        alignas(8) uint8_t newData[kMaxEventDataBytes];
     };
 
-    // A ring buffer for tracking the last kMaxMonitorEvents metadata changes
-    static const int kMaxMonitorEvents = 100;
-    RingBuffer<MonitorEvent> mMonitoringEvents;
+    // A ring buffer for tracking the last kMaxMonitorEvents metadata changes,
+    // allocated once
+    static const size_t kMaxMonitorEvents = 100;
+    std::vector<MonitorEvent> mMonitoringEvents;
+    size_t mMonitoringEventHead;
+    size_t mMonitoringEventCount;
+
+    void recordEvent(eventSource source, uint32_t frameNumber, nsecs_t timestamp,
+            const camera_metadata_ro_entry &entry);
 
     // 3A fields to use with the "3a" option
     static const char *k3aTags;
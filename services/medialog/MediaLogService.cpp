@@ -18,6 +18,8 @@
 //#define LOG_NDEBUG 0
 
 #include <sys/mman.h>
+#include <algorithm>
+#include <vector>
 #include <utils/Log.h>
 #include <binder/PermissionCache.h>
 #include <media/nbaio/NBLog.h>
@@ -28,6 +30,33 @@ namespace android {
 
 static const char kDeadlockedString[] = "MediaLogService may be deadlocked\n";
 
+void MediaLogService::onFirstRef()
+{
+    mHistogramThread = new HistogramThread(this);
+    mHistogramThread->run("MediaLogHistograms", PRIORITY_BACKGROUND);
+}
+
+bool MediaLogService::HistogramThread::threadLoop()
+{
+    usleep(kHistogramPollMs * 1000);
+    Vector<NamedReader> namedReaders;
+    {
+        Mutex::Autolock _l(mService->mLock);
+        namedReaders = mService->mNamedReaders;
+    }
+    const bool rotate = ++mPolls >= kHistogramWindowSec * 1000 / kHistogramPollMs;
+    if (rotate) {
+        mPolls = 0;
+    }
+    for (size_t i = 0; i < namedReaders.size(); i++) {
+        namedReaders[i].reader()->updateHistograms();
+        if (rotate) {
+            namedReaders[i].reader()->rotateHistograms();
+        }
+    }
+    return true;
+}
+
 void MediaLogService::registerWriter(const sp<IMemory>& shared, size_t size, const char *name)
 {
     if (IPCThreadState::self()->getCallingUid() != AID_AUDIOSERVER || shared == 0 ||
@@ -69,12 +98,49 @@ bool MediaLogService::dumpTryLock(Mutex& mutex)
     return locked;
 }
 
-status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
+/*static*/
+bool MediaLogService::checkDumpPermission()
 {
     // FIXME merge with similar but not identical code at services/audioflinger/ServiceUtilities.cpp
     static const String16 sDump("android.permission.DUMP");
-    if (!(IPCThreadState::self()->getCallingUid() == AID_AUDIOSERVER ||
-            PermissionCache::checkCallingPermission(sDump))) {
+    return IPCThreadState::self()->getCallingUid() == AID_AUDIOSERVER ||
+            PermissionCache::checkCallingPermission(sDump);
+}
+
+status_t MediaLogService::getHistogramSummary(const char *writerName, const char *name,
+        bool recent, NBLog::Histogram::Summary *summary)
+{
+    if (!checkDumpPermission()) {
+        return PERMISSION_DENIED;
+    }
+    sp<NBLog::Reader> reader;
+    {
+        Mutex::Autolock _l(mLock);
+        for (size_t i = 0; i < mNamedReaders.size(); i++) {
+            if (strcmp(mNamedReaders[i].name(), writerName) == 0) {
+                reader = mNamedReaders[i].reader();
+                break;
+            }
+        }
+    }
+    if (reader == 0) {
+        return NAME_NOT_FOUND;
+    }
+    reader->updateHistograms();
+    return reader->getHistogramSummary(name, recent, summary) ? NO_ERROR : NAME_NOT_FOUND;
+}
+
+// For a merged dump, a line of one writer's log
+struct MergedLine {
+    int64_t     mTimestampNs;
+    const char *mName;
+    String8     mText;
+    bool operator<(const MergedLine& other) const { return mTimestampNs < other.mTimestampNs; }
+};
+
+status_t MediaLogService::dump(int fd, const Vector<String16>& args)
+{
+    if (!checkDumpPermission()) {
         dprintf(fd, "Permission Denial: can't dump media.log from pid=%d, uid=%d\n",
                 IPCThreadState::self()->getCallingPid(),
                 IPCThreadState::self()->getCallingUid());
@@ -99,6 +165,35 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
         mLock.unlock();
     }
 
+    // "--merge" interleaves the lines of all writers by timestamp
+    bool merge = false;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == String16("--merge")) {
+            merge = true;
+        }
+    }
+    if (merge) {
+        std::vector<MergedLine> merged;
+        for (size_t i = 0; i < namedReaders.size(); i++) {
+            Vector<NBLog::Reader::Line> lines;
+            namedReaders[i].reader()->dump(lines);
+            for (size_t j = 0; j < lines.size(); j++) {
+                MergedLine line = { lines[j].mTimestampNs, namedReaders[i].name(), lines[j].mText };
+                merged.push_back(line);
+            }
+        }
+        // lines of one writer keep their order when they share a timestamp
+        std::stable_sort(merged.begin(), merged.end());
+        for (size_t i = 0; i < merged.size(); i++) {
+            if (fd >= 0) {
+                dprintf(fd, "%s: %s\n", merged[i].mName, merged[i].mText.string());
+            } else {
+                ALOGI("%s: %s", merged[i].mName, merged[i].mText.string());
+            }
+        }
+        return NO_ERROR;
+    }
+
     for (size_t i = 0; i < namedReaders.size(); i++) {
         const NamedReader& namedReader = namedReaders[i];
         if (fd >= 0) {
@@ -107,6 +202,8 @@ status_t MediaLogService::dump(int fd, const Vector<String16>& args __unused)
             ALOGI("%s:", namedReader.name());
         }
         namedReader.reader()->dump(fd, 0 /*indent*/);
+        namedReader.reader()->updateHistograms();
+        namedReader.reader()->dumpHistograms(fd, 0 /*indent*/);
     }
     return NO_ERROR;
 }
@@ -20,6 +20,7 @@
 #include <binder/BinderService.h>
 #include <media/IMediaLogService.h>
 #include <media/nbaio/NBLog.h>
+#include <utils/Thread.h>
 
 namespace android {
 
@@ -29,7 +30,7 @@ class MediaLogService : public BinderService<MediaLogService>, public BnMediaLog
 public:
     MediaLogService() : BnMediaLogService() { }
     virtual ~MediaLogService() { }
-    virtual void onFirstRef() { }
+    virtual void onFirstRef();
 
     static const char*  getServiceName() { return "media.log"; }
 
@@ -37,6 +38,8 @@ public:
     static const size_t kMaxSize = 0x10000;
     virtual void        registerWriter(const sp<IMemory>& shared, size_t size, const char *name);
     virtual void        unregisterWriter(const sp<IMemory>& shared);
+    virtual status_t    getHistogramSummary(const char *writerName, const char *name,
+                                            bool recent, NBLog::Histogram::Summary *summary);
 
     virtual status_t    dump(int fd, const Vector<String16>& args);
     virtual status_t    onTransact(uint32_t code, const Parcel& data, Parcel* reply,
@@ -48,6 +51,23 @@ private:
     static const int kDumpLockRetries = 50;
     static const int kDumpLockSleepUs = 20000;
     static bool dumpTryLock(Mutex& mutex);
+    static bool checkDumpPermission();
+
+    // The histograms are updated often enough not to miss values when the writers wrap,
+    // and their recent window is rotated every kHistogramWindowSec.
+    static const int kHistogramPollMs = 100;
+    static const int kHistogramWindowSec = 60;
+
+    class HistogramThread : public Thread {
+    public:
+        explicit HistogramThread(MediaLogService *service)
+            : Thread(false /*canCallJava*/), mService(service), mPolls(0) { }
+    private:
+        virtual bool threadLoop();
+        MediaLogService * const mService;   // owns this thread, and lives forever
+        int                 mPolls;
+    };
+    sp<HistogramThread> mHistogramThread;
 
     Mutex               mLock;
     class NamedReader {
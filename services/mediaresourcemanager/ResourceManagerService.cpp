@@ -43,7 +43,7 @@ static String8 getString(const Vector<T> &items) {
     return itemsStr;
 }
 
-static bool hasResourceType(MediaResource::Type type, Vector<MediaResource> resources) {
+static bool hasResourceType(MediaResource::Type type, const Vector<MediaResource> &resources) {
     for (size_t i = 0; i < resources.size(); ++i) {
         if (resources[i].mType == type) {
             return true;
@@ -52,7 +52,7 @@ static bool hasResourceType(MediaResource::Type type, Vector<MediaResource> reso
     return false;
 }
 
-static bool hasResourceType(MediaResource::Type type, ResourceInfos infos) {
+static bool hasResourceType(MediaResource::Type type, const ResourceInfos &infos) {
     for (size_t i = 0; i < infos.size(); ++i) {
         if (hasResourceType(type, infos[i].resources)) {
             return true;
@@ -120,12 +120,20 @@ status_t ResourceManagerService::dump(int fd, const Vector<String16>& /* args */
     PidResourceInfosMap mapCopy;
     bool supportsMultipleSecureCodecs;
     bool supportsSecureWithNonSecureCodec;
+    uint32_t reclaimCount;
+    uint32_t reclaimFailedCount;
+    nsecs_t reclaimTotalNs;
+    nsecs_t reclaimMaxNs;
     String8 serviceLog;
     {
         Mutex::Autolock lock(mLock);
         mapCopy = mMap;  // Shadow copy, real copy will happen on write.
         supportsMultipleSecureCodecs = mSupportsMultipleSecureCodecs;
         supportsSecureWithNonSecureCodec = mSupportsSecureWithNonSecureCodec;
+        reclaimCount = mReclaimCount;
+        reclaimFailedCount = mReclaimFailedCount;
+        reclaimTotalNs = mReclaimTotalNs;
+        reclaimMaxNs = mReclaimMaxNs;
         serviceLog = mServiceLog->toString("    " /* linePrefix */);
     }
 
@@ -140,6 +148,16 @@ status_t ResourceManagerService::dump(int fd, const Vector<String16>& /* args */
             supportsSecureWithNonSecureCodec);
     result.append(buffer);
 
+    result.append("  Reclaims:\n");
+    snprintf(buffer, SIZE, "    Count: %u (%u failed)\n", reclaimCount, reclaimFailedCount);
+    result.append(buffer);
+    if (reclaimCount > 0) {
+        snprintf(buffer, SIZE, "    Latency: avg %lld us, max %lld us\n",
+                (long long)(reclaimTotalNs / reclaimCount / 1000),
+                (long long)(reclaimMaxNs / 1000));
+        result.append(buffer);
+    }
+
     result.append("  Processes:\n");
     for (size_t i = 0; i < mapCopy.size(); ++i) {
         snprintf(buffer, SIZE, "    Pid: %d\n", mapCopy.keyAt(i));
@@ -176,7 +194,12 @@ ResourceManagerService::ResourceManagerService(sp<ProcessInfoInterface> processI
     : mProcessInfo(processInfo),
       mServiceLog(new ServiceLog()),
       mSupportsMultipleSecureCodecs(true),
-      mSupportsSecureWithNonSecureCodec(true) {}
+      mSupportsSecureWithNonSecureCodec(true),
+      mCachingPriorities(false),
+      mReclaimCount(0),
+      mReclaimFailedCount(0),
+      mReclaimTotalNs(0),
+      mReclaimMaxNs(0) {}
 
 ResourceManagerService::~ResourceManagerService() {}
 
@@ -264,6 +287,26 @@ bool ResourceManagerService::reclaimResource(
             callingPid, getString(resources).string());
     mServiceLog->add(log);
 
+    nsecs_t startNs = systemTime();
+    bool reclaimed = reclaimResources(callingPid, resources);
+    nsecs_t durationNs = systemTime() - startNs;
+
+    Mutex::Autolock lock(mLock);
+    ++mReclaimCount;
+    if (!reclaimed) {
+        ++mReclaimFailedCount;
+    }
+    mReclaimTotalNs += durationNs;
+    if (durationNs > mReclaimMaxNs) {
+        mReclaimMaxNs = durationNs;
+    }
+    ALOGV("reclaimResource: %s in %lld us",
+            reclaimed ? "reclaimed" : "failed", (long long)(durationNs / 1000));
+    return reclaimed;
+}
+
+bool ResourceManagerService::reclaimResources(
+        int callingPid, const Vector<MediaResource> &resources) {
     Vector<sp<IResourceManagerClient>> clients;
     {
         Mutex::Autolock lock(mLock);
@@ -271,62 +314,12 @@ bool ResourceManagerService::reclaimResource(
             ALOGE("Rejected reclaimResource call with invalid callingPid.");
             return false;
         }
-        const MediaResource *secureCodec = NULL;
-        const MediaResource *nonSecureCodec = NULL;
-        const MediaResource *graphicMemory = NULL;
-        for (size_t i = 0; i < resources.size(); ++i) {
-            MediaResource::Type type = resources[i].mType;
-            if (resources[i].mType == MediaResource::kSecureCodec) {
-                secureCodec = &resources[i];
-            } else if (type == MediaResource::kNonSecureCodec) {
-                nonSecureCodec = &resources[i];
-            } else if (type == MediaResource::kGraphicMemory) {
-                graphicMemory = &resources[i];
-            }
-        }
-
-        // first pass to handle secure/non-secure codec conflict
-        if (secureCodec != NULL) {
-            if (!mSupportsMultipleSecureCodecs) {
-                if (!getAllClients_l(callingPid, MediaResource::kSecureCodec, &clients)) {
-                    return false;
-                }
-            }
-            if (!mSupportsSecureWithNonSecureCodec) {
-                if (!getAllClients_l(callingPid, MediaResource::kNonSecureCodec, &clients)) {
-                    return false;
-                }
-            }
-        }
-        if (nonSecureCodec != NULL) {
-            if (!mSupportsSecureWithNonSecureCodec) {
-                if (!getAllClients_l(callingPid, MediaResource::kSecureCodec, &clients)) {
-                    return false;
-                }
-            }
-        }
-
-        if (clients.size() == 0) {
-            // if no secure/non-secure codec conflict, run second pass to handle other resources.
-            getClientForResource_l(callingPid, graphicMemory, &clients);
-        }
-
-        if (clients.size() == 0) {
-            // if we are here, run the third pass to free one codec with the same type.
-            getClientForResource_l(callingPid, secureCodec, &clients);
-            getClientForResource_l(callingPid, nonSecureCodec, &clients);
-        }
-
-        if (clients.size() == 0) {
-            // if we are here, run the fourth pass to free one codec with the different type.
-            if (secureCodec != NULL) {
-                MediaResource temp(MediaResource::kNonSecureCodec, 1);
-                getClientForResource_l(callingPid, &temp, &clients);
-            }
-            if (nonSecureCodec != NULL) {
-                MediaResource temp(MediaResource::kSecureCodec, 1);
-                getClientForResource_l(callingPid, &temp, &clients);
-            }
+        mCachingPriorities = true;
+        bool ok = getClientsToReclaim_l(callingPid, resources, &clients);
+        mCachingPriorities = false;
+        mPriorityCache.clear();
+        if (!ok) {
+            return false;
         }
     }
 
@@ -336,7 +329,7 @@ bool ResourceManagerService::reclaimResource(
 
     sp<IResourceManagerClient> failedClient;
     for (size_t i = 0; i < clients.size(); ++i) {
-        log = String8::format("reclaimResource from client %p", clients[i].get());
+        String8 log = String8::format("reclaimResource from client %p", clients[i].get());
         mServiceLog->add(log);
         if (!clients[i]->reclaimResource()) {
             failedClient = clients[i];
@@ -373,6 +366,69 @@ bool ResourceManagerService::reclaimResource(
     return false;
 }
 
+bool ResourceManagerService::getClientsToReclaim_l(
+        int callingPid, const Vector<MediaResource> &resources,
+        Vector<sp<IResourceManagerClient>> *clients) {
+    const MediaResource *secureCodec = NULL;
+    const MediaResource *nonSecureCodec = NULL;
+    const MediaResource *graphicMemory = NULL;
+    for (size_t i = 0; i < resources.size(); ++i) {
+        MediaResource::Type type = resources[i].mType;
+        if (resources[i].mType == MediaResource::kSecureCodec) {
+            secureCodec = &resources[i];
+        } else if (type == MediaResource::kNonSecureCodec) {
+            nonSecureCodec = &resources[i];
+        } else if (type == MediaResource::kGraphicMemory) {
+            graphicMemory = &resources[i];
+        }
+    }
+
+    // first pass to handle secure/non-secure codec conflict
+    if (secureCodec != NULL) {
+        if (!mSupportsMultipleSecureCodecs) {
+            if (!getAllClients_l(callingPid, MediaResource::kSecureCodec, clients)) {
+                return false;
+            }
+        }
+        if (!mSupportsSecureWithNonSecureCodec) {
+            if (!getAllClients_l(callingPid, MediaResource::kNonSecureCodec, clients)) {
+                return false;
+            }
+        }
+    }
+    if (nonSecureCodec != NULL) {
+        if (!mSupportsSecureWithNonSecureCodec) {
+            if (!getAllClients_l(callingPid, MediaResource::kSecureCodec, clients)) {
+                return false;
+            }
+        }
+    }
+
+    if (clients->size() == 0) {
+        // if no secure/non-secure codec conflict, run second pass to handle other resources.
+        getClientForResource_l(callingPid, graphicMemory, clients);
+    }
+
+    if (clients->size() == 0) {
+        // if we are here, run the third pass to free one codec with the same type.
+        getClientForResource_l(callingPid, secureCodec, clients);
+        getClientForResource_l(callingPid, nonSecureCodec, clients);
+    }
+
+    if (clients->size() == 0) {
+        // if we are here, run the fourth pass to free one codec with the different type.
+        if (secureCodec != NULL) {
+            MediaResource temp(MediaResource::kNonSecureCodec, 1);
+            getClientForResource_l(callingPid, &temp, clients);
+        }
+        if (nonSecureCodec != NULL) {
+            MediaResource temp(MediaResource::kSecureCodec, 1);
+            getClientForResource_l(callingPid, &temp, clients);
+        }
+    }
+    return true;
+}
+
 bool ResourceManagerService::getAllClients_l(
         int callingPid, MediaResource::Type type, Vector<sp<IResourceManagerClient>> *clients) {
     Vector<sp<IResourceManagerClient>> temp;
@@ -404,7 +460,7 @@ bool ResourceManagerService::getLowestPriorityBiggestClient_l(
     int lowestPriorityPid;
     int lowestPriority;
     int callingPriority;
-    if (!mProcessInfo->getPriority(callingPid, &callingPriority)) {
+    if (!getPriority_l(callingPid, &callingPriority)) {
         ALOGE("getLowestPriorityBiggestClient_l: can't get process priority for pid %d",
                 callingPid);
         return false;
@@ -439,7 +495,7 @@ bool ResourceManagerService::getLowestPriorityPid_l(
         }
         int tempPid = mMap.keyAt(i);
         int tempPriority;
-        if (!mProcessInfo->getPriority(tempPid, &tempPriority)) {
+        if (!getPriority_l(tempPid, &tempPriority)) {
             ALOGV("getLowestPriorityPid_l: can't get priority of pid %d, skipped", tempPid);
             // TODO: remove this pid from mMap?
             continue;
@@ -459,18 +515,35 @@ bool ResourceManagerService::getLowestPriorityPid_l(
 
 bool ResourceManagerService::isCallingPriorityHigher_l(int callingPid, int pid) {
     int callingPidPriority;
-    if (!mProcessInfo->getPriority(callingPid, &callingPidPriority)) {
+    if (!getPriority_l(callingPid, &callingPidPriority)) {
         return false;
     }
 
     int priority;
-    if (!mProcessInfo->getPriority(pid, &priority)) {
+    if (!getPriority_l(pid, &priority)) {
         return false;
     }
 
     return (callingPidPriority < priority);
 }
 
+bool ResourceManagerService::getPriority_l(int pid, int *priority) {
+    if (mCachingPriorities) {
+        ssize_t index = mPriorityCache.indexOfKey(pid);
+        if (index >= 0) {
+            *priority = mPriorityCache.valueAt(index);
+            return true;
+        }
+    }
+    if (!mProcessInfo->getPriority(pid, priority)) {
+        return false;
+    }
+    if (mCachingPriorities) {
+        mPriorityCache.add(pid, *priority);
+    }
+    return true;
+}
+
 bool ResourceManagerService::getBiggestClient_l(
         int pid, MediaResource::Type type, sp<IResourceManagerClient> *client) {
     ssize_t index = mMap.indexOfKey(pid);
@@ -483,7 +556,7 @@ bool ResourceManagerService::getBiggestClient_l(
     uint64_t largestValue = 0;
     const ResourceInfos &infos = mMap.valueAt(index);
     for (size_t i = 0; i < infos.size(); ++i) {
-        Vector<MediaResource> resources = infos[i].resources;
+        const Vector<MediaResource> &resources = infos[i].resources;
         for (size_t j = 0; j < resources.size(); ++j) {
             if (resources[j].mType == type) {
                 if (resources[j].mValue > largestValue) {
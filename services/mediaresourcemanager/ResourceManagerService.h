@@ -24,6 +24,7 @@
 #include <utils/KeyedVector.h>
 #include <utils/String8.h>
 #include <utils/threads.h>
+#include <utils/Timers.h>
 #include <utils/Vector.h>
 
 #include <media/IResourceManagerService.h>
@@ -98,6 +99,17 @@ private:
 
     bool isCallingPriorityHigher_l(int callingPid, int pid);
 
+    // Does the work of reclaimResource(), which also times it.
+    bool reclaimResources(int callingPid, const Vector<MediaResource> &resources);
+
+    // Gets the priority of pid, from the per-reclaim cache if it is enabled.
+    bool getPriority_l(int pid, int *priority);
+
+    // Picks the clients to reclaim from for reclaimResource().
+    // Returns false if the request can't be fulfilled.
+    bool getClientsToReclaim_l(int callingPid, const Vector<MediaResource> &resources,
+            Vector<sp<IResourceManagerClient>> *clients);
+
     // A helper function basically calls getLowestPriorityBiggestClient_l and add the result client
     // to the given Vector.
     void getClientForResource_l(
@@ -109,6 +121,18 @@ private:
     PidResourceInfosMap mMap;
     bool mSupportsMultipleSecureCodecs;
     bool mSupportsSecureWithNonSecureCodec;
+
+    // Process priorities looked up during the reclaim decision in progress.
+    // Every lookup is a call into the activity manager, and a decision can
+    // ask for the same pid many times.
+    bool mCachingPriorities;
+    KeyedVector<int, int> mPriorityCache;
+
+    // reclaim latency stats, for dump()
+    uint32_t mReclaimCount;
+    uint32_t mReclaimFailedCount;
+    nsecs_t mReclaimTotalNs;
+    nsecs_t mReclaimMaxNs;
 };
 
 // ----------------------------------------------------------------------------
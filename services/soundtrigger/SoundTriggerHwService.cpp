@@ -309,10 +309,6 @@ void SoundTriggerHwService::sendRecognitionEvent(struct sound_trigger_recognitio
 
         event = &newEvent.common;
      }
-     sp<IMemory> eventMemory = prepareRecognitionEvent_l(event);
-     if (eventMemory == 0) {
-         return;
-     }
      sp<Module> strongModule;
      for (size_t i = 0; i < mModules.size(); i++) {
          if (mModules.valueAt(i).get() == module) {
@@ -323,6 +319,10 @@ void SoundTriggerHwService::sendRecognitionEvent(struct sound_trigger_recognitio
      if (strongModule == 0) {
          return;
      }
+     sp<IMemory> eventMemory = prepareRecognitionEvent_l(event);
+     if (eventMemory == 0) {
+         return;
+     }
 
      sendCallbackEvent_l(new CallbackEvent(CallbackEvent::TYPE_RECOGNITION,
                                                   eventMemory, strongModule));
@@ -424,22 +424,27 @@ void SoundTriggerHwService::sendCallbackEvent_l(const sp<CallbackEvent>& event)
     mCallbackThread->sendCallbackEvent(event);
 }
 
-void SoundTriggerHwService::onCallbackEvent(const sp<CallbackEvent>& event)
+void SoundTriggerHwService::onCallbackEvents(const Vector< sp<CallbackEvent> >& events)
 {
-    ALOGV("onCallbackEvent");
-    sp<Module> module;
+    ALOGV("onCallbackEvents %zu events", events.size());
+    Vector< sp<Module> > modules;
     {
         AutoMutex lock(mServiceLock);
-        module = event->mModule.promote();
-        if (module == 0) {
-            return;
+        for (size_t i = 0; i < events.size(); i++) {
+            modules.add(events[i]->mModule.promote());
+        }
+    }
+    for (size_t i = 0; i < events.size(); i++) {
+        if (modules[i] != 0) {
+            modules[i]->onCallbackEvent(events[i]);
         }
     }
-    module->onCallbackEvent(event);
     {
         AutoMutex lock(mServiceLock);
         // clear now to execute with mServiceLock locked
-        event->mMemory.clear();
+        for (size_t i = 0; i < events.size(); i++) {
+            events[i]->mMemory.clear();
+        }
     }
 }
 
@@ -467,7 +472,9 @@ void SoundTriggerHwService::CallbackThread::onFirstRef()
 bool SoundTriggerHwService::CallbackThread::threadLoop()
 {
     while (!exitPending()) {
-        sp<CallbackEvent> event;
+        // events queued while the previous batch was delivered, e.g. by several
+        // models triggering at once, are delivered together
+        Vector< sp<CallbackEvent> > events;
         sp<SoundTriggerHwService> service;
         {
             Mutex::Autolock _l(mCallbackLock);
@@ -479,12 +486,12 @@ bool SoundTriggerHwService::CallbackThread::threadLoop()
             if (exitPending()) {
                 break;
             }
-            event = mEventQueue[0];
-            mEventQueue.removeAt(0);
+            events = mEventQueue;
+            mEventQueue.clear();
             service = mService.promote();
         }
         if (service != 0) {
-            service->onCallbackEvent(event);
+            service->onCallbackEvents(events);
         }
     }
     return false;
@@ -190,7 +190,7 @@ public:
            void sendServiceStateEvent_l(sound_trigger_service_state_t state, Module *module);
 
            void sendCallbackEvent_l(const sp<CallbackEvent>& event);
-           void onCallbackEvent(const sp<CallbackEvent>& event);
+           void onCallbackEvents(const Vector< sp<CallbackEvent> >& events);
 
 private:
 